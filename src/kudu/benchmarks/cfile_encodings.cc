@@ -0,0 +1,478 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Micro benchmark for the cfile encodings. For every type and encoding
+// registered in TypeEncodingInfo and each of several data distributions,
+// writes a CFile, then measures:
+//
+//  - the encoded size,
+//  - encode throughput (CFileWriter::AppendEntries() and Finish()),
+//  - decode throughput (a full CFileIterator scan out of the block cache),
+//  - for sorted data of key types, the latency of CFileIterator::SeekAtOrAfter(),
+//    which ends in the block decoder's SeekAtOrAfterValue().
+//
+// The files are written without compression, so the numbers are those of the
+// encodings alone. Each result is printed to stdout as a line of JSON.
+//
+// Going through the CFile rather than the block builders and decoders
+// directly costs a little index maintenance, but it's what the tablet does,
+// and dictionary-encoded blocks can't be decoded without their file anyway.
+
+#include <inttypes.h>
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/type_encodings.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/encoded_key.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/types.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/random.h"
+#include "kudu/util/status.h"
+#include "kudu/util/stopwatch.h"
+
+DEFINE_string(cfile_encodings_types, "BOOL,INT32,UINT32,INT64,DOUBLE,BINARY",
+              "Comma-separated list of the data types to benchmark.");
+DEFINE_string(cfile_encodings_encodings, "",
+              "Comma-separated list of the encodings to benchmark, e.g. "
+              "'RLE,BIT_SHUFFLE'. Empty means every encoding of each type.");
+DEFINE_string(cfile_encodings_distributions, "sorted,random,low_cardinality,high_cardinality,runs",
+              "Comma-separated list of the data distributions to benchmark. "
+              "'sorted' counts up by one, 'random' is uniform over the type's range, "
+              "'low_cardinality' and 'high_cardinality' draw values without order from "
+              "--cfile_encodings_low_cardinality and as many values as there are rows, "
+              "and 'runs' repeats each of a sorted sequence of values "
+              "--cfile_encodings_run_length times.");
+DEFINE_int32(cfile_encodings_num_rows, 1000000, "Number of values per file.");
+DEFINE_int32(cfile_encodings_iterations, 5,
+             "Number of times each file is encoded and scanned. The fastest run is reported.");
+DEFINE_int32(cfile_encodings_num_seeks, 10000,
+             "Number of random seeks timed in each sorted file of a key type.");
+DEFINE_int32(cfile_encodings_low_cardinality, 16,
+             "Number of distinct values of the 'low_cardinality' distribution.");
+DEFINE_int32(cfile_encodings_run_length, 100,
+             "Number of times each value repeats in the 'runs' distribution.");
+DEFINE_string(cfile_encodings_dir, "",
+              "Directory for the files written by the benchmark. Its contents are deleted. "
+              "Defaults to a directory under the test directory.");
+
+DECLARE_bool(enable_data_block_fsync);
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace cfile {
+
+namespace {
+
+enum Distribution {
+  SORTED,
+  RANDOM,
+  LOW_CARDINALITY,
+  HIGH_CARDINALITY,
+  RUNS
+};
+
+const char* const kDistributionNames[] = {
+  "sorted", "random", "low_cardinality", "high_cardinality", "runs"
+};
+
+const EncodingType kAllEncodings[] = {
+  PLAIN_ENCODING, PREFIX_ENCODING, GROUP_VARINT, RLE, DICT_ENCODING,
+  BIT_SHUFFLE, DELTA_OF_DELTA, XOR_ENCODING
+};
+
+// The results of benchmarking one type, encoding and distribution.
+struct Result {
+  uint64_t encoded_bytes = 0;
+  double encode_sec = 0;
+  double decode_sec = 0;
+  // Negative if the seeks weren't measured.
+  double seek_ns = -1;
+};
+
+// The values of a column, in the in-memory format of its type.
+class ColumnData {
+ public:
+  ColumnData(const TypeInfo* type, Distribution dist, int num_rows)
+      : type_(type),
+        num_rows_(num_rows),
+        cells_(type->size() * num_rows) {
+    Random rng(0x5eed);
+    if (type_->physical_type() == BINARY) {
+      strings_.resize(num_rows_);
+    }
+    for (int i = 0; i < num_rows_; i++) {
+      int64_t v = 0;
+      switch (dist) {
+        case SORTED:
+          // So that sorted booleans aren't simply alternating.
+          v = type_->type() == BOOL ? (i * 2L >= num_rows_) : i;
+          break;
+        case RANDOM:
+          v = static_cast<int64_t>(rng.Next64());
+          break;
+        case LOW_CARDINALITY:
+          v = rng.Uniform64(FLAGS_cfile_encodings_low_cardinality);
+          break;
+        case HIGH_CARDINALITY:
+          v = rng.Uniform64(num_rows_);
+          break;
+        case RUNS:
+          v = i / FLAGS_cfile_encodings_run_length;
+          break;
+      }
+      Set(i, v);
+    }
+  }
+
+  const void* cells() const { return cells_.data(); }
+  const void* cell(int i) const { return &cells_[type_->size() * i]; }
+  int num_rows() const { return num_rows_; }
+
+  // The size of the values before encoding.
+  uint64_t raw_bytes() const {
+    if (type_->physical_type() != BINARY) {
+      return cells_.size();
+    }
+    uint64_t bytes = 0;
+    for (const string& s : strings_) {
+      bytes += s.size();
+    }
+    return bytes;
+  }
+
+ private:
+  void Set(int i, int64_t v) {
+    uint8_t* cell = &cells_[type_->size() * i];
+    switch (type_->physical_type()) {
+      case BOOL:
+        *reinterpret_cast<bool*>(cell) = v & 1;
+        break;
+      case INT8:
+        *reinterpret_cast<int8_t*>(cell) = v;
+        break;
+      case UINT8:
+        *reinterpret_cast<uint8_t*>(cell) = v;
+        break;
+      case INT16:
+        *reinterpret_cast<int16_t*>(cell) = v;
+        break;
+      case UINT16:
+        *reinterpret_cast<uint16_t*>(cell) = v;
+        break;
+      case INT32:
+        *reinterpret_cast<int32_t*>(cell) = v;
+        break;
+      case UINT32:
+        *reinterpret_cast<uint32_t*>(cell) = v;
+        break;
+      case INT64:
+        *reinterpret_cast<int64_t*>(cell) = v;
+        break;
+      case UINT64:
+        *reinterpret_cast<uint64_t*>(cell) = v;
+        break;
+      case FLOAT:
+        *reinterpret_cast<float*>(cell) = v;
+        break;
+      case DOUBLE:
+        *reinterpret_cast<double*>(cell) = v;
+        break;
+      case BINARY:
+        // Fixed-width hex, so that sorted values sort as strings too.
+        strings_[i] = StringPrintf("%016" PRIx64, static_cast<uint64_t>(v));
+        *reinterpret_cast<Slice*>(cell) = Slice(strings_[i]);
+        break;
+      default:
+        LOG(FATAL) << "Unsupported type: " << type_->name();
+    }
+  }
+
+  const TypeInfo* const type_;
+  const int num_rows_;
+  vector<uint8_t> cells_;
+  // The storage for the Slices of a BINARY column.
+  vector<string> strings_;
+};
+
+class EncodingBenchmark {
+ public:
+  Status Init() {
+    Env* env = Env::Default();
+    string dir = FLAGS_cfile_encodings_dir;
+    if (dir.empty()) {
+      RETURN_NOT_OK(env->GetTestDirectory(&dir));
+      dir = JoinPathSegments(dir, "cfile_encodings");
+    }
+    if (env->FileExists(dir)) {
+      RETURN_NOT_OK(env->DeleteRecursively(dir));
+    }
+    // The benchmark is about CPU time; flushes to disk would only add noise.
+    FLAGS_enable_data_block_fsync = false;
+    fs_manager_.reset(new FsManager(env, dir));
+    RETURN_NOT_OK(fs_manager_->CreateInitialFileSystemLayout());
+    return fs_manager_->Open();
+  }
+
+  Status Run() {
+    vector<const TypeInfo*> types;
+    vector<string> type_names = Split(FLAGS_cfile_encodings_types, ",", strings::SkipEmpty());
+    for (const string& name : type_names) {
+      DataType type;
+      if (!DataType_Parse(name, &type)) {
+        return Status::InvalidArgument("unknown data type", name);
+      }
+      types.push_back(GetTypeInfo(type));
+    }
+
+    vector<EncodingType> encodings;
+    vector<string> encoding_names = Split(FLAGS_cfile_encodings_encodings, ",",
+                                          strings::SkipEmpty());
+    for (const string& name : encoding_names) {
+      EncodingType encoding;
+      if (!EncodingType_Parse(name, &encoding)) {
+        return Status::InvalidArgument("unknown encoding", name);
+      }
+      encodings.push_back(encoding);
+    }
+    if (encodings.empty()) {
+      encodings.assign(std::begin(kAllEncodings), std::end(kAllEncodings));
+    }
+
+    vector<Distribution> dists;
+    vector<string> dist_names = Split(FLAGS_cfile_encodings_distributions, ",",
+                                      strings::SkipEmpty());
+    for (const string& name : dist_names) {
+      auto it = std::find(std::begin(kDistributionNames), std::end(kDistributionNames), name);
+      if (it == std::end(kDistributionNames)) {
+        return Status::InvalidArgument("unknown distribution", name);
+      }
+      dists.push_back(static_cast<Distribution>(it - std::begin(kDistributionNames)));
+    }
+
+    for (const TypeInfo* type : types) {
+      for (Distribution dist : dists) {
+        ColumnData data(type, dist, FLAGS_cfile_encodings_num_rows);
+        for (EncodingType encoding : encodings) {
+          const TypeEncodingInfo* info;
+          if (!TypeEncodingInfo::Get(type, encoding, &info).ok()) {
+            continue;
+          }
+          Result result;
+          RETURN_NOT_OK_PREPEND(
+              Benchmark(type, encoding, dist, data, &result),
+              Substitute("$0 $1 $2", type->name(), EncodingType_Name(encoding),
+                         kDistributionNames[dist]));
+          Report(type, encoding, dist, data, result);
+        }
+      }
+    }
+    return Status::OK();
+  }
+
+ private:
+  Status WriteFile(const TypeInfo* type, EncodingType encoding,
+                   const ColumnData& data, bool write_validx, BlockId* id) {
+    gscoped_ptr<fs::WritableBlock> sink;
+    RETURN_NOT_OK(fs_manager_->CreateNewBlock(&sink));
+    *id = sink->id();
+    WriterOptions opts;
+    opts.write_posidx = true;
+    opts.write_validx = write_validx;
+    opts.storage_attributes.encoding = encoding;
+    opts.storage_attributes.compression = NO_COMPRESSION;
+    CFileWriter w(opts, type, false, std::move(sink));
+    RETURN_NOT_OK(w.Start());
+    RETURN_NOT_OK(w.AppendEntries(data.cells(), data.num_rows()));
+    return w.Finish();
+  }
+
+  // Scans the whole file, returning the number of values read.
+  Status Scan(const TypeInfo* type, CFileIterator* iter, int64_t* count) {
+    const size_t kBatchSize = 8192;
+    Arena arena(32 * 1024, 4 * 1024 * 1024);
+    vector<uint8_t> cells(type->size() * kBatchSize);
+    ColumnBlock cb(type, nullptr, cells.data(), kBatchSize, &arena);
+    *count = 0;
+    RETURN_NOT_OK(iter->SeekToFirst());
+    while (iter->HasNext()) {
+      size_t n = kBatchSize;
+      RETURN_NOT_OK(iter->CopyNextValues(&n, &cb));
+      *count += n;
+      arena.Reset();
+    }
+    return Status::OK();
+  }
+
+  Status Benchmark(const TypeInfo* type, EncodingType encoding, Distribution dist,
+                   const ColumnData& data, Result* result) {
+    // Only key types have a value index, and seeking in one takes sorted data.
+    bool seekable = (dist == SORTED || dist == RUNS) &&
+        type->type() != BOOL && type->type() != FLOAT && type->type() != DOUBLE;
+
+    result->encode_sec = std::numeric_limits<double>::max();
+    for (int i = 0; i < FLAGS_cfile_encodings_iterations; i++) {
+      BlockId id;
+      Stopwatch sw;
+      sw.start();
+      RETURN_NOT_OK(WriteFile(type, encoding, data, false, &id));
+      sw.stop();
+      result->encode_sec = std::min(result->encode_sec, sw.elapsed().wall_seconds());
+
+      if (i == 0) {
+        gscoped_ptr<fs::ReadableBlock> block;
+        RETURN_NOT_OK(fs_manager_->OpenBlock(id, &block));
+        RETURN_NOT_OK(block->Size(&result->encoded_bytes));
+      }
+      RETURN_NOT_OK(fs_manager_->DeleteBlock(id));
+    }
+
+    // Read back a file with a value index when there will be seeks, so that
+    // the scans and the seeks are of the same file.
+    BlockId id;
+    RETURN_NOT_OK(WriteFile(type, encoding, data, seekable, &id));
+    gscoped_ptr<fs::ReadableBlock> block;
+    RETURN_NOT_OK(fs_manager_->OpenBlock(id, &block));
+    gscoped_ptr<CFileReader> reader;
+    RETURN_NOT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    RETURN_NOT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+
+    // The first scan loads the blocks into the cache.
+    int64_t count;
+    RETURN_NOT_OK(Scan(type, iter.get(), &count));
+    if (count != data.num_rows()) {
+      return Status::Corruption(Substitute("read $0 values back, expected $1",
+                                           count, data.num_rows()));
+    }
+    result->decode_sec = std::numeric_limits<double>::max();
+    for (int i = 0; i < FLAGS_cfile_encodings_iterations; i++) {
+      Stopwatch sw;
+      sw.start();
+      RETURN_NOT_OK(Scan(type, iter.get(), &count));
+      sw.stop();
+      result->decode_sec = std::min(result->decode_sec, sw.elapsed().wall_seconds());
+    }
+
+    if (seekable && FLAGS_cfile_encodings_num_seeks > 0) {
+      Schema schema({ ColumnSchema("key", type->type()) }, 1);
+      vector<unique_ptr<EncodedKey>> keys;
+      Random rng(0xfeed);
+      for (int i = 0; i < FLAGS_cfile_encodings_num_seeks; i++) {
+        EncodedKeyBuilder kb(&schema);
+        kb.AddColumnKey(data.cell(rng.Uniform(data.num_rows())));
+        keys.emplace_back(kb.BuildEncodedKey());
+      }
+      Stopwatch sw;
+      sw.start();
+      for (const auto& key : keys) {
+        bool exact;
+        RETURN_NOT_OK(iter->SeekAtOrAfter(*key, &exact));
+        DCHECK(exact);
+      }
+      sw.stop();
+      result->seek_ns = sw.elapsed().wall_seconds() * 1e9 / keys.size();
+    }
+
+    iter.reset();
+    reader.reset();
+    return fs_manager_->DeleteBlock(id);
+  }
+
+  void Report(const TypeInfo* type, EncodingType encoding, Distribution dist,
+              const ColumnData& data, const Result& result) {
+    double raw_mb = static_cast<double>(data.raw_bytes()) / (1024 * 1024);
+    std::stringstream out;
+    JsonWriter jw(&out, JsonWriter::COMPACT);
+    jw.StartObject();
+    jw.String("type");
+    jw.String(type->name());
+    jw.String("encoding");
+    jw.String(EncodingType_Name(encoding));
+    jw.String("distribution");
+    jw.String(kDistributionNames[dist]);
+    jw.String("rows");
+    jw.Int64(data.num_rows());
+    jw.String("raw_bytes");
+    jw.Uint64(data.raw_bytes());
+    jw.String("encoded_bytes");
+    jw.Uint64(result.encoded_bytes);
+    jw.String("bits_per_value");
+    jw.Double(result.encoded_bytes * 8.0 / data.num_rows());
+    jw.String("encode_mb_per_sec");
+    jw.Double(raw_mb / result.encode_sec);
+    jw.String("decode_mb_per_sec");
+    jw.Double(raw_mb / result.decode_sec);
+    jw.String("decode_ns_per_value");
+    jw.Double(result.decode_sec * 1e9 / data.num_rows());
+    if (result.seek_ns >= 0) {
+      jw.String("seek_ns");
+      jw.Double(result.seek_ns);
+    }
+    jw.EndObject();
+    std::cout << out.str() << std::endl;
+  }
+
+  gscoped_ptr<FsManager> fs_manager_;
+};
+
+} // anonymous namespace
+
+} // namespace cfile
+} // namespace kudu
+
+int main(int argc, char* argv[]) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  kudu::cfile::EncodingBenchmark benchmark;
+  kudu::Status s = benchmark.Init();
+  if (s.ok()) {
+    s = benchmark.Run();
+  }
+  if (!s.ok()) {
+    std::cerr << "The benchmark failed: " << s.ToString() << std::endl;
+    return 1;
+  }
+  return 0;
+}
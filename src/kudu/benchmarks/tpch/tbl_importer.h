@@ -0,0 +1,113 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TPCH_TBL_IMPORTER_H
+#define KUDU_TPCH_TBL_IMPORTER_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "kudu/client/schema.h"
+#include "kudu/common/partial_row.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/stringpiece.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// Utility class used to parse the '|' separated files output by dbgen for any
+// of the TPC-H tables whose schema lists its columns in the order of the
+// file's fields, i.e. all of them but lineitem (see LineItemTsvImporter).
+class TblImporter {
+ public:
+  TblImporter(const std::string& path, const client::KuduSchema& schema)
+      : in_(path.c_str()),
+        schema_(schema),
+        updated_(false),
+        done_(false) {
+    CHECK(in_.is_open()) << "not able to open input file: " << path;
+  }
+
+  bool HasNextLine() {
+    if (!updated_) {
+      done_ = !getline(in_, line_);
+      updated_ = true;
+    }
+    return !done_;
+  }
+
+  // Fills the row builder with the next line of the file, which must exist.
+  void GetNextLine(KuduPartialRow* row) {
+    CHECK(HasNextLine());
+    // dbgen ends each line with a separator, so there's one more field than
+    // there are columns.
+    columns_ = strings::Split(line_, "|");
+    CHECK_GE(columns_.size(), schema_.num_columns()) << "Bad line: '" << line_ << "'";
+    for (size_t i = 0; i < schema_.num_columns(); i++) {
+      Populate(columns_[i], i, row);
+    }
+    updated_ = false;
+  }
+
+ private:
+  void Populate(const StringPiece& chars, int col_idx, KuduPartialRow* row) {
+    chars.CopyToString(&tmp_);
+    bool ok_parse = true;
+    switch (schema_.Column(col_idx).type()) {
+      case client::KuduColumnSchema::INT32: {
+        int32_t number;
+        ok_parse = SimpleAtoi(tmp_.c_str(), &number);
+        if (ok_parse) {
+          CHECK_OK(row->SetInt32(col_idx, number));
+        }
+        break;
+      }
+      case client::KuduColumnSchema::INT64: {
+        int64_t number;
+        ok_parse = safe_strto64(tmp_.c_str(), &number);
+        if (ok_parse) {
+          CHECK_OK(row->SetInt64(col_idx, number));
+        }
+        break;
+      }
+      case client::KuduColumnSchema::DOUBLE: {
+        double number;
+        ok_parse = safe_strtod(tmp_.c_str(), &number);
+        if (ok_parse) {
+          CHECK_OK(row->SetDouble(col_idx, number));
+        }
+        break;
+      }
+      case client::KuduColumnSchema::STRING:
+        CHECK_OK(row->SetStringCopy(col_idx, tmp_));
+        break;
+      default:
+        LOG(FATAL) << "Unexpected type for column " << col_idx;
+    }
+    CHECK(ok_parse) << "Bad value in column " << col_idx << ": '" << tmp_ << "'";
+  }
+
+  std::ifstream in_;
+  const client::KuduSchema schema_;
+  std::vector<StringPiece> columns_;
+  std::string line_, tmp_;
+  bool updated_, done_;
+};
+
+} // namespace kudu
+#endif
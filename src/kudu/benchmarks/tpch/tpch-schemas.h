@@ -113,6 +113,104 @@ inline std::vector<std::string> GetTpchQ1QueryColumns() {
            kTaxColName };
 }
 
+// The schemas of the other tables list their columns in the order of the
+// fields of dbgen's output, so that TblImporter can load them.
+
+inline client::KuduSchema CreatePartSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  b.AddColumn("p_partkey")->Type(kInt32)->NotNull()->PrimaryKey();
+  b.AddColumn("p_name")->Type(kString)->NotNull();
+  b.AddColumn("p_mfgr")->Type(kString)->NotNull();
+  b.AddColumn("p_brand")->Type(kString)->NotNull();
+  b.AddColumn("p_type")->Type(kString)->NotNull();
+  b.AddColumn("p_size")->Type(kInt32)->NotNull();
+  b.AddColumn("p_container")->Type(kString)->NotNull();
+  b.AddColumn("p_retailprice")->Type(kDouble)->NotNull();
+  b.AddColumn("p_comment")->Type(kString)->NotNull();
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateSupplierSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  b.AddColumn("s_suppkey")->Type(kInt32)->NotNull()->PrimaryKey();
+  b.AddColumn("s_name")->Type(kString)->NotNull();
+  b.AddColumn("s_address")->Type(kString)->NotNull();
+  b.AddColumn("s_nationkey")->Type(kInt32)->NotNull();
+  b.AddColumn("s_phone")->Type(kString)->NotNull();
+  b.AddColumn("s_acctbal")->Type(kDouble)->NotNull();
+  b.AddColumn("s_comment")->Type(kString)->NotNull();
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreatePartSuppSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  b.AddColumn("ps_partkey")->Type(kInt32)->NotNull();
+  b.AddColumn("ps_suppkey")->Type(kInt32)->NotNull();
+  b.AddColumn("ps_availqty")->Type(kInt32)->NotNull();
+  b.AddColumn("ps_supplycost")->Type(kDouble)->NotNull();
+  b.AddColumn("ps_comment")->Type(kString)->NotNull();
+  b.SetPrimaryKey({ "ps_partkey", "ps_suppkey" });
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateCustomerSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  b.AddColumn("c_custkey")->Type(kInt32)->NotNull()->PrimaryKey();
+  b.AddColumn("c_name")->Type(kString)->NotNull();
+  b.AddColumn("c_address")->Type(kString)->NotNull();
+  b.AddColumn("c_nationkey")->Type(kInt32)->NotNull();
+  b.AddColumn("c_phone")->Type(kString)->NotNull();
+  b.AddColumn("c_acctbal")->Type(kDouble)->NotNull();
+  b.AddColumn("c_mktsegment")->Type(kString)->NotNull();
+  b.AddColumn("c_comment")->Type(kString)->NotNull();
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateOrdersSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  b.AddColumn("o_orderkey")->Type(kInt64)->NotNull()->PrimaryKey();
+  b.AddColumn("o_custkey")->Type(kInt32)->NotNull();
+  b.AddColumn("o_orderstatus")->Type(kString)->NotNull();
+  b.AddColumn("o_totalprice")->Type(kDouble)->NotNull();
+  b.AddColumn("o_orderdate")->Type(kString)->NotNull();
+  b.AddColumn("o_orderpriority")->Type(kString)->NotNull();
+  b.AddColumn("o_clerk")->Type(kString)->NotNull();
+  b.AddColumn("o_shippriority")->Type(kInt32)->NotNull();
+  b.AddColumn("o_comment")->Type(kString)->NotNull();
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateNationSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  b.AddColumn("n_nationkey")->Type(kInt32)->NotNull()->PrimaryKey();
+  b.AddColumn("n_name")->Type(kString)->NotNull();
+  b.AddColumn("n_regionkey")->Type(kInt32)->NotNull();
+  b.AddColumn("n_comment")->Type(kString)->NotNull();
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
+inline client::KuduSchema CreateRegionSchema() {
+  client::KuduSchemaBuilder b;
+  client::KuduSchema s;
+  b.AddColumn("r_regionkey")->Type(kInt32)->NotNull()->PrimaryKey();
+  b.AddColumn("r_name")->Type(kString)->NotNull();
+  b.AddColumn("r_comment")->Type(kString)->NotNull();
+  CHECK_OK(b.Build(&s));
+  return s;
+}
+
 } // namespace tpch
 } // namespace kudu
 #endif
@@ -0,0 +1,646 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// This utility loads the eight TPC-H tables from the files output by dbgen,
+// unless they're already loaded, and then runs the TPC-H queries which can be
+// answered with Kudu scans plus client-side joins and aggregation: Q1, Q3, Q6,
+// Q12 and Q14. The scans push down whatever predicates they can.
+//
+// Each run of a query is timed and reported along with what its scans cost
+// the tablet servers, as returned in the scanners' resource metrics: the
+// bytes, cells and blocks the iterators read, and the block cache hits and
+// misses.
+//
+// Usage:
+//   tpch_queries -tpch_data_dir=/data/tpch-sf1 -tpch_queries=1,6,14
+//                -tpch_num_query_iterations=3
+//
+// dbgen names its output <table>.tbl, e.g. lineitem.tbl.
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/tpch/line_item_tsv_importer.h"
+#include "kudu/benchmarks/tpch/rpc_line_item_dao.h"
+#include "kudu/benchmarks/tpch/tbl_importer.h"
+#include "kudu/benchmarks/tpch/tpch-schemas.h"
+#include "kudu/client/client.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/master/mini_master.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/stopwatch.h"
+
+DEFINE_string(tpch_data_dir, ".",
+              "Directory containing the '|' separated files output by dbgen for the "
+              "tables to load");
+DEFINE_string(tpch_queries, "1,3,6,12,14",
+              "Comma-separated numbers of the TPC-H queries to run");
+DEFINE_int32(tpch_num_query_iterations, 1, "Number of times each query will be run.");
+DEFINE_bool(tpch_use_mini_cluster, true,
+            "Create a mini cluster for the work to be performed against.");
+DEFINE_string(tpch_mini_cluster_base_dir, "/tmp/tpch_queries",
+              "If using a mini cluster, directory for master/ts data.");
+DEFINE_string(tpch_master_address, "localhost",
+              "Address of master for the cluster to operate on");
+DEFINE_int32(tpch_max_batch_size, 1000,
+             "Maximum number of inserts to batch at once");
+DEFINE_string(tpch_table_prefix, "",
+              "Prefix of the names of the tables to write/read");
+
+namespace kudu {
+
+using client::KuduClient;
+using client::KuduClientBuilder;
+using client::KuduError;
+using client::KuduInsert;
+using client::KuduPredicate;
+using client::KuduScanBatch;
+using client::KuduScanner;
+using client::KuduSchema;
+using client::KuduSession;
+using client::KuduTable;
+using client::KuduTableCreator;
+using client::KuduValue;
+using std::map;
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::unordered_set;
+using std::vector;
+using strings::Substitute;
+
+class TpchQueries {
+ public:
+  explicit TpchQueries(string master_address)
+      : master_address_(std::move(master_address)) {
+  }
+
+  Status Init();
+
+  // Loads the tables which are empty from the files in --tpch_data_dir.
+  Status LoadTables();
+
+  // Runs TPC-H query 'query', logging its results and what it cost.
+  Status RunQuery(int query, int iteration);
+
+ private:
+  typedef std::function<void(const KuduScanBatch::RowPtr&)> RowCallback;
+
+  static string TableName(const string& table) {
+    return FLAGS_tpch_table_prefix + table;
+  }
+
+  Status OpenTable(const string& table, client::sp::shared_ptr<KuduTable>* out);
+
+  Status LoadTable(const string& table, const KuduSchema& schema);
+  Status LoadLineItems();
+  Status IsTableEmpty(const string& table, bool* empty);
+
+  // Scans the columns 'columns' of 'table' for the rows matching all of
+  // 'preds', passing each to 'cb'. Takes ownership of 'preds'.
+  Status Scan(KuduTable* table, const vector<string>& columns,
+              const vector<KuduPredicate*>& preds, const RowCallback& cb);
+
+  Status Q1();
+  Status Q3();
+  Status Q6();
+  Status Q12();
+  Status Q14();
+
+  const string master_address_;
+  client::sp::shared_ptr<KuduClient> client_;
+
+  // What the scans of the query being run cost, summed up.
+  map<string, int64_t> metrics_;
+};
+
+Status TpchQueries::Init() {
+  return KuduClientBuilder()
+      .add_master_server_addr(master_address_)
+      .Build(&client_);
+}
+
+Status TpchQueries::OpenTable(const string& table, client::sp::shared_ptr<KuduTable>* out) {
+  return client_->OpenTable(TableName(table), out);
+}
+
+Status TpchQueries::IsTableEmpty(const string& table, bool* empty) {
+  client::sp::shared_ptr<KuduTable> t;
+  RETURN_NOT_OK(OpenTable(table, &t));
+  KuduScanner scanner(t.get());
+  RETURN_NOT_OK(scanner.SetProjectedColumnNames({}));
+  RETURN_NOT_OK(scanner.Open());
+  *empty = !scanner.HasMoreRows();
+  return Status::OK();
+}
+
+Status TpchQueries::LoadTable(const string& table, const KuduSchema& schema) {
+  bool exists;
+  RETURN_NOT_OK(client_->TableExists(TableName(table), &exists));
+  if (!exists) {
+    vector<string> key_columns;
+    vector<int> key_idxs;
+    schema.GetPrimaryKeyColumnIndexes(&key_idxs);
+    for (int idx : key_idxs) {
+      key_columns.push_back(schema.Column(idx).name());
+    }
+    gscoped_ptr<KuduTableCreator> creator(client_->NewTableCreator());
+    KuduSchema s(schema);
+    RETURN_NOT_OK(creator->table_name(TableName(table))
+                  .schema(&s)
+                  .num_replicas(1)
+                  .set_range_partition_columns(key_columns)
+                  .Create());
+  }
+  bool empty;
+  RETURN_NOT_OK(IsTableEmpty(table, &empty));
+  if (!empty) {
+    LOG(INFO) << "Table " << table << " already loaded";
+    return Status::OK();
+  }
+
+  client::sp::shared_ptr<KuduTable> t;
+  RETURN_NOT_OK(OpenTable(table, &t));
+  client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+  RETURN_NOT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  TblImporter importer(JoinPathSegments(FLAGS_tpch_data_dir, table + ".tbl"), schema);
+  int64_t num_rows = 0;
+  LOG_TIMING(INFO, Substitute("loading $0", table)) {
+    while (importer.HasNextLine()) {
+      gscoped_ptr<KuduInsert> insert(t->NewInsert());
+      importer.GetNextLine(insert->mutable_row());
+      RETURN_NOT_OK(session->Apply(insert.release()));
+      if (++num_rows % FLAGS_tpch_max_batch_size == 0 || !importer.HasNextLine()) {
+        Status s = session->Flush();
+        if (!s.ok()) {
+          vector<KuduError*> errors;
+          ElementDeleter d(&errors);
+          bool overflowed;
+          session->GetPendingErrors(&errors, &overflowed);
+          return errors.empty() ? s : errors[0]->status();
+        }
+      }
+    }
+  }
+  LOG(INFO) << "Loaded " << num_rows << " rows into " << table;
+  return Status::OK();
+}
+
+Status TpchQueries::LoadLineItems() {
+  // The DAO creates the table if needed.
+  RpcLineItemDAO dao(master_address_, TableName("lineitem"), FLAGS_tpch_max_batch_size);
+  dao.Init();
+  if (!dao.IsTableEmpty()) {
+    LOG(INFO) << "Table lineitem already loaded";
+    return Status::OK();
+  }
+  LineItemTsvImporter importer(JoinPathSegments(FLAGS_tpch_data_dir, "lineitem.tbl"));
+  LOG_TIMING(INFO, "loading lineitem") {
+    while (importer.HasNextLine()) {
+      dao.WriteLine(boost::bind(&LineItemTsvImporter::GetNextLine, &importer, _1));
+    }
+    dao.FinishWriting();
+  }
+  return Status::OK();
+}
+
+Status TpchQueries::LoadTables() {
+  RETURN_NOT_OK(LoadLineItems());
+  RETURN_NOT_OK(LoadTable("orders", tpch::CreateOrdersSchema()));
+  RETURN_NOT_OK(LoadTable("customer", tpch::CreateCustomerSchema()));
+  RETURN_NOT_OK(LoadTable("part", tpch::CreatePartSchema()));
+  RETURN_NOT_OK(LoadTable("partsupp", tpch::CreatePartSuppSchema()));
+  RETURN_NOT_OK(LoadTable("supplier", tpch::CreateSupplierSchema()));
+  RETURN_NOT_OK(LoadTable("nation", tpch::CreateNationSchema()));
+  return LoadTable("region", tpch::CreateRegionSchema());
+}
+
+Status TpchQueries::Scan(KuduTable* table, const vector<string>& columns,
+                         const vector<KuduPredicate*>& preds, const RowCallback& cb) {
+  KuduScanner scanner(table);
+  for (KuduPredicate* pred : preds) {
+    // The scanner takes ownership of each predicate, even if it fails.
+    RETURN_NOT_OK(scanner.AddConjunctPredicate(pred));
+  }
+  RETURN_NOT_OK(scanner.SetProjectedColumnNames(columns));
+  RETURN_NOT_OK(scanner.Open());
+  KuduScanBatch batch;
+  int64_t num_rows = 0;
+  while (scanner.HasMoreRows()) {
+    RETURN_NOT_OK(scanner.NextBatch(&batch));
+    for (int i = 0; i < batch.NumRows(); i++) {
+      cb(batch.Row(i));
+    }
+    num_rows += batch.NumRows();
+  }
+  metrics_["rows_returned"] += num_rows;
+  for (const auto& entry : scanner.GetResourceMetrics().Get()) {
+    metrics_[entry.first] += entry.second;
+  }
+  return Status::OK();
+}
+
+// Q1: pricing summary report.
+//
+// select l_returnflag, l_linestatus, sum(l_quantity), sum(l_extendedprice),
+//   sum(l_extendedprice * (1 - l_discount)),
+//   sum(l_extendedprice * (1 - l_discount) * (1 + l_tax)),
+//   avg(l_quantity), avg(l_extendedprice), avg(l_discount), count(*)
+// from lineitem
+// where l_shipdate <= '1998-09-02'
+// group by l_returnflag, l_linestatus
+// order by l_returnflag, l_linestatus
+Status TpchQueries::Q1() {
+  struct Agg {
+    int64_t sum_qty = 0;
+    double sum_base_price = 0;
+    double sum_disc_price = 0;
+    double sum_charge = 0;
+    double sum_disc = 0;
+    int64_t count = 0;
+  };
+  map<pair<string, string>, Agg> groups;
+
+  client::sp::shared_ptr<KuduTable> lineitem;
+  RETURN_NOT_OK(OpenTable("lineitem", &lineitem));
+  RETURN_NOT_OK(Scan(lineitem.get(),
+                     { "l_returnflag", "l_linestatus", "l_quantity", "l_extendedprice",
+                       "l_discount", "l_tax" },
+                     { lineitem->NewComparisonPredicate("l_shipdate", KuduPredicate::LESS_EQUAL,
+                                                        KuduValue::CopyString("1998-09-02")) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    Slice returnflag, linestatus;
+    int32_t qty;
+    double price, disc, tax;
+    CHECK_OK(row.GetString(0, &returnflag));
+    CHECK_OK(row.GetString(1, &linestatus));
+    CHECK_OK(row.GetInt32(2, &qty));
+    CHECK_OK(row.GetDouble(3, &price));
+    CHECK_OK(row.GetDouble(4, &disc));
+    CHECK_OK(row.GetDouble(5, &tax));
+    Agg& agg = groups[{ returnflag.ToString(), linestatus.ToString() }];
+    agg.sum_qty += qty;
+    agg.sum_base_price += price;
+    agg.sum_disc_price += price * (1 - disc);
+    agg.sum_charge += price * (1 - disc) * (1 + tax);
+    agg.sum_disc += disc;
+    agg.count++;
+  }));
+
+  for (const auto& group : groups) {
+    const Agg& agg = group.second;
+    LOG(INFO) << group.first.first << ", " << group.first.second << ", "
+              << agg.sum_qty << ", "
+              << StringPrintf("%.2f, %.2f, %.2f, ", agg.sum_base_price, agg.sum_disc_price,
+                              agg.sum_charge)
+              << StringPrintf("%.2f, %.2f, %.2f, ", static_cast<double>(agg.sum_qty) / agg.count,
+                              agg.sum_base_price / agg.count, agg.sum_disc / agg.count)
+              << agg.count;
+  }
+  return Status::OK();
+}
+
+// Q3: shipping priority.
+//
+// select l_orderkey, sum(l_extendedprice * (1 - l_discount)) as revenue,
+//   o_orderdate, o_shippriority
+// from customer, orders, lineitem
+// where c_mktsegment = 'BUILDING' and c_custkey = o_custkey
+//   and l_orderkey = o_orderkey and o_orderdate < '1995-03-15'
+//   and l_shipdate > '1995-03-15'
+// group by l_orderkey, o_orderdate, o_shippriority
+// order by revenue desc, o_orderdate
+// limit 10
+Status TpchQueries::Q3() {
+  client::sp::shared_ptr<KuduTable> customer, orders, lineitem;
+  RETURN_NOT_OK(OpenTable("customer", &customer));
+  RETURN_NOT_OK(OpenTable("orders", &orders));
+  RETURN_NOT_OK(OpenTable("lineitem", &lineitem));
+
+  unordered_set<int32_t> customers;
+  RETURN_NOT_OK(Scan(customer.get(), { "c_custkey" },
+                     { customer->NewComparisonPredicate("c_mktsegment", KuduPredicate::EQUAL,
+                                                        KuduValue::CopyString("BUILDING")) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    int32_t custkey;
+    CHECK_OK(row.GetInt32(0, &custkey));
+    customers.insert(custkey);
+  }));
+
+  struct Order {
+    string orderdate;
+    int32_t shippriority;
+    double revenue;
+  };
+  unordered_map<int64_t, Order> selected_orders;
+  RETURN_NOT_OK(Scan(orders.get(), { "o_orderkey", "o_custkey", "o_orderdate", "o_shippriority" },
+                     { orders->NewComparisonPredicate("o_orderdate", KuduPredicate::LESS,
+                                                      KuduValue::CopyString("1995-03-15")) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    int32_t custkey;
+    CHECK_OK(row.GetInt32(1, &custkey));
+    if (!ContainsKey(customers, custkey)) {
+      return;
+    }
+    int64_t orderkey;
+    Slice orderdate;
+    Order order;
+    CHECK_OK(row.GetInt64(0, &orderkey));
+    CHECK_OK(row.GetString(2, &orderdate));
+    CHECK_OK(row.GetInt32(3, &order.shippriority));
+    order.orderdate = orderdate.ToString();
+    order.revenue = 0;
+    selected_orders.emplace(orderkey, std::move(order));
+  }));
+
+  RETURN_NOT_OK(Scan(lineitem.get(), { "l_orderkey", "l_extendedprice", "l_discount" },
+                     { lineitem->NewComparisonPredicate("l_shipdate", KuduPredicate::GREATER,
+                                                        KuduValue::CopyString("1995-03-15")) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    int64_t orderkey;
+    CHECK_OK(row.GetInt64(0, &orderkey));
+    auto it = selected_orders.find(orderkey);
+    if (it == selected_orders.end()) {
+      return;
+    }
+    double price, disc;
+    CHECK_OK(row.GetDouble(1, &price));
+    CHECK_OK(row.GetDouble(2, &disc));
+    it->second.revenue += price * (1 - disc);
+  }));
+
+  vector<pair<int64_t, const Order*>> results;
+  for (const auto& entry : selected_orders) {
+    if (entry.second.revenue > 0) {
+      results.emplace_back(entry.first, &entry.second);
+    }
+  }
+  auto limit = results.begin() + std::min<size_t>(results.size(), 10);
+  std::partial_sort(results.begin(), limit, results.end(),
+                    [](const pair<int64_t, const Order*>& a,
+                       const pair<int64_t, const Order*>& b) {
+    if (a.second->revenue != b.second->revenue) {
+      return a.second->revenue > b.second->revenue;
+    }
+    return a.second->orderdate < b.second->orderdate;
+  });
+  for (auto it = results.begin(); it != limit; ++it) {
+    LOG(INFO) << it->first << ", " << StringPrintf("%.2f", it->second->revenue) << ", "
+              << it->second->orderdate << ", " << it->second->shippriority;
+  }
+  return Status::OK();
+}
+
+// Q6: forecasting revenue change.
+//
+// select sum(l_extendedprice * l_discount) as revenue
+// from lineitem
+// where l_shipdate >= '1994-01-01' and l_shipdate < '1995-01-01'
+//   and l_discount between 0.05 and 0.07 and l_quantity < 24
+Status TpchQueries::Q6() {
+  client::sp::shared_ptr<KuduTable> lineitem;
+  RETURN_NOT_OK(OpenTable("lineitem", &lineitem));
+  double revenue = 0;
+  RETURN_NOT_OK(Scan(lineitem.get(), { "l_extendedprice", "l_discount" },
+                     { lineitem->NewComparisonPredicate("l_shipdate", KuduPredicate::GREATER_EQUAL,
+                                                        KuduValue::CopyString("1994-01-01")),
+                       lineitem->NewComparisonPredicate("l_shipdate", KuduPredicate::LESS,
+                                                        KuduValue::CopyString("1995-01-01")),
+                       lineitem->NewComparisonPredicate("l_discount", KuduPredicate::GREATER_EQUAL,
+                                                        KuduValue::FromDouble(0.05)),
+                       lineitem->NewComparisonPredicate("l_discount", KuduPredicate::LESS_EQUAL,
+                                                        KuduValue::FromDouble(0.07)),
+                       lineitem->NewComparisonPredicate("l_quantity", KuduPredicate::LESS,
+                                                        KuduValue::FromInt(24)) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    double price, disc;
+    CHECK_OK(row.GetDouble(0, &price));
+    CHECK_OK(row.GetDouble(1, &disc));
+    revenue += price * disc;
+  }));
+  LOG(INFO) << StringPrintf("%.2f", revenue);
+  return Status::OK();
+}
+
+// Q12: shipping modes and order priority.
+//
+// select l_shipmode,
+//   sum(case when o_orderpriority = '1-URGENT' or o_orderpriority = '2-HIGH'
+//       then 1 else 0 end) as high_line_count,
+//   sum(case when o_orderpriority <> '1-URGENT' and o_orderpriority <> '2-HIGH'
+//       then 1 else 0 end) as low_line_count
+// from orders, lineitem
+// where o_orderkey = l_orderkey and l_shipmode in ('MAIL', 'SHIP')
+//   and l_commitdate < l_receiptdate and l_shipdate < l_commitdate
+//   and l_receiptdate >= '1994-01-01' and l_receiptdate < '1995-01-01'
+// group by l_shipmode
+// order by l_shipmode
+Status TpchQueries::Q12() {
+  static const char* const kShipModes[] = { "MAIL", "SHIP" };
+  client::sp::shared_ptr<KuduTable> orders, lineitem;
+  RETURN_NOT_OK(OpenTable("orders", &orders));
+  RETURN_NOT_OK(OpenTable("lineitem", &lineitem));
+
+  // The number of matching line items of each order, by ship mode.
+  unordered_map<int64_t, pair<int64_t, int64_t>> counts_by_order;
+  RETURN_NOT_OK(Scan(lineitem.get(),
+                     { "l_orderkey", "l_shipmode", "l_shipdate", "l_commitdate",
+                       "l_receiptdate" },
+                     { lineitem->NewComparisonPredicate("l_receiptdate",
+                                                        KuduPredicate::GREATER_EQUAL,
+                                                        KuduValue::CopyString("1994-01-01")),
+                       lineitem->NewComparisonPredicate("l_receiptdate", KuduPredicate::LESS,
+                                                        KuduValue::CopyString("1995-01-01")) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    Slice shipmode, shipdate, commitdate, receiptdate;
+    CHECK_OK(row.GetString(1, &shipmode));
+    CHECK_OK(row.GetString(2, &shipdate));
+    CHECK_OK(row.GetString(3, &commitdate));
+    CHECK_OK(row.GetString(4, &receiptdate));
+    bool mail = shipmode == kShipModes[0];
+    if ((!mail && shipmode != kShipModes[1]) ||
+        commitdate.compare(receiptdate) >= 0 ||
+        shipdate.compare(commitdate) >= 0) {
+      return;
+    }
+    int64_t orderkey;
+    CHECK_OK(row.GetInt64(0, &orderkey));
+    pair<int64_t, int64_t>& counts = counts_by_order[orderkey];
+    (mail ? counts.first : counts.second)++;
+  }));
+
+  int64_t high[2] = { 0, 0 };
+  int64_t low[2] = { 0, 0 };
+  RETURN_NOT_OK(Scan(orders.get(), { "o_orderkey", "o_orderpriority" }, {},
+                     [&](const KuduScanBatch::RowPtr& row) {
+    int64_t orderkey;
+    CHECK_OK(row.GetInt64(0, &orderkey));
+    auto it = counts_by_order.find(orderkey);
+    if (it == counts_by_order.end()) {
+      return;
+    }
+    Slice priority;
+    CHECK_OK(row.GetString(1, &priority));
+    int64_t* counts = (priority == "1-URGENT" || priority == "2-HIGH") ? high : low;
+    counts[0] += it->second.first;
+    counts[1] += it->second.second;
+  }));
+  for (int i = 0; i < 2; i++) {
+    LOG(INFO) << kShipModes[i] << ", " << high[i] << ", " << low[i];
+  }
+  return Status::OK();
+}
+
+// Q14: promotion effect.
+//
+// select 100.00 * sum(case when p_type like 'PROMO%'
+//                     then l_extendedprice * (1 - l_discount) else 0 end)
+//   / sum(l_extendedprice * (1 - l_discount)) as promo_revenue
+// from lineitem, part
+// where l_partkey = p_partkey
+//   and l_shipdate >= '1995-09-01' and l_shipdate < '1995-10-01'
+Status TpchQueries::Q14() {
+  client::sp::shared_ptr<KuduTable> part, lineitem;
+  RETURN_NOT_OK(OpenTable("part", &part));
+  RETURN_NOT_OK(OpenTable("lineitem", &lineitem));
+
+  // The prefix match is pushed down as a range.
+  unordered_set<int32_t> promo_parts;
+  RETURN_NOT_OK(Scan(part.get(), { "p_partkey" },
+                     { part->NewComparisonPredicate("p_type", KuduPredicate::GREATER_EQUAL,
+                                                    KuduValue::CopyString("PROMO")),
+                       part->NewComparisonPredicate("p_type", KuduPredicate::LESS,
+                                                    KuduValue::CopyString("PROMP")) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    int32_t partkey;
+    CHECK_OK(row.GetInt32(0, &partkey));
+    promo_parts.insert(partkey);
+  }));
+
+  double promo_revenue = 0;
+  double total_revenue = 0;
+  RETURN_NOT_OK(Scan(lineitem.get(), { "l_partkey", "l_extendedprice", "l_discount" },
+                     { lineitem->NewComparisonPredicate("l_shipdate", KuduPredicate::GREATER_EQUAL,
+                                                        KuduValue::CopyString("1995-09-01")),
+                       lineitem->NewComparisonPredicate("l_shipdate", KuduPredicate::LESS,
+                                                        KuduValue::CopyString("1995-10-01")) },
+                     [&](const KuduScanBatch::RowPtr& row) {
+    int32_t partkey;
+    double price, disc;
+    CHECK_OK(row.GetInt32(0, &partkey));
+    CHECK_OK(row.GetDouble(1, &price));
+    CHECK_OK(row.GetDouble(2, &disc));
+    double revenue = price * (1 - disc);
+    total_revenue += revenue;
+    if (ContainsKey(promo_parts, partkey)) {
+      promo_revenue += revenue;
+    }
+  }));
+  LOG(INFO) << StringPrintf("%.2f", total_revenue > 0 ? 100 * promo_revenue / total_revenue : 0);
+  return Status::OK();
+}
+
+Status TpchQueries::RunQuery(int query, int iteration) {
+  metrics_.clear();
+  Stopwatch sw;
+  sw.start();
+  LOG(INFO) << Substitute("Q$0 iteration $1 results:", query, iteration);
+  switch (query) {
+    case 1: RETURN_NOT_OK(Q1()); break;
+    case 3: RETURN_NOT_OK(Q3()); break;
+    case 6: RETURN_NOT_OK(Q6()); break;
+    case 12: RETURN_NOT_OK(Q12()); break;
+    case 14: RETURN_NOT_OK(Q14()); break;
+    default:
+      return Status::NotSupported(Substitute("TPC-H query $0 is not implemented", query));
+  }
+  sw.stop();
+
+  vector<string> metrics;
+  for (const auto& entry : metrics_) {
+    metrics.push_back(Substitute("$0=$1", entry.first, entry.second));
+  }
+  LOG(INFO) << Substitute("Q$0 iteration $1 took $2s: $3", query, iteration,
+                          StringPrintf("%.3f", sw.elapsed().wall_seconds()),
+                          JoinStrings(metrics, " "));
+  return Status::OK();
+}
+
+} // namespace kudu
+
+int main(int argc, char **argv) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  std::vector<int> queries;
+  std::vector<std::string> query_names = strings::Split(FLAGS_tpch_queries, ",",
+                                                        strings::SkipEmpty());
+  for (const std::string& q : query_names) {
+    int query;
+    CHECK(SimpleAtoi(q, &query)) << "Bad query number: " << q;
+    queries.push_back(query);
+  }
+
+  gscoped_ptr<kudu::MiniCluster> cluster;
+  std::string master_address;
+  if (FLAGS_tpch_use_mini_cluster) {
+    kudu::Env* env = kudu::Env::Default();
+    kudu::Status s = env->CreateDir(FLAGS_tpch_mini_cluster_base_dir);
+    CHECK(s.IsAlreadyPresent() || s.ok()) << s.ToString();
+    kudu::MiniClusterOptions options;
+    options.data_root = FLAGS_tpch_mini_cluster_base_dir;
+    cluster.reset(new kudu::MiniCluster(env, options));
+    CHECK_OK(cluster->StartSync());
+    master_address = cluster->mini_master()->bound_rpc_addr_str();
+  } else {
+    master_address = FLAGS_tpch_master_address;
+  }
+
+  kudu::TpchQueries tpch(master_address);
+  CHECK_OK(tpch.Init());
+  CHECK_OK(tpch.LoadTables());
+  for (int query : queries) {
+    for (int i = 0; i < FLAGS_tpch_num_query_iterations; i++) {
+      CHECK_OK(tpch.RunQuery(query, i));
+    }
+  }
+
+  if (cluster) {
+    cluster->Shutdown();
+  }
+  return 0;
+}
@@ -0,0 +1,879 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Benchmarking tool which runs the YCSB core workloads, or a custom mix of
+// the same operations, against a cluster.
+//
+// The tool first loads --ycsb_record_count records into the YCSB table (see
+// ycsb-schema.h), then runs --ycsb_operation_count operations, or as many as
+// fit in --ycsb_runtime_sec, from --ycsb_num_threads threads. Each operation is
+// sent on its own and timed from the client's point of view.
+//
+// Every --ycsb_report_interval_sec, the throughput and latency percentiles of
+// each type of operation over the last interval are printed to stdout as one
+// JSON object per line, followed at the end by the same for the whole run.
+// Latency SLOs given with --ycsb_latency_slos are checked against the whole
+// run, and the tool exits with status 2 if any of them is missed, so that it
+// can gate an upgrade.
+//
+// The workloads are those of YCSB's core package:
+//  - A: 50% reads, 50% updates.
+//  - B: 95% reads, 5% updates.
+//  - C: 100% reads.
+//  - D: 95% reads, 5% inserts; the most recently inserted records are read most.
+//  - E: 95% short scans, 5% inserts.
+//  - F: 50% reads, 50% read-modify-writes.
+//  - custom: the proportions given with the --ycsb_*_proportion flags.
+//
+// Usage:
+//   ycsb -ycsb_workload=A -ycsb_record_count=1000000 -ycsb_runtime_sec=300
+//        -ycsb_use_mini_cluster=false -ycsb_master_addresses=master-1:7051
+//        -ycsb_latency_slos=read:99:5000,update:99:10000
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/benchmarks/ycsb-schema.h"
+#include "kudu/client/client.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/integration-tests/external_mini_cluster.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/env.h"
+#include "kudu/util/flags.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/random.h"
+#include "kudu/util/random_util.h"
+#include "kudu/util/thread.h"
+
+DEFINE_bool(ycsb_use_mini_cluster, true,
+            "Create an external mini cluster for the work to be performed against");
+DEFINE_string(ycsb_mini_cluster_base_dir, "/tmp/ycsb",
+              "If using a mini cluster, directory for master/ts data");
+DEFINE_int32(ycsb_num_tablet_servers, 1,
+             "If using a mini cluster, the number of tablet servers to start");
+DEFINE_string(ycsb_master_addresses, "localhost",
+              "Comma-separated addresses of the masters of the cluster to operate on "
+              "if not using a mini cluster");
+DEFINE_string(ycsb_table_name, "ycsb",
+              "Table name to use during the benchmark");
+DEFINE_int32(ycsb_num_tablets, 8,
+             "Number of hash buckets the table is partitioned into, if it is created");
+DEFINE_int32(ycsb_num_replicas, 1,
+             "Replication factor of the table, if it is created");
+DEFINE_int32(ycsb_client_timeout_msec, 10000,
+             "Timeout that will be used for all operations and RPCs");
+
+DEFINE_string(ycsb_workload, "A",
+              "The workload to run: one of YCSB's core workloads A to F, or 'custom' "
+              "to use the --ycsb_*_proportion flags");
+DEFINE_double(ycsb_read_proportion, 0.5,
+              "For the custom workload, the proportion of operations which read a record");
+DEFINE_double(ycsb_update_proportion, 0.5,
+              "For the custom workload, the proportion of operations which update a record");
+DEFINE_double(ycsb_insert_proportion, 0,
+              "For the custom workload, the proportion of operations which insert a record");
+DEFINE_double(ycsb_scan_proportion, 0,
+              "For the custom workload, the proportion of operations which scan records");
+DEFINE_double(ycsb_read_modify_write_proportion, 0,
+              "For the custom workload, the proportion of operations which read a record "
+              "and then update it");
+DEFINE_string(ycsb_request_distribution, "",
+              "How the records operated on are chosen: 'zipfian', 'uniform' or 'latest'. "
+              "Defaults to that of the workload.");
+DEFINE_double(ycsb_zipfian_constant, 0.99,
+              "The skew of the zipfian and latest request distributions");
+
+DEFINE_bool(ycsb_load, true,
+            "Whether to load the records before running the operations. Disable it "
+            "to run against a table loaded by an earlier run.");
+DEFINE_int64(ycsb_record_count, 100000,
+             "Number of records loaded, and over which the operations are spread");
+DEFINE_int64(ycsb_operation_count, 0,
+             "Number of operations to run. 0 runs them for --ycsb_runtime_sec only.");
+DEFINE_int32(ycsb_runtime_sec, 60,
+             "Longest time the operations run for. 0 runs --ycsb_operation_count of them.");
+DEFINE_int32(ycsb_num_threads, 16,
+             "Number of client threads running operations concurrently");
+DEFINE_int32(ycsb_field_length, 100,
+             "Length of each of the values written to the fields of a record");
+DEFINE_int32(ycsb_max_scan_length, 100,
+             "Maximum number of records read by a scan. The length of each is uniform "
+             "between 1 and this.");
+DEFINE_int32(ycsb_load_batch_size, 1000,
+             "Number of records inserted per batch while loading");
+
+DEFINE_int32(ycsb_report_interval_sec, 10,
+             "How often the statistics of the last interval are printed");
+DEFINE_string(ycsb_latency_slos, "",
+              "Comma-separated latency SLOs checked at the end of the run, each as "
+              "<operation>:<percentile>:<max latency in microseconds>, e.g. "
+              "'read:99:5000,update:99.9:20000'. The operations are read, update, insert, "
+              "scan and read_modify_write.");
+
+namespace kudu {
+
+using client::KuduClient;
+using client::KuduClientBuilder;
+using client::KuduError;
+using client::KuduInsert;
+using client::KuduPredicate;
+using client::KuduScanBatch;
+using client::KuduScanner;
+using client::KuduSchema;
+using client::KuduSession;
+using client::KuduTable;
+using client::KuduTableCreator;
+using client::KuduUpdate;
+using client::KuduValue;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace {
+
+enum OpType {
+  kRead,
+  kUpdate,
+  kInsert,
+  kScan,
+  kReadModifyWrite,
+  kNumOpTypes
+};
+
+const char* const kOpTypeNames[kNumOpTypes] = {
+  "read", "update", "insert", "scan", "read_modify_write"
+};
+
+const int kNumFields = 10;
+
+// Latencies above a minute are recorded as a minute.
+const uint64_t kMaxLatencyUs = 60 * 1000 * 1000;
+
+// The FNV-1a hash of 'val', which YCSB uses both to scatter the keys of
+// consecutive records and to scramble the zipfian distribution.
+uint64_t FnvHash64(uint64_t val) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= val & 0xff;
+    hash *= 0x100000001b3ULL;
+    val >>= 8;
+  }
+  return hash;
+}
+
+// The key of the 'n'th record, as YCSB names them.
+string RecordKey(uint64_t n) {
+  return "user" + SimpleItoa(FnvHash64(n));
+}
+
+// Picks integers in [0, n) following a zipfian distribution, 0 being the most
+// frequent, as described in "Quickly Generating Billion-Record Synthetic
+// Databases" by Gray et al. 'n' may grow as records are inserted, in which
+// case the normalization constant is extended incrementally.
+//
+// Not thread-safe: each thread should have its own copy.
+class ZipfianGenerator {
+ public:
+  ZipfianGenerator(uint64_t n, double theta)
+      : theta_(theta),
+        alpha_(1.0 / (1.0 - theta)),
+        zeta2_(Zeta(0, 2, 0)),
+        n_(0),
+        zetan_(0) {
+    Grow(n);
+  }
+
+  uint64_t Next(Random* rng, uint64_t n) {
+    if (n > n_) {
+      Grow(n);
+    }
+    double u = rng->NextDoubleFraction();
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + pow(0.5, theta_)) {
+      return 1;
+    }
+    uint64_t ret = n_ * pow(eta_ * u - eta_ + 1, alpha_);
+    return std::min(ret, n_ - 1);
+  }
+
+ private:
+  // Returns the sum of 1/i^theta for i in (from, to], added to 'initial'.
+  double Zeta(uint64_t from, uint64_t to, double initial) const {
+    double sum = initial;
+    for (uint64_t i = from + 1; i <= to; i++) {
+      sum += 1.0 / pow(i, theta_);
+    }
+    return sum;
+  }
+
+  void Grow(uint64_t n) {
+    zetan_ = Zeta(n_, n, zetan_);
+    n_ = n;
+    eta_ = (1 - pow(2.0 / n_, 1 - theta_)) / (1 - zeta2_ / zetan_);
+  }
+
+  const double theta_;
+  const double alpha_;
+  const double zeta2_;
+  uint64_t n_;
+  double zetan_;
+  double eta_;
+};
+
+// The latencies and errors of the operations run over some period of time.
+// Thread-safe.
+struct Stats {
+  Stats() {
+    for (int i = 0; i < kNumOpTypes; i++) {
+      latencies[i].reset(new HdrHistogram(kMaxLatencyUs, 3));
+      errors[i] = 0;
+      not_found[i] = 0;
+    }
+  }
+
+  void MergeFrom(const Stats& other) {
+    for (int i = 0; i < kNumOpTypes; i++) {
+      latencies[i]->MergeFrom(*other.latencies[i]);
+      errors[i] += other.errors[i];
+      not_found[i] += other.not_found[i];
+    }
+  }
+
+  gscoped_ptr<HdrHistogram> latencies[kNumOpTypes];
+  std::atomic<int64_t> errors[kNumOpTypes];
+  // Reads and read-modify-writes of records which were not found, e.g.
+  // because their insert hadn't completed yet.
+  std::atomic<int64_t> not_found[kNumOpTypes];
+};
+
+struct LatencySlo {
+  OpType op;
+  double percentile;
+  uint64_t max_latency_us;
+};
+
+Status ParseOpType(const string& name, OpType* op) {
+  for (int i = 0; i < kNumOpTypes; i++) {
+    if (name == kOpTypeNames[i]) {
+      *op = static_cast<OpType>(i);
+      return Status::OK();
+    }
+  }
+  return Status::InvalidArgument("unknown operation", name);
+}
+
+Status ParseLatencySlos(const string& flag, vector<LatencySlo>* slos) {
+  vector<string> specs = strings::Split(flag, ",", strings::SkipEmpty());
+  for (const string& spec : specs) {
+    vector<string> parts = strings::Split(spec, ":");
+    LatencySlo slo;
+    uint64 max_latency_us;
+    if (parts.size() != 3 ||
+        !ParseOpType(parts[0], &slo.op).ok() ||
+        !safe_strtod(parts[1], &slo.percentile) ||
+        slo.percentile <= 0 || slo.percentile > 100 ||
+        !safe_strtou64(parts[2], &max_latency_us)) {
+      return Status::InvalidArgument("invalid latency SLO", spec);
+    }
+    slo.max_latency_us = max_latency_us;
+    slos->push_back(slo);
+  }
+  return Status::OK();
+}
+
+void WriteOpStats(const Stats& stats, double elapsed_sec, JsonWriter* jw) {
+  jw->StartObject();
+  for (int i = 0; i < kNumOpTypes; i++) {
+    const HdrHistogram& hist = *stats.latencies[i];
+    int64_t errors = stats.errors[i];
+    if (hist.TotalCount() == 0 && errors == 0) {
+      continue;
+    }
+    jw->String(kOpTypeNames[i]);
+    jw->StartObject();
+    jw->String("count");
+    jw->Uint64(hist.TotalCount());
+    jw->String("ops_per_sec");
+    jw->Double(hist.TotalCount() / elapsed_sec);
+    jw->String("errors");
+    jw->Int64(errors);
+    jw->String("not_found");
+    jw->Int64(stats.not_found[i]);
+    if (hist.TotalCount() > 0) {
+      jw->String("mean_us");
+      jw->Double(hist.MeanValue());
+      for (double p : { 50.0, 95.0, 99.0, 99.9 }) {
+        jw->String(Substitute("p$0_us", p));
+        jw->Uint64(hist.ValueAtPercentile(p));
+      }
+      jw->String("max_us");
+      jw->Uint64(hist.MaxValue());
+    }
+    jw->EndObject();
+  }
+  jw->EndObject();
+}
+
+} // anonymous namespace
+
+class YcsbBenchmark {
+ public:
+  YcsbBenchmark()
+    : ops_started_(0),
+      next_insert_(0),
+      stop_threads_(false),
+      window_(new Stats),
+      window_start_(MonoTime::Now(MonoTime::FINE)) {
+  }
+
+  Status Init();
+
+  Status Run();
+
+ private:
+  // Sets 'proportions_' and 'distribution_' from the flags.
+  Status InitWorkload();
+
+  Status CreateTableIfNeeded();
+
+  // Inserts this thread's share of the records, setting 'status' to the
+  // outcome.
+  void LoadThread(int thread_idx, Status* status);
+  Status LoadRecords(int thread_idx);
+  void RunThread(int thread_idx);
+  void ReportThread();
+
+  // Runs a single operation of type 'op' on a record chosen by 'keys'.
+  Status RunOp(OpType op, KuduSession* session, Random* rng, ZipfianGenerator* keys,
+               bool* found);
+
+  // Returns the number of the record the next operation runs on.
+  uint64_t NextRecord(Random* rng, ZipfianGenerator* keys);
+
+  Status Read(const string& key, bool* found);
+  Status Scan(const string& start_key, int num_rows);
+  Status Insert(KuduSession* session, uint64_t record, Random* rng);
+  Status Update(KuduSession* session, const string& key, Random* rng);
+
+  Status SetRandomField(KuduPartialRow* row, int field, Random* rng) {
+    string value(FLAGS_ycsb_field_length, '\0');
+    for (char& c : value) {
+      c = ' ' + rng->Uniform(95);
+    }
+    return row->SetStringCopy(Substitute("field$0", field), value);
+  }
+
+  // Prints the statistics gathered since the last call and starts anew.
+  void ReportWindow();
+
+  // Prints the statistics of the whole run and checks the SLOs against them.
+  // Returns whether they were all met.
+  bool ReportSummary(double elapsed_sec);
+
+  Status CheckSessionErrors(KuduSession* session, const Status& s);
+
+  std::shared_ptr<Stats> CurrentWindow() {
+    std::lock_guard<simple_spinlock> l(window_lock_);
+    return window_;
+  }
+
+  gscoped_ptr<ExternalMiniCluster> cluster_;
+  client::sp::shared_ptr<KuduClient> client_;
+  client::sp::shared_ptr<KuduTable> table_;
+
+  double proportions_[kNumOpTypes];
+  string distribution_;
+  vector<LatencySlo> slos_;
+
+  // The number of operations handed out to the threads so far.
+  AtomicInt<int64_t> ops_started_;
+
+  // The number of the next record to insert. The records below it have been,
+  // or are being, inserted.
+  AtomicInt<int64_t> next_insert_;
+
+  AtomicBool stop_threads_;
+
+  // The statistics of the current reporting interval, swapped out by the
+  // reporting thread, and those of the whole run.
+  simple_spinlock window_lock_;
+  std::shared_ptr<Stats> window_;
+  MonoTime window_start_;
+  Stats total_;
+};
+
+Status YcsbBenchmark::InitWorkload() {
+  const string& w = FLAGS_ycsb_workload;
+  std::fill(proportions_, proportions_ + kNumOpTypes, 0);
+  distribution_ = "zipfian";
+  if (w == "A" || w == "a") {
+    proportions_[kRead] = 0.5;
+    proportions_[kUpdate] = 0.5;
+  } else if (w == "B" || w == "b") {
+    proportions_[kRead] = 0.95;
+    proportions_[kUpdate] = 0.05;
+  } else if (w == "C" || w == "c") {
+    proportions_[kRead] = 1;
+  } else if (w == "D" || w == "d") {
+    proportions_[kRead] = 0.95;
+    proportions_[kInsert] = 0.05;
+    distribution_ = "latest";
+  } else if (w == "E" || w == "e") {
+    proportions_[kScan] = 0.95;
+    proportions_[kInsert] = 0.05;
+  } else if (w == "F" || w == "f") {
+    proportions_[kRead] = 0.5;
+    proportions_[kReadModifyWrite] = 0.5;
+  } else if (w == "custom") {
+    proportions_[kRead] = FLAGS_ycsb_read_proportion;
+    proportions_[kUpdate] = FLAGS_ycsb_update_proportion;
+    proportions_[kInsert] = FLAGS_ycsb_insert_proportion;
+    proportions_[kScan] = FLAGS_ycsb_scan_proportion;
+    proportions_[kReadModifyWrite] = FLAGS_ycsb_read_modify_write_proportion;
+  } else {
+    return Status::InvalidArgument("unknown workload", w);
+  }
+  if (!FLAGS_ycsb_request_distribution.empty()) {
+    distribution_ = FLAGS_ycsb_request_distribution;
+  }
+  if (distribution_ != "zipfian" && distribution_ != "uniform" && distribution_ != "latest") {
+    return Status::InvalidArgument("unknown request distribution", distribution_);
+  }
+
+  double sum = 0;
+  for (double p : proportions_) {
+    if (p < 0) {
+      return Status::InvalidArgument("operation proportions must not be negative");
+    }
+    sum += p;
+  }
+  if (sum <= 0) {
+    return Status::InvalidArgument("no operations to run");
+  }
+  for (double& p : proportions_) {
+    p /= sum;
+  }
+  if (FLAGS_ycsb_record_count <= 0) {
+    return Status::InvalidArgument("--ycsb_record_count must be positive");
+  }
+  if (FLAGS_ycsb_operation_count <= 0 && FLAGS_ycsb_runtime_sec <= 0) {
+    return Status::InvalidArgument(
+        "one of --ycsb_operation_count and --ycsb_runtime_sec must be set");
+  }
+  return ParseLatencySlos(FLAGS_ycsb_latency_slos, &slos_);
+}
+
+Status YcsbBenchmark::Init() {
+  RETURN_NOT_OK(InitWorkload());
+
+  KuduClientBuilder builder;
+  builder.default_admin_operation_timeout(
+      MonoDelta::FromMilliseconds(FLAGS_ycsb_client_timeout_msec));
+  builder.default_rpc_timeout(MonoDelta::FromMilliseconds(FLAGS_ycsb_client_timeout_msec));
+  if (FLAGS_ycsb_use_mini_cluster) {
+    Env* env = Env::Default();
+    if (env->FileExists(FLAGS_ycsb_mini_cluster_base_dir)) {
+      RETURN_NOT_OK(env->DeleteRecursively(FLAGS_ycsb_mini_cluster_base_dir));
+    }
+    RETURN_NOT_OK(env->CreateDir(FLAGS_ycsb_mini_cluster_base_dir));
+
+    ExternalMiniClusterOptions opts;
+    opts.num_tablet_servers = FLAGS_ycsb_num_tablet_servers;
+    opts.data_root = FLAGS_ycsb_mini_cluster_base_dir;
+    cluster_.reset(new ExternalMiniCluster(opts));
+    RETURN_NOT_OK(cluster_->Start());
+    RETURN_NOT_OK(cluster_->CreateClient(builder, &client_));
+  } else {
+    vector<string> master_addrs = strings::Split(FLAGS_ycsb_master_addresses, ",",
+                                                 strings::SkipEmpty());
+    builder.master_server_addrs(master_addrs);
+    RETURN_NOT_OK(builder.Build(&client_));
+  }
+
+  RETURN_NOT_OK(CreateTableIfNeeded());
+  RETURN_NOT_OK(client_->OpenTable(FLAGS_ycsb_table_name, &table_));
+  next_insert_.Store(FLAGS_ycsb_record_count);
+  return Status::OK();
+}
+
+Status YcsbBenchmark::CreateTableIfNeeded() {
+  bool exists;
+  RETURN_NOT_OK(client_->TableExists(FLAGS_ycsb_table_name, &exists));
+  if (exists) {
+    return Status::OK();
+  }
+  if (!FLAGS_ycsb_load) {
+    return Status::NotFound("table doesn't exist and --ycsb_load is disabled",
+                            FLAGS_ycsb_table_name);
+  }
+  KuduSchema schema(CreateYCSBSchema());
+  gscoped_ptr<KuduTableCreator> creator(client_->NewTableCreator());
+  return creator->table_name(FLAGS_ycsb_table_name)
+      .schema(&schema)
+      .add_hash_partitions({ "key" }, FLAGS_ycsb_num_tablets)
+      .num_replicas(FLAGS_ycsb_num_replicas)
+      .Create();
+}
+
+Status YcsbBenchmark::CheckSessionErrors(KuduSession* session, const Status& s) {
+  if (s.ok()) {
+    return s;
+  }
+  vector<KuduError*> errors;
+  ElementDeleter d(&errors);
+  bool overflowed;
+  session->GetPendingErrors(&errors, &overflowed);
+  if (!errors.empty()) {
+    return errors[0]->status();
+  }
+  return s;
+}
+
+void YcsbBenchmark::LoadThread(int thread_idx, Status* status) {
+  *status = LoadRecords(thread_idx);
+}
+
+Status YcsbBenchmark::LoadRecords(int thread_idx) {
+  client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+  RETURN_NOT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+  session->SetTimeoutMillis(FLAGS_ycsb_client_timeout_msec);
+  Random rng(thread_idx);
+  int pending = 0;
+  for (int64_t record = thread_idx; record < FLAGS_ycsb_record_count;
+       record += FLAGS_ycsb_num_threads) {
+    RETURN_NOT_OK(Insert(session.get(), record, &rng));
+    if (++pending == FLAGS_ycsb_load_batch_size) {
+      RETURN_NOT_OK(CheckSessionErrors(session.get(), session->Flush()));
+      pending = 0;
+    }
+  }
+  return CheckSessionErrors(session.get(), session->Flush());
+}
+
+uint64_t YcsbBenchmark::NextRecord(Random* rng, ZipfianGenerator* keys) {
+  uint64_t num_records = next_insert_.Load();
+  if (distribution_ == "uniform") {
+    return rng->Uniform64(num_records);
+  }
+  uint64_t n = keys->Next(rng, num_records);
+  if (distribution_ == "latest") {
+    return num_records - 1 - n;
+  }
+  // Scramble the zipfian distribution so that the popular records are spread
+  // over the key space, rather than clustered on the first records.
+  return FnvHash64(n) % num_records;
+}
+
+Status YcsbBenchmark::Read(const string& key, bool* found) {
+  KuduScanner scanner(table_.get());
+  RETURN_NOT_OK(scanner.SetTimeoutMillis(FLAGS_ycsb_client_timeout_msec));
+  RETURN_NOT_OK(scanner.AddConjunctPredicate(table_->NewComparisonPredicate(
+      "key", KuduPredicate::EQUAL, KuduValue::CopyString(key))));
+  RETURN_NOT_OK(scanner.Open());
+  int num_rows = 0;
+  KuduScanBatch batch;
+  while (scanner.HasMoreRows()) {
+    RETURN_NOT_OK(scanner.NextBatch(&batch));
+    num_rows += batch.NumRows();
+  }
+  *found = num_rows > 0;
+  return Status::OK();
+}
+
+Status YcsbBenchmark::Scan(const string& start_key, int num_rows) {
+  KuduScanner scanner(table_.get());
+  RETURN_NOT_OK(scanner.SetTimeoutMillis(FLAGS_ycsb_client_timeout_msec));
+  gscoped_ptr<KuduPartialRow> lower_bound(table_->schema().NewRow());
+  RETURN_NOT_OK(lower_bound->SetStringCopy("key", start_key));
+  RETURN_NOT_OK(scanner.AddLowerBound(*lower_bound));
+  RETURN_NOT_OK(scanner.Open());
+  int rows_read = 0;
+  KuduScanBatch batch;
+  while (rows_read < num_rows && scanner.HasMoreRows()) {
+    RETURN_NOT_OK(scanner.NextBatch(&batch));
+    rows_read += batch.NumRows();
+  }
+  return Status::OK();
+}
+
+Status YcsbBenchmark::Insert(KuduSession* session, uint64_t record, Random* rng) {
+  gscoped_ptr<KuduInsert> insert(table_->NewInsert());
+  KuduPartialRow* row = insert->mutable_row();
+  RETURN_NOT_OK(row->SetStringCopy("key", RecordKey(record)));
+  for (int i = 0; i < kNumFields; i++) {
+    RETURN_NOT_OK(SetRandomField(row, i, rng));
+  }
+  return CheckSessionErrors(session, session->Apply(insert.release()));
+}
+
+Status YcsbBenchmark::Update(KuduSession* session, const string& key, Random* rng) {
+  // Like YCSB by default, only one of the fields is written.
+  gscoped_ptr<KuduUpdate> update(table_->NewUpdate());
+  KuduPartialRow* row = update->mutable_row();
+  RETURN_NOT_OK(row->SetStringCopy("key", key));
+  RETURN_NOT_OK(SetRandomField(row, rng->Uniform(kNumFields), rng));
+  return CheckSessionErrors(session, session->Apply(update.release()));
+}
+
+Status YcsbBenchmark::RunOp(OpType op, KuduSession* session, Random* rng,
+                            ZipfianGenerator* keys, bool* found) {
+  *found = true;
+  switch (op) {
+    case kRead:
+      return Read(RecordKey(NextRecord(rng, keys)), found);
+    case kUpdate:
+      return Update(session, RecordKey(NextRecord(rng, keys)), rng);
+    case kInsert:
+      return Insert(session, next_insert_.Increment() - 1, rng);
+    case kScan:
+      return Scan(RecordKey(NextRecord(rng, keys)), 1 + rng->Uniform(FLAGS_ycsb_max_scan_length));
+    case kReadModifyWrite: {
+      string key = RecordKey(NextRecord(rng, keys));
+      RETURN_NOT_OK(Read(key, found));
+      if (!*found) {
+        return Status::OK();
+      }
+      return Update(session, key, rng);
+    }
+    default:
+      LOG(FATAL) << "unexpected operation type " << op;
+  }
+  return Status::OK();
+}
+
+void YcsbBenchmark::RunThread(int thread_idx) {
+  client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+  CHECK_OK(session->SetFlushMode(KuduSession::AUTO_FLUSH_SYNC));
+  session->SetTimeoutMillis(FLAGS_ycsb_client_timeout_msec);
+  Random rng(GetRandomSeed32() + thread_idx);
+  ZipfianGenerator keys(next_insert_.Load(), FLAGS_ycsb_zipfian_constant);
+
+  while (!stop_threads_.Load()) {
+    if (FLAGS_ycsb_operation_count > 0 &&
+        ops_started_.Increment() > FLAGS_ycsb_operation_count) {
+      return;
+    }
+    double r = rng.NextDoubleFraction();
+    int op = 0;
+    while (op < kNumOpTypes - 1 && r >= proportions_[op]) {
+      r -= proportions_[op];
+      op++;
+    }
+
+    bool found;
+    MonoTime start = MonoTime::Now(MonoTime::FINE);
+    Status s = RunOp(static_cast<OpType>(op), session.get(), &rng, &keys, &found);
+    int64_t latency_us = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start).ToMicroseconds();
+
+    std::shared_ptr<Stats> stats = CurrentWindow();
+    if (PREDICT_FALSE(!s.ok())) {
+      KLOG_EVERY_N(WARNING, 1000) << kOpTypeNames[op] << " failed: " << s.ToString();
+      stats->errors[op]++;
+      continue;
+    }
+    if (!found) {
+      stats->not_found[op]++;
+    }
+    stats->latencies[op]->Increment(std::min<uint64_t>(latency_us, kMaxLatencyUs));
+  }
+}
+
+void YcsbBenchmark::ReportWindow() {
+  std::shared_ptr<Stats> stats(new Stats);
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  MonoTime start;
+  {
+    std::lock_guard<simple_spinlock> l(window_lock_);
+    stats.swap(window_);
+    start = window_start_;
+    window_start_ = now;
+  }
+  // Threads may still be recording into the old window; they're done with it
+  // by the time they finish their current operation, which is close enough.
+  total_.MergeFrom(*stats);
+
+  std::stringstream out;
+  JsonWriter jw(&out, JsonWriter::COMPACT);
+  jw.StartObject();
+  jw.String("time");
+  jw.Double(WallTime_Now());
+  jw.String("interval_sec");
+  double elapsed_sec = now.GetDeltaSince(start).ToSeconds();
+  jw.Double(elapsed_sec);
+  jw.String("ops");
+  WriteOpStats(*stats, elapsed_sec, &jw);
+  jw.EndObject();
+  std::cout << out.str() << std::endl;
+}
+
+bool YcsbBenchmark::ReportSummary(double elapsed_sec) {
+  std::stringstream out;
+  JsonWriter jw(&out, JsonWriter::COMPACT);
+  jw.StartObject();
+  jw.String("summary");
+  jw.Bool(true);
+  jw.String("workload");
+  jw.String(FLAGS_ycsb_workload);
+  jw.String("request_distribution");
+  jw.String(distribution_);
+  jw.String("runtime_sec");
+  jw.Double(elapsed_sec);
+  jw.String("ops");
+  WriteOpStats(total_, elapsed_sec, &jw);
+
+  bool all_met = true;
+  jw.String("slos");
+  jw.StartArray();
+  for (const LatencySlo& slo : slos_) {
+    const HdrHistogram& hist = *total_.latencies[slo.op];
+    uint64_t actual_us = hist.TotalCount() > 0 ? hist.ValueAtPercentile(slo.percentile) : 0;
+    bool met = actual_us <= slo.max_latency_us;
+    all_met &= met;
+    jw.StartObject();
+    jw.String("op");
+    jw.String(kOpTypeNames[slo.op]);
+    jw.String("percentile");
+    jw.Double(slo.percentile);
+    jw.String("max_latency_us");
+    jw.Uint64(slo.max_latency_us);
+    jw.String("actual_us");
+    jw.Uint64(actual_us);
+    jw.String("met");
+    jw.Bool(met);
+    jw.EndObject();
+  }
+  jw.EndArray();
+  jw.EndObject();
+  std::cout << out.str() << std::endl;
+  return all_met;
+}
+
+void YcsbBenchmark::ReportThread() {
+  while (!stop_threads_.Load()) {
+    SleepFor(MonoDelta::FromSeconds(FLAGS_ycsb_report_interval_sec));
+    ReportWindow();
+  }
+}
+
+Status YcsbBenchmark::Run() {
+  if (FLAGS_ycsb_load) {
+    LOG_TIMING(INFO, Substitute("loading $0 records", FLAGS_ycsb_record_count)) {
+      vector<scoped_refptr<Thread> > threads;
+      vector<Status> statuses(FLAGS_ycsb_num_threads);
+      for (int i = 0; i < FLAGS_ycsb_num_threads; i++) {
+        scoped_refptr<Thread> thr;
+        RETURN_NOT_OK(Thread::Create("ycsb", Substitute("load-$0", i),
+                                     &YcsbBenchmark::LoadThread, this, i, &statuses[i],
+                                     &thr));
+        threads.push_back(thr);
+      }
+      for (const scoped_refptr<Thread>& thr : threads) {
+        RETURN_NOT_OK(ThreadJoiner(thr.get()).Join());
+      }
+      for (const Status& s : statuses) {
+        RETURN_NOT_OK_PREPEND(s, "couldn't load the records");
+      }
+    }
+  }
+
+  {
+    std::lock_guard<simple_spinlock> l(window_lock_);
+    window_start_ = MonoTime::Now(MonoTime::FINE);
+  }
+  MonoTime start = MonoTime::Now(MonoTime::FINE);
+  vector<scoped_refptr<Thread> > threads;
+  for (int i = 0; i < FLAGS_ycsb_num_threads; i++) {
+    scoped_refptr<Thread> thr;
+    RETURN_NOT_OK(Thread::Create("ycsb", Substitute("run-$0", i),
+                                 &YcsbBenchmark::RunThread, this, i, &thr));
+    threads.push_back(thr);
+  }
+  scoped_refptr<Thread> reporter;
+  RETURN_NOT_OK(Thread::Create("ycsb", "report", &YcsbBenchmark::ReportThread, this,
+                               &reporter));
+
+  if (FLAGS_ycsb_runtime_sec > 0) {
+    MonoTime deadline = start;
+    deadline.AddDelta(MonoDelta::FromSeconds(FLAGS_ycsb_runtime_sec));
+    while (MonoTime::Now(MonoTime::FINE).ComesBefore(deadline) &&
+           (FLAGS_ycsb_operation_count <= 0 ||
+            ops_started_.Load() < FLAGS_ycsb_operation_count)) {
+      SleepFor(MonoDelta::FromMilliseconds(100));
+    }
+    stop_threads_.Store(true);
+  }
+  for (const scoped_refptr<Thread>& thr : threads) {
+    RETURN_NOT_OK(ThreadJoiner(thr.get()).Join());
+  }
+  double elapsed_sec = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start).ToSeconds();
+  stop_threads_.Store(true);
+  RETURN_NOT_OK(ThreadJoiner(reporter.get()).Join());
+
+  // Account for whatever was run since the last report.
+  ReportWindow();
+  if (!ReportSummary(elapsed_sec)) {
+    return Status::IllegalState("latency SLOs missed");
+  }
+  return Status::OK();
+}
+
+} // namespace kudu
+
+int main(int argc, char* argv[]) {
+  kudu::ParseCommandLineFlags(&argc, &argv, true);
+  kudu::InitGoogleLoggingSafe(argv[0]);
+
+  kudu::YcsbBenchmark benchmark;
+  kudu::Status s = benchmark.Init();
+  if (!s.ok()) {
+    std::cerr << "Couldn't initialize the benchmarking tool, reason: " << s.ToString() << std::endl;
+    return 1;
+  }
+  s = benchmark.Run();
+  if (s.IsIllegalState()) {
+    std::cerr << "The run " << s.ToString() << std::endl;
+    return 2;
+  }
+  if (!s.ok()) {
+    std::cerr << "Couldn't run the benchmarking tool, reason: " << s.ToString() << std::endl;
+    return 1;
+  }
+  return 0;
+}
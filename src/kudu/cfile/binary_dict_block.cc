@@ -24,7 +24,9 @@
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/bshuf_block.h"
+#include "kudu/common/column_materialization_context.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/util/coding.h"
@@ -54,6 +56,9 @@ void BinaryDictBlockBuilder::Reset() {
       dict_block_.IsBlockFull(options_->storage_attributes.cfile_block_size)) {
     mode_ = kPlainBinaryMode;
     data_builder_.reset(new BinaryPlainBlockBuilder(options_));
+    VLOG(1) << "Dictionary block is full with " << dict_block_.Count() << " entries after "
+            << stats_.num_code_word_blocks() << " data blocks; "
+            << "falling back to plain encoding";
   } else {
     data_builder_->Reset();
   }
@@ -65,6 +70,12 @@ Slice BinaryDictBlockBuilder::Finish(rowid_t ordinal_pos) {
   finished_ = true;
 
   InlineEncodeFixed32(&buffer_[0], mode_);
+  if (mode_ == kCodeWordMode) {
+    stats_.set_num_code_word_blocks(stats_.num_code_word_blocks() + 1);
+  } else {
+    stats_.set_num_plain_blocks(stats_.num_plain_blocks() + 1);
+    stats_.set_num_plain_values(stats_.num_plain_values() + data_builder_->Count());
+  }
 
   // TODO: if we could modify the the Finish() API a little bit, we can
   // avoid an extra memory copy (buffer_.append(..))
@@ -150,6 +161,10 @@ Status BinaryDictBlockBuilder::AppendExtraInfo(CFileWriter* c_writer, CFileFoote
     return s;
   }
   ptr.CopyToPB(footer->mutable_dict_block_ptr());
+
+  stats_.set_num_dict_entries(dict_block_.Count());
+  stats_.set_dict_block_size(dict_slice.size());
+  footer->mutable_dict_stats()->CopyFrom(stats_);
   return Status::OK();
 }
 
@@ -187,7 +202,8 @@ Status BinaryDictBlockBuilder::GetLastKey(void* key_void) const {
 
 BinaryDictBlockDecoder::BinaryDictBlockDecoder(Slice slice, CFileIterator* iter)
     : data_(std::move(slice)),
-      parsed_(false) {
+      parsed_(false),
+      iter_(iter) {
   dict_decoder_ = iter->GetDictDecoder();
 }
 
@@ -281,5 +297,50 @@ Status BinaryDictBlockDecoder::CopyNextValues(size_t* n, ColumnDataView* dst) {
   }
 }
 
+Status BinaryDictBlockDecoder::CopyNextAndEval(size_t* n,
+                                               ColumnMaterializationContext* ctx,
+                                               SelectionVectorView* sel,
+                                               ColumnDataView* dst) {
+  if (mode_ != kCodeWordMode) {
+    // Blocks which fell back to plain encoding have no code words to test.
+    DCHECK_EQ(mode_, kPlainBinaryMode);
+    ctx->SetDecoderEvalNotSupported();
+    return data_decoder_->CopyNextValues(n, dst);
+  }
+
+  DCHECK(parsed_);
+  CHECK_EQ(dst->type_info()->physical_type(), BINARY);
+  DCHECK_LE(*n, dst->nrows());
+  DCHECK_EQ(dst->stride(), sizeof(Slice));
+
+  const SelectionVector* codewords_matching_pred =
+      iter_->GetCodeWordsMatchingPredicate(*ctx->pred());
+
+  Arena* out_arena = dst->arena();
+  Slice* out = reinterpret_cast<Slice*>(dst->data());
+
+  codeword_buf_.resize((*n)*sizeof(uint32_t));
+  BShufBlockDecoder<UINT32>* d_bptr = down_cast<BShufBlockDecoder<UINT32>*>(data_decoder_.get());
+  RETURN_NOT_OK(d_bptr->CopyNextValuesToArray(n, codeword_buf_.data()));
+
+  for (int i = 0; i < *n; i++, out++) {
+    // Rows which are already deselected, or whose code word does not satisfy
+    // the predicate, are never looked at again: skip copying their strings.
+    if (!sel->TestBit(i)) {
+      *out = Slice();
+      continue;
+    }
+    uint32_t codeword = *reinterpret_cast<uint32_t*>(&codeword_buf_[i*sizeof(uint32_t)]);
+    if (!codewords_matching_pred->IsRowSelected(codeword)) {
+      sel->ClearBit(i);
+      *out = Slice();
+      continue;
+    }
+    Slice elem = dict_decoder_->string_at_index(codeword);
+    CHECK(out_arena->RelocateSlice(elem, out));
+  }
+  return Status::OK();
+}
+
 } // namespace cfile
 } // namespace kudu
@@ -86,6 +86,10 @@ class BinaryDictBlockBuilder : public BlockBuilder {
 
   Status GetLastKey(void* key) const OVERRIDE;
 
+  // Returns how the data blocks finished so far were written. The dictionary
+  // fields are only set by AppendExtraInfo().
+  const DictEncodingStatsPB& stats() const { return stats_; }
+
   static const size_t kMaxHeaderSize = sizeof(uint32_t) * 1;
 
  private:
@@ -115,6 +119,9 @@ class BinaryDictBlockBuilder : public BlockBuilder {
 
   // First key when mode_ = kCodeWordMode
   faststring first_key_;
+
+  // Like the dictionary, accumulated over the whole cfile.
+  DictEncodingStatsPB stats_;
 };
 
 class CFileIterator;
@@ -128,6 +135,15 @@ class BinaryDictBlockDecoder : public BlockDecoder {
   virtual Status SeekAtOrAfterValue(const void* value, bool* exact_match) OVERRIDE;
   Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE;
 
+  // In code word mode, evaluates the predicate once per dictionary entry
+  // (see CFileIterator::GetCodeWordsMatchingPredicate()) and filters rows by
+  // looking up their code words, copying out only the strings of rows which
+  // remain selected.
+  Status CopyNextAndEval(size_t* n,
+                         ColumnMaterializationContext* ctx,
+                         SelectionVectorView* sel,
+                         ColumnDataView* dst) OVERRIDE;
+
   virtual bool HasNext() const OVERRIDE {
     return data_decoder_->HasNext();
   }
@@ -152,6 +168,9 @@ class BinaryDictBlockDecoder : public BlockDecoder {
   Slice data_;
   bool parsed_;
 
+  // The iterator which owns the dictionary block.
+  CFileIterator* iter_;
+
   // Dictionary block decoder
   BinaryPlainBlockDecoder* dict_decoder_;
 
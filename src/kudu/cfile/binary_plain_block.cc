@@ -24,6 +24,7 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/fastmem.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
 #include "kudu/util/group_varint-inl.h"
@@ -284,20 +285,27 @@ Status BinaryPlainBlockDecoder::CopyNextValues(size_t *n, ColumnDataView *dst) {
 
   size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
 
+  // The values are stored back to back, so the whole batch is copied into
+  // the arena at once, and the output slices are pointed into the copy.
+  const uint32_t start = offsets_[cur_idx_];
+  const uint32_t end = offsets_[cur_idx_ + max_fetch];
+  DCHECK_LE(start, end);
+  uint8_t *buf = reinterpret_cast<uint8_t *>(out_arena->AllocateBytes(end - start));
+  if (PREDICT_FALSE(buf == nullptr && end > start)) {
+    return Status::IOError(
+      "Out of memory",
+      strings::Substitute("Failed to allocate $0 bytes in output arena", end - start));
+  }
+  strings::memcpy_inlined(buf, &data_[start], end - start);
+
   Slice *out = reinterpret_cast<Slice *>(dst->data());
-  size_t i;
-  for (i = 0; i < max_fetch; i++) {
-    Slice elem(string_at_index(cur_idx_));
-
-    // TODO: in a lot of cases, we might be able to get away with the decoder
-    // owning it and not truly copying. But, we should extend the CopyNextValues
-    // API so that the caller can specify if they truly _need_ copies or not.
-    CHECK(out_arena->RelocateSlice(elem, out));
-    out++;
-    cur_idx_++;
+  for (size_t i = 0; i < max_fetch; i++) {
+    const uint32_t offset = offsets_[cur_idx_ + i];
+    out[i] = Slice(buf + offset - start, offsets_[cur_idx_ + i + 1] - offset);
   }
+  cur_idx_ += max_fetch;
 
-  *n = i;
+  *n = max_fetch;
   return Status::OK();
 }
 
@@ -45,8 +45,16 @@ static const uint8_t *DecodeEntryLengths(
   const uint8_t *ptr, const uint8_t *limit,
   uint32_t *shared, uint32_t *non_shared) {
 
-  if ((ptr = GetVarint32Ptr(ptr, limit, shared)) == nullptr) return nullptr;
-  if ((ptr = GetVarint32Ptr(ptr, limit, non_shared)) == nullptr) return nullptr;
+  if (PREDICT_TRUE(limit - ptr >= 2 && ((ptr[0] | ptr[1]) & 0x80) == 0)) {
+    // Fast path: both lengths fit in a single byte, as is the case for most
+    // entries.
+    *shared = ptr[0];
+    *non_shared = ptr[1];
+    ptr += 2;
+  } else {
+    if ((ptr = GetVarint32Ptr(ptr, limit, shared)) == nullptr) return nullptr;
+    if ((ptr = GetVarint32Ptr(ptr, limit, non_shared)) == nullptr) return nullptr;
+  }
   if (limit - ptr < *non_shared) {
     return nullptr;
   }
@@ -396,38 +404,48 @@ Status BinaryPrefixBlockDecoder::CopyNextValues(size_t *n, ColumnDataView *dst)
     return Status::OK();
   }
 
-  size_t i = 0;
   size_t max_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
 
-  // Grab the first row, which we've cached from the last call or seek.
-  const uint8_t *out_data = out_arena->AddSlice(cur_val_);
-  if (PREDICT_FALSE(out_data == nullptr)) {
+  // The first value is cached from the last call or seek. Decode the lengths
+  // of the others, so that all the values of the batch can be rebuilt into a
+  // single arena allocation.
+  entries_.resize(max_fetch - 1);
+  size_t total_size = cur_val_.size();
+  size_t prev_size = cur_val_.size();
+  for (size_t i = 0; i < entries_.size(); i++) {
+    RETURN_NOT_OK(CheckNextPtr());
+    Entry* e = &entries_[i];
+    e->delta = DecodeEntryLengths(next_ptr_, &e->shared, &e->non_shared);
+    if (PREDICT_FALSE(e->delta == nullptr || e->shared > prev_size)) {
+      return Status::Corruption(
+        StringPrintf("Could not decode value length data at idx %zu",
+                     cur_idx_ + i + 1));
+    }
+    prev_size = e->shared + e->non_shared;
+    total_size += prev_size;
+    next_ptr_ = e->delta + e->non_shared;
+  }
+
+  uint8_t *buf = reinterpret_cast<uint8_t *>(out_arena->AllocateBytes(total_size));
+  if (PREDICT_FALSE(buf == nullptr && total_size > 0)) {
     return Status::IOError(
       "Out of memory",
-      StringPrintf("Failed to allocate %d bytes in output arena",
-                   static_cast<int>(cur_val_.size())));
+      StringPrintf("Failed to allocate %zu bytes in output arena", total_size));
   }
 
-  // Put a slice to it in the output array
-  Slice prev_val(out_data, cur_val_.size());
+  // Then rebuild each value from the shared prefix of the previous one.
+  strings::memcpy_inlined(buf, cur_val_.data(), cur_val_.size());
+  Slice prev_val(buf, cur_val_.size());
   *out++ = prev_val;
-  i++;
-  cur_idx_++;
-
-  #ifndef NDEBUG
-  cur_val_.assign_copy("INVALID");
-  #endif
-
-  // Now iterate pulling more rows from the block, decoding relative
-  // to the previous value.
-
-  for (; i < max_fetch; i++) {
-    Slice copied;
-    RETURN_NOT_OK(ParseNextIntoArena(prev_val, dst->arena(), &copied));
-    *out++  = copied;
-    prev_val = copied;
-    cur_idx_++;
+  buf += prev_val.size();
+  for (const Entry& e : entries_) {
+    strings::memcpy_inlined(buf, prev_val.data(), e.shared);
+    strings::memcpy_inlined(buf + e.shared, e.delta, e.non_shared);
+    prev_val = Slice(buf, e.shared + e.non_shared);
+    *out++ = prev_val;
+    buf += prev_val.size();
   }
+  cur_idx_ += max_fetch;
 
   // Fetch the next value to be returned, using the last value we fetched
   // for the delta.
@@ -438,7 +456,7 @@ Status BinaryPrefixBlockDecoder::CopyNextValues(size_t *n, ColumnDataView *dst)
     next_ptr_ = nullptr;
   }
 
-  *n = i;
+  *n = max_fetch;
   return Status::OK();
 }
 
@@ -486,30 +504,6 @@ Status BinaryPrefixBlockDecoder::CheckNextPtr() {
   return Status::OK();
 }
 
-inline Status BinaryPrefixBlockDecoder::ParseNextIntoArena(Slice prev_val,
-                                                           Arena *dst,
-                                                           Slice *copied) {
-  RETURN_NOT_OK(CheckNextPtr());
-  uint32_t shared, non_shared;
-  const uint8_t *val_delta = DecodeEntryLengths(next_ptr_, &shared, &non_shared);
-  if (val_delta == nullptr) {
-    return Status::Corruption(
-      StringPrintf("Could not decode value length data at idx %d",
-                   cur_idx_));
-  }
-
-  DCHECK_LE(shared, prev_val.size())
-    << "Spcified longer shared amount than previous key length";
-
-  uint8_t *buf = reinterpret_cast<uint8_t *>(dst->AllocateBytes(non_shared + shared));
-  strings::memcpy_inlined(buf, prev_val.data(), shared);
-  strings::memcpy_inlined(buf + shared, val_delta, non_shared);
-
-  *copied = Slice(buf, non_shared + shared);
-  next_ptr_ = val_delta + non_shared;
-  return Status::OK();
-}
-
 // Parses the data pointed to by next_ptr_ and stores it in cur_val_
 // Advances next_ptr_ to point to the following values.
 // Does not modify cur_idx_
@@ -120,7 +120,6 @@ class BinaryPrefixBlockDecoder : public BlockDecoder {
   Status SkipForward(int n);
   Status CheckNextPtr();
   Status ParseNextValue();
-  Status ParseNextIntoArena(Slice prev_val, Arena *dst, Slice *copied);
 
   const uint8_t *DecodeEntryLengths(const uint8_t *ptr,
                            uint32_t *shared,
@@ -156,6 +155,15 @@ class BinaryPrefixBlockDecoder : public BlockDecoder {
   // following cur_val_
   // This is advanced by ParseNextValue()
   const uint8_t *next_ptr_;
+
+  // The lengths and delta of an entry, as decoded by the first pass of
+  // CopyNextValues().
+  struct Entry {
+    uint32_t shared;
+    uint32_t non_shared;
+    const uint8_t *delta;
+  };
+  std::vector<Entry> entries_;
 };
 
 } // namespace cfile
@@ -60,6 +60,79 @@ TEST(TestBlockCache, TestBasics) {
   ASSERT_FALSE(cache.Lookup(key1, Cache::EXPECT_IN_CACHE, &retrieved_handle));
 }
 
+TEST(TestBlockCache, TestListEntries) {
+  BlockCache cache(512 * 1024 * 1024);
+  BlockCache::FileId id(1234);
+  for (int i = 1; i <= 3; i++) {
+    BlockCache::PendingEntry data = cache.Allocate(BlockCache::CacheKey(id, i), i * 10);
+    BlockCacheHandle handle;
+    cache.Insert(&data, &handle);
+  }
+
+  std::vector<std::pair<BlockCache::CacheKey, size_t> > entries;
+  cache.ListEntries(10, &entries);
+  ASSERT_EQ(3, entries.size());
+  std::sort(entries.begin(), entries.end(),
+            [](const std::pair<BlockCache::CacheKey, size_t>& a,
+               const std::pair<BlockCache::CacheKey, size_t>& b) {
+              return a.first.offset_ < b.first.offset_;
+            });
+  for (int i = 1; i <= 3; i++) {
+    ASSERT_EQ(id.id(), entries[i - 1].first.file_id_);
+    ASSERT_EQ(i, entries[i - 1].first.offset_);
+    ASSERT_EQ(i * 10, entries[i - 1].second);
+  }
+
+  entries.clear();
+  cache.ListEntries(1, &entries);
+  ASSERT_EQ(1, entries.size());
+}
+
+TEST(TestBlockCache, TestCompressedEntries) {
+  size_t data_size = strlen(DATA_TO_CACHE) + 1;
+  BlockCache::FileId id(1234);
+  BlockCache::CacheKey key(id, 1);
+
+  // Without a compressed share, compressed entries are never cached.
+  {
+    BlockCache cache(1024 * 1024);
+    ASSERT_FALSE(cache.caches_compressed_blocks());
+    ASSERT_FALSE(cache.Allocate(key, data_size, BlockCache::COMPRESSED).valid());
+  }
+
+  // With a split cache, compressed and uncompressed entries for the same key
+  // are kept apart.
+  {
+    BlockCache cache(1024 * 1024, 0.5);
+    ASSERT_TRUE(cache.caches_compressed_blocks());
+    ASSERT_TRUE(cache.caches_uncompressed_blocks());
+    BlockCache::PendingEntry data = cache.Allocate(key, data_size, BlockCache::COMPRESSED);
+    ASSERT_TRUE(data.valid());
+    memcpy(data.val_ptr(), DATA_TO_CACHE, data_size);
+    BlockCacheHandle inserted_handle;
+    cache.Insert(&data, &inserted_handle);
+
+    BlockCacheHandle handle;
+    ASSERT_FALSE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle));
+    ASSERT_TRUE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle, BlockCache::COMPRESSED));
+    ASSERT_EQ(0, memcmp(handle.data().data(), DATA_TO_CACHE, data_size));
+
+    // Compressed entries aren't listed for cache warming.
+    std::vector<std::pair<BlockCache::CacheKey, size_t> > entries;
+    cache.ListEntries(10, &entries);
+    ASSERT_TRUE(entries.empty());
+  }
+
+  // A cache given over entirely to compressed blocks.
+  {
+    BlockCache cache(1024 * 1024, 1);
+    ASSERT_TRUE(cache.caches_compressed_blocks());
+    ASSERT_FALSE(cache.caches_uncompressed_blocks());
+    ASSERT_FALSE(cache.Allocate(key, data_size).valid());
+    BlockCacheHandle handle;
+    ASSERT_FALSE(cache.Lookup(key, Cache::EXPECT_IN_CACHE, &handle));
+  }
+}
 
 } // namespace cfile
 } // namespace kudu
@@ -16,6 +16,9 @@
 // under the License.
 
 #include <gflags/gflags.h>
+#include <string.h>
+#include <utility>
+#include <vector>
 
 #include "kudu/cfile/block_cache.h"
 #include "kudu/gutil/port.h"
@@ -24,17 +27,46 @@
 #include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/string_case.h"
+#include "kudu/util/tiered_cache.h"
 
 DEFINE_int64(block_cache_capacity_mb, 512, "block cache capacity in MB");
 TAG_FLAG(block_cache_capacity_mb, stable);
 
 DEFINE_string(block_cache_type, "DRAM",
               "Which type of block cache to use for caching data. "
-              "Valid choices are 'DRAM' or 'NVM'. DRAM, the default, "
+              "Valid choices are 'DRAM', 'NVM' or 'TIERED'. DRAM, the default, "
               "caches data in regular memory. 'NVM' caches data "
-              "in a memory-mapped file using the NVML library.");
+              "in a memory-mapped file using the NVML library. 'TIERED' "
+              "caches data in regular memory, and demotes the blocks it "
+              "evicts into an NVM cache of --block_cache_nvm_capacity_mb.");
 TAG_FLAG(block_cache_type, experimental);
 
+DEFINE_int64(block_cache_nvm_capacity_mb, 4096,
+             "Capacity in MB of the NVM tier of a 'TIERED' block cache. "
+             "--block_cache_capacity_mb is the capacity of its DRAM tier.");
+TAG_FLAG(block_cache_nvm_capacity_mb, experimental);
+
+DEFINE_string(block_cache_eviction_policy, "LRU",
+              "Which eviction policy the block cache uses. Valid choices are "
+              "'LRU', 'SLRU' or 'CLOCK'. 'SLRU', a segmented LRU policy, keeps "
+              "large scans from evicting frequently read blocks. 'CLOCK' "
+              "approximates LRU without serializing concurrent lookups. "
+              "'SLRU' and 'CLOCK' are only supported in DRAM, which is the "
+              "upper tier of a 'TIERED' block cache.");
+TAG_FLAG(block_cache_eviction_policy, experimental);
+
+DEFINE_double(block_cache_compressed_fraction, 0,
+              "Fraction of --block_cache_capacity_mb reserved for caching "
+              "blocks of compressed columns in their on-disk, compressed form. "
+              "Compressed blocks are decompressed on every cache hit, trading "
+              "CPU for a larger effective cache. The rest of the capacity "
+              "caches uncompressed blocks as usual. 0, the default, caches "
+              "uncompressed blocks only; 1 caches compressed blocks only.");
+TAG_FLAG(block_cache_compressed_fraction, experimental);
+
+using std::pair;
+using std::vector;
+
 namespace kudu {
 
 class MetricEntity;
@@ -43,6 +75,22 @@ namespace cfile {
 
 namespace {
 
+Cache* CreateCacheWithPolicy(CacheType t, int64_t capacity) {
+  ToUpperCase(FLAGS_block_cache_eviction_policy, &FLAGS_block_cache_eviction_policy);
+  if (FLAGS_block_cache_eviction_policy == "SLRU") {
+    return NewSLRUCache(t, capacity, "block_cache");
+  }
+  if (FLAGS_block_cache_eviction_policy == "CLOCK") {
+    return NewClockCache(t, capacity, "block_cache");
+  }
+  if (FLAGS_block_cache_eviction_policy != "LRU") {
+    LOG(FATAL) << "Unknown block cache eviction policy: '"
+               << FLAGS_block_cache_eviction_policy
+               << "' (expected 'LRU', 'SLRU' or 'CLOCK')";
+  }
+  return NewLRUCache(t, capacity, "block_cache");
+}
+
 Cache* CreateCache(int64_t capacity) {
   CacheType t;
   ToUpperCase(FLAGS_block_cache_type, &FLAGS_block_cache_type);
@@ -50,47 +98,102 @@ Cache* CreateCache(int64_t capacity) {
     t = NVM_CACHE;
   } else if (FLAGS_block_cache_type == "DRAM") {
     t = DRAM_CACHE;
+  } else if (FLAGS_block_cache_type == "TIERED") {
+    return NewTieredCache(
+        CreateCacheWithPolicy(DRAM_CACHE, capacity),
+        NewLRUCache(NVM_CACHE, FLAGS_block_cache_nvm_capacity_mb * 1024 * 1024,
+                    "block_cache_nvm_tier"));
   } else {
     LOG(FATAL) << "Unknown block cache type: '" << FLAGS_block_cache_type
-               << "' (expected 'DRAM' or 'NVM')";
+               << "' (expected 'DRAM', 'NVM' or 'TIERED')";
   }
-  return NewLRUCache(t, capacity, "block_cache");
+  return CreateCacheWithPolicy(t, capacity);
 }
 
 } // anonymous namespace
 
 BlockCache::BlockCache()
-  : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024) {
+  : BlockCache(FLAGS_block_cache_capacity_mb * 1024 * 1024,
+               FLAGS_block_cache_compressed_fraction) {
 }
 
 BlockCache::BlockCache(size_t capacity)
-  : cache_(CreateCache(capacity)) {
+  : BlockCache(capacity, 0) {
+}
+
+BlockCache::BlockCache(size_t capacity, double compressed_fraction) {
+  if (compressed_fraction < 0 || compressed_fraction > 1) {
+    LOG(FATAL) << "Invalid block cache compressed fraction: " << compressed_fraction
+               << " (expected a value between 0 and 1)";
+  }
+  size_t compressed_capacity = capacity * compressed_fraction;
+  if (compressed_capacity < capacity) {
+    cache_.reset(CreateCache(capacity - compressed_capacity));
+  }
+  if (compressed_capacity > 0) {
+    // Compressed blocks are always kept in DRAM: they're decompressed on
+    // every hit, so there's nothing to gain from an extra copy out of NVM.
+    compressed_cache_.reset(NewLRUCache(DRAM_CACHE, compressed_capacity,
+                                        "block_cache_compressed"));
+  }
 }
 
-BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_size) {
+BlockCache::PendingEntry BlockCache::Allocate(const CacheKey& key, size_t val_size,
+                                              EntryType type) {
+  Cache* cache = cache_for(type);
+  if (cache == nullptr) {
+    return PendingEntry();
+  }
   Slice key_slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key));
   int charge = val_size;
-  return PendingEntry(cache_.get(), cache_->Allocate(key_slice, val_size, charge));
+  return PendingEntry(cache, cache->Allocate(key_slice, val_size, charge));
 }
 
 bool BlockCache::Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
-                        BlockCacheHandle *handle) {
-  Cache::Handle *h = cache_->Lookup(Slice(reinterpret_cast<const uint8_t*>(&key),
-                                          sizeof(key)), behavior);
+                        BlockCacheHandle *handle, EntryType type) {
+  Cache* cache = cache_for(type);
+  if (cache == nullptr) {
+    return false;
+  }
+  Cache::Handle *h = cache->Lookup(Slice(reinterpret_cast<const uint8_t*>(&key),
+                                         sizeof(key)), behavior);
   if (h != nullptr) {
-    handle->SetHandle(cache_.get(), h);
+    handle->SetHandle(cache, h);
   }
   return h != nullptr;
 }
 
 void BlockCache::Insert(BlockCache::PendingEntry* entry, BlockCacheHandle* inserted) {
-  Cache::Handle *h = cache_->Insert(entry->handle_, /* eviction_callback= */ nullptr);
+  // The pending entry remembers which cache it was allocated from.
+  Cache* cache = entry->cache_;
+  Cache::Handle *h = cache->Insert(entry->handle_, /* eviction_callback= */ nullptr);
   entry->handle_ = nullptr;
-  inserted->SetHandle(cache_.get(), h);
+  inserted->SetHandle(cache, h);
+}
+
+void BlockCache::ListEntries(size_t max_entries,
+                             vector<pair<CacheKey, size_t> >* entries) const {
+  if (!cache_) {
+    return;
+  }
+  vector<Cache::EntryInfo> cache_entries;
+  cache_->ListEntries(max_entries, &cache_entries);
+  for (const Cache::EntryInfo& e : cache_entries) {
+    if (PREDICT_FALSE(e.key.size() != sizeof(CacheKey))) {
+      continue;
+    }
+    CacheKey key(BlockId(), 0);
+    memcpy(&key, e.key.data(), sizeof(key));
+    entries->emplace_back(key, e.value_size);
+  }
 }
 
 void BlockCache::StartInstrumentation(const scoped_refptr<MetricEntity>& metric_entity) {
-  cache_->SetMetrics(metric_entity);
+  // Only the uncompressed cache reports the block cache metrics; compressed
+  // cache hits are traced by the CFile reader.
+  if (cache_) {
+    cache_->SetMetrics(metric_entity);
+  }
 }
 
 } // namespace cfile
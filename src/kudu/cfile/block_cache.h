@@ -19,6 +19,8 @@
 
 #include <algorithm>
 #include <glog/logging.h>
+#include <utility>
+#include <vector>
 
 #include "kudu/fs/block_id.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -45,6 +47,15 @@ class BlockCache {
   // which is just a portion of a CFile.
   typedef BlockId FileId;
 
+  // The form in which a block is cached. Compressed blocks are only cached
+  // when --block_cache_compressed_fraction is positive, in which case they
+  // live in their own cache so that they never compete with (or shadow)
+  // uncompressed entries for the same key.
+  enum EntryType {
+    UNCOMPRESSED,
+    COMPRESSED
+  };
+
   // The unique key identifying entries in the block cache.
   // Each cached block corresponds to a specific offset within
   // a file (called a "block" in other parts of Kudu).
@@ -111,6 +122,11 @@ class BlockCache {
 
   explicit BlockCache(size_t capacity);
 
+  // Create a block cache of 'capacity' bytes, 'compressed_fraction' of which
+  // is reserved for compressed blocks. A fraction of 1 caches compressed
+  // blocks only.
+  BlockCache(size_t capacity, double compressed_fraction);
+
   // Lookup the given block in the cache.
   //
   // If the entry is found, then sets *handle to refer to the entry.
@@ -119,7 +135,23 @@ class BlockCache {
   //
   // Returns true to indicate that the entry was found, false otherwise.
   bool Lookup(const CacheKey& key, Cache::CacheBehavior behavior,
-              BlockCacheHandle* handle);
+              BlockCacheHandle* handle, EntryType type = UNCOMPRESSED);
+
+  // Return true if compressed blocks have a share of the cache.
+  bool caches_compressed_blocks() const {
+    return compressed_cache_ != nullptr;
+  }
+
+  // Return true if uncompressed blocks have a share of the cache.
+  bool caches_uncompressed_blocks() const {
+    return cache_ != nullptr;
+  }
+
+  // Appends the keys and sizes of up to 'max_entries' cached blocks to
+  // 'entries', preferring recently used blocks. This locks the cache, so it
+  // should be called infrequently.
+  void ListEntries(size_t max_entries,
+                   std::vector<std::pair<CacheKey, size_t> >* entries) const;
 
   // Pass a metric entity to the cache to start recording metrics.
   // This should be called before the block cache starts serving blocks.
@@ -146,7 +178,10 @@ class BlockCache {
   //   cache->Insert(&entry, &bch);
 
   // Allocate a new entry to be inserted into the cache.
-  PendingEntry Allocate(const CacheKey& key, size_t block_size);
+  //
+  // Returns an invalid entry if the cache has no share for blocks of 'type'.
+  PendingEntry Allocate(const CacheKey& key, size_t block_size,
+                        EntryType type = UNCOMPRESSED);
 
   // Insert the given block into the cache. 'inserted' is set to refer to the
   // entry in the cache.
@@ -158,7 +193,18 @@ class BlockCache {
 
   DISALLOW_COPY_AND_ASSIGN(BlockCache);
 
+  // Returns the cache holding blocks of 'type', or nullptr if there is none.
+  Cache* cache_for(EntryType type) const {
+    return type == COMPRESSED ? compressed_cache_.get() : cache_.get();
+  }
+
+  // Cache of uncompressed blocks. Null if the whole capacity is given
+  // to compressed blocks.
   gscoped_ptr<Cache> cache_;
+
+  // Cache of compressed blocks. Null unless --block_cache_compressed_fraction
+  // is positive.
+  gscoped_ptr<Cache> compressed_cache_;
 };
 
 // Scoped reference to a block from the block cache.
@@ -19,18 +19,24 @@
 #define KUDU_CFILE_BLOCK_ENCODINGS_H
 
 #include <stdint.h>
+#include <string.h>
 
 #include <glog/logging.h>
 
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/columnblock.h"
 #include "kudu/common/rowid.h"
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 class ColumnDataView;
+class SelectionVectorView;
 
 namespace cfile {
 class CFileWriter;
@@ -93,6 +99,46 @@ class BlockBuilder {
 };
 
 
+// Copies the packed fixed-width values at 'src', of which there are 'nsrc',
+// into those of the next 'nrows' cells of 'dst' which its null bitmap marks
+// as non-NULL. Sets '*ncopied' to the number of values copied. Returns false,
+// having copied an unspecified number of values, if there are fewer values
+// than non-NULL cells.
+//
+// Shared by the CopyNextNonNullValues() implementations of decoders which
+// keep their values as an array of CppType. The cell size is a constant, so
+// the copy of a lone value compiles down to a single load and store.
+template<typename CppType>
+inline bool CopyFixedWidthToNonNullCells(const uint8_t *src, size_t nsrc, size_t nrows,
+                                         ColumnDataView *dst, size_t *ncopied) {
+  DCHECK_EQ(dst->stride(), sizeof(CppType));
+  DCHECK_LE(nrows, dst->nrows());
+  size_t first = dst->first_row_index();
+  BitmapIterator iter(dst->null_bitmap(), first + nrows);
+  iter.SeekTo(first);
+  uint8_t *out = dst->data();
+  size_t copied = 0;
+  bool not_null;
+  size_t run;
+  while ((run = iter.Next(&not_null)) > 0) {
+    if (not_null) {
+      if (PREDICT_FALSE(copied + run > nsrc)) {
+        *ncopied = copied;
+        return false;
+      }
+      if (run == 1) {
+        memcpy(out, src + copied * sizeof(CppType), sizeof(CppType));
+      } else {
+        memcpy(out, src + copied * sizeof(CppType), run * sizeof(CppType));
+      }
+      copied += run;
+    }
+    out += run * sizeof(CppType);
+  }
+  *ncopied = copied;
+  return true;
+}
+
 class BlockDecoder {
  public:
   BlockDecoder() { }
@@ -138,6 +184,51 @@ class BlockDecoder {
   // allocated in the dst block's arena.
   virtual Status CopyNextValues(size_t *n, ColumnDataView *dst) = 0;
 
+  // Fetch the next set of values from the block into 'dst', evaluating the
+  // predicate in 'ctx' against them as they are decoded. Rows which do not
+  // match are cleared in 'sel'; rows already unset in 'sel' may be skipped
+  // and their cells left with arbitrary contents.
+  //
+  // Decoders which cannot evaluate predicates on their encoded form use this
+  // default, which marks 'ctx' as unsupported and falls back to
+  // CopyNextValues(). The caller is then responsible for evaluating the
+  // predicate itself.
+  virtual Status CopyNextAndEval(size_t *n,
+                                 ColumnMaterializationContext *ctx,
+                                 SelectionVectorView *sel,
+                                 ColumnDataView *dst) {
+    ctx->SetDecoderEvalNotSupported();
+    return CopyNextValues(n, dst);
+  }
+
+  // Fetch the next values from the block into those of the next 'nrows'
+  // cells of 'dst' which its null bitmap marks as non-NULL. The NULL cells
+  // are left untouched. The block must hold a value for each non-NULL cell.
+  //
+  // This default makes a CopyNextValues() call per run of non-NULL cells.
+  // Decoders of fixed-width values override it to fill the whole range in
+  // a single call, which matters for sparsely NULL columns.
+  virtual Status CopyNextNonNullValues(size_t nrows, ColumnDataView *dst) {
+    DCHECK_LE(nrows, dst->nrows());
+    size_t first = dst->first_row_index();
+    BitmapIterator iter(dst->null_bitmap(), first + nrows);
+    iter.SeekTo(first);
+    ColumnDataView view(*dst);
+    bool not_null;
+    size_t run;
+    while ((run = iter.Next(&not_null)) > 0) {
+      if (not_null) {
+        size_t n = run;
+        RETURN_NOT_OK(CopyNextValues(&n, &view));
+        if (PREDICT_FALSE(n != run)) {
+          return Status::Corruption("block ran out of values before the non-NULL cells");
+        }
+      }
+      view.Advance(run);
+    }
+    return Status::OK();
+  }
+
   // Return true if there are more values remaining to be iterated.
   // (i.e that the next call to CopyNextValues will return at least 1
   // element)
@@ -69,7 +69,7 @@ class BloomFileTestBase : public KuduTest {
     }
   }
 
-  void WriteTestBloomFile() {
+  void WriteTestBloomFile(BloomFilterLayout layout = CLASSIC_BLOOM_LAYOUT) {
     gscoped_ptr<WritableBlock> sink;
     ASSERT_OK(fs_manager_->CreateNewBlock(&sink));
     block_id_ = sink->id();
@@ -81,6 +81,7 @@ class BloomFileTestBase : public KuduTest {
     ASSERT_GT(FLAGS_n_keys, sizing.expected_count())
       << "Invalid parameters: --n_keys isn't set large enough to fill even "
       << "one bloom filter of the requested --bloom_size_bytes";
+    sizing.set_layout(layout);
 
     BloomFileWriter bfw(std::move(sink), sizing);
 
@@ -19,6 +19,7 @@
 #include "kudu/fs/fs-test-util.h"
 
 using std::shared_ptr;
+using std::vector;
 
 namespace kudu {
 namespace cfile {
@@ -28,7 +29,9 @@ using fs::CountingReadableBlock;
 class BloomFileTest : public BloomFileTestBase {
 
  protected:
-  void VerifyBloomFile() {
+  // 'max_fp_rate_factor' bounds the observed false positive rate as a
+  // multiple of --fp_rate.
+  void VerifyBloomFile(double max_fp_rate_factor = 1.2) {
     // Verify all the keys that we inserted probe as present.
     for (uint64_t i = 0; i < FLAGS_n_keys; i++) {
       uint64_t i_byteswapped = BigEndian::FromHost64(i << kKeyShift);
@@ -54,8 +57,8 @@ class BloomFileTest : public BloomFileTestBase {
 
     double fp_rate = static_cast<double>(positive_count) / FLAGS_n_keys;
     LOG(INFO) << "fp_rate: " << fp_rate << "(" << positive_count << "/" << FLAGS_n_keys << ")";
-    ASSERT_LT(fp_rate, FLAGS_fp_rate + FLAGS_fp_rate * 0.20f)
-      << "Should be no more than 1.2x the expected FP rate";
+    ASSERT_LT(fp_rate, FLAGS_fp_rate * max_fp_rate_factor)
+      << "Should be no more than " << max_fp_rate_factor << "x the expected FP rate";
   }
 };
 
@@ -66,6 +69,45 @@ TEST_F(BloomFileTest, TestWriteAndRead) {
   VerifyBloomFile();
 }
 
+TEST_F(BloomFileTest, TestWriteAndReadBlocked) {
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile(BLOCKED_BLOOM_LAYOUT));
+  ASSERT_OK(OpenBloomFile());
+  // Blocked blooms trade a somewhat higher false positive rate for locality.
+  VerifyBloomFile(2.0);
+}
+
+// Test that batched probing agrees with probing one key at a time, for a
+// mix of inserted and random keys given in arbitrary order.
+TEST_F(BloomFileTest, TestCheckKeysPresent) {
+  ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
+  ASSERT_OK(OpenBloomFile());
+
+  const int kNumProbes = 1000;
+  vector<uint64_t> keys;
+  for (int i = 0; i < kNumProbes; i++) {
+    if (i % 2 == 0) {
+      keys.push_back(BigEndian::FromHost64((random() % FLAGS_n_keys) << kKeyShift));
+    } else {
+      keys.push_back(random());
+    }
+  }
+  vector<BloomKeyProbe> probes;
+  for (const uint64_t& key : keys) {
+    probes.emplace_back(Slice(reinterpret_cast<const uint8_t*>(&key), sizeof(key)));
+  }
+
+  vector<uint8_t> bitmap(BitmapSize(kNumProbes), 0xff);
+  ASSERT_OK(bfr_->CheckKeysPresent(&probes[0], probes.size(), &bitmap[0]));
+  for (int i = 0; i < kNumProbes; i++) {
+    bool present = false;
+    ASSERT_OK(bfr_->CheckKeyPresent(probes[i], &present));
+    ASSERT_EQ(present, BitmapTest(&bitmap[0], i)) << "probe " << i;
+    if (i % 2 == 0) {
+      ASSERT_TRUE(present) << "inserted key " << i << " not found";
+    }
+  }
+}
+
 #ifdef NDEBUG
 TEST_F(BloomFileTest, Benchmark) {
   ASSERT_NO_FATAL_FAILURE(WriteTestBloomFile());
@@ -15,10 +15,12 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <algorithm>
 #include <mutex>
 #include <sched.h>
 #include <string>
 #include <unistd.h>
+#include <vector>
 
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_writer.h"
@@ -42,6 +44,15 @@ using fs::WritableBlock;
 // Writer
 ////////////////////////////////////////////////////////////
 
+static BloomFilterLayout LayoutFromPB(BloomFilterLayoutPB layout) {
+  switch (layout) {
+    case CLASSIC_BLOOM: return CLASSIC_BLOOM_LAYOUT;
+    case BLOCKED_BLOOM: return BLOCKED_BLOOM_LAYOUT;
+  }
+  LOG(FATAL) << "unknown bloom filter layout: " << layout;
+  return CLASSIC_BLOOM_LAYOUT;
+}
+
 BloomFileWriter::BloomFileWriter(gscoped_ptr<WritableBlock> block,
                                  const BloomFilterSizing &sizing)
   : bloom_builder_(sizing) {
@@ -111,6 +122,11 @@ Status BloomFileWriter::FinishCurrentBloomBlock() {
   // Encode the header.
   BloomBlockHeaderPB hdr;
   hdr.set_num_hash_functions(bloom_builder_.n_hashes());
+  if (bloom_builder_.layout() == BLOCKED_BLOOM_LAYOUT) {
+    // Left unset for classic blooms so that they stay readable by older
+    // versions.
+    hdr.set_layout(BLOCKED_BLOOM);
+  }
   faststring hdr_str;
   PutFixed32(&hdr_str, hdr.ByteSize());
   CHECK(pb_util::AppendToString(hdr, &hdr_str));
@@ -171,6 +187,12 @@ BloomFileReader::BloomFileReader(gscoped_ptr<CFileReader> reader,
                      memory_footprint_excluding_reader()) {
 }
 
+int64_t BloomFileReader::memory_consumption() const {
+  // The consumption only changes while initializing the file.
+  int64_t consumption = init_once_.initted() ? mem_consumption_.consumption() : 0;
+  return consumption + reader_->memory_consumption();
+}
+
 Status BloomFileReader::Init() {
   return init_once_.Init(&BloomFileReader::InitOnce, this);
 }
@@ -233,33 +255,40 @@ Status BloomFileReader::ParseBlockHeader(const Slice &block,
   }
 
   data.remove_prefix(header_len);
+  if (hdr->layout() == BLOCKED_BLOOM && PREDICT_FALSE(data.size() < 32)) {
+    return Status::Corruption(
+      StringPrintf("Blocked bloom filter of %ld bytes is smaller than one bucket",
+                   data.size()));
+  }
   *bloom_data = data;
   return Status::OK();
 }
 
-Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
-                                        bool *maybe_present) {
-  DCHECK(init_once_.initted());
-
+int BloomFileReader::LockIndexIterator(std::unique_lock<simple_spinlock> *lock) {
 #if defined(__linux__)
   int cpu = sched_getcpu();
 #else
   // Use just one lock if on OS X.
   int cpu = 0;
 #endif
+  while (true) {
+    std::unique_lock<simple_spinlock> l(iter_locks_[cpu], std::try_to_lock);
+    if (l.owns_lock()) {
+      lock->swap(l);
+      return cpu;
+    }
+    cpu = (cpu + 1) % index_iters_.size();
+  }
+}
+
+Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
+                                        bool *maybe_present) {
+  DCHECK(init_once_.initted());
+
   BlockPointer bblk_ptr;
   {
     std::unique_lock<simple_spinlock> lock;
-    while (true) {
-      std::unique_lock<simple_spinlock> l(iter_locks_[cpu], std::try_to_lock);
-      if (l.owns_lock()) {
-        lock.swap(l);
-        break;
-      }
-      cpu = (cpu + 1) % index_iters_.size();
-    }
-
-    cfile::IndexTreeIterator *index_iter = index_iters_[cpu].get();
+    cfile::IndexTreeIterator *index_iter = index_iters_[LockIndexIterator(&lock)].get();
 
     Status s = index_iter->SeekAtOrBefore(probe.key());
     if (PREDICT_FALSE(s.IsNotFound())) {
@@ -282,7 +311,7 @@ Status BloomFileReader::CheckKeyPresent(const BloomKeyProbe &probe,
   RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
 
   // Actually check the bloom filter.
-  BloomFilter bf(bloom_data, hdr.num_hash_functions());
+  BloomFilter bf(bloom_data, hdr.num_hash_functions(), LayoutFromPB(hdr.layout()));
   *maybe_present = bf.MayContainKey(probe);
   return Status::OK();
 }
@@ -308,5 +337,78 @@ size_t BloomFileReader::memory_footprint_excluding_reader() const {
   return size;
 }
 
+Status BloomFileReader::CheckKeysPresent(const BloomKeyProbe *probes,
+                                         size_t n_probes,
+                                         uint8_t *present_bitmap) {
+  DCHECK(init_once_.initted());
+  if (n_probes == 0) {
+    return Status::OK();
+  }
+
+  // Probes which fall before the first entry in the file are definitely not
+  // present; the rest are mapped to the bloom block which may contain them.
+  struct BlockProbe {
+    BlockPointer bblk_ptr;
+    size_t probe_idx;
+  };
+  std::vector<BlockProbe> block_probes;
+  block_probes.reserve(n_probes);
+  {
+    std::unique_lock<simple_spinlock> lock;
+    cfile::IndexTreeIterator *index_iter = index_iters_[LockIndexIterator(&lock)].get();
+    for (size_t i = 0; i < n_probes; i++) {
+      Status s = index_iter->SeekAtOrBefore(probes[i].key());
+      if (PREDICT_FALSE(s.IsNotFound())) {
+        BitmapClear(present_bitmap, i);
+        continue;
+      }
+      RETURN_NOT_OK(s);
+      block_probes.push_back({ index_iter->GetCurrentBlockPointer(), i });
+    }
+  }
+
+  // Group the probes by bloom block, so that each block is read and parsed
+  // once. The sort is stable so that, within a block, probes keep the order
+  // in which they were given.
+  std::stable_sort(block_probes.begin(), block_probes.end(),
+                   [](const BlockProbe &a, const BlockProbe &b) {
+                     return a.bblk_ptr.offset() < b.bblk_ptr.offset();
+                   });
+
+  // The number of probes whose bitmap lines are prefetched ahead of testing.
+  // Enough to overlap the misses, few enough that the lines stay in cache.
+  const size_t kPrefetchGroupSize = 16;
+
+  size_t group_start = 0;
+  while (group_start < block_probes.size()) {
+    const BlockPointer &bblk_ptr = block_probes[group_start].bblk_ptr;
+    size_t group_end = group_start + 1;
+    while (group_end < block_probes.size() &&
+           block_probes[group_end].bblk_ptr.offset() == bblk_ptr.offset()) {
+      group_end++;
+    }
+
+    BlockHandle dblk_data;
+    RETURN_NOT_OK(reader_->ReadBlock(bblk_ptr, CFileReader::CACHE_BLOCK, &dblk_data));
+    BloomBlockHeaderPB hdr;
+    Slice bloom_data;
+    RETURN_NOT_OK(ParseBlockHeader(dblk_data.data(), &hdr, &bloom_data));
+    BloomFilter bf(bloom_data, hdr.num_hash_functions(), LayoutFromPB(hdr.layout()));
+
+    for (size_t i = group_start; i < group_end; i += kPrefetchGroupSize) {
+      size_t end = std::min(i + kPrefetchGroupSize, group_end);
+      for (size_t j = i; j < end; j++) {
+        bf.PrefetchKey(probes[block_probes[j].probe_idx]);
+      }
+      for (size_t j = i; j < end; j++) {
+        size_t probe_idx = block_probes[j].probe_idx;
+        BitmapChange(present_bitmap, probe_idx, bf.MayContainKey(probes[probe_idx]));
+      }
+    }
+    group_start = group_end;
+  }
+  return Status::OK();
+}
+
 } // namespace cfile
 } // namespace kudu
@@ -18,6 +18,7 @@
 #define KUDU_CFILE_BLOOMFILE_H
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -103,6 +104,29 @@ class BloomFileReader {
   Status CheckKeyPresent(const BloomKeyProbe &probe,
                          bool *maybe_present);
 
+  // Check which of the 'n_probes' keys in 'probes' may be present in the
+  // file. Bit 'i' of 'present_bitmap' is set if 'probes[i]' may be present,
+  // and cleared if it is definitely not present. 'present_bitmap' must have
+  // room for at least 'n_probes' bits.
+  //
+  // Compared to calling CheckKeyPresent() once per key, the index is
+  // searched under a single lock acquisition, each bloom block is read and
+  // parsed once for all of the keys that fall into it, and the bitmap cache
+  // lines for a group of keys are prefetched before any of them are tested.
+  // Passing the probes in key order makes the index search cheapest.
+  Status CheckKeysPresent(const BloomKeyProbe *probes,
+                          size_t n_probes,
+                          uint8_t *present_bitmap);
+
+  // Returns the memory used by this reader and its CFileReader, as accounted
+  // to their parent MemTracker.
+  int64_t memory_consumption() const;
+
+  // Returns the number of bytes of index blocks kept in memory.
+  size_t pinned_index_bytes() const {
+    return reader_->pinned_validx_bytes();
+  }
+
  private:
   DISALLOW_COPY_AND_ASSIGN(BloomFileReader);
 
@@ -117,6 +141,11 @@ class BloomFileReader {
                           BloomBlockHeaderPB *hdr,
                           Slice *bloom_data) const;
 
+  // Lock one of the per-CPU index iterators, preferring the one belonging
+  // to the current CPU, and return its index. The lock is transferred to
+  // 'lock'.
+  int LockIndexIterator(std::unique_lock<simple_spinlock> *lock);
+
   // Callback used in 'init_once_' to initialize this bloom file.
   Status InitOnce();
 
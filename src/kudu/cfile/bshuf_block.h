@@ -280,6 +280,23 @@ class BShufBlockDecoder : public BlockDecoder {
     return CopyNextValuesToArray(n, dst->data());
   }
 
+  Status CopyNextNonNullValues(size_t nrows, ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    // UINT32 blocks may store narrower elements, which have to be widened
+    // by CopyNextValuesToArray().
+    if (Type == UINT32 && size_of_elem_ != size_of_type) {
+      return BlockDecoder::CopyNextNonNullValues(nrows, dst);
+    }
+    size_t ncopied;
+    bool ok = CopyFixedWidthToNonNullCells<CppType>(
+        decoded_.data() + cur_idx_ * size_of_type, num_elems_ - cur_idx_, nrows, dst, &ncopied);
+    cur_idx_ += ncopied;
+    if (PREDICT_FALSE(!ok)) {
+      return Status::Corruption("block ran out of values before the non-NULL cells");
+    }
+    return Status::OK();
+  }
+
   // Copy the codewords to a temporary buffer.
   // This API provides a more convenient way for the dictionary decoder to copy out
   // integer codewords and then look up the strings. If we use the CopyNextValuesToArray()
@@ -26,7 +26,10 @@
 #include "kudu/cfile/cfile.pb.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/fs/fs-test-util.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
@@ -34,8 +37,11 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/stopwatch.h"
 
+DECLARE_double(block_cache_compressed_fraction);
 DECLARE_string(block_cache_type);
 DECLARE_string(cfile_do_on_finish);
+DECLARE_int32(cfile_readahead_kb);
+DECLARE_double(cfile_value_bloom_fp_rate);
 
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
@@ -257,6 +263,186 @@ class TestCFile : public CFileTestBase {
 
   void TestReadWriteStrings(EncodingType encoding, const char* format);
 
+  // Write a file using 'encoding' and verify that scanning it while evaluating
+  // 'pred' in the decoders selects the same rows, with the same values, as
+  // scanning it plainly and evaluating 'pred' afterwards.
+  template <class DataGeneratorType>
+  void TestDecoderEval(DataGeneratorType* generator, EncodingType encoding,
+                       const ColumnPredicate& pred) {
+    const int kNumEntries = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, encoding, NO_COMPRESSION, kNumEntries, SMALL_BLOCKSIZE, &block_id);
+
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+
+    ScopedColumnBlock<DataGeneratorType::kDataType> expected_cb(1000);
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(1000);
+    int total_selected = 0;
+    while (iter->HasNext()) {
+      size_t n = cb.nrows();
+      ASSERT_OK(iter->PrepareBatch(&n));
+      // Predicates are evaluated over the whole block, so trim it to the batch.
+      ColumnBlock expected_slice(expected_cb.type_info(), expected_cb.null_bitmap(),
+                                 expected_cb.data(), n, expected_cb.arena());
+      ColumnBlock slice(cb.type_info(), cb.null_bitmap(), cb.data(), n, cb.arena());
+
+      SelectionVector expected_sel(n);
+      expected_sel.SetAllTrue();
+      ASSERT_OK(iter->Scan(&expected_slice));
+      pred.Evaluate(expected_slice, &expected_sel);
+
+      SelectionVector sel(n);
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, &pred, &slice, &sel);
+      ASSERT_OK(iter->Scan(&ctx));
+      if (!ctx.DecoderEvalSupported()) {
+        pred.Evaluate(slice, &sel);
+      }
+      ASSERT_OK(iter->FinishBatch());
+
+      for (size_t i = 0; i < n; i++) {
+        SCOPED_TRACE(i);
+        ASSERT_EQ(expected_sel.IsRowSelected(i), sel.IsRowSelected(i));
+        if (sel.IsRowSelected(i)) {
+          ASSERT_EQ(expected_cb[i], cb[i]);
+        }
+      }
+      total_selected += sel.CountSelected();
+      expected_cb.arena()->Reset();
+      cb.arena()->Reset();
+    }
+    // Make sure the predicate was actually selective.
+    ASSERT_GT(total_selected, 0);
+    ASSERT_LT(total_selected, kNumEntries);
+  }
+
+  // Write a file using 'encoding' and verify that scanning it with zone map
+  // based block skipping enabled for 'pred' selects the same rows as a plain
+  // scan, while reading fewer data blocks.
+  template <class DataGeneratorType>
+  void TestZoneMapSkipping(DataGeneratorType* generator, EncodingType encoding,
+                           const ColumnPredicate& pred) {
+    const int kNumEntries = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, encoding, NO_COMPRESSION, kNumEntries, SMALL_BLOCKSIZE, &block_id);
+
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    ASSERT_TRUE(reader->footer().has_zone_maps_block_ptr());
+
+    gscoped_ptr<CFileIterator> expected_iter;
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&expected_iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(expected_iter->SeekToOrdinal(0));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+
+    ScopedColumnBlock<DataGeneratorType::kDataType> expected_cb(1000);
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(1000);
+    int total_selected = 0;
+    while (expected_iter->HasNext()) {
+      ASSERT_TRUE(iter->HasNext());
+      size_t n = cb.nrows();
+      ASSERT_OK(expected_iter->PrepareBatch(&n));
+      ColumnBlock expected_slice(expected_cb.type_info(), expected_cb.null_bitmap(),
+                                 expected_cb.data(), n, expected_cb.arena());
+      SelectionVector expected_sel(n);
+      expected_sel.SetAllTrue();
+      ASSERT_OK(expected_iter->Scan(&expected_slice));
+      pred.Evaluate(expected_slice, &expected_sel);
+      ASSERT_OK(expected_iter->FinishBatch());
+
+      ColumnBlock slice(cb.type_info(), cb.null_bitmap(), cb.data(), n, cb.arena());
+      SelectionVector sel(n);
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, &pred, &slice, &sel);
+      size_t prepared = n;
+      ASSERT_OK(iter->PrepareBatch(&ctx, &prepared));
+      ASSERT_EQ(n, prepared);
+      ASSERT_OK(iter->Scan(&ctx));
+      if (!ctx.DecoderEvalSupported()) {
+        pred.Evaluate(slice, &sel);
+      }
+      ASSERT_OK(iter->FinishBatch());
+
+      for (size_t i = 0; i < n; i++) {
+        SCOPED_TRACE(i);
+        ASSERT_EQ(expected_sel.IsRowSelected(i), sel.IsRowSelected(i));
+        if (sel.IsRowSelected(i) && !cb.is_null(i)) {
+          ASSERT_EQ(expected_cb[i], cb[i]);
+        }
+      }
+      total_selected += sel.CountSelected();
+      expected_cb.arena()->Reset();
+      cb.arena()->Reset();
+    }
+    ASSERT_GT(total_selected, 0);
+    ASSERT_LT(iter->io_statistics().data_blocks_read_from_disk,
+              expected_iter->io_statistics().data_blocks_read_from_disk);
+  }
+
+  // Write a file using 'encoding' and verify that scanning it with a sparse
+  // random selection vector, skipping the unselected rows, yields the same
+  // values for the selected rows as a plain scan.
+  template <class DataGeneratorType>
+  void TestSkipUnselectedRows(DataGeneratorType* generator, EncodingType encoding) {
+    const int kNumEntries = 10000;
+    BlockId block_id;
+    WriteTestFile(generator, encoding, NO_COMPRESSION, kNumEntries, SMALL_BLOCKSIZE, &block_id);
+
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+
+    ScopedColumnBlock<DataGeneratorType::kDataType> expected_cb(1000);
+    ScopedColumnBlock<DataGeneratorType::kDataType> cb(1000);
+    int batch = 0;
+    while (iter->HasNext()) {
+      size_t n = cb.nrows();
+      ASSERT_OK(iter->PrepareBatch(&n));
+      ASSERT_OK(iter->Scan(&expected_cb));
+
+      // Vary the density of the selection from batch to batch, so that both
+      // long and short runs of unselected rows are exercised.
+      SelectionVector sel(n);
+      sel.SetAllFalse();
+      int one_in = 1 << (batch++ % 8);
+      for (size_t i = 0; i < n; i++) {
+        if (random() % one_in == 0) {
+          sel.SetRowSelected(i);
+        }
+      }
+      ColumnBlock slice(cb.type_info(), cb.null_bitmap(), cb.data(), n, cb.arena());
+      ColumnMaterializationContext ctx(0, nullptr, &slice, &sel);
+      ctx.set_skip_unselected_rows(true);
+      ASSERT_OK(iter->Scan(&ctx));
+      ASSERT_OK(iter->FinishBatch());
+
+      for (size_t i = 0; i < n; i++) {
+        if (!sel.IsRowSelected(i)) continue;
+        SCOPED_TRACE(i);
+        ASSERT_EQ(expected_cb.is_null(i), cb.is_null(i));
+        if (!cb.is_null(i)) {
+          ASSERT_EQ(expected_cb[i], cb[i]);
+        }
+      }
+      expected_cb.arena()->Reset();
+      cb.arena()->Reset();
+    }
+  }
+
 #ifdef NDEBUG
   void TestWrite100MFileStrings(EncodingType encoding) {
     BlockId block_id;
@@ -405,6 +591,43 @@ TEST_P(TestCFileBothCacheTypes, TestWrite1MUniqueFileStringsDictEncoding) {
   }
 }
 
+// The footer records whether the dictionary filled up, and how many blocks
+// fell back to plain encoding.
+TEST_P(TestCFileBothCacheTypes, TestDictEncodingStats) {
+  const int kNumRows = 100000;
+  BlockId block_id;
+  DuplicateStringDataGenerator<false> duplicates("hello %zu", 256);
+  WriteTestFile(&duplicates, DICT_ENCODING, NO_COMPRESSION, kNumRows, NO_FLAGS, &block_id);
+  {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    const DictEncodingStatsPB& stats = reader->footer().dict_stats();
+    ASSERT_EQ(256, stats.num_dict_entries());
+    ASSERT_GT(stats.num_code_word_blocks(), 0);
+    ASSERT_EQ(0, stats.num_plain_blocks());
+    ASSERT_EQ(0, stats.num_plain_values());
+  }
+
+  StringDataGenerator<false> unique("hello %zu");
+  WriteTestFile(&unique, DICT_ENCODING, NO_COMPRESSION, kNumRows, NO_FLAGS, &block_id);
+  {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    const DictEncodingStatsPB& stats = reader->footer().dict_stats();
+    ASSERT_GT(stats.num_dict_entries(), 0);
+    ASSERT_LT(stats.num_dict_entries(), kNumRows);
+    ASSERT_GT(stats.dict_block_size(), 0);
+    ASSERT_GT(stats.num_code_word_blocks(), 0);
+    ASSERT_GT(stats.num_plain_blocks(), 0);
+    ASSERT_GT(stats.num_plain_values(), 0);
+    ASSERT_LT(stats.num_plain_values(), kNumRows);
+  }
+}
+
 // Write and Read 1 million strings, which contains duplicates with dictionary encoding
 TEST_P(TestCFileBothCacheTypes, TestWrite1MDuplicateFileStringsDictEncoding) {
   BlockId block_id;
@@ -444,6 +667,12 @@ TEST_P(TestCFileBothCacheTypes, TestFixedSizeReadWritePlainEncodingFloat) {
 TEST_P(TestCFileBothCacheTypes, TestFixedSizeReadWritePlainEncodingDouble) {
   TestReadWriteFixedSizeTypes<FPDataGenerator<DOUBLE, false> >(PLAIN_ENCODING);
 }
+TEST_P(TestCFileBothCacheTypes, TestFixedSizeReadWriteXorEncodingFloat) {
+  TestReadWriteFixedSizeTypes<FPDataGenerator<FLOAT, false> >(XOR_ENCODING);
+}
+TEST_P(TestCFileBothCacheTypes, TestFixedSizeReadWriteXorEncodingDouble) {
+  TestReadWriteFixedSizeTypes<FPDataGenerator<DOUBLE, false> >(XOR_ENCODING);
+}
 
 // Test for BitShuffle builder for UINT8, INT8, UINT16, INT16, UINT32, INT32, FLOAT, DOUBLE
 template <typename T>
@@ -466,6 +695,24 @@ TYPED_TEST(BitShuffleTest, TestFixedSizeReadWriteBitShuffle) {
   this->TestBitShuffle();
 }
 
+template <typename T>
+class DeltaOfDeltaTest : public TestCFile {
+  public:
+    void TestDeltaOfDelta() {
+      TestReadWriteFixedSizeTypes<T>(DELTA_OF_DELTA);
+    }
+};
+typedef ::testing::Types<UInt8DataGenerator<false>,
+                         Int8DataGenerator<false>,
+                         UInt16DataGenerator<false>,
+                         Int16DataGenerator<false>,
+                         UInt32DataGenerator<false>,
+                         Int32DataGenerator<false> > DeltaOfDeltaTypes;
+TYPED_TEST_CASE(DeltaOfDeltaTest, DeltaOfDeltaTypes);
+TYPED_TEST(DeltaOfDeltaTest, TestFixedSizeReadWriteDeltaOfDelta) {
+  this->TestDeltaOfDelta();
+}
+
 void EncodeStringKey(const Schema &schema, const Slice& key,
                      gscoped_ptr<EncodedKey> *encoded_key) {
   EncodedKeyBuilder kb(&schema);
@@ -619,6 +866,326 @@ TEST_P(TestCFileBothCacheTypes, TestReadWriteLargeStrings) {
 #endif
 
 // Test that metadata entries stored in the cfile are persisted.
+TEST_P(TestCFileBothCacheTypes, TestDecoderEvalDictStrings) {
+  ColumnSchema col("c", STRING, true);
+  Slice lower("hello 1");
+  Slice upper("hello 2");
+  ColumnPredicate pred = ColumnPredicate::Range(col, &lower, &upper);
+
+  DuplicateStringDataGenerator<false> generator("hello %zu", 256);
+  TestDecoderEval(&generator, DICT_ENCODING, pred);
+
+  DuplicateStringDataGenerator<true> nullable_generator("hello %zu", 256);
+  TestDecoderEval(&nullable_generator, DICT_ENCODING, pred);
+}
+
+TEST_P(TestCFileBothCacheTypes, TestDecoderEvalRleInts) {
+  ColumnSchema col("c", UINT32, true);
+  uint32_t lower = 100;
+  uint32_t upper = 5000;
+  ColumnPredicate pred = ColumnPredicate::Range(col, &lower, &upper);
+
+  UInt32DataGenerator<false> generator;
+  TestDecoderEval(&generator, RLE, pred);
+
+  UInt32DataGenerator<true> nullable_generator;
+  TestDecoderEval(&nullable_generator, RLE, pred);
+}
+
+TEST_P(TestCFileBothCacheTypes, TestSkipUnselectedRows) {
+  for (auto enc : { PLAIN_ENCODING, PREFIX_ENCODING, DICT_ENCODING }) {
+    StringDataGenerator<true> generator("hello %zu");
+    TestSkipUnselectedRows(&generator, enc);
+  }
+  for (auto enc : { PLAIN_ENCODING, RLE, BIT_SHUFFLE, DELTA_OF_DELTA }) {
+    Int32DataGenerator<true> generator;
+    TestSkipUnselectedRows(&generator, enc);
+  }
+  UInt32DataGenerator<false> generator;
+  TestSkipUnselectedRows(&generator, GROUP_VARINT);
+}
+
+TEST_P(TestCFileBothCacheTypes, TestZoneMapSkipping) {
+  // The generated values increase with the row index, so the blocks cover
+  // disjoint ranges of values.
+  ColumnSchema col("c", UINT32, true);
+  uint32_t lower = 20000;
+  uint32_t upper = 30000;
+  ColumnPredicate range = ColumnPredicate::Range(col, &lower, &upper);
+
+  uint32_t values[] = { 100, 50000, 50010, 99990 };
+  vector<const void*> value_ptrs;
+  for (const uint32_t& v : values) {
+    value_ptrs.push_back(&v);
+  }
+  ColumnPredicate in_list = ColumnPredicate::InList(col, &value_ptrs);
+
+  for (auto enc : { PLAIN_ENCODING, RLE, BIT_SHUFFLE, DELTA_OF_DELTA }) {
+    for (const ColumnPredicate* pred : { &range, &in_list }) {
+      SCOPED_TRACE(pred->ToString());
+      UInt32DataGenerator<false> generator;
+      TestZoneMapSkipping(&generator, enc, *pred);
+      UInt32DataGenerator<true> nullable_generator;
+      TestZoneMapSkipping(&nullable_generator, enc, *pred);
+    }
+  }
+}
+
+// The footer holds the zone map of the whole file, which excludes the
+// predicates none of the file's values satisfy.
+TEST_P(TestCFileBothCacheTypes, TestFileZoneMap) {
+  UInt32DataGenerator<true> generator;
+  BlockId block_id;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, 10000, SMALL_BLOCKSIZE, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->footer().has_file_zone_map());
+  ASSERT_EQ(10000, reader->footer().file_zone_map().num_rows());
+  ASSERT_GT(reader->footer().file_zone_map().null_count(), 0);
+
+  // The generated values are the multiples of 10 below 100000.
+  ColumnSchema col("c", UINT32, true);
+  uint32_t lower = 100000;
+  uint32_t upper = 200000;
+  uint32_t mid = 50000;
+  ASSERT_TRUE(reader->FileZoneMapExcludes(ColumnPredicate::Range(col, &lower, &upper)));
+  ASSERT_FALSE(reader->FileZoneMapExcludes(ColumnPredicate::Range(col, &mid, &upper)));
+  ASSERT_FALSE(reader->FileZoneMapExcludes(ColumnPredicate::IsNull(col)));
+}
+
+TEST_P(TestCFileBothCacheTypes, TestValueBloomSkipping) {
+  // Make a false positive, which would fail the test, very unlikely.
+  FLAGS_cfile_value_bloom_fp_rate = 0.0001;
+  const int kNumEntries = 10000;
+  UInt32DataGenerator<true> generator;
+  BlockId block_id;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries,
+                SMALL_BLOCKSIZE | WRITE_VALUE_BLOOM, &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->footer().has_value_bloom_block_ptr());
+
+  // The generated values are the multiples of 10 below 100000, so the values
+  // looked for all fall within the zone map of some block: only the bloom
+  // filter can tell that the odd ones are absent.
+  ColumnSchema col("c", UINT32, true);
+  uint32_t absent = 55555;
+  uint32_t present = 55550;
+  uint32_t other_absent = 12345;
+  vector<const void*> absent_values = { &other_absent, &absent };
+  vector<const void*> mixed_values = { &other_absent, &present };
+  ColumnPredicate absent_eq = ColumnPredicate::Equality(col, &absent);
+  ColumnPredicate absent_in = ColumnPredicate::InList(col, &absent_values);
+  ColumnPredicate present_eq = ColumnPredicate::Equality(col, &present);
+  ColumnPredicate mixed_in = ColumnPredicate::InList(col, &mixed_values);
+
+  for (const ColumnPredicate* pred : { &absent_eq, &absent_in, &present_eq, &mixed_in }) {
+    SCOPED_TRACE(pred->ToString());
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+    ScopedColumnBlock<UINT32> cb(1000);
+    int total_selected = 0;
+    while (iter->HasNext()) {
+      size_t n = cb.nrows();
+      ColumnBlock slice(cb.type_info(), cb.null_bitmap(), cb.data(), n, cb.arena());
+      SelectionVector sel(n);
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, pred, &slice, &sel);
+      ASSERT_OK(iter->PrepareBatch(&ctx, &n));
+      ASSERT_OK(iter->Scan(&ctx));
+      if (!ctx.DecoderEvalSupported()) {
+        pred->Evaluate(slice, &sel);
+      }
+      ASSERT_OK(iter->FinishBatch());
+      total_selected += sel.CountSelected();
+      cb.arena()->Reset();
+    }
+    if (pred == &absent_eq || pred == &absent_in) {
+      ASSERT_EQ(0, total_selected);
+      ASSERT_EQ(0, iter->io_statistics().data_blocks_read_from_disk);
+    } else {
+      ASSERT_EQ(1, total_selected);
+      ASSERT_GT(iter->io_statistics().data_blocks_read_from_disk, 0);
+    }
+  }
+}
+
+// Generates a low-cardinality column: 0 and 6 alternate, except for a run
+// of 3s in rows [6000, 6100).
+class StatusDataGenerator : public DataGenerator<UINT32, false> {
+ public:
+  uint32_t BuildTestValue(size_t block_index, size_t value) OVERRIDE {
+    if (value >= 6000 && value < 6100) {
+      return 3;
+    }
+    return value % 2 == 0 ? 0 : 6;
+  }
+};
+
+TEST_P(TestCFileBothCacheTypes, TestBitmapIndexSkipping) {
+  const int kNumEntries = 10000;
+  StatusDataGenerator generator;
+  BlockId block_id;
+  WriteTestFile(&generator, PLAIN_ENCODING, NO_COMPRESSION, kNumEntries, SMALL_BLOCKSIZE,
+                &block_id);
+
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_TRUE(reader->footer().has_bitmap_index_block_ptr());
+
+  // Every block's zone map covers [0, 6], so only the bitmap index can tell
+  // which blocks hold the 3s, and that none holds a 5.
+  ColumnSchema col("c", UINT32, false);
+  uint32_t rare = 3;
+  uint32_t absent = 5;
+  uint32_t common = 6;
+  vector<const void*> rare_values = { &rare, &absent };
+  ColumnPredicate rare_eq = ColumnPredicate::Equality(col, &rare);
+  ColumnPredicate absent_eq = ColumnPredicate::Equality(col, &absent);
+  ColumnPredicate rare_in = ColumnPredicate::InList(col, &rare_values);
+  ColumnPredicate common_eq = ColumnPredicate::Equality(col, &common);
+
+  int num_blocks = 0;
+  for (const ColumnPredicate* pred : { &common_eq, &rare_eq, &absent_eq, &rare_in }) {
+    SCOPED_TRACE(pred->ToString());
+    gscoped_ptr<CFileIterator> iter;
+    ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+    ASSERT_OK(iter->SeekToOrdinal(0));
+    ScopedColumnBlock<UINT32> cb(1000);
+    int total_selected = 0;
+    while (iter->HasNext()) {
+      size_t n = cb.nrows();
+      ColumnBlock slice(cb.type_info(), cb.null_bitmap(), cb.data(), n, cb.arena());
+      SelectionVector sel(n);
+      sel.SetAllTrue();
+      ColumnMaterializationContext ctx(0, pred, &slice, &sel);
+      ASSERT_OK(iter->PrepareBatch(&ctx, &n));
+      ASSERT_OK(iter->Scan(&ctx));
+      if (!ctx.DecoderEvalSupported()) {
+        pred->Evaluate(slice, &sel);
+      }
+      ASSERT_OK(iter->FinishBatch());
+      total_selected += sel.CountSelected();
+      cb.arena()->Reset();
+    }
+    int blocks_read = iter->io_statistics().data_blocks_read_from_disk;
+    if (pred == &common_eq) {
+      // The odd rows, but for those among the 3s.
+      ASSERT_EQ(kNumEntries / 2 - 50, total_selected);
+      num_blocks = blocks_read;
+    } else if (pred == &absent_eq) {
+      ASSERT_EQ(0, total_selected);
+      ASSERT_EQ(0, blocks_read);
+    } else {
+      // The 100 rows span at most two blocks.
+      ASSERT_EQ(100, total_selected);
+      ASSERT_GT(blocks_read, 0);
+      ASSERT_LE(blocks_read, 2);
+      ASSERT_LT(blocks_read, num_blocks);
+    }
+  }
+}
+
+// Values from the threshold up are stored out of line, but read back like
+// the others, and the zone maps and predicates still see them.
+TEST_P(TestCFileBothCacheTypes, TestOutOfLineValues) {
+  const int kNumEntries = 5000;
+  const size_t kThreshold = 256;
+  // Every 10th row holds a large value, every 7th is NULL.
+  vector<string> values(kNumEntries);
+  uint8_t null_bitmap[BitmapSize(kNumEntries)];
+  vector<Slice> cells(kNumEntries);
+  for (int i = 0; i < kNumEntries; i++) {
+    values[i] = i % 10 == 0 ? StringPrintf("%04d", i) + string(1000, 'x')
+                            : StringPrintf("%04d", i);
+    cells[i] = Slice(values[i]);
+    BitmapChange(null_bitmap, i, i % 7 != 0);
+  }
+
+  for (auto enc : { PLAIN_ENCODING, PREFIX_ENCODING, DICT_ENCODING }) {
+    SCOPED_TRACE(enc);
+    gscoped_ptr<WritableBlock> sink;
+    ASSERT_OK(fs_manager_->CreateNewBlock(&sink));
+    BlockId id = sink->id();
+    WriterOptions opts;
+    opts.write_posidx = true;
+    opts.out_of_line_value_threshold = kThreshold;
+    opts.storage_attributes.cfile_block_size = 1024;
+    opts.storage_attributes.encoding = enc;
+    CFileWriter w(opts, GetTypeInfo(STRING), true, std::move(sink));
+    ASSERT_OK(w.Start());
+    ASSERT_OK(w.AppendNullableEntries(null_bitmap, &cells[0], kNumEntries));
+    ASSERT_OK(w.Finish());
+
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(fs_manager_->OpenBlock(id, &block));
+    gscoped_ptr<CFileReader> reader;
+    ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+    ASSERT_TRUE(reader->has_out_of_line_values());
+
+    // A scan of every row reads all the values.
+    {
+      gscoped_ptr<CFileIterator> iter;
+      ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+      ASSERT_OK(iter->SeekToOrdinal(0));
+      ScopedColumnBlock<STRING> cb(1000);
+      int row = 0;
+      while (iter->HasNext()) {
+        size_t n = cb.nrows();
+        ASSERT_OK_FAST(iter->CopyNextValues(&n, &cb));
+        for (int i = 0; i < n; i++, row++) {
+          ASSERT_EQ(row % 7 != 0, !cb.is_null(i)) << row;
+          if (row % 7 != 0) {
+            ASSERT_EQ(values[row], cb[i].ToString()) << row;
+          }
+        }
+        cb.arena()->Reset();
+      }
+      ASSERT_EQ(kNumEntries, row);
+    }
+
+    // A predicate is evaluated against the large values, not the cells left
+    // in their place.
+    ColumnSchema col("c", STRING, true);
+    Slice large(values[4990]);
+    Slice empty("");
+    ColumnPredicate large_eq = ColumnPredicate::Equality(col, &large);
+    ColumnPredicate empty_eq = ColumnPredicate::Equality(col, &empty);
+    for (const ColumnPredicate* pred : { &large_eq, &empty_eq }) {
+      SCOPED_TRACE(pred->ToString());
+      gscoped_ptr<CFileIterator> iter;
+      ASSERT_OK(reader->NewIterator(&iter, CFileReader::CACHE_BLOCK));
+      ASSERT_OK(iter->SeekToOrdinal(0));
+      ScopedColumnBlock<STRING> cb(1000);
+      int total_selected = 0;
+      while (iter->HasNext()) {
+        size_t n = cb.nrows();
+        ColumnBlock slice(cb.type_info(), cb.null_bitmap(), cb.data(), n, cb.arena());
+        SelectionVector sel(n);
+        sel.SetAllTrue();
+        ColumnMaterializationContext ctx(0, pred, &slice, &sel);
+        ASSERT_OK(iter->PrepareBatch(&ctx, &n));
+        ASSERT_OK(iter->Scan(&ctx));
+        ASSERT_FALSE(ctx.DecoderEvalSupported());
+        pred->Evaluate(slice, &sel);
+        ASSERT_OK(iter->FinishBatch());
+        total_selected += sel.CountSelected();
+        cb.arena()->Reset();
+      }
+      ASSERT_EQ(pred == &large_eq ? 1 : 0, total_selected);
+    }
+  }
+}
+
 TEST_P(TestCFileBothCacheTypes, TestMetadata) {
   BlockId block_id;
 
@@ -814,6 +1381,43 @@ TEST_P(TestCFileBothCacheTypes, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+// Tests that a reader opened with 'pin_validx' keeps every block of the
+// value index in memory, accounted to its MemTracker, and seeks through them.
+TEST_P(TestCFileBothCacheTypes, TestPinValidx) {
+  BlockId block_id;
+  {
+    const int nrows = 10000;
+    StringDataGenerator<false> generator("hello %04d");
+    WriteTestFile(&generator, PREFIX_ENCODING, NO_COMPRESSION, nrows,
+                  SMALL_BLOCKSIZE | WRITE_VALIDX, &block_id);
+  }
+
+  shared_ptr<MemTracker> tracker = MemTracker::CreateTracker(-1, "test");
+  ReaderOptions opts;
+  opts.parent_mem_tracker = tracker;
+  opts.pin_validx = true;
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  gscoped_ptr<CFileReader> reader;
+  ASSERT_OK(CFileReader::Open(std::move(block), opts, &reader));
+  ASSERT_GT(reader->pinned_validx_bytes(), 0);
+  ASSERT_FALSE(reader->pinned_validx_block(reader->validx_root()).empty());
+  ASSERT_GE(tracker->consumption(), reader->pinned_validx_bytes());
+  ASSERT_EQ(tracker->consumption(), reader->memory_consumption());
+
+  gscoped_ptr<IndexTreeIterator> iter(
+      IndexTreeIterator::Create(reader.get(), reader->validx_root()));
+  ASSERT_OK(iter->SeekAtOrBefore(Slice("hello 5000")));
+  ASSERT_LE(iter->GetCurrentKey().compare(Slice("hello 5000")), 0);
+
+  // A reader without the option only pins the root.
+  size_t all_pinned_bytes = reader->pinned_validx_bytes();
+  ASSERT_OK(fs_manager_->OpenBlock(block_id, &block));
+  ASSERT_OK(CFileReader::Open(std::move(block), ReaderOptions(), &reader));
+  ASSERT_GT(reader->pinned_validx_bytes(), 0);
+  ASSERT_LT(reader->pinned_validx_bytes(), all_pinned_bytes);
+}
+
 // Tests that the block cache keys used by CFileReaders are stable. That is,
 // different reader instances operating on the same block should use the same
 // block cache keys.
@@ -857,6 +1461,31 @@ TEST_P(TestCFileBothCacheTypes, TestCacheKeysAreStable) {
   }
 }
 
+// Scan files with readahead enabled, so that sequential scans hint the
+// underlying block to read ahead and seeks reset the detection.
+TEST_P(TestCFileBothCacheTypes, TestReadahead) {
+  FLAGS_cfile_readahead_kb = 64;
+  TestReadWriteFixedSizeTypes<UInt32DataGenerator<false> >(PLAIN_ENCODING);
+  TestReadWriteFixedSizeTypes<Int32DataGenerator<true> >(BIT_SHUFFLE);
+}
+
+// Read compressed files back through a block cache that keeps compressed
+// blocks, either alongside uncompressed ones or instead of them.
+TEST_P(TestCFileBothCacheTypes, TestCompressedBlockCache) {
+  for (double fraction : { 0.5, 1.0 }) {
+    SCOPED_TRACE(fraction);
+    FLAGS_block_cache_compressed_fraction = fraction;
+    Singleton<BlockCache>::UnsafeReset();
+    ASSERT_TRUE(BlockCache::GetSingleton()->caches_compressed_blocks());
+
+    UInt32DataGenerator<true> int_generator;
+    TestNullTypes(&int_generator, GROUP_VARINT, LZ4);
+    StringDataGenerator<true> string_generator("hello %zu");
+    TestNullTypes(&string_generator, DICT_ENCODING, ZLIB);
+    TestReadWriteRawBlocks(SNAPPY, 1000);
+  }
+}
+
 #if defined(__linux__)
 // Inject failures in nvm allocation and ensure that we can still read a file.
 TEST_P(TestCFileBothCacheTypes, TestNvmAllocationFailure) {
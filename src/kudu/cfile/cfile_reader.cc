@@ -25,20 +25,26 @@
 #include "kudu/cfile/block_handle.h"
 #include "kudu/cfile/block_pointer.h"
 #include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h" // for kMagicString
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/cfile/binary_plain_block.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/object_pool.h"
+#include "kudu/util/pb_util.h"
 #include "kudu/util/rle-encoding.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
@@ -48,6 +54,39 @@ DEFINE_bool(cfile_lazy_open, true,
             "Allow lazily opening of cfiles");
 TAG_FLAG(cfile_lazy_open, hidden);
 
+DEFINE_bool(cfile_use_zone_maps, true,
+            "Whether to use the per-block zone maps of cfiles to skip data blocks "
+            "which can't match a scan's predicates");
+TAG_FLAG(cfile_use_zone_maps, hidden);
+TAG_FLAG(cfile_use_zone_maps, runtime);
+
+DEFINE_int32(cfile_readahead_kb, 0,
+             "Amount of data, in KB, to read ahead of a CFileIterator once it "
+             "is scanning data blocks sequentially. Set to 0 to disable "
+             "readahead.");
+TAG_FLAG(cfile_readahead_kb, experimental);
+TAG_FLAG(cfile_readahead_kb, runtime);
+
+DEFINE_int32(cfile_readahead_min_sequential_blocks, 2,
+             "Number of consecutive data blocks a CFileIterator must read in "
+             "file order before it begins to read ahead.");
+TAG_FLAG(cfile_readahead_min_sequential_blocks, experimental);
+TAG_FLAG(cfile_readahead_min_sequential_blocks, runtime);
+
+DEFINE_bool(cfile_pin_validx_root, true,
+            "Whether to keep the root block of the value-based index of each cfile, "
+            "such as the key index of a rowset, in memory once the file is opened. "
+            "Seeks by key, such as the presence checks of inserts, then only read "
+            "the index blocks below the root.");
+TAG_FLAG(cfile_pin_validx_root, advanced);
+
+DEFINE_bool(cfile_invalidate_uncached_reads, false,
+            "Drop data blocks read without caching them (e.g. by compactions) "
+            "from the OS page cache after reading them, so that background "
+            "work doesn't displace data being read by scans.");
+TAG_FLAG(cfile_invalidate_uncached_reads, experimental);
+TAG_FLAG(cfile_invalidate_uncached_reads, runtime);
+
 using kudu::fs::ReadableBlock;
 using strings::Substitute;
 
@@ -63,6 +102,10 @@ static const size_t kMaxHeaderFooterPBSize = 64*1024;
 
 static const size_t kBlockSizeLimit = 16 * 1024 * 1024; // 16MB
 
+// Runs of unselected rows shorter than this are decoded rather than seeked
+// over when skipping unselected rows, since the seek costs more than it saves.
+static const size_t kMinRowsToSkip = 8;
+
 static Status ParseMagicAndLength(const Slice &data,
                                   uint32_t *parsed_len) {
   if (data.size() != kMagicAndLengthSize) {
@@ -86,6 +129,8 @@ CFileReader::CFileReader(const ReaderOptions &options,
                          gscoped_ptr<ReadableBlock> block) :
   block_(std::move(block)),
   file_size_(file_size),
+  pin_validx_(options.pin_validx),
+  pinned_validx_bytes_(0),
   mem_consumption_(options.parent_mem_tracker, memory_footprint()) {
 }
 
@@ -153,7 +198,61 @@ Status CFileReader::InitOnce() {
 }
 
 Status CFileReader::Init() {
-  return init_once_.Init(&CFileReader::InitOnce, this);
+  RETURN_NOT_OK(init_once_.Init(&CFileReader::InitOnce, this));
+  return pin_validx_once_.Init(&CFileReader::PinValidxOnce, this);
+}
+
+Status CFileReader::PinValidxOnce() {
+  if (!has_validx() || !(pin_validx_ || FLAGS_cfile_pin_validx_root)) {
+    return Status::OK();
+  }
+
+  // Read the index top-down, the leaves included if the whole of it is to be
+  // pinned. The data blocks they point to aren't pinned.
+  vector<BlockPointer> to_pin = { validx_root() };
+  while (!to_pin.empty()) {
+    BlockPointer ptr = to_pin.back();
+    to_pin.pop_back();
+    BlockHandle block;
+    RETURN_NOT_OK_PREPEND(ReadBlock(ptr, DONT_CACHE_BLOCK, &block),
+                          "unable to read value index block");
+    string* pinned = &pinned_validx_blocks_[ptr.offset()];
+    pinned->assign(reinterpret_cast<const char*>(block.data().data()), block.data().size());
+    pinned_validx_bytes_ += pinned->size();
+    if (!pin_validx_) {
+      break;
+    }
+
+    IndexBlockReader reader;
+    RETURN_NOT_OK(reader.Parse(Slice(*pinned)));
+    if (reader.IsLeaf()) {
+      continue;
+    }
+    gscoped_ptr<IndexBlockIterator> iter(reader.NewIterator());
+    for (size_t i = 0; i < reader.Count(); i++) {
+      RETURN_NOT_OK(i == 0 ? iter->SeekToIndex(0) : iter->Next());
+      to_pin.push_back(iter->GetCurrentBlockPointer());
+    }
+  }
+  mem_consumption_.Reset(memory_footprint());
+  return Status::OK();
+}
+
+Slice CFileReader::pinned_validx_block(const BlockPointer& ptr) const {
+  if (!pin_validx_once_.initted()) {
+    return Slice();
+  }
+  const string* pinned = FindOrNull(pinned_validx_blocks_, ptr.offset());
+  return pinned ? Slice(*pinned) : Slice();
+}
+
+size_t CFileReader::pinned_validx_bytes() const {
+  return pin_validx_once_.initted() ? pinned_validx_bytes_ : 0;
+}
+
+int64_t CFileReader::memory_consumption() const {
+  // The consumption only changes while initializing the file.
+  return pin_validx_once_.initted() ? mem_consumption_.consumption() : 0;
 }
 
 Status CFileReader::ReadAndParseHeader() {
@@ -244,13 +343,14 @@ class ScratchMemory {
     }
   }
 
-  // Try to allocate 'size' bytes from the cache. If the cache has
-  // no capacity and cannot evict to make room, this will fall back
-  // to allocating from the heap. In that case, IsFromCache() will
-  // return false.
-  void TryAllocateFromCache(BlockCache* cache, const BlockCache::CacheKey& key, int size) {
+  // Try to allocate 'size' bytes from the cache share for blocks of 'type'.
+  // If the cache has no such share, or no capacity and cannot evict to make
+  // room, this will fall back to allocating from the heap. In that case,
+  // IsFromCache() will return false.
+  void TryAllocateFromCache(BlockCache* cache, const BlockCache::CacheKey& key, int size,
+                            BlockCache::EntryType type = BlockCache::UNCOMPRESSED) {
     DCHECK(!ptr_);
-    from_cache_ = cache->Allocate(key, size);
+    from_cache_ = cache->Allocate(key, size, type);
     if (!from_cache_.valid()) {
       AllocateFromHeap(size);
       return;
@@ -327,30 +427,50 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     return Status::OK();
   }
 
-  // Cache miss: need to read ourselves.
-  // We issue trace events only in the cache miss case since we expect the
-  // tracing overhead to be small compared to the IO (even if it's a memcpy
-  // from the Linux cache).
-  TRACE_EVENT1("io", "CFileReader::ReadBlock(cache miss)",
-               "cfile", ToString());
-  TRACE_COUNTER_INCREMENT("cfile_cache_miss", 1);
-  TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
-
+  // If the block cache keeps compressed blocks, the on-disk form of this
+  // block may still be cached even though its uncompressed form is not.
+  bool cache_compressed = block_uncompressor_ != nullptr &&
+      cache_control == CACHE_BLOCK && cache->caches_compressed_blocks();
+  BlockCacheHandle compressed_handle;
   ScratchMemory scratch;
-  // If we are reading uncompressed data and plan to cache the result,
-  // then we should allocate our scratch memory directly from the cache.
-  // This avoids an extra memory copy in the case of an NVM cache.
-  if (block_uncompressor_ == nullptr && cache_control == CACHE_BLOCK) {
-    scratch.TryAllocateFromCache(cache, key, ptr.size());
+  uint8_t* buf;
+  Slice block;
+  if (cache_compressed &&
+      cache->Lookup(key, cache_behavior, &compressed_handle, BlockCache::COMPRESSED)) {
+    TRACE_COUNTER_INCREMENT("cfile_compressed_cache_hit", 1);
+    block = compressed_handle.data();
+    buf = nullptr;
   } else {
-    scratch.AllocateFromHeap(ptr.size());
-  }
-  uint8_t* buf = scratch.get();
+    // Cache miss: need to read ourselves.
+    // We issue trace events only in the cache miss case since we expect the
+    // tracing overhead to be small compared to the IO (even if it's a memcpy
+    // from the Linux cache).
+    TRACE_EVENT1("io", "CFileReader::ReadBlock(cache miss)",
+                 "cfile", ToString());
+    TRACE_COUNTER_INCREMENT("cfile_cache_miss", 1);
+    TRACE_COUNTER_INCREMENT(CFILE_CACHE_MISS_BYTES_METRIC_NAME, ptr.size());
+
+    // If we are reading uncompressed data and plan to cache the result,
+    // then we should allocate our scratch memory directly from the cache.
+    // This avoids an extra memory copy in the case of an NVM cache. The same
+    // goes for compressed data when its on-disk form is cached.
+    if (block_uncompressor_ == nullptr && cache_control == CACHE_BLOCK) {
+      scratch.TryAllocateFromCache(cache, key, ptr.size());
+    } else if (cache_compressed) {
+      scratch.TryAllocateFromCache(cache, key, ptr.size(), BlockCache::COMPRESSED);
+    } else {
+      scratch.AllocateFromHeap(ptr.size());
+    }
+    buf = scratch.get();
 
-  Slice block;
-  RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, buf));
-  if (block.size() != ptr.size()) {
-    return Status::IOError("Could not read full block length");
+    RETURN_NOT_OK(block_->Read(ptr.offset(), ptr.size(), &block, buf));
+    if (block.size() != ptr.size()) {
+      return Status::IOError("Could not read full block length");
+    }
+    if (cache_control == DONT_CACHE_BLOCK && FLAGS_cfile_invalidate_uncached_reads) {
+      WARN_NOT_OK(block_->InvalidateCache(ptr.offset(), ptr.size()),
+                  Substitute("Could not invalidate cache of cfile $0", ToString()));
+    }
   }
 
   // Decompress the block
@@ -365,6 +485,14 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
       return s;
     }
 
+    // The compressed block is intact, so it's safe to cache it. The handle
+    // keeps it pinned until we're done decompressing below.
+    if (scratch.IsFromCache()) {
+      block.relocate(buf);
+      cache->Insert(scratch.mutable_pending_entry(), &compressed_handle);
+      ignore_result(scratch.release());
+    }
+
     // If we plan to put the uncompressed block in the cache, we should
     // decompress directly into the cache's memory (to avoid a memcpy for NVM).
     ScratchMemory decompressed_scratch;
@@ -385,6 +513,7 @@ Status CFileReader::ReadBlock(const BlockPointer &ptr, CacheControl cache_contro
     // scratch buffer. Instead, we have to start holding onto our decompression
     // output buffer.
     scratch.Swap(&decompressed_scratch);
+    buf = scratch.get();
 
     // Set the result block to our decompressed data.
     block = Slice(buf, uncompressed_size);
@@ -425,6 +554,30 @@ Status CFileReader::CountRows(rowid_t *count) const {
   return Status::OK();
 }
 
+Status CFileReader::ReadZoneMaps(gscoped_ptr<CFileZoneMapsPB>* zone_maps) const {
+  zone_maps->reset();
+  if (!footer().has_zone_maps_block_ptr()) {
+    return Status::OK();
+  }
+  BlockPointer bp(footer().zone_maps_block_ptr());
+  BlockHandle handle;
+  RETURN_NOT_OK_PREPEND(ReadBlock(bp, CACHE_BLOCK, &handle),
+                        "Couldn't read zone maps block");
+  gscoped_ptr<CFileZoneMapsPB> pb(new CFileZoneMapsPB());
+  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(pb.get(), handle.data().data(),
+                                                handle.data().size()),
+                        "Couldn't parse zone maps block");
+  zone_maps->swap(pb);
+  return Status::OK();
+}
+
+bool CFileReader::FileZoneMapExcludes(const ColumnPredicate& pred) const {
+  if (!FLAGS_cfile_use_zone_maps || !footer().has_file_zone_map()) {
+    return false;
+  }
+  return CFileIterator::ZoneMapExcludes(pred, footer().file_zone_map());
+}
+
 bool CFileReader::GetMetadataEntry(const string &key, string *val) {
   for (const FileMetadataPairPB &pair : header().metadata()) {
     if (pair.key() == key) {
@@ -441,6 +594,52 @@ bool CFileReader::GetMetadataEntry(const string &key, string *val) {
   return false;
 }
 
+Status CFileReader::WarmBlock(uint64_t offset, uint64_t cached_size) const {
+  DCHECK(init_once_.initted());
+  // A compressed block is cached uncompressed, so its size on disk is read
+  // from its header.
+  uint64_t size = cached_size;
+  if (block_uncompressor_ != nullptr) {
+    uint8_t header_buf[CompressedBlockBuilder::kHeaderReservedLength];
+    if (offset + sizeof(header_buf) >= file_size_) {
+      return Status::Corruption("block header is past the end of the file",
+                                ToString());
+    }
+    Slice header;
+    RETURN_NOT_OK(block_->Read(offset, sizeof(header_buf), &header, header_buf));
+    size = CompressedBlockBuilder::kHeaderReservedLength + DecodeFixed32(header.data());
+  }
+  if (offset == 0 || offset + size >= file_size_) {
+    return Status::Corruption(Substitute("bad block at offset $0 of size $1", offset, size),
+                              ToString());
+  }
+  BlockHandle handle;
+  return ReadBlock(BlockPointer(offset, size), CACHE_BLOCK, &handle);
+}
+
+Status CFileReader::Readahead(uint64_t offset, uint64_t length) const {
+  if (offset >= file_size_) {
+    return Status::OK();
+  }
+  length = std::min(length, file_size_ - offset);
+  return block_->Readahead(offset, length);
+}
+
+Status CFileReader::PrefetchBlock(const BlockPointer& ptr, CacheControl cache_control) const {
+  DCHECK(init_once_.initted());
+  if (cache_control == CACHE_BLOCK) {
+    BlockCache* cache = BlockCache::GetSingleton();
+    BlockCache::CacheKey key(block_->id(), ptr.offset());
+    BlockCacheHandle handle;
+    if (cache->Lookup(key, Cache::NO_EXPECT_IN_CACHE, &handle) ||
+        (block_uncompressor_ != nullptr && cache->caches_compressed_blocks() &&
+         cache->Lookup(key, Cache::NO_EXPECT_IN_CACHE, &handle, BlockCache::COMPRESSED))) {
+      return Status::OK();
+    }
+  }
+  return Readahead(ptr.offset(), ptr.size());
+}
+
 Status CFileReader::NewIterator(CFileIterator **iter, CacheControl cache_control) {
   *iter = new CFileIterator(this, cache_control);
   return Status::OK();
@@ -463,6 +662,9 @@ size_t CFileReader::memory_footprint() const {
   if (block_uncompressor_) {
     size += kudu_malloc_usable_size(block_uncompressor_.get());
   }
+  for (const auto& entry : pinned_validx_blocks_) {
+    size += entry.second.capacity();
+  }
   return size;
 }
 
@@ -514,16 +716,38 @@ Status DefaultColumnValueIterator::FinishBatch() {
 CFileIterator::CFileIterator(CFileReader* reader,
                              CFileReader::CacheControl cache_control)
   : reader_(reader),
+    codewords_pred_(nullptr),
+    zone_maps_loaded_(false),
+    value_bloom_pred_(nullptr),
+    value_bloom_excludes_(false),
+    bitmap_index_pred_(nullptr),
+    bitmap_index_applies_(false),
     seeked_(nullptr),
     prepared_(false),
     cache_control_(cache_control),
     last_prepare_idx_(-1),
-    last_prepare_count_(-1) {
+    last_prepare_count_(-1),
+    last_read_end_(0),
+    sequential_reads_(0),
+    readahead_end_(0) {
 }
 
 CFileIterator::~CFileIterator() {
 }
 
+Status CFileIterator::PrefetchOrdinal(rowid_t ord_idx) {
+  DCHECK(!seeked());
+  RETURN_NOT_OK(PrepareForNewSeek());
+  if (PREDICT_FALSE(posidx_iter_ == nullptr)) {
+    return Status::OK();
+  }
+
+  tmp_buf_.clear();
+  KeyEncoderTraits<UINT32, faststring>::Encode(ord_idx, &tmp_buf_);
+  RETURN_NOT_OK(posidx_iter_->SeekAtOrBefore(Slice(tmp_buf_)));
+  return reader_->PrefetchBlock(posidx_iter_->GetCurrentBlockPointer(), cache_control_);
+}
+
 Status CFileIterator::SeekToOrdinal(rowid_t ord_idx) {
   RETURN_NOT_OK(PrepareForNewSeek());
   if (PREDICT_FALSE(posidx_iter_ == nullptr)) {
@@ -750,6 +974,42 @@ Status DecodeNullInfo(Slice *data_block, uint32_t *num_rows_in_block, Slice *nul
 Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                                            PreparedBlock *prep_block) {
   prep_block->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
+  return ReadDataBlock(prep_block);
+}
+
+void CFileIterator::MaybeReadahead(const BlockPointer& ptr) {
+  uint64_t window = static_cast<uint64_t>(FLAGS_cfile_readahead_kb) * 1024;
+  uint64_t offset = ptr.offset();
+  uint64_t end = offset + ptr.size();
+
+  // A block which starts at or shortly after the last one ended (e.g. past a
+  // block skipped by its zone map) continues a sequential scan; anything else
+  // means the access pattern turned random, so stop reading ahead.
+  if (offset >= last_read_end_ && offset - last_read_end_ <= window) {
+    sequential_reads_++;
+  } else {
+    sequential_reads_ = 0;
+    readahead_end_ = 0;
+  }
+  last_read_end_ = end;
+
+  if (window == 0 || sequential_reads_ < FLAGS_cfile_readahead_min_sequential_blocks) {
+    return;
+  }
+
+  // Only issue a new hint once the scan has consumed half of the last one,
+  // so that sequential scans don't issue a syscall per block.
+  if (readahead_end_ >= end + window / 2) {
+    return;
+  }
+  uint64_t start = std::max(readahead_end_, end);
+  WARN_NOT_OK(reader_->Readahead(start, end + window - start),
+              Substitute("Could not read ahead in cfile $0", reader_->ToString()));
+  readahead_end_ = end + window;
+}
+
+Status CFileIterator::ReadDataBlock(PreparedBlock *prep_block) {
+  MaybeReadahead(prep_block->dblk_ptr_);
   RETURN_NOT_OK(reader_->ReadBlock(prep_block->dblk_ptr_, cache_control_, &prep_block->dblk_data_));
 
   uint32_t num_rows_in_block = 0;
@@ -776,23 +1036,272 @@ Status CFileIterator::ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
   io_stats_.data_blocks_read_from_disk++;
   io_stats_.bytes_read_from_disk += data_block.size();
 
+  prep_block->first_row_idx_ = bd->GetFirstRowId();
   prep_block->idx_in_block_ = 0;
   prep_block->num_rows_in_block_ = num_rows_in_block;
   prep_block->needs_rewind_ = false;
   prep_block->rewind_idx_ = 0;
+  prep_block->skipped_ = false;
 
   DVLOG(2) << "Read dblk " << prep_block->ToString();
   return Status::OK();
 }
 
-Status CFileIterator::QueueCurrentDataBlock(const IndexTreeIterator &idx_iter) {
+Status CFileIterator::ReadSkippedDataBlock(PreparedBlock *prep_block) {
+  DCHECK(prep_block->skipped_);
+  uint32_t idx_in_block = prep_block->idx_in_block_;
+  bool needs_rewind = prep_block->needs_rewind_;
+  uint32_t rewind_idx = prep_block->rewind_idx_;
+
+  RETURN_NOT_OK(ReadDataBlock(prep_block));
+  SeekToPositionInBlock(prep_block, idx_in_block);
+  prep_block->needs_rewind_ = needs_rewind;
+  prep_block->rewind_idx_ = rewind_idx;
+  return Status::OK();
+}
+
+Status CFileIterator::QueueCurrentDataBlock(const IndexTreeIterator &idx_iter,
+                                            const ColumnPredicate *pred) {
   pblock_pool_scoped_ptr b = prepared_block_pool_.make_scoped_ptr(
     prepared_block_pool_.Construct());
-  RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
+  int zone_map_idx = -1;
+  if (pred != nullptr) {
+    zone_map_idx = FindZoneMap(idx_iter.GetCurrentBlockPointer());
+  }
+  if (zone_map_idx >= 0 && BlockExcluded(*pred, zone_map_idx)) {
+    // None of the rows of this block can match: skip reading it.
+    const BlockZoneMapPB& zone_map = zone_maps_->blocks(zone_map_idx);
+    b->dblk_ptr_ = idx_iter.GetCurrentBlockPointer();
+    b->first_row_idx_ = zone_map.first_row();
+    b->idx_in_block_ = 0;
+    b->num_rows_in_block_ = zone_map.num_rows();
+    b->needs_rewind_ = false;
+    b->rewind_idx_ = 0;
+    b->skipped_ = true;
+    DVLOG(2) << "Skipped dblk " << b->ToString();
+  } else {
+    RETURN_NOT_OK(ReadCurrentDataBlock(idx_iter, b.get()));
+  }
   prepared_blocks_.push_back(b.release());
   return Status::OK();
 }
 
+Status CFileIterator::LoadZoneMaps() {
+  if (zone_maps_loaded_) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(reader_->ReadZoneMaps(&zone_maps_));
+  // The bitmap index refers to the data blocks by their zone maps, so it is
+  // of no use without them.
+  if (zone_maps_ != nullptr && reader_->footer().has_bitmap_index_block_ptr()) {
+    BlockPointer bp(reader_->footer().bitmap_index_block_ptr());
+    BlockHandle handle;
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &handle),
+                          "Couldn't read bitmap index block");
+    gscoped_ptr<CFileBitmapIndexPB> bitmap_index(new CFileBitmapIndexPB());
+    RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(bitmap_index.get(), handle.data().data(),
+                                                  handle.data().size()),
+                          "Couldn't parse bitmap index block");
+    bitmap_index_.swap(bitmap_index);
+  }
+  zone_maps_loaded_ = true;
+  return Status::OK();
+}
+
+int CFileIterator::FindZoneMap(const BlockPointer& ptr) const {
+  DCHECK(zone_maps_ != nullptr);
+  const auto& blocks = zone_maps_->blocks();
+  auto it = std::lower_bound(blocks.begin(), blocks.end(), ptr.offset(),
+                             [](const BlockZoneMapPB& zm, uint64_t offset) {
+                               return zm.block_offset() < offset;
+                             });
+  if (it == blocks.end() || it->block_offset() != ptr.offset()) {
+    return -1;
+  }
+  return it - blocks.begin();
+}
+
+namespace {
+
+// A cell holding a min or max value from a zone map.
+class ZoneMapCell {
+ public:
+  ZoneMapCell(const TypeInfo* type, const string& value)
+      : valid_(true) {
+    if (type->physical_type() == BINARY) {
+      slice_ = Slice(value);
+      cell_ = &slice_;
+    } else if (value.size() == type->size() && value.size() <= sizeof(fixed_)) {
+      memcpy(fixed_, value.data(), value.size());
+      cell_ = fixed_;
+    } else {
+      valid_ = false;
+      cell_ = nullptr;
+    }
+  }
+
+  bool valid() const { return valid_; }
+  const void* cell() const { return cell_; }
+
+ private:
+  bool valid_;
+  const void* cell_;
+  Slice slice_;
+  uint64_t fixed_[2];
+
+  DISALLOW_COPY_AND_ASSIGN(ZoneMapCell);
+};
+
+} // anonymous namespace
+
+bool CFileIterator::ZoneMapExcludes(const ColumnPredicate& pred,
+                                    const BlockZoneMapPB& zone_map) {
+  bool all_null = zone_map.null_count() >= zone_map.num_rows();
+  switch (pred.predicate_type()) {
+    case PredicateType::None: return true;
+    case PredicateType::IsNotNull: return all_null;
+    case PredicateType::IsNull: return zone_map.null_count() == 0;
+    case PredicateType::Equality:
+    case PredicateType::Range:
+    case PredicateType::InList: break;
+  }
+
+  // The remaining predicates are never satisfied by NULLs.
+  if (all_null) return true;
+  if (!zone_map.has_min_value() || !zone_map.has_max_value()) return false;
+
+  const TypeInfo* type = pred.column().type_info();
+  ZoneMapCell min(type, zone_map.min_value());
+  ZoneMapCell max(type, zone_map.max_value());
+  if (!min.valid() || !max.valid()) return false;
+
+  switch (pred.predicate_type()) {
+    case PredicateType::Equality:
+      return type->Compare(pred.raw_lower(), min.cell()) < 0 ||
+             type->Compare(pred.raw_lower(), max.cell()) > 0;
+    case PredicateType::Range:
+      return (pred.raw_lower() != nullptr && type->Compare(max.cell(), pred.raw_lower()) < 0) ||
+             (pred.raw_upper() != nullptr && type->Compare(min.cell(), pred.raw_upper()) >= 0);
+    case PredicateType::InList: {
+      // The values are sorted: find the first one which is at least the min.
+      const vector<const void*>& values = pred.raw_values();
+      auto it = std::lower_bound(values.begin(), values.end(), min.cell(),
+                                 [&](const void* lhs, const void* rhs) {
+                                   return type->Compare(lhs, rhs) < 0;
+                                 });
+      return it == values.end() || type->Compare(*it, max.cell()) > 0;
+    }
+    default: break;
+  }
+  LOG(FATAL) << "unknown predicate type";
+  return false;
+}
+
+Status CFileIterator::CheckValueBloom(const ColumnPredicate& pred) {
+  if (value_bloom_pred_ == &pred) {
+    return Status::OK();
+  }
+  value_bloom_pred_ = &pred;
+  value_bloom_excludes_ = false;
+  if (!reader_->footer().has_value_bloom_block_ptr() ||
+      (pred.predicate_type() != PredicateType::Equality &&
+       pred.predicate_type() != PredicateType::InList)) {
+    return Status::OK();
+  }
+
+  if (value_bloom_ == nullptr) {
+    BlockPointer bp(reader_->footer().value_bloom_block_ptr());
+    BlockHandle handle;
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &handle),
+                          "Couldn't read value bloom block");
+    gscoped_ptr<CFileValueBloomPB> value_bloom(new CFileValueBloomPB());
+    RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(value_bloom.get(), handle.data().data(),
+                                                  handle.data().size()),
+                          "Couldn't parse value bloom block");
+    value_bloom_.swap(value_bloom);
+  }
+
+  BloomFilter bloom(Slice(value_bloom_->bitmap()), value_bloom_->num_hash_functions());
+  const TypeInfo* type = pred.column().type_info();
+  auto may_contain = [&](const void* value) {
+    uint64_t hash = HashValueForBloom(type, value);
+    return bloom.MayContainKey(
+        BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&hash), sizeof(hash))));
+  };
+  if (pred.predicate_type() == PredicateType::Equality) {
+    value_bloom_excludes_ = !may_contain(pred.raw_lower());
+  } else {
+    value_bloom_excludes_ = std::none_of(pred.raw_values().begin(), pred.raw_values().end(),
+                                         may_contain);
+  }
+  if (value_bloom_excludes_) {
+    VLOG(2) << "Value bloom filter excludes " << pred.ToString() << " from "
+            << reader_->ToString();
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::CheckBitmapIndex(const ColumnPredicate& pred) {
+  if (bitmap_index_pred_ == &pred) {
+    return Status::OK();
+  }
+  bitmap_index_pred_ = &pred;
+  bitmap_index_applies_ = false;
+  bitmap_index_blocks_.clear();
+  if (bitmap_index_ == nullptr ||
+      (pred.predicate_type() != PredicateType::Equality &&
+       pred.predicate_type() != PredicateType::InList)) {
+    return Status::OK();
+  }
+
+  // The index holds every distinct value of the file, so the blocks holding
+  // a value which it doesn't have are none at all.
+  const TypeInfo* type = pred.column().type_info();
+  vector<const void*> eq_value;
+  if (pred.predicate_type() == PredicateType::Equality) {
+    eq_value.push_back(pred.raw_lower());
+  }
+  const vector<const void*>& values =
+      pred.predicate_type() == PredicateType::Equality ? eq_value : pred.raw_values();
+  for (const auto& entry : bitmap_index_->entries()) {
+    ZoneMapCell cell(type, entry.value());
+    if (!cell.valid()) {
+      return Status::Corruption("invalid value in bitmap index", reader_->ToString());
+    }
+    bool matches = std::any_of(values.begin(), values.end(), [&](const void* value) {
+      return type->Compare(value, cell.cell()) == 0;
+    });
+    if (!matches) {
+      continue;
+    }
+    const string& blocks = entry.blocks();
+    if (bitmap_index_blocks_.size() < blocks.size()) {
+      bitmap_index_blocks_.resize(blocks.size(), '\0');
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+      bitmap_index_blocks_[i] |= blocks[i];
+    }
+  }
+  bitmap_index_applies_ = true;
+  return Status::OK();
+}
+
+bool CFileIterator::BlockExcluded(const ColumnPredicate& pred, int zone_map_idx) const {
+  // NULLs never satisfy the predicates which the bloom filter and the bitmap
+  // index are checked for, so they exclude blocks whether or not they hold
+  // NULLs.
+  if (value_bloom_pred_ == &pred && value_bloom_excludes_) {
+    return true;
+  }
+  if (bitmap_index_pred_ == &pred && bitmap_index_applies_ &&
+      (static_cast<size_t>(zone_map_idx) >= bitmap_index_blocks_.size() * 8 ||
+       !BitmapTest(reinterpret_cast<const uint8_t*>(bitmap_index_blocks_.data()),
+                   zone_map_idx))) {
+    return true;
+  }
+  return ZoneMapExcludes(pred, zone_maps_->blocks(zone_map_idx));
+}
+
 bool CFileIterator::HasNext() const {
   CHECK(seeked_) << "not seeked";
   CHECK(!prepared_) << "Cannot call HasNext() mid-batch";
@@ -801,6 +1310,26 @@ bool CFileIterator::HasNext() const {
 }
 
 Status CFileIterator::PrepareBatch(size_t *n) {
+  return DoPrepareBatch(n, nullptr);
+}
+
+Status CFileIterator::PrepareBatch(ColumnMaterializationContext *ctx, size_t *n) {
+  // Blocks may only be skipped if the predicate's outcome depends on the base
+  // data alone, which is the same condition as for evaluating it in the
+  // decoders.
+  const ColumnPredicate* pred = nullptr;
+  if (FLAGS_cfile_use_zone_maps && ctx->DecoderEvalSupported() && ctx->sel() != nullptr) {
+    RETURN_NOT_OK(LoadZoneMaps());
+    if (zone_maps_ != nullptr) {
+      pred = ctx->pred();
+      RETURN_NOT_OK(CheckValueBloom(*pred));
+      RETURN_NOT_OK(CheckBitmapIndex(*pred));
+    }
+  }
+  return DoPrepareBatch(n, pred);
+}
+
+Status CFileIterator::DoPrepareBatch(size_t *n, const ColumnPredicate *pred) {
   CHECK(!prepared_) << "Should call FinishBatch() first";
   CHECK(seeked_ != nullptr) << "must be seeked";
 
@@ -809,6 +1338,17 @@ Status CFileIterator::PrepareBatch(size_t *n) {
   rowid_t start_idx = last_prepare_idx_;
   rowid_t end_idx = start_idx + *n;
 
+  // A block skipped by a previous batch may be needed by this one.
+  {
+    PreparedBlock *front = prepared_blocks_.front();
+    if (PREDICT_FALSE(front->skipped_)) {
+      int zone_map_idx = pred ? FindZoneMap(front->dblk_ptr_) : -1;
+      if (zone_map_idx < 0 || !BlockExcluded(*pred, zone_map_idx)) {
+        RETURN_NOT_OK(ReadSkippedDataBlock(front));
+      }
+    }
+  }
+
   // Read blocks until all blocks covering the requested range are in the
   // prepared_blocks_ queue.
   while (prepared_blocks_.back()->last_row_idx() < end_idx) {
@@ -819,7 +1359,7 @@ Status CFileIterator::PrepareBatch(size_t *n) {
     } else if (!s.ok()) {
       return s;
     }
-    RETURN_NOT_OK(QueueCurrentDataBlock(*seeked_));
+    RETURN_NOT_OK(QueueCurrentDataBlock(*seeked_, pred));
   }
 
   // Seek the first block in the queue such that the first value to be read
@@ -895,83 +1435,119 @@ Status CFileIterator::FinishBatch() {
 
 
 Status CFileIterator::Scan(ColumnBlock *dst) {
+  ColumnMaterializationContext ctx(0, nullptr, dst, nullptr);
+  return Scan(&ctx);
+}
+
+Status CFileIterator::Scan(ColumnMaterializationContext *ctx) {
   CHECK(seeked_) << "not seeked";
+  ColumnBlock *dst = ctx->block();
+
+  // NULL-ness predicates are answered by the null bitmap alone, which the
+  // caller evaluates more cheaply than the decoders could.
+  if (ctx->DecoderEvalSupported() &&
+      (ctx->pred()->predicate_type() == PredicateType::IsNotNull ||
+       ctx->pred()->predicate_type() == PredicateType::IsNull)) {
+    ctx->SetDecoderEvalNotSupported();
+  }
+  // The decoders only see the empty cells left in place of the out-of-line
+  // values, so the predicate has to be evaluated once they're resolved.
+  if (ctx->DecoderEvalSupported() && reader_->has_out_of_line_values()) {
+    ctx->SetDecoderEvalNotSupported();
+  }
 
   // Use a column data view to been able to advance it as we read into it.
   ColumnDataView remaining_dst(dst);
+  SelectionVectorView remaining_sel(ctx->sel());
 
   uint32_t rem = last_prepare_count_;
   DCHECK_LE(rem, dst->nrows());
 
   for (PreparedBlock *pb : prepared_blocks_) {
+    if (PREDICT_FALSE(pb->skipped_) && (ctx->pred() == nullptr || ctx->sel() == nullptr)) {
+      // The block was skipped based on a predicate which this scan can't
+      // apply, so it has to be read after all.
+      RETURN_NOT_OK(ReadSkippedDataBlock(pb));
+    }
+
     if (pb->needs_rewind_) {
       // Seek back to the saved position.
-      SeekToPositionInBlock(pb, pb->rewind_idx_);
+      if (pb->skipped_) {
+        pb->idx_in_block_ = pb->rewind_idx_;
+      } else {
+        SeekToPositionInBlock(pb, pb->rewind_idx_);
+      }
       // TODO: we could add a mark/reset like interface in BlockDecoder interface
       // that might be more efficient (allowing the decoder to save internal state
       // instead of having to reconstruct it)
     }
 
-    if (reader_->is_nullable()) {
-      DCHECK(dst->is_nullable());
-
-      size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
-
-      // Fill column bitmap
-      size_t count = nrows;
-      while (count > 0) {
-        bool not_null = false;
-        size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
-        DCHECK_LE(nblock, count);
-        if (PREDICT_FALSE(nblock == 0)) {
-          return Status::Corruption(
-            Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
-                       count));
+    // Fetch as many as we can from the current datablock.
+    size_t nrows = std::min(rem, pb->num_rows_in_block_ - pb->idx_in_block_);
+    if (pb->skipped_) {
+      // The block's zone map showed that none of its rows match the predicate.
+      remaining_sel.ClearBits(0, nrows);
+      if (dst->is_nullable()) {
+        remaining_dst.SetNullBits(nrows, false);
+      }
+      remaining_dst.Advance(nrows);
+      remaining_sel.Advance(nrows);
+      pb->idx_in_block_ += nrows;
+      pb->needs_rewind_ = true;
+      rem -= nrows;
+    } else if (!ctx->skip_unselected_rows()) {
+      RETURN_NOT_OK(ScanBlockRows(pb, nrows, ctx, &remaining_sel, &remaining_dst));
+      rem -= nrows;
+    } else {
+      // Only decode the selected ranges of rows, seeking over the
+      // unselected ones.
+      const uint8_t* sel_bitmap = ctx->sel()->bitmap();
+      size_t sel_idx = last_prepare_count_ - rem;
+      size_t sel_end = sel_idx + nrows;
+      while (sel_idx < sel_end) {
+        size_t next_selected;
+        if (!BitmapFindFirstSet(sel_bitmap, sel_idx, sel_end, &next_selected)) {
+          next_selected = sel_end;
         }
-
-        size_t this_batch = nblock;
-        if (not_null) {
-          // TODO: Maybe copy all and shift later?
-          RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-          DCHECK_EQ(nblock, this_batch);
+        size_t nskip = next_selected - sel_idx;
+        if (nskip > 0 && (nskip >= kMinRowsToSkip || next_selected == sel_end)) {
+          if (pb->idx_in_block_ + nskip == pb->num_rows_in_block_) {
+            // The rest of the block is unselected. Rather than seeking the
+            // decoder to its end, leave it in place: any later read of this
+            // block starts with a rewind from the beginning of the block.
+            pb->idx_in_block_ += nskip;
+          } else {
+            SeekToPositionInBlock(pb, pb->idx_in_block_ + nskip);
+          }
           pb->needs_rewind_ = true;
-        } else {
-#ifndef NDEBUG
-          kudu::OverwriteWithPattern(reinterpret_cast<char *>(remaining_dst.data()),
-                                     remaining_dst.stride() * nblock,
-                                     "NULLNULLNULLNULLNULL");
-#endif
+          // The contents of skipped cells are unspecified; mark them NULL so
+          // that they are never read as values.
+          if (dst->is_nullable()) {
+            remaining_dst.SetNullBits(nskip, false);
+          }
+          remaining_dst.Advance(nskip);
+          remaining_sel.Advance(nskip);
+          sel_idx += nskip;
+          continue;
         }
 
-        // Set the ColumnBlock bitmap
-        remaining_dst.SetNullBits(this_batch, not_null);
-
-        rem -= this_batch;
-        count -= this_batch;
-        pb->idx_in_block_ += this_batch;
-        remaining_dst.Advance(this_batch);
-      }
-    } else {
-      // Fetch as many as we can from the current datablock.
-      size_t this_batch = rem;
-      RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, &remaining_dst));
-      pb->needs_rewind_ = true;
-      DCHECK_LE(this_batch, rem);
-
-      // If the column is nullable, set all bits to true
-      if (dst->is_nullable()) {
-        remaining_dst.SetNullBits(this_batch, true);
+        // Decode up to the end of the next run of selected rows (including any
+        // unselected run too short to be worth seeking over).
+        size_t next_unselected;
+        if (!BitmapFindFirstZero(sel_bitmap, next_selected, sel_end, &next_unselected)) {
+          next_unselected = sel_end;
+        }
+        size_t nscan = next_unselected - sel_idx;
+        RETURN_NOT_OK(ScanBlockRows(pb, nscan, ctx, &remaining_sel, &remaining_dst));
+        sel_idx += nscan;
       }
-
-      rem -= this_batch;
-      pb->idx_in_block_ += this_batch;
-      remaining_dst.Advance(this_batch);
+      rem -= nrows;
     }
 
     // If we didn't fetch as many as requested, then it should
     // be because the current data block ran out.
     if (rem > 0) {
-      DCHECK_EQ(pb->dblk_->Count(), pb->dblk_->GetCurrentIndex()) <<
+      DCHECK_EQ(pb->num_rows_in_block_, pb->idx_in_block_) <<
         "dblk stopped yielding values before it was empty.";
     } else {
       break;
@@ -979,9 +1555,203 @@ Status CFileIterator::Scan(ColumnBlock *dst) {
   }
 
   DCHECK_EQ(rem, 0) << "Should have fetched exactly the number of prepared rows";
+  if (reader_->has_out_of_line_values()) {
+    RETURN_NOT_OK(ResolveOutOfLineValues(ctx));
+  }
+  return Status::OK();
+}
+
+Status CFileIterator::LoadOutOfLineValues() {
+  if (out_of_line_values_) {
+    return Status::OK();
+  }
+  BlockPointer bp(reader_->footer().out_of_line_values_block_ptr());
+  BlockHandle handle;
+  RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::CACHE_BLOCK, &handle),
+                        "Couldn't read out-of-line values block");
+  gscoped_ptr<CFileOutOfLineValuesPB> values(new CFileOutOfLineValuesPB());
+  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(values.get(), handle.data().data(),
+                                                handle.data().size()),
+                        "Couldn't parse out-of-line values block");
+  if (values->offsets_size() != values->ordinals_size() ||
+      values->sizes_size() != values->ordinals_size()) {
+    return Status::Corruption("mismatched out-of-line values arrays");
+  }
+  out_of_line_values_.swap(values);
+  return Status::OK();
+}
+
+Status CFileIterator::ResolveOutOfLineValues(ColumnMaterializationContext* ctx) {
+  RETURN_NOT_OK(LoadOutOfLineValues());
+  ColumnBlock* dst = ctx->block();
+  const auto& ordinals = out_of_line_values_->ordinals();
+  rowid_t end = last_prepare_idx_ + last_prepare_count_;
+  for (auto it = std::lower_bound(ordinals.begin(), ordinals.end(), last_prepare_idx_);
+       it != ordinals.end() && *it < end;
+       ++it) {
+    size_t row = *it - last_prepare_idx_;
+    if ((ctx->sel() != nullptr && !ctx->sel()->IsRowSelected(row)) ||
+        (dst->is_nullable() && dst->is_null(row))) {
+      continue;
+    }
+    int idx = it - ordinals.begin();
+    BlockPointer bp(out_of_line_values_->offsets(idx), out_of_line_values_->sizes(idx));
+    // The values are read once per scan at most, and are too large to be
+    // worth evicting other blocks for.
+    BlockHandle handle;
+    RETURN_NOT_OK_PREPEND(reader_->ReadBlock(bp, CFileReader::DONT_CACHE_BLOCK, &handle),
+                          "Couldn't read out-of-line value");
+    io_stats_.bytes_read_from_disk += bp.size();
+    Slice* cell = reinterpret_cast<Slice*>(dst->mutable_cell_ptr(row));
+    if (PREDICT_FALSE(!dst->arena()->RelocateSlice(handle.data(), cell))) {
+      return Status::IOError("out of memory copying out-of-line value");
+    }
+  }
   return Status::OK();
 }
 
+Status CFileIterator::ScanBlockRows(PreparedBlock *pb,
+                                    size_t nrows,
+                                    ColumnMaterializationContext *ctx,
+                                    SelectionVectorView *sel,
+                                    ColumnDataView *dst) {
+  if (reader_->is_nullable() && !ctx->DecoderEvalSupported()) {
+    DCHECK(ctx->block()->is_nullable());
+
+    // Fill the null bitmap for the whole range first, then decode all of its
+    // non-NULL values with a single decoder call, rather than making a call
+    // per run of non-NULL cells.
+    ColumnDataView bitmap_dst(*dst);
+    bool any_not_null = false;
+    size_t count = nrows;
+    while (count > 0) {
+      bool not_null = false;
+      size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
+      DCHECK_LE(nblock, count);
+      if (PREDICT_FALSE(nblock == 0)) {
+        return Status::Corruption(
+          Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
+                     count));
+      }
+#ifndef NDEBUG
+      if (!not_null) {
+        kudu::OverwriteWithPattern(reinterpret_cast<char *>(bitmap_dst.data()),
+                                   bitmap_dst.stride() * nblock,
+                                   "NULLNULLNULLNULLNULL");
+      }
+#endif
+      bitmap_dst.SetNullBits(nblock, not_null);
+      bitmap_dst.Advance(nblock);
+      any_not_null |= not_null;
+      count -= nblock;
+    }
+    if (any_not_null) {
+      RETURN_NOT_OK(pb->dblk_->CopyNextNonNullValues(nrows, dst));
+      pb->needs_rewind_ = true;
+    }
+
+    pb->idx_in_block_ += nrows;
+    dst->Advance(nrows);
+    if (ctx->sel() != nullptr) {
+      sel->Advance(nrows);
+    }
+  } else if (reader_->is_nullable()) {
+    DCHECK(ctx->block()->is_nullable());
+
+    // Fill column bitmap
+    size_t count = nrows;
+    while (count > 0) {
+      bool not_null = false;
+      size_t nblock = pb->rle_decoder_.GetNextRun(&not_null, count);
+      DCHECK_LE(nblock, count);
+      if (PREDICT_FALSE(nblock == 0)) {
+        return Status::Corruption(
+          Substitute("Unexpected EOF on NULL bitmap read. Expected at least $0 more rows",
+                     count));
+      }
+
+      size_t this_batch = nblock;
+      if (not_null) {
+        // The decoder may give up on evaluating the predicate part way.
+        if (ctx->DecoderEvalSupported()) {
+          RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, sel, dst));
+        } else {
+          RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, dst));
+        }
+        DCHECK_EQ(nblock, this_batch);
+        pb->needs_rewind_ = true;
+      } else {
+#ifndef NDEBUG
+        kudu::OverwriteWithPattern(reinterpret_cast<char *>(dst->data()),
+                                   dst->stride() * nblock,
+                                   "NULLNULLNULLNULLNULL");
+#endif
+        // A NULL cell never satisfies a value predicate.
+        if (ctx->DecoderEvalSupported()) {
+          sel->ClearBits(0, nblock);
+        }
+      }
+
+      // Set the ColumnBlock bitmap
+      dst->SetNullBits(this_batch, not_null);
+
+      count -= this_batch;
+      pb->idx_in_block_ += this_batch;
+      dst->Advance(this_batch);
+      if (ctx->sel() != nullptr) {
+        sel->Advance(this_batch);
+      }
+    }
+  } else {
+    size_t this_batch = nrows;
+    if (ctx->DecoderEvalSupported()) {
+      RETURN_NOT_OK(pb->dblk_->CopyNextAndEval(&this_batch, ctx, sel, dst));
+    } else {
+      RETURN_NOT_OK(pb->dblk_->CopyNextValues(&this_batch, dst));
+    }
+    pb->needs_rewind_ = true;
+    DCHECK_EQ(nrows, this_batch);
+
+    // If the column is nullable, set all bits to true
+    if (ctx->block()->is_nullable()) {
+      dst->SetNullBits(this_batch, true);
+    }
+
+    pb->idx_in_block_ += this_batch;
+    dst->Advance(this_batch);
+    if (ctx->sel() != nullptr) {
+      sel->Advance(this_batch);
+    }
+  }
+  return Status::OK();
+}
+
+const SelectionVector* CFileIterator::GetCodeWordsMatchingPredicate(
+    const ColumnPredicate& pred) {
+  DCHECK(dict_decoder_ != nullptr);
+  if (codewords_matching_pred_ != nullptr && codewords_pred_ == &pred) {
+    return codewords_matching_pred_.get();
+  }
+
+  // Evaluate the predicate once against each dictionary entry. The resulting
+  // selection vector is indexed by code word.
+  size_t nwords = dict_decoder_->Count();
+  codewords_matching_pred_.reset(new SelectionVector(nwords));
+  codewords_matching_pred_->SetAllTrue();
+  codewords_pred_ = &pred;
+  if (nwords == 0) {
+    return codewords_matching_pred_.get();
+  }
+
+  vector<Slice> words(nwords);
+  for (size_t i = 0; i < nwords; i++) {
+    words[i] = dict_decoder_->string_at_index(i);
+  }
+  ColumnBlock block(pred.column().type_info(), nullptr, words.data(), nwords, nullptr);
+  pred.Evaluate(block, codewords_matching_pred_.get());
+  return codewords_matching_pred_.get();
+}
+
 Status CFileIterator::CopyNextValues(size_t *n, ColumnBlock *cb) {
   RETURN_NOT_OK(PrepareBatch(n));
   RETURN_NOT_OK(Scan(cb));
@@ -19,9 +19,12 @@
 #define KUDU_CFILE_CFILE_READER_H
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "kudu/common/column_materialization_context.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/types.h"
 #include "kudu/cfile/block_cache.h"
 #include "kudu/cfile/block_encodings.h"
@@ -98,11 +101,34 @@ class CFileReader {
   Status ReadBlock(const BlockPointer &ptr, CacheControl cache_control,
                    BlockHandle *ret) const;
 
+  // Read the block at 'offset' into the block cache, unless it is already
+  // cached. 'cached_size' is the size of the block once it is cached, as
+  // listed by BlockCache::ListEntries(). This is used to warm the block
+  // cache with the blocks it held before a restart.
+  Status WarmBlock(uint64_t offset, uint64_t cached_size) const;
+
+  // Hint that the byte range [offset, offset + length) of the file will be
+  // read soon. The range is clipped to the end of the file.
+  Status Readahead(uint64_t offset, uint64_t length) const;
+
+  // Hint that the block at 'ptr' will be read soon with 'cache_control',
+  // unless it is already in the block cache.
+  Status PrefetchBlock(const BlockPointer& ptr, CacheControl cache_control) const;
+
   // Return the number of rows in this cfile.
   // This is assumed to be reasonably fast (i.e does not scan
   // the data)
   Status CountRows(rowid_t *count) const;
 
+  // Read the file's zone maps into '*zone_maps', or reset it if the file
+  // has none.
+  Status ReadZoneMaps(gscoped_ptr<CFileZoneMapsPB>* zone_maps) const;
+
+  // Return true if the zone map of the whole file shows that none of its
+  // rows can satisfy 'pred'. Files written without one never exclude a
+  // predicate.
+  bool FileZoneMapExcludes(const ColumnPredicate& pred) const;
+
   // Retrieve the given metadata entry into 'val'.
   // Returns true if the entry was found, otherwise returns false.
   //
@@ -156,11 +182,29 @@ class CFileReader {
 
   // Return true if there is a value-based index on this file.
   bool has_validx() const { return footer().has_validx_info(); }
+
+  // Return true if some of the values of this file were stored out of line.
+  bool has_out_of_line_values() const {
+    return footer().has_out_of_line_values_block_ptr();
+  }
   BlockPointer validx_root() const {
     DCHECK(has_validx());
     return BlockPointer(footer().validx_info().root_block());
   }
 
+  // Returns the block of the value-based index at 'ptr' if it's kept in
+  // memory, or an empty slice if it isn't. Once the file is initialized, the
+  // root of the index is kept in memory if --cfile_pin_validx_root is set,
+  // and the rest of it too if the reader was opened with 'pin_validx'.
+  Slice pinned_validx_block(const BlockPointer& ptr) const;
+
+  // Returns the number of bytes of value-based index blocks kept in memory.
+  size_t pinned_validx_bytes() const;
+
+  // Returns the memory used by the reader's metadata and pinned index blocks,
+  // as accounted to its parent MemTracker.
+  int64_t memory_consumption() const;
+
   std::string ToString() const { return block_->id().ToString(); }
 
  private:
@@ -173,6 +217,11 @@ class CFileReader {
   // Callback used in 'init_once_' to initialize this cfile.
   Status InitOnce();
 
+  // Callback used in 'pin_validx_once_' to read the root block of the
+  // value-based index, or all its blocks if 'pin_validx_' is set, into
+  // memory once the file is initialized.
+  Status PinValidxOnce();
+
   Status ReadMagicAndLength(uint64_t offset, uint32_t *len);
   Status ReadAndParseHeader();
   Status ReadAndParseFooter();
@@ -196,6 +245,14 @@ class CFileReader {
 
   KuduOnceDynamic init_once_;
 
+  const bool pin_validx_;
+  KuduOnceDynamic pin_validx_once_;
+
+  // The pinned index blocks, keyed by their offset in the file. Not modified
+  // once 'pin_validx_once_' is initted.
+  std::unordered_map<uint64_t, std::string> pinned_validx_blocks_;
+  size_t pinned_validx_bytes_;
+
   ScopedTrackedConsumption mem_consumption_;
 };
 
@@ -238,6 +295,23 @@ class ColumnIterator {
   // ever result in a "short read".
   virtual Status PrepareBatch(size_t *n) = 0;
 
+  // Like PrepareBatch(size_t*), but allows the iterator to use the predicate
+  // in 'ctx', if any, to avoid reading data which can't match it. The rows
+  // of any such data are filtered out by a following Scan(ctx).
+  virtual Status PrepareBatch(ColumnMaterializationContext *ctx, size_t *n) {
+    return PrepareBatch(n);
+  }
+
+  // Hints that the data holding the given ordinal entry will be read soon,
+  // without seeking the iterator. Lets a caller which reads a short range
+  // of several columns have all of their reads issued at once rather than
+  // one after the other. The iterator must not be seeked yet.
+  //
+  // The default implementation does nothing.
+  virtual Status PrefetchOrdinal(rowid_t ord_idx) {
+    return Status::OK();
+  }
+
   // Copy values into the prepared column block.
   // Any indirected values (eg strings) are copied into the dst block's
   // arena.
@@ -245,6 +319,15 @@ class ColumnIterator {
   // calls to Scan() will re-read the same values.
   virtual Status Scan(ColumnBlock *dst) = 0;
 
+  // Like Scan(ColumnBlock*), but additionally allows the iterator to evaluate
+  // the predicate in 'ctx' while decoding, clearing the selection vector bits
+  // of non-matching rows. If the iterator cannot do so, it marks 'ctx' as
+  // unsupported and the caller must evaluate the predicate itself.
+  virtual Status Scan(ColumnMaterializationContext *ctx) {
+    ctx->SetDecoderEvalNotSupported();
+    return Scan(ctx->block());
+  }
+
   // Finish processing the current batch, advancing the iterators
   // such that the next call to PrepareBatch() will start where the previous
   // batch left off.
@@ -305,6 +388,10 @@ class CFileIterator : public ColumnIterator {
   // TODO: do we ever want to be able to seek to the end of the file?
   Status SeekToOrdinal(rowid_t ord_idx) OVERRIDE;
 
+  // Looks up the data block holding 'ord_idx' in the positional index and
+  // hints the file to read it, unless it is cached.
+  Status PrefetchOrdinal(rowid_t ord_idx) OVERRIDE;
+
   // Seek the index to the given row_key, or to the index entry immediately
   // before it. Then (if the index is sparse) seek the data block to the
   // value matching value or to the value immediately after it.
@@ -317,6 +404,10 @@ class CFileIterator : public ColumnIterator {
   Status SeekAtOrAfter(const EncodedKey &encoded_key,
                        bool *exact_match);
 
+  // Return true if no row of the block described by 'zone_map' can satisfy
+  // 'pred'.
+  static bool ZoneMapExcludes(const ColumnPredicate& pred, const BlockZoneMapPB& zone_map);
+
   // Return true if this reader is currently seeked.
   // If the iterator is not seeked, it is an error to call any functions except
   // for seek (including GetCurrentOrdinal).
@@ -341,6 +432,12 @@ class CFileIterator : public ColumnIterator {
   // ever result in a "short read".
   Status PrepareBatch(size_t *n) OVERRIDE;
 
+  // Like PrepareBatch(size_t*), but data blocks whose zone maps show that
+  // none of their rows can match the predicate in 'ctx' are not read at all.
+  // Their rows are filtered out of the selection vector by Scan(), which must
+  // then be passed the same context.
+  Status PrepareBatch(ColumnMaterializationContext *ctx, size_t *n) OVERRIDE;
+
   // Copy values into the prepared column block.
   // Any indirected values (eg strings) are copied into the dst block's
   // arena.
@@ -348,6 +445,10 @@ class CFileIterator : public ColumnIterator {
   // calls to Scan() will re-read the same values.
   Status Scan(ColumnBlock *dst) OVERRIDE;
 
+  // Scan the prepared batch, evaluating the predicate in 'ctx' inside the
+  // block decoders where the block encoding allows it.
+  Status Scan(ColumnMaterializationContext *ctx) OVERRIDE;
+
   // Finish processing the current batch, advancing the iterators
   // such that the next call to PrepareBatch() will start where the previous
   // batch left off.
@@ -368,6 +469,12 @@ class CFileIterator : public ColumnIterator {
   // StringDictBlockDecoder.
   BinaryPlainBlockDecoder* GetDictDecoder() { return dict_decoder_.get();}
 
+  // If the column is dictionary-coded, returns a selection vector over the
+  // dictionary's code words in which the bits of the words matching 'pred'
+  // are set. The result is computed on first use and cached for as long as
+  // the same predicate is passed in.
+  const SelectionVector* GetCodeWordsMatchingPredicate(const ColumnPredicate& pred);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(CFileIterator);
 
@@ -378,8 +485,13 @@ class CFileIterator : public ColumnIterator {
 
     // The rowid of the first row in this block.
     rowid_t first_row_idx() const {
-      return dblk_->GetFirstRowId();
+      return first_row_idx_;
     }
+    rowid_t first_row_idx_;
+
+    // True if the block was skipped based on its zone map, in which case
+    // dblk_data_ and dblk_ are not set.
+    bool skipped_;
 
     // The index of the seeked position, relative to the start of the block.
     // In case of null bitmap present, dblk_->GetCurrentIndex() is not aligned
@@ -411,6 +523,13 @@ class CFileIterator : public ColumnIterator {
     string ToString() const;
   };
 
+  // Scan exactly 'nrows' rows of 'pb', starting at its current position, into
+  // 'dst', advancing 'dst' and (if the context has a selection vector) 'sel'.
+  Status ScanBlockRows(PreparedBlock *pb, size_t nrows,
+                       ColumnMaterializationContext *ctx,
+                       SelectionVectorView *sel,
+                       ColumnDataView *dst);
+
   // Seek the given PreparedBlock to the given index within it.
   void SeekToPositionInBlock(PreparedBlock *pb, uint32_t idx_in_block);
 
@@ -421,9 +540,57 @@ class CFileIterator : public ColumnIterator {
   Status ReadCurrentDataBlock(const IndexTreeIterator &idx_iter,
                               PreparedBlock *prep_block);
 
+  // Read the data block pointed to by prep_block->dblk_ptr_.
+  Status ReadDataBlock(PreparedBlock *prep_block);
+
+  // Track whether data blocks are being read in file order and, once the
+  // access pattern looks sequential, hint the file to read ahead of the
+  // block described by 'ptr'.
+  void MaybeReadahead(const BlockPointer& ptr);
+
+  // Read the data of a block which was previously skipped, keeping its
+  // position.
+  Status ReadSkippedDataBlock(PreparedBlock *prep_block);
+
   // Read the data block currently pointed to by idx_iter_, and enqueue
-  // it onto the end of the prepared_blocks_ deque.
-  Status QueueCurrentDataBlock(const IndexTreeIterator &idx_iter);
+  // it onto the end of the prepared_blocks_ deque. If 'pred' is non-NULL and
+  // the block's zone map shows that it can't match, the block is enqueued
+  // without being read.
+  Status QueueCurrentDataBlock(const IndexTreeIterator &idx_iter,
+                               const ColumnPredicate *pred);
+
+  Status DoPrepareBatch(size_t *n, const ColumnPredicate *pred);
+
+  // Load the file's zone maps, and its bitmap index, if it has any and they
+  // aren't loaded yet.
+  Status LoadZoneMaps();
+
+  // Return the index within zone_maps_ of the zone map of the data block at
+  // 'ptr', or -1 if there is none.
+  int FindZoneMap(const BlockPointer& ptr) const;
+
+  // Check 'pred' against the file's value bloom filter, if it has one and
+  // 'pred' is an equality or IN-list predicate, loading the filter if needed.
+  // The outcome is kept for later calls with the same predicate.
+  Status CheckValueBloom(const ColumnPredicate& pred);
+
+  // Look up the blocks which may satisfy 'pred' in the file's bitmap index,
+  // if it has one and 'pred' is an equality or IN-list predicate. The blocks
+  // are kept for later calls with the same predicate.
+  Status CheckBitmapIndex(const ColumnPredicate& pred);
+
+  // Return true if no row of the block described by the zone map at index
+  // 'zone_map_idx' can satisfy 'pred', according to the zone map, the file's
+  // value bloom filter or the file's bitmap index.
+  bool BlockExcluded(const ColumnPredicate& pred, int zone_map_idx) const;
+
+  // Load the index of the file's out-of-line values, if not loaded yet.
+  Status LoadOutOfLineValues();
+
+  // Read the out-of-line values of the selected non-NULL rows of the last
+  // prepared batch into the cells of ctx->block(), which were scanned as
+  // empty, copying them into its arena.
+  Status ResolveOutOfLineValues(ColumnMaterializationContext* ctx);
 
   // Fully initialize the underlying cfile reader if needed, and clear any
   // seek-related state.
@@ -438,6 +605,35 @@ class CFileIterator : public ColumnIterator {
   gscoped_ptr<BinaryPlainBlockDecoder> dict_decoder_;
   BlockHandle dict_block_handle_;
 
+  // Code words of the dictionary matching 'codewords_pred_', if computed.
+  gscoped_ptr<SelectionVector> codewords_matching_pred_;
+  const ColumnPredicate* codewords_pred_;
+
+  // The file's zone maps, if loaded and present.
+  gscoped_ptr<CFileZoneMapsPB> zone_maps_;
+  bool zone_maps_loaded_;
+
+  // The file's value bloom filter, if loaded and present.
+  gscoped_ptr<CFileValueBloomPB> value_bloom_;
+
+  // The predicate last checked against the value bloom filter, and whether
+  // the filter showed that no row of the file can satisfy it.
+  const ColumnPredicate* value_bloom_pred_;
+  bool value_bloom_excludes_;
+
+  // The file's bitmap index, if loaded and present.
+  gscoped_ptr<CFileBitmapIndexPB> bitmap_index_;
+
+  // The predicate last looked up in the bitmap index, whether the index
+  // applied to it, and if so a bitmap of the blocks which may satisfy it,
+  // indexed like zone_maps_.
+  const ColumnPredicate* bitmap_index_pred_;
+  bool bitmap_index_applies_;
+  std::string bitmap_index_blocks_;
+
+  // The index of the file's out-of-line values, if loaded.
+  gscoped_ptr<CFileOutOfLineValuesPB> out_of_line_values_;
+
   // The currently in-use index iterator. This is equal to either
   // posidx_iter_.get(), validx_iter_.get(), or NULL if not seeked.
   IndexTreeIterator *seeked_;
@@ -466,6 +662,18 @@ class CFileIterator : public ColumnIterator {
 
   IteratorStats io_stats_;
 
+  // The end offset of the last data block read from the file, used to detect
+  // sequential access.
+  uint64_t last_read_end_;
+
+  // The number of consecutive data block reads which followed the previous
+  // one in the file.
+  int sequential_reads_;
+
+  // The end offset of the most recent readahead hint, or 0 if no readahead
+  // is in flight.
+  uint64_t readahead_end_;
+
   // a temporary buffer for encoding
   faststring tmp_buf_;
 };
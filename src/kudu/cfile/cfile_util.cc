@@ -22,6 +22,8 @@
 #include <string>
 
 #include "kudu/cfile/cfile_reader.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/hash/city.h"
 #include "kudu/util/env.h"
 #include "kudu/util/mem_tracker.h"
 
@@ -85,7 +87,8 @@ Status DumpIterator(const CFileReader& reader,
 }
 
 ReaderOptions::ReaderOptions()
-  : parent_mem_tracker(MemTracker::GetRootTracker()) {
+  : parent_mem_tracker(MemTracker::GetRootTracker()),
+    pin_validx(false) {
 }
 
 size_t CommonPrefixLength(const Slice& slice_a, const Slice& slice_b) {
@@ -129,5 +132,21 @@ void GetSeparatingKey(const Slice& left, Slice* right) {
   right->truncate(cpl == right->size() ? cpl : cpl + 1);
 }
 
+uint64_t HashValueForBloom(const TypeInfo* type, const void* cell) {
+  if (type->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    return util_hash::CityHash64(reinterpret_cast<const char*>(s->data()), s->size());
+  }
+  return util_hash::CityHash64(reinterpret_cast<const char*>(cell), type->size());
+}
+
+void AddDictEncodingStats(const DictEncodingStatsPB& src, DictEncodingStatsPB* dst) {
+  dst->set_num_dict_entries(dst->num_dict_entries() + src.num_dict_entries());
+  dst->set_dict_block_size(dst->dict_block_size() + src.dict_block_size());
+  dst->set_num_code_word_blocks(dst->num_code_word_blocks() + src.num_code_word_blocks());
+  dst->set_num_plain_blocks(dst->num_plain_blocks() + src.num_plain_blocks());
+  dst->set_num_plain_values(dst->num_plain_values() + src.num_plain_values());
+}
+
 } // namespace cfile
 } // namespace kudu
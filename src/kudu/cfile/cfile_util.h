@@ -56,10 +56,24 @@ struct WriterOptions {
   // Whether the file needs a value index
   bool write_validx;
 
+  // Number of entries between restart points of the prefix compressed keys
+  // of index blocks. 0 writes index blocks with whole keys.
+  //
+  // Default: --cfile_index_block_restart_interval
+  int index_block_restart_interval;
+
   // Whether to optimize index keys by storing shortest separating prefixes
   // instead of entire keys.
   bool optimize_index_keys;
 
+  // The size from which the values of a BINARY file without a value index are
+  // stored out of line, each in a block of its own, rather than in the data
+  // blocks. Scans of the file then only read the large values of the rows
+  // they materialize. 0 stores all the values inline.
+  //
+  // Default: 0
+  size_t out_of_line_value_threshold;
+
   // Column storage attributes.
   //
   // Default: all default values as specified in the constructor in
@@ -76,6 +90,13 @@ struct ReaderOptions {
   //
   // Default: the root tracker.
   std::shared_ptr<MemTracker> parent_mem_tracker;
+
+  // Whether to keep every block of the value-based index in memory, outside
+  // the block cache, once the file is initialized, rather than just its root
+  // (see --cfile_pin_validx_root).
+  //
+  // Default: false.
+  bool pin_validx;
 };
 
 struct DumpIteratorOptions {
@@ -108,6 +129,15 @@ size_t CommonPrefixLength(const Slice& a, const Slice& b);
 // Truncate right to give a shortest key satisfying left <= key <= right.
 void GetSeparatingKey(const Slice& left, Slice* right);
 
+// Add the counts of 'src' to 'dst', e.g. to total the dictionary statistics
+// of the columns of a rowset.
+void AddDictEncodingStats(const DictEncodingStatsPB& src, DictEncodingStatsPB* dst);
+
+// Return the hash by which the cell 'cell' of type 'type' is recorded in a
+// cfile's value bloom filter: the hash of the string contents for binary
+// types, and of the cell's bytes otherwise.
+uint64_t HashValueForBloom(const TypeInfo* type, const void* cell);
+
 }  // namespace cfile
 }  // namespace kudu
 
@@ -18,6 +18,7 @@
 #include "kudu/cfile/cfile_writer.h"
 
 #include <glog/logging.h>
+#include <algorithm>
 #include <string>
 #include <utility>
 
@@ -28,6 +29,8 @@
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/common/key_encoder.h"
 #include "kudu/gutil/endian.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/bloom_filter.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
@@ -64,6 +67,33 @@ DEFINE_string(cfile_do_on_finish, "flush",
               "Possible values are 'close', 'flush', or 'nothing'.");
 TAG_FLAG(cfile_do_on_finish, experimental);
 
+DEFINE_bool(cfile_write_zone_maps, true,
+            "Whether to record the min/max value and NULL count of each data block "
+            "in new cfiles, allowing scans to skip blocks which can't match their "
+            "predicates.");
+TAG_FLAG(cfile_write_zone_maps, advanced);
+
+DEFINE_double(cfile_value_bloom_fp_rate, 0.01,
+              "Target false positive rate of the value bloom filters written for "
+              "the cfiles of columns which ask for them. Lower rates let more files "
+              "be skipped by equality predicates, at the cost of larger filters.");
+TAG_FLAG(cfile_value_bloom_fp_rate, advanced);
+
+DEFINE_int32(cfile_bitmap_index_max_values, 64,
+             "Maximum number of distinct values a new cfile may hold to be written "
+             "with a bitmap index recording which data blocks hold each value, "
+             "allowing equality predicates to skip the other blocks. 0 disables "
+             "bitmap indexes.");
+TAG_FLAG(cfile_bitmap_index_max_values, advanced);
+
+DEFINE_int32(cfile_index_block_restart_interval, 16,
+             "Number of entries between restart points of the prefix compressed "
+             "keys of the index blocks of new cfiles. Composite and string keys "
+             "often share long prefixes, so compressing them keeps key indexes "
+             "small enough to stay cached. 0 writes index blocks with whole keys, "
+             "which older versions can read.");
+TAG_FLAG(cfile_index_block_restart_interval, advanced);
+
 namespace kudu {
 namespace cfile {
 
@@ -72,7 +102,15 @@ const char kMagicString[] = "kuducfil";
 static const size_t kBlockSizeLimit = 16 * 1024 * 1024; // 16MB
 static const size_t kMinBlockSize = 512;
 
-static CompressionType GetDefaultCompressionCodec() {
+// Binary values longer than this are not recorded in zone maps, so that
+// long strings don't bloat the zone map block.
+static const size_t kMaxZoneMapValueSize = 128;
+
+// The number of value hashes buffered for the value bloom filter before the
+// duplicates are first removed from the buffer.
+static const size_t kMinValueHashDedupSize = 64 * 1024;
+
+CompressionType GetDefaultCompressionCodec() {
   return GetCompressionCodecType(FLAGS_cfile_default_compression_codec);
 }
 
@@ -82,9 +120,11 @@ static CompressionType GetDefaultCompressionCodec() {
 WriterOptions::WriterOptions()
   : index_block_size(32*1024),
     block_restart_interval(16),
+    index_block_restart_interval(FLAGS_cfile_index_block_restart_interval),
     write_posidx(false),
     write_validx(false),
-    optimize_index_keys(true) {
+    optimize_index_keys(true),
+    out_of_line_value_threshold(0) {
 }
 
 
@@ -104,6 +144,22 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     is_nullable_(is_nullable),
     typeinfo_(typeinfo),
     key_encoder_(nullptr),
+    write_zone_maps_(FLAGS_cfile_write_zone_maps),
+    file_has_min_max_(false),
+    file_zone_map_overflow_(false),
+    file_null_count_(0),
+    write_value_bloom_(options.storage_attributes.bloom_filter &&
+                       typeinfo->physical_type() != FLOAT &&
+                       typeinfo->physical_type() != DOUBLE),
+    value_hash_dedup_size_(kMinValueHashDedupSize),
+    write_bitmap_index_(write_zone_maps_ &&
+                        FLAGS_cfile_bitmap_index_max_values > 0 &&
+                        typeinfo->physical_type() != FLOAT &&
+                        typeinfo->physical_type() != DOUBLE),
+    last_value_id_(-1),
+    write_out_of_line_values_(options.out_of_line_value_threshold > 0 &&
+                              !options.write_validx &&
+                              typeinfo->physical_type() == BINARY),
     state_(kWriterInitialized) {
   EncodingType encoding = options_.storage_attributes.encoding;
   Status s = TypeEncodingInfo::Get(typeinfo_, encoding, &type_encoding_info_);
@@ -140,6 +196,8 @@ CFileWriter::CFileWriter(const WriterOptions &options,
     key_encoder_ = &GetKeyEncoder<faststring>(typeinfo_);
     validx_builder_.reset(new IndexTreeBuilder(&options_, this));
   }
+
+  ResetZoneMap();
 }
 
 CFileWriter::~CFileWriter() {
@@ -152,7 +210,8 @@ Status CFileWriter::Start() {
 
   if (compression_ != NO_COMPRESSION) {
     const CompressionCodec* codec;
-    RETURN_NOT_OK(GetCompressionCodec(compression_, &codec));
+    RETURN_NOT_OK(GetCompressionCodec(compression_, options_.storage_attributes.compression_level,
+                                      &codec));
     block_compressor_ .reset(new CompressedBlockBuilder(codec, kBlockSizeLimit));
   }
 
@@ -229,9 +288,69 @@ Status CFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer) {
     footer.mutable_validx_info()->CopyFrom(validx_info);
   }
 
+  if (write_zone_maps_) {
+    faststring zone_maps_str;
+    if (!pb_util::SerializeToString(zone_maps_, &zone_maps_str)) {
+      return Status::Corruption("unable to serialize zone maps");
+    }
+    BlockPointer zone_maps_ptr;
+    RETURN_NOT_OK_PREPEND(AddBlock({ Slice(zone_maps_str) }, &zone_maps_ptr, "zone maps block"),
+                          "Couldn't write zone maps");
+    zone_maps_ptr.CopyToPB(footer.mutable_zone_maps_block_ptr());
+
+    BlockZoneMapPB* file_zone_map = footer.mutable_file_zone_map();
+    file_zone_map->set_block_offset(0);
+    file_zone_map->set_first_row(0);
+    file_zone_map->set_num_rows(value_count_);
+    file_zone_map->set_null_count(file_null_count_);
+    if (file_has_min_max_ && !file_zone_map_overflow_) {
+      file_zone_map->set_min_value(file_min_.data(), file_min_.size());
+      file_zone_map->set_max_value(file_max_.data(), file_max_.size());
+    }
+  }
+
+  if (write_value_bloom_ && !value_hashes_.empty()) {
+    BlockPointer value_bloom_ptr;
+    RETURN_NOT_OK_PREPEND(WriteValueBloom(&value_bloom_ptr), "Couldn't write value bloom filter");
+    value_bloom_ptr.CopyToPB(footer.mutable_value_bloom_block_ptr());
+  }
+
+  if (write_bitmap_index_ && !bitmap_index_values_.empty()) {
+    CFileBitmapIndexPB bitmap_index;
+    for (size_t id = 0; id < bitmap_index_values_.size(); id++) {
+      CFileBitmapIndexPB::EntryPB* entry = bitmap_index.add_entries();
+      entry->set_value(bitmap_index_values_[id]);
+      entry->set_blocks(bitmap_index_blocks_[id]);
+    }
+    faststring bitmap_index_str;
+    if (!pb_util::SerializeToString(bitmap_index, &bitmap_index_str)) {
+      return Status::Corruption("unable to serialize bitmap index");
+    }
+    BlockPointer bitmap_index_ptr;
+    RETURN_NOT_OK_PREPEND(AddBlock({ Slice(bitmap_index_str) }, &bitmap_index_ptr,
+                                   "bitmap index block"),
+                          "Couldn't write bitmap index");
+    bitmap_index_ptr.CopyToPB(footer.mutable_bitmap_index_block_ptr());
+  }
+
+  if (out_of_line_values_.ordinals_size() > 0) {
+    faststring out_of_line_values_str;
+    if (!pb_util::SerializeToString(out_of_line_values_, &out_of_line_values_str)) {
+      return Status::Corruption("unable to serialize out-of-line values");
+    }
+    BlockPointer out_of_line_values_ptr;
+    RETURN_NOT_OK_PREPEND(AddBlock({ Slice(out_of_line_values_str) }, &out_of_line_values_ptr,
+                                   "out-of-line values block"),
+                          "Couldn't write out-of-line values");
+    out_of_line_values_ptr.CopyToPB(footer.mutable_out_of_line_values_block_ptr());
+  }
+
   // Optionally append extra information to the end of cfile.
   // Example: dictionary block for dictionary encoding
   RETURN_NOT_OK(data_block_->AppendExtraInfo(this, &footer));
+  if (footer.has_dict_stats()) {
+    dict_stats_.CopyFrom(footer.dict_stats());
+  }
 
   // Flush metadata.
   FlushMetadataToPB(footer.mutable_metadata());
@@ -293,12 +412,20 @@ Status CFileWriter::AppendEntries(const void *entries, size_t count) {
   int rem = count;
 
   const uint8_t *ptr = reinterpret_cast<const uint8_t *>(entries);
+  // The cells added to the data blocks, which differ from 'ptr' where values
+  // were stored out of line.
+  const uint8_t *cells;
+  RETURN_NOT_OK(StoreOutOfLineValues(ptr, count, &cells));
 
   while (rem > 0) {
-    int n = data_block_->Add(ptr, rem);
+    int n = data_block_->Add(cells, rem);
     DCHECK_GE(n, 0);
+    UpdateZoneMap(ptr, n);
+    UpdateValueBloom(ptr, n);
+    UpdateBitmapIndex(ptr, n);
 
     ptr += typeinfo_->size() * n;
+    cells += typeinfo_->size() * n;
     rem -= n;
     value_count_ += n;
 
@@ -324,12 +451,18 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
   while ((nblock = bmap_iter.Next(&not_null)) > 0) {
     if (not_null) {
       size_t rem = nblock;
+      const uint8_t *cells;
+      RETURN_NOT_OK(StoreOutOfLineValues(ptr, nblock, &cells));
       do {
-        int n = data_block_->Add(ptr, rem);
+        int n = data_block_->Add(cells, rem);
         DCHECK_GE(n, 0);
+        UpdateZoneMap(ptr, n);
+        UpdateValueBloom(ptr, n);
+        UpdateBitmapIndex(ptr, n);
 
         null_bitmap_builder_->AddRun(true, n);
         ptr += n * typeinfo_->size();
+        cells += n * typeinfo_->size();
         value_count_ += n;
         rem -= n;
 
@@ -340,6 +473,7 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
       } while (rem > 0);
     } else {
       null_bitmap_builder_->AddRun(false, nblock);
+      block_null_count_ += nblock;
       ptr += nblock * typeinfo_->size();
       value_count_ += nblock;
     }
@@ -348,6 +482,36 @@ Status CFileWriter::AppendNullableEntries(const uint8_t *bitmap,
   return Status::OK();
 }
 
+Status CFileWriter::StoreOutOfLineValues(const uint8_t* vals, size_t count,
+                                         const uint8_t** cells) {
+  *cells = vals;
+  if (!write_out_of_line_values_) {
+    return Status::OK();
+  }
+  const Slice* slices = reinterpret_cast<const Slice*>(vals);
+  bool copied = false;
+  for (size_t i = 0; i < count; i++) {
+    if (slices[i].size() < options_.out_of_line_value_threshold) {
+      continue;
+    }
+    if (!copied) {
+      out_of_line_cells_.assign(slices, slices + count);
+      copied = true;
+    }
+    BlockPointer ptr;
+    RETURN_NOT_OK_PREPEND(AddBlock({ slices[i] }, &ptr, "out-of-line value"),
+                          "Couldn't write out-of-line value");
+    out_of_line_values_.add_ordinals(value_count_ + i);
+    out_of_line_values_.add_offsets(ptr.offset());
+    out_of_line_values_.add_sizes(ptr.size());
+    out_of_line_cells_[i] = Slice();
+  }
+  if (copied) {
+    *cells = reinterpret_cast<const uint8_t*>(out_of_line_cells_.data());
+  }
+  return Status::OK();
+}
+
 Status CFileWriter::FinishCurDataBlock() {
   uint32_t num_elems_in_block = data_block_->Count();
   if (is_nullable_) {
@@ -386,6 +550,9 @@ Status CFileWriter::FinishCurDataBlock() {
     v.push_back(null_bitmap);
   }
   v.push_back(data);
+  if (write_zone_maps_) {
+    RecordZoneMap(first_elem_ord, num_elems_in_block);
+  }
   Status s = AppendRawBlock(v, first_elem_ord,
                             reinterpret_cast<const void *>(key_tmp_space),
                             Slice(last_key_),
@@ -446,6 +613,195 @@ Status CFileWriter::AppendRawBlock(const vector<Slice> &data_slices,
   return s;
 }
 
+const void* CFileWriter::ZoneMapCell(const faststring& buf, Slice* slice) const {
+  if (typeinfo_->physical_type() == BINARY) {
+    *slice = Slice(buf);
+    return slice;
+  }
+  return buf.data();
+}
+
+void CFileWriter::UpdateZoneMap(const uint8_t* vals, size_t count) {
+  if (!write_zone_maps_ || block_zone_map_overflow_) {
+    return;
+  }
+  bool is_binary = typeinfo_->physical_type() == BINARY;
+  size_t size = typeinfo_->size();
+  Slice min_slice, max_slice;
+  for (size_t i = 0; i < count; i++, vals += size) {
+    if (is_binary &&
+        reinterpret_cast<const Slice*>(vals)->size() > kMaxZoneMapValueSize) {
+      block_zone_map_overflow_ = true;
+      return;
+    }
+    bool is_min = !block_has_min_max_ ||
+        typeinfo_->Compare(vals, ZoneMapCell(block_min_, &min_slice)) < 0;
+    bool is_max = !block_has_min_max_ ||
+        typeinfo_->Compare(vals, ZoneMapCell(block_max_, &max_slice)) > 0;
+    if (is_min) {
+      CopyZoneMapCell(vals, &block_min_);
+    }
+    if (is_max) {
+      CopyZoneMapCell(vals, &block_max_);
+    }
+    block_has_min_max_ = true;
+  }
+}
+
+void CFileWriter::CopyZoneMapCell(const uint8_t* cell, faststring* dst) const {
+  if (typeinfo_->physical_type() == BINARY) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    dst->assign_copy(s->data(), s->size());
+  } else {
+    dst->assign_copy(cell, typeinfo_->size());
+  }
+}
+
+void CFileWriter::RecordZoneMap(rowid_t first_row, uint32_t num_rows) {
+  BlockZoneMapPB* zone_map = zone_maps_.add_blocks();
+  // The data block is about to be appended at the current offset.
+  zone_map->set_block_offset(off_);
+  zone_map->set_first_row(first_row);
+  zone_map->set_num_rows(num_rows);
+  zone_map->set_null_count(block_null_count_);
+  if (block_has_min_max_ && !block_zone_map_overflow_) {
+    zone_map->set_min_value(block_min_.data(), block_min_.size());
+    zone_map->set_max_value(block_max_.data(), block_max_.size());
+  }
+  RecordBitmapIndexBlock(zone_maps_.blocks_size() - 1);
+
+  file_null_count_ += block_null_count_;
+  if (block_zone_map_overflow_) {
+    file_zone_map_overflow_ = true;
+  } else if (block_has_min_max_ && !file_zone_map_overflow_) {
+    Slice block_slice, file_slice;
+    if (!file_has_min_max_ ||
+        typeinfo_->Compare(ZoneMapCell(block_min_, &block_slice),
+                           ZoneMapCell(file_min_, &file_slice)) < 0) {
+      file_min_.assign_copy(block_min_.data(), block_min_.size());
+    }
+    if (!file_has_min_max_ ||
+        typeinfo_->Compare(ZoneMapCell(block_max_, &block_slice),
+                           ZoneMapCell(file_max_, &file_slice)) > 0) {
+      file_max_.assign_copy(block_max_.data(), block_max_.size());
+    }
+    file_has_min_max_ = true;
+  }
+  ResetZoneMap();
+}
+
+void CFileWriter::ResetZoneMap() {
+  block_has_min_max_ = false;
+  block_zone_map_overflow_ = false;
+  block_null_count_ = 0;
+}
+
+void CFileWriter::UpdateBitmapIndex(const uint8_t* vals, size_t count) {
+  if (!write_bitmap_index_) {
+    return;
+  }
+  bool is_binary = typeinfo_->physical_type() == BINARY;
+  size_t size = typeinfo_->size();
+  for (size_t i = 0; i < count; i++, vals += size) {
+    Slice value = is_binary ? *reinterpret_cast<const Slice*>(vals) : Slice(vals, size);
+    // Runs of the same value are common in low-cardinality columns.
+    if (last_value_id_ >= 0 && value == Slice(bitmap_index_values_[last_value_id_])) {
+      continue;
+    }
+    if (is_binary && value.size() > kMaxZoneMapValueSize) {
+      AbandonBitmapIndex();
+      return;
+    }
+    string key = value.ToString();
+    int id;
+    auto it = bitmap_index_ids_.find(key);
+    if (it != bitmap_index_ids_.end()) {
+      id = it->second;
+    } else {
+      if (bitmap_index_values_.size() >=
+          static_cast<size_t>(FLAGS_cfile_bitmap_index_max_values)) {
+        AbandonBitmapIndex();
+        return;
+      }
+      id = bitmap_index_values_.size();
+      bitmap_index_ids_.emplace(key, id);
+      bitmap_index_values_.push_back(std::move(key));
+      bitmap_index_blocks_.emplace_back();
+      block_has_value_.push_back(false);
+    }
+    if (!block_has_value_[id]) {
+      block_has_value_[id] = true;
+      block_value_ids_.push_back(id);
+    }
+    last_value_id_ = id;
+  }
+}
+
+void CFileWriter::RecordBitmapIndexBlock(int block_idx) {
+  if (!write_bitmap_index_) {
+    return;
+  }
+  for (int id : block_value_ids_) {
+    string* blocks = &bitmap_index_blocks_[id];
+    blocks->resize(BitmapSize(block_idx + 1), '\0');
+    BitmapSet(reinterpret_cast<uint8_t*>(&(*blocks)[0]), block_idx);
+    block_has_value_[id] = false;
+  }
+  block_value_ids_.clear();
+  last_value_id_ = -1;
+}
+
+void CFileWriter::AbandonBitmapIndex() {
+  write_bitmap_index_ = false;
+  bitmap_index_ids_.clear();
+  vector<string>().swap(bitmap_index_values_);
+  vector<string>().swap(bitmap_index_blocks_);
+  block_value_ids_.clear();
+  block_has_value_.clear();
+  last_value_id_ = -1;
+}
+
+void CFileWriter::UpdateValueBloom(const uint8_t* vals, size_t count) {
+  if (!write_value_bloom_) {
+    return;
+  }
+  size_t size = typeinfo_->size();
+  for (size_t i = 0; i < count; i++, vals += size) {
+    value_hashes_.push_back(HashValueForBloom(typeinfo_, vals));
+  }
+  if (value_hashes_.size() >= value_hash_dedup_size_) {
+    // Columns worth indexing usually repeat their values, e.g. a user ID
+    // recurring in many events, so keep the buffer to the distinct values.
+    DedupValueHashes();
+    value_hash_dedup_size_ = std::max(kMinValueHashDedupSize, value_hashes_.size() * 2);
+  }
+}
+
+void CFileWriter::DedupValueHashes() {
+  std::sort(value_hashes_.begin(), value_hashes_.end());
+  value_hashes_.erase(std::unique(value_hashes_.begin(), value_hashes_.end()),
+                      value_hashes_.end());
+}
+
+Status CFileWriter::WriteValueBloom(BlockPointer* block_ptr) {
+  DedupValueHashes();
+  BloomFilterBuilder bloom(BloomFilterSizing::ByCountAndFPRate(
+      value_hashes_.size(), FLAGS_cfile_value_bloom_fp_rate));
+  for (const uint64_t& hash : value_hashes_) {
+    bloom.AddKey(BloomKeyProbe(Slice(reinterpret_cast<const uint8_t*>(&hash), sizeof(hash))));
+  }
+  vector<uint64_t>().swap(value_hashes_);
+
+  CFileValueBloomPB bloom_pb;
+  bloom_pb.set_num_hash_functions(bloom.n_hashes());
+  bloom_pb.set_bitmap(bloom.slice().data(), bloom.slice().size());
+  faststring bloom_str;
+  if (!pb_util::SerializeToString(bloom_pb, &bloom_str)) {
+    return Status::Corruption("unable to serialize value bloom filter");
+  }
+  return AddBlock({ Slice(bloom_str) }, block_ptr, "value bloom block");
+}
+
 size_t CFileWriter::written_size() const {
   // This is a low estimate, but that's OK -- this is checked after every block
   // write during flush/compact, so better to give a fast slightly-inaccurate result
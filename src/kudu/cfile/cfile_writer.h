@@ -58,6 +58,10 @@ extern const char kMagicString[];
 const int kCFileMajorVersion = 1;
 const int kCFileMinorVersion = 0;
 
+// Returns the codec that data with DEFAULT_COMPRESSION is compressed with,
+// per --cfile_default_compression_codec.
+CompressionType GetDefaultCompressionCodec();
+
 class NullBitmapBuilder {
  public:
   explicit NullBitmapBuilder(size_t initial_row_capacity)
@@ -160,6 +164,12 @@ class CFileWriter {
     return value_count_;
   }
 
+  // Return how the dictionary of a dictionary encoded file was used. Empty
+  // for other encodings.
+  //
+  // REQUIRES: Finish() already called.
+  const DictEncodingStatsPB& dict_stats() const { return dict_stats_; }
+
   std::string ToString() const { return block_->id().ToString(); }
 
   // Wrapper for AddBlock() to append the dictionary block to the end of a Cfile.
@@ -184,6 +194,44 @@ class CFileWriter {
 
   Status FinishCurDataBlock();
 
+  // Fold 'count' non-NULL cells starting at 'vals' into the zone map of the
+  // current data block.
+  void UpdateZoneMap(const uint8_t* vals, size_t count);
+
+  // Append the zone map of the current data block, which is about to be
+  // written, to 'zone_maps_', and reset it for the next block.
+  void RecordZoneMap(rowid_t first_row, uint32_t num_rows);
+  void ResetZoneMap();
+
+  // Helpers to convert between cells and their zone map representation.
+  const void* ZoneMapCell(const faststring& buf, Slice* slice) const;
+  void CopyZoneMapCell(const uint8_t* cell, faststring* dst) const;
+
+  // Record the hashes of 'count' non-NULL cells starting at 'vals' for the
+  // value bloom filter.
+  void UpdateValueBloom(const uint8_t* vals, size_t count);
+  void DedupValueHashes();
+
+  // Build the value bloom filter from the recorded hashes and append it to
+  // the file, setting *block_ptr to its block.
+  Status WriteValueBloom(BlockPointer* block_ptr);
+
+  // Record the distinct values among 'count' non-NULL cells starting at
+  // 'vals' as held by the current data block, for the bitmap index. Gives up
+  // on the index once the file has too many distinct values.
+  void UpdateBitmapIndex(const uint8_t* vals, size_t count);
+
+  // Mark the values held by the current data block, whose zone map is at
+  // index 'block_idx', in their bitmaps, and reset them for the next block.
+  void RecordBitmapIndexBlock(int block_idx);
+  void AbandonBitmapIndex();
+
+  // Write each of the 'count' non-NULL cells starting at 'vals' which is at
+  // least options_.out_of_line_value_threshold bytes to a block of its own.
+  // Sets *cells to the cells to add to the data blocks: 'vals' itself if
+  // none was, or a copy in which they are empty.
+  Status StoreOutOfLineValues(const uint8_t* vals, size_t count, const uint8_t** cells);
+
   // Flush the current unflushed_metadata_ entries into the given protobuf
   // field, clearing the buffer.
   void FlushMetadataToPB(google::protobuf::RepeatedPtrField<FileMetadataPairPB> *field);
@@ -225,6 +273,54 @@ class CFileWriter {
   gscoped_ptr<NullBitmapBuilder> null_bitmap_builder_;
   gscoped_ptr<CompressedBlockBuilder> block_compressor_;
 
+  // Copied from the footer by FinishAndReleaseBlock().
+  DictEncodingStatsPB dict_stats_;
+
+  // Zone maps of the data blocks written so far, and the state of the zone
+  // map of the current data block. Only maintained if write_zone_maps_ is set.
+  const bool write_zone_maps_;
+  CFileZoneMapsPB zone_maps_;
+  bool block_has_min_max_;
+  bool block_zone_map_overflow_;
+  faststring block_min_;
+  faststring block_max_;
+  uint32_t block_null_count_;
+
+  // The zone map of the whole file, folded from those of the data blocks
+  // written so far.
+  bool file_has_min_max_;
+  bool file_zone_map_overflow_;
+  faststring file_min_;
+  faststring file_max_;
+  uint32_t file_null_count_;
+
+  // The hashes of the values written so far, for the value bloom filter.
+  // Only maintained if write_value_bloom_ is set. Duplicates are removed
+  // whenever the buffer reaches value_hash_dedup_size_ entries.
+  const bool write_value_bloom_;
+  std::vector<uint64_t> value_hashes_;
+  size_t value_hash_dedup_size_;
+
+  // The distinct values of the file, in their zone map representation, with
+  // the ids they are known by here, and the bitmap of the data blocks holding
+  // each. The values held by the current data block are flagged in
+  // block_has_value_ and listed in block_value_ids_, and last_value_id_ is
+  // the id of the last value seen in it. Only maintained while
+  // write_bitmap_index_ is set.
+  bool write_bitmap_index_;
+  unordered_map<std::string, int> bitmap_index_ids_;
+  std::vector<std::string> bitmap_index_values_;
+  std::vector<std::string> bitmap_index_blocks_;
+  std::vector<bool> block_has_value_;
+  std::vector<int> block_value_ids_;
+  int last_value_id_;
+
+  // The values stored out of line so far, and the buffer of the cells with
+  // which they were replaced.
+  const bool write_out_of_line_values_;
+  CFileOutOfLineValuesPB out_of_line_values_;
+  std::vector<Slice> out_of_line_cells_;
+
   enum State {
     kWriterInitialized,
     kWriterWriting,
@@ -18,6 +18,7 @@
 #include <gtest/gtest.h>
 #include <glog/logging.h>
 #include <stdlib.h>
+#include <string>
 
 #include "kudu/cfile/cfile-test-base.h"
 #include "kudu/cfile/cfile_reader.h"
@@ -26,14 +27,17 @@
 #include "kudu/cfile/compression_codec.h"
 #include "kudu/cfile/index_block.h"
 #include "kudu/cfile/index_btree.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 #include "kudu/util/status.h"
 
+using std::string;
+
 namespace kudu {
 namespace cfile {
 
-static void TestCompressionCodec(CompressionType compression) {
+static void TestCompressionCodec(CompressionType compression, int level = 0) {
   const int kInputSize = 64;
 
   const CompressionCodec* codec;
@@ -45,7 +49,7 @@ static void TestCompressionCodec(CompressionType compression) {
   memset(ibuffer, 'Z', kInputSize);
 
   // Get the specified compression codec
-  ASSERT_OK(GetCompressionCodec(compression, &codec));
+  ASSERT_OK(GetCompressionCodec(compression, level, &codec));
 
   // Allocate the compression buffer
   size_t max_compressed = codec->MaxCompressedLength(kInputSize);
@@ -111,6 +115,55 @@ TEST_F(TestCompression, TestZlibCompressionCodec) {
   TestCompressionCodec(ZLIB);
 }
 
+TEST_F(TestCompression, TestZstdCompressionCodec) {
+  TestCompressionCodec(ZSTD);
+  TestCompressionCodec(ZSTD, 1);
+  TestCompressionCodec(ZSTD, 19);
+
+  const CompressionCodec* codec;
+  Status s = GetCompressionCodec(ZSTD, 1000, &codec);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+  s = GetCompressionCodec(ZSTD, -1, &codec);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+
+  // Other codecs have no levels to check.
+  ASSERT_OK(GetCompressionCodec(LZ4, 1000, &codec));
+}
+
+// Blocks compressed at any level can be uncompressed by any zstd codec, and
+// corrupt blocks are detected.
+TEST_F(TestCompression, TestZstdLevels) {
+  string input;
+  for (int i = 0; i < 1000; i++) {
+    input += strings::Substitute("{\"id\": $0, \"name\": \"user$1\"}", i, i % 37);
+  }
+  const CompressionCodec* fast;
+  const CompressionCodec* small;
+  ASSERT_OK(GetCompressionCodec(ZSTD, 1, &fast));
+  ASSERT_OK(GetCompressionCodec(ZSTD, 19, &small));
+
+  gscoped_array<uint8_t> fast_buf(new uint8_t[fast->MaxCompressedLength(input.size())]);
+  gscoped_array<uint8_t> small_buf(new uint8_t[small->MaxCompressedLength(input.size())]);
+  size_t fast_size;
+  size_t small_size;
+  ASSERT_OK(fast->Compress(Slice(input), fast_buf.get(), &fast_size));
+  ASSERT_OK(small->Compress(Slice(input), small_buf.get(), &small_size));
+  LOG(INFO) << "Compressed " << input.size() << " bytes to " << fast_size
+            << " bytes at level 1 and " << small_size << " bytes at level 19";
+  ASSERT_LE(small_size, fast_size);
+
+  gscoped_array<uint8_t> output(new uint8_t[input.size()]);
+  ASSERT_OK(small->Uncompress(Slice(fast_buf.get(), fast_size), output.get(), input.size()));
+  ASSERT_EQ(0, memcmp(input.data(), output.get(), input.size()));
+  ASSERT_OK(fast->Uncompress(Slice(small_buf.get(), small_size), output.get(), input.size()));
+  ASSERT_EQ(0, memcmp(input.data(), output.get(), input.size()));
+
+  Status s = fast->Uncompress(Slice(fast_buf.get(), fast_size), output.get(), input.size() - 1);
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+  s = fast->Uncompress(Slice(fast_buf.get(), fast_size / 2), output.get(), input.size());
+  ASSERT_TRUE(s.IsCorruption()) << s.ToString();
+}
+
 TEST_F(TestCompression, TestCFileNoCompressionReadWrite) {
   TestReadWriteCompressed(NO_COMPRESSION);
 }
@@ -127,5 +180,9 @@ TEST_F(TestCompression, TestCFileZlibReadWrite) {
   TestReadWriteCompressed(ZLIB);
 }
 
+TEST_F(TestCompression, TestCFileZstdReadWrite) {
+  TestReadWriteCompressed(ZSTD);
+}
+
 } // namespace cfile
 } // namespace kudu
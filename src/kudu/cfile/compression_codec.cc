@@ -20,12 +20,15 @@
 #include <snappy.h>
 #include <zlib.h>
 #include <lz4.h>
+#include <zstd.h>
 #include <string>
 #include <vector>
 
 #include "kudu/cfile/compression_codec.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/threadlocal.h"
 
 namespace kudu {
 namespace cfile {
@@ -225,8 +228,107 @@ class ZlibCodec : public CompressionCodec {
   }
 };
 
+// Compresses into the zstd frame format, which records the uncompressed size.
+//
+// There is one codec per compression level. The compression and
+// decompression contexts are allocated once per thread: they are large,
+// especially at high levels, so reusing them is significantly faster than
+// using the one-shot ZSTD_compress() and ZSTD_decompress().
+class ZstdCodec : public CompressionCodec {
+ public:
+  // REQUIRES: 0 <= level <= ZSTD_maxCLevel().
+  static const ZstdCodec* GetSingleton(int level) {
+    static const vector<ZstdCodec*>* codecs = CreateCodecs();
+    DCHECK_GE(level, 0);
+    DCHECK_LT(level, codecs->size());
+    return (*codecs)[level];
+  }
+
+  Status Compress(const Slice& input,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    BLOCK_STATIC_THREAD_LOCAL(CompressContext, ctx);
+    size_t n = ZSTD_compressCCtx(ctx->get(), compressed, MaxCompressedLength(input.size()),
+                                 input.data(), input.size(), level_);
+    if (ZSTD_isError(n)) {
+      return Status::IOError("unable to compress the buffer", ZSTD_getErrorName(n));
+    }
+    *compressed_length = n;
+    return Status::OK();
+  }
+
+  Status Compress(const vector<Slice>& input_slices,
+                  uint8_t *compressed, size_t *compressed_length) const OVERRIDE {
+    if (input_slices.size() == 1) {
+      return Compress(input_slices[0], compressed, compressed_length);
+    }
+
+    SlicesSource source(input_slices);
+    faststring buffer;
+    source.Dump(&buffer);
+    return Compress(Slice(buffer.data(), buffer.size()), compressed, compressed_length);
+  }
+
+  Status Uncompress(const Slice& compressed,
+                    uint8_t *uncompressed, size_t uncompressed_length) const OVERRIDE {
+    BLOCK_STATIC_THREAD_LOCAL(DecompressContext, ctx);
+    size_t n = ZSTD_decompressDCtx(ctx->get(), uncompressed, uncompressed_length,
+                                   compressed.data(), compressed.size());
+    if (ZSTD_isError(n)) {
+      return Status::Corruption("unable to uncompress the buffer", ZSTD_getErrorName(n));
+    }
+    if (n != uncompressed_length) {
+      return Status::Corruption(strings::Substitute(
+          "unable to uncompress the buffer: got $0 bytes, expected $1", n, uncompressed_length));
+    }
+    return Status::OK();
+  }
+
+  size_t MaxCompressedLength(size_t source_bytes) const OVERRIDE {
+    return ZSTD_compressBound(source_bytes);
+  }
+
+ private:
+  explicit ZstdCodec(int level) : level_(level) {}
+
+  static const vector<ZstdCodec*>* CreateCodecs() {
+    auto codecs = new vector<ZstdCodec*>();
+    for (int level = 0; level <= ZSTD_maxCLevel(); level++) {
+      codecs->push_back(new ZstdCodec(level));
+    }
+    return codecs;
+  }
+
+  class CompressContext {
+   public:
+    CompressContext() : ctx_(CHECK_NOTNULL(ZSTD_createCCtx())) {}
+    ~CompressContext() { ZSTD_freeCCtx(ctx_); }
+    ZSTD_CCtx* get() { return ctx_; }
+   private:
+    ZSTD_CCtx* const ctx_;
+    DISALLOW_COPY_AND_ASSIGN(CompressContext);
+  };
+
+  class DecompressContext {
+   public:
+    DecompressContext() : ctx_(CHECK_NOTNULL(ZSTD_createDCtx())) {}
+    ~DecompressContext() { ZSTD_freeDCtx(ctx_); }
+    ZSTD_DCtx* get() { return ctx_; }
+   private:
+    ZSTD_DCtx* const ctx_;
+    DISALLOW_COPY_AND_ASSIGN(DecompressContext);
+  };
+
+  // Level 0 selects zstd's default level.
+  const int level_;
+};
+
 Status GetCompressionCodec(CompressionType compression,
                            const CompressionCodec** codec) {
+  return GetCompressionCodec(compression, 0, codec);
+}
+
+Status GetCompressionCodec(CompressionType compression, int level,
+                           const CompressionCodec** codec) {
   switch (compression) {
     case NO_COMPRESSION:
       *codec = nullptr;
@@ -240,6 +342,13 @@ Status GetCompressionCodec(CompressionType compression,
     case ZLIB:
       *codec = ZlibCodec::GetSingleton();
       break;
+    case ZSTD:
+      if (level < 0 || level > ZSTD_maxCLevel()) {
+        return Status::InvalidArgument(strings::Substitute(
+            "zstd compression level $0 is not between 0 and $1", level, ZSTD_maxCLevel()));
+      }
+      *codec = ZstdCodec::GetSingleton(level);
+      break;
     default:
       return Status::NotFound("bad compression type");
   }
@@ -253,6 +362,8 @@ CompressionType GetCompressionCodecType(const std::string& name) {
     return LZ4;
   if (name.compare("zlib") == 0)
     return ZLIB;
+  if (name.compare("zstd") == 0)
+    return ZSTD;
   if (name.compare("none") == 0)
     return NO_COMPRESSION;
 
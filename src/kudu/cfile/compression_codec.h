@@ -66,6 +66,15 @@ class CompressionCodec {
 Status GetCompressionCodec(CompressionType compression,
                            const CompressionCodec** codec);
 
+// Like above, but compressing at 'level' for codecs which have levels
+// (currently only ZSTD), or at the codec's default level if 'level' is 0.
+// The level is ignored by other codecs, and doesn't need to be known to
+// uncompress.
+//
+// Returns InvalidArgument if the level isn't supported by the codec.
+Status GetCompressionCodec(CompressionType compression, int level,
+                           const CompressionCodec** codec);
+
 // Returns the compression codec type given the name
 CompressionType GetCompressionCodecType(const std::string& name);
 
@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/cfile/delta_of_delta_block.h"
+
+#include <string.h>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/port.h"
+
+namespace kudu {
+namespace cfile {
+namespace delta_of_delta {
+
+namespace {
+
+// The packed values are stored as little-endian 64-bit words; like the rest
+// of the on-disk formats, this assumes a little-endian host.
+template<int kWidth>
+void UnpackBitsWithWidth(const uint8_t* src, size_t num_values, uint64_t* values) {
+  const uint64_t kMask = kWidth == 64 ? ~0ULL : (1ULL << (kWidth % 64)) - 1;
+  for (size_t i = 0; i < num_values; i++) {
+    size_t bit = i * kWidth;
+    const uint8_t* word = src + (bit / 64) * sizeof(uint64_t);
+    int shift = bit % 64;
+    uint64_t value = UNALIGNED_LOAD64(word) >> shift;
+    // The value straddles two words. This never happens for widths which
+    // divide 64, so the compiler drops the branch for those.
+    if (64 % kWidth != 0 && shift + kWidth > 64) {
+      value |= UNALIGNED_LOAD64(word + sizeof(uint64_t)) << (64 - shift);
+    }
+    values[i] = value & kMask;
+  }
+}
+
+template<>
+void UnpackBitsWithWidth<0>(const uint8_t* src, size_t num_values, uint64_t* values) {
+  memset(values, 0, num_values * sizeof(uint64_t));
+}
+
+typedef void (*UnpackFunction)(const uint8_t*, size_t, uint64_t*);
+
+template<int kWidth>
+struct UnpackTableFiller {
+  static void Fill(UnpackFunction* table) {
+    table[kWidth] = &UnpackBitsWithWidth<kWidth>;
+    UnpackTableFiller<kWidth - 1>::Fill(table);
+  }
+};
+
+template<>
+struct UnpackTableFiller<-1> {
+  static void Fill(UnpackFunction* table) {}
+};
+
+// The unpacking functions, indexed by bit width.
+struct UnpackTable {
+  UnpackTable() {
+    UnpackTableFiller<64>::Fill(functions);
+  }
+  UnpackFunction functions[65];
+};
+
+} // anonymous namespace
+
+void PackBits(const uint64_t* values, size_t num_values, int bit_width, uint8_t* dst) {
+  DCHECK_LE(bit_width, 64);
+  size_t packed_size = PackedSize(num_values, bit_width);
+  memset(dst, 0, packed_size);
+  if (bit_width == 0) {
+    return;
+  }
+  const uint64_t mask = bit_width == 64 ? ~0ULL : (1ULL << bit_width) - 1;
+  for (size_t i = 0; i < num_values; i++) {
+    uint64_t value = values[i] & mask;
+    size_t bit = i * bit_width;
+    uint8_t* word = dst + (bit / 64) * sizeof(uint64_t);
+    int shift = bit % 64;
+    UNALIGNED_STORE64(word, UNALIGNED_LOAD64(word) | (value << shift));
+    if (shift + bit_width > 64) {
+      uint8_t* next = word + sizeof(uint64_t);
+      UNALIGNED_STORE64(next, UNALIGNED_LOAD64(next) | (value >> (64 - shift)));
+    }
+  }
+}
+
+void UnpackBits(const uint8_t* src, size_t num_values, int bit_width, uint64_t* values) {
+  DCHECK_GE(bit_width, 0);
+  DCHECK_LE(bit_width, 64);
+  static const UnpackTable table;
+  table.functions[bit_width](src, num_values, values);
+}
+
+} // namespace delta_of_delta
+} // namespace cfile
+} // namespace kudu
@@ -0,0 +1,502 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Delta-of-delta encoding of integer blocks, for columns whose values move
+// at a nearly constant rate, such as event timestamps and counters.
+//
+// The values of a block are grouped in mini-blocks of kMiniBlockSize values.
+// A mini-block stores its first value and first delta as they are, and the
+// differences between consecutive deltas ("delta of deltas") bit-packed
+// relative to their minimum (frame of reference), all with the same bit
+// width. Values at a constant rate pack with a bit width of 0, leaving only
+// the mini-block header.
+//
+// Since every mini-block can be decoded on its own, seeking to a position
+// only decodes the mini-block holding it, and seeking to a value in a
+// sorted block binary searches the first values of the mini-blocks.
+#ifndef KUDU_CFILE_DELTA_OF_DELTA_BLOCK_H
+#define KUDU_CFILE_DELTA_OF_DELTA_BLOCK_H
+
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include <vector>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/faststring.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace delta_of_delta {
+
+// The number of values of a mini-block (except for the last one of a block,
+// which may be shorter).
+const size_t kMiniBlockSize = 128;
+
+// Returns the number of bytes 'num_values' values of 'bit_width' bits take
+// once packed. Packed values fill whole 64-bit words, so that they can be
+// unpacked with word loads.
+inline size_t PackedSize(size_t num_values, int bit_width) {
+  return (num_values * bit_width + 63) / 64 * 8;
+}
+
+// Returns the number of bits needed to represent 'value'.
+inline int BitWidth(uint64_t value) {
+  return Bits::Log2Floor64(value) + 1;
+}
+
+inline uint64_t ZigZagEncode(uint64_t value) {
+  return (value << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(value) >> 63);
+}
+
+inline uint64_t ZigZagDecode(uint64_t value) {
+  return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+// Packs the low 'bit_width' bits of each of the 'num_values' values into
+// the PackedSize(num_values, bit_width) bytes at 'dst', lowest bits first.
+void PackBits(const uint64_t* values, size_t num_values, int bit_width, uint8_t* dst);
+
+// Unpacks 'num_values' values of 'bit_width' bits packed by PackBits().
+// Dispatches to a loop specialized for each bit width, in which the shifts
+// and masks are constants.
+void UnpackBits(const uint8_t* src, size_t num_values, int bit_width, uint64_t* values);
+
+// Converts a value to the 64-bit integer the deltas are computed on: signed
+// types are sign-extended so that small negative deltas stay small.
+template<typename CppType>
+inline uint64_t ToUint64(CppType value) {
+  typedef typename std::conditional<std::is_signed<CppType>::value,
+                                    int64_t, uint64_t>::type WideType;
+  return static_cast<uint64_t>(static_cast<WideType>(value));
+}
+
+} // namespace delta_of_delta
+
+// Builds delta-of-delta encoded integer blocks.
+//
+// Block layout:
+// 1. num of elements within the block (uint32_t, little endian).
+// 2. ordinal of the first element within the block (uint32_t, little endian).
+// 3. the mini-blocks, each of which consists of:
+//    a. the first value, sign-extended to 64 bits (uint64_t, little endian).
+//    b. the first delta, or 0 if the mini-block has a single value
+//       (zigzag encoded varint64).
+//    c. the minimum delta of deltas (zigzag encoded varint64).
+//    d. the bit width of the packed values (uint8_t).
+//    e. the delta of deltas of the third and following values, each minus
+//       the minimum, packed with PackBits().
+// 4. the offset of each mini-block within the block (uint32_t, little endian).
+template<DataType Type>
+class DeltaOfDeltaBlockBuilder : public BlockBuilder {
+ public:
+  explicit DeltaOfDeltaBlockBuilder(const WriterOptions* options)
+    : options_(options) {
+    Reset();
+  }
+
+  void Reset() OVERRIDE {
+    count_ = 0;
+    num_pending_ = 0;
+    buffer_.clear();
+    buffer_.resize(kHeaderSize);
+    offsets_.clear();
+  }
+
+  bool IsBlockFull(size_t limit) const OVERRIDE {
+    return EstimateEncodedSize() > limit;
+  }
+
+  int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    int added = 0;
+    // If the current block is full, stop adding more items.
+    while (!IsBlockFull(options_->storage_attributes.cfile_block_size) && added < count) {
+      if (PREDICT_FALSE(count_ == 0)) {
+        first_key_ = vals[added];
+      }
+      pending_[num_pending_++] = vals[added];
+      if (num_pending_ == delta_of_delta::kMiniBlockSize) {
+        FlushMiniBlock();
+      }
+      added++;
+      count_++;
+    }
+    if (added > 0) {
+      last_key_ = vals[added - 1];
+    }
+    return added;
+  }
+
+  Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    if (num_pending_ > 0) {
+      FlushMiniBlock();
+    }
+    for (uint32_t offset : offsets_) {
+      InlinePutFixed32(&buffer_, offset);
+    }
+    InlineEncodeFixed32(&buffer_[0], count_);
+    InlineEncodeFixed32(&buffer_[4], ordinal_pos);
+    return Slice(buffer_);
+  }
+
+  size_t Count() const OVERRIDE {
+    return count_;
+  }
+
+  Status GetFirstKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    *reinterpret_cast<CppType*>(key) = first_key_;
+    return Status::OK();
+  }
+
+  Status GetLastKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    *reinterpret_cast<CppType*>(key) = last_key_;
+    return Status::OK();
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+
+  size_t EstimateEncodedSize() const {
+    // The pending values are counted at their full size, which overestimates
+    // by at most a mini-block.
+    return buffer_.size() + num_pending_ * sizeof(CppType) +
+        (offsets_.size() + 1) * sizeof(uint32_t);
+  }
+
+  void FlushMiniBlock() {
+    DCHECK_GT(num_pending_, 0);
+    offsets_.push_back(buffer_.size());
+
+    uint64_t values[delta_of_delta::kMiniBlockSize];
+    for (size_t i = 0; i < num_pending_; i++) {
+      values[i] = delta_of_delta::ToUint64(pending_[i]);
+    }
+    uint64_t first_delta = num_pending_ > 1 ? values[1] - values[0] : 0;
+
+    // The arithmetic wraps around, which decoding reverses exactly.
+    size_t num_packed = num_pending_ > 2 ? num_pending_ - 2 : 0;
+    uint64_t dods[delta_of_delta::kMiniBlockSize];
+    int64_t min_dod = num_packed > 0 ? std::numeric_limits<int64_t>::max() : 0;
+    for (size_t i = 0; i < num_packed; i++) {
+      dods[i] = (values[i + 2] - values[i + 1]) - (values[i + 1] - values[i]);
+      min_dod = std::min(min_dod, static_cast<int64_t>(dods[i]));
+    }
+    uint64_t all_bits = 0;
+    for (size_t i = 0; i < num_packed; i++) {
+      dods[i] -= static_cast<uint64_t>(min_dod);
+      all_bits |= dods[i];
+    }
+    int bit_width = delta_of_delta::BitWidth(all_bits);
+
+    InlinePutFixed64(&buffer_, values[0]);
+    PutVarint64(&buffer_, delta_of_delta::ZigZagEncode(first_delta));
+    PutVarint64(&buffer_, delta_of_delta::ZigZagEncode(static_cast<uint64_t>(min_dod)));
+    buffer_.push_back(static_cast<uint8_t>(bit_width));
+    size_t packed_size = delta_of_delta::PackedSize(num_packed, bit_width);
+    size_t old_size = buffer_.size();
+    buffer_.resize(old_size + packed_size);
+    delta_of_delta::PackBits(dods, num_packed, bit_width, &buffer_[old_size]);
+
+    num_pending_ = 0;
+  }
+
+  const WriterOptions* options_;
+  size_t count_;
+  CppType first_key_;
+  CppType last_key_;
+
+  // The values of the mini-block being built.
+  CppType pending_[delta_of_delta::kMiniBlockSize];
+  size_t num_pending_;
+
+  faststring buffer_;
+  std::vector<uint32_t> offsets_;
+};
+
+// Decodes blocks built by DeltaOfDeltaBlockBuilder.
+template<DataType Type>
+class DeltaOfDeltaBlockDecoder : public BlockDecoder {
+ public:
+  explicit DeltaOfDeltaBlockDecoder(Slice slice)
+    : data_(std::move(slice)),
+      parsed_(false),
+      ordinal_pos_base_(0),
+      num_elems_(0),
+      num_miniblocks_(0),
+      offsets_end_(0),
+      offsets_(nullptr),
+      cur_idx_(0),
+      loaded_miniblock_(kNoMiniBlock),
+      loaded_count_(0) {
+  }
+
+  Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+    if (data_.size() < kHeaderSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for header: $0 < $1",
+                              data_.size(), kHeaderSize));
+    }
+    num_elems_ = DecodeFixed32(&data_[0]);
+    ordinal_pos_base_ = DecodeFixed32(&data_[4]);
+    num_miniblocks_ = (static_cast<size_t>(num_elems_) + delta_of_delta::kMiniBlockSize - 1) /
+        delta_of_delta::kMiniBlockSize;
+    if (data_.size() < kHeaderSize + num_miniblocks_ * sizeof(uint32_t)) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for $0 mini-block offsets", num_miniblocks_));
+    }
+    offsets_end_ = data_.size() - num_miniblocks_ * sizeof(uint32_t);
+    offsets_ = data_.data() + offsets_end_;
+
+    // Check that each mini-block has room for its fixed-size header, so that
+    // the first values may be read without further checks.
+    size_t min_offset = kHeaderSize;
+    for (size_t i = 0; i < num_miniblocks_; i++) {
+      size_t offset = MiniBlockOffset(i);
+      if ((i == 0 && offset != kHeaderSize) || offset < min_offset) {
+        return Status::Corruption(
+            strings::Substitute("invalid offset of mini-block $0: $1", i, offset));
+      }
+      min_offset = offset + kMinMiniBlockHeaderSize;
+      if (min_offset > offsets_end_) {
+        return Status::Corruption(
+            strings::Substitute("mini-block $0 overruns the block", i));
+      }
+    }
+
+    parsed_ = true;
+    return Status::OK();
+  }
+
+  void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    DCHECK_LE(pos, num_elems_);
+    cur_idx_ = pos;
+  }
+
+  Status SeekAtOrAfterValue(const void* value_void, bool* exact) OVERRIDE {
+    DCHECK(parsed_);
+    CppType target = *reinterpret_cast<const CppType*>(value_void);
+
+    // Find the last mini-block whose first value is at or before the target.
+    size_t left = 0;
+    size_t right = num_miniblocks_;
+    while (left != right) {
+      size_t mid = (left + right) / 2;
+      if (MiniBlockFirstValue(mid) <= target) {
+        left = mid + 1;
+      } else {
+        right = mid;
+      }
+    }
+    if (left == 0) {
+      // Every value is after the target (or there are none).
+      cur_idx_ = 0;
+      *exact = false;
+      if (num_elems_ == 0) {
+        return Status::NotFound("after last key in block");
+      }
+      return Status::OK();
+    }
+
+    size_t miniblock = left - 1;
+    RETURN_NOT_OK(LoadMiniBlock(miniblock));
+    const CppType* pos = std::lower_bound(decoded_, decoded_ + loaded_count_, target);
+    cur_idx_ = miniblock * delta_of_delta::kMiniBlockSize + (pos - decoded_);
+    if (pos == decoded_ + loaded_count_) {
+      // The target is between this mini-block and the next one, if any.
+      *exact = false;
+      if (cur_idx_ == num_elems_) {
+        return Status::NotFound("after last key in block");
+      }
+      return Status::OK();
+    }
+    *exact = *pos == target;
+    return Status::OK();
+  }
+
+  Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    CppType* out = reinterpret_cast<CppType*>(dst->data());
+    size_t remaining = to_fetch;
+    while (remaining > 0) {
+      size_t miniblock = cur_idx_ / delta_of_delta::kMiniBlockSize;
+      size_t idx_in_miniblock = cur_idx_ % delta_of_delta::kMiniBlockSize;
+      size_t count = MiniBlockCount(miniblock);
+      size_t nfetch;
+      if (idx_in_miniblock == 0 && remaining >= count &&
+          loaded_miniblock_ != miniblock) {
+        // The whole mini-block is wanted: decode it in place.
+        RETURN_NOT_OK(DecodeMiniBlock(miniblock, out));
+        nfetch = count;
+      } else {
+        RETURN_NOT_OK(LoadMiniBlock(miniblock));
+        nfetch = std::min(remaining, count - idx_in_miniblock);
+        memcpy(out, &decoded_[idx_in_miniblock], nfetch * sizeof(CppType));
+      }
+      out += nfetch;
+      cur_idx_ += nfetch;
+      remaining -= nfetch;
+    }
+    *n = to_fetch;
+    return Status::OK();
+  }
+
+  bool HasNext() const OVERRIDE {
+    return cur_idx_ < num_elems_;
+  }
+
+  size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  size_t GetCurrentIndex() const OVERRIDE {
+    DCHECK(parsed_) << "must parse header first";
+    return cur_idx_;
+  }
+
+  rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+  // The first value, and at least a byte for each of the first delta, the
+  // minimum delta of deltas and the bit width.
+  static const size_t kMinMiniBlockHeaderSize = sizeof(uint64_t) + 3;
+  static const size_t kNoMiniBlock = static_cast<size_t>(-1);
+
+  uint32_t MiniBlockOffset(size_t miniblock) const {
+    return DecodeFixed32(offsets_ + miniblock * sizeof(uint32_t));
+  }
+
+  size_t MiniBlockCount(size_t miniblock) const {
+    return std::min(delta_of_delta::kMiniBlockSize,
+                    num_elems_ - miniblock * delta_of_delta::kMiniBlockSize);
+  }
+
+  CppType MiniBlockFirstValue(size_t miniblock) const {
+    return static_cast<CppType>(DecodeFixed64(data_.data() + MiniBlockOffset(miniblock)));
+  }
+
+  // Decodes mini-block 'miniblock' into 'decoded_', unless it's there already.
+  Status LoadMiniBlock(size_t miniblock) {
+    if (loaded_miniblock_ == miniblock) {
+      return Status::OK();
+    }
+    loaded_miniblock_ = kNoMiniBlock;
+    RETURN_NOT_OK(DecodeMiniBlock(miniblock, decoded_));
+    loaded_miniblock_ = miniblock;
+    loaded_count_ = MiniBlockCount(miniblock);
+    return Status::OK();
+  }
+
+  // Decodes the values of mini-block 'miniblock' into 'out'.
+  Status DecodeMiniBlock(size_t miniblock, CppType* out) const {
+    const uint8_t* p = data_.data() + MiniBlockOffset(miniblock);
+    const uint8_t* limit = miniblock + 1 < num_miniblocks_ ?
+        data_.data() + MiniBlockOffset(miniblock + 1) : data_.data() + offsets_end_;
+    size_t count = MiniBlockCount(miniblock);
+
+    uint64_t value = DecodeFixed64(p);
+    p += sizeof(uint64_t);
+    uint64_t delta;
+    uint64_t min_dod;
+    p = GetVarint64Ptr(p, limit, &delta);
+    if (PREDICT_TRUE(p != nullptr)) {
+      p = GetVarint64Ptr(p, limit, &min_dod);
+    }
+    if (PREDICT_FALSE(p == nullptr || p >= limit)) {
+      return Status::Corruption(
+          strings::Substitute("truncated header of mini-block $0", miniblock));
+    }
+    int bit_width = *p++;
+    size_t num_packed = count > 2 ? count - 2 : 0;
+    size_t available = limit - p;
+    if (PREDICT_FALSE(bit_width > 64 ||
+                      delta_of_delta::PackedSize(num_packed, bit_width) > available)) {
+      return Status::Corruption(
+          strings::Substitute("invalid bit width $0 of mini-block $1", bit_width, miniblock));
+    }
+    delta = delta_of_delta::ZigZagDecode(delta);
+    min_dod = delta_of_delta::ZigZagDecode(min_dod);
+
+    uint64_t dods[delta_of_delta::kMiniBlockSize];
+    delta_of_delta::UnpackBits(p, num_packed, bit_width, dods);
+
+    out[0] = static_cast<CppType>(value);
+    if (count > 1) {
+      value += delta;
+      out[1] = static_cast<CppType>(value);
+    }
+    for (size_t i = 0; i < num_packed; i++) {
+      delta += dods[i] + min_dod;
+      value += delta;
+      out[i + 2] = static_cast<CppType>(value);
+    }
+    return Status::OK();
+  }
+
+  Slice data_;
+  bool parsed_;
+  rowid_t ordinal_pos_base_;
+  uint32_t num_elems_;
+  size_t num_miniblocks_;
+  size_t offsets_end_;
+  const uint8_t* offsets_;
+
+  size_t cur_idx_;
+
+  // The values of the most recently loaded mini-block.
+  size_t loaded_miniblock_;
+  size_t loaded_count_;
+  CppType decoded_[delta_of_delta::kMiniBlockSize];
+};
+
+} // namespace cfile
+} // namespace kudu
+#endif
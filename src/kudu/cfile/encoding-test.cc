@@ -17,6 +17,8 @@
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <limits>
 #include <stdlib.h>
@@ -25,15 +27,18 @@
 #include "kudu/cfile/block_encodings.h"
 #include "kudu/cfile/bshuf_block.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/delta_of_delta_block.h"
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
+#include "kudu/cfile/xor_block.h"
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/binary_prefix_block.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/group_varint-inl.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/memory/arena.h"
@@ -284,6 +289,41 @@ class TestEncoding : public ::testing::Test {
     }
   }
 
+  // Decode a block in batches of varying sizes, with values long enough, and
+  // sharing prefixes long enough, for their lengths to take multi-byte varints.
+  template<class BuilderType, class DecoderType>
+  void TestBinaryBlockBatches() {
+    gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+    BuilderType sbb(opts.get());
+    vector<string> values;
+    vector<Slice> slices;
+    for (int i = 0; i < 100; i++) {
+      values.push_back(StringPrintf("%s%04d%s", string(i % 3 == 0 ? 200 : 5, 'a').c_str(), i,
+                                    string(i % 5 == 0 ? 300 : 0, 'b').c_str()));
+    }
+    for (const string& v : values) {
+      slices.push_back(Slice(v));
+    }
+    ASSERT_EQ(values.size(), sbb.Add(reinterpret_cast<const uint8_t*>(&slices[0]),
+                                     slices.size()));
+    Slice s = sbb.Finish(0);
+
+    DecoderType sbd(s);
+    ASSERT_OK(sbd.ParseHeader());
+    ScopedColumnBlock<STRING> cb(values.size());
+    int i = 0;
+    for (size_t batch = 1; sbd.HasNext(); batch = batch * 2 + 1) {
+      ColumnDataView cdv(&cb);
+      size_t n = batch;
+      ASSERT_OK(sbd.CopyNextValues(&n, &cdv));
+      ASSERT_GT(n, 0);
+      for (size_t j = 0; j < n; j++, i++) {
+        ASSERT_EQ(values[i], cb[j].ToString()) << i;
+      }
+    }
+    ASSERT_EQ(values.size(), i);
+  }
+
   template<class BlockBuilderType, class BlockDecoderType, DataType IntType>
   void DoSeekTest(BlockBuilderType* ibb, int num_ints, int num_queries, bool verify) {
     // TODO : handle and verify seeking inside a run for testing RLE
@@ -414,6 +454,95 @@ class TestEncoding : public ::testing::Test {
     }
   }
 
+  // Logs the encoded size of 'src' and the time to decode it in blocks of
+  // 1000 rows, 'num_iters' times.
+  template <DataType Type, class BuilderType, class DecoderType>
+  void BenchmarkDecode(const char* name, const typename TypeTraits<Type>::cpp_type* src,
+                       uint32_t size, int num_iters) {
+    typedef typename TypeTraits<Type>::cpp_type CppType;
+    gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+    BuilderType pbb(opts.get());
+    CHECK_EQ(size, pbb.Add(reinterpret_cast<const uint8_t *>(src), size));
+    Slice s = pbb.Finish(0);
+    LOG(INFO) << name << ": " << s.size() << " bytes for " << size << " values ("
+              << StringPrintf("%.2f", s.size() * 8.0 / size) << " bits per value)";
+
+    vector<CppType> decoded(1000);
+    ColumnBlock dst_block(GetTypeInfo(Type), nullptr, &decoded[0], decoded.size(), &arena_);
+    LOG_TIMING(INFO, strings::Substitute("Decoding $0", name)) {
+      for (int i = 0; i < num_iters; i++) {
+        DecoderType pbd(s);
+        ASSERT_OK(pbd.ParseHeader());
+        while (pbd.HasNext()) {
+          ColumnDataView view(&dst_block);
+          size_t n = dst_block.nrows();
+          ASSERT_OK_FAST(pbd.CopyNextValues(&n, &view));
+        }
+      }
+    }
+  }
+
+  // Encodes 'src' and decodes it into the non-NULL cells of a block with a
+  // random null bitmap, both with the decoder's CopyNextNonNullValues() and
+  // with the default one-call-per-run implementation.
+  template <DataType Type, class BuilderType, class DecoderType>
+  void TestCopyNextNonNullValues(typename TypeTraits<Type>::cpp_type* src, uint32_t size) {
+    typedef typename TypeTraits<Type>::cpp_type CppType;
+    gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+    BuilderType pbb(opts.get());
+    pbb.Add(reinterpret_cast<const uint8_t *>(src), size);
+    Slice s = pbb.Finish(0);
+
+    // Alternate runs of 1 to 4 NULL and non-NULL cells.
+    vector<bool> cells;
+    size_t nvalues = 0;
+    bool not_null = false;
+    while (nvalues < size) {
+      size_t run = (random() % 4) + 1;
+      if (not_null) {
+        run = std::min<size_t>(run, size - nvalues);
+        nvalues += run;
+      }
+      cells.insert(cells.end(), run, not_null);
+      not_null = !not_null;
+    }
+    const size_t nrows = cells.size();
+    vector<uint8_t> null_bitmap(BitmapSize(nrows));
+    for (size_t i = 0; i < nrows; i++) {
+      BitmapChange(&null_bitmap[0], i, cells[i]);
+    }
+
+    for (int use_default = 0; use_default < 2; use_default++) {
+      DecoderType pbd(s);
+      ASSERT_OK(pbd.ParseHeader());
+      vector<CppType> decoded(nrows);
+      ColumnBlock dst_block(GetTypeInfo(Type), &null_bitmap[0], &decoded[0], nrows, &arena_);
+      ColumnDataView view(&dst_block);
+      // Decode in a few uneven chunks.
+      size_t rem = nrows;
+      while (rem > 0) {
+        size_t n = std::min<size_t>((random() % 300) + 1, rem);
+        if (use_default) {
+          ASSERT_OK(pbd.BlockDecoder::CopyNextNonNullValues(n, &view));
+        } else {
+          ASSERT_OK(pbd.CopyNextNonNullValues(n, &view));
+        }
+        view.Advance(n);
+        rem -= n;
+      }
+      ASSERT_FALSE(pbd.HasNext());
+
+      size_t idx = 0;
+      for (size_t i = 0; i < nrows; i++) {
+        if (BitmapTest(&null_bitmap[0], i)) {
+          ASSERT_EQ(src[idx], decoded[i]) << "at cell " << i;
+          idx++;
+        }
+      }
+      ASSERT_EQ(size, idx);
+    }
+  }
+
   // Test truncation of blocks
   template<class BuilderType, class DecoderType>
   void TestBinaryBlockTruncation() {
@@ -626,6 +755,60 @@ TEST_F(TestEncoding, TestBShufIntBlockEncoder) {
                                     BShufBlockDecoder<INT32> >(ints.get(), kSize);
 }
 
+TEST_F(TestEncoding, TestCopyNextNonNullValues) {
+  const uint32_t kSize = 10000;
+
+  gscoped_ptr<int32_t[]> ints(new int32_t[kSize]);
+  gscoped_ptr<double[]> doubles(new double[kSize]);
+  for (int i = 0; i < kSize; i++) {
+    ints.get()[i] = random();
+    doubles.get()[i] = random() + 0.5;
+  }
+
+  TestCopyNextNonNullValues<INT32, PlainBlockBuilder<INT32>,
+                            PlainBlockDecoder<INT32> >(ints.get(), kSize);
+  TestCopyNextNonNullValues<INT32, BShufBlockBuilder<INT32>,
+                            BShufBlockDecoder<INT32> >(ints.get(), kSize);
+  TestCopyNextNonNullValues<DOUBLE, BShufBlockBuilder<DOUBLE>,
+                            BShufBlockDecoder<DOUBLE> >(doubles.get(), kSize);
+}
+
+// Timestamps at a nearly constant rate, with occasional jumps and the
+// extremes of the type, which need the full 64 bits per value.
+TEST_F(TestEncoding, TestDeltaOfDeltaTimestamps) {
+  const uint32_t kSize = 10000;
+  gscoped_ptr<int64_t[]> timestamps(new int64_t[kSize]);
+  int64_t ts = 1480000000000000L;
+  for (int i = 0; i < kSize; i++) {
+    ts += 1000000 + (random() % 3) - 1;
+    if (random() % 1000 == 0) {
+      ts += random();
+    }
+    timestamps.get()[i] = ts;
+  }
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  {
+    DeltaOfDeltaBlockBuilder<INT64> builder(opts.get());
+    ASSERT_EQ(kSize, builder.Add(reinterpret_cast<const uint8_t*>(timestamps.get()), kSize));
+    Slice s = builder.Finish(0);
+    LOG(INFO) << "Encoded size for " << kSize << " timestamps: " << s.size();
+    ASSERT_LT(s.size(), kSize * sizeof(int64_t) / 4);
+  }
+  TestEncodeDecodeTemplateBlockEncoder<INT64, DeltaOfDeltaBlockBuilder<INT64>,
+                                       DeltaOfDeltaBlockDecoder<INT64> >(timestamps.get(), kSize);
+
+  const int64_t kMin = std::numeric_limits<int64_t>::min();
+  const int64_t kMax = std::numeric_limits<int64_t>::max();
+  int64_t extremes[] = { kMin, kMax, kMin, 0, kMax, kMax, -1, kMin, 1, kMin };
+  TestEncodeDecodeTemplateBlockEncoder<INT64, DeltaOfDeltaBlockBuilder<INT64>,
+                                       DeltaOfDeltaBlockDecoder<INT64> >(extremes,
+                                                                         arraysize(extremes));
+  uint64_t unsigned_extremes[] = { 0, ~0ULL, 0, 1, ~0ULL - 1, 0 };
+  TestEncodeDecodeTemplateBlockEncoder<UINT64, DeltaOfDeltaBlockBuilder<UINT64>,
+                                       DeltaOfDeltaBlockDecoder<UINT64> >(
+      unsigned_extremes, arraysize(unsigned_extremes));
+}
+
 TEST_F(TestEncoding, TestBShufFloatBlockEncoder) {
   const uint32_t kSize = 10000;
 
@@ -650,6 +833,94 @@ TEST_F(TestEncoding, TestBShufDoubleBlockEncoder) {
                                     BShufBlockDecoder<DOUBLE> >(doubles.get(), kSize);
 }
 
+// A slowly varying gauge, rounded to two decimal places, with runs of
+// repeated values and the special values of the type.
+TEST_F(TestEncoding, TestXorDoubleBlockEncoder) {
+  const uint32_t kSize = 10000;
+  gscoped_ptr<double[]> doubles(new double[kSize]);
+  double value = 20.0;
+  for (int i = 0; i < kSize; i++) {
+    if (random() % 4 != 0) {
+      value = round((value + static_cast<double>(random() % 21 - 10) / 100) * 100) / 100;
+    }
+    doubles.get()[i] = value;
+  }
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  {
+    XorBlockBuilder<DOUBLE> builder(opts.get());
+    ASSERT_EQ(kSize, builder.Add(reinterpret_cast<const uint8_t*>(doubles.get()), kSize));
+    Slice s = builder.Finish(0);
+    LOG(INFO) << "Encoded size for " << kSize << " doubles: " << s.size();
+    ASSERT_LT(s.size(), kSize * sizeof(double));
+  }
+  TestEncodeDecodeTemplateBlockEncoder<DOUBLE, XorBlockBuilder<DOUBLE>,
+                                       XorBlockDecoder<DOUBLE> >(doubles.get(), kSize);
+
+  double specials[] = { 0.0, -0.0, 1.0, std::numeric_limits<double>::max(),
+                        std::numeric_limits<double>::min(),
+                        std::numeric_limits<double>::denorm_min(),
+                        -std::numeric_limits<double>::infinity(), 1.0, 1.0,
+                        std::numeric_limits<double>::infinity(), -1.0 };
+  TestEncodeDecodeTemplateBlockEncoder<DOUBLE, XorBlockBuilder<DOUBLE>,
+                                       XorBlockDecoder<DOUBLE> >(specials, arraysize(specials));
+}
+
+TEST_F(TestEncoding, TestXorFloatBlockEncoder) {
+  const uint32_t kSize = 10000;
+  gscoped_ptr<float[]> floats(new float[kSize]);
+  float value = 1.0f;
+  for (int i = 0; i < kSize; i++) {
+    value += static_cast<float>(random() % 5 - 2) / 4;
+    floats.get()[i] = value;
+  }
+  TestEncodeDecodeTemplateBlockEncoder<FLOAT, XorBlockBuilder<FLOAT>,
+                                       XorBlockDecoder<FLOAT> >(floats.get(), kSize);
+
+  // Random bit patterns share no bits with their neighbours, which is the
+  // worst case of the encoding.
+  for (int i = 0; i < kSize; i++) {
+    floats.get()[i] = random() + static_cast<float>(random())/INT_MAX;
+  }
+  TestEncodeDecodeTemplateBlockEncoder<FLOAT, XorBlockBuilder<FLOAT>,
+                                       XorBlockDecoder<FLOAT> >(floats.get(), kSize);
+}
+
+TEST_F(TestEncoding, TestXorSeekAtOrAfterValue) {
+  const uint32_t kSize = 1000;
+  vector<double> doubles;
+  for (int i = 0; i < kSize; i++) {
+    doubles.push_back(i * 1.5);
+  }
+  gscoped_ptr<WriterOptions> opts(NewWriterOptions());
+  XorBlockBuilder<DOUBLE> builder(opts.get());
+  builder.Add(reinterpret_cast<const uint8_t*>(&doubles[0]), kSize);
+  Slice s = builder.Finish(0);
+
+  XorBlockDecoder<DOUBLE> decoder(s);
+  ASSERT_OK(decoder.ParseHeader());
+  for (int i = 0; i < 200; i++) {
+    int target_idx = random() % kSize;
+    bool exact;
+    double target = doubles[target_idx];
+    ASSERT_OK(decoder.SeekAtOrAfterValue(&target, &exact));
+    ASSERT_TRUE(exact);
+    ASSERT_EQ(target_idx, decoder.GetCurrentIndex());
+
+    target += 0.5;
+    ASSERT_EQ(target_idx + 1 == kSize,
+              decoder.SeekAtOrAfterValue(&target, &exact).IsNotFound());
+    if (target_idx + 1 < kSize) {
+      ASSERT_FALSE(exact);
+      ASSERT_EQ(target_idx + 1, decoder.GetCurrentIndex());
+    }
+  }
+  double before = -1.0;
+  bool exact;
+  ASSERT_OK(decoder.SeekAtOrAfterValue(&before, &exact));
+  ASSERT_FALSE(exact);
+  ASSERT_EQ(0, decoder.GetCurrentIndex());
+}
+
 TEST_F(TestEncoding, TestIntBlockEncoder) {
   gscoped_ptr<WriterOptions> opts(NewWriterOptions());
   GVIntBlockBuilder ibb(opts.get());
@@ -741,6 +1012,14 @@ TEST_F(TestEncoding, TestBinaryPlainBlockBuilderRoundTrip) {
 }
 
 // Test empty block encode/decode
+TEST_F(TestEncoding, TestBinaryPrefixBlockBatches) {
+  TestBinaryBlockBatches<BinaryPrefixBlockBuilder, BinaryPrefixBlockDecoder>();
+}
+
+TEST_F(TestEncoding, TestBinaryPlainBlockBatches) {
+  TestBinaryBlockBatches<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
+}
+
 TEST_F(TestEncoding, TestBinaryPlainEmptyBlockEncodeDecode) {
   TestEmptyBlockEncodeDecode<BinaryPlainBlockBuilder, BinaryPlainBlockDecoder>();
 }
@@ -766,6 +1045,38 @@ TEST_F(TestEncoding, GVIntSeekBenchmark) {
 }
 #endif
 
+#ifdef NDEBUG
+// Compares bitshuffle and XOR encoding on synthetic metric series.
+TEST_F(TestEncoding, XorDecodeBenchmark) {
+  // Small enough for a single block of either encoding.
+  const uint32_t kSize = 30000;
+  const int kIters = 1000;
+  vector<double> walk(kSize);
+  vector<double> gauge(kSize);
+  vector<double> sensor(kSize);
+  double value = 100.0;
+  for (int i = 0; i < kSize; i++) {
+    // A price-like random walk with two decimal places.
+    value = round((value + static_cast<double>(random() % 21 - 10) / 100) * 100) / 100;
+    walk[i] = value;
+    // A gauge which changes once every few hundred samples.
+    gauge[i] = static_cast<double>(i / 300 % 7) * 0.5;
+    // A noisy sensor reading which shares few low-order bits.
+    sensor[i] = 20.0 + static_cast<double>(random()) / RAND_MAX;
+  }
+  const struct {
+    const char* name;
+    const vector<double>& values;
+  } series[] = { { "random walk", walk }, { "gauge", gauge }, { "sensor", sensor } };
+  for (const auto& s : series) {
+    BenchmarkDecode<DOUBLE, BShufBlockBuilder<DOUBLE>, BShufBlockDecoder<DOUBLE> >(
+        strings::Substitute("bitshuffle $0", s.name).c_str(), &s.values[0], kSize, kIters);
+    BenchmarkDecode<DOUBLE, XorBlockBuilder<DOUBLE>, XorBlockDecoder<DOUBLE> >(
+        strings::Substitute("xor $0", s.name).c_str(), &s.values[0], kSize, kIters);
+  }
+}
+#endif
+
 TEST_F(TestEncoding, GVIntSeekTest) {
   gscoped_ptr<WriterOptions> opts(NewWriterOptions());
   gscoped_ptr<GVIntBlockBuilder> ibb(new GVIntBlockBuilder(opts.get()));
@@ -809,7 +1120,16 @@ struct BitshuffleTestTraits {
     typedef BShufBlockDecoder<type> decoder_type;
   };
 };
-typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits> MyTestFixtures;
+
+struct DeltaOfDeltaTestTraits {
+  template<DataType type>
+  struct Classes {
+    typedef DeltaOfDeltaBlockBuilder<type> encoder_type;
+    typedef DeltaOfDeltaBlockDecoder<type> decoder_type;
+  };
+};
+typedef testing::Types<RleTestTraits, BitshuffleTestTraits, PlainTestTraits,
+                       DeltaOfDeltaTestTraits> MyTestFixtures;
 TYPED_TEST_CASE(IntEncodingTest, MyTestFixtures);
 
 template<class TestTraits>
@@ -20,6 +20,7 @@
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/index_btree.h"
 #include "kudu/gutil/endian.h"
+#include "kudu/gutil/stringprintf.h"
 #include "kudu/util/hexdump.h"
 #include "kudu/util/status.h"
 #include "kudu/util/test_macros.h"
@@ -28,7 +29,7 @@ namespace kudu { namespace cfile {
 
 Status SearchInReaderString(const IndexBlockReader &reader,
                             string search_key,
-                            BlockPointer *ptr, Slice *match) {
+                            BlockPointer *ptr, string *match) {
 
   static faststring dst;
 
@@ -39,14 +40,14 @@ Status SearchInReaderString(const IndexBlockReader &reader,
   RETURN_NOT_OK(s);
 
   *ptr = iter->GetCurrentBlockPointer();
-  *match = iter->GetCurrentKey();
+  *match = iter->GetCurrentKey().ToString();
   return Status::OK();
 }
 
 
 Status SearchInReaderUint32(const IndexBlockReader &reader,
                             uint32_t search_key,
-                            BlockPointer *ptr, Slice *match) {
+                            BlockPointer *ptr, string *match) {
 
   static faststring dst;
 
@@ -57,7 +58,7 @@ Status SearchInReaderUint32(const IndexBlockReader &reader,
   RETURN_NOT_OK(s);
 
   *ptr = iter->GetCurrentBlockPointer();
-  *match = iter->GetCurrentKey();
+  *match = iter->GetCurrentKey().ToString();
   return Status::OK();
 }
 
@@ -120,7 +121,7 @@ TEST(TestIndexBuilder, TestIndexWithInts) {
 
   // Search for a value prior to first entry
   BlockPointer ptr;
-  Slice match;
+  string match;
   Status status = SearchInReaderUint32(reader, 0, &ptr, &match);
   EXPECT_TRUE(status.IsNotFound());
 
@@ -218,7 +219,7 @@ TEST(TestIndexBlock, TestIndexBlockWithStrings) {
 
   // Search for a value prior to first entry
   BlockPointer ptr;
-  Slice match;
+  string match;
   Status status = SearchInReaderString(reader, "hello", &ptr, &match);
   EXPECT_TRUE(status.IsNotFound());
 
@@ -323,6 +324,67 @@ TEST(TestIndexBlock, TestIterator) {
   ASSERT_TRUE(iter->HasNext());
 }
 
+// Test that index blocks with prefix compressed keys are smaller than those
+// with whole keys, and that seeks and iteration find the same entries in
+// both, whatever the interval between restart points.
+TEST(TestIndexBlock, TestPrefixCompressedKeys) {
+  const int kNumEntries = 1000;
+  vector<string> keys;
+  for (int i = 0; i < kNumEntries; i++) {
+    keys.push_back(StringPrintf("composite-key-prefix-%08d", i * 10));
+  }
+
+  size_t plain_size = 0;
+  for (int restart_interval : { 0, 1, 4, 16 }) {
+    SCOPED_TRACE(restart_interval);
+    WriterOptions opts;
+    opts.index_block_restart_interval = restart_interval;
+    IndexBlockBuilder idx(&opts, true);
+    for (int i = 0; i < kNumEntries; i++) {
+      idx.Add(keys[i], BlockPointer(100000 + i, 64 * 1024));
+    }
+    Slice first_key;
+    ASSERT_OK(idx.GetFirstKey(&first_key));
+    ASSERT_EQ(keys[0], first_key);
+
+    Slice s = idx.Finish();
+    if (restart_interval == 0) {
+      plain_size = s.size();
+    } else if (restart_interval > 1) {
+      ASSERT_LT(s.size(), plain_size / 2);
+    }
+
+    IndexBlockReader reader;
+    ASSERT_OK(reader.Parse(s));
+    ASSERT_EQ(restart_interval > 0, reader.is_prefix_compressed());
+    ASSERT_EQ(kNumEntries, static_cast<int>(reader.Count()));
+    gscoped_ptr<IndexBlockIterator> iter(reader.NewIterator());
+
+    ASSERT_TRUE(iter->SeekAtOrBefore("composite-key-prefix").IsNotFound());
+    for (int i = 0; i < kNumEntries; i++) {
+      // Seek to the key itself, and to a key just after it.
+      ASSERT_OK(iter->SeekAtOrBefore(keys[i]));
+      ASSERT_EQ(keys[i], iter->GetCurrentKey());
+      ASSERT_EQ(100000 + i, static_cast<int>(iter->GetCurrentBlockPointer().offset()));
+      ASSERT_OK(iter->SeekAtOrBefore(keys[i] + "0"));
+      ASSERT_EQ(keys[i], iter->GetCurrentKey());
+    }
+    ASSERT_OK(iter->SeekAtOrBefore("composite-key-prefix-99999999"));
+    ASSERT_EQ(keys.back(), iter->GetCurrentKey());
+
+    ASSERT_OK(iter->SeekToIndex(kNumEntries / 2 + 1));
+    for (int i = kNumEntries / 2 + 1; i < kNumEntries; i++) {
+      ASSERT_EQ(keys[i], iter->GetCurrentKey());
+      ASSERT_EQ(100000 + i, static_cast<int>(iter->GetCurrentBlockPointer().offset()));
+      ASSERT_EQ(i + 1 < kNumEntries, iter->HasNext());
+      if (iter->HasNext()) {
+        ASSERT_OK(iter->Next());
+      }
+    }
+    ASSERT_TRUE(iter->Next().IsNotFound());
+  }
+}
+
 TEST(TestIndexKeys, TestGetSeparatingKey) {
   // Test example cases
   Slice left = "";
@@ -15,8 +15,11 @@
 // specific language governing permissions and limitations
 // under the License.
 
-#include "kudu/cfile/cfile_writer.h"
 #include "kudu/cfile/index_block.h"
+
+#include <algorithm>
+
+#include "kudu/cfile/cfile_writer.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/protobuf_util.h"
 
@@ -51,7 +54,10 @@ IndexBlockBuilder::IndexBlockBuilder(
   bool is_leaf)
   : options_(options),
     finished_(false),
-    is_leaf_(is_leaf) {
+    is_leaf_(is_leaf),
+    restart_interval_(options->index_block_restart_interval),
+    num_entries_(0) {
+  DCHECK_GE(restart_interval_, 0);
 }
 
 
@@ -61,9 +67,27 @@ void IndexBlockBuilder::Add(const Slice &keyptr,
     "Must Reset() after Finish() before more Add()";
 
   size_t entry_offset = buffer_.size();
-  SliceEncode(keyptr, &buffer_);
+  if (restart_interval_ == 0) {
+    SliceEncode(keyptr, &buffer_);
+    entry_offsets_.push_back(entry_offset);
+  } else {
+    // Prefix compressed entries are encoded as follows:
+    // <shared prefix length> <length of the rest of the key> <rest of the key>
+    size_t shared = 0;
+    if (num_entries_ % restart_interval_ == 0) {
+      entry_offsets_.push_back(entry_offset);
+    } else {
+      size_t max_shared = std::min(keyptr.size(), last_key_.size());
+      while (shared < max_shared && keyptr[shared] == last_key_[shared]) {
+        shared++;
+      }
+    }
+    InlinePutVarint32(&buffer_, shared);
+    SliceEncode(Slice(keyptr.data() + shared, keyptr.size() - shared), &buffer_);
+    last_key_.assign_copy(keyptr.data(), keyptr.size());
+  }
   ptr.EncodeTo(&buffer_);
-  entry_offsets_.push_back(entry_offset);
+  num_entries_++;
 }
 
 Slice IndexBlockBuilder::Finish() {
@@ -74,9 +98,12 @@ Slice IndexBlockBuilder::Finish() {
   }
 
   IndexBlockTrailerPB trailer;
-  trailer.set_num_entries(entry_offsets_.size());
+  trailer.set_num_entries(num_entries_);
   trailer.set_type(
     is_leaf_ ? IndexBlockTrailerPB::LEAF : IndexBlockTrailerPB::INTERNAL);
+  if (restart_interval_ > 0) {
+    trailer.set_restart_interval(restart_interval_);
+  }
   AppendPBToString(trailer, &buffer_);
 
   InlinePutFixed32(&buffer_, trailer.GetCachedSize());
@@ -91,11 +118,19 @@ Status IndexBlockBuilder::GetFirstKey(Slice *key) const {
   // TODO: going to need to be able to pass an arena or something
   // for slices, which need to copy
 
-  if (entry_offsets_.empty()) {
+  if (num_entries_ == 0) {
     return Status::NotFound("no keys in builder");
   }
 
-  bool success = nullptr != SliceDecode(buffer_.data(),buffer_.data() + buffer_.size(),key);
+  const uint8_t *ptr = buffer_.data();
+  const uint8_t *limit = buffer_.data() + buffer_.size();
+  uint32_t shared_unused;
+  if (restart_interval_ > 0) {
+    // The first entry is a restart point, so its key is stored whole after
+    // its zero shared prefix length.
+    ptr = GetVarint32Ptr(ptr, limit, &shared_unused);
+  }
+  bool success = ptr != nullptr && nullptr != SliceDecode(ptr, limit, key);
 
   if (success) {
     return Status::OK();
@@ -121,7 +156,10 @@ size_t IndexBlockBuilder::EstimateEncodedSize() const {
 // Construct a reader.
 // After construtoin, call
 IndexBlockReader::IndexBlockReader()
-  : parsed_(false) {
+  : key_offsets_(nullptr),
+    num_offsets_(0),
+    restart_interval_(0),
+    parsed_(false) {
 }
 
 void IndexBlockReader::Reset() {
@@ -158,8 +196,19 @@ Status IndexBlockReader::Parse(const Slice &data) {
       trailer_.InitializationErrorString());
   }
 
-  key_offsets_ = trailer_ptr - sizeof(uint32_t) * trailer_.num_entries();
-  CHECK(trailer_ptr >= data_.data());
+  if (trailer_.num_entries() < 0) {
+    return Status::Corruption("invalid number of index block entries");
+  }
+  restart_interval_ = trailer_.restart_interval();
+  if (restart_interval_ > 0) {
+    num_offsets_ = (trailer_.num_entries() + restart_interval_ - 1) / restart_interval_;
+  } else {
+    num_offsets_ = trailer_.num_entries();
+  }
+  if (sizeof(uint32_t) * num_offsets_ > static_cast<size_t>(trailer_ptr - data_.data())) {
+    return Status::Corruption("index block too small for its entries");
+  }
+  key_offsets_ = trailer_ptr - sizeof(uint32_t) * num_offsets_;
 
   VLOG(2) << "Parsed index trailer: " << trailer_.DebugString();
 
@@ -194,6 +243,56 @@ int IndexBlockReader::CompareKey(int idx_in_block,
   return this_slice.compare(search_key);
 }
 
+int IndexBlockReader::CompareRestartKey(int restart_idx,
+                                        const Slice &search_key) const {
+  const uint8_t *key_ptr, *limit;
+  GetKeyPointer(restart_idx, &key_ptr, &limit);
+  uint32_t shared;
+  Slice this_slice;
+  key_ptr = GetVarint32Ptr(key_ptr, limit, &shared);
+  if (PREDICT_FALSE(key_ptr == nullptr || shared != 0 ||
+                    SliceDecode(key_ptr, limit, &this_slice) == nullptr)) {
+    LOG(WARNING)<< "Invalid data in block!";
+    return 0;
+  }
+
+  return this_slice.compare(search_key);
+}
+
+const uint8_t* IndexBlockReader::DecodeCompressedEntry(const uint8_t *ptr,
+                                                       const Slice &prev_key,
+                                                       faststring *key,
+                                                       BlockPointer *block_ptr) const {
+  // The entries end where the restart point offsets begin.
+  const uint8_t *limit = key_offsets_;
+  uint32_t shared;
+  Slice non_shared;
+  ptr = GetVarint32Ptr(ptr, limit, &shared);
+  if (ptr == nullptr || shared > prev_key.size()) {
+    return nullptr;
+  }
+  ptr = SliceDecode(ptr, limit, &non_shared);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  key->resize(shared + non_shared.size());
+  memmove(key->data(), prev_key.data(), shared);
+  memcpy(key->data() + shared, non_shared.data(), non_shared.size());
+
+  uint64_t offset;
+  uint32_t size;
+  ptr = GetVarint64Ptr(ptr, limit, &offset);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  ptr = GetVarint32Ptr(ptr, limit, &size);
+  if (ptr == nullptr) {
+    return nullptr;
+  }
+  *block_ptr = BlockPointer(offset, size);
+  return ptr;
+}
+
 Status IndexBlockReader::ReadEntry(size_t idx, Slice *key, BlockPointer *block_ptr) const {
   if (idx >= trailer_.num_entries()) {
     return Status::NotFound("Invalid index");
@@ -221,9 +320,9 @@ void IndexBlockReader::GetKeyPointer(int idx_in_block, const uint8_t **ptr,
 
   int next_idx = idx_in_block + 1;
 
-  if (PREDICT_FALSE(next_idx >= trailer_.num_entries())) {
-    DCHECK(next_idx == Count()) << "Bad index: " << idx_in_block
-                                << " Count: " << Count();
+  if (PREDICT_FALSE(next_idx >= static_cast<int>(num_offsets_))) {
+    DCHECK(next_idx == static_cast<int>(num_offsets_)) << "Bad index: " << idx_in_block
+                                     << " Count: " << num_offsets_;
     // last key in block: limit is the beginning of the offsets array
     *limit = key_offsets_;
   } else {
@@ -237,21 +336,30 @@ void IndexBlockReader::GetKeyPointer(int idx_in_block, const uint8_t **ptr,
 void IndexBlockBuilder::Reset() {
   buffer_.clear();
   entry_offsets_.clear();
+  num_entries_ = 0;
+  last_key_.clear();
   finished_ = false;
 }
 
 IndexBlockIterator::IndexBlockIterator(const IndexBlockReader *reader)
   : reader_(reader),
     cur_idx_(-1),
-    seeked_(false) {
+    seeked_(false),
+    cur_buf_(0),
+    next_entry_(nullptr) {
 }
 
 void IndexBlockIterator::Reset() {
   seeked_ = false;
   cur_idx_ = -1;
+  next_entry_ = nullptr;
 }
 
 Status IndexBlockIterator::SeekAtOrBefore(const Slice &search_key) {
+  if (reader_->is_prefix_compressed()) {
+    return SeekAtOrBeforeCompressed(search_key);
+  }
+
   size_t left = 0;
   size_t right = reader_->Count() - 1;
   while (left < right) {
@@ -280,11 +388,95 @@ Status IndexBlockIterator::SeekAtOrBefore(const Slice &search_key) {
   return SeekToIndex(left);
 }
 
-Status IndexBlockIterator::SeekToIndex(size_t idx) {
+Status IndexBlockIterator::SeekAtOrBeforeCompressed(const Slice &search_key) {
+  if (reader_->num_restarts() == 0) {
+    return Status::NotFound("key not present");
+  }
+
+  // Find the last restart point at or before the key: their keys are stored
+  // whole, so they can be compared without decoding the entries before them.
+  size_t left = 0;
+  size_t right = reader_->num_restarts() - 1;
+  while (left < right) {
+    int mid = (left + right + 1) / 2;
+
+    int compare = reader_->CompareRestartKey(mid, search_key);
+    if (compare < 0) {  // mid < search
+      left = mid;
+    } else if (compare > 0) {  // mid > search
+      right = mid - 1;
+    } else {  // mid == search
+      return SeekToIndex(mid * reader_->restart_interval_);
+    }
+  }
+
+  if (reader_->CompareRestartKey(left, search_key) > 0) {
+    // The key is lower than the lowest in the block.
+    return Status::NotFound("key not present");
+  }
+  RETURN_NOT_OK(SeekToIndex(left * reader_->restart_interval_));
+
+  // Then scan the rest of the restart interval for the last entry at or
+  // before the key.
+  while (HasNext() && (cur_idx_ + 1) % reader_->restart_interval_ != 0) {
+    BlockPointer block_ptr;
+    const uint8_t *next;
+    RETURN_NOT_OK(DecodeNext(next_entry_, false, &block_ptr, &next));
+    if (Slice(key_bufs_[cur_buf_ ^ 1]).compare(search_key) > 0) {
+      break;
+    }
+    AdvanceTo(cur_idx_ + 1, block_ptr, next);
+  }
+  return Status::OK();
+}
+
+Status IndexBlockIterator::DecodeNext(const uint8_t *ptr, bool is_restart,
+                                      BlockPointer *block_ptr, const uint8_t **next) const {
+  *next = reader_->DecodeCompressedEntry(ptr, is_restart ? Slice() : cur_key_,
+                                         &key_bufs_[cur_buf_ ^ 1], block_ptr);
+  if (*next == nullptr) {
+    return Status::Corruption("Invalid key in index");
+  }
+  return Status::OK();
+}
+
+void IndexBlockIterator::AdvanceTo(size_t idx, const BlockPointer &block_ptr,
+                                   const uint8_t *next) {
+  cur_buf_ ^= 1;
   cur_idx_ = idx;
-  Status s = reader_->ReadEntry(idx, &cur_key_, &cur_ptr_);
-  seeked_ = s.ok();
-  return s;
+  cur_key_ = Slice(key_bufs_[cur_buf_]);
+  cur_ptr_ = block_ptr;
+  next_entry_ = next;
+  seeked_ = true;
+}
+
+Status IndexBlockIterator::SeekToIndex(size_t idx) {
+  if (!reader_->is_prefix_compressed()) {
+    cur_idx_ = idx;
+    Status s = reader_->ReadEntry(idx, &cur_key_, &cur_ptr_);
+    seeked_ = s.ok();
+    return s;
+  }
+
+  seeked_ = false;
+  if (idx >= reader_->Count()) {
+    return Status::NotFound("Invalid index");
+  }
+
+  // Decode forward from the restart point the entry belongs to.
+  size_t restart_idx = idx / reader_->restart_interval_;
+  const uint8_t *ptr, *limit_unused;
+  reader_->GetKeyPointer(restart_idx, &ptr, &limit_unused);
+  BlockPointer block_ptr;
+  const uint8_t *next;
+  RETURN_NOT_OK(DecodeNext(ptr, true, &block_ptr, &next));
+  AdvanceTo(restart_idx * reader_->restart_interval_, block_ptr, next);
+  while (cur_idx_ < idx) {
+    seeked_ = false;
+    RETURN_NOT_OK(DecodeNext(next_entry_, false, &block_ptr, &next));
+    AdvanceTo(cur_idx_ + 1, block_ptr, next);
+  }
+  return Status::OK();
 }
 
 bool IndexBlockIterator::HasNext() const {
@@ -292,7 +484,26 @@ bool IndexBlockIterator::HasNext() const {
 }
 
 Status IndexBlockIterator::Next() {
-  return SeekToIndex(cur_idx_ + 1);
+  if (!reader_->is_prefix_compressed() || !seeked_) {
+    return SeekToIndex(cur_idx_ + 1);
+  }
+  if (!HasNext()) {
+    seeked_ = false;
+    return Status::NotFound("Invalid index");
+  }
+  // Restart points store their keys whole, so any entry can be decoded given
+  // the current one.
+  size_t next_idx = cur_idx_ + 1;
+  BlockPointer block_ptr;
+  const uint8_t *next;
+  Status s = DecodeNext(next_entry_, next_idx % reader_->restart_interval_ == 0,
+                        &block_ptr, &next);
+  if (!s.ok()) {
+    seeked_ = false;
+    return s;
+  }
+  AdvanceTo(next_idx, block_ptr, next);
+  return Status::OK();
 }
 
 const BlockPointer &IndexBlockIterator::GetCurrentBlockPointer() const {
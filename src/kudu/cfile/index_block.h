@@ -45,6 +45,11 @@ struct WriterOptions;
 // This works like the rest of the builders in the cfile package.
 // After repeatedly calling Add(), call Finish() to encode it
 // into a Slice, then you may Reset to re-use buffers.
+//
+// If the options have a non-zero 'index_block_restart_interval', the keys are
+// prefix compressed: each entry only stores the bytes of its key past the
+// prefix it shares with the key before it, except for the restart points,
+// which store their keys whole so that they can be binary searched.
 class IndexBlockBuilder {
  public:
   explicit IndexBlockBuilder(const WriterOptions *options,
@@ -67,7 +72,7 @@ class IndexBlockBuilder {
   // Return the number of entries already added to this index
   // block.
   size_t count() const {
-    return entry_offsets_.size();
+    return num_entries_;
   }
 
   // Return an estimate of the post-encoding size of this
@@ -93,8 +98,19 @@ class IndexBlockBuilder {
   // Is this a leaf block?
   bool is_leaf_;
 
+  // Number of entries between restart points, or 0 if the keys are stored
+  // whole.
+  const int restart_interval_;
+
   faststring buffer_;
+
+  // The offsets of every entry, or only of the restart points if the keys
+  // are prefix compressed.
   vector<uint32_t> entry_offsets_;
+  size_t num_entries_;
+
+  // The key of the last entry added, if the keys are prefix compressed.
+  faststring last_key_;
 };
 
 class IndexBlockReader {
@@ -118,6 +134,11 @@ class IndexBlockReader {
 
   bool IsLeaf();
 
+  // Whether the keys of the block are prefix compressed.
+  bool is_prefix_compressed() const {
+    return restart_interval_ > 0;
+  }
+
  private:
   friend class IndexBlockIterator;
 
@@ -126,18 +147,37 @@ class IndexBlockReader {
   Status ReadEntry(size_t idx, Slice *key, BlockPointer *block_ptr) const;
 
   // Set *ptr to the beginning of the index data for the given index
-  // entry.
+  // entry, or for the given restart point if the keys are prefix compressed.
   // Set *limit to the 'limit' pointer for that entry (i.e a pointer
   // beyond which the data no longer is part of that entry).
   //   - *limit can be used to prevent overrunning in the case of a
   //     corrupted length varint or length prefix
   void GetKeyPointer(int idx_in_block, const uint8_t **ptr, const uint8_t **limit) const;
 
+  // Prefix compressed blocks only.
+  //
+  // Compares the whole key stored at the given restart point with
+  // 'search_key'.
+  int CompareRestartKey(int restart_idx, const Slice &search_key) const;
+
+  // Decodes the entry at 'ptr' into 'key' and 'block_ptr'. 'prev_key' is the
+  // key of the entry before it, which its key shares a prefix with; it may be
+  // empty for a restart point. Returns a pointer just past the entry, or null
+  // if the entry is corrupt.
+  const uint8_t* DecodeCompressedEntry(const uint8_t *ptr, const Slice &prev_key,
+                                       faststring *key, BlockPointer *block_ptr) const;
+
+  size_t num_restarts() const {
+    return num_offsets_;
+  }
+
   static const int kMaxTrailerSize = 64*1024;
   Slice data_;
 
   IndexBlockTrailerPB trailer_;
   const uint8_t *key_offsets_;
+  size_t num_offsets_;
+  int restart_interval_;
   bool parsed_;
 
   DISALLOW_COPY_AND_ASSIGN(IndexBlockReader);
@@ -174,12 +214,30 @@ class IndexBlockIterator {
   const Slice GetCurrentKey() const;
 
  private:
+  Status SeekAtOrBeforeCompressed(const Slice &search_key);
+
+  // Prefix compressed blocks only.
+  //
+  // Decodes the entry at 'ptr', which is either a restart point or the entry
+  // after the current one, into the spare key buffer. Doesn't move the
+  // iterator: AdvanceTo() makes the decoded entry the current one.
+  Status DecodeNext(const uint8_t *ptr, bool is_restart,
+                    BlockPointer *block_ptr, const uint8_t **next) const;
+  void AdvanceTo(size_t idx, const BlockPointer &block_ptr, const uint8_t *next);
+
   const IndexBlockReader *reader_;
   size_t cur_idx_;
   Slice cur_key_;
   BlockPointer cur_ptr_;
   bool seeked_;
 
+  // For prefix compressed blocks, the key of the current entry is rebuilt in
+  // one of these buffers, so that the next key can be decoded into the other
+  // without losing it. 'next_entry_' points just past the current entry.
+  mutable faststring key_bufs_[2];
+  int cur_buf_;
+  const uint8_t *next_entry_;
+
   DISALLOW_COPY_AND_ASSIGN(IndexBlockIterator);
 };
 
@@ -267,11 +267,19 @@ Status IndexTreeIterator::LoadBlock(const BlockPointer &block, int depth) {
     seeked = seeked_indexes_.back().get();
   }
 
-  RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data));
+  // The blocks of a value index may be pinned in memory by the reader, which
+  // outlives this iterator.
+  Slice data = reader_->pinned_validx_block(block);
+  if (!data.empty()) {
+    seeked->data = BlockHandle();
+  } else {
+    RETURN_NOT_OK(reader_->ReadBlock(block, CFileReader::CACHE_BLOCK, &seeked->data));
+    data = seeked->data.data();
+  }
   seeked->block_ptr = block;
 
   // Parse the new block.
-  RETURN_NOT_OK(seeked->reader.Parse(seeked->data.data()));
+  RETURN_NOT_OK(seeked->reader.Parse(data));
 
   return Status::OK();
 }
@@ -208,6 +208,19 @@ class PlainBlockDecoder : public BlockDecoder {
     return Status::OK();
   }
 
+  virtual Status CopyNextNonNullValues(size_t nrows, ColumnDataView *dst) OVERRIDE {
+    DCHECK(parsed_);
+    size_t ncopied;
+    bool ok = CopyFixedWidthToNonNullCells<CppType>(
+        data_.data() + kPlainBlockHeaderSize + cur_idx_ * size_of_type,
+        num_elems_ - cur_idx_, nrows, dst, &ncopied);
+    cur_idx_ += ncopied;
+    if (PREDICT_FALSE(!ok)) {
+      return Status::Corruption("block ran out of values before the non-NULL cells");
+    }
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE {
     return cur_idx_ < num_elems_;
   }
@@ -23,7 +23,10 @@
 
 #include "kudu/gutil/port.h"
 #include "kudu/cfile/block_encodings.h"
+#include "kudu/common/column_materialization_context.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/coding-inl.h"
 #include "kudu/util/hexdump.h"
@@ -41,6 +44,31 @@ enum {
   kRleBitmapBlockHeaderSize = 8
 };
 
+// Decode 'count' values from 'decoder' into 'out', evaluating 'pred' once
+// per run of identical values rather than once per row. Rows belonging to
+// runs which do not match the predicate are cleared in 'sel'.
+template<typename CppType>
+inline Status DecodeRunsAndEval(RleDecoder<CppType>* decoder,
+                                size_t count,
+                                const ColumnPredicate& pred,
+                                SelectionVectorView* sel,
+                                CppType* out) {
+  size_t row = 0;
+  while (row < count) {
+    CppType val;
+    size_t run = decoder->GetNextRun(&val, count - row);
+    if (PREDICT_FALSE(run == 0)) {
+      return Status::Corruption("unexpected end of RLE data");
+    }
+    std::fill(out + row, out + row + run, val);
+    if (!pred.EvaluateCell(&val)) {
+      sel->ClearBits(row, run);
+    }
+    row += run;
+  }
+  return Status::OK();
+}
+
 //
 // RLE encoder for the BOOL datatype: uses an RLE-encoded bitmap to
 // represent a bool column.
@@ -182,6 +210,29 @@ class RleBitMapBlockDecoder : public BlockDecoder {
     return Status::OK();
   }
 
+  virtual Status CopyNextAndEval(size_t *n,
+                                 ColumnMaterializationContext *ctx,
+                                 SelectionVectorView *sel,
+                                 ColumnDataView *dst) OVERRIDE {
+    DCHECK(parsed_);
+
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(bool));
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t bits_to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    RETURN_NOT_OK(DecodeRunsAndEval(&rle_decoder_, bits_to_fetch, *ctx->pred(), sel,
+                                    reinterpret_cast<bool*>(dst->data())));
+
+    cur_idx_ += bits_to_fetch;
+    *n = bits_to_fetch;
+    return Status::OK();
+  }
+
   virtual Status SeekAtOrAfterValue(const void *value,
                                     bool *exact_match) OVERRIDE {
     return Status::NotSupported("BOOL keys are not supported!");
@@ -325,8 +376,8 @@ class RleIntBlockDecoder : public BlockDecoder {
 
   virtual void SeekToPositionInBlock(uint pos) OVERRIDE {
     CHECK(parsed_) << "Must call ParseHeader()";
-    CHECK_LT(pos, num_elems_)
-        << "Tried to seek to " << pos << " which is >= number of elements ("
+    CHECK_LE(pos, num_elems_)
+        << "Tried to seek to " << pos << " which is > number of elements ("
         << num_elems_ << ") in the block!.";
 
     if (cur_idx_ == pos) {
@@ -404,6 +455,29 @@ class RleIntBlockDecoder : public BlockDecoder {
     return Status::OK();
   }
 
+  virtual Status CopyNextAndEval(size_t *n,
+                                 ColumnMaterializationContext *ctx,
+                                 SelectionVectorView *sel,
+                                 ColumnDataView *dst) OVERRIDE {
+    DCHECK(parsed_);
+
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    RETURN_NOT_OK(DecodeRunsAndEval(&rle_decoder_, to_fetch, *ctx->pred(), sel,
+                                    reinterpret_cast<CppType*>(dst->data())));
+
+    cur_idx_ += to_fetch;
+    *n = to_fetch;
+    return Status::OK();
+  }
+
   virtual bool HasNext() const OVERRIDE {
     return cur_idx_ < num_elems_;
   }
@@ -23,10 +23,12 @@
 #include <glog/logging.h>
 
 #include "kudu/cfile/bshuf_block.h"
+#include "kudu/cfile/delta_of_delta_block.h"
 #include "kudu/cfile/gvint_block.h"
 #include "kudu/cfile/plain_bitmap_block.h"
 #include "kudu/cfile/plain_block.h"
 #include "kudu/cfile/rle_block.h"
+#include "kudu/cfile/xor_block.h"
 #include "kudu/cfile/binary_dict_block.h"
 #include "kudu/cfile/binary_plain_block.h"
 #include "kudu/cfile/binary_prefix_block.h"
@@ -85,6 +87,36 @@ struct DataTypeEncodingTraits<Type, BIT_SHUFFLE> {
   }
 };
 
+template<DataType IntType>
+struct DataTypeEncodingTraits<IntType, DELTA_OF_DELTA> {
+
+  static Status CreateBlockBuilder(BlockBuilder **bb, const WriterOptions *options) {
+    *bb = new DeltaOfDeltaBlockBuilder<IntType>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder **bd, const Slice &slice,
+                                   CFileIterator *iter) {
+    *bd = new DeltaOfDeltaBlockDecoder<IntType>(slice);
+    return Status::OK();
+  }
+};
+
+template<DataType FloatType>
+struct DataTypeEncodingTraits<FloatType, XOR_ENCODING> {
+
+  static Status CreateBlockBuilder(BlockBuilder **bb, const WriterOptions *options) {
+    *bb = new XorBlockBuilder<FloatType>(options);
+    return Status::OK();
+  }
+
+  static Status CreateBlockDecoder(BlockDecoder **bd, const Slice &slice,
+                                   CFileIterator *iter) {
+    *bd = new XorBlockDecoder<FloatType>(slice);
+    return Status::OK();
+  }
+};
+
 // Template specialization for plain encoded string as they require a
 // specific encoder/decoder.
 template<>
@@ -262,30 +294,40 @@ class TypeEncodingResolver {
     AddMapping<UINT8, PLAIN_ENCODING>();
     AddMapping<UINT8, RLE>();
     AddMapping<UINT8, BIT_SHUFFLE>();
+    AddMapping<UINT8, DELTA_OF_DELTA>();
     AddMapping<INT8, PLAIN_ENCODING>();
     AddMapping<INT8, RLE>();
     AddMapping<INT8, BIT_SHUFFLE>();
+    AddMapping<INT8, DELTA_OF_DELTA>();
     AddMapping<UINT16, PLAIN_ENCODING>();
     AddMapping<UINT16, RLE>();
     AddMapping<UINT16, BIT_SHUFFLE>();
+    AddMapping<UINT16, DELTA_OF_DELTA>();
     AddMapping<INT16, PLAIN_ENCODING>();
     AddMapping<INT16, RLE>();
     AddMapping<INT16, BIT_SHUFFLE>();
+    AddMapping<INT16, DELTA_OF_DELTA>();
     AddMapping<UINT32, GROUP_VARINT>();
     AddMapping<UINT32, RLE>();
     AddMapping<UINT32, PLAIN_ENCODING>();
     AddMapping<UINT32, BIT_SHUFFLE>();
+    AddMapping<UINT32, DELTA_OF_DELTA>();
     AddMapping<INT32, PLAIN_ENCODING>();
     AddMapping<INT32, RLE>();
     AddMapping<INT32, BIT_SHUFFLE>();
+    AddMapping<INT32, DELTA_OF_DELTA>();
     AddMapping<UINT64, PLAIN_ENCODING>();
     AddMapping<UINT64, BIT_SHUFFLE>();
+    AddMapping<UINT64, DELTA_OF_DELTA>();
     AddMapping<INT64, PLAIN_ENCODING>();
     AddMapping<INT64, BIT_SHUFFLE>();
+    AddMapping<INT64, DELTA_OF_DELTA>();
     AddMapping<FLOAT, PLAIN_ENCODING>();
     AddMapping<FLOAT, BIT_SHUFFLE>();
+    AddMapping<FLOAT, XOR_ENCODING>();
     AddMapping<DOUBLE, PLAIN_ENCODING>();
     AddMapping<DOUBLE, BIT_SHUFFLE>();
+    AddMapping<DOUBLE, XOR_ENCODING>();
     AddMapping<BINARY, PLAIN_ENCODING>();
     AddMapping<BINARY, PREFIX_ENCODING>();
     AddMapping<BINARY, DICT_ENCODING>();
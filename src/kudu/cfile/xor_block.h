@@ -0,0 +1,589 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// XOR encoding of FLOAT and DOUBLE blocks, for slowly varying values such
+// as metrics and sensor readings.
+//
+// Each value is XORed with the previous one. Consecutive values which are
+// close share their sign, exponent and high mantissa bits, so the XOR has
+// many leading (and often trailing) zero bits, and only the bits between
+// them are stored. This is the scheme of Facebook's Gorilla time series
+// database:
+//
+//   '0'                       the value is equal to the previous one.
+//   '10' <bits>               the meaningful bits of the XOR fall within
+//                             those of the previous XOR, and are stored in
+//                             the same window.
+//   '11' <leading> <length-1> <bits>
+//                             the meaningful bits are stored, along with
+//                             the number of leading zeros and their length.
+//
+// The values of a block are grouped in mini-blocks of kMiniBlockSize values,
+// each of which restarts the XOR chain from a stored value. Seeking to a
+// position only decodes the mini-block holding it, and seeking to a value
+// in a sorted block binary searches the first values of the mini-blocks.
+#ifndef KUDU_CFILE_XOR_BLOCK_H
+#define KUDU_CFILE_XOR_BLOCK_H
+
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "kudu/cfile/block_encodings.h"
+#include "kudu/cfile/cfile_util.h"
+#include "kudu/common/columnblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/coding.h"
+#include "kudu/util/coding-inl.h"
+#include "kudu/util/faststring.h"
+
+namespace kudu {
+namespace cfile {
+
+namespace xor_encoding {
+
+// The number of values of a mini-block (except for the last one of a block,
+// which may be shorter).
+const size_t kMiniBlockSize = 128;
+
+// The parameters of the encoding of a floating point type.
+template<DataType Type>
+struct Traits;
+
+template<>
+struct Traits<FLOAT> {
+  typedef uint32_t UintType;
+  static const int kBits = 32;
+  // The number of bits of the leading zero count and the length of the
+  // meaningful bits (minus one).
+  static const int kLeadingBits = 5;
+  static const int kLengthBits = 5;
+};
+
+template<>
+struct Traits<DOUBLE> {
+  typedef uint64_t UintType;
+  static const int kBits = 64;
+  static const int kLeadingBits = 6;
+  static const int kLengthBits = 6;
+};
+
+inline uint64_t LowBits(uint64_t value, int num_bits) {
+  return num_bits == 64 ? value : value & ((1ULL << num_bits) - 1);
+}
+
+// Appends bits to a faststring, lowest bits first.
+class BitStreamWriter {
+ public:
+  explicit BitStreamWriter(faststring* dst)
+    : dst_(dst),
+      buffered_(0),
+      num_buffered_(0) {
+  }
+
+  // Appends the low 'num_bits' bits of 'value', which may not have higher
+  // bits set. 'num_bits' is from 1 to 64.
+  void Put(uint64_t value, int num_bits) {
+    DCHECK_GE(num_bits, 1);
+    DCHECK_LE(num_bits, 64);
+    DCHECK_EQ(value, LowBits(value, num_bits));
+    buffered_ |= value << num_buffered_;
+    if (num_buffered_ + num_bits < 64) {
+      num_buffered_ += num_bits;
+      return;
+    }
+    InlinePutFixed64(dst_, buffered_);
+    int consumed = 64 - num_buffered_;
+    buffered_ = consumed == 64 ? 0 : value >> consumed;
+    num_buffered_ = num_bits - consumed;
+  }
+
+  // Appends the buffered bits, padded to a whole byte.
+  void Flush() {
+    uint8_t buf[sizeof(uint64_t)];
+    InlineEncodeFixed64(buf, buffered_);
+    dst_->append(buf, (num_buffered_ + 7) / 8);
+    buffered_ = 0;
+    num_buffered_ = 0;
+  }
+
+ private:
+  faststring* dst_;
+  uint64_t buffered_;
+  int num_buffered_;
+};
+
+// Reads the bits written by BitStreamWriter. Reads past the end of the
+// stream yield zeros; the caller checks for them with overrun().
+class BitStreamReader {
+ public:
+  BitStreamReader(const uint8_t* data, size_t size)
+    : data_(data),
+      size_bits_(size * 8),
+      pos_(0) {
+  }
+
+  // Reads 'num_bits' bits, from 1 to 64.
+  uint64_t Get(int num_bits) {
+    DCHECK_GE(num_bits, 1);
+    DCHECK_LE(num_bits, 64);
+    size_t byte = pos_ / 8;
+    int shift = pos_ % 8;
+    uint64_t value;
+    if (PREDICT_TRUE(byte + sizeof(uint64_t) + 1 <= size_bits_ / 8)) {
+      value = UNALIGNED_LOAD64(data_ + byte) >> shift;
+      if (shift + num_bits > 64) {
+        value |= static_cast<uint64_t>(data_[byte + sizeof(uint64_t)]) << (64 - shift);
+      }
+    } else {
+      value = SlowLoad(byte, shift);
+    }
+    pos_ += num_bits;
+    return LowBits(value, num_bits);
+  }
+
+  // Returns true if more bits were read than the stream holds.
+  bool overrun() const {
+    return pos_ > size_bits_;
+  }
+
+ private:
+  // Like the fast path of Get(), near the end of the stream.
+  uint64_t SlowLoad(size_t byte, int shift) const {
+    uint8_t buf[sizeof(uint64_t) + 1] = { 0 };
+    size_t size = size_bits_ / 8;
+    if (byte < size) {
+      memcpy(buf, data_ + byte, std::min(sizeof(buf), size - byte));
+    }
+    uint64_t value = UNALIGNED_LOAD64(buf) >> shift;
+    if (shift > 0) {
+      value |= static_cast<uint64_t>(buf[sizeof(uint64_t)]) << (64 - shift);
+    }
+    return value;
+  }
+
+  const uint8_t* data_;
+  size_t size_bits_;
+  size_t pos_;
+};
+
+} // namespace xor_encoding
+
+// Builds XOR encoded FLOAT and DOUBLE blocks.
+//
+// Block layout:
+// 1. num of elements within the block (uint32_t, little endian).
+// 2. ordinal of the first element within the block (uint32_t, little endian).
+// 3. the mini-blocks, each of which consists of:
+//    a. the bits of the first value (uint32_t or uint64_t, little endian).
+//    b. the encoded XORs of the following values, padded to a whole byte.
+// 4. the offset of each mini-block within the block (uint32_t, little endian).
+template<DataType Type>
+class XorBlockBuilder : public BlockBuilder {
+ public:
+  explicit XorBlockBuilder(const WriterOptions* options)
+    : options_(options) {
+    Reset();
+  }
+
+  void Reset() OVERRIDE {
+    count_ = 0;
+    num_pending_ = 0;
+    buffer_.clear();
+    buffer_.resize(kHeaderSize);
+    offsets_.clear();
+  }
+
+  bool IsBlockFull(size_t limit) const OVERRIDE {
+    return EstimateEncodedSize() > limit;
+  }
+
+  int Add(const uint8_t* vals_void, size_t count) OVERRIDE {
+    const CppType* vals = reinterpret_cast<const CppType*>(vals_void);
+    int added = 0;
+    // If the current block is full, stop adding more items.
+    while (!IsBlockFull(options_->storage_attributes.cfile_block_size) && added < count) {
+      if (PREDICT_FALSE(count_ == 0)) {
+        first_key_ = vals[added];
+      }
+      memcpy(&pending_[num_pending_++], &vals[added], sizeof(UintType));
+      if (num_pending_ == xor_encoding::kMiniBlockSize) {
+        FlushMiniBlock();
+      }
+      added++;
+      count_++;
+    }
+    if (added > 0) {
+      last_key_ = vals[added - 1];
+    }
+    return added;
+  }
+
+  Slice Finish(rowid_t ordinal_pos) OVERRIDE {
+    if (num_pending_ > 0) {
+      FlushMiniBlock();
+    }
+    for (uint32_t offset : offsets_) {
+      InlinePutFixed32(&buffer_, offset);
+    }
+    InlineEncodeFixed32(&buffer_[0], count_);
+    InlineEncodeFixed32(&buffer_[4], ordinal_pos);
+    return Slice(buffer_);
+  }
+
+  size_t Count() const OVERRIDE {
+    return count_;
+  }
+
+  Status GetFirstKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    *reinterpret_cast<CppType*>(key) = first_key_;
+    return Status::OK();
+  }
+
+  Status GetLastKey(void* key) const OVERRIDE {
+    if (count_ == 0) {
+      return Status::NotFound("no keys in data block");
+    }
+    *reinterpret_cast<CppType*>(key) = last_key_;
+    return Status::OK();
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef xor_encoding::Traits<Type> XorTraits;
+  typedef typename XorTraits::UintType UintType;
+
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+
+  size_t EstimateEncodedSize() const {
+    // The pending values are counted at their full size, which overestimates
+    // by at most a mini-block.
+    return buffer_.size() + num_pending_ * sizeof(CppType) +
+        (offsets_.size() + 1) * sizeof(uint32_t);
+  }
+
+  void FlushMiniBlock() {
+    DCHECK_GT(num_pending_, 0);
+    offsets_.push_back(buffer_.size());
+
+    uint8_t first[sizeof(UintType)];
+    memcpy(first, &pending_[0], sizeof(UintType));
+    buffer_.append(first, sizeof(first));
+
+    xor_encoding::BitStreamWriter writer(&buffer_);
+    // The window of the meaningful bits of the previous XOR. Starts out
+    // invalid, with no room for any bits.
+    int prev_leading = XorTraits::kBits;
+    int prev_trailing = 0;
+    for (size_t i = 1; i < num_pending_; i++) {
+      UintType x = pending_[i] ^ pending_[i - 1];
+      if (x == 0) {
+        writer.Put(0, 1);
+        continue;
+      }
+      int leading = XorTraits::kBits - 1 - Bits::Log2FloorNonZero64(x);
+      int trailing = Bits::FindLSBSetNonZero64(x);
+      if (leading >= prev_leading && trailing >= prev_trailing) {
+        int length = XorTraits::kBits - prev_leading - prev_trailing;
+        writer.Put(1, 2);
+        writer.Put(x >> prev_trailing, length);
+      } else {
+        int length = XorTraits::kBits - leading - trailing;
+        writer.Put(3, 2);
+        writer.Put(leading, XorTraits::kLeadingBits);
+        writer.Put(length - 1, XorTraits::kLengthBits);
+        writer.Put(x >> trailing, length);
+        prev_leading = leading;
+        prev_trailing = trailing;
+      }
+    }
+    writer.Flush();
+    num_pending_ = 0;
+  }
+
+  const WriterOptions* options_;
+  size_t count_;
+  CppType first_key_;
+  CppType last_key_;
+
+  // The bits of the values of the mini-block being built.
+  UintType pending_[xor_encoding::kMiniBlockSize];
+  size_t num_pending_;
+
+  faststring buffer_;
+  std::vector<uint32_t> offsets_;
+};
+
+// Decodes blocks built by XorBlockBuilder.
+template<DataType Type>
+class XorBlockDecoder : public BlockDecoder {
+ public:
+  explicit XorBlockDecoder(Slice slice)
+    : data_(std::move(slice)),
+      parsed_(false),
+      ordinal_pos_base_(0),
+      num_elems_(0),
+      num_miniblocks_(0),
+      offsets_end_(0),
+      offsets_(nullptr),
+      cur_idx_(0),
+      loaded_miniblock_(kNoMiniBlock),
+      loaded_count_(0) {
+  }
+
+  Status ParseHeader() OVERRIDE {
+    CHECK(!parsed_);
+    if (data_.size() < kHeaderSize) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for header: $0 < $1",
+                              data_.size(), kHeaderSize));
+    }
+    num_elems_ = DecodeFixed32(&data_[0]);
+    ordinal_pos_base_ = DecodeFixed32(&data_[4]);
+    num_miniblocks_ = (static_cast<size_t>(num_elems_) + xor_encoding::kMiniBlockSize - 1) /
+        xor_encoding::kMiniBlockSize;
+    if (data_.size() < kHeaderSize + num_miniblocks_ * sizeof(uint32_t)) {
+      return Status::Corruption(
+          strings::Substitute("not enough bytes for $0 mini-block offsets", num_miniblocks_));
+    }
+    offsets_end_ = data_.size() - num_miniblocks_ * sizeof(uint32_t);
+    offsets_ = data_.data() + offsets_end_;
+
+    // Check that each mini-block has room for its first value, so that the
+    // first values may be read without further checks.
+    size_t min_offset = kHeaderSize;
+    for (size_t i = 0; i < num_miniblocks_; i++) {
+      size_t offset = MiniBlockOffset(i);
+      if ((i == 0 && offset != kHeaderSize) || offset < min_offset) {
+        return Status::Corruption(
+            strings::Substitute("invalid offset of mini-block $0: $1", i, offset));
+      }
+      min_offset = offset + sizeof(UintType);
+      if (min_offset > offsets_end_) {
+        return Status::Corruption(
+            strings::Substitute("mini-block $0 overruns the block", i));
+      }
+    }
+
+    parsed_ = true;
+    return Status::OK();
+  }
+
+  void SeekToPositionInBlock(uint pos) OVERRIDE {
+    CHECK(parsed_) << "Must call ParseHeader()";
+    DCHECK_LE(pos, num_elems_);
+    cur_idx_ = pos;
+  }
+
+  Status SeekAtOrAfterValue(const void* value_void, bool* exact) OVERRIDE {
+    DCHECK(parsed_);
+    CppType target = *reinterpret_cast<const CppType*>(value_void);
+
+    // Find the last mini-block whose first value is at or before the target.
+    size_t left = 0;
+    size_t right = num_miniblocks_;
+    while (left != right) {
+      size_t mid = (left + right) / 2;
+      if (MiniBlockFirstValue(mid) <= target) {
+        left = mid + 1;
+      } else {
+        right = mid;
+      }
+    }
+    if (left == 0) {
+      // Every value is after the target (or there are none).
+      cur_idx_ = 0;
+      *exact = false;
+      if (num_elems_ == 0) {
+        return Status::NotFound("after last key in block");
+      }
+      return Status::OK();
+    }
+
+    size_t miniblock = left - 1;
+    RETURN_NOT_OK(LoadMiniBlock(miniblock));
+    const CppType* pos = std::lower_bound(decoded_, decoded_ + loaded_count_, target);
+    cur_idx_ = miniblock * xor_encoding::kMiniBlockSize + (pos - decoded_);
+    if (pos == decoded_ + loaded_count_) {
+      // The target is between this mini-block and the next one, if any.
+      *exact = false;
+      if (cur_idx_ == num_elems_) {
+        return Status::NotFound("after last key in block");
+      }
+      return Status::OK();
+    }
+    *exact = *pos == target;
+    return Status::OK();
+  }
+
+  Status CopyNextValues(size_t* n, ColumnDataView* dst) OVERRIDE {
+    DCHECK(parsed_);
+    DCHECK_LE(*n, dst->nrows());
+    DCHECK_EQ(dst->stride(), sizeof(CppType));
+
+    if (PREDICT_FALSE(*n == 0 || cur_idx_ >= num_elems_)) {
+      *n = 0;
+      return Status::OK();
+    }
+
+    size_t to_fetch = std::min(*n, static_cast<size_t>(num_elems_ - cur_idx_));
+    CppType* out = reinterpret_cast<CppType*>(dst->data());
+    size_t remaining = to_fetch;
+    while (remaining > 0) {
+      size_t miniblock = cur_idx_ / xor_encoding::kMiniBlockSize;
+      size_t idx_in_miniblock = cur_idx_ % xor_encoding::kMiniBlockSize;
+      size_t count = MiniBlockCount(miniblock);
+      size_t nfetch;
+      if (idx_in_miniblock == 0 && remaining >= count &&
+          loaded_miniblock_ != miniblock) {
+        // The whole mini-block is wanted: decode it in place.
+        RETURN_NOT_OK(DecodeMiniBlock(miniblock, out));
+        nfetch = count;
+      } else {
+        RETURN_NOT_OK(LoadMiniBlock(miniblock));
+        nfetch = std::min(remaining, count - idx_in_miniblock);
+        memcpy(out, &decoded_[idx_in_miniblock], nfetch * sizeof(CppType));
+      }
+      out += nfetch;
+      cur_idx_ += nfetch;
+      remaining -= nfetch;
+    }
+    *n = to_fetch;
+    return Status::OK();
+  }
+
+  bool HasNext() const OVERRIDE {
+    return cur_idx_ < num_elems_;
+  }
+
+  size_t Count() const OVERRIDE {
+    return num_elems_;
+  }
+
+  size_t GetCurrentIndex() const OVERRIDE {
+    DCHECK(parsed_) << "must parse header first";
+    return cur_idx_;
+  }
+
+  rowid_t GetFirstRowId() const OVERRIDE {
+    return ordinal_pos_base_;
+  }
+
+ private:
+  typedef typename TypeTraits<Type>::cpp_type CppType;
+  typedef xor_encoding::Traits<Type> XorTraits;
+  typedef typename XorTraits::UintType UintType;
+
+  static const size_t kHeaderSize = sizeof(uint32_t) * 2;
+  static const size_t kNoMiniBlock = static_cast<size_t>(-1);
+
+  uint32_t MiniBlockOffset(size_t miniblock) const {
+    return DecodeFixed32(offsets_ + miniblock * sizeof(uint32_t));
+  }
+
+  size_t MiniBlockCount(size_t miniblock) const {
+    return std::min(xor_encoding::kMiniBlockSize,
+                    num_elems_ - miniblock * xor_encoding::kMiniBlockSize);
+  }
+
+  CppType MiniBlockFirstValue(size_t miniblock) const {
+    CppType value;
+    memcpy(&value, data_.data() + MiniBlockOffset(miniblock), sizeof(value));
+    return value;
+  }
+
+  // Decodes mini-block 'miniblock' into 'decoded_', unless it's there already.
+  Status LoadMiniBlock(size_t miniblock) {
+    if (loaded_miniblock_ == miniblock) {
+      return Status::OK();
+    }
+    loaded_miniblock_ = kNoMiniBlock;
+    RETURN_NOT_OK(DecodeMiniBlock(miniblock, decoded_));
+    loaded_miniblock_ = miniblock;
+    loaded_count_ = MiniBlockCount(miniblock);
+    return Status::OK();
+  }
+
+  // Decodes the values of mini-block 'miniblock' into 'out'.
+  Status DecodeMiniBlock(size_t miniblock, CppType* out) const {
+    const uint8_t* p = data_.data() + MiniBlockOffset(miniblock);
+    const uint8_t* limit = miniblock + 1 < num_miniblocks_ ?
+        data_.data() + MiniBlockOffset(miniblock + 1) : data_.data() + offsets_end_;
+    size_t count = MiniBlockCount(miniblock);
+
+    UintType value;
+    memcpy(&value, p, sizeof(value));
+    p += sizeof(value);
+    memcpy(&out[0], &value, sizeof(value));
+
+    xor_encoding::BitStreamReader reader(p, limit - p);
+    // As in the builder, the window starts out invalid.
+    int leading = XorTraits::kBits;
+    int trailing = 0;
+    for (size_t i = 1; i < count; i++) {
+      if (reader.Get(1) != 0) {
+        if (reader.Get(1) != 0) {
+          leading = reader.Get(XorTraits::kLeadingBits);
+          int length = reader.Get(XorTraits::kLengthBits) + 1;
+          trailing = XorTraits::kBits - leading - length;
+          if (PREDICT_FALSE(trailing < 0)) {
+            return Status::Corruption(
+                strings::Substitute("invalid XOR window in mini-block $0", miniblock));
+          }
+        }
+        int length = XorTraits::kBits - leading - trailing;
+        if (PREDICT_FALSE(length == 0)) {
+          return Status::Corruption(
+              strings::Substitute("XOR window reused before set in mini-block $0", miniblock));
+        }
+        value ^= static_cast<UintType>(reader.Get(length) << trailing);
+      }
+      memcpy(&out[i], &value, sizeof(value));
+    }
+    if (PREDICT_FALSE(reader.overrun())) {
+      return Status::Corruption(
+          strings::Substitute("truncated mini-block $0", miniblock));
+    }
+    return Status::OK();
+  }
+
+  Slice data_;
+  bool parsed_;
+  rowid_t ordinal_pos_base_;
+  uint32_t num_elems_;
+  size_t num_miniblocks_;
+  size_t offsets_end_;
+  const uint8_t* offsets_;
+
+  size_t cur_idx_;
+
+  // The values of the most recently loaded mini-block.
+  size_t loaded_miniblock_;
+  size_t loaded_count_;
+  CppType decoded_[xor_encoding::kMiniBlockSize];
+};
+
+} // namespace cfile
+} // namespace kudu
+#endif
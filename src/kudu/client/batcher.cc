@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
 #include <mutex>
@@ -50,6 +51,7 @@
 #include "kudu/rpc/rpc.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/debug-util.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 
 using std::pair;
@@ -59,6 +61,13 @@ using std::unique_ptr;
 using std::unordered_map;
 using strings::Substitute;
 
+DEFINE_bool(client_multi_tablet_writes, false,
+            "Whether a flush sends the batches for several tablets whose leaders "
+            "are on the same tablet server in a single MultiWrite RPC. Writes sent "
+            "this way are not tracked for exactly-once semantics on their first "
+            "attempt.");
+TAG_FLAG(client_multi_tablet_writes, experimental);
+
 namespace kudu {
 
 using rpc::ErrorStatusPB;
@@ -70,6 +79,9 @@ using rpc::RetriableRpcStatus;
 using rpc::Rpc;
 using rpc::RpcController;
 using rpc::ServerPicker;
+using tserver::MultiWriteRequestPB;
+using tserver::MultiWriteResponsePB;
+using tserver::TabletServerErrorPB;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
 using tserver::WriteResponsePB_PerRowErrorPB;
@@ -182,6 +194,42 @@ struct InFlightOp {
   }
 };
 
+class WriteRpc;
+
+// Gathers the first attempts of the WriteRpcs created by one flush, so that
+// those whose leaders are on the same tablet server can be sent to it in a
+// single MultiWrite RPC.
+class WriteCoalescer : public RefCountedThreadSafe<WriteCoalescer> {
+ public:
+  WriteCoalescer() : closed_(false) {}
+
+  // Holds on to the attempt of 'rpc' to write to 'replica' until SendAll() is
+  // called. Returns false, leaving the caller to send it, if SendAll() has
+  // already been called.
+  bool Add(WriteRpc* rpc, RemoteTabletServer* replica, const ResponseCallback& callback);
+
+  // Sends all of the attempts which were added, batching together those to
+  // the same tablet server.
+  void SendAll();
+
+ private:
+  friend class RefCountedThreadSafe<WriteCoalescer>;
+  friend class MultiWriteRpc;
+  ~WriteCoalescer() {}
+
+  struct Attempt {
+    WriteRpc* rpc;
+    ResponseCallback callback;
+  };
+  typedef unordered_map<RemoteTabletServer*, vector<Attempt>> AttemptsMap;
+
+  simple_spinlock lock_;
+  bool closed_;
+  AttemptsMap attempts_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteCoalescer);
+};
+
 // A Write RPC which is in-flight to a tablet. Initially, the RPC is sent
 // to the leader replica, but it may be retried with another replica if the
 // leader fails.
@@ -195,10 +243,23 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
            vector<InFlightOp*> ops,
            const MonoTime& deadline,
            const shared_ptr<Messenger>& messenger,
-           const string& tablet_id);
+           const string& tablet_id,
+           scoped_refptr<WriteCoalescer> coalescer);
   virtual ~WriteRpc();
   string ToString() const override;
 
+  // Sends the current attempt to 'replica' in its own Write RPC.
+  void SendDirect(RemoteTabletServer* replica, const ResponseCallback& callback);
+
+  // Called when the current attempt was sent as part of a MultiWrite RPC,
+  // before its callback runs. 'status' is the outcome of the MultiWrite RPC
+  // as a whole, and 'resp' (swapped into resp_) the response to this write,
+  // or NULL if there is none.
+  void MultiWriteFinished(const Status& status, bool server_busy, WriteResponsePB* resp);
+
+  const WriteRequestPB& req() const { return req_; }
+  const MonoTime& deadline() const { return retrier().deadline(); }
+
   const KuduTable* table() const {
     // All of the ops for a given tablet obviously correspond to the same table,
     // so we'll just grab the table from the first.
@@ -214,6 +275,12 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
   void Finish(const Status& status) override;
 
  private:
+  // Sends the current attempt once it got into the write window of 'replica'.
+  void TryInWindow(RemoteTabletServer* replica, const ResponseCallback& callback);
+
+  // Classifies the outcome of the current attempt.
+  RetriableRpcStatus AnalyzeAttempt(const Status& rpc_cb_status);
+
   // Pointer back to the batcher. Processes the write response when it
   // completes, regardless of success or failure.
   scoped_refptr<Batcher> batcher_;
@@ -224,19 +291,124 @@ class WriteRpc : public RetriableRpc<RemoteTabletServer, WriteRequestPB, WriteRe
 
   // The id of the tablet being written to.
   string tablet_id_;
+
+  // If set, the first attempt is handed to the coalescer rather than sent
+  // directly.
+  scoped_refptr<WriteCoalescer> coalescer_;
+
+  // Set by MultiWriteFinished() for the attempt which just completed, and
+  // consumed by AnalyzeResponse().
+  bool in_multi_write_;
+  Status multi_write_status_;
+  bool multi_write_server_busy_;
+
+  // The server whose write window the current attempt is counted in, if any.
+  RemoteTabletServer* window_replica_;
 };
 
+// A MultiWrite RPC carrying the attempts of several WriteRpcs to one tablet
+// server. It isn't retried itself: each WriteRpc analyzes its own response
+// and retries on its own if needed. Deletes itself once done.
+class MultiWriteRpc {
+ public:
+  MultiWriteRpc(RemoteTabletServer* replica, vector<WriteCoalescer::Attempt> attempts)
+      : replica_(replica),
+        attempts_(std::move(attempts)) {
+    MonoTime deadline = MonoTime::Max();
+    for (const WriteCoalescer::Attempt& a : attempts_) {
+      req_.add_writes()->CopyFrom(a.rpc->req());
+      deadline = MonoTime::Earliest(deadline, a.rpc->deadline());
+    }
+    controller_.set_deadline(deadline);
+  }
+
+  void Send() {
+    VLOG(2) << "Writing batches for " << attempts_.size() << " tablets to replica "
+            << replica_->ToString();
+    replica_->proxy()->MultiWriteAsync(req_, &resp_, &controller_,
+                                       boost::bind(&MultiWriteRpc::SendRpcCb, this));
+  }
+
+ private:
+  void SendRpcCb() {
+    unique_ptr<MultiWriteRpc> this_instance(this);
+    Status s = controller_.status();
+    const ErrorStatusPB* err = controller_.error_response();
+    if (s.IsRemoteError() && err && err->has_code() &&
+        err->code() == ErrorStatusPB::ERROR_NO_SUCH_METHOD) {
+      // The server predates MultiWrite: send the writes one by one instead.
+      for (const WriteCoalescer::Attempt& a : attempts_) {
+        a.rpc->SendDirect(replica_, a.callback);
+      }
+      return;
+    }
+    bool server_busy = s.IsRemoteError() && err && err->has_code() &&
+        err->code() == ErrorStatusPB::ERROR_SERVER_TOO_BUSY;
+    if (s.ok() && resp_.has_error()) {
+      s = StatusFromPB(resp_.error().status());
+    }
+    if (s.ok() && resp_.responses_size() != static_cast<int>(attempts_.size())) {
+      s = Status::Corruption(Substitute("MultiWrite returned $0 responses for $1 writes",
+                                        resp_.responses_size(), attempts_.size()));
+    }
+    for (int i = 0; i < attempts_.size(); i++) {
+      const WriteCoalescer::Attempt& a = attempts_[i];
+      a.rpc->MultiWriteFinished(s, server_busy, s.ok() ? resp_.mutable_responses(i) : nullptr);
+      a.callback();
+    }
+  }
+
+  RemoteTabletServer* replica_;
+  vector<WriteCoalescer::Attempt> attempts_;
+  MultiWriteRequestPB req_;
+  MultiWriteResponsePB resp_;
+  RpcController controller_;
+
+  DISALLOW_COPY_AND_ASSIGN(MultiWriteRpc);
+};
+
+bool WriteCoalescer::Add(WriteRpc* rpc, RemoteTabletServer* replica,
+                         const ResponseCallback& callback) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (closed_) {
+    return false;
+  }
+  attempts_[replica].push_back({ rpc, callback });
+  return true;
+}
+
+void WriteCoalescer::SendAll() {
+  AttemptsMap attempts;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    closed_ = true;
+    attempts.swap(attempts_);
+  }
+  for (auto& e : attempts) {
+    if (e.second.size() == 1) {
+      e.second[0].rpc->SendDirect(e.first, e.second[0].callback);
+    } else {
+      (new MultiWriteRpc(e.first, std::move(e.second)))->Send();
+    }
+  }
+}
+
 WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
                    const scoped_refptr<MetaCacheServerPicker>& replica_picker,
                    const scoped_refptr<RequestTracker>& request_tracker,
                    vector<InFlightOp*> ops,
                    const MonoTime& deadline,
                    const shared_ptr<Messenger>& messenger,
-                   const string& tablet_id)
+                   const string& tablet_id,
+                   scoped_refptr<WriteCoalescer> coalescer)
     : RetriableRpc(replica_picker, request_tracker, deadline, messenger),
       batcher_(batcher),
       ops_(std::move(ops)),
-      tablet_id_(tablet_id) {
+      tablet_id_(tablet_id),
+      coalescer_(std::move(coalescer)),
+      in_multi_write_(false),
+      multi_write_server_busy_(false),
+      window_replica_(nullptr) {
   const Schema* schema = table()->schema().schema_;
 
   req_.set_tablet_id(tablet_id_);
@@ -258,9 +430,16 @@ WriteRpc::WriteRpc(const scoped_refptr<Batcher>& batcher,
 
   RowOperationsPB* requested = req_.mutable_row_operations();
 
-  // Add the rows
+  // Add the rows. Sizing the buffers up front keeps them from being copied
+  // over and over as they grow.
   int ctr = 0;
   RowOperationsPBEncoder enc(requested);
+  size_t rows_size = 0;
+  size_t indirect_size = 0;
+  for (InFlightOp* op : ops_) {
+    RowOperationsPBEncoder::AddEncodedSize(op->write_op->row(), &rows_size, &indirect_size);
+  }
+  enc.Reserve(*schema, rows_size, indirect_size);
   for (InFlightOp* op : ops_) {
     const Partition& partition = op->tablet->partition();
     const PartitionSchema& partition_schema = table()->partition_schema();
@@ -299,12 +478,40 @@ string WriteRpc::ToString() const {
 }
 
 void WriteRpc::Try(RemoteTabletServer* replica, const ResponseCallback& callback) {
+  // Retries go through the window too, so that a server which is too busy
+  // sees fewer of them rather than all of them at once.
+  replica->write_window()->Acquire(
+      boost::bind(&WriteRpc::TryInWindow, this, replica, callback));
+}
+
+void WriteRpc::TryInWindow(RemoteTabletServer* replica, const ResponseCallback& callback) {
+  window_replica_ = replica;
+  // Only the first attempt is coalesced; retries are sent on their own.
+  scoped_refptr<WriteCoalescer> coalescer;
+  coalescer.swap(coalescer_);
+  if (coalescer && coalescer->Add(this, replica, callback)) {
+    return;
+  }
+  SendDirect(replica, callback);
+}
+
+void WriteRpc::SendDirect(RemoteTabletServer* replica, const ResponseCallback& callback) {
   VLOG(2) << "Tablet " << tablet_id_ << ": Writing batch to replica " << replica->ToString();
   replica->proxy()->WriteAsync(req_, &resp_,
                                mutable_retrier()->mutable_controller(),
                                callback);
 }
 
+void WriteRpc::MultiWriteFinished(const Status& status, bool server_busy,
+                                  WriteResponsePB* resp) {
+  in_multi_write_ = true;
+  multi_write_status_ = status;
+  multi_write_server_busy_ = server_busy;
+  if (resp) {
+    resp_.Swap(resp);
+  }
+}
+
 void WriteRpc::Finish(const Status& status) {
   unique_ptr<WriteRpc> this_instance(this);
   Status final_status = status;
@@ -318,16 +525,44 @@ void WriteRpc::Finish(const Status& status) {
 }
 
 RetriableRpcStatus WriteRpc::AnalyzeResponse(const Status& rpc_cb_status) {
+  RetriableRpcStatus result = AnalyzeAttempt(rpc_cb_status);
+  if (window_replica_) {
+    RemoteTabletServer* replica = window_replica_;
+    window_replica_ = nullptr;
+    replica->write_window()->Release(result.result == RetriableRpcStatus::SERVER_BUSY);
+  }
+  return result;
+}
+
+RetriableRpcStatus WriteRpc::AnalyzeAttempt(const Status& rpc_cb_status) {
   RetriableRpcStatus result;
   result.status = rpc_cb_status;
 
+  bool in_multi_write = in_multi_write_;
+  in_multi_write_ = false;
+
   // If we didn't fail on tablet lookup/proxy initialization, check if we failed actually performing
   // the write.
   if (rpc_cb_status.ok()) {
-    result.status = mutable_retrier()->controller().status();
+    result.status = in_multi_write ? multi_write_status_
+                                   : mutable_retrier()->controller().status();
   }
 
-  if (result.status.IsRemoteError()) {
+  if (in_multi_write) {
+    // A write in a MultiWrite RPC reports being too busy in its own response
+    // rather than failing the whole RPC.
+    bool write_busy = result.status.ok() && resp_.has_error() &&
+        (resp_.error().code() == TabletServerErrorPB::UNKNOWN_ERROR ||
+         resp_.error().code() == TabletServerErrorPB::THROTTLED) &&
+        StatusFromPB(resp_.error().status()).IsServiceUnavailable();
+    if (multi_write_server_busy_ || write_busy) {
+      if (write_busy) {
+        result.status = StatusFromPB(resp_.error().status());
+      }
+      result.result = RetriableRpcStatus::SERVER_BUSY;
+      return result;
+    }
+  } else if (result.status.IsRemoteError()) {
     const ErrorStatusPB* err = mutable_retrier()->controller().error_response();
     if (err &&
         err->has_code() &&
@@ -660,6 +895,7 @@ void Batcher::TabletLookupFinished(InFlightOp* op, const Status& s) {
 
 void Batcher::FlushBuffersIfReady() {
   unordered_map<RemoteTablet*, vector<InFlightOp*> > ops_copy;
+  scoped_refptr<WriteCoalescer> coalescer;
 
   // We're only ready to flush if:
   // 1. The batcher is in the flushing state (i.e. FlushAsync was called).
@@ -681,6 +917,12 @@ void Batcher::FlushBuffersIfReady() {
     ops_copy.swap(per_tablet_ops_);
   }
 
+  // Writes to tablets whose leaders are already known are sent right away
+  // below, so gather those to the same tablet server into MultiWrite RPCs.
+  if (FLAGS_client_multi_tablet_writes && ops_copy.size() > 1) {
+    coalescer = new WriteCoalescer();
+  }
+
   // Now flush the ops for each tablet.
   for (const OpsMap::value_type& e : ops_copy) {
     RemoteTablet* tablet = e.first;
@@ -688,11 +930,16 @@ void Batcher::FlushBuffersIfReady() {
 
     VLOG(3) << "FlushBuffersIfReady: already in flushing state, immediately flushing to "
             << tablet->tablet_id();
-    FlushBuffer(tablet, ops);
+    FlushBuffer(tablet, ops, coalescer);
+  }
+
+  if (coalescer) {
+    coalescer->SendAll();
   }
 }
 
-void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops) {
+void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops,
+                          const scoped_refptr<WriteCoalescer>& coalescer) {
   CHECK(!ops.empty());
 
   // Create and send an RPC that aggregates the ops. The RPC is freed when
@@ -713,7 +960,8 @@ void Batcher::FlushBuffer(RemoteTablet* tablet, const vector<InFlightOp*>& ops)
                                ops,
                                deadline_,
                                client_->data_->messenger_,
-                               tablet->tablet_id());
+                               tablet->tablet_id(),
+                               coalescer);
   rpc->SendRpc();
 }
 
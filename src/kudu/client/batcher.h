@@ -45,6 +45,7 @@ struct InFlightOp;
 
 class ErrorCollector;
 class RemoteTablet;
+class WriteCoalescer;
 class WriteRpc;
 
 // A Batcher is the class responsible for collecting row operations, routing them to the
@@ -135,7 +136,10 @@ class Batcher : public RefCountedThreadSafe<Batcher> {
 
   void CheckForFinishedFlush();
   void FlushBuffersIfReady();
-  void FlushBuffer(RemoteTablet* tablet, const std::vector<InFlightOp*>& ops);
+  // Sends 'ops' to 'tablet'. If 'coalescer' is set, the first attempt is
+  // handed to it so that it may be sent along with those to other tablets.
+  void FlushBuffer(RemoteTablet* tablet, const std::vector<InFlightOp*>& ops,
+                   const scoped_refptr<WriteCoalescer>& coalescer);
 
   // Cleans up an RPC response, scooping out any errors and passing them up
   // to the batcher.
@@ -43,6 +43,7 @@
 #include "kudu/util/net/dns_resolver.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/thread_restrictions.h"
+#include "kudu/util/threadpool.h"
 
 using std::set;
 using std::shared_ptr;
@@ -62,6 +63,8 @@ using master::DeleteTableResponsePB;
 using master::GetLeaderMasterRpc;
 using master::GetTableSchemaRequestPB;
 using master::GetTableSchemaResponsePB;
+using master::GetTableStatisticsRequestPB;
+using master::GetTableStatisticsResponsePB;
 using master::IsAlterTableDoneRequestPB;
 using master::IsAlterTableDoneResponsePB;
 using master::IsCreateTableDoneRequestPB;
@@ -233,6 +236,18 @@ Status KuduClient::Data::SyncLeaderMasterRpc(
 
 // Explicit specialization for callers outside this compilation unit.
 template
+Status KuduClient::Data::SyncLeaderMasterRpc(
+    const MonoTime& deadline,
+    KuduClient* client,
+    const GetTableStatisticsRequestPB& req,
+    GetTableStatisticsResponsePB* resp,
+    const char* func_name,
+    const boost::function<Status(MasterServiceProxy*,
+                                 const GetTableStatisticsRequestPB&,
+                                 GetTableStatisticsResponsePB*,
+                                 RpcController*)>& func,
+    vector<uint32_t> required_feature_flags);
+template
 Status KuduClient::Data::SyncLeaderMasterRpc(
     const MonoTime& deadline,
     KuduClient* client,
@@ -270,6 +285,7 @@ KuduClient::Data::~Data() {
   // jitter on the reactor is not a big deal (and DNS resolutions are not in flight).
   ThreadRestrictions::ScopedAllowWait allow_wait;
   dns_resolver_.reset();
+  async_scan_pool_.reset();
 }
 
 RemoteTabletServer* KuduClient::Data::SelectTServer(const scoped_refptr<RemoteTablet>& rt,
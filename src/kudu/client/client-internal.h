@@ -34,6 +34,7 @@ namespace kudu {
 
 class DnsResolver;
 class HostPort;
+class ThreadPool;
 
 namespace master {
 class AlterTableRequestPB;
@@ -205,6 +206,10 @@ class KuduClient::Data {
   gscoped_ptr<DnsResolver> dns_resolver_;
   scoped_refptr<internal::MetaCache> meta_cache_;
 
+  // Runs the parts of asynchronous scans which may block, such as opening
+  // tablets and retrying failed RPCs. See KuduScanner::NextBatchAsync().
+  gscoped_ptr<ThreadPool> async_scan_pool_;
+
   // Set of hostnames and IPs on the local host.
   // This is initialized at client startup.
   std::unordered_set<std::string> local_host_names_;
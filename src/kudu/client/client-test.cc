@@ -57,6 +57,7 @@
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/scoped_cleanup.h"
@@ -65,10 +66,12 @@
 #include "kudu/util/test_util.h"
 #include "kudu/util/thread.h"
 
+DECLARE_bool(client_multi_tablet_writes);
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(fail_dns_resolution);
 DECLARE_bool(log_inject_latency);
 DECLARE_int32(heartbeat_interval_ms);
+DECLARE_int32(heartbeat_tablet_statistics_interval_ms);
 DECLARE_int32(log_inject_latency_ms_mean);
 DECLARE_int32(log_inject_latency_ms_stddev);
 DECLARE_int32(master_inject_latency_on_tablet_lookups_ms);
@@ -84,6 +87,7 @@ METRIC_DECLARE_counter(rpcs_queue_overflow);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetMasterRegistration);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTableLocations);
 METRIC_DECLARE_histogram(handler_latency_kudu_master_MasterService_GetTabletLocations);
+METRIC_DECLARE_histogram(handler_latency_kudu_tserver_TabletServerService_MultiWrite);
 
 using std::pair;
 using std::set;
@@ -313,6 +317,9 @@ class ClientTest : public KuduTest {
       ASSERT_TRUE(ContainsKey(metrics, "cfile_cache_miss_bytes"));
       ASSERT_TRUE(ContainsKey(metrics, "cfile_cache_hit_bytes"));
       ASSERT_GT(metrics["cfile_cache_miss_bytes"] + metrics["cfile_cache_hit_bytes"], 0);
+      ASSERT_GT(metrics["bytes_read_from_disk"], 0);
+      ASSERT_GT(metrics["cells_read_from_disk"], 0);
+      ASSERT_GT(metrics["data_blocks_read_from_disk"], 0);
     }
   }
 
@@ -552,6 +559,41 @@ TEST_F(ClientTest, TestListTabletServers) {
             tss[0]->hostname());
 }
 
+TEST_F(ClientTest, TestGetTableStatistics) {
+  FLAGS_heartbeat_tablet_statistics_interval_ms = 10;
+  vector<KuduColumnStatistics*> stats;
+  ElementDeleter deleter(&stats);
+
+  // Nothing was flushed yet.
+  ASSERT_OK(client_->GetTableStatistics(kTable2Name, &stats));
+  ASSERT_TRUE(stats.empty());
+
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table2_.get(), 1000));
+  ASSERT_NO_FATAL_FAILURE(FlushTablet(GetFirstTabletId(client_table2_.get())));
+  for (int i = 0; i < 1000 && stats.empty(); i++) {
+    SleepFor(MonoDelta::FromMilliseconds(10));
+    ASSERT_OK(client_->GetTableStatistics(kTable2Name, &stats));
+  }
+  ASSERT_EQ(4, stats.size());
+  ASSERT_EQ("key", stats[0]->column_name());
+  ASSERT_EQ(1000, stats[0]->num_rows());
+  ASSERT_EQ(0, stats[0]->null_count());
+  ASSERT_NEAR(1000, stats[0]->num_distinct_values(), 250);
+  ASSERT_TRUE(stats[0]->min_value() != nullptr);
+  ASSERT_TRUE(stats[0]->max_value() != nullptr);
+  ASSERT_GT(stats[0]->num_histogram_buckets(), 0);
+  int64_t histogram_total = 0;
+  for (int i = 0; i < stats[0]->num_histogram_buckets(); i++) {
+    ASSERT_TRUE(stats[0]->histogram_upper_bound(i) != nullptr);
+    histogram_total += stats[0]->histogram_count(i);
+  }
+  ASSERT_EQ(1000, histogram_total);
+  ASSERT_EQ("string_val", stats[2]->column_name());
+
+  Status s = client_->GetTableStatistics("xxx-does-not-exist", &stats);
+  ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+}
+
 TEST_F(ClientTest, TestBadTable) {
   shared_ptr<KuduTable> t;
   Status s = client_->OpenTable("xxx-does-not-exist", &t);
@@ -815,6 +857,39 @@ TEST_F(ClientTest, TestScanEmptyProjection) {
   }
 }
 
+TEST_F(ClientTest, TestCountRows) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(),
+                                         FLAGS_test_scan_num_rows));
+  ASSERT_NO_FATAL_FAILURE(DeleteTestRows(client_table_.get(), 0, 10));
+  const uint64_t expected = FLAGS_test_scan_num_rows - 10;
+
+  // Without predicates, the tablet servers count from rowset metadata.
+  {
+    KuduScanner scanner(client_table_.get());
+    uint64_t count;
+    ASSERT_OK(scanner.CountRows(&count));
+    ASSERT_EQ(expected, count);
+  }
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
+    uint64_t count;
+    ASSERT_OK(scanner.CountRows(&count));
+    ASSERT_EQ(expected, count);
+  }
+
+  // With a predicate, the matching rows are scanned.
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.AddConjunctPredicate(
+        client_table_->NewComparisonPredicate("key", KuduPredicate::LESS,
+                                              KuduValue::FromInt(20))));
+    uint64_t count;
+    ASSERT_OK(scanner.CountRows(&count));
+    ASSERT_EQ(10, count);
+  }
+}
+
 TEST_F(ClientTest, TestProjectInvalidColumn) {
   KuduScanner scanner(client_table_.get());
   Status s = scanner.SetProjectedColumns({ "column-doesnt-exist" });
@@ -1255,6 +1330,30 @@ TEST_F(ClientTest, TestMetaCacheExpiry) {
   ASSERT_FALSE(entry.stale());
 }
 
+TEST_F(ClientTest, TestPrefetchTabletLocations) {
+  const int kNumTablets = 40;
+  vector<unique_ptr<KuduPartialRow>> split_rows;
+  for (int i = 1; i < kNumTablets; i++) {
+    unique_ptr<KuduPartialRow> row(schema_.NewRow());
+    ASSERT_OK(row->SetInt32(0, i * 10));
+    split_rows.push_back(std::move(row));
+  }
+  shared_ptr<KuduTable> table;
+  ASSERT_NO_FATAL_FAILURE(CreateTable("prefetch", 1, std::move(split_rows), {}, &table));
+
+  auto& meta_cache = client_->data_->meta_cache_;
+  meta_cache->ClearCache();
+
+  // All of the tablets fit in a single page.
+  int master_rpcs_before = CountMasterLookupRPCs();
+  ASSERT_OK(table->PrefetchTabletLocations());
+  ASSERT_EQ(1, CountMasterLookupRPCs() - master_rpcs_before);
+  {
+    shared_lock<rw_spinlock> l(meta_cache->lock_);
+    ASSERT_EQ(kNumTablets, FindOrDie(meta_cache->tablets_by_table_and_key_, table->id()).size());
+  }
+}
+
 TEST_F(ClientTest, TestGetTabletServerBlacklist) {
   shared_ptr<KuduTable> table;
   ASSERT_NO_FATAL_FAILURE(CreateTable("blacklist",
@@ -1564,6 +1663,230 @@ TEST_F(ClientTest, TestCloseScanner) {
   }
 }
 
+// Test the typed zero-copy accessors of columnar scan batches.
+TEST_F(ClientTest, TestScanColumnarTypedAccessors) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 100));
+
+  KuduScanner scanner(client_table_.get());
+  ASSERT_OK(scanner.SetRowFormatFlags(KuduScanner::COLUMNAR_LAYOUT));
+  ASSERT_OK(scanner.Open());
+
+  int num_rows = 0;
+  KuduScanBatch batch;
+  while (scanner.HasMoreRows()) {
+    ASSERT_OK(scanner.NextBatch(&batch));
+    if (batch.NumRows() == 0) continue;
+
+    const int32_t* keys;
+    const int32_t* int_vals;
+    const uint32_t* offsets;
+    const uint8_t* strings;
+    ASSERT_OK(batch.GetFixedLengthColumn(0, &keys));
+    ASSERT_OK(batch.GetFixedLengthColumn(1, &int_vals));
+    ASSERT_OK(batch.GetVariableLengthColumn(2, &offsets, &strings));
+    for (int i = 0; i < batch.NumRows(); i++) {
+      ASSERT_EQ(keys[i] * 2, int_vals[i]);
+      Slice str(strings + offsets[i], offsets[i + 1] - offsets[i]);
+      ASSERT_EQ(StringPrintf("hello %d", keys[i]), str.ToString());
+    }
+    num_rows += batch.NumRows();
+
+    // The cell type and the kind of column are checked.
+    const int64_t* wrong_size;
+    ASSERT_TRUE(batch.GetFixedLengthColumn(0, &wrong_size).IsInvalidArgument());
+    ASSERT_TRUE(batch.GetFixedLengthColumn(2, &keys).IsInvalidArgument());
+    ASSERT_TRUE(batch.GetVariableLengthColumn(0, &offsets, &strings).IsInvalidArgument());
+  }
+  ASSERT_EQ(100, num_rows);
+}
+
+// Test that prefetching scanners return the same rows as regular ones, and
+// that they can be closed while a prefetch is in flight.
+TEST_F(ClientTest, TestScanWithPrefetching) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 1000));
+
+  for (bool prefetching : { false, true }) {
+    SCOPED_TRACE(prefetching);
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetPrefetching(prefetching));
+    // Use small batches so that each tablet is read in many batches.
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.Open());
+    ASSERT_TRUE(scanner.SetPrefetching(!prefetching).IsIllegalState());
+
+    KuduScanBatch batch;
+    int64_t sum = 0;
+    int num_batches = 0;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      sum += SumResults(batch);
+      num_batches++;
+    }
+    ASSERT_GT(num_batches, 2);
+    ASSERT_EQ(499500, sum);
+  }
+
+  {
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetPrefetching(true));
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.Open());
+    KuduScanBatch batch;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      if (batch.NumRows() > 0) break;
+    }
+    ASSERT_TRUE(scanner.HasMoreRows());
+    scanner.Close();
+  }
+}
+
+// Test that one thread can drive several scans at once through the
+// asynchronous scanner API.
+TEST_F(ClientTest, TestScanAsync) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 1000));
+
+  const int kNumScanners = 4;
+  vector<unique_ptr<KuduScanner>> scanners;
+  for (int i = 0; i < kNumScanners; i++) {
+    scanners.emplace_back(new KuduScanner(client_table_.get()));
+    // Use small batches so that each tablet is read in many batches.
+    ASSERT_OK(scanners.back()->SetBatchSizeBytes(100));
+  }
+  {
+    vector<Synchronizer> syncs(kNumScanners);
+    vector<unique_ptr<KuduStatusMemberCallback<Synchronizer>>> cbs;
+    for (int i = 0; i < kNumScanners; i++) {
+      cbs.emplace_back(new KuduStatusMemberCallback<Synchronizer>(&syncs[i],
+                                                                  &Synchronizer::StatusCB));
+      scanners[i]->OpenAsync(cbs.back().get());
+    }
+    for (Synchronizer& s : syncs) {
+      ASSERT_OK(s.Wait());
+    }
+  }
+
+  vector<KuduScanBatch> batches(kNumScanners);
+  vector<int64_t> sums(kNumScanners);
+  int num_rounds = 0;
+  while (true) {
+    vector<Synchronizer> syncs(kNumScanners);
+    vector<unique_ptr<KuduStatusMemberCallback<Synchronizer>>> cbs;
+    vector<int> active;
+    for (int i = 0; i < kNumScanners; i++) {
+      if (!scanners[i]->HasMoreRows()) continue;
+      active.push_back(i);
+      cbs.emplace_back(new KuduStatusMemberCallback<Synchronizer>(&syncs[i],
+                                                                  &Synchronizer::StatusCB));
+      scanners[i]->NextBatchAsync(&batches[i], cbs.back().get());
+    }
+    if (active.empty()) break;
+    for (int i : active) {
+      ASSERT_OK(syncs[i].Wait());
+      sums[i] += SumResults(batches[i]);
+    }
+    num_rounds++;
+  }
+  ASSERT_GT(num_rounds, 2);
+  for (int64_t sum : sums) {
+    ASSERT_EQ(499500, sum);
+  }
+}
+
+// Test that a scan with a row limit returns exactly that many rows and
+// leaves no scanners open on the server.
+TEST_F(ClientTest, TestScanLimit) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 1000));
+  const tserver::ScannerManager* manager =
+    cluster_->mini_tablet_server(0)->server()->scanner_manager();
+
+  for (int64_t limit : { 0, 1, 10, 499, 500, 999, 1000, 2000 }) {
+    SCOPED_TRACE(limit);
+    KuduScanner scanner(client_table_.get());
+    ASSERT_OK(scanner.SetLimit(limit));
+    // Use small batches so that the limit falls in the middle of a tablet.
+    ASSERT_OK(scanner.SetBatchSizeBytes(100));
+    ASSERT_OK(scanner.Open());
+    ASSERT_TRUE(scanner.SetLimit(limit).IsIllegalState());
+
+    KuduScanBatch batch;
+    int64_t num_rows = 0;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&batch));
+      num_rows += batch.NumRows();
+    }
+    ASSERT_EQ(std::min<int64_t>(limit, 1000), num_rows);
+    scanner.Close();
+    AssertScannersDisappear(manager);
+  }
+
+  KuduScanner scanner(client_table_.get());
+  ASSERT_TRUE(scanner.SetLimit(-1).IsInvalidArgument());
+}
+
+// Test batched primary key lookups spanning both tablets of the table.
+TEST_F(ClientTest, TestRowLookup) {
+  ASSERT_NO_FATAL_FAILURE(InsertTestRows(client_table_.get(), 100));
+
+  KuduRowLookup lookup(client_table_.get());
+  ASSERT_OK(lookup.SetProjectedColumnNames({ "key", "int_val" }));
+  const vector<int32_t> keys = { 50, 3, 1000, 9, 99 };
+  for (int32_t key : keys) {
+    unique_ptr<KuduPartialRow> row(client_table_->schema().NewRow());
+    ASSERT_OK(row->SetInt32("key", key));
+    ASSERT_OK(lookup.AddKey(row.release()));
+  }
+  ASSERT_TRUE(lookup.AddKey(client_table_->schema().NewRow()).IsIllegalState());
+  ASSERT_EQ(5, lookup.num_keys());
+  ASSERT_OK(lookup.Run());
+
+  for (int i = 0; i < keys.size(); i++) {
+    SCOPED_TRACE(keys[i]);
+    KuduScanBatch::RowPtr row;
+    if (keys[i] >= 100) {
+      ASSERT_FALSE(lookup.GetRow(i, &row));
+      continue;
+    }
+    ASSERT_TRUE(lookup.GetRow(i, &row));
+    int32_t key;
+    int32_t int_val;
+    ASSERT_OK(row.GetInt32(0, &key));
+    ASSERT_OK(row.GetInt32(1, &int_val));
+    ASSERT_EQ(keys[i], key);
+    ASSERT_EQ(keys[i] * 2, int_val);
+  }
+}
+
+// Test that the master returns the same tablet locations whether they're
+// sent inline or pre-serialized for a sidecar.
+TEST_F(ClientTest, TestSerializedTableLocations) {
+  CatalogManager* catalog = cluster_->mini_master()->master()->catalog_manager();
+  CatalogManager::ScopedLeaderSharedLock l(catalog);
+  ASSERT_OK(l.first_failed_status());
+
+  GetTableLocationsRequestPB req;
+  req.mutable_table()->set_table_name(kTableName);
+  GetTableLocationsResponsePB inline_resp;
+  ASSERT_OK(catalog->GetTableLocations(&req, &inline_resp));
+  ASSERT_EQ(2, inline_resp.tablet_locations_size());
+
+  // Ask twice so that the second response comes from the cache.
+  for (int i = 0; i < 2; i++) {
+    faststring serialized;
+    GetTableLocationsResponsePB resp;
+    ASSERT_OK(catalog->GetTableLocations(&req, &resp, &serialized));
+    ASSERT_EQ(0, resp.tablet_locations_size());
+
+    GetTableLocationsResponsePB parsed;
+    ASSERT_TRUE(parsed.ParseFromArray(serialized.data(), serialized.size()));
+    ASSERT_EQ(inline_resp.tablet_locations_size(), parsed.tablet_locations_size());
+    for (int j = 0; j < parsed.tablet_locations_size(); j++) {
+      ASSERT_EQ(inline_resp.tablet_locations(j).ShortDebugString(),
+                parsed.tablet_locations(j).ShortDebugString());
+    }
+  }
+}
+
 TEST_F(ClientTest, TestScanTimeout) {
   // If we set the RPC timeout to be 0, we'll time out in the GetTableLocations
   // code path and not even discover where the tablet is hosted.
@@ -1907,6 +2230,40 @@ TEST_F(ClientTest, TestBatchWithPartialError) {
             "int32 non_null_with_default=12345)", rows[1]);
 }
 
+// Test that a batch spanning several tablets hosted by the same tablet server
+// is sent as a single MultiWrite RPC, and that per-row errors are still
+// attributed to the right operations.
+TEST_F(ClientTest, TestMultiTabletBatch) {
+  FLAGS_client_multi_tablet_writes = true;
+  shared_ptr<KuduSession> session = client_->NewSession();
+  ASSERT_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+
+  // Insert a row with key "1" so that the next batch has a failing op.
+  ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, 1, 1, "original row"));
+  FlushSessionOrDie(session);
+
+  auto ent = cluster_->mini_tablet_server(0)->server()->metric_entity();
+  scoped_refptr<Histogram> multi_writes =
+      METRIC_handler_latency_kudu_tserver_TabletServerService_MultiWrite.Instantiate(ent);
+  int64_t multi_writes_before = multi_writes->TotalCount();
+
+  // Keys on both sides of the split point (9) land on different tablets.
+  ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, 1, 1, "Attempted dup"));
+  for (int i = 2; i < 20; i++) {
+    ASSERT_OK(ApplyInsertToSession(session.get(), client_table_, i, i, "hello"));
+  }
+  Status s = session->Flush();
+  ASSERT_FALSE(s.ok());
+  ASSERT_STR_CONTAINS(s.ToString(), "Some errors occurred");
+  gscoped_ptr<KuduError> error = GetSingleErrorFromSession(session.get());
+  ASSERT_TRUE(error->status().IsAlreadyPresent());
+  ASSERT_EQ(error->failed_op().ToString(),
+            "INSERT int32 key=1, int32 int_val=1, string string_val=Attempted dup");
+
+  ASSERT_EQ(multi_writes_before + 1, multi_writes->TotalCount());
+  ASSERT_EQ(19, CountRowsFromClient(client_table_.get()));
+}
+
 // Test flushing an empty batch (should be a no-op).
 TEST_F(ClientTest, TestEmptyBatch) {
   shared_ptr<KuduSession> session = client_->NewSession();
@@ -2308,13 +2665,51 @@ TEST_F(ClientTest, TestBasicAlterOperations) {
     ASSERT_EQ(2, tablet_peer->tablet()->metadata()->schema_version());
   }
 
+  // test that a column's type can't be altered, nor can an encoding
+  // incompatible with it be set
+  {
+    gscoped_ptr<KuduTableAlterer> table_alterer(client_->NewTableAlterer(kTableName));
+    table_alterer->AlterColumn("new_string_val")->Type(KuduColumnSchema::INT32);
+    Status s = table_alterer->Alter();
+    ASSERT_TRUE(s.IsNotSupported());
+    ASSERT_STR_CONTAINS(s.ToString(), "cannot support AlterColumn of this type");
+  }
+  {
+    gscoped_ptr<KuduTableAlterer> table_alterer(client_->NewTableAlterer(kTableName));
+    table_alterer->AlterColumn("new_string_val")
+      ->Encoding(KuduColumnStorageAttributes::GROUP_VARINT);
+    Status s = table_alterer->Alter();
+    ASSERT_TRUE(s.IsNotSupported());
+    ASSERT_STR_CONTAINS(s.ToString(), "Unsupported type/encoding pair");
+    ASSERT_EQ(2, tablet_peer->tablet()->metadata()->schema_version());
+  }
+
+  // test that a column's storage attributes can be altered along with its name
+  {
+    gscoped_ptr<KuduTableAlterer> table_alterer(client_->NewTableAlterer(kTableName));
+    table_alterer->AlterColumn("new_string_val")
+      ->Encoding(KuduColumnStorageAttributes::DICT_ENCODING)
+      ->Compression(KuduColumnStorageAttributes::LZ4)
+      ->BlockSize(16 * 1024)
+      ->RenameTo("renamed_string_val");
+    ASSERT_OK(table_alterer->Alter());
+    ASSERT_EQ(3, tablet_peer->tablet()->metadata()->schema_version());
+    const Schema* schema = tablet_peer->tablet()->schema();
+    int idx = schema->find_column("renamed_string_val");
+    ASSERT_NE(Schema::kColumnNotFound, idx);
+    const ColumnStorageAttributes& attributes = schema->column(idx).attributes();
+    ASSERT_EQ(DICT_ENCODING, attributes.encoding);
+    ASSERT_EQ(LZ4, attributes.compression);
+    ASSERT_EQ(16 * 1024, attributes.cfile_block_size);
+  }
+
   {
     const char *kRenamedTableName = "RenamedTable";
     gscoped_ptr<KuduTableAlterer> table_alterer(client_->NewTableAlterer(kTableName));
     ASSERT_OK(table_alterer
               ->RenameTo(kRenamedTableName)
               ->Alter());
-    ASSERT_EQ(3, tablet_peer->tablet()->metadata()->schema_version());
+    ASSERT_EQ(4, tablet_peer->tablet()->metadata()->schema_version());
     ASSERT_EQ(kRenamedTableName, tablet_peer->tablet()->metadata()->table_name());
 
     CatalogManager *catalog_manager = cluster_->mini_master()->master()->catalog_manager();
@@ -24,6 +24,7 @@
 
 #include "kudu/client/client.h"
 #include "kudu/client/client-internal.h"
+#include "kudu/client/meta_cache.h"
 
 using std::string;
 using std::vector;
@@ -170,6 +171,55 @@ TEST(ClientUnitTest, TestRetryFunc) {
   ASSERT_LT(counter, 20);
 }
 
+TEST(ClientUnitTest, TestWriteWindow) {
+  internal::WriteWindow window(4);
+  int sent = 0;
+  auto send = [&sent]() { sent++; };
+
+  // Writes beyond the limit wait for others to be released.
+  for (int i = 0; i < 6; i++) {
+    window.Acquire(send);
+  }
+  ASSERT_EQ(4, sent);
+  ASSERT_EQ(4, window.num_in_flight());
+  ASSERT_EQ(2, window.num_waiting());
+
+  // Backpressure halves the limit, so releasing a busy write doesn't let
+  // the waiting ones through.
+  window.Release(true);
+  ASSERT_EQ(2, window.size());
+  ASSERT_EQ(4, sent);
+  ASSERT_EQ(3, window.num_in_flight());
+
+  // The limit never drops below one write in flight.
+  window.Release(true);
+  window.Release(true);
+  ASSERT_EQ(1, window.size());
+  window.Release(true);
+  ASSERT_EQ(1, window.size());
+  ASSERT_EQ(5, sent);
+  ASSERT_EQ(1, window.num_in_flight());
+  ASSERT_EQ(1, window.num_waiting());
+
+  // Accepted writes grow the limit back, up to its maximum.
+  for (int i = 0; i < 100; i++) {
+    window.Release(false);
+    window.Acquire(send);
+  }
+  ASSERT_EQ(4, window.size());
+  ASSERT_EQ(0, window.num_waiting());
+
+  // A window without a maximum never holds writes back.
+  internal::WriteWindow unlimited(0);
+  int unlimited_sent = 0;
+  for (int i = 0; i < 100; i++) {
+    unlimited.Acquire([&unlimited_sent]() { unlimited_sent++; });
+    unlimited.Release(true);
+  }
+  ASSERT_EQ(100, unlimited_sent);
+  ASSERT_EQ(0, unlimited.size());
+}
+
 } // namespace client
 } // namespace kudu
 
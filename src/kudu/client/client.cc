@@ -19,6 +19,8 @@
 
 #include <algorithm>
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <limits>
 #include <memory>
 #include <mutex>
 #include <set>
@@ -31,9 +33,12 @@
 #include "kudu/client/callbacks.h"
 #include "kudu/client/client-internal.h"
 #include "kudu/client/client_builder-internal.h"
+#include "kudu/client/column_statistics-internal.h"
 #include "kudu/client/error-internal.h"
 #include "kudu/client/error_collector.h"
 #include "kudu/client/meta_cache.h"
+#include "kudu/client/parallel_scanner-internal.h"
+#include "kudu/client/row_lookup-internal.h"
 #include "kudu/client/row_result.h"
 #include "kudu/client/scan_predicate-internal.h"
 #include "kudu/client/scan_token-internal.h"
@@ -48,17 +53,21 @@
 #include "kudu/common/common.pb.h"
 #include "kudu/common/partition.h"
 #include "kudu/common/row_operations.h"
+#include "kudu/common/types.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.h" // TODO: remove this include - just needed for default port
 #include "kudu/master/master.pb.h"
 #include "kudu/master/master.proxy.h"
 #include "kudu/rpc/messenger.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/init.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/net/dns_resolver.h"
 #include "kudu/util/oid_generator.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/version_info.h"
 
 using kudu::master::AlterTableRequestPB;
@@ -70,6 +79,8 @@ using kudu::master::DeleteTableRequestPB;
 using kudu::master::DeleteTableResponsePB;
 using kudu::master::GetTableSchemaRequestPB;
 using kudu::master::GetTableSchemaResponsePB;
+using kudu::master::GetTableStatisticsRequestPB;
+using kudu::master::GetTableStatisticsResponsePB;
 using kudu::master::ListTablesRequestPB;
 using kudu::master::ListTablesResponsePB;
 using kudu::master::ListTabletServersRequestPB;
@@ -87,6 +98,12 @@ using std::string;
 using std::unique_ptr;
 using std::vector;
 
+DEFINE_int32(client_async_scan_threads, 4,
+             "The maximum number of threads the client uses for the parts of "
+             "asynchronous scans which may block, such as opening tablets and "
+             "retrying failed scan requests.");
+TAG_FLAG(client_async_scan_threads, advanced);
+
 MAKE_ENUM_LIMITS(kudu::client::KuduSession::FlushMode,
                  kudu::client::KuduSession::AUTO_FLUSH_SYNC,
                  kudu::client::KuduSession::MANUAL_FLUSH);
@@ -236,6 +253,9 @@ Status KuduClientBuilder::Build(shared_ptr<KuduClient>* client) {
 
   c->data_->meta_cache_.reset(new MetaCache(c.get()));
   c->data_->dns_resolver_.reset(new DnsResolver());
+  RETURN_NOT_OK(ThreadPoolBuilder("client-async-scan")
+                .set_max_threads(FLAGS_client_async_scan_threads)
+                .Build(&c->data_->async_scan_pool_));
 
   // Init local host names used for locality decisions.
   RETURN_NOT_OK_PREPEND(c->data_->InitLocalHostNames(),
@@ -328,6 +348,43 @@ Status KuduClient::ListTabletServers(vector<KuduTabletServer*>* tablet_servers)
   return Status::OK();
 }
 
+Status KuduClient::GetTableStatistics(const string& table_name,
+                                      vector<KuduColumnStatistics*>* column_stats) {
+  GetTableStatisticsRequestPB req;
+  GetTableStatisticsResponsePB resp;
+  req.mutable_table()->set_table_name(table_name);
+
+  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(default_admin_operation_timeout());
+  Status s =
+      data_->SyncLeaderMasterRpc<GetTableStatisticsRequestPB, GetTableStatisticsResponsePB>(
+          deadline,
+          this,
+          req,
+          &resp,
+          "GetTableStatistics",
+          &MasterServiceProxy::GetTableStatistics,
+          {});
+  RETURN_NOT_OK(s);
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  vector<KuduColumnStatistics*> result;
+  ElementDeleter result_deleter(&result);
+  for (const GetTableStatisticsResponsePB::ColumnEntry& e : resp.columns()) {
+    unique_ptr<KuduColumnStatistics::Data> data;
+    RETURN_NOT_OK_PREPEND(
+        KuduColumnStatistics::Data::FromPB(e.name(), GetTypeInfo(e.type()), e.stats(), &data),
+        strings::Substitute("invalid statistics for column $0", e.name()));
+    auto stats = new KuduColumnStatistics();
+    stats->data_ = data.release();
+    result.push_back(stats);
+  }
+  column_stats->insert(column_stats->end(), result.begin(), result.end());
+  result.clear();
+  return Status::OK();
+}
+
 Status KuduClient::ListTables(vector<string>* tables,
                               const string& filter) {
   ListTablesRequestPB req;
@@ -494,6 +551,29 @@ KuduTableCreator& KuduTableCreator::num_replicas(int num_replicas) {
   return *this;
 }
 
+KuduTableCreator& KuduTableCreator::compaction_policy(CompactionPolicy policy) {
+  data_->has_compaction_policy_ = true;
+  data_->compaction_policy_ = policy;
+  return *this;
+}
+
+KuduTableCreator& KuduTableCreator::history_max_age(const MonoDelta& max_age) {
+  data_->has_history_max_age_ = true;
+  data_->history_max_age_ = max_age;
+  return *this;
+}
+
+KuduTableCreator& KuduTableCreator::row_ttl(const string& column, const MonoDelta& ttl) {
+  data_->row_ttl_column_ = column;
+  data_->row_ttl_ = ttl;
+  return *this;
+}
+
+KuduTableCreator& KuduTableCreator::pin_key_index(bool pin_key_index) {
+  data_->pin_key_index_ = pin_key_index;
+  return *this;
+}
+
 KuduTableCreator& KuduTableCreator::timeout(const MonoDelta& timeout) {
   data_->timeout_ = timeout;
   return *this;
@@ -524,6 +604,37 @@ Status KuduTableCreator::Create() {
   if (data_->num_replicas_ >= 1) {
     req.set_num_replicas(data_->num_replicas_);
   }
+  if (data_->has_compaction_policy_) {
+    switch (data_->compaction_policy_) {
+      case BUDGETED_COMPACTION:
+        req.set_compaction_policy(tablet::BUDGETED_COMPACTION_POLICY);
+        break;
+      case TIERED_COMPACTION:
+        req.set_compaction_policy(tablet::TIERED_COMPACTION_POLICY);
+        break;
+      default:
+        return Status::InvalidArgument("Unknown compaction policy");
+    }
+  }
+  if (data_->has_history_max_age_) {
+    double max_age_sec = data_->history_max_age_.ToSeconds();
+    if (max_age_sec < 0 || max_age_sec > std::numeric_limits<int32_t>::max()) {
+      return Status::InvalidArgument("Invalid history retention",
+                                     data_->history_max_age_.ToString());
+    }
+    req.set_history_max_age_sec(static_cast<int32_t>(max_age_sec));
+  }
+  if (!data_->row_ttl_column_.empty()) {
+    double ttl_sec = data_->row_ttl_.ToSeconds();
+    if (ttl_sec < 0 || ttl_sec > std::numeric_limits<int32_t>::max()) {
+      return Status::InvalidArgument("Invalid row TTL", data_->row_ttl_.ToString());
+    }
+    req.set_row_ttl_column(data_->row_ttl_column_);
+    req.set_row_ttl_sec(static_cast<int32_t>(ttl_sec));
+  }
+  if (data_->pin_key_index_) {
+    req.set_pin_key_index(true);
+  }
   RETURN_NOT_OK_PREPEND(SchemaToPB(*data_->schema_->schema_, req.mutable_schema()),
                         "Invalid schema");
 
@@ -642,6 +753,39 @@ KuduPredicate* KuduTable::NewComparisonPredicate(const Slice& col_name,
   return new KuduPredicate(new ComparisonPredicateData(s->column(col_idx), op, value));
 }
 
+KuduPredicate* KuduTable::NewInListPredicate(const Slice& col_name,
+                                             vector<KuduValue*>* values) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    // We always take ownership of 'values'.
+    STLDeleteElements(values);
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+
+  return new KuduPredicate(new InListPredicateData(s->column(col_idx), values));
+}
+
+KuduPredicate* KuduTable::NewIsNullPredicate(const Slice& col_name) {
+  StringPiece name_sp(reinterpret_cast<const char*>(col_name.data()), col_name.size());
+  const Schema* s = data_->schema_.schema_;
+  int col_idx = s->find_column(name_sp);
+  if (col_idx == Schema::kColumnNotFound) {
+    return new KuduPredicate(new ErrorPredicateData(
+                                 Status::NotFound("column not found", col_name)));
+  }
+
+  return new KuduPredicate(new IsNullPredicateData(s->column(col_idx)));
+}
+
+Status KuduTable::PrefetchTabletLocations() {
+  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(client()->default_admin_operation_timeout());
+  return client()->data_->meta_cache_->PrefetchTableLocations(this, deadline);
+}
+
 ////////////////////////////////////////////////////////////
 // Error
 ////////////////////////////////////////////////////////////
@@ -948,6 +1092,9 @@ Status KuduTableAlterer::Alter() {
 // KuduScanner
 ////////////////////////////////////////////////////////////
 
+const uint64_t KuduScanner::NO_FLAGS = 0;
+const uint64_t KuduScanner::COLUMNAR_LAYOUT = 1 << 0;
+
 KuduScanner::KuduScanner(KuduTable* table)
   : data_(new KuduScanner::Data(table)) {
 }
@@ -979,6 +1126,20 @@ Status KuduScanner::SetBatchSizeBytes(uint32_t batch_size) {
   return data_->mutable_configuration()->SetBatchSizeBytes(batch_size);
 }
 
+Status KuduScanner::SetPrefetching(bool prefetching) {
+  if (data_->open_) {
+    return Status::IllegalState("Prefetching must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetPrefetching(prefetching);
+}
+
+Status KuduScanner::SetLimit(int64_t limit) {
+  if (data_->open_) {
+    return Status::IllegalState("Limit must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetLimit(limit);
+}
+
 Status KuduScanner::SetReadMode(ReadMode read_mode) {
   if (data_->open_) {
     return Status::IllegalState("Read mode must be set before Open()");
@@ -1022,6 +1183,13 @@ Status KuduScanner::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   return Status::OK();
 }
 
+Status KuduScanner::SetMaxStalenessMillis(int max_staleness_ms) {
+  if (data_->open_) {
+    return Status::IllegalState("Max staleness must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetMaxStalenessMillis(max_staleness_ms);
+}
+
 Status KuduScanner::SetSelection(KuduClient::ReplicaSelection selection) {
   if (data_->open_) {
     return Status::IllegalState("Replica selection must be set before Open()");
@@ -1077,6 +1245,13 @@ Status KuduScanner::SetCacheBlocks(bool cache_blocks) {
   return data_->mutable_configuration()->SetCacheBlocks(cache_blocks);
 }
 
+Status KuduScanner::SetRowFormatFlags(uint64_t flags) {
+  if (data_->open_) {
+    return Status::IllegalState("Row format flags must be set before Open()");
+  }
+  return data_->mutable_configuration()->SetRowFormatFlags(flags);
+}
+
 KuduSchema KuduScanner::GetProjectionSchema() const {
   return KuduSchema(*data_->configuration().projection());
 }
@@ -1119,6 +1294,7 @@ Status KuduScanner::Open() {
   data_->partition_pruner_.Init(*data_->table_->schema().schema_,
                                 data_->table_->partition_schema(),
                                 data_->configuration().spec());
+  data_->unvisited_partition_key_ = data_->configuration().spec().lower_bound_partition_key();
 
   if (data_->configuration().spec().CanShortCircuit() ||
       !data_->partition_pruner_.HasMorePartitionKeyRanges()) {
@@ -1140,6 +1316,23 @@ Status KuduScanner::Open() {
   return Status::OK();
 }
 
+Status KuduScanner::CountRows(uint64_t* count) {
+  if (data_->open_) {
+    return Status::IllegalState("CountRows() must be called instead of Open()");
+  }
+  RETURN_NOT_OK(data_->mutable_configuration()->SetCountOnly());
+  RETURN_NOT_OK(Open());
+
+  uint64_t total = 0;
+  KuduScanBatch batch;
+  while (HasMoreRows()) {
+    RETURN_NOT_OK(NextBatch(&batch));
+    total += batch.NumRows();
+  }
+  *count = total;
+  return Status::OK();
+}
+
 Status KuduScanner::KeepAlive() {
   return data_->KeepAlive();
 }
@@ -1149,6 +1342,10 @@ void KuduScanner::Close() {
 
   VLOG(1) << "Ending scan " << ToString();
 
+  // The prefetched response, if any, is dropped; the close request below
+  // follows it in the scanner's call sequence.
+  data_->DiscardPrefetch();
+
   // Close the scanner on the server-side, if necessary.
   //
   // If the scan did not match any rows, the tserver will not assign a scanner ID.
@@ -1173,28 +1370,28 @@ void KuduScanner::Close() {
 bool KuduScanner::HasMoreRows() const {
   CHECK(data_->open_);
   return !data_->short_circuit_ &&                 // The scan is not short circuited
+      !data_->LimitReached() &&                    // The scan's row limit isn't reached
       (data_->data_in_open_ ||                     // more data in hand
        data_->last_response_.has_more_results() || // more data in this tablet
        data_->MoreTablets());                      // more tablets to scan, possibly with more data
 }
 
 Status KuduScanner::NextBatch(vector<KuduRowResult>* rows) {
+  if (PREDICT_FALSE(data_->configuration().row_format_flags() & COLUMNAR_LAYOUT)) {
+    return Status::NotSupported("columnar scans must use NextBatch(KuduScanBatch*)");
+  }
   RETURN_NOT_OK(NextBatch(&data_->batch_for_old_api_));
   data_->batch_for_old_api_.data_->ExtractRows(rows);
   return Status::OK();
 }
 
 Status KuduScanner::NextBatch(KuduScanBatch* batch) {
-  // TODO: do some double-buffering here -- when we return this batch
-  // we should already have fired off the RPC for the next batch, but
-  // need to do some swapping of the response objects around to avoid
-  // stomping on the memory the user is looking at.
   CHECK(data_->open_);
   CHECK(data_->proxy_);
 
   batch->data_->Clear();
 
-  if (data_->short_circuit_) {
+  if (data_->short_circuit_ || data_->LimitReached()) {
     return Status::OK();
   }
 
@@ -1202,56 +1399,27 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
     // We have data from a previous scan.
     VLOG(1) << "Extracting data from scan " << ToString();
     data_->data_in_open_ = false;
-    return batch->data_->Reset(&data_->controller_,
-                               data_->configuration().projection(),
-                               data_->configuration().client_projection(),
-                                make_gscoped_ptr(data_->last_response_.release_data()));
+    return ExtractBatch(batch);
   } else if (data_->last_response_.has_more_results()) {
     // More data is available in this tablet.
     VLOG(1) << "Continuing scan " << ToString();
 
     MonoTime batch_deadline = MonoTime::Now(MonoTime::FINE);
     batch_deadline.AddDelta(data_->configuration().timeout());
-    data_->PrepareRequest(KuduScanner::Data::CONTINUE);
 
-    while (true) {
+    // If the request for this batch was prefetched, its response stands in
+    // for the first attempt.
+    ScanRpcStatus result;
+    if (!data_->FinishPrefetch(batch_deadline, &result)) {
+      data_->PrepareRequest(KuduScanner::Data::CONTINUE);
       bool allow_time_for_failover = data_->configuration().is_fault_tolerant();
-      ScanRpcStatus result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
-
-      // Success case.
-      if (result.result == ScanRpcStatus::OK) {
-        if (data_->last_response_.has_last_primary_key()) {
-          data_->last_primary_key_ = data_->last_response_.last_primary_key();
-        }
-        data_->scan_attempts_ = 0;
-        return batch->data_->Reset(&data_->controller_,
-                                   data_->configuration().projection(),
-                                   data_->configuration().client_projection(),
-                                   make_gscoped_ptr(data_->last_response_.release_data()));
-      }
-
-      data_->scan_attempts_++;
-
-      // Error handling.
-      LOG(WARNING) << "Scan at tablet server " << data_->ts_->ToString() << " of tablet "
-                   << ToString() << " failed: " << result.status.ToString();
-
-      set<string> blacklist;
-      RETURN_NOT_OK(data_->HandleError(result, batch_deadline, &blacklist));
-
-      if (data_->configuration().is_fault_tolerant()) {
-        LOG(WARNING) << "Attempting to retry scan of tablet " << ToString() << " elsewhere.";
-        return data_->ReopenCurrentTablet(batch_deadline, &blacklist);
-      }
-
-      if (blacklist.empty()) {
-        // If we didn't blacklist the current server, we can just retry again.
-        continue;
-      }
-      // If we blacklisted the current server, and it's not fault-tolerant, we can't
-      // retry anywhere, so just propagate the error.
-      return result.status;
+      result = data_->SendScanRpc(batch_deadline, allow_time_for_failover);
     }
+
+    bool batch_ready;
+    RETURN_NOT_OK(data_->FinishContinueScan(batch_deadline, result, &batch_ready));
+    // If the tablet was reopened instead, the next invocation picks up its rows.
+    return batch_ready ? ExtractBatch(batch) : Status::OK();
   } else if (data_->MoreTablets()) {
     // More data may be available in other tablets.
     // No need to close the current tablet; we scanned all the data so the
@@ -1271,6 +1439,83 @@ Status KuduScanner::NextBatch(KuduScanBatch* batch) {
   }
 }
 
+void KuduScanner::OpenAsync(KuduStatusCallback* cb) {
+  Status s = data_->table_->client()->data_->async_scan_pool_->SubmitFunc(
+      [this, cb]() { cb->Run(Open()); });
+  if (!s.ok()) {
+    cb->Run(s);
+  }
+}
+
+void KuduScanner::NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb) {
+  CHECK(data_->open_);
+  CHECK(data_->proxy_);
+
+  // Continuing the scan of the current tablet, the common case, is done
+  // without blocking any thread. Handing out the rows received by Open() or
+  // by a previous tablet does not block either.
+  if (data_->short_circuit_ || data_->LimitReached() || data_->data_in_open_ ||
+      (!data_->last_response_.has_more_results() && !data_->MoreTablets())) {
+    cb->Run(NextBatch(batch));
+    return;
+  }
+  if (data_->last_response_.has_more_results() && !data_->prefetch_in_flight_) {
+    VLOG(1) << "Continuing scan asynchronously " << ToString();
+    batch->data_->Clear();
+    data_->async_batch_deadline_ = MonoTime::Now(MonoTime::FINE);
+    data_->async_batch_deadline_.AddDelta(data_->configuration().timeout());
+    data_->PrepareRequest(KuduScanner::Data::CONTINUE);
+    data_->SendScanRpcAsync(data_->async_batch_deadline_,
+                            data_->configuration().is_fault_tolerant(),
+                            [this, batch, cb]() { NextBatchAsyncDone(batch, cb); });
+    return;
+  }
+
+  // Opening the next tablet, or waiting for a prefetch, blocks.
+  Status s = data_->table_->client()->data_->async_scan_pool_->SubmitFunc(
+      [this, batch, cb]() { cb->Run(NextBatch(batch)); });
+  if (!s.ok()) {
+    cb->Run(s);
+  }
+}
+
+void KuduScanner::NextBatchAsyncDone(KuduScanBatch* batch, KuduStatusCallback* cb) {
+  ScanRpcStatus result = data_->FinishScanRpcAsync(data_->async_batch_deadline_);
+  if (result.result == ScanRpcStatus::OK) {
+    bool batch_ready;
+    Status s = data_->FinishContinueScan(data_->async_batch_deadline_, result, &batch_ready);
+    DCHECK(batch_ready);
+    cb->Run(s.ok() ? ExtractBatch(batch) : s);
+    return;
+  }
+
+  // Retrying the request may sleep or reopen the tablet, which must not be
+  // done on the reactor thread running this callback.
+  Status s = data_->table_->client()->data_->async_scan_pool_->SubmitFunc(
+      [this, batch, cb, result]() {
+        bool batch_ready;
+        Status status = data_->FinishContinueScan(data_->async_batch_deadline_, result,
+                                                  &batch_ready);
+        if (status.ok() && batch_ready) {
+          status = ExtractBatch(batch);
+        }
+        cb->Run(status);
+      });
+  if (!s.ok()) {
+    cb->Run(s);
+  }
+}
+
+Status KuduScanner::ExtractBatch(KuduScanBatch* batch) {
+  RETURN_NOT_OK(batch->data_->Reset(&data_->controller_,
+                                    data_->configuration().projection(),
+                                    data_->configuration().client_projection(),
+                                    &data_->last_response_));
+  data_->num_rows_returned_ += batch->NumRows();
+  data_->StartPrefetch();
+  return Status::OK();
+}
+
 Status KuduScanner::GetCurrentServer(KuduTabletServer** server) {
   CHECK(data_->open_);
   internal::RemoteTabletServer* rts = data_->ts_;
@@ -1371,6 +1616,15 @@ Status KuduScanTokenBuilder::SetTimeoutMillis(int millis) {
   return Status::OK();
 }
 
+Status KuduScanTokenBuilder::SetLimit(int64_t limit) {
+  return data_->mutable_configuration()->SetLimit(limit);
+}
+
+Status KuduScanTokenBuilder::SetSplitSizeBytes(uint64_t split_size_bytes) {
+  data_->SetSplitSizeBytes(split_size_bytes);
+  return Status::OK();
+}
+
 Status KuduScanTokenBuilder::AddConjunctPredicate(KuduPredicate* pred) {
   return data_->mutable_configuration()->AddConjunctPredicate(pred);
 }
@@ -1391,6 +1645,118 @@ Status KuduScanTokenBuilder::Build(vector<KuduScanToken*>* tokens) {
   return data_->Build(tokens);
 }
 
+////////////////////////////////////////////////////////////
+// KuduParallelScanner
+////////////////////////////////////////////////////////////
+
+KuduParallelScanner::KuduParallelScanner(KuduScanTokenBuilder* builder)
+    : data_(new KuduParallelScanner::Data(builder)) {
+}
+
+KuduParallelScanner::~KuduParallelScanner() {
+  delete data_;
+}
+
+Status KuduParallelScanner::SetOrderMode(KuduScanner::OrderMode order_mode) {
+  if (data_->open_) {
+    return Status::IllegalState("Order mode must be set before Open()");
+  }
+  data_->order_mode_ = order_mode;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::SetMaxConcurrentScanners(int max_scanners) {
+  if (data_->open_) {
+    return Status::IllegalState("Concurrency limits must be set before Open()");
+  }
+  if (max_scanners <= 0) {
+    return Status::InvalidArgument("maximum number of concurrent scanners must be positive");
+  }
+  data_->max_scanners_ = max_scanners;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::SetMaxConcurrentScannersPerServer(int max_scanners) {
+  if (data_->open_) {
+    return Status::IllegalState("Concurrency limits must be set before Open()");
+  }
+  if (max_scanners <= 0) {
+    return Status::InvalidArgument(
+        "maximum number of concurrent scanners per server must be positive");
+  }
+  data_->max_scanners_per_server_ = max_scanners;
+  return Status::OK();
+}
+
+Status KuduParallelScanner::Open() {
+  return data_->Open();
+}
+
+bool KuduParallelScanner::HasMoreRows() const {
+  return data_->HasMoreRows();
+}
+
+Status KuduParallelScanner::NextBatch(vector<KuduScanBatch::RowPtr>* rows) {
+  return data_->NextBatch(rows);
+}
+
+void KuduParallelScanner::Close() {
+  data_->Close();
+}
+
+////////////////////////////////////////////////////////////
+// KuduRowLookup
+////////////////////////////////////////////////////////////
+
+KuduRowLookup::KuduRowLookup(KuduTable* table)
+    : data_(new KuduRowLookup::Data(table)) {
+}
+
+KuduRowLookup::~KuduRowLookup() {
+  delete data_;
+}
+
+Status KuduRowLookup::SetProjectedColumnNames(const vector<string>& col_names) {
+  return data_->configuration_.SetProjectedColumnNames(col_names);
+}
+
+Status KuduRowLookup::SetSelection(KuduClient::ReplicaSelection selection) {
+  return data_->configuration_.SetSelection(selection);
+}
+
+Status KuduRowLookup::SetTimeoutMillis(int millis) {
+  data_->configuration_.SetTimeoutMillis(millis);
+  return Status::OK();
+}
+
+Status KuduRowLookup::AddKey(KuduPartialRow* key) {
+  unique_ptr<KuduPartialRow> owned_key(key);
+  if (!key->IsKeySet()) {
+    return Status::IllegalState("Key not specified", key->ToString());
+  }
+  data_->keys_.push_back(owned_key.release());
+  return Status::OK();
+}
+
+int KuduRowLookup::num_keys() const {
+  return data_->keys_.size();
+}
+
+Status KuduRowLookup::Run() {
+  return data_->Run();
+}
+
+bool KuduRowLookup::GetRow(int idx, KuduScanBatch::RowPtr* row) const {
+  CHECK_GE(idx, 0);
+  CHECK_LT(idx, data_->rows_.size());
+  const std::pair<int, int>& location = data_->rows_[idx];
+  if (location.first < 0) {
+    return false;
+  }
+  *row = data_->batches_[location.first]->Row(location.second);
+  return true;
+}
+
 ////////////////////////////////////////////////////////////
 // KuduTabletServer
 ////////////////////////////////////////////////////////////
@@ -1411,5 +1777,53 @@ const string& KuduTabletServer::hostname() const {
   return data_->hostname_;
 }
 
+////////////////////////////////////////////////////////////
+// KuduColumnStatistics
+////////////////////////////////////////////////////////////
+
+KuduColumnStatistics::KuduColumnStatistics()
+  : data_(nullptr) {
+}
+
+KuduColumnStatistics::~KuduColumnStatistics() {
+  delete data_;
+}
+
+const string& KuduColumnStatistics::column_name() const {
+  return data_->column_name_;
+}
+
+int64_t KuduColumnStatistics::num_rows() const {
+  return data_->num_rows_;
+}
+
+int64_t KuduColumnStatistics::null_count() const {
+  return data_->null_count_;
+}
+
+int64_t KuduColumnStatistics::num_distinct_values() const {
+  return data_->num_distinct_values_;
+}
+
+const KuduValue* KuduColumnStatistics::min_value() const {
+  return data_->min_value_.get();
+}
+
+const KuduValue* KuduColumnStatistics::max_value() const {
+  return data_->max_value_.get();
+}
+
+int KuduColumnStatistics::num_histogram_buckets() const {
+  return data_->histogram_counts_.size();
+}
+
+const KuduValue* KuduColumnStatistics::histogram_upper_bound(int idx) const {
+  return data_->histogram_upper_bounds_[idx].get();
+}
+
+int64_t KuduColumnStatistics::histogram_count(int idx) const {
+  return data_->histogram_counts_[idx];
+}
+
 } // namespace client
 } // namespace kudu
@@ -63,6 +63,7 @@ class PartitionSchema;
 
 namespace client {
 
+class KuduColumnStatistics;
 class KuduLoggingCallback;
 class KuduScanToken;
 class KuduSession;
@@ -303,6 +304,24 @@ class KUDU_EXPORT KuduClient : public sp::enable_shared_from_this<KuduClient> {
   /// @return Operation status.
   Status ListTabletServers(std::vector<KuduTabletServer*>* tablet_servers);
 
+  /// Get the statistics of the values of the columns of a table.
+  ///
+  /// The statistics are collected by the tablet servers as they flush and
+  /// compact data, and are periodically reported to the master. They
+  /// describe the data as it was written: recent writes and the updates and
+  /// deletes of existing rows are not accounted for. They are meant to help
+  /// query planners estimate cardinalities, not to be exact.
+  ///
+  /// @param [in] table_name
+  ///   Name of the table.
+  /// @param [out] column_stats
+  ///   The placeholder for the result: the statistics of the columns which
+  ///   have some, in schema order. The caller takes ownership of the
+  ///   container's elements.
+  /// @return Operation status.
+  Status GetTableStatistics(const std::string& table_name,
+                            std::vector<KuduColumnStatistics*>* column_stats);
+
   /// List only those tables whose names pass a substring match on 'filter'.
   ///
   /// @param [out] tables
@@ -563,6 +582,65 @@ class KUDU_EXPORT KuduTableCreator {
   /// @return Reference to the modified table creator.
   KuduTableCreator& num_replicas(int n_replicas);
 
+  /// Compaction policies which may be used by the tablets of a table.
+  enum CompactionPolicy {
+    /// Pick rowsets which maximally reduce the average rowset height
+    /// within a fixed I/O budget.
+    BUDGETED_COMPACTION,
+    /// Merge overlapping rowsets of similar size, bounding the number of
+    /// times each row is rewritten. Suited to write-heavy tables.
+    TIERED_COMPACTION
+  };
+
+  /// Set the compaction policy for the tablets of the table.
+  ///
+  /// @param [in] policy
+  ///   The compaction policy to use. If not provided, the tablet servers
+  ///   use their configured default policy.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& compaction_policy(CompactionPolicy policy);
+
+  /// Set how long the tablets of the table keep the history of their rows.
+  ///
+  /// Snapshot scans may read the table as of any time within this window.
+  /// Older history is garbage-collected in the background, and scans at
+  /// snapshots before the window are rejected.
+  ///
+  /// @param [in] max_age
+  ///   The history retention, with a granularity of one second. If not
+  ///   provided, the tablet servers use their configured default retention.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& history_max_age(const MonoDelta& max_age);
+
+  /// Set a time-to-live for the rows of the table.
+  ///
+  /// A row expires once the value of its TTL column is older than the TTL.
+  /// Expired rows are hidden from scans and eventually removed by flushes
+  /// and compactions, or by deleting whole rowsets whose rows have all
+  /// expired. Since they may be removed at any time, updates to rows which
+  /// are about to expire may be lost.
+  ///
+  /// @param [in] column
+  ///   Name of the column holding the time of each row. It must be a
+  ///   non-nullable UNIXTIME_MICROS column, and can't be dropped later.
+  /// @param [in] ttl
+  ///   The time-to-live, with a granularity of one second.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& row_ttl(const std::string& column, const MonoDelta& ttl);
+
+  /// Keep the key indexes of the table's rowsets in memory.
+  ///
+  /// The primary key index and bloom filter index blocks of each rowset are
+  /// then read once when the rowset is opened and kept outside the block
+  /// cache, so that point lookups and the presence checks of inserts don't
+  /// miss the cache on them. This is meant for tables which need predictable
+  /// point lookup latency, at the cost of the memory the indexes take up.
+  ///
+  /// @param [in] pin_key_index
+  ///   Whether to pin the key indexes in memory.
+  /// @return Reference to the modified table creator.
+  KuduTableCreator& pin_key_index(bool pin_key_index);
+
   /// Set the timeout for the table creation operation.
   ///
   /// This includes any waiting after the create has been submitted
@@ -696,6 +774,44 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
                                         KuduPredicate::ComparisonOp op,
                                         KuduValue* value);
 
+  /// Create a new IN list predicate.
+  ///
+  /// This method creates new instance of an IN list predicate which
+  /// can be used for scanners on this table object. The predicate matches
+  /// the rows where the column value is equal to any of the listed values.
+  ///
+  /// @param [in] col_name
+  ///   Name of column to use for the predicate.
+  /// @param [in] values
+  ///   The values to match. The type of each value must correspond to the
+  ///   type of the column, as described for NewComparisonPredicate().
+  ///   The values need not be sorted or unique. The returned predicate takes
+  ///   ownership of the values, and the vector is cleared.
+  /// @return Raw pointer to instance of IN list predicate. The caller owns
+  ///   the result until it is passed into KuduScanner::AddConjunctPredicate().
+  ///   Non-NULL is returned both in success and error cases.
+  ///   In the case of an error (e.g. invalid column name), a non-NULL value
+  ///   is still returned. The error will be returned when attempting
+  ///   to add this predicate to a KuduScanner.
+  KuduPredicate* NewInListPredicate(const Slice& col_name,
+                                    std::vector<KuduValue*>* values);
+
+  /// Create a new IS NULL predicate.
+  ///
+  /// This method creates new instance of an IS NULL predicate which
+  /// can be used for scanners on this table object. The predicate matches
+  /// the rows where the column value is null.
+  ///
+  /// @param [in] col_name
+  ///   Name of column to use for the predicate.
+  /// @return Raw pointer to instance of IS NULL predicate. The caller owns
+  ///   the result until it is passed into KuduScanner::AddConjunctPredicate().
+  ///   Non-NULL is returned both in success and error cases.
+  ///   In the case of an error (e.g. invalid column name), a non-NULL value
+  ///   is still returned. The error will be returned when attempting
+  ///   to add this predicate to a KuduScanner.
+  KuduPredicate* NewIsNullPredicate(const Slice& col_name);
+
   /// @return The KuduClient object associated with the table.  The caller
   ///   should not free the returned pointer.
   KuduClient* client() const;
@@ -703,6 +819,18 @@ class KUDU_EXPORT KuduTable : public sp::enable_shared_from_this<KuduTable> {
   /// @return The partition schema for the table.
   const PartitionSchema& partition_schema() const;
 
+  /// Fetch the locations of all of the table's tablets into the client's
+  /// metadata cache.
+  ///
+  /// The client otherwise looks up the location of a tablet the first time
+  /// it writes to or scans it, a few tablets per request to the master.
+  /// Calling this method after opening a table with many tablets fetches
+  /// them in large pages instead, avoiding a burst of lookups once writes
+  /// start. The locations expire from the cache as usual.
+  ///
+  /// @return Operation result status.
+  Status PrefetchTabletLocations();
+
  private:
   class KUDU_NO_EXPORT Data;
 
@@ -755,7 +883,12 @@ class KUDU_EXPORT KuduTableAlterer {
 
   /// Alter an existing column.
   ///
-  /// @note The column may not be in the primary key.
+  /// Only renames and changes to the column's encoding, compression,
+  /// compression level and block size are supported. Data already written
+  /// keeps its old storage attributes until it is rewritten, e.g. by a
+  /// compaction.
+  ///
+  /// @note The column may not be renamed if it is in the primary key.
   ///
   /// @param [in] name
   ///   Name of the column to alter.
@@ -1321,6 +1454,20 @@ class KUDU_EXPORT KuduScanner {
   /// KuduClientBuilder::default_rpc_timeout().
   enum { kScanTimeoutMillis = 30000 };
 
+  /// @name Row format flags
+  ///
+  /// Flags for SetRowFormatFlags(), which may be combined with bitwise OR.
+  ///
+  ///@{
+  /// The default layout: rows are returned row by row.
+  static const uint64_t NO_FLAGS;
+  /// Rows are returned column by column, and must be read through the
+  /// columnar accessors of KuduScanBatch, e.g.
+  /// KuduScanBatch::GetFixedLengthColumn(). This avoids transposing the data
+  /// into rows on the tablet server and back into columns on the client.
+  static const uint64_t COLUMNAR_LAYOUT;
+  ///@}
+
   /// Constructor for KuduScanner.
   ///
   /// @param [in] table
@@ -1437,9 +1584,43 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetCacheBlocks(bool cache_blocks);
 
+  /// Set the layout of the rows returned by the tablet servers.
+  ///
+  /// @note This requires tablet servers which support the requested
+  ///   layout; scans against older servers fail with a NotSupported status.
+  ///
+  /// @param [in] flags
+  ///   A bitwise OR of the row format flags above. Default is @c NO_FLAGS.
+  /// @return Operation result status.
+  Status SetRowFormatFlags(uint64_t flags);
+
   /// @return Result status of the operation (begin scanning).
   Status Open();
 
+  /// Begin scanning asynchronously.
+  ///
+  /// Opening the scanner may block on tablet lookups and on the first scan
+  /// request, so it runs on a thread of the client's asynchronous scan
+  /// pool (see the @c client_async_scan_threads flag). The callback is
+  /// invoked with the result of Open() from that thread, and should not block.
+  ///
+  /// @param [in] cb
+  ///   Callback to report on the result. The scanner must not be used or
+  ///   destroyed until the callback is invoked.
+  void OpenAsync(KuduStatusCallback* cb);
+
+  /// Count the rows matching the scanner's predicates and bounds.
+  ///
+  /// This is called instead of Open() and scans all the matching tablets
+  /// with an empty projection. When there are no predicates, tablet servers
+  /// can usually answer from their rowset metadata without reading any data.
+  /// The scanner should be closed afterwards.
+  ///
+  /// @param [out] count
+  ///   The number of matching rows.
+  /// @return Operation result status.
+  Status CountRows(uint64_t* count);
+
   /// Keep the current remote scanner alive.
   ///
   /// Keep the current remote scanner alive on the Tablet server
@@ -1500,6 +1681,28 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status NextBatch(KuduScanBatch* batch);
 
+  /// Fetch the next batch of results for this scanner asynchronously.
+  ///
+  /// This is the asynchronous counterpart of NextBatch(KuduScanBatch*).
+  /// Continuing the scan of the current tablet, which is what most calls do,
+  /// is done without tying up any thread until the tablet server responds,
+  /// so that a single thread can drive many concurrent scans. Opening the
+  /// next tablet and retrying failed requests may block, and are run on the
+  /// client's asynchronous scan pool instead. Since a single request is in
+  /// flight at a time, prefetching does not help asynchronous scans.
+  ///
+  /// As in all other async functions in Kudu, the callback may be called
+  /// either from an IO thread or the same thread which calls NextBatchAsync().
+  /// The callback should not block.
+  ///
+  /// @param [out] batch
+  ///   Placeholder for the result. It must stay valid, and not be read,
+  ///   until the callback is invoked.
+  /// @param [in] cb
+  ///   Callback to report on the result. The scanner must not be used,
+  ///   closed or destroyed until the callback is invoked.
+  void NextBatchAsync(KuduScanBatch* batch, KuduStatusCallback* cb);
+
   /// Get the KuduTabletServer that is currently handling the scan.
   ///
   /// More concretely, this is the server that handled the most recent
@@ -1521,6 +1724,34 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  /// Keep the request for the next batch in flight while the caller
+  /// consumes the current one.
+  ///
+  /// With prefetching, each call to NextBatch() which leaves more rows to
+  /// read in the current tablet immediately sends the request for the
+  /// following batch, so that scanning on the server overlaps processing on
+  /// the client. At most one batch is prefetched, so a prefetching scanner
+  /// buffers at most one extra batch of the requested batch size. Changes
+  /// to the batch size take effect one batch later.
+  ///
+  /// @param [in] prefetching
+  ///   Whether to prefetch batches. Default is @c false.
+  /// @return Operation result status.
+  Status SetPrefetching(bool prefetching);
+
+  /// Set the maximum number of rows to return.
+  ///
+  /// Each tablet server stops scanning and closes its scanner once the
+  /// rows it returned reach what is left of the limit, and the scanner
+  /// reports no more rows once the limit is reached. Unless the scan is
+  /// fault tolerant, which rows make up the limit is unspecified.
+  ///
+  /// @param [in] limit
+  ///   The maximum number of rows, which must not be negative.
+  ///   By default there is no limit.
+  /// @return Operation result status.
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
   /// Set the replica selection policy while scanning.
   ///
   /// @param [in] selection
@@ -1574,6 +1805,21 @@ class KUDU_EXPORT KuduScanner {
   /// @return Operation result status.
   Status SetSnapshotRaw(uint64_t snapshot_timestamp) WARN_UNUSED_RESULT;
 
+  /// Allow reads to be served by any replica whose data is at most
+  /// @c max_staleness_ms milliseconds behind the current time.
+  ///
+  /// This sets the read mode to @c READ_AT_SNAPSHOT and lets followers serve
+  /// the scan at their safe time instead of waiting for in-flight operations.
+  /// Replicas that are further behind reject the scan, and the scan is retried
+  /// at the next replica allowed by the replica selection policy, falling back
+  /// to the leader. Combine with @c CLOSEST_REPLICA to spread read load across
+  /// all replicas. A snapshot timestamp, if set, takes precedence.
+  ///
+  /// @param [in] max_staleness_ms
+  ///   Maximum staleness to accept (in milliseconds). Must not be negative.
+  /// @return Operation result status.
+  Status SetMaxStalenessMillis(int max_staleness_ms) WARN_UNUSED_RESULT;
+
   /// Set the maximum time that Open() and NextBatch() are allowed to take.
   ///
   /// @param [in] millis
@@ -1590,6 +1836,13 @@ class KUDU_EXPORT KuduScanner {
  private:
   class KUDU_NO_EXPORT Data;
 
+  // Hands the rows of the last scan response out in 'batch'.
+  Status ExtractBatch(KuduScanBatch* batch);
+
+  // Completes a NextBatchAsync() call once its scan RPC has returned.
+  void NextBatchAsyncDone(KuduScanBatch* batch, KuduStatusCallback* cb);
+
+  friend class KuduParallelScanner;
   friend class KuduScanToken;
   FRIEND_TEST(ClientTest, TestScanCloseProxy);
   FRIEND_TEST(ClientTest, TestScanFaultTolerance);
@@ -1769,6 +2022,34 @@ class KUDU_EXPORT KuduScanTokenBuilder {
   /// @copydoc KuduScanner::SetTimeoutMillis
   Status SetTimeoutMillis(int millis) WARN_UNUSED_RESULT;
 
+  /// Set the maximum number of rows to return.
+  ///
+  /// The limit applies to the scan of each token. KuduParallelScanner
+  /// applies it to the scan as a whole, and stops scanning the remaining
+  /// tablets once it is reached.
+  ///
+  /// @param [in] limit
+  ///   The maximum number of rows, which must not be negative.
+  ///   By default there is no limit.
+  /// @return Operation result status.
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
+  /// Split the scan of each tablet into several tokens covering about
+  /// the given amount of on-disk data each.
+  ///
+  /// Without this, Build() makes one token per tablet, however large.
+  /// With it, Build() asks a tablet server hosting each tablet for split
+  /// points in the tablet's primary key range, estimated from its on-disk
+  /// key indexes, so that tokens of unbalanced tablets take about as long
+  /// to scan as one another. A tablet whose range can't be split gets a
+  /// single token.
+  ///
+  /// @param [in] split_size_bytes
+  ///   The target amount of data per token, in bytes. 0, the default,
+  ///   disables splitting.
+  /// @return Operation result status.
+  Status SetSplitSizeBytes(uint64_t split_size_bytes) WARN_UNUSED_RESULT;
+
   /// Build the set of scan tokens.
   ///
   /// The builder may be reused after this call.
@@ -1785,12 +2066,191 @@ class KUDU_EXPORT KuduScanTokenBuilder {
  private:
   class KUDU_NO_EXPORT Data;
 
+  friend class KuduParallelScanner;
+
   // Owned.
   Data* data_;
 
   DISALLOW_COPY_AND_ASSIGN(KuduScanTokenBuilder);
 };
 
+/// @brief A scanner which reads the tablets of a table concurrently.
+///
+/// The scan is described by a KuduScanTokenBuilder: its projection,
+/// predicates, bounds and other options apply to the scan of every tablet.
+/// The rows are returned through NextBatch() either as they arrive or, in
+/// KuduScanner::ORDERED mode, merged into primary key order.
+///
+/// @note This class is not thread-safe.
+class KUDU_EXPORT KuduParallelScanner {
+ public:
+  /// Default concurrency limits (see SetMaxConcurrentScanners() and
+  /// SetMaxConcurrentScannersPerServer()).
+  enum {
+    kDefaultMaxConcurrentScanners = 8,
+    kDefaultMaxConcurrentScannersPerServer = 2
+  };
+
+  /// Construct a parallel scanner.
+  ///
+  /// @param [in] builder
+  ///   Describes the scan. The given object must remain valid until Open()
+  ///   returns; the parallel scanner builds its scan tokens there.
+  explicit KuduParallelScanner(KuduScanTokenBuilder* builder);
+  ~KuduParallelScanner();
+
+  /// Set the order in which rows are returned.
+  ///
+  /// In KuduScanner::UNORDERED mode, the default, batches are returned in
+  /// the order they arrive from the tablets. In KuduScanner::ORDERED mode,
+  /// each tablet is scanned in primary key order and the rows of all tablets
+  /// are merged, which requires the projection to include every primary key
+  /// column. The merge needs a scanner open on every tablet at once, so in
+  /// this mode the concurrency limits below only bound how many tablet
+  /// scanners are opened at once, and the per-server limit does not apply.
+  ///
+  /// @param [in] order_mode
+  ///   Order mode to set.
+  /// @return Operation result status.
+  Status SetOrderMode(KuduScanner::OrderMode order_mode) WARN_UNUSED_RESULT;
+
+  /// Set the maximum number of tablets to scan at once.
+  ///
+  /// @param [in] max_scanners
+  ///   The maximum number of concurrent tablet scans, which must be positive.
+  ///   Default is kDefaultMaxConcurrentScanners.
+  /// @return Operation result status.
+  Status SetMaxConcurrentScanners(int max_scanners) WARN_UNUSED_RESULT;
+
+  /// Set the maximum number of tablets to scan at once on any tablet server.
+  ///
+  /// Tablets are attributed to the first tablet server hinted by their
+  /// scan tokens (see KuduScanToken::TabletServers()).
+  ///
+  /// @param [in] max_scanners
+  ///   The maximum number of concurrent tablet scans per server, which must
+  ///   be positive. Default is kDefaultMaxConcurrentScannersPerServer.
+  /// @return Operation result status.
+  Status SetMaxConcurrentScannersPerServer(int max_scanners) WARN_UNUSED_RESULT;
+
+  /// Begin scanning.
+  ///
+  /// @return Operation result status.
+  Status Open() WARN_UNUSED_RESULT;
+
+  /// Check if there may be rows to be fetched from this scanner.
+  ///
+  /// @pre The scanner must be opened before calling this method.
+  ///
+  /// @return @c true if there may be rows to be fetched from this scanner.
+  ///   As with KuduScanner::HasMoreRows(), the next batch may turn out
+  ///   to be empty.
+  bool HasMoreRows() const;
+
+  /// Get the next batch of rows.
+  ///
+  /// The rows point into row data held by the parallel scanner, and are only
+  /// valid until the next call to NextBatch() or Close().
+  ///
+  /// @param [out] rows
+  ///   Placeholder for the result. Its previous contents are discarded.
+  /// @return The first error encountered by the scan of any tablet, or
+  ///   Status::OK() if none.
+  Status NextBatch(std::vector<KuduScanBatch::RowPtr>* rows) WARN_UNUSED_RESULT;
+
+  /// Stop scanning, and close the scanners of all tablets.
+  ///
+  /// This is called automatically by the destructor.
+  void Close();
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduParallelScanner);
+};
+
+/// @brief Looks up rows of a table by their primary keys.
+///
+/// The keys are grouped by tablet, and each tablet is sent one request for
+/// all of its keys, which is answered without opening a scanner. The
+/// requests to different tablets are sent in parallel. As with a
+/// KuduScanner in the default @c READ_LATEST mode, each tablet returns the
+/// latest rows of the replica the request is sent to.
+///
+/// @note This class is not thread-safe.
+class KUDU_EXPORT KuduRowLookup {
+ public:
+  /// Create a lookup of the rows of the given table.
+  ///
+  /// @param [in] table
+  ///   The table to read. It must remain valid for the lifetime of the
+  ///   lookup object.
+  explicit KuduRowLookup(KuduTable* table);
+
+  ~KuduRowLookup();
+
+  /// Set the projection for the lookup.
+  ///
+  /// @param [in] col_names
+  ///   Column names to use for the projection. By default, all columns
+  ///   are returned.
+  /// @return Operation result status.
+  Status SetProjectedColumnNames(const std::vector<std::string>& col_names)
+      WARN_UNUSED_RESULT;
+
+  /// Set the replica selection policy, as for KuduScanner::SetSelection().
+  ///
+  /// @param [in] selection
+  ///   The replica selection policy. Default is KuduClient::CLOSEST_REPLICA.
+  /// @return Operation result status.
+  Status SetSelection(KuduClient::ReplicaSelection selection) WARN_UNUSED_RESULT;
+
+  /// Set the maximum time that Run() is allowed to take.
+  ///
+  /// @param [in] millis
+  ///   The timeout in milliseconds.
+  /// @return Operation result status.
+  Status SetTimeoutMillis(int millis);
+
+  /// Add the primary key of a row to look up.
+  ///
+  /// @param [in] key
+  ///   A row of the table with every primary key column set; other columns
+  ///   are ignored. The lookup takes ownership of the row.
+  /// @return Operation result status.
+  Status AddKey(KuduPartialRow* key) WARN_UNUSED_RESULT;
+
+  /// @return The number of keys added so far.
+  int num_keys() const;
+
+  /// Look up the rows of all the keys added.
+  ///
+  /// @return Operation result status. If the request to any tablet failed,
+  ///   returns the first error.
+  Status Run() WARN_UNUSED_RESULT;
+
+  /// Get the row of a key, after Run() succeeded.
+  ///
+  /// @param [in] idx
+  ///   The index of the key, in the order the keys were added.
+  /// @param [out] row
+  ///   The row of the key, in the projection of the lookup. It stays valid
+  ///   for the lifetime of this object.
+  /// @return @c true if the row exists, @c false otherwise.
+  bool GetRow(int idx, KuduScanBatch::RowPtr* row) const;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduRowLookup);
+};
+
 /// @brief In-memory representation of a remote tablet server.
 class KUDU_EXPORT KuduTabletServer {
  public:
@@ -1819,6 +2279,67 @@ class KUDU_EXPORT KuduTabletServer {
   DISALLOW_COPY_AND_ASSIGN(KuduTabletServer);
 };
 
+/// @brief Statistics of the values of a column of a table.
+///
+/// @see KuduClient::GetTableStatistics()
+class KUDU_EXPORT KuduColumnStatistics {
+ public:
+  ~KuduColumnStatistics();
+
+  /// @return Name of the column.
+  const std::string& column_name() const;
+
+  /// @return Number of rows, including those whose value is @c NULL.
+  int64_t num_rows() const;
+
+  /// @return Number of rows whose value is @c NULL.
+  int64_t null_count() const;
+
+  /// @return Estimated number of distinct non-@c NULL values, or -1 if
+  ///   unknown.
+  int64_t num_distinct_values() const;
+
+  /// @return The smallest value of the column, or @c NULL if unknown, e.g.
+  ///   because some values were too large to be recorded. The object is owned
+  ///   by this KuduColumnStatistics.
+  const KuduValue* min_value() const;
+
+  /// @return The largest value of the column, or @c NULL if unknown.
+  ///   The object is owned by this KuduColumnStatistics.
+  const KuduValue* max_value() const;
+
+  /// The values of the column are split into approximately equi-depth
+  /// buckets, in increasing order of value, each holding the number of
+  /// values greater than the upper bound of the previous bucket, and no
+  /// greater than its own.
+  ///
+  /// @return Number of histogram buckets, 0 if unknown.
+  int num_histogram_buckets() const;
+
+  /// @param [in] idx
+  ///   Index of the bucket.
+  /// @return The upper bound of the bucket. The object is owned by this
+  ///   KuduColumnStatistics.
+  const KuduValue* histogram_upper_bound(int idx) const;
+
+  /// @param [in] idx
+  ///   Index of the bucket.
+  /// @return The estimated number of values in the bucket.
+  int64_t histogram_count(int idx) const;
+
+ private:
+  class KUDU_NO_EXPORT Data;
+
+  friend class KuduClient;
+
+  KuduColumnStatistics();
+
+  // Owned.
+  Data* data_;
+
+  DISALLOW_COPY_AND_ASSIGN(KuduColumnStatistics);
+};
+
 } // namespace client
 } // namespace kudu
 #endif
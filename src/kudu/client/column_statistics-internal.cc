@@ -0,0 +1,121 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/column_statistics-internal.h"
+
+#include <string.h>
+
+#include "kudu/common/column_stats.h"
+#include "kudu/common/common.pb.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::string;
+using std::unique_ptr;
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+namespace {
+
+template<typename T>
+T DecodeFixed(const string& value) {
+  T v;
+  memcpy(&v, value.data(), sizeof(v));
+  return v;
+}
+
+// Converts 'value', as stored in the statistics of a column of type 'type',
+// into a KuduValue.
+Status ValueFromStats(const TypeInfo* type, const string& value,
+                      unique_ptr<KuduValue>* result) {
+  if (type->physical_type() != BINARY && value.size() != type->size()) {
+    return Status::Corruption(Substitute("invalid $0 statistics value of size $1",
+                                         type->name(), value.size()));
+  }
+  switch (type->type()) {
+    case BOOL:
+      result->reset(KuduValue::FromBool(DecodeFixed<bool>(value)));
+      break;
+    case INT8:
+      result->reset(KuduValue::FromInt(DecodeFixed<int8_t>(value)));
+      break;
+    case INT16:
+      result->reset(KuduValue::FromInt(DecodeFixed<int16_t>(value)));
+      break;
+    case INT32:
+      result->reset(KuduValue::FromInt(DecodeFixed<int32_t>(value)));
+      break;
+    case INT64:
+    case UNIXTIME_MICROS:
+      result->reset(KuduValue::FromInt(DecodeFixed<int64_t>(value)));
+      break;
+    case FLOAT:
+      result->reset(KuduValue::FromFloat(DecodeFixed<float>(value)));
+      break;
+    case DOUBLE:
+      result->reset(KuduValue::FromDouble(DecodeFixed<double>(value)));
+      break;
+    case STRING:
+    case BINARY:
+      result->reset(KuduValue::CopyString(value));
+      break;
+    default:
+      return Status::NotSupported(Substitute("unsupported statistics type $0", type->name()));
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+KuduColumnStatistics::Data::Data()
+    : num_rows_(0),
+      null_count_(0),
+      num_distinct_values_(-1) {
+}
+
+KuduColumnStatistics::Data::~Data() {
+}
+
+Status KuduColumnStatistics::Data::FromPB(string name, const TypeInfo* type,
+                                          const ColumnStatisticsPB& stats,
+                                          unique_ptr<Data>* data) {
+  unique_ptr<Data> d(new Data());
+  d->column_name_ = std::move(name);
+  d->num_rows_ = stats.num_rows();
+  d->null_count_ = stats.null_count();
+  d->num_distinct_values_ = EstimateDistinctValues(stats);
+  if (stats.has_min_value() && stats.has_max_value()) {
+    RETURN_NOT_OK(ValueFromStats(type, stats.min_value(), &d->min_value_));
+    RETURN_NOT_OK(ValueFromStats(type, stats.max_value(), &d->max_value_));
+  }
+  if (stats.histogram_upper_bounds_size() != stats.histogram_counts_size()) {
+    return Status::Corruption("mismatched histogram bounds and counts");
+  }
+  for (int i = 0; i < stats.histogram_upper_bounds_size(); i++) {
+    unique_ptr<KuduValue> bound;
+    RETURN_NOT_OK(ValueFromStats(type, stats.histogram_upper_bounds(i), &bound));
+    d->histogram_upper_bounds_.emplace_back(std::move(bound));
+    d->histogram_counts_.push_back(stats.histogram_counts(i));
+  }
+  *data = std::move(d);
+  return Status::OK();
+}
+
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,66 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_CLIENT_COLUMN_STATISTICS_INTERNAL_H
+#define KUDU_CLIENT_COLUMN_STATISTICS_INTERNAL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/client/value.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnStatisticsPB;
+class TypeInfo;
+
+namespace client {
+
+class KuduColumnStatistics::Data {
+ public:
+  ~Data();
+
+  // Sets '*data' to the statistics of the column 'name' of type 'type'
+  // described by 'stats', as sent by the master.
+  //
+  // Returns Corruption if one of their values isn't valid for the type.
+  static Status FromPB(std::string name, const TypeInfo* type,
+                       const ColumnStatisticsPB& stats,
+                       std::unique_ptr<Data>* data);
+
+  std::string column_name_;
+  int64_t num_rows_;
+  int64_t null_count_;
+  int64_t num_distinct_values_;
+  std::unique_ptr<KuduValue> min_value_;
+  std::unique_ptr<KuduValue> max_value_;
+  std::vector<std::unique_ptr<KuduValue>> histogram_upper_bounds_;
+  std::vector<int64_t> histogram_counts_;
+
+ private:
+  Data();
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
+
+#endif
@@ -17,7 +17,9 @@
 
 #include "kudu/client/meta_cache.h"
 
+#include <algorithm>
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <mutex>
 
@@ -33,6 +35,7 @@
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc.h"
 #include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/net/dns_resolver.h"
 #include "kudu/util/net/net_util.h"
 
@@ -42,6 +45,13 @@ using std::shared_ptr;
 using std::string;
 using strings::Substitute;
 
+DEFINE_int32(client_max_inflight_writes_per_server, 0,
+             "The maximum number of write RPCs the client keeps in flight to any "
+             "one tablet server. The limit shrinks while the server reports being "
+             "too busy, and grows back as it accepts writes again. 0 disables the "
+             "limit.");
+TAG_FLAG(client_max_inflight_writes_per_server, experimental);
+
 namespace kudu {
 
 using consensus::RaftPeerPB;
@@ -61,12 +71,78 @@ namespace internal {
 
 namespace {
 const int MAX_RETURNED_TABLE_LOCATIONS = 10;
+
+// The number of tablet locations fetched per master RPC when prefetching all
+// of the locations of a table.
+const int PREFETCH_TABLE_LOCATIONS_PAGE_SIZE = 1000;
 } // anonymous namespace
 
 ////////////////////////////////////////////////////////////
 
+WriteWindow::WriteWindow(int max_size)
+  : max_size_(max_size),
+    size_(max_size),
+    num_in_flight_(0) {
+  CHECK_GE(max_size, 0);
+}
+
+void WriteWindow::Acquire(const boost::function<void()>& send) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (max_size_ > 0 && num_in_flight_ >= static_cast<int>(size_)) {
+      waiting_.push_back(send);
+      return;
+    }
+    num_in_flight_++;
+  }
+  send();
+}
+
+void WriteWindow::Release(bool server_busy) {
+  std::vector<boost::function<void()>> to_send;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    DCHECK_GT(num_in_flight_, 0);
+    num_in_flight_--;
+    if (max_size_ == 0) {
+      return;
+    }
+    if (server_busy) {
+      size_ = std::max(1.0, size_ / 2);
+    } else {
+      size_ = std::min<double>(max_size_, size_ + 1 / size_);
+    }
+    while (!waiting_.empty() && num_in_flight_ < static_cast<int>(size_)) {
+      to_send.push_back(waiting_.front());
+      waiting_.pop_front();
+      num_in_flight_++;
+    }
+  }
+  for (const auto& send : to_send) {
+    send();
+  }
+}
+
+int WriteWindow::size() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return static_cast<int>(size_);
+}
+
+int WriteWindow::num_in_flight() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return num_in_flight_;
+}
+
+int WriteWindow::num_waiting() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return waiting_.size();
+}
+
+////////////////////////////////////////////////////////////
+
 RemoteTabletServer::RemoteTabletServer(const master::TSInfoPB& pb)
-  : uuid_(pb.permanent_uuid()) {
+  : uuid_(pb.permanent_uuid()),
+    write_window_(FLAGS_client_max_inflight_writes_per_server) {
 
   Update(pb);
 }
@@ -514,7 +590,8 @@ class LookupRpc : public Rpc {
             scoped_refptr<RemoteTablet>* remote_tablet,
             const MonoTime& deadline,
             const shared_ptr<Messenger>& messenger,
-            bool is_exact_lookup);
+            bool is_exact_lookup,
+            int max_returned_locations = MAX_RETURNED_TABLE_LOCATIONS);
   virtual ~LookupRpc();
   virtual void SendRpc() OVERRIDE;
   virtual string ToString() const OVERRIDE;
@@ -573,6 +650,9 @@ class LookupRpc : public Rpc {
   // partition key. If false, the next tablet after the partition key should be
   // returned if the partition key falls in a non-covered partition range.
   bool is_exact_lookup_;
+
+  // The maximum number of tablet locations fetched from the master.
+  int max_returned_locations_;
 };
 
 LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
@@ -581,7 +661,8 @@ LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
                      scoped_refptr<RemoteTablet>* remote_tablet,
                      const MonoTime& deadline,
                      const shared_ptr<Messenger>& messenger,
-                     bool is_exact_lookup)
+                     bool is_exact_lookup,
+                     int max_returned_locations)
     : Rpc(deadline, messenger),
       meta_cache_(meta_cache),
       user_cb_(std::move(user_cb)),
@@ -589,7 +670,8 @@ LookupRpc::LookupRpc(const scoped_refptr<MetaCache>& meta_cache,
       partition_key_(std::move(partition_key)),
       remote_tablet_(remote_tablet),
       has_permit_(false),
-      is_exact_lookup_(is_exact_lookup) {
+      is_exact_lookup_(is_exact_lookup),
+      max_returned_locations_(max_returned_locations) {
   DCHECK(deadline.Initialized());
 }
 
@@ -639,7 +721,8 @@ void LookupRpc::SendRpc() {
   // Fill out the request.
   req_.mutable_table()->set_table_id(table_->id());
   req_.set_partition_key_start(partition_key_);
-  req_.set_max_returned_locations(MAX_RETURNED_TABLE_LOCATIONS);
+  req_.set_max_returned_locations(max_returned_locations_);
+  req_.set_allow_locations_sidecar(true);
 
   // The end partition key is left unset intentionally so that we'll prefetch
   // some additional tablets.
@@ -749,6 +832,18 @@ void LookupRpc::SendRpcCb(const Status& status) {
     return;
   }
 
+  if (new_status.ok() && resp_.has_tablet_locations_sidecar()) {
+    // The master sent the locations pre-serialized; move them into the
+    // response so they're processed like inline locations.
+    Slice sidecar;
+    new_status = retrier().controller().GetSidecar(resp_.tablet_locations_sidecar(), &sidecar);
+    GetTableLocationsResponsePB locations;
+    if (new_status.ok() && !locations.ParseFromArray(sidecar.data(), sidecar.size())) {
+      new_status = Status::Corruption("Unable to parse tablet locations sidecar");
+    }
+    resp_.mutable_tablet_locations()->Swap(locations.mutable_tablet_locations());
+  }
+
   if (new_status.ok()) {
     MetaCacheEntry entry;
     new_status = meta_cache_->ProcessLookupResponse(*this, &entry);
@@ -886,7 +981,8 @@ Status MetaCache::ProcessLookupResponse(const LookupRpc& rpc,
       InsertOrDie(&tablets_by_key, tablet_lower_bound, std::move(entry));
     }
 
-    if (!last_upper_bound.empty() && tablet_locations.size() < MAX_RETURNED_TABLE_LOCATIONS) {
+    if (!last_upper_bound.empty() &&
+        tablet_locations.size() < rpc.req().max_returned_locations()) {
       // There is a non-covered range between the last tablet and the end of the
       // partition key space, such as F.
 
@@ -939,6 +1035,26 @@ bool MetaCache::LookupTabletByKeyFastPath(const KuduTable* table,
   return false;
 }
 
+int MetaCache::CountCachedTablets(const KuduTable* table,
+                                  const string& lower,
+                                  const string& upper) {
+  shared_lock<rw_spinlock> l(lock_);
+  const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
+  if (!tablets) {
+    return 0;
+  }
+  int count = 0;
+  for (auto it = tablets->lower_bound(lower);
+       it != tablets->end() && (upper.empty() || it->first < upper);
+       ++it) {
+    const MetaCacheEntry& e = it->second;
+    if (!e.stale() && !e.is_non_covered_range()) {
+      count++;
+    }
+  }
+  return count;
+}
+
 void MetaCache::ClearCache() {
   VLOG(3) << "Clearing cache";
   std::lock_guard<rw_spinlock> l(lock_);
@@ -979,6 +1095,64 @@ void MetaCache::LookupTabletByKeyOrNext(const KuduTable* table,
   rpc->SendRpc();
 }
 
+Status MetaCache::PrefetchTableLocations(const KuduTable* table,
+                                         const MonoTime& deadline) {
+  string partition_key;
+  while (true) {
+    Synchronizer sync;
+    LookupRpc* rpc = new LookupRpc(this,
+                                   sync.AsStatusCallback(),
+                                   table,
+                                   partition_key,
+                                   nullptr,
+                                   deadline,
+                                   client_->data_->messenger_,
+                                   false,
+                                   PREFETCH_TABLE_LOCATIONS_PAGE_SIZE);
+    rpc->SendRpc();
+    Status s = sync.Wait();
+    if (s.IsNotFound()) {
+      // The rest of the table is a non-covered range.
+      return Status::OK();
+    }
+    RETURN_NOT_OK(s);
+
+    // Skip over the page of locations which was just cached, and whatever
+    // was already cached after it.
+    string next_partition_key = CachedRangeEnd(table, partition_key);
+    if (next_partition_key.empty() || next_partition_key <= partition_key) {
+      // Either done, or the entries expired already; in the latter case the
+      // remaining tablets are looked up as they are needed.
+      return Status::OK();
+    }
+    partition_key = std::move(next_partition_key);
+  }
+}
+
+string MetaCache::CachedRangeEnd(const KuduTable* table, const string& partition_key) {
+  shared_lock<rw_spinlock> l(lock_);
+  const TabletMap* tablets = FindOrNull(tablets_by_table_and_key_, table->id());
+  if (!tablets) {
+    return partition_key;
+  }
+  string end = partition_key;
+  auto it = tablets->upper_bound(partition_key);
+  if (it != tablets->begin()) {
+    --it;
+  }
+  for (; it != tablets->end(); ++it) {
+    const MetaCacheEntry& e = it->second;
+    if (e.stale() || !e.Contains(end)) {
+      break;
+    }
+    end = e.upper_bound_partition_key();
+    if (end.empty()) {
+      break;
+    }
+  }
+  return end;
+}
+
 void MetaCache::MarkTSFailed(RemoteTabletServer* ts,
                              const Status& status) {
   LOG(INFO) << "Marking tablet server " << ts->ToString() << " as failed.";
@@ -20,6 +20,7 @@
 #define KUDU_CLIENT_META_CACHE_H
 
 #include <boost/function.hpp>
+#include <deque>
 #include <map>
 #include <set>
 #include <string>
@@ -70,6 +71,45 @@ class RemoteTablet;
 // The information cached about a given tablet server in the cluster.
 //
 // This class is thread-safe.
+// Limits the number of write attempts in flight to one tablet server.
+//
+// The limit adapts to the server's backpressure: it is halved each time the
+// server rejects a write as too busy, and grows back by about one for each
+// limit's worth of writes which it accepts, up to 'max_size'.
+class WriteWindow {
+ public:
+  // A 'max_size' of 0 disables the limit.
+  explicit WriteWindow(int max_size);
+
+  // Runs 'send' right away if fewer writes than the current limit are in
+  // flight, or else once enough of them were released. Either way, the
+  // write sent by 'send' counts as in flight until Release() is called.
+  void Acquire(const boost::function<void()>& send);
+
+  // Releases a write taken in flight by Acquire(). 'server_busy' is whether
+  // the server rejected it for being too busy.
+  void Release(bool server_busy);
+
+  // The current limit, or 0 if disabled.
+  int size() const;
+
+  int num_in_flight() const;
+  int num_waiting() const;
+
+ private:
+  mutable simple_spinlock lock_;
+  const int max_size_;
+
+  // Fractional, so that the growth by one per window of accepted writes
+  // can be applied one write at a time.
+  double size_;
+
+  int num_in_flight_;
+  std::deque<boost::function<void()>> waiting_;
+
+  DISALLOW_COPY_AND_ASSIGN(WriteWindow);
+};
+
 class RemoteTabletServer {
  public:
   explicit RemoteTabletServer(const master::TSInfoPB& pb);
@@ -94,6 +134,9 @@ class RemoteTabletServer {
   // Returns the remote server's uuid.
   std::string permanent_uuid() const;
 
+  // The limit on the writes in flight to this server.
+  WriteWindow* write_window() { return &write_window_; }
+
  private:
   // Internal callback for DNS resolution.
   void DnsResolutionFinished(const HostPort& hp,
@@ -108,6 +151,8 @@ class RemoteTabletServer {
   std::vector<HostPort> rpc_hostports_;
   std::shared_ptr<tserver::TabletServerServiceProxy> proxy_;
 
+  WriteWindow write_window_;
+
   DISALLOW_COPY_AND_ASSIGN(RemoteTabletServer);
 };
 
@@ -374,6 +419,20 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                                scoped_refptr<RemoteTablet>* remote_tablet,
                                const StatusCallback& callback);
 
+  // Fetches the locations of all of the tablets of 'table' from the master,
+  // many tablets per RPC, rather than waiting for them to be looked up one
+  // key at a time.
+  //
+  // NOTE: blocks until done or until 'deadline' passes.
+  Status PrefetchTableLocations(const KuduTable* table, const MonoTime& deadline);
+
+  // Returns the number of tablets of 'table' whose partitions start in
+  // ['lower', 'upper'), where an empty 'upper' is the end of the table,
+  // counting only the unexpired entries of the cache.
+  int CountCachedTablets(const KuduTable* table,
+                         const std::string& lower,
+                         const std::string& upper);
+
   // Clears the meta cache.
   void ClearCache();
 
@@ -393,6 +452,7 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
 
   FRIEND_TEST(client::ClientTest, TestMasterLookupPermits);
   FRIEND_TEST(client::ClientTest, TestMetaCacheExpiry);
+  FRIEND_TEST(client::ClientTest, TestPrefetchTabletLocations);
 
   // Called on the slow LookupTablet path when the master responds. Populates
   // the tablet caches and returns a reference to the first one.
@@ -404,6 +464,12 @@ class MetaCache : public RefCountedThreadSafe<MetaCache> {
                                  const std::string& partition_key,
                                  MetaCacheEntry* entry);
 
+  // Returns the end of the range of partition keys of 'table' which starts at
+  // 'partition_key' and is covered by unexpired entries of the cache: either
+  // 'partition_key' itself if it has no such entry, or the empty string if
+  // the range extends to the end of the table.
+  std::string CachedRangeEnd(const KuduTable* table, const std::string& partition_key);
+
   // Update our information about the given tablet server.
   //
   // This is called when we get some response from the master which contains
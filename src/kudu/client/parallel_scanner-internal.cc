@@ -0,0 +1,378 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/parallel_scanner-internal.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <mutex>
+
+#include "kudu/client/scan_token-internal.h"
+#include "kudu/client/scanner-internal.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+KuduParallelScanner::Data::Data(KuduScanTokenBuilder* builder)
+  : builder_(DCHECK_NOTNULL(builder)),
+    order_mode_(KuduScanner::UNORDERED),
+    max_scanners_(kDefaultMaxConcurrentScanners),
+    max_scanners_per_server_(kDefaultMaxConcurrentScannersPerServer),
+    open_(false),
+    limit_(-1),
+    num_rows_returned_(0),
+    running_scans_(0),
+    cancelled_(false),
+    batches_done_(false),
+    projection_(nullptr) {
+}
+
+KuduParallelScanner::Data::~Data() {
+  Close();
+}
+
+Status KuduParallelScanner::Data::OpenScanner(const KuduScanToken& token, bool ordered,
+                                              unique_ptr<KuduScanner>* scanner) {
+  KuduScanner* scanner_ptr;
+  RETURN_NOT_OK(token.IntoKuduScanner(&scanner_ptr));
+  unique_ptr<KuduScanner> new_scanner(scanner_ptr);
+  if (ordered) {
+    RETURN_NOT_OK(new_scanner->SetFaultTolerant());
+  }
+  // Each tablet scanner keeps its next batch in flight, so the tablet keeps
+  // being scanned while its current batch waits to be consumed.
+  RETURN_NOT_OK(new_scanner->SetPrefetching(true));
+  RETURN_NOT_OK(new_scanner->Open());
+  *scanner = std::move(new_scanner);
+  return Status::OK();
+}
+
+Status KuduParallelScanner::Data::Open() {
+  CHECK(!open_) << "Parallel scanner already open";
+
+  // Every token carries the limit too, which bounds the scan of each tablet.
+  const ScanConfiguration& configuration = builder_->data_->configuration();
+  if (configuration.has_limit()) {
+    limit_ = configuration.limit();
+  }
+
+  vector<KuduScanToken*> tokens;
+  ElementDeleter deleter(&tokens);
+  RETURN_NOT_OK(builder_->Build(&tokens));
+  builder_ = nullptr;
+
+  RETURN_NOT_OK(ThreadPoolBuilder("parallel-scan")
+                .set_min_threads(0)
+                .set_max_threads(max_scanners_)
+                .Build(&pool_));
+  open_ = true;
+
+  if (order_mode_ == KuduScanner::UNORDERED) {
+    // Buffer at most two batches per running scan: one being handed over,
+    // and one being fetched by the tablet scanner's prefetch.
+    batches_.reset(new BlockingQueue<KuduScanBatch*>(2 * max_scanners_));
+
+    std::lock_guard<simple_spinlock> l(lock_);
+    for (KuduScanToken* token : tokens) {
+      gscoped_ptr<TabletScan> scan(new TabletScan);
+      if (!token->TabletServers().empty()) {
+        scan->server_uuid = token->TabletServers()[0]->uuid();
+      }
+      scan->token.reset(token);
+      pending_scans_.push_back(scan.release());
+    }
+    tokens.clear();
+    if (pending_scans_.empty()) {
+      batches_->Shutdown();
+    }
+    StartScansUnlocked();
+    return Status::OK();
+  }
+
+  // Opening the scanner of a tablet sends its first scan request, so the
+  // scanners are opened concurrently.
+  for (KuduScanToken* token : tokens) {
+    streams_.emplace_back(new MergeStream);
+    streams_.back()->next_row = 0;
+    Status s = pool_->SubmitFunc(boost::bind(&Data::OpenStream, this, token,
+                                             streams_.back().get()));
+    if (!s.ok()) {
+      std::lock_guard<simple_spinlock> l(lock_);
+      if (first_error_.ok()) first_error_ = s;
+      break;
+    }
+  }
+  pool_->Wait();
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    RETURN_NOT_OK(first_error_);
+  }
+  if (streams_.empty()) {
+    return Status::OK();
+  }
+
+  // The rows are merged by primary key, so all of its columns must be projected.
+  KuduScanner* scanner = streams_.front()->scanner.get();
+  projection_ = scanner->data_->configuration().projection();
+  const KuduSchema& table_schema = scanner->data_->table_->schema();
+  vector<int> table_key_indexes;
+  table_schema.GetPrimaryKeyColumnIndexes(&table_key_indexes);
+  for (int idx : table_key_indexes) {
+    const string& name = table_schema.Column(idx).name();
+    int projection_idx = projection_->find_column(name);
+    if (projection_idx == Schema::kColumnNotFound) {
+      return Status::InvalidArgument(Substitute(
+          "ordered parallel scans must project primary key column $0", name));
+    }
+    key_column_indexes_.push_back(projection_idx);
+  }
+
+  // No stream has a batch yet; merging starts by fetching one for each.
+  for (const auto& stream : streams_) {
+    exhausted_.push_back(stream.get());
+  }
+  return Status::OK();
+}
+
+bool KuduParallelScanner::Data::HasMoreRows() const {
+  CHECK(open_);
+  if (LimitReached()) {
+    return false;
+  }
+  if (order_mode_ == KuduScanner::UNORDERED) {
+    return !batches_done_;
+  }
+  return !heap_.empty() || !exhausted_.empty();
+}
+
+Status KuduParallelScanner::Data::NextBatch(vector<KuduScanBatch::RowPtr>* rows) {
+  CHECK(open_);
+  rows->clear();
+  if (LimitReached()) {
+    return Status::OK();
+  }
+  Status s = order_mode_ == KuduScanner::UNORDERED ?
+      NextUnorderedBatch(rows) : NextOrderedBatch(rows);
+  RETURN_NOT_OK(s);
+
+  num_rows_returned_ += rows->size();
+  if (LimitReached()) {
+    // Drop the rows past the limit, and stop scanning the other tablets.
+    // The rows handed out stay valid until the next call, or Close().
+    rows->resize(rows->size() - (num_rows_returned_ - limit_));
+    num_rows_returned_ = limit_;
+    StopScans();
+    for (const auto& stream : streams_) {
+      if (stream->scanner) {
+        stream->scanner->Close();
+      }
+    }
+  }
+  return Status::OK();
+}
+
+void KuduParallelScanner::Data::StopScans() {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    cancelled_ = true;
+    STLDeleteElements(&pending_scans_);
+  }
+  // Wake up the scans blocked on a full queue.
+  if (batches_) {
+    batches_->Shutdown();
+  }
+}
+
+void KuduParallelScanner::Data::Close() {
+  if (!open_) return;
+
+  // Stop the scans, and wait for them to finish.
+  StopScans();
+  pool_->Wait();
+  pool_->Shutdown();
+
+  if (batches_) {
+    vector<KuduScanBatch*> leftover;
+    batches_->BlockingDrainTo(&leftover);
+    STLDeleteElements(&leftover);
+  }
+  current_batch_.reset();
+  heap_.clear();
+  exhausted_.clear();
+  streams_.clear();
+  batches_done_ = true;
+  open_ = false;
+}
+
+void KuduParallelScanner::Data::StartScansUnlocked() {
+  DCHECK(lock_.is_locked());
+  auto iter = pending_scans_.begin();
+  while (iter != pending_scans_.end() && running_scans_ < max_scanners_) {
+    TabletScan* scan = *iter;
+    int* per_server = &running_scans_per_server_[scan->server_uuid];
+    if (!scan->server_uuid.empty() && *per_server >= max_scanners_per_server_) {
+      ++iter;
+      continue;
+    }
+    Status s = pool_->SubmitFunc(boost::bind(&Data::RunScan, this, scan));
+    if (!s.ok()) {
+      if (first_error_.ok()) first_error_ = s;
+      cancelled_ = true;
+      if (running_scans_ == 0) {
+        batches_->Shutdown();
+      }
+      return;
+    }
+    ++*per_server;
+    running_scans_++;
+    iter = pending_scans_.erase(iter);
+  }
+}
+
+void KuduParallelScanner::Data::RunScan(TabletScan* scan) {
+  unique_ptr<TabletScan> scan_deleter(scan);
+  Status s = ScanTablet(*scan->token);
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  running_scans_--;
+  running_scans_per_server_[scan->server_uuid]--;
+  if (!s.ok() && !cancelled_) {
+    first_error_ = s;
+    cancelled_ = true;
+  }
+  if (!cancelled_) {
+    StartScansUnlocked();
+  }
+  if (running_scans_ == 0 && (cancelled_ || pending_scans_.empty())) {
+    // Let the caller drain the batches that were already returned.
+    batches_->Shutdown();
+  }
+}
+
+Status KuduParallelScanner::Data::ScanTablet(const KuduScanToken& token) {
+  unique_ptr<KuduScanner> scanner;
+  RETURN_NOT_OK(OpenScanner(token, false, &scanner));
+  while (scanner->HasMoreRows()) {
+    {
+      std::lock_guard<simple_spinlock> l(lock_);
+      if (cancelled_) {
+        return Status::OK();
+      }
+    }
+    gscoped_ptr<KuduScanBatch> batch(new KuduScanBatch);
+    RETURN_NOT_OK(scanner->NextBatch(batch.get()));
+    if (batch->NumRows() == 0) {
+      continue;
+    }
+    if (!batches_->BlockingPut(batch.get())) {
+      // The scan was closed.
+      return Status::OK();
+    }
+    ignore_result(batch.release());
+  }
+  return Status::OK();
+}
+
+Status KuduParallelScanner::Data::NextUnorderedBatch(vector<KuduScanBatch::RowPtr>* rows) {
+  // The rows handed out by the last call are no longer referenced.
+  current_batch_.reset();
+  if (batches_done_) {
+    return Status::OK();
+  }
+
+  KuduScanBatch* batch;
+  if (batches_->BlockingGet(&batch)) {
+    current_batch_.reset(batch);
+    rows->reserve(batch->NumRows());
+    for (const KuduScanBatch::RowPtr& row : *batch) {
+      rows->push_back(row);
+    }
+    return Status::OK();
+  }
+
+  batches_done_ = true;
+  std::lock_guard<simple_spinlock> l(lock_);
+  return first_error_;
+}
+
+void KuduParallelScanner::Data::OpenStream(const KuduScanToken* token, MergeStream* stream) {
+  Status s = OpenScanner(*token, true, &stream->scanner);
+  if (!s.ok()) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (first_error_.ok()) first_error_ = s;
+  }
+}
+
+bool KuduParallelScanner::Data::StreamGreater(const MergeStream* a,
+                                              const MergeStream* b) const {
+  KuduScanBatch::RowPtr a_row = a->batch.Row(a->next_row);
+  KuduScanBatch::RowPtr b_row = b->batch.Row(b->next_row);
+  for (int idx : key_column_indexes_) {
+    int cmp = projection_->column(idx).type_info()->Compare(a_row.cell(idx), b_row.cell(idx));
+    if (cmp != 0) {
+      return cmp > 0;
+    }
+  }
+  return false;
+}
+
+Status KuduParallelScanner::Data::NextOrderedBatch(vector<KuduScanBatch::RowPtr>* rows) {
+  auto greater = [this](const MergeStream* a, const MergeStream* b) {
+    return StreamGreater(a, b);
+  };
+
+  // Fetch the next batch of the streams which ran out of rows. Their scanners
+  // prefetch, so the batch is usually already there.
+  for (MergeStream* stream : exhausted_) {
+    while (stream->next_row == stream->batch.NumRows() &&
+           stream->scanner->HasMoreRows()) {
+      RETURN_NOT_OK(stream->scanner->NextBatch(&stream->batch));
+      stream->next_row = 0;
+    }
+    if (stream->next_row < stream->batch.NumRows()) {
+      heap_.push_back(stream);
+      std::push_heap(heap_.begin(), heap_.end(), greater);
+    }
+  }
+  exhausted_.clear();
+
+  // Merge until some stream runs out of rows: the batch it fetches next
+  // would replace the rows it contributed to this batch.
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), greater);
+    MergeStream* stream = heap_.back();
+    rows->push_back(stream->batch.Row(stream->next_row++));
+    if (stream->next_row == stream->batch.NumRows()) {
+      heap_.pop_back();
+      exhausted_.push_back(stream);
+      break;
+    }
+    std::push_heap(heap_.begin(), heap_.end(), greater);
+  }
+  return Status::OK();
+}
+
+} // namespace client
+} // namespace kudu
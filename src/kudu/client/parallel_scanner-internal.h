@@ -0,0 +1,175 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/util/blocking_queue.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/threadpool.h"
+
+namespace kudu {
+
+class Schema;
+
+namespace client {
+
+class KuduParallelScanner::Data {
+ public:
+  explicit Data(KuduScanTokenBuilder* builder);
+  ~Data();
+
+  Status Open();
+
+  bool HasMoreRows() const;
+
+  Status NextBatch(std::vector<KuduScanBatch::RowPtr>* rows);
+
+  void Close();
+
+  // Not owned. Only valid until Open() returns.
+  KuduScanTokenBuilder* builder_;
+
+  KuduScanner::OrderMode order_mode_;
+  int max_scanners_;
+  int max_scanners_per_server_;
+
+  bool open_;
+
+ private:
+  // The scan of one tablet in UNORDERED mode.
+  struct TabletScan {
+    std::unique_ptr<KuduScanToken> token;
+
+    // The tablet server the scan is attributed to, or empty if unknown.
+    std::string server_uuid;
+  };
+
+  // The tablet scanner and current batch of one tablet in ORDERED mode.
+  struct MergeStream {
+    std::unique_ptr<KuduScanner> scanner;
+    KuduScanBatch batch;
+
+    // The index of the next row of 'batch' to merge.
+    int next_row;
+  };
+
+  // Stops the tablet scans: the pending ones never start, and the running
+  // ones return once they notice.
+  void StopScans();
+
+  // Returns true if the rows handed out reached the scan's limit.
+  bool LimitReached() const {
+    return limit_ >= 0 && num_rows_returned_ >= limit_;
+  }
+
+  // Turns 'token' into a scanner and opens it. The scanner prefetches its
+  // batches, and is fault tolerant (so returns rows in key order) if
+  // 'ordered' is true.
+  static Status OpenScanner(const KuduScanToken& token, bool ordered,
+                            std::unique_ptr<KuduScanner>* scanner);
+
+  // UNORDERED mode
+  // --------------------
+
+  // Starts as many pending tablet scans as the concurrency limits allow.
+  void StartScansUnlocked();
+
+  // Runs the scan of 'scan' on a thread of 'pool_', then starts the next
+  // pending scans.
+  void RunScan(TabletScan* scan);
+
+  // Scans the tablet of 'token', passing its batches to 'batches_'.
+  Status ScanTablet(const KuduScanToken& token);
+
+  Status NextUnorderedBatch(std::vector<KuduScanBatch::RowPtr>* rows);
+
+  // ORDERED mode
+  // --------------------
+
+  // Opens the scanner of 'stream' on a thread of 'pool_'.
+  void OpenStream(const KuduScanToken* token, MergeStream* stream);
+
+  // Returns true if the next row of 'a' sorts after the next row of 'b'.
+  bool StreamGreater(const MergeStream* a, const MergeStream* b) const;
+
+  Status NextOrderedBatch(std::vector<KuduScanBatch::RowPtr>* rows);
+
+  // The maximum number of rows to hand out, or -1 if there is no limit, and
+  // the number handed out so far. Only accessed by the caller's thread.
+  int64_t limit_;
+  int64_t num_rows_returned_;
+
+  // Runs the tablet scans in UNORDERED mode, and opens the tablet scanners
+  // in ORDERED mode.
+  gscoped_ptr<ThreadPool> pool_;
+
+  // Protects the members below, which are shared with the threads of 'pool_'.
+  simple_spinlock lock_;
+
+  // UNORDERED mode: the scans which weren't started yet, in token order.
+  std::vector<TabletScan*> pending_scans_;
+
+  // UNORDERED mode: the number of running scans, overall and per server.
+  int running_scans_;
+  std::unordered_map<std::string, int> running_scans_per_server_;
+
+  // The first error encountered by any tablet scan.
+  Status first_error_;
+
+  // Set when the scan was stopped by Close() or by an error.
+  bool cancelled_;
+
+  // UNORDERED mode: the batches returned by the tablet scans, and not yet
+  // handed out. Shut down once all tablet scans are done, or by Close().
+  gscoped_ptr<BlockingQueue<KuduScanBatch*>> batches_;
+
+  // UNORDERED mode: the batch whose rows were handed out by the last call
+  // to NextBatch(). Only accessed by the caller's thread.
+  std::unique_ptr<KuduScanBatch> current_batch_;
+
+  // UNORDERED mode: whether 'batches_' was drained after its shutdown.
+  bool batches_done_;
+
+  // ORDERED mode: the scan of each tablet.
+  std::vector<std::unique_ptr<MergeStream>> streams_;
+
+  // ORDERED mode: a min-heap, by next row key, of the streams with rows left
+  // in their current batch.
+  std::vector<MergeStream*> heap_;
+
+  // ORDERED mode: the streams whose current batch was consumed, and which
+  // must fetch their next batch before merging resumes. The rows of their
+  // current batch may be referenced by the last rows handed out.
+  std::vector<MergeStream*> exhausted_;
+
+  // ORDERED mode: the projection of the tablet scans, and the indexes of
+  // the primary key columns in it.
+  const Schema* projection_;
+  std::vector<int> key_column_indexes_;
+
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,188 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/client/row_lookup-internal.h"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+
+#include "kudu/client/client-internal.h"
+#include "kudu/client/meta_cache.h"
+#include "kudu/client/scanner-internal.h"
+#include "kudu/common/partition.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tserver/tserver_service.proxy.h"
+#include "kudu/util/async_util.h"
+#include "kudu/util/countdown_latch.h"
+
+using std::map;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace client {
+
+using internal::RemoteTablet;
+using internal::RemoteTabletServer;
+
+namespace {
+
+// The most keys sent to a tablet in one request, which bounds the size of
+// the requests and of their responses.
+const int kMaxKeysPerRequest = 1000;
+
+// A request for the rows of some of the keys of one tablet.
+struct LookupRequest {
+  shared_ptr<tserver::TabletServerServiceProxy> proxy;
+  tserver::LookupRowsRequestPB req;
+  tserver::LookupRowsResponsePB resp;
+  rpc::RpcController controller;
+
+  // The indexes of the keys of 'req' in KuduRowLookup::Data::keys_.
+  vector<int> key_indexes;
+};
+
+} // anonymous namespace
+
+KuduRowLookup::Data::Data(KuduTable* table)
+    : table_(table),
+      configuration_(table) {
+}
+
+KuduRowLookup::Data::~Data() {
+  STLDeleteElements(&keys_);
+  STLDeleteElements(&batches_);
+}
+
+Status KuduRowLookup::Data::Run() {
+  KuduClient* client = table_->client();
+  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(configuration_.timeout());
+
+  STLDeleteElements(&batches_);
+  rows_.assign(keys_.size(), std::make_pair(-1, -1));
+
+  // Group the keys by tablet, like the Batcher does for writes.
+  map<string, vector<int>> keys_by_tablet;
+  map<string, scoped_refptr<RemoteTablet>> tablets;
+  for (int i = 0; i < keys_.size(); i++) {
+    string partition_key;
+    RETURN_NOT_OK(table_->partition_schema().EncodeKey(*keys_[i], &partition_key));
+    scoped_refptr<RemoteTablet> tablet;
+    Synchronizer sync;
+    client->data_->meta_cache_->LookupTabletByKey(table_, partition_key, deadline,
+                                                  &tablet, sync.AsStatusCallback());
+    Status s = sync.Wait();
+    if (s.IsNotFound()) {
+      // The key is in a non-covered range partition, so it has no row.
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    keys_by_tablet[tablet->tablet_id()].push_back(i);
+    tablets.insert(std::make_pair(tablet->tablet_id(), tablet));
+  }
+
+  google::protobuf::RepeatedPtrField<ColumnSchemaPB> projected_columns;
+  RETURN_NOT_OK(SchemaToColumnPBs(*configuration_.projection(), &projected_columns,
+                                  SCHEMA_PB_WITHOUT_STORAGE_ATTRIBUTES | SCHEMA_PB_WITHOUT_IDS));
+
+  vector<unique_ptr<LookupRequest>> requests;
+  for (const auto& entry : keys_by_tablet) {
+    const scoped_refptr<RemoteTablet>& tablet = FindOrDie(tablets, entry.first);
+    RemoteTabletServer* ts;
+    vector<RemoteTabletServer*> candidates;
+    RETURN_NOT_OK(client->data_->GetTabletServer(client, tablet, configuration_.selection(),
+                                                 set<string>(), &candidates, &ts));
+    const vector<int>& key_indexes = entry.second;
+    for (int start = 0; start < key_indexes.size(); start += kMaxKeysPerRequest) {
+      unique_ptr<LookupRequest> request(new LookupRequest);
+      request->proxy = ts->proxy();
+      request->req.set_tablet_id(entry.first);
+      *request->req.mutable_projected_columns() = projected_columns;
+      int end = std::min<int>(start + kMaxKeysPerRequest, key_indexes.size());
+      for (int j = start; j < end; j++) {
+        RETURN_NOT_OK(keys_[key_indexes[j]]->EncodeRowKey(
+            request->req.add_encoded_primary_keys()));
+        request->key_indexes.push_back(key_indexes[j]);
+      }
+      request->controller.set_deadline(deadline);
+      requests.emplace_back(std::move(request));
+    }
+  }
+
+  // Send all the requests at once, and wait for all of them.
+  CountDownLatch latch(requests.size());
+  for (const auto& request : requests) {
+    request->proxy->LookupRowsAsync(request->req, &request->resp, &request->controller,
+                                    boost::bind(&CountDownLatch::CountDown, &latch));
+  }
+  latch.Wait();
+
+  for (const auto& request : requests) {
+    RETURN_NOT_OK_PREPEND(request->controller.status(),
+                          Substitute("Lookup in tablet $0 failed", request->req.tablet_id()));
+    if (request->resp.has_error()) {
+      return StatusFromPB(request->resp.error().status()).CloneAndPrepend(
+          Substitute("Lookup in tablet $0 failed", request->req.tablet_id()));
+    }
+    if (PREDICT_FALSE(request->resp.found_size() != request->key_indexes.size())) {
+      return Status::Corruption(Substitute("Server sent $0 results for $1 keys",
+                                           request->resp.found_size(),
+                                           request->key_indexes.size()));
+    }
+    if (!request->resp.has_data()) {
+      // None of the rows exist.
+      continue;
+    }
+
+    gscoped_ptr<KuduScanBatch> batch(new KuduScanBatch);
+    RETURN_NOT_OK(batch->data_->Reset(&request->controller,
+                                      configuration_.projection(),
+                                      configuration_.client_projection(),
+                                      make_gscoped_ptr(request->resp.release_data())));
+    int batch_idx = batches_.size();
+    int num_rows = batch->NumRows();
+    batches_.push_back(batch.release());
+
+    int row_idx = 0;
+    for (int j = 0; j < request->key_indexes.size(); j++) {
+      if (request->resp.found(j)) {
+        rows_[request->key_indexes[j]] = std::make_pair(batch_idx, row_idx++);
+      }
+    }
+    if (PREDICT_FALSE(row_idx != num_rows)) {
+      return Status::Corruption(Substitute("Server sent $0 rows for $1 keys found",
+                                           num_rows, row_idx));
+    }
+  }
+  return Status::OK();
+}
+
+} // namespace client
+} // namespace kudu
@@ -0,0 +1,59 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/client/scan_configuration.h"
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+namespace client {
+
+class KuduRowLookup::Data {
+ public:
+  explicit Data(KuduTable* table);
+  ~Data();
+
+  // Sends the lookup requests for 'keys_' and collects their rows.
+  Status Run();
+
+  // The table to read. Not owned.
+  KuduTable* const table_;
+
+  // The projection, replica selection and timeout of the lookup.
+  ScanConfiguration configuration_;
+
+  // The keys to look up, in the order they were added. Owned.
+  std::vector<KuduPartialRow*> keys_;
+
+  // The batches holding the rows found, one per request. Owned.
+  std::vector<KuduScanBatch*> batches_;
+
+  // For each key, the index of the batch holding its row and the index of
+  // the row in that batch, or (-1, -1) if the row doesn't exist.
+  std::vector<std::pair<int, int>> rows_;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Data);
+};
+
+} // namespace client
+} // namespace kudu
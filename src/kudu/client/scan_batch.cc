@@ -54,6 +54,55 @@ const KuduSchema* KuduScanBatch::projection_schema() const {
   return data_->client_projection_;
 }
 
+Status KuduScanBatch::GetFixedLengthColumn(int idx, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnarAccess(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() == BINARY)) {
+    return Status::InvalidArgument("column is variable-length", col.name());
+  }
+  *data = data_->columns_[idx].data;
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const {
+  RETURN_NOT_OK(data_->CheckColumnarAccess(idx));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->physical_type() != BINARY)) {
+    return Status::InvalidArgument("column is fixed-length", col.name());
+  }
+  *offsets = data_->columns_[idx].data;
+  *data = data_->columns_[idx].varlen_data;
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetFixedLengthColumnOfCellSize(int idx, size_t cell_size,
+                                                     Slice* data) const {
+  RETURN_NOT_OK(GetFixedLengthColumn(idx, data));
+  const ColumnSchema& col = data_->projection_->column(idx);
+  if (PREDICT_FALSE(col.type_info()->size() != cell_size)) {
+    return Status::InvalidArgument(
+        Substitute("column has $0-byte cells, not $1-byte cells",
+                   col.type_info()->size(), cell_size),
+        col.name());
+  }
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetVariableLengthColumn(int idx, const uint32_t** offsets,
+                                              const uint8_t** data) const {
+  Slice offsets_slice, data_slice;
+  RETURN_NOT_OK(GetVariableLengthColumn(idx, &offsets_slice, &data_slice));
+  *offsets = reinterpret_cast<const uint32_t*>(offsets_slice.data());
+  *data = data_slice.data();
+  return Status::OK();
+}
+
+Status KuduScanBatch::GetNonNullBitmapForColumn(int idx, Slice* non_null_bitmap) const {
+  RETURN_NOT_OK(data_->CheckColumnarAccess(idx));
+  *non_null_bitmap = data_->columns_[idx].non_null_bitmap;
+  return Status::OK();
+}
+
 ////////////////////////////////////////////////////////////
 // KuduScanBatch::RowPtr
 ////////////////////////////////////////////////////////////
@@ -28,6 +28,7 @@
 
 #include "kudu/util/kudu_export.h"
 #include "kudu/util/slice.h"
+#include "kudu/util/status.h"
 
 namespace kudu {
 class Schema;
@@ -91,11 +92,64 @@ class KUDU_EXPORT KuduScanBatch {
   // All KuduScanBatch::RowPtr returned by this batch are guaranteed to have this schema.
   const KuduSchema* projection_schema() const;
 
+  // Columnar accessors, for batches fetched by a scanner configured with
+  // KuduScanner::COLUMNAR_LAYOUT. Such batches have no row-wise
+  // representation: Row(), begin() and end() must not be used on them.
+  //
+  // The returned Slices are only valid for as long as this KuduScanBatch.
+  // These return a bad Status if the batch is not columnar, if 'idx' is out
+  // of range, or if the column is of the wrong kind.
+
+  // Sets 'data' to the NumRows() cells of the fixed-width column 'idx',
+  // stored back to back in their in-memory representation. The contents of
+  // NULL cells are zeroed.
+  Status GetFixedLengthColumn(int idx, Slice* data) const WARN_UNUSED_RESULT;
+
+  // Sets 'offsets' and 'data' to the cells of the STRING or BINARY column
+  // 'idx'. 'offsets' holds NumRows() + 1 uint32_t values, and cell 'i'
+  // consists of the bytes of 'data' in [offsets[i], offsets[i + 1]).
+  // NULL cells are empty.
+  Status GetVariableLengthColumn(int idx, Slice* offsets, Slice* data) const WARN_UNUSED_RESULT;
+
+  // Sets 'non_null_bitmap' to a bitmap with one bit per row, which is set
+  // for each non-NULL cell of column 'idx'. Row 'i' is bit (i % 8) of byte
+  // (i / 8), counting from the least significant bit. The Slice is empty if
+  // the column is not nullable.
+  Status GetNonNullBitmapForColumn(int idx, Slice* non_null_bitmap) const WARN_UNUSED_RESULT;
+
+  // Typed variants of the columnar accessors above. They point straight into
+  // the RPC sidecars of the batch, so reading a cell is a plain array access,
+  // without any per-row type check or pointer fixup.
+  //
+  // 'T' must have the size of the in-memory representation of the column's
+  // type, e.g. int32_t for INT32 or int64_t for UNIXTIME_MICROS; this is
+  // checked once per call. As with the row-wise accessors, the cells are
+  // not guaranteed to be aligned for 'T'.
+  template<typename T>
+  Status GetFixedLengthColumn(int idx, const T** cells) const WARN_UNUSED_RESULT {
+    Slice data;
+    Status s = GetFixedLengthColumnOfCellSize(idx, sizeof(T), &data);
+    if (s.ok()) {
+      *cells = reinterpret_cast<const T*>(data.data());
+    }
+    return s;
+  }
+
+  // Sets 'offsets' to the NumRows() + 1 offsets of the STRING or BINARY
+  // column 'idx' into its contiguous cell data 'data'.
+  Status GetVariableLengthColumn(int idx, const uint32_t** offsets,
+                                 const uint8_t** data) const WARN_UNUSED_RESULT;
+
  private:
   class KUDU_NO_EXPORT Data;
+  friend class KuduRowLookup;
   friend class KuduScanner;
   friend class kudu::tools::TsAdminClient;
 
+  // Same as GetFixedLengthColumn(), but also checks that the cells of the
+  // column are 'cell_size' bytes.
+  Status GetFixedLengthColumnOfCellSize(int idx, size_t cell_size, Slice* data) const;
+
   Data* data_;
   DISALLOW_COPY_AND_ASSIGN(KuduScanBatch);
 };
@@ -43,6 +43,10 @@ ScanConfiguration::ScanConfiguration(KuduTable* table)
       is_fault_tolerant_(false),
       snapshot_timestamp_(kNoTimestamp),
       timeout_(MonoDelta::FromMilliseconds(KuduScanner::kScanTimeoutMillis)),
+      row_format_flags_(KuduScanner::NO_FLAGS),
+      count_only_(false),
+      prefetching_(false),
+      limit_(kNoLimit),
       arena_(1024, 1024 * 1024) {
 }
 
@@ -137,12 +141,39 @@ Status ScanConfiguration::SetCacheBlocks(bool cache_blocks) {
   return Status::OK();
 }
 
+Status ScanConfiguration::SetRowFormatFlags(uint64_t flags) {
+  if (flags & ~KuduScanner::COLUMNAR_LAYOUT) {
+    return Status::InvalidArgument(strings::Substitute("unknown row format flags: $0", flags));
+  }
+  row_format_flags_ = flags;
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetCountOnly() {
+  RETURN_NOT_OK(SetProjectedColumnIndexes(vector<int>()));
+  count_only_ = true;
+  return Status::OK();
+}
+
 Status ScanConfiguration::SetBatchSizeBytes(uint32_t batch_size) {
   has_batch_size_bytes_ = true;
   batch_size_bytes_ = batch_size;
   return Status::OK();
 }
 
+Status ScanConfiguration::SetPrefetching(bool prefetching) {
+  prefetching_ = prefetching;
+  return Status::OK();
+}
+
+Status ScanConfiguration::SetLimit(int64_t limit) {
+  if (limit < 0) {
+    return Status::InvalidArgument("limit must not be negative");
+  }
+  limit_ = limit;
+  return Status::OK();
+}
+
 Status ScanConfiguration::SetSelection(KuduClient::ReplicaSelection selection) {
   selection_ = selection;
   return Status::OK();
@@ -169,6 +200,16 @@ void ScanConfiguration::SetSnapshotRaw(uint64_t snapshot_timestamp) {
   snapshot_timestamp_ = snapshot_timestamp;
 }
 
+Status ScanConfiguration::SetMaxStalenessMillis(int max_staleness_ms) {
+  if (max_staleness_ms < 0) {
+    return Status::InvalidArgument(
+        strings::Substitute("max staleness must not be negative: $0", max_staleness_ms));
+  }
+  RETURN_NOT_OK(SetReadMode(KuduScanner::READ_AT_SNAPSHOT));
+  max_staleness_ = MonoDelta::FromMilliseconds(max_staleness_ms);
+  return Status::OK();
+}
+
 void ScanConfiguration::SetTimeoutMillis(int millis) {
   timeout_ = MonoDelta::FromMilliseconds(millis);
 }
@@ -38,6 +38,7 @@ class ScanConfiguration {
  public:
 
   static const int64_t kNoTimestamp = -1;
+  static const int64_t kNoLimit = -1;
   static const int kHtTimestampBitsToShift = 12;
 
   explicit ScanConfiguration(KuduTable* table);
@@ -65,8 +66,17 @@ class ScanConfiguration {
 
   Status SetCacheBlocks(bool cache_blocks);
 
+  Status SetRowFormatFlags(uint64_t flags);
+
+  // Only the number of matching rows is needed. Projects no columns.
+  Status SetCountOnly();
+
   Status SetBatchSizeBytes(uint32_t batch_size);
 
+  Status SetPrefetching(bool prefetching);
+
+  Status SetLimit(int64_t limit) WARN_UNUSED_RESULT;
+
   Status SetSelection(KuduClient::ReplicaSelection selection) WARN_UNUSED_RESULT;
 
   Status SetReadMode(KuduScanner::ReadMode read_mode) WARN_UNUSED_RESULT;
@@ -77,6 +87,8 @@ class ScanConfiguration {
 
   void SetSnapshotRaw(uint64_t snapshot_timestamp);
 
+  Status SetMaxStalenessMillis(int max_staleness_ms) WARN_UNUSED_RESULT;
+
   void SetTimeoutMillis(int millis);
 
   void OptimizeScanSpec();
@@ -128,10 +140,39 @@ class ScanConfiguration {
     return snapshot_timestamp_;
   }
 
+  bool has_max_staleness() const {
+    return max_staleness_.Initialized();
+  }
+
+  const MonoDelta& max_staleness() const {
+    return max_staleness_;
+  }
+
   const MonoDelta& timeout() const {
     return timeout_;
   }
 
+  uint64_t row_format_flags() const {
+    return row_format_flags_;
+  }
+
+  bool count_only() const {
+    return count_only_;
+  }
+
+  bool prefetching() const {
+    return prefetching_;
+  }
+
+  bool has_limit() const {
+    return limit_ != kNoLimit;
+  }
+
+  int64_t limit() const {
+    DCHECK(has_limit());
+    return limit_;
+  }
+
   Arena* arena() {
     return &arena_;
   }
@@ -161,8 +202,21 @@ class ScanConfiguration {
 
   int64_t snapshot_timestamp_;
 
+  // Uninitialized unless bounded-staleness reads were requested.
+  MonoDelta max_staleness_;
+
   MonoDelta timeout_;
 
+  // Bitfield of KuduScanner row format flags.
+  uint64_t row_format_flags_;
+
+  bool count_only_;
+
+  bool prefetching_;
+
+  // The maximum number of rows to return, or kNoLimit.
+  int64_t limit_;
+
   // Manages interior allocations for the scan spec and copied bounds.
   Arena arena_;
 
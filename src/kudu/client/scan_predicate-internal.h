@@ -17,6 +17,8 @@
 #ifndef KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 #define KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H
 
+#include <vector>
+
 #include "kudu/client/scan_predicate.h"
 #include "kudu/client/value.h"
 #include "kudu/client/value-internal.h"
@@ -88,6 +90,40 @@ class ComparisonPredicateData : public KuduPredicate::Data {
   gscoped_ptr<KuduValue> val_;
 };
 
+// A predicate which matches the rows where the column value is one of a list
+// of constants.
+class InListPredicateData : public KuduPredicate::Data {
+ public:
+  // Takes ownership of the values, and clears 'values'.
+  InListPredicateData(ColumnSchema col, std::vector<KuduValue*>* values);
+  virtual ~InListPredicateData();
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  InListPredicateData* Clone() const override;
+
+ private:
+  ColumnSchema col_;
+  std::vector<KuduValue*> vals_;
+};
+
+// A predicate which matches the rows where the column value is null.
+class IsNullPredicateData : public KuduPredicate::Data {
+ public:
+  explicit IsNullPredicateData(ColumnSchema col)
+      : col_(std::move(col)) {
+  }
+
+  Status AddToScanSpec(ScanSpec* spec, Arena* arena) override;
+
+  IsNullPredicateData* Clone() const override {
+    return new IsNullPredicateData(col_);
+  }
+
+ private:
+  ColumnSchema col_;
+};
+
 } // namespace client
 } // namespace kudu
 #endif /* KUDU_CLIENT_SCAN_PREDICATE_INTERNAL_H */
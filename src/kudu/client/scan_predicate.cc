@@ -24,9 +24,11 @@
 #include "kudu/client/value-internal.h"
 #include "kudu/client/value.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 
 using std::move;
+using std::vector;
 using boost::optional;
 
 namespace kudu {
@@ -104,5 +106,43 @@ Status ComparisonPredicateData::AddToScanSpec(ScanSpec* spec, Arena* arena) {
   return Status::OK();
 }
 
+InListPredicateData::InListPredicateData(ColumnSchema col,
+                                         vector<KuduValue*>* values)
+    : col_(move(col)) {
+  vals_.swap(*values);
+}
+
+InListPredicateData::~InListPredicateData() {
+  STLDeleteElements(&vals_);
+}
+
+InListPredicateData* InListPredicateData::Clone() const {
+  vector<KuduValue*> values;
+  values.reserve(vals_.size());
+  for (KuduValue* val : vals_) {
+    values.push_back(val->Clone());
+  }
+  return new InListPredicateData(col_, &values);
+}
+
+Status InListPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
+  vector<const void*> vals_list;
+  vals_list.reserve(vals_.size());
+  for (KuduValue* val : vals_) {
+    void* val_void;
+    RETURN_NOT_OK(val->data_->CheckTypeAndGetPointer(col_.name(),
+                                                     col_.type_info()->physical_type(),
+                                                     &val_void));
+    vals_list.push_back(val_void);
+  }
+  spec->AddPredicate(ColumnPredicate::InList(col_, &vals_list));
+  return Status::OK();
+}
+
+Status IsNullPredicateData::AddToScanSpec(ScanSpec* spec, Arena* /*arena*/) {
+  spec->AddPredicate(ColumnPredicate::IsNull(col_));
+  return Status::OK();
+}
+
 } // namespace client
 } // namespace kudu
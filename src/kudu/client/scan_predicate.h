@@ -51,6 +51,8 @@ class KUDU_EXPORT KuduPredicate {
  private:
   friend class ComparisonPredicateData;
   friend class ErrorPredicateData;
+  friend class InListPredicateData;
+  friend class IsNullPredicateData;
   friend class KuduTable;
   friend class ScanConfiguration;
 
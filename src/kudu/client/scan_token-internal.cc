@@ -18,6 +18,7 @@
 #include "kudu/client/scan_token-internal.h"
 
 #include <boost/optional.hpp>
+#include <set>
 #include <vector>
 #include <string>
 #include <memory>
@@ -29,9 +30,12 @@
 #include "kudu/client/tablet_server-internal.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/status.h"
 
+using std::set;
 using std::string;
 using std::unique_ptr;
 using std::vector;
@@ -127,7 +131,7 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
   }
 
   if (message.has_limit()) {
-    // TODO(KUDU-16)
+    RETURN_NOT_OK(scan_builder->SetLimit(message.limit()));
   }
 
   if (message.has_read_mode()) {
@@ -163,7 +167,41 @@ Status KuduScanToken::Data::PBIntoScanner(KuduClient* client,
 }
 
 KuduScanTokenBuilder::Data::Data(KuduTable* table)
-    : configuration_(table) {
+    : configuration_(table),
+      split_size_bytes_(0) {
+}
+
+Status KuduScanTokenBuilder::Data::SplitKeyRange(
+    const scoped_refptr<internal::RemoteTablet>& tablet,
+    const string& start_key,
+    const string& stop_key,
+    const MonoTime& deadline,
+    vector<string>* split_keys) {
+  KuduClient* client = configuration_.table_->client();
+  internal::RemoteTabletServer* ts;
+  vector<internal::RemoteTabletServer*> candidates;
+  RETURN_NOT_OK(client->data_->GetTabletServer(client, tablet, configuration_.selection(),
+                                               set<string>(), &candidates, &ts));
+
+  tserver::SplitKeyRangeRequestPB req;
+  req.set_tablet_id(tablet->tablet_id());
+  if (!start_key.empty()) {
+    req.set_start_primary_key(start_key);
+  }
+  if (!stop_key.empty()) {
+    req.set_stop_primary_key(stop_key);
+  }
+  req.set_target_chunk_size_bytes(split_size_bytes_);
+
+  tserver::SplitKeyRangeResponsePB resp;
+  rpc::RpcController controller;
+  controller.set_deadline(deadline);
+  RETURN_NOT_OK(ts->proxy()->SplitKeyRange(req, &resp, &controller));
+  if (resp.has_error()) {
+    return StatusFromPB(resp.error().status());
+  }
+  split_keys->assign(resp.split_primary_keys().begin(), resp.split_primary_keys().end());
+  return Status::OK();
 }
 
 Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
@@ -209,6 +247,9 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
 
   pb.set_cache_blocks(configuration_.spec().cache_blocks());
   pb.set_fault_tolerant(configuration_.is_fault_tolerant());
+  if (configuration_.has_limit()) {
+    pb.set_limit(configuration_.limit());
+  }
 
   MonoTime deadline = MonoTime::Now(MonoTime::FINE);
   deadline.AddDelta(client->default_admin_operation_timeout());
@@ -244,13 +285,43 @@ Status KuduScanTokenBuilder::Data::Build(vector<KuduScanToken*>* tokens) {
                                                         host_ports[0].host());
       tablet_servers.push_back(tablet_server);
     }
-    ScanTokenPB message;
-    message.CopyFrom(pb);
-    message.set_lower_bound_partition_key(tablet->partition().partition_key_start());
-    message.set_upper_bound_partition_key(tablet->partition().partition_key_end());
-    tokens->push_back(new KuduScanToken(new KuduScanToken::Data(table,
-                                                                std::move(message),
-                                                                std::move(tablet_servers))));
+
+    vector<string> split_keys;
+    if (split_size_bytes_ > 0) {
+      Status s = SplitKeyRange(tablet, pb.lower_bound_primary_key(),
+                               pb.upper_bound_primary_key(), deadline, &split_keys);
+      if (!s.ok()) {
+        // Splitting is only an optimization: scan the tablet with one token.
+        LOG(WARNING) << "Unable to split the key range of tablet " << tablet->tablet_id()
+                     << ": " << s.ToString();
+        split_keys.clear();
+      }
+    }
+
+    // The tokens of a tablet scan consecutive primary key ranges, bounded by
+    // the split keys and the scan's own bounds.
+    for (int i = 0; i <= split_keys.size(); i++) {
+      ScanTokenPB message;
+      message.CopyFrom(pb);
+      message.set_lower_bound_partition_key(tablet->partition().partition_key_start());
+      message.set_upper_bound_partition_key(tablet->partition().partition_key_end());
+      if (i > 0) {
+        message.set_lower_bound_primary_key(split_keys[i - 1]);
+      }
+      if (i < split_keys.size()) {
+        message.set_upper_bound_primary_key(split_keys[i]);
+      }
+
+      vector<KuduTabletServer*> token_servers;
+      for (const KuduTabletServer* ts : tablet_servers) {
+        KuduTabletServer* copy = new KuduTabletServer;
+        copy->data_ = new KuduTabletServer::Data(ts->uuid(), ts->hostname());
+        token_servers.push_back(copy);
+      }
+      tokens->push_back(new KuduScanToken(new KuduScanToken::Data(table,
+                                                                  std::move(message),
+                                                                  std::move(token_servers))));
+    }
     pruner.RemovePartitionKeyRange(tablet->partition().partition_key_end());
   }
   return Status::OK();
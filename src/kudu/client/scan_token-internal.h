@@ -23,10 +23,15 @@
 #include "kudu/client/client.h"
 #include "kudu/client/client.pb.h"
 #include "kudu/client/scan_configuration.h"
+#include "kudu/gutil/ref_counted.h"
 
 namespace kudu {
 namespace client {
 
+namespace internal {
+class RemoteTablet;
+} // namespace internal
+
 class KuduScanToken::Data {
  public:
   explicit Data(KuduTable* table,
@@ -72,8 +77,24 @@ class KuduScanTokenBuilder::Data {
     return &configuration_;
   }
 
+  void SetSplitSizeBytes(uint64_t split_size_bytes) {
+    split_size_bytes_ = split_size_bytes;
+  }
+
  private:
+  // Asks a tablet server hosting 'tablet' for the encoded primary keys which
+  // split [start_key, stop_key) into chunks of about 'split_size_bytes_'.
+  // An empty bound leaves that end of the range unbounded.
+  Status SplitKeyRange(const scoped_refptr<internal::RemoteTablet>& tablet,
+                       const std::string& start_key,
+                       const std::string& stop_key,
+                       const MonoTime& deadline,
+                       std::vector<std::string>* split_keys);
+
   ScanConfiguration configuration_;
+
+  // The target amount of data per token, or 0 for one token per tablet.
+  uint64_t split_size_bytes_;
 };
 
 } // namespace client
@@ -24,8 +24,14 @@
 #include "kudu/client/client.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/integration-tests/mini_cluster.h"
+#include "kudu/tablet/tablet_peer.h"
+#include "kudu/tserver/mini_tablet_server.h"
+#include "kudu/tserver/tablet_server.h"
+#include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(cfile_default_block_size);
+
 using std::atomic;
 using std::string;
 using std::thread;
@@ -194,5 +200,207 @@ TEST_F(ScanTokenTest, TestScanTokens) {
   }
 }
 
+TEST_F(ScanTokenTest, TestSplitScanTokens) {
+  // Small blocks give the key indexes many entries to split at.
+  FLAGS_cfile_default_block_size = 1024;
+
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("col")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // Create a table with one small and one large tablet.
+  const int kNumRows = 10000;
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<KuduPartialRow> split(schema.NewRow());
+    ASSERT_OK(split->SetInt64("col", kNumRows / 10));
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .split_rows({ split.release() })
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  shared_ptr<KuduSession> session = CreateSession();
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("col", i));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  // Only flushed data can be split.
+  vector<scoped_refptr<tablet::TabletPeer>> peers;
+  cluster_->mini_tablet_server(0)->server()->tablet_manager()->GetTabletPeers(&peers);
+  for (const scoped_refptr<tablet::TabletPeer>& peer : peers) {
+    ASSERT_OK(peer->tablet()->Flush());
+  }
+
+  { // a split size larger than any tablet
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(1ULL << 40));
+    ASSERT_OK(builder.Build(&tokens));
+
+    ASSERT_EQ(2, tokens.size());
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+  }
+
+  { // tablets split into several tokens each
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetSplitSizeBytes(256));
+    ASSERT_OK(builder.Build(&tokens));
+
+    ASSERT_GT(tokens.size(), 4);
+    ASSERT_EQ(kNumRows, CountRows(tokens));
+  }
+
+  { // primary key bound
+    vector<KuduScanToken*> tokens;
+    ElementDeleter deleter(&tokens);
+    KuduScanTokenBuilder builder(table.get());
+    unique_ptr<KuduPartialRow> lower_bound(schema.NewRow());
+    ASSERT_OK(lower_bound->SetInt64("col", kNumRows / 2));
+    ASSERT_OK(builder.AddLowerBound(*lower_bound));
+    ASSERT_OK(builder.SetSplitSizeBytes(256));
+    ASSERT_OK(builder.Build(&tokens));
+
+    ASSERT_GT(tokens.size(), 2);
+    ASSERT_EQ(kNumRows / 2, CountRows(tokens));
+  }
+}
+
+TEST_F(ScanTokenTest, TestParallelScanner) {
+  // Create schema
+  KuduSchema schema;
+  {
+    KuduSchemaBuilder builder;
+    builder.AddColumn("key")->NotNull()->Type(KuduColumnSchema::INT64)->PrimaryKey();
+    builder.AddColumn("val")->NotNull()->Type(KuduColumnSchema::INT64);
+    ASSERT_OK(builder.Build(&schema));
+  }
+
+  // Create a table whose hash partitions interleave their keys.
+  shared_ptr<KuduTable> table;
+  {
+    unique_ptr<client::KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name("table")
+                            .schema(&schema)
+                            .add_hash_partitions({ "key" }, 8)
+                            .num_replicas(1)
+                            .Create());
+    ASSERT_OK(client_->OpenTable("table", &table));
+  }
+
+  const int kNumRows = 2000;
+  shared_ptr<KuduSession> session = CreateSession();
+  for (int i = 0; i < kNumRows; i++) {
+    unique_ptr<KuduInsert> insert(table->NewInsert());
+    ASSERT_OK(insert->mutable_row()->SetInt64("key", i));
+    ASSERT_OK(insert->mutable_row()->SetInt64("val", i * 2));
+    ASSERT_OK(session->Apply(insert.release()));
+  }
+  ASSERT_OK(session->Flush());
+
+  for (KuduScanner::OrderMode mode : { KuduScanner::UNORDERED, KuduScanner::ORDERED }) {
+    SCOPED_TRACE(mode);
+    KuduScanTokenBuilder builder(table.get());
+    // Use small batches so that each tablet is read in many batches.
+    ASSERT_OK(builder.SetBatchSizeBytes(64));
+    KuduParallelScanner scanner(&builder);
+    ASSERT_OK(scanner.SetOrderMode(mode));
+    ASSERT_OK(scanner.SetMaxConcurrentScanners(3));
+    ASSERT_OK(scanner.SetMaxConcurrentScannersPerServer(1));
+    ASSERT_TRUE(scanner.SetMaxConcurrentScanners(0).IsInvalidArgument());
+    ASSERT_OK(scanner.Open());
+
+    vector<bool> seen(kNumRows);
+    int64_t prev_key = -1;
+    int num_rows = 0;
+    vector<KuduScanBatch::RowPtr> rows;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&rows));
+      for (const KuduScanBatch::RowPtr& row : rows) {
+        int64_t key, val;
+        ASSERT_OK(row.GetInt64(0, &key));
+        ASSERT_OK(row.GetInt64(1, &val));
+        ASSERT_EQ(key * 2, val);
+        ASSERT_FALSE(seen[key]);
+        seen[key] = true;
+        if (mode == KuduScanner::ORDERED) {
+          ASSERT_GT(key, prev_key);
+        }
+        prev_key = key;
+        num_rows++;
+      }
+    }
+    ASSERT_EQ(kNumRows, num_rows);
+  }
+
+  { // predicate, and closing the scanner mid-scan
+    KuduScanTokenBuilder builder(table.get());
+    unique_ptr<KuduPredicate> predicate(table->NewComparisonPredicate("key",
+                                                                      KuduPredicate::LESS,
+                                                                      KuduValue::FromInt(1000)));
+    ASSERT_OK(builder.AddConjunctPredicate(predicate.release()));
+    ASSERT_OK(builder.SetBatchSizeBytes(64));
+    KuduParallelScanner scanner(&builder);
+    ASSERT_OK(scanner.Open());
+    vector<KuduScanBatch::RowPtr> rows;
+    int num_rows = 0;
+    while (scanner.HasMoreRows() && num_rows == 0) {
+      ASSERT_OK(scanner.NextBatch(&rows));
+      num_rows += rows.size();
+    }
+    ASSERT_GT(num_rows, 0);
+    ASSERT_LT(num_rows, 1000);
+    scanner.Close();
+  }
+
+  // a row limit spans all tablets
+  for (KuduScanner::OrderMode mode : { KuduScanner::UNORDERED, KuduScanner::ORDERED }) {
+    SCOPED_TRACE(mode);
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetLimit(100));
+    ASSERT_OK(builder.SetBatchSizeBytes(64));
+    KuduParallelScanner scanner(&builder);
+    ASSERT_OK(scanner.SetOrderMode(mode));
+    ASSERT_OK(scanner.Open());
+    vector<KuduScanBatch::RowPtr> rows;
+    int64_t prev_key = -1;
+    int num_rows = 0;
+    while (scanner.HasMoreRows()) {
+      ASSERT_OK(scanner.NextBatch(&rows));
+      for (const KuduScanBatch::RowPtr& row : rows) {
+        int64_t key;
+        ASSERT_OK(row.GetInt64(0, &key));
+        if (mode == KuduScanner::ORDERED) {
+          // An ordered scan returns the smallest keys.
+          ASSERT_EQ(prev_key + 1, key);
+        }
+        prev_key = key;
+        num_rows++;
+      }
+    }
+    ASSERT_EQ(100, num_rows);
+  }
+
+  { // an ordered scan must project the primary key
+    KuduScanTokenBuilder builder(table.get());
+    ASSERT_OK(builder.SetProjectedColumnNames({ "val" }));
+    KuduParallelScanner scanner(&builder);
+    ASSERT_OK(scanner.SetOrderMode(KuduScanner::ORDERED));
+    ASSERT_TRUE(scanner.Open().IsInvalidArgument());
+  }
+}
+
 } // namespace client
 } // namespace kudu
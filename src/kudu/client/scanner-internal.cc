@@ -31,6 +31,8 @@
 #include "kudu/common/wire_protocol.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/rpc_controller.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/hexdump.h"
 
 using google::protobuf::FieldDescriptor;
@@ -45,6 +47,7 @@ using rpc::RpcController;
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 using tserver::NewScanRequestPB;
+using tserver::ScanResponsePB;
 using tserver::TabletServerFeatures;
 
 namespace client {
@@ -56,11 +59,15 @@ KuduScanner::Data::Data(KuduTable* table)
     open_(false),
     data_in_open_(false),
     short_circuit_(false),
+    num_rows_returned_(0),
+    prefetch_in_flight_(false),
+    prefetch_latch_(0),
     table_(DCHECK_NOTNULL(table)->shared_from_this()),
     scan_attempts_(0) {
 }
 
 KuduScanner::Data::~Data() {
+  DiscardPrefetch();
 }
 
 Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
@@ -94,6 +101,7 @@ Status KuduScanner::Data::HandleError(const ScanRpcStatus& err,
     case ScanRpcStatus::SCANNER_EXPIRED:
       break;
     case ScanRpcStatus::TABLET_NOT_RUNNING:
+    case ScanRpcStatus::REPLICA_TOO_STALE:
       blacklist_location = true;
       break;
     case ScanRpcStatus::TABLET_NOT_FOUND:
@@ -203,6 +211,8 @@ ScanRpcStatus KuduScanner::Data::AnalyzeResponse(const Status& rpc_status,
       return ScanRpcStatus{ScanRpcStatus::TABLET_NOT_RUNNING, server_status};
     case tserver::TabletServerErrorPB::TABLET_NOT_FOUND:
       return ScanRpcStatus{ScanRpcStatus::TABLET_NOT_FOUND, server_status};
+    case tserver::TabletServerErrorPB::REPLICA_TOO_STALE:
+      return ScanRpcStatus{ScanRpcStatus::REPLICA_TOO_STALE, server_status};
     default:
       return ScanRpcStatus{ScanRpcStatus::OTHER_TS_ERROR, server_status};
   }
@@ -222,27 +232,25 @@ Status KuduScanner::Data::ReopenCurrentTablet(const MonoTime& deadline,
                     blacklist);
 }
 
-ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
-                                             bool allow_time_for_failover) {
+MonoTime KuduScanner::Data::ComputeRpcDeadline(const MonoTime& overall_deadline,
+                                               bool allow_time_for_failover) const {
   // The user has specified a timeout which should apply to the total time for each call
   // to NextBatch(). However, for fault-tolerant scans, or for when we are first opening
   // a scanner, it's preferable to set a shorter timeout (the "default RPC timeout") for
   // each individual RPC call. This gives us time to fail over to a different server
   // if the first server we try happens to be hung.
-  MonoTime rpc_deadline;
-  if (allow_time_for_failover) {
-    rpc_deadline = MonoTime::Now(MonoTime::FINE);
-    rpc_deadline.AddDelta(table_->client()->default_rpc_timeout());
-    rpc_deadline = MonoTime::Earliest(overall_deadline, rpc_deadline);
-  } else {
-    rpc_deadline = overall_deadline;
+  if (!allow_time_for_failover) {
+    return overall_deadline;
   }
+  MonoTime rpc_deadline = MonoTime::Now(MonoTime::FINE);
+  rpc_deadline.AddDelta(table_->client()->default_rpc_timeout());
+  return MonoTime::Earliest(overall_deadline, rpc_deadline);
+}
 
-  controller_.Reset();
-  controller_.set_deadline(rpc_deadline);
-  if (!configuration_.spec().predicates().empty()) {
-    controller_.RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
-  }
+ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
+                                             bool allow_time_for_failover) {
+  MonoTime rpc_deadline = ComputeRpcDeadline(overall_deadline, allow_time_for_failover);
+  PrepareController(&controller_, rpc_deadline);
   ScanRpcStatus scan_status = AnalyzeResponse(
       proxy_->Scan(next_req_,
                    &last_response_,
@@ -254,6 +262,127 @@ ScanRpcStatus KuduScanner::Data::SendScanRpc(const MonoTime& overall_deadline,
   return scan_status;
 }
 
+void KuduScanner::Data::SendScanRpcAsync(const MonoTime& overall_deadline,
+                                         bool allow_time_for_failover,
+                                         const rpc::ResponseCallback& callback) {
+  async_rpc_deadline_ = ComputeRpcDeadline(overall_deadline, allow_time_for_failover);
+  PrepareController(&controller_, async_rpc_deadline_);
+  proxy_->ScanAsync(next_req_, &last_response_, &controller_, callback);
+}
+
+ScanRpcStatus KuduScanner::Data::FinishScanRpcAsync(const MonoTime& overall_deadline) {
+  ScanRpcStatus scan_status = AnalyzeResponse(controller_.status(),
+                                              async_rpc_deadline_, overall_deadline);
+  if (scan_status.result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+  return scan_status;
+}
+
+Status KuduScanner::Data::FinishContinueScan(const MonoTime& deadline,
+                                             ScanRpcStatus result,
+                                             bool* batch_ready) {
+  bool allow_time_for_failover = configuration_.is_fault_tolerant();
+  while (true) {
+    // Success case.
+    if (result.result == ScanRpcStatus::OK) {
+      if (last_response_.has_last_primary_key()) {
+        last_primary_key_ = last_response_.last_primary_key();
+      }
+      scan_attempts_ = 0;
+      *batch_ready = true;
+      return Status::OK();
+    }
+
+    scan_attempts_++;
+
+    // Error handling.
+    LOG(WARNING) << "Scan at tablet server " << ts_->ToString() << " of tablet "
+                 << remote_->tablet_id() << " failed: " << result.status.ToString();
+
+    set<string> blacklist;
+    RETURN_NOT_OK(HandleError(result, deadline, &blacklist));
+
+    if (configuration_.is_fault_tolerant()) {
+      LOG(WARNING) << "Attempting to retry scan of tablet " << remote_->tablet_id()
+                   << " elsewhere.";
+      *batch_ready = false;
+      return ReopenCurrentTablet(deadline, &blacklist);
+    }
+
+    if (blacklist.empty()) {
+      // If we didn't blacklist the current server, we can just retry again.
+      result = SendScanRpc(deadline, allow_time_for_failover);
+      continue;
+    }
+    // If we blacklisted the current server, and it's not fault-tolerant, we can't
+    // retry anywhere, so just propagate the error.
+    return result.status;
+  }
+}
+
+void KuduScanner::Data::PrepareController(RpcController* controller,
+                                          const MonoTime& rpc_deadline) {
+  controller->Reset();
+  controller->set_deadline(rpc_deadline);
+  if (!configuration_.spec().predicates().empty()) {
+    controller->RequireServerFeature(TabletServerFeatures::COLUMN_PREDICATES);
+  }
+  if (configuration_.row_format_flags() & KuduScanner::COLUMNAR_LAYOUT) {
+    controller->RequireServerFeature(TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE);
+  }
+}
+
+void KuduScanner::Data::StartPrefetch() {
+  DCHECK(!prefetch_in_flight_);
+  if (!configuration_.prefetching() || !last_response_.has_more_results()) {
+    return;
+  }
+
+  // Only one request is kept in flight: the tablet server expects a
+  // scanner's requests in call sequence order, and one outstanding batch
+  // is enough to hide the round trip while bounding the buffered data.
+  PrepareRequest(KuduScanner::Data::CONTINUE);
+  prefetch_deadline_ = MonoTime::Now(MonoTime::FINE);
+  prefetch_deadline_.AddDelta(configuration_.timeout());
+  PrepareController(&prefetch_controller_, prefetch_deadline_);
+  prefetch_response_.Clear();
+  prefetch_latch_.Reset(1);
+  prefetch_in_flight_ = true;
+  proxy_->ScanAsync(next_req_, &prefetch_response_, &prefetch_controller_,
+                    boost::bind(&CountDownLatch::CountDown, &prefetch_latch_));
+}
+
+bool KuduScanner::Data::FinishPrefetch(const MonoTime& overall_deadline,
+                                       ScanRpcStatus* result) {
+  if (!prefetch_in_flight_) {
+    return false;
+  }
+  prefetch_latch_.Wait();
+  prefetch_in_flight_ = false;
+
+  last_response_.Swap(&prefetch_response_);
+  controller_.Swap(&prefetch_controller_);
+
+  // A prefetch which timed out before the batch's own deadline is retried
+  // like any other RPC which exceeded its deadline.
+  *result = AnalyzeResponse(controller_.status(), overall_deadline, prefetch_deadline_);
+  if (result->result == ScanRpcStatus::OK) {
+    UpdateResourceMetrics();
+  }
+  return true;
+}
+
+void KuduScanner::Data::DiscardPrefetch() {
+  if (!prefetch_in_flight_) {
+    return;
+  }
+  prefetch_latch_.Wait();
+  prefetch_in_flight_ = false;
+  prefetch_response_.Clear();
+  prefetch_controller_.Reset();
+}
+
 Status KuduScanner::Data::OpenTablet(const string& partition_key,
                                      const MonoTime& deadline,
                                      set<string>* blacklist) {
@@ -280,6 +409,15 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   }
 
   scan->set_cache_blocks(configuration_.spec().cache_blocks());
+  scan->set_row_format_flags(configuration_.row_format_flags());
+  scan->set_count_only(configuration_.count_only());
+  if (configuration_.has_limit()) {
+    // The tablet server closes the scanner once the rest of the limit is
+    // reached.
+    scan->set_limit(configuration_.limit() - num_rows_returned_);
+  } else {
+    scan->clear_limit();
+  }
 
   if (configuration_.snapshot_timestamp() != ScanConfiguration::kNoTimestamp) {
     if (PREDICT_FALSE(configuration_.read_mode() != READ_AT_SNAPSHOT)) {
@@ -288,6 +426,14 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     } else {
       scan->set_snap_timestamp(configuration_.snapshot_timestamp());
     }
+  } else if (configuration_.has_max_staleness()) {
+    scan->set_max_staleness_us(configuration_.max_staleness().ToMicroseconds());
+    // Have followers reject the scan unless they have caught up with what this
+    // client has already observed, for read-your-writes.
+    uint64_t observed = table_->client()->data_->GetLatestObservedTimestamp();
+    if (observed != KuduClient::kNoTimestamp) {
+      scan->set_propagated_timestamp(observed);
+    }
   }
 
   // Set up the predicates.
@@ -324,6 +470,7 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     if (s.IsNotFound()) {
       // No more tablets in the table.
       partition_pruner_.RemovePartitionKeyRange("");
+      CountPrunedTablets("");
       return Status::OK();
     } else {
       RETURN_NOT_OK(s);
@@ -332,9 +479,19 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
     // Check if the meta cache returned a tablet covering a partition key range past
     // what we asked for. This can happen if the requested partition key falls
     // in a non-covered range. In this case we can potentially prune the tablet.
-    if (partition_key < remote_->partition().partition_key_start() &&
+    const string& tablet_start = remote_->partition().partition_key_start();
+    const string& tablet_end = remote_->partition().partition_key_end();
+    if (unvisited_partition_key_ < tablet_start) {
+      // The partition pruner skipped the tablets in between.
+      CountPrunedTablets(tablet_start);
+    }
+    if (partition_key < tablet_start &&
         partition_pruner_.ShouldPrune(remote_->partition())) {
-      partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
+      partition_pruner_.RemovePartitionKeyRange(tablet_end);
+      CountPrunedTablets(tablet_end);
+      if (!tablet_end.empty() && !partition_pruner_.HasMorePartitionKeyRanges()) {
+        CountPrunedTablets("");
+      }
       return Status::OK();
     }
 
@@ -385,14 +542,20 @@ Status KuduScanner::Data::OpenTablet(const string& partition_key,
   }
 
   partition_pruner_.RemovePartitionKeyRange(remote_->partition().partition_key_end());
+  if (unvisited_partition_key_ < remote_->partition().partition_key_end()) {
+    unvisited_partition_key_ = remote_->partition().partition_key_end();
+  }
+  if (!unvisited_partition_key_.empty() && !partition_pruner_.HasMorePartitionKeyRanges()) {
+    CountPrunedTablets("");
+  }
 
   next_req_.clear_new_scan_request();
-  data_in_open_ = last_response_.has_data();
+  data_in_open_ = last_response_.has_data() || last_response_.has_columnar_data();
   if (last_response_.has_more_results()) {
     next_req_.set_scanner_id(last_response_.scanner_id());
     VLOG(1) << "Opened tablet " << remote_->tablet_id()
             << ", scanner ID " << last_response_.scanner_id();
-  } else if (last_response_.has_data()) {
+  } else if (data_in_open_) {
     VLOG(1) << "Opened tablet " << remote_->tablet_id() << ", no scanner ID assigned";
   } else {
     VLOG(1) << "Opened tablet " << remote_->tablet_id() << " (no rows), no scanner ID assigned";
@@ -436,6 +599,17 @@ Status KuduScanner::Data::KeepAlive() {
   return Status::OK();
 }
 
+void KuduScanner::Data::CountPrunedTablets(const string& upper) {
+  const string& end = upper.empty() ?
+      configuration_.spec().exclusive_upper_bound_partition_key() : upper;
+  int num_pruned = table_->client()->data_->meta_cache_->CountCachedTablets(
+      table_.get(), unvisited_partition_key_, end);
+  if (num_pruned > 0) {
+    resource_metrics_.Increment("tablets_pruned", num_pruned);
+  }
+  unvisited_partition_key_ = upper;
+}
+
 bool KuduScanner::Data::MoreTablets() const {
   CHECK(open_);
   // TODO(KUDU-565): add a test which has a scan end on a tablet boundary
@@ -468,7 +642,7 @@ void KuduScanner::Data::UpdateLastError(const Status& error) {
 // KuduScanBatch
 ////////////////////////////////////////////////////////////
 
-KuduScanBatch::Data::Data() : projection_(NULL) {}
+KuduScanBatch::Data::Data() : projection_(NULL), columnar_(false) {}
 
 KuduScanBatch::Data::~Data() {}
 
@@ -485,6 +659,7 @@ Status KuduScanBatch::Data::Reset(RpcController* controller,
   controller_.Swap(controller);
   projection_ = projection;
   client_projection_ = client_projection;
+  columnar_ = false;
   resp_data_.Swap(data.get());
 
   // First, rewrite the relative addresses into absolute ones.
@@ -512,6 +687,111 @@ Status KuduScanBatch::Data::Reset(RpcController* controller,
   return Status::OK();
 }
 
+Status KuduScanBatch::Data::Reset(RpcController* controller,
+                                  const Schema* projection,
+                                  const KuduSchema* client_projection,
+                                  gscoped_ptr<ColumnarRowBlockPB> data) {
+  CHECK(controller->finished());
+  controller_.Swap(controller);
+  projection_ = projection;
+  client_projection_ = client_projection;
+  columnar_ = true;
+  columnar_data_.Swap(data.get());
+
+  int64_t num_rows = columnar_data_.num_rows();
+  if (PREDICT_FALSE(columnar_data_.columns_size() != projection_->num_columns())) {
+    return Status::Corruption(Substitute(
+        "Server sent invalid response: $0 columns for a projection of $1",
+        columnar_data_.columns_size(), projection_->num_columns()));
+  }
+
+  columns_.resize(projection_->num_columns());
+  for (int i = 0; i < projection_->num_columns(); i++) {
+    const ColumnSchema& col = projection_->column(i);
+    const ColumnarRowBlockPB::Column& col_pb = columnar_data_.columns(i);
+    ColumnSlices* slices = &columns_[i];
+    *slices = ColumnSlices();
+
+    if (PREDICT_FALSE(!col_pb.has_data_sidecar())) {
+      return Status::Corruption("Server sent invalid response: no data for column",
+                                col.name());
+    }
+    Status s = controller_.GetSidecar(col_pb.data_sidecar(), &slices->data);
+    if (!s.ok()) {
+      return Status::Corruption("Server sent invalid response: column data "
+                                "sidecar index corrupt", s.ToString());
+    }
+    if (col_pb.has_varlen_data_sidecar()) {
+      s = controller_.GetSidecar(col_pb.varlen_data_sidecar(), &slices->varlen_data);
+      if (!s.ok()) {
+        return Status::Corruption("Server sent invalid response: column varlen data "
+                                  "sidecar index corrupt", s.ToString());
+      }
+    }
+    if (col_pb.has_non_null_bitmap_sidecar()) {
+      s = controller_.GetSidecar(col_pb.non_null_bitmap_sidecar(), &slices->non_null_bitmap);
+      if (!s.ok()) {
+        return Status::Corruption("Server sent invalid response: column non-null bitmap "
+                                  "sidecar index corrupt", s.ToString());
+      }
+    }
+
+    // Validate the buffer sizes so that the accessors can be used without
+    // further bounds checks.
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+    size_t expected_size = is_varlen ? (num_rows + 1) * sizeof(uint32_t)
+                                     : num_rows * col.type_info()->size();
+    if (PREDICT_FALSE(slices->data.size() != expected_size)) {
+      return Status::Corruption(Substitute(
+          "Server sent invalid response: column $0 has $1 bytes of data but expected $2",
+          col.name(), slices->data.size(), expected_size));
+    }
+    if (is_varlen) {
+      const uint8_t* offsets = slices->data.data();
+      uint32_t prev = 0;
+      for (int64_t row = 0; row <= num_rows; row++) {
+        uint32_t offset;
+        memcpy(&offset, offsets + row * sizeof(uint32_t), sizeof(offset));
+        if (PREDICT_FALSE(offset < prev || offset > slices->varlen_data.size())) {
+          return Status::Corruption(Substitute(
+              "Server sent invalid response: column $0 has bad offset $1 for row $2",
+              col.name(), offset, row));
+        }
+        prev = offset;
+      }
+    }
+    size_t expected_bitmap_size = col.is_nullable() ? BitmapSize(num_rows) : 0;
+    if (PREDICT_FALSE(col.is_nullable() != col_pb.has_non_null_bitmap_sidecar() ||
+                      slices->non_null_bitmap.size() != expected_bitmap_size)) {
+      return Status::Corruption(Substitute(
+          "Server sent invalid response: bad non-null bitmap for column $0", col.name()));
+    }
+  }
+  return Status::OK();
+}
+
+Status KuduScanBatch::Data::Reset(RpcController* controller,
+                                  const Schema* projection,
+                                  const KuduSchema* client_projection,
+                                  ScanResponsePB* response) {
+  if (response->has_columnar_data()) {
+    return Reset(controller, projection, client_projection,
+                 make_gscoped_ptr(response->release_columnar_data()));
+  }
+  return Reset(controller, projection, client_projection,
+               make_gscoped_ptr(response->release_data()));
+}
+
+Status KuduScanBatch::Data::CheckColumnarAccess(int col_idx) const {
+  if (PREDICT_FALSE(!columnar_)) {
+    return Status::IllegalState("not a columnar batch: use KuduScanner::COLUMNAR_LAYOUT");
+  }
+  if (PREDICT_FALSE(col_idx < 0 || col_idx >= static_cast<int>(columns_.size()))) {
+    return Status::InvalidArgument(Substitute("invalid column index: $0", col_idx));
+  }
+  return Status::OK();
+}
+
 void KuduScanBatch::Data::ExtractRows(vector<KuduScanBatch::RowPtr>* rows) {
   int n_rows = resp_data_.num_rows();
   rows->resize(n_rows);
@@ -539,6 +819,9 @@ void KuduScanBatch::Data::ExtractRows(vector<KuduScanBatch::RowPtr>* rows) {
 
 void KuduScanBatch::Data::Clear() {
   resp_data_.Clear();
+  columnar_data_.Clear();
+  columns_.clear();
+  columnar_ = false;
   controller_.Reset();
 }
 
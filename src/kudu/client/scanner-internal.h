@@ -28,8 +28,11 @@
 #include "kudu/common/partition_pruner.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/rpc/response_callback.h"
 #include "kudu/tserver/tserver_service.proxy.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/monotime.h"
 
 namespace kudu {
 
@@ -68,6 +71,9 @@ struct ScanRpcStatus {
     // The destination tablet does not exist (e.g. because the replica was deleted).
     TABLET_NOT_FOUND,
 
+    // The replica's data was staler than the scan's max staleness allows.
+    REPLICA_TOO_STALE,
+
     // Some other unknown tablet server error. This indicates that the TS was running
     // but some problem occurred other than the ones enumerated above.
     OTHER_TS_ERROR
@@ -92,6 +98,46 @@ class KuduScanner::Data {
   // The RPC and TS proxy should already have been prepared in next_req_, proxy_, etc.
   ScanRpcStatus SendScanRpc(const MonoTime& overall_deadline, bool allow_time_for_failover);
 
+  // Like SendScanRpc(), but sends the RPC asynchronously and runs 'callback'
+  // on a reactor thread once it completes. The callback should collect the
+  // outcome with FinishScanRpcAsync().
+  void SendScanRpcAsync(const MonoTime& overall_deadline, bool allow_time_for_failover,
+                        const rpc::ResponseCallback& callback);
+
+  // Analyzes the response of the RPC sent by SendScanRpcAsync().
+  ScanRpcStatus FinishScanRpcAsync(const MonoTime& overall_deadline);
+
+  // Handles the outcome 'result' of a continuation request on the current
+  // tablet, for a batch due by 'deadline'. Failed requests are retried,
+  // possibly after reopening the tablet on another replica if the scan is
+  // fault tolerant.
+  //
+  // On success, 'batch_ready' says whether 'last_response_' holds the rows
+  // of the next batch; it is false if the tablet was reopened instead.
+  // This may block, so it must not be called on a reactor thread unless
+  // 'result' is OK.
+  Status FinishContinueScan(const MonoTime& deadline,
+                            ScanRpcStatus result,
+                            bool* batch_ready);
+
+  // If prefetching is enabled and the current tablet has more results,
+  // prepares the next continuation request in 'next_req_' and sends it
+  // asynchronously. Its response is collected by FinishPrefetch().
+  //
+  // Must be called only after the rows of 'last_response_' were handed off
+  // to a batch, since the prefetched response will replace it.
+  void StartPrefetch();
+
+  // Waits for the in-flight prefetch, if any, and makes its response the
+  // last response, as if it had just been returned by SendScanRpc() for a
+  // batch due by 'overall_deadline'. The outcome is stored in 'result'.
+  //
+  // Returns false if there was no prefetch in flight.
+  bool FinishPrefetch(const MonoTime& overall_deadline, ScanRpcStatus* result);
+
+  // Waits for the in-flight prefetch, if any, and drops its response.
+  void DiscardPrefetch();
+
   // Called when KuduScanner::NextBatch or KuduScanner::Data::OpenTablet result in an RPC or
   // server error.
   //
@@ -123,6 +169,12 @@ class KuduScanner::Data {
 
   Status KeepAlive();
 
+  // Counts the tablets with partitions starting between
+  // 'unvisited_partition_key_' and 'upper' as pruned, as far as the meta
+  // cache knows them, and moves 'unvisited_partition_key_' to 'upper'. An
+  // empty 'upper' is the end of the scan.
+  void CountPrunedTablets(const std::string& upper);
+
   // Returns whether there may exist more tablets to scan.
   //
   // This method does not take into account any non-covered range partitions
@@ -132,6 +184,11 @@ class KuduScanner::Data {
   // but we won't know until we scan them.
   bool MoreTablets() const;
 
+  // Returns true if the scan has a limit and returned that many rows.
+  bool LimitReached() const {
+    return configuration_.has_limit() && num_rows_returned_ >= configuration_.limit();
+  }
+
   // Possible scan requests.
   enum RequestType {
     // A new scan of a particular tablet.
@@ -172,6 +229,9 @@ class KuduScanner::Data {
   // The encoded last primary key from the most recent tablet scan response.
   std::string last_primary_key_;
 
+  // The number of rows handed out by NextBatch() so far, over all tablets.
+  int64_t num_rows_returned_;
+
   internal::RemoteTabletServer* ts_;
 
   // The proxy can be derived from the RemoteTabletServer, but this involves retaking the
@@ -189,11 +249,30 @@ class KuduScanner::Data {
   // RPC controller for the last in-flight RPC.
   rpc::RpcController controller_;
 
+  // The deadlines of the RPC in flight for KuduScanner::NextBatchAsync(),
+  // and of the batch it belongs to.
+  MonoTime async_rpc_deadline_;
+  MonoTime async_batch_deadline_;
+
+  // Whether a prefetched continuation request is in flight. See StartPrefetch().
+  bool prefetch_in_flight_;
+
+  // The response, controller and deadline of the prefetched request.
+  // 'prefetch_latch_' is counted down when the response arrives.
+  tserver::ScanResponsePB prefetch_response_;
+  rpc::RpcController prefetch_controller_;
+  MonoTime prefetch_deadline_;
+  CountDownLatch prefetch_latch_;
+
   // The table we're scanning.
   sp::shared_ptr<KuduTable> table_;
 
   PartitionPruner partition_pruner_;
 
+  // The start of the partition keys which the scan has neither scanned nor
+  // counted as pruned yet.
+  std::string unvisited_partition_key_;
+
   // The tablet we're scanning.
   scoped_refptr<internal::RemoteTablet> remote_;
 
@@ -216,6 +295,11 @@ class KuduScanner::Data {
   ResourceMetrics resource_metrics_;
 
  private:
+  // Returns the deadline of the next RPC for a batch due by 'overall_deadline'.
+  // See SendScanRpc().
+  MonoTime ComputeRpcDeadline(const MonoTime& overall_deadline,
+                              bool allow_time_for_failover) const;
+
   // Analyze the response of the last Scan RPC made by this scanner.
   //
   // The error handling of a scan RPC is fairly complex, since we have to handle
@@ -234,6 +318,10 @@ class KuduScanner::Data {
 
   void UpdateResourceMetrics();
 
+  // Resets 'controller' for a scan RPC due by 'rpc_deadline', requiring the
+  // server features the scan needs.
+  void PrepareController(rpc::RpcController* controller, const MonoTime& rpc_deadline);
+
   DISALLOW_COPY_AND_ASSIGN(Data);
 };
 
@@ -247,11 +335,29 @@ class KuduScanBatch::Data {
                const KuduSchema* client_projection,
                gscoped_ptr<RowwiseRowBlockPB> resp_data);
 
+  // Same as above, but for a batch returned in the columnar layout.
+  Status Reset(rpc::RpcController* controller,
+               const Schema* projection,
+               const KuduSchema* client_projection,
+               gscoped_ptr<ColumnarRowBlockPB> columnar_data);
+
+  // Resets the batch from whichever row block 'response' carries, which is
+  // released from the response.
+  Status Reset(rpc::RpcController* controller,
+               const Schema* projection,
+               const KuduSchema* client_projection,
+               tserver::ScanResponsePB* response);
+
   int num_rows() const {
-    return resp_data_.num_rows();
+    return columnar_ ? columnar_data_.num_rows() : resp_data_.num_rows();
   }
 
+  // Returns a bad Status unless this is a columnar batch and 'col_idx' is a
+  // valid column of its projection.
+  Status CheckColumnarAccess(int col_idx) const;
+
   KuduRowResult row(int idx) {
+    DCHECK(!columnar_);
     DCHECK_GE(idx, 0);
     DCHECK_LT(idx, num_rows());
     int offset = idx * projected_row_size_;
@@ -277,6 +383,19 @@ class KuduScanBatch::Data {
   // by the members above.
   Slice direct_data_, indirect_data_;
 
+  // Whether this batch was returned in the columnar layout, in which case
+  // 'columnar_data_' and 'columns_' are used instead of the members above.
+  bool columnar_;
+  ColumnarRowBlockPB columnar_data_;
+
+  // Slices into the sidecars of each projected column of a columnar batch.
+  struct ColumnSlices {
+    Slice data;
+    Slice varlen_data;
+    Slice non_null_bitmap;
+  };
+  std::vector<ColumnSlices> columns_;
+
   // The projection being scanned.
   const Schema* projection_;
   // The KuduSchema version of 'projection_'
@@ -50,6 +50,8 @@ class KuduColumnSpec::Data {
         has_type(false),
         has_encoding(false),
         has_compression(false),
+        has_compression_level(false),
+        bloom_filter(false),
         has_block_size(false),
         has_nullable(false),
         primary_key(false),
@@ -74,6 +76,11 @@ class KuduColumnSpec::Data {
   bool has_compression;
   KuduColumnStorageAttributes::CompressionType compression;
 
+  bool has_compression_level;
+  int32_t compression_level;
+
+  bool bloom_filter;
+
   bool has_block_size;
   int32_t block_size;
 
@@ -55,6 +55,8 @@ kudu::EncodingType ToInternalEncodingType(KuduColumnStorageAttributes::EncodingT
     case KuduColumnStorageAttributes::GROUP_VARINT: return kudu::GROUP_VARINT;
     case KuduColumnStorageAttributes::RLE: return kudu::RLE;
     case KuduColumnStorageAttributes::BIT_SHUFFLE: return kudu::BIT_SHUFFLE;
+    case KuduColumnStorageAttributes::DELTA_OF_DELTA: return kudu::DELTA_OF_DELTA;
+    case KuduColumnStorageAttributes::XOR_ENCODING: return kudu::XOR_ENCODING;
     default: LOG(FATAL) << "Unexpected encoding type: " << type;
   }
 }
@@ -68,6 +70,8 @@ KuduColumnStorageAttributes::EncodingType FromInternalEncodingType(kudu::Encodin
     case kudu::GROUP_VARINT: return KuduColumnStorageAttributes::GROUP_VARINT;
     case kudu::RLE: return KuduColumnStorageAttributes::RLE;
     case kudu::BIT_SHUFFLE: return KuduColumnStorageAttributes::BIT_SHUFFLE;
+    case kudu::DELTA_OF_DELTA: return KuduColumnStorageAttributes::DELTA_OF_DELTA;
+    case kudu::XOR_ENCODING: return KuduColumnStorageAttributes::XOR_ENCODING;
     default: LOG(FATAL) << "Unexpected internal encoding type: " << type;
   }
 }
@@ -79,6 +83,7 @@ kudu::CompressionType ToInternalCompressionType(KuduColumnStorageAttributes::Com
     case KuduColumnStorageAttributes::SNAPPY: return kudu::SNAPPY;
     case KuduColumnStorageAttributes::LZ4: return kudu::LZ4;
     case KuduColumnStorageAttributes::ZLIB: return kudu::ZLIB;
+    case KuduColumnStorageAttributes::ZSTD: return kudu::ZSTD;
     default: LOG(FATAL) << "Unexpected compression type" << type;
   }
 }
@@ -91,6 +96,7 @@ KuduColumnStorageAttributes::CompressionType FromInternalCompressionType(
     case kudu::SNAPPY: return KuduColumnStorageAttributes::SNAPPY;
     case kudu::LZ4: return KuduColumnStorageAttributes::LZ4;
     case kudu::ZLIB: return KuduColumnStorageAttributes::ZLIB;
+    case kudu::ZSTD: return KuduColumnStorageAttributes::ZSTD;
     default: LOG(FATAL) << "Unexpected internal compression type: " << type;
   }
 }
@@ -159,6 +165,17 @@ KuduColumnSpec* KuduColumnSpec::Compression(
   return this;
 }
 
+KuduColumnSpec* KuduColumnSpec::CompressionLevel(int32_t level) {
+  data_->has_compression_level = true;
+  data_->compression_level = level;
+  return this;
+}
+
+KuduColumnSpec* KuduColumnSpec::BloomFilter(bool bloom_filter) {
+  data_->bloom_filter = bloom_filter;
+  return this;
+}
+
 KuduColumnSpec* KuduColumnSpec::Encoding(
     KuduColumnStorageAttributes::EncodingType encoding) {
   data_->has_encoding = true;
@@ -247,9 +264,16 @@ Status KuduColumnSpec::ToColumnSchema(KuduColumnSchema* col) const {
     block_size = data_->block_size;
   }
 
+  int32_t compression_level = 0; // '0' signifies the codec's default
+  if (data_->has_compression_level) {
+    compression_level = data_->compression_level;
+  }
+
   *col = KuduColumnSchema(data_->name, data_->type, nullable,
                           default_val,
-                          KuduColumnStorageAttributes(encoding, compression, block_size));
+                          KuduColumnStorageAttributes(encoding, compression, block_size,
+                                                      compression_level,
+                                                      data_->bloom_filter));
 
   return Status::OK();
 }
@@ -399,6 +423,8 @@ KuduColumnSchema::KuduColumnSchema(const std::string &name,
   ColumnStorageAttributes attr_private;
   attr_private.encoding = ToInternalEncodingType(attributes.encoding());
   attr_private.compression = ToInternalCompressionType(attributes.compression());
+  attr_private.compression_level = attributes.compression_level();
+  attr_private.bloom_filter = attributes.bloom_filter();
   col_ = new ColumnSchema(name, ToInternalDataType(type), is_nullable,
                           default_value, default_value, attr_private);
 }
@@ -504,7 +530,10 @@ bool KuduSchema::Equals(const KuduSchema& other) const {
 KuduColumnSchema KuduSchema::Column(size_t idx) const {
   ColumnSchema col(schema_->column(idx));
   KuduColumnStorageAttributes attrs(FromInternalEncodingType(col.attributes().encoding),
-                                    FromInternalCompressionType(col.attributes().compression));
+                                    FromInternalCompressionType(col.attributes().compression),
+                                    col.attributes().cfile_block_size,
+                                    col.attributes().compression_level,
+                                    col.attributes().bloom_filter);
   return KuduColumnSchema(col.name(), FromInternalDataType(col.type_info()->type()),
                           col.is_nullable(), col.read_default_value(),
                           attrs);
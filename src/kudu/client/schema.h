@@ -59,7 +59,9 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     GROUP_VARINT = 3,
     RLE = 4,
     DICT_ENCODING = 5,
-    BIT_SHUFFLE = 6
+    BIT_SHUFFLE = 6,
+    DELTA_OF_DELTA = 7,
+    XOR_ENCODING = 8
   };
 
   enum CompressionType {
@@ -68,6 +70,7 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     SNAPPY = 2,
     LZ4 = 3,
     ZLIB = 4,
+    ZSTD = 5,
   };
 
 
@@ -75,10 +78,14 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
   // be made private in a future release.
   KuduColumnStorageAttributes(EncodingType encoding = AUTO_ENCODING,
                               CompressionType compression = DEFAULT_COMPRESSION,
-                              int32_t block_size = 0)
+                              int32_t block_size = 0,
+                              int32_t compression_level = 0,
+                              bool bloom_filter = false)
       : encoding_(encoding),
       compression_(compression),
-      block_size_(block_size) {
+      block_size_(block_size),
+      compression_level_(compression_level),
+      bloom_filter_(bloom_filter) {
   }
 
   const EncodingType encoding() const {
@@ -89,12 +96,22 @@ class KUDU_EXPORT KuduColumnStorageAttributes {
     return compression_;
   }
 
+  const int32_t compression_level() const {
+    return compression_level_;
+  }
+
+  const bool bloom_filter() const {
+    return bloom_filter_;
+  }
+
   std::string ToString() const;
 
  private:
   EncodingType encoding_;
   CompressionType compression_;
   int32_t block_size_;
+  int32_t compression_level_;
+  bool bloom_filter_;
 };
 
 class KUDU_EXPORT KuduColumnSchema {
@@ -171,8 +188,27 @@ class KUDU_EXPORT KuduColumnSpec {
   KuduColumnSpec* Default(KuduValue* value);
 
   // Set the preferred compression for this column.
+  //
+  // This and the other storage attributes below may also be changed when
+  // altering a column, in which case they apply to the data written from then
+  // on; existing data is rewritten with them as it's compacted.
   KuduColumnSpec* Compression(KuduColumnStorageAttributes::CompressionType compression);
 
+  // Set the level to compress this column at, for compression types which
+  // have levels. Currently only ZSTD does, with levels 1 (fastest) through
+  // 22 (smallest); if unset, the codec's default level (3 for ZSTD) is used.
+  // Higher levels make writes slower but don't slow down reads.
+  KuduColumnSpec* CompressionLevel(int32_t level);
+
+  // Set whether the data files of this column record a bloom filter of the
+  // column's values. Scans with an equality or IN-list predicate on the
+  // column then skip the files holding none of the values, which makes
+  // lookups by a column other than the primary key much cheaper than a
+  // full scan when the values are spread over few rowsets. The filter costs
+  // about 10 bits per distinct value of each file, and is not supported for
+  // FLOAT and DOUBLE columns.
+  KuduColumnSpec* BloomFilter(bool bloom_filter);
+
   // Set the preferred encoding for this column.
   // Note that not all encodings are supported for all column types.
   KuduColumnSpec* Encoding(KuduColumnStorageAttributes::EncodingType encoding);
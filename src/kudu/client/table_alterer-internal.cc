@@ -84,29 +84,56 @@ Status KuduTableAlterer::Data::ToRequest(AlterTableRequestPB* req) {
         break;
       }
       case AlterTableRequestPB::ALTER_COLUMN:
-        // TODO(KUDU-861): support altering a column in the wire protocol.
-        // For now, we just give an error if the caller tries to do
-        // any operation other than rename.
-        if (s.spec->data_->has_type ||
-            s.spec->data_->has_encoding ||
-            s.spec->data_->has_compression ||
-            s.spec->data_->has_nullable ||
-            s.spec->data_->primary_key ||
-            s.spec->data_->has_default ||
-            s.spec->data_->default_val ||
-            s.spec->data_->remove_default) {
+      {
+        // TODO(KUDU-861): support altering a column's type, nullability and
+        // defaults too. For now, only renames and changes to the storage
+        // attributes are supported.
+        const KuduColumnSpec::Data* data = s.spec->data_;
+        if (data->has_type ||
+            data->has_nullable ||
+            data->primary_key ||
+            data->has_default ||
+            data->default_val ||
+            data->remove_default ||
+            data->bloom_filter) {
           return Status::NotSupported("cannot support AlterColumn of this type",
-                                      s.spec->data_->name);
+                                      data->name);
         }
-        // We only support rename column
-        if (!s.spec->data_->has_rename_to) {
+        bool alters_storage = data->has_encoding ||
+                              data->has_compression ||
+                              data->has_compression_level ||
+                              data->has_block_size;
+        if (!alters_storage && !data->has_rename_to) {
           return Status::InvalidArgument("no alter operation specified",
-                                         s.spec->data_->name);
+                                         data->name);
+        }
+        if (alters_storage) {
+          AlterTableRequestPB::AlterColumn* alter = pb_step->mutable_alter_column();
+          alter->set_name(data->name);
+          if (data->has_encoding) {
+            alter->set_encoding(ToInternalEncodingType(data->encoding));
+          }
+          if (data->has_compression) {
+            alter->set_compression(ToInternalCompressionType(data->compression));
+          }
+          if (data->has_compression_level) {
+            alter->set_compression_level(data->compression_level);
+          }
+          if (data->has_block_size) {
+            alter->set_cfile_block_size(data->block_size);
+          }
+          if (!data->has_rename_to) {
+            break;
+          }
+          // The storage attributes are changed under the old name, and the
+          // column is then renamed by a step of its own.
+          pb_step = req->add_alter_schema_steps();
         }
-        pb_step->mutable_rename_column()->set_old_name(s.spec->data_->name);
-        pb_step->mutable_rename_column()->set_new_name(s.spec->data_->rename_to);
+        pb_step->mutable_rename_column()->set_old_name(data->name);
+        pb_step->mutable_rename_column()->set_new_name(data->rename_to);
         pb_step->set_type(AlterTableRequestPB::RENAME_COLUMN);
         break;
+      }
       case AlterTableRequestPB::ADD_RANGE_PARTITION:
       {
         RowOperationsPBEncoder encoder(pb_step->mutable_add_range_partition()
@@ -28,6 +28,10 @@ KuduTableCreator::Data::Data(KuduClient* client)
   : client_(client),
     schema_(nullptr),
     num_replicas_(0),
+    has_compaction_policy_(false),
+    compaction_policy_(KuduTableCreator::BUDGETED_COMPACTION),
+    has_history_max_age_(false),
+    pin_key_index_(false),
     wait_(true) {
 }
 
@@ -49,6 +49,17 @@ class KuduTableCreator::Data {
 
   int num_replicas_;
 
+  bool has_compaction_policy_;
+  KuduTableCreator::CompactionPolicy compaction_policy_;
+
+  bool has_history_max_age_;
+  MonoDelta history_max_age_;
+
+  std::string row_ttl_column_;
+  MonoDelta row_ttl_;
+
+  bool pin_key_index_;
+
   MonoDelta timeout_;
 
   bool wait_;
@@ -41,7 +41,10 @@
 
 #include "kudu/codegen/jit_wrapper.h"
 #include "kudu/codegen/module_builder.h"
+#include "kudu/codegen/predicate_evaluator.h"
+#include "kudu/codegen/row_key_coder.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/codegen/row_serializer.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/once.h"
@@ -81,6 +84,7 @@ using llvm::Target;
 using llvm::TargetMachine;
 using llvm::Triple;
 using std::string;
+using std::vector;
 
 namespace kudu {
 
@@ -229,5 +233,67 @@ Status CodeGenerator::CompileRowProjector(const Schema& base, const Schema& proj
   return Status::OK();
 }
 
+Status CodeGenerator::CompileRowSerializer(const Schema& block_schema,
+                                           const Schema& projection,
+                                           scoped_refptr<RowSerializerFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(RowSerializerFunctions::Create(block_schema, projection, out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 500;
+    std::stringstream sstr;
+    sstr << "Printing row serialization function:\n";
+    int instrs = DumpAsm((*out)->serialize(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
+Status CodeGenerator::CompilePredicateEvaluator(
+    const Schema& projection, const vector<PredicateShape>& shapes,
+    scoped_refptr<PredicateEvaluatorFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(PredicateEvaluatorFunctions::Create(projection, shapes, out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 500;
+    std::stringstream sstr;
+    sstr << "Printing predicate evaluation function:\n";
+    int instrs = DumpAsm((*out)->evaluate(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
+Status CodeGenerator::CompileRowKeyFunctions(const Schema& schema,
+                                             scoped_refptr<RowKeyFunctions>* out) {
+  RETURN_NOT_OK(CheckCodegenEnabled());
+
+  TargetMachine* tm;
+  RETURN_NOT_OK(RowKeyFunctions::Create(schema, out, &tm));
+
+  if (FLAGS_codegen_dump_mc) {
+    static const int kInstrMax = 500;
+    std::stringstream sstr;
+    sstr << "Printing key encoding function:\n";
+    int instrs = DumpAsm((*out)->encode(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.\n";
+    sstr << "Printing key comparison function:\n";
+    instrs = DumpAsm((*out)->compare(), *tm, &sstr, kInstrMax);
+    sstr << "Printed " << instrs << " instructions.";
+    LOG(INFO) << sstr.str();
+  }
+
+  return Status::OK();
+}
+
 } // namespace codegen
 } // namespace kudu
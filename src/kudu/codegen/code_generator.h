@@ -18,6 +18,8 @@
 #ifndef KUDU_CODEGEN_CODE_GENERATOR_H
 #define KUDU_CODEGEN_CODE_GENERATOR_H
 
+#include <vector>
+
 #include "kudu/codegen/row_projector.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -34,7 +36,11 @@ class Schema;
 
 namespace codegen {
 
+class PredicateEvaluatorFunctions;
+class RowKeyFunctions;
 class RowProjectorFunctions;
+class RowSerializerFunctions;
+struct PredicateShape;
 
 // CodeGenerator is a top-level class that manages a per-module
 // LLVM context, ExecutionEngine initialization, native target loading,
@@ -71,6 +77,23 @@ class CodeGenerator {
   Status CompileRowProjector(const Schema& base, const Schema& proj,
                              scoped_refptr<RowProjectorFunctions>* out);
 
+  // Attempts to initialize a row serialization function by compiling code
+  // for the parameter schemas. Writes to 'out' upon success.
+  Status CompileRowSerializer(const Schema& block_schema, const Schema& projection,
+                              scoped_refptr<RowSerializerFunctions>* out);
+
+  // Attempts to initialize a predicate evaluation function by compiling
+  // code for the given predicate shapes over the projection. Writes to
+  // 'out' upon success.
+  Status CompilePredicateEvaluator(const Schema& projection,
+                                   const std::vector<PredicateShape>& shapes,
+                                   scoped_refptr<PredicateEvaluatorFunctions>* out);
+
+  // Attempts to initialize row key encoding and comparison functions by
+  // compiling code for the key columns of 'schema'. Writes to 'out' upon
+  // success.
+  Status CompileRowKeyFunctions(const Schema& schema, scoped_refptr<RowKeyFunctions>* out);
+
  private:
   static void GlobalInit();
 
@@ -16,6 +16,7 @@
 // under the License.
 
 #include <algorithm>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -25,18 +26,29 @@
 
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/codegen/object_cache.h"
+#include "kudu/codegen/predicate_evaluator.h"
+#include "kudu/codegen/row_key_coder.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/codegen/row_serializer.h"
+#include "kudu/common/column_predicate.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
+#include "kudu/common/wire_protocol.h"
+#include "kudu/common/wire_protocol.pb.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/env.h"
 #include "kudu/util/logging_test_util.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/random.h"
 #include "kudu/util/random_util.h"
 #include "kudu/util/test_util.h"
 
+using std::shared_ptr;
 using std::string;
 using std::vector;
 
@@ -49,6 +61,8 @@ typedef RowProjector NoCodegenRP;
 typedef codegen::RowProjector CodegenRP;
 
 using codegen::CompilationManager;
+using codegen::ModuleBuilder;
+using codegen::PersistentObjectCache;
 
 class CodegenTest : public KuduTest {
  public:
@@ -107,6 +121,19 @@ class CodegenTest : public KuduTest {
   // Generates a new row projector for the given projection schema.
   Status Generate(const Schema* proj, gscoped_ptr<CodegenRP>* out);
 
+  // Compares the rows of the test data selected by the codegenned and the
+  // interpreted evaluation of the conjunction of 'predicates'.
+  void TestPredicates(const vector<ColumnPredicate>& predicates);
+
+  // Compares the output of the codegenned and the interpreted row-wise
+  // serialization of the test rows to the given projection.
+  void TestSerialization(const Schema& proj);
+
+  // Returns the value of the given column of a test row.
+  const void* TestRowCell(int row, size_t col_idx) const {
+    return test_rows_[row]->cell_ptr(col_idx);
+  }
+
   enum {
     // Base schema column indices
     kKeyCol,
@@ -226,6 +253,65 @@ Status CodegenTest::Generate(const Schema* proj, gscoped_ptr<CodegenRP>* out) {
   return Status::OK();
 }
 
+void CodegenTest::TestPredicates(const vector<ColumnPredicate>& predicates) {
+  vector<codegen::PredicateShape> shapes;
+  ASSERT_OK(codegen::PredicateEvaluatorFunctions::GetShapes(base_, predicates, &shapes));
+  scoped_refptr<codegen::PredicateEvaluatorFunctions> functions;
+  ASSERT_OK(generator_.CompilePredicateEvaluator(base_, shapes, &functions));
+  codegen::PredicateEvaluator with(predicates, functions);
+
+  NoCodegenRP identity(&base_, &base_);
+  ASSERT_OK(identity.Init());
+  RowBlock rb_with(base_, kNumTestRows, &projections_arena_);
+  RowBlock rb_without(base_, kNumTestRows, &projections_arena_);
+  projections_arena_.Reset();
+  ProjectTestRows<true>(&identity, &rb_with);
+  ProjectTestRows<true>(&identity, &rb_without);
+
+  // Leave a row unselected to check that it stays unselected.
+  rb_with.selection_vector()->SetAllTrue();
+  rb_with.selection_vector()->SetRowUnselected(0);
+  rb_without.selection_vector()->SetAllTrue();
+  rb_without.selection_vector()->SetRowUnselected(0);
+
+  with.Evaluate(&rb_with);
+  for (const ColumnPredicate& pred : predicates) {
+    int col_idx = base_.find_column(pred.column().name());
+    pred.Evaluate(rb_without.column_block(col_idx), rb_without.selection_vector());
+  }
+
+  for (int i = 0; i < kNumTestRows; i++) {
+    EXPECT_EQ(rb_without.selection_vector()->IsRowSelected(i),
+              rb_with.selection_vector()->IsRowSelected(i))
+      << "at row " << i << ": " << base_.DebugRow(rb_with.row(i));
+  }
+}
+
+void CodegenTest::TestSerialization(const Schema& proj) {
+  scoped_refptr<codegen::RowSerializerFunctions> functions;
+  ASSERT_OK(generator_.CompileRowSerializer(base_, proj, &functions));
+  codegen::RowSerializer with(functions);
+
+  NoCodegenRP identity(&base_, &base_);
+  ASSERT_OK(identity.Init());
+  RowBlock rb(base_, kNumTestRows, &projections_arena_);
+  projections_arena_.Reset();
+  ProjectTestRows<true>(&identity, &rb);
+  rb.selection_vector()->SetAllTrue();
+  rb.selection_vector()->SetRowUnselected(1);
+
+  // Serialize the block twice to check that rows are appended.
+  RowwiseRowBlockPB pb_with, pb_without;
+  faststring data_with, data_without, indirect_with, indirect_without;
+  for (int i = 0; i < 2; i++) {
+    with.SerializeRowBlock(rb, &pb_with, &data_with, &indirect_with);
+    SerializeRowBlock(rb, &pb_without, &proj, &data_without, &indirect_without);
+  }
+  ASSERT_EQ(pb_without.num_rows(), pb_with.num_rows());
+  ASSERT_EQ(data_without.ToString(), data_with.ToString());
+  ASSERT_EQ(indirect_without.ToString(), indirect_with.ToString());
+}
+
 Status CodegenTest::CreatePartialSchema(const vector<size_t>& col_indexes,
                                         Schema* out) {
   vector<ColumnId> col_ids;
@@ -261,7 +347,7 @@ TEST_F(CodegenTest, ObservablesTest) {
 // Test key projection
 TEST_F(CodegenTest, TestKey) {
   Schema key = base_.CreateKeyProjection();
-  TestProjection<true>(&key);
+  TestProjection(&key);
   TestProjection<false>(&key);
 }
 
@@ -271,7 +357,7 @@ TEST_F(CodegenTest, TestInts) {
   vector<size_t> part_cols = { kI32Col, kI32NullValCol, kI32NullCol };
   ASSERT_OK(CreatePartialSchema(part_cols, &ints));
 
-  TestProjection<true>(&ints);
+  TestProjection(&ints);
   TestProjection<false>(&ints);
 }
 
@@ -281,7 +367,7 @@ TEST_F(CodegenTest, TestStrings) {
   vector<size_t> part_cols = { kStrCol, kStrNullValCol, kStrNullCol };
   ASSERT_OK(CreatePartialSchema(part_cols, &strs));
 
-  TestProjection<true>(&strs);
+  TestProjection(&strs);
   TestProjection<false>(&strs);
 }
 
@@ -291,7 +377,7 @@ TEST_F(CodegenTest, TestNonNullables) {
   vector<size_t> part_cols = { kKeyCol, kI32Col, kStrCol };
   ASSERT_OK(CreatePartialSchema(part_cols, &non_null));
 
-  TestProjection<true>(&non_null);
+  TestProjection(&non_null);
   TestProjection<false>(&non_null);
 }
 
@@ -301,13 +387,13 @@ TEST_F(CodegenTest, TestNullables) {
   vector<size_t> part_cols = { kI32NullValCol, kI32NullCol, kStrNullValCol, kStrNullCol };
   ASSERT_OK(CreatePartialSchema(part_cols, &nullables));
 
-  TestProjection<true>(&nullables);
+  TestProjection(&nullables);
   TestProjection<false>(&nullables);
 }
 
 // Test full schema projection
 TEST_F(CodegenTest, TestFullSchema) {
-  TestProjection<true>(&base_);
+  TestProjection(&base_);
   TestProjection<false>(&base_);
 }
 
@@ -319,7 +405,7 @@ TEST_F(CodegenTest, TestDefaultsOnly) {
   vector<size_t> part_cols = { kI32RCol, kI32RWCol, kStrRCol, kStrRWCol };
   ASSERT_OK(CreatePartialSchema(part_cols, &pure_defaults));
 
-  TestProjection<true>(&pure_defaults);
+  TestProjection(&pure_defaults);
 
   // Default write projections
   part_cols = { kI32RWCol, kStrRWCol };
@@ -330,7 +416,7 @@ TEST_F(CodegenTest, TestDefaultsOnly) {
 
 // Test full defaults projection
 TEST_F(CodegenTest, TestFullSchemaWithDefaults) {
-  TestProjection<true>(&defaults_);
+  TestProjection(&defaults_);
 
   // Default write projection
   Schema full_write;
@@ -358,13 +444,167 @@ TEST_F(CodegenTest, TestDumpMC) {
   Schema ints;
   vector<size_t> part_cols = { kI32Col, kI32NullValCol, kI32NullCol, kStrCol };
   ASSERT_OK(CreatePartialSchema(part_cols, &ints));
-  TestProjection<true>(&ints);
+  TestProjection(&ints);
 
   const vector<string>& msgs = sink.logged_msgs();
   ASSERT_EQ(msgs.size(), 1);
   EXPECT_THAT(msgs[0], testing::ContainsRegex("retq"));
 }
 
+TEST_F(CodegenTest, TestPredicateEvaluation) {
+  const uint64_t kKeyLower = 2;
+  const uint64_t kKeyUpper = 8;
+  const int32_t kZero = 0;
+  const ColumnSchema& key = base_.column(kKeyCol);
+  const ColumnSchema& i32 = base_.column(kI32Col);
+  const ColumnSchema& str = base_.column(kStrCol);
+
+  // Ranges over integers, with one or both bounds.
+  TestPredicates({ ColumnPredicate::Range(key, &kKeyLower, &kKeyUpper),
+                   ColumnPredicate::Range(i32, &kZero, nullptr) });
+  TestPredicates({ ColumnPredicate::Range(i32, nullptr, &kZero) });
+  TestPredicates({ ColumnPredicate::Equality(key, &kKeyLower) });
+
+  // Nullability, alone and combined with comparisons of strings.
+  TestPredicates({ ColumnPredicate::IsNull(base_.column(kI32NullCol)),
+                   ColumnPredicate::Equality(str, TestRowCell(3, kStrCol)) });
+  TestPredicates({ ColumnPredicate::IsNotNull(base_.column(kI32NullValCol)),
+                   ColumnPredicate::Range(base_.column(kStrNullValCol),
+                                          TestRowCell(5, kStrNullValCol), nullptr) });
+  TestPredicates({ ColumnPredicate::IsNotNull(base_.column(kStrNullCol)) });
+}
+
+// Predicates with the same shape share the compiled code, regardless of their
+// values, and predicates which can't be compiled are never requested.
+TEST_F(CodegenTest, TestPredicateEvaluatorCache) {
+  Singleton<CompilationManager>::UnsafeReset();
+  CompilationManager* cm = CompilationManager::GetSingleton();
+  const int32_t kValues[] = { 1, 2 };
+  const ColumnSchema& i32 = base_.column(kI32Col);
+
+  gscoped_ptr<codegen::PredicateEvaluator> evaluator;
+  ASSERT_FALSE(cm->RequestPredicateEvaluator(
+      &base_, { ColumnPredicate::Range(i32, &kValues[0], nullptr) }, &evaluator));
+  cm->Wait();
+  ASSERT_TRUE(cm->RequestPredicateEvaluator(
+      &base_, { ColumnPredicate::Range(i32, &kValues[1], nullptr) }, &evaluator));
+  ASSERT_TRUE(evaluator);
+
+  // A range with both bounds has a different shape.
+  evaluator.reset();
+  ASSERT_FALSE(cm->RequestPredicateEvaluator(
+      &base_, { ColumnPredicate::Range(i32, &kValues[0], &kValues[1]) }, &evaluator));
+  ASSERT_FALSE(evaluator);
+
+  // IN lists aren't compiled.
+  for (int i = 0; i < 2; i++) {
+    vector<const void*> values = { &kValues[0], &kValues[1] };
+    ASSERT_FALSE(cm->RequestPredicateEvaluator(
+        &base_, { ColumnPredicate::InList(i32, &values) }, &evaluator));
+    cm->Wait();
+  }
+}
+
+TEST_F(CodegenTest, TestRowSerialization) {
+  TestSerialization(base_);
+  TestSerialization(base_.CreateKeyProjection());
+
+  // A reordered subset of the columns.
+  Schema proj;
+  vector<size_t> part_cols = { kStrNullCol, kI32NullValCol, kKeyCol, kStrCol };
+  ASSERT_OK(CreatePartialSchema(part_cols, &proj));
+  TestSerialization(proj);
+}
+
+// Compares the codegenned key functions against the Schema's for a composite
+// key mixing integers of different widths with strings, including strings
+// with '\0' bytes, which need escaping before the last component.
+TEST_F(CodegenTest, TestRowKeyFunctions) {
+  Schema schema({ ColumnSchema("k8", INT8),
+                  ColumnSchema("kstr", STRING),
+                  ColumnSchema("k32", INT32),
+                  ColumnSchema("klast", STRING),
+                  ColumnSchema("val", UINT32, true) }, 4);
+  scoped_refptr<codegen::RowKeyFunctions> functions;
+  ASSERT_OK(generator_.CompileRowKeyFunctions(schema, &functions));
+  codegen::RowKeyCoder coder(functions);
+
+  const int kNumRows = 50;
+  const Slice kStrings[] = { "", "a", Slice("a\0b", 3), "ab", "b" };
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema, kNumRows, &arena);
+  for (int i = 0; i < kNumRows; i++) {
+    RowBlockRow row = block.row(i);
+    // Use few distinct values so that the comparisons often reach the later
+    // columns.
+    int8_t k8 = static_cast<int>(random_.Uniform(3)) - 1;
+    int32_t k32 = static_cast<int>(random_.Uniform(3)) - 1;
+    const Slice& kstr = kStrings[random_.Uniform(arraysize(kStrings))];
+    const Slice& klast = kStrings[random_.Uniform(arraysize(kStrings))];
+    memcpy(row.mutable_cell_ptr(0), &k8, sizeof(k8));
+    memcpy(row.mutable_cell_ptr(1), &kstr, sizeof(kstr));
+    memcpy(row.mutable_cell_ptr(2), &k32, sizeof(k32));
+    memcpy(row.mutable_cell_ptr(3), &klast, sizeof(klast));
+    row.cell(4).set_null(true);
+  }
+
+  faststring with, without;
+  for (int i = 0; i < kNumRows; i++) {
+    uint8_t* row_data = static_cast<uint8_t*>(
+        arena.AllocateBytes(ContiguousRowHelper::row_size(schema)));
+    ContiguousRow row(&schema, row_data);
+    ASSERT_OK(CopyRow(block.row(i), &row, &arena));
+    ConstContiguousRow const_row(row);
+    ASSERT_EQ(schema.EncodeComparableKey(const_row, &without).ToString(),
+              coder.EncodeComparableKey(const_row, &with).ToString())
+      << "at row " << i << ": " << schema.DebugRow(const_row);
+
+    for (int j = 0; j < kNumRows; j++) {
+      int expected = schema.Compare(block.row(i), block.row(j));
+      int actual = coder.Compare(block.row(i), block.row(j));
+      ASSERT_EQ(expected < 0, actual < 0) << i << " vs " << j;
+      ASSERT_EQ(expected == 0, actual == 0) << i << " vs " << j;
+    }
+  }
+}
+
+// Modules compiled with a persistent object cache are loaded from it when
+// they're compiled again, unless the cache was built for another fingerprint.
+TEST_F(CodegenTest, TestPersistentObjectCache) {
+  string dir = GetTestPath("codegen-cache");
+  shared_ptr<PersistentObjectCache> cache(new PersistentObjectCache(env_.get(), dir));
+  ASSERT_OK(cache->Init());
+  ModuleBuilder::SetObjectCache(cache);
+
+  Schema ints;
+  vector<size_t> part_cols = { kI32Col, kI32NullValCol, kI32NullCol };
+  ASSERT_OK(CreatePartialSchema(part_cols, &ints));
+  TestProjection(&ints);
+  ASSERT_EQ(0, cache->num_hits());
+  ASSERT_EQ(1, cache->num_stores());
+  TestProjection(&ints);
+  ASSERT_EQ(1, cache->num_hits());
+  ASSERT_EQ(1, cache->num_stores());
+
+  // Projections which embed pointers to default values are never stored.
+  Schema defaults;
+  part_cols = { kI32RCol, kStrRCol };
+  ASSERT_OK(CreatePartialSchema(part_cols, &defaults));
+  TestProjection(&defaults);
+  ASSERT_EQ(1, cache->num_stores());
+
+  // Objects compiled for another fingerprint are discarded.
+  ASSERT_OK(WriteStringToFile(env_.get(), "stale", JoinPathSegments(dir, "fingerprint")));
+  cache.reset(new PersistentObjectCache(env_.get(), dir));
+  ASSERT_OK(cache->Init());
+  ModuleBuilder::SetObjectCache(cache);
+  TestProjection(&ints);
+  ASSERT_EQ(0, cache->num_hits());
+  ASSERT_EQ(1, cache->num_stores());
+
+  ModuleBuilder::SetObjectCache(nullptr);
+}
+
 // Basic test for the CompilationManager code cache.
 // This runs a bunch of compilation tasks and ensures that the cache
 // sometimes hits on the second attempt for the same projection.
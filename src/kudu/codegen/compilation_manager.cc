@@ -23,11 +23,17 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
+#include <utility>
 
 #include "kudu/codegen/code_cache.h"
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/predicate_evaluator.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/codegen/object_cache.h"
+#include "kudu/codegen/row_key_coder.h"
 #include "kudu/codegen/row_projector.h"
+#include "kudu/codegen/row_serializer.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/casts.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -43,6 +49,8 @@
 #include "kudu/util/threadpool.h"
 
 using std::shared_ptr;
+using std::string;
+using std::vector;
 
 DEFINE_bool(codegen_time_compilation, false, "Whether to print time that each code "
             "generation request took.");
@@ -53,6 +61,11 @@ DEFINE_int32(codegen_cache_capacity, 100, "Number of entries which may be stored
              "code generation cache.");
 TAG_FLAG(codegen_cache_capacity, experimental);
 
+DEFINE_bool(codegen_persistent_cache, true, "Whether the tablet server should keep the "
+            "object code it compiles in its metadata directory, so that it doesn't "
+            "have to be compiled again after a restart.");
+TAG_FLAG(codegen_persistent_cache, experimental);
+
 METRIC_DEFINE_gauge_int64(server, code_cache_hits, "Codegen Cache Hits",
                           kudu::MetricUnit::kCacheHits,
                           "Number of codegen cache hits since start",
@@ -119,6 +132,137 @@ class CompilationTask : public Runnable {
   DISALLOW_COPY_AND_ASSIGN(CompilationTask);
 };
 
+// Compiles a predicate evaluator. Only the predicates' shapes are needed, so
+// the task doesn't depend on the lifetime of the scan which requested it.
+class PredicateCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  PredicateCompilationTask(const Schema& projection, vector<PredicateShape> shapes,
+                           CodeCache* cache, CodeGenerator* generator)
+    : projection_(projection),
+      shapes_(std::move(shapes)),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of predicate evaluator over projection schema " +
+                projection_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(PredicateEvaluatorFunctions::EncodeKey(projection_, shapes_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<PredicateEvaluatorFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating predicate evaluator") {
+      RETURN_NOT_OK(generator_->CompilePredicateEvaluator(projection_, shapes_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  Schema projection_;
+  vector<PredicateShape> shapes_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(PredicateCompilationTask);
+};
+
+// Compiles a row serializer for a block schema and client projection.
+class SerializerCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  SerializerCompilationTask(const Schema& block_schema, const Schema& projection,
+                            CodeCache* cache, CodeGenerator* generator)
+    : block_schema_(block_schema),
+      projection_(projection),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of row serializer from block schema " +
+                block_schema_.ToString() + " to projection schema " +
+                projection_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(RowSerializerFunctions::EncodeKey(block_schema_, projection_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<RowSerializerFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating row serializer") {
+      RETURN_NOT_OK(generator_->CompileRowSerializer(block_schema_, projection_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  Schema block_schema_;
+  Schema projection_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(SerializerCompilationTask);
+};
+
+// Compiles the row key functions for the key columns of a schema.
+class RowKeyCompilationTask : public Runnable {
+ public:
+  // Requires that the cache and generator are valid for the lifetime
+  // of this object.
+  RowKeyCompilationTask(const Schema& schema, CodeCache* cache, CodeGenerator* generator)
+    : key_schema_(schema.CreateKeyProjection()),
+      cache_(cache),
+      generator_(generator) {}
+
+  // Can only be run once.
+  void Run() override {
+    WARN_NOT_OK(RunWithStatus(),
+                "Failed compilation of row key functions for key schema " +
+                key_schema_.ToString());
+  }
+
+ private:
+  Status RunWithStatus() {
+    faststring key;
+    RETURN_NOT_OK(RowKeyFunctions::EncodeKey(key_schema_, &key));
+
+    // Check again to make sure we didn't compile it already.
+    if (cache_->Lookup(key)) return Status::OK();
+
+    scoped_refptr<RowKeyFunctions> functions;
+    LOG_TIMING_IF(INFO, FLAGS_codegen_time_compilation, "code-generating row key functions") {
+      RETURN_NOT_OK(generator_->CompileRowKeyFunctions(key_schema_, &functions));
+    }
+
+    RETURN_NOT_OK(cache_->AddEntry(functions));
+    return Status::OK();
+  }
+
+  Schema key_schema_;
+  CodeCache* const cache_;
+  CodeGenerator* const generator_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowKeyCompilationTask);
+};
+
 } // anonymous namespace
 
 CompilationManager::CompilationManager()
@@ -145,6 +289,16 @@ void CompilationManager::Wait() {
   pool_->Wait();
 }
 
+Status CompilationManager::OpenPersistentCache(Env* env, const string& dir) {
+  if (!FLAGS_codegen_persistent_cache) {
+    return Status::OK();
+  }
+  shared_ptr<PersistentObjectCache> cache(new PersistentObjectCache(env, dir));
+  RETURN_NOT_OK(cache->Init());
+  ModuleBuilder::SetObjectCache(std::move(cache));
+  return Status::OK();
+}
+
 void CompilationManager::Shutdown() {
   GetSingleton()->pool_->Shutdown();
 }
@@ -196,5 +350,90 @@ bool CompilationManager::RequestRowProjector(const Schema* base_schema,
   return true;
 }
 
+bool CompilationManager::RequestRowSerializer(const Schema* block_schema,
+                                              const Schema* projection,
+                                              gscoped_ptr<RowSerializer>* out) {
+  faststring key;
+  Status s = RowSerializerFunctions::EncodeKey(*block_schema, *projection, &key);
+  WARN_NOT_OK(s, "RowSerializer compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<RowSerializerFunctions> cached(
+    down_cast<RowSerializerFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new SerializerCompilationTask(*block_schema, *projection, &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "RowSerializer compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new RowSerializer(cached));
+  return true;
+}
+
+bool CompilationManager::RequestRowKeyCoder(const Schema* schema,
+                                            gscoped_ptr<RowKeyCoder>* out) {
+  faststring key;
+  Status s = RowKeyFunctions::EncodeKey(*schema, &key);
+  WARN_NOT_OK(s, "RowKeyCoder compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<RowKeyFunctions> cached(
+    down_cast<RowKeyFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(new RowKeyCompilationTask(*schema, &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "RowKeyCoder compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new RowKeyCoder(cached));
+  return true;
+}
+
+bool CompilationManager::RequestPredicateEvaluator(const Schema* projection,
+                                                   const vector<ColumnPredicate>& predicates,
+                                                   gscoped_ptr<PredicateEvaluator>* out) {
+  // Predicates which can't be compiled are evaluated by the caller; there's
+  // no need to warn about them.
+  vector<PredicateShape> shapes;
+  if (!PredicateEvaluatorFunctions::GetShapes(*projection, predicates, &shapes).ok()) {
+    return false;
+  }
+  faststring key;
+  Status s = PredicateEvaluatorFunctions::EncodeKey(*projection, shapes, &key);
+  WARN_NOT_OK(s, "PredicateEvaluator compilation request failed");
+  if (!s.ok()) return false;
+  query_counter_.Increment();
+
+  scoped_refptr<PredicateEvaluatorFunctions> cached(
+    down_cast<PredicateEvaluatorFunctions*>(cache_.Lookup(key).get()));
+
+  // If not cached, add a request to compilation pool
+  if (!cached) {
+    shared_ptr<Runnable> task(
+      new PredicateCompilationTask(*projection, std::move(shapes), &cache_, &generator_));
+    WARN_NOT_OK(pool_->Submit(task),
+                "PredicateEvaluator compilation request failed");
+    return false;
+  }
+
+  hit_counter_.Increment();
+
+  out->reset(new PredicateEvaluator(predicates, cached));
+  return true;
+}
+
 } // namespace codegen
 } // namespace kudu
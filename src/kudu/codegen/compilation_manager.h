@@ -18,6 +18,9 @@
 #ifndef KUDU_CODEGEN_COMPILATION_MANAGER_H
 #define KUDU_CODEGEN_COMPILATION_MANAGER_H
 
+#include <string>
+#include <vector>
+
 #include "kudu/codegen/code_generator.h"
 #include "kudu/codegen/code_cache.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -28,14 +31,19 @@
 
 namespace kudu {
 
+class ColumnPredicate;
 class Counter;
+class Env;
 class MetricEntity;
 class MetricRegistry;
 class ThreadPool;
 
 namespace codegen {
 
+class PredicateEvaluator;
+class RowKeyCoder;
 class RowProjector;
+class RowSerializer;
 
 // The compilation manager is a top-level class which manages the actual
 // delivery of a code generator's output by maintaining its own
@@ -76,9 +84,39 @@ class CompilationManager {
                            const Schema* projection,
                            gscoped_ptr<RowProjector>* out);
 
+  // Like RequestRowProjector(), but for a serializer of blocks of
+  // 'block_schema' into the row-wise wire format of 'projection' (see
+  // SerializeRowBlock() in common/wire_protocol.h).
+  bool RequestRowSerializer(const Schema* block_schema,
+                            const Schema* projection,
+                            gscoped_ptr<RowSerializer>* out);
+
+  // Like RequestRowProjector(), but for a coder of the keys of rows of
+  // 'schema' (see Schema::EncodeComparableKey() and Schema::Compare()).
+  bool RequestRowKeyCoder(const Schema* schema, gscoped_ptr<RowKeyCoder>* out);
+
+  // If a codegenned evaluator for predicates of the same shapes (see
+  // codegen::PredicateShape) over 'projection' is ready, then one
+  // evaluating 'predicates' is written to 'out' and true is returned.
+  // Otherwise, this enqueues a compilation task for the predicates' shapes
+  // and returns false, and the caller should evaluate the predicates itself.
+  // False is also returned if the predicates can't be compiled.
+  // Does not write to 'out' if false is returned.
+  //
+  // The predicates' values must outlive the evaluator.
+  bool RequestPredicateEvaluator(const Schema* projection,
+                                 const std::vector<ColumnPredicate>& predicates,
+                                 gscoped_ptr<PredicateEvaluator>* out);
+
   // Waits for all asynchronous compilation tasks to finish.
   void Wait();
 
+  // Persists compiled object code in 'dir', so that code which was compiled
+  // before a restart is loaded rather than compiled again (see
+  // PersistentObjectCache). Does nothing if --codegen_persistent_cache is
+  // false.
+  Status OpenPersistentCache(Env* env, const std::string& dir);
+
   // Sets up a metric registry to observe the compilation manager's metrics.
   // This method is used instead of registering a counter with a given
   // registry because the CompilationManager is a singleton and there would
@@ -18,6 +18,7 @@
 #include "kudu/codegen/module_builder.h"
 
 #include <cstdlib>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -27,6 +28,7 @@
 #include <llvm/Analysis/Passes.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
@@ -37,13 +39,16 @@
 #include <llvm/IRReader/IRReader.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_os_ostream.h>
+#include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/SourceMgr.h>
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 
+#include "kudu/codegen/object_cache.h"
 #include "kudu/codegen/precompiled.ll.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/status.h"
 
 #ifndef CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS
@@ -75,6 +80,7 @@ using llvm::Type;
 using llvm::Value;
 using std::move;
 using std::ostream;
+using std::shared_ptr;
 using std::string;
 using std::stringstream;
 using std::unique_ptr;
@@ -116,12 +122,47 @@ bool ModuleContains(const Module& m, const Function* fptr) {
   return false;
 }
 
+// The cache set with ModuleBuilder::SetObjectCache().
+simple_spinlock object_cache_lock;
+shared_ptr<PersistentObjectCache>* object_cache = new shared_ptr<PersistentObjectCache>();
+
+shared_ptr<PersistentObjectCache> GetObjectCache() {
+  std::lock_guard<simple_spinlock> l(object_cache_lock);
+  return *object_cache;
+}
+
+// Adapts a PersistentObjectCache to the compilation of one module by an
+// ExecutionEngine: hands out the object code that was found in the cache,
+// if any, and stores the object code compiled otherwise.
+class ModuleObjectCache : public llvm::ObjectCache {
+ public:
+  ModuleObjectCache(PersistentObjectCache* cache, string module_id,
+                    unique_ptr<llvm::MemoryBuffer> cached_object)
+    : cache_(cache),
+      module_id_(move(module_id)),
+      cached_object_(move(cached_object)) {}
+
+  void notifyObjectCompiled(const Module* m, llvm::MemoryBufferRef obj) override {
+    cache_->Store(module_id_, obj);
+  }
+
+  unique_ptr<llvm::MemoryBuffer> getObject(const Module* m) override {
+    return move(cached_object_);
+  }
+
+ private:
+  PersistentObjectCache* const cache_;
+  const string module_id_;
+  unique_ptr<llvm::MemoryBuffer> cached_object_;
+};
+
 } // anonymous namespace
 
 ModuleBuilder::ModuleBuilder()
   : state_(kUninitialized),
     context_(new LLVMContext()),
-    builder_(*context_) {}
+    builder_(*context_),
+    has_pointer_constants_(false) {}
 
 ModuleBuilder::~ModuleBuilder() {}
 
@@ -179,8 +220,9 @@ Type* ModuleBuilder::GetType(const string& name) {
   return CHECK_NOTNULL(module_->getTypeByName(name));
 }
 
-Value* ModuleBuilder::GetPointerValue(void* ptr) const {
+Value* ModuleBuilder::GetPointerValue(void* ptr) {
   CHECK_EQ(state_, kBuilding);
+  has_pointer_constants_ = true;
   // No direct way of creating constant pointer values in LLVM, so
   // first a constant int has to be created and then casted to a pointer
   IntegerType* llvm_uintptr_t = Type::getIntNTy(*context_, 8 * sizeof(ptr));
@@ -281,12 +323,33 @@ Status ModuleBuilder::Compile(unique_ptr<ExecutionEngine>* out) {
   }
   module->setDataLayout(target_->createDataLayout());
 
+  // Look for the object code of an identical module. If there is one, the
+  // module doesn't need to be optimized: the engine loads the object code
+  // instead of compiling it.
+  shared_ptr<PersistentObjectCache> persistent_cache;
+  if (!has_pointer_constants_) {
+    persistent_cache = GetObjectCache();
+  }
+  unique_ptr<ModuleObjectCache> module_cache;
+  bool is_cached = false;
+  if (persistent_cache) {
+    string module_id = PersistentObjectCache::ModuleId(GetGeneratedIR());
+    unique_ptr<llvm::MemoryBuffer> cached_object = persistent_cache->Load(module_id);
+    is_cached = cached_object != nullptr;
+    module_cache.reset(new ModuleObjectCache(persistent_cache.get(), move(module_id),
+                                             move(cached_object)));
+    local_engine->setObjectCache(module_cache.get());
+  }
+
 #if CODEGEN_MODULE_BUILDER_DO_OPTIMIZATIONS
-  DoOptimizations(local_engine.get(), module, GetFunctionNames());
+  if (!is_cached) {
+    DoOptimizations(local_engine.get(), module, GetFunctionNames());
+  }
 #endif
 
   // Compile the module
   local_engine->finalizeObject();
+  local_engine->setObjectCache(nullptr);
 
   // Satisfy the promises
   for (JITFuture& fut : futures_) {
@@ -316,6 +379,20 @@ TargetMachine* ModuleBuilder::GetTargetMachine() const {
   return CHECK_NOTNULL(target_);
 }
 
+void ModuleBuilder::SetObjectCache(shared_ptr<PersistentObjectCache> cache) {
+  std::lock_guard<simple_spinlock> l(object_cache_lock);
+  object_cache->swap(cache);
+}
+
+string ModuleBuilder::GetGeneratedIR() const {
+  string ir;
+  llvm::raw_string_ostream os(ir);
+  for (const JITFuture& fut : futures_) {
+    fut.llvm_f_->print(os);
+  }
+  return os.str();
+}
+
 vector<const char*> ModuleBuilder::GetFunctionNames() const {
   vector<const char*> ret;
   for (const JITFuture& fut : futures_) {
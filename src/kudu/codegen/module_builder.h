@@ -43,6 +43,8 @@ class Value;
 namespace kudu {
 namespace codegen {
 
+class PersistentObjectCache;
+
 // A ModuleBuilder provides an interface to generate code for procedures
 // given a CodeGenerator to refer to. Builder can be used to create multiple
 // functions. It is intended to make building functions easier than using
@@ -83,8 +85,10 @@ class ModuleBuilder {
   llvm::Type* GetType(const std::string& name);
   // Retrieve a precompiled function
   llvm::Function* GetFunction(const std::string& name);
-  // Get the LLVM wrapper for a constant pointer value of type i8*
-  llvm::Value* GetPointerValue(void* ptr) const;
+  // Get the LLVM wrapper for a constant pointer value of type i8*.
+  // Modules which embed pointers are never persisted, since the pointers
+  // are only valid in this process.
+  llvm::Value* GetPointerValue(void* ptr);
 
   LLVMBuilder* builder() { return &builder_; }
 
@@ -111,6 +115,11 @@ class ModuleBuilder {
   // the code will be freed.
   Status Compile(std::unique_ptr<llvm::ExecutionEngine>* out);
 
+  // Sets the cache consulted by Compile() for the object code of an
+  // identical module compiled earlier, and updated with newly compiled
+  // object code. NULL (the default) disables it.
+  static void SetObjectCache(std::shared_ptr<PersistentObjectCache> cache);
+
   // Retrieves the TargetMachine that the engine builder guessed was
   // the native target. Requires compilation is complete.
   // Pointer is valid while Compile()'s ExecutionEngine is.
@@ -135,6 +144,9 @@ class ModuleBuilder {
   // JITFutures. The pointers are valid so long as the futures_ vector's
   // elements have valid llvm::Function* values.
   std::vector<const char*> GetFunctionNames() const;
+  // Returns the IR of the promised functions, which (along with the
+  // precompiled IR) determines the module's object code.
+  std::string GetGeneratedIR() const;
 
   MBState state_;
   std::vector<JITFuture> futures_;
@@ -142,6 +154,7 @@ class ModuleBuilder {
   std::unique_ptr<llvm::Module> module_;
   LLVMBuilder builder_;
   llvm::TargetMachine* target_; // not owned
+  bool has_pointer_constants_;
 
   DISALLOW_COPY_AND_ASSIGN(ModuleBuilder);
 };
@@ -0,0 +1,163 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/object_cache.h"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glog/logging.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "kudu/codegen/precompiled.ll.h"
+#include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/path_util.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+const char* const kFingerprintFileName = "fingerprint";
+const char* const kObjectFileSuffix = ".o";
+const char* const kTmpFileSuffix = ".tmp";
+
+string ComputeFingerprint() {
+  vector<string> features;
+  llvm::StringMap<bool> cpu_features;
+  llvm::sys::getHostCPUFeatures(cpu_features);
+  for (const auto& entry : cpu_features) {
+    features.push_back(Substitute("$0$1", entry.second ? "+" : "-", entry.first().data()));
+  }
+  // The iteration order of a StringMap isn't specified.
+  std::sort(features.begin(), features.end());
+
+  // The precompiled IR is inlined into every module, so a build with
+  // different precompiled functions makes all the objects stale.
+  uint64_t precompiled_hash = CityHash64(precompiled_ll_data, precompiled_ll_len);
+  return Substitute("llvm=$0 cpu=$1 features=$2 precompiled=$3\n",
+                    LLVM_VERSION_STRING, llvm::sys::getHostCPUName().str(),
+                    JoinStrings(features, ","), precompiled_hash);
+}
+
+} // anonymous namespace
+
+PersistentObjectCache::PersistentObjectCache(Env* env, string dir)
+  : env_(env),
+    dir_(std::move(dir)),
+    num_hits_(0),
+    num_stores_(0) {
+}
+
+const string& PersistentObjectCache::Fingerprint() {
+  static const string* fingerprint = new string(ComputeFingerprint());
+  return *fingerprint;
+}
+
+Status PersistentObjectCache::Init() {
+  bool created;
+  RETURN_NOT_OK_PREPEND(env_util::CreateDirIfMissing(env_, dir_, &created),
+                        "Could not create code cache directory");
+
+  string fingerprint_path = JoinPathSegments(dir_, kFingerprintFileName);
+  if (!created && env_->FileExists(fingerprint_path)) {
+    faststring fingerprint;
+    RETURN_NOT_OK(ReadFileToString(env_, fingerprint_path, &fingerprint));
+    if (fingerprint.ToString() == Fingerprint()) {
+      return Status::OK();
+    }
+    LOG(INFO) << "Code cache in " << dir_ << " was built for " << fingerprint.ToString()
+              << "; discarding it";
+  }
+
+  // Objects from another build, LLVM version or CPU may not be loaded, so
+  // clear them out before recording the current fingerprint.
+  vector<string> children;
+  RETURN_NOT_OK(env_->GetChildren(dir_, &children));
+  for (const string& child : children) {
+    if (HasSuffixString(child, kObjectFileSuffix) || HasSuffixString(child, kTmpFileSuffix)) {
+      RETURN_NOT_OK(env_->DeleteFile(JoinPathSegments(dir_, child)));
+    }
+  }
+  return WriteStringToFile(env_, Fingerprint(), fingerprint_path);
+}
+
+string PersistentObjectCache::ModuleId(const string& generated_ir) {
+  // A collision would run the wrong code, so use a 128-bit hash.
+  uint128 hash = CityHash128WithSeed(generated_ir.data(), generated_ir.size(),
+                                     CityHash128(Fingerprint().data(), Fingerprint().size()));
+  return StringPrintf("%016llx%016llx",
+                      static_cast<unsigned long long>(Uint128High64(hash)), // NOLINT(*)
+                      static_cast<unsigned long long>(Uint128Low64(hash))); // NOLINT(*)
+}
+
+string PersistentObjectCache::ObjectPath(const string& module_id) const {
+  return JoinPathSegments(dir_, module_id + kObjectFileSuffix);
+}
+
+unique_ptr<llvm::MemoryBuffer> PersistentObjectCache::Load(const string& module_id) {
+  string path = ObjectPath(module_id);
+  if (!env_->FileExists(path)) {
+    return nullptr;
+  }
+  faststring object;
+  Status s = ReadFileToString(env_, path, &object);
+  if (!s.ok()) {
+    LOG(WARNING) << "Could not read cached object code: " << s.ToString();
+    return nullptr;
+  }
+  num_hits_.Increment();
+  return unique_ptr<llvm::MemoryBuffer>(llvm::MemoryBuffer::getMemBufferCopy(
+      llvm::StringRef(reinterpret_cast<const char*>(object.data()), object.size()),
+      module_id));
+}
+
+void PersistentObjectCache::Store(const string& module_id, llvm::MemoryBufferRef object) {
+  string path = ObjectPath(module_id);
+  string tmp_path = path + kTmpFileSuffix;
+  Status s = WriteStringToFile(env_, Slice(object.getBufferStart(), object.getBufferSize()),
+                               tmp_path);
+  if (s.ok()) {
+    s = env_->RenameFile(tmp_path, path);
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Could not store compiled object code: " << s.ToString();
+    WARN_NOT_OK(env_->DeleteFile(tmp_path), "Could not delete temporary object file");
+    return;
+  }
+  num_stores_.Increment();
+}
+
+} // namespace codegen
+} // namespace kudu
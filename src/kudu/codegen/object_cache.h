@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_OBJECT_CACHE_H
+#define KUDU_CODEGEN_OBJECT_CACHE_H
+
+#include <memory>
+#include <string>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class MemoryBuffer;
+class MemoryBufferRef;
+} // namespace llvm
+
+namespace kudu {
+
+class Env;
+
+namespace codegen {
+
+// Persists the object code of compiled modules in a directory, so that a
+// module which was compiled by an earlier run of the process is loaded
+// rather than optimized and compiled again.
+//
+// Modules are identified by a hash of the IR of their generated functions
+// (see ModuleId()). The directory also records the fingerprint of the build,
+// the LLVM version and the host CPU that its objects were compiled for;
+// objects compiled for a different fingerprint are removed by Init().
+//
+// Object files are written to a temporary name and renamed, so a crash
+// never leaves a partially written object behind.
+//
+// This class is thread-safe.
+class PersistentObjectCache {
+ public:
+  PersistentObjectCache(Env* env, std::string dir);
+
+  // Creates the directory if it's missing, and empties it if its objects
+  // were compiled for another fingerprint.
+  Status Init();
+
+  // Returns the identifier of a module whose generated functions have the
+  // given IR.
+  static std::string ModuleId(const std::string& generated_ir);
+
+  // Returns the object code previously stored for 'module_id', or NULL if
+  // there is none.
+  std::unique_ptr<llvm::MemoryBuffer> Load(const std::string& module_id);
+
+  // Stores the object code compiled for 'module_id'. Failures are logged
+  // and otherwise ignored: they only cost a compilation after a restart.
+  void Store(const std::string& module_id, llvm::MemoryBufferRef object);
+
+  int64_t num_hits() const { return num_hits_.Load(); }
+  int64_t num_stores() const { return num_stores_.Load(); }
+
+ private:
+  // Returns the build, LLVM and host CPU fingerprint.
+  static const std::string& Fingerprint();
+
+  std::string ObjectPath(const std::string& module_id) const;
+
+  Env* const env_;
+  const std::string dir_;
+  AtomicInt<int64_t> num_hits_;
+  AtomicInt<int64_t> num_stores_;
+
+  DISALLOW_COPY_AND_ASSIGN(PersistentObjectCache);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
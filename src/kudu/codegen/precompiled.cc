@@ -36,8 +36,10 @@
 #include <cstdlib>
 #include <cstring>
 
+#include "kudu/common/key_encoder.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/memory/arena.h"
 
 // Even though this file is only needed for IR purposes, we need to check for
@@ -64,6 +66,17 @@ extern "C" void *__dso_handle __attribute__((__visibility__("hidden"))) = NULL;
 
 namespace kudu {
 
+// A KeyEncoderTraits buffer which writes to memory that has already been
+// reserved, so that the cells of a key can be encoded without the capacity
+// checks of faststring::append().
+struct ReservedKeyBuffer {
+  void append(const char* data, size_t len) {
+    memcpy(pos, data, len);
+    pos += len;
+  }
+  uint8_t* pos;
+};
+
 // Returns whether copy was successful (fails iff slice relocation fails,
 // which can only occur if is_string is true).
 // If arena is NULL, then no relocation occurs.
@@ -160,5 +173,109 @@ IR_ALWAYS_INLINE void _PrecompiledCopyCellToRowBlockSetNull(
   dst->cell(col).set_null(is_null);
 }
 
+// Accessors used by the predicate evaluation functions.
+
+IR_ALWAYS_INLINE uint64_t _PrecompiledRowBlockNumRows(const RowBlock* block) {
+  return block->nrows();
+}
+
+IR_ALWAYS_INLINE uint8_t* _PrecompiledRowBlockColumnData(const RowBlock* block,
+                                                         uint64_t col) {
+  return block->column_data_base_ptr(col);
+}
+
+IR_ALWAYS_INLINE uint8_t* _PrecompiledRowBlockNullBitmap(const RowBlock* block,
+                                                         uint64_t col) {
+  return block->column_block(col).null_bitmap();
+}
+
+IR_ALWAYS_INLINE uint8_t* _PrecompiledRowBlockSelectionBitmap(RowBlock* block) {
+  return block->selection_vector()->mutable_bitmap();
+}
+
+IR_ALWAYS_INLINE bool _PrecompiledBitmapTest(const uint8_t* bitmap, uint64_t idx) {
+  return BitmapTest(bitmap, idx);
+}
+
+IR_ALWAYS_INLINE void _PrecompiledBitmapClear(uint8_t* bitmap, uint64_t idx) {
+  BitmapClear(bitmap, idx);
+}
+
+IR_ALWAYS_INLINE int32_t _PrecompiledCompareSlices(const uint8_t* cell, const void* value) {
+  return reinterpret_cast<const Slice*>(cell)->compare(*reinterpret_cast<const Slice*>(value));
+}
+
+// Helpers used by the row serialization functions. See SerializeRowBlock()
+// in common/wire_protocol.cc for the format.
+
+IR_ALWAYS_INLINE void _PrecompiledSerializeSlice(const uint8_t* src, uint8_t* dst,
+                                                 faststring* indirect_data) {
+  // The serialized slice points at its offset in the indirect data.
+  const Slice* slice = reinterpret_cast<const Slice*>(src);
+  size_t offset_in_indirect = indirect_data->size();
+  indirect_data->append(slice->data(), slice->size());
+  *reinterpret_cast<Slice*>(dst) = Slice(reinterpret_cast<const uint8_t*>(offset_in_indirect),
+                                         slice->size());
+}
+
+IR_ALWAYS_INLINE void _PrecompiledSerializeNullableSlice(const uint8_t* src, uint8_t* dst,
+                                                         faststring* indirect_data,
+                                                         bool not_null) {
+  if (not_null) {
+    _PrecompiledSerializeSlice(src, dst, indirect_data);
+  } else {
+    memset(dst, 0, sizeof(Slice));
+  }
+}
+
+IR_ALWAYS_INLINE void _PrecompiledSetSerializedNull(uint8_t* dst_row, uint64_t offset_to_bitmap,
+                                                    uint64_t col, bool is_null) {
+  BitmapChange(dst_row + offset_to_bitmap, col, is_null);
+}
+
+// Helpers used by the row key functions. See Schema::EncodeComparableKey()
+// for the format.
+
+IR_ALWAYS_INLINE uint8_t* _PrecompiledReserveKeyBytes(faststring* dst, uint64_t len) {
+  size_t old_size = dst->size();
+  dst->resize(old_size + len);
+  return dst->data() + old_size;
+}
+
+// Defines the functions which encode an integer key cell to 'dst', returning
+// the position after it, and which compare two integer key cells.
+#define KEY_CELL_FUNCTIONS(name, type)                                          \
+  IR_ALWAYS_INLINE uint8_t* _PrecompiledEncodeKey##name(const uint8_t* cell,    \
+                                                        uint8_t* dst) {         \
+    ReservedKeyBuffer buf = { dst };                                            \
+    KeyEncoderTraits<type, ReservedKeyBuffer>::Encode(cell, &buf);              \
+    return buf.pos;                                                             \
+  }                                                                             \
+  IR_ALWAYS_INLINE int32_t _PrecompiledCompareKey##name(const uint8_t* lhs,     \
+                                                        const uint8_t* rhs) {   \
+    typedef DataTypeTraits<type>::cpp_type cpp_type;                            \
+    cpp_type l, r;                                                              \
+    memcpy(&l, lhs, sizeof(l));                                                 \
+    memcpy(&r, rhs, sizeof(r));                                                 \
+    return l < r ? -1 : (l > r ? 1 : 0);                                        \
+  }
+
+KEY_CELL_FUNCTIONS(Uint8, UINT8)
+KEY_CELL_FUNCTIONS(Int8, INT8)
+KEY_CELL_FUNCTIONS(Uint16, UINT16)
+KEY_CELL_FUNCTIONS(Int16, INT16)
+KEY_CELL_FUNCTIONS(Uint32, UINT32)
+KEY_CELL_FUNCTIONS(Int32, INT32)
+KEY_CELL_FUNCTIONS(Uint64, UINT64)
+KEY_CELL_FUNCTIONS(Int64, INT64)
+
+#undef KEY_CELL_FUNCTIONS
+
+IR_ALWAYS_INLINE void _PrecompiledEncodeKeySlice(const uint8_t* cell, bool is_last,
+                                                 faststring* dst) {
+  KeyEncoderTraits<BINARY, faststring>::EncodeWithSeparators(
+      *reinterpret_cast<const Slice*>(cell), is_last, dst);
+}
+
 } // extern "C"
 } // namespace kudu
@@ -0,0 +1,462 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/predicate_evaluator.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class LLVMContext;
+} // namespace llvm
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PHINode;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// The IR values needed to evaluate one predicate on a row.
+struct PredicateValues {
+  Value* col_data;
+  Value* null_bitmap;
+  Value* lower;
+  Value* upper;
+};
+
+// Returns the LLVM type in which cells of the given physical type are
+// compared, or NULL for BINARY cells, which are compared out of line.
+Type* GetCellType(LLVMContext& context, const TypeInfo* type_info) {
+  switch (type_info->physical_type()) {
+    case FLOAT:
+      return Type::getFloatTy(context);
+    case DOUBLE:
+      return Type::getDoubleTy(context);
+    case BINARY:
+      return nullptr;
+    default:
+      return Type::getIntNTy(context, 8 * type_info->size());
+  }
+}
+
+bool IsUnsigned(DataType physical_type) {
+  switch (physical_type) {
+    case UINT8:
+    case UINT16:
+    case UINT32:
+    case UINT64:
+    case BOOL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Loads the bound pointed to by 'bound_ptr' into a register, or leaves it as
+// a pointer to a Slice for BINARY columns.
+Value* LoadBound(ModuleBuilder::LLVMBuilder* builder, Type* cell_type, Value* bound_ptr) {
+  if (cell_type == nullptr) {
+    return bound_ptr;
+  }
+  return builder->CreateLoad(
+      builder->CreateBitCast(bound_ptr, PointerType::getUnqual(cell_type)));
+}
+
+// Generates the comparison of 'cell' (a pointer to the cell) against 'bound'.
+// Returns an i1 which is true if the cell is at least the bound (if
+// 'at_least') or less than it (otherwise), or equal to it (if 'equal').
+Value* MakeComparison(ModuleBuilder* mbuilder, const ColumnSchema& col,
+                      Type* cell_type, Value* cell, Value* bound,
+                      bool equal, bool at_least) {
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  DataType physical_type = col.type_info()->physical_type();
+  if (cell_type == nullptr) {
+    Value* cmp = builder->CreateCall(mbuilder->GetFunction("_PrecompiledCompareSlices"),
+                                     vector<Value*>{ cell, bound });
+    Value* zero = builder->getInt32(0);
+    if (equal) return builder->CreateICmpEQ(cmp, zero);
+    return at_least ? builder->CreateICmpSGE(cmp, zero) : builder->CreateICmpSLT(cmp, zero);
+  }
+
+  Value* val = builder->CreateLoad(builder->CreateBitCast(cell, PointerType::getUnqual(cell_type)));
+  if (physical_type == FLOAT || physical_type == DOUBLE) {
+    if (equal) return builder->CreateFCmpOEQ(val, bound);
+    return at_least ? builder->CreateFCmpOGE(val, bound) : builder->CreateFCmpOLT(val, bound);
+  }
+  if (equal) return builder->CreateICmpEQ(val, bound);
+  if (IsUnsigned(physical_type)) {
+    return at_least ? builder->CreateICmpUGE(val, bound) : builder->CreateICmpULT(val, bound);
+  }
+  return at_least ? builder->CreateICmpSGE(val, bound) : builder->CreateICmpSLT(val, bound);
+}
+
+llvm::Function* MakeEvaluation(const string& name,
+                               ModuleBuilder* mbuilder,
+                               const Schema& projection,
+                               const vector<PredicateShape>& shapes) {
+  // Get the IRBuilder
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  // Create the function after providing a declaration
+  Type* block_type = PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlock"));
+  vector<Type*> argtypes = { block_type,
+                             PointerType::getUnqual(Type::getInt8PtrTy(context)) };
+  FunctionType* fty = FunctionType::get(Type::getVoidTy(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  // Get the function's Arguments
+  Function::arg_iterator it = f->arg_begin();
+  Argument* block = &*it++;
+  Argument* bounds = &*it++;
+  DCHECK(it == f->arg_end());
+
+  // Give names to the arguments for debugging IR.
+  block->setName("block");
+  bounds->setName("bounds");
+  f->setDoesNotAlias(1);
+  f->setDoesNotAlias(2);
+
+  // Evaluation function in IR (note: values in angle brackets are
+  // constants whose values are determined right now, at JIT time).
+  //
+  // define void @name(RowBlock* noalias %block, i8** noalias %bounds)
+  // entry:
+  //   %nrows = call i64 @_PrecompiledRowBlockNumRows(%block)
+  //   %sel = call i8* @_PrecompiledRowBlockSelectionBitmap(%block)
+  //   <for each predicate>
+  //     %data = call i8* @_PrecompiledRowBlockColumnData(%block, i64 <col>)
+  //     %nulls = call i8* @_PrecompiledRowBlockNullBitmap(...)*
+  //     %lower, %upper = <bounds loaded from %bounds>
+  //   <end implicit for each>
+  //   br loop
+  // loop:
+  //   %row = phi i64 [0, %entry], [%next_row, %next]
+  //   br (icmp uge %row, %nrows), exit, check_selected
+  // check_selected:
+  //   br (call @_PrecompiledBitmapTest(%sel, %row)), pred0, next
+  // <for each predicate k>
+  //   pred<k>:
+  //     <if nullable: branch to reject (or to pred<k+1> for IS NULL) on null>
+  //     <compare the cell at %data + %row * <size> against the bounds,
+  //      branching to reject on failure>
+  //     br pred<k+1> (the last one branches to next)
+  // <end implicit for each>
+  // reject:
+  //   call void @_PrecompiledBitmapClear(%sel, %row)
+  //   br next
+  // next:
+  //   %next_row = add i64 %row, 1
+  //   br loop
+  // exit:
+  //   ret void
+  //
+  // *Only for nullable columns.
+  Function* num_rows = mbuilder->GetFunction("_PrecompiledRowBlockNumRows");
+  Function* col_data = mbuilder->GetFunction("_PrecompiledRowBlockColumnData");
+  Function* null_bitmap = mbuilder->GetFunction("_PrecompiledRowBlockNullBitmap");
+  Function* sel_bitmap = mbuilder->GetFunction("_PrecompiledRowBlockSelectionBitmap");
+  Function* bitmap_test = mbuilder->GetFunction("_PrecompiledBitmapTest");
+  Function* bitmap_clear = mbuilder->GetFunction("_PrecompiledBitmapClear");
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* loop = BasicBlock::Create(context, "loop", f);
+  BasicBlock* check_selected = BasicBlock::Create(context, "check_selected", f);
+  vector<BasicBlock*> pred_blocks;
+  for (size_t i = 0; i < shapes.size(); i++) {
+    pred_blocks.push_back(BasicBlock::Create(context, StrCat("pred", i), f));
+  }
+  BasicBlock* reject = BasicBlock::Create(context, "reject", f);
+  BasicBlock* next = BasicBlock::Create(context, "next", f);
+  BasicBlock* exit = BasicBlock::Create(context, "exit", f);
+  pred_blocks.push_back(next);
+
+  // Everything which doesn't depend on the row is loaded once up front.
+  builder->SetInsertPoint(entry);
+  Value* nrows = builder->CreateCall(num_rows, vector<Value*>{ block });
+  nrows->setName("nrows");
+  Value* sel = builder->CreateCall(sel_bitmap, vector<Value*>{ block });
+  sel->setName("sel");
+  vector<PredicateValues> values;
+  int bound_idx = 0;
+  for (const PredicateShape& shape : shapes) {
+    const ColumnSchema& col = projection.column(shape.col_idx);
+    Type* cell_type = GetCellType(context, col.type_info());
+    Value* col_idx = builder->getInt64(shape.col_idx);
+    PredicateValues v = { nullptr, nullptr, nullptr, nullptr };
+    v.col_data = builder->CreateCall(col_data, vector<Value*>{ block, col_idx });
+    v.col_data->setName(StrCat("data_", shape.col_idx));
+    if (col.is_nullable()) {
+      v.null_bitmap = builder->CreateCall(null_bitmap, vector<Value*>{ block, col_idx });
+      v.null_bitmap->setName(StrCat("nulls_", shape.col_idx));
+    }
+    if (shape.has_lower) {
+      v.lower = LoadBound(builder, cell_type,
+                          builder->CreateLoad(builder->CreateConstGEP1_64(bounds, bound_idx++)));
+    }
+    if (shape.has_upper) {
+      v.upper = LoadBound(builder, cell_type,
+                          builder->CreateLoad(builder->CreateConstGEP1_64(bounds, bound_idx++)));
+    }
+    values.push_back(v);
+  }
+  builder->CreateBr(loop);
+
+  // Loop over the rows of the block.
+  builder->SetInsertPoint(loop);
+  PHINode* row = builder->CreatePHI(Type::getInt64Ty(context), 2, "row");
+  row->addIncoming(builder->getInt64(0), entry);
+  builder->CreateCondBr(builder->CreateICmpUGE(row, nrows), exit, check_selected);
+
+  // Rows that have already been filtered out don't need to be evaluated.
+  builder->SetInsertPoint(check_selected);
+  Value* selected = builder->CreateCall(bitmap_test, vector<Value*>{ sel, row });
+  builder->CreateCondBr(selected, pred_blocks[0], next);
+
+  for (size_t i = 0; i < shapes.size(); i++) {
+    const PredicateShape& shape = shapes[i];
+    const PredicateValues& v = values[i];
+    const ColumnSchema& col = projection.column(shape.col_idx);
+    Type* cell_type = GetCellType(context, col.type_info());
+    BasicBlock* pass = pred_blocks[i + 1];
+    builder->SetInsertPoint(pred_blocks[i]);
+
+    // A set bit in the null bitmap means that the cell is not null.
+    if (shape.predicate_type == PredicateType::IsNull ||
+        shape.predicate_type == PredicateType::IsNotNull) {
+      if (v.null_bitmap == nullptr) {
+        // An IS NOT NULL predicate on a non-nullable column always passes.
+        DCHECK(shape.predicate_type == PredicateType::IsNotNull);
+        builder->CreateBr(pass);
+        continue;
+      }
+      Value* not_null = builder->CreateCall(bitmap_test, vector<Value*>{ v.null_bitmap, row });
+      if (shape.predicate_type == PredicateType::IsNull) {
+        builder->CreateCondBr(not_null, reject, pass);
+      } else {
+        builder->CreateCondBr(not_null, pass, reject);
+      }
+      continue;
+    }
+
+    // Null cells never pass a comparison.
+    if (v.null_bitmap != nullptr) {
+      BasicBlock* compare = BasicBlock::Create(context, StrCat("pred", i, "_compare"), f, pass);
+      Value* not_null = builder->CreateCall(bitmap_test, vector<Value*>{ v.null_bitmap, row });
+      builder->CreateCondBr(not_null, compare, reject);
+      builder->SetInsertPoint(compare);
+    }
+
+    Value* offset = builder->CreateMul(row, builder->getInt64(col.type_info()->size()));
+    Value* cell = builder->CreateGEP(v.col_data, offset);
+    cell->setName(StrCat("cell_", shape.col_idx));
+    Value* result;
+    if (shape.predicate_type == PredicateType::Equality) {
+      result = MakeComparison(mbuilder, col, cell_type, cell, v.lower, true, false);
+    } else {
+      DCHECK(shape.predicate_type == PredicateType::Range);
+      result = builder->getInt1(true);
+      if (v.lower != nullptr) {
+        result = builder->CreateAnd(
+            result, MakeComparison(mbuilder, col, cell_type, cell, v.lower, false, true));
+      }
+      if (v.upper != nullptr) {
+        result = builder->CreateAnd(
+            result, MakeComparison(mbuilder, col, cell_type, cell, v.upper, false, false));
+      }
+    }
+    result->setName(StrCat("result_", i));
+    builder->CreateCondBr(result, pass, reject);
+  }
+
+  builder->SetInsertPoint(reject);
+  builder->CreateCall(bitmap_clear, vector<Value*>{ sel, row });
+  builder->CreateBr(next);
+
+  builder->SetInsertPoint(next);
+  Value* next_row = builder->CreateAdd(row, builder->getInt64(1), "next_row");
+  row->addIncoming(next_row, next);
+  builder->CreateBr(loop);
+
+  // Return
+  builder->SetInsertPoint(exit);
+  builder->CreateRetVoid();
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping predicate evaluation:";
+    f->dump();
+  }
+
+  return f;
+}
+
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+PredicateEvaluatorFunctions::PredicateEvaluatorFunctions(const Schema& projection,
+                                                         vector<PredicateShape> shapes,
+                                                         EvaluationFunction evaluate_f,
+                                                         unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    projection_(projection),
+    shapes_(std::move(shapes)),
+    evaluate_f_(evaluate_f) {
+  CHECK(evaluate_f != nullptr)
+    << "Promise to compile evaluation function not fulfilled by ModuleBuilder";
+}
+
+Status PredicateEvaluatorFunctions::Create(const Schema& projection,
+                                           const vector<PredicateShape>& shapes,
+                                           scoped_refptr<PredicateEvaluatorFunctions>* out,
+                                           llvm::TargetMachine** tm) {
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+
+  Function* evaluate = MakeEvaluation("PredEval", &builder, projection, shapes);
+
+  EvaluationFunction evaluate_f;
+  builder.AddJITPromise(evaluate, &evaluate_f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new PredicateEvaluatorFunctions(projection, shapes, evaluate_f,
+                                             std::move(owner)));
+  return Status::OK();
+}
+
+Status PredicateEvaluatorFunctions::GetShapes(const Schema& projection,
+                                              const vector<ColumnPredicate>& predicates,
+                                              vector<PredicateShape>* shapes) {
+  shapes->clear();
+  for (const ColumnPredicate& pred : predicates) {
+    int col_idx = projection.find_column(pred.column().name());
+    if (col_idx == Schema::kColumnNotFound) {
+      return Status::NotSupported("predicate column not in projection", pred.ToString());
+    }
+    if (!projection.column(col_idx).EqualsPhysicalType(pred.column())) {
+      return Status::NotSupported("predicate column type differs from projection",
+                                  pred.ToString());
+    }
+    PredicateShape shape = { static_cast<size_t>(col_idx), pred.predicate_type(),
+                             false, false };
+    switch (pred.predicate_type()) {
+      case PredicateType::Equality:
+        shape.has_lower = true;
+        break;
+      case PredicateType::Range:
+        shape.has_lower = pred.raw_lower() != nullptr;
+        shape.has_upper = pred.raw_upper() != nullptr;
+        break;
+      case PredicateType::IsNotNull:
+        break;
+      case PredicateType::IsNull:
+        // IS NULL predicates on non-nullable columns are simplified to None.
+        DCHECK(projection.column(col_idx).is_nullable());
+        break;
+      default:
+        return Status::NotSupported(
+            Substitute("predicate type can't be code-generated: $0", pred.ToString()));
+    }
+    shapes->push_back(shape);
+  }
+  return Status::OK();
+}
+
+Status PredicateEvaluatorFunctions::EncodeKey(const Schema& projection,
+                                              const vector<PredicateShape>& shapes,
+                                              faststring* out) {
+  AddNext(out, JITWrapper::PREDICATE_EVALUATOR);
+  AddNext(out, shapes.size());
+  for (const PredicateShape& shape : shapes) {
+    if (shape.col_idx >= projection.num_columns()) {
+      return Status::InvalidArgument("predicate column index out of range");
+    }
+    const ColumnSchema& col = projection.column(shape.col_idx);
+    AddNext(out, shape.col_idx);
+    AddNext(out, col.type_info()->physical_type());
+    AddNext(out, col.is_nullable());
+    AddNext(out, shape.predicate_type);
+    AddNext(out, shape.has_lower);
+    AddNext(out, shape.has_upper);
+  }
+  return Status::OK();
+}
+
+PredicateEvaluator::PredicateEvaluator(vector<ColumnPredicate> predicates,
+                                       const scoped_refptr<PredicateEvaluatorFunctions>& functions)
+  : predicates_(std::move(predicates)),
+    functions_(functions) {
+  // Lay out the bounds in the order the evaluation function expects them.
+  for (const ColumnPredicate& pred : predicates_) {
+    switch (pred.predicate_type()) {
+      case PredicateType::Equality:
+        bounds_.push_back(pred.raw_lower());
+        break;
+      case PredicateType::Range:
+        if (pred.raw_lower() != nullptr) bounds_.push_back(pred.raw_lower());
+        if (pred.raw_upper() != nullptr) bounds_.push_back(pred.raw_upper());
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+} // namespace codegen
+} // namespace kudu
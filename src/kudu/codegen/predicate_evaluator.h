@@ -0,0 +1,127 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_PREDICATE_EVALUATOR_H
+#define KUDU_CODEGEN_PREDICATE_EVALUATOR_H
+
+#include <memory>
+#include <vector>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/column_predicate.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+namespace codegen {
+
+// The part of a ColumnPredicate which determines the code evaluating it:
+// everything but the bound values, which are passed in at evaluation time.
+// Scans whose predicates have the same shapes share their compiled code.
+struct PredicateShape {
+  // The index of the predicated column in the projection.
+  size_t col_idx;
+  PredicateType predicate_type;
+  // Whether the predicate has a lower bound (or an equality value) and an
+  // upper bound, respectively.
+  bool has_lower;
+  bool has_upper;
+};
+
+// A conjunction of column predicates over a projection, fused into a single
+// function which is specialized for the types and nullability of the
+// predicated columns.
+class PredicateEvaluatorFunctions : public JITWrapper {
+ public:
+  // Evaluates the conjunction on every selected row of the block, clearing
+  // the selection vector bits of the rows which don't pass. The second
+  // argument holds the bound values: for each predicate in order, its lower
+  // bound (if it has one) followed by its upper bound (if it has one).
+  typedef void(*EvaluationFunction)(RowBlock*, const void* const*);
+
+  // Compiles the evaluator for the given predicate shapes over the
+  // projection. Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the functions to 'out' upon success.
+  static Status Create(const Schema& projection,
+                       const std::vector<PredicateShape>& shapes,
+                       scoped_refptr<PredicateEvaluatorFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  // Extracts the shapes of 'predicates' over 'projection' into 'shapes'.
+  // Returns Status::NotSupported if any of the predicates can't be compiled.
+  static Status GetShapes(const Schema& projection,
+                          const std::vector<ColumnPredicate>& predicates,
+                          std::vector<PredicateShape>* shapes);
+
+  EvaluationFunction evaluate() const { return evaluate_f_; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE {
+    return EncodeKey(projection_, shapes_, out);
+  }
+
+  static Status EncodeKey(const Schema& projection,
+                          const std::vector<PredicateShape>& shapes,
+                          faststring* out);
+
+ private:
+  PredicateEvaluatorFunctions(const Schema& projection,
+                              std::vector<PredicateShape> shapes,
+                              EvaluationFunction evaluate_f,
+                              std::unique_ptr<JITCodeOwner> owner);
+
+  const Schema projection_;
+  const std::vector<PredicateShape> shapes_;
+  const EvaluationFunction evaluate_f_;
+};
+
+// Evaluates a scan's conjunction of column predicates with codegenned
+// functions. Stands in for calling ColumnPredicate::Evaluate() on each of the
+// predicates in turn.
+class PredicateEvaluator {
+ public:
+  // Requires that the predicates' values remain valid for the lifetime of
+  // this object, and that 'functions' were compiled for the predicates'
+  // shapes over the evaluated blocks' schema.
+  PredicateEvaluator(std::vector<ColumnPredicate> predicates,
+                     const scoped_refptr<PredicateEvaluatorFunctions>& functions);
+
+  // Evaluates the predicates on the rows of 'block', and'ing the result into
+  // its selection vector.
+  void Evaluate(RowBlock* block) const {
+    functions_->evaluate()(block, bounds_.data());
+  }
+
+  const std::vector<ColumnPredicate>& predicates() const { return predicates_; }
+
+ private:
+  const std::vector<ColumnPredicate> predicates_;
+  std::vector<const void*> bounds_;
+  scoped_refptr<PredicateEvaluatorFunctions> functions_;
+
+  DISALLOW_COPY_AND_ASSIGN(PredicateEvaluator);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
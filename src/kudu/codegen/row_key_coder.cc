@@ -0,0 +1,327 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/row_key_coder.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/key_encoder.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class LLVMContext;
+} // namespace llvm
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PHINode;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+// Returns the suffix of the precompiled functions which encode and compare
+// integer key cells of the given physical type (see precompiled.cc).
+const char* IntegerKeyFunctionSuffix(DataType physical_type) {
+  switch (physical_type) {
+    case UINT8: return "Uint8";
+    case INT8: return "Int8";
+    case UINT16: return "Uint16";
+    case INT16: return "Int16";
+    case UINT32: return "Uint32";
+    case INT32: return "Int32";
+    case UINT64: return "Uint64";
+    case INT64: return "Int64";
+    default:
+      LOG(FATAL) << "not an integer key type: " << DataType_Name(physical_type);
+  }
+  return nullptr;
+}
+
+llvm::Function* MakeEncode(const string& name,
+                           ModuleBuilder* mbuilder,
+                           const Schema& key_schema) {
+  // Get the IRBuilder
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  // Create the function after providing a declaration
+  vector<Type*> argtypes = { Type::getInt8PtrTy(context),
+                             PointerType::getUnqual(mbuilder->GetType("class.kudu::faststring")) };
+  FunctionType* fty = FunctionType::get(Type::getVoidTy(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  // Get the function's Arguments
+  Function::arg_iterator it = f->arg_begin();
+  Argument* row = &*it++;
+  Argument* dst = &*it++;
+  DCHECK(it == f->arg_end());
+
+  // Give names to the arguments for debugging IR.
+  row->setName("row");
+  dst->setName("dst");
+  f->setDoesNotAlias(1);
+  f->setDoesNotAlias(2);
+
+  // Encoding function in IR (note: values in angle brackets are
+  // constants whose values are determined right now, at JIT time).
+  //
+  // define void @name(i8* noalias %row, faststring* noalias %dst)
+  // entry:
+  //   <for each key column, in order>
+  //     <if the first of a run of integer columns>
+  //       %pos = call i8* @_PrecompiledReserveKeyBytes(%dst, <run size>)
+  //     <if an integer column>
+  //       %pos = call i8* @_PrecompiledEncodeKey<type>(%row + <offset>, %pos)
+  //     <if a string column>
+  //       call void @_PrecompiledEncodeKeySlice(%row + <offset>, <is last>, %dst)
+  //   <end implicit for each>
+  //   ret void
+  //
+  // All of the helpers are inlined, so each integer cell turns into a load,
+  // a byte swap and a store.
+  Function* reserve = mbuilder->GetFunction("_PrecompiledReserveKeyBytes");
+  Function* encode_slice = mbuilder->GetFunction("_PrecompiledEncodeKeySlice");
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  builder->SetInsertPoint(entry);
+  size_t num_key_columns = key_schema.num_key_columns();
+  size_t col_idx = 0;
+  while (col_idx < num_key_columns) {
+    const ColumnSchema& col = key_schema.column(col_idx);
+    Value* cell = builder->CreateConstGEP1_64(row, key_schema.column_offset(col_idx));
+    if (col.type_info()->physical_type() == BINARY) {
+      bool is_last = col_idx == num_key_columns - 1;
+      builder->CreateCall(encode_slice, vector<Value*>{ cell, builder->getInt1(is_last), dst });
+      col_idx++;
+      continue;
+    }
+
+    // Reserve the space for the whole run of integers at once.
+    size_t run_end = col_idx;
+    size_t run_size = 0;
+    while (run_end < num_key_columns &&
+           key_schema.column(run_end).type_info()->physical_type() != BINARY) {
+      run_size += key_schema.column(run_end).type_info()->size();
+      run_end++;
+    }
+    Value* pos = builder->CreateCall(reserve, vector<Value*>{ dst, builder->getInt64(run_size) });
+    for (; col_idx < run_end; col_idx++) {
+      DataType type = key_schema.column(col_idx).type_info()->physical_type();
+      Function* encode_int = mbuilder->GetFunction(
+          StrCat("_PrecompiledEncodeKey", IntegerKeyFunctionSuffix(type)));
+      cell = builder->CreateConstGEP1_64(row, key_schema.column_offset(col_idx));
+      pos = builder->CreateCall(encode_int, vector<Value*>{ cell, pos });
+    }
+  }
+  builder->CreateRetVoid();
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping key encoding:";
+    f->dump();
+  }
+
+  return f;
+}
+
+llvm::Function* MakeCompare(const string& name,
+                            ModuleBuilder* mbuilder,
+                            const Schema& key_schema) {
+  // Get the IRBuilder
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  // Create the function after providing a declaration
+  Type* block_type = PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlock"));
+  vector<Type*> argtypes = { block_type, Type::getInt64Ty(context),
+                             block_type, Type::getInt64Ty(context) };
+  FunctionType* fty = FunctionType::get(Type::getInt32Ty(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  // Get the function's Arguments
+  Function::arg_iterator it = f->arg_begin();
+  Argument* lhs_block = &*it++;
+  Argument* lhs_idx = &*it++;
+  Argument* rhs_block = &*it++;
+  Argument* rhs_idx = &*it++;
+  DCHECK(it == f->arg_end());
+
+  // Give names to the arguments for debugging IR.
+  lhs_block->setName("lhs_block");
+  lhs_idx->setName("lhs_idx");
+  rhs_block->setName("rhs_block");
+  rhs_idx->setName("rhs_idx");
+
+  // Comparison function in IR (note: values in angle brackets are
+  // constants whose values are determined right now, at JIT time).
+  //
+  // define i32 @name(RowBlock* %lhs_block, i64 %lhs_idx,
+  //                  RowBlock* %rhs_block, i64 %rhs_idx)
+  // <for each key column k>
+  //   col<k>:
+  //     %lhs = call i8* @_PrecompiledRowBlockColumnData(%lhs_block, <k>)
+  //              + %lhs_idx * <size>
+  //     %rhs = <likewise>
+  //     %cmp = call i32 @_PrecompiledCompareKey<type>(%lhs, %rhs)*
+  //     br (icmp ne %cmp, 0), done, col<k+1> (the last one branches to done)
+  // <end implicit for each>
+  // done:
+  //   %result = phi i32 [%cmp, col<k>]...
+  //   ret %result
+  //
+  // *@_PrecompiledCompareSlices for string key columns.
+  Function* col_data = mbuilder->GetFunction("_PrecompiledRowBlockColumnData");
+
+  size_t num_key_columns = key_schema.num_key_columns();
+  vector<BasicBlock*> col_blocks;
+  for (size_t i = 0; i < num_key_columns; i++) {
+    col_blocks.push_back(BasicBlock::Create(context, StrCat("col", i), f));
+  }
+  BasicBlock* done = BasicBlock::Create(context, "done", f);
+
+  builder->SetInsertPoint(done);
+  PHINode* result = builder->CreatePHI(Type::getInt32Ty(context), num_key_columns, "result");
+  builder->CreateRet(result);
+
+  for (size_t i = 0; i < num_key_columns; i++) {
+    const TypeInfo* type_info = key_schema.column(i).type_info();
+    builder->SetInsertPoint(col_blocks[i]);
+    Value* col_idx = builder->getInt64(i);
+    Value* size = builder->getInt64(type_info->size());
+    Value* lhs = builder->CreateGEP(
+        builder->CreateCall(col_data, vector<Value*>{ lhs_block, col_idx }),
+        builder->CreateMul(lhs_idx, size));
+    Value* rhs = builder->CreateGEP(
+        builder->CreateCall(col_data, vector<Value*>{ rhs_block, col_idx }),
+        builder->CreateMul(rhs_idx, size));
+    Function* compare = mbuilder->GetFunction(
+        type_info->physical_type() == BINARY ?
+        string("_PrecompiledCompareSlices") :
+        StrCat("_PrecompiledCompareKey", IntegerKeyFunctionSuffix(type_info->physical_type())));
+    Value* cmp = builder->CreateCall(compare, vector<Value*>{ lhs, rhs });
+    cmp->setName(StrCat("cmp_", i));
+    result->addIncoming(cmp, col_blocks[i]);
+    if (i == num_key_columns - 1) {
+      builder->CreateBr(done);
+    } else {
+      builder->CreateCondBr(builder->CreateICmpNE(cmp, builder->getInt32(0)),
+                            done, col_blocks[i + 1]);
+    }
+  }
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping key comparison:";
+    f->dump();
+  }
+
+  return f;
+}
+
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+RowKeyFunctions::RowKeyFunctions(const Schema& key_schema,
+                                 EncodeFunction encode_f,
+                                 CompareFunction compare_f,
+                                 unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    key_schema_(key_schema),
+    encode_f_(encode_f),
+    compare_f_(compare_f) {
+  CHECK(encode_f != nullptr)
+    << "Promise to compile key encoding function not fulfilled by ModuleBuilder";
+  CHECK(compare_f != nullptr)
+    << "Promise to compile key comparison function not fulfilled by ModuleBuilder";
+}
+
+Status RowKeyFunctions::Create(const Schema& schema, scoped_refptr<RowKeyFunctions>* out,
+                               llvm::TargetMachine** tm) {
+  Schema key_schema = schema.CreateKeyProjection();
+  for (const ColumnSchema& col : key_schema.columns()) {
+    if (!IsTypeAllowableInKey(col.type_info()) || col.is_nullable()) {
+      return Status::InvalidArgument(
+          Substitute("unsupported key column: $0", col.ToString()));
+    }
+  }
+
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+
+  Function* encode = MakeEncode("EncodeKey", &builder, key_schema);
+  Function* compare = MakeCompare("CompareKeys", &builder, key_schema);
+
+  EncodeFunction encode_f;
+  CompareFunction compare_f;
+  builder.AddJITPromise(encode, &encode_f);
+  builder.AddJITPromise(compare, &compare_f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new RowKeyFunctions(key_schema, encode_f, compare_f, std::move(owner)));
+  return Status::OK();
+}
+
+Status RowKeyFunctions::EncodeKey(const Schema& schema, faststring* out) {
+  AddNext(out, JITWrapper::ROW_KEY_CODER);
+  AddNext(out, schema.num_key_columns());
+  for (size_t i = 0; i < schema.num_key_columns(); i++) {
+    AddNext(out, schema.column(i).type_info()->physical_type());
+  }
+  return Status::OK();
+}
+
+} // namespace codegen
+} // namespace kudu
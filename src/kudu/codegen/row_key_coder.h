@@ -0,0 +1,115 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_ROW_KEY_CODER_H
+#define KUDU_CODEGEN_ROW_KEY_CODER_H
+
+#include <memory>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/row.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+namespace codegen {
+
+// Codegenned equivalents of Schema::EncodeComparableKey() and
+// Schema::Compare() for a particular sequence of key column types. The
+// per-column dispatch on the types is done once, at compile time, and the
+// cell offsets are compiled in as constants.
+//
+// Since the key columns come first in a schema, their layout only depends
+// on the key columns themselves, so schemas which share the key column
+// types share these functions.
+class RowKeyFunctions : public JITWrapper {
+ public:
+  // Appends the encoded key of the contiguous row pointed to by the first
+  // argument to the faststring.
+  typedef void(*EncodeFunction)(const uint8_t*, faststring*);
+
+  // Compares the keys of two rows of row blocks, given as (block, index)
+  // pairs. Returns a negative, zero or positive value like Schema::Compare().
+  typedef int32_t(*CompareFunction)(const RowBlock*, size_t, const RowBlock*, size_t);
+
+  // Compiles the key functions for the key columns of 'schema'. Writes the
+  // llvm::TargetMachine* used to 'tm' (if not NULL) and the functions to
+  // 'out' upon success.
+  static Status Create(const Schema& schema, scoped_refptr<RowKeyFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  const Schema& key_schema() const { return key_schema_; }
+  EncodeFunction encode() const { return encode_f_; }
+  CompareFunction compare() const { return compare_f_; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE {
+    return EncodeKey(key_schema_, out);
+  }
+
+  static Status EncodeKey(const Schema& schema, faststring* out);
+
+ private:
+  RowKeyFunctions(const Schema& key_schema, EncodeFunction encode_f,
+                  CompareFunction compare_f, std::unique_ptr<JITCodeOwner> owner);
+
+  const Schema key_schema_;
+  const EncodeFunction encode_f_;
+  const CompareFunction compare_f_;
+};
+
+// Encodes and compares row keys with codegenned functions. Stands in for
+// Schema::EncodeComparableKey() and Schema::Compare() for rows of schemas
+// whose key column types are the ones the functions were compiled for.
+class RowKeyCoder {
+ public:
+  explicit RowKeyCoder(const scoped_refptr<RowKeyFunctions>& functions)
+    : functions_(functions) {}
+
+  // Same contract as Schema::EncodeComparableKey().
+  Slice EncodeComparableKey(const ConstContiguousRow& row, faststring* dst) const {
+    DCHECK_EQ(functions_->key_schema().num_key_columns(), row.schema()->num_key_columns());
+    dst->clear();
+    functions_->encode()(row.row_data(), dst);
+    return Slice(*dst);
+  }
+
+  // Same contract as Schema::Compare().
+  int Compare(const RowBlockRow& lhs, const RowBlockRow& rhs) const {
+    DCHECK_EQ(functions_->key_schema().num_key_columns(), lhs.schema()->num_key_columns());
+    DCHECK_EQ(functions_->key_schema().num_key_columns(), rhs.schema()->num_key_columns());
+    return functions_->compare()(lhs.row_block(), lhs.row_index(),
+                                 rhs.row_block(), rhs.row_index());
+  }
+
+ private:
+  scoped_refptr<RowKeyFunctions> functions_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowKeyCoder);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
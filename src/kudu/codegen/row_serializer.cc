@@ -0,0 +1,376 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/codegen/row_serializer.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Argument.h>
+#include <llvm/IR/BasicBlock.h>
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Type.h>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/codegen/module_builder.h"
+#include "kudu/common/row.h"
+#include "kudu/common/schema.h"
+#include "kudu/common/wire_protocol.pb.h"
+#include "kudu/gutil/strings/strcat.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class LLVMContext;
+} // namespace llvm
+
+using llvm::Argument;
+using llvm::BasicBlock;
+using llvm::ConstantInt;
+using llvm::Function;
+using llvm::FunctionType;
+using llvm::LLVMContext;
+using llvm::PHINode;
+using llvm::PointerType;
+using llvm::Type;
+using llvm::Value;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+
+DECLARE_bool(codegen_dump_functions);
+
+namespace kudu {
+namespace codegen {
+
+namespace {
+
+llvm::Function* MakeSerialization(const string& name,
+                                  ModuleBuilder* mbuilder,
+                                  const Schema& block_schema,
+                                  const Schema& projection) {
+  // Get the IRBuilder
+  ModuleBuilder::LLVMBuilder* builder = mbuilder->builder();
+  LLVMContext& context = builder->getContext();
+
+  // Create the function after providing a declaration
+  vector<Type*> argtypes = { PointerType::getUnqual(mbuilder->GetType("class.kudu::RowBlock")),
+                             Type::getInt8PtrTy(context),
+                             PointerType::getUnqual(mbuilder->GetType("class.kudu::faststring")) };
+  FunctionType* fty = FunctionType::get(Type::getVoidTy(context), argtypes, false);
+  Function* f = mbuilder->Create(fty, name);
+
+  // Get the function's Arguments
+  Function::arg_iterator it = f->arg_begin();
+  Argument* block = &*it++;
+  Argument* dst_base = &*it++;
+  Argument* indirect = &*it++;
+  DCHECK(it == f->arg_end());
+
+  // Give names to the arguments for debugging IR.
+  block->setName("block");
+  dst_base->setName("dst_base");
+  indirect->setName("indirect");
+  f->setDoesNotAlias(1);
+  f->setDoesNotAlias(2);
+  f->setDoesNotAlias(3);
+
+  // Serialization function in IR (note: values in angle brackets are
+  // constants whose values are determined right now, at JIT time).
+  //
+  // define void @name(RowBlock* noalias %block, i8* noalias %dst_base,
+  //                   faststring* noalias %indirect)
+  // entry:
+  //   %nrows = call i64 @_PrecompiledRowBlockNumRows(%block)
+  //   %sel = call i8* @_PrecompiledRowBlockSelectionBitmap(%block)
+  //   <for each serialized column>
+  //     %data = call i8* @_PrecompiledRowBlockColumnData(%block, i64 <block col>)
+  //     %nulls = call i8* @_PrecompiledRowBlockNullBitmap(...)*
+  //   <end implicit for each>
+  //   br loop
+  // loop:
+  //   %row = phi i64 [0, %entry], [%next_row, %next]
+  //   %dst = phi i8* [%dst_base, %entry], [%next_dst, %next]
+  //   br (icmp uge %row, %nrows), exit, check_selected
+  // check_selected:
+  //   br (call @_PrecompiledBitmapTest(%sel, %row)), copy, next
+  // copy:
+  //   <for each serialized column>
+  //     %src_cell = getelementptr i8* %data, i64 (%row * <cell size>)
+  //     %dst_cell = getelementptr i8* %dst, i64 <offset in projection row>
+  //     <if binary>
+  //       call void @_PrecompiledSerializeSlice(%src_cell, %dst_cell, %indirect)**
+  //     <else>
+  //       %val = load i<8 * cell size>, %src_cell
+  //       store %val, %dst_cell***
+  //     <end implicit if>
+  //     call void @_PrecompiledSetSerializedNull(
+  //       %dst, i64 <offset to bitmap>, i64 <projection col>, %is_null)*
+  //   <end implicit for each>
+  //   %copied_dst = getelementptr i8* %dst, i64 <row stride>
+  //   br next
+  // next:
+  //   %next_dst = phi i8* [%dst, check_selected], [%copied_dst, %copy]
+  //   %next_row = add i64 %row, 1
+  //   br loop
+  // exit:
+  //   ret void
+  //
+  // *Only for nullable columns.
+  // **@_PrecompiledSerializeNullableSlice for nullable columns, which also
+  // takes whether the cell is non-null.
+  // ***For nullable columns, null cells are written as zeros using a select
+  // rather than a branch.
+  Function* num_rows = mbuilder->GetFunction("_PrecompiledRowBlockNumRows");
+  Function* col_data = mbuilder->GetFunction("_PrecompiledRowBlockColumnData");
+  Function* null_bitmap = mbuilder->GetFunction("_PrecompiledRowBlockNullBitmap");
+  Function* sel_bitmap = mbuilder->GetFunction("_PrecompiledRowBlockSelectionBitmap");
+  Function* bitmap_test = mbuilder->GetFunction("_PrecompiledBitmapTest");
+  Function* serialize_slice = mbuilder->GetFunction("_PrecompiledSerializeSlice");
+  Function* serialize_nullable_slice =
+    mbuilder->GetFunction("_PrecompiledSerializeNullableSlice");
+  Function* set_null = mbuilder->GetFunction("_PrecompiledSetSerializedNull");
+
+  BasicBlock* entry = BasicBlock::Create(context, "entry", f);
+  BasicBlock* loop = BasicBlock::Create(context, "loop", f);
+  BasicBlock* check_selected = BasicBlock::Create(context, "check_selected", f);
+  BasicBlock* copy = BasicBlock::Create(context, "copy", f);
+  BasicBlock* next = BasicBlock::Create(context, "next", f);
+  BasicBlock* exit = BasicBlock::Create(context, "exit", f);
+
+  // The bitmap for a contiguous row goes after the row data
+  // See common/row.h ContiguousRowHelper class
+  size_t row_stride = ContiguousRowHelper::row_size(projection);
+  size_t offset_to_null_bitmap = projection.byte_size();
+  RowSerializerFunctions::ColumnMapping mapping =
+    RowSerializerFunctions::GetColumnMapping(block_schema, projection);
+
+  // Everything which doesn't depend on the row is loaded once up front.
+  builder->SetInsertPoint(entry);
+  Value* nrows = builder->CreateCall(num_rows, vector<Value*>{ block });
+  nrows->setName("nrows");
+  Value* sel = builder->CreateCall(sel_bitmap, vector<Value*>{ block });
+  sel->setName("sel");
+  vector<Value*> data;
+  vector<Value*> nulls;
+  for (const auto& map : mapping) {
+    size_t block_idx = map.second;
+    Value* col_idx = builder->getInt64(block_idx);
+    Value* d = builder->CreateCall(col_data, vector<Value*>{ block, col_idx });
+    d->setName(StrCat("data_", block_idx));
+    data.push_back(d);
+    Value* n = nullptr;
+    if (block_schema.column(block_idx).is_nullable()) {
+      n = builder->CreateCall(null_bitmap, vector<Value*>{ block, col_idx });
+      n->setName(StrCat("nulls_", block_idx));
+    }
+    nulls.push_back(n);
+  }
+  builder->CreateBr(loop);
+
+  // Loop over the rows of the block.
+  builder->SetInsertPoint(loop);
+  PHINode* row = builder->CreatePHI(Type::getInt64Ty(context), 2, "row");
+  PHINode* dst = builder->CreatePHI(Type::getInt8PtrTy(context), 2, "dst");
+  row->addIncoming(builder->getInt64(0), entry);
+  dst->addIncoming(dst_base, entry);
+  builder->CreateCondBr(builder->CreateICmpUGE(row, nrows), exit, check_selected);
+
+  // Unselected rows aren't serialized.
+  builder->SetInsertPoint(check_selected);
+  Value* selected = builder->CreateCall(bitmap_test, vector<Value*>{ sel, row });
+  builder->CreateCondBr(selected, copy, next);
+
+  // Copy each of the columns of the row with straight-line code.
+  builder->SetInsertPoint(copy);
+  for (size_t i = 0; i < mapping.size(); i++) {
+    size_t proj_idx = mapping[i].first;
+    size_t block_idx = mapping[i].second;
+    const ColumnSchema& col = block_schema.column(block_idx);
+    size_t size = col.type_info()->size();
+
+    Value* src_cell = builder->CreateGEP(data[i], builder->CreateMul(row, builder->getInt64(size)));
+    src_cell->setName(StrCat("src_cell_", block_idx));
+    Value* dst_cell = builder->CreateConstGEP1_64(dst, projection.column_offset(proj_idx));
+    dst_cell->setName(StrCat("dst_cell_", proj_idx));
+
+    // A set bit in the null bitmap means that the cell is not null.
+    Value* not_null = nullptr;
+    if (nulls[i] != nullptr) {
+      not_null = builder->CreateCall(bitmap_test, vector<Value*>{ nulls[i], row });
+      not_null->setName(StrCat("not_null_", block_idx));
+    }
+
+    if (col.type_info()->physical_type() == BINARY) {
+      if (not_null != nullptr) {
+        builder->CreateCall(serialize_nullable_slice,
+                            vector<Value*>{ src_cell, dst_cell, indirect, not_null });
+      } else {
+        builder->CreateCall(serialize_slice, vector<Value*>{ src_cell, dst_cell, indirect });
+      }
+    } else {
+      // Fixed-width cells are moved as integers of the same width. The
+      // output rows are packed, so the stores may be unaligned.
+      Type* cell_type = Type::getIntNTy(context, 8 * size);
+      Value* val = builder->CreateAlignedLoad(
+          builder->CreateBitCast(src_cell, PointerType::getUnqual(cell_type)), 1);
+      if (not_null != nullptr) {
+        val = builder->CreateSelect(not_null, val, ConstantInt::get(cell_type, 0));
+      }
+      builder->CreateAlignedStore(
+          val, builder->CreateBitCast(dst_cell, PointerType::getUnqual(cell_type)), 1);
+    }
+
+    if (not_null != nullptr) {
+      builder->CreateCall(set_null, vector<Value*>{ dst,
+                                                    builder->getInt64(offset_to_null_bitmap),
+                                                    builder->getInt64(proj_idx),
+                                                    builder->CreateNot(not_null) });
+    }
+  }
+  Value* copied_dst = builder->CreateConstGEP1_64(dst, row_stride);
+  copied_dst->setName("copied_dst");
+  builder->CreateBr(next);
+
+  builder->SetInsertPoint(next);
+  PHINode* next_dst = builder->CreatePHI(Type::getInt8PtrTy(context), 2, "next_dst");
+  next_dst->addIncoming(dst, check_selected);
+  next_dst->addIncoming(copied_dst, copy);
+  Value* next_row = builder->CreateAdd(row, builder->getInt64(1), "next_row");
+  row->addIncoming(next_row, next);
+  dst->addIncoming(next_dst, next);
+  builder->CreateBr(loop);
+
+  // Return
+  builder->SetInsertPoint(exit);
+  builder->CreateRetVoid();
+
+  if (FLAGS_codegen_dump_functions) {
+    LOG(INFO) << "Dumping row serialization:";
+    f->dump();
+  }
+
+  return f;
+}
+
+template<typename T>
+void AddNext(faststring* fs, const T& val) {
+  fs->append(&val, sizeof(T));
+}
+
+} // anonymous namespace
+
+RowSerializerFunctions::RowSerializerFunctions(const Schema& block_schema,
+                                               const Schema& projection,
+                                               SerializationFunction serialize_f,
+                                               unique_ptr<JITCodeOwner> owner)
+  : JITWrapper(std::move(owner)),
+    block_schema_(block_schema),
+    projection_(projection),
+    serialize_f_(serialize_f) {
+  CHECK(serialize_f != nullptr)
+    << "Promise to compile serialization function not fulfilled by ModuleBuilder";
+}
+
+Status RowSerializerFunctions::Create(const Schema& block_schema,
+                                      const Schema& projection,
+                                      scoped_refptr<RowSerializerFunctions>* out,
+                                      llvm::TargetMachine** tm) {
+  for (const auto& map : GetColumnMapping(block_schema, projection)) {
+    if (!block_schema.column(map.second).EqualsPhysicalType(projection.column(map.first))) {
+      return Status::InvalidArgument("projection column type differs from block column",
+                                     projection.column(map.first).ToString());
+    }
+  }
+
+  ModuleBuilder builder;
+  RETURN_NOT_OK(builder.Init());
+
+  Function* serialize = MakeSerialization("SerializeRows", &builder, block_schema, projection);
+
+  SerializationFunction serialize_f;
+  builder.AddJITPromise(serialize, &serialize_f);
+
+  unique_ptr<JITCodeOwner> owner;
+  RETURN_NOT_OK(builder.Compile(&owner));
+
+  if (tm) {
+    *tm = builder.GetTargetMachine();
+  }
+  out->reset(new RowSerializerFunctions(block_schema, projection, serialize_f,
+                                        std::move(owner)));
+  return Status::OK();
+}
+
+RowSerializerFunctions::ColumnMapping RowSerializerFunctions::GetColumnMapping(
+    const Schema& block_schema, const Schema& projection) {
+  ColumnMapping mapping;
+  for (size_t block_idx = 0; block_idx < block_schema.num_columns(); block_idx++) {
+    int proj_idx = projection.find_column(block_schema.column(block_idx).name());
+    if (proj_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    mapping.emplace_back(proj_idx, block_idx);
+  }
+  return mapping;
+}
+
+Status RowSerializerFunctions::EncodeKey(const Schema& block_schema, const Schema& projection,
+                                         faststring* out) {
+  AddNext(out, JITWrapper::ROW_SERIALIZER);
+  AddNext(out, block_schema.num_columns());
+  for (const ColumnSchema& col : block_schema.columns()) {
+    AddNext(out, col.type_info()->physical_type());
+    AddNext(out, col.is_nullable());
+  }
+  AddNext(out, projection.num_columns());
+  for (const ColumnSchema& col : projection.columns()) {
+    AddNext(out, col.type_info()->physical_type());
+    AddNext(out, col.is_nullable());
+  }
+  ColumnMapping mapping = GetColumnMapping(block_schema, projection);
+  AddNext(out, mapping.size());
+  for (const auto& map : mapping) {
+    AddNext(out, map);
+  }
+  return Status::OK();
+}
+
+RowSerializer::RowSerializer(const scoped_refptr<RowSerializerFunctions>& functions)
+  : functions_(functions),
+    row_stride_(ContiguousRowHelper::row_size(functions->projection())) {}
+
+void RowSerializer::SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
+                                      faststring* data_buf, faststring* indirect_data) const {
+  DCHECK_GT(block.nrows(), 0);
+  size_t old_size = data_buf->size();
+  int num_rows = block.selection_vector()->CountSelected();
+  data_buf->resize(old_size + row_stride_ * num_rows);
+  uint8_t* base = reinterpret_cast<uint8_t*>(&(*data_buf)[old_size]);
+  functions_->serialize()(&block, base, indirect_data);
+  rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
+}
+
+} // namespace codegen
+} // namespace kudu
@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CODEGEN_ROW_SERIALIZER_H
+#define KUDU_CODEGEN_ROW_SERIALIZER_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "kudu/codegen/jit_wrapper.h"
+#include "kudu/common/rowblock.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/status.h"
+
+namespace llvm {
+class TargetMachine;
+} // namespace llvm
+
+namespace kudu {
+
+class RowwiseRowBlockPB;
+class faststring;
+
+namespace codegen {
+
+// Codegenned equivalent of SerializeRowBlock() (see common/wire_protocol.h)
+// for a particular block schema and client projection: the cell sizes, the
+// offsets within the output rows and the nullability of the columns are all
+// compiled in as constants.
+class RowSerializerFunctions : public JITWrapper {
+ public:
+  // Pairs of (projection column index, block column index).
+  typedef std::vector<std::pair<size_t, size_t>> ColumnMapping;
+
+  // Writes the selected rows of the block, back to back, to the buffer
+  // starting at the second argument, in the row-wise wire format of the
+  // projection. Indirect data is appended to the faststring.
+  typedef void(*SerializationFunction)(const RowBlock*, uint8_t*, faststring*);
+
+  // Compiles the serializer for blocks of 'block_schema' projected to
+  // 'projection'. Writes the llvm::TargetMachine* used to 'tm' (if not NULL)
+  // and the functions to 'out' upon success.
+  static Status Create(const Schema& block_schema, const Schema& projection,
+                       scoped_refptr<RowSerializerFunctions>* out,
+                       llvm::TargetMachine** tm = NULL);
+
+  // Returns the projection columns which are serialized and the block
+  // columns they are serialized from. Block columns which aren't in the
+  // projection are skipped, as are projection columns which aren't in the
+  // block.
+  static ColumnMapping GetColumnMapping(const Schema& block_schema, const Schema& projection);
+
+  const Schema& block_schema() const { return block_schema_; }
+  const Schema& projection() const { return projection_; }
+  SerializationFunction serialize() const { return serialize_f_; }
+
+  virtual Status EncodeOwnKey(faststring* out) OVERRIDE {
+    return EncodeKey(block_schema_, projection_, out);
+  }
+
+  static Status EncodeKey(const Schema& block_schema, const Schema& projection,
+                          faststring* out);
+
+ private:
+  RowSerializerFunctions(const Schema& block_schema, const Schema& projection,
+                         SerializationFunction serialize_f,
+                         std::unique_ptr<JITCodeOwner> owner);
+
+  const Schema block_schema_, projection_;
+  const SerializationFunction serialize_f_;
+};
+
+class RowSerializer {
+ public:
+  // Requires that 'functions' were compiled for schemas with the same
+  // physical layout as the serialized blocks and the projection.
+  explicit RowSerializer(const scoped_refptr<RowSerializerFunctions>& functions);
+
+  // Same contract as SerializeRowBlock(), for the block and projection
+  // schemas the functions were compiled for.
+  void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
+                         faststring* data_buf, faststring* indirect_data) const;
+
+ private:
+  scoped_refptr<RowSerializerFunctions> functions_;
+  const size_t row_stride_;
+
+  DISALLOW_COPY_AND_ASSIGN(RowSerializer);
+};
+
+} // namespace codegen
+} // namespace kudu
+
+#endif
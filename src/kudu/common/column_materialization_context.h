@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#pragma once
+
+#include <cstddef>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+
+class ColumnBlock;
+class ColumnPredicate;
+class SelectionVector;
+
+// Describes the materialization of a single column of a batch, passed down
+// from the MaterializingIterator through the columnwise iterators to the
+// cfile block decoders.
+//
+// If the context carries a predicate, lower layers may evaluate it while
+// decoding (for example once per dictionary code or once per RLE run instead
+// of once per cell), clearing the bits of non-matching rows in the selection
+// vector. Cells of rows which are filtered this way may be left with
+// placeholder values.
+//
+// Any layer which cannot evaluate the predicate, or which may change the cell
+// values after they are decoded (e.g. a DeltaApplier with updates to apply),
+// must call SetDecoderEvalNotSupported(). In that case the caller is
+// responsible for evaluating the predicate after materialization.
+//
+// If skip_unselected_rows() is set, the rows which are unselected in the
+// selection vector on entry are never going to be looked at by the caller,
+// so lower layers may avoid decoding them altogether (late materialization).
+// The contents of such cells are unspecified; in nullable columns they are
+// marked NULL.
+class ColumnMaterializationContext {
+ public:
+  ColumnMaterializationContext(size_t col_idx,
+                               const ColumnPredicate* pred,
+                               ColumnBlock* block,
+                               SelectionVector* sel)
+      : col_idx_(col_idx),
+        pred_(pred),
+        block_(block),
+        sel_(sel),
+        decoder_eval_supported_(pred != nullptr),
+        skip_unselected_rows_(false) {
+  }
+
+  // The column index within the projection of the iterator.
+  size_t col_idx() const { return col_idx_; }
+
+  // The predicate to evaluate, or nullptr if there is none.
+  const ColumnPredicate* pred() const { return pred_; }
+
+  // The destination block for the materialized column.
+  ColumnBlock* block() { return block_; }
+
+  // The selection vector of the batch.
+  SelectionVector* sel() { return sel_; }
+
+  // Disables decoder-level evaluation of the predicate for this column.
+  void SetDecoderEvalNotSupported() {
+    decoder_eval_supported_ = false;
+  }
+
+  // Returns true if the predicate may be (and has been, once materialization
+  // completes) evaluated during decoding.
+  bool DecoderEvalSupported() const {
+    return decoder_eval_supported_;
+  }
+
+  // Allows rows which are unselected on entry to be left undecoded.
+  // Requires a selection vector.
+  void set_skip_unselected_rows(bool skip) {
+    DCHECK(sel_ != nullptr || !skip);
+    skip_unselected_rows_ = skip;
+  }
+
+  bool skip_unselected_rows() const {
+    return skip_unselected_rows_;
+  }
+
+ private:
+  const size_t col_idx_;
+  const ColumnPredicate* const pred_;
+  ColumnBlock* const block_;
+  SelectionVector* const sel_;
+  bool decoder_eval_supported_;
+  bool skip_unselected_rows_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnMaterializationContext);
+};
+
+} // namespace kudu
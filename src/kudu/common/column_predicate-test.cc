@@ -21,8 +21,11 @@
 #include <gtest/gtest.h>
 #include <vector>
 
+#include "kudu/common/columnblock.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/util/random.h"
 #include "kudu/util/test_util.h"
 
 namespace kudu {
@@ -227,6 +230,69 @@ class TestColumnPredicate : public KuduTest {
               ColumnPredicate::Range(column, &values[0], &values[2]),
               PredicateType::Range);
   }
+
+  // Test that evaluating the predicate on a block of randomly generated values
+  // matches a cell-by-cell evaluation using the type's comparator.
+  template <DataType Type>
+  void TestEvaluate(const ColumnPredicate& predicate, size_t nrows) {
+    typedef typename TypeTraits<Type>::cpp_type cpp_type;
+    const TypeInfo* type_info = GetTypeInfo(Type);
+    Random rand(SeedRandom());
+
+    ScopedColumnBlock<Type> block(nrows);
+    for (size_t i = 0; i < nrows; i++) {
+      block[i] = static_cast<cpp_type>(rand.Uniform(16));
+      block.SetCellIsNull(i, rand.OneIn(4));
+    }
+
+    SelectionVector sel(nrows);
+    SelectionVector expected(nrows);
+    sel.SetAllTrue();
+    for (size_t i = 0; i < nrows; i++) {
+      if (rand.OneIn(4)) sel.SetRowUnselected(i);
+    }
+    memcpy(expected.mutable_bitmap(), sel.bitmap(), BitmapSize(nrows));
+
+    for (size_t i = 0; i < nrows; i++) {
+      const void* cell = block.nullable_cell_ptr(i);
+      bool matches;
+      if (cell == nullptr) {
+        matches = false;
+      } else if (predicate.predicate_type() == PredicateType::Equality) {
+        matches = type_info->Compare(cell, predicate.raw_lower()) == 0;
+      } else {
+        matches = (predicate.raw_lower() == nullptr ||
+                   type_info->Compare(cell, predicate.raw_lower()) >= 0) &&
+                  (predicate.raw_upper() == nullptr ||
+                   type_info->Compare(cell, predicate.raw_upper()) < 0);
+      }
+      if (!matches) expected.SetRowUnselected(i);
+    }
+
+    predicate.Evaluate(block, &sel);
+    for (size_t i = 0; i < nrows; i++) {
+      ASSERT_EQ(expected.IsRowSelected(i), sel.IsRowSelected(i))
+          << predicate.ToString() << ", row " << i;
+    }
+  }
+
+  template <DataType Type>
+  void TestEvaluateCombinations() {
+    typedef typename TypeTraits<Type>::cpp_type cpp_type;
+    ColumnSchema column("c", Type, true);
+    cpp_type three = 3;
+    cpp_type seven = 7;
+    cpp_type twelve = 12;
+
+    // Exercise blocks which are smaller than, equal to, and not a multiple of
+    // the batch size.
+    for (size_t nrows : { 1, 7, 64, 100, 1000 }) {
+      TestEvaluate<Type>(ColumnPredicate::Equality(column, &seven), nrows);
+      TestEvaluate<Type>(ColumnPredicate::Range(column, &three, &twelve), nrows);
+      TestEvaluate<Type>(ColumnPredicate::Range(column, &three, nullptr), nrows);
+      TestEvaluate<Type>(ColumnPredicate::Range(column, nullptr, &twelve), nrows);
+    }
+  }
 };
 
 TEST_F(TestColumnPredicate, TestMerge) {
@@ -250,6 +316,175 @@ TEST_F(TestColumnPredicate, TestMerge) {
                                       });
 }
 
+TEST_F(TestColumnPredicate, TestEvaluate) {
+  TestEvaluateCombinations<INT8>();
+  TestEvaluateCombinations<INT16>();
+  TestEvaluateCombinations<INT32>();
+  TestEvaluateCombinations<INT64>();
+  TestEvaluateCombinations<TIMESTAMP>();
+  TestEvaluateCombinations<FLOAT>();
+  TestEvaluateCombinations<DOUBLE>();
+}
+
+// Test that the IN list constructor sorts and deduplicates the values, and
+// simplifies small lists.
+TEST_F(TestColumnPredicate, TestInListConstructor) {
+  ColumnSchema column("c", INT32);
+  int32_t one = 1;
+  int32_t two = 2;
+  int32_t three = 3;
+
+  vector<const void*> values;
+  ASSERT_EQ(PredicateType::None, ColumnPredicate::InList(column, &values).predicate_type());
+
+  values = { &one };
+  ASSERT_EQ(ColumnPredicate::Equality(column, &one), ColumnPredicate::InList(column, &values));
+  ASSERT_TRUE(values.empty());
+
+  int32_t other_one = 1;
+  values = { &one, &other_one };
+  ASSERT_EQ(ColumnPredicate::Equality(column, &one), ColumnPredicate::InList(column, &values));
+
+  values = { &three, &one, &two, &one };
+  ColumnPredicate in_list = ColumnPredicate::InList(column, &values);
+  ASSERT_EQ(PredicateType::InList, in_list.predicate_type());
+  ASSERT_EQ(3, in_list.raw_values().size());
+  ASSERT_EQ(1, *static_cast<const int32_t*>(in_list.raw_values()[0]));
+  ASSERT_EQ(2, *static_cast<const int32_t*>(in_list.raw_values()[1]));
+  ASSERT_EQ(3, *static_cast<const int32_t*>(in_list.raw_values()[2]));
+  ASSERT_EQ("`c` IN (1, 2, 3)", in_list.ToString());
+}
+
+// Test merging IN list and IS NULL predicates with the other predicate types.
+TEST_F(TestColumnPredicate, TestMergeInListAndIsNull) {
+  ColumnSchema column("c", INT32, true);
+  vector<int32_t> v { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+  auto in_list = [&] (vector<const void*> values) {
+    return ColumnPredicate::InList(column, &values);
+  };
+
+  // { 1, 3, 5 } AND [2, 6) = { 3, 5 }
+  TestMerge(in_list({ &v[1], &v[3], &v[5] }),
+            ColumnPredicate::Range(column, &v[2], &v[6]),
+            in_list({ &v[3], &v[5] }),
+            PredicateType::InList);
+
+  // { 1, 3, 5 } AND [2, 4) = 3
+  TestMerge(in_list({ &v[1], &v[3], &v[5] }),
+            ColumnPredicate::Range(column, &v[2], &v[4]),
+            ColumnPredicate::Equality(column, &v[3]),
+            PredicateType::Equality);
+
+  // { 1, 3 } AND [4, ...) = None
+  TestMerge(in_list({ &v[1], &v[3] }),
+            ColumnPredicate::Range(column, &v[4], nullptr),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // { 1, 3, 5 } AND 3 = 3
+  TestMerge(in_list({ &v[1], &v[3], &v[5] }),
+            ColumnPredicate::Equality(column, &v[3]),
+            ColumnPredicate::Equality(column, &v[3]),
+            PredicateType::Equality);
+
+  // { 1, 3, 5 } AND 4 = None
+  TestMerge(in_list({ &v[1], &v[3], &v[5] }),
+            ColumnPredicate::Equality(column, &v[4]),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // { 1, 3, 5 } AND { 3, 5, 7 } = { 3, 5 }
+  TestMerge(in_list({ &v[1], &v[3], &v[5] }),
+            in_list({ &v[3], &v[5], &v[7] }),
+            in_list({ &v[3], &v[5] }),
+            PredicateType::InList);
+
+  // { 1, 3 } AND { 5, 7 } = None
+  TestMerge(in_list({ &v[1], &v[3] }),
+            in_list({ &v[5], &v[7] }),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // { 1, 3 } AND IS NOT NULL = { 1, 3 }
+  TestMerge(in_list({ &v[1], &v[3] }),
+            ColumnPredicate::IsNotNull(column),
+            in_list({ &v[1], &v[3] }),
+            PredicateType::InList);
+
+  // { 1, 3 } AND IS NULL = None
+  TestMerge(in_list({ &v[1], &v[3] }),
+            ColumnPredicate::IsNull(column),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // IS NULL AND IS NULL = IS NULL
+  TestMerge(ColumnPredicate::IsNull(column),
+            ColumnPredicate::IsNull(column),
+            ColumnPredicate::IsNull(column),
+            PredicateType::IsNull);
+
+  // IS NULL AND IS NOT NULL = None
+  TestMerge(ColumnPredicate::IsNull(column),
+            ColumnPredicate::IsNotNull(column),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // IS NULL AND 1 = None
+  TestMerge(ColumnPredicate::IsNull(column),
+            ColumnPredicate::Equality(column, &v[1]),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // IS NULL AND [1, 3) = None
+  TestMerge(ColumnPredicate::IsNull(column),
+            ColumnPredicate::Range(column, &v[1], &v[3]),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // IS NULL AND None = None
+  TestMerge(ColumnPredicate::IsNull(column),
+            ColumnPredicate::None(column),
+            ColumnPredicate::None(column),
+            PredicateType::None);
+
+  // IS NULL on a non-nullable column is None.
+  ASSERT_EQ(PredicateType::None,
+            ColumnPredicate::IsNull(ColumnSchema("c", INT32)).predicate_type());
+}
+
+// Test evaluating IN list and IS NULL predicates.
+TEST_F(TestColumnPredicate, TestEvaluateInListAndIsNull) {
+  ColumnSchema column("c", INT32, true);
+  const size_t kNumRows = 20;
+  ScopedColumnBlock<INT32> block(kNumRows);
+  for (int32_t i = 0; i < kNumRows; i++) {
+    block[i] = i;
+    block.SetCellIsNull(i, i % 3 == 0);
+  }
+
+  int32_t one = 1;
+  int32_t three = 3;
+  int32_t four = 4;
+  int32_t nineteen = 19;
+  vector<const void*> values { &nineteen, &three, &one, &four };
+  ColumnPredicate in_list = ColumnPredicate::InList(column, &values);
+  SelectionVector sel(kNumRows);
+  sel.SetAllTrue();
+  in_list.Evaluate(block, &sel);
+  for (int32_t i = 0; i < kNumRows; i++) {
+    bool expected = i == 1 || i == 4 || i == 19;
+    ASSERT_EQ(expected, sel.IsRowSelected(i)) << "row " << i;
+  }
+
+  ColumnPredicate is_null = ColumnPredicate::IsNull(column);
+  sel.SetAllTrue();
+  is_null.Evaluate(block, &sel);
+  for (int32_t i = 0; i < kNumRows; i++) {
+    ASSERT_EQ(i % 3 == 0, sel.IsRowSelected(i)) << "row " << i;
+  }
+}
+
 // Test that the range constructor handles equality and empty ranges.
 TEST_F(TestColumnPredicate, TestRangeConstructor) {
   {
@@ -17,15 +17,22 @@
 
 #include "kudu/common/column_predicate.h"
 
+#include <emmintrin.h>
+
+#include <algorithm>
 #include <utility>
 
 #include "kudu/common/key_util.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/types.h"
+#include "kudu/gutil/cpu.h"
+#include "kudu/gutil/port.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/memory/arena.h"
 
 using std::move;
+using std::vector;
 
 namespace kudu {
 
@@ -112,6 +119,32 @@ ColumnPredicate ColumnPredicate::IsNotNull(ColumnSchema column) {
   return ColumnPredicate(PredicateType::IsNotNull, move(column), nullptr, nullptr);
 }
 
+ColumnPredicate ColumnPredicate::IsNull(ColumnSchema column) {
+  if (!column.is_nullable()) {
+    return None(move(column));
+  }
+  return ColumnPredicate(PredicateType::IsNull, move(column), nullptr, nullptr);
+}
+
+ColumnPredicate ColumnPredicate::InList(ColumnSchema column, vector<const void*>* values) {
+  CHECK(values != nullptr);
+
+  // Sort the values and remove duplicates.
+  auto less = [&column] (const void* a, const void* b) {
+    return column.type_info()->Compare(a, b) < 0;
+  };
+  auto equal = [&column] (const void* a, const void* b) {
+    return column.type_info()->Compare(a, b) == 0;
+  };
+  std::sort(values->begin(), values->end(), less);
+  values->erase(std::unique(values->begin(), values->end(), equal), values->end());
+
+  ColumnPredicate pred(PredicateType::InList, move(column), nullptr, nullptr);
+  pred.values_.swap(*values);
+  pred.Simplify();
+  return pred;
+}
+
 ColumnPredicate ColumnPredicate::None(ColumnSchema column) {
   return ColumnPredicate(PredicateType::None, move(column), nullptr, nullptr);
 }
@@ -120,13 +153,15 @@ void ColumnPredicate::SetToNone() {
   predicate_type_ = PredicateType::None;
   lower_ = nullptr;
   upper_ = nullptr;
+  values_.clear();
 }
 
 void ColumnPredicate::Simplify() {
   switch (predicate_type_) {
     case PredicateType::None:
     case PredicateType::Equality:
-    case PredicateType::IsNotNull: return;
+    case PredicateType::IsNotNull:
+    case PredicateType::IsNull: return;
     case PredicateType::Range: {
       if (lower_ != nullptr && upper_ != nullptr) {
         if (column_.type_info()->Compare(lower_, upper_) >= 0) {
@@ -140,6 +175,18 @@ void ColumnPredicate::Simplify() {
       }
       return;
     };
+    case PredicateType::InList: {
+      if (values_.empty()) {
+        // If the list is empty then no results can be returned.
+        SetToNone();
+      } else if (values_.size() == 1) {
+        // List has only one value, so convert to an equality predicate.
+        predicate_type_ = PredicateType::Equality;
+        lower_ = values_[0];
+        values_.clear();
+      }
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -157,15 +204,25 @@ void ColumnPredicate::Merge(const ColumnPredicate& other) {
       return;
     };
     case PredicateType::IsNotNull: {
-      // NOT NULL is less selective than all other predicate types, so the
-      // intersection of NOT NULL with any other predicate is just the other
-      // predicate.
-      //
-      // Note: this will no longer be true when an IS NULL predicate type is
-      // added.
-      predicate_type_ = other.predicate_type_;
-      lower_ = other.lower_;
-      upper_ = other.upper_;
+      // NOT NULL is less selective than all other predicate types except
+      // IS NULL, so the intersection of NOT NULL with any other predicate is
+      // just the other predicate, or None in the case of IS NULL.
+      if (other.predicate_type_ == PredicateType::IsNull) {
+        SetToNone();
+      } else {
+        predicate_type_ = other.predicate_type_;
+        lower_ = other.lower_;
+        upper_ = other.upper_;
+        values_ = other.values_;
+      }
+      return;
+    };
+    case PredicateType::IsNull: {
+      MergeIntoIsNull(other);
+      return;
+    };
+    case PredicateType::InList: {
+      MergeIntoInList(other);
       return;
     };
   }
@@ -199,8 +256,7 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
     };
 
     case PredicateType::Equality: {
-      if (column_.type_info()->Compare(lower_, other.lower_) > 0 ||
-          column_.type_info()->Compare(upper_, other.lower_) <= 0) {
+      if (!CheckValueInRange(other.lower_)) {
         // The equality value does not fall in this range.
         SetToNone();
       } else {
@@ -211,6 +267,26 @@ void ColumnPredicate::MergeIntoRange(const ColumnPredicate& other) {
       return;
     };
     case PredicateType::IsNotNull: return;
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::InList: {
+      // The merged predicate is the subset of the list values which fall in
+      // this range.
+      vector<const void*> values;
+      for (const void* value : other.values_) {
+        if (CheckValueInRange(value)) {
+          values.push_back(value);
+        }
+      }
+      predicate_type_ = PredicateType::InList;
+      lower_ = nullptr;
+      upper_ = nullptr;
+      values_.swap(values);
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -224,8 +300,7 @@ void ColumnPredicate::MergeIntoEquality(const ColumnPredicate& other) {
       return;
     }
     case PredicateType::Range: {
-      if (column_.type_info()->Compare(lower_, other.lower_) < 0 ||
-          column_.type_info()->Compare(lower_, other.upper_) >= 0) {
+      if (!other.CheckValueInRange(lower_)) {
         // This equality value does not fall in the other range.
         SetToNone();
       }
@@ -238,41 +313,297 @@ void ColumnPredicate::MergeIntoEquality(const ColumnPredicate& other) {
       return;
     };
     case PredicateType::IsNotNull: return;
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::InList: {
+      if (!other.CheckValueInList(lower_)) {
+        // This equality value does not fall in the other list.
+        SetToNone();
+      }
+      return;
+    };
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
+void ColumnPredicate::MergeIntoIsNull(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::IsNull);
+
+  // IS NULL is only satisfied by null values, which no other predicate type
+  // matches.
+  if (other.predicate_type() != PredicateType::IsNull) {
+    SetToNone();
+  }
+}
+
+void ColumnPredicate::MergeIntoInList(const ColumnPredicate& other) {
+  CHECK(predicate_type_ == PredicateType::InList);
+
+  switch (other.predicate_type()) {
+    case PredicateType::None:
+    case PredicateType::IsNull: {
+      SetToNone();
+      return;
+    };
+    case PredicateType::Range: {
+      // Only keep the list values which fall in the other range.
+      values_.erase(std::remove_if(values_.begin(), values_.end(),
+                                   [&other] (const void* value) {
+                                     return !other.CheckValueInRange(value);
+                                   }),
+                    values_.end());
+      Simplify();
+      return;
+    };
+    case PredicateType::Equality: {
+      if (CheckValueInList(other.lower_)) {
+        predicate_type_ = PredicateType::Equality;
+        lower_ = other.lower_;
+        values_.clear();
+      } else {
+        SetToNone();
+      }
+      return;
+    };
+    case PredicateType::IsNotNull: return;
+    case PredicateType::InList: {
+      // Both lists are sorted, so the intersection can be done in one pass.
+      vector<const void*> values;
+      auto this_it = values_.begin();
+      auto other_it = other.values_.begin();
+      while (this_it != values_.end() && other_it != other.values_.end()) {
+        int cmp = column_.type_info()->Compare(*this_it, *other_it);
+        if (cmp < 0) {
+          ++this_it;
+        } else if (cmp > 0) {
+          ++other_it;
+        } else {
+          values.push_back(*this_it);
+          ++this_it;
+          ++other_it;
+        }
+      }
+      values_.swap(values);
+      Simplify();
+      return;
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
 
+bool ColumnPredicate::CheckValueInRange(const void* value) const {
+  DCHECK(predicate_type_ == PredicateType::Range);
+  return (lower_ == nullptr || column_.type_info()->Compare(lower_, value) <= 0) &&
+         (upper_ == nullptr || column_.type_info()->Compare(upper_, value) > 0);
+}
+
+bool ColumnPredicate::CheckValueInList(const void* value) const {
+  DCHECK(predicate_type_ == PredicateType::InList);
+  return std::binary_search(values_.begin(), values_.end(), value,
+                            [this] (const void* lhs, const void* rhs) {
+                              return this->column_.type_info()->Compare(lhs, rhs) < 0;
+                            });
+}
+
 namespace {
 template <typename P>
 void ApplyPredicate(const ColumnBlock& block, SelectionVector* sel, P p) {
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
   if (block.is_nullable()) {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
-      const void *cell = block.nullable_cell_ptr(i);
-      if (cell == nullptr || !p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
+    BitmapForEachSetBit(sel_bitmap, block.nrows(), [&](size_t i) {
+        const void *cell = block.nullable_cell_ptr(i);
+        if (cell == nullptr || !p(cell)) {
+          BitmapClear(sel_bitmap, i);
+        }
+      });
+  } else {
+    BitmapForEachSetBit(sel_bitmap, block.nrows(), [&](size_t i) {
+        const void *cell = block.cell_ptr(i);
+        if (!p(cell)) {
+          BitmapClear(sel_bitmap, i);
+        }
+      });
+  }
+}
+
+// The number of rows evaluated per iteration of the batch kernels. Must be a
+// multiple of 16 so that the per-row match bytes can be packed into bitmap
+// bytes with 128-bit operations.
+const size_t kBatchRows = 64;
+
+// Packs kBatchRows match bytes (each 0 or 1) into kBatchRows / 8 bitmap bytes.
+ATTRIBUTE_ALWAYS_INLINE
+inline void PackMatches(const uint8_t* matches, uint8_t* bits) {
+  const __m128i zero = _mm_setzero_si128();
+  for (size_t i = 0; i < kBatchRows; i += 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(matches + i));
+    // Turn each 0x01 into 0xff so that movemask picks it up from the high bit.
+    uint16_t mask = _mm_movemask_epi8(_mm_sub_epi8(zero, v));
+    memcpy(bits + i / 8, &mask, sizeof(mask));
+  }
+}
+
+// Evaluates the predicate 'p' on every cell of a block of fixed-width values,
+// ANDing the results (and the block's non-null bits) into 'sel'.
+//
+// Unlike ApplyPredicate, the predicate is evaluated for all rows regardless of
+// the current selection, kBatchRows at a time. Each batch is first evaluated
+// into one byte per row with a straight-line loop which the compiler can
+// vectorize for the instruction set of the calling kernel, and then packed
+// into selection bits.
+template <DataType PhysicalType, typename P>
+ATTRIBUTE_ALWAYS_INLINE
+inline void ApplyPredicateBatch(const ColumnBlock& block, SelectionVector* sel, P p) {
+  typedef typename DataTypeTraits<PhysicalType>::cpp_type cpp_type;
+  const cpp_type* data = reinterpret_cast<const cpp_type*>(block.data());
+  const uint8_t* null_bitmap = block.null_bitmap();
+  uint8_t* sel_bitmap = sel->mutable_bitmap();
+  const size_t nrows = block.nrows();
+
+  uint8_t matches[kBatchRows];
+  uint8_t match_bits[kBatchRows / 8];
+  for (size_t offset = 0; offset < nrows; offset += kBatchRows) {
+    const cpp_type* cells = data + offset;
+    const size_t n = std::min(kBatchRows, nrows - offset);
+    if (PREDICT_TRUE(n == kBatchRows)) {
+      for (size_t i = 0; i < kBatchRows; i++) {
+        matches[i] = p(cells[i]);
+      }
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        matches[i] = p(cells[i]);
       }
+      // Rows past the end of the block must leave their selection bits alone.
+      memset(matches + n, 1, kBatchRows - n);
     }
-  } else {
-    for (size_t i = 0; i < block.nrows(); i++) {
-      if (!sel->IsRowSelected(i)) continue;
-      const void *cell = block.cell_ptr(i);
-      if (!p(cell)) {
-        BitmapClear(sel->mutable_bitmap(), i);
+    PackMatches(matches, match_bits);
+
+    const size_t n_bytes = BitmapSize(n);
+    if (null_bitmap != nullptr) {
+      const uint8_t* null_bytes = null_bitmap + offset / 8;
+      for (size_t i = 0; i < n_bytes; i++) {
+        match_bits[i] &= null_bytes[i];
       }
+      if (n % 8 != 0) {
+        // The null bitmap bits past the end of the block are undefined.
+        match_bits[n_bytes - 1] |= static_cast<uint8_t>(0xff << (n % 8));
+      }
+    }
+    uint8_t* sel_bytes = sel_bitmap + offset / 8;
+    for (size_t i = 0; i < n_bytes; i++) {
+      sel_bytes[i] &= match_bits[i];
     }
   }
 }
+
+template <DataType PhysicalType, typename P>
+void ApplyPredicateBatchSSE4(const ColumnBlock& block, SelectionVector* sel, P p) {
+  ApplyPredicateBatch<PhysicalType>(block, sel, p);
+}
+
+// The same kernel as above, compiled for AVX2. Only called when the CPU
+// supports it.
+template <DataType PhysicalType, typename P>
+__attribute__((target("avx2")))
+void ApplyPredicateBatchAVX2(const ColumnBlock& block, SelectionVector* sel, P p) {
+  ApplyPredicateBatch<PhysicalType>(block, sel, p);
+}
+
+bool CpuHasAVX2() {
+  static const bool has_avx2 = base::CPU().has_avx2();
+  return has_avx2;
+}
+
+template <DataType PhysicalType, typename P>
+void DispatchPredicateBatch(const ColumnBlock& block, SelectionVector* sel, P p) {
+  if (CpuHasAVX2()) {
+    ApplyPredicateBatchAVX2<PhysicalType>(block, sel, p);
+  } else {
+    ApplyPredicateBatchSSE4<PhysicalType>(block, sel, p);
+  }
+}
+
+// Evaluates a Range or Equality predicate on a block of cells with physical
+// type 'PhysicalType', using the batch kernels.
+//
+// The comparisons are written in terms of operator< only so that they match
+// GenericCompare exactly, including for NaN floating point values.
+template <DataType PhysicalType>
+void EvaluateFixedWidth(PredicateType predicate_type,
+                        const void* lower,
+                        const void* upper,
+                        const ColumnBlock& block,
+                        SelectionVector* sel) {
+  typedef typename DataTypeTraits<PhysicalType>::cpp_type cpp_type;
+  if (predicate_type == PredicateType::Equality) {
+    const cpp_type value = *reinterpret_cast<const cpp_type*>(lower);
+    DispatchPredicateBatch<PhysicalType>(block, sel, [value] (cpp_type cell) {
+        return !(cell < value) & !(value < cell);
+    });
+    return;
+  }
+
+  DCHECK(predicate_type == PredicateType::Range);
+  if (lower == nullptr) {
+    const cpp_type u = *reinterpret_cast<const cpp_type*>(upper);
+    DispatchPredicateBatch<PhysicalType>(block, sel, [u] (cpp_type cell) {
+        return cell < u;
+    });
+  } else if (upper == nullptr) {
+    const cpp_type l = *reinterpret_cast<const cpp_type*>(lower);
+    DispatchPredicateBatch<PhysicalType>(block, sel, [l] (cpp_type cell) {
+        return !(cell < l);
+    });
+  } else {
+    const cpp_type l = *reinterpret_cast<const cpp_type*>(lower);
+    const cpp_type u = *reinterpret_cast<const cpp_type*>(upper);
+    DispatchPredicateBatch<PhysicalType>(block, sel, [l, u] (cpp_type cell) {
+        return (cell < u) & !(cell < l);
+    });
+  }
+}
+
+// Attempts to evaluate a Range or Equality predicate using the type-specialized
+// batch kernels. Returns false if the column's physical type has no kernel.
+bool TryEvaluateFixedWidth(PredicateType predicate_type,
+                           const void* lower,
+                           const void* upper,
+                           const ColumnBlock& block,
+                           SelectionVector* sel) {
+  switch (block.type_info()->physical_type()) {
+    case INT8:
+      EvaluateFixedWidth<INT8>(predicate_type, lower, upper, block, sel);
+      return true;
+    case INT16:
+      EvaluateFixedWidth<INT16>(predicate_type, lower, upper, block, sel);
+      return true;
+    case INT32:
+      EvaluateFixedWidth<INT32>(predicate_type, lower, upper, block, sel);
+      return true;
+    case INT64:
+      EvaluateFixedWidth<INT64>(predicate_type, lower, upper, block, sel);
+      return true;
+    case FLOAT:
+      EvaluateFixedWidth<FLOAT>(predicate_type, lower, upper, block, sel);
+      return true;
+    case DOUBLE:
+      EvaluateFixedWidth<DOUBLE>(predicate_type, lower, upper, block, sel);
+      return true;
+    default:
+      return false;
+  }
+}
 } // anonymous namespace
 
 void ColumnPredicate::Evaluate(const ColumnBlock& block, SelectionVector *sel) const {
   CHECK_NOTNULL(sel);
 
-  // The type-specific predicate is provided as a function template to
-  // ApplyPredicate in the hope that they are inlined.
-  //
-  // TODO: In the future we can improve this by also providing the type info as a
-  // template, so that the type-specific data comparisons can be inlined.
+  // Range and Equality predicates over fixed-width types are evaluated with
+  // type-specialized batch kernels (see ApplyPredicateBatch). All other
+  // predicates go through ApplyPredicate, where the type-specific predicate is
+  // provided as a function template in the hope that it is inlined.
   //
   // Going a step further we could do runtime codegen to inline the
   // lower/upper/equality bounds.
@@ -287,6 +618,9 @@ void ColumnPredicate::Evaluate(const ColumnBlock& block, SelectionVector *sel) c
       return;
     };
     case PredicateType::Range: {
+      if (TryEvaluateFixedWidth(predicate_type_, lower_, upper_, block, sel)) {
+        return;
+      }
       if (lower_ == nullptr) {
         ApplyPredicate(block, sel, [this] (const void* cell) {
             return column_.type_info()->Compare(cell, this->upper_) < 0;
@@ -304,6 +638,9 @@ void ColumnPredicate::Evaluate(const ColumnBlock& block, SelectionVector *sel) c
       return;
     };
     case PredicateType::Equality: {
+        if (TryEvaluateFixedWidth(predicate_type_, lower_, upper_, block, sel)) {
+          return;
+        }
         ApplyPredicate(block, sel, [this] (const void* cell) {
             return column_.type_info()->Compare(cell, this->lower_) == 0;
         });
@@ -311,19 +648,39 @@ void ColumnPredicate::Evaluate(const ColumnBlock& block, SelectionVector *sel) c
     };
     case PredicateType::IsNotNull: {
       if (!block.is_nullable()) return;
-      // TODO: make this more efficient by using bitwise operations on the
-      // null and selection vectors.
-      for (size_t i = 0; i < block.nrows(); i++) {
-        if (sel->IsRowSelected(i) && block.is_null(i)) {
-          BitmapClear(sel->mutable_bitmap(), i);
-        }
+      BitmapAnd(sel->mutable_bitmap(), block.null_bitmap(), block.nrows());
+      return;
+    }
+    case PredicateType::IsNull: {
+      if (!block.is_nullable()) {
+        BitmapChangeBits(sel->mutable_bitmap(), 0, block.nrows(), false);
+        return;
       }
+      BitmapAndNot(sel->mutable_bitmap(), block.null_bitmap(), block.nrows());
+      return;
+    }
+    case PredicateType::InList: {
+      ApplyPredicate(block, sel, [this] (const void* cell) {
+          return this->CheckValueInList(cell);
+      });
       return;
     }
   }
   LOG(FATAL) << "unknown predicate type";
 }
 
+bool ColumnPredicate::EvaluateCell(const void* cell) const {
+  switch (predicate_type()) {
+    case PredicateType::None: return false;
+    case PredicateType::Range: return CheckValueInRange(cell);
+    case PredicateType::Equality: return column_.type_info()->Compare(cell, lower_) == 0;
+    case PredicateType::IsNotNull: return true;
+    case PredicateType::IsNull: return false;
+    case PredicateType::InList: return CheckValueInList(cell);
+  }
+  LOG(FATAL) << "unknown predicate type";
+}
+
 string ColumnPredicate::ToString() const {
   switch (predicate_type()) {
     case PredicateType::None: return strings::Substitute("`$0` NONE", column_.name());
@@ -345,6 +702,17 @@ string ColumnPredicate::ToString() const {
     case PredicateType::IsNotNull: {
       return strings::Substitute("`$0` IS NOT NULL", column_.name());
     };
+    case PredicateType::IsNull: {
+      return strings::Substitute("`$0` IS NULL", column_.name());
+    };
+    case PredicateType::InList: {
+      string values;
+      for (const void* value : values_) {
+        if (!values.empty()) values.append(", ");
+        values.append(column_.Stringify(value));
+      }
+      return strings::Substitute("`$0` IN ($1)", column_.name(), values);
+    };
   }
   LOG(FATAL) << "unknown predicate type";
 }
@@ -362,6 +730,12 @@ bool ColumnPredicate::operator==(const ColumnPredicate& other) const {
            (upper_ == other.upper_ ||
             (upper_ != nullptr && other.upper_ != nullptr &&
              column_.type_info()->Compare(upper_, other.upper_) == 0));
+  } else if (predicate_type_ == PredicateType::InList) {
+    if (values_.size() != other.values_.size()) return false;
+    for (int i = 0; i < values_.size(); i++) {
+      if (column_.type_info()->Compare(values_[i], other.values_[i]) != 0) return false;
+    }
+    return true;
   } else {
     return true;
   }
@@ -372,9 +746,11 @@ int SelectivityRank(const ColumnPredicate& predicate) {
   int rank;
   switch (predicate.predicate_type()) {
     case PredicateType::None: rank = 0; break;
-    case PredicateType::Equality: rank = 1; break;
-    case PredicateType::Range: rank = 2; break;
-    case PredicateType::IsNotNull: rank = 3; break;
+    case PredicateType::IsNull: rank = 1; break;
+    case PredicateType::Equality: rank = 2; break;
+    case PredicateType::InList: rank = 3; break;
+    case PredicateType::Range: rank = 4; break;
+    case PredicateType::IsNotNull: rank = 5; break;
     default: LOG(FATAL) << "unknown predicate type";
   }
   return rank * (kLargestTypeSize + 1) + predicate.column().type_info()->size();
@@ -19,6 +19,7 @@
 
 #include <boost/optional.hpp>
 #include <string>
+#include <vector>
 
 #include "kudu/common/schema.h"
 
@@ -44,6 +45,13 @@ enum class PredicateType {
 
   // A predicate which evaluates to true if the value is not null.
   IsNotNull,
+
+  // A predicate which evaluates to true if the value is null.
+  IsNull,
+
+  // A predicate which evaluates to true if the column value is present in
+  // a known set of values.
+  InList,
 };
 
 // A predicate which can be evaluated over a block of column values.
@@ -107,6 +115,21 @@ class ColumnPredicate {
   // Creates a new IS NOT NULL predicate for the column.
   static ColumnPredicate IsNotNull(ColumnSchema column);
 
+  // Creates a new IS NULL predicate for the column.
+  //
+  // If the column is not nullable, a None predicate is returned.
+  static ColumnPredicate IsNull(ColumnSchema column);
+
+  // Creates a new IN list predicate for the column.
+  //
+  // The values are not copied, and must outlive the returned predicate. The
+  // vector of values is sorted and deduplicated, and its contents are moved
+  // into the returned predicate, leaving 'values' empty.
+  //
+  // The IN list will be simplified into an Equality or None predicate type if
+  // it contains a single value or no values.
+  static ColumnPredicate InList(ColumnSchema column, std::vector<const void*>* values);
+
   // Returns the type of this predicate.
   PredicateType predicate_type() const {
     return predicate_type_;
@@ -138,6 +161,12 @@ class ColumnPredicate {
   // same vector as block->selection_vector().
   void Evaluate(const ColumnBlock& block, SelectionVector* sel) const;
 
+  // Evaluate the predicate on a single non-null cell.
+  //
+  // Used by block decoders which evaluate the predicate on encoded data, for
+  // example once per dictionary entry or once per run.
+  bool EvaluateCell(const void* cell) const;
+
   // Print the predicate for debugging.
   std::string ToString() const;
 
@@ -157,6 +186,12 @@ class ColumnPredicate {
     return upper_;
   }
 
+  // Returns the sorted, deduplicated list of values if this is an InList
+  // predicate.
+  const std::vector<const void*>& raw_values() const {
+    return values_;
+  }
+
   // Returns the column schema of the column on which this predicate applies.
   const ColumnSchema& column() const {
     return column_;
@@ -187,6 +222,18 @@ class ColumnPredicate {
   // Merge another predicate into this Equality predicate.
   void MergeIntoEquality(const ColumnPredicate& other);
 
+  // Merge another predicate into this IsNull predicate.
+  void MergeIntoIsNull(const ColumnPredicate& other);
+
+  // Merge another predicate into this InList predicate.
+  void MergeIntoInList(const ColumnPredicate& other);
+
+  // Returns true if the value is in the range bounds of this Range predicate.
+  bool CheckValueInRange(const void* value) const;
+
+  // Returns true if the value is in the list of this InList predicate.
+  bool CheckValueInList(const void* value) const;
+
   // The type of this predicate.
   PredicateType predicate_type_;
 
@@ -199,6 +246,9 @@ class ColumnPredicate {
 
   // The exclusive upper bound value if this is a Range predicate.
   const void* upper_;
+
+  // The sorted and deduplicated values if this is an InList predicate.
+  std::vector<const void*> values_;
 };
 
 // Compares predicates according to selectivity. Predicates that match fewer
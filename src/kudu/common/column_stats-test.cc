@@ -0,0 +1,145 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/column_stats.h"
+
+#include <cmath>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/common/columnblock.h"
+#include "kudu/common/types.h"
+#include "kudu/util/test_macros.h"
+
+using std::string;
+
+namespace kudu {
+
+class ColumnStatsTest : public ::testing::Test {
+ protected:
+  // Adds the values [begin, end) to 'collector', every tenth one as a NULL.
+  static void AddInts(int32_t begin, int32_t end, ColumnStatsCollector* collector) {
+    ScopedColumnBlock<INT32> block(end - begin);
+    for (int32_t i = begin; i < end; i++) {
+      block[i - begin] = i;
+      block.SetCellIsNull(i - begin, i % 10 == 0);
+    }
+    collector->AddCells(block);
+  }
+
+  static int32_t DecodeInt(const string& value) {
+    CHECK_EQ(sizeof(int32_t), value.size());
+    int32_t v;
+    memcpy(&v, value.data(), sizeof(v));
+    return v;
+  }
+
+  static void CheckHistogram(const ColumnStatisticsPB& stats) {
+    ASSERT_GT(stats.histogram_counts_size(), 1);
+    ASSERT_LE(stats.histogram_counts_size(), 16);
+    ASSERT_EQ(stats.histogram_counts_size(), stats.histogram_upper_bounds_size());
+    int64_t total = 0;
+    for (int i = 0; i < stats.histogram_counts_size(); i++) {
+      total += stats.histogram_counts(i);
+      if (i > 0) {
+        ASSERT_LT(DecodeInt(stats.histogram_upper_bounds(i - 1)),
+                  DecodeInt(stats.histogram_upper_bounds(i)));
+      }
+    }
+    ASSERT_EQ(stats.num_rows() - stats.null_count(), total);
+    ASSERT_LE(DecodeInt(stats.min_value()), DecodeInt(stats.histogram_upper_bounds(0)));
+    ASSERT_GE(DecodeInt(stats.max_value()),
+              DecodeInt(stats.histogram_upper_bounds(stats.histogram_upper_bounds_size() - 1)));
+  }
+};
+
+TEST_F(ColumnStatsTest, TestCollect) {
+  ColumnStatsCollector collector(ColumnId(3), GetTypeInfo(INT32));
+  AddInts(0, 5000, &collector);
+  AddInts(5000, 10000, &collector);
+  ColumnStatisticsPB stats;
+  collector.Finish(&stats);
+
+  ASSERT_EQ(3, stats.column_id());
+  ASSERT_EQ(10000, stats.num_rows());
+  ASSERT_EQ(1000, stats.null_count());
+  ASSERT_EQ(1, DecodeInt(stats.min_value()));
+  ASSERT_EQ(9999, DecodeInt(stats.max_value()));
+  ASSERT_LE(std::abs(EstimateDistinctValues(stats) - 9000), 9000 * 0.2);
+  NO_FATALS(CheckHistogram(stats));
+
+  // The buckets hold about the same number of values, so the median falls
+  // in the middle of the histogram.
+  int64_t below_half = 0;
+  for (int i = 0; i < stats.histogram_counts_size(); i++) {
+    if (DecodeInt(stats.histogram_upper_bounds(i)) < 5000) {
+      below_half += stats.histogram_counts(i);
+    }
+  }
+  ASSERT_NEAR(4500, below_half, 1000);
+}
+
+TEST_F(ColumnStatsTest, TestMerge) {
+  const TypeInfo* type = GetTypeInfo(INT32);
+  ColumnStatsCollector first(ColumnId(0), type);
+  AddInts(0, 6000, &first);
+  ColumnStatsCollector second(ColumnId(0), type);
+  AddInts(4000, 10000, &second);
+  ColumnStatisticsPB merged;
+  first.Finish(&merged);
+  ColumnStatisticsPB stats;
+  second.Finish(&stats);
+  ASSERT_OK(MergeColumnStatistics(type, stats, &merged));
+
+  ASSERT_EQ(12000, merged.num_rows());
+  ASSERT_EQ(1200, merged.null_count());
+  ASSERT_EQ(1, DecodeInt(merged.min_value()));
+  ASSERT_EQ(9999, DecodeInt(merged.max_value()));
+  // The overlapping values are only counted once.
+  ASSERT_LE(std::abs(EstimateDistinctValues(merged) - 9000), 9000 * 0.2);
+  NO_FATALS(CheckHistogram(merged));
+
+  // Merging into empty statistics copies them.
+  ColumnStatisticsPB empty;
+  ASSERT_OK(MergeColumnStatistics(type, merged, &empty));
+  ASSERT_EQ(merged.SerializeAsString(), empty.SerializeAsString());
+}
+
+TEST_F(ColumnStatsTest, TestLargeValues) {
+  ColumnStatsCollector collector(ColumnId(0), GetTypeInfo(STRING));
+  ScopedColumnBlock<STRING> block(2);
+  string small = "a";
+  string large(1000, 'b');
+  block[0] = Slice(small);
+  block[1] = Slice(large);
+  block.SetCellIsNull(0, false);
+  block.SetCellIsNull(1, false);
+  collector.AddCells(block);
+  ColumnStatisticsPB stats;
+  collector.Finish(&stats);
+
+  // The large value is too large for the min/max and the histogram, but is
+  // counted as a distinct value.
+  ASSERT_FALSE(stats.has_min_value());
+  ASSERT_FALSE(stats.has_max_value());
+  ASSERT_EQ(1, stats.histogram_counts_size());
+  ASSERT_EQ("a", stats.histogram_upper_bounds(0));
+  ASSERT_EQ(2, EstimateDistinctValues(stats));
+}
+
+} // namespace kudu
@@ -0,0 +1,326 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/common/column_stats.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+
+#include <glog/logging.h>
+
+#include "kudu/common/columnblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/hash/city.h"
+
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+namespace {
+
+// The precision of the NDV sketches: 256 registers, for a standard error of
+// about 6.5%, keeps the statistics of each rowset small.
+const int kNdvSketchPrecision = 8;
+
+// The number of values sampled for the histogram, and the number of its
+// buckets.
+const size_t kMaxSampleSize = 1024;
+const int64_t kNumHistogramBuckets = 16;
+
+// Binary values larger than this aren't recorded in the min/max or the
+// histogram.
+const size_t kMaxRecordedValueSize = 128;
+
+bool IsBinary(const TypeInfo* type) {
+  return type->physical_type() == BINARY;
+}
+
+void CellToValue(const TypeInfo* type, const void* cell, string* value) {
+  if (IsBinary(type)) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    value->assign(reinterpret_cast<const char*>(s->data()), s->size());
+  } else {
+    value->assign(reinterpret_cast<const char*>(cell), type->size());
+  }
+}
+
+uint64_t HashCell(const TypeInfo* type, const void* cell) {
+  if (IsBinary(type)) {
+    const Slice* s = reinterpret_cast<const Slice*>(cell);
+    return util_hash::CityHash64(reinterpret_cast<const char*>(s->data()), s->size());
+  }
+  return util_hash::CityHash64(reinterpret_cast<const char*>(cell), type->size());
+}
+
+// A cell holding a value in its statistics representation.
+class ValueCell {
+ public:
+  ValueCell(const TypeInfo* type, const string& value) : ptr_(nullptr) {
+    if (IsBinary(type)) {
+      slice_ = Slice(value);
+      ptr_ = &slice_;
+    } else if (value.size() == type->size() && value.size() <= sizeof(buf_)) {
+      memcpy(buf_, value.data(), value.size());
+      ptr_ = buf_;
+    }
+  }
+
+  bool valid() const { return ptr_ != nullptr; }
+  const void* cell() const { return ptr_; }
+
+ private:
+  Slice slice_;
+  uint64_t buf_[2];
+  const void* ptr_;
+};
+
+int CompareValues(const TypeInfo* type, const string& a, const string& b) {
+  ValueCell a_cell(type, a);
+  ValueCell b_cell(type, b);
+  DCHECK(a_cell.valid() && b_cell.valid());
+  return type->Compare(a_cell.cell(), b_cell.cell());
+}
+
+bool ValuesValid(const TypeInfo* type, const ColumnStatisticsPB& stats) {
+  if (stats.has_min_value() && !ValueCell(type, stats.min_value()).valid()) return false;
+  if (stats.has_max_value() && !ValueCell(type, stats.max_value()).valid()) return false;
+  for (const string& bound : stats.histogram_upper_bounds()) {
+    if (!ValueCell(type, bound).valid()) return false;
+  }
+  return stats.histogram_upper_bounds_size() == stats.histogram_counts_size();
+}
+
+typedef vector<pair<string, int64_t>> WeightedValues;
+
+// Sets the histogram of 'stats' to at most kNumHistogramBuckets buckets of
+// about the same total weight, from 'values' sorted in ascending order.
+// Values which are equal end up in the same bucket.
+void BuildHistogram(const TypeInfo* type, const WeightedValues& values,
+                    ColumnStatisticsPB* stats) {
+  stats->clear_histogram_upper_bounds();
+  stats->clear_histogram_counts();
+  int64_t total = 0;
+  for (const auto& v : values) {
+    total += v.second;
+  }
+  if (total == 0) {
+    return;
+  }
+  int64_t cumulative = 0;
+  int64_t bucket_count = 0;
+  int next_bucket = 1;
+  for (size_t i = 0; i < values.size(); i++) {
+    cumulative += values[i].second;
+    bucket_count += values[i].second;
+    bool last_of_value = i + 1 == values.size() ||
+        CompareValues(type, values[i].first, values[i + 1].first) != 0;
+    if (last_of_value &&
+        (i + 1 == values.size() ||
+         cumulative * kNumHistogramBuckets >= next_bucket * total)) {
+      stats->add_histogram_upper_bounds(values[i].first);
+      stats->add_histogram_counts(bucket_count);
+      bucket_count = 0;
+      while (cumulative * kNumHistogramBuckets >= next_bucket * total) {
+        next_bucket++;
+      }
+    }
+  }
+}
+
+int64_t NonNullCount(const ColumnStatisticsPB& stats) {
+  return stats.num_rows() - stats.null_count();
+}
+
+} // anonymous namespace
+
+ColumnStatsCollector::ColumnStatsCollector(ColumnId col_id, const TypeInfo* type)
+    : col_id_(col_id),
+      type_(type),
+      num_rows_(0),
+      null_count_(0),
+      has_min_max_(false),
+      min_max_overflow_(false),
+      ndv_sketch_(kNdvSketchPrecision),
+      num_sampled_values_(0),
+      rng_(col_id) {
+}
+
+void ColumnStatsCollector::AddCells(const ColumnBlock& block) {
+  num_rows_ += block.nrows();
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (block.is_nullable() && block.is_null(i)) {
+      null_count_++;
+      continue;
+    }
+    AddValue(block.cell_ptr(i));
+  }
+}
+
+void ColumnStatsCollector::AddValue(const void* cell) {
+  ndv_sketch_.AddHash(HashCell(type_, cell));
+
+  if (IsBinary(type_) &&
+      reinterpret_cast<const Slice*>(cell)->size() > kMaxRecordedValueSize) {
+    min_max_overflow_ = true;
+    return;
+  }
+  if (!min_max_overflow_) {
+    if (!has_min_max_) {
+      CellToValue(type_, cell, &min_);
+      CellToValue(type_, cell, &max_);
+      has_min_max_ = true;
+    } else if (type_->Compare(cell, ValueCell(type_, min_).cell()) < 0) {
+      CellToValue(type_, cell, &min_);
+    } else if (type_->Compare(cell, ValueCell(type_, max_).cell()) > 0) {
+      CellToValue(type_, cell, &max_);
+    }
+  }
+
+  // Keep each of the values seen with the same probability.
+  num_sampled_values_++;
+  if (sample_.size() < kMaxSampleSize) {
+    sample_.emplace_back();
+    CellToValue(type_, cell, &sample_.back());
+  } else {
+    uint64_t idx = rng_.Uniform64(num_sampled_values_);
+    if (idx < kMaxSampleSize) {
+      CellToValue(type_, cell, &sample_[idx]);
+    }
+  }
+}
+
+void ColumnStatsCollector::Finish(ColumnStatisticsPB* stats) {
+  stats->Clear();
+  stats->set_column_id(col_id_);
+  stats->set_num_rows(num_rows_);
+  stats->set_null_count(null_count_);
+  if (has_min_max_ && !min_max_overflow_) {
+    stats->set_min_value(min_);
+    stats->set_max_value(max_);
+  }
+  stats->set_ndv_sketch(ndv_sketch_.registers().ToString());
+
+  if (sample_.empty()) {
+    return;
+  }
+  std::sort(sample_.begin(), sample_.end(), [&](const string& a, const string& b) {
+      return CompareValues(type_, a, b) < 0;
+    });
+  WeightedValues values;
+  values.reserve(sample_.size());
+  for (const string& v : sample_) {
+    values.emplace_back(v, 1);
+  }
+  BuildHistogram(type_, values, stats);
+
+  // Scale the buckets of the sample up to all the values it was taken from.
+  int64_t sampled = 0;
+  int64_t scaled = 0;
+  for (int i = 0; i < stats->histogram_counts_size(); i++) {
+    sampled += stats->histogram_counts(i);
+    int64_t new_scaled = num_sampled_values_ * sampled / static_cast<int64_t>(sample_.size());
+    stats->set_histogram_counts(i, new_scaled - scaled);
+    scaled = new_scaled;
+  }
+}
+
+Status MergeColumnStatistics(const TypeInfo* type,
+                             const ColumnStatisticsPB& src,
+                             ColumnStatisticsPB* dst) {
+  if (!ValuesValid(type, src) || !ValuesValid(type, *dst)) {
+    return Status::Corruption("invalid column statistics values");
+  }
+  if (!dst->has_column_id() && src.has_column_id()) {
+    dst->set_column_id(src.column_id());
+  }
+  int64_t src_non_null = NonNullCount(src);
+  int64_t dst_non_null = NonNullCount(*dst);
+  dst->set_num_rows(dst->num_rows() + src.num_rows());
+  dst->set_null_count(dst->null_count() + src.null_count());
+  if (src_non_null == 0) {
+    return Status::OK();
+  }
+  if (dst_non_null == 0) {
+    // Only the non-NULL values are described by the rest of the statistics.
+    dst->clear_min_value();
+    dst->clear_max_value();
+    dst->clear_ndv_sketch();
+    dst->clear_histogram_upper_bounds();
+    dst->clear_histogram_counts();
+    if (src.has_min_value()) dst->set_min_value(src.min_value());
+    if (src.has_max_value()) dst->set_max_value(src.max_value());
+    if (src.has_ndv_sketch()) dst->set_ndv_sketch(src.ndv_sketch());
+    dst->mutable_histogram_upper_bounds()->CopyFrom(src.histogram_upper_bounds());
+    dst->mutable_histogram_counts()->CopyFrom(src.histogram_counts());
+    return Status::OK();
+  }
+
+  if (dst->has_min_value() && src.has_min_value()) {
+    if (CompareValues(type, src.min_value(), dst->min_value()) < 0) {
+      dst->set_min_value(src.min_value());
+    }
+    if (CompareValues(type, src.max_value(), dst->max_value()) > 0) {
+      dst->set_max_value(src.max_value());
+    }
+  } else {
+    dst->clear_min_value();
+    dst->clear_max_value();
+  }
+
+  if (dst->has_ndv_sketch() && src.has_ndv_sketch()) {
+    HyperLogLog dst_sketch(kNdvSketchPrecision);
+    HyperLogLog src_sketch(kNdvSketchPrecision);
+    RETURN_NOT_OK(HyperLogLog::FromRegisters(dst->ndv_sketch(), &dst_sketch));
+    RETURN_NOT_OK(HyperLogLog::FromRegisters(src.ndv_sketch(), &src_sketch));
+    RETURN_NOT_OK(dst_sketch.Merge(src_sketch));
+    dst->set_ndv_sketch(dst_sketch.registers().ToString());
+  } else {
+    dst->clear_ndv_sketch();
+  }
+
+  WeightedValues values;
+  const ColumnStatisticsPB& old_dst = *dst;
+  for (const ColumnStatisticsPB* stats : { &src, &old_dst }) {
+    for (int i = 0; i < stats->histogram_upper_bounds_size(); i++) {
+      values.emplace_back(stats->histogram_upper_bounds(i), stats->histogram_counts(i));
+    }
+  }
+  std::stable_sort(values.begin(), values.end(),
+                   [&](const pair<string, int64_t>& a, const pair<string, int64_t>& b) {
+                     return CompareValues(type, a.first, b.first) < 0;
+                   });
+  BuildHistogram(type, values, dst);
+  return Status::OK();
+}
+
+int64_t EstimateDistinctValues(const ColumnStatisticsPB& stats) {
+  if (NonNullCount(stats) == 0) {
+    return 0;
+  }
+  HyperLogLog sketch(kNdvSketchPrecision);
+  if (!stats.has_ndv_sketch() || !HyperLogLog::FromRegisters(stats.ndv_sketch(), &sketch).ok()) {
+    return -1;
+  }
+  // The estimate can't be more than the number of values.
+  return std::min(sketch.Estimate(), NonNullCount(stats));
+}
+
+} // namespace kudu
@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_COMMON_COLUMN_STATS_H
+#define KUDU_COMMON_COLUMN_STATS_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "kudu/common/common.pb.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/hyperloglog.h"
+#include "kudu/util/random.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class ColumnBlock;
+class TypeInfo;
+
+// Collects the ColumnStatisticsPB of the values of one column as they are
+// written, e.g. to the CFile of a rowset.
+//
+// The histogram is built from a uniform sample of the values, so that
+// collecting the statistics takes a bounded amount of memory.
+class ColumnStatsCollector {
+ public:
+  ColumnStatsCollector(ColumnId col_id, const TypeInfo* type);
+
+  // Folds the cells of 'block' into the statistics.
+  void AddCells(const ColumnBlock& block);
+
+  // Sets '*stats' to the statistics of the cells added so far.
+  void Finish(ColumnStatisticsPB* stats);
+
+ private:
+  void AddValue(const void* cell);
+
+  const ColumnId col_id_;
+  const TypeInfo* const type_;
+
+  int64_t num_rows_;
+  int64_t null_count_;
+
+  bool has_min_max_;
+  bool min_max_overflow_;
+  std::string min_;
+  std::string max_;
+
+  HyperLogLog ndv_sketch_;
+
+  // A reservoir sample of the values small enough to be recorded, of which
+  // 'num_sampled_values_' were seen.
+  std::vector<std::string> sample_;
+  int64_t num_sampled_values_;
+  Random rng_;
+
+  DISALLOW_COPY_AND_ASSIGN(ColumnStatsCollector);
+};
+
+// Merges the statistics 'src' into 'dst', both of which describe values of
+// type 'type', as if they had been collected from the union of their cells.
+// Merged histograms are rebuilt from the buckets of both, so they are only
+// approximately equi-depth.
+//
+// Returns Corruption if either has an invalid sketch.
+Status MergeColumnStatistics(const TypeInfo* type,
+                             const ColumnStatisticsPB& src,
+                             ColumnStatisticsPB* dst);
+
+// Returns the estimated number of distinct non-NULL values described by
+// 'stats', or -1 if unknown.
+int64_t EstimateDistinctValues(const ColumnStatisticsPB& stats);
+
+} // namespace kudu
+
+#endif /* KUDU_COMMON_COLUMN_STATS_H */
@@ -168,6 +168,12 @@ class ColumnDataView {
     return row_offset_;
   }
 
+  // Returns the null bitmap of the underlying block. The first cell of the
+  // view is at bit first_row_index().
+  const uint8_t *null_bitmap() const {
+    return column_block_->null_bitmap();
+  }
+
   // Set 'nrows' bits of the the null-bitmap to "value"
   // true if not null, false if null.
   void SetNullBits(size_t nrows, bool value) {
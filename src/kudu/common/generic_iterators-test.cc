@@ -29,6 +29,7 @@
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_int32(num_lists, 3, "Number of lists to merge");
 DEFINE_int32(num_rows, 1000, "Number of entries per list");
@@ -209,6 +210,43 @@ TEST(TestMergeIterator, TestPredicate) {
   TestMerge(predicate);
 }
 
+// Test merging many iterators whose key ranges don't overlap, passed in an
+// order unrelated to their keys, so that whole runs are copied at a time.
+TEST(TestMergeIterator, TestMergeNonOverlapping) {
+  const int kNumLists = 50;
+  const int kRowsPerList = 1500;
+  vector<int> order;
+  for (int i = 0; i < kNumLists; i++) {
+    order.push_back(i);
+  }
+  std::random_shuffle(order.begin(), order.end());
+
+  vector<shared_ptr<RowwiseIterator>> to_merge;
+  for (int list : order) {
+    vector<uint32_t> ints;
+    for (int j = 0; j < kRowsPerList; j++) {
+      ints.push_back(list * kRowsPerList + j);
+    }
+    to_merge.push_back(shared_ptr<RowwiseIterator>(
+      new MaterializingIterator(
+        shared_ptr<ColumnwiseIterator>(new VectorIterator(ints)))));
+  }
+
+  MergeIterator merger(kIntSchema, to_merge);
+  ASSERT_OK(merger.Init(nullptr));
+
+  RowBlock dst(kIntSchema, 100, nullptr);
+  uint32_t expected = 0;
+  while (merger.HasNext()) {
+    ASSERT_OK(merger.NextBlock(&dst));
+    ASSERT_GT(dst.nrows(), 0);
+    for (int i = 0; i < dst.nrows(); i++) {
+      ASSERT_EQ(expected++, *kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+    }
+  }
+  ASSERT_EQ(kNumLists * kRowsPerList, expected);
+}
+
 // Test that the MaterializingIterator properly evaluates predicates when they apply
 // to single columns.
 TEST(TestMaterializingIterator, TestMaterializingPredicatePushdown) {
@@ -301,4 +339,112 @@ TEST(TestPredicateEvaluatingIterator, TestDontWrapWhenNoPredicates) {
   ASSERT_EQ(outer_iter, materializing) << "InitAndMaybeWrap should not have wrapped iter";
 }
 
+// Builds 'num_lists' prefetching iterators over ascending integers. The union
+// of the iterators yields the same sequence as the sorted 'all_ints'.
+static void BuildPrefetchingIterators(ThreadPool* pool, int num_lists, int num_rows,
+                                      vector<shared_ptr<PrefetchingIterator>>* prefetchers,
+                                      vector<uint32_t>* all_ints) {
+  for (int i = 0; i < num_lists; i++) {
+    vector<uint32_t> ints;
+    for (int j = 0; j < num_rows; j++) {
+      ints.push_back(i * num_rows + j);
+    }
+    all_ints->insert(all_ints->end(), ints.begin(), ints.end());
+    shared_ptr<RowwiseIterator> iter(
+      new MaterializingIterator(
+        shared_ptr<ColumnwiseIterator>(new VectorIterator(ints))));
+    prefetchers->push_back(std::make_shared<PrefetchingIterator>(iter, pool, 2));
+  }
+}
+
+static void CheckIteratorYields(RowwiseIterator* iter, const vector<uint32_t>& expected) {
+  Arena arena(1024, 1024);
+  RowBlock dst(kIntSchema, 100, &arena);
+  size_t total_idx = 0;
+  while (iter->HasNext()) {
+    ASSERT_OK(iter->NextBlock(&dst));
+    for (int i = 0; i < dst.nrows(); i++) {
+      ASSERT_LT(total_idx, expected.size());
+      ASSERT_EQ(expected[total_idx++],
+                *kIntSchema.ExtractColumnFromRow<UINT32>(dst.row(i), 0));
+    }
+  }
+  ASSERT_EQ(expected.size(), total_idx);
+}
+
+// Test that prefetching iterators consumed one after another, with only a
+// window of them prefetching at a time, yield all of their rows in order.
+TEST(TestPrefetchingIterator, TestUnion) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("prefetch").set_max_threads(2).Build(&pool));
+
+  vector<shared_ptr<PrefetchingIterator>> prefetchers;
+  vector<uint32_t> all_ints;
+  BuildPrefetchingIterators(pool.get(), 5, 2500, &prefetchers, &all_ints);
+  const int kWindow = 2;
+  vector<shared_ptr<RowwiseIterator>> to_union;
+  for (int i = 0; i < prefetchers.size(); i++) {
+    if (i < kWindow) {
+      prefetchers[i]->StartPrefetching();
+    } else {
+      prefetchers[i - kWindow]->set_successor(prefetchers[i]);
+    }
+    to_union.push_back(prefetchers[i]);
+  }
+  prefetchers.clear();
+
+  UnionIterator iter(to_union);
+  ASSERT_OK(iter.Init(nullptr));
+  NO_FATALS(CheckIteratorYields(&iter, all_ints));
+}
+
+// Test that a merge of prefetching iterators evaluating a predicate yields
+// the matching rows in order.
+TEST(TestPrefetchingIterator, TestMergeWithPredicate) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("prefetch").set_max_threads(2).Build(&pool));
+
+  vector<shared_ptr<PrefetchingIterator>> prefetchers;
+  vector<uint32_t> all_ints;
+  BuildPrefetchingIterators(pool.get(), 3, 2500, &prefetchers, &all_ints);
+  vector<shared_ptr<RowwiseIterator>> to_merge;
+  for (const auto& prefetcher : prefetchers) {
+    prefetcher->StartPrefetching();
+    to_merge.push_back(prefetcher);
+  }
+
+  TestIntRangePredicate predicate(1000, 6000);
+  ScanSpec spec;
+  spec.AddPredicate(predicate.pred_);
+  vector<uint32_t> expected;
+  for (uint32_t v : all_ints) {
+    if (v >= predicate.lower_ && v < predicate.upper_) {
+      expected.push_back(v);
+    }
+  }
+
+  MergeIterator iter(kIntSchema, to_merge);
+  ASSERT_OK(iter.Init(&spec));
+  NO_FATALS(CheckIteratorYields(&iter, expected));
+}
+
+// Test that a prefetching iterator whose tasks are dropped by the thread
+// pool returns an error rather than hanging.
+TEST(TestPrefetchingIterator, TestPoolShutdown) {
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("prefetch").set_max_threads(1).Build(&pool));
+  pool->Shutdown();
+
+  vector<shared_ptr<PrefetchingIterator>> prefetchers;
+  vector<uint32_t> all_ints;
+  BuildPrefetchingIterators(pool.get(), 1, 100, &prefetchers, &all_ints);
+  ASSERT_OK(prefetchers[0]->Init(nullptr));
+  ASSERT_TRUE(prefetchers[0]->HasNext());
+
+  Arena arena(1024, 1024);
+  RowBlock dst(kIntSchema, 100, &arena);
+  Status s = prefetchers[0]->NextBlock(&dst);
+  ASSERT_TRUE(s.IsAborted()) << s.ToString();
+}
+
 } // namespace kudu
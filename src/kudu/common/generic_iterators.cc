@@ -16,36 +16,57 @@
 // under the License.
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
 #include <tuple>
+#include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
+#include "kudu/common/types.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/threadpool.h"
+#include "kudu/util/trace.h"
 
 using std::all_of;
 using std::get;
 using std::move;
-using std::remove_if;
 using std::shared_ptr;
 using std::sort;
 using std::string;
 using std::unique_ptr;
 using std::tuple;
+using std::vector;
 
 DEFINE_bool(materializing_iterator_do_pushdown, true,
             "Should MaterializingIterator do predicate pushdown");
 TAG_FLAG(materializing_iterator_do_pushdown, hidden);
 
+DEFINE_bool(materializing_iterator_decoder_eval, true,
+            "Should MaterializingIterator allow column predicates to be evaluated "
+            "by the block decoders while decoding");
+TAG_FLAG(materializing_iterator_decoder_eval, hidden);
+TAG_FLAG(materializing_iterator_decoder_eval, runtime);
+
+DEFINE_bool(materializing_iterator_late_materialization, true,
+            "Should MaterializingIterator skip decoding the rows of a block which "
+            "have already been filtered out by a predicate");
+TAG_FLAG(materializing_iterator_late_materialization, hidden);
+TAG_FLAG(materializing_iterator_late_materialization, runtime);
+
 namespace kudu {
 
+const char* SCAN_PREDICATE_EVAL_TIME_METRIC_NAME = "scan_predicate_eval_us";
+
 ////////////////////////////////////////////////////////////
 // Merge iterator
 ////////////////////////////////////////////////////////////
@@ -53,6 +74,49 @@ namespace kudu {
 // TODO: size by bytes, not # rows
 static const int kMergeRowBuffer = 1000;
 
+// Normalized 64-bit prefixes of key values: comparing the prefixes of two
+// values as integers orders them as their type would, unless the prefixes are
+// equal. Integers are mapped exactly, strings to their first 8 bytes.
+template<typename T>
+static uint64_t NormalizedKeyPrefix(T value) {
+  if (std::is_signed<T>::value) {
+    // Flipping the sign bit maps the signed values to unsigned ones in order.
+    return static_cast<uint64_t>(static_cast<int64_t>(value)) ^ (1ULL << 63);
+  }
+  return static_cast<uint64_t>(value);
+}
+
+static uint64_t NormalizedKeyPrefix(const Slice& value) {
+  // Shorter strings are padded with zeroes, so a string which is a prefix of
+  // another never gets a larger prefix than it.
+  uint8_t buf[sizeof(uint64_t)] = { 0 };
+  memcpy(buf, value.data(), std::min<size_t>(value.size(), sizeof(buf)));
+  return BigEndian::Load64(buf);
+}
+
+template<DataType type>
+static void ComputeKeyPrefixes(const RowBlock& block, vector<uint64_t>* prefixes) {
+  const ColumnBlock col = block.column_block(0);
+  const SelectionVector* selection = block.selection_vector();
+  for (size_t i = 0; i < block.nrows(); i++) {
+    if (selection->IsRowSelected(i)) {
+      (*prefixes)[i] = NormalizedKeyPrefix(
+          *reinterpret_cast<const typename DataTypeTraits<type>::cpp_type*>(col.cell_ptr(i)));
+    }
+  }
+}
+
+// Compares 'a' and 'b' as Schema::Compare() does, comparing their normalized
+// key prefixes first and only comparing the rows themselves on a tie.
+static int CompareRows(const Schema& schema,
+                       const RowBlockRow& a, uint64_t a_prefix,
+                       const RowBlockRow& b, uint64_t b_prefix) {
+  if (a_prefix != b_prefix) {
+    return a_prefix < b_prefix ? -1 : 1;
+  }
+  return schema.Compare(a, b);
+}
+
 // MergeIterState wraps a RowwiseIterator for use by the MergeIterator.
 // Importantly, it also filters out unselected rows from the wrapped RowwiseIterator,
 // such that all returned rows are valid.
@@ -62,7 +126,9 @@ class MergeIterState {
     iter_(iter),
     arena_(1024, 256*1024),
     read_block_(iter->schema(), kMergeRowBuffer, &arena_),
+    key_prefixes_(kMergeRowBuffer),
     next_row_idx_(0),
+    last_row_idx_(0),
     num_advanced_(0),
     num_valid_(0)
   {}
@@ -72,6 +138,20 @@ class MergeIterState {
     return next_row_;
   }
 
+  // The last selected row of the current block.
+  const RowBlockRow& last_row() {
+    DCHECK_LT(num_advanced_, num_valid_);
+    return last_row_;
+  }
+
+  // The normalized key prefixes of next_row() and last_row().
+  uint64_t next_key_prefix() const {
+    return key_prefixes_[next_row_idx_];
+  }
+  uint64_t last_key_prefix() const {
+    return key_prefixes_[last_row_idx_];
+  }
+
   Status Advance() {
     num_advanced_++;
     if (IsBlockExhausted()) {
@@ -80,13 +160,10 @@ class MergeIterState {
     } else {
       // Seek to the next selected row.
       SelectionVector *selection = read_block_.selection_vector();
-      for (++next_row_idx_; next_row_idx_ < read_block_.nrows(); next_row_idx_++) {
-        if (selection->IsRowSelected(next_row_idx_)) {
-          next_row_.Reset(&read_block_, next_row_idx_);
-          break;
-        }
-      }
-      DCHECK_NE(next_row_idx_, read_block_.nrows()+1) << "No selected rows found!";
+      bool found = BitmapFindFirstSet(selection->bitmap(), next_row_idx_ + 1,
+                                      read_block_.nrows(), &next_row_idx_);
+      DCHECK(found) << "No selected rows found!";
+      next_row_.Reset(&read_block_, next_row_idx_);
       return Status::OK();
     }
   }
@@ -118,17 +195,39 @@ class MergeIterState {
     DCHECK_LE(selection->CountSelected(), read_block_.nrows());
     num_valid_ = selection->CountSelected();
     VLOG(2) << selection->CountSelected() << "/" << read_block_.nrows() << " rows selected";
-    // Seek next_row_ to the first selected row.
-    for (next_row_idx_ = 0; next_row_idx_ < read_block_.nrows(); next_row_idx_++) {
-      if (selection->IsRowSelected(next_row_idx_)) {
-        next_row_.Reset(&read_block_, next_row_idx_);
-        break;
+    if (num_valid_ > 0) {
+      // Seek next_row_ to the first selected row.
+      CHECK(BitmapFindFirstSet(selection->bitmap(), 0, read_block_.nrows(), &next_row_idx_));
+      next_row_.Reset(&read_block_, next_row_idx_);
+      last_row_idx_ = read_block_.nrows() - 1;
+      while (!selection->IsRowSelected(last_row_idx_)) {
+        last_row_idx_--;
       }
+      last_row_.Reset(&read_block_, last_row_idx_);
+      ComputeBlockKeyPrefixes();
     }
-    DCHECK_NE(next_row_idx_, read_block_.nrows()+1) << "No selected rows found!";
     return Status::OK();
   }
 
+  // Computes the normalized key prefixes of the selected rows of read_block_.
+  void ComputeBlockKeyPrefixes() {
+    key_prefixes_.resize(read_block_.nrows());
+    switch (read_block_.schema().column(0).type_info()->physical_type()) {
+      case INT8: ComputeKeyPrefixes<INT8>(read_block_, &key_prefixes_); break;
+      case INT16: ComputeKeyPrefixes<INT16>(read_block_, &key_prefixes_); break;
+      case INT32: ComputeKeyPrefixes<INT32>(read_block_, &key_prefixes_); break;
+      case INT64: ComputeKeyPrefixes<INT64>(read_block_, &key_prefixes_); break;
+      case UINT8: ComputeKeyPrefixes<UINT8>(read_block_, &key_prefixes_); break;
+      case UINT16: ComputeKeyPrefixes<UINT16>(read_block_, &key_prefixes_); break;
+      case UINT32: ComputeKeyPrefixes<UINT32>(read_block_, &key_prefixes_); break;
+      case UINT64: ComputeKeyPrefixes<UINT64>(read_block_, &key_prefixes_); break;
+      case BINARY: ComputeKeyPrefixes<BINARY>(read_block_, &key_prefixes_); break;
+      default:
+        std::fill(key_prefixes_.begin(), key_prefixes_.end(), 0);
+        break;
+    }
+  }
+
   size_t remaining_in_block() const {
     return num_valid_ - num_advanced_;
   }
@@ -140,10 +239,18 @@ class MergeIterState {
   shared_ptr<RowwiseIterator> iter_;
   Arena arena_;
   RowBlock read_block_;
+  // The normalized prefix of the first key column of each selected row of
+  // read_block_, so that most comparisons between the rows of different
+  // sub-iterators are integer comparisons.
+  vector<uint64_t> key_prefixes_;
   // The row currently pointed to by the iterator.
   RowBlockRow next_row_;
+  // The last selected row in read_block_.
+  RowBlockRow last_row_;
   // Row index of next_row_ in read_block_.
   size_t next_row_idx_;
+  // Row index of last_row_ in read_block_.
+  size_t last_row_idx_;
   // Number of rows we've advanced past in the current RowBlock.
   size_t num_advanced_;
   // Number of valid (selected) rows in the current RowBlock.
@@ -173,14 +280,17 @@ Status MergeIterator::Init(ScanSpec *spec) {
     RETURN_NOT_OK(state->PullNextBlock());
   }
 
-  // Before we copy any rows, clean up any iterators which were empty
+  // Before we copy any rows, leave out any iterators which were empty
   // to start with. Otherwise, HasNext() won't properly return false
   // if we were passed only empty iterators.
-  iters_.erase(
-      remove_if(iters_.begin(), iters_.end(), [] (const unique_ptr<MergeIterState>& iter) {
-        return PREDICT_FALSE(iter->IsFullyExhausted());
-      }),
-      iters_.end());
+  for (const unique_ptr<MergeIterState>& state : iters_) {
+    if (PREDICT_TRUE(!state->IsFullyExhausted())) {
+      heap_.push_back(state.get());
+    }
+  }
+  for (size_t i = heap_.size() / 2; i-- > 0;) {
+    SiftDown(i);
+  }
 
   initted_ = true;
   return Status::OK();
@@ -188,7 +298,32 @@ Status MergeIterator::Init(ScanSpec *spec) {
 
 bool MergeIterator::HasNext() const {
   CHECK(initted_);
-  return !iters_.empty();
+  return !heap_.empty();
+}
+
+bool MergeIterator::HeapLess(size_t a, size_t b) const {
+  return CompareRows(schema_,
+                     heap_[a]->next_row(), heap_[a]->next_key_prefix(),
+                     heap_[b]->next_row(), heap_[b]->next_key_prefix()) < 0;
+}
+
+void MergeIterator::SiftDown(size_t idx) {
+  while (true) {
+    size_t smallest = idx;
+    size_t left = 2 * idx + 1;
+    size_t right = left + 1;
+    if (left < heap_.size() && HeapLess(left, smallest)) {
+      smallest = left;
+    }
+    if (right < heap_.size() && HeapLess(right, smallest)) {
+      smallest = right;
+    }
+    if (smallest == idx) {
+      return;
+    }
+    std::swap(heap_[idx], heap_[smallest]);
+    idx = smallest;
+  }
 }
 
 Status MergeIterator::InitSubIterators(ScanSpec *spec) {
@@ -225,8 +360,8 @@ void MergeIterator::PrepareBatch(RowBlock* dst) {
   // We can always provide at least as many rows as are remaining
   // in the currently queued up blocks.
   size_t available = 0;
-  for (unique_ptr<MergeIterState> &iter : iters_) {
-    available += iter->remaining_in_block();
+  for (MergeIterState* state : heap_) {
+    available += state->remaining_in_block();
   }
 
   dst->Resize(std::min(dst->row_capacity(), available));
@@ -239,34 +374,41 @@ Status MergeIterator::MaterializeBlock(RowBlock *dst) {
   // Initialize the selection vector.
   // MergeIterState only returns selected rows.
   dst->selection_vector()->SetAllTrue();
-  for (size_t dst_row_idx = 0; dst_row_idx < dst->nrows(); dst_row_idx++) {
-    RowBlockRow dst_row = dst->row(dst_row_idx);
-
-    // Find the sub-iterator which is currently smallest
-    MergeIterState *smallest = nullptr;
-    ssize_t smallest_idx = -1;
-
-    // Typically the number of iters_ is not that large, so using a priority
-    // queue is not worth it
-    for (size_t i = 0; i < iters_.size(); i++) {
-      unique_ptr<MergeIterState> &state = iters_[i];
-
-      if (smallest == nullptr ||
-          schema_.Compare(state->next_row(), smallest->next_row()) < 0) {
-        smallest = state.get();
-        smallest_idx = i;
-      }
+  size_t dst_row_idx = 0;
+  while (dst_row_idx < dst->nrows() && !heap_.empty()) {
+    // The sub-iterator which is currently smallest is at the top of the heap.
+    MergeIterState* smallest = heap_[0];
+
+    // Find the smallest row among the other sub-iterators. If the rest of
+    // the smallest sub-iterator's block sorts before it, the whole run can
+    // be copied without comparing each row. This is the common case when
+    // the sub-iterators' key ranges don't overlap.
+    MergeIterState* next_smallest = nullptr;
+    if (heap_.size() > 1) {
+      size_t child = (heap_.size() > 2 && HeapLess(2, 1)) ? 2 : 1;
+      next_smallest = heap_[child];
+    }
+    size_t run_length = 1;
+    if (next_smallest == nullptr ||
+        CompareRows(schema_,
+                    smallest->last_row(), smallest->last_key_prefix(),
+                    next_smallest->next_row(), next_smallest->next_key_prefix()) < 0) {
+      run_length = std::min(smallest->remaining_in_block(), dst->nrows() - dst_row_idx);
     }
 
-    // If no iterators had any row left, then we're done iterating.
-    if (PREDICT_FALSE(smallest == nullptr)) break;
-
-    // Otherwise, copy the row from the smallest one, and advance it
-    RETURN_NOT_OK(CopyRow(smallest->next_row(), &dst_row, dst->arena()));
-    RETURN_NOT_OK(smallest->Advance());
+    // Copy the run from the smallest one, advancing it past each row.
+    for (size_t i = 0; i < run_length; i++) {
+      RowBlockRow dst_row = dst->row(dst_row_idx++);
+      RETURN_NOT_OK(CopyRow(smallest->next_row(), &dst_row, dst->arena()));
+      RETURN_NOT_OK(smallest->Advance());
+    }
 
     if (smallest->IsFullyExhausted()) {
-      iters_.erase(iters_.begin() + smallest_idx);
+      heap_[0] = heap_.back();
+      heap_.pop_back();
+    }
+    if (!heap_.empty()) {
+      SiftDown(0);
     }
   }
 
@@ -509,13 +651,29 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
   // been deleted.
   RETURN_NOT_OK(iter_->InitializeSelectionVector(dst->selection_vector()));
 
+  bool decoder_eval = FLAGS_materializing_iterator_decoder_eval;
+  // Once the block is being filtered, rows which are not selected will never
+  // be looked at, so there is no need to decode them. Unfiltered scans (e.g.
+  // for compactions) keep fully materializing deleted rows.
+  bool late_materialize = FLAGS_materializing_iterator_late_materialization &&
+                          !col_idx_predicates_.empty();
   for (const auto& col_pred : col_idx_predicates_) {
-    // Materialize the column itself into the row block.
+    // Materialize the column itself into the row block, allowing the
+    // predicate to be evaluated while decoding.
     ColumnBlock dst_col(dst->column_block(get<0>(col_pred)));
-    RETURN_NOT_OK(iter_->MaterializeColumn(get<0>(col_pred), &dst_col));
-
-    // Evaluate the column predicate.
-    get<1>(col_pred).Evaluate(dst_col, dst->selection_vector());
+    ColumnMaterializationContext ctx(get<0>(col_pred),
+                                     decoder_eval ? &get<1>(col_pred) : nullptr,
+                                     &dst_col,
+                                     dst->selection_vector());
+    ctx.set_skip_unselected_rows(late_materialize);
+    RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
+
+    // Evaluate the column predicate, unless it was already evaluated during
+    // decoding.
+    if (!ctx.DecoderEvalSupported()) {
+      TRACE_COUNTER_SCOPE_LATENCY_US(SCAN_PREDICATE_EVAL_TIME_METRIC_NAME);
+      get<1>(col_pred).Evaluate(dst_col, dst->selection_vector());
+    }
 
     // If after evaluating this predicate the entire row block has been filtered
     // out, we don't need to materialize other columns at all.
@@ -526,9 +684,12 @@ Status MaterializingIterator::MaterializeBlock(RowBlock *dst) {
   }
 
   for (size_t col_idx : non_predicate_column_indexes_) {
-    // Materialize the column itself into the row block.
+    // Materialize the column itself into the row block, decoding only the
+    // rows which passed the predicates.
     ColumnBlock dst_col(dst->column_block(col_idx));
-    RETURN_NOT_OK(iter_->MaterializeColumn(col_idx, &dst_col));
+    ColumnMaterializationContext ctx(col_idx, nullptr, &dst_col, dst->selection_vector());
+    ctx.set_skip_unselected_rows(late_materialize);
+    RETURN_NOT_OK(iter_->MaterializeColumn(&ctx));
   }
 
   DVLOG(1) << dst->selection_vector()->CountSelected() << "/"
@@ -593,7 +754,10 @@ Status PredicateEvaluatingIterator::NextBlock(RowBlock *dst) {
     if (col_idx == Schema::kColumnNotFound) {
       return Status::InvalidArgument("Unknown column in predicate", predicate.ToString());
     }
-    predicate.Evaluate(dst->column_block(col_idx), dst->selection_vector());
+    {
+      TRACE_COUNTER_SCOPE_LATENCY_US(SCAN_PREDICATE_EVAL_TIME_METRIC_NAME);
+      predicate.Evaluate(dst->column_block(col_idx), dst->selection_vector());
+    }
 
     // If after evaluating this predicate, the entire row block has now been
     // filtered out, we don't need to evaluate any further predicates.
@@ -609,4 +773,259 @@ string PredicateEvaluatingIterator::ToString() const {
   return strings::Substitute("PredicateEvaluating($0)", base_iter_->ToString());
 }
 
+////////////////////////////////////////////////////////////
+// Prefetching iterator
+////////////////////////////////////////////////////////////
+
+// TODO: size by bytes, not # rows
+static const int kPrefetchRowBuffer = 1000;
+
+struct PrefetchingIterator::Buffer {
+  explicit Buffer(const Schema& schema)
+      : arena(1024, 256*1024),
+        block(schema, kPrefetchRowBuffer, &arena),
+        next_row_idx(0) {
+  }
+
+  Arena arena;
+  RowBlock block;
+
+  // Index of the next row of 'block' to return.
+  size_t next_row_idx;
+};
+
+class PrefetchingIterator::PrefetchTask : public Runnable {
+ public:
+  explicit PrefetchTask(PrefetchingIterator* iter)
+      : iter_(iter),
+        ran_(false) {
+  }
+
+  ~PrefetchTask() {
+    if (!ran_) {
+      iter_->AbandonPrefetch();
+    }
+  }
+
+  void Run() OVERRIDE {
+    ran_ = true;
+    iter_->RunPrefetch();
+  }
+
+ private:
+  PrefetchingIterator* const iter_;
+  bool ran_;
+};
+
+PrefetchingIterator::PrefetchingIterator(shared_ptr<RowwiseIterator> iter,
+                                         ThreadPool* pool,
+                                         int max_buffered_blocks)
+    : iter_(std::move(iter)),
+      pool_(DCHECK_NOTNULL(pool)),
+      max_buffered_blocks_(max_buffered_blocks),
+      cond_(&lock_),
+      initted_(false),
+      started_(false),
+      cancelled_(false),
+      task_in_flight_(false),
+      iter_has_next_(false) {
+  CHECK_GT(max_buffered_blocks, 0);
+}
+
+PrefetchingIterator::~PrefetchingIterator() {
+  MutexLock l(lock_);
+  cancelled_ = true;
+  while (task_in_flight_) {
+    cond_.Wait();
+  }
+}
+
+Status PrefetchingIterator::Init(ScanSpec *spec) {
+  CHECK(!initted_);
+  RETURN_NOT_OK(PredicateEvaluatingIterator::InitAndMaybeWrap(&iter_, spec));
+  bool empty = !iter_->HasNext();
+  bool submit;
+  {
+    MutexLock l(lock_);
+    iter_has_next_ = !empty;
+    initted_ = true;
+    submit = ShouldSubmitUnlocked();
+  }
+  if (submit) {
+    SubmitPrefetchTask();
+  }
+  if (empty && successor_) {
+    // NextBlock() may never be called on an empty iterator.
+    successor_->StartPrefetching();
+    successor_.reset();
+  }
+  return Status::OK();
+}
+
+void PrefetchingIterator::StartPrefetching() {
+  bool submit;
+  {
+    MutexLock l(lock_);
+    started_ = true;
+    submit = ShouldSubmitUnlocked();
+  }
+  if (submit) {
+    SubmitPrefetchTask();
+  }
+}
+
+bool PrefetchingIterator::ShouldSubmitUnlocked() {
+  lock_.AssertAcquired();
+  if (!initted_ || !started_ || cancelled_ || task_in_flight_ ||
+      !status_.ok() || !iter_has_next_ || ready_.size() >= max_buffered_blocks_) {
+    return false;
+  }
+  task_in_flight_ = true;
+  return true;
+}
+
+void PrefetchingIterator::SubmitPrefetchTask() {
+  // This must not be called with 'lock_' held: if the submission fails, the
+  // task is destroyed and abandons itself, which takes the lock.
+  Status s = pool_->Submit(std::make_shared<PrefetchTask>(this));
+  WARN_NOT_OK(s, "Unable to submit prefetch task");
+}
+
+void PrefetchingIterator::RunPrefetch() {
+  unique_ptr<Buffer> buf;
+  {
+    MutexLock l(lock_);
+    DCHECK(task_in_flight_);
+    if (cancelled_) {
+      task_in_flight_ = false;
+      cond_.Broadcast();
+      return;
+    }
+    if (!free_.empty()) {
+      buf = std::move(free_.back());
+      free_.pop_back();
+    }
+  }
+
+  while (true) {
+    if (!buf) {
+      buf.reset(new Buffer(iter_->schema()));
+    }
+    buf->arena.Reset();
+    buf->next_row_idx = 0;
+    Status s = iter_->NextBlock(&buf->block);
+    bool has_next = s.ok() && iter_->HasNext();
+
+    MutexLock l(lock_);
+    iter_has_next_ = has_next;
+    if (PREDICT_FALSE(!s.ok())) {
+      status_ = s;
+    } else {
+      ready_.push_back(std::move(buf));
+    }
+    cond_.Broadcast();
+    if (!iter_has_next_ || cancelled_ || !status_.ok() ||
+        ready_.size() >= max_buffered_blocks_) {
+      task_in_flight_ = false;
+      return;
+    }
+    if (!free_.empty()) {
+      buf = std::move(free_.back());
+      free_.pop_back();
+    }
+  }
+}
+
+void PrefetchingIterator::AbandonPrefetch() {
+  MutexLock l(lock_);
+  DCHECK(task_in_flight_);
+  task_in_flight_ = false;
+  if (status_.ok()) {
+    status_ = Status::Aborted("prefetch task was not run");
+  }
+  cond_.Broadcast();
+}
+
+bool PrefetchingIterator::HasNext() const {
+  MutexLock l(lock_);
+  DCHECK(initted_);
+  // An error is returned by the next call to NextBlock().
+  return !status_.ok() || !ready_.empty() || task_in_flight_ || iter_has_next_;
+}
+
+Status PrefetchingIterator::NextBlock(RowBlock* dst) {
+  DCHECK_SCHEMA_EQ(dst->schema(), schema());
+  size_t n = 0;
+  bool submit = false;
+  bool exhausted;
+  {
+    MutexLock l(lock_);
+    DCHECK(initted_);
+    for (unique_ptr<Buffer>& buf : retired_) {
+      free_.push_back(std::move(buf));
+    }
+    retired_.clear();
+    started_ = true;
+
+    dst->Resize(dst->row_capacity());
+    while (n == 0 && dst->nrows() > 0) {
+      if (ShouldSubmitUnlocked()) {
+        // Decode the next blocks while the caller is busy with this one.
+        l.Unlock();
+        SubmitPrefetchTask();
+        l.Lock();
+      }
+      while (ready_.empty() && task_in_flight_) {
+        cond_.Wait();
+      }
+      RETURN_NOT_OK(status_);
+      if (ready_.empty()) {
+        // The wrapped iterator is exhausted.
+        break;
+      }
+
+      // Copy the selected rows of the decoded blocks.
+      while (n < dst->nrows() && !ready_.empty()) {
+        Buffer* buf = ready_.front().get();
+        const SelectionVector* sel = buf->block.selection_vector();
+        for (; buf->next_row_idx < buf->block.nrows() && n < dst->nrows();
+             buf->next_row_idx++) {
+          if (!sel->IsRowSelected(buf->next_row_idx)) continue;
+          RowBlockRow dst_row = dst->row(n++);
+          RETURN_NOT_OK(CopyRow(buf->block.row(buf->next_row_idx), &dst_row, dst->arena()));
+        }
+        if (buf->next_row_idx == buf->block.nrows()) {
+          retired_.push_back(std::move(ready_.front()));
+          ready_.pop_front();
+        }
+      }
+    }
+    dst->Resize(n);
+    dst->selection_vector()->SetAllTrue();
+
+    submit = ShouldSubmitUnlocked();
+    exhausted = ready_.empty() && !task_in_flight_ && !iter_has_next_;
+  }
+  if (submit) {
+    SubmitPrefetchTask();
+  }
+  if (exhausted && successor_) {
+    successor_->StartPrefetching();
+    successor_.reset();
+  }
+  return Status::OK();
+}
+
+string PrefetchingIterator::ToString() const {
+  return strings::Substitute("Prefetching($0)", iter_->ToString());
+}
+
+void PrefetchingIterator::GetIteratorStats(vector<IteratorStats>* stats) const {
+  MutexLock l(lock_);
+  while (task_in_flight_) {
+    cond_.Wait();
+  }
+  iter_->GetIteratorStats(stats);
+}
+
 } // namespace kudu
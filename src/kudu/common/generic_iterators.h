@@ -23,16 +23,20 @@
 #include <string>
 #include <tuple>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "kudu/common/iterator.h"
 #include "kudu/common/scan_spec.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/object_pool.h"
 
 namespace kudu {
 
 class Arena;
 class MergeIterState;
+class ThreadPool;
 
 // An iterator which merges the results of other iterators, comparing
 // based on keys.
@@ -63,6 +67,12 @@ class MergeIterator : public RowwiseIterator {
   Status MaterializeBlock(RowBlock* dst);
   Status InitSubIterators(ScanSpec *spec);
 
+  // Returns true if the next row of heap_[a] sorts before that of heap_[b].
+  bool HeapLess(size_t a, size_t b) const;
+
+  // Restores the heap property of heap_ below 'idx'.
+  void SiftDown(size_t idx);
+
   const Schema schema_;
 
   bool initted_;
@@ -72,6 +82,10 @@ class MergeIterator : public RowwiseIterator {
   std::deque<std::shared_ptr<RowwiseIterator> > orig_iters_;
   std::vector<std::unique_ptr<MergeIterState> > iters_;
 
+  // The sub-iterators which are not yet exhausted, as a min-heap ordered
+  // by their next rows. Points into iters_.
+  std::vector<MergeIterState*> heap_;
+
   // When the underlying iterators are initialized, each needs its own
   // copy of the scan spec in order to do its own pushdown calculations, etc.
   // The copies are allocated from this pool so they can be automatically freed
@@ -224,5 +238,99 @@ class PredicateEvaluatingIterator : public RowwiseIterator {
   std::vector<ColumnPredicate> col_idx_predicates_;
 };
 
+// Wraps a RowwiseIterator and decodes its blocks ahead of the consumer on a
+// thread pool. Wrapping each of the per-rowset iterators of a tablet lets
+// them be decoded in parallel while a single thread merges or unions them.
+//
+// The wrapped iterator is only ever used by one thread at a time: at most one
+// prefetch task is in flight, and the consumer only touches the wrapped
+// iterator while none is. Returned blocks only contain selected rows.
+class PrefetchingIterator : public RowwiseIterator {
+ public:
+  // 'max_buffered_blocks' bounds the number of decoded blocks held ahead of
+  // the consumer. The wrapped iterator should not yet be initialized.
+  PrefetchingIterator(std::shared_ptr<RowwiseIterator> iter,
+                      ThreadPool* pool,
+                      int max_buffered_blocks);
+
+  // Waits for any in-flight prefetch task.
+  virtual ~PrefetchingIterator();
+
+  // Initializes the wrapped iterator, which evaluates all of the predicates.
+  Status Init(ScanSpec *spec) OVERRIDE;
+
+  // Start decoding blocks in the background. Otherwise, this happens on the
+  // first call to NextBlock(). If called before Init(), prefetching starts
+  // once the iterator is initialized.
+  void StartPrefetching();
+
+  // Sets an iterator whose prefetching is started once this one has returned
+  // all of its rows. This is used to slide a window of prefetching iterators
+  // over a sequence of iterators consumed in order.
+  void set_successor(std::shared_ptr<PrefetchingIterator> successor) {
+    successor_ = std::move(successor);
+  }
+
+  bool HasNext() const OVERRIDE;
+
+  std::string ToString() const OVERRIDE;
+
+  const Schema &schema() const OVERRIDE {
+    return iter_->schema();
+  }
+
+  virtual void GetIteratorStats(std::vector<IteratorStats>* stats) const OVERRIDE;
+
+  virtual Status NextBlock(RowBlock* dst) OVERRIDE;
+
+ private:
+  class PrefetchTask;
+  struct Buffer;
+
+  // Returns true if a prefetch task should be submitted, marking it in flight.
+  bool ShouldSubmitUnlocked();
+  void SubmitPrefetchTask();
+
+  // Decodes blocks until the buffer is full or the wrapped iterator is
+  // exhausted. Runs on the thread pool.
+  void RunPrefetch();
+
+  // Called if a submitted task is destroyed without having run, e.g. when
+  // the thread pool is shut down.
+  void AbandonPrefetch();
+
+  std::shared_ptr<RowwiseIterator> iter_;
+  ThreadPool* const pool_;
+  const size_t max_buffered_blocks_;
+  std::shared_ptr<PrefetchingIterator> successor_;
+
+  // Protects all of the below.
+  mutable Mutex lock_;
+  mutable ConditionVariable cond_;
+
+  bool initted_;
+  bool started_;
+  bool cancelled_;
+  bool task_in_flight_;
+
+  // Whether the wrapped iterator has more rows to decode.
+  bool iter_has_next_;
+
+  // The first error returned by the wrapped iterator.
+  Status status_;
+
+  // Decoded blocks, in iteration order.
+  std::deque<std::unique_ptr<Buffer> > ready_;
+
+  // Blocks consumed by the last call to NextBlock(). If the caller's block
+  // has no arena, it references their indirect data until the next call.
+  std::vector<std::unique_ptr<Buffer> > retired_;
+
+  // Blocks available for reuse by the prefetch task.
+  std::vector<std::unique_ptr<Buffer> > free_;
+
+  DISALLOW_COPY_AND_ASSIGN(PrefetchingIterator);
+};
+
 } // namespace kudu
 #endif
@@ -20,6 +20,7 @@
 #include <string>
 #include <vector>
 
+#include "kudu/common/column_materialization_context.h"
 #include "kudu/common/columnblock.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
@@ -99,6 +100,16 @@ class ColumnwiseIterator : public virtual IteratorBase {
   // arena, if non-null.
   virtual Status MaterializeColumn(size_t col_idx, ColumnBlock *dst) = 0;
 
+  // Materialize the column described by 'ctx' into ctx->block(), possibly
+  // evaluating the context's predicate while decoding. See
+  // ColumnMaterializationContext for the contract.
+  //
+  // The default implementation does not support evaluation during decoding.
+  virtual Status MaterializeColumn(ColumnMaterializationContext *ctx) {
+    ctx->SetDecoderEvalNotSupported();
+    return MaterializeColumn(ctx->col_idx(), ctx->block());
+  }
+
   // Finish the current batch.
   virtual Status FinishBatch() = 0;
 
@@ -140,7 +140,8 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
 
   const Schema& schema = *CHECK_NOTNULL(row->schema());
   int pushed_predicates = 0;
-  // Tracks whether the last pushed predicate is an equality predicate.
+  // Tracks whether the last pushed predicate is an equality or IN list
+  // predicate.
   const ColumnPredicate* final_predicate = nullptr;
 
   // Step 1: copy predicates into the row in key column order, stopping after
@@ -155,6 +156,12 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
       memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_lower(), size);
       pushed_predicates++;
       final_predicate = predicate;
+    } else if (predicate->predicate_type() == PredicateType::InList) {
+      // The largest value in the list bounds the key in the same way as an
+      // equality predicate on that value.
+      memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_values().back(), size);
+      pushed_predicates++;
+      final_predicate = predicate;
     } else if (predicate->predicate_type() == PredicateType::Range) {
       if (predicate->raw_upper() != nullptr) {
         memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_upper(), size);
@@ -176,7 +183,8 @@ int PushUpperBoundKeyPredicates(ColIdxIter first,
 
   // Step 2: If the final predicate is an equality predicate, increment the
   // key to convert it to an exclusive upper bound.
-  if (final_predicate->predicate_type() == PredicateType::Equality) {
+  if (final_predicate->predicate_type() == PredicateType::Equality ||
+      final_predicate->predicate_type() == PredicateType::InList) {
     if (!IncrementKey(first, std::next(first, pushed_predicates), row, arena)) {
       // If the increment fails then this bound is is not constraining the keyspace.
       return 0;
@@ -208,6 +216,11 @@ int PushLowerBoundKeyPredicates(ColIdxIter first,
     if (predicate->predicate_type() == PredicateType::Equality) {
       memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_lower(), size);
       pushed_predicates++;
+    } else if (predicate->predicate_type() == PredicateType::InList) {
+      // The smallest value in the list bounds the key in the same way as an
+      // equality predicate on that value.
+      memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_values().front(), size);
+      pushed_predicates++;
     } else if (predicate->predicate_type() == PredicateType::Range) {
       if (predicate->raw_lower() != nullptr) {
         memcpy(row->mutable_cell_ptr(*col_idx_it), predicate->raw_lower(), size);
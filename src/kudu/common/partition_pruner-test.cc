@@ -65,6 +65,11 @@ void CheckPrunedPartitions(const Schema& schema,
   ASSERT_EQ(remaining_tablets, partitions.size() - pruned_partitions);
 }
 
+// Creates an IN list predicate on the column from the values.
+ColumnPredicate InList(const ColumnSchema& column, vector<const void*> values) {
+  return ColumnPredicate::InList(column, &values);
+}
+
 TEST(TestPartitionPruner, TestPrimaryKeyRangePruning) {
   // CREATE TABLE t
   // (a INT8, b INT8, c INT8)
@@ -377,6 +382,20 @@ TEST(TestPartitionPruner, TestRangePruning) {
   // c < 100
   Check({ ColumnPredicate::Range(schema.column(2), &five, &hundred) }, 2);
 
+  // c IN (-10, 0)
+  Check({ InList(schema.column(2), { &neg_ten, &zero }) }, 2);
+
+  // c IN (-10, 100)
+  Check({ InList(schema.column(2), { &neg_ten, &hundred }) }, 2);
+
+  // c IN (-10, 100)
+  // c < 10
+  Check({ InList(schema.column(2), { &neg_ten, &hundred }),
+          ColumnPredicate::Range(schema.column(2), nullptr, &ten) }, 1);
+
+  // c IN (5, 100)
+  Check({ InList(schema.column(2), { &five, &hundred }) }, 2);
+
   // b = ""
   Check({ ColumnPredicate::Equality(schema.column(1), &empty) }, 3);
 
@@ -517,6 +536,38 @@ TEST(TestPartitionPruner, TestHashPruning) {
           ColumnPredicate::Equality(schema.column(1), &one),
           ColumnPredicate::Equality(schema.column(2), &two) },
         1);
+
+  // a IN (0, 0);
+  Check({ InList(schema.column(0), { &zero, &zero }) }, 2);
+
+  // b IN (1);
+  // c IN (2);
+  Check({ InList(schema.column(1), { &one }),
+          InList(schema.column(2), { &two }) },
+        2);
+
+  // a = 0;
+  // b IN (1);
+  // c IN (2);
+  Check({ ColumnPredicate::Equality(schema.column(0), &zero),
+          InList(schema.column(1), { &one }),
+          InList(schema.column(2), { &two }) },
+        1);
+
+  // b IN (0, 1);
+  // c IN (0, 2);
+  //
+  // All combinations must be covered, so each bucket of the 'a' component is
+  // scanned at least once.
+  ScanSpec spec;
+  spec.AddPredicate(InList(schema.column(1), { &zero, &one }));
+  spec.AddPredicate(InList(schema.column(2), { &zero, &two }));
+  PartitionPruner pruner;
+  pruner.Init(schema, partition_schema, spec);
+  size_t remaining = count_if(partitions.begin(), partitions.end(),
+                              [&] (const Partition& p) { return !pruner.ShouldPrune(p); });
+  ASSERT_GE(remaining, 2);
+  ASSERT_LE(remaining, 4);
 }
 
 TEST(TestPartitionPruner, TestPruning) {
@@ -149,6 +149,74 @@ void EncodeRangeKeysFromPredicates(const Schema& schema,
     key_util::EncodeKey(col_idxs, row, range_key_end);
   }
 }
+
+// If the first range column is constrained by an IN list predicate, sets
+// 'intervals' to the range key interval covering the keys which start with
+// each of its values, in order, intersected with the range key bounds
+// ['lower', 'upper'). An empty bound is unbounded.
+//
+// Returns false if there is no such predicate, or if the intervals can't be
+// bounded, in which case the bounds should be used as a whole.
+bool EncodeRangeKeyIntervalsFromInList(const Schema& schema,
+                                       const unordered_map<string, ColumnPredicate>& predicates,
+                                       const vector<ColumnId>& range_columns,
+                                       const string& lower,
+                                       const string& upper,
+                                       vector<tuple<string, string>>* intervals) {
+  // Each value makes a separate interval for every hash bucket combination,
+  // so longer lists fall back to the bounds.
+  const size_t kMaxInListIntervals = 1024;
+
+  int32_t col_idx = schema.find_column_by_id(range_columns[0]);
+  CHECK(col_idx != Schema::kColumnNotFound);
+  const ColumnSchema& column = schema.column(col_idx);
+  const ColumnPredicate* predicate = FindOrNull(predicates, column.name());
+  if (predicate == nullptr || predicate->predicate_type() != PredicateType::InList) {
+    return false;
+  }
+  // A binary value followed by other columns is encoded with a separator, so
+  // the encoded keys which start with the value are not bounded by the
+  // encoding of its successor alone.
+  if (column.type_info()->physical_type() == BINARY && range_columns.size() > 1) {
+    return false;
+  }
+  const vector<const void*>& values = predicate->raw_values();
+  if (values.size() > kMaxInListIntervals) {
+    return false;
+  }
+
+  Arena arena(max<size_t>(Arena::kMinimumChunkSize, schema.key_byte_size()), 4096);
+  uint8_t* buf = static_cast<uint8_t*>(CHECK_NOTNULL(arena.AllocateBytes(schema.key_byte_size())));
+  ContiguousRow row(&schema, buf);
+  vector<int32_t> col_idxs = { col_idx };
+
+  vector<tuple<string, string>> ret;
+  for (const void* value : values) {
+    string start;
+    string end;
+    memcpy(row.mutable_cell_ptr(col_idx), value, column.type_info()->size());
+    key_util::EncodeKey(col_idxs, row, &start);
+    if (!key_util::IncrementCell(column, row.mutable_cell_ptr(col_idx), &arena)) {
+      // The value is the maximum of its type. This only happens for the last
+      // value, but leave the whole list to the bounds rather than special-case
+      // an unbounded interval.
+      return false;
+    }
+    key_util::EncodeKey(col_idxs, row, &end);
+
+    if (!lower.empty() && start < lower) {
+      start = lower;
+    }
+    if (!upper.empty() && upper < end) {
+      end = upper;
+    }
+    if (start < end) {
+      ret.emplace_back(move(start), move(end));
+    }
+  }
+  intervals->swap(ret);
+  return true;
+}
 } // anonymous namespace
 
 void PartitionPruner::Init(const Schema& schema,
@@ -242,35 +310,38 @@ void PartitionPruner::Init(const Schema& schema,
     }
   }
 
+  // Step 1b: If the first range column is constrained to a list of values,
+  // split the range bounds into an interval for each value, so that the range
+  // partitions between the values are pruned too. Either way, the intervals
+  // agree on whether their upper bound is empty.
+  vector<tuple<string, string>> range_intervals;
+  if (range_columns.empty() ||
+      !EncodeRangeKeyIntervalsFromInList(schema,
+                                         scan_spec.predicates(),
+                                         range_columns,
+                                         range_lower_bound,
+                                         range_upper_bound,
+                                         &range_intervals)) {
+    range_intervals.emplace_back(range_lower_bound, range_upper_bound);
+  } else if (range_intervals.empty()) {
+    // None of the values are within the bounds.
+    return;
+  } else {
+    range_lower_bound = get<0>(range_intervals.front());
+    range_upper_bound = get<1>(range_intervals.back());
+  }
+
   // Step 2: Create the hash bucket portion of the partition key.
 
-  // The list of hash buckets per hash component, or none if the component is
-  // not constrained.
-  vector<optional<uint32_t>> hash_buckets;
+  // The sorted set of hash buckets per hash component, or none if the
+  // component is not constrained.
+  vector<optional<vector<uint32_t>>> hash_buckets;
   hash_buckets.reserve(partition_schema.hash_bucket_schemas_.size());
   for (int hash_idx = 0; hash_idx < partition_schema.hash_bucket_schemas_.size(); hash_idx++) {
-    const auto& hash_bucket_schema = partition_schema.hash_bucket_schemas_[hash_idx];
-    string encoded_columns;
-    bool can_prune = true;
-    for (int col_offset = 0; col_offset < hash_bucket_schema.column_ids.size(); col_offset++) {
-      const ColumnSchema& column = schema.column_by_id(hash_bucket_schema.column_ids[col_offset]);
-      const ColumnPredicate* predicate = FindOrNull(scan_spec.predicates(), column.name());
-      if (predicate == nullptr || predicate->predicate_type() != PredicateType::Equality) {
-        can_prune = false;
-        break;
-      }
-
-      const KeyEncoder<string>& encoder = GetKeyEncoder<string>(column.type_info());
-      encoder.Encode(predicate->raw_lower(),
-                     col_offset + 1 == hash_bucket_schema.column_ids.size(),
-                     &encoded_columns);
-    }
-    if (can_prune) {
-      hash_buckets.push_back(partition_schema.BucketForEncodedColumns(encoded_columns,
-                                                                      hash_bucket_schema));
-    } else {
-      hash_buckets.push_back(boost::none);
-    }
+    hash_buckets.push_back(HashBucketsForPredicates(schema,
+                                                    partition_schema,
+                                                    hash_idx,
+                                                    scan_spec.predicates()));
   }
 
   // The index of the final constrained component in the partition key.
@@ -285,17 +356,22 @@ void PartitionPruner::Init(const Schema& schema,
                         distance(hash_buckets.rbegin(),
                                  find_if(hash_buckets.rbegin(),
                                          hash_buckets.rend(),
-                                         [] (const optional<uint32_t>& x) { return x; }));
+                                         [] (const optional<vector<uint32_t>>& x) {
+                                           return static_cast<bool>(x);
+                                         }));
   }
 
   // Build up a set of partition key ranges out of the hash components.
   //
-  // Each constrained hash component simply appends its bucket number to the
-  // partition key ranges (possibly incrementing the upper bound by one bucket
-  // number if this is the final constraint, see note 2 in the example above).
+  // Each hash component constrained to a single bucket simply appends its
+  // bucket number to the partition key ranges (possibly incrementing the upper
+  // bound by one bucket number if this is the final constraint, see note 2 in
+  // the example above).
   //
   // Each unconstrained hash component results in creating a new partition key
-  // range for each bucket of the hash component.
+  // range for each bucket of the hash component. Components constrained by IN
+  // list predicates to a set of buckets do the same, but only for the buckets
+  // in the set.
   vector<tuple<string, string>> partition_key_ranges(1);
   const KeyEncoder<string>& hash_encoder = GetKeyEncoder<string>(GetTypeInfo(UINT32));
   for (int hash_idx = 0; hash_idx < constrained_index; hash_idx++) {
@@ -305,10 +381,10 @@ void PartitionPruner::Init(const Schema& schema,
     // exclusive.
     bool is_last = hash_idx + 1 == constrained_index && range_upper_bound.empty();
 
-    if (hash_buckets[hash_idx]) {
+    if (hash_buckets[hash_idx] && hash_buckets[hash_idx]->size() == 1) {
       // This hash component is constrained by equality predicates to a single
       // hash bucket.
-      uint32_t bucket = *hash_buckets[hash_idx];
+      uint32_t bucket = hash_buckets[hash_idx]->front();
       uint32_t bucket_upper = is_last ? bucket + 1 : bucket;
       for (auto& partition_key_range : partition_key_ranges) {
         hash_encoder.Encode(&bucket, &get<0>(partition_key_range));
@@ -316,10 +392,17 @@ void PartitionPruner::Init(const Schema& schema,
       }
     } else {
       const auto& hash_bucket_schema = partition_schema.hash_bucket_schemas_[hash_idx];
+      vector<uint32_t> buckets;
+      if (hash_buckets[hash_idx]) {
+        buckets = *hash_buckets[hash_idx];
+      } else {
+        buckets.resize(hash_bucket_schema.num_buckets);
+        iota(buckets.begin(), buckets.end(), 0);
+      }
       // Add a partition key range for each possible hash bucket.
       vector<tuple<string, string>> new_partition_key_ranges;
       for (const auto& partition_key_range : partition_key_ranges) {
-        for (uint32_t bucket = 0; bucket < hash_bucket_schema.num_buckets; bucket++) {
+        for (uint32_t bucket : buckets) {
           uint32_t bucket_upper = is_last ? bucket + 1 : bucket;
           string lower = get<0>(partition_key_range);
           string upper = get<1>(partition_key_range);
@@ -332,10 +415,23 @@ void PartitionPruner::Init(const Schema& schema,
     }
   }
 
-  // Step 3: append the (possibly empty) range bounds to the partition key ranges.
-  for (auto& range : partition_key_ranges) {
-    get<0>(range).append(range_lower_bound);
-    get<1>(range).append(range_upper_bound);
+  // Step 3: append the (possibly empty) range bounds to the partition key
+  // ranges, once for each range interval.
+  if (range_intervals.size() == 1) {
+    for (auto& range : partition_key_ranges) {
+      get<0>(range).append(range_lower_bound);
+      get<1>(range).append(range_upper_bound);
+    }
+  } else {
+    vector<tuple<string, string>> new_partition_key_ranges;
+    new_partition_key_ranges.reserve(partition_key_ranges.size() * range_intervals.size());
+    for (const auto& range : partition_key_ranges) {
+      for (const auto& interval : range_intervals) {
+        new_partition_key_ranges.emplace_back(get<0>(range) + get<0>(interval),
+                                              get<1>(range) + get<1>(interval));
+      }
+    }
+    partition_key_ranges.swap(new_partition_key_ranges);
   }
 
   // Step 4: remove all partition key ranges past the scan spec's upper bound partition key.
@@ -366,6 +462,56 @@ void PartitionPruner::Init(const Schema& schema,
   }
 }
 
+optional<vector<uint32_t>> PartitionPruner::HashBucketsForPredicates(
+    const Schema& schema,
+    const PartitionSchema& partition_schema,
+    int hash_idx,
+    const unordered_map<string, ColumnPredicate>& predicates) {
+  // Every combination of the column values is hashed, so the component is
+  // treated as unconstrained if there are more than this many of them.
+  const size_t kMaxHashCombinations = 1024;
+  const auto& hash_bucket_schema = partition_schema.hash_bucket_schemas_[hash_idx];
+
+  // The encoded column values of every combination of predicate values.
+  vector<string> encoded_columns(1);
+  for (int col_offset = 0; col_offset < hash_bucket_schema.column_ids.size(); col_offset++) {
+    const ColumnSchema& column = schema.column_by_id(hash_bucket_schema.column_ids[col_offset]);
+    const ColumnPredicate* predicate = FindOrNull(predicates, column.name());
+    if (predicate == nullptr) return boost::none;
+
+    vector<const void*> values;
+    if (predicate->predicate_type() == PredicateType::Equality) {
+      values.push_back(predicate->raw_lower());
+    } else if (predicate->predicate_type() == PredicateType::InList) {
+      values = predicate->raw_values();
+    } else {
+      return boost::none;
+    }
+    if (encoded_columns.size() * values.size() > kMaxHashCombinations) return boost::none;
+
+    const KeyEncoder<string>& encoder = GetKeyEncoder<string>(column.type_info());
+    bool is_last = col_offset + 1 == hash_bucket_schema.column_ids.size();
+    vector<string> new_encoded_columns;
+    new_encoded_columns.reserve(encoded_columns.size() * values.size());
+    for (const string& prefix : encoded_columns) {
+      for (const void* value : values) {
+        string encoded = prefix;
+        encoder.Encode(value, is_last, &encoded);
+        new_encoded_columns.push_back(move(encoded));
+      }
+    }
+    encoded_columns.swap(new_encoded_columns);
+  }
+
+  vector<uint32_t> buckets;
+  for (const string& encoded : encoded_columns) {
+    buckets.push_back(partition_schema.BucketForEncodedColumns(encoded, hash_bucket_schema));
+  }
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+  return buckets;
+}
+
 bool PartitionPruner::HasMorePartitionKeyRanges() const {
   return !partition_key_ranges_.empty();
 }
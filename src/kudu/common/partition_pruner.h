@@ -17,14 +17,17 @@
 
 #pragma once
 
+#include <boost/optional.hpp>
 #include <string>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/gutil/macros.h"
 
 namespace kudu {
 
+class ColumnPredicate;
 class Partition;
 class PartitionSchema;
 class ScanSpec;
@@ -63,6 +66,18 @@ class PartitionPruner {
   std::string ToString(const Schema& schema, const PartitionSchema& partition_schema) const;
 
  private:
+  // Returns the sorted set of hash buckets of the hash component at index
+  // 'hash_idx' which may contain rows matching the predicates, or none if the
+  // hash component is not constrained by the predicates.
+  //
+  // A hash component is constrained when each of its columns has an equality
+  // or IN list predicate.
+  static boost::optional<std::vector<uint32_t>> HashBucketsForPredicates(
+      const Schema& schema,
+      const PartitionSchema& partition_schema,
+      int hash_idx,
+      const std::unordered_map<std::string, ColumnPredicate>& predicates);
+
   // The reverse sorted set of partition key ranges. Each range has an inclusive
   // lower and exclusive upper bound.
   std::vector<std::tuple<std::string, std::string>> partition_key_ranges_;
@@ -20,12 +20,14 @@
 #include <string>
 
 #include "kudu/common/partial_row.h"
+#include "kudu/common/row.h"
 #include "kudu/common/row_operations.h"
 #include "kudu/common/schema.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/test_util.h"
 
 using std::shared_ptr;
+using std::unique_ptr;
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 
@@ -378,6 +380,102 @@ TEST_F(RowOperationsTest, ProjectionTestWholeSchemaSpecified) {
   }
 }
 
+// Test that full rows from a client whose schema has the tablet's layout
+// reference the request in place, and that partial rows in the same batch
+// still get projected.
+TEST_F(RowOperationsTest, TestDecodeFullRowsSameLayout) {
+  Schema client_schema({ ColumnSchema("key", INT32),
+                         ColumnSchema("int_val", INT32, true),
+                         ColumnSchema("string_val", STRING, true) },
+                       1);
+  Schema server_schema = client_schema.CopyWithColumnIds();
+
+  RowOperationsPB pb;
+  RowOperationsPBEncoder enc(&pb);
+  {
+    KuduPartialRow row(&client_schema);
+    CHECK_OK(row.SetInt32("key", 1));
+    CHECK_OK(row.SetInt32("int_val", 10));
+    CHECK_OK(row.SetStringCopy("string_val", "hello"));
+    enc.Add(RowOperationsPB::INSERT, row);
+  }
+  {
+    KuduPartialRow row(&client_schema);
+    CHECK_OK(row.SetInt32("key", 2));
+    CHECK_OK(row.SetNull("int_val"));
+    CHECK_OK(row.SetStringCopy("string_val", "world"));
+    enc.Add(RowOperationsPB::UPSERT, row);
+  }
+  {
+    KuduPartialRow row(&client_schema);
+    CHECK_OK(row.SetInt32("key", 3));
+    enc.Add(RowOperationsPB::INSERT, row);
+  }
+
+  Arena arena(1024, 1024*1024);
+  vector<DecodedRowOperation> ops;
+  RowOperationsPBDecoder dec(&pb, &client_schema, &server_schema, &arena);
+  ASSERT_OK(dec.DecodeOperations(&ops));
+  ASSERT_EQ(3, ops.size());
+  EXPECT_EQ("INSERT (int32 key=1, int32 int_val=10, string string_val=hello)",
+            ops[0].ToString(server_schema));
+  EXPECT_EQ("UPSERT (int32 key=2, int32 int_val=NULL, string string_val=world)",
+            ops[1].ToString(server_schema));
+  EXPECT_EQ("INSERT (int32 key=3, int32 int_val=NULL, string string_val=NULL)",
+            ops[2].ToString(server_schema));
+
+  // The full rows' isset bitmaps and strings point into the request.
+  const uint8_t* rows_begin = reinterpret_cast<const uint8_t*>(pb.rows().data());
+  const uint8_t* rows_end = rows_begin + pb.rows().size();
+  for (int i = 0; i < 2; i++) {
+    EXPECT_GE(ops[i].isset_bitmap, rows_begin);
+    EXPECT_LT(ops[i].isset_bitmap, rows_end);
+    ConstContiguousRow row(&server_schema, ops[i].row_data);
+    const Slice* str = reinterpret_cast<const Slice*>(row.cell_ptr(2));
+    EXPECT_GE(str->data(), reinterpret_cast<const uint8_t*>(pb.indirect_data().data()));
+    EXPECT_LT(str->data(), reinterpret_cast<const uint8_t*>(pb.indirect_data().data()) +
+              pb.indirect_data().size());
+  }
+}
+
+// Test that the sizes computed ahead of encoding match the encoded rows, so
+// that reserving them keeps the buffers from being reallocated.
+TEST_F(RowOperationsTest, TestReserveEncodedSize) {
+  vector<unique_ptr<KuduPartialRow>> rows;
+  for (int i = 0; i < 100; i++) {
+    unique_ptr<KuduPartialRow> row(new KuduPartialRow(&schema_without_ids_));
+    CHECK_OK(row->SetInt32("key", i));
+    if (i % 2 == 0) {
+      CHECK_OK(row->SetInt32("int_val", i));
+    }
+    if (i % 3 == 0) {
+      CHECK_OK(row->SetNull("string_val"));
+    } else {
+      CHECK_OK(row->SetStringCopy("string_val", string(i, 'x')));
+    }
+    rows.push_back(std::move(row));
+  }
+
+  size_t rows_size = 0;
+  size_t indirect_size = 0;
+  for (const auto& row : rows) {
+    RowOperationsPBEncoder::AddEncodedSize(*row, &rows_size, &indirect_size);
+  }
+
+  RowOperationsPB pb;
+  RowOperationsPBEncoder enc(&pb);
+  enc.Reserve(schema_without_ids_, rows_size, indirect_size);
+  const char* rows_data = pb.rows().data();
+  const char* indirect_data = pb.indirect_data().data();
+  for (const auto& row : rows) {
+    enc.Add(RowOperationsPB::INSERT, *row);
+  }
+  ASSERT_EQ(rows_size, pb.rows().size());
+  ASSERT_EQ(indirect_size, pb.indirect_data().size());
+  ASSERT_EQ(rows_data, pb.rows().data());
+  ASSERT_EQ(indirect_data, pb.indirect_data().data());
+}
+
 TEST_F(RowOperationsTest, ProjectionTestWithDefaults) {
   int32_t nullable_default = 123;
   int32_t non_null_default = 456;
@@ -117,6 +117,42 @@ void RowOperationsPBEncoder::Add(RowOperationsPB::Type op_type, const KuduPartia
   dst->resize(reinterpret_cast<char*>(dst_ptr) - &(*dst)[0]);
 }
 
+void RowOperationsPBEncoder::AddEncodedSize(const KuduPartialRow& partial_row,
+                                            size_t* rows_size, size_t* indirect_size) {
+  const Schema* schema = partial_row.schema();
+  size_t size = 1 + BitmapSize(schema->num_columns()) +
+      ContiguousRowHelper::null_bitmap_size(*schema);
+
+  ContiguousRow row(schema, partial_row.row_data_);
+  for (int i = 0; i < schema->num_columns(); i++) {
+    if (!partial_row.IsColumnSet(i)) continue;
+    const ColumnSchema& col = schema->column(i);
+
+    if (col.is_nullable() && row.is_null(i)) continue;
+
+    if (col.type_info()->physical_type() == BINARY) {
+      const Slice* val = reinterpret_cast<const Slice*>(row.cell_ptr(i));
+      *indirect_size += val->size();
+      size += sizeof(Slice);
+    } else {
+      size += col.type_info()->size();
+    }
+  }
+  *rows_size += size;
+}
+
+void RowOperationsPBEncoder::Reserve(const Schema& schema,
+                                     size_t rows_size, size_t indirect_size) {
+  // Add() temporarily grows 'rows' by the maximum size of a row before
+  // shrinking it back to the row's actual size.
+  size_t max_row_size = 1 + schema.byte_size() + BitmapSize(schema.num_columns()) +
+      ContiguousRowHelper::null_bitmap_size(schema);
+  string* rows = pb_->mutable_rows();
+  rows->reserve(rows->size() + rows_size + max_row_size);
+  string* indirect_data = pb_->mutable_indirect_data();
+  indirect_data->reserve(indirect_data->size() + indirect_size);
+}
+
 // ------------------------------------------------------------
 // Decoder
 // ------------------------------------------------------------
@@ -131,7 +167,8 @@ RowOperationsPBDecoder::RowOperationsPBDecoder(const RowOperationsPB* pb,
     dst_arena_(dst_arena),
     bm_size_(BitmapSize(client_schema_->num_columns())),
     tablet_row_size_(ContiguousRowHelper::row_size(*tablet_schema_)),
-    src_(pb->rows().data(), pb->rows().size()) {
+    src_(pb->rows().data(), pb->rows().size()),
+    same_layout_(false) {
 }
 
 RowOperationsPBDecoder::~RowOperationsPBDecoder() {
@@ -304,6 +341,52 @@ class ClientServerMapping {
 };
 
 
+bool RowOperationsPBDecoder::IsSameLayout(const ClientServerMapping& mapping) const {
+  if (client_schema_->num_columns() != tablet_schema_->num_columns()) {
+    return false;
+  }
+  for (int i = 0; i < client_schema_->num_columns(); i++) {
+    if (mapping.client_to_tablet_idx(i) != i ||
+        client_schema_->column(i).is_nullable() != tablet_schema_->column(i).is_nullable()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status RowOperationsPBDecoder::DecodeFullRowSameLayout(const uint8_t* client_isset_map,
+                                                       DecodedRowOperation* op) {
+  DCHECK(same_layout_);
+  uint8_t* tablet_row_storage = reinterpret_cast<uint8_t*>(
+      dst_arena_->AllocateBytesAligned(tablet_row_size_, 8));
+  if (PREDICT_FALSE(!tablet_row_storage)) {
+    return Status::RuntimeError("Out of memory");
+  }
+  ContiguousRow tablet_row(tablet_schema_, tablet_row_storage);
+
+  const uint8_t* client_null_map = nullptr;
+  if (tablet_schema_->has_nullables()) {
+    RETURN_NOT_OK(ReadNullBitmap(&client_null_map));
+    memcpy(ContiguousRowHelper::null_bitmap_ptr(*tablet_schema_, tablet_row_storage),
+           client_null_map, ContiguousRowHelper::null_bitmap_size(*tablet_schema_));
+  }
+
+  for (int col_idx = 0; col_idx < tablet_schema_->num_columns(); col_idx++) {
+    const ColumnSchema& col = tablet_schema_->column(col_idx);
+    uint8_t* dst = tablet_row.mutable_cell_ptr(col_idx);
+    if (col.is_nullable() && BitmapTest(client_null_map, col_idx)) {
+      // Keep the unused cell deterministic, as the prototype row would.
+      memset(dst, 0, col.type_info()->size());
+      continue;
+    }
+    RETURN_NOT_OK(ReadColumn(col, dst));
+  }
+
+  op->row_data = tablet_row_storage;
+  op->isset_bitmap = client_isset_map;
+  return Status::OK();
+}
+
 Status RowOperationsPBDecoder::DecodeInsertOrUpsert(const uint8_t* prototype_row_storage,
                                                     const ClientServerMapping& mapping,
                                                     DecodedRowOperation* op) {
@@ -312,6 +395,10 @@ Status RowOperationsPBDecoder::DecodeInsertOrUpsert(const uint8_t* prototype_row
 
   // Read the null and isset bitmaps for the client-provided row.
   RETURN_NOT_OK(ReadIssetBitmap(&client_isset_map));
+  if (same_layout_ &&
+      BitMapIsAllSet(client_isset_map, 0, client_schema_->num_columns())) {
+    return DecodeFullRowSameLayout(client_isset_map, op);
+  }
   if (client_schema_->has_nullables()) {
     RETURN_NOT_OK(ReadNullBitmap(&client_null_map));
   }
@@ -550,6 +637,7 @@ Status RowOperationsPBDecoder::DecodeOperations(vector<DecodedRowOperation>* ops
   RETURN_NOT_OK(client_schema_->GetProjectionMapping(*tablet_schema_, &mapping));
   DCHECK_EQ(mapping.num_mapped(), client_schema_->num_columns());
   RETURN_NOT_OK(mapping.CheckAllRequiredColumnsPresent());
+  same_layout_ = IsSameLayout(mapping);
 
   // Make a "prototype row" which has all the defaults filled in. We can copy
   // this to create a starting point for each row as we decode it, with
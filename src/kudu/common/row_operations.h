@@ -42,6 +42,16 @@ class RowOperationsPBEncoder {
   // Append this partial row to the protobuf.
   void Add(RowOperationsPB::Type type, const KuduPartialRow& row);
 
+  // Adds the number of bytes which Add() appends to the 'rows' and
+  // 'indirect_data' fields for 'row' to '*rows_size' and '*indirect_size'.
+  static void AddEncodedSize(const KuduPartialRow& row,
+                             size_t* rows_size, size_t* indirect_size);
+
+  // Grows the capacity of the protobuf's buffers so that appending rows of
+  // 'schema' taking up to 'rows_size' and 'indirect_size' bytes (as computed
+  // by AddEncodedSize()) doesn't reallocate them.
+  void Reserve(const Schema& schema, size_t rows_size, size_t indirect_size);
+
  private:
   RowOperationsPB* pb_;
 
@@ -90,6 +100,19 @@ class RowOperationsPBDecoder {
   Status DecodeInsertOrUpsert(const uint8_t* prototype_row_storage,
                               const ClientServerMapping& mapping,
                               DecodedRowOperation* op);
+
+  // Fast path for DecodeInsertOrUpsert() when the client schema has the same
+  // layout as the tablet schema and the client set every column. No projection
+  // or defaults are needed: the isset bitmap is referenced in place in the
+  // request, as is any indirect data, and the null bitmap is copied verbatim.
+  //
+  // 'client_isset_map' must already have been read from the input.
+  Status DecodeFullRowSameLayout(const uint8_t* client_isset_map,
+                                 DecodedRowOperation* op);
+
+  // Returns true if 'mapping' maps every client column onto the tablet column
+  // at the same index, with the same nullability.
+  bool IsSameLayout(const ClientServerMapping& mapping) const;
   //------------------------------------------------------------
   // Serialization/deserialization support
   //------------------------------------------------------------
@@ -111,6 +134,10 @@ class RowOperationsPBDecoder {
   const int tablet_row_size_;
   Slice src_;
 
+  // Whether the client schema has the same layout as the tablet schema.
+  // Set by DecodeOperations().
+  bool same_layout_;
+
 
   DISALLOW_COPY_AND_ASSIGN(RowOperationsPBDecoder);
 };
@@ -43,7 +43,15 @@ void SelectionVector::Resize(size_t n_rows) {
 }
 
 size_t SelectionVector::CountSelected() const {
-  return Bits::Count(&bitmap_[0], n_bytes_);
+  return BitmapCountSet(&bitmap_[0], n_rows_);
+}
+
+void SelectionVector::GetSelectedRows(std::vector<int>* selected) const {
+  selected->clear();
+  selected->reserve(n_rows_);
+  BitmapForEachSetBit(&bitmap_[0], n_rows_, [selected](size_t row) {
+      selected->push_back(row);
+    });
 }
 
 bool SelectionVector::AnySelected() const {
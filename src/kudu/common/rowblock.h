@@ -63,6 +63,11 @@ class SelectionVector {
   // This is equivalent to (CountSelected() > 0), but faster.
   bool AnySelected() const;
 
+  // Set 'selected' to the indices of the selected rows, in ascending order,
+  // so that passes over the selected rows of several columns don't each have
+  // to walk the bitmap.
+  void GetSelectedRows(std::vector<int>* selected) const;
+
   bool IsRowSelected(size_t row) const {
     DCHECK_LT(row, n_rows_);
     return BitmapTest(&bitmap_[0], row);
@@ -118,6 +123,41 @@ class SelectionVector {
   gscoped_array<uint8_t> bitmap_;
 };
 
+// A view into a SelectionVector starting at a given row offset. Used by block
+// decoders to address rows relative to the start of their own output, in the
+// same way as ColumnDataView does for cell data.
+class SelectionVectorView {
+ public:
+  explicit SelectionVectorView(SelectionVector *sel_vec)
+    : sel_vec_(sel_vec), row_offset_(0) {
+  }
+
+  void Advance(size_t skip) {
+    DCHECK_LE(row_offset_ + skip, sel_vec_->nrows());
+    row_offset_ += skip;
+  }
+
+  bool TestBit(size_t row_idx) const {
+    DCHECK_LT(row_offset_ + row_idx, sel_vec_->nrows());
+    return BitmapTest(sel_vec_->bitmap(), row_offset_ + row_idx);
+  }
+
+  void ClearBit(size_t row_idx) {
+    DCHECK_LT(row_offset_ + row_idx, sel_vec_->nrows());
+    BitmapClear(sel_vec_->mutable_bitmap(), row_offset_ + row_idx);
+  }
+
+  // Clear 'nrows' bits starting at 'row_idx', relative to the current offset.
+  void ClearBits(size_t row_idx, size_t nrows) {
+    DCHECK_LE(row_offset_ + row_idx + nrows, sel_vec_->nrows());
+    BitmapChangeBits(sel_vec_->mutable_bitmap(), row_offset_ + row_idx, nrows, false);
+  }
+
+ private:
+  SelectionVector *sel_vec_;
+  size_t row_offset_;
+};
+
 // A block of decoded rows.
 // Wrapper around a buffer, which keeps the buffer's size, associated arena,
 // and schema. Provides convenience accessors for indexing by row, column, etc.
@@ -156,6 +156,10 @@ void ScanSpec::PushPredicatesIntoPrimaryKeyBounds(const Schema& schema,
       } else if (type == PredicateType::Range) {
         RemovePredicate(column);
         break;
+      } else if (type == PredicateType::InList) {
+        // IN list predicates are only partially captured by the key bounds,
+        // so neither they nor any following predicates may be removed.
+        break;
       } else {
         LOG(FATAL) << "Can not remove unknown predicate type";
       }
@@ -46,10 +46,13 @@ static const ColumnId  kFirstColumnId(10);
 #endif
 
 string ColumnStorageAttributes::ToString() const {
-  return strings::Substitute("encoding=$0, compression=$1, cfile_block_size=$2",
+  return strings::Substitute("encoding=$0, compression=$1, cfile_block_size=$2, "
+                             "compression_level=$3, bloom_filter=$4",
                              EncodingType_Name(encoding),
                              CompressionType_Name(compression),
-                             cfile_block_size);
+                             cfile_block_size,
+                             compression_level,
+                             bloom_filter);
 }
 
 // TODO: include attributes_.ToString() -- need to fix unit tests
@@ -465,6 +468,17 @@ Status SchemaBuilder::RenameColumn(const string& old_name, const string& new_nam
   return Status::IllegalState("Unable to rename existing column");
 }
 
+Status SchemaBuilder::SetColumnStorageAttributes(const string& name,
+                                                 const ColumnStorageAttributes& attributes) {
+  for (ColumnSchema& col_schema : cols_) {
+    if (name == col_schema.name()) {
+      col_schema.set_attributes(attributes);
+      return Status::OK();
+    }
+  }
+  return Status::NotFound("The specified column does not exist", name);
+}
+
 Status SchemaBuilder::AddColumn(const ColumnSchema& column, bool is_key) {
   if (ContainsKey(col_names_, column.name())) {
     return Status::AlreadyPresent("The column already exists", column.name());
@@ -85,7 +85,9 @@ struct ColumnStorageAttributes {
   ColumnStorageAttributes()
     : encoding(AUTO_ENCODING),
       compression(DEFAULT_COMPRESSION),
-      cfile_block_size(0) {
+      cfile_block_size(0),
+      compression_level(0),
+      bloom_filter(false) {
   }
 
   string ToString() const;
@@ -96,6 +98,15 @@ struct ColumnStorageAttributes {
   // The preferred block size for cfile blocks. If 0, uses the
   // server-wide default.
   int32_t cfile_block_size;
+
+  // The level to compress cfile blocks at, for codecs which have levels
+  // (currently only ZSTD). If 0, uses the codec's default level.
+  int32_t compression_level;
+
+  // Whether each cfile of the column records a bloom filter of its values,
+  // letting scans with equality or IN-list predicates on the column skip
+  // files which don't contain any of the values.
+  bool bloom_filter;
 };
 
 // The schema for a given column.
@@ -278,6 +289,10 @@ class ColumnSchema {
     name_ = name;
   }
 
+  void set_attributes(const ColumnStorageAttributes& attributes) {
+    attributes_ = attributes;
+  }
+
   string name_;
   const TypeInfo *type_info_;
   bool is_nullable_;
@@ -844,6 +859,12 @@ class SchemaBuilder {
   Status RemoveColumn(const string& name);
   Status RenameColumn(const string& old_name, const string& new_name);
 
+  // Replaces the storage attributes of the column 'name'. Data already written
+  // with the old attributes stays readable; only data written afterwards, e.g.
+  // by flushes and compactions, uses the new ones.
+  Status SetColumnStorageAttributes(const string& name,
+                                    const ColumnStorageAttributes& attributes);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(SchemaBuilder);
 
@@ -20,6 +20,7 @@
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
+#include "kudu/util/bitmap.h"
 #include "kudu/util/status.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
@@ -283,6 +284,57 @@ TEST_F(WireProtocolTest, TestBlockWithNoColumns) {
   ASSERT_EQ(900, pb.num_rows());
 }
 
+// Test serializing blocks in the columnar layout, including unselected rows,
+// NULL cells, and appending a second block to the same batch.
+TEST_F(WireProtocolTest, TestSerializeRowBlockColumnar) {
+  Arena arena(1024, 1024 * 1024);
+  RowBlock block(schema_, 10, &arena);
+  FillRowBlockWithTestRows(&block);
+  block.selection_vector()->SetRowUnselected(1);
+  block.row(3).cell(2).set_null(true);
+
+  ColumnarSerializedBatch batch;
+  SerializeRowBlockColumnar(block, nullptr, &batch);
+  SerializeRowBlockColumnar(block, nullptr, &batch);
+  ASSERT_EQ(18, batch.num_rows);
+  ASSERT_EQ(3, batch.columns.size());
+
+  // The string columns are sent as offsets plus contiguous data.
+  const std::string kCol1 = "hello world col1";
+  const ColumnarSerializedBatch::Column& col1 = batch.columns[0];
+  ASSERT_EQ((batch.num_rows + 1) * sizeof(uint32_t), col1.data->size());
+  ASSERT_EQ(batch.num_rows * kCol1.size(), col1.varlen_data->size());
+  const uint32_t* offsets = reinterpret_cast<const uint32_t*>(col1.data->data());
+  for (int i = 0; i < batch.num_rows; i++) {
+    ASSERT_EQ(i * kCol1.size(), offsets[i]);
+    ASSERT_EQ(kCol1, Slice(col1.varlen_data->data() + offsets[i],
+                           offsets[i + 1] - offsets[i]).ToString());
+  }
+  ASSERT_FALSE(col1.non_null_bitmap);
+
+  // The nullable column carries a non-null bitmap, and NULL cells are zeroed.
+  const ColumnarSerializedBatch::Column& col3 = batch.columns[2];
+  ASSERT_FALSE(col3.varlen_data);
+  ASSERT_EQ(batch.num_rows * sizeof(uint32_t), col3.data->size());
+  ASSERT_EQ(BitmapSize(batch.num_rows), col3.non_null_bitmap->size());
+  const uint32_t* vals = reinterpret_cast<const uint32_t*>(col3.data->data());
+  for (int i = 0; i < batch.num_rows; i++) {
+    // Row 1 of each block was unselected, and row 3 is NULL.
+    int src_row = i % 9 == 0 ? 0 : i % 9 + 1;
+    bool non_null = src_row != 3;
+    SCOPED_TRACE(i);
+    ASSERT_EQ(non_null, BitmapTest(col3.non_null_bitmap->data(), i));
+    ASSERT_EQ(static_cast<uint32_t>(non_null ? src_row : 0), vals[i]);
+  }
+
+  // A projection only serializes its own columns.
+  Schema projection({ ColumnSchema("col3", UINT32, true /* nullable */) }, 0);
+  ColumnarSerializedBatch proj_batch;
+  SerializeRowBlockColumnar(block, &projection, &proj_batch);
+  ASSERT_EQ(1, proj_batch.columns.size());
+  ASSERT_EQ(9 * sizeof(uint32_t), proj_batch.columns[0].data->size());
+}
+
 TEST_F(WireProtocolTest, TestColumnDefaultValue) {
   Slice write_default_str("Hello Write");
   Slice read_default_str("Hello Read");
@@ -23,6 +23,8 @@
 #include "kudu/common/column_predicate.h"
 #include "kudu/common/row.h"
 #include "kudu/common/rowblock.h"
+#include "kudu/gutil/cpu.h"
+#include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/fastmem.h"
@@ -201,6 +203,8 @@ void ColumnSchemaToPB(const ColumnSchema& col_schema, ColumnSchemaPB *pb, int fl
     pb->set_encoding(col_schema.attributes().encoding);
     pb->set_compression(col_schema.attributes().compression);
     pb->set_cfile_block_size(col_schema.attributes().cfile_block_size);
+    pb->set_compression_level(col_schema.attributes().compression_level);
+    pb->set_bloom_filter(col_schema.attributes().bloom_filter);
   }
   if (col_schema.has_read_default()) {
     if (col_schema.type_info()->physical_type() == BINARY) {
@@ -255,6 +259,12 @@ ColumnSchema ColumnSchemaFromPB(const ColumnSchemaPB& pb) {
   if (pb.has_cfile_block_size()) {
     attributes.cfile_block_size = pb.cfile_block_size();
   }
+  if (pb.has_compression_level()) {
+    attributes.compression_level = pb.compression_level();
+  }
+  if (pb.has_bloom_filter()) {
+    attributes.bloom_filter = pb.bloom_filter();
+  }
   return ColumnSchema(pb.name(), pb.type(), pb.is_nullable(),
                       read_default_ptr, write_default_ptr,
                       attributes);
@@ -389,6 +399,17 @@ void ColumnPredicateToPB(const ColumnPredicate& predicate,
       pb->mutable_is_not_null();
       return;
     };
+    case PredicateType::IsNull: {
+      pb->mutable_is_null();
+      return;
+    };
+    case PredicateType::InList: {
+      auto in_list_pred = pb->mutable_in_list();
+      for (const void* value : predicate.raw_values()) {
+        CopyPredicateBoundToPB(predicate.column(), value, in_list_pred->add_values());
+      }
+      return;
+    };
     case PredicateType::None: LOG(FATAL) << "None predicate may not be converted to protobuf";
   }
   LOG(FATAL) << "unknown predicate type";
@@ -444,6 +465,22 @@ Status ColumnPredicateFromPB(const Schema& schema,
       *predicate = ColumnPredicate::IsNotNull(col);
       break;
     };
+    case ColumnPredicatePB::kIsNull: {
+      *predicate = ColumnPredicate::IsNull(col);
+      break;
+    };
+    case ColumnPredicatePB::kInList: {
+      const auto& in_list = pb.in_list();
+      vector<const void*> values;
+      values.reserve(in_list.values_size());
+      for (const string& pb_value : in_list.values()) {
+        const void* value = nullptr;
+        RETURN_NOT_OK(CopyPredicateBoundFromPB(col, pb_value, arena, &value));
+        values.push_back(value);
+      }
+      *predicate = ColumnPredicate::InList(col, &values);
+      break;
+    };
     default: return Status::InvalidArgument("Unknown predicate type for column", col.name());
   }
   return Status::OK();
@@ -595,7 +632,8 @@ void AppendRowToString<RowBlockRow>(const RowBlockRow& row, string* buf) {
 template<bool IS_NULLABLE, bool IS_VARLEN>
 static void CopyColumn(const RowBlock& block, int col_idx,
                        int dst_col_idx, uint8_t* dst_base,
-                       faststring* indirect_data, const Schema* dst_schema) {
+                       faststring* indirect_data, const Schema* dst_schema,
+                       const vector<int>& selected_rows) {
   DCHECK_NOTNULL(dst_schema);
   ColumnBlock cblock = block.column_block(col_idx);
   size_t row_stride = ContiguousRowHelper::row_size(*dst_schema);
@@ -603,45 +641,32 @@ static void CopyColumn(const RowBlock& block, int col_idx,
   size_t offset_to_null_bitmap = dst_schema->byte_size() - dst_schema->column_offset(dst_col_idx);
 
   size_t cell_size = cblock.stride();
-  const uint8_t* src = cblock.cell_ptr(0);
-
-  BitmapIterator selected_row_iter(block.selection_vector()->bitmap(),
-                                   block.nrows());
-  int run_size;
-  bool selected;
-  int row_idx = 0;
-  while ((run_size = selected_row_iter.Next(&selected))) {
-    if (!selected) {
-      src += run_size * cell_size;
-      row_idx += run_size;
-      continue;
-    }
-    for (int i = 0; i < run_size; i++) {
-      if (IS_NULLABLE && cblock.is_null(row_idx)) {
-        memset(dst, 0, cell_size);
-        BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, true);
-      } else if (IS_VARLEN) {
-        const Slice *slice = reinterpret_cast<const Slice *>(src);
-        size_t offset_in_indirect = indirect_data->size();
-        indirect_data->append(reinterpret_cast<const char*>(slice->data()),
-                              slice->size());
-
-        Slice *dst_slice = reinterpret_cast<Slice *>(dst);
-        *dst_slice = Slice(reinterpret_cast<const uint8_t*>(offset_in_indirect),
-                           slice->size());
-        if (IS_NULLABLE) {
-          BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, false);
-        }
-      } else { // non-string, non-null
-        strings::memcpy_inlined(dst, src, cell_size);
-        if (IS_NULLABLE) {
-          BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, false);
-        }
+  const uint8_t* src_base = cblock.cell_ptr(0);
+
+  for (int row_idx : selected_rows) {
+    const uint8_t* src = src_base + row_idx * cell_size;
+    if (IS_NULLABLE && cblock.is_null(row_idx)) {
+      memset(dst, 0, cell_size);
+      BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, true);
+    } else if (IS_VARLEN) {
+      const Slice *slice = reinterpret_cast<const Slice *>(src);
+      size_t offset_in_indirect = indirect_data->size();
+      indirect_data->append(reinterpret_cast<const char*>(slice->data()),
+                            slice->size());
+
+      Slice *dst_slice = reinterpret_cast<Slice *>(dst);
+      *dst_slice = Slice(reinterpret_cast<const uint8_t*>(offset_in_indirect),
+                         slice->size());
+      if (IS_NULLABLE) {
+        BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, false);
+      }
+    } else { // non-string, non-null
+      strings::memcpy_inlined(dst, src, cell_size);
+      if (IS_NULLABLE) {
+        BitmapChange(dst + offset_to_null_bitmap, dst_col_idx, false);
       }
-      dst += row_stride;
-      src += cell_size;
-      row_idx++;
     }
+    dst += row_stride;
   }
 }
 
@@ -660,7 +685,10 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
 
   size_t old_size = data_buf->size();
   size_t row_stride = ContiguousRowHelper::row_size(*projection_schema);
-  int num_rows = block.selection_vector()->CountSelected();
+  // The selected rows are found once for all the columns.
+  vector<int> selected_rows;
+  block.selection_vector()->GetSelectedRows(&selected_rows);
+  int num_rows = selected_rows.size();
   data_buf->resize(old_size + row_stride * num_rows);
   uint8_t* base = reinterpret_cast<uint8_t*>(&(*data_buf)[old_size]);
 
@@ -674,22 +702,21 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
 
     // Generating different functions for each of these cases makes them much less
     // branch-heavy -- we do the branch once outside the loop, and then have a
-    // compiled version for each combination below.
-    // TODO: Using LLVM to build a specialized CopyColumn on the fly should have
-    // even bigger gains, since we could inline the constant cell sizes and column
-    // offsets.
+    // compiled version for each combination below. codegen::RowSerializer
+    // goes further, compiling in the cell sizes and column offsets, and is
+    // used instead of this function when scanning on the tablet server.
     if (col.is_nullable() && col.type_info()->physical_type() == BINARY) {
       CopyColumn<true, true>(block, t_schema_idx, proj_schema_idx, base, indirect_data,
-                             projection_schema);
+                             projection_schema, selected_rows);
     } else if (col.is_nullable() && col.type_info()->physical_type() != BINARY) {
       CopyColumn<true, false>(block, t_schema_idx, proj_schema_idx, base, indirect_data,
-                              projection_schema);
+                              projection_schema, selected_rows);
     } else if (!col.is_nullable() && col.type_info()->physical_type() == BINARY) {
       CopyColumn<false, true>(block, t_schema_idx, proj_schema_idx, base, indirect_data,
-                              projection_schema);
+                              projection_schema, selected_rows);
     } else if (!col.is_nullable() && col.type_info()->physical_type() != BINARY) {
       CopyColumn<false, false>(block, t_schema_idx, proj_schema_idx, base, indirect_data,
-                               projection_schema);
+                               projection_schema, selected_rows);
     } else {
       LOG(FATAL) << "cannot reach here";
     }
@@ -697,4 +724,171 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
   rowblock_pb->set_num_rows(rowblock_pb->num_rows() + num_rows);
 }
 
+namespace {
+
+// Copies the cells of type T at 'rows' of the column 'src' one after the
+// other to 'dst'. A straight-line loop which the compiler can turn into
+// vector gathers for the instruction set of the calling kernel.
+template<typename T>
+ATTRIBUTE_ALWAYS_INLINE
+inline void GatherCellsOfType(const uint8_t* src, const int* rows, int n, uint8_t* dst) {
+  const T* cells = reinterpret_cast<const T*>(src);
+  T* out = reinterpret_cast<T*>(dst);
+  for (int i = 0; i < n; i++) {
+    out[i] = cells[rows[i]];
+  }
+}
+
+template<typename T>
+void GatherCellsSSE4(const uint8_t* src, const int* rows, int n, uint8_t* dst) {
+  GatherCellsOfType<T>(src, rows, n, dst);
+}
+
+// The same kernel, compiled for AVX2. Only called when the CPU supports it.
+template<typename T>
+__attribute__((target("avx2")))
+void GatherCellsAVX2(const uint8_t* src, const int* rows, int n, uint8_t* dst) {
+  GatherCellsOfType<T>(src, rows, n, dst);
+}
+
+bool CpuHasAVX2() {
+  static const bool has_avx2 = base::CPU().has_avx2();
+  return has_avx2;
+}
+
+template<typename T>
+void DispatchGatherCells(const uint8_t* src, const vector<int>& rows, uint8_t* dst) {
+  if (CpuHasAVX2()) {
+    GatherCellsAVX2<T>(src, rows.data(), rows.size(), dst);
+  } else {
+    GatherCellsSSE4<T>(src, rows.data(), rows.size(), dst);
+  }
+}
+
+// Copies the non-NULL fixed-width cells of 'cell_size' bytes at 'rows' of
+// the column 'src' to 'dst'. Returns false, copying nothing, if there is no
+// kernel for cells of that size.
+bool GatherCells(const uint8_t* src, size_t cell_size, const vector<int>& rows, uint8_t* dst) {
+  switch (cell_size) {
+    case 1: DispatchGatherCells<uint8_t>(src, rows, dst); return true;
+    case 2: DispatchGatherCells<uint16_t>(src, rows, dst); return true;
+    case 4: DispatchGatherCells<uint32_t>(src, rows, dst); return true;
+    case 8: DispatchGatherCells<uint64_t>(src, rows, dst); return true;
+    default: return false;
+  }
+}
+
+} // anonymous namespace
+
+// Columnar counterpart of CopyColumn(): appends the selected cells of column
+// 'col_idx' of 'block' to 'dst', starting at output row 'dst_row_idx'.
+template<bool IS_NULLABLE, bool IS_VARLEN>
+static void CopyColumnColumnar(const RowBlock& block, int col_idx,
+                               int64_t dst_row_idx, const vector<int>& selected_rows,
+                               ColumnarSerializedBatch::Column* dst) {
+  const int num_selected = selected_rows.size();
+  ColumnBlock cblock = block.column_block(col_idx);
+  size_t cell_size = cblock.stride();
+  const uint8_t* src_base = cblock.cell_ptr(0);
+
+  // Size the fixed-width output once up front.
+  size_t dst_cell_size = IS_VARLEN ? sizeof(uint32_t) : cell_size;
+  faststring* data = dst->data.get();
+  size_t old_size = data->size();
+  data->resize(old_size + num_selected * dst_cell_size);
+  uint8_t* dst_cell = &(*data)[old_size];
+
+  uint8_t* non_null_bitmap = nullptr;
+  if (IS_NULLABLE) {
+    faststring* bitmap = dst->non_null_bitmap.get();
+    size_t old_bitmap_size = bitmap->size();
+    size_t new_bitmap_size = BitmapSize(dst_row_idx + num_selected);
+    bitmap->resize(new_bitmap_size);
+    if (new_bitmap_size > old_bitmap_size) {
+      memset(&(*bitmap)[old_bitmap_size], 0, new_bitmap_size - old_bitmap_size);
+    }
+    non_null_bitmap = &(*bitmap)[0];
+  }
+
+  if (!IS_NULLABLE && !IS_VARLEN &&
+      GatherCells(src_base, cell_size, selected_rows, dst_cell)) {
+    return;
+  }
+  for (int row_idx : selected_rows) {
+    const uint8_t* src = src_base + row_idx * cell_size;
+    bool is_null = IS_NULLABLE && cblock.is_null(row_idx);
+    if (IS_NULLABLE && !is_null) {
+      BitmapSet(non_null_bitmap, dst_row_idx);
+    }
+    if (IS_VARLEN) {
+      if (!is_null) {
+        const Slice* slice = reinterpret_cast<const Slice*>(src);
+        dst->varlen_data->append(slice->data(), slice->size());
+      }
+      DCHECK_LE(dst->varlen_data->size(), MathLimits<uint32_t>::kMax);
+      uint32_t end_offset = dst->varlen_data->size();
+      memcpy(dst_cell, &end_offset, sizeof(end_offset));
+    } else if (is_null) {
+      memset(dst_cell, 0, cell_size);
+    } else {
+      strings::memcpy_inlined(dst_cell, src, cell_size);
+    }
+    dst_cell += dst_cell_size;
+    dst_row_idx++;
+  }
+}
+
+ATTRIBUTE_NO_ADDRESS_SAFETY_ANALYSIS
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* projection_schema,
+                               ColumnarSerializedBatch* batch) {
+  DCHECK_GT(block.nrows(), 0);
+  const Schema& tablet_schema = block.schema();
+
+  if (projection_schema == nullptr) {
+    projection_schema = &tablet_schema;
+  }
+
+  if (batch->columns.empty()) {
+    batch->columns.resize(projection_schema->num_columns());
+    for (int i = 0; i < projection_schema->num_columns(); i++) {
+      const ColumnSchema& col = projection_schema->column(i);
+      ColumnarSerializedBatch::Column* dst = &batch->columns[i];
+      dst->data.reset(new faststring());
+      if (col.type_info()->physical_type() == BINARY) {
+        dst->varlen_data.reset(new faststring());
+        // The offsets array starts with the start offset of the first cell.
+        uint32_t zero = 0;
+        dst->data->append(&zero, sizeof(zero));
+      }
+      if (col.is_nullable()) {
+        dst->non_null_bitmap.reset(new faststring());
+      }
+    }
+  }
+  DCHECK_EQ(batch->columns.size(), projection_schema->num_columns());
+
+  vector<int> selected_rows;
+  block.selection_vector()->GetSelectedRows(&selected_rows);
+  for (int t_schema_idx = 0; t_schema_idx < tablet_schema.num_columns(); t_schema_idx++) {
+    const ColumnSchema& col = tablet_schema.column(t_schema_idx);
+    int proj_schema_idx = projection_schema->find_column(col.name());
+    if (proj_schema_idx == -1) {
+      continue;
+    }
+    ColumnarSerializedBatch::Column* dst = &batch->columns[proj_schema_idx];
+    bool is_varlen = col.type_info()->physical_type() == BINARY;
+    if (col.is_nullable() && is_varlen) {
+      CopyColumnColumnar<true, true>(block, t_schema_idx, batch->num_rows, selected_rows, dst);
+    } else if (col.is_nullable()) {
+      CopyColumnColumnar<true, false>(block, t_schema_idx, batch->num_rows, selected_rows, dst);
+    } else if (is_varlen) {
+      CopyColumnColumnar<false, true>(block, t_schema_idx, batch->num_rows, selected_rows, dst);
+    } else {
+      CopyColumnColumnar<false, false>(block, t_schema_idx, batch->num_rows, selected_rows, dst);
+    }
+  }
+  batch->num_rows += selected_rows.size();
+}
+
 } // namespace kudu
@@ -20,9 +20,11 @@
 #define KUDU_COMMON_WIRE_PROTOCOL_H
 
 #include <boost/optional.hpp>
+#include <memory>
 #include <vector>
 
 #include "kudu/common/wire_protocol.pb.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/status.h"
 
 using boost::optional;
@@ -33,7 +35,6 @@ class Arena;
 class ColumnPredicate;
 class ColumnSchema;
 class ConstContiguousRow;
-class faststring;
 class HostPort;
 class RowBlock;
 class RowBlockRow;
@@ -126,6 +127,39 @@ void SerializeRowBlock(const RowBlock& block, RowwiseRowBlockPB* rowblock_pb,
                        const Schema* client_projection_schema,
                        faststring* data_buf, faststring* indirect_data);
 
+// The buffers of a row block being serialized in the layout described by
+// ColumnarRowBlockPB. Each buffer is sent to the client as its own sidecar.
+struct ColumnarSerializedBatch {
+  struct Column {
+    // Fixed-width cell data, or num_rows + 1 uint32 offsets into
+    // 'varlen_data' for BINARY columns.
+    std::unique_ptr<faststring> data;
+
+    // The concatenated cell contents of a BINARY column. NULL for other types.
+    std::unique_ptr<faststring> varlen_data;
+
+    // One bit per row, set if the cell is not NULL. NULL for non-nullable
+    // columns.
+    std::unique_ptr<faststring> non_null_bitmap;
+  };
+
+  // One entry per projected column, in projection order. Populated by the
+  // first call to SerializeRowBlockColumnar().
+  std::vector<Column> columns;
+
+  // The number of rows serialized so far.
+  int64_t num_rows = 0;
+};
+
+// Columnar equivalent of SerializeRowBlock(): appends the selected rows of
+// 'block' to the buffers in 'batch'. Successive calls for the same scan must
+// use the same projection.
+//
+// Requires that block.nrows() > 0
+void SerializeRowBlockColumnar(const RowBlock& block,
+                               const Schema* client_projection_schema,
+                               ColumnarSerializedBatch* batch);
+
 // Rewrites the data pointed-to by row data slice 'row_data_slice' by replacing
 // relative indirect data pointers with absolute ones in 'indirect_data_slice'.
 // At the time of this writing, this rewriting is only done for STRING types.
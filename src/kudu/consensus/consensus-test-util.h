@@ -37,6 +37,7 @@
 #include "kudu/server/clock.h"
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/threadpool.h"
 
@@ -288,7 +289,7 @@ class NoOpTestPeerProxy : public TestPeerProxy {
  public:
 
   explicit NoOpTestPeerProxy(ThreadPool* pool, const consensus::RaftPeerPB& peer_pb)
-    : TestPeerProxy(pool), peer_pb_(peer_pb) {
+    : TestPeerProxy(pool), peer_pb_(peer_pb), num_serialized_updates_(0) {
     last_received_.CopyFrom(MinimumOpId());
   }
 
@@ -320,6 +321,27 @@ class NoOpTestPeerProxy : public TestPeerProxy {
     return RegisterCallbackAndRespond(kUpdate, callback);
   }
 
+  // Checks that 'serialized_request' matches 'request' before handling it.
+  virtual void UpdateAsyncSerialized(const ConsensusRequestPB* request,
+                                     const Slice& serialized_request,
+                                     ConsensusResponsePB* response,
+                                     rpc::RpcController* controller,
+                                     const rpc::ResponseCallback& callback) OVERRIDE {
+    ConsensusRequestPB parsed;
+    CHECK(parsed.ParseFromArray(serialized_request.data(), serialized_request.size()));
+    CHECK_EQ(parsed.SerializeAsString(), request->SerializeAsString());
+    {
+      std::lock_guard<simple_spinlock> lock(lock_);
+      num_serialized_updates_++;
+    }
+    UpdateAsync(request, response, controller, callback);
+  }
+
+  int num_serialized_updates() {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    return num_serialized_updates_;
+  }
+
   virtual void RequestConsensusVoteAsync(const VoteRequestPB* request,
                                          VoteResponsePB* response,
                                          rpc::RpcController* controller,
@@ -342,6 +364,7 @@ class NoOpTestPeerProxy : public TestPeerProxy {
   const consensus::RaftPeerPB peer_pb_;
   ConsensusStatusPB last_status_; // Protected by lock_.
   OpId last_received_;            // Protected by lock_.
+  int num_serialized_updates_;    // Protected by lock_.
 };
 
 class NoOpTestPeerProxyFactory : public PeerProxyFactory {
@@ -476,6 +499,8 @@ class LocalTestPeerProxy : public TestPeerProxy {
 
   void SendUpdateRequest(const ConsensusRequestPB* request,
                          ConsensusResponsePB* response) {
+    InjectLatency();
+
     // Copy the request and the response for the other peer so that ownership
     // remains as close to the dist. impl. as possible.
     ConsensusRequestPB other_peer_req;
@@ -508,6 +533,7 @@ class LocalTestPeerProxy : public TestPeerProxy {
 
   void SendVoteRequest(const VoteRequestPB* request,
                        VoteResponsePB* response) {
+    InjectLatency();
 
     // Copy the request and the response for the other peer so that ownership
     // remains as close to the dist. impl. as possible.
@@ -539,14 +565,33 @@ class LocalTestPeerProxy : public TestPeerProxy {
     miss_comm_ = true;
   }
 
+  // Delays every request by 'latency' before it's handed to the other peer,
+  // to emulate the round trip over a network.
+  void set_latency(const MonoDelta& latency) {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    latency_ = latency;
+  }
+
   const std::string& GetTarget() const {
     return peer_uuid_;
   }
 
  private:
+  void InjectLatency() {
+    MonoDelta latency;
+    {
+      std::lock_guard<simple_spinlock> lock(lock_);
+      latency = latency_;
+    }
+    if (latency.Initialized()) {
+      SleepFor(latency);
+    }
+  }
+
   const std::string peer_uuid_;
   TestPeerMapManager* const peers_;
   bool miss_comm_;
+  MonoDelta latency_; // Protected by lock_.
 };
 
 class LocalTestPeerProxyFactory : public PeerProxyFactory {
@@ -561,6 +606,7 @@ class LocalTestPeerProxyFactory : public PeerProxyFactory {
     LocalTestPeerProxy* new_proxy = new LocalTestPeerProxy(peer_pb.permanent_uuid(),
                                                            pool_.get(),
                                                            peers_);
+    new_proxy->set_latency(latency_);
     proxy->reset(new_proxy);
     proxies_.push_back(new_proxy);
     return Status::OK();
@@ -570,9 +616,20 @@ class LocalTestPeerProxyFactory : public PeerProxyFactory {
     return proxies_;
   }
 
+  // Sets the latency of the proxies made so far and of those made from now on.
+  // See LocalTestPeerProxy::set_latency(). Must not race with NewProxy(), so
+  // it's best called before the consensus instance is started.
+  void SetLatency(const MonoDelta& latency) {
+    latency_ = latency;
+    for (LocalTestPeerProxy* proxy : proxies_) {
+      proxy->set_latency(latency);
+    }
+  }
+
  private:
   gscoped_ptr<ThreadPool> pool_;
   TestPeerMapManager* const peers_;
+  MonoDelta latency_;
     // NOTE: There is no need to delete this on the dctor because proxies are externally managed
   vector<LocalTestPeerProxy*> proxies_;
 };
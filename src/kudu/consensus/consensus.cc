@@ -28,6 +28,7 @@ namespace kudu {
 namespace consensus {
 
 using std::shared_ptr;
+using std::vector;
 using strings::Substitute;
 
 ConsensusBootstrapInfo::ConsensusBootstrapInfo()
@@ -77,6 +78,16 @@ scoped_refptr<ConsensusRound> Consensus::NewRound(
   return make_scoped_refptr(new ConsensusRound(this, std::move(replicate_msg), replicated_cb));
 }
 
+Status Consensus::ReplicateBatch(const vector<scoped_refptr<ConsensusRound> >& rounds,
+                                 int* num_replicated) {
+  *num_replicated = 0;
+  for (const scoped_refptr<ConsensusRound>& round : rounds) {
+    RETURN_NOT_OK(Replicate(round));
+    (*num_replicated)++;
+  }
+  return Status::OK();
+}
+
 void Consensus::SetFaultHooks(const shared_ptr<ConsensusFaultHooks>& hooks) {
   fault_hooks_ = hooks;
 }
@@ -32,7 +32,9 @@
 #include "kudu/util/status_callback.h"
 
 namespace kudu {
+
 class MonoDelta;
+class Timestamp;
 
 namespace log {
 class Log;
@@ -139,6 +141,22 @@ class Consensus : public RefCountedThreadSafe<Consensus> {
     return Status::NotSupported("Not implemented.");
   }
 
+  // Implement a LeaderStepDown() request which hands leadership to the voter
+  // 'new_leader_uuid'.
+  virtual Status TransferLeadership(const std::string& new_leader_uuid,
+                                    LeaderStepDownResponsePB* resp) {
+    return Status::NotSupported("Not implemented.");
+  }
+
+  // Returns OK if this replica holds a valid leader lease, i.e. no other
+  // replica can have been elected leader since it last heard from a majority,
+  // and every operation committed by a leader so far is committed locally.
+  // Reads served while the lease is held are linearizable without a round
+  // trip to the followers.
+  virtual Status CheckLeaderLease() const {
+    return Status::NotSupported("Leader leases are not supported.");
+  }
+
   // Creates a new ConsensusRound, the entity that owns all the data
   // structures required for a consensus round, such as the ReplicateMsg
   // (and later on the CommitMsg). ConsensusRound will also point to and
@@ -180,6 +198,16 @@ class Consensus : public RefCountedThreadSafe<Consensus> {
   // This method can only be called on the leader, i.e. role() == LEADER
   virtual Status Replicate(const scoped_refptr<ConsensusRound>& round) = 0;
 
+  // Like Replicate(), but for a batch of rounds, which are replicated in
+  // order. Implementations may append the batch to the log and send it to
+  // the peers together, rather than one round at a time.
+  //
+  // If a round can't be replicated, the rounds after it aren't either.
+  // 'num_replicated' is set to the number of rounds which are being
+  // replicated, whether or not an error is returned.
+  virtual Status ReplicateBatch(const std::vector<scoped_refptr<ConsensusRound> >& rounds,
+                                int* num_replicated);
+
   // Ensures that the consensus implementation is currently acting as LEADER,
   // and thus is allowed to submit operations to be prepared before they are
   // replicated. To avoid a time-of-check-to-time-of-use (TOCTOU) race, the
@@ -323,6 +351,19 @@ class ReplicaTransactionFactory {
  public:
   virtual Status StartReplicaTransaction(const scoped_refptr<ConsensusRound>& context) = 0;
 
+  // Called on the leader. Sets 'safe_time' to a timestamp such that every
+  // operation which has not yet been appended to the log when this returns
+  // will be assigned a higher timestamp.
+  virtual Status GetSafeTimeForPropagation(Timestamp* safe_time) {
+    return Status::NotSupported("Safe time propagation is not supported.");
+  }
+
+  // Called on a follower, with the replica state's update lock held, when
+  // the leader propagated 'safe_time' along with a request that reached the
+  // end of its log. Implementations may advance their safe time to it once
+  // every replica transaction started so far has finished.
+  virtual void AdvanceSafeTime(const Timestamp& safe_time) {}
+
   virtual ~ReplicaTransactionFactory() {}
 };
 
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 
 #include "kudu/common/schema.h"
@@ -31,6 +32,9 @@
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(consensus_max_batch_size_bytes);
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
+
 METRIC_DECLARE_entity(tablet);
 
 namespace kudu {
@@ -172,6 +176,62 @@ TEST_F(ConsensusPeersTest, TestRemotePeer) {
   CheckLastRemoteEntry(proxy, 2, 20);
 }
 
+// Tests that requests carrying ops are sent preassembled from the ops which
+// the leader serialized when appending them, and that the assembled bytes
+// parse back into the same request.
+TEST_F(ConsensusPeersTest, TestRemotePeerSerializedRequests) {
+  FLAGS_consensus_max_batch_size_bytes = 1024;
+
+  message_queue_->Init(MinimumOpId());
+  message_queue_->SetLeaderMode(MinimumOpId(),
+                                MinimumOpId().term(),
+                                BuildRaftConfigPBForTests(3));
+
+  RaftPeerPB peer_pb;
+  peer_pb.set_permanent_uuid(kFollowerUuid);
+  auto proxy = new NoOpTestPeerProxy(pool_.get(), peer_pb);
+  gscoped_ptr<Peer> remote_peer;
+  ASSERT_OK(Peer::NewRemotePeer(peer_pb,
+                                kTabletId,
+                                kLeaderUuid,
+                                message_queue_.get(),
+                                pool_.get(),
+                                gscoped_ptr<PeerProxy>(proxy),
+                                &remote_peer));
+
+  AppendReplicateMessagesToQueue(message_queue_.get(), clock_, 1, 30, 100);
+  remote_peer->SetTermForTest(4);
+
+  remote_peer->SignalRequest();
+  WaitForMajorityReplicatedIndex(30);
+  ASSERT_OPID_EQ(MakeOpId(4, 30), proxy->last_received());
+  ASSERT_GT(proxy->num_serialized_updates(), 1);
+}
+
+// Tests that a peer with several requests in flight replicates every
+// message, when the messages take many batches to send.
+TEST_F(ConsensusPeersTest, TestRemotePeerPipelined) {
+  FLAGS_consensus_max_inflight_requests_per_peer = 3;
+  FLAGS_consensus_max_batch_size_bytes = 1024;
+
+  message_queue_->Init(MinimumOpId());
+  message_queue_->SetLeaderMode(MinimumOpId(),
+                                MinimumOpId().term(),
+                                BuildRaftConfigPBForTests(3));
+
+  gscoped_ptr<Peer> remote_peer;
+  DelayablePeerProxy<NoOpTestPeerProxy>* proxy =
+      NewRemotePeer(kFollowerUuid, &remote_peer);
+
+  // The last message is appended in term 14 (see AppendReplicateMessagesToQueue()).
+  AppendReplicateMessagesToQueue(message_queue_.get(), clock_, 1, 100);
+  remote_peer->SetTermForTest(14);
+
+  remote_peer->SignalRequest();
+  WaitForMajorityReplicatedIndex(100);
+  CheckLastRemoteEntry(proxy, 14, 100);
+}
+
 TEST_F(ConsensusPeersTest, TestRemotePeers) {
   message_queue_->Init(MinimumOpId());
   message_queue_->SetLeaderMode(MinimumOpId(),
@@ -21,6 +21,8 @@
 #include <boost/bind.hpp>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
 #include <mutex>
 #include <string>
 #include <utility>
@@ -38,6 +40,7 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/net/net_util.h"
+#include "kudu/util/pb_util.h"
 #include "kudu/util/threadpool.h"
 
 DEFINE_int32(consensus_rpc_timeout_ms, 1000,
@@ -69,6 +72,35 @@ DEFINE_bool(enable_tablet_copy, true,
             "replica. For testing purposes only.");
 TAG_FLAG(enable_tablet_copy, unsafe);
 
+DEFINE_int32(consensus_max_inflight_requests_per_peer, 1,
+             "Maximum number of UpdateConsensus requests the leader keeps in flight to "
+             "each follower. Values above 1 pipeline replication: the leader sends the "
+             "next batch of operations before the previous one is acknowledged, which "
+             "raises throughput to followers with high round-trip times.");
+TAG_FLAG(consensus_max_inflight_requests_per_peer, experimental);
+
+DEFINE_bool(raft_enable_quiescence, false,
+            "Whether a leader stops heartbeating the followers of a tablet that has "
+            "had no writes for --raft_quiesce_after_idle_ms. The followers then rely "
+            "on periodic liveness messages from the leader's server, shared by all "
+            "its tablets, to hold off elections. All tablet servers must support "
+            "MultiRaftHeartbeat.");
+TAG_FLAG(raft_enable_quiescence, experimental);
+TAG_FLAG(raft_enable_quiescence, runtime);
+
+DEFINE_int32(raft_quiesce_after_idle_ms, 10000,
+             "How long a tablet must go without writes before its leader stops "
+             "heartbeating the followers, if --raft_enable_quiescence is set.");
+TAG_FLAG(raft_quiesce_after_idle_ms, experimental);
+TAG_FLAG(raft_quiesce_after_idle_ms, runtime);
+
+DEFINE_int32(raft_quiesced_heartbeat_interval_ms, 10000,
+             "The interval at which a leader still heartbeats the followers of an "
+             "idle tablet once it has quiesced. Followers start an election if they "
+             "miss --leader_failure_max_missed_heartbeat_periods of these, e.g. "
+             "after the leader stepped down, even if its server is alive.");
+TAG_FLAG(raft_quiesced_heartbeat_interval_ms, experimental);
+
 namespace kudu {
 namespace consensus {
 
@@ -107,16 +139,27 @@ Peer::Peer(const RaftPeerPB& peer_pb, string tablet_id, string leader_uuid,
       proxy_(std::move(proxy)),
       queue_(queue),
       failed_attempts_(0),
-      sem_(1),
+      max_inflight_(std::max(1, FLAGS_consensus_max_inflight_requests_per_peer)),
+      sem_(max_inflight_),
+      last_ops_sent_(MonoTime::Now(MonoTime::FINE)),
+      last_request_sent_(last_ops_sent_),
+      quiesced_(false),
       heartbeater_(
           peer_pb.permanent_uuid(),
           MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_interval_ms),
           boost::bind(&Peer::SignalRequest, this, true)),
       thread_pool_(thread_pool),
-      state_(kPeerCreated) {}
+      state_(kPeerCreated) {
+  for (int i = 0; i < max_inflight_; i++) {
+    calls_.emplace_back(new Call());
+    free_calls_.push_back(calls_.back().get());
+  }
+}
 
 void Peer::SetTermForTest(int term) {
-  response_.set_responder_term(term);
+  for (const std::unique_ptr<Call>& call : calls_) {
+    call->response.set_responder_term(term);
+  }
 }
 
 Status Peer::Init() {
@@ -128,11 +171,12 @@ Status Peer::Init() {
 }
 
 Status Peer::SignalRequest(bool even_if_queue_empty) {
-  // If the peer is currently sending, return Status::OK().
+  // If the peer already has as many requests outstanding as it may, return Status::OK().
   // If there are new requests in the queue we'll get them on ProcessResponse().
   if (!sem_.TryAcquire()) {
     return Status::OK();
   }
+  Call* call;
   {
     std::lock_guard<simple_spinlock> l(peer_lock_);
 
@@ -164,50 +208,106 @@ Status Peer::SignalRequest(bool even_if_queue_empty) {
       sem_.Release();
       return Status::OK();
     }
+
+    DCHECK(!free_calls_.empty());
+    call = free_calls_.back();
+    free_calls_.pop_back();
   }
 
 
-  RETURN_NOT_OK(thread_pool_->SubmitClosure(
-                  Bind(&Peer::SendNextRequest, Unretained(this), even_if_queue_empty)));
-  return Status::OK();
+  Status s = thread_pool_->SubmitFunc(boost::bind(&Peer::SendNextRequest, this,
+                                                  even_if_queue_empty, call));
+  if (PREDICT_FALSE(!s.ok())) {
+    ReleaseCall(call);
+  }
+  return s;
 }
 
-void Peer::SendNextRequest(bool even_if_queue_empty) {
-  // The peer has no pending request nor is sending: send the request.
+namespace {
+
+// Serializes 'request' into 'dst', copying the bytes of any ops which the
+// leader serialized ahead of time rather than serializing them again.
+// 'msg_refs' must hold the ops of 'request', in order.
+void SerializeUpdateRequest(ConsensusRequestPB* request,
+                            const vector<ReplicateRefPtr>& msg_refs,
+                            faststring* dst) {
+  using google::protobuf::internal::WireFormatLite;
+  using google::protobuf::io::CodedOutputStream;
+  DCHECK_EQ(request->ops_size(), static_cast<int>(msg_refs.size()));
+
+  // Serialize everything but the ops, then append the ops: the wire format
+  // allows the fields of a message to come in any order.
+  vector<ReplicateMsg*> ops(request->ops_size());
+  request->mutable_ops()->ExtractSubrange(0, request->ops_size(), ops.data());
+  dst->clear();
+  CHECK(pb_util::SerializeToString(*request, dst));
+
+  const uint32_t tag = WireFormatLite::MakeTag(ConsensusRequestPB::kOpsFieldNumber,
+                                               WireFormatLite::WIRETYPE_LENGTH_DELIMITED);
+  uint8_t buf[2 * CodedOutputStream::kMaxVarint32Bytes];
+  for (size_t i = 0; i < ops.size(); i++) {
+    RefCountedReplicate* ref = msg_refs[i].get();
+    DCHECK_EQ(ref->get(), ops[i]);
+    int op_size = ref->is_serialized() ? ref->serialized().size() : ops[i]->ByteSize();
+    uint8_t* end = CodedOutputStream::WriteVarint32ToArray(tag, buf);
+    end = CodedOutputStream::WriteVarint32ToArray(op_size, end);
+    dst->append(buf, end - buf);
+    if (ref->is_serialized()) {
+      DCHECK_EQ(op_size, ops[i]->ByteSize()) << "Op modified after serialization";
+      dst->append(ref->serialized().data(), op_size);
+    } else {
+      // ByteSize() above cached the sizes needed here.
+      size_t old_size = dst->size();
+      dst->resize(old_size + op_size);
+      ops[i]->SerializeWithCachedSizesToArray(dst->data() + old_size);
+    }
+    request->mutable_ops()->AddAllocated(ops[i]);
+  }
+}
+
+} // anonymous namespace
+
+void Peer::SendNextRequest(bool even_if_queue_empty, Call* call) {
+  // The peer has a free slot for a request: send the request.
   bool needs_tablet_copy = false;
-  int64_t commit_index_before = request_.has_committed_index() ?
-      request_.committed_index().index() : kMinimumOpIdIndex;
-  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), &request_,
-                                    &replicate_msg_refs_, &needs_tablet_copy);
-  int64_t commit_index_after = request_.has_committed_index() ?
-      request_.committed_index().index() : kMinimumOpIdIndex;
+  ConsensusRequestPB* request = &call->request;
+  int64_t commit_index_before = request->has_committed_index() ?
+      request->committed_index().index() : kMinimumOpIdIndex;
+  // Requests are built and sent one at a time, so that concurrent calls pick
+  // up consecutive batches from the queue and send them in order.
+  std::unique_lock<std::mutex> l(request_lock_);
+  Status s = queue_->RequestForPeer(peer_pb_.permanent_uuid(), request,
+                                    &call->replicate_msg_refs, &needs_tablet_copy);
+  int64_t commit_index_after = request->has_committed_index() ?
+      request->committed_index().index() : kMinimumOpIdIndex;
 
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(INFO) << "Could not obtain request from queue for peer: "
         << peer_pb_.permanent_uuid() << ". Status: " << s.ToString();
-    sem_.Release();
+    ReleaseCall(call);
     return;
   }
 
   if (PREDICT_FALSE(needs_tablet_copy)) {
-    Status s = SendTabletCopyRequest();
+    Status s = SendTabletCopyRequest(call);
     if (!s.ok()) {
       LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to generate Tablet Copy request for peer: "
                                         << s.ToString();
-      sem_.Release();
+      ReleaseCall(call);
     }
     return;
   }
 
-  request_.set_tablet_id(tablet_id_);
-  request_.set_caller_uuid(leader_uuid_);
-  request_.set_dest_uuid(peer_pb_.permanent_uuid());
+  request->set_tablet_id(tablet_id_);
+  request->set_caller_uuid(leader_uuid_);
+  request->set_dest_uuid(peer_pb_.permanent_uuid());
+  request->clear_quiesce();
 
-  bool req_has_ops = request_.ops_size() > 0 || (commit_index_after > commit_index_before);
+  bool req_has_ops = request->ops_size() > 0 || (commit_index_after > commit_index_before);
   // If the queue is empty, check if we were told to send a status-only
   // message, if not just return.
   if (PREDICT_FALSE(!req_has_ops && !even_if_queue_empty)) {
-    sem_.Release();
+    ReleaseCall(call);
     return;
   }
 
@@ -215,29 +315,79 @@ void Peer::SendNextRequest(bool even_if_queue_empty) {
   // reset the heartbeater
   if (req_has_ops) {
     heartbeater_.Reset();
+    last_ops_sent_ = MonoTime::Now(MonoTime::FINE);
+    if (PREDICT_FALSE(quiesced_)) {
+      VLOG_WITH_PREFIX_UNLOCKED(1) << "Resuming heartbeats to peer "
+                                   << peer_pb_.permanent_uuid();
+      quiesced_ = false;
+      proxy_->SetQuiesced(peer_pb_.permanent_uuid(), false);
+    }
+  } else if (quiesced_ &&
+             MonoTime::Now(MonoTime::FINE).GetDeltaSince(last_request_sent_).ToMilliseconds() <
+                 FLAGS_raft_quiesced_heartbeat_interval_ms) {
+    // The peer knows the tablet is idle: there's nothing to tell it yet.
+    ReleaseCall(call);
+    return;
+  } else if (quiesced_ || ShouldQuiesceUnlocked()) {
+    // The peer is considered quiesced once it has accepted this request.
+    request->set_quiesce(true);
   }
 
   MAYBE_FAULT(FLAGS_fault_crash_on_leader_request_fraction);
 
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending to peer " << peer_pb().permanent_uuid() << ": "
-      << request_.ShortDebugString();
-  controller_.Reset();
+      << request->ShortDebugString();
+  call->controller.Reset();
+
+  // 'call' may be reused as soon as it has been sent, so decide up front
+  // whether to follow it with another request.
+  bool pipeline_next = max_inflight_ > 1 && request->ops_size() > 0;
+  call->send_time = MonoTime::Now(MonoTime::FINE);
+  last_request_sent_ = call->send_time;
+  if (request->ops_size() > 0) {
+    SerializeUpdateRequest(request, call->replicate_msg_refs, &call->serialized_request);
+    proxy_->UpdateAsyncSerialized(request, call->serialized_request,
+                                  &call->response, &call->controller,
+                                  boost::bind(&Peer::ProcessResponse, this, call));
+  } else if (!req_has_ops &&
+             proxy_->BatchedHeartbeatAsync(
+                 request, &call->response,
+                 boost::bind(&Peer::ProcessHeartbeatResponse, this, call, _1))) {
+    // The heartbeat goes out together with those of other tablets.
+  } else {
+    proxy_->UpdateAsync(request, &call->response, &call->controller,
+                        boost::bind(&Peer::ProcessResponse, this, call));
+  }
+  l.unlock();
+
+  // Fill the rest of the window, if there are more operations to send.
+  if (pipeline_next) {
+    Status s = SignalRequest(false);
+    if (PREDICT_FALSE(!s.ok())) {
+      VLOG_WITH_PREFIX_UNLOCKED(1) << "Not pipelining another request: " << s.ToString();
+    }
+  }
+}
 
-  proxy_->UpdateAsync(&request_, &response_, &controller_,
-                      boost::bind(&Peer::ProcessResponse, this));
+void Peer::ProcessResponse(Call* call) {
+  HandleResponse(call, call->controller.status());
 }
 
-void Peer::ProcessResponse() {
+void Peer::ProcessHeartbeatResponse(Call* call, const Status& rpc_status) {
+  HandleResponse(call, rpc_status);
+}
+
+void Peer::HandleResponse(Call* call, const Status& rpc_status) {
   // Note: This method runs on the reactor thread.
 
-  DCHECK_EQ(0, sem_.GetValue())
+  DCHECK_LT(sem_.GetValue(), max_inflight_)
     << "Got a response when nothing was pending";
 
   MAYBE_FAULT(FLAGS_fault_crash_after_leader_request_fraction);
 
-  if (!controller_.status().ok()) {
-    if (controller_.status().IsRemoteError()) {
+  if (!rpc_status.ok()) {
+    if (rpc_status.IsRemoteError()) {
       // Most controller errors are caused by network issues or corner cases
       // like shutdown and failure to serialize a protobuf. Therefore, we
       // generally consider these errors to indicate an unreachable peer.
@@ -246,20 +396,21 @@ void Peer::ProcessResponse() {
       // the queue know that the remote is responsive.
       queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
     }
-    ProcessResponseError(controller_.status());
+    ProcessResponseError(call, rpc_status);
     return;
   }
 
   // Pass through errors we can respond to, like not found, since in that case
   // we will need to start a Tablet Copy. TODO: Handle DELETED response once implemented.
-  if ((response_.has_error() &&
-      response_.error().code() != TabletServerErrorPB::TABLET_NOT_FOUND) ||
-      (response_.status().has_error() &&
-          response_.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE)) {
+  const ConsensusResponsePB& response = call->response;
+  if ((response.has_error() &&
+      response.error().code() != TabletServerErrorPB::TABLET_NOT_FOUND) ||
+      (response.status().has_error() &&
+          response.status().error().code() == consensus::ConsensusErrorPB::CANNOT_PREPARE)) {
     // Again, let the queue know that the remote is still responsive, since we
     // will not be sending this error response through to the queue.
     queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
-    ProcessResponseError(StatusFromPB(response_.error().status()));
+    ProcessResponseError(call, StatusFromPB(response.error().status()));
     return;
   }
 
@@ -267,75 +418,122 @@ void Peer::ProcessResponse() {
   // the WAL) and SendNextRequest() may do the same thing. So we run the rest
   // of the response handling logic on our thread pool and not on the reactor
   // thread.
-  Status s = thread_pool_->SubmitClosure(Bind(&Peer::DoProcessResponse, Unretained(this)));
+  Status s = thread_pool_->SubmitFunc(boost::bind(&Peer::DoProcessResponse, this, call));
   if (PREDICT_FALSE(!s.ok())) {
     LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to process peer response: " << s.ToString()
-        << ": " << response_.ShortDebugString();
-    sem_.Release();
+        << ": " << response.ShortDebugString();
+    ReleaseCall(call);
   }
 }
 
-void Peer::DoProcessResponse() {
-  failed_attempts_ = 0;
+void Peer::DoProcessResponse(Call* call) {
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    failed_attempts_ = 0;
+  }
 
   VLOG_WITH_PREFIX_UNLOCKED(2) << "Response from peer " << peer_pb().permanent_uuid() << ": "
-      << response_.ShortDebugString();
+      << call->response.ShortDebugString();
+
+  // A request accepted without error means the peer will not vote for anyone
+  // else for a while, counted from no earlier than when we sent it.
+  const ConsensusResponsePB& response = call->response;
+  if (!response.has_error() && !response.status().has_error()) {
+    queue_->NotifyPeerAcceptedRequest(peer_pb_.permanent_uuid(), response.responder_term(),
+                                      call->send_time);
+  }
+
+  if (call->request.quiesce() &&
+      !response.has_error() && !response.status().has_error()) {
+    std::lock_guard<std::mutex> l(request_lock_);
+    // Operations may have been sent since the request was built.
+    if (!quiesced_ && !call->send_time.ComesBefore(last_ops_sent_)) {
+      VLOG_WITH_PREFIX_UNLOCKED(1) << "Tablet is idle: no longer heartbeating peer "
+                                   << peer_pb_.permanent_uuid();
+      quiesced_ = true;
+      proxy_->SetQuiesced(peer_pb_.permanent_uuid(), true);
+    }
+  }
 
   bool more_pending;
-  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), response_, &more_pending);
+  queue_->ResponseFromPeer(peer_pb_.permanent_uuid(), call->response, &more_pending);
 
   // We're OK to read the state_ without a lock here -- if we get a race,
   // the worst thing that could happen is that we'll make one more request before
   // noticing a close.
   if (more_pending && ANNOTATE_UNPROTECTED_READ(state_) != kPeerClosed) {
-    SendNextRequest(true);
+    SendNextRequest(true, call);
   } else {
-    sem_.Release();
+    ReleaseCall(call);
+  }
+}
+
+bool Peer::ShouldQuiesceUnlocked() const {
+  if (!FLAGS_raft_enable_quiescence || !proxy_->SupportsQuiescence()) {
+    return false;
   }
+  MonoDelta idle = MonoTime::Now(MonoTime::FINE).GetDeltaSince(last_ops_sent_);
+  return idle.ToMilliseconds() >= FLAGS_raft_quiesce_after_idle_ms &&
+      queue_->IsPeerCaughtUp(peer_pb_.permanent_uuid());
 }
 
-Status Peer::SendTabletCopyRequest() {
+Status Peer::SendTabletCopyRequest(Call* call) {
   if (!FLAGS_enable_tablet_copy) {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
     failed_attempts_++;
     return Status::NotSupported("Tablet Copy is disabled");
   }
 
   LOG_WITH_PREFIX_UNLOCKED(INFO) << "Sending request to start Tablet Copy";
-  RETURN_NOT_OK(queue_->GetTabletCopyRequestForPeer(peer_pb_.permanent_uuid(), &tc_request_));
-  controller_.Reset();
-  proxy_->StartTabletCopy(&tc_request_, &tc_response_, &controller_,
-                          boost::bind(&Peer::ProcessTabletCopyResponse, this));
+  RETURN_NOT_OK(queue_->GetTabletCopyRequestForPeer(peer_pb_.permanent_uuid(),
+                                                    &call->tc_request));
+  call->controller.Reset();
+  proxy_->StartTabletCopy(&call->tc_request, &call->tc_response, &call->controller,
+                          boost::bind(&Peer::ProcessTabletCopyResponse, this, call));
   return Status::OK();
 }
 
-void Peer::ProcessTabletCopyResponse() {
-  if (controller_.status().ok() && tc_response_.has_error()) {
+void Peer::ProcessTabletCopyResponse(Call* call) {
+  const StartTabletCopyResponsePB& tc_response = call->tc_response;
+  if (call->controller.status().ok() && tc_response.has_error()) {
     // ALREADY_INPROGRESS is expected, so we do not log this error.
-    if (tc_response_.error().code() ==
+    if (tc_response.error().code() ==
         TabletServerErrorPB::TabletServerErrorPB::ALREADY_INPROGRESS) {
       queue_->NotifyPeerIsResponsiveDespiteError(peer_pb_.permanent_uuid());
     } else {
       LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Unable to begin Tablet Copy on peer: "
-                                        << tc_response_.ShortDebugString();
+                                        << tc_response.ShortDebugString();
     }
   }
-  sem_.Release();
+  ReleaseCall(call);
 }
 
-void Peer::ProcessResponseError(const Status& status) {
-  failed_attempts_++;
+void Peer::ProcessResponseError(Call* call, const Status& status) {
+  uint64_t failed_attempts;
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    failed_attempts = ++failed_attempts_;
+  }
   string resp_err_info;
-  if (response_.has_error()) {
+  if (call->response.has_error()) {
     resp_err_info = Substitute(" Error code: $0 ($1).",
-                               TabletServerErrorPB::Code_Name(response_.error().code()),
-                               response_.error().code());
+                               TabletServerErrorPB::Code_Name(call->response.error().code()),
+                               call->response.error().code());
   }
   LOG_WITH_PREFIX_UNLOCKED(WARNING) << "Couldn't send request to peer " << peer_pb_.permanent_uuid()
       << " for tablet " << tablet_id_ << "."
       << resp_err_info
       << " Status: " << status.ToString() << "."
       << " Retrying in the next heartbeat period."
-      << " Already tried " << failed_attempts_ << " times.";
+      << " Already tried " << failed_attempts << " times.";
+  ReleaseCall(call);
+}
+
+void Peer::ReleaseCall(Call* call) {
+  {
+    std::lock_guard<simple_spinlock> l(peer_lock_);
+    free_calls_.push_back(call);
+  }
   sem_.Release();
 }
 
@@ -357,13 +555,27 @@ void Peer::Close() {
   }
   LOG_WITH_PREFIX_UNLOCKED(INFO) << "Closing peer: " << peer_pb_.permanent_uuid();
 
-  // Acquire the semaphore to wait for any concurrent request to finish.
+  // Acquire the whole semaphore to wait for any concurrent requests to finish.
   // They will see the state_ == kPeerClosed and not start any new requests,
   // but we can't currently cancel the already-sent ones. (see KUDU-699)
-  std::lock_guard<Semaphore> l(sem_);
+  for (int i = 0; i < max_inflight_; i++) {
+    sem_.Acquire();
+  }
+  {
+    std::lock_guard<std::mutex> l(request_lock_);
+    if (quiesced_) {
+      quiesced_ = false;
+      proxy_->SetQuiesced(peer_pb_.permanent_uuid(), false);
+    }
+  }
   queue_->UntrackPeer(peer_pb_.permanent_uuid());
   // We don't own the ops (the queue does).
-  request_.mutable_ops()->ExtractSubrange(0, request_.ops_size(), nullptr);
+  for (const std::unique_ptr<Call>& call : calls_) {
+    call->request.mutable_ops()->ExtractSubrange(0, call->request.ops_size(), nullptr);
+  }
+  for (int i = 0; i < max_inflight_; i++) {
+    sem_.Release();
+  }
 }
 
 Peer::~Peer() {
@@ -372,9 +584,11 @@ Peer::~Peer() {
 
 
 RpcPeerProxy::RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy)
+                           gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+                           shared_ptr<HeartbeatBatcher> heartbeat_batcher)
     : hostport_(std::move(hostport)),
-      consensus_proxy_(std::move(consensus_proxy)) {
+      consensus_proxy_(std::move(consensus_proxy)),
+      heartbeat_batcher_(std::move(heartbeat_batcher)) {
 }
 
 void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
@@ -385,6 +599,38 @@ void RpcPeerProxy::UpdateAsync(const ConsensusRequestPB* request,
   consensus_proxy_->UpdateConsensusAsync(*request, response, controller, callback);
 }
 
+void RpcPeerProxy::UpdateAsyncSerialized(const ConsensusRequestPB* request,
+                                         const Slice& serialized_request,
+                                         ConsensusResponsePB* response,
+                                         rpc::RpcController* controller,
+                                         const rpc::ResponseCallback& callback) {
+  controller->set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  consensus_proxy_->AsyncRequestSerialized("UpdateConsensus", serialized_request,
+                                           response, controller, callback);
+}
+
+bool RpcPeerProxy::BatchedHeartbeatAsync(const ConsensusRequestPB* request,
+                                         ConsensusResponsePB* response,
+                                         const HeartbeatBatcher::HeartbeatCallback& callback) {
+  if (!heartbeat_batcher_) {
+    return false;
+  }
+  return heartbeat_batcher_->AddHeartbeat(*hostport_, *request, response, callback);
+}
+
+bool RpcPeerProxy::SupportsQuiescence() const {
+  return heartbeat_batcher_ != nullptr;
+}
+
+void RpcPeerProxy::SetQuiesced(const string& peer_uuid, bool quiesced) {
+  DCHECK(heartbeat_batcher_);
+  if (quiesced) {
+    heartbeat_batcher_->AddQuiescedPeer(*hostport_, peer_uuid);
+  } else {
+    heartbeat_batcher_->RemoveQuiescedPeer(peer_uuid);
+  }
+}
+
 void RpcPeerProxy::RequestConsensusVoteAsync(const VoteRequestPB* request,
                                              VoteResponsePB* response,
                                              rpc::RpcController* controller,
@@ -399,6 +645,13 @@ void RpcPeerProxy::StartTabletCopy(const StartTabletCopyRequestPB* request,
   consensus_proxy_->StartTabletCopyAsync(*request, response, controller, callback);
 }
 
+void RpcPeerProxy::RunLeaderElectionAsync(const RunLeaderElectionRequestPB* request,
+                                          RunLeaderElectionResponsePB* response,
+                                          rpc::RpcController* controller,
+                                          const rpc::ResponseCallback& callback) {
+  consensus_proxy_->RunLeaderElectionAsync(*request, response, controller, callback);
+}
+
 RpcPeerProxy::~RpcPeerProxy() {}
 
 namespace {
@@ -419,8 +672,10 @@ Status CreateConsensusServiceProxyForHost(const shared_ptr<Messenger>& messenger
 
 } // anonymous namespace
 
-RpcPeerProxyFactory::RpcPeerProxyFactory(shared_ptr<Messenger> messenger)
-    : messenger_(std::move(messenger)) {}
+RpcPeerProxyFactory::RpcPeerProxyFactory(shared_ptr<Messenger> messenger,
+                                         shared_ptr<HeartbeatBatcher> heartbeat_batcher)
+    : messenger_(std::move(messenger)),
+      heartbeat_batcher_(std::move(heartbeat_batcher)) {}
 
 Status RpcPeerProxyFactory::NewProxy(const RaftPeerPB& peer_pb,
                                      gscoped_ptr<PeerProxy>* proxy) {
@@ -428,7 +683,8 @@ Status RpcPeerProxyFactory::NewProxy(const RaftPeerPB& peer_pb,
   RETURN_NOT_OK(HostPortFromPB(peer_pb.last_known_addr(), hostport.get()));
   gscoped_ptr<ConsensusServiceProxy> new_proxy;
   RETURN_NOT_OK(CreateConsensusServiceProxyForHost(messenger_, *hostport, &new_proxy));
-  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy)));
+  proxy->reset(new RpcPeerProxy(std::move(hostport), std::move(new_proxy),
+                                heartbeat_batcher_));
   return Status::OK();
 }
 
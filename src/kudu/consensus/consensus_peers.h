@@ -19,18 +19,23 @@
 #define KUDU_CONSENSUS_CONSENSUS_PEERS_H_
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "kudu/consensus/consensus.pb.h"
+#include "kudu/consensus/heartbeat_batcher.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/rpc/response_callback.h"
 #include "kudu/rpc/rpc_controller.h"
 #include "kudu/util/countdown_latch.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/resettable_heartbeater.h"
 #include "kudu/util/semaphore.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
@@ -106,6 +111,11 @@ class VoteResponsePB;
 //        v                               v
 //  SignalRequest()                    return
 //
+// By default there is at most one request outstanding to the peer. With
+// --consensus_max_inflight_requests_per_peer set higher, up to that many
+// requests may be in flight at once: each one picks up the next batch of
+// operations from the queue, which optimistically assumes that the batches
+// sent before it will be accepted.
 class Peer {
  public:
   // Initializes a peer and get its status.
@@ -145,33 +155,74 @@ class Peer {
                               gscoped_ptr<Peer>* peer);
 
  private:
+  // The state of one request to the peer.
+  struct Call {
+    // The consensus update request and response.
+    ConsensusRequestPB request;
+    ConsensusResponsePB response;
+
+    // The tablet copy request and response.
+    StartTabletCopyRequestPB tc_request;
+    StartTabletCopyResponsePB tc_response;
+
+    // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
+    // may have loaded these messages from the LogCache, in which case we are potentially
+    // sharing the same object as other peers. Since the PB request itself can't hold
+    // reference counts, this holds them.
+    std::vector<ReplicateRefPtr> replicate_msg_refs;
+
+    // When 'request' was last sent. Used to extend the leader lease.
+    MonoTime send_time;
+
+    // 'request' in its wire format, assembled from the serialized ops.
+    faststring serialized_request;
+
+    rpc::RpcController controller;
+  };
+
   Peer(const RaftPeerPB& peer, std::string tablet_id, std::string leader_uuid,
        gscoped_ptr<PeerProxy> proxy, PeerMessageQueue* queue,
        ThreadPool* thread_pool);
 
-  void SendNextRequest(bool even_if_queue_empty);
+  // Send the next request to the peer using 'call'. Takes ownership of one
+  // unit of sem_ along with 'call', and gives both back when done with them.
+  void SendNextRequest(bool even_if_queue_empty, Call* call);
 
   // Signals that a response was received from the peer.
   // This method is called from the reactor thread and calls
   // DoProcessResponse() on thread_pool_ to do any work that requires IO or
   // lock-taking.
-  void ProcessResponse();
+  void ProcessResponse(Call* call);
+
+  // Like ProcessResponse(), for a heartbeat that was sent as part of a batch.
+  // 'rpc_status' stands in for the status of the call's controller.
+  void ProcessHeartbeatResponse(Call* call, const Status& rpc_status);
+
+  // Handles the response to 'call', which was received with 'rpc_status'.
+  void HandleResponse(Call* call, const Status& rpc_status);
 
   // Run on 'thread_pool'. Does response handling that requires IO or may block.
-  void DoProcessResponse();
+  void DoProcessResponse(Call* call);
 
   // Fetch the desired tablet copy request from the queue and send it
   // to the peer. The callback goes to ProcessTabletCopyResponse().
   //
   // Returns a bad Status if tablet copy is disabled, or if the
   // request cannot be generated for some reason.
-  Status SendTabletCopyRequest();
+  Status SendTabletCopyRequest(Call* call);
 
   // Handle RPC callback from initiating tablet copy.
-  void ProcessTabletCopyResponse();
+  void ProcessTabletCopyResponse(Call* call);
 
   // Signals there was an error sending the request to the peer.
-  void ProcessResponseError(const Status& status);
+  void ProcessResponseError(Call* call, const Status& status);
+
+  // Whether the tablet has been idle long enough, and the peer caught up, for
+  // the peer to stop being heartbeated. Requires request_lock_.
+  bool ShouldQuiesceUnlocked() const;
+
+  // Return 'call' to the free list and release its unit of sem_.
+  void ReleaseCall(Call* call);
 
   std::string LogPrefixUnlocked() const;
 
@@ -185,30 +236,34 @@ class Peer {
   gscoped_ptr<PeerProxy> proxy_;
 
   PeerMessageQueue* queue_;
-  uint64_t failed_attempts_;
 
-  // The latest consensus update request and response.
-  ConsensusRequestPB request_;
-  ConsensusResponsePB response_;
+  // Protected by peer_lock_.
+  uint64_t failed_attempts_;
 
-  // The latest tablet copy request and response.
-  StartTabletCopyRequestPB tc_request_;
-  StartTabletCopyResponsePB tc_response_;
+  // The maximum number of requests outstanding to the peer at once.
+  const int max_inflight_;
 
-  // Reference-counted pointers to any ReplicateMsgs which are in-flight to the peer. We
-  // may have loaded these messages from the LogCache, in which case we are potentially
-  // sharing the same object as other peers. Since the PB request_ itself can't hold
-  // reference counts, this holds them.
-  std::vector<ReplicateRefPtr> replicate_msg_refs_;
+  // One unit is held for each outstanding request.
+  // This is used in order to bound the number of requests outstanding
+  // at a time, and to wait for the outstanding requests at Close().
+  Semaphore sem_;
 
-  rpc::RpcController controller_;
+  // All calls, and those not currently in use. There is always a free call
+  // for each available unit of sem_. 'free_calls_' is protected by peer_lock_.
+  std::vector<std::unique_ptr<Call>> calls_;
+  std::vector<Call*> free_calls_;
 
-  // Held if there is an outstanding request.
-  // This is used in order to ensure that we only have a single request
-  // oustanding at a time, and to wait for the outstanding requests
-  // at Close().
-  Semaphore sem_;
+  // Serializes building and sending requests, so that concurrent calls pick
+  // up consecutive batches of operations and send them in order.
+  // Acquired before peer_lock_.
+  std::mutex request_lock_;
 
+  // When operations, and any request at all, were last sent to the peer, and
+  // whether it was told that the tablet is idle, so that it is only rarely
+  // heartbeated. Protected by request_lock_.
+  MonoTime last_ops_sent_;
+  MonoTime last_request_sent_;
+  bool quiesced_;
 
   // Heartbeater for remote peer implementations.
   // This will send status only requests to the remote peers
@@ -243,6 +298,39 @@ class PeerProxy {
                            rpc::RpcController* controller,
                            const rpc::ResponseCallback& callback) = 0;
 
+  // Like UpdateAsync(), but 'serialized_request' already holds 'request' in
+  // its wire format and may be sent as is. By default the serialized form is
+  // ignored.
+  virtual void UpdateAsyncSerialized(const ConsensusRequestPB* request,
+                                     const Slice& serialized_request,
+                                     ConsensusResponsePB* response,
+                                     rpc::RpcController* controller,
+                                     const rpc::ResponseCallback& callback) {
+    UpdateAsync(request, response, controller, callback);
+  }
+
+  // Sends a status-only 'request' along with the heartbeats of other tablets
+  // to the same server. Returns false, without sending anything, if this
+  // proxy doesn't batch heartbeats; the caller should then use UpdateAsync().
+  virtual bool BatchedHeartbeatAsync(const ConsensusRequestPB* request,
+                                     ConsensusResponsePB* response,
+                                     const HeartbeatBatcher::HeartbeatCallback& callback) {
+    return false;
+  }
+
+  // Whether the leader may stop heartbeating the peer while the tablet is
+  // idle. That requires the proxy to keep the peer's server informed that
+  // this one is alive in the meantime.
+  virtual bool SupportsQuiescence() const {
+    return false;
+  }
+
+  // Called when the leader stops heartbeating the peer with UUID 'peer_uuid'
+  // because the tablet is idle, and again with 'quiesced' false when the
+  // leader resumes.
+  virtual void SetQuiesced(const std::string& peer_uuid, bool quiesced) {
+  }
+
   // Sends a RequestConsensusVote to a remote peer.
   virtual void RequestConsensusVoteAsync(const VoteRequestPB* request,
                                          VoteResponsePB* response,
@@ -257,6 +345,14 @@ class PeerProxy {
     LOG(DFATAL) << "Not implemented";
   }
 
+  // Instructs a peer to start a leader election right away.
+  virtual void RunLeaderElectionAsync(const RunLeaderElectionRequestPB* request,
+                                      RunLeaderElectionResponsePB* response,
+                                      rpc::RpcController* controller,
+                                      const rpc::ResponseCallback& callback) {
+    LOG(DFATAL) << "Not implemented";
+  }
+
   virtual ~PeerProxy() {}
 };
 
@@ -274,14 +370,30 @@ class PeerProxyFactory {
 // PeerProxy implementation that does RPC calls
 class RpcPeerProxy : public PeerProxy {
  public:
+  // 'heartbeat_batcher' may be null, in which case heartbeats are not batched.
   RpcPeerProxy(gscoped_ptr<HostPort> hostport,
-               gscoped_ptr<ConsensusServiceProxy> consensus_proxy);
+               gscoped_ptr<ConsensusServiceProxy> consensus_proxy,
+               std::shared_ptr<HeartbeatBatcher> heartbeat_batcher);
 
   virtual void UpdateAsync(const ConsensusRequestPB* request,
                            ConsensusResponsePB* response,
                            rpc::RpcController* controller,
                            const rpc::ResponseCallback& callback) OVERRIDE;
 
+  virtual void UpdateAsyncSerialized(const ConsensusRequestPB* request,
+                                     const Slice& serialized_request,
+                                     ConsensusResponsePB* response,
+                                     rpc::RpcController* controller,
+                                     const rpc::ResponseCallback& callback) OVERRIDE;
+
+  virtual bool BatchedHeartbeatAsync(const ConsensusRequestPB* request,
+                                     ConsensusResponsePB* response,
+                                     const HeartbeatBatcher::HeartbeatCallback& callback) OVERRIDE;
+
+  virtual bool SupportsQuiescence() const OVERRIDE;
+
+  virtual void SetQuiesced(const std::string& peer_uuid, bool quiesced) OVERRIDE;
+
   virtual void RequestConsensusVoteAsync(const VoteRequestPB* request,
                                          VoteResponsePB* response,
                                          rpc::RpcController* controller,
@@ -292,17 +404,26 @@ class RpcPeerProxy : public PeerProxy {
                                     rpc::RpcController* controller,
                                     const rpc::ResponseCallback& callback) OVERRIDE;
 
+  virtual void RunLeaderElectionAsync(const RunLeaderElectionRequestPB* request,
+                                      RunLeaderElectionResponsePB* response,
+                                      rpc::RpcController* controller,
+                                      const rpc::ResponseCallback& callback) OVERRIDE;
+
   virtual ~RpcPeerProxy();
 
  private:
   gscoped_ptr<HostPort> hostport_;
   gscoped_ptr<ConsensusServiceProxy> consensus_proxy_;
+  const std::shared_ptr<HeartbeatBatcher> heartbeat_batcher_;
 };
 
 // PeerProxyFactory implementation that generates RPCPeerProxies
 class RpcPeerProxyFactory : public PeerProxyFactory {
  public:
-  explicit RpcPeerProxyFactory(std::shared_ptr<rpc::Messenger> messenger);
+  // Heartbeats from the proxies are batched through 'heartbeat_batcher',
+  // unless it is null.
+  RpcPeerProxyFactory(std::shared_ptr<rpc::Messenger> messenger,
+                      std::shared_ptr<HeartbeatBatcher> heartbeat_batcher);
 
   virtual Status NewProxy(const RaftPeerPB& peer_pb,
                           gscoped_ptr<PeerProxy>* proxy) OVERRIDE;
@@ -310,6 +431,7 @@ class RpcPeerProxyFactory : public PeerProxyFactory {
   virtual ~RpcPeerProxyFactory();
  private:
   std::shared_ptr<rpc::Messenger> messenger_;
+  std::shared_ptr<HeartbeatBatcher> heartbeat_batcher_;
 };
 
 // Query the consensus service at last known host/port that is
@@ -445,6 +445,48 @@ TEST_F(ConsensusQueueTest, TestQueueAdvancesCommittedIndex) {
   ASSERT_OPID_EQ(queue_->GetMajorityReplicatedOpIdForTests(), MakeOpId(1, 10));
 }
 
+// Tests that the leader lease time only advances once a majority of voters,
+// counting the local peer, accepted requests in the current term.
+TEST_F(ConsensusQueueTest, TestMajorityAcceptedRequestSendTime) {
+  queue_->Init(MinimumOpId());
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(MonoTime::Min()));
+
+  queue_->SetLeaderMode(MinimumOpId(), 2, BuildRaftConfigPBForTests(5));
+  queue_->TrackPeer("peer-1");
+  queue_->TrackPeer("peer-2");
+  queue_->TrackPeer("peer-3");
+  queue_->TrackPeer("peer-4");
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(MonoTime::Min()));
+
+  MonoTime t1 = MonoTime::Now(MonoTime::FINE);
+  MonoTime t2 = t1;
+  t2.AddDelta(MonoDelta::FromMilliseconds(10));
+
+  // One follower plus the leader is not a majority of five.
+  queue_->NotifyPeerAcceptedRequest("peer-1", 2, t2);
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(MonoTime::Min()));
+
+  // Acceptances from another term don't count.
+  queue_->NotifyPeerAcceptedRequest("peer-2", 1, t2);
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(MonoTime::Min()));
+
+  // With a majority, the oldest send time within the majority wins.
+  queue_->NotifyPeerAcceptedRequest("peer-2", 2, t1);
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(t1));
+  queue_->NotifyPeerAcceptedRequest("peer-3", 2, t2);
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(t2));
+
+  // Late responses to older requests don't move the time backwards.
+  queue_->NotifyPeerAcceptedRequest("peer-3", 2, t1);
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(t2));
+
+  // A new term starts from scratch.
+  queue_->SetNonLeaderMode();
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(MonoTime::Min()));
+  queue_->SetLeaderMode(MinimumOpId(), 3, BuildRaftConfigPBForTests(5));
+  ASSERT_TRUE(queue_->MajorityAcceptedRequestSendTime().Equals(MonoTime::Min()));
+}
+
 // In this test we append a sequence of operations to a log
 // and then start tracking a peer whose first required operation
 // is before the first operation in the queue.
@@ -23,6 +23,7 @@
 #include <string>
 #include <utility>
 
+#include "kudu/common/timestamp.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/log_reader.h"
@@ -50,6 +51,8 @@ DEFINE_int32(consensus_max_batch_size_bytes, 1024 * 1024,
              "The maximum per-tablet RPC batch size when updating peers.");
 TAG_FLAG(consensus_max_batch_size_bytes, advanced);
 
+DECLARE_int32(consensus_max_inflight_requests_per_peer);
+
 DEFINE_int32(follower_unavailable_considered_failed_sec, 300,
              "Seconds that a leader is unable to successfully heartbeat to a "
              "follower after which the follower is considered to be failed and "
@@ -63,6 +66,14 @@ DEFINE_int32(consensus_inject_latency_ms_in_notifications, 0,
 TAG_FLAG(consensus_inject_latency_ms_in_notifications, hidden);
 TAG_FLAG(consensus_inject_latency_ms_in_notifications, unsafe);
 
+DEFINE_bool(tablet_copy_from_followers, true,
+            "Whether a leader which asks a new replica to copy its tablet offers "
+            "the up-to-date followers as copy sources too, so that the new "
+            "replica copies the data from one of them rather than from the "
+            "leader.");
+TAG_FLAG(tablet_copy_from_followers, advanced);
+TAG_FLAG(tablet_copy_from_followers, runtime);
+
 namespace kudu {
 namespace consensus {
 
@@ -151,6 +162,8 @@ void PeerMessageQueue::SetLeaderMode(const OpId& committed_index,
   MonoTime now(MonoTime::Now(MonoTime::FINE));
   for (const PeersMap::value_type& entry : peers_map_) {
     entry.second->last_successful_communication_time = now;
+    // Acceptances from previous terms say nothing about this one.
+    entry.second->last_accepted_request_send_time = MonoTime::Min();
   }
 }
 
@@ -163,6 +176,10 @@ void PeerMessageQueue::SetNonLeaderMode() {
       << queue_state_.ToString();
 }
 
+void PeerMessageQueue::SetSafeTimeCallback(const Callback<Status(Timestamp*)>& safe_time_cb) {
+  safe_time_cb_ = safe_time_cb;
+}
+
 void PeerMessageQueue::TrackPeer(const string& uuid) {
   std::lock_guard<simple_spinlock> lock(queue_lock_);
   TrackPeerUnlocked(uuid);
@@ -254,12 +271,21 @@ Status PeerMessageQueue::AppendOperations(const vector<ReplicateRefPtr>& msgs,
   if (last_id.term() > queue_state_.current_term) {
     queue_state_.current_term = last_id.term();
   }
+  bool is_leader = queue_state_.mode == LEADER;
 
   // Unlock ourselves during Append to prevent a deadlock: it's possible that
   // the log buffer is full, in which case AppendOperations would block. However,
   // for the log buffer to empty, it may need to call LocalPeerAppendFinished()
   // which also needs queue_lock_.
   lock.unlock();
+
+  // As leader, each op is sent to every follower: serialize it once here,
+  // before it is shared, so that requests can be built from the cached bytes.
+  if (is_leader) {
+    for (const ReplicateRefPtr& msg : msgs) {
+      msg->Serialize();
+    }
+  }
   RETURN_NOT_OK(log_cache_.AppendOperations(msgs,
                                             Bind(&PeerMessageQueue::LocalPeerAppendFinished,
                                                  Unretained(this),
@@ -276,8 +302,21 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
                                         ConsensusRequestPB* request,
                                         vector<ReplicateRefPtr>* msg_refs,
                                         bool* needs_tablet_copy) {
+  // Get the safe time before looking at the end of the log: every op appended
+  // after this point has a higher timestamp.
+  Timestamp safe_time;
+  bool has_safe_time = false;
+  if (!safe_time_cb_.is_null()) {
+    Status s = safe_time_cb_.Run(&safe_time);
+    has_safe_time = s.ok();
+    if (PREDICT_FALSE(!s.ok())) {
+      VLOG_WITH_PREFIX_UNLOCKED(1) << "Not propagating safe time: " << s.ToString();
+    }
+  }
+
   TrackedPeer* peer = nullptr;
   OpId preceding_id;
+  int64_t last_appended_index;
   {
     std::lock_guard<simple_spinlock> lock(queue_lock_);
     DCHECK_EQ(queue_state_.state, kQueueOpen);
@@ -294,8 +333,10 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     // This is initialized to the queue's last appended op but gets set to the id of the
     // log entry preceding the first one in 'messages' if messages are found for the peer.
     preceding_id = queue_state_.last_appended;
+    last_appended_index = queue_state_.last_appended.index();
     request->mutable_committed_index()->CopyFrom(queue_state_.committed_index);
     request->set_caller_term(queue_state_.current_term);
+    request->clear_safe_timestamp();
   }
 
   MonoDelta unreachable_time =
@@ -367,11 +408,27 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
     }
     msg_refs->swap(messages);
     DCHECK_LE(request->ByteSize(), FLAGS_consensus_max_batch_size_bytes);
+
+    // When several requests may be in flight to the peer, optimistically assume
+    // that this batch will be accepted, so that the next request picks up where
+    // this one ends. An LMP mismatch in a response rolls 'next_index' back.
+    if (FLAGS_consensus_max_inflight_requests_per_peer > 1 && request->ops_size() > 0) {
+      std::lock_guard<simple_spinlock> lock(queue_lock_);
+      peer->next_index = request->ops(request->ops_size() - 1).id().index() + 1;
+    }
   }
 
   DCHECK(preceding_id.IsInitialized());
   request->mutable_preceding_id()->CopyFrom(preceding_id);
 
+  // The safe time only holds for a follower that has everything up to the
+  // end of the log as it was when the safe time was taken.
+  int64_t last_sent_index = request->ops_size() > 0 ?
+      request->ops(request->ops_size() - 1).id().index() : preceding_id.index();
+  if (has_safe_time && !peer->is_new && last_sent_index >= last_appended_index) {
+    request->set_safe_timestamp(safe_time.ToUint64());
+  }
+
   if (PREDICT_FALSE(VLOG_IS_ON(2))) {
     if (request->ops_size() > 0) {
       VLOG_WITH_PREFIX_UNLOCKED(2) << "Sending request with operations to Peer: " << uuid
@@ -390,6 +447,7 @@ Status PeerMessageQueue::RequestForPeer(const string& uuid,
 Status PeerMessageQueue::GetTabletCopyRequestForPeer(const string& uuid,
                                                           StartTabletCopyRequestPB* req) {
   TrackedPeer* peer = nullptr;
+  std::vector<RaftPeerPB> followers;
   {
     std::lock_guard<simple_spinlock> lock(queue_lock_);
     DCHECK_EQ(queue_state_.state, kQueueOpen);
@@ -398,12 +456,34 @@ Status PeerMessageQueue::GetTabletCopyRequestForPeer(const string& uuid,
     if (PREDICT_FALSE(peer == nullptr || queue_state_.mode == NON_LEADER)) {
       return Status::NotFound("Peer not tracked or queue not in leader mode.");
     }
+
+    // Offer the voters which are reachable and hold everything replicated to
+    // a majority as sources too.
+    if (FLAGS_tablet_copy_from_followers && queue_state_.active_config) {
+      for (const RaftPeerPB& member : queue_state_.active_config->peers()) {
+        if (member.permanent_uuid() == uuid ||
+            member.permanent_uuid() == local_peer_pb_.permanent_uuid() ||
+            member.member_type() != RaftPeerPB::VOTER ||
+            !member.has_last_known_addr()) {
+          continue;
+        }
+        const TrackedPeer* follower = FindPtrOrNull(peers_map_, member.permanent_uuid());
+        if (follower && follower->is_last_exchange_successful &&
+            !follower->needs_tablet_copy &&
+            follower->last_received.index() >= queue_state_.majority_replicated_opid.index()) {
+          followers.push_back(member);
+        }
+      }
+    }
   }
 
   if (PREDICT_FALSE(!peer->needs_tablet_copy)) {
     return Status::IllegalState("Peer does not need to initiate Tablet Copy", uuid);
   }
   req->Clear();
+  for (const RaftPeerPB& follower : followers) {
+    *req->add_follower_copy_peers() = follower;
+  }
   req->set_dest_uuid(uuid);
   req->set_tablet_id(tablet_id_);
   req->set_copy_peer_uuid(local_peer_pb_.permanent_uuid());
@@ -473,6 +553,55 @@ void PeerMessageQueue::NotifyPeerIsResponsiveDespiteError(const std::string& pee
   peer->last_successful_communication_time = MonoTime::Now(MonoTime::FINE);
 }
 
+void PeerMessageQueue::NotifyPeerAcceptedRequest(const std::string& peer_uuid,
+                                                 int64_t term,
+                                                 const MonoTime& send_time) {
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  if (queue_state_.mode != LEADER || term != queue_state_.current_term) return;
+  TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_uuid);
+  if (!peer) return;
+  if (peer->last_accepted_request_send_time.ComesBefore(send_time)) {
+    peer->last_accepted_request_send_time = send_time;
+  }
+}
+
+MonoTime PeerMessageQueue::MajorityAcceptedRequestSendTime() const {
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  if (queue_state_.mode != LEADER) return MonoTime::Min();
+
+  const string& local_uuid = local_peer_pb_.permanent_uuid();
+  vector<MonoTime> times;
+  for (const RaftPeerPB& peer_pb : queue_state_.active_config->peers()) {
+    if (!IsRaftConfigVoter(peer_pb.permanent_uuid(), *queue_state_.active_config)) continue;
+    if (peer_pb.permanent_uuid() == local_uuid) {
+      // We always support our own leadership.
+      times.push_back(MonoTime::Max());
+      continue;
+    }
+    const TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_pb.permanent_uuid());
+    times.push_back(peer ? peer->last_accepted_request_send_time : MonoTime::Min());
+  }
+
+  // Sort newest first: the majority_size-th entry is the latest time that a
+  // majority of voters has acknowledged.
+  std::sort(times.begin(), times.end(), [](const MonoTime& a, const MonoTime& b) {
+      return b.ComesBefore(a);
+    });
+  int majority_size = queue_state_.majority_size_;
+  if (majority_size <= 0 || majority_size > static_cast<int>(times.size())) {
+    return MonoTime::Min();
+  }
+  return times[majority_size - 1];
+}
+
+bool PeerMessageQueue::IsPeerCaughtUp(const std::string& peer_uuid) const {
+  std::lock_guard<simple_spinlock> l(queue_lock_);
+  if (queue_state_.mode != LEADER) return false;
+  const TrackedPeer* peer = FindPtrOrNull(peers_map_, peer_uuid);
+  return peer && peer->is_last_exchange_successful &&
+      OpIdEquals(peer->last_received, queue_state_.last_appended);
+}
+
 void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
                                         const ConsensusResponsePB& response,
                                         bool* more_pending) {
@@ -568,6 +697,19 @@ void PeerMessageQueue::ResponseFromPeer(const std::string& peer_uuid,
           << "Falling back to committed index " << peer->last_known_committed_idx;
     }
 
+    // With several requests in flight, a successful response may describe an
+    // older state of the peer than one we've already processed, and ops past
+    // the peer's last received one may still be in flight. Neither should be
+    // moved backwards. Once the peer has a prefix of our log, that prefix only
+    // grows for as long as we are leader.
+    if (FLAGS_consensus_max_inflight_requests_per_peer > 1 &&
+        peer_has_prefix_of_log && !status.has_error() && !previous.is_new) {
+      if (previous.last_received.index() > peer->last_received.index()) {
+        peer->last_received = previous.last_received;
+      }
+      peer->next_index = std::max(peer->next_index, previous.next_index);
+    }
+
     if (PREDICT_FALSE(status.has_error())) {
       peer->is_last_exchange_successful = false;
       switch (status.error().code()) {
@@ -30,6 +30,7 @@
 #include "kudu/consensus/log_util.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
+#include "kudu/gutil/callback.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/status.h"
@@ -40,6 +41,7 @@ class AtomicGauge;
 class MemTracker;
 class MetricEntity;
 class ThreadPool;
+class Timestamp;
 
 namespace log {
 class Log;
@@ -61,9 +63,10 @@ extern const char kConsensusQueueParentTrackerId[];
 //
 // This class is used only on the LEADER side.
 //
-// TODO Right now this class is able to track one outstanding operation
-// per peer. If we want to have more than one outstanding RPC we need to
-// modify it.
+// When --consensus_max_inflight_requests_per_peer is above 1, several requests
+// may be outstanding per peer: RequestForPeer() advances the peer's next_index
+// past each batch it hands out, and responses never move it backwards unless
+// they report an LMP mismatch.
 class PeerMessageQueue {
  public:
   struct TrackedPeer {
@@ -75,6 +78,7 @@ class PeerMessageQueue {
           last_known_committed_idx(MinimumOpId().index()),
           is_last_exchange_successful(false),
           last_successful_communication_time(MonoTime::Now(MonoTime::FINE)),
+          last_accepted_request_send_time(MonoTime::Min()),
           needs_tablet_copy(false),
           last_seen_term_(0) {}
 
@@ -112,6 +116,12 @@ class PeerMessageQueue {
     // successful communication ever took place.
     MonoTime last_successful_communication_time;
 
+    // The time at which we sent the most recent request that this peer
+    // accepted in the current term. Since the peer withholds its vote for
+    // the minimum election timeout after accepting a request, this bounds
+    // how long the peer will keep supporting our leadership.
+    MonoTime last_accepted_request_send_time;
+
     // Whether the follower was detected to need tablet copy.
     bool needs_tablet_copy;
 
@@ -149,6 +159,11 @@ class PeerMessageQueue {
   // index or notify observers of its advancement.
   virtual void SetNonLeaderMode();
 
+  // Sets the callback used to get a safe timestamp to send along with requests
+  // that reach the end of the log. See ConsensusRequestPB.safe_timestamp.
+  // Must be called before any peer is tracked.
+  void SetSafeTimeCallback(const Callback<Status(Timestamp*)>& safe_time_cb);
+
   // Makes the queue track this peer.
   virtual void TrackPeer(const std::string& peer_uuid);
 
@@ -207,6 +222,22 @@ class PeerMessageQueue {
   // may not be fully up and running or able to accept updates.
   void NotifyPeerIsResponsiveDespiteError(const std::string& peer_uuid);
 
+  // Records that 'peer_uuid' accepted, in term 'term', a request that was sent
+  // at 'send_time'. Ignored if 'term' is not the queue's current term.
+  virtual void NotifyPeerAcceptedRequest(const std::string& peer_uuid,
+                                         int64_t term,
+                                         const MonoTime& send_time);
+
+  // Returns the latest send time such that a majority of voters (counting the
+  // local peer) accepted a request sent no earlier than it in the current
+  // term. Returns MonoTime::Min() if the queue is not in LEADER mode or no
+  // such majority exists yet.
+  virtual MonoTime MajorityAcceptedRequestSendTime() const;
+
+  // Returns true if the queue is in LEADER mode and 'peer_uuid' has received
+  // every operation appended to the queue so far.
+  virtual bool IsPeerCaughtUp(const std::string& peer_uuid) const;
+
   // Updates the request queue with the latest response of a peer, returns
   // whether this peer has more requests pending.
   virtual void ResponseFromPeer(const std::string& peer_uuid,
@@ -396,6 +427,9 @@ class PeerMessageQueue {
   LogCache log_cache_;
 
   Metrics metrics_;
+
+  // Unset unless safe time propagation is enabled.
+  Callback<Status(Timestamp*)> safe_time_cb_;
 };
 
 // The interface between RaftConsensus and the PeerMessageQueue.
@@ -0,0 +1,279 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/consensus/heartbeat_batcher.h"
+
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <mutex>
+
+#include "kudu/consensus/consensus.proxy.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/net/net_util.h"
+#include "kudu/util/net/sockaddr.h"
+
+DEFINE_bool(raft_batch_heartbeats, true,
+            "Whether the status-only heartbeats that the leaders on this server send "
+            "to replicas on another server are coalesced into a single "
+            "MultiRaftHeartbeat RPC.");
+TAG_FLAG(raft_batch_heartbeats, advanced);
+TAG_FLAG(raft_batch_heartbeats, runtime);
+
+DEFINE_int32(raft_heartbeat_batch_window_ms, 10,
+             "How long a heartbeat may wait for others bound for the same server "
+             "before they are sent together. Should be well below "
+             "--raft_heartbeat_interval_ms.");
+TAG_FLAG(raft_heartbeat_batch_window_ms, advanced);
+
+DEFINE_int32(raft_heartbeat_batch_max_size, 1000,
+             "Maximum number of tablets' heartbeats sent in a single "
+             "MultiRaftHeartbeat RPC. A full batch is sent without waiting for "
+             "the rest of the window.");
+TAG_FLAG(raft_heartbeat_batch_max_size, advanced);
+
+DECLARE_int32(consensus_rpc_timeout_ms);
+DECLARE_int32(raft_heartbeat_interval_ms);
+
+namespace kudu {
+namespace consensus {
+
+using rpc::ErrorStatusPB;
+using rpc::Messenger;
+using std::shared_ptr;
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using strings::Substitute;
+
+HeartbeatBatcher::HeartbeatBatcher(shared_ptr<Messenger> messenger, string local_uuid)
+    : messenger_(std::move(messenger)),
+      local_uuid_(std::move(local_uuid)) {
+}
+
+HeartbeatBatcher::~HeartbeatBatcher() {
+}
+
+bool HeartbeatBatcher::AddHeartbeat(const HostPort& hostport,
+                                    const ConsensusRequestPB& request,
+                                    ConsensusResponsePB* response,
+                                    const HeartbeatCallback& callback) {
+  DCHECK_EQ(0, request.ops_size());
+  if (!FLAGS_raft_batch_heartbeats) {
+    return false;
+  }
+  const string& dest_uuid = request.dest_uuid();
+
+  std::unique_lock<simple_spinlock> l(lock_);
+  Destination* dest = GetOrCreateDestination(hostport, dest_uuid, &l);
+  if (PREDICT_FALSE(dest == nullptr) || dest->unsupported) {
+    return false;
+  }
+
+  bool schedule_flush = false;
+  if (!dest->batch) {
+    dest->batch.reset(new Batch);
+    dest->batch->request.set_dest_uuid(dest_uuid);
+    dest->batch->request.set_caller_uuid(local_uuid_);
+    schedule_flush = true;
+  }
+  Batch* batch = dest->batch.get();
+  batch->request.add_heartbeats()->CopyFrom(request);
+  batch->pending.push_back({ response, callback });
+
+  unique_ptr<Batch> full_batch;
+  if (static_cast<int>(batch->pending.size()) >= FLAGS_raft_heartbeat_batch_max_size) {
+    full_batch = std::move(dest->batch);
+  }
+  l.unlock();
+
+  if (full_batch) {
+    SendBatch(dest, std::move(full_batch));
+  } else if (schedule_flush) {
+    messenger_->ScheduleOnReactor(
+        boost::bind(&HeartbeatBatcher::FlushDestination, shared_from_this(), dest_uuid, _1),
+        MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_batch_window_ms));
+  }
+  return true;
+}
+
+void HeartbeatBatcher::AddQuiescedPeer(const HostPort& hostport, const string& dest_uuid) {
+  std::unique_lock<simple_spinlock> l(lock_);
+  Destination* dest = GetOrCreateDestination(hostport, dest_uuid, &l);
+  if (PREDICT_FALSE(dest == nullptr)) {
+    // The peer's server will not hear from us and will time out the leader,
+    // just as it would without quiescence.
+    return;
+  }
+  dest->num_quiesced_peers++;
+  if (dest->pinging) {
+    return;
+  }
+  dest->pinging = true;
+  l.unlock();
+  SchedulePing(dest_uuid);
+}
+
+void HeartbeatBatcher::RemoveQuiescedPeer(const string& dest_uuid) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  Destination* dest = FindPointeeOrNull(destinations_, dest_uuid);
+  if (PREDICT_FALSE(dest == nullptr)) {
+    return;
+  }
+  DCHECK_GT(dest->num_quiesced_peers, 0);
+  dest->num_quiesced_peers--;
+}
+
+void HeartbeatBatcher::RecordHeardFrom(const string& server_uuid) {
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  std::lock_guard<simple_spinlock> l(lock_);
+  last_heard_from_[server_uuid] = now;
+}
+
+MonoTime HeartbeatBatcher::LastHeardFrom(const string& server_uuid) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return FindWithDefault(last_heard_from_, server_uuid, MonoTime());
+}
+
+HeartbeatBatcher::Destination* HeartbeatBatcher::GetOrCreateDestination(
+    const HostPort& hostport, const string& dest_uuid, std::unique_lock<simple_spinlock>* l) {
+  Destination* dest = FindPointeeOrNull(destinations_, dest_uuid);
+  if (PREDICT_TRUE(dest != nullptr)) {
+    return dest;
+  }
+  // Resolve the address without holding the lock.
+  l->unlock();
+  vector<Sockaddr> addrs;
+  Status s = hostport.ResolveAddresses(&addrs);
+  if (PREDICT_FALSE(!s.ok() || addrs.empty())) {
+    l->lock();
+    return nullptr;
+  }
+  unique_ptr<Destination> new_dest(new Destination);
+  new_dest->proxy.reset(new ConsensusServiceProxy(messenger_, addrs[0]));
+  new_dest->unsupported = false;
+  new_dest->num_quiesced_peers = 0;
+  new_dest->pinging = false;
+  l->lock();
+  // Another thread may have added the destination in the meantime.
+  unique_ptr<Destination>& entry = destinations_[dest_uuid];
+  if (!entry) {
+    entry = std::move(new_dest);
+  }
+  return entry.get();
+}
+
+void HeartbeatBatcher::FlushDestination(const string& dest_uuid, const Status& status) {
+  Destination* dest;
+  unique_ptr<Batch> batch;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    dest = FindPointeeOrNull(destinations_, dest_uuid);
+    DCHECK(dest);
+    batch = std::move(dest->batch);
+  }
+  // The batch may have filled up and been sent already.
+  if (!batch) {
+    return;
+  }
+  if (PREDICT_FALSE(!status.ok())) {
+    // The messenger is shutting down.
+    for (const PendingHeartbeat& hb : batch->pending) {
+      hb.callback(status);
+    }
+    return;
+  }
+  SendBatch(dest, std::move(batch));
+}
+
+void HeartbeatBatcher::SchedulePing(const string& dest_uuid) {
+  messenger_->ScheduleOnReactor(
+      boost::bind(&HeartbeatBatcher::SendPing, shared_from_this(), dest_uuid, _1),
+      MonoDelta::FromMilliseconds(FLAGS_raft_heartbeat_interval_ms));
+}
+
+void HeartbeatBatcher::SendPing(const string& dest_uuid, const Status& status) {
+  Destination* dest;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    dest = FindPointeeOrNull(destinations_, dest_uuid);
+    DCHECK(dest);
+    if (!status.ok() || dest->num_quiesced_peers == 0 || dest->unsupported) {
+      dest->pinging = false;
+      return;
+    }
+  }
+  unique_ptr<Batch> batch(new Batch);
+  batch->request.set_dest_uuid(dest_uuid);
+  batch->request.set_caller_uuid(local_uuid_);
+  SendBatch(dest, std::move(batch));
+  SchedulePing(dest_uuid);
+}
+
+void HeartbeatBatcher::SendBatch(Destination* dest, unique_ptr<Batch> batch) {
+  VLOG(2) << "Sending " << batch->pending.size() << " heartbeats to server "
+          << batch->request.dest_uuid();
+  Batch* b = batch.release();
+  b->controller.set_timeout(MonoDelta::FromMilliseconds(FLAGS_consensus_rpc_timeout_ms));
+  dest->proxy->MultiRaftHeartbeatAsync(
+      b->request, &b->response, &b->controller,
+      boost::bind(&HeartbeatBatcher::BatchResponseReceived, shared_from_this(), dest, b));
+}
+
+void HeartbeatBatcher::BatchResponseReceived(Destination* dest, Batch* batch) {
+  unique_ptr<Batch> b(batch);
+  Status s = b->controller.status();
+  const ErrorStatusPB* err = b->controller.error_response();
+  if (s.IsRemoteError() && err && err->has_code() &&
+      err->code() == ErrorStatusPB::ERROR_NO_SUCH_METHOD) {
+    // The server predates MultiRaftHeartbeat: from now on, the tablets send
+    // their heartbeats to it one by one. This batch fails, and the next
+    // heartbeats for these tablets go out on their own.
+    LOG(INFO) << "Server " << b->request.dest_uuid() << " does not support "
+              << "batched heartbeats; sending them individually";
+    std::lock_guard<simple_spinlock> l(lock_);
+    dest->unsupported = true;
+  }
+  int num_pending = b->pending.size();
+  if (s.ok() && !b->response.has_error() && b->response.responses_size() != num_pending) {
+    s = Status::RemoteError(Substitute("Expected $0 heartbeat responses from $1, got $2",
+                                       num_pending, b->request.dest_uuid(),
+                                       b->response.responses_size()));
+  }
+
+  for (int i = 0; i < num_pending; i++) {
+    const PendingHeartbeat& hb = b->pending[i];
+    if (s.ok()) {
+      if (PREDICT_FALSE(b->response.has_error())) {
+        // An error about the batch as a whole concerns every tablet in it.
+        hb.response->Clear();
+        hb.response->mutable_error()->CopyFrom(b->response.error());
+      } else {
+        hb.response->Swap(b->response.mutable_responses(i));
+      }
+    }
+    hb.callback(s);
+  }
+}
+
+}  // namespace consensus
+}  // namespace kudu
@@ -0,0 +1,168 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_CONSENSUS_HEARTBEAT_BATCHER_H_
+#define KUDU_CONSENSUS_HEARTBEAT_BATCHER_H_
+
+#include <boost/function.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "kudu/consensus/consensus.pb.h"
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/rpc/rpc_controller.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+class HostPort;
+
+namespace rpc {
+class Messenger;
+}
+
+namespace consensus {
+class ConsensusServiceProxy;
+
+// Coalesces the status-only UpdateConsensus requests that the leaders hosted
+// on this server send to replicas on other servers. Heartbeats bound for the
+// same server are gathered for a short window and sent in a single
+// MultiRaftHeartbeat RPC, whose response is then handed back out to each
+// tablet. A server hosting thousands of idle tablets thus sends a handful of
+// RPCs to each of its peers per heartbeat interval rather than one per tablet.
+//
+// The batcher also keeps the other servers informed that this one is alive
+// while some of its leaders have quiesced, i.e. stopped heartbeating their
+// idle tablets' replicas on those servers, and records when it last heard
+// from each server in turn.
+//
+// One instance is shared by all the tablets of a server. This class is
+// thread-safe.
+class HeartbeatBatcher : public std::enable_shared_from_this<HeartbeatBatcher> {
+ public:
+  // Invoked once the response to a queued heartbeat has been filled in, or
+  // with the error that kept the heartbeat from being delivered. Runs on a
+  // reactor thread.
+  typedef boost::function<void(const Status&)> HeartbeatCallback;
+
+  // 'local_uuid' is the UUID of this server.
+  HeartbeatBatcher(std::shared_ptr<rpc::Messenger> messenger, std::string local_uuid);
+  ~HeartbeatBatcher();
+
+  // Queues 'request' to be sent to the server at 'hostport' with the next
+  // batch for it. 'request' must not carry any operations; it is copied.
+  // 'response' must stay valid until 'callback' runs.
+  //
+  // Returns false, without queuing anything, if heartbeats to that server
+  // are not batched, in which case the caller should send 'request' itself.
+  bool AddHeartbeat(const HostPort& hostport,
+                    const ConsensusRequestPB& request,
+                    ConsensusResponsePB* response,
+                    const HeartbeatCallback& callback);
+
+  // Notes that a leader on this server stopped heartbeating its replica on
+  // the server with UUID 'dest_uuid', at 'hostport', because the tablet is
+  // idle. As long as any leader has, this server periodically lets that one
+  // know it is alive. Must be matched by a call to RemoveQuiescedPeer().
+  void AddQuiescedPeer(const HostPort& hostport, const std::string& dest_uuid);
+
+  // Notes that a leader that had quiesced resumed heartbeating its replica on
+  // the server with UUID 'dest_uuid'.
+  void RemoveQuiescedPeer(const std::string& dest_uuid);
+
+  // Records that the server with UUID 'server_uuid' just showed it is alive.
+  void RecordHeardFrom(const std::string& server_uuid);
+
+  // Returns when the server with UUID 'server_uuid' was last heard from, or
+  // an uninitialized MonoTime if it never was.
+  MonoTime LastHeardFrom(const std::string& server_uuid) const;
+
+ private:
+  struct PendingHeartbeat {
+    ConsensusResponsePB* response;
+    HeartbeatCallback callback;
+  };
+
+  // A MultiRaftHeartbeat RPC, while it is being filled and once sent.
+  struct Batch {
+    MultiRaftHeartbeatRequestPB request;
+    MultiRaftHeartbeatResponsePB response;
+    rpc::RpcController controller;
+    std::vector<PendingHeartbeat> pending;
+  };
+
+  // The state kept for each remote server, keyed by its UUID. Never removed,
+  // so that pointers to it stay valid in callbacks.
+  struct Destination {
+    gscoped_ptr<ConsensusServiceProxy> proxy;
+
+    // Set once the server turns out not to support MultiRaftHeartbeat.
+    bool unsupported;
+
+    // The number of leaders that stopped heartbeating their replicas on the
+    // server, and whether liveness pings to it are scheduled.
+    int num_quiesced_peers;
+    bool pinging;
+
+    // The batch being filled, if any heartbeats are waiting to be sent.
+    std::unique_ptr<Batch> batch;
+  };
+
+  // Returns the state for the server with UUID 'dest_uuid' at 'hostport',
+  // creating it if needed, or null if the address couldn't be resolved. 'l'
+  // must hold 'lock_' and may be released meanwhile.
+  Destination* GetOrCreateDestination(const HostPort& hostport,
+                                      const std::string& dest_uuid,
+                                      std::unique_lock<simple_spinlock>* l);
+
+  // Sends whatever is queued for the server with UUID 'dest_uuid'. Scheduled
+  // on a reactor once the batch window has passed.
+  void FlushDestination(const std::string& dest_uuid, const Status& status);
+
+  // Sends an empty batch to the server with UUID 'dest_uuid' if any leader
+  // is still quiesced towards it, and schedules the next one.
+  void SendPing(const std::string& dest_uuid, const Status& status);
+  void SchedulePing(const std::string& dest_uuid);
+
+  void SendBatch(Destination* dest, std::unique_ptr<Batch> batch);
+
+  // Hands out the responses in 'batch' to the tablets that queued them.
+  void BatchResponseReceived(Destination* dest, Batch* batch);
+
+  const std::shared_ptr<rpc::Messenger> messenger_;
+  const std::string local_uuid_;
+
+  // Protects 'destinations_', the fields of each Destination and
+  // 'last_heard_from_'.
+  mutable simple_spinlock lock_;
+  std::unordered_map<std::string, std::unique_ptr<Destination>> destinations_;
+
+  // When each server was last heard from, keyed by its UUID.
+  std::unordered_map<std::string, MonoTime> last_heard_from_;
+
+  DISALLOW_COPY_AND_ASSIGN(HeartbeatBatcher);
+};
+
+}  // namespace consensus
+}  // namespace kudu
+
+#endif /* KUDU_CONSENSUS_HEARTBEAT_BATCHER_H_ */
@@ -148,6 +148,14 @@ Status PrintDecoded(const LogEntryPB& entry, const Schema& tablet_schema) {
           tablet_schema,
           replicate.write_request(),
           replicate.has_request_id() ? &replicate.request_id() : nullptr));
+      for (const consensus::CoalescedWritePB& write : replicate.coalesced_writes()) {
+        cout << indent << "Coalesced write:" << endl;
+        RETURN_NOT_OK(PrintDecodedWriteRequestPB(
+            indent + indent,
+            tablet_schema,
+            write.write_request(),
+            write.has_request_id() ? &write.request_id() : nullptr));
+      }
     } else {
       cout << indent << replicate.ShortDebugString() << endl;
     }
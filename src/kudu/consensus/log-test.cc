@@ -33,11 +33,16 @@
 DEFINE_int32(num_batches, 10000,
              "Number of batches to write to/read from the Log in TestWriteManyBatches");
 
+DECLARE_string(log_compression_codec);
 DECLARE_int32(log_min_segments_to_retain);
+DECLARE_int32(log_max_buffered_commits);
+DECLARE_int32(log_max_buffered_commit_delay_ms);
 DECLARE_double(log_inject_io_error_on_preallocate_fraction);
 DECLARE_int64(fs_wal_dir_reserved_bytes);
 DECLARE_int64(disk_reserved_bytes_free_for_testing);
 
+METRIC_DECLARE_histogram(log_fsync_latency);
+
 namespace kudu {
 namespace log {
 
@@ -204,6 +209,31 @@ TEST_F(LogTest, TestFsync) {
   ASSERT_OK(log_->Close());
 }
 
+// Tests that in timed-fsync mode appends are acknowledged without waiting
+// for an fsync, and that the pending fsync is made up once it's due.
+TEST_F(LogTest, TestTimedFsync) {
+  options_.force_fsync_all = true;
+  options_.fsync_interval_ms = 500;
+  ASSERT_OK(BuildLog());
+  scoped_refptr<Histogram> fsyncs = METRIC_log_fsync_latency.Instantiate(metric_entity_);
+
+  // The first append is synced right away since there was no earlier fsync.
+  OpId opid = MakeOpId(0, 1);
+  ASSERT_OK(AppendNoOp(&opid));
+  ASSERT_EQ(1, fsyncs->TotalCount());
+
+  // The following ones within the interval don't wait for an fsync.
+  ASSERT_OK(AppendNoOp(&opid));
+  ASSERT_OK(AppendNoOp(&opid));
+  ASSERT_EQ(1, fsyncs->TotalCount());
+
+  // The append thread syncs them on its own once the interval passes.
+  SleepFor(MonoDelta::FromSeconds(2));
+  ASSERT_EQ(2, fsyncs->TotalCount());
+
+  ASSERT_OK(log_->Close());
+}
+
 // Regression test for part of KUDU-735:
 // if a log is not preallocated, we should properly track its on-disk size as we append to
 // it.
@@ -606,6 +636,65 @@ TEST_F(LogTest, TestWaitUntilAllFlushed) {
   }
 }
 
+// Tests that buffered commits are only appended once enough of them are
+// buffered, or when the log is flushed.
+TEST_F(LogTest, TestBufferedCommits) {
+  FLAGS_log_max_buffered_commits = 3;
+  FLAGS_log_max_buffered_commit_delay_ms = 1000 * 1000;
+  ASSERT_OK(BuildLog());
+
+  auto buffer_commit = [&](int64_t index, Synchronizer* s) {
+    gscoped_ptr<CommitMsg> commit(new CommitMsg);
+    commit->set_op_type(WRITE_OP);
+    commit->mutable_commited_op_id()->CopyFrom(MakeOpId(1, index));
+    commit->mutable_result();
+    return log_->AsyncAppendBufferedCommit(std::move(commit), s->AsStatusCallback());
+  };
+  auto count_entries = [&](int* num_replicates, int* num_commits) {
+    vector<LogEntryPB*> entries;
+    ElementDeleter deleter(&entries);
+    SegmentSequence segments;
+    RETURN_NOT_OK(log_->reader()->GetSegmentsSnapshot(&segments));
+    RETURN_NOT_OK(segments[0]->ReadEntries(&entries));
+    *num_replicates = 0;
+    *num_commits = 0;
+    for (const LogEntryPB* entry : entries) {
+      *num_replicates += entry->has_replicate();
+      *num_commits += entry->has_commit();
+    }
+    return Status::OK();
+  };
+
+  for (int i = 1; i <= 4; i++) {
+    AppendReplicateBatch(MakeOpId(1, i));
+  }
+
+  // Two commits stay buffered.
+  Synchronizer s1, s2, s3, s4;
+  ASSERT_OK(buffer_commit(1, &s1));
+  ASSERT_OK(buffer_commit(2, &s2));
+  int num_replicates;
+  int num_commits;
+  ASSERT_OK(count_entries(&num_replicates, &num_commits));
+  ASSERT_EQ(4, num_replicates);
+  ASSERT_EQ(0, num_commits);
+
+  // The third one appends all three.
+  ASSERT_OK(buffer_commit(3, &s3));
+  ASSERT_OK(s1.Wait());
+  ASSERT_OK(s2.Wait());
+  ASSERT_OK(s3.Wait());
+  ASSERT_OK(count_entries(&num_replicates, &num_commits));
+  ASSERT_EQ(3, num_commits);
+
+  // Flushing the log appends the rest.
+  ASSERT_OK(buffer_commit(4, &s4));
+  ASSERT_OK(log_->WaitUntilAllFlushed());
+  ASSERT_OK(s4.Wait());
+  ASSERT_OK(count_entries(&num_replicates, &num_commits));
+  ASSERT_EQ(4, num_commits);
+}
+
 // Tests log reopening and that GC'ing the old log's segments works.
 TEST_F(LogTest, TestLogReopenAndGC) {
   ASSERT_OK(BuildLog());
@@ -711,6 +800,45 @@ TEST_F(LogTest, TestWriteManyBatches) {
   }
 }
 
+// Tests that segments with compressed entry batches can be read back, also
+// after the codec has changed, alongside uncompressed segments.
+TEST_F(LogTest, TestCompressedSegments) {
+  FLAGS_log_compression_codec = "lz4";
+  ASSERT_OK(BuildLog());
+  AppendReplicateBatchAndCommitEntryPairsToLog(10);
+
+  FLAGS_log_compression_codec = "none";
+  ASSERT_OK(log_->AllocateSegmentAndRollOver());
+  AppendReplicateBatchAndCommitEntryPairsToLog(10);
+
+  FLAGS_log_compression_codec = "zlib";
+  ASSERT_OK(log_->AllocateSegmentAndRollOver());
+  AppendReplicateBatchAndCommitEntryPairsToLog(10);
+
+  // Random access through the index must also uncompress the batches.
+  OpId op;
+  ASSERT_OK(log_->reader()->LookupOpId(5, &op));
+  ASSERT_EQ(5, op.index());
+  ASSERT_OK(log_->reader()->LookupOpId(25, &op));
+  ASSERT_EQ(25, op.index());
+  ASSERT_OK(log_->Close());
+
+  shared_ptr<LogReader> reader;
+  ASSERT_OK(LogReader::Open(fs_manager_.get(), NULL, kTestTablet, NULL, &reader));
+  SegmentSequence segments;
+  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  ASSERT_EQ(3, segments.size());
+  ASSERT_EQ(LZ4, segments[0]->header().compression_codec());
+  ASSERT_FALSE(segments[1]->header().has_compression_codec());
+  ASSERT_EQ(ZLIB, segments[2]->header().compression_codec());
+
+  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
+    STLDeleteElements(&entries_);
+    ASSERT_OK(segment->ReadEntries(&entries_));
+    ASSERT_EQ(20, entries_.size());
+  }
+}
+
 // This tests that querying LogReader works.
 // This sets up a reader with some segments to query which amount to the
 // following:
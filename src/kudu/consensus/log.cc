@@ -18,8 +18,10 @@
 #include "kudu/consensus/log.h"
 
 #include <algorithm>
+#include <condition_variable>
 #include <mutex>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/log_index.h"
 #include "kudu/consensus/log_metrics.h"
@@ -75,6 +77,39 @@ DEFINE_int32(group_commit_queue_size_bytes, 4 * 1024 * 1024,
              "Maximum size of the group commit queue in bytes");
 TAG_FLAG(group_commit_queue_size_bytes, advanced);
 
+DEFINE_int32(log_group_commit_max_delay_us, 0,
+             "Maximum number of microseconds the log appender waits for more "
+             "entry batches to arrive before fsyncing a group commit. The delay "
+             "is tuned between 0 and this value depending on how many batches "
+             "arrive while waiting, so that lightly loaded logs sync right away. "
+             "0 disables the wait. Only applies when log_force_fsync_all is set.");
+TAG_FLAG(log_group_commit_max_delay_us, experimental);
+
+DEFINE_int32(log_shared_appender_threads, 0,
+             "If positive, the logs of all tablets share a pool of at most this "
+             "many appender threads instead of each running its own. With many "
+             "tablets per server this saves a thread per tablet. Shared appenders "
+             "don't wait for group commits to fill, and in timed-fsync mode also "
+             "fsync whenever a log goes idle. The pool is sized when first used.");
+TAG_FLAG(log_shared_appender_threads, experimental);
+
+DEFINE_int32(log_max_buffered_commits, 1,
+             "Maximum number of write COMMIT messages buffered in memory before "
+             "they're appended to the log together, as a single entry batch. 1 "
+             "appends each one on its own. Buffered commits are always appended "
+             "before the tablet flushes any of its stores, so those lost in a "
+             "crash belong to operations whose effects weren't durable either, "
+             "and which bootstrap replays.");
+TAG_FLAG(log_max_buffered_commits, experimental);
+TAG_FLAG(log_max_buffered_commits, runtime);
+
+DEFINE_int32(log_max_buffered_commit_delay_ms, 100,
+             "Maximum age of the oldest buffered COMMIT message before the "
+             "buffered commits are appended, checked whenever one is buffered. "
+             "Only applies when log_max_buffered_commits is above 1.");
+TAG_FLAG(log_max_buffered_commit_delay_ms, experimental);
+TAG_FLAG(log_max_buffered_commit_delay_ms, runtime);
+
 // Fault/latency injection flags.
 // -----------------------------
 DEFINE_bool(log_inject_latency, false,
@@ -112,6 +147,12 @@ DEFINE_int64(fs_wal_dir_reserved_bytes, 0,
 TAG_FLAG(fs_wal_dir_reserved_bytes, runtime);
 TAG_FLAG(fs_wal_dir_reserved_bytes, evolving);
 
+DEFINE_string(log_compression_codec, "none",
+              "Codec used to compress the entry batches of new WAL segments: one of "
+              "'none', 'lz4', 'snappy' or 'zlib'. Each segment records the codec it "
+              "was written with, so this may be changed across restarts.");
+TAG_FLAG(log_compression_codec, experimental);
+
 // Validate that log_min_segments_to_retain >= 1
 static bool ValidateLogsToRetain(const char* flagname, int value) {
   if (value >= 1) {
@@ -136,8 +177,44 @@ using env_util::OpenFileForRandom;
 using std::shared_ptr;
 using strings::Substitute;
 
+namespace {
+
+// The pool is never destroyed: logs may still be appending at exit.
+ThreadPool* shared_append_pool = nullptr;
+std::mutex shared_append_pool_lock;
+
+// Returns the shared appender pool, creating it if needed, or NULL if logs
+// should run their own appender threads.
+ThreadPool* GetSharedAppendPool() {
+  if (FLAGS_log_shared_appender_threads <= 0) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> l(shared_append_pool_lock);
+  if (shared_append_pool == nullptr) {
+    gscoped_ptr<ThreadPool> pool;
+    Status s = ThreadPoolBuilder("log-append")
+        .set_min_threads(0)
+        .set_max_threads(FLAGS_log_shared_appender_threads)
+        .set_idle_timeout(MonoDelta::FromSeconds(10))
+        .Build(&pool);
+    if (!s.ok()) {
+      LOG(WARNING) << "Unable to create shared log appender pool, using an "
+                   << "appender thread per log: " << s.ToString();
+      return nullptr;
+    }
+    shared_append_pool = pool.release();
+  }
+  return shared_append_pool;
+}
+
+} // anonymous namespace
+
 // This class is responsible for managing the thread that appends to
 // the log file.
+//
+// By default each log runs its own thread. If --log_shared_appender_threads
+// is set, the log is instead scheduled on a pool shared by all logs whenever
+// entries are queued, and processes one group per turn on the pool.
 class Log::AppendThread {
  public:
   explicit AppendThread(Log* log);
@@ -145,6 +222,10 @@ class Log::AppendThread {
   // Initializes the objects and starts the thread.
   Status Init();
 
+  // Must be called after an entry batch is put in the log's queue. When using
+  // the shared pool, schedules this log on it unless already scheduled.
+  void Wake();
+
   // Waits until the last enqueued elements are processed, sets the
   // Appender thread to closing state. If any entries are added to the
   // queue during the process, invoke their callbacks' 'OnFailure()'
@@ -154,26 +235,74 @@ class Log::AppendThread {
  private:
   void RunThread();
 
+  // Processes one group of entry batches on a shared pool thread, then
+  // reschedules itself, or goes idle once the queue is empty.
+  void ProcessQueueTask();
+
+  // Appends and syncs 'entry_batches', and runs their callbacks. Successfully
+  // appended batches are deleted and removed from the vector.
+  void ProcessBatches(std::vector<LogEntryBatch*>* entry_batches);
+
+  // Waits up to the current group commit delay to add more entry batches to
+  // 'entry_batches', and retunes the delay according to how many arrived.
+  // Returns false if the queue was shut down.
+  bool WaitForMoreBatches(std::vector<LogEntryBatch*>* entry_batches);
+
   Log* const log_;
 
-  // Lock to protect access to thread_ during shutdown.
+  // The shared appender pool, or NULL if this log runs its own thread.
+  ThreadPool* const shared_pool_;
+
+  // The current group commit delay. Only accessed by the append thread.
+  int64_t group_commit_delay_us_;
+
+  // Lock to protect access to thread_ during shutdown, and to the state of
+  // the shared pool task below.
   mutable std::mutex lock_;
   scoped_refptr<Thread> thread_;
+
+  // Whether a ProcessQueueTask() is scheduled or running on the shared pool.
+  bool task_active_;
+  // Set once Shutdown() has waited for the shared pool task to go idle.
+  bool shut_down_;
+  // Signaled when 'task_active_' becomes false.
+  std::condition_variable task_idle_;
 };
 
 
 Log::AppendThread::AppendThread(Log *log)
-  : log_(log) {
+  : log_(log),
+    shared_pool_(GetSharedAppendPool()),
+    group_commit_delay_us_(0),
+    task_active_(false),
+    shut_down_(false) {
 }
 
 Status Log::AppendThread::Init() {
   DCHECK(!thread_) << "Already initialized";
+  if (shared_pool_) {
+    VLOG(1) << "Using the shared log append pool for tablet " << log_->tablet_id();
+    return Status::OK();
+  }
   VLOG(1) << "Starting log append thread for tablet " << log_->tablet_id();
   RETURN_NOT_OK(kudu::Thread::Create("log", "appender",
       &AppendThread::RunThread, this, &thread_));
   return Status::OK();
 }
 
+void Log::AppendThread::Wake() {
+  if (!shared_pool_) {
+    return;
+  }
+  std::lock_guard<std::mutex> l(lock_);
+  if (task_active_ || shut_down_) {
+    return;
+  }
+  task_active_ = true;
+  CHECK_OK(shared_pool_->SubmitClosure(
+      Bind(&AppendThread::ProcessQueueTask, Unretained(this))));
+}
+
 void Log::AppendThread::RunThread() {
   bool shutting_down = false;
   while (PREDICT_TRUE(!shutting_down)) {
@@ -185,72 +314,189 @@ void Log::AppendThread::RunThread() {
     // the entry_batches vector with the final set of log entry batches that
     // were enqueued. We finish processing this last bunch of log entry batches
     // before exiting the main RunThread() loop.
-    if (PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(&entry_batches))) {
+    //
+    // If an fsync is pending in timed-fsync mode, only wait until it is due.
+    if (log_->fsync_pending_ &&
+        log_->entry_queue()->BlockingDrainTo(&entry_batches, log_->NextFsyncDeadline()) &&
+        entry_batches.empty()) {
+      Status s = log_->Sync();
+      if (PREDICT_FALSE(!s.ok())) {
+        LOG(ERROR) << "Error syncing log" << s.ToString();
+      }
+      continue;
+    }
+    if (entry_batches.empty() &&
+        PREDICT_FALSE(!log_->entry_queue()->BlockingDrainTo(&entry_batches))) {
       shutting_down = true;
     }
+    if (!shutting_down && log_->force_sync_all_ && !log_->sync_disabled_) {
+      shutting_down = !WaitForMoreBatches(&entry_batches);
+    }
+    ProcessBatches(&entry_batches);
+  }
+  VLOG(1) << "Exiting AppendThread for tablet " << log_->tablet_id();
+}
+
+void Log::AppendThread::ProcessQueueTask() {
+  std::vector<LogEntryBatch*> entry_batches;
+  ElementDeleter d(&entry_batches);
+  while (true) {
+    std::unique_lock<std::mutex> l(lock_);
+    // The deadline has already passed, so this doesn't block. It is called
+    // with 'lock_' held so that Wake() can't miss a batch queued right after
+    // we find the queue empty.
+    log_->entry_queue()->BlockingDrainTo(&entry_batches, MonoTime::Min());
+    if (!entry_batches.empty()) {
+      break;
+    }
+    if (!log_->fsync_pending_) {
+      task_active_ = false;
+      task_idle_.notify_all();
+      return;
+    }
+    // We can't wait for a pending fsync to fall due on a shared thread, so
+    // do it now that the log is idle.
+    l.unlock();
+    Status s = log_->Sync();
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG(ERROR) << "Error syncing log" << s.ToString();
+    }
+  }
+  ProcessBatches(&entry_batches);
+
+  // Go to the back of the pool's queue so other logs get a turn.
+  CHECK_OK(shared_pool_->SubmitClosure(
+      Bind(&AppendThread::ProcessQueueTask, Unretained(this))));
+}
 
-    if (log_->metrics_) {
-      log_->metrics_->entry_batches_per_group->Increment(entry_batches.size());
+void Log::AppendThread::ProcessBatches(std::vector<LogEntryBatch*>* entry_batches) {
+  if (log_->metrics_) {
+    log_->metrics_->entry_batches_per_group->Increment(entry_batches->size());
+    size_t group_bytes = 0;
+    for (const LogEntryBatch* entry_batch : *entry_batches) {
+      group_bytes += entry_batch->total_size_bytes();
     }
-    TRACE_EVENT1("log", "batch", "batch_size", entry_batches.size());
+    log_->metrics_->bytes_per_group->Increment(group_bytes);
+  }
+  TRACE_EVENT1("log", "batch", "batch_size", entry_batches->size());
 
-    SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
+  SCOPED_LATENCY_METRIC(log_->metrics_, group_commit_latency);
 
-    bool is_all_commits = true;
-    for (LogEntryBatch* entry_batch : entry_batches) {
-      entry_batch->WaitForReady();
-      TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
-      Status s = log_->DoAppend(entry_batch);
-      if (PREDICT_FALSE(!s.ok())) {
-        LOG(ERROR) << "Error appending to the log: " << s.ToString();
-        entry_batch->set_failed_to_append();
-        // TODO If a single transaction fails to append, should we
-        // abort all subsequent transactions in this batch or allow
-        // them to be appended? What about transactions in future
-        // batches?
-        if (!entry_batch->callback().is_null()) {
-          entry_batch->callback().Run(s);
-        }
-      }
-      if (is_all_commits && entry_batch->type_ != COMMIT) {
-        is_all_commits = false;
+  bool is_all_commits = true;
+  for (LogEntryBatch* entry_batch : *entry_batches) {
+    entry_batch->WaitForReady();
+    TRACE_EVENT_FLOW_END0("log", "Batch", entry_batch);
+    Status s = log_->DoAppend(entry_batch);
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG(ERROR) << "Error appending to the log: " << s.ToString();
+      entry_batch->set_failed_to_append();
+      // TODO If a single transaction fails to append, should we
+      // abort all subsequent transactions in this batch or allow
+      // them to be appended? What about transactions in future
+      // batches?
+      if (!entry_batch->callback().is_null()) {
+        entry_batch->callback().Run(s);
       }
     }
-
-    Status s;
-    if (!is_all_commits) {
-      s = log_->Sync();
+    if (is_all_commits && entry_batch->type_ != COMMIT) {
+      is_all_commits = false;
     }
-    if (PREDICT_FALSE(!s.ok())) {
-      LOG(ERROR) << "Error syncing log" << s.ToString();
-      for (LogEntryBatch* entry_batch : entry_batches) {
-        if (!entry_batch->callback().is_null()) {
-          entry_batch->callback().Run(s);
-        }
+  }
+
+  Status s;
+  if (!is_all_commits) {
+    s = log_->SyncIfDue();
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG(ERROR) << "Error syncing log" << s.ToString();
+    for (LogEntryBatch* entry_batch : *entry_batches) {
+      if (!entry_batch->callback().is_null()) {
+        entry_batch->callback().Run(s);
       }
-    } else {
-      TRACE_EVENT0("log", "Callbacks");
-      VLOG(2) << "Synchronized " << entry_batches.size() << " entry batches";
-      SCOPED_WATCH_STACK(100);
-      for (LogEntryBatch* entry_batch : entry_batches) {
-        if (PREDICT_TRUE(!entry_batch->failed_to_append()
-                         && !entry_batch->callback().is_null())) {
-          entry_batch->callback().Run(Status::OK());
-        }
-        // It's important to delete each batch as we see it, because
-        // deleting it may free up memory from memory trackers, and the
-        // callback of a later batch may want to use that memory.
-        delete entry_batch;
+    }
+  } else {
+    TRACE_EVENT0("log", "Callbacks");
+    VLOG(2) << "Synchronized " << entry_batches->size() << " entry batches";
+    SCOPED_WATCH_STACK(100);
+    for (LogEntryBatch* entry_batch : *entry_batches) {
+      if (PREDICT_TRUE(!entry_batch->failed_to_append()
+                       && !entry_batch->callback().is_null())) {
+        entry_batch->callback().Run(Status::OK());
       }
-      entry_batches.clear();
+      // It's important to delete each batch as we see it, because
+      // deleting it may free up memory from memory trackers, and the
+      // callback of a later batch may want to use that memory.
+      delete entry_batch;
     }
+    entry_batches->clear();
   }
-  VLOG(1) << "Exiting AppendThread for tablet " << log_->tablet_id();
+}
+
+bool Log::AppendThread::WaitForMoreBatches(std::vector<LogEntryBatch*>* entry_batches) {
+  const int64_t max_delay_us = FLAGS_log_group_commit_max_delay_us;
+  if (max_delay_us <= 0) {
+    group_commit_delay_us_ = 0;
+    return true;
+  }
+  // Under light load we don't wait at all: a group comes in and is synced
+  // right away. Once groups start carrying more than one batch, the log is
+  // busy enough that it's worth holding the fsync back a little.
+  if (group_commit_delay_us_ == 0) {
+    if (entry_batches->size() > 1) {
+      group_commit_delay_us_ = std::max<int64_t>(1, max_delay_us / 8);
+    }
+    return true;
+  }
+
+  size_t num_before = entry_batches->size();
+  MonoTime start = MonoTime::Now(MonoTime::FINE);
+  MonoTime deadline = start;
+  deadline.AddDelta(MonoDelta::FromMicroseconds(group_commit_delay_us_));
+  bool ok = true;
+  while (MonoTime::Now(MonoTime::FINE).ComesBefore(deadline)) {
+    if (!log_->entry_queue()->BlockingDrainTo(entry_batches, deadline)) {
+      ok = false;
+      break;
+    }
+  }
+  if (log_->metrics_) {
+    log_->metrics_->group_commit_delay->Increment(
+        MonoTime::Now(MonoTime::FINE).GetDeltaSince(start).ToMicroseconds());
+  }
+
+  // If waiting paid off, wait longer next time; otherwise back off until we
+  // stop waiting altogether.
+  if (entry_batches->size() > num_before) {
+    group_commit_delay_us_ = std::min(group_commit_delay_us_ * 2, max_delay_us);
+  } else {
+    group_commit_delay_us_ /= 2;
+    if (group_commit_delay_us_ < max_delay_us / 8) {
+      group_commit_delay_us_ = 0;
+    }
+  }
+  return ok;
 }
 
 void Log::AppendThread::Shutdown() {
   log_->entry_queue()->Shutdown();
-  std::lock_guard<std::mutex> lock_guard(lock_);
+  std::unique_lock<std::mutex> lock_guard(lock_);
+  if (shared_pool_) {
+    while (task_active_) {
+      task_idle_.wait(lock_guard);
+    }
+    shut_down_ = true;
+    lock_guard.unlock();
+
+    // Handle batches queued after the task last looked at the queue, whose
+    // Wake() may have come too late to schedule it.
+    std::vector<LogEntryBatch*> entry_batches;
+    ElementDeleter d(&entry_batches);
+    log_->entry_queue()->BlockingDrainTo(&entry_batches, MonoTime::Min());
+    if (!entry_batches.empty()) {
+      ProcessBatches(&entry_batches);
+    }
+    return;
+  }
   if (thread_) {
     VLOG(1) << "Shutting down log append thread for tablet " << log_->tablet_id();
     CHECK_OK(ThreadJoiner(thread_.get()).Join());
@@ -309,6 +555,8 @@ Log::Log(LogOptions options, FsManager* fs_manager, string log_path,
       append_thread_(new AppendThread(this)),
       force_sync_all_(options_.force_fsync_all),
       sync_disabled_(false),
+      last_fsync_time_(MonoTime::Min()),
+      fsync_pending_(false),
       allocation_state_(kAllocationNotStarted),
       metric_entity_(metric_entity) {
   CHECK_OK(ThreadPoolBuilder("log-alloc").set_max_threads(1).Build(&allocation_pool_));
@@ -336,7 +584,7 @@ Status Log::Init() {
   // sequence numbers.
   if (reader_->num_segments() != 0) {
     VLOG(1) << "Using existing " << reader_->num_segments()
-            << " segments from path: " << fs_manager_->GetWalsRootDir();
+            << " segments from path: " << log_dir_;
 
     vector<scoped_refptr<ReadableLogSegment> > segments;
     RETURN_NOT_OK(reader_->GetSegmentsSnapshot(&segments));
@@ -426,6 +674,7 @@ Status Log::Reserve(LogEntryTypePB type,
   if (PREDICT_FALSE(!entry_batch_queue_.BlockingPut(new_entry_batch.get()))) {
     return kLogShutdownStatus;
   }
+  append_thread_->Wake();
 
   // Release the memory back to the caller: this will be freed when
   // the entry is removed from the queue.
@@ -484,6 +733,66 @@ Status Log::AsyncAppendCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
   return Status::OK();
 }
 
+namespace {
+
+void RunBufferedCommitCallbacks(const std::vector<StatusCallback>& callbacks, const Status& s) {
+  for (const StatusCallback& callback : callbacks) {
+    callback.Run(s);
+  }
+}
+
+} // anonymous namespace
+
+Status Log::AsyncAppendBufferedCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
+                                      const StatusCallback& callback) {
+  int max_buffered = FLAGS_log_max_buffered_commits;
+  if (max_buffered <= 1) {
+    // Append whatever was buffered before the flag was lowered first.
+    {
+      std::lock_guard<Mutex> l(buffered_commits_lock_);
+      RETURN_NOT_OK(AppendBufferedCommitsUnlocked());
+    }
+    return AsyncAppendCommit(std::move(commit_msg), callback);
+  }
+
+  MAYBE_FAULT(FLAGS_fault_crash_before_append_commit);
+
+  std::lock_guard<Mutex> l(buffered_commits_lock_);
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  if (!buffered_commits_) {
+    buffered_commits_.reset(new LogEntryBatchPB);
+    oldest_buffered_commit_time_ = now;
+  }
+  LogEntryPB* entry = buffered_commits_->add_entry();
+  entry->set_type(COMMIT);
+  entry->set_allocated_commit(commit_msg.release());
+  buffered_commit_callbacks_.push_back(callback);
+
+  if (buffered_commits_->entry_size() >= max_buffered ||
+      now.GetDeltaSince(oldest_buffered_commit_time_).ToMilliseconds() >=
+          FLAGS_log_max_buffered_commit_delay_ms) {
+    RETURN_NOT_OK(AppendBufferedCommitsUnlocked());
+  }
+  return Status::OK();
+}
+
+Status Log::AppendBufferedCommitsUnlocked() {
+  buffered_commits_lock_.AssertAcquired();
+  if (!buffered_commits_) {
+    return Status::OK();
+  }
+  std::vector<StatusCallback> callbacks;
+  callbacks.swap(buffered_commit_callbacks_);
+
+  // Reserve while still holding the lock, so that once a caller appends the
+  // buffered commits, or sees there are none, all of those buffered so far
+  // are ahead of anything it queues next, e.g. the marker of
+  // WaitUntilAllFlushed().
+  LogEntryBatch* reserved_entry_batch;
+  RETURN_NOT_OK(Reserve(COMMIT, std::move(buffered_commits_), &reserved_entry_batch));
+  return AsyncAppend(reserved_entry_batch, Bind(&RunBufferedCommitCallbacks, callbacks));
+}
+
 Status Log::DoAppend(LogEntryBatch* entry_batch) {
   size_t num_entries = entry_batch->count();
   DCHECK_GT(num_entries, 0) << "Cannot call DoAppend() with zero entries reserved";
@@ -614,7 +923,14 @@ Status Log::Sync() {
 
   if (force_sync_all_ && !sync_disabled_) {
     LOG_SLOW_EXECUTION(WARNING, 50, "Fsync log took a long time") {
+      MonoTime start = MonoTime::Now(MonoTime::FINE);
       RETURN_NOT_OK(active_segment_->Sync());
+      last_fsync_time_ = MonoTime::Now(MonoTime::FINE);
+      fsync_pending_ = false;
+      if (metrics_) {
+        metrics_->fsync_latency->Increment(
+            last_fsync_time_.GetDeltaSince(start).ToMicroseconds());
+      }
 
       if (log_hooks_) {
         RETURN_NOT_OK_PREPEND(log_hooks_->PostSyncIfFsyncEnabled(),
@@ -629,6 +945,27 @@ Status Log::Sync() {
   return Status::OK();
 }
 
+Status Log::SyncIfDue() {
+  if (force_sync_all_ && !sync_disabled_ && options_.fsync_interval_ms > 0 &&
+      MonoTime::Now(MonoTime::FINE).ComesBefore(NextFsyncDeadline())) {
+    fsync_pending_ = true;
+    if (log_hooks_) {
+      RETURN_NOT_OK_PREPEND(log_hooks_->PostSync(), "PostSync hook failed");
+    }
+    return Status::OK();
+  }
+  return Sync();
+}
+
+MonoTime Log::NextFsyncDeadline() const {
+  if (last_fsync_time_.Equals(MonoTime::Min())) {
+    return MonoTime::Min();
+  }
+  MonoTime deadline = last_fsync_time_;
+  deadline.AddDelta(MonoDelta::FromMilliseconds(options_.fsync_interval_ms));
+  return deadline;
+}
+
 Status Log::GetSegmentsToGCUnlocked(int64_t min_op_idx, SegmentSequence* segments_to_gc) const {
   // Find the prefix of segments in the segment sequence that is guaranteed not to include
   // 'min_op_idx'.
@@ -689,6 +1026,11 @@ Status Log::Append(LogEntryPB* phys_entry) {
 }
 
 Status Log::WaitUntilAllFlushed() {
+  {
+    std::lock_guard<Mutex> l(buffered_commits_lock_);
+    RETURN_NOT_OK(AppendBufferedCommitsUnlocked());
+  }
+
   // In order to make sure we empty the queue we need to use
   // the async api.
   gscoped_ptr<LogEntryBatchPB> entry_batch(new LogEntryBatchPB);
@@ -795,6 +1137,18 @@ void Log::SetSchemaForNextLogSegment(const Schema& schema,
 }
 
 Status Log::Close() {
+  {
+    std::lock_guard<Mutex> l(buffered_commits_lock_);
+    bool writing;
+    {
+      shared_lock<rw_spinlock> state_l(state_lock_.get_lock());
+      writing = log_state_ == kLogWriting;
+    }
+    if (writing) {
+      RETURN_NOT_OK(AppendBufferedCommitsUnlocked());
+    }
+  }
+
   allocation_pool_->Shutdown();
   append_thread_->Shutdown();
 
@@ -896,6 +1250,10 @@ Status Log::SwitchToAllocatedSegment() {
   header.set_minor_version(kLogMinorVersion);
   header.set_sequence_number(active_segment_sequence_number_);
   header.set_tablet_id(tablet_id_);
+  CompressionType codec = cfile::GetCompressionCodecType(FLAGS_log_compression_codec);
+  if (codec != NO_COMPRESSION) {
+    header.set_compression_codec(codec);
+  }
 
   // Set up the new footer. This will be maintained as the segment is written.
   footer_builder_.Clear();
@@ -32,6 +32,8 @@
 #include "kudu/util/async_util.h"
 #include "kudu/util/blocking_queue.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
 #include "kudu/util/rw_mutex.h"
 #include "kudu/util/promise.h"
 #include "kudu/util/status.h"
@@ -130,9 +132,24 @@ class Log : public RefCountedThreadSafe<Log> {
   Status AsyncAppendCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
                            const StatusCallback& callback);
 
-
-  // Blocks the current thread until all the entries in the log queue
-  // are flushed and fsynced (if fsync of log entries is enabled).
+  // Like AsyncAppendCommit(), but if --log_max_buffered_commits is above 1,
+  // the commit may be held in memory and appended later, along with others,
+  // in a single entry batch: once enough are buffered or the oldest is older
+  // than --log_max_buffered_commit_delay_ms, and at the latest by
+  // WaitUntilAllFlushed() or Close(). 'callback' is invoked once the commit
+  // is durable.
+  //
+  // Only suitable for commits whose loss in a crash is harmless, i.e. those
+  // of operations whose effects are only made durable after a call to
+  // WaitUntilAllFlushed(), as the tablet does before flushing its stores.
+  // Bootstrap then replays such operations as if the commit had been in
+  // flight.
+  Status AsyncAppendBufferedCommit(gscoped_ptr<consensus::CommitMsg> commit_msg,
+                                   const StatusCallback& callback);
+
+  // Blocks the current thread until all the entries in the log queue,
+  // including any buffered commits, are flushed and fsynced (if fsync of
+  // log entries is enabled).
   Status WaitUntilAllFlushed();
 
   // Kick off an asynchronous task that pre-allocates a new
@@ -299,6 +316,18 @@ class Log : public RefCountedThreadSafe<Log> {
 
   Status Sync();
 
+  // Like Sync(), but in timed-fsync mode (see LogOptions::fsync_interval_ms)
+  // only fsyncs if the last fsync is older than the interval. Otherwise the
+  // fsync is left pending, for the append thread to make up later.
+  Status SyncIfDue();
+
+  // The time by which a pending fsync must happen, in timed-fsync mode.
+  MonoTime NextFsyncDeadline() const;
+
+  // Appends the commits buffered by AsyncAppendBufferedCommit(), if any, as
+  // a single entry batch. Requires 'buffered_commits_lock_' to be held.
+  Status AppendBufferedCommitsUnlocked();
+
   // Helper method to get the segment sequence to GC based on the provided min_op_idx.
   Status GetSegmentsToGCUnlocked(int64_t min_op_idx, SegmentSequence* segments_to_gc) const;
 
@@ -383,6 +412,11 @@ class Log : public RefCountedThreadSafe<Log> {
   // This is used to disable fsync during bootstrap.
   bool sync_disabled_;
 
+  // When the log was last fsynced, and whether appends have been
+  // acknowledged since without an fsync. Only used in timed-fsync mode.
+  MonoTime last_fsync_time_;
+  bool fsync_pending_;
+
   // The status of the most recent log-allocation action.
   Promise<Status> allocation_status_;
 
@@ -390,6 +424,16 @@ class Log : public RefCountedThreadSafe<Log> {
   mutable RWMutex allocation_lock_;
   SegmentAllocationState allocation_state_;
 
+  // Protects the commits buffered by AsyncAppendBufferedCommit(). A Mutex
+  // since it's held while reserving space in the queue, which may block.
+  Mutex buffered_commits_lock_;
+
+  // The buffered commits, if any, their callbacks, and when the first of
+  // them was buffered.
+  gscoped_ptr<LogEntryBatchPB> buffered_commits_;
+  std::vector<StatusCallback> buffered_commit_callbacks_;
+  MonoTime oldest_buffered_commit_time_;
+
   scoped_refptr<MetricEntity> metric_entity_;
   gscoped_ptr<LogMetrics> metrics_;
 
@@ -68,6 +68,12 @@ static const char kParentMemTrackerId[] = "log_cache";
 
 typedef vector<const ReplicateMsg*>::const_iterator MsgIter;
 
+// Memory charged to the cache for 'msg': the message itself, plus its
+// serialized form if the leader cached one.
+static int64_t SpaceUsedByMessage(const ReplicateRefPtr& msg) {
+  return msg->get()->SpaceUsed() + msg->serialized_space_used();
+}
+
 LogCache::LogCache(const scoped_refptr<MetricEntity>& metric_entity,
                    const scoped_refptr<log::Log>& log,
                    const string& local_uuid,
@@ -147,7 +153,7 @@ Status LogCache::AppendOperations(const vector<ReplicateRefPtr>& msgs,
 
   int64_t mem_required = 0;
   for (const auto& msg : msgs) {
-    mem_required += msg->get()->SpaceUsed();
+    mem_required += SpaceUsedByMessage(msg);
   }
 
   // Try to consume the memory. If it can't be consumed, we may need to evict.
@@ -267,6 +273,17 @@ int64_t TotalByteSizeForMessage(const ReplicateMsg& msg) {
   msg_size += 1; // for the type tag
   return msg_size;
 }
+
+// Same as above, but avoids recomputing the size of an already serialized message.
+int64_t TotalByteSizeForMessage(const ReplicateRefPtr& msg) {
+  if (!msg->is_serialized()) {
+    return TotalByteSizeForMessage(*msg->get());
+  }
+  int msg_size = google::protobuf::internal::WireFormatLite::LengthDelimitedSize(
+    msg->serialized().size());
+  msg_size += 1; // for the type tag
+  return msg_size;
+}
 } // anonymous namespace
 
 Status LogCache::ReadOps(int64_t after_op_index,
@@ -330,7 +347,7 @@ Status LogCache::ReadOps(int64_t after_op_index,
           continue;
         }
 
-        remaining_space -= TotalByteSizeForMessage(*msg->get());
+        remaining_space -= TotalByteSizeForMessage(msg);
         if (remaining_space < 0 && !messages->empty()) {
           break;
         }
@@ -381,7 +398,7 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
 
     VLOG_WITH_PREFIX_UNLOCKED(2) << "Evicting cache. Removing: " << msg->get()->id();
     AccountForMessageRemovalUnlocked(msg);
-    bytes_evicted += msg->get()->SpaceUsed();
+    bytes_evicted += SpaceUsedByMessage(msg);
     cache_.erase(iter++);
 
     if (bytes_evicted >= bytes_to_evict) {
@@ -392,8 +409,9 @@ void LogCache::EvictSomeUnlocked(int64_t stop_after_index, int64_t bytes_to_evic
 }
 
 void LogCache::AccountForMessageRemovalUnlocked(const ReplicateRefPtr& msg) {
-  tracker_->Release(msg->get()->SpaceUsed());
-  metrics_.log_cache_size->DecrementBy(msg->get()->SpaceUsed());
+  int64_t space_used = SpaceUsedByMessage(msg);
+  tracker_->Release(space_used);
+  metrics_.log_cache_size->DecrementBy(space_used);
   metrics_.log_cache_num_ops->Decrement();
 }
 
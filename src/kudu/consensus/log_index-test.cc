@@ -26,6 +26,7 @@ namespace log {
 
 using consensus::MakeOpId;
 using consensus::OpId;
+using std::vector;
 
 class LogIndexTest : public KuduTest {
  public:
@@ -109,5 +110,30 @@ TEST_F(LogIndexTest, TestMultiSegmentWithGC) {
   VerifyNotFound(2500000);
 }
 
+TEST_F(LogIndexTest, TestGetEntries) {
+  // A run of entries spanning a chunk boundary, with a gap after it.
+  for (int64_t i = 999990; i <= 1000010; i++) {
+    ASSERT_OK(AddEntry(MakeOpId(2, i), 3, i * 10));
+  }
+
+  vector<LogIndexEntry> entries;
+  ASSERT_OK(index_->GetEntries(999990, 1000020, &entries));
+  ASSERT_EQ(21, entries.size());
+  for (int i = 0; i < entries.size(); i++) {
+    EXPECT_EQ(999990 + i, entries[i].op_id.index());
+    EXPECT_EQ(2, entries[i].op_id.term());
+    EXPECT_EQ(3, entries[i].segment_sequence_number);
+    EXPECT_EQ((999990 + i) * 10, entries[i].offset_in_segment);
+  }
+
+  // Only a missing first entry is an error.
+  entries.clear();
+  Status s = index_->GetEntries(999980, 999995, &entries);
+  EXPECT_TRUE(s.IsNotFound()) << s.ToString();
+  EXPECT_TRUE(entries.empty());
+  s = index_->GetEntries(5000000, 5000001, &entries);
+  EXPECT_TRUE(s.IsNotFound()) << s.ToString();
+}
+
 } // namespace log
 } // namespace kudu
@@ -172,7 +172,7 @@ Status LogIndex::GetChunkForIndex(int64_t log_index, bool create,
   int64_t chunk_idx = log_index / kEntriesPerIndexChunk;
 
   {
-    std::lock_guard<simple_spinlock> l(open_chunks_lock_);
+    shared_lock<rw_spinlock> l(open_chunks_lock_);
     if (FindCopy(open_chunks_, chunk_idx, chunk)) {
       return Status::OK();
     }
@@ -185,7 +185,7 @@ Status LogIndex::GetChunkForIndex(int64_t log_index, bool create,
   RETURN_NOT_OK_PREPEND(OpenChunk(chunk_idx, chunk),
                         "Couldn't open index chunk");
   {
-    std::lock_guard<simple_spinlock> l(open_chunks_lock_);
+    std::lock_guard<rw_spinlock> l(open_chunks_lock_);
     if (PREDICT_FALSE(ContainsKey(open_chunks_, chunk_idx))) {
       // Someone else opened the chunk in the meantime.
       // We'll just return that one.
@@ -237,13 +237,43 @@ Status LogIndex::GetEntry(int64_t index, LogIndexEntry* entry) {
   return Status::OK();
 }
 
+Status LogIndex::GetEntries(int64_t start_index, int64_t end_index,
+                            std::vector<LogIndexEntry>* entries) {
+  DCHECK_LE(start_index, end_index);
+  scoped_refptr<IndexChunk> chunk;
+  for (int64_t index = start_index; index <= end_index; index++) {
+    int index_in_chunk = index % kEntriesPerIndexChunk;
+    if (!chunk || index_in_chunk == 0) {
+      Status s = GetChunkForIndex(index, false /* do not create */, &chunk);
+      if (!s.ok()) {
+        if (index == start_index) return s;
+        break;
+      }
+    }
+    PhysicalEntry phys;
+    chunk->GetEntry(index_in_chunk, &phys);
+    // See GetEntry() above.
+    if (phys.offset_in_segment == 0) {
+      if (index == start_index) return Status::NotFound("entry not found");
+      break;
+    }
+
+    LogIndexEntry entry;
+    entry.op_id = consensus::MakeOpId(phys.term, index);
+    entry.segment_sequence_number = phys.segment_sequence_number;
+    entry.offset_in_segment = phys.offset_in_segment;
+    entries->push_back(entry);
+  }
+  return Status::OK();
+}
+
 void LogIndex::GC(int64_t min_index_to_retain) {
   int min_chunk_to_retain = min_index_to_retain / kEntriesPerIndexChunk;
 
   // Enumerate which chunks to delete.
   vector<int64_t> chunks_to_delete;
   {
-    std::lock_guard<simple_spinlock> l(open_chunks_lock_);
+    shared_lock<rw_spinlock> l(open_chunks_lock_);
     for (auto it = open_chunks_.begin();
          it != open_chunks_.lower_bound(min_chunk_to_retain); ++it) {
       chunks_to_delete.push_back(it->first);
@@ -260,7 +290,7 @@ void LogIndex::GC(int64_t min_index_to_retain) {
     }
     LOG(INFO) << "Deleted log index segment " << path;
     {
-      std::lock_guard<simple_spinlock> l(open_chunks_lock_);
+      std::lock_guard<rw_spinlock> l(open_chunks_lock_);
       open_chunks_.erase(chunk_idx);
     }
   }
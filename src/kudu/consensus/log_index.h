@@ -19,6 +19,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/macros.h"
@@ -67,6 +68,16 @@ class LogIndex : public RefCountedThreadSafe<LogIndex> {
   // Returns NotFound() if the given log entry was never written.
   Status GetEntry(int64_t index, LogIndexEntry* entry);
 
+  // Retrieve the entries for indexes 'start_index' through 'end_index'
+  // (inclusive), appending them to 'entries'. Stops at the first index that
+  // was never written. Returns NotFound() only if 'start_index' itself was
+  // never written.
+  //
+  // This is cheaper than calling GetEntry() for each index, since each chunk
+  // is only looked up once.
+  Status GetEntries(int64_t start_index, int64_t end_index,
+                    std::vector<LogIndexEntry>* entries);
+
   // Indicate that we no longer need to retain information about indexes lower than the
   // given index. Note that the implementation is conservative and _may_ choose to retain
   // earlier entries.
@@ -94,7 +105,9 @@ class LogIndex : public RefCountedThreadSafe<LogIndex> {
   // The base directory where index files are located.
   const std::string base_dir_;
 
-  simple_spinlock open_chunks_lock_;
+  // Readers only take this lock in shared mode, so concurrent lookups don't
+  // serialize on each other.
+  rw_spinlock open_chunks_lock_;
 
   // Map from chunk index to IndexChunk. The chunk index is the log index modulo
   // the number of entries per chunk (see docs in log_index.cc).
@@ -48,6 +48,22 @@ METRIC_DEFINE_histogram(tablet, log_entry_batches_per_group, "Log Group Commit B
                         "Number of log entry batches in a group commit group",
                         1024, 2);
 
+METRIC_DEFINE_histogram(tablet, log_bytes_per_group, "Log Group Commit Bytes",
+                        kudu::MetricUnit::kBytes,
+                        "Number of bytes in the log entry batches of a group commit group",
+                        64 * 1024 * 1024, 2);
+
+METRIC_DEFINE_histogram(tablet, log_group_commit_delay, "Log Group Commit Delay",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds the log appender waited for more entry batches "
+                        "before committing a group",
+                        60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, log_fsync_latency, "Log Fsync Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds spent on fsyncing the log segment file",
+                        60000000LU, 2);
+
 namespace kudu {
 namespace log {
 
@@ -58,7 +74,10 @@ LogMetrics::LogMetrics(const scoped_refptr<MetricEntity>& metric_entity)
       MINIT(append_latency),
       MINIT(group_commit_latency),
       MINIT(roll_latency),
-      MINIT(entry_batches_per_group) {
+      MINIT(entry_batches_per_group),
+      MINIT(bytes_per_group),
+      MINIT(group_commit_delay),
+      MINIT(fsync_latency) {
 }
 #undef MINIT
 
@@ -41,6 +41,9 @@ struct LogMetrics {
   scoped_refptr<Histogram> group_commit_latency;
   scoped_refptr<Histogram> roll_latency;
   scoped_refptr<Histogram> entry_batches_per_group;
+  scoped_refptr<Histogram> bytes_per_group;
+  scoped_refptr<Histogram> group_commit_delay;
+  scoped_refptr<Histogram> fsync_latency;
 };
 
 // TODO extract and generalize this for all histogram metrics
@@ -56,7 +56,10 @@ struct LogSegmentSeqnoComparator {
     return a->header().sequence_number() < b->header().sequence_number();
   }
 };
-}
+
+// The most ReadReplicatesInRange() reads from a segment in a single I/O.
+const int64_t kMaxReadAheadBytes = 8 * 1024 * 1024;
+} // anonymous namespace
 
 using consensus::OpId;
 using consensus::ReplicateMsg;
@@ -302,13 +305,105 @@ Status LogReader::ReadBatchUsingIndexEntry(const LogIndexEntry& index_entry,
                                    index_entry.offset_in_segment));
 
   if (bytes_read_) {
-    bytes_read_->IncrementBy(kEntryHeaderSize + tmp_buf->length());
+    bytes_read_->IncrementBy(segment->entry_header_size() + tmp_buf->length());
     entries_read_->IncrementBy((**batch).entry_size());
   }
 
   return Status::OK();
 }
 
+struct LogReader::ReadAheadBuffer {
+  ReadAheadBuffer() : segment_sequence_number(-1), pos(0) {}
+  ~ReadAheadBuffer() { Clear(); }
+
+  void Clear() {
+    STLDeleteElements(&batches);
+    offsets.clear();
+    segment_sequence_number = -1;
+    pos = 0;
+  }
+
+  // The segment the batches were read from, and their offsets in it.
+  int64_t segment_sequence_number;
+  vector<int64_t> offsets;
+  vector<LogEntryBatchPB*> batches;
+
+  // The next batch which wasn't handed out yet.
+  size_t pos;
+};
+
+Status LogReader::ReadBatchWithReadAhead(const vector<LogIndexEntry>& index_entries,
+                                         int i,
+                                         int64_t max_readahead_bytes,
+                                         ReadAheadBuffer* readahead,
+                                         faststring* tmp_buf,
+                                         gscoped_ptr<LogEntryBatchPB>* batch) const {
+  const LogIndexEntry& index_entry = index_entries[i];
+  if (readahead->segment_sequence_number == index_entry.segment_sequence_number) {
+    while (readahead->pos < readahead->batches.size() &&
+           readahead->offsets[readahead->pos] < index_entry.offset_in_segment) {
+      readahead->pos++;
+    }
+    if (readahead->pos < readahead->batches.size() &&
+        readahead->offsets[readahead->pos] == index_entry.offset_in_segment) {
+      batch->reset(readahead->batches[readahead->pos]);
+      readahead->batches[readahead->pos++] = nullptr;
+      return Status::OK();
+    }
+  }
+  readahead->Clear();
+
+  // Batches are written in index order, so the following index entries in the
+  // same segment point to contiguous batches after this one. The last of them
+  // is left for the next read, since we don't know where it ends.
+  int64_t end_offset = index_entry.offset_in_segment;
+  for (int j = i + 1; j < index_entries.size(); j++) {
+    const LogIndexEntry& next = index_entries[j];
+    if (next.segment_sequence_number != index_entry.segment_sequence_number ||
+        next.offset_in_segment < end_offset ||
+        next.offset_in_segment - index_entry.offset_in_segment > max_readahead_bytes) {
+      break;
+    }
+    end_offset = next.offset_in_segment;
+  }
+  if (end_offset == index_entry.offset_in_segment) {
+    return ReadBatchUsingIndexEntry(index_entry, tmp_buf, batch);
+  }
+
+  scoped_refptr<ReadableLogSegment> segment = GetSegmentBySequenceNumber(
+    index_entry.segment_sequence_number);
+  if (PREDICT_FALSE(!segment)) {
+    return Status::NotFound(Substitute("Segment $0 which contained index $1 has been GCed",
+                                       index_entry.segment_sequence_number,
+                                       index_entry.op_id.index()));
+  }
+  {
+    ScopedLatencyMetric scoped(read_batch_latency_.get());
+    RETURN_NOT_OK_PREPEND(segment->ReadEntryBatchesInRange(index_entry.offset_in_segment,
+                                                           end_offset, tmp_buf,
+                                                           &readahead->offsets,
+                                                           &readahead->batches),
+                          Substitute("Failed to read LogEntries for index $0 from log segment "
+                                     "$1 offsets $2-$3",
+                                     index_entry.op_id.index(),
+                                     index_entry.segment_sequence_number,
+                                     index_entry.offset_in_segment, end_offset));
+  }
+  if (bytes_read_) {
+    bytes_read_->IncrementBy(tmp_buf->length());
+    for (const LogEntryBatchPB* read_batch : readahead->batches) {
+      entries_read_->IncrementBy(read_batch->entry_size());
+    }
+  }
+  readahead->segment_sequence_number = index_entry.segment_sequence_number;
+
+  DCHECK_EQ(index_entry.offset_in_segment, readahead->offsets[0]);
+  batch->reset(readahead->batches[0]);
+  readahead->batches[0] = nullptr;
+  readahead->pos = 1;
+  return Status::OK();
+}
+
 Status LogReader::ReadReplicatesInRange(const int64_t starting_at,
                                         const int64_t up_to,
                                         int64_t max_bytes_to_read,
@@ -321,14 +416,28 @@ Status LogReader::ReadReplicatesInRange(const int64_t starting_at,
   ElementDeleter d(&replicates_tmp);
   LogIndexEntry prev_index_entry;
 
+  // Look up the whole range in the index at once. It may come up short of
+  // 'up_to', which is only an error if we get that far.
+  vector<LogIndexEntry> index_entries;
+  RETURN_NOT_OK_PREPEND(log_index_->GetEntries(starting_at, up_to, &index_entries),
+                        Substitute("Failed to read log index for op $0", starting_at));
+  int64_t max_readahead_bytes = kMaxReadAheadBytes;
+  if (max_bytes_to_read > 0) {
+    max_readahead_bytes = std::min(max_readahead_bytes, max_bytes_to_read);
+  }
+  ReadAheadBuffer readahead;
+
   int64_t total_size = 0;
   bool limit_exceeded = false;
   faststring tmp_buf;
   gscoped_ptr<LogEntryBatchPB> batch;
   for (int index = starting_at; index <= up_to && !limit_exceeded; index++) {
-    LogIndexEntry index_entry;
-    RETURN_NOT_OK_PREPEND(log_index_->GetEntry(index, &index_entry),
-                          Substitute("Failed to read log index for op $0", index));
+    int i = index - starting_at;
+    if (PREDICT_FALSE(i >= index_entries.size())) {
+      return Status::NotFound(Substitute("Failed to read log index for op $0", index),
+                              "entry not found");
+    }
+    const LogIndexEntry& index_entry = index_entries[i];
 
     // Since a given LogEntryBatchPB may contain multiple REPLICATE messages,
     // it's likely that this index entry points to the same batch as the previous
@@ -337,7 +446,8 @@ Status LogReader::ReadReplicatesInRange(const int64_t starting_at,
     if (index == starting_at ||
         index_entry.segment_sequence_number != prev_index_entry.segment_sequence_number ||
         index_entry.offset_in_segment != prev_index_entry.offset_in_segment) {
-      RETURN_NOT_OK(ReadBatchUsingIndexEntry(index_entry, &tmp_buf, &batch));
+      RETURN_NOT_OK(ReadBatchWithReadAhead(index_entries, i, max_readahead_bytes,
+                                           &readahead, &tmp_buf, &batch));
 
       // Sanity-check the property that a batch should only have increasing indexes.
       int64_t prev_index = 0;
@@ -173,6 +173,20 @@ class LogReader {
                                   faststring* tmp_buf,
                                   gscoped_ptr<LogEntryBatchPB>* batch) const;
 
+  // Entry batches read ahead by ReadBatchWithReadAhead().
+  struct ReadAheadBuffer;
+
+  // Like ReadBatchUsingIndexEntry() for 'index_entries[i]', but if the next
+  // index entries point to later batches of the same segment, reads up to
+  // 'max_readahead_bytes' of them in the same I/O into 'readahead'. Later calls
+  // for those index entries are then served from 'readahead'.
+  Status ReadBatchWithReadAhead(const std::vector<LogIndexEntry>& index_entries,
+                                int i,
+                                int64_t max_readahead_bytes,
+                                ReadAheadBuffer* readahead,
+                                faststring* tmp_buf,
+                                gscoped_ptr<LogEntryBatchPB>* batch) const;
+
   LogReader(FsManager* fs_manager, const scoped_refptr<LogIndex>& index,
             std::string tablet_name,
             const scoped_refptr<MetricEntity>& metric_entity);
@@ -25,6 +25,7 @@
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/consensus/ref_counted_replicate.h"
 #include "kudu/fs/fs_manager.h"
@@ -50,6 +51,12 @@ DEFINE_bool(log_force_fsync_all, false,
             "Whether the Log/WAL should explicitly call fsync() after each write.");
 TAG_FLAG(log_force_fsync_all, stable);
 
+DEFINE_int32(log_fsync_interval_ms, 0,
+             "If positive, and log_force_fsync_all is set, the WAL is fsynced at most "
+             "once per this many milliseconds instead of after every group commit. "
+             "Writes acknowledged in between may be lost if the machine crashes.");
+TAG_FLAG(log_fsync_interval_ms, experimental);
+
 DEFINE_bool(log_preallocate_segments, true,
             "Whether the WAL should preallocate the entire segment before writing to it");
 TAG_FLAG(log_preallocate_segments, advanced);
@@ -85,6 +92,7 @@ const size_t kLogSegmentHeaderMagicAndHeaderLength = 12;
 const size_t kLogSegmentFooterMagicAndFooterLength  = 12;
 
 const size_t kEntryHeaderSize = 12;
+const size_t kCompressedEntryHeaderSize = 16;
 
 const int kLogMajorVersion = 1;
 const int kLogMinorVersion = 0;
@@ -95,6 +103,7 @@ const uint32_t kLogSegmentMaxHeaderOrFooterSize = 8 * 1024 * 1024;
 LogOptions::LogOptions()
 : segment_size_mb(FLAGS_log_segment_size_mb),
   force_fsync_all(FLAGS_log_force_fsync_all),
+  fsync_interval_ms(FLAGS_log_fsync_interval_ms),
   preallocate_segments(FLAGS_log_preallocate_segments),
   async_preallocate_segments(FLAGS_log_async_preallocate_segments) {
 }
@@ -262,6 +271,7 @@ ReadableLogSegment::ReadableLogSegment(
       readable_to_offset_(0),
       readable_file_(std::move(readable_file)),
       is_initialized_(false),
+      codec_(nullptr),
       footer_was_rebuilt_(false) {}
 
 Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
@@ -274,6 +284,7 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   RETURN_NOT_OK(ReadFileSize());
 
   header_.CopyFrom(header);
+  RETURN_NOT_OK(InitCompressionCodec());
   footer_.CopyFrom(footer);
   first_entry_offset_ = first_entry_offset;
   is_initialized_ = true;
@@ -290,6 +301,7 @@ Status ReadableLogSegment::Init(const LogSegmentHeaderPB& header,
   RETURN_NOT_OK(ReadFileSize());
 
   header_.CopyFrom(header);
+  RETURN_NOT_OK(InitCompressionCodec());
   first_entry_offset_ = first_entry_offset;
   is_initialized_ = true;
 
@@ -409,11 +421,22 @@ Status ReadableLogSegment::ReadHeader() {
                         "Unable to parse protobuf");
 
   header_.CopyFrom(header);
+  RETURN_NOT_OK(InitCompressionCodec());
   first_entry_offset_ = header_size + kLogSegmentHeaderMagicAndHeaderLength;
 
   return Status::OK();
 }
 
+Status ReadableLogSegment::InitCompressionCodec() {
+  codec_ = nullptr;
+  if (header_.has_compression_codec() &&
+      header_.compression_codec() != NO_COMPRESSION) {
+    RETURN_NOT_OK_PREPEND(cfile::GetCompressionCodec(header_.compression_codec(), &codec_),
+                          Substitute("Unable to read log segment $0", path_));
+  }
+  return Status::OK();
+}
+
 
 Status ReadableLogSegment::ReadHeaderMagicAndHeaderLength(uint32_t *len) {
   uint8_t scratch[kLogSegmentHeaderMagicAndHeaderLength];
@@ -573,11 +596,13 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
   const int kChunkSize = 1024 * 1024;
   gscoped_ptr<uint8_t[]> buf(new uint8_t[kChunkSize]);
 
+  const int64_t header_size = entry_header_size();
+
   // We overlap the reads by the size of the header, so that if a header
   // spans chunks, we don't miss it.
   for (;
-       offset < file_size() - kEntryHeaderSize;
-       offset += kChunkSize - kEntryHeaderSize) {
+       offset < file_size() - header_size;
+       offset += kChunkSize - header_size) {
     int rem = std::min<int64_t>(file_size() - offset, kChunkSize);
     Slice chunk;
     RETURN_NOT_OK(ReadFully(readable_file().get(), offset, rem, &chunk, &buf[0]));
@@ -590,9 +615,9 @@ Status ReadableLogSegment::ScanForValidEntryHeaders(int64_t offset, bool* has_va
 
     // Check if this chunk has a valid entry header.
     for (int off_in_chunk = 0;
-         off_in_chunk < chunk.size() - kEntryHeaderSize;
+         off_in_chunk < chunk.size() - header_size;
          off_in_chunk++) {
-      Slice potential_header = Slice(&chunk[off_in_chunk], kEntryHeaderSize);
+      Slice potential_header = Slice(&chunk[off_in_chunk], header_size);
 
       EntryHeader header;
       if (DecodeEntryHeader(potential_header, &header)) {
@@ -619,9 +644,9 @@ Status ReadableLogSegment::ReadEntryHeaderAndBatch(int64_t* offset, faststring*
 
 
 Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header) {
-  uint8_t scratch[kEntryHeaderSize];
+  uint8_t scratch[kCompressedEntryHeaderSize];
   Slice slice;
-  RETURN_NOT_OK_PREPEND(ReadFully(readable_file().get(), *offset, kEntryHeaderSize,
+  RETURN_NOT_OK_PREPEND(ReadFully(readable_file().get(), *offset, entry_header_size(),
                                   &slice, scratch),
                         "Could not read log entry header");
 
@@ -633,13 +658,21 @@ Status ReadableLogSegment::ReadEntryHeader(int64_t *offset, EntryHeader* header)
 }
 
 bool ReadableLogSegment::DecodeEntryHeader(const Slice& data, EntryHeader* header) {
-  DCHECK_EQ(kEntryHeaderSize, data.size());
-  header->msg_length = DecodeFixed32(&data[0]);
-  header->msg_crc    = DecodeFixed32(&data[4]);
-  header->header_crc = DecodeFixed32(&data[8]);
+  DCHECK_EQ(entry_header_size(), data.size());
+  if (codec_) {
+    header->msg_length_compressed = DecodeFixed32(&data[0]);
+    header->msg_length            = DecodeFixed32(&data[4]);
+    header->msg_crc               = DecodeFixed32(&data[8]);
+    header->header_crc            = DecodeFixed32(&data[12]);
+  } else {
+    header->msg_length            = DecodeFixed32(&data[0]);
+    header->msg_length_compressed = header->msg_length;
+    header->msg_crc               = DecodeFixed32(&data[4]);
+    header->header_crc            = DecodeFixed32(&data[8]);
+  }
 
   // Verify the header.
-  uint32_t computed_crc = crc::Crc32c(&data[0], 8);
+  uint32_t computed_crc = crc::Crc32c(&data[0], data.size() - sizeof(uint32_t));
   return computed_crc == header->header_crc;
 }
 
@@ -651,41 +684,112 @@ Status ReadableLogSegment::ReadEntryBatch(int64_t *offset,
   TRACE_EVENT2("log", "ReadableLogSegment::ReadEntryBatch",
                "path", path_,
                "range", Substitute("offset=$0 entry_len=$1",
-                                   *offset, header.msg_length));
+                                   *offset, header.msg_length_compressed));
 
-  if (header.msg_length == 0) {
+  if (header.msg_length == 0 || header.msg_length_compressed == 0) {
     return Status::Corruption("Invalid 0 entry length");
   }
   int64_t limit = readable_up_to();
-  if (PREDICT_FALSE(header.msg_length + *offset > limit)) {
+  if (PREDICT_FALSE(header.msg_length_compressed + *offset > limit)) {
     // The log was likely truncated during writing.
     return Status::Corruption(
         Substitute("Could not read $0-byte log entry from offset $1 in $2: "
                    "log only readable up to offset $3",
-                   header.msg_length, *offset, path_, limit));
+                   header.msg_length_compressed, *offset, path_, limit));
   }
 
   tmp_buf->clear();
-  tmp_buf->resize(header.msg_length);
+  tmp_buf->resize(header.msg_length_compressed);
   Slice entry_batch_slice;
 
   Status s =  readable_file()->Read(*offset,
-                                    header.msg_length,
+                                    header.msg_length_compressed,
                                     &entry_batch_slice,
                                     tmp_buf->data());
 
   if (!s.ok()) return Status::IOError(Substitute("Could not read entry. Cause: $0",
                                                  s.ToString()));
 
+  RETURN_NOT_OK(DecodeEntryBatch(entry_batch_slice, *offset, header, entry_batch));
+  *offset += header.msg_length_compressed;
+  return Status::OK();
+}
+
+Status ReadableLogSegment::ReadEntryBatchesInRange(int64_t start_offset, int64_t end_offset,
+                                                   faststring* tmp_buf,
+                                                   vector<int64_t>* offsets,
+                                                   vector<LogEntryBatchPB*>* batches) {
+  DCHECK_LT(start_offset, end_offset);
+  TRACE_EVENT2("log", "ReadableLogSegment::ReadEntryBatchesInRange",
+               "path", path_,
+               "range", Substitute("offset=$0 len=$1",
+                                   start_offset, end_offset - start_offset));
+  int64_t limit = readable_up_to();
+  if (PREDICT_FALSE(end_offset > limit)) {
+    return Status::Corruption(
+        Substitute("Could not read log entries in range $0-$1 in $2: "
+                   "log only readable up to offset $3",
+                   start_offset, end_offset, path_, limit));
+  }
+
+  tmp_buf->clear();
+  tmp_buf->resize(end_offset - start_offset);
+  Slice data;
+  RETURN_NOT_OK_PREPEND(ReadFully(readable_file().get(), start_offset, tmp_buf->size(),
+                                  &data, tmp_buf->data()),
+                        "Could not read log entries");
+
+  const size_t header_size = entry_header_size();
+  int64_t pos = 0;
+  while (pos < data.size()) {
+    int64_t offset = start_offset + pos;
+    EntryHeader header;
+    if (PREDICT_FALSE(data.size() - pos < header_size ||
+                      !DecodeEntryHeader(Slice(data.data() + pos, header_size), &header))) {
+      return Status::Corruption(Substitute("Invalid log entry header at offset $0 in $1",
+                                           offset, path_));
+    }
+    pos += header_size;
+    if (PREDICT_FALSE(header.msg_length == 0 || header.msg_length_compressed == 0 ||
+                      data.size() - pos < header.msg_length_compressed)) {
+      return Status::Corruption(Substitute("Invalid log entry length at offset $0 in $1",
+                                           offset, path_));
+    }
+    gscoped_ptr<LogEntryBatchPB> batch;
+    RETURN_NOT_OK(DecodeEntryBatch(Slice(data.data() + pos, header.msg_length_compressed),
+                                   offset + header_size, header, &batch));
+    pos += header.msg_length_compressed;
+    offsets->push_back(offset);
+    batches->push_back(batch.release());
+  }
+  return Status::OK();
+}
+
+Status ReadableLogSegment::DecodeEntryBatch(const Slice& data, int64_t offset,
+                                            const EntryHeader& header,
+                                            gscoped_ptr<LogEntryBatchPB>* entry_batch) {
+  Slice entry_batch_slice = data;
+
   // Verify the CRC.
   uint32_t read_crc = crc::Crc32c(entry_batch_slice.data(), entry_batch_slice.size());
   if (PREDICT_FALSE(read_crc != header.msg_crc)) {
     return Status::Corruption(Substitute("Entry CRC mismatch in byte range $0-$1: "
                                          "expected CRC=$2, computed=$3",
-                                         *offset, *offset + header.msg_length,
+                                         offset, offset + header.msg_length_compressed,
                                          header.msg_crc, read_crc));
   }
 
+  // Batches are checksummed as stored, so they are uncompressed only after
+  // the CRC check above.
+  Status s;
+  faststring uncompressed_buf;
+  if (codec_) {
+    uncompressed_buf.resize(header.msg_length);
+    s = codec_->Uncompress(entry_batch_slice, uncompressed_buf.data(), header.msg_length);
+    if (!s.ok()) return Status::Corruption(Substitute("Could not uncompress entry. Cause: $0",
+                                                      s.ToString()));
+    entry_batch_slice = Slice(uncompressed_buf);
+  }
 
   gscoped_ptr<LogEntryBatchPB> read_entry_batch(new LogEntryBatchPB());
   s = pb_util::ParseFromArray(read_entry_batch.get(),
@@ -695,7 +799,6 @@ Status ReadableLogSegment::ReadEntryBatch(int64_t *offset,
   if (!s.ok()) return Status::Corruption(Substitute("Could parse PB. Cause: $0",
                                                     s.ToString()));
 
-  *offset += entry_batch_slice.size();
   entry_batch->reset(read_entry_batch.release());
   return Status::OK();
 }
@@ -706,12 +809,17 @@ WritableLogSegment::WritableLogSegment(string path,
       writable_file_(std::move(writable_file)),
       is_header_written_(false),
       is_footer_written_(false),
+      codec_(nullptr),
       written_offset_(0) {}
 
 Status WritableLogSegment::WriteHeaderAndOpen(const LogSegmentHeaderPB& new_header) {
   DCHECK(!IsHeaderWritten()) << "Can only call WriteHeader() once";
   DCHECK(new_header.IsInitialized())
       << "Log segment header must be initialized" << new_header.InitializationErrorString();
+  if (new_header.has_compression_codec() &&
+      new_header.compression_codec() != NO_COMPRESSION) {
+    RETURN_NOT_OK(cfile::GetCompressionCodec(new_header.compression_codec(), &codec_));
+  }
   faststring buf;
 
   // First the magic.
@@ -760,26 +868,40 @@ Status WritableLogSegment::WriteFooterAndClose(const LogSegmentFooterPB& footer)
   return Status::OK();
 }
 
-Status WritableLogSegment::WriteEntryBatch(const Slice& data) {
+Status WritableLogSegment::WriteEntryBatch(const Slice& entry_batch_data) {
   DCHECK(is_header_written_);
   DCHECK(!is_footer_written_);
-  uint8_t header_buf[kEntryHeaderSize];
-
-  // First encode the length of the message.
-  uint32_t len = data.size();
-  InlineEncodeFixed32(&header_buf[0], len);
+  uint8_t header_buf[kCompressedEntryHeaderSize];
+  size_t header_size = 0;
+
+  // First encode the length of the message. With compression, that is the
+  // compressed length followed by the uncompressed one.
+  Slice data = entry_batch_data;
+  if (codec_) {
+    compress_buf_.resize(codec_->MaxCompressedLength(data.size()));
+    size_t compressed_len;
+    RETURN_NOT_OK_PREPEND(codec_->Compress(data, compress_buf_.data(), &compressed_len),
+                          "Unable to compress log entry batch");
+    InlineEncodeFixed32(&header_buf[header_size], compressed_len);
+    header_size += sizeof(uint32_t);
+    data = Slice(compress_buf_.data(), compressed_len);
+  }
+  InlineEncodeFixed32(&header_buf[header_size], entry_batch_data.size());
+  header_size += sizeof(uint32_t);
 
-  // Then the CRC of the message.
+  // Then the CRC of the message, as written.
   uint32_t msg_crc = crc::Crc32c(&data[0], data.size());
-  InlineEncodeFixed32(&header_buf[4], msg_crc);
+  InlineEncodeFixed32(&header_buf[header_size], msg_crc);
+  header_size += sizeof(uint32_t);
 
   // Then the CRC of the header
-  uint32_t header_crc = crc::Crc32c(&header_buf, 8);
-  InlineEncodeFixed32(&header_buf[8], header_crc);
+  uint32_t header_crc = crc::Crc32c(&header_buf, header_size);
+  InlineEncodeFixed32(&header_buf[header_size], header_crc);
+  header_size += sizeof(uint32_t);
 
   // Write the header to the file, followed by the batch data itself.
-  RETURN_NOT_OK(writable_file_->Append(Slice(header_buf, sizeof(header_buf))));
-  written_offset_ += sizeof(header_buf);
+  RETURN_NOT_OK(writable_file_->Append(Slice(header_buf, header_size)));
+  written_offset_ += header_size;
 
   RETURN_NOT_OK(writable_file_->Append(data));
   written_offset_ += data.size();
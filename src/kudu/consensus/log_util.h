@@ -33,12 +33,17 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/env.h"
+#include "kudu/util/faststring.h"
 
 // Used by other classes, now part of the API.
 DECLARE_bool(log_force_fsync_all);
 
 namespace kudu {
 
+namespace cfile {
+class CompressionCodec;
+} // namespace cfile
+
 namespace consensus {
 struct OpIdBiggerThanFunctor;
 } // namespace consensus
@@ -52,6 +57,10 @@ extern const char kTmpSuffix[];
 // and checksum of the other two fields (see EntryHeader struct below).
 extern const size_t kEntryHeaderSize;
 
+// In segments with compressed entries, the header also holds the
+// uncompressed length of the entry (4 bytes).
+extern const size_t kCompressedEntryHeaderSize;
+
 extern const int kLogMajorVersion;
 extern const int kLogMinorVersion;
 
@@ -67,6 +76,12 @@ struct LogOptions {
   // Whether to call fsync on every call to Append().
   bool force_fsync_all;
 
+  // If positive, and 'force_fsync_all' is set, fsync at most once per this
+  // many milliseconds rather than after every group of appends. Appends are
+  // then acknowledged once written, and may be lost in a machine crash until
+  // the next fsync.
+  int32_t fsync_interval_ms;
+
   // Whether to fallocate segments before writing to them.
   bool preallocate_segments;
 
@@ -240,6 +255,11 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
     return first_entry_offset_;
   }
 
+  // The size of the header preceding each entry batch in this segment.
+  size_t entry_header_size() const {
+    return codec_ ? kCompressedEntryHeaderSize : kEntryHeaderSize;
+  }
+
   // Returns the full size of the file, if the segment is closed and has
   // a footer, or the offset where the last written, non corrupt entry
   // ends.
@@ -255,7 +275,11 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
     // The length of the batch data.
     uint32_t msg_length;
 
-    // The CRC32C of the batch data.
+    // The length of the batch data as stored, i.e. after compression. Equal
+    // to 'msg_length' in segments without compression.
+    uint32_t msg_length_compressed;
+
+    // The CRC32C of the batch data as stored.
     uint32_t msg_crc;
 
     // The CRC32C of this EntryHeader.
@@ -280,6 +304,9 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
 
   Status ParseFooterMagicAndFooterLength(const Slice &data, uint32_t *parsed_len);
 
+  // Sets 'codec_' according to the compression codec in 'header_'.
+  Status InitCompressionCodec();
+
   // Starting at 'offset', read the rest of the log file, looking for any
   // valid log entry headers. If any are found, sets *has_valid_entries to true.
   //
@@ -297,7 +324,7 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
   // Also increments the passed offset* by the length of the entry.
   Status ReadEntryHeader(int64_t *offset, EntryHeader* header);
 
-  // Decode a log entry header from the given slice, which must be kEntryHeaderSize
+  // Decode a log entry header from the given slice, which must be entry_header_size()
   // bytes long. Returns true if successful, false if corrupt.
   //
   // NOTE: this is performance-critical since it is used by ScanForValidEntryHeaders
@@ -312,6 +339,22 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
                         faststring* tmp_buf,
                         gscoped_ptr<LogEntryBatchPB>* entry_batch);
 
+  // Reads all the entry batches in the byte range ['start_offset', 'end_offset')
+  // with a single read, appending them and their offsets to 'batches' and
+  // 'offsets'. 'start_offset' must be the offset of an entry header, and
+  // 'end_offset' the offset of an entry header or the end of the entries.
+  // The caller takes ownership of the batches, even on failure.
+  Status ReadEntryBatchesInRange(int64_t start_offset, int64_t end_offset,
+                                 faststring* tmp_buf,
+                                 std::vector<int64_t>* offsets,
+                                 std::vector<LogEntryBatchPB*>* batches);
+
+  // Checks the CRC of 'data', the stored bytes of an entry batch read from
+  // 'offset', then uncompresses and parses it into 'entry_batch'.
+  Status DecodeEntryBatch(const Slice& data, int64_t offset,
+                          const EntryHeader& header,
+                          gscoped_ptr<LogEntryBatchPB>* entry_batch);
+
   void UpdateReadableToOffset(int64_t readable_to_offset);
 
   const std::string path_;
@@ -337,6 +380,9 @@ class ReadableLogSegment : public RefCountedThreadSafe<ReadableLogSegment> {
 
   LogSegmentHeaderPB header_;
 
+  // The codec the entry batches were compressed with, or NULL.
+  const cfile::CompressionCodec* codec_;
+
   LogSegmentFooterPB footer_;
 
   // True if the footer was rebuilt, rather than actually found on disk.
@@ -370,7 +416,8 @@ class WritableLogSegment {
   }
 
   // Appends the provided batch of data, including a header
-  // and checksum.
+  // and checksum. The data is compressed first if the segment
+  // header specifies a compression codec.
   // Makes sure that the log segment has not been closed.
   Status WriteEntryBatch(const Slice& entry_batch_data);
 
@@ -429,6 +476,12 @@ class WritableLogSegment {
 
   LogSegmentHeaderPB header_;
 
+  // The codec to compress entry batches with, or NULL.
+  const cfile::CompressionCodec* codec_;
+
+  // Scratch space for compressing entry batches.
+  faststring compress_buf_;
+
   LogSegmentFooterPB footer_;
 
   // the offset of the first entry in the log
@@ -33,6 +33,8 @@ DEFINE_int32(num_writer_threads, 4, "Number of threads writing to the log");
 DEFINE_int32(num_batches_per_thread, 2000, "Number of batches per thread");
 DEFINE_int32(num_ops_per_batch_avg, 5, "Target average number of ops per batch");
 
+DECLARE_int32(log_shared_appender_threads);
+
 namespace kudu {
 namespace log {
 
@@ -141,6 +143,34 @@ class MultiThreadedLogTest : public LogTestBase {
       ASSERT_OK(ThreadJoiner(thread.get()).Join());
     }
   }
+
+  // Appends from several threads, closes the log and verifies that all the
+  // ops were written in order.
+  void RunAndVerifyAppends() {
+    ASSERT_OK(BuildLog());
+    int start_current_id = current_index_;
+    LOG_TIMING(INFO, strings::Substitute("inserting $0 batches($1 threads, $2 per-thread)",
+                                        FLAGS_num_writer_threads * FLAGS_num_batches_per_thread,
+                                        FLAGS_num_batches_per_thread, FLAGS_num_writer_threads)) {
+      ASSERT_NO_FATAL_FAILURE(Run());
+    }
+    ASSERT_OK(log_->Close());
+
+    shared_ptr<LogReader> reader;
+    ASSERT_OK(LogReader::Open(fs_manager_.get(), NULL, kTestTablet, NULL, &reader));
+    SegmentSequence segments;
+    ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+
+    for (const SegmentSequence::value_type& entry : segments) {
+      ASSERT_OK(entry->ReadEntries(&entries_));
+    }
+    vector<uint32_t> ids;
+    EntriesToIdList(&ids);
+    DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
+    ASSERT_EQ(current_index_ - start_current_id, ids.size());
+    ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+  }
+
  private:
   ThreadSafeRandom random_;
   simple_spinlock lock_;
@@ -148,28 +178,13 @@ class MultiThreadedLogTest : public LogTestBase {
 };
 
 TEST_F(MultiThreadedLogTest, TestAppends) {
-  ASSERT_OK(BuildLog());
-  int start_current_id = current_index_;
-  LOG_TIMING(INFO, strings::Substitute("inserting $0 batches($1 threads, $2 per-thread)",
-                                      FLAGS_num_writer_threads * FLAGS_num_batches_per_thread,
-                                      FLAGS_num_batches_per_thread, FLAGS_num_writer_threads)) {
-    ASSERT_NO_FATAL_FAILURE(Run());
-  }
-  ASSERT_OK(log_->Close());
-
-  shared_ptr<LogReader> reader;
-  ASSERT_OK(LogReader::Open(fs_manager_.get(), NULL, kTestTablet, NULL, &reader));
-  SegmentSequence segments;
-  ASSERT_OK(reader->GetSegmentsSnapshot(&segments));
+  RunAndVerifyAppends();
+}
 
-  for (const SegmentSequence::value_type& entry : segments) {
-    ASSERT_OK(entry->ReadEntries(&entries_));
-  }
-  vector<uint32_t> ids;
-  EntriesToIdList(&ids);
-  DVLOG(1) << "Wrote total of " << current_index_ - start_current_id << " ops";
-  ASSERT_EQ(current_index_ - start_current_id, ids.size());
-  ASSERT_TRUE(std::is_sorted(ids.begin(), ids.end()));
+TEST_F(MultiThreadedLogTest, TestAppendsWithSharedAppender) {
+  FLAGS_log_shared_appender_threads = 2;
+  options_.force_fsync_all = true;
+  RunAndVerifyAppends();
 }
 
 } // namespace log
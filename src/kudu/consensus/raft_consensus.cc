@@ -18,6 +18,7 @@
 #include "kudu/consensus/raft_consensus.h"
 
 #include <algorithm>
+#include <boost/bind.hpp>
 #include <boost/optional.hpp>
 #include <gflags/gflags.h>
 #include <iostream>
@@ -35,6 +36,7 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/rpc/rpc_controller.h"
 #include "kudu/server/clock.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
@@ -101,7 +103,54 @@ DEFINE_bool(follower_fail_all_prepare, false,
             "Warning! This is only intended for testing.");
 TAG_FLAG(follower_fail_all_prepare, unsafe);
 
+DEFINE_double(raft_leader_lease_fraction, 0.9,
+              "Fraction of the minimum leader election timeout, counted from the "
+              "send time of the latest request acknowledged by a majority, for which "
+              "a leader considers its lease valid and serves linearizable reads "
+              "locally. Must be below 1.0 to leave room for clock rate drift. "
+              "A value of 0 or less disables leader leases.");
+TAG_FLAG(raft_leader_lease_fraction, advanced);
+
+DEFINE_bool(raft_propagate_safe_time, true,
+            "Whether a leader sends its safe time to followers along with requests "
+            "that reach the end of its log, so that followers of idle tablets can "
+            "serve snapshot scans without waiting for another write.");
+TAG_FLAG(raft_propagate_safe_time, advanced);
+
+DEFINE_bool(raft_enable_pre_election, true,
+            "When enabled, a replica which detects a leader failure first checks "
+            "that a majority would vote for it before starting a new term, so "
+            "that a replica which can't win doesn't disrupt a healthy leader.");
+TAG_FLAG(raft_enable_pre_election, advanced);
+TAG_FLAG(raft_enable_pre_election, runtime);
+
+DEFINE_int32(raft_leader_transfer_timeout_ms, 1000,
+             "Maximum time a leader pauses writes while waiting for the target of "
+             "a leadership transfer to catch up.");
+TAG_FLAG(raft_leader_transfer_timeout_ms, advanced);
+
+DEFINE_bool(raft_adaptive_failure_detection, false,
+            "Whether followers detect leader failures by learning the distribution of "
+            "the intervals between the leader's heartbeats, rather than waiting a fixed "
+            "raft_heartbeat_interval_ms * leader_failure_max_missed_heartbeat_periods. "
+            "That timeout remains the upper bound on the time to detect a failure.");
+TAG_FLAG(raft_adaptive_failure_detection, experimental);
+
+DEFINE_double(raft_failure_detector_phi_threshold, 8.0,
+              "When adaptive failure detection is enabled, the suspicion level (phi) at "
+              "which the leader is considered failed. A threshold of N accepts a 10^-N "
+              "chance of wrongly suspecting a live leader at each check.");
+TAG_FLAG(raft_failure_detector_phi_threshold, experimental);
+
+DEFINE_bool(consensus_reject_updates_on_soft_memory_limit, false,
+            "Whether followers reject replicated writes as soon as the soft "
+            "memory limit of the server is exceeded, rather than only once its "
+            "hard limit is.");
+TAG_FLAG(consensus_reject_updates_on_soft_memory_limit, advanced);
+TAG_FLAG(consensus_reject_updates_on_soft_memory_limit, runtime);
+
 DECLARE_int32(memory_limit_warn_threshold_percentage);
+DECLARE_int32(raft_quiesced_heartbeat_interval_ms);
 
 METRIC_DEFINE_counter(tablet, follower_memory_pressure_rejections,
                       "Follower Memory Pressure Rejections",
@@ -113,6 +162,12 @@ METRIC_DEFINE_gauge_int64(tablet, raft_term,
                           kudu::MetricUnit::kUnits,
                           "Current Term of the Raft Consensus algorithm. This number increments "
                           "each time a leader election is started.");
+METRIC_DEFINE_gauge_double(tablet, raft_leader_suspicion,
+                           "Raft Leader Suspicion Level",
+                           kudu::MetricUnit::kUnits,
+                           "Suspicion level (phi) that the leader has failed, computed from "
+                           "the intervals between its heartbeats. Only reported when "
+                           "adaptive failure detection is enabled.");
 
 namespace  {
 
@@ -156,10 +211,12 @@ scoped_refptr<RaftConsensus> RaftConsensus::Create(
     const scoped_refptr<server::Clock>& clock,
     ReplicaTransactionFactory* txn_factory,
     const shared_ptr<rpc::Messenger>& messenger,
+    const shared_ptr<HeartbeatBatcher>& heartbeat_batcher,
     const scoped_refptr<log::Log>& log,
     const shared_ptr<MemTracker>& parent_mem_tracker,
     const Callback<void(const std::string& reason)>& mark_dirty_clbk) {
-  gscoped_ptr<PeerProxyFactory> rpc_factory(new RpcPeerProxyFactory(messenger));
+  gscoped_ptr<PeerProxyFactory> rpc_factory(new RpcPeerProxyFactory(messenger,
+                                                                    heartbeat_batcher));
 
   // The message queue that keeps track of which operations need to be replicated
   // where.
@@ -190,6 +247,7 @@ scoped_refptr<RaftConsensus> RaftConsensus::Create(
                               options,
                               std::move(cmeta),
                               std::move(rpc_factory),
+                              heartbeat_batcher,
                               std::move(queue),
                               std::move(peer_manager),
                               std::move(thread_pool),
@@ -205,6 +263,7 @@ scoped_refptr<RaftConsensus> RaftConsensus::Create(
 RaftConsensus::RaftConsensus(
     const ConsensusOptions& options, gscoped_ptr<ConsensusMetadata> cmeta,
     gscoped_ptr<PeerProxyFactory> proxy_factory,
+    shared_ptr<HeartbeatBatcher> heartbeat_batcher,
     gscoped_ptr<PeerMessageQueue> queue, gscoped_ptr<PeerManager> peer_manager,
     gscoped_ptr<ThreadPool> thread_pool,
     const scoped_refptr<MetricEntity>& metric_entity,
@@ -216,15 +275,14 @@ RaftConsensus::RaftConsensus(
       log_(log),
       clock_(clock),
       peer_proxy_factory_(std::move(proxy_factory)),
+      heartbeat_batcher_(std::move(heartbeat_batcher)),
       peer_manager_(std::move(peer_manager)),
       queue_(std::move(queue)),
       rng_(GetRandomSeed32()),
       failure_monitor_(GetRandomSeed32(), GetFailureMonitorCheckMeanMs(),
                        GetFailureMonitorCheckStddevMs()),
-      failure_detector_(new TimedFailureDetector(MonoDelta::FromMilliseconds(
-          FLAGS_raft_heartbeat_interval_ms *
-          FLAGS_leader_failure_max_missed_heartbeat_periods))),
       withhold_votes_until_(MonoTime::Min()),
+      leader_quiesced_(false),
       mark_dirty_clbk_(std::move(mark_dirty_clbk)),
       shutdown_(false),
       follower_memory_pressure_rejections_(metric_entity->FindOrCreateCounter(
@@ -233,10 +291,28 @@ RaftConsensus::RaftConsensus(
                                                     cmeta->current_term())),
       parent_mem_tracker_(std::move(parent_mem_tracker)) {
   DCHECK_NOTNULL(log_.get());
+  MonoDelta failure_period = MonoDelta::FromMilliseconds(
+      FLAGS_raft_heartbeat_interval_ms * FLAGS_leader_failure_max_missed_heartbeat_periods);
+  if (FLAGS_raft_adaptive_failure_detection) {
+    phi_failure_detector_ = new PhiAccrualFailureDetector(
+        failure_period,
+        MonoDelta::FromMilliseconds(std::max(1, FLAGS_raft_heartbeat_interval_ms / 10)),
+        FLAGS_raft_failure_detector_phi_threshold);
+    failure_detector_ = phi_failure_detector_;
+    METRIC_raft_leader_suspicion.InstantiateFunctionGauge(
+      metric_entity, Bind(&RaftConsensus::GetLeaderSuspicion, Unretained(this)))
+      ->AutoDetach(&metric_detacher_);
+  } else {
+    failure_detector_ = new TimedFailureDetector(failure_period);
+  }
   state_.reset(new ReplicaState(options,
                                 peer_uuid,
                                 std::move(cmeta),
                                 DCHECK_NOTNULL(txn_factory)));
+  if (FLAGS_raft_propagate_safe_time) {
+    queue_->SetSafeTimeCallback(Bind(&ReplicaTransactionFactory::GetSafeTimeForPropagation,
+                                     Unretained(txn_factory)));
+  }
 }
 
 RaftConsensus::~RaftConsensus() {
@@ -343,6 +419,12 @@ Status RaftConsensus::EmulateElection() {
 }
 
 Status RaftConsensus::StartElection(ElectionMode mode) {
+  // An election forced on a replica, e.g. to transfer leadership to it, is
+  // expected to win and gains nothing from a pre-election.
+  return DoStartElection(mode, FLAGS_raft_enable_pre_election && mode == NORMAL_ELECTION);
+}
+
+Status RaftConsensus::DoStartElection(ElectionMode mode, bool preelection) {
   TRACE_EVENT2("consensus", "RaftConsensus::StartElection",
                "peer", peer_uuid(),
                "tablet", tablet_id());
@@ -362,18 +444,26 @@ Status RaftConsensus::StartElection(ElectionMode mode) {
                                   state_->GetActiveConfigUnlocked().ShortDebugString());
     }
 
+    const char* election_type = preelection ? "pre-election" : "leader election";
     if (state_->HasLeaderUnlocked()) {
       LOG_WITH_PREFIX_UNLOCKED(INFO)
           << "Failure of leader " << state_->GetLeaderUuidUnlocked()
-          << " detected. Triggering leader election";
+          << " detected. Triggering " << election_type;
     } else {
       LOG_WITH_PREFIX_UNLOCKED(INFO)
           << "No leader contacted us within the election timeout. "
-          << "Triggering leader election";
+          << "Triggering " << election_type;
     }
 
-    // Increment the term.
-    RETURN_NOT_OK(IncrementTermUnlocked());
+    // A pre-election asks for votes in the next term without moving to it.
+    int64_t candidate_term = state_->GetCurrentTermUnlocked() + 1;
+    if (!preelection) {
+      // Increment the term and vote for ourselves in it, persisting both with
+      // a single flush of the consensus metadata.
+      RETURN_NOT_OK(HandleTermAdvanceUnlocked(candidate_term, ReplicaState::SKIP_FLUSH_TO_DISK));
+      DCHECK_EQ(candidate_term, state_->GetCurrentTermUnlocked());
+      RETURN_NOT_OK(state_->SetVotedForCurrentTermUnlocked(state_->GetPeerUuid()));
+    }
 
     // Snooze to avoid the election timer firing again as much as possible.
     // We do not disable the election timer while running an election.
@@ -383,26 +473,28 @@ Status RaftConsensus::StartElection(ElectionMode mode) {
     RETURN_NOT_OK(SnoozeFailureDetectorUnlocked(timeout, ALLOW_LOGGING));
 
     const RaftConfigPB& active_config = state_->GetActiveConfigUnlocked();
-    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Starting election with config: "
+    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Starting " << election_type << " with config: "
                                    << active_config.ShortDebugString();
 
     // Initialize the VoteCounter.
     int num_voters = CountVoters(active_config);
     int majority_size = MajoritySize(num_voters);
     gscoped_ptr<VoteCounter> counter(new VoteCounter(num_voters, majority_size));
-    // Vote for ourselves.
+    // Vote for ourselves. The vote was persisted along with the new term
+    // above; a pre-election vote is not persisted, since the term doesn't
+    // change.
     // TODO: Consider using a separate Mutex for voting, which must sync to disk.
-    RETURN_NOT_OK(state_->SetVotedForCurrentTermUnlocked(state_->GetPeerUuid()));
     bool duplicate;
     RETURN_NOT_OK(counter->RegisterVote(state_->GetPeerUuid(), VOTE_GRANTED, &duplicate));
     CHECK(!duplicate) << state_->LogPrefixUnlocked()
                       << "Inexplicable duplicate self-vote for term "
-                      << state_->GetCurrentTermUnlocked();
+                      << candidate_term;
 
     VoteRequestPB request;
     request.set_ignore_live_leader(mode == ELECT_EVEN_IF_LEADER_IS_ALIVE);
+    request.set_is_pre_election(preelection);
     request.set_candidate_uuid(state_->GetPeerUuid());
-    request.set_candidate_term(state_->GetCurrentTermUnlocked());
+    request.set_candidate_term(candidate_term);
     request.set_tablet_id(state_->GetOptions().tablet_id);
     *request.mutable_candidate_status()->mutable_last_received() =
         state_->GetLastReceivedOpIdUnlocked();
@@ -410,6 +502,8 @@ Status RaftConsensus::StartElection(ElectionMode mode) {
     election.reset(new LeaderElection(active_config,
                                       peer_proxy_factory_.get(),
                                       request, std::move(counter), timeout,
+                                      preelection ?
+                                      Bind(&RaftConsensus::PreElectionCallback, this) :
                                       Bind(&RaftConsensus::ElectionCallback, this)));
   }
 
@@ -448,8 +542,161 @@ Status RaftConsensus::StepDown(LeaderStepDownResponsePB* resp) {
   return Status::OK();
 }
 
+Status RaftConsensus::TransferLeadership(const string& new_leader_uuid,
+                                         LeaderStepDownResponsePB* resp) {
+  TRACE_EVENT0("consensus", "RaftConsensus::TransferLeadership");
+  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(MonoDelta::FromMilliseconds(FLAGS_raft_leader_transfer_timeout_ms));
+  RaftPeerPB new_leader;
+  int64_t term;
+  {
+    ReplicaState::UniqueLock lock;
+    RETURN_NOT_OK(state_->LockForConfigChange(&lock));
+    if (state_->GetActiveRoleUnlocked() != RaftPeerPB::LEADER) {
+      resp->mutable_error()->set_code(TabletServerErrorPB::NOT_THE_LEADER);
+      StatusToPB(Status::IllegalState("Not currently leader"),
+                 resp->mutable_error()->mutable_status());
+      // We return OK so that the tablet service won't overwrite the error code.
+      return Status::OK();
+    }
+    if (new_leader_uuid == state_->GetPeerUuid()) {
+      return Status::OK();
+    }
+    const RaftConfigPB& config = state_->GetActiveConfigUnlocked();
+    if (!GetRaftConfigMember(config, new_leader_uuid, &new_leader).ok() ||
+        new_leader.member_type() != RaftPeerPB::VOTER) {
+      resp->mutable_error()->set_code(TabletServerErrorPB::INVALID_CONFIG);
+      StatusToPB(Status::InvalidArgument(
+                     Substitute("$0 is not a voter in the active config", new_leader_uuid),
+                     config.ShortDebugString()),
+                 resp->mutable_error()->mutable_status());
+      return Status::OK();
+    }
+    if (!leader_transfer_target_.empty()) {
+      return Status::ServiceUnavailable(
+          Substitute("Leadership is already being transferred to $0", leader_transfer_target_));
+    }
+    // Stop accepting writes so that the new leader can catch up.
+    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Transferring leadership to " << new_leader_uuid;
+    leader_transfer_target_ = new_leader_uuid;
+    term = state_->GetCurrentTermUnlocked();
+  }
+
+  while (true) {
+    // Push whatever the new leader is missing right away rather than waiting
+    // for the next heartbeat.
+    peer_manager_->SignalRequest(true);
+    SleepFor(MonoDelta::FromMilliseconds(1));
+
+    ReplicaState::UniqueLock lock;
+    RETURN_NOT_OK(state_->LockForConfigChange(&lock));
+    if (state_->GetActiveRoleUnlocked() != RaftPeerPB::LEADER ||
+        state_->GetCurrentTermUnlocked() != term) {
+      return Status::IllegalState("Lost leadership while transferring it");
+    }
+    if (queue_->IsPeerCaughtUp(new_leader_uuid)) {
+      RETURN_NOT_OK(BecomeReplicaUnlocked());
+      break;
+    }
+    if (MonoTime::Now(MonoTime::FINE).ComesBefore(deadline)) {
+      continue;
+    }
+    leader_transfer_target_.clear();
+    return Status::TimedOut(Substitute("Peer $0 did not catch up with the leader within $1 ms",
+                                       new_leader_uuid,
+                                       FLAGS_raft_leader_transfer_timeout_ms));
+  }
+
+  // Nobody is leader and the new leader has every operation we appended, so
+  // it wins the election it starts.
+  SendRunLeaderElection(new_leader);
+  return Status::OK();
+}
+
+namespace {
+
+// The state of an outstanding RunLeaderElection() call. Deletes itself when
+// the call completes.
+struct RunLeaderElectionCall {
+  void Done() {
+    if (!controller.status().ok()) {
+      LOG(WARNING) << "RunLeaderElection() to " << req.dest_uuid() << " failed: "
+                   << controller.status().ToString();
+    } else if (resp.has_error()) {
+      LOG(WARNING) << "RunLeaderElection() to " << req.dest_uuid() << " failed: "
+                   << StatusFromPB(resp.error().status()).ToString();
+    }
+    delete this;
+  }
+
+  gscoped_ptr<PeerProxy> proxy;
+  RunLeaderElectionRequestPB req;
+  RunLeaderElectionResponsePB resp;
+  rpc::RpcController controller;
+};
+
+} // anonymous namespace
+
+void RaftConsensus::SendRunLeaderElection(const RaftPeerPB& peer) {
+  gscoped_ptr<RunLeaderElectionCall> call(new RunLeaderElectionCall);
+  Status s = peer_proxy_factory_->NewProxy(peer, &call->proxy);
+  if (!s.ok()) {
+    LOG_WITH_PREFIX(WARNING) << "Unable to create proxy for " << peer.permanent_uuid()
+                             << ": " << s.ToString();
+    return;
+  }
+  call->req.set_dest_uuid(peer.permanent_uuid());
+  call->req.set_tablet_id(tablet_id());
+  call->controller.set_timeout(MinimumElectionTimeout());
+  RunLeaderElectionCall* c = call.release();
+  c->proxy->RunLeaderElectionAsync(&c->req, &c->resp, &c->controller,
+                                   boost::bind(&RunLeaderElectionCall::Done, c));
+}
+
+Status RaftConsensus::CheckLeaderLease() const {
+  if (FLAGS_raft_leader_lease_fraction <= 0) {
+    return Status::NotSupported("Leader leases are disabled");
+  }
+  // Voters may vote before the minimum election timeout when they suspect the
+  // leader, so the lease can't be relied on.
+  if (phi_failure_detector_) {
+    return Status::NotSupported("Leader leases are not supported with adaptive "
+                                "failure detection");
+  }
+  ReplicaState::UniqueLock lock;
+  RETURN_NOT_OK(state_->LockForRead(&lock));
+  if (state_->GetActiveRoleUnlocked() != RaftPeerPB::LEADER) {
+    return Status::IllegalState("Not currently leader");
+  }
+  // Until an op from our own term commits we may not yet have applied
+  // everything the previous leader committed.
+  if (state_->GetCommittedOpIdUnlocked().term() != state_->GetCurrentTermUnlocked()) {
+    return Status::ServiceUnavailable("Leader has not yet committed an op in its term");
+  }
+
+  // Followers withhold their votes for the minimum election timeout after
+  // accepting a request, so no other leader can be elected until at least
+  // that long after the majority-acknowledged send time.
+  MonoTime expiry = queue_->MajorityAcceptedRequestSendTime();
+  if (expiry.Equals(MonoTime::Max())) {
+    // We are the only voter.
+    return Status::OK();
+  }
+  if (!expiry.Equals(MonoTime::Min())) {
+    expiry.AddDelta(MonoDelta::FromNanoseconds(
+        MinimumElectionTimeout().ToNanoseconds() * FLAGS_raft_leader_lease_fraction));
+  }
+  if (!MonoTime::Now(MonoTime::FINE).ComesBefore(expiry)) {
+    return Status::ServiceUnavailable("Leader lease is not held");
+  }
+  return Status::OK();
+}
+
 void RaftConsensus::ReportFailureDetected(const std::string& name, const Status& msg) {
   DCHECK_EQ(name, kTimerId);
+  if (QuiescedLeaderIsAlive()) {
+    return;
+  }
   // Start an election.
   Status s = StartElection(NORMAL_ELECTION);
   if (PREDICT_FALSE(!s.ok())) {
@@ -457,6 +704,32 @@ void RaftConsensus::ReportFailureDetected(const std::string& name, const Status&
   }
 }
 
+bool RaftConsensus::QuiescedLeaderIsAlive() {
+  ReplicaState::UniqueLock lock;
+  if (!state_->LockForRead(&lock).ok() || !leader_quiesced_) {
+    return false;
+  }
+  const string& leader_uuid = state_->GetLeaderUuidUnlocked();
+  MonoTime last_heard = heartbeat_batcher_->LastHeardFrom(leader_uuid);
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  int32_t quiesced_timeout_ms = FLAGS_leader_failure_max_missed_heartbeat_periods *
+      FLAGS_raft_quiesced_heartbeat_interval_ms;
+  MonoDelta quiesced_timeout = MonoDelta::FromMilliseconds(quiesced_timeout_ms);
+  if (last_heard.Initialized() &&
+      now.GetDeltaSince(last_heard).LessThan(MinimumElectionTimeout()) &&
+      now.GetDeltaSince(last_quiesced_request_).LessThan(quiesced_timeout)) {
+    // The leader's tablet is idle, but its server is up: wait on, and keep
+    // withholding votes from candidates that may not know the leader.
+    ignore_result(SnoozeFailureDetectorUnlocked());
+    withhold_votes_until_ = now;
+    withhold_votes_until_.AddDelta(MinimumElectionTimeout());
+    return true;
+  }
+  LOG_WITH_PREFIX_UNLOCKED(INFO) << "Lost contact with quiesced leader " << leader_uuid;
+  leader_quiesced_ = false;
+  return false;
+}
+
 Status RaftConsensus::BecomeLeaderUnlocked() {
   TRACE_EVENT2("consensus", "RaftConsensus::BecomeLeaderUnlocked",
                "peer", peer_uuid(),
@@ -468,6 +741,7 @@ Status RaftConsensus::BecomeLeaderUnlocked() {
 
   // Don't vote for anyone if we're a leader.
   withhold_votes_until_ = MonoTime::Max();
+  leader_quiesced_ = false;
 
   queue_->RegisterObserver(this);
   RETURN_NOT_OK(RefreshConsensusQueueAndPeersUnlocked());
@@ -500,6 +774,8 @@ Status RaftConsensus::BecomeReplicaUnlocked() {
                                  << state_->ToStringUnlocked();
 
   state_->ClearLeaderUnlocked();
+  leader_transfer_target_.clear();
+  leader_quiesced_ = false;
 
   // FD should be running while we are a follower.
   RETURN_NOT_OK(EnsureFailureDetectorEnabledUnlocked());
@@ -524,6 +800,7 @@ Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
   {
     ReplicaState::UniqueLock lock;
     RETURN_NOT_OK(state_->LockForReplicate(&lock, *round->replicate_msg()));
+    RETURN_NOT_OK(CheckNoLeaderTransferUnlocked());
     RETURN_NOT_OK(round->CheckBoundTerm(state_->GetCurrentTermUnlocked()));
     RETURN_NOT_OK(AppendNewRoundToQueueUnlocked(round));
   }
@@ -534,13 +811,45 @@ Status RaftConsensus::Replicate(const scoped_refptr<ConsensusRound>& round) {
   return Status::OK();
 }
 
+Status RaftConsensus::ReplicateBatch(const vector<scoped_refptr<ConsensusRound> >& rounds,
+                                     int* num_replicated) {
+  *num_replicated = 0;
+  if (rounds.empty()) {
+    return Status::OK();
+  }
+
+  RETURN_NOT_OK(ExecuteHook(PRE_REPLICATE));
+
+  std::lock_guard<simple_spinlock> lock(update_lock_);
+  {
+    ReplicaState::UniqueLock lock;
+    RETURN_NOT_OK(state_->LockForReplicate(&lock, *rounds.front()->replicate_msg()));
+    RETURN_NOT_OK(CheckNoLeaderTransferUnlocked());
+    RETURN_NOT_OK(AppendNewRoundsToQueueUnlocked(rounds, num_replicated));
+  }
+
+  peer_manager_->SignalRequest();
+
+  RETURN_NOT_OK(ExecuteHook(POST_REPLICATE));
+  return Status::OK();
+}
+
 Status RaftConsensus::CheckLeadershipAndBindTerm(const scoped_refptr<ConsensusRound>& round) {
   ReplicaState::UniqueLock lock;
   RETURN_NOT_OK(state_->LockForReplicate(&lock, *round->replicate_msg()));
+  RETURN_NOT_OK(CheckNoLeaderTransferUnlocked());
   round->BindToTerm(state_->GetCurrentTermUnlocked());
   return Status::OK();
 }
 
+Status RaftConsensus::CheckNoLeaderTransferUnlocked() const {
+  if (PREDICT_FALSE(!leader_transfer_target_.empty())) {
+    return Status::ServiceUnavailable(
+        Substitute("Leadership is being transferred to $0", leader_transfer_target_));
+  }
+  return Status::OK();
+}
+
 Status RaftConsensus::AppendNewRoundToQueueUnlocked(const scoped_refptr<ConsensusRound>& round) {
   state_->NewIdUnlocked(round->replicate_msg()->mutable_id());
   RETURN_NOT_OK(state_->AddPendingOperation(round));
@@ -570,6 +879,56 @@ Status RaftConsensus::AppendNewRoundToQueueUnlocked(const scoped_refptr<Consensu
   return Status::OK();
 }
 
+Status RaftConsensus::AppendNewRoundsToQueueUnlocked(
+    const vector<scoped_refptr<ConsensusRound> >& rounds, int* num_appended) {
+  *num_appended = 0;
+
+  // Assign the ids and register the rounds as pending, up to the first one
+  // which can't be, e.g. because it was bound to an older term. That one and
+  // those after it fail with its status.
+  Status stop_status;
+  vector<ReplicateRefPtr> replicate_msgs;
+  replicate_msgs.reserve(rounds.size());
+  for (const scoped_refptr<ConsensusRound>& round : rounds) {
+    stop_status = round->CheckBoundTerm(state_->GetCurrentTermUnlocked());
+    if (PREDICT_FALSE(!stop_status.ok())) {
+      break;
+    }
+    state_->NewIdUnlocked(round->replicate_msg()->mutable_id());
+    stop_status = state_->AddPendingOperation(round);
+    if (PREDICT_FALSE(!stop_status.ok())) {
+      break;
+    }
+    replicate_msgs.push_back(round->replicate_scoped_refptr());
+  }
+  if (replicate_msgs.empty()) {
+    return stop_status;
+  }
+
+  Status s = queue_->AppendOperations(replicate_msgs,
+                                      Bind(CrashIfNotOkStatusCB,
+                                           "Enqueued replicate operations failed to write to WAL"));
+
+  // Handle Status::ServiceUnavailable(), which means the queue is full.
+  if (PREDICT_FALSE(s.IsServiceUnavailable())) {
+    // Rollback the ids in reverse order, as in AppendNewRoundToQueueUnlocked().
+    for (int i = replicate_msgs.size() - 1; i >= 0; i--) {
+      gscoped_ptr<OpId> id(replicate_msgs[i]->get()->release_id());
+      state_->CancelPendingOperation(*id);
+    }
+    LOG_WITH_PREFIX_UNLOCKED(WARNING) << ": Could not append " << replicate_msgs.size()
+                                      << " replicate requests to the queue. Queue is Full. "
+                                      << "Queue metrics: " << queue_->ToString();
+  } else if (PREDICT_FALSE(s.IsIOError())) {
+    // This likely came from the log.
+    LOG(FATAL) << "IO error appending to the queue: " << s.ToString();
+  }
+  RETURN_NOT_OK_PREPEND(s, "Unable to append operations to consensus queue");
+  state_->UpdateLastReceivedOpIdUnlocked(replicate_msgs.back()->get()->id());
+  *num_appended = replicate_msgs.size();
+  return stop_status;
+}
+
 void RaftConsensus::UpdateMajorityReplicated(const OpId& majority_replicated,
                                              OpId* committed_index) {
   ReplicaState::UniqueLock lock;
@@ -963,6 +1322,11 @@ Status RaftConsensus::CheckLeaderRequestUnlocked(const ConsensusRequestPB* reque
   }
   if (PREDICT_FALSE(!state_->HasLeaderUnlocked())) {
     SetLeaderUuidUnlocked(request->caller_uuid());
+    // The heartbeat intervals of the previous leader say nothing about this
+    // one.
+    if (phi_failure_detector_) {
+      ignore_result(phi_failure_detector_->ResetHistory(kTimerId));
+    }
   }
 
   return Status::OK();
@@ -1090,6 +1454,18 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
     withhold_votes_until_ = MonoTime::Now(MonoTime::FINE);
     withhold_votes_until_.AddDelta(MinimumElectionTimeout());
 
+    // Until its next request, a quiesced leader is known to be alive through
+    // its server instead.
+    bool quiesced = request->quiesce() && heartbeat_batcher_;
+    if (quiesced != leader_quiesced_) {
+      VLOG_WITH_PREFIX_UNLOCKED(1) << "Leader " << request->caller_uuid()
+                                   << (quiesced ? " quiesced" : " resumed heartbeats");
+      leader_quiesced_ = quiesced;
+    }
+    if (quiesced) {
+      last_quiesced_request_ = MonoTime::Now(MonoTime::FINE);
+    }
+
 
     // 1 - Early commit pending (and committed) transactions
 
@@ -1121,12 +1497,24 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
 
       // This request contains at least one message, and is likely to increase
       // our memory pressure.
+      // Unless configured otherwise, only the hard limit is enforced here:
+      // the leader already delays writes between the soft and hard limits,
+      // and rejecting their replication makes the leader retry the whole
+      // batch while the memory held by its queue doesn't shrink.
       double capacity_pct;
-      if (parent_mem_tracker_->AnySoftLimitExceeded(&capacity_pct)) {
+      bool exceeded = FLAGS_consensus_reject_updates_on_soft_memory_limit ?
+          parent_mem_tracker_->AnySoftLimitExceeded(&capacity_pct) :
+          parent_mem_tracker_->AnyLimitExceeded();
+      if (exceeded) {
+        string msg;
+        if (FLAGS_consensus_reject_updates_on_soft_memory_limit) {
+          msg = StringPrintf("Soft memory limit exceeded (at %.2f%% of capacity)",
+                             capacity_pct);
+        } else {
+          msg = "Hard memory limit exceeded";
+          capacity_pct = 100;
+        }
         follower_memory_pressure_rejections_->Increment();
-        string msg = StringPrintf(
-            "Soft memory limit exceeded (at %.2f%% of capacity)",
-            capacity_pct);
         if (capacity_pct >= FLAGS_memory_limit_warn_threshold_percentage) {
           KLOG_EVERY_N_SECS(WARNING, 1) << "Rejecting consensus request: " << msg
                                         << THROTTLE_MSG;
@@ -1227,6 +1615,17 @@ Status RaftConsensus::UpdateReplica(const ConsensusRequestPB* request,
     // watermark to the last message that remains in 'deduped_req'.
     state_->UpdateLastReceivedOpIdUnlocked(last_from_leader);
 
+    // If the leader sent its safe time and we now have its whole log, pass the
+    // safe time on. It only takes effect once everything we received is applied.
+    if (request->has_safe_timestamp()) {
+      const OpId& leader_last = request->ops_size() > 0 ?
+          request->ops(request->ops_size() - 1).id() : request->preceding_id();
+      Timestamp safe_time(request->safe_timestamp());
+      if (last_from_leader.index() >= leader_last.index() && clock_->Update(safe_time).ok()) {
+        state_->GetReplicaTransactionFactoryUnlocked()->AdvanceSafeTime(safe_time);
+      }
+    }
+
     // Fill the response with the current state. We will not mutate anymore state until
     // we actually reply to the leader, we'll just wait for the messages to be durable.
     FillConsensusResponseOKUnlocked(response);
@@ -1342,8 +1741,14 @@ Status RaftConsensus::RequestVote(const VoteRequestPB* request, VoteResponsePB*
   // See also https://ramcloud.stanford.edu/~ongaro/thesis.pdf
   // section 4.2.3.
   MonoTime now = MonoTime::Now(MonoTime::COARSE);
+  //
+  // With adaptive failure detection, we also vote early if our own detector
+  // suspects the leader, since the candidate's detector may legitimately
+  // fire before the minimum election timeout.
   if (!request->ignore_live_leader() &&
-      now.ComesBefore(withhold_votes_until_)) {
+      now.ComesBefore(withhold_votes_until_) &&
+      !(phi_failure_detector_ &&
+        GetLeaderSuspicion() > FLAGS_raft_failure_detector_phi_threshold)) {
     return RequestVoteRespondLeaderIsAlive(request, response);
   }
 
@@ -1352,6 +1757,10 @@ Status RaftConsensus::RequestVote(const VoteRequestPB* request, VoteResponsePB*
     return RequestVoteRespondInvalidTerm(request, response);
   }
 
+  if (request->is_pre_election()) {
+    return RequestPreVote(request, response);
+  }
+
   // We already voted this term.
   if (request->candidate_term() == state_->GetCurrentTermUnlocked() &&
       state_->HasVotedCurrentTermUnlocked()) {
@@ -1365,22 +1774,56 @@ Status RaftConsensus::RequestVote(const VoteRequestPB* request, VoteResponsePB*
     return RequestVoteRespondAlreadyVotedForOther(request, response);
   }
 
-  // The term advanced.
+  // The term advanced. The new term is persisted along with our vote if we
+  // grant it, or on its own otherwise.
+  bool term_advanced = false;
   if (request->candidate_term() > state_->GetCurrentTermUnlocked()) {
-    RETURN_NOT_OK_PREPEND(HandleTermAdvanceUnlocked(request->candidate_term()),
+    RETURN_NOT_OK_PREPEND(HandleTermAdvanceUnlocked(request->candidate_term(),
+                                                    ReplicaState::SKIP_FLUSH_TO_DISK),
         Substitute("Could not step down in RequestVote. Current term: $0, candidate term: $1",
                    state_->GetCurrentTermUnlocked(), request->candidate_term()));
+    term_advanced = true;
   }
 
   // Candidate must have last-logged OpId at least as large as our own to get
   // our vote.
   OpId local_last_logged_opid = GetLatestOpIdFromLog();
   if (OpIdLessThan(request->candidate_status().last_received(), local_last_logged_opid)) {
+    if (term_advanced) {
+      RETURN_NOT_OK(state_->FlushConsensusMetadataUnlocked());
+    }
     return RequestVoteRespondLastOpIdTooOld(local_last_logged_opid, request, response);
   }
 
   // Passed all our checks. Vote granted.
-  return RequestVoteRespondVoteGranted(request, response);
+  Status s = RequestVoteRespondVoteGranted(request, response);
+  if (PREDICT_FALSE(!s.ok()) && term_advanced) {
+    // Don't leave the new term unpersisted if we failed before voting.
+    RETURN_NOT_OK(state_->FlushConsensusMetadataUnlocked());
+  }
+  return s;
+}
+
+Status RaftConsensus::RequestPreVote(const VoteRequestPB* request, VoteResponsePB* response) {
+  // Would deny the vote in the candidate's term because we already voted for
+  // someone else in it.
+  if (request->candidate_term() == state_->GetCurrentTermUnlocked() &&
+      state_->HasVotedCurrentTermUnlocked() &&
+      state_->GetVotedForCurrentTermUnlocked() != request->candidate_uuid()) {
+    return RequestVoteRespondAlreadyVotedForOther(request, response);
+  }
+
+  OpId local_last_logged_opid = GetLatestOpIdFromLog();
+  if (OpIdLessThan(request->candidate_status().last_received(), local_last_logged_opid)) {
+    return RequestVoteRespondLastOpIdTooOld(local_last_logged_opid, request, response);
+  }
+
+  FillVoteResponseVoteGranted(response);
+  LOG(INFO) << Substitute("$0: Granting yes pre-election vote for candidate $1 in term $2.",
+                          GetRequestVoteLogPrefixUnlocked(),
+                          request->candidate_uuid(),
+                          request->candidate_term());
+  return Status::OK();
 }
 
 Status RaftConsensus::ChangeConfig(const ChangeConfigRequestPB& req,
@@ -1801,6 +2244,46 @@ void RaftConsensus::ElectionCallback(const ElectionResult& result) {
               state_->LogPrefixThreadSafe() + "Unable to run election callback");
 }
 
+void RaftConsensus::PreElectionCallback(const ElectionResult& result) {
+  // Like ElectionCallback(), defer to our threadpool.
+  WARN_NOT_OK(thread_pool_->SubmitClosure(Bind(&RaftConsensus::DoPreElectionCallback,
+                                               this, result)),
+              state_->LogPrefixThreadSafe() + "Unable to run pre-election callback");
+}
+
+void RaftConsensus::DoPreElectionCallback(const ElectionResult& result) {
+  {
+    ReplicaState::UniqueLock lock;
+    Status s = state_->LockForRead(&lock);
+    if (PREDICT_FALSE(!s.ok())) {
+      LOG_WITH_PREFIX(INFO) << "Received pre-election callback for term "
+                            << result.election_term << " while not running: "
+                            << s.ToString();
+      return;
+    }
+    if (result.decision == VOTE_DENIED) {
+      // Snooze so that we don't immediately retry; see DoElectionCallback().
+      ignore_result(SnoozeFailureDetectorUnlocked(LeaderElectionExpBackoffDeltaUnlocked(),
+                                                  ALLOW_LOGGING));
+      LOG_WITH_PREFIX_UNLOCKED(INFO) << "Pre-election lost for term " << result.election_term
+                                     << ". Reason: "
+                                     << (!result.message.empty() ? result.message : "None given");
+      return;
+    }
+    if (result.election_term != state_->GetCurrentTermUnlocked() + 1) {
+      LOG_WITH_PREFIX_UNLOCKED(INFO) << "Pre-election decision for defunct term "
+                                     << result.election_term << ": won";
+      return;
+    }
+    LOG_WITH_PREFIX_UNLOCKED(INFO) << "Pre-election won for term " << result.election_term;
+  }
+
+  Status s = DoStartElection(NORMAL_ELECTION, false);
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG_WITH_PREFIX(WARNING) << "Failed to start leader election: " << s.ToString();
+  }
+}
+
 void RaftConsensus::DoElectionCallback(const ElectionResult& result) {
   // Snooze to avoid the election timer firing again as much as possible.
   {
@@ -1980,6 +2463,10 @@ MonoDelta RaftConsensus::MinimumElectionTimeout() const {
   return MonoDelta::FromMilliseconds(failure_timeout);
 }
 
+double RaftConsensus::GetLeaderSuspicion() const {
+  return phi_failure_detector_->Phi(kTimerId, MonoTime::Now(MonoTime::FINE));
+}
+
 MonoDelta RaftConsensus::LeaderElectionExpBackoffDeltaUnlocked() {
   // Compute a backoff factor based on how many leader elections have
   // taken place since a leader was successfully elected.
@@ -2005,7 +2492,8 @@ Status RaftConsensus::IncrementTermUnlocked() {
   return HandleTermAdvanceUnlocked(state_->GetCurrentTermUnlocked() + 1);
 }
 
-Status RaftConsensus::HandleTermAdvanceUnlocked(ConsensusTerm new_term) {
+Status RaftConsensus::HandleTermAdvanceUnlocked(ConsensusTerm new_term,
+                                               ReplicaState::FlushToDisk flush) {
   if (new_term <= state_->GetCurrentTermUnlocked()) {
     return Status::IllegalState(Substitute("Can't advance term to: $0 current term: $1 is higher.",
                                            new_term, state_->GetCurrentTermUnlocked()));
@@ -2017,7 +2505,7 @@ Status RaftConsensus::HandleTermAdvanceUnlocked(ConsensusTerm new_term) {
   }
 
   LOG_WITH_PREFIX_UNLOCKED(INFO) << "Advancing to term " << new_term;
-  RETURN_NOT_OK(state_->SetCurrentTermUnlocked(new_term));
+  RETURN_NOT_OK(state_->SetCurrentTermUnlocked(new_term, flush));
   term_metric_->set_value(new_term);
   return Status::OK();
 }
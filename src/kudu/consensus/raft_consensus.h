@@ -31,6 +31,7 @@
 #include "kudu/consensus/consensus_queue.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/failure_detector.h"
+#include "kudu/util/metrics.h"
 
 namespace kudu {
 
@@ -52,6 +53,7 @@ class Messenger;
 
 namespace consensus {
 class ConsensusMetadata;
+class HeartbeatBatcher;
 class Peer;
 class PeerProxyFactory;
 class PeerManager;
@@ -71,6 +73,7 @@ class RaftConsensus : public Consensus,
     const scoped_refptr<server::Clock>& clock,
     ReplicaTransactionFactory* txn_factory,
     const std::shared_ptr<rpc::Messenger>& messenger,
+    const std::shared_ptr<HeartbeatBatcher>& heartbeat_batcher,
     const scoped_refptr<log::Log>& log,
     const std::shared_ptr<MemTracker>& parent_mem_tracker,
     const Callback<void(const std::string& reason)>& mark_dirty_clbk);
@@ -78,6 +81,7 @@ class RaftConsensus : public Consensus,
   RaftConsensus(const ConsensusOptions& options,
                 gscoped_ptr<ConsensusMetadata> cmeta,
                 gscoped_ptr<PeerProxyFactory> peer_proxy_factory,
+                std::shared_ptr<HeartbeatBatcher> heartbeat_batcher,
                 gscoped_ptr<PeerMessageQueue> queue,
                 gscoped_ptr<PeerManager> peer_manager,
                 gscoped_ptr<ThreadPool> thread_pool,
@@ -107,12 +111,33 @@ class RaftConsensus : public Consensus,
 
   virtual Status StepDown(LeaderStepDownResponsePB* resp) OVERRIDE;
 
+  // Hands leadership to the voter 'new_leader_uuid'. New writes are rejected
+  // while the new leader catches up; once it has received every operation
+  // appended by this leader, this replica steps down and asks it to start an
+  // election right away. Since nobody else is leader, it wins without
+  // waiting for a failure timeout. If the new leader doesn't catch up within
+  // --raft_leader_transfer_timeout_ms, writes resume and TimedOut is returned.
+  virtual Status TransferLeadership(const std::string& new_leader_uuid,
+                                    LeaderStepDownResponsePB* resp) OVERRIDE;
+
+  // The lease is extended by every request a majority of voters accepts, and
+  // lasts --raft_leader_lease_fraction of the minimum election timeout from
+  // when that request was sent. It relies on followers withholding their votes
+  // after accepting a request, so an election started with
+  // ELECT_EVEN_IF_LEADER_IS_ALIVE can break it.
+  virtual Status CheckLeaderLease() const OVERRIDE;
+
   // Call StartElection(), log a warning if the call fails (usually due to
   // being shut down).
   void ReportFailureDetected(const std::string& name, const Status& msg);
 
   virtual Status Replicate(const scoped_refptr<ConsensusRound>& round) OVERRIDE;
 
+  // Appends all of the rounds to the queue, and so to the log, as one batch,
+  // and signals the peers once for all of them.
+  virtual Status ReplicateBatch(const std::vector<scoped_refptr<ConsensusRound> >& rounds,
+                                int* num_replicated) OVERRIDE;
+
   virtual Status CheckLeadershipAndBindTerm(const scoped_refptr<ConsensusRound>& round) OVERRIDE;
 
   virtual Status Update(const ConsensusRequestPB* request,
@@ -180,6 +205,11 @@ class RaftConsensus : public Consensus,
   // Only virtual and protected for mocking purposes.
   virtual Status AppendNewRoundToQueueUnlocked(const scoped_refptr<ConsensusRound>& round);
 
+  // As a leader, append a batch of new ConsensusRounds to the queue, as a
+  // single append. See ReplicateBatch() for 'num_appended'.
+  Status AppendNewRoundsToQueueUnlocked(const std::vector<scoped_refptr<ConsensusRound> >& rounds,
+                                        int* num_appended);
+
   // As a follower, start a consensus round not associated with a Transaction.
   // Only virtual and protected for mocking purposes.
   virtual Status StartConsensusOnlyRoundUnlocked(const ReplicateRefPtr& msg);
@@ -239,6 +269,15 @@ class RaftConsensus : public Consensus,
   // The ReplicaState must be locked for configuration change before calling.
   Status BecomeReplicaUnlocked();
 
+  // Returns ServiceUnavailable if a leadership transfer is in progress.
+  //
+  // The ReplicaState must be locked before calling.
+  Status CheckNoLeaderTransferUnlocked() const;
+
+  // Asks 'peer' to start a leader election right away, without waiting for
+  // a response.
+  void SendRunLeaderElection(const RaftPeerPB& peer);
+
   // Updates the state in a replica by storing the received operations in the log
   // and triggering the required transactions. This method won't return until all
   // operations have been stored in the log and all Prepares() have been completed,
@@ -355,6 +394,20 @@ class RaftConsensus : public Consensus,
   void ElectionCallback(const ElectionResult& result);
   void DoElectionCallback(const ElectionResult& result);
 
+  // Starts a pre-election if 'preelection' is true, or else a real election
+  // which advances the term.
+  Status DoStartElection(ElectionMode mode, bool preelection);
+
+  // Callback for the pre-election driver. Like ElectionCallback, it defers to
+  // DoPreElectionCallback, which starts the real election if the
+  // pre-election was won.
+  void PreElectionCallback(const ElectionResult& result);
+  void DoPreElectionCallback(const ElectionResult& result);
+
+  // Respond to a pre-election VoteRequest. Does not modify the local term or
+  // vote.
+  Status RequestPreVote(const VoteRequestPB* request, VoteResponsePB* response);
+
   // Start tracking the leader for failures. This typically occurs at startup
   // and when the local peer steps down as leader.
   // If the failure detector is already registered, has no effect.
@@ -383,10 +436,20 @@ class RaftConsensus : public Consensus,
   Status SnoozeFailureDetectorUnlocked(const MonoDelta& additional_delta,
                                        AllowLogging allow_logging);
 
+  // If the leader quiesced, its server was heard from recently and its last
+  // quiesced heartbeat isn't overdue, snoozes the failure detector and
+  // returns true. Otherwise forgets that the leader
+  // quiesced and returns false.
+  bool QuiescedLeaderIsAlive();
+
   // Return the minimum election timeout. Due to backoff and random
   // jitter, election timeouts may be longer than this.
   MonoDelta MinimumElectionTimeout() const;
 
+  // Returns the phi-accrual suspicion level of the leader, for the
+  // raft_leader_suspicion metric.
+  double GetLeaderSuspicion() const;
+
   // Calculates an additional snooze delta for leader election.
   // The additional delta increases exponentially with the difference
   // between the current term and the term of the last committed
@@ -397,8 +460,11 @@ class RaftConsensus : public Consensus,
   // Increment the term to the next term, resetting the current leader, etc.
   Status IncrementTermUnlocked();
 
-  // Handle when the term has advanced beyond the current term.
-  Status HandleTermAdvanceUnlocked(ConsensusTerm new_term);
+  // Handle when the term has advanced beyond the current term. See
+  // ReplicaState::SetCurrentTermUnlocked() for 'flush'.
+  Status HandleTermAdvanceUnlocked(ConsensusTerm new_term,
+                                   ReplicaState::FlushToDisk flush =
+                                       ReplicaState::FLUSH_TO_DISK);
 
   // Asynchronously (on thread_pool_) notify the tablet peer that the consensus configuration
   // has changed, thus reporting it back to the master.
@@ -430,6 +496,10 @@ class RaftConsensus : public Consensus,
   scoped_refptr<server::Clock> clock_;
   gscoped_ptr<PeerProxyFactory> peer_proxy_factory_;
 
+  // Tells when the servers of quiesced leaders were last heard from. May be
+  // null, in which case the leader's quiescence is ignored.
+  const std::shared_ptr<HeartbeatBatcher> heartbeat_batcher_;
+
   gscoped_ptr<PeerManager> peer_manager_;
 
   // The queue of messages that must be sent to peers.
@@ -444,11 +514,25 @@ class RaftConsensus : public Consensus,
 
   scoped_refptr<FailureDetector> failure_detector_;
 
+  // Same as 'failure_detector_' if --raft_adaptive_failure_detection is set,
+  // otherwise null.
+  scoped_refptr<PhiAccrualFailureDetector> phi_failure_detector_;
+
   // If any RequestVote() RPC arrives before this timestamp,
   // the request will be ignored. This prevents abandoned or partitioned
   // nodes from disturbing the healthy leader.
   MonoTime withhold_votes_until_;
 
+  // The voter to which leadership is being transferred, or empty if no
+  // transfer is in progress. Protected by the ReplicaState lock.
+  std::string leader_transfer_target_;
+
+  // Whether the leader has all but stopped heartbeating this replica because
+  // the tablet is idle, and when it last did. Protected by the ReplicaState
+  // lock.
+  bool leader_quiesced_;
+  MonoTime last_quiesced_request_;
+
   const Callback<void(const std::string& reason)> mark_dirty_clbk_;
 
   // TODO hack to serialize updates due to repeated/out-of-order messages
@@ -465,6 +549,9 @@ class RaftConsensus : public Consensus,
 
   std::shared_ptr<MemTracker> parent_mem_tracker_;
 
+  // Declared last so that the function gauges are detached first.
+  FunctionGaugeDetacher metric_detacher_;
+
   DISALLOW_COPY_AND_ASSIGN(RaftConsensus);
 };
 
@@ -15,7 +15,9 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
+#include <sstream>
 
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol-test-util.h"
@@ -38,7 +40,11 @@
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/server/logical_clock.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/auto_release_pool.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
@@ -47,6 +53,20 @@
 DECLARE_int32(raft_heartbeat_interval_ms);
 DECLARE_bool(enable_leader_failure_detection);
 
+// Flags for the replication benchmarks. Disk latency is injected in the
+// syncs of the logs with --log_inject_latency and its related flags.
+DEFINE_int32(raft_bench_num_replicas, 3, "Number of replicas in the benchmarked config");
+DEFINE_int32(raft_bench_seconds, 1,
+             "How long each replication benchmark replicates for, in seconds");
+DEFINE_int32(raft_bench_ops_per_sec, 0,
+             "Rate at which the benchmarks replicate operations through the leader. "
+             "If 0, they replicate as fast as --raft_bench_max_outstanding allows");
+DEFINE_int32(raft_bench_max_outstanding, 100,
+             "Maximum number of operations the benchmarks have being replicated at "
+             "any time");
+DEFINE_int32(raft_bench_network_rtt_ms, 0,
+             "Latency injected in every request between the replicas, in milliseconds");
+
 METRIC_DECLARE_entity(tablet);
 
 #define REPLICATE_SEQUENCE_OF_MESSAGES(a, b, c, d, e, f, g) \
@@ -94,7 +114,10 @@ class RaftConsensusQuorumTest : public KuduTest {
   RaftConsensusQuorumTest()
     : clock_(server::LogicalClock::CreateStartingAt(Timestamp(0))),
       metric_entity_(METRIC_ENTITY_tablet.Instantiate(&metric_registry_, "raft-test")),
-      schema_(GetSimpleTestSchema()) {
+      schema_(GetSimpleTestSchema()),
+      bench_outstanding_(0),
+      bench_replicated_(0),
+      bench_failed_(0) {
     options_.tablet_id = kTestTablet;
     FLAGS_enable_leader_failure_detection = false;
   }
@@ -172,6 +195,7 @@ class RaftConsensusQuorumTest : public KuduTest {
           new RaftConsensus(options_,
                             std::move(cmeta),
                             gscoped_ptr<PeerProxyFactory>(proxy_factory),
+                            nullptr,
                             std::move(queue),
                             std::move(peer_manager),
                             std::move(thread_pool),
@@ -548,6 +572,171 @@ class RaftConsensusQuorumTest : public KuduTest {
     ASSERT_FALSE(cmeta->has_voted_for());
   }
 
+  // Result of a run of RunReplicationBench().
+  struct BenchResult {
+    int64_t ops_issued = 0;
+    int64_t ops_replicated = 0;
+    int64_t ops_failed = 0;
+    MonoDelta elapsed;
+  };
+
+  // Builds and starts a config of --raft_bench_num_replicas peers, with
+  // --raft_bench_network_rtt_ms of latency between them.
+  Status BuildAndStartBenchConfig() {
+    RETURN_NOT_OK(BuildConfig(FLAGS_raft_bench_num_replicas));
+    TestPeerMap all_peers = peers_->GetPeerMapCopy();
+    for (const TestPeerMap::value_type& entry : all_peers) {
+      down_cast<LocalTestPeerProxyFactory*>(entry.second->peer_proxy_factory_.get())
+          ->SetLatency(MonoDelta::FromMilliseconds(FLAGS_raft_bench_network_rtt_ms));
+    }
+    RETURN_NOT_OK(StartPeers());
+
+    bench_latency_hist_.reset(new HdrHistogram(60 * 1000 * 1000, 2));
+    scoped_refptr<RaftConsensus> leader;
+    RETURN_NOT_OK(peers_->GetPeerByIdx(FLAGS_raft_bench_num_replicas - 1, &leader));
+    return leader->EmulateElection();
+  }
+
+  // Used in RunReplicationBench() to specify whether to wait for the
+  // operations still in flight at the end of the run.
+  enum BenchDrainMode {
+    WAIT_FOR_IN_FLIGHT,
+    DONT_WAIT_FOR_IN_FLIGHT
+  };
+
+  // Replicates NO_OP operations through the peer at 'leader_idx' for
+  // 'duration', at --raft_bench_ops_per_sec and with no more than
+  // --raft_bench_max_outstanding of them in flight. The operations are
+  // committed once replicated, and the time they took to replicate is
+  // recorded in 'bench_latency_hist_'. The operations still in flight at the
+  // end aren't counted in the result unless 'drain_mode' is WAIT_FOR_IN_FLIGHT.
+  BenchResult RunReplicationBench(int leader_idx, const MonoDelta& duration,
+                                  BenchDrainMode drain_mode) {
+    scoped_refptr<RaftConsensus> leader;
+    CHECK_OK(peers_->GetPeerByIdx(leader_idx, &leader));
+    int64_t replicated_before = bench_replicated_.Load();
+    int64_t failed_before = bench_failed_.Load();
+
+    BenchResult result;
+    MonoTime start = MonoTime::Now(MonoTime::FINE);
+    MonoTime deadline = start;
+    deadline.AddDelta(duration);
+    while (true) {
+      MonoTime now = MonoTime::Now(MonoTime::FINE);
+      if (!now.ComesBefore(deadline)) {
+        break;
+      }
+      if (FLAGS_raft_bench_ops_per_sec > 0) {
+        MonoTime next = start;
+        next.AddDelta(MonoDelta::FromNanoseconds(
+            result.ops_issued * 1000000000L / FLAGS_raft_bench_ops_per_sec));
+        if (now.ComesBefore(next)) {
+          SleepFor(next.GetDeltaSince(now));
+          continue;
+        }
+      }
+      if (bench_outstanding_.Load() >= FLAGS_raft_bench_max_outstanding) {
+        SleepFor(MonoDelta::FromMicroseconds(100));
+        continue;
+      }
+
+      gscoped_ptr<ReplicateMsg> msg(new ReplicateMsg());
+      msg->set_op_type(NO_OP);
+      msg->mutable_noop_request();
+      msg->set_timestamp(clock_->Now().ToUint64());
+      scoped_refptr<ConsensusRound> round = leader->NewRound(std::move(msg),
+                                                             ConsensusReplicatedCallback());
+      round->SetConsensusReplicatedCallback(
+          Bind(&RaftConsensusQuorumTest::BenchOpReplicated, Unretained(this),
+               leader_idx, Unretained(round.get()), now));
+      bench_outstanding_.Increment();
+      result.ops_issued++;
+      Status s = leader->Replicate(round.get());
+      if (!s.ok()) {
+        // The round's callback is only called once it's been appended.
+        KLOG_EVERY_N_SECS(WARNING, 1) << "Unable to replicate: " << s.ToString() << THROTTLE_MSG;
+        bench_failed_.Increment();
+        bench_outstanding_.IncrementBy(-1);
+      }
+    }
+
+    if (drain_mode == WAIT_FOR_IN_FLIGHT) {
+      WaitForBenchOpsInFlight();
+    }
+    result.elapsed = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start);
+    result.ops_replicated = bench_replicated_.Load() - replicated_before;
+    result.ops_failed = bench_failed_.Load() - failed_before;
+    return result;
+  }
+
+  void WaitForBenchOpsInFlight() {
+    while (bench_outstanding_.Load() > 0) {
+      SleepFor(MonoDelta::FromMilliseconds(1));
+    }
+  }
+
+  // Called once a round replicated by RunReplicationBench() at 'start' is done
+  // replicating, or has been aborted.
+  void BenchOpReplicated(int leader_idx, ConsensusRound* round, MonoTime start,
+                         const Status& s) {
+    if (s.ok()) {
+      MonoDelta latency = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start);
+      bench_latency_hist_->Increment(latency.ToMicroseconds());
+      bench_replicated_.Increment();
+      CHECK_OK(CommitDummyMessage(leader_idx, round));
+    } else {
+      bench_failed_.Increment();
+    }
+    bench_outstanding_.IncrementBy(-1);
+  }
+
+  // Logs the results of a benchmark as a line of JSON.
+  void LogBenchResult(const string& name, const BenchResult& result,
+                      const MonoDelta& failover_time) {
+    std::ostringstream json;
+    JsonWriter jw(&json, JsonWriter::COMPACT);
+    jw.StartObject();
+    jw.String("benchmark");
+    jw.String(name);
+    jw.String("num_replicas");
+    jw.Int(FLAGS_raft_bench_num_replicas);
+    jw.String("target_ops_per_sec");
+    jw.Int(FLAGS_raft_bench_ops_per_sec);
+    jw.String("max_outstanding");
+    jw.Int(FLAGS_raft_bench_max_outstanding);
+    jw.String("network_rtt_ms");
+    jw.Int(FLAGS_raft_bench_network_rtt_ms);
+    jw.String("ops_issued");
+    jw.Int64(result.ops_issued);
+    jw.String("ops_replicated");
+    jw.Int64(result.ops_replicated);
+    jw.String("ops_failed");
+    jw.Int64(result.ops_failed);
+    jw.String("wall_seconds");
+    jw.Double(result.elapsed.ToSeconds());
+    jw.String("ops_per_sec");
+    jw.Double(result.ops_replicated / result.elapsed.ToSeconds());
+    if (failover_time.Initialized()) {
+      jw.String("failover_ms");
+      jw.Double(failover_time.ToSeconds() * 1000);
+    }
+    jw.String("latency_us");
+    jw.StartObject();
+    jw.String("p50");
+    jw.Uint64(bench_latency_hist_->ValueAtPercentile(50));
+    jw.String("p99");
+    jw.Uint64(bench_latency_hist_->ValueAtPercentile(99));
+    jw.String("p999");
+    jw.Uint64(bench_latency_hist_->ValueAtPercentile(99.9));
+    jw.String("max");
+    jw.Uint64(bench_latency_hist_->MaxValue());
+    jw.String("mean");
+    jw.Double(bench_latency_hist_->MeanValue());
+    jw.EndObject();
+    jw.EndObject();
+    LOG(INFO) << "JSON: " << json.str();
+  }
+
   ~RaftConsensusQuorumTest() {
     peers_->Clear();
     STLDeleteElements(&txn_factories_);
@@ -572,6 +761,12 @@ class RaftConsensusQuorumTest : public KuduTest {
   scoped_refptr<MetricEntity> metric_entity_;
   const Schema schema_;
   unordered_map<ConsensusRound*, Synchronizer*> syncs_;
+
+  // State of the replication benchmarks.
+  gscoped_ptr<HdrHistogram> bench_latency_hist_;
+  AtomicInt<int64_t> bench_outstanding_;
+  AtomicInt<int64_t> bench_replicated_;
+  AtomicInt<int64_t> bench_failed_;
 };
 
 // Tests Replicate/Commit a single message through the leader.
@@ -651,6 +846,48 @@ TEST_F(RaftConsensusQuorumTest, TestFollowersReplicateAndCommitSequence) {
   VerifyLogs(2, 0, 1);
 }
 
+// Tests that a batch of messages replicated through ReplicateBatch() gets
+// consecutive ids, and is replicated and committed like a sequence.
+TEST_F(RaftConsensusQuorumTest, TestFollowersReplicateAndCommitBatch) {
+  const int kFollower0Idx = 0;
+  const int kFollower1Idx = 1;
+  const int kLeaderIdx = 2;
+  const int kBatchSize = 10;
+
+  ASSERT_OK(BuildAndStartConfig(3));
+  scoped_refptr<RaftConsensus> leader;
+  ASSERT_OK(peers_->GetPeerByIdx(kLeaderIdx, &leader));
+
+  vector<scoped_refptr<ConsensusRound> > rounds;
+  for (int i = 0; i < kBatchSize; i++) {
+    gscoped_ptr<ReplicateMsg> msg(new ReplicateMsg());
+    msg->set_op_type(NO_OP);
+    msg->mutable_noop_request();
+    msg->set_timestamp(clock_->Now().ToUint64());
+    gscoped_ptr<Synchronizer> sync(new Synchronizer());
+    rounds.push_back(leader->NewRound(std::move(msg), sync->AsStatusCallback()));
+    InsertOrDie(&syncs_, rounds.back().get(), sync.release());
+  }
+  int num_replicated = 0;
+  ASSERT_OK(leader->ReplicateBatch(rounds, &num_replicated));
+  ASSERT_EQ(kBatchSize, num_replicated);
+
+  shared_ptr<Synchronizer> commit_sync;
+  for (int i = 0; i < kBatchSize; i++) {
+    ASSERT_OK(WaitForReplicate(rounds[i].get()));
+    if (i > 0) {
+      ASSERT_EQ(rounds[i - 1]->id().index() + 1, rounds[i]->id().index());
+    }
+    ASSERT_OK(CommitDummyMessage(kLeaderIdx, rounds[i].get(), &commit_sync));
+  }
+
+  OpId last_op_id = rounds.back()->id();
+  ASSERT_OK(commit_sync->Wait());
+  WaitForCommitIfNotAlreadyPresent(last_op_id, kFollower0Idx, kLeaderIdx);
+  WaitForCommitIfNotAlreadyPresent(last_op_id, kFollower1Idx, kLeaderIdx);
+  VerifyLogs(2, 0, 1);
+}
+
 TEST_F(RaftConsensusQuorumTest, TestConsensusContinuesIfAMinorityFallsBehind) {
   // Constants with the indexes of peers with certain roles,
   // since peers don't change roles in this test.
@@ -1118,5 +1355,124 @@ TEST_F(RaftConsensusQuorumTest, TestRequestVote) {
   LOG(INFO) << "Follower rejected old heartbeat, as expected: " << res.ShortDebugString();
 }
 
+// Test that pre-election votes follow the rules of real votes, without
+// changing the voter's term or recorded vote.
+TEST_F(RaftConsensusQuorumTest, TestRequestPreVote) {
+  ASSERT_OK(BuildAndStartConfig(3));
+
+  OpId last_op_id;
+  shared_ptr<Synchronizer> last_commit_sync;
+  vector<scoped_refptr<ConsensusRound> > rounds;
+  REPLICATE_SEQUENCE_OF_MESSAGES(10,
+                                 2, // The index of the initial leader.
+                                 WAIT_FOR_ALL_REPLICAS,
+                                 COMMIT_ONE_BY_ONE,
+                                 &last_op_id,
+                                 &rounds,
+                                 &last_commit_sync);
+  ASSERT_OK(last_commit_sync->Wait());
+  WaitForCommitIfNotAlreadyPresent(last_op_id, 0, 2);
+  WaitForCommitIfNotAlreadyPresent(last_op_id, 1, 2);
+
+  const int kPeerIndex = 1;
+  scoped_refptr<RaftConsensus> peer;
+  CHECK_OK(peers_->GetPeerByIdx(kPeerIndex, &peer));
+  gscoped_ptr<ConsensusMetadata> cmeta = ReadConsensusMetadataFromDisk(kPeerIndex);
+  const int64_t term = cmeta->current_term();
+
+  VoteRequestPB request;
+  request.set_tablet_id(kTestTablet);
+  request.set_is_pre_election(true);
+  request.set_candidate_uuid("peer-0");
+  request.set_candidate_term(term + 1);
+  request.mutable_candidate_status()->mutable_last_received()->CopyFrom(last_op_id);
+
+  // The replica has recently heard from a valid leader.
+  VoteResponsePB response;
+  ASSERT_OK(peer->RequestVote(&request, &response));
+  ASSERT_FALSE(response.vote_granted());
+  ASSERT_EQ(ConsensusErrorPB::LEADER_IS_ALIVE, response.consensus_error().code());
+
+  // Granting a pre-election vote leaves the term alone, so other candidates
+  // can be granted one too.
+  request.set_ignore_live_leader(true);
+  response.Clear();
+  ASSERT_OK(peer->RequestVote(&request, &response));
+  ASSERT_TRUE(response.vote_granted());
+  ASSERT_EQ(term, response.responder_term());
+  request.set_candidate_uuid("peer-2");
+  response.Clear();
+  ASSERT_OK(peer->RequestVote(&request, &response));
+  ASSERT_TRUE(response.vote_granted());
+  cmeta = ReadConsensusMetadataFromDisk(kPeerIndex);
+  ASSERT_EQ(term, cmeta->current_term());
+
+  // A candidate with an old log is denied.
+  request.mutable_candidate_status()->mutable_last_received()->CopyFrom(MinimumOpId());
+  response.Clear();
+  ASSERT_OK(peer->RequestVote(&request, &response));
+  ASSERT_FALSE(response.vote_granted());
+  ASSERT_EQ(ConsensusErrorPB::LAST_OPID_TOO_OLD, response.consensus_error().code());
+}
+
+// Benchmarks the replication of operations through a stable leader.
+TEST_F(RaftConsensusQuorumTest, BenchmarkReplication) {
+  OverrideFlagForSlowTests("raft_bench_seconds", "10");
+  ASSERT_OK(BuildAndStartBenchConfig());
+
+  BenchResult result = RunReplicationBench(FLAGS_raft_bench_num_replicas - 1,
+                                           MonoDelta::FromSeconds(FLAGS_raft_bench_seconds),
+                                           WAIT_FOR_IN_FLIGHT);
+  LogBenchResult("replication", result, MonoDelta());
+  ASSERT_GT(result.ops_replicated, 0);
+  ASSERT_EQ(0, result.ops_failed);
+}
+
+// Benchmarks replication across the failure of the leader: half way through,
+// the leader is shut down under load and another peer is elected in its place.
+// The time from the shutdown until the new leader replicates its first
+// operation is reported as the failover time. The operations in flight on the
+// old leader when it's shut down are aborted, and reported as failed.
+TEST_F(RaftConsensusQuorumTest, BenchmarkReplicationWithFailover) {
+  OverrideFlagForSlowTests("raft_bench_seconds", "10");
+  if (FLAGS_raft_bench_num_replicas < 3) {
+    LOG(INFO) << "Failover needs at least 3 replicas, skipping";
+    return;
+  }
+  ASSERT_OK(BuildAndStartBenchConfig());
+  const MonoDelta half = MonoDelta::FromMilliseconds(FLAGS_raft_bench_seconds * 500);
+
+  const int kOldLeaderIdx = FLAGS_raft_bench_num_replicas - 1;
+  MonoTime start = MonoTime::Now(MonoTime::FINE);
+  BenchResult before = RunReplicationBench(kOldLeaderIdx, half, DONT_WAIT_FOR_IN_FLIGHT);
+
+  scoped_refptr<RaftConsensus> old_leader;
+  ASSERT_OK(peers_->GetPeerByIdx(kOldLeaderIdx, &old_leader));
+  MonoTime failover_start = MonoTime::Now(MonoTime::FINE);
+  old_leader->Shutdown();
+  WaitForBenchOpsInFlight();
+
+  const int kNewLeaderIdx = 0;
+  scoped_refptr<RaftConsensus> new_leader;
+  ASSERT_OK(peers_->GetPeerByIdx(kNewLeaderIdx, &new_leader));
+  ASSERT_OK(new_leader->EmulateElection());
+  scoped_refptr<ConsensusRound> round;
+  ASSERT_OK(AppendDummyMessage(kNewLeaderIdx, &round));
+  ASSERT_OK(WaitForReplicate(round.get()));
+  MonoDelta failover_time = MonoTime::Now(MonoTime::FINE).GetDeltaSince(failover_start);
+
+  BenchResult after = RunReplicationBench(kNewLeaderIdx, half, WAIT_FOR_IN_FLIGHT);
+
+  // The counters cover the operations which were in flight during the failover.
+  BenchResult total;
+  total.ops_issued = before.ops_issued + after.ops_issued;
+  total.ops_replicated = bench_replicated_.Load();
+  total.ops_failed = bench_failed_.Load();
+  total.elapsed = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start);
+  LogBenchResult("replication_with_failover", total, failover_time);
+  ASSERT_GT(after.ops_replicated, 0);
+  ASSERT_EQ(0, after.ops_failed);
+}
+
 }  // namespace consensus
 }  // namespace kudu
@@ -199,9 +199,19 @@ class ReplicaState {
   // otherwise return the committed configuration.
   const RaftConfigPB& GetActiveConfigUnlocked() const;
 
+  enum FlushToDisk {
+    SKIP_FLUSH_TO_DISK,
+    FLUSH_TO_DISK,
+  };
+
   // Checks if the term change is legal. If so, sets 'current_term'
   // to 'new_term' and sets 'has voted' to no for the current term.
-  Status SetCurrentTermUnlocked(int64_t new_term) WARN_UNUSED_RESULT;
+  //
+  // With SKIP_FLUSH_TO_DISK, the new term is only persisted by the next
+  // flush of the consensus metadata, which the caller must trigger (e.g. by
+  // voting) before acting on the new term outside of the replica.
+  Status SetCurrentTermUnlocked(int64_t new_term,
+                                FlushToDisk flush = FLUSH_TO_DISK) WARN_UNUSED_RESULT;
 
   // Returns the term set in the last config change round.
   const int64_t GetCurrentTermUnlocked() const;
@@ -219,6 +229,10 @@ class ReplicaState {
   // metadata to disk.
   Status SetVotedForCurrentTermUnlocked(const std::string& uuid) WARN_UNUSED_RESULT;
 
+  // Flushes the consensus metadata to disk, e.g. to persist a term set with
+  // SKIP_FLUSH_TO_DISK.
+  Status FlushConsensusMetadataUnlocked() WARN_UNUSED_RESULT;
+
   // Return replica's vote for the current term.
   // The vote must be set; use HasVotedCurrentTermUnlocked() to check.
   const std::string& GetVotedForCurrentTermUnlocked() const;
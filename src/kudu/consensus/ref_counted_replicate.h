@@ -18,6 +18,9 @@
 #ifndef KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 #define KUDU_CONSENSUS_REF_COUNTED_REPLICATE_H_
 
+#include <glog/logging.h>
+#include <string>
+
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/gscoped_ptr.h"
@@ -28,14 +31,45 @@ namespace consensus {
 // A simple ref-counted wrapper around ReplicateMsg.
 class RefCountedReplicate : public RefCountedThreadSafe<RefCountedReplicate> {
  public:
-  explicit RefCountedReplicate(ReplicateMsg* msg) : msg_(msg) {}
+  explicit RefCountedReplicate(ReplicateMsg* msg) : msg_(msg), is_serialized_(false) {}
 
   ReplicateMsg* get() {
     return msg_.get();
   }
 
+  // Serializes the message into an internal buffer so that it can be sent to
+  // several peers without serializing it again. Does nothing if that was
+  // already done.
+  //
+  // The message must not be modified afterwards. This is not thread-safe and
+  // must be called before the message is handed to the LogCache.
+  void Serialize() {
+    if (is_serialized_) return;
+    msg_->SerializeToString(&serialized_);
+    is_serialized_ = true;
+  }
+
+  bool is_serialized() const {
+    return is_serialized_;
+  }
+
+  // The serialized message.
+  // REQUIRES: Serialize() has been called.
+  const std::string& serialized() const {
+    DCHECK(is_serialized_);
+    return serialized_;
+  }
+
+  // The memory held by the serialized copy of the message, if any.
+  int64_t serialized_space_used() const {
+    return is_serialized_ ? serialized_.capacity() : 0;
+  }
+
  private:
   gscoped_ptr<ReplicateMsg> msg_;
+
+  bool is_serialized_;
+  std::string serialized_;
 };
 
 typedef scoped_refptr<RefCountedReplicate> ReplicateRefPtr;
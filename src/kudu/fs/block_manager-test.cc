@@ -16,6 +16,7 @@
 // under the License.
 
 #include <memory>
+#include <set>
 
 #include "kudu/fs/file_block_manager.h"
 #include "kudu/fs/fs.pb.h"
@@ -50,12 +51,18 @@ DEFINE_int32(num_blocks_close, 500,
 DECLARE_uint64(log_container_preallocate_bytes);
 DECLARE_uint64(log_container_max_size);
 
+DECLARE_double(log_container_live_metadata_before_compact_ratio);
+
 DECLARE_int64(fs_data_dirs_reserved_bytes);
 DECLARE_int64(disk_reserved_bytes_free_for_testing);
 
 DECLARE_int32(log_block_manager_full_disk_cache_seconds);
+DECLARE_int32(log_block_manager_open_threads_per_dir);
+DECLARE_int32(fs_target_data_dirs_per_tablet);
 DECLARE_string(block_manager);
 
+DECLARE_bool(block_manager_invalidate_background_writes);
+
 // Generic block manager metrics.
 METRIC_DECLARE_gauge_uint64(block_manager_blocks_open_reading);
 METRIC_DECLARE_gauge_uint64(block_manager_blocks_open_writing);
@@ -405,6 +412,79 @@ TYPED_TEST(BlockManagerTest, EndToEndTest) {
               .IsNotFound());
 }
 
+// Test vectored reads of a block and batched reads across blocks.
+TYPED_TEST(BlockManagerTest, ReadBlocksTest) {
+  const string kData[] = { "first block data", "second block data" };
+  vector<BlockId> ids;
+  for (const string& data : kData) {
+    gscoped_ptr<WritableBlock> written_block;
+    ASSERT_OK(this->bm_->CreateBlock(&written_block));
+    ASSERT_OK(written_block->Append(data));
+    ASSERT_OK(written_block->Close());
+    ids.push_back(written_block->id());
+  }
+  gscoped_ptr<ReadableBlock> first;
+  gscoped_ptr<ReadableBlock> second;
+  ASSERT_OK(this->bm_->OpenBlock(ids[0], &first));
+  ASSERT_OK(this->bm_->OpenBlock(ids[1], &second));
+
+  // Read the first block into two buffers.
+  uint8_t scratch[64];
+  vector<Slice> results = { Slice(scratch, 5), Slice(scratch + 5, kData[0].size() - 5) };
+  ASSERT_OK(first->ReadV(0, &results));
+  ASSERT_EQ(kData[0], Slice(scratch, kData[0].size()));
+
+  // Reading past the end of the block fails.
+  results = { Slice(scratch, kData[0].size()), Slice(scratch + kData[0].size(), 1) };
+  ASSERT_TRUE(first->ReadV(0, &results).IsIOError());
+
+  // Batch out-of-order, partly adjacent ranges of both blocks.
+  uint8_t batch_scratch[64];
+  uint8_t* buf = batch_scratch;
+  vector<BlockReadRequest> requests;
+  requests.emplace_back(second.get(), 7, Slice(buf, kData[1].size() - 7));
+  buf += kData[1].size() - 7;
+  requests.emplace_back(first.get(), 6, Slice(buf, kData[0].size() - 6));
+  buf += kData[0].size() - 6;
+  requests.emplace_back(second.get(), 0, Slice(buf, 7));
+  buf += 7;
+  requests.emplace_back(first.get(), 0, Slice(buf, 6));
+  ASSERT_OK(this->bm_->ReadBlocks(&requests));
+  ASSERT_EQ(kData[1].substr(7), requests[0].result);
+  ASSERT_EQ(kData[0].substr(6), requests[1].result);
+  ASSERT_EQ(kData[1].substr(0, 7), requests[2].result);
+  ASSERT_EQ(kData[0].substr(0, 6), requests[3].result);
+
+  // An out-of-bounds range fails the batch.
+  requests.emplace_back(first.get(), kData[0].size(), Slice(buf, 1));
+  ASSERT_TRUE(this->bm_->ReadBlocks(&requests).IsIOError());
+}
+
+// Test that blocks whose writes or reads drop their data from the page cache
+// can still be read back.
+TYPED_TEST(BlockManagerTest, InvalidateCacheTest) {
+  FLAGS_block_manager_invalidate_background_writes = true;
+  CreateBlockOptions opts;
+  opts.background_write = true;
+  gscoped_ptr<WritableBlock> written_block;
+  ASSERT_OK(this->bm_->CreateBlock(opts, &written_block));
+  string test_data = "test data";
+  ASSERT_OK(written_block->Append(test_data));
+  ASSERT_OK(written_block->Close());
+
+  gscoped_ptr<ReadableBlock> read_block;
+  ASSERT_OK(this->bm_->OpenBlock(written_block->id(), &read_block));
+  Slice data;
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[test_data.length()]);
+  ASSERT_OK(read_block->Read(0, test_data.length(), &data, scratch.get()));
+  ASSERT_EQ(test_data, data);
+
+  ASSERT_OK(read_block->InvalidateCache(0, test_data.length()));
+  ASSERT_OK(read_block->InvalidateCache(test_data.length(), 100));
+  ASSERT_OK(read_block->Read(0, test_data.length(), &data, scratch.get()));
+  ASSERT_EQ(test_data, data);
+}
+
 // Test that we can still read from an opened block after deleting it
 // (even if we can't open it again).
 TYPED_TEST(BlockManagerTest, ReadAfterDeleteTest) {
@@ -778,6 +858,217 @@ TEST_F(LogBlockManagerTest, TestReuseBlockIds) {
                                false));
 }
 
+// Test that containers opened in parallel at startup rebuild the same block
+// map as the one they were written from.
+TEST_F(LogBlockManagerTest, TestParallelOpen) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  // Keep all of the blocks open at once so that each gets its own container.
+  const int kNumBlocks = 20;
+  vector<BlockId> block_ids;
+  {
+    ScopedWritableBlockCloser closer;
+    for (int i = 0; i < kNumBlocks; i++) {
+      gscoped_ptr<WritableBlock> writer;
+      ASSERT_OK(bm_->CreateBlock(&writer));
+      ASSERT_OK(writer->Append(Substitute("block $0", i)));
+      block_ids.push_back(writer->id());
+      closer.AddBlock(std::move(writer));
+    }
+    ASSERT_OK(closer.CloseBlocks());
+  }
+  for (int i = 0; i < kNumBlocks; i += 2) {
+    ASSERT_OK(bm_->DeleteBlock(block_ids[i]));
+  }
+
+  FLAGS_log_block_manager_open_threads_per_dir = 8;
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  ASSERT_EQ(kNumBlocks, bm_->all_containers_.size());
+  ASSERT_EQ(kNumBlocks / 2, bm_->CountBlocksForTests());
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<ReadableBlock> block;
+    Status s = bm_->OpenBlock(block_ids[i], &block);
+    if (i % 2 == 0) {
+      ASSERT_TRUE(s.IsNotFound()) << s.ToString();
+      continue;
+    }
+    ASSERT_OK(s);
+    string expected = Substitute("block $0", i);
+    Slice data;
+    uint8_t scratch[32];
+    ASSERT_OK(block->Read(0, expected.size(), &data, scratch));
+    ASSERT_EQ(expected, data);
+  }
+}
+
+// Test that the blocks of a tablet are kept in the same group of data
+// directories, across restarts too.
+TEST_F(LogBlockManagerTest, TestTabletDataDirGroups) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  vector<string> paths;
+  for (int i = 0; i < 4; i++) {
+    paths.push_back(GetTestPath(Substitute("path$0", i)));
+  }
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               paths,
+                               true));
+  FLAGS_fs_target_data_dirs_per_tablet = 2;
+
+  // Keeps 'num_blocks' blocks of 'tablet_id' open at once, so that each gets
+  // a container of its own, and returns the paths they were created in.
+  auto create_blocks = [&](const string& tablet_id, int num_blocks,
+                           std::set<string>* root_paths) {
+    CreateBlockOptions opts;
+    opts.tablet_id = tablet_id;
+    ScopedWritableBlockCloser closer;
+    for (int i = 0; i < num_blocks; i++) {
+      gscoped_ptr<WritableBlock> writer;
+      ASSERT_OK(bm_->CreateBlock(opts, &writer));
+      ASSERT_OK(writer->Append("test data"));
+      string root_path;
+      ASSERT_OK(bm_->FindBlockRootPath(writer->id(), &root_path));
+      root_paths->insert(root_path);
+      closer.AddBlock(std::move(writer));
+    }
+    ASSERT_OK(closer.CloseBlocks());
+  };
+
+  std::set<string> tablet_a_paths;
+  NO_FATALS(create_blocks("tablet-a", 8, &tablet_a_paths));
+  ASSERT_EQ(2, tablet_a_paths.size());
+
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               paths,
+                               false));
+  std::set<string> reopened_paths;
+  NO_FATALS(create_blocks("tablet-a", 8, &reopened_paths));
+  ASSERT_EQ(tablet_a_paths, reopened_paths);
+
+  // Blocks which don't belong to a tablet, or written while groups are
+  // disabled, go to every path. The first eight reuse the containers of
+  // the tablet's group.
+  std::set<string> all_paths;
+  NO_FATALS(create_blocks("", 16, &all_paths));
+  ASSERT_EQ(paths.size(), all_paths.size());
+  FLAGS_fs_target_data_dirs_per_tablet = 0;
+  all_paths.clear();
+  NO_FATALS(create_blocks("tablet-a", 24, &all_paths));
+  ASSERT_EQ(paths.size(), all_paths.size());
+}
+
+TEST_F(LogBlockManagerTest, TestMetadataCompaction) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  // Write the blocks one at a time so that they share a single container.
+  const int kNumBlocks = 10;
+  vector<BlockId> block_ids;
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append(Substitute("block $0", i)));
+    block_ids.push_back(writer->id());
+    ASSERT_OK(writer->Close());
+  }
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  string metadata_path = LogBlockManager::ContainerPathForTests(
+      bm_->all_containers_.front()) + LogBlockManager::kContainerMetadataFileSuffix;
+
+  // Keep only the first block and one in the middle of the container, so
+  // that the live blocks don't account for the container's full length.
+  for (int i = 0; i < kNumBlocks; i++) {
+    if (i != 0 && i != 5) {
+      ASSERT_OK(bm_->DeleteBlock(block_ids[i]));
+    }
+  }
+  uint64_t orig_meta_size;
+  ASSERT_OK(env_->GetFileSize(metadata_path, &orig_meta_size));
+
+  // Reopening compacts the metadata down to the two live records.
+  FLAGS_log_container_live_metadata_before_compact_ratio = 0.5;
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  uint64_t compacted_meta_size;
+  ASSERT_OK(env_->GetFileSize(metadata_path, &compacted_meta_size));
+  ASSERT_LT(compacted_meta_size, orig_meta_size);
+  ASSERT_FALSE(env_->FileExists(
+      LogBlockManager::ContainerPathForTests(bm_->all_containers_.front()) +
+      LogBlockManager::kContainerMetadataTmpFileSuffix));
+  ASSERT_EQ(2, bm_->CountBlocksForTests());
+
+  // Reopen from the compacted metadata and write more blocks than fit in
+  // the gap between the two live blocks; none of them may clobber block 5.
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  for (int i = 0; i < kNumBlocks; i++) {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append("new block"));
+    ASSERT_OK(writer->Close());
+  }
+  for (int i : { 0, 5 }) {
+    gscoped_ptr<ReadableBlock> block;
+    ASSERT_OK(bm_->OpenBlock(block_ids[i], &block));
+    string expected = Substitute("block $0", i);
+    Slice data;
+    uint8_t scratch[32];
+    ASSERT_OK(block->Read(0, expected.size(), &data, scratch));
+    ASSERT_EQ(expected, data);
+  }
+  ASSERT_EQ(kNumBlocks + 2, bm_->CountBlocksForTests());
+}
+
+TEST_F(LogBlockManagerTest, TestDeleteDeadContainers) {
+  RETURN_NOT_LOG_BLOCK_MANAGER();
+
+  // Make every container full after its first block.
+  FLAGS_log_container_max_size = 1;
+  BlockId dead_id;
+  BlockId live_id;
+  {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append("dead"));
+    dead_id = writer->id();
+    ASSERT_OK(writer->Close());
+  }
+  {
+    gscoped_ptr<WritableBlock> writer;
+    ASSERT_OK(bm_->CreateBlock(&writer));
+    ASSERT_OK(writer->Append("live"));
+    live_id = writer->id();
+    ASSERT_OK(writer->Close());
+  }
+  ASSERT_EQ(2, bm_->all_containers_.size());
+  ASSERT_OK(bm_->DeleteBlock(dead_id));
+
+  // The full container without live blocks is deleted on reopen.
+  ASSERT_OK(ReopenBlockManager(scoped_refptr<MetricEntity>(),
+                               shared_ptr<MemTracker>(),
+                               { GetTestDataDirectory() },
+                               false));
+  ASSERT_EQ(1, bm_->all_containers_.size());
+  ASSERT_EQ(1, bm_->CountBlocksForTests());
+  gscoped_ptr<ReadableBlock> block;
+  ASSERT_OK(bm_->OpenBlock(live_id, &block));
+  ASSERT_TRUE(bm_->OpenBlock(dead_id, &block).IsNotFound());
+
+  // Only the instance file and the surviving container's two files remain.
+  vector<string> children;
+  ASSERT_OK(env_->GetChildren(GetTestDataDirectory(), &children));
+  ASSERT_EQ(5, children.size());
+}
+
 // Test partial record at end of metadata file. See KUDU-1377.
 // The idea behind this test is that we should tolerate one partial record at
 // the end of a given container metadata file, since we actively append a
@@ -16,6 +16,11 @@
 // under the License.
 
 #include "kudu/fs/block_manager.h"
+
+#include <string.h>
+
+#include "kudu/gutil/callback.h"
+#include "kudu/util/async_io.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/metrics.h"
 
@@ -28,11 +33,38 @@ DEFINE_bool(block_manager_lock_dirs, true,
             "Note that read-only concurrent usage is still allowed.");
 TAG_FLAG(block_manager_lock_dirs, unsafe);
 
+DEFINE_bool(block_manager_invalidate_background_writes, false,
+            "Drop the data of blocks written by flushes and compactions from "
+            "the OS page cache once it is durable, rather than letting it "
+            "displace data being read by scans.");
+TAG_FLAG(block_manager_invalidate_background_writes, experimental);
+TAG_FLAG(block_manager_invalidate_background_writes, runtime);
+
 namespace kudu {
 namespace fs {
 
 const char* BlockManager::kInstanceMetadataFileName = "block_manager_instance";
 
+Status ReadableBlock::ReadV(uint64_t offset, std::vector<Slice>* results) const {
+  for (Slice& result : *results) {
+    Slice data;
+    RETURN_NOT_OK(Read(offset, result.size(), &data, result.mutable_data()));
+    if (data.data() != result.data()) {
+      memcpy(result.mutable_data(), data.data(), data.size());
+    }
+    offset += result.size();
+  }
+  return Status::OK();
+}
+
+void ReadableBlock::ReadAsync(uint64_t offset, size_t length,
+                              Slice* result, uint8_t* scratch,
+                              const StatusCallback& callback) const {
+  SubmitAsyncIo([=]() {
+    callback.Run(Read(offset, length, result, scratch));
+  });
+}
+
 BlockManagerOptions::BlockManagerOptions()
   : read_only(false) {
 }
@@ -29,7 +29,9 @@
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/slice.h"
 #include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
 
 DECLARE_bool(block_coalesce_close);
 
@@ -37,7 +39,6 @@ namespace kudu {
 
 class MemTracker;
 class MetricEntity;
-class Slice;
 
 namespace fs {
 
@@ -152,12 +153,76 @@ class ReadableBlock : public Block {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Reads consecutive bytes of the block beginning at 'offset' into the
+  // buffers described by 'results': each slice must point at a buffer of
+  // its size, which is filled in place. Returns an error if the block does
+  // not hold enough bytes.
+  virtual Status ReadV(uint64_t offset, std::vector<Slice>* results) const;
+
+  // Asynchronous version of Read(): the read is run on the shared
+  // asynchronous I/O pool and 'callback' is invoked with its outcome, from
+  // the thread that performed it (possibly the calling thread). The block,
+  // 'result' and 'scratch' must remain live until 'callback' has run.
+  virtual void ReadAsync(uint64_t offset, size_t length,
+                         Slice* result, uint8_t* scratch,
+                         const StatusCallback& callback) const;
+
+  // Hints that the range [offset, offset + length) of the block will be
+  // read soon. Out-of-bounds ranges are clipped to the end of the block.
+  //
+  // The default implementation does nothing.
+  virtual Status Readahead(uint64_t offset, size_t length) const {
+    return Status::OK();
+  }
+
+  // Hints that the range [offset, offset + length) of the block won't be
+  // read again soon, so that it may be dropped from the OS page cache.
+  // Out-of-bounds ranges are clipped to the end of the block.
+  //
+  // The default implementation does nothing.
+  virtual Status InvalidateCache(uint64_t offset, size_t length) const {
+    return Status::OK();
+  }
+
   // Returns the memory usage of this object including the object itself.
   virtual size_t memory_footprint() const = 0;
 };
 
+// A range of a block to read as part of BlockManager::ReadBlocks().
+struct BlockReadRequest {
+  BlockReadRequest(const ReadableBlock* block, uint64_t offset, Slice result)
+    : block(block),
+      offset(offset),
+      result(result) {
+  }
+
+  // The block to read from. Must have been opened by the block manager
+  // servicing the request.
+  const ReadableBlock* block;
+
+  // The offset within the block at which to begin reading.
+  uint64_t offset;
+
+  // The buffer to fill, whose size is the number of bytes to read.
+  Slice result;
+};
+
 // Provides options and hints for block placement.
 struct CreateBlockOptions {
+  CreateBlockOptions()
+    : background_write(false) {
+  }
+
+  // Whether the block is written by background work, such as a flush or a
+  // compaction, and is unlikely to be read back soon. If so, and
+  // --block_manager_invalidate_background_writes is set, the block's data is
+  // dropped from the OS page cache once it is durable, so that it doesn't
+  // displace data being read by scans.
+  bool background_write;
+
+  // The ID of the tablet the block belongs to, if any. The log block manager
+  // keeps all the blocks of a tablet in the same group of data directories.
+  std::string tablet_id;
 };
 
 // Block manager creation options.
@@ -232,6 +297,20 @@ class BlockManager {
   // On success, guarantees that outstanding data is durable.
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) = 0;
 
+  // Fills the buffer of every request in 'requests'. Effectively like
+  // Read() for each request, but requests whose ranges are adjacent on disk
+  // are coalesced into a single vectored read.
+  //
+  // On error, some of the buffers may have been filled.
+  virtual Status ReadBlocks(std::vector<BlockReadRequest>* requests) = 0;
+
+  // Looks up the data root path under which an existing block is stored.
+  // Used to attribute the I/O of background operations to individual disks.
+  //
+  // Returns NotFound if the block does not exist.
+  virtual Status FindBlockRootPath(const BlockId& block_id,
+                                   std::string* root_path) const = 0;
+
  protected:
   static const char* kInstanceMetadataFileName;
 };
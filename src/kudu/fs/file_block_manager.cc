@@ -17,11 +17,18 @@
 
 #include "kudu/fs/file_block_manager.h"
 
+#include <sys/resource.h>
+
+#include <algorithm>
 #include <deque>
+#include <functional>
+#include <limits>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
+#include <gflags/gflags.h>
+
 #include "kudu/fs/block_manager_metrics.h"
 #include "kudu/fs/block_manager_util.h"
 #include "kudu/fs/fs.pb.h"
@@ -29,8 +36,11 @@
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/background_io_throttle.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/file_cache.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
@@ -48,6 +58,14 @@ using strings::Substitute;
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_invalidate_background_writes);
+
+DEFINE_int32(block_manager_max_open_files, -1,
+             "Maximum number of blocks whose files the file block manager keeps "
+             "open for reading. Blocks beyond this limit have their files closed "
+             "in least-recently-used order and reopened on their next read. If "
+             "-1, 40% of the process's open file limit is used.");
+TAG_FLAG(block_manager_max_open_files, advanced);
 
 namespace kudu {
 namespace fs {
@@ -213,7 +231,7 @@ void FileBlockLocation::GetAllParentDirs(vector<string>* parent_dirs) const {
 class FileWritableBlock : public WritableBlock {
  public:
   FileWritableBlock(FileBlockManager* block_manager, FileBlockLocation location,
-                    shared_ptr<WritableFile> writer);
+                    shared_ptr<WritableFile> writer, bool background_write);
 
   virtual ~FileWritableBlock();
 
@@ -258,17 +276,22 @@ class FileWritableBlock : public WritableBlock {
   // The number of bytes successfully appended to the block.
   size_t bytes_appended_;
 
+  // See CreateBlockOptions::background_write.
+  const bool background_write_;
+
   DISALLOW_COPY_AND_ASSIGN(FileWritableBlock);
 };
 
 FileWritableBlock::FileWritableBlock(FileBlockManager* block_manager,
                                      FileBlockLocation location,
-                                     shared_ptr<WritableFile> writer)
+                                     shared_ptr<WritableFile> writer,
+                                     bool background_write)
     : block_manager_(block_manager),
       location_(std::move(location)),
       writer_(std::move(writer)),
       state_(CLEAN),
-      bytes_appended_(0) {
+      bytes_appended_(0),
+      background_write_(background_write) {
   if (block_manager_->metrics_) {
     block_manager_->metrics_->blocks_open_writing->Increment();
     block_manager_->metrics_->total_writable_blocks->Increment();
@@ -303,6 +326,7 @@ Status FileWritableBlock::Append(const Slice& data) {
   DCHECK(state_ == CLEAN || state_ == DIRTY)
       << "Invalid state: " << state_;
 
+  BackgroundIOThrottle::Throttle(data.size());
   RETURN_NOT_OK(writer_->Append(data));
   state_ = DIRTY;
   bytes_appended_ += data.size();
@@ -347,6 +371,11 @@ Status FileWritableBlock::Close(SyncMode mode) {
     }
     WARN_NOT_OK(sync, Substitute("Failed to sync when closing block $0",
                                  id().ToString()));
+    if (sync.ok() && background_write_ &&
+        FLAGS_block_manager_invalidate_background_writes) {
+      WARN_NOT_OK(writer_->InvalidateCache(0, 0),
+                  Substitute("Failed to invalidate cache of block $0", id().ToString()));
+    }
   }
   Status close = writer_->Close();
 
@@ -386,6 +415,12 @@ class FileReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE;
+
+  virtual Status Readahead(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual Status InvalidateCache(uint64_t offset, size_t length) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
  private:
@@ -448,6 +483,7 @@ Status FileReadableBlock::Read(uint64_t offset, size_t length,
                                Slice* result, uint8_t* scratch) const {
   DCHECK(!closed_.Load());
 
+  BackgroundIOThrottle::Throttle(length);
   RETURN_NOT_OK(env_util::ReadFully(reader_.get(), offset, length, result, scratch));
   if (block_manager_->metrics_) {
     block_manager_->metrics_->total_bytes_read->IncrementBy(length);
@@ -456,6 +492,38 @@ Status FileReadableBlock::Read(uint64_t offset, size_t length,
   return Status::OK();
 }
 
+Status FileReadableBlock::ReadV(uint64_t offset, vector<Slice>* results) const {
+  DCHECK(!closed_.Load());
+
+  size_t length = 0;
+  for (const Slice& result : *results) {
+    length += result.size();
+  }
+  BackgroundIOThrottle::Throttle(length);
+  RETURN_NOT_OK(reader_->ReadV(offset, results));
+  if (block_manager_->metrics_) {
+    block_manager_->metrics_->total_bytes_read->IncrementBy(length);
+  }
+
+  return Status::OK();
+}
+
+Status FileReadableBlock::Readahead(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  return reader_->Readahead(offset, length);
+}
+
+Status FileReadableBlock::InvalidateCache(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  // A zero length would extend the hint to the end of the file.
+  if (length == 0) {
+    return Status::OK();
+  }
+  return reader_->InvalidateCache(offset, length);
+}
+
 size_t FileReadableBlock::memory_footprint() const {
   DCHECK(reader_);
   return kudu_malloc_usable_size(this) + reader_->memory_footprint();
@@ -505,6 +573,17 @@ bool FileBlockManager::FindBlockPath(const BlockId& block_id,
   return metadata_file != nullptr;
 }
 
+Status FileBlockManager::FindBlockRootPath(const BlockId& block_id,
+                                           string* root_path) const {
+  PathInstanceMetadataFile* metadata_file = FindPtrOrNull(
+      root_paths_by_idx_, internal::FileBlockLocation::GetRootPathIdx(block_id));
+  if (!metadata_file) {
+    return Status::NotFound("Can't find block", block_id.ToString());
+  }
+  *root_path = metadata_file->path();
+  return Status::OK();
+}
+
 FileBlockManager::FileBlockManager(Env* env, const BlockManagerOptions& opts)
   : env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
@@ -518,6 +597,14 @@ FileBlockManager::FileBlockManager(Env* env, const BlockManagerOptions& opts)
   if (opts.metric_entity) {
     metrics_.reset(new internal::BlockManagerMetrics(opts.metric_entity));
   }
+  int max_open_files = FLAGS_block_manager_max_open_files;
+  if (max_open_files == -1) {
+    struct rlimit limit;
+    PCHECK(getrlimit(RLIMIT_NOFILE, &limit) == 0);
+    uint64_t fd_limit = std::min<uint64_t>(limit.rlim_cur, std::numeric_limits<int>::max());
+    max_open_files = std::max<int>(1, fd_limit * 2 / 5);
+  }
+  file_cache_.reset(new FileCache("fbm", env_, max_open_files, opts.metric_entity));
 }
 
 FileBlockManager::~FileBlockManager() {
@@ -703,7 +790,8 @@ Status FileBlockManager::CreateBlock(const CreateBlockOptions& opts,
       }
       dirty_dirs_.insert(DirName(path));
     }
-    block->reset(new internal::FileWritableBlock(this, location, writer));
+    block->reset(new internal::FileWritableBlock(this, location, writer,
+                                                 opts.background_write));
   }
   return s;
 }
@@ -723,7 +811,7 @@ Status FileBlockManager::OpenBlock(const BlockId& block_id,
   VLOG(1) << "Opening block with id " << block_id.ToString() << " at " << path;
 
   shared_ptr<RandomAccessFile> reader;
-  RETURN_NOT_OK(env_util::OpenFileForRandom(env_, path, &reader));
+  RETURN_NOT_OK(file_cache_->OpenExistingFile(path, &reader));
   block->reset(new internal::FileReadableBlock(this, block_id, reader));
   return Status::OK();
 }
@@ -737,6 +825,7 @@ Status FileBlockManager::DeleteBlock(const BlockId& block_id) {
         Substitute("Block $0 not found", block_id.ToString()));
   }
   RETURN_NOT_OK(env_->DeleteFile(path));
+  file_cache_->Invalidate(path);
 
   // We don't bother fsyncing the parent directory as there's nothing to be
   // gained by ensuring that the deletion is made durable. Even if we did
@@ -768,5 +857,40 @@ Status FileBlockManager::CloseBlocks(const vector<WritableBlock*>& blocks) {
   return Status::OK();
 }
 
+Status FileBlockManager::ReadBlocks(vector<BlockReadRequest>* requests) {
+  // Each block is its own file, so only ranges of the same block can be
+  // coalesced. Order the requests so that those ranges are next to each
+  // other.
+  vector<BlockReadRequest*> sorted;
+  sorted.reserve(requests->size());
+  for (BlockReadRequest& r : *requests) {
+    sorted.push_back(&r);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const BlockReadRequest* a, const BlockReadRequest* b) {
+              if (a->block != b->block) {
+                return std::less<const ReadableBlock*>()(a->block, b->block);
+              }
+              return a->offset < b->offset;
+            });
+
+  vector<Slice> run;
+  int i = 0;
+  while (i < sorted.size()) {
+    const BlockReadRequest* first = sorted[i];
+    uint64_t run_end = first->offset;
+    run.clear();
+    while (i < sorted.size() &&
+           sorted[i]->block == first->block &&
+           sorted[i]->offset == run_end) {
+      run.push_back(sorted[i]->result);
+      run_end += sorted[i]->result.size();
+      i++;
+    }
+    RETURN_NOT_OK(first->block->ReadV(first->offset, &run));
+  }
+  return Status::OK();
+}
+
 } // namespace fs
 } // namespace kudu
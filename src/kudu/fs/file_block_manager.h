@@ -33,6 +33,7 @@
 namespace kudu {
 
 class Env;
+class FileCache;
 class MemTracker;
 class MetricEntity;
 class WritableFile;
@@ -92,6 +93,11 @@ class FileBlockManager : public BlockManager {
 
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
+  virtual Status ReadBlocks(std::vector<BlockReadRequest>* requests) OVERRIDE;
+
+  virtual Status FindBlockRootPath(const BlockId& block_id,
+                                   std::string* root_path) const OVERRIDE;
+
  private:
   friend class internal::FileBlockLocation;
   friend class internal::FileReadableBlock;
@@ -146,6 +152,9 @@ class FileBlockManager : public BlockManager {
   // interesting.
   std::shared_ptr<MemTracker> mem_tracker_;
 
+  // Bounds the number of descriptors held by the blocks open for reading.
+  gscoped_ptr<FileCache> file_cache_;
+
   DISALLOW_COPY_AND_ASSIGN(FileBlockManager);
 };
 
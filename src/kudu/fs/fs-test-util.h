@@ -66,6 +66,10 @@ class CountingReadableBlock : public ReadableBlock {
     return Status::OK();
   }
 
+  virtual Status Readahead(uint64_t offset, size_t length) const OVERRIDE {
+    return block_->Readahead(offset, length);
+  }
+
   virtual size_t memory_footprint() const OVERRIDE {
     return block_->memory_footprint();
   }
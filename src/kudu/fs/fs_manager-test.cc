@@ -21,12 +21,14 @@
 
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
 using std::shared_ptr;
+using strings::Substitute;
 
 namespace kudu {
 
@@ -45,12 +47,14 @@ class FsManagerTestBase : public KuduTest {
     ReinitFsManager(GetTestPath("fs_root"), { GetTestPath("fs_root")} );
   }
 
-  void ReinitFsManager(const string& wal_path, const vector<string>& data_paths) {
+  void ReinitFsManager(const string& wal_path, const vector<string>& data_paths,
+                       const vector<string>& extra_wal_paths = {}) {
     // Blow away the old memtrackers first.
     fs_manager_.reset();
 
     FsManagerOpts opts;
     opts.wal_path = wal_path;
+    opts.extra_wal_paths = extra_wal_paths;
     opts.data_paths = data_paths;
     fs_manager_.reset(new FsManager(env_.get(), opts));
   }
@@ -175,4 +179,40 @@ TEST_F(FsManagerTestBase, TestOnlyWALPath) {
   ASSERT_TRUE(HasPrefixString(data_dirs[0], path));
 }
 
+TEST_F(FsManagerTestBase, TestMultipleWALPaths) {
+  vector<string> wal_paths = { GetTestPath("wal-a"), GetTestPath("wal-b"), GetTestPath("wal-c") };
+  vector<string> extra_wal_paths(wal_paths.begin() + 1, wal_paths.end());
+  ReinitFsManager(wal_paths[0], { GetTestPath("data") }, extra_wal_paths);
+  ASSERT_OK(fs_manager()->CreateInitialFileSystemLayout());
+  ASSERT_OK(fs_manager()->Open());
+  vector<string> wals_root_dirs = fs_manager()->GetWalsRootDirs();
+  ASSERT_EQ(3, wals_root_dirs.size());
+
+  // New tablets are spread evenly across the WAL roots, and keep their root.
+  vector<int> tablets_per_root(wals_root_dirs.size());
+  for (int i = 0; i < 6; i++) {
+    string tablet_id = Substitute("tablet-$0", i);
+    string wal_dir = fs_manager()->GetTabletWalDir(tablet_id);
+    ASSERT_EQ(wal_dir, fs_manager()->GetTabletWalDir(tablet_id));
+    ASSERT_OK(fs_manager()->CreateDirIfMissing(wal_dir));
+    for (int j = 0; j < wals_root_dirs.size(); j++) {
+      if (HasPrefixString(wal_dir, wals_root_dirs[j] + "/")) {
+        tablets_per_root[j]++;
+      }
+    }
+  }
+  ASSERT_EQ(vector<int>({ 2, 2, 2 }), tablets_per_root);
+
+  // After a restart, existing WALs are found where they were written.
+  vector<string> wal_dirs;
+  for (int i = 0; i < 6; i++) {
+    wal_dirs.push_back(fs_manager()->GetTabletWalDir(Substitute("tablet-$0", i)));
+  }
+  ReinitFsManager(wal_paths[0], { GetTestPath("data") }, extra_wal_paths);
+  ASSERT_OK(fs_manager()->Open());
+  for (int i = 5; i >= 0; i--) {
+    ASSERT_EQ(wal_dirs[i], fs_manager()->GetTabletWalDir(Substitute("tablet-$0", i)));
+  }
+}
+
 } // namespace kudu
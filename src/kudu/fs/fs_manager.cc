@@ -17,9 +17,11 @@
 
 #include "kudu/fs/fs_manager.h"
 
+#include <algorithm>
 #include <deque>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <unordered_set>
 
 #include <glog/logging.h>
@@ -41,6 +43,7 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/io_latency_env.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/net/net_util.h"
 #include "kudu/util/oid_generator.h"
@@ -65,6 +68,12 @@ DEFINE_string(fs_wal_dir, "",
               "Directory with write-ahead logs. If this is not specified, the "
               "program will not start. May be the same as fs_data_dirs");
 TAG_FLAG(fs_wal_dir, stable);
+DEFINE_string(fs_extra_wal_dirs, "",
+              "Comma-separated list of further directories with write-ahead logs. "
+              "The WALs of new tablets are spread across fs_wal_dir and these "
+              "directories, preferring the one holding the fewest of them. Each "
+              "directory should be on its own device.");
+TAG_FLAG(fs_extra_wal_dirs, experimental);
 DEFINE_string(fs_data_dirs, "",
               "Comma-separated list of directories with data blocks. If this "
               "is not specified, fs_wal_dir will be used as the sole data "
@@ -95,13 +104,17 @@ const char *FsManager::kTabletMetadataDirName = "tablet-meta";
 const char *FsManager::kDataDirName = "data";
 const char *FsManager::kCorruptedSuffix = ".corrupted";
 const char *FsManager::kInstanceMetadataFileName = "instance";
+const char *FsManager::kBlockCacheKeysFileName = "block_cache_keys";
+const char *FsManager::kCodegenCacheDirName = "codegen-cache";
 const char *FsManager::kConsensusMetadataDirName = "consensus-meta";
 
 static const char* const kTmpInfix = ".tmp";
 
 FsManagerOpts::FsManagerOpts()
-  : wal_path(FLAGS_fs_wal_dir),
+  : metric_registry(nullptr),
+    wal_path(FLAGS_fs_wal_dir),
     read_only(false) {
+  extra_wal_paths = strings::Split(FLAGS_fs_extra_wal_dirs, ",", strings::SkipEmpty());
   data_paths = strings::Split(FLAGS_fs_data_dirs, ",", strings::SkipEmpty());
 }
 
@@ -114,6 +127,7 @@ FsManager::FsManager(Env* env, const string& root_path)
     wal_fs_root_(root_path),
     data_fs_roots_({ root_path }),
     metric_entity_(nullptr),
+    metric_registry_(nullptr),
     initted_(false) {
 }
 
@@ -122,8 +136,10 @@ FsManager::FsManager(Env* env,
   : env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
     wal_fs_root_(opts.wal_path),
+    extra_wal_fs_roots_(opts.extra_wal_paths),
     data_fs_roots_(opts.data_paths),
     metric_entity_(opts.metric_entity),
+    metric_registry_(opts.metric_registry),
     parent_mem_tracker_(opts.parent_mem_tracker),
     initted_(false) {
 }
@@ -144,6 +160,9 @@ Status FsManager::Init() {
   // Deduplicate all of the roots.
   set<string> all_roots;
   all_roots.insert(wal_fs_root_);
+  for (const string& wal_fs_root : extra_wal_fs_roots_) {
+    all_roots.insert(wal_fs_root);
+  }
   for (const string& data_fs_root : data_fs_roots_) {
     all_roots.insert(data_fs_root);
   }
@@ -179,6 +198,15 @@ Status FsManager::Init() {
 
   // All done, use the map to set the canonicalized state.
   canonicalized_wal_fs_root_ = FindOrDie(canonicalized_roots, wal_fs_root_);
+  canonicalized_wal_fs_roots_.push_back(canonicalized_wal_fs_root_);
+  for (const string& wal_fs_root : extra_wal_fs_roots_) {
+    const string& canonicalized = FindOrDie(canonicalized_roots, wal_fs_root);
+    if (std::find(canonicalized_wal_fs_roots_.begin(), canonicalized_wal_fs_roots_.end(),
+                  canonicalized) == canonicalized_wal_fs_roots_.end()) {
+      canonicalized_wal_fs_roots_.push_back(canonicalized);
+    }
+  }
+  wal_root_num_tablets_.assign(canonicalized_wal_fs_roots_.size(), 0);
   if (!data_fs_roots_.empty()) {
     canonicalized_metadata_fs_root_ = FindOrDie(canonicalized_roots, data_fs_roots_[0]);
     for (const string& data_fs_root : data_fs_roots_) {
@@ -195,12 +223,29 @@ Status FsManager::Init() {
   }
 
   if (VLOG_IS_ON(1)) {
-    VLOG(1) << "WAL root: " << canonicalized_wal_fs_root_;
+    VLOG(1) << "WAL roots: " << canonicalized_wal_fs_roots_;
     VLOG(1) << "Metadata root: " << canonicalized_metadata_fs_root_;
     VLOG(1) << "Data roots: " << canonicalized_data_fs_roots_;
     VLOG(1) << "All roots: " << canonicalized_all_fs_roots_;
   }
 
+  // Time the I/O of every root before any of their files are opened.
+  if (metric_registry_) {
+    io_latency_env_.reset(new IoLatencyEnv(env_));
+    for (const string& root : canonicalized_all_fs_roots_) {
+      vector<string> roles;
+      if (std::find(canonicalized_wal_fs_roots_.begin(), canonicalized_wal_fs_roots_.end(),
+                    root) != canonicalized_wal_fs_roots_.end()) {
+        roles.emplace_back("wal");
+      }
+      if (ContainsKey(canonicalized_data_fs_roots_, root)) {
+        roles.emplace_back("data");
+      }
+      io_latency_env_->AddDirectory(root, JoinStrings(roles, ","), metric_registry_);
+    }
+    env_ = io_latency_env_.get();
+  }
+
   // With the data roots canonicalized, we can initialize the block manager.
   InitBlockManager();
 
@@ -239,6 +284,7 @@ Status FsManager::Open() {
   }
 
   RETURN_NOT_OK(block_manager_->Open());
+  RETURN_NOT_OK(LoadTabletWalRoots());
   LOG(INFO) << "Opened local filesystem: " << JoinStrings(canonicalized_all_fs_roots_, ",")
             << std::endl << metadata_->DebugString();
   return Status::OK();
@@ -288,9 +334,9 @@ Status FsManager::CreateInitialFileSystemLayout() {
   }
 
   // Initialize ancillary directories.
-  vector<string> ancillary_dirs = { GetWalsRootDir(),
-                                    GetTabletMetadataDir(),
-                                    GetConsensusMetadataDir() };
+  vector<string> ancillary_dirs = GetWalsRootDirs();
+  ancillary_dirs.push_back(GetTabletMetadataDir());
+  ancillary_dirs.push_back(GetConsensusMetadataDir());
   for (const string& dir : ancillary_dirs) {
     bool created;
     RETURN_NOT_OK_PREPEND(CreateDirIfMissing(dir, &created),
@@ -426,8 +472,72 @@ string FsManager::GetInstanceMetadataPath(const string& root) const {
   return JoinPathSegments(root, kInstanceMetadataFileName);
 }
 
+vector<string> FsManager::GetWalsRootDirs() const {
+  DCHECK(initted_);
+  vector<string> wal_dirs;
+  for (const string& wal_fs_root : canonicalized_wal_fs_roots_) {
+    wal_dirs.push_back(JoinPathSegments(wal_fs_root, kWalDirName));
+  }
+  return wal_dirs;
+}
+
+Status FsManager::LoadTabletWalRoots() {
+  if (canonicalized_wal_fs_roots_.size() == 1) {
+    return Status::OK();
+  }
+  std::lock_guard<simple_spinlock> l(wal_roots_lock_);
+  tablet_wal_roots_.clear();
+  wal_root_num_tablets_.assign(canonicalized_wal_fs_roots_.size(), 0);
+  for (int i = 0; i < static_cast<int>(canonicalized_wal_fs_roots_.size()); i++) {
+    string dir = JoinPathSegments(canonicalized_wal_fs_roots_[i], kWalDirName);
+    vector<string> children;
+    RETURN_NOT_OK_PREPEND(ListDir(dir, &children),
+                          Substitute("Couldn't list tablets in WAL directory $0", dir));
+    for (const string& name : children) {
+      if (HasPrefixString(name, ".")) {
+        continue;
+      }
+      // A leftover recovery directory pins its tablet to this root as well.
+      string child = StripSuffixString(name, kWalsRecoveryDirSuffix);
+      const int* existing = FindOrNull(tablet_wal_roots_, child);
+      if (existing == nullptr) {
+        InsertOrDie(&tablet_wal_roots_, child, i);
+        wal_root_num_tablets_[i]++;
+      } else if (*existing != i) {
+        return Status::Corruption(Substitute(
+            "Tablet $0 has WAL directories under both $1 and $2", child,
+            canonicalized_wal_fs_roots_[*existing], canonicalized_wal_fs_roots_[i]));
+      }
+    }
+  }
+  return Status::OK();
+}
+
+int FsManager::GetTabletWalRootIndex(const string& tablet_id) const {
+  DCHECK(initted_);
+  if (canonicalized_wal_fs_roots_.size() == 1) {
+    return 0;
+  }
+  std::lock_guard<simple_spinlock> l(wal_roots_lock_);
+  const int* idx = FindOrNull(tablet_wal_roots_, tablet_id);
+  if (idx != nullptr) {
+    return *idx;
+  }
+  int least_loaded = std::min_element(wal_root_num_tablets_.begin(),
+                                      wal_root_num_tablets_.end()) -
+                     wal_root_num_tablets_.begin();
+  InsertOrDie(&tablet_wal_roots_, tablet_id, least_loaded);
+  wal_root_num_tablets_[least_loaded]++;
+  return least_loaded;
+}
+
+string FsManager::GetTabletWalDir(const string& tablet_id) const {
+  const string& wal_fs_root = canonicalized_wal_fs_roots_[GetTabletWalRootIndex(tablet_id)];
+  return JoinPathSegments(JoinPathSegments(wal_fs_root, kWalDirName), tablet_id);
+}
+
 string FsManager::GetTabletWalRecoveryDir(const string& tablet_id) const {
-  string path = JoinPathSegments(GetWalsRootDir(), tablet_id);
+  string path = GetTabletWalDir(tablet_id);
   StrAppend(&path, kWalsRecoveryDirSuffix);
   return path;
 }
@@ -489,6 +599,13 @@ Status FsManager::CreateNewBlock(gscoped_ptr<WritableBlock>* block) {
   return block_manager_->CreateBlock(block);
 }
 
+Status FsManager::CreateNewBlock(const CreateBlockOptions& opts,
+                                 gscoped_ptr<WritableBlock>* block) {
+  CHECK(!read_only_);
+
+  return block_manager_->CreateBlock(opts, block);
+}
+
 Status FsManager::OpenBlock(const BlockId& block_id, gscoped_ptr<ReadableBlock>* block) {
   return block_manager_->OpenBlock(block_id, block);
 }
@@ -23,11 +23,13 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/util/env.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/path_util.h"
 
 DECLARE_bool(enable_data_block_fsync);
@@ -40,11 +42,14 @@ class Message;
 
 namespace kudu {
 
+class IoLatencyEnv;
 class MemTracker;
 class MetricEntity;
+class MetricRegistry;
 
 namespace fs {
 class BlockManager;
+struct CreateBlockOptions;
 class ReadableBlock;
 class WritableBlock;
 } // namespace fs
@@ -66,6 +71,13 @@ struct FsManagerOpts {
   // Defaults to NULL.
   scoped_refptr<MetricEntity> metric_entity;
 
+  // The registry under which the I/O latency metrics of each WAL and data
+  // directory are created (see IoLatencyEnv). If NULL, I/O latencies will not
+  // be tracked.
+  //
+  // Defaults to NULL.
+  MetricRegistry* metric_registry;
+
   // The memory tracker under which all new memory trackers will be parented.
   // If NULL, new memory trackers will be parented to the root tracker.
   std::shared_ptr<MemTracker> parent_mem_tracker;
@@ -73,6 +85,10 @@ struct FsManagerOpts {
   // The path where WALs will be stored. Cannot be empty.
   std::string wal_path;
 
+  // Further paths where WALs will be stored. Each tablet's WAL lives in
+  // exactly one of 'wal_path' and these paths.
+  std::vector<std::string> extra_wal_paths;
+
   // The paths where data blocks will be stored. Cannot be empty.
   std::vector<std::string> data_paths;
 
@@ -127,6 +143,10 @@ class FsManager {
   // Block will be synced on close.
   Status CreateNewBlock(gscoped_ptr<fs::WritableBlock>* block);
 
+  // Like the above, but creates the block with the given options.
+  Status CreateNewBlock(const fs::CreateBlockOptions& opts,
+                        gscoped_ptr<fs::WritableBlock>* block);
+
   Status OpenBlock(const BlockId& block_id,
                    gscoped_ptr<fs::ReadableBlock>* block);
 
@@ -139,14 +159,20 @@ class FsManager {
   // ==========================================================================
   std::vector<std::string> GetDataRootDirs() const;
 
+  // Returns the WAL directory under the first WAL root.
   std::string GetWalsRootDir() const {
     DCHECK(initted_);
     return JoinPathSegments(canonicalized_wal_fs_root_, kWalDirName);
   }
 
-  std::string GetTabletWalDir(const std::string& tablet_id) const {
-    return JoinPathSegments(GetWalsRootDir(), tablet_id);
-  }
+  // Returns the WAL directories under all WAL roots; the first is
+  // GetWalsRootDir().
+  std::vector<std::string> GetWalsRootDirs() const;
+
+  // Returns the directory holding the WAL of 'tablet_id'. A tablet without
+  // a WAL yet is assigned to the WAL root with the fewest tablets; the
+  // assignment holds for as long as this FsManager lives.
+  std::string GetTabletWalDir(const std::string& tablet_id) const;
 
   std::string GetTabletWalRecoveryDir(const std::string& tablet_id) const;
 
@@ -165,6 +191,20 @@ class FsManager {
   // Return the path where InstanceMetadataPB is stored.
   std::string GetInstanceMetadataPath(const std::string& root) const;
 
+  // Return the path where the keys of the block cache are periodically
+  // recorded, so that it can be warmed after a restart.
+  std::string GetBlockCacheKeysPath() const {
+    DCHECK(initted_);
+    return JoinPathSegments(canonicalized_metadata_fs_root_, kBlockCacheKeysFileName);
+  }
+
+  // Return the directory where the object code compiled by codegen is kept
+  // across restarts.
+  std::string GetCodegenCacheDir() const {
+    DCHECK(initted_);
+    return JoinPathSegments(canonicalized_metadata_fs_root_, kCodegenCacheDirName);
+  }
+
   // Return the directory where the consensus metadata is stored.
   std::string GetConsensusMetadataDir() const {
     DCHECK(initted_);
@@ -219,6 +259,14 @@ class FsManager {
   Status WriteInstanceMetadata(const InstanceMetadataPB& metadata,
                                const std::string& root);
 
+  // Assigns the tablets whose WAL directories already exist to the WAL
+  // roots holding them.
+  Status LoadTabletWalRoots();
+
+  // Returns the index in 'canonicalized_wal_fs_roots_' of the WAL root
+  // holding the WAL of 'tablet_id', assigning one if necessary.
+  int GetTabletWalRootIndex(const std::string& tablet_id) const;
+
   // Checks if 'path' is an empty directory.
   //
   // Returns an error if it's not a directory. Otherwise, sets 'is_empty'
@@ -241,19 +289,28 @@ class FsManager {
   static const char *kInstanceMetadataMagicNumber;
   static const char *kTabletSuperBlockMagicNumber;
   static const char *kConsensusMetadataDirName;
+  static const char *kBlockCacheKeysFileName;
+  static const char *kCodegenCacheDirName;
 
   Env *env_;
 
+  // Wraps the Env passed in once Init() has found the roots, if the I/O
+  // latencies are tracked. 'env_' then points to it.
+  gscoped_ptr<IoLatencyEnv> io_latency_env_;
+
   // If false, operations that mutate on-disk state are prohibited.
   const bool read_only_;
 
   // These roots are the constructor input verbatim. None of them are used
   // as-is; they are first canonicalized during Init().
   const std::string wal_fs_root_;
+  const std::vector<std::string> extra_wal_fs_roots_;
   const std::vector<std::string> data_fs_roots_;
 
   scoped_refptr<MetricEntity> metric_entity_;
 
+  MetricRegistry* metric_registry_;
+
   std::shared_ptr<MemTracker> parent_mem_tracker_;
 
   // Canonicalized forms of 'wal_fs_root_ and 'data_fs_roots_'. Constructed
@@ -262,6 +319,7 @@ class FsManager {
   // - The first data root is used as the metadata root.
   // - Common roots in the collections have been deduplicated.
   std::string canonicalized_wal_fs_root_;
+  std::vector<std::string> canonicalized_wal_fs_roots_;
   std::string canonicalized_metadata_fs_root_;
   std::set<std::string> canonicalized_data_fs_roots_;
   std::set<std::string> canonicalized_all_fs_roots_;
@@ -270,6 +328,15 @@ class FsManager {
 
   gscoped_ptr<fs::BlockManager> block_manager_;
 
+  // Protects 'tablet_wal_roots_' and 'wal_root_num_tablets_'.
+  mutable simple_spinlock wal_roots_lock_;
+
+  // The index of the WAL root of each tablet assigned one so far.
+  mutable std::unordered_map<std::string, int> tablet_wal_roots_;
+
+  // The number of tablets assigned to each WAL root.
+  mutable std::vector<int> wal_root_num_tablets_;
+
   bool initted_;
 
   DISALLOW_COPY_AND_ASSIGN(FsManager);
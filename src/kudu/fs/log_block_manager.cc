@@ -18,21 +18,26 @@
 #include "kudu/fs/log_block_manager.h"
 
 #include <algorithm>
+#include <functional>
 #include <mutex>
 
 #include "kudu/fs/block_manager_metrics.h"
 #include "kudu/fs/block_manager_util.h"
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/strip.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/alignment.h"
 #include "kudu/util/atomic.h"
+#include "kudu/util/background_io_throttle.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/hash_util.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/malloc.h"
 #include "kudu/util/metrics.h"
@@ -47,6 +52,7 @@
 
 DECLARE_bool(enable_data_block_fsync);
 DECLARE_bool(block_manager_lock_dirs);
+DECLARE_bool(block_manager_invalidate_background_writes);
 
 // TODO: How should this be configured? Should provide some guidance.
 DEFINE_uint64(log_container_max_size, 10LU * 1024 * 1024 * 1024,
@@ -63,6 +69,22 @@ DEFINE_bool(log_block_manager_test_hole_punching, true,
 TAG_FLAG(log_block_manager_test_hole_punching, advanced);
 TAG_FLAG(log_block_manager_test_hole_punching, unsafe);
 
+DEFINE_int32(log_block_manager_open_threads_per_dir, 4,
+             "Number of threads per data directory used to open that "
+             "directory's log block containers at startup.");
+TAG_FLAG(log_block_manager_open_threads_per_dir, advanced);
+
+DEFINE_double(log_container_live_metadata_before_compact_ratio, 0.50,
+              "Desired ratio of live block metadata in log containers. If a "
+              "container's live to total block ratio dips below this value, "
+              "the container's metadata file will be compacted at startup.");
+TAG_FLAG(log_container_live_metadata_before_compact_ratio, experimental);
+
+DEFINE_bool(log_block_manager_delete_dead_containers, true,
+            "Whether to delete full containers that have no live blocks "
+            "when opening the block manager.");
+TAG_FLAG(log_block_manager_delete_dead_containers, advanced);
+
 DEFINE_int32(log_block_manager_full_disk_cache_seconds, 30,
              "Number of seconds we cache the full-disk status in the block manager. "
              "During this time, writes to the corresponding root path will not be attempted.");
@@ -76,6 +98,17 @@ DEFINE_int64(fs_data_dirs_reserved_bytes, 0,
 TAG_FLAG(fs_data_dirs_reserved_bytes, runtime);
 TAG_FLAG(fs_data_dirs_reserved_bytes, evolving);
 
+DEFINE_int32(fs_target_data_dirs_per_tablet, 3,
+             "Number of data directories a tablet's data blocks are written to. "
+             "Keeping each tablet on a subset of the directories improves the "
+             "locality of its scans and limits the number of tablets damaged by "
+             "the loss of one disk. Once all of a tablet's directories are full, "
+             "its blocks go to the others. If 0, or at least the number of data "
+             "directories, the blocks of every tablet are spread over all of them. "
+             "Only works with the log block manager.");
+TAG_FLAG(fs_target_data_dirs_per_tablet, advanced);
+TAG_FLAG(fs_target_data_dirs_per_tablet, evolving);
+
 METRIC_DEFINE_gauge_uint64(server, log_block_manager_bytes_under_management,
                            "Bytes Under Management",
                            kudu::MetricUnit::kBytes,
@@ -209,6 +242,15 @@ class LogBlockContainer {
   Status ReadData(int64_t offset, size_t length,
                   Slice* result, uint8_t* scratch) const;
 
+  // See RWFile::ReadV().
+  Status ReadDataV(int64_t offset, vector<Slice>* results) const;
+
+  // See RWFile::Readahead().
+  Status ReadaheadData(int64_t offset, size_t length) const;
+
+  // See RWFile::InvalidateCache().
+  Status InvalidateDataCache(int64_t offset, size_t length) const;
+
   // Appends 'pb' to this container's metadata file.
   //
   // The on-disk effects of this call are made durable only after SyncMetadata().
@@ -260,6 +302,26 @@ class LogBlockContainer {
   // This function is thread unsafe.
   void UpdateBytesWritten(int64_t more_bytes);
 
+  // Ensures that 'total_bytes_written_' covers the block found at 'offset'
+  // with 'length' bytes, rounded up to the nearest filesystem block. Used
+  // while rebuilding the container from its records; unlike summing block
+  // lengths, this remains correct once dead records have been compacted away.
+  //
+  // This function is thread unsafe.
+  void UpdateBytesWrittenForRecord(int64_t offset, int64_t length);
+
+  // Atomically replaces the container's metadata file with one holding only
+  // 'records', which should be the CREATE records of the container's live
+  // blocks. The new file is written to a temporary path and renamed over the
+  // existing one; the metadata writer is then reopened against it.
+  //
+  // Must not be called while the container is in use by other threads.
+  Status CompactMetadata(const vector<BlockRecordPB>& records);
+
+  // Deletes the container's metadata and data files. The container must
+  // have no live blocks and must not be used afterwards.
+  Status DeleteFiles();
+
   // Run a task on this container's root path thread pool.
   //
   // Normally the task is performed asynchronously. However, if submission to
@@ -573,6 +635,24 @@ Status LogBlockContainer::ReadData(int64_t offset, size_t length,
   return data_file_->Read(offset, length, result, scratch);
 }
 
+Status LogBlockContainer::ReadDataV(int64_t offset, vector<Slice>* results) const {
+  DCHECK_GE(offset, 0);
+
+  return data_file_->ReadV(offset, results);
+}
+
+Status LogBlockContainer::InvalidateDataCache(int64_t offset, size_t length) const {
+  DCHECK_GE(offset, 0);
+
+  return data_file_->InvalidateCache(offset, length);
+}
+
+Status LogBlockContainer::ReadaheadData(int64_t offset, size_t length) const {
+  DCHECK_GE(offset, 0);
+
+  return data_file_->Readahead(offset, length);
+}
+
 Status LogBlockContainer::AppendMetadata(const BlockRecordPB& pb) {
   // Note: We don't check for sufficient disk space for metadata writes in
   // order to allow for block deletion on full disks.
@@ -631,6 +711,68 @@ void LogBlockContainer::UpdateBytesWritten(int64_t more_bytes) {
   }
 }
 
+void LogBlockContainer::UpdateBytesWrittenForRecord(int64_t offset, int64_t length) {
+  DCHECK_GE(offset, 0);
+  DCHECK_GE(length, 0);
+  total_bytes_written_ = std::max(
+      total_bytes_written_,
+      static_cast<int64_t>(KUDU_ALIGN_UP(offset + length,
+                                         instance()->filesystem_block_size_bytes())));
+}
+
+Status LogBlockContainer::CompactMetadata(const vector<BlockRecordPB>& records) {
+  string metadata_path = MetadataFilePath();
+  string tmp_path = StrCat(path_, LogBlockManager::kContainerMetadataTmpFileSuffix);
+
+  // Write the live records out to a temporary file.
+  {
+    gscoped_ptr<RWFile> tmp_file;
+    RETURN_NOT_OK(block_manager_->env()->NewRWFile(tmp_path, &tmp_file));
+    ScopedFileDeleter tmp_deleter(block_manager_->env(), tmp_path);
+    WritablePBContainerFile pb_writer(std::move(tmp_file));
+    RETURN_NOT_OK(pb_writer.Init(BlockRecordPB()));
+    for (const BlockRecordPB& r : records) {
+      RETURN_NOT_OK(pb_writer.Append(r));
+    }
+    RETURN_NOT_OK(pb_writer.Sync());
+    RETURN_NOT_OK(pb_writer.Close());
+
+    // Swap it in. Once renamed, there's nothing left for the deleter to do.
+    RETURN_NOT_OK(block_manager_->env()->RenameFile(tmp_path, metadata_path));
+    tmp_deleter.Cancel();
+  }
+  if (FLAGS_enable_data_block_fsync) {
+    RETURN_NOT_OK(block_manager_->env()->SyncDir(dir()));
+  }
+
+  // The existing writer still refers to the old (now unlinked) file.
+  gscoped_ptr<RWFile> metadata_file;
+  RWFileOptions opts;
+  opts.mode = Env::OPEN_EXISTING;
+  RETURN_NOT_OK(block_manager_->env()->NewRWFile(opts, metadata_path, &metadata_file));
+  gscoped_ptr<WritablePBContainerFile> metadata_pb_writer(
+      new WritablePBContainerFile(std::move(metadata_file)));
+  RETURN_NOT_OK(metadata_pb_writer->Reopen());
+
+  std::lock_guard<Mutex> l(metadata_pb_writer_lock_);
+  WARN_NOT_OK(metadata_pb_writer_->Close(),
+              Substitute("Could not close old metadata file of container $0", ToString()));
+  metadata_pb_writer_.swap(metadata_pb_writer);
+  return Status::OK();
+}
+
+Status LogBlockContainer::DeleteFiles() {
+  // Delete the metadata file first: a data file without metadata is merely
+  // leaked (and cleaned up by the next open), whereas metadata without its
+  // data file would prevent the block manager from opening.
+  RETURN_NOT_OK(block_manager_->env()->DeleteFile(MetadataFilePath()));
+  RETURN_NOT_OK(block_manager_->env()->DeleteFile(DataFilePath()));
+  if (FLAGS_enable_data_block_fsync) {
+    RETURN_NOT_OK(block_manager_->env()->SyncDir(dir()));
+  }
+  return Status::OK();
+}
+
 void LogBlockContainer::ExecClosure(const Closure& task) {
   ThreadPool* pool = FindOrDie(block_manager()->thread_pools_by_root_path_,
                                dir());
@@ -743,7 +885,7 @@ class LogWritableBlock : public WritableBlock {
   };
 
   LogWritableBlock(LogBlockContainer* container, BlockId block_id,
-                   int64_t block_offset);
+                   int64_t block_offset, bool background_write);
 
   virtual ~LogWritableBlock();
 
@@ -804,6 +946,9 @@ class LogWritableBlock : public WritableBlock {
   // The block's length. Changes with each Append().
   int64_t block_length_;
 
+  // See CreateBlockOptions::background_write.
+  const bool background_write_;
+
   // The state of the block describing where it is in the write lifecycle,
   // for example, has it been synchronized to disk?
   WritableBlock::State state_;
@@ -812,11 +957,13 @@ class LogWritableBlock : public WritableBlock {
 };
 
 LogWritableBlock::LogWritableBlock(LogBlockContainer* container,
-                                   BlockId block_id, int64_t block_offset)
+                                   BlockId block_id, int64_t block_offset,
+                                   bool background_write)
     : container_(container),
       block_id_(std::move(block_id)),
       block_offset_(block_offset),
       block_length_(0),
+      background_write_(background_write),
       state_(CLEAN) {
   DCHECK_GE(block_offset, 0);
   DCHECK_EQ(0, block_offset % container->instance()->filesystem_block_size_bytes());
@@ -860,6 +1007,7 @@ Status LogWritableBlock::Append(const Slice& data) {
   // The metadata change is deferred to Close() or FlushDataAsync(),
   // whichever comes first. We can't do it now because the block's
   // length is still in flux.
+  BackgroundIOThrottle::Throttle(data.size());
   RETURN_NOT_OK(container_->WriteData(block_offset_ + block_length_, data));
 
   block_length_ += data.size();
@@ -927,6 +1075,12 @@ Status LogWritableBlock::DoClose(SyncMode mode) {
       s = container_->SyncMetadata();
       RETURN_NOT_OK(s);
 
+      if (background_write_ && FLAGS_block_manager_invalidate_background_writes &&
+          block_length_ > 0) {
+        WARN_NOT_OK(container_->InvalidateDataCache(block_offset_, block_length_),
+                    Substitute("Failed to invalidate cache of block $0", id().ToString()));
+      }
+
       if (container_->metrics()) {
         container_->metrics()->generic_metrics.blocks_open_writing->Decrement();
         container_->metrics()->generic_metrics.total_bytes_written->IncrementBy(
@@ -971,8 +1125,21 @@ class LogReadableBlock : public ReadableBlock {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const OVERRIDE;
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE;
+
+  virtual Status Readahead(uint64_t offset, size_t length) const OVERRIDE;
+
+  virtual Status InvalidateCache(uint64_t offset, size_t length) const OVERRIDE;
+
   virtual size_t memory_footprint() const OVERRIDE;
 
+  // Returns an error if [offset, offset + length) does not lie within the
+  // block. Otherwise, sets 'data_offset' to the beginning of the range
+  // within the container's data file.
+  Status GetDataOffset(uint64_t offset, size_t length, uint64_t* data_offset) const;
+
+  LogBlockContainer* container() const { return container_; }
+
  private:
   // The owning container. Must outlive this block.
   LogBlockContainer* container_;
@@ -1029,16 +1196,10 @@ Status LogReadableBlock::Read(uint64_t offset, size_t length,
                               Slice* result, uint8_t* scratch) const {
   DCHECK(!closed_.Load());
 
-  uint64_t read_offset = log_block_->offset() + offset;
-  if (log_block_->length() < offset + length) {
-    return Status::IOError("Out-of-bounds read",
-                           Substitute("read of [$0-$1) in block [$2-$3)",
-                                      read_offset,
-                                      read_offset + length,
-                                      log_block_->offset(),
-                                      log_block_->offset() + log_block_->length()));
-  }
+  uint64_t read_offset;
+  RETURN_NOT_OK(GetDataOffset(offset, length, &read_offset));
 
+  BackgroundIOThrottle::Throttle(length);
   MicrosecondsInt64 start_time = GetMonoTimeMicros();
   RETURN_NOT_OK(container_->ReadData(read_offset, length, result, scratch));
   MicrosecondsInt64 end_time = GetMonoTimeMicros();
@@ -1064,6 +1225,63 @@ Status LogReadableBlock::Read(uint64_t offset, size_t length,
   return Status::OK();
 }
 
+Status LogReadableBlock::ReadV(uint64_t offset, vector<Slice>* results) const {
+  DCHECK(!closed_.Load());
+
+  size_t length = 0;
+  for (const Slice& result : *results) {
+    length += result.size();
+  }
+  uint64_t read_offset;
+  RETURN_NOT_OK(GetDataOffset(offset, length, &read_offset));
+  BackgroundIOThrottle::Throttle(length);
+  RETURN_NOT_OK(container_->ReadDataV(read_offset, results));
+
+  if (container_->metrics()) {
+    container_->metrics()->generic_metrics.total_bytes_read->IncrementBy(length);
+  }
+  return Status::OK();
+}
+
+Status LogReadableBlock::GetDataOffset(uint64_t offset, size_t length,
+                                       uint64_t* data_offset) const {
+  uint64_t read_offset = log_block_->offset() + offset;
+  if (log_block_->length() < offset + length) {
+    return Status::IOError("Out-of-bounds read",
+                           Substitute("read of [$0-$1) in block [$2-$3)",
+                                      read_offset,
+                                      read_offset + length,
+                                      log_block_->offset(),
+                                      log_block_->offset() + log_block_->length()));
+  }
+  *data_offset = read_offset;
+  return Status::OK();
+}
+
+Status LogReadableBlock::Readahead(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  // Don't let the hint spill into whatever block follows this one in the
+  // container.
+  if (offset >= log_block_->length()) {
+    return Status::OK();
+  }
+  length = std::min<uint64_t>(length, log_block_->length() - offset);
+  return container_->ReadaheadData(log_block_->offset() + offset, length);
+}
+
+Status LogReadableBlock::InvalidateCache(uint64_t offset, size_t length) const {
+  DCHECK(!closed_.Load());
+
+  // Neighbouring blocks share the container's data file, so the hint must
+  // not extend past this block.
+  if (offset >= log_block_->length() || length == 0) {
+    return Status::OK();
+  }
+  length = std::min<uint64_t>(length, log_block_->length() - offset);
+  return container_->InvalidateDataCache(log_block_->offset() + offset, length);
+}
+
 size_t LogReadableBlock::memory_footprint() const {
   return kudu_malloc_usable_size(this);
 }
@@ -1076,18 +1294,23 @@ size_t LogReadableBlock::memory_footprint() const {
 
 const char* LogBlockManager::kContainerMetadataFileSuffix = ".metadata";
 const char* LogBlockManager::kContainerDataFileSuffix = ".data";
+const char* LogBlockManager::kContainerMetadataTmpFileSuffix = ".metadata.tmp";
 
 static const char* kBlockManagerType = "log";
 
+LogBlockManager::BlockMapShard::BlockMapShard(
+    const std::shared_ptr<MemTracker>& mem_tracker)
+  : // TODO: C++11 provides a single-arg constructor
+    blocks(10,
+           BlockMap::hasher(),
+           BlockMap::key_equal(),
+           BlockAllocator(mem_tracker)) {
+}
+
 LogBlockManager::LogBlockManager(Env* env, const BlockManagerOptions& opts)
   : mem_tracker_(MemTracker::CreateTracker(-1,
                                            "log_block_manager",
                                            opts.parent_mem_tracker)),
-    // TODO: C++11 provides a single-arg constructor
-    blocks_by_block_id_(10,
-                        BlockMap::hasher(),
-                        BlockMap::key_equal(),
-                        BlockAllocator(mem_tracker_)),
     env_(DCHECK_NOTNULL(env)),
     read_only_(opts.read_only),
     root_paths_(opts.root_paths),
@@ -1106,6 +1329,10 @@ LogBlockManager::LogBlockManager(Env* env, const BlockManagerOptions& opts)
     next_block_id_.Store(r.Next64());
   }
 
+  for (int i = 0; i < kNumBlockMapShards; i++) {
+    block_map_shards_.emplace_back(new BlockMapShard(mem_tracker_));
+  }
+
   DCHECK_GT(root_paths_.size(), 0);
   if (opts.metric_entity) {
     metrics_.reset(new internal::LogBlockManagerMetrics(opts.metric_entity));
@@ -1115,14 +1342,16 @@ LogBlockManager::LogBlockManager(Env* env, const BlockManagerOptions& opts)
 LogBlockManager::~LogBlockManager() {
   // Release all of the memory accounted by the blocks.
   int64_t mem = 0;
-  for (const auto& entry : blocks_by_block_id_) {
-    mem += kudu_malloc_usable_size(entry.second.get());
+  for (const auto& shard : block_map_shards_) {
+    for (const auto& entry : shard->blocks) {
+      mem += kudu_malloc_usable_size(entry.second.get());
+    }
   }
   mem_tracker_->Release(mem);
 
   // A LogBlock's destructor depends on its container, so all LogBlocks must be
   // destroyed before their containers.
-  blocks_by_block_id_.clear();
+  block_map_shards_.clear();
 
   // As LogBlock destructors run, some blocks may be deleted, so we might be
   // waiting here for a little while.
@@ -1264,10 +1493,27 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
   //
   // TODO: should we cap the number of outstanding containers and force
   // callers to block if we've reached it?
+  // The root paths the blocks of the tablet are kept in, if any.
+  unordered_set<string> group;
+  bool use_group = GetDataDirGroup(opts.tablet_id, &group);
+
   LogBlockContainer* container = nullptr;
   while (!container) {
-    container = GetAvailableContainer(full_root_paths);
+    container = GetAvailableContainer(full_root_paths, use_group ? &group : nullptr);
     if (!container) {
+      // If all the root paths of the tablet's group are full, fall back to
+      // the other root paths rather than failing the write.
+      if (use_group &&
+          std::all_of(group.begin(), group.end(), [&](const string& root_path) {
+            return ContainsKey(full_root_paths, root_path);
+          })) {
+        LOG(WARNING) << Substitute("Log block manager: all data directories of tablet $0 "
+                                   "are full, placing its new block elsewhere",
+                                   opts.tablet_id);
+        use_group = false;
+        continue;
+      }
+
       // If all root paths are full, we cannot allocate a block.
       if (full_root_paths.size() == root_paths_.size()) {
         return Status::IOError("Unable to allocate block: All data directories are full. "
@@ -1275,16 +1521,16 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
                                "fs_data_dirs_reserved_bytes configuration parameter",
                                "", ENOSPC);
       }
-      // Round robin through the root paths to select where the next
-      // container should live.
-      // TODO: Consider a more random scheme for block placement.
+      // Round robin through the root paths (of the tablet's group, if any)
+      // to select where the next container should live.
       int32 cur_idx;
       int32 next_idx;
       do {
         cur_idx = root_paths_idx_.Load();
         next_idx = (cur_idx + 1) % root_paths_.size();
       } while (!root_paths_idx_.CompareAndSet(cur_idx, next_idx) ||
-               ContainsKey(full_root_paths, root_paths_[cur_idx]));
+               ContainsKey(full_root_paths, root_paths_[cur_idx]) ||
+               (use_group && !ContainsKey(group, root_paths_[cur_idx])));
       string root_path = root_paths_[cur_idx];
       if (full_disk_cache_.IsRootFull(root_path)) {
         InsertOrDie(&full_root_paths, root_path);
@@ -1347,7 +1593,8 @@ Status LogBlockManager::CreateBlock(const CreateBlockOptions& opts,
 
   block->reset(new internal::LogWritableBlock(container,
                                               new_block_id,
-                                              container->total_bytes_written()));
+                                              container->total_bytes_written(),
+                                              opts.background_write));
   VLOG(3) << "Created block " << (*block)->id() << " in container "
           << container->ToString();
   return Status::OK();
@@ -1361,8 +1608,9 @@ Status LogBlockManager::OpenBlock(const BlockId& block_id,
                                   gscoped_ptr<ReadableBlock>* block) {
   scoped_refptr<LogBlock> lb;
   {
-    std::lock_guard<simple_spinlock> l(lock_);
-    lb = FindPtrOrNull(blocks_by_block_id_, block_id);
+    BlockMapShard* shard = ShardFor(block_id);
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    lb = FindPtrOrNull(shard->blocks, block_id);
   }
   if (!lb) {
     return Status::NotFound("Can't find block", block_id.ToString());
@@ -1375,6 +1623,21 @@ Status LogBlockManager::OpenBlock(const BlockId& block_id,
   return Status::OK();
 }
 
+Status LogBlockManager::FindBlockRootPath(const BlockId& block_id,
+                                          string* root_path) const {
+  scoped_refptr<LogBlock> lb;
+  {
+    BlockMapShard* shard = ShardFor(block_id);
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    lb = FindPtrOrNull(shard->blocks, block_id);
+  }
+  if (!lb) {
+    return Status::NotFound("Can't find block", block_id.ToString());
+  }
+  *root_path = lb->container()->root_path();
+  return Status::OK();
+}
+
 Status LogBlockManager::DeleteBlock(const BlockId& block_id) {
   CHECK(!read_only_);
 
@@ -1421,9 +1684,62 @@ Status LogBlockManager::CloseBlocks(const std::vector<WritableBlock*>& blocks) {
   return Status::OK();
 }
 
+Status LogBlockManager::ReadBlocks(vector<BlockReadRequest>* requests) {
+  // Ranges of different blocks may be adjacent within a container's data
+  // file, so order the requests by their location on disk.
+  struct Range {
+    LogBlockContainer* container;
+    uint64_t data_offset;
+    const BlockReadRequest* request;
+  };
+  vector<Range> ranges;
+  ranges.reserve(requests->size());
+  for (const BlockReadRequest& r : *requests) {
+    const internal::LogReadableBlock* block =
+        down_cast<const internal::LogReadableBlock*>(r.block);
+    Range range;
+    range.container = block->container();
+    range.request = &r;
+    RETURN_NOT_OK(block->GetDataOffset(r.offset, r.result.size(), &range.data_offset));
+    ranges.push_back(range);
+  }
+  std::sort(ranges.begin(), ranges.end(), [](const Range& a, const Range& b) {
+    if (a.container != b.container) {
+      return std::less<LogBlockContainer*>()(a.container, b.container);
+    }
+    return a.data_offset < b.data_offset;
+  });
+
+  vector<Slice> run;
+  int i = 0;
+  while (i < ranges.size()) {
+    const Range& first = ranges[i];
+    uint64_t run_end = first.data_offset;
+    run.clear();
+    while (i < ranges.size() &&
+           ranges[i].container == first.container &&
+           ranges[i].data_offset == run_end) {
+      run.push_back(ranges[i].request->result);
+      run_end += ranges[i].request->result.size();
+      i++;
+    }
+    BackgroundIOThrottle::Throttle(run_end - first.data_offset);
+    RETURN_NOT_OK(first.container->ReadDataV(first.data_offset, &run));
+    if (metrics_) {
+      metrics_->generic_metrics.total_bytes_read->IncrementBy(
+          run_end - first.data_offset);
+    }
+  }
+  return Status::OK();
+}
+
 int64_t LogBlockManager::CountBlocksForTests() const {
-  std::lock_guard<simple_spinlock> l(lock_);
-  return blocks_by_block_id_.size();
+  int64_t count = 0;
+  for (const auto& shard : block_map_shards_) {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    count += shard->blocks.size();
+  }
+  return count;
 }
 
 void LogBlockManager::AddNewContainerUnlocked(LogBlockContainer* container) {
@@ -1437,8 +1753,38 @@ void LogBlockManager::AddNewContainerUnlocked(LogBlockContainer* container) {
   }
 }
 
+bool LogBlockManager::GetDataDirGroup(const string& tablet_id,
+                                      unordered_set<string>* group) const {
+  int group_size = FLAGS_fs_target_data_dirs_per_tablet;
+  if (tablet_id.empty() || group_size <= 0 || group_size >= root_paths_.size()) {
+    return false;
+  }
+
+  // Rendezvous hashing: rank the directories by the hash of the tablet ID,
+  // seeded by the directory's UUID rather than its path, so that moving a
+  // directory to another mount point doesn't move its tablets.
+  vector<std::pair<uint64_t, const string*>> ranked;
+  ranked.reserve(root_paths_.size());
+  for (const string& root_path : root_paths_) {
+    const string& uuid =
+        FindOrDie(instances_by_root_path_, root_path)->metadata()->path_set().uuid();
+    uint64_t seed = HashUtil::MurmurHash2_64(uuid.data(), uuid.size(), 0);
+    ranked.emplace_back(HashUtil::MurmurHash2_64(tablet_id.data(), tablet_id.size(), seed),
+                        &root_path);
+  }
+  std::partial_sort(ranked.begin(), ranked.begin() + group_size, ranked.end(),
+                    std::greater<std::pair<uint64_t, const string*>>());
+
+  group->clear();
+  for (int i = 0; i < group_size; i++) {
+    group->insert(*ranked[i].second);
+  }
+  return true;
+}
+
 LogBlockContainer* LogBlockManager::GetAvailableContainer(
-    const unordered_set<string>& full_root_paths) {
+    const unordered_set<string>& full_root_paths,
+    const unordered_set<string>* group) {
   LogBlockContainer* container = nullptr;
   int64_t disk_full_containers_delta = 0;
   MonoTime now = MonoTime::Now(MonoTime::FINE);
@@ -1454,9 +1800,14 @@ LogBlockContainer* LogBlockManager::GetAvailableContainer(
 
     // Return the first currently-available non-full-disk container (according to
     // our full-disk cache).
-    while (!container && !available_containers_.empty()) {
-      container = available_containers_.front();
-      available_containers_.pop_front();
+    auto it = available_containers_.begin();
+    while (!container && it != available_containers_.end()) {
+      if (group && !ContainsKey(*group, (*it)->root_path())) {
+        ++it;
+        continue;
+      }
+      container = *it;
+      it = available_containers_.erase(it);
       MonoTime expires;
       // Note: We must check 'full_disk_cache_' before 'full_root_paths' in
       // order to correctly use the expiry time provided by 'full_disk_cache_'.
@@ -1527,34 +1878,34 @@ bool LogBlockManager::TryUseBlockId(const BlockId& block_id) {
     return false;
   }
 
-  std::lock_guard<simple_spinlock> l(lock_);
-  if (ContainsKey(blocks_by_block_id_, block_id)) {
+  BlockMapShard* shard = ShardFor(block_id);
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  if (ContainsKey(shard->blocks, block_id)) {
     return false;
   }
-  return InsertIfNotPresent(&open_block_ids_, block_id);
+  return InsertIfNotPresent(&shard->open_block_ids, block_id);
 }
 
 bool LogBlockManager::AddLogBlock(LogBlockContainer* container,
                                   const BlockId& block_id,
                                   int64_t offset,
                                   int64_t length) {
-  std::lock_guard<simple_spinlock> l(lock_);
   scoped_refptr<LogBlock> lb(new LogBlock(container, block_id, offset, length));
   mem_tracker_->Consume(kudu_malloc_usable_size(lb.get()));
 
-  return AddLogBlockUnlocked(lb);
+  return AddLogBlock(lb);
 }
 
-bool LogBlockManager::AddLogBlockUnlocked(const scoped_refptr<LogBlock>& lb) {
-  DCHECK(lock_.is_locked());
-
-  if (!InsertIfNotPresent(&blocks_by_block_id_, lb->block_id(), lb)) {
+bool LogBlockManager::AddLogBlock(const scoped_refptr<LogBlock>& lb) {
+  BlockMapShard* shard = ShardFor(lb->block_id());
+  std::lock_guard<simple_spinlock> l(shard->lock);
+  if (!InsertIfNotPresent(&shard->blocks, lb->block_id(), lb)) {
     return false;
   }
 
-  // There may already be an entry in open_block_ids_ (e.g. we just finished
+  // There may already be an entry in 'open_block_ids' (e.g. we just finished
   // writing out a block).
-  open_block_ids_.erase(lb->block_id());
+  shard->open_block_ids.erase(lb->block_id());
   if (metrics()) {
     metrics()->blocks_under_management->Increment();
     metrics()->bytes_under_management->IncrementBy(lb->length());
@@ -1563,9 +1914,10 @@ bool LogBlockManager::AddLogBlockUnlocked(const scoped_refptr<LogBlock>& lb) {
 }
 
 scoped_refptr<LogBlock> LogBlockManager::RemoveLogBlock(const BlockId& block_id) {
-  std::lock_guard<simple_spinlock> l(lock_);
+  BlockMapShard* shard = ShardFor(block_id);
+  std::lock_guard<simple_spinlock> l(shard->lock);
   scoped_refptr<LogBlock> result =
-      EraseKeyReturnValuePtr(&blocks_by_block_id_, block_id);
+      EraseKeyReturnValuePtr(&shard->blocks, block_id);
   if (result) {
     mem_tracker_->Release(kudu_malloc_usable_size(result.get()));
 
@@ -1623,75 +1975,186 @@ void LogBlockManager::OpenRootPath(const string& root_path,
         "Could not list children of $0", root_path));
     return;
   }
+  vector<string> container_ids;
+  vector<string> data_file_ids;
   for (const string& child : children) {
     string id;
-    if (!TryStripSuffixString(child, LogBlockManager::kContainerMetadataFileSuffix, &id)) {
-      continue;
+    if (TryStripSuffixString(child, LogBlockManager::kContainerMetadataFileSuffix, &id)) {
+      container_ids.push_back(id);
+    } else if (TryStripSuffixString(child, LogBlockManager::kContainerDataFileSuffix, &id)) {
+      data_file_ids.push_back(id);
+    } else if (!read_only_ &&
+               HasSuffixString(child, LogBlockManager::kContainerMetadataTmpFileSuffix)) {
+      // Left behind by a metadata compaction that didn't finish.
+      string path = JoinPathSegments(root_path, child);
+      LOG(INFO) << "Deleting leftover temporary metadata file " << path;
+      WARN_NOT_OK(env_->DeleteFile(path),
+                  Substitute("Could not delete $0", path));
     }
-    gscoped_ptr<LogBlockContainer> container;
-    s = LogBlockContainer::Open(this, metadata->metadata(),
-                                root_path, id, &container);
-    if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not open container $0", id));
-      return;
+  }
+
+  // Containers are deleted metadata file first, so a data file without
+  // metadata belongs to a dead container whose deletion was interrupted.
+  if (!read_only_) {
+    unordered_set<string> container_id_set(container_ids.begin(), container_ids.end());
+    for (const string& id : data_file_ids) {
+      if (!ContainsKey(container_id_set, id)) {
+        string path = JoinPathSegments(
+            root_path, StrCat(id, LogBlockManager::kContainerDataFileSuffix));
+        LOG(INFO) << "Deleting orphaned container data file " << path;
+        WARN_NOT_OK(env_->DeleteFile(path),
+                    Substitute("Could not delete $0", path));
+      }
     }
+  }
 
-    // Populate the in-memory block maps using each container's records.
-    deque<BlockRecordPB> records;
-    s = container->ReadContainerRecords(&records);
+  // Open the containers in parallel: the work is dominated by reading and
+  // parsing metadata files, which a single thread can't do fast enough to
+  // keep the disk busy.
+  gscoped_ptr<ThreadPool> pool;
+  s = ThreadPoolBuilder("lbm open")
+      .set_max_threads(std::max(1, FLAGS_log_block_manager_open_threads_per_dir))
+      .Build(&pool);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend("Could not build thread pool");
+    return;
+  }
+  vector<Status> statuses(container_ids.size());
+  for (int i = 0; i < container_ids.size(); i++) {
+    s = pool->SubmitClosure(Bind(&LogBlockManager::OpenContainer,
+                                 Unretained(this),
+                                 root_path,
+                                 metadata->metadata(),
+                                 container_ids[i],
+                                 &statuses[i]));
     if (!s.ok()) {
-      *result_status = s.CloneAndPrepend(Substitute(
-          "Could not read records from container $0", container->ToString()));
+      statuses[i] = s.CloneAndPrepend(Substitute(
+          "Could not open container $0", container_ids[i]));
+      break;
+    }
+  }
+  pool->Wait();
+  pool->Shutdown();
+  for (const Status& container_status : statuses) {
+    if (!container_status.ok()) {
+      *result_status = container_status;
       return;
     }
+  }
 
-    // Process the records, building a container-local map.
-    //
-    // It's important that we don't try to add these blocks to the global map
-    // incrementally as we see each record, since it's possible that one container
-    // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
-    // If we processed those two containers in this order, then upon processing
-    // the second container, we'd think there was a duplicate block. Building
-    // the container-local map first ensures that we discount deleted blocks
-    // before checking for duplicate IDs.
-    //
-    // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
-    // exceedingly unlikely. However, we might have old data which still exhibits
-    // the above issue.
-    UntrackedBlockMap blocks_in_container;
-    uint64_t max_block_id = 0;
-    for (const BlockRecordPB& r : records) {
-      ProcessBlockRecord(r, container.get(), &blocks_in_container);
-      max_block_id = std::max(max_block_id, r.block_id().id());
+  *result_status = Status::OK();
+  *result_metadata = metadata.release();
+}
+
+void LogBlockManager::OpenContainer(const string& root_path,
+                                    PathInstanceMetadataPB* instance,
+                                    const string& id,
+                                    Status* result_status) {
+  gscoped_ptr<LogBlockContainer> container;
+  Status s = LogBlockContainer::Open(this, instance, root_path, id, &container);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not open container $0", id));
+    return;
+  }
+
+  // Populate the in-memory block maps using each container's records.
+  deque<BlockRecordPB> records;
+  s = container->ReadContainerRecords(&records);
+  if (!s.ok()) {
+    *result_status = s.CloneAndPrepend(Substitute(
+        "Could not read records from container $0", container->ToString()));
+    return;
+  }
+
+  // Process the records, building a container-local map.
+  //
+  // It's important that we don't try to add these blocks to the global map
+  // incrementally as we see each record, since it's possible that one container
+  // has a "CREATE <b>" while another has a "CREATE <b> ; DELETE <b>" pair.
+  // If we processed those two containers in this order, then upon processing
+  // the second container, we'd think there was a duplicate block. Building
+  // the container-local map first ensures that we discount deleted blocks
+  // before checking for duplicate IDs.
+  //
+  // NOTE: Since KUDU-1538, we allocate sequential block IDs, which makes reuse
+  // exceedingly unlikely. However, we might have old data which still exhibits
+  // the above issue.
+  UntrackedBlockMap blocks_in_container;
+  uint64_t max_block_id = 0;
+  for (const BlockRecordPB& r : records) {
+    ProcessBlockRecord(r, container.get(), &blocks_in_container);
+    max_block_id = std::max(max_block_id, r.block_id().id());
+  }
+  next_block_id_.StoreMax(max_block_id + 1);
+
+  if (!read_only_) {
+    // A full container without live blocks will never be written to again,
+    // and all of its data has already been hole punched. Reclaim its files.
+    if (FLAGS_log_block_manager_delete_dead_containers &&
+        container->full() && blocks_in_container.empty()) {
+      VLOG(1) << "Deleting dead log block container " << container->ToString();
+      s = container->DeleteFiles();
+      if (!s.ok()) {
+        *result_status = s.CloneAndPrepend(Substitute(
+            "Could not delete dead container $0", container->ToString()));
+        return;
+      }
+      *result_status = Status::OK();
+      return;
     }
-    next_block_id_.StoreMax(max_block_id + 1);
 
-    // Under the lock, merge this map into the main block map and add
-    // the container.
-    {
-      std::lock_guard<simple_spinlock> l(lock_);
-      // To avoid cacheline contention during startup, we aggregate all of the
-      // memory in a local and add it to the mem-tracker in a single increment
-      // at the end of this loop.
-      int64_t mem_usage = 0;
-      for (const UntrackedBlockMap::value_type& e : blocks_in_container) {
-        if (!AddLogBlockUnlocked(e.second)) {
-          LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
-                     << " which already is alive from another container when "
-                     << " processing container " << container->ToString();
+    // Most of the metadata describes deleted blocks; rewrite it so that
+    // future opens need only read the live records.
+    if (blocks_in_container.size() <
+        records.size() * FLAGS_log_container_live_metadata_before_compact_ratio) {
+      vector<BlockRecordPB> live_records;
+      live_records.reserve(blocks_in_container.size());
+      for (const BlockRecordPB& r : records) {
+        if (r.op_type() != CREATE) {
+          continue;
+        }
+        const scoped_refptr<LogBlock>* lb = FindOrNull(
+            blocks_in_container, BlockId::FromPB(r.block_id()));
+        if (lb && (*lb)->offset() == r.offset()) {
+          live_records.push_back(r);
         }
-        mem_usage += kudu_malloc_usable_size(e.second.get());
       }
+      VLOG(1) << Substitute("Compacting metadata of container $0: $1 of $2 records are live",
+                            container->ToString(), live_records.size(), records.size());
+      s = container->CompactMetadata(live_records);
+      if (!s.ok()) {
+        *result_status = s.CloneAndPrepend(Substitute(
+            "Could not compact metadata of container $0", container->ToString()));
+        return;
+      }
+    }
+  }
 
-      mem_tracker_->Consume(mem_usage);
-      AddNewContainerUnlocked(container.get());
-      MakeContainerAvailableUnlocked(container.release());
+  // Merge this map into the main block map. Each block is added under the
+  // lock of its own shard, so containers opened in parallel rarely contend.
+  //
+  // To avoid cacheline contention during startup, we aggregate all of the
+  // memory in a local and add it to the mem-tracker in a single increment
+  // at the end of this loop.
+  int64_t mem_usage = 0;
+  for (const UntrackedBlockMap::value_type& e : blocks_in_container) {
+    if (!AddLogBlock(e.second)) {
+      LOG(FATAL) << "Found duplicate CREATE record for block " << e.first
+                 << " which already is alive from another container when "
+                 << " processing container " << container->ToString();
     }
+    mem_usage += kudu_malloc_usable_size(e.second.get());
   }
+  mem_tracker_->Consume(mem_usage);
 
+  // Under the lock, add the container.
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    AddNewContainerUnlocked(container.get());
+    MakeContainerAvailableUnlocked(container.release());
+  }
   *result_status = Status::OK();
-  *result_metadata = metadata.release();
 }
 
 void LogBlockManager::ProcessBlockRecord(const BlockRecordPB& record,
@@ -1720,7 +2183,11 @@ void LogBlockManager::ProcessBlockRecord(const BlockRecordPB& record,
       //
       // If we ignored deleted blocks, we would end up reusing the space
       // belonging to the last deleted block in the container.
-      container->UpdateBytesWritten(record.length());
+      //
+      // Once a container's metadata has been compacted, the records of dead
+      // blocks are gone and their space may be reused across a restart. That
+      // is safe: nothing refers to those byte ranges any more.
+      container->UpdateBytesWrittenForRecord(record.offset(), record.length());
       break;
     }
     case DELETE:
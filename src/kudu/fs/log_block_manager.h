@@ -170,6 +170,7 @@ class LogBlockManager : public BlockManager {
  public:
   static const char* kContainerMetadataFileSuffix;
   static const char* kContainerDataFileSuffix;
+  static const char* kContainerMetadataTmpFileSuffix;
 
   LogBlockManager(Env* env, const BlockManagerOptions& opts);
 
@@ -191,12 +192,20 @@ class LogBlockManager : public BlockManager {
 
   virtual Status CloseBlocks(const std::vector<WritableBlock*>& blocks) OVERRIDE;
 
+  virtual Status ReadBlocks(std::vector<BlockReadRequest>* requests) OVERRIDE;
+
+  virtual Status FindBlockRootPath(const BlockId& block_id,
+                                   std::string* root_path) const OVERRIDE;
+
   // Return the number of blocks stored in the block manager.
   int64_t CountBlocksForTests() const;
 
  private:
   FRIEND_TEST(LogBlockManagerTest, TestReuseBlockIds);
   FRIEND_TEST(LogBlockManagerTest, TestMetadataTruncation);
+  FRIEND_TEST(LogBlockManagerTest, TestParallelOpen);
+  FRIEND_TEST(LogBlockManagerTest, TestMetadataCompaction);
+  FRIEND_TEST(LogBlockManagerTest, TestDeleteDeadContainers);
   friend class internal::LogBlockContainer;
 
   // Simpler typedef for a block map which isn't tracked in the memory tracker.
@@ -216,6 +225,35 @@ class LogBlockManager : public BlockManager {
       BlockIdEqual,
       BlockAllocator> BlockMap;
 
+  // The block map is striped across this many shards, each with its own
+  // lock, so that threads opening containers in parallel at startup (and
+  // readers opening blocks afterwards) don't all serialize on 'lock_'.
+  static const int kNumBlockMapShards = 32;
+
+  struct BlockMapShard {
+    explicit BlockMapShard(const std::shared_ptr<MemTracker>& mem_tracker);
+
+    // Protects 'blocks' and 'open_block_ids'.
+    mutable simple_spinlock lock;
+
+    // Maps block IDs to blocks that are now readable, either because they
+    // already existed on disk when the block manager was opened, or because
+    // they're WritableBlocks that were closed.
+    BlockMap blocks;
+
+    // Contains block IDs for WritableBlocks that are still open for writing.
+    // When a WritableBlock is closed, its ID is moved to 'blocks'.
+    //
+    // Together with the keys of 'blocks', used to prevent collisions when
+    // creating new anonymous blocks.
+    std::unordered_set<BlockId, BlockIdHash> open_block_ids;
+  };
+
+  // Returns the shard of the block map holding 'block_id'.
+  BlockMapShard* ShardFor(const BlockId& block_id) const {
+    return block_map_shards_[BlockIdHash()(block_id) % kNumBlockMapShards].get();
+  }
+
   typedef std::pair<internal::LogBlockContainer*, MonoTime> ExpiringContainerPair;
 
   class ExpiringContainerPairGreaterThanFunctor {
@@ -237,8 +275,23 @@ class LogBlockManager : public BlockManager {
   //
   // 'full_root_paths' is a blacklist containing root paths that are full.
   // Containers with root paths in this list will not be returned.
+  //
+  // If 'group' isn't null, only containers with root paths in it are
+  // returned. The others are left available to other writers.
   internal::LogBlockContainer* GetAvailableContainer(
-      const std::unordered_set<std::string>& full_root_paths);
+      const std::unordered_set<std::string>& full_root_paths,
+      const std::unordered_set<std::string>* group);
+
+  // Fills 'group' with the root paths of the data directories which hold the
+  // new blocks of tablet 'tablet_id': the --fs_target_data_dirs_per_tablet
+  // directories which rank highest when their UUIDs are hashed together with
+  // the tablet ID. As the ranking only depends on the IDs, a tablet keeps its
+  // group across restarts, and tablets are spread evenly over the
+  // directories.
+  //
+  // Returns false if the tablet's blocks may go to any directory.
+  bool GetDataDirGroup(const std::string& tablet_id,
+                       std::unordered_set<std::string>* group) const;
 
   // Indicate that this container is no longer in use and can be handed out
   // to other writers.
@@ -264,9 +317,8 @@ class LogBlockManager : public BlockManager {
                    int64_t offset,
                    int64_t length);
 
-  // Unlocked variant of AddLogBlock() for an already-constructed LogBlock object.
-  // Must hold 'lock_'.
-  bool AddLogBlockUnlocked(const scoped_refptr<internal::LogBlock>& lb);
+  // Variant of AddLogBlock() for an already-constructed LogBlock object.
+  bool AddLogBlock(const scoped_refptr<internal::LogBlock>& lb);
 
   // Removes a LogBlock from in-memory data structures.
   //
@@ -288,6 +340,15 @@ class LogBlockManager : public BlockManager {
                     Status* result_status,
                     PathInstanceMetadataFile** result_metadata);
 
+  // Open the container named 'id' in 'root_path' and add its blocks to the
+  // block map. Called in parallel by OpenRootPath() for each container.
+  //
+  // Success or failure is set in 'result_status'.
+  void OpenContainer(const std::string& root_path,
+                     PathInstanceMetadataPB* instance,
+                     const std::string& id,
+                     Status* result_status);
+
   // Test for hole punching support at 'path'.
   Status CheckHolePunch(const std::string& path);
 
@@ -307,20 +368,11 @@ class LogBlockManager : public BlockManager {
   // interesting (e.g. LogBlocks).
   std::shared_ptr<MemTracker> mem_tracker_;
 
-  // Protects the block map, container structures, and 'dirty_dirs'.
+  // Protects the container structures and 'dirty_dirs'.
   mutable simple_spinlock lock_;
 
-  // Maps block IDs to blocks that are now readable, either because they
-  // already existed on disk when the block manager was opened, or because
-  // they're WritableBlocks that were closed.
-  BlockMap blocks_by_block_id_;
-
-  // Contains block IDs for WritableBlocks that are still open for writing.
-  // When a WritableBlock is closed, its ID is moved to blocks_by_block_id.
-  //
-  // Together with blocks_by_block_id's keys, used to prevent collisions
-  // when creating new anonymous blocks.
-  std::unordered_set<BlockId, BlockIdHash> open_block_ids_;
+  // The block map, striped by block ID. See BlockMapShard.
+  std::vector<std::unique_ptr<BlockMapShard>> block_map_shards_;
 
   // Holds (and owns) all containers loaded from disk.
   std::vector<internal::LogBlockContainer*> all_containers_;
@@ -1264,6 +1264,30 @@ TEST_F(AlterTableTest, TestAlterRangePartitioningInvalid) {
   ASSERT_STR_CONTAINS(s.ToString(), "No tablet found for drop partition step");
   ASSERT_EQ(100, CountTableRows(table.get()));
 
+  // DROP [0, 50) <- illegal (only shares the lower bound)
+  table_alterer.reset(client_->NewTableAlterer(table_name));
+  lower.reset(schema_.NewRow());
+  upper.reset(schema_.NewRow());
+  ASSERT_OK(lower->SetInt32("c0", 0));
+  ASSERT_OK(upper->SetInt32("c0", 50));
+  table_alterer->DropRangePartition(lower.release(), upper.release());
+  s = table_alterer->Alter();
+  ASSERT_FALSE(s.ok());
+  ASSERT_STR_CONTAINS(s.ToString(), "No tablet found for drop partition step");
+  ASSERT_EQ(100, CountTableRows(table.get()));
+
+  // DROP [-50, 100) <- illegal (only shares the upper bound)
+  table_alterer.reset(client_->NewTableAlterer(table_name));
+  lower.reset(schema_.NewRow());
+  upper.reset(schema_.NewRow());
+  ASSERT_OK(lower->SetInt32("c0", -50));
+  ASSERT_OK(upper->SetInt32("c0", 100));
+  table_alterer->DropRangePartition(lower.release(), upper.release());
+  s = table_alterer->Alter();
+  ASSERT_FALSE(s.ok());
+  ASSERT_STR_CONTAINS(s.ToString(), "No tablet found for drop partition step");
+  ASSERT_EQ(100, CountTableRows(table.get()));
+
   // DROP [0, 100)
   // ADD  [100, 200)
   // DROP [100, 200)
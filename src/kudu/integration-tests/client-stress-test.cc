@@ -217,6 +217,11 @@ class ClientStressTest_LowMemory : public ClientStressTest {
         "--memory_limit_hard_bytes=$0", kMemLimitBytes));
     opts.extra_tserver_flags.push_back(
         "--memory_limit_soft_percentage=0");
+    // Reject writes over the soft limit rather than delaying them.
+    opts.extra_tserver_flags.push_back(
+        "--write_memory_pressure_max_delay_ms=0");
+    opts.extra_tserver_flags.push_back(
+        "--consensus_reject_updates_on_soft_memory_limit");
     return opts;
   }
 };
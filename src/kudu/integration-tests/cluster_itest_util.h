@@ -199,6 +199,15 @@ Status LeaderStepDown(const TServerDetails* replica,
                       const MonoDelta& timeout,
                       tserver::TabletServerErrorPB* error = NULL);
 
+// Ask the leader on the specified server to hand its leadership to the
+// replica 'new_leader'. Returns once the old leader has stepped down and
+// asked the new leader to run an election.
+Status TransferLeadership(const TServerDetails* replica,
+                          const std::string& tablet_id,
+                          const TServerDetails* new_leader,
+                          const MonoDelta& timeout,
+                          tserver::TabletServerErrorPB* error = NULL);
+
 // Write a "simple test schema" row to the specified tablet on the given
 // replica. This schema is commonly used by tests and is defined in
 // wire_protocol-test-util.h
@@ -0,0 +1,376 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Runs a fixed set of end-to-end scenarios against an external mini cluster
+// and times them, so that performance regressions can be caught before they
+// reach a release.
+//
+// The results are written as JSON to --perf_regression_results_file. When
+// that file from a previous run on the same machine is passed back as
+// --perf_regression_baseline_file, the test fails if any scenario got more
+// than --perf_regression_threshold_pct slower than in it. For example:
+//
+//   perf_regression-itest --perf_regression_results_file=baseline.json
+//   <upgrade>
+//   perf_regression-itest --perf_regression_baseline_file=baseline.json
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "kudu/client/client.h"
+#include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/integration-tests/external_mini_cluster-itest-base.h"
+#include "kudu/util/env.h"
+#include "kudu/util/jsonreader.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/random.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/test_util.h"
+
+DEFINE_int32(perf_regression_num_rows, -1,
+             "Number of rows inserted by the bulk insert scenario, which the other "
+             "scenarios then work on. Defaults to a small number, or to a larger one "
+             "if slow tests are enabled.");
+DEFINE_string(perf_regression_results_file, "",
+              "If set, the results of the scenarios are written to this file as JSON, "
+              "so that it can be used as the --perf_regression_baseline_file of a later run.");
+DEFINE_string(perf_regression_baseline_file, "",
+              "If set, the results file of a previous run, to which the results of this "
+              "run are compared.");
+DEFINE_int32(perf_regression_threshold_pct, 20,
+             "Percentage by which a scenario may be slower than in the baseline before "
+             "the test fails.");
+
+METRIC_DECLARE_entity(tablet);
+METRIC_DECLARE_gauge_size(memrowset_size);
+METRIC_DECLARE_gauge_uint32(flush_mrs_running);
+METRIC_DECLARE_gauge_uint32(flush_dms_running);
+METRIC_DECLARE_gauge_uint32(compact_rs_running);
+METRIC_DECLARE_gauge_uint32(delta_minor_compact_rs_running);
+METRIC_DECLARE_gauge_uint32(delta_major_compact_rs_running);
+
+using std::map;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+using client::KuduColumnSchema;
+using client::KuduInsert;
+using client::KuduPredicate;
+using client::KuduRowResult;
+using client::KuduScanner;
+using client::KuduSchema;
+using client::KuduSchemaBuilder;
+using client::KuduSession;
+using client::KuduTable;
+using client::KuduTableCreator;
+using client::KuduUpdate;
+using client::KuduValue;
+using client::sp::shared_ptr;
+
+namespace {
+
+const char* const kTableName = "perf_regression";
+const int kBatchSize = 1000;
+const int kFlushThresholdMb = 1;
+
+} // anonymous namespace
+
+class PerfRegressionITest : public ExternalMiniClusterITestBase {
+ protected:
+  // The timing of one scenario.
+  struct Result {
+    int64_t num_ops;
+    int64_t elapsed_us;
+  };
+
+  PerfRegressionITest()
+      : num_rows_(FLAGS_perf_regression_num_rows > 0 ? FLAGS_perf_regression_num_rows :
+                  AllowSlowTests() ? 500000 : 20000),
+        rng_(SeedRandom()) {
+  }
+
+  void SetUp() OVERRIDE {
+    ExternalMiniClusterITestBase::SetUp();
+    // A single tablet server, so that the timings don't depend on replication.
+    NO_FATALS(StartCluster({ Substitute("--flush_threshold_mb=$0", kFlushThresholdMb) }, {}, 1));
+
+    KuduSchemaBuilder b;
+    b.AddColumn("key")->Type(KuduColumnSchema::INT32)->NotNull()->PrimaryKey();
+    b.AddColumn("int_val")->Type(KuduColumnSchema::INT32)->NotNull();
+    b.AddColumn("string_val")->Type(KuduColumnSchema::STRING)->NotNull();
+    ASSERT_OK(b.Build(&schema_));
+    gscoped_ptr<KuduTableCreator> table_creator(client_->NewTableCreator());
+    ASSERT_OK(table_creator->table_name(kTableName)
+              .schema(&schema_)
+              .set_range_partition_columns({ "key" })
+              .num_replicas(1)
+              .Create());
+    ASSERT_OK(client_->OpenTable(kTableName, &table_));
+  }
+
+  shared_ptr<KuduSession> NewSession() {
+    shared_ptr<KuduSession> session = client_->NewSession();
+    session->SetTimeoutMillis(60000);
+    CHECK_OK(session->SetFlushMode(KuduSession::MANUAL_FLUSH));
+    return session;
+  }
+
+  void Record(const string& name, int64_t num_ops, const Stopwatch& sw) {
+    int64_t elapsed_us = sw.elapsed().wall / 1000;
+    LOG(INFO) << Substitute("Scenario $0: $1 ops in $2 us", name, num_ops, elapsed_us);
+    results_[name] = { num_ops, elapsed_us };
+  }
+
+  // Inserts the rows with keys [0, num_rows_), in batches.
+  void BulkInsert() {
+    shared_ptr<KuduSession> session = NewSession();
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < num_rows_; i++) {
+      gscoped_ptr<KuduInsert> insert(table_->NewInsert());
+      ASSERT_OK(insert->mutable_row()->SetInt32("key", i));
+      ASSERT_OK(insert->mutable_row()->SetInt32("int_val", i));
+      ASSERT_OK(insert->mutable_row()->SetStringCopy("string_val", Substitute("hello $0", i)));
+      ASSERT_OK(session->Apply(insert.release()));
+      if ((i + 1) % kBatchSize == 0) {
+        ASSERT_OK(session->Flush());
+      }
+    }
+    ASSERT_OK(session->Flush());
+    sw.stop();
+    Record("bulk_insert", num_rows_, sw);
+  }
+
+  // Updates a tenth of the rows, picked at random, in batches.
+  void RandomUpdate() {
+    shared_ptr<KuduSession> session = NewSession();
+    const int num_updates = num_rows_ / 10;
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < num_updates; i++) {
+      gscoped_ptr<KuduUpdate> update(table_->NewUpdate());
+      ASSERT_OK(update->mutable_row()->SetInt32("key", rng_.Uniform(num_rows_)));
+      ASSERT_OK(update->mutable_row()->SetInt32("int_val", -i));
+      ASSERT_OK(session->Apply(update.release()));
+      if ((i + 1) % kBatchSize == 0) {
+        ASSERT_OK(session->Flush());
+      }
+    }
+    ASSERT_OK(session->Flush());
+    sw.stop();
+    Record("random_update", num_updates, sw);
+  }
+
+  // Returns the value of an integer metric of the table's tablet.
+  int64_t GetTabletMetric(const MetricPrototype* metric) {
+    int64_t value;
+    CHECK_OK(cluster_->tablet_server(0)->GetInt64Metric(
+        &METRIC_ENTITY_tablet, nullptr, metric, "value", &value));
+    return value;
+  }
+
+  // Waits until the maintenance manager has flushed the MemRowSet under the
+  // flush threshold and no flush or compaction is running.
+  void CompactionCatchUp() {
+    const vector<const MetricPrototype*> running_metrics = {
+      &METRIC_flush_mrs_running,
+      &METRIC_flush_dms_running,
+      &METRIC_compact_rs_running,
+      &METRIC_delta_minor_compact_rs_running,
+      &METRIC_delta_major_compact_rs_running,
+    };
+    Stopwatch sw;
+    sw.start();
+    while (true) {
+      bool caught_up = GetTabletMetric(&METRIC_memrowset_size) <
+          kFlushThresholdMb * 1024 * 1024;
+      for (const MetricPrototype* metric : running_metrics) {
+        caught_up = caught_up && GetTabletMetric(metric) == 0;
+      }
+      if (caught_up) break;
+      ASSERT_LT(sw.elapsed().wall_seconds(), 300) << "Timed out waiting for the flushes";
+      SleepFor(MonoDelta::FromMilliseconds(50));
+    }
+    sw.stop();
+    Record("compaction_catch_up", 1, sw);
+  }
+
+  // Opens a scanner with the given predicates, if any, and returns the number
+  // of rows it returns.
+  int64_t CountRows(const vector<KuduPredicate*>& predicates) {
+    KuduScanner scanner(table_.get());
+    for (KuduPredicate* pred : predicates) {
+      CHECK_OK(scanner.AddConjunctPredicate(pred));
+    }
+    CHECK_OK(scanner.Open());
+    int64_t count = 0;
+    vector<KuduRowResult> rows;
+    while (scanner.HasMoreRows()) {
+      CHECK_OK(scanner.NextBatch(&rows));
+      count += rows.size();
+    }
+    return count;
+  }
+
+  // Looks up random rows, one at a time, by key.
+  void PointLookup() {
+    const int num_lookups = std::min(num_rows_, AllowSlowTests() ? 10000 : 1000);
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < num_lookups; i++) {
+      KuduPredicate* pred = table_->NewComparisonPredicate(
+          "key", KuduPredicate::EQUAL, KuduValue::FromInt(rng_.Uniform(num_rows_)));
+      ASSERT_EQ(1, CountRows({ pred }));
+    }
+    sw.stop();
+    Record("point_lookup", num_lookups, sw);
+  }
+
+  void FullScan() {
+    Stopwatch sw;
+    sw.start();
+    ASSERT_EQ(num_rows_, CountRows({}));
+    sw.stop();
+    Record("full_scan", num_rows_, sw);
+  }
+
+  // Scans the first tenth of the key range, and the rows whose value is in
+  // the first tenth of its range, which isn't a key range.
+  void PredicateScan() {
+    const int cutoff = num_rows_ / 10;
+    Stopwatch sw;
+    sw.start();
+    KuduPredicate* key_pred = table_->NewComparisonPredicate(
+        "key", KuduPredicate::LESS_EQUAL, KuduValue::FromInt(cutoff - 1));
+    ASSERT_EQ(cutoff, CountRows({ key_pred }));
+    KuduPredicate* lower_pred = table_->NewComparisonPredicate(
+        "int_val", KuduPredicate::GREATER_EQUAL, KuduValue::FromInt(0));
+    KuduPredicate* upper_pred = table_->NewComparisonPredicate(
+        "int_val", KuduPredicate::LESS_EQUAL, KuduValue::FromInt(cutoff - 1));
+    ASSERT_LE(CountRows({ lower_pred, upper_pred }), cutoff);
+    sw.stop();
+    Record("predicate_scan", 2, sw);
+  }
+
+  // Restarts the tablet server and waits for its tablet to be bootstrapped.
+  void RestartAndBootstrap() {
+    ExternalTabletServer* ts = cluster_->tablet_server(0);
+    ts->Shutdown();
+    Stopwatch sw;
+    sw.start();
+    ASSERT_OK(ts->Restart());
+    ASSERT_OK(cluster_->WaitForTabletsRunning(ts, 1, MonoDelta::FromSeconds(300)));
+    sw.stop();
+    Record("restart_and_bootstrap", 1, sw);
+  }
+
+  string ResultsToJson() const {
+    std::stringstream out;
+    JsonWriter jw(&out, JsonWriter::PRETTY);
+    jw.StartObject();
+    jw.String("num_rows");
+    jw.Int(num_rows_);
+    jw.String("scenarios");
+    jw.StartArray();
+    for (const auto& entry : results_) {
+      jw.StartObject();
+      jw.String("name");
+      jw.String(entry.first);
+      jw.String("num_ops");
+      jw.Int64(entry.second.num_ops);
+      jw.String("elapsed_us");
+      jw.Int64(entry.second.elapsed_us);
+      jw.EndObject();
+    }
+    jw.EndArray();
+    jw.EndObject();
+    return out.str();
+  }
+
+  // Compares the results to those of the baseline file, failing the test for
+  // each scenario which got slower than the threshold allows.
+  void CompareToBaseline(const string& path) {
+    faststring contents;
+    ASSERT_OK(ReadFileToString(env_.get(), path, &contents));
+    JsonReader reader(contents.ToString());
+    ASSERT_OK(reader.Init());
+    int32_t baseline_num_rows;
+    ASSERT_OK(reader.ExtractInt32(reader.root(), "num_rows", &baseline_num_rows));
+    ASSERT_EQ(num_rows_, baseline_num_rows)
+        << "The baseline was recorded with a different --perf_regression_num_rows";
+
+    vector<const rapidjson::Value*> scenarios;
+    ASSERT_OK(reader.ExtractObjectArray(reader.root(), "scenarios", &scenarios));
+    for (const rapidjson::Value* scenario : scenarios) {
+      string name;
+      int64_t baseline_us;
+      ASSERT_OK(reader.ExtractString(scenario, "name", &name));
+      ASSERT_OK(reader.ExtractInt64(scenario, "elapsed_us", &baseline_us));
+      const Result* result = FindOrNull(results_, name);
+      if (result == nullptr) {
+        LOG(WARNING) << "Scenario " << name << " of the baseline wasn't run";
+        continue;
+      }
+      int64_t limit_us = baseline_us * (100 + FLAGS_perf_regression_threshold_pct) / 100;
+      LOG(INFO) << Substitute("Scenario $0: $1 us, baseline $2 us ($3%)", name,
+                              result->elapsed_us, baseline_us,
+                              baseline_us > 0 ? result->elapsed_us * 100 / baseline_us : 0);
+      EXPECT_LE(result->elapsed_us, limit_us)
+          << "Scenario " << name << " regressed by more than "
+          << FLAGS_perf_regression_threshold_pct << "%";
+    }
+  }
+
+  const int num_rows_;
+  Random rng_;
+  KuduSchema schema_;
+  shared_ptr<KuduTable> table_;
+  map<string, Result> results_;
+};
+
+TEST_F(PerfRegressionITest, TestScenarios) {
+  NO_FATALS(BulkInsert());
+  NO_FATALS(RandomUpdate());
+  NO_FATALS(CompactionCatchUp());
+  NO_FATALS(PointLookup());
+  NO_FATALS(FullScan());
+  NO_FATALS(PredicateScan());
+  NO_FATALS(RestartAndBootstrap());
+
+  string json = ResultsToJson();
+  LOG(INFO) << "Results:\n" << json;
+  if (!FLAGS_perf_regression_results_file.empty()) {
+    ASSERT_OK(WriteStringToFile(env_.get(), json, FLAGS_perf_regression_results_file));
+  }
+  if (!FLAGS_perf_regression_baseline_file.empty()) {
+    NO_FATALS(CompareToBaseline(FLAGS_perf_regression_baseline_file));
+  }
+}
+
+} // namespace kudu
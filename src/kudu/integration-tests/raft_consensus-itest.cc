@@ -1383,6 +1383,86 @@ TEST_F(RaftConsensusITest, TestLeaderStepDown) {
                                   << s.ToString();
 }
 
+TEST_F(RaftConsensusITest, TestLeadershipTransfer) {
+  FLAGS_num_replicas = 3;
+  FLAGS_num_tablet_servers = 3;
+
+  vector<string> ts_flags, master_flags;
+  ts_flags.push_back("--enable_leader_failure_detection=false");
+  master_flags.push_back("--catalog_manager_wait_for_new_tablets_to_elect_leader=false");
+  BuildAndStart(ts_flags, master_flags);
+
+  vector<TServerDetails*> tservers;
+  AppendValuesFromMap(tablet_servers_, &tservers);
+  ASSERT_OK(StartElection(tservers[0], tablet_id_, MonoDelta::FromSeconds(10)));
+  ASSERT_OK(WaitUntilLeader(tservers[0], tablet_id_, MonoDelta::FromSeconds(10)));
+  ASSERT_OK(WriteSimpleTestRow(tservers[0], tablet_id_, RowOperationsPB::INSERT,
+                               kTestRowKey, kTestRowIntVal, "foo", MonoDelta::FromSeconds(10)));
+
+  // With failure detection disabled, only the transfer can elect the new
+  // leader.
+  ASSERT_OK(TransferLeadership(tservers[0], tablet_id_, tservers[1],
+                               MonoDelta::FromSeconds(10)));
+  ASSERT_OK(WaitUntilLeader(tservers[1], tablet_id_, MonoDelta::FromSeconds(10)));
+  ASSERT_OK(WriteSimpleTestRow(tservers[1], tablet_id_, RowOperationsPB::UPDATE,
+                               kTestRowKey, kTestRowIntVal + 1, "bar",
+                               MonoDelta::FromSeconds(10)));
+
+  // A former leader can no longer transfer leadership.
+  TabletServerErrorPB error;
+  Status s = TransferLeadership(tservers[0], tablet_id_, tservers[2],
+                                MonoDelta::FromSeconds(10), &error);
+  ASSERT_TRUE(s.IsIllegalState()) << s.ToString();
+  ASSERT_EQ(TabletServerErrorPB::NOT_THE_LEADER, error.code()) << error.ShortDebugString();
+}
+
+// Test that the replicas of an idle tablet stop heartbeating without starting
+// elections, and that they still elect a new leader once the leader's server
+// goes away.
+TEST_F(RaftConsensusITest, TestQuiescence) {
+  FLAGS_num_replicas = 3;
+  FLAGS_num_tablet_servers = 3;
+
+  vector<string> ts_flags, master_flags;
+  ts_flags.push_back("--raft_enable_quiescence=true");
+  ts_flags.push_back("--raft_quiesce_after_idle_ms=1000");
+  BuildAndStart(ts_flags, master_flags);
+
+  TServerDetails* leader;
+  ASSERT_OK(GetLeaderReplicaWithRetries(tablet_id_, &leader));
+  ASSERT_OK(WriteSimpleTestRow(leader, tablet_id_, RowOperationsPB::INSERT,
+                               kTestRowKey, kTestRowIntVal, "foo", MonoDelta::FromSeconds(10)));
+  consensus::ConsensusStatePB cstate;
+  ASSERT_OK(itest::GetConsensusState(leader, tablet_id_,
+                                     consensus::CONSENSUS_CONFIG_COMMITTED,
+                                     MonoDelta::FromSeconds(10), &cstate));
+  int64_t term = cstate.current_term();
+
+  // Idle for many election timeouts: the leader keeps its leadership even
+  // though it no longer heartbeats its followers.
+  SleepFor(MonoDelta::FromSeconds(5));
+  ASSERT_OK(itest::GetConsensusState(leader, tablet_id_,
+                                     consensus::CONSENSUS_CONFIG_COMMITTED,
+                                     MonoDelta::FromSeconds(10), &cstate));
+  ASSERT_EQ(term, cstate.current_term());
+  ASSERT_EQ(leader->uuid(), cstate.leader_uuid());
+
+  // A write wakes the tablet up.
+  ASSERT_OK(WriteSimpleTestRow(leader, tablet_id_, RowOperationsPB::UPDATE,
+                               kTestRowKey, kTestRowIntVal + 1, "bar",
+                               MonoDelta::FromSeconds(10)));
+
+  // Once quiesced again, losing the leader's server leads to an election.
+  SleepFor(MonoDelta::FromSeconds(2));
+  cluster_->tablet_server_by_uuid(leader->uuid())->Shutdown();
+  TabletServerMap survivors = tablet_servers_;
+  survivors.erase(leader->uuid());
+  TServerDetails* new_leader;
+  ASSERT_OK(itest::FindTabletLeader(survivors, tablet_id_, MonoDelta::FromSeconds(30),
+                                    &new_leader));
+  ASSERT_NE(leader->uuid(), new_leader->uuid());
+}
+
 void RaftConsensusITest::AssertMajorityRequiredForElectionsAndWrites(
     const TabletServerMap& tablet_servers, const string& leader_uuid) {
 
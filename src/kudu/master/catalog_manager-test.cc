@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 #include <gtest/gtest.h>
+#include <memory>
 
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/catalog_manager.h"
@@ -77,10 +78,17 @@ TEST(TableInfoTest, TestAssignmentRanges) {
     LOG(INFO) << "Key " << start_key << " found in tablet " << tablet_id;
   }
 
+  // An index handed out before the tablets are removed is left untouched by
+  // the removal, while a newly fetched one reflects it.
+  std::shared_ptr<const TableInfo::TabletIndex> index = table->tablet_index();
+  ASSERT_EQ(kNumSplits + 1, index->size());
+
   for (const scoped_refptr<TabletInfo>& tablet : tablets) {
     ASSERT_TRUE(table->RemoveTablet(
         tablet->metadata().state().pb.partition().partition_key_start()));
   }
+  ASSERT_EQ(kNumSplits + 1, index->size());
+  ASSERT_TRUE(table->tablet_index()->empty());
 }
 
 TEST(TestTSDescriptor, TestReplicaCreationsDecay) {
@@ -105,5 +113,47 @@ TEST(TestTSDescriptor, TestReplicaCreationsDecay) {
   }
 }
 
+TEST(TestTSDescriptor, TestLoadTracking) {
+  TSDescriptor ts("test");
+  ASSERT_EQ(0, ts.data_size_bytes());
+  ASSERT_EQ(0, ts.write_rate());
+
+  // The first report only establishes a baseline for the write rate.
+  TSLoadPB load;
+  load.set_data_size_bytes(1000);
+  load.set_rows_written(1000000);
+  ts.UpdateLoad(load);
+  ASSERT_EQ(1000, ts.data_size_bytes());
+  ASSERT_EQ(0, ts.write_rate());
+
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  load.set_rows_written(1010000);
+  ts.UpdateLoad(load);
+  double rate = ts.write_rate();
+  ASSERT_GT(rate, 0);
+
+  // A counter that goes backwards, e.g. after a restart, is not a sample.
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  load.set_data_size_bytes(2000);
+  load.set_rows_written(0);
+  ts.UpdateLoad(load);
+  ASSERT_EQ(2000, ts.data_size_bytes());
+  ASSERT_EQ(rate, ts.write_rate());
+}
+
+TEST(TestTSDescriptor, TestLeaderTracking) {
+  TSDescriptor ts("test");
+  ASSERT_EQ(0, ts.num_leaders());
+  ts.SetTabletLeadership("a", true);
+  ts.SetTabletLeadership("b", true);
+  ts.SetTabletLeadership("a", true);
+  ASSERT_EQ(2, ts.num_leaders());
+  ts.SetTabletLeadership("a", false);
+  ts.SetTabletLeadership("c", false);
+  ASSERT_EQ(1, ts.num_leaders());
+  ts.ClearTabletLeadership();
+  ASSERT_EQ(0, ts.num_leaders());
+}
+
 } // namespace master
 } // namespace kudu
@@ -52,7 +52,9 @@
 #include <utility>
 #include <vector>
 
+#include "kudu/cfile/compression_codec.h"
 #include "kudu/cfile/type_encodings.h"
+#include "kudu/common/column_stats.h"
 #include "kudu/common/partial_row.h"
 #include "kudu/common/partition.h"
 #include "kudu/common/row_operations.h"
@@ -79,6 +81,7 @@
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/tserver/tserver_admin.proxy.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
@@ -166,6 +169,64 @@ DEFINE_bool(catalog_manager_delete_orphaned_tablets, false,
             "master failures!");
 TAG_FLAG(catalog_manager_delete_orphaned_tablets, advanced);
 
+DEFINE_int32(catalog_manager_report_batch_size, 256,
+             "Maximum number of tablets from a tablet report whose changes are "
+             "written to the system catalog in a single batch.");
+TAG_FLAG(catalog_manager_report_batch_size, advanced);
+
+DEFINE_double(master_placement_data_size_weight, 1.0,
+              "Weight given to the amount of data stored on a tablet server, "
+              "relative to its number of replicas, when placing new replicas.");
+TAG_FLAG(master_placement_data_size_weight, experimental);
+
+DEFINE_double(master_placement_write_rate_weight, 1.0,
+              "Weight given to the rate of writes to a tablet server, "
+              "relative to its number of replicas, when placing new replicas.");
+TAG_FLAG(master_placement_write_rate_weight, experimental);
+
+DEFINE_bool(master_auto_rebalance, false,
+            "Whether the leader master moves tablet replicas between tablet "
+            "servers to even out the number of replicas on each server.");
+TAG_FLAG(master_auto_rebalance, experimental);
+TAG_FLAG(master_auto_rebalance, runtime);
+
+DEFINE_int32(master_rebalance_interval_ms, 10 * 1000, // 10 sec
+             "How often the leader master looks for a replica to move when "
+             "auto-rebalancing is enabled.");
+TAG_FLAG(master_rebalance_interval_ms, experimental);
+
+DEFINE_int32(master_max_concurrent_replica_moves, 1,
+             "Maximum number of replica moves started by the rebalancer which "
+             "may be in progress at once.");
+TAG_FLAG(master_max_concurrent_replica_moves, experimental);
+
+DEFINE_int32(master_replica_move_timeout_ms, 10 * 60 * 1000, // 10 min
+             "Time after which the rebalancer stops tracking a replica move "
+             "which has not completed.");
+TAG_FLAG(master_replica_move_timeout_ms, experimental);
+
+DEFINE_bool(master_auto_leader_rebalance, false,
+            "Whether the leader master transfers tablet leadership between "
+            "tablet servers to even out the number of leaders on each server.");
+TAG_FLAG(master_auto_leader_rebalance, experimental);
+TAG_FLAG(master_auto_leader_rebalance, runtime);
+
+DEFINE_int32(master_leader_rebalance_interval_ms, 10 * 1000, // 10 sec
+             "How often the leader master looks for leaderships to transfer "
+             "when leader rebalancing is enabled.");
+TAG_FLAG(master_leader_rebalance_interval_ms, experimental);
+
+DEFINE_int32(master_max_leader_transfers_per_round, 8,
+             "Maximum number of leadership transfers started each time the "
+             "leader rebalancer runs.");
+TAG_FLAG(master_max_leader_transfers_per_round, experimental);
+
+DEFINE_int32(master_leader_transfer_timeout_ms, 30 * 1000, // 30 sec
+             "Time after which the master gives up on a leadership transfer, "
+             "e.g. because the new leader does not catch up.");
+TAG_FLAG(master_leader_transfer_timeout_ms, experimental);
+
+using google::protobuf::RepeatedPtrField;
 using std::pair;
 using std::shared_ptr;
 using std::string;
@@ -273,8 +334,10 @@ class TabletLoader : public TabletVisitor {
       table->AddTablet(tablet);
     }
 
-    LOG(INFO) << "Loaded metadata for tablet " << tablet_id
-              << " (table " << table->ToString() << ")";
+    // With hundreds of thousands of tablets, logging each one would take a
+    // good part of the loading time.
+    VLOG(1) << "Loaded metadata for tablet " << tablet_id
+            << " (table " << table->ToString() << ")";
     VLOG(2) << "Metadata for tablet " << tablet_id << ": " << metadata.ShortDebugString();
     return Status::OK();
   }
@@ -383,6 +446,9 @@ void CatalogManagerBgTasks::Run() {
                        << s.ToString();
           }
         }
+
+        catalog_manager_->RebalanceReplicas();
+        catalog_manager_->RebalanceLeaders();
       }
     }
 
@@ -687,6 +753,8 @@ Status CatalogManager::VisitTablesAndTablets() {
   TabletLoader tablet_loader(this);
   RETURN_NOT_OK_PREPEND(sys_catalog_->VisitTablets(&tablet_loader),
                         "Failed while visiting tablets in sys catalog");
+  LOG(INFO) << Substitute("Loaded metadata for $0 tables and $1 tablets",
+                          table_ids_map_.size(), tablet_map_.size());
   return Status::OK();
 }
 
@@ -761,6 +829,38 @@ static void SetupError(MasterErrorPB* error,
   error->set_code(code);
 }
 
+// Checks that the column's compression level is supported by its codec, so
+// that a bad level is rejected up front instead of failing every flush.
+static Status ValidateColumnCompression(const ColumnSchema& col) {
+  const ColumnStorageAttributes& attrs = col.attributes();
+  if (attrs.compression == DEFAULT_COMPRESSION || attrs.compression == NO_COMPRESSION) {
+    return Status::OK();
+  }
+  const cfile::CompressionCodec* codec;
+  Status s = cfile::GetCompressionCodec(attrs.compression, attrs.compression_level, &codec);
+  if (!s.ok()) {
+    return s.CloneAndPrepend(Substitute("column `$0`", col.name()));
+  }
+  return Status::OK();
+}
+
+// Checks that the column's values can be recorded in a value bloom filter,
+// if it asks for one. Equal floating point values may differ in their bits,
+// e.g. 0.0 and -0.0, so a bloom filter of their bits could wrongly exclude
+// a file.
+static Status ValidateColumnBloomFilter(const ColumnSchema& col) {
+  if (!col.attributes().bloom_filter) {
+    return Status::OK();
+  }
+  DataType type = col.type_info()->physical_type();
+  if (type == FLOAT || type == DOUBLE) {
+    return Status::InvalidArgument(
+        Substitute("column `$0`: bloom filters are not supported for $1 columns",
+                   col.name(), col.type_info()->name()));
+  }
+  return Status::OK();
+}
+
 Status CatalogManager::CheckOnline() const {
   if (PREDICT_FALSE(!IsInitialized())) {
     return Status::ServiceUnavailable("CatalogManager is not running");
@@ -803,6 +903,16 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
         return s;
     }
   }
+  for (int i = 0; i < client_schema.num_columns(); i++) {
+    s = ValidateColumnCompression(client_schema.column(i));
+    if (s.ok()) {
+      s = ValidateColumnBloomFilter(client_schema.column(i));
+    }
+    if (!s.ok()) {
+      SetupError(resp->mutable_error(), MasterErrorPB::INVALID_SCHEMA, s);
+      return s;
+    }
+  }
   Schema schema = client_schema.CopyWithColumnIds();
 
   // If the client did not set a partition schema in the create table request,
@@ -850,6 +960,35 @@ Status CatalogManager::CreateTable(const CreateTableRequestPB* orig_req,
   vector<Partition> partitions;
   RETURN_NOT_OK(partition_schema.CreatePartitions(split_rows, range_bounds, schema, &partitions));
 
+  if (req.has_history_max_age_sec() && req.history_max_age_sec() < 0) {
+    s = Status::InvalidArgument(Substitute("Invalid history retention: $0 seconds",
+                                           req.history_max_age_sec()));
+    SetupError(resp->mutable_error(), MasterErrorPB::UNKNOWN_ERROR, s);
+    return s;
+  }
+
+  if (req.has_row_ttl_column() != req.has_row_ttl_sec()) {
+    s = Status::InvalidArgument("A row TTL needs both a column and a duration");
+    SetupError(resp->mutable_error(), MasterErrorPB::UNKNOWN_ERROR, s);
+    return s;
+  }
+  if (req.has_row_ttl_column()) {
+    int idx = schema.find_column(req.row_ttl_column());
+    if (idx == Schema::kColumnNotFound) {
+      s = Status::InvalidArgument("Row TTL column not found", req.row_ttl_column());
+    } else if (schema.column(idx).type_info()->type() != UNIXTIME_MICROS ||
+               schema.column(idx).is_nullable()) {
+      s = Status::InvalidArgument("Row TTL column must be a non-nullable UNIXTIME_MICROS column",
+                                  req.row_ttl_column());
+    } else if (req.row_ttl_sec() < 0) {
+      s = Status::InvalidArgument(Substitute("Invalid row TTL: $0 seconds", req.row_ttl_sec()));
+    }
+    if (!s.ok()) {
+      SetupError(resp->mutable_error(), MasterErrorPB::INVALID_SCHEMA, s);
+      return s;
+    }
+  }
+
   // If they didn't specify a num_replicas, set it based on the default.
   if (!req.has_num_replicas()) {
     req.set_num_replicas(FLAGS_default_num_replicas);
@@ -1011,6 +1150,20 @@ TableInfo *CatalogManager::CreateTableInfo(const CreateTableRequestPB& req,
   metadata->set_version(0);
   metadata->set_next_column_id(ColumnId(schema.max_col_id() + 1));
   metadata->set_num_replicas(req.num_replicas());
+  if (req.has_compaction_policy()) {
+    metadata->set_compaction_policy(req.compaction_policy());
+  }
+  if (req.has_history_max_age_sec()) {
+    metadata->set_history_max_age_sec(req.history_max_age_sec());
+  }
+  if (req.has_row_ttl_column()) {
+    tablet::RowTtlPB* row_ttl = metadata->mutable_row_ttl();
+    row_ttl->set_column_id(schema.column_id(schema.find_column(req.row_ttl_column())));
+    row_ttl->set_ttl_sec(req.row_ttl_sec());
+  }
+  if (req.pin_key_index()) {
+    metadata->set_pin_key_index(true);
+  }
   // Use the Schema object passed in, since it has the column IDs already assigned,
   // whereas the user request PB does not.
   CHECK_OK(SchemaToPB(schema, metadata->mutable_schema()));
@@ -1167,6 +1320,8 @@ Status CatalogManager::ApplyAlterSchemaSteps(const SysTablesEntryPB& current_pb,
         RETURN_NOT_OK(TypeEncodingInfo::Get(new_col.type_info(),
                                             new_col.attributes().encoding,
                                             &dummy));
+        RETURN_NOT_OK(ValidateColumnCompression(new_col));
+        RETURN_NOT_OK(ValidateColumnBloomFilter(new_col));
 
         // can't accept a NOT NULL column without read default
         if (!new_col.is_nullable() && !new_col.has_read_default()) {
@@ -1186,6 +1341,14 @@ Status CatalogManager::ApplyAlterSchemaSteps(const SysTablesEntryPB& current_pb,
         if (cur_schema.is_key_column(step.drop_column().name())) {
           return Status::InvalidArgument("cannot remove a key column");
         }
+        if (current_pb.has_row_ttl()) {
+          Schema partial_schema = builder.Build();
+          int idx = partial_schema.find_column(step.drop_column().name());
+          if (idx != Schema::kColumnNotFound &&
+              partial_schema.column_id(idx) == current_pb.row_ttl().column_id()) {
+            return Status::InvalidArgument("cannot remove the row TTL column");
+          }
+        }
 
         RETURN_NOT_OK(builder.RemoveColumn(step.drop_column().name()));
         break;
@@ -1207,7 +1370,52 @@ Status CatalogManager::ApplyAlterSchemaSteps(const SysTablesEntryPB& current_pb,
         break;
       }
 
-      // TODO: EDIT_COLUMN
+      case AlterTableRequestPB::ALTER_COLUMN: {
+        if (!step.has_alter_column()) {
+          return Status::InvalidArgument("ALTER_COLUMN missing column info");
+        }
+        const AlterTableRequestPB::AlterColumn& alter = step.alter_column();
+
+        // Look the column up in the schema as altered by the previous steps,
+        // in case it was renamed by one of them.
+        Schema partial_schema = builder.Build();
+        int idx = partial_schema.find_column(alter.name());
+        if (idx == Schema::kColumnNotFound) {
+          return Status::NotFound("The specified column does not exist", alter.name());
+        }
+        const ColumnSchema& cur_col = partial_schema.column(idx);
+        ColumnStorageAttributes attributes = cur_col.attributes();
+        if (alter.has_encoding()) {
+          attributes.encoding = alter.encoding();
+        }
+        if (alter.has_compression()) {
+          attributes.compression = alter.compression();
+        }
+        if (alter.has_compression_level()) {
+          attributes.compression_level = alter.compression_level();
+        }
+        if (alter.has_cfile_block_size()) {
+          if (alter.cfile_block_size() < 0) {
+            return Status::InvalidArgument(
+                Substitute("column `$0`: invalid block size $1",
+                           cur_col.name(), alter.cfile_block_size()));
+          }
+          attributes.cfile_block_size = alter.cfile_block_size();
+        }
+
+        // The existing data keeps its old attributes until it is rewritten by
+        // the tablet servers, so only the new ones need validating.
+        ColumnSchema new_col(cur_col.name(), cur_col.type_info()->type(),
+                             cur_col.is_nullable(), nullptr, nullptr, attributes);
+        const TypeEncodingInfo *dummy;
+        RETURN_NOT_OK(TypeEncodingInfo::Get(new_col.type_info(),
+                                            new_col.attributes().encoding,
+                                            &dummy));
+        RETURN_NOT_OK(ValidateColumnCompression(new_col));
+
+        RETURN_NOT_OK(builder.SetColumnStorageAttributes(alter.name(), attributes));
+        break;
+      }
 
       default: {
         return Status::InvalidArgument("Invalid alter schema step type", step.DebugString());
@@ -1319,6 +1527,9 @@ Status CatalogManager::ApplyAlterPartitioningSteps(
           const string& upper_bound = partition.partition_key_end();
 
           // Iter points to the tablet if it exists, or the next tablet, or the end.
+          // Only a tablet covering exactly the bounds is dropped: a partition
+          // whose bounds merely share a start or an end with the step holds
+          // rows outside of it, which would be deleted along with the tablet.
           auto existing_iter = existing_tablets.lower_bound(lower_bound);
           auto new_iter = new_tablets.lower_bound(lower_bound);
 
@@ -1328,12 +1539,12 @@ Status CatalogManager::ApplyAlterPartitioningSteps(
           if (existing_iter != existing_tablets.end()) {
             TabletMetadataLock metadata(existing_iter->second, TabletMetadataLock::READ);
             const auto& partition = metadata.data().pb.partition();
-            found_existing = partition.partition_key_start() == lower_bound ||
+            found_existing = partition.partition_key_start() == lower_bound &&
                              partition.partition_key_end() == upper_bound;
           }
           if (new_iter != new_tablets.end()) {
             const auto& partition = new_iter->second->mutable_metadata()->dirty().pb.partition();
-            found_new = partition.partition_key_start() == lower_bound ||
+            found_new = partition.partition_key_start() == lower_bound &&
                         partition.partition_key_end() == upper_bound;
           }
 
@@ -1381,7 +1592,8 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
     switch (step.type()) {
       case AlterTableRequestPB::ADD_COLUMN:
       case AlterTableRequestPB::DROP_COLUMN:
-      case AlterTableRequestPB::RENAME_COLUMN: {
+      case AlterTableRequestPB::RENAME_COLUMN:
+      case AlterTableRequestPB::ALTER_COLUMN: {
         alter_schema_steps.emplace_back(step);
         break;
       }
@@ -1390,7 +1602,6 @@ Status CatalogManager::AlterTable(const AlterTableRequestPB* req,
         alter_partitioning_steps.emplace_back(step);
         break;
       }
-      case AlterTableRequestPB::ALTER_COLUMN:
       case AlterTableRequestPB::UNKNOWN: {
         return Status::InvalidArgument("Invalid alter step type", step.ShortDebugString());
       }
@@ -1687,6 +1898,66 @@ Status CatalogManager::GetTableSchema(const GetTableSchemaRequestPB* req,
   return Status::OK();
 }
 
+Status CatalogManager::GetTableStatistics(const GetTableStatisticsRequestPB* req,
+                                          GetTableStatisticsResponsePB* resp) {
+  leader_lock_.AssertAcquiredForReading();
+  RETURN_NOT_OK(CheckOnline());
+
+  scoped_refptr<TableInfo> table;
+  RETURN_NOT_OK(FindTable(req->table(), &table));
+  if (table == nullptr) {
+    Status s = Status::NotFound("The table does not exist", req->table().DebugString());
+    SetupError(resp->mutable_error(), MasterErrorPB::TABLE_NOT_FOUND, s);
+    return s;
+  }
+
+  Schema schema;
+  {
+    TableMetadataLock l(table.get(), TableMetadataLock::READ);
+    RETURN_NOT_OK(CheckIfTableDeletedOrNotRunning(&l, resp));
+    RETURN_NOT_OK(SchemaFromPB(l.data().pb.schema(), &schema));
+  }
+
+  vector<scoped_refptr<TabletInfo>> tablets;
+  table->GetAllTablets(&tablets);
+  unordered_map<int32_t, ColumnStatisticsPB> stats_by_id;
+  int num_tablets_reported = 0;
+  for (const scoped_refptr<TabletInfo>& tablet : tablets) {
+    shared_ptr<const TabletStatisticsPB> tablet_stats = tablet->statistics();
+    if (!tablet_stats) {
+      continue;
+    }
+    num_tablets_reported++;
+    for (const ColumnStatisticsPB& col_stats : tablet_stats->columns()) {
+      int col_idx = schema.find_column_by_id(ColumnId(col_stats.column_id()));
+      if (col_idx == Schema::kColumnNotFound) {
+        continue;
+      }
+      Status s = MergeColumnStatistics(schema.column(col_idx).type_info(), col_stats,
+                                       &stats_by_id[col_stats.column_id()]);
+      if (!s.ok()) {
+        LOG(WARNING) << Substitute("Ignoring the statistics of column $0 of tablet $1: $2",
+                                   schema.column(col_idx).name(), tablet->ToString(),
+                                   s.ToString());
+      }
+    }
+  }
+
+  for (int i = 0; i < schema.num_columns(); i++) {
+    ColumnStatisticsPB* col_stats = FindOrNull(stats_by_id, schema.column_id(i));
+    if (!col_stats) {
+      continue;
+    }
+    GetTableStatisticsResponsePB::ColumnEntry* entry = resp->add_columns();
+    entry->set_name(schema.column(i).name());
+    entry->set_type(schema.column(i).type_info()->type());
+    entry->mutable_stats()->Swap(col_stats);
+  }
+  resp->set_num_tablets(tablets.size());
+  resp->set_num_tablets_reported(num_tablets_reported);
+  return Status::OK();
+}
+
 Status CatalogManager::ListTables(const ListTablesRequestPB* req,
                                   ListTablesResponsePB* resp) {
   leader_lock_.AssertAcquiredForReading();
@@ -1770,12 +2041,46 @@ Status CatalogManager::ProcessTabletReport(TSDescriptor* ts_desc,
   // the server should have, compare vs the ones being reported, and somehow mark
   // any that have been "lost" (eg somehow the tablet metadata got corrupted or something).
 
+  // Changed tablets stay write-locked until their batch is written to the sys
+  // catalog, so handle them in tablet ID order to keep concurrent reports from
+  // deadlocking (see the locking rules at the top of the file).
+  vector<const ReportedTabletPB*> sorted_tablets;
+  sorted_tablets.reserve(report.updated_tablets_size());
   for (const ReportedTabletPB& reported : report.updated_tablets()) {
+    sorted_tablets.push_back(&reported);
+  }
+  std::sort(sorted_tablets.begin(), sorted_tablets.end(),
+            [](const ReportedTabletPB* a, const ReportedTabletPB* b) {
+              return a->tablet_id() < b->tablet_id();
+            });
+
+  if (!report.is_incremental()) {
+    ts_desc->ClearTabletLeadership();
+  }
+
+  vector<ReportedTabletChange> changes;
+  const string* prev_tablet_id = nullptr;
+  for (const ReportedTabletPB* reported : sorted_tablets) {
+    if (prev_tablet_id && *prev_tablet_id == reported->tablet_id()) {
+      LOG(WARNING) << "Ignoring duplicate report for tablet " << reported->tablet_id()
+                   << " from " << RequestorString(rpc);
+      continue;
+    }
+    prev_tablet_id = &reported->tablet_id();
+    ts_desc->SetTabletLeadership(
+        reported->tablet_id(),
+        reported->has_committed_consensus_state() &&
+        reported->committed_consensus_state().leader_uuid() == ts_desc->permanent_uuid());
+
     ReportedTabletUpdatesPB *tablet_report = report_update->add_tablets();
-    tablet_report->set_tablet_id(reported.tablet_id());
-    RETURN_NOT_OK_PREPEND(HandleReportedTablet(ts_desc, reported, tablet_report),
-                          Substitute("Error handling $0", reported.ShortDebugString()));
+    tablet_report->set_tablet_id(reported->tablet_id());
+    RETURN_NOT_OK_PREPEND(HandleReportedTablet(ts_desc, *reported, tablet_report, &changes),
+                          Substitute("Error handling $0", reported->ShortDebugString()));
+    if (static_cast<int>(changes.size()) >= FLAGS_catalog_manager_report_batch_size) {
+      RETURN_NOT_OK(PersistReportedTablets(ts_desc, &changes));
+    }
   }
+  RETURN_NOT_OK(PersistReportedTablets(ts_desc, &changes));
 
   if (report.updated_tablets_size() > 0) {
     background_tasks_->WakeIfHasPendingUpdates();
@@ -1804,7 +2109,8 @@ bool ShouldTransitionTabletToRunning(const ReportedTabletPB& report) {
 
 Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
                                             const ReportedTabletPB& report,
-                                            ReportedTabletUpdatesPB *report_updates) {
+                                            ReportedTabletUpdatesPB *report_updates,
+                                            vector<ReportedTabletChange>* changes) {
   TRACE_EVENT1("master", "HandleReportedTablet",
                "tablet_id", report.tablet_id());
   scoped_refptr<TabletInfo> tablet;
@@ -1839,14 +2145,16 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
   // TODO: we don't actually need to do the COW here until we see we're going
   // to change the state. Can we change CowedObject to lazily do the copy?
   TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
-  TabletMetadataLock tablet_lock(tablet.get(), TabletMetadataLock::WRITE);
+  unique_ptr<TabletMetadataLock> tablet_lock(
+      new TabletMetadataLock(tablet.get(), TabletMetadataLock::WRITE));
+  bool tablet_modified = false;
 
   // If the TS is reporting a tablet which has been deleted, or a tablet from
   // a table which has been deleted, send it an RPC to delete it.
-  if (tablet_lock.data().is_deleted() ||
+  if (tablet_lock->data().is_deleted() ||
       table_lock.data().is_deleted()) {
-    report_updates->set_state_msg(tablet_lock.data().pb.state_msg());
-    const string msg = tablet_lock.data().pb.state_msg();
+    report_updates->set_state_msg(tablet_lock->data().pb.state_msg());
+    const string msg = tablet_lock->data().pb.state_msg();
     LOG(INFO) << "Got report from deleted tablet " << tablet->ToString()
               << " (" << msg << "): Sending delete request for this tablet";
     // TODO: Cancel tablet creation, instead of deleting, in cases where
@@ -1860,8 +2168,8 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
   if (!table_lock.data().is_running()) {
     LOG(INFO) << "Got report from tablet " << tablet->tablet_id()
               << " for non-running table " << tablet->table()->ToString() << ": "
-              << tablet_lock.data().pb.state_msg();
-    report_updates->set_state_msg(tablet_lock.data().pb.state_msg());
+              << tablet_lock->data().pb.state_msg();
+    report_updates->set_state_msg(tablet_lock->data().pb.state_msg());
     return Status::OK();
   }
 
@@ -1901,7 +2209,7 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
   // The report will not have a committed_consensus_state if it is in the
   // middle of starting up, such as during tablet bootstrap.
   if (report.has_committed_consensus_state()) {
-    const ConsensusStatePB& prev_cstate = tablet_lock.data().pb.committed_consensus_state();
+    const ConsensusStatePB& prev_cstate = tablet_lock->data().pb.committed_consensus_state();
     ConsensusStatePB cstate = report.committed_consensus_state();
 
     // Check if we got a report from a tablet that is no longer part of the raft
@@ -1929,16 +2237,15 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
     // could incorrectly consider a tablet created when only a minority of its replicas
     // were successful. In that case, the tablet would be stuck in this bad state
     // forever.
-    if (!tablet_lock.data().is_running() && ShouldTransitionTabletToRunning(report)) {
-      DCHECK_EQ(SysTabletsEntryPB::CREATING, tablet_lock.data().pb.state())
+    if (!tablet_lock->data().is_running() && ShouldTransitionTabletToRunning(report)) {
+      DCHECK_EQ(SysTabletsEntryPB::CREATING, tablet_lock->data().pb.state())
           << "Tablet in unexpected state: " << tablet->ToString()
-          << ": " << tablet_lock.data().pb.ShortDebugString();
+          << ": " << tablet_lock->data().pb.ShortDebugString();
       // Mark the tablet as running
-      // TODO: we could batch the IO onto a background thread, or at least
-      // across multiple tablets in the same report.
       VLOG(1) << "Tablet " << tablet->ToString() << " is now online";
-      tablet_lock.mutable_data()->set_state(SysTabletsEntryPB::RUNNING,
-                                            "Tablet reported with an active leader");
+      tablet_lock->mutable_data()->set_state(SysTabletsEntryPB::RUNNING,
+                                             "Tablet reported with an active leader");
+      tablet_modified = true;
     }
 
     // The Master only accepts committed consensus configurations since it needs the committed index
@@ -2000,33 +2307,66 @@ Status CatalogManager::HandleReportedTablet(TSDescriptor* ts_desc,
               << final_report->committed_consensus_state().current_term();
 
       RETURN_NOT_OK(HandleRaftConfigChanged(*final_report, tablet,
-                                            &tablet_lock, &table_lock));
-
+                                            tablet_lock.get(), &table_lock));
+      tablet_modified = true;
     }
   }
 
   table_lock.Unlock();
-  // We update the tablets each time that someone reports it.
-  // This shouldn't be very frequent and should only happen when something in fact changed.
+
+  // Tablets that didn't change have nothing to persist, so their write lock
+  // can be dropped right away. Either way, the follow-up work for the report
+  // is deferred until the caller has persisted the whole batch: it may need
+  // the table's write lock, which must not be acquired while holding the
+  // write locks of other tablets.
+  if (!tablet_modified) {
+    tablet_lock.reset();
+  }
+  ReportedTabletChange change;
+  change.tablet = tablet;
+  change.lock = std::move(tablet_lock);
+  change.report = &report;
+  change.needs_alter = tablet_needs_alter;
+  changes->push_back(std::move(change));
+  return Status::OK();
+}
+
+Status CatalogManager::PersistReportedTablets(TSDescriptor* ts_desc,
+                                              vector<ReportedTabletChange>* changes) {
   SysCatalogTable::Actions actions;
-  actions.tablets_to_update.push_back(tablet.get());
-  Status s = sys_catalog_->Write(actions);
-  if (!s.ok()) {
-    LOG(WARNING) << "Error updating tablets: " << s.ToString() << ". Tablet report was: "
-                 << report.ShortDebugString();
-    return s;
+  for (const ReportedTabletChange& change : *changes) {
+    if (change.lock) {
+      actions.tablets_to_update.push_back(change.tablet.get());
+    }
+  }
+  if (!actions.tablets_to_update.empty()) {
+    Status s = sys_catalog_->Write(actions);
+    if (!s.ok()) {
+      LOG(WARNING) << "Error updating " << actions.tablets_to_update.size()
+                   << " reported tablets: " << s.ToString();
+      // Dropping the locks aborts the mutations.
+      changes->clear();
+      return s;
+    }
+    for (ReportedTabletChange& change : *changes) {
+      if (change.lock) {
+        change.lock->Commit();
+      }
+    }
   }
-  tablet_lock.Commit();
 
   // Need to defer the AlterTable command to after we've committed the new tablet data,
   // since the tablet report may also be updating the raft config, and the Alter Table
   // request needs to know who the most recent leader is.
-  if (tablet_needs_alter) {
-    SendAlterTabletRequest(tablet);
-  } else if (report.has_schema_version()) {
-    HandleTabletSchemaVersionReport(tablet.get(), report.schema_version());
+  for (const ReportedTabletChange& change : *changes) {
+    if (change.needs_alter) {
+      SendAlterTabletRequest(change.tablet);
+    } else if (change.report->has_schema_version()) {
+      HandleTabletSchemaVersionReport(change.tablet.get(), change.report->schema_version());
+    }
+    CompleteReplicaMove(ts_desc, change);
   }
-
+  changes->clear();
   return Status::OK();
 }
 
@@ -2431,6 +2771,18 @@ class AsyncCreateReplica : public RetrySpecificTSRpcTask {
         table_lock.data().pb.partition_schema());
     req_.mutable_config()->CopyFrom(
         tablet_lock.data().pb.committed_consensus_state().config());
+    if (table_lock.data().pb.has_compaction_policy()) {
+      req_.set_compaction_policy(table_lock.data().pb.compaction_policy());
+    }
+    if (table_lock.data().pb.has_history_max_age_sec()) {
+      req_.set_history_max_age_sec(table_lock.data().pb.history_max_age_sec());
+    }
+    if (table_lock.data().pb.has_row_ttl()) {
+      req_.mutable_row_ttl()->CopyFrom(table_lock.data().pb.row_ttl());
+    }
+    if (table_lock.data().pb.pin_key_index()) {
+      req_.set_pin_key_index(true);
+    }
   }
 
   virtual string type_name() const OVERRIDE { return "Create Tablet"; }
@@ -2668,14 +3020,18 @@ bool SelectRandomTSForReplica(const TSDescriptorVector& ts_descs,
 
 class AsyncAddServerTask : public RetryingTSRpcTask {
  public:
+  // If 'dest_uuid' is empty, a random live tablet server which does not
+  // already host a replica is added.
   AsyncAddServerTask(Master *master,
                      const scoped_refptr<TabletInfo>& tablet,
-                     const ConsensusStatePB& cstate)
+                     const ConsensusStatePB& cstate,
+                     string dest_uuid)
     : RetryingTSRpcTask(master,
                         gscoped_ptr<TSPicker>(new PickLeaderReplica(tablet)),
                         tablet->table()),
       tablet_(tablet),
-      cstate_(cstate) {
+      cstate_(cstate),
+      dest_uuid_(std::move(dest_uuid)) {
     deadline_ = MonoTime::Max(); // Never time out.
   }
 
@@ -2699,6 +3055,7 @@ class AsyncAddServerTask : public RetryingTSRpcTask {
 
   const scoped_refptr<TabletInfo> tablet_;
   const ConsensusStatePB cstate_;
+  const string dest_uuid_;
 
   consensus::ChangeConfigRequestPB req_;
   consensus::ChangeConfigResponsePB resp_;
@@ -2725,13 +3082,23 @@ bool AsyncAddServerTask::SendRequest(int attempt) {
   for (const RaftPeerPB& peer : cstate_.config().peers()) {
     InsertOrDie(&replica_uuids, peer.permanent_uuid());
   }
-  TSDescriptorVector ts_descs;
-  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
   shared_ptr<TSDescriptor> replacement_replica;
-  if (PREDICT_FALSE(!SelectRandomTSForReplica(ts_descs, replica_uuids, &replacement_replica))) {
-    KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "No candidate replacement replica found "
-                               << "for tablet " << tablet_->ToString();
-    return false;
+  if (!dest_uuid_.empty()) {
+    if (PREDICT_FALSE(!master_->ts_manager()->LookupTSByUUID(dest_uuid_, &replacement_replica) ||
+                      ContainsKey(replica_uuids, dest_uuid_))) {
+      LOG_WITH_PREFIX(WARNING) << "Cannot add " << dest_uuid_ << " to the config of tablet "
+                               << tablet_->ToString() << ". Aborting task.";
+      MarkAborted();
+      return false;
+    }
+  } else {
+    TSDescriptorVector ts_descs;
+    master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+    if (PREDICT_FALSE(!SelectRandomTSForReplica(ts_descs, replica_uuids, &replacement_replica))) {
+      KLOG_EVERY_N(WARNING, 100) << LogPrefix() << "No candidate replacement replica found "
+                                 << "for tablet " << tablet_->ToString();
+      return false;
+    }
   }
 
   req_.set_dest_uuid(permanent_uuid());
@@ -2785,6 +3152,179 @@ void AsyncAddServerTask::HandleResponse(int attempt) {
   }
 }
 
+class AsyncRemoveServerTask : public RetryingTSRpcTask {
+ public:
+  AsyncRemoveServerTask(Master *master,
+                        const scoped_refptr<TabletInfo>& tablet,
+                        const ConsensusStatePB& cstate,
+                        string peer_uuid)
+    : RetryingTSRpcTask(master,
+                        gscoped_ptr<TSPicker>(new PickLeaderReplica(tablet)),
+                        tablet->table()),
+      tablet_(tablet),
+      cstate_(cstate),
+      peer_uuid_(std::move(peer_uuid)) {
+    deadline_ = MonoTime::Max(); // Never time out.
+  }
+
+  virtual string type_name() const OVERRIDE { return "RemoveServer ChangeConfig"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("RemoveServer ChangeConfig RPC for tablet $0 on peer $1 "
+                      "removing $2 with cas_config_opid_index $3",
+                      tablet_->tablet_id(), permanent_uuid(), peer_uuid_,
+                      cstate_.config().opid_index());
+  }
+
+ protected:
+  virtual bool SendRequest(int attempt) OVERRIDE;
+  virtual void HandleResponse(int attempt) OVERRIDE;
+
+ private:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+  string permanent_uuid() const {
+    return target_ts_desc_->permanent_uuid();
+  }
+
+  const scoped_refptr<TabletInfo> tablet_;
+  const ConsensusStatePB cstate_;
+  const string peer_uuid_;
+
+  consensus::ChangeConfigRequestPB req_;
+  consensus::ChangeConfigResponsePB resp_;
+};
+
+bool AsyncRemoveServerTask::SendRequest(int attempt) {
+  // Bail if the config changed since the task was created; the removal may
+  // no longer be safe.
+  int64_t latest_index;
+  {
+    TabletMetadataLock tablet_lock(tablet_.get(), TabletMetadataLock::READ);
+    latest_index = tablet_lock.data().pb.committed_consensus_state().config().opid_index();
+  }
+  if (latest_index > cstate_.config().opid_index()) {
+    LOG_WITH_PREFIX(INFO) << "Latest config for has opid_index of " << latest_index
+                          << " while this task has opid_index of "
+                          << cstate_.config().opid_index() << ". Aborting task.";
+    MarkAborted();
+    return false;
+  }
+
+  // The leader refuses to remove itself.
+  if (permanent_uuid() == peer_uuid_) {
+    LOG_WITH_PREFIX(INFO) << "Peer " << peer_uuid_ << " to remove is the leader. "
+                          << "Aborting task.";
+    MarkAborted();
+    return false;
+  }
+
+  req_.set_dest_uuid(permanent_uuid());
+  req_.set_tablet_id(tablet_->tablet_id());
+  req_.set_type(consensus::REMOVE_SERVER);
+  req_.set_cas_config_opid_index(cstate_.config().opid_index());
+  req_.mutable_server()->set_permanent_uuid(peer_uuid_);
+  VLOG(1) << "Sending RemoveServer ChangeConfig request to " << permanent_uuid() << ":\n"
+          << req_.DebugString();
+  consensus_proxy_->ChangeConfigAsync(req_, &resp_, &rpc_,
+                                      boost::bind(&AsyncRemoveServerTask::RpcCallback, this));
+  return true;
+}
+
+void AsyncRemoveServerTask::HandleResponse(int attempt) {
+  if (!resp_.has_error()) {
+    MarkComplete();
+    LOG_WITH_PREFIX(INFO) << "Change config succeeded";
+    return;
+  }
+
+  Status status = StatusFromPB(resp_.error().status());
+
+  // Do not retry on a CAS error, otherwise retry forever or until cancelled.
+  switch (resp_.error().code()) {
+    case TabletServerErrorPB::CAS_FAILED:
+      LOG_WITH_PREFIX(WARNING) << "ChangeConfig() failed with leader " << permanent_uuid()
+                               << " due to CAS failure. No further retry: "
+                               << status.ToString();
+      MarkFailed();
+      break;
+    default:
+      LOG_WITH_PREFIX(INFO) << "ChangeConfig() failed with leader " << permanent_uuid()
+                            << " due to error "
+                            << TabletServerErrorPB::Code_Name(resp_.error().code())
+                            << ". This operation will be retried. Error detail: "
+                            << status.ToString();
+      break;
+  }
+}
+
+// Asks the leader replica of a tablet to hand its leadership to another voter.
+// Keeps retrying until the new leader has caught up or the deadline passes.
+class AsyncTransferLeadershipTask : public RetrySpecificTSRpcTask {
+ public:
+  AsyncTransferLeadershipTask(Master* master,
+                              const scoped_refptr<TabletInfo>& tablet,
+                              const string& leader_uuid,
+                              string new_leader_uuid)
+    : RetrySpecificTSRpcTask(master, leader_uuid, tablet->table()),
+      tablet_(tablet),
+      new_leader_uuid_(std::move(new_leader_uuid)) {
+    deadline_ = start_ts_;
+    deadline_.AddDelta(MonoDelta::FromMilliseconds(FLAGS_master_leader_transfer_timeout_ms));
+  }
+
+  virtual string type_name() const OVERRIDE { return "Transfer Leadership"; }
+
+  virtual string description() const OVERRIDE {
+    return Substitute("Transfer Leadership RPC for tablet $0 from $1 to $2",
+                      tablet_->tablet_id(), permanent_uuid_, new_leader_uuid_);
+  }
+
+ protected:
+  virtual string tablet_id() const OVERRIDE { return tablet_->tablet_id(); }
+
+  virtual bool SendRequest(int attempt) OVERRIDE {
+    req_.set_dest_uuid(permanent_uuid_);
+    req_.set_tablet_id(tablet_->tablet_id());
+    req_.set_new_leader_uuid(new_leader_uuid_);
+    VLOG(1) << "Sending leadership transfer request to " << permanent_uuid_
+            << " (attempt " << attempt << "):\n" << req_.DebugString();
+    consensus_proxy_->LeaderStepDownAsync(
+        req_, &resp_, &rpc_, boost::bind(&AsyncTransferLeadershipTask::RpcCallback, this));
+    return true;
+  }
+
+  virtual void HandleResponse(int attempt) OVERRIDE {
+    if (!resp_.has_error()) {
+      LOG_WITH_PREFIX(INFO) << "Transferred leadership to " << new_leader_uuid_;
+      MarkComplete();
+      return;
+    }
+    Status status = StatusFromPB(resp_.error().status());
+    switch (resp_.error().code()) {
+      case TabletServerErrorPB::NOT_THE_LEADER:
+      case TabletServerErrorPB::INVALID_CONFIG:
+      case TabletServerErrorPB::TABLET_NOT_FOUND:
+        LOG_WITH_PREFIX(INFO) << "Leadership transfer to " << new_leader_uuid_
+                              << " is no longer possible. No further retry: "
+                              << status.ToString();
+        MarkFailed();
+        break;
+      default:
+        // Most likely the new leader hasn't caught up yet.
+        VLOG(1) << LogPrefix() << "Leadership transfer to " << new_leader_uuid_
+                << " failed, will retry: " << status.ToString();
+        break;
+    }
+  }
+
+ private:
+  const scoped_refptr<TabletInfo> tablet_;
+  const string new_leader_uuid_;
+
+  consensus::LeaderStepDownRequestPB req_;
+  consensus::LeaderStepDownResponsePB resp_;
+};
+
 void CatalogManager::SendAlterTableRequest(const scoped_refptr<TableInfo>& table) {
   vector<scoped_refptr<TabletInfo> > tablets;
   table->GetAllTablets(&tablets);
@@ -2859,8 +3399,9 @@ void CatalogManager::SendDeleteReplicaRequest(
 }
 
 void CatalogManager::SendAddServerRequest(const scoped_refptr<TabletInfo>& tablet,
-                                          const ConsensusStatePB& cstate) {
-  auto task = new AsyncAddServerTask(master_, tablet, cstate);
+                                          const ConsensusStatePB& cstate,
+                                          const string& dest_uuid) {
+  auto task = new AsyncAddServerTask(master_, tablet, cstate, dest_uuid);
   tablet->table()->AddTask(task);
   WARN_NOT_OK(task->Run(), "Failed to send new AddServer request");
 
@@ -2869,6 +3410,259 @@ void CatalogManager::SendAddServerRequest(const scoped_refptr<TabletInfo>& table
   LOG(INFO) << "Started AddServer task for tablet " << tablet->tablet_id();
 }
 
+void CatalogManager::SendRemoveServerRequest(const scoped_refptr<TabletInfo>& tablet,
+                                             const ConsensusStatePB& cstate,
+                                             const string& peer_uuid) {
+  auto task = new AsyncRemoveServerTask(master_, tablet, cstate, peer_uuid);
+  tablet->table()->AddTask(task);
+  WARN_NOT_OK(task->Run(), "Failed to send new RemoveServer request");
+
+  // As above, 'task' may already have deleted itself.
+  LOG(INFO) << "Started RemoveServer task for tablet " << tablet->tablet_id()
+            << " removing " << peer_uuid;
+}
+
+void CatalogManager::RebalanceReplicas() {
+  if (!FLAGS_master_auto_rebalance) {
+    return;
+  }
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  {
+    std::lock_guard<simple_spinlock> l(moves_lock_);
+    if (last_rebalance_.Initialized() &&
+        now.GetDeltaSince(last_rebalance_).ToMilliseconds() <
+        FLAGS_master_rebalance_interval_ms) {
+      return;
+    }
+    last_rebalance_ = now;
+
+    // Forget about moves which stalled, e.g. because the destination died
+    // while copying the tablet or the config changed under the add task.
+    for (auto it = pending_moves_.begin(); it != pending_moves_.end();) {
+      if (now.GetDeltaSince(it->second.start_time).ToMilliseconds() >
+          FLAGS_master_replica_move_timeout_ms) {
+        LOG(WARNING) << "Replica move of tablet " << it->first << " from "
+                     << it->second.src_uuid << " to " << it->second.dest_uuid
+                     << " timed out";
+        it = pending_moves_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+    if (static_cast<int>(pending_moves_.size()) >= FLAGS_master_max_concurrent_replica_moves) {
+      return;
+    }
+  }
+
+  TSDescriptorVector ts_descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+  if (ts_descs.size() < 2) {
+    return;
+  }
+  unordered_map<string, int> replica_counts;
+  for (const auto& ts : ts_descs) {
+    replica_counts[ts->permanent_uuid()] = 0;
+  }
+
+  vector<scoped_refptr<TabletInfo>> tablets;
+  {
+    shared_lock<LockType> l(lock_);
+    AppendValuesFromMap(tablet_map_, &tablets);
+  }
+
+  // Count the voters hosted by each live tablet server according to the
+  // committed configs of the running tablets.
+  vector<pair<scoped_refptr<TabletInfo>, ConsensusStatePB>> running;
+  for (const auto& tablet : tablets) {
+    TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+    if (!l.data().is_running()) {
+      continue;
+    }
+    const ConsensusStatePB& cstate = l.data().pb.committed_consensus_state();
+    for (const RaftPeerPB& peer : cstate.config().peers()) {
+      if (peer.member_type() == RaftPeerPB::VOTER) {
+        int* count = FindOrNull(replica_counts, peer.permanent_uuid());
+        if (count) {
+          (*count)++;
+        }
+      }
+    }
+    running.emplace_back(tablet, cstate);
+  }
+
+  auto minmax = std::minmax_element(
+      replica_counts.begin(), replica_counts.end(),
+      [](const pair<const string, int>& a, const pair<const string, int>& b) {
+        return a.second < b.second;
+      });
+  const string& dest_uuid = minmax.first->first;
+  const string& src_uuid = minmax.second->first;
+  if (minmax.second->second - minmax.first->second <= 1) {
+    return;
+  }
+
+  // Move a follower replica of a fully replicated tablet. Leaders are left
+  // alone since the leader can't remove itself from the config.
+  for (const auto& entry : running) {
+    const scoped_refptr<TabletInfo>& tablet = entry.first;
+    const ConsensusStatePB& cstate = entry.second;
+    if (!cstate.has_leader_uuid() || cstate.leader_uuid() == src_uuid ||
+        !IsRaftConfigVoter(src_uuid, cstate.config()) ||
+        IsRaftConfigMember(dest_uuid, cstate.config())) {
+      continue;
+    }
+    {
+      TableMetadataLock table_lock(tablet->table().get(), TableMetadataLock::READ);
+      if (CountVoters(cstate.config()) != table_lock.data().pb.num_replicas()) {
+        continue;
+      }
+    }
+    {
+      std::lock_guard<simple_spinlock> l(moves_lock_);
+      ReplicaMove move;
+      move.src_uuid = src_uuid;
+      move.dest_uuid = dest_uuid;
+      move.start_time = now;
+      if (!InsertIfNotPresent(&pending_moves_, tablet->tablet_id(), move)) {
+        continue;
+      }
+    }
+    LOG(INFO) << "Moving replica of tablet " << tablet->tablet_id() << " from "
+              << src_uuid << " (" << minmax.second->second << " replicas) to "
+              << dest_uuid << " (" << minmax.first->second << " replicas)";
+    SendAddServerRequest(tablet, cstate, dest_uuid);
+    return;
+  }
+}
+
+void CatalogManager::RebalanceLeaders() {
+  if (!FLAGS_master_auto_leader_rebalance) {
+    return;
+  }
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  {
+    std::lock_guard<simple_spinlock> l(moves_lock_);
+    if (last_leader_rebalance_.Initialized() &&
+        now.GetDeltaSince(last_leader_rebalance_).ToMilliseconds() <
+        FLAGS_master_leader_rebalance_interval_ms) {
+      return;
+    }
+    last_leader_rebalance_ = now;
+  }
+
+  TSDescriptorVector ts_descs;
+  master_->ts_manager()->GetAllLiveDescriptors(&ts_descs);
+  if (ts_descs.size() < 2) {
+    return;
+  }
+  unordered_map<string, int> leader_counts;
+  for (const auto& ts : ts_descs) {
+    leader_counts[ts->permanent_uuid()] = ts->num_leaders();
+  }
+
+  vector<scoped_refptr<TabletInfo>> tablets;
+  {
+    shared_lock<LockType> l(lock_);
+    AppendValuesFromMap(tablet_map_, &tablets);
+  }
+
+  // Group the running tablets by their current leader.
+  unordered_map<string, vector<pair<scoped_refptr<TabletInfo>, ConsensusStatePB>>> by_leader;
+  for (const auto& tablet : tablets) {
+    TabletMetadataLock l(tablet.get(), TabletMetadataLock::READ);
+    if (!l.data().is_running()) {
+      continue;
+    }
+    const ConsensusStatePB& cstate = l.data().pb.committed_consensus_state();
+    if (cstate.has_leader_uuid() && ContainsKey(leader_counts, cstate.leader_uuid())) {
+      by_leader[cstate.leader_uuid()].emplace_back(tablet, cstate);
+    }
+  }
+
+  // Repeatedly move a leadership from the server with the most leaders to the
+  // server with the fewest leaders among the tablet's other voters.
+  int transfers = 0;
+  while (transfers < FLAGS_master_max_leader_transfers_per_round) {
+    auto src = std::max_element(
+        leader_counts.begin(), leader_counts.end(),
+        [](const pair<const string, int>& a, const pair<const string, int>& b) {
+          return a.second < b.second;
+        });
+    auto& candidates = by_leader[src->first];
+    bool transferred = false;
+    for (auto it = candidates.begin(); it != candidates.end(); ++it) {
+      const ConsensusStatePB& cstate = it->second;
+      const string* dest = nullptr;
+      int dest_count = src->second - 1;
+      for (const RaftPeerPB& peer : cstate.config().peers()) {
+        if (peer.member_type() != RaftPeerPB::VOTER ||
+            peer.permanent_uuid() == src->first) {
+          continue;
+        }
+        const int* count = FindOrNull(leader_counts, peer.permanent_uuid());
+        if (count && *count < dest_count) {
+          dest = &peer.permanent_uuid();
+          dest_count = *count;
+        }
+      }
+      if (!dest) {
+        continue;
+      }
+      LOG(INFO) << "Transferring leadership of tablet " << it->first->tablet_id() << " from "
+                << src->first << " (" << src->second << " leaders) to " << *dest
+                << " (" << dest_count << " leaders)";
+      auto task = new AsyncTransferLeadershipTask(master_, it->first, src->first, *dest);
+      it->first->table()->AddTask(task);
+      WARN_NOT_OK(task->Run(), "Failed to send leadership transfer request");
+      src->second--;
+      leader_counts[*dest]++;
+      candidates.erase(it);
+      transferred = true;
+      break;
+    }
+    if (!transferred) {
+      break;
+    }
+    transfers++;
+  }
+}
+
+void CatalogManager::CompleteReplicaMove(TSDescriptor* ts_desc,
+                                         const ReportedTabletChange& change) {
+  if (change.report->state() != tablet::RUNNING) {
+    return;
+  }
+  const string& tablet_id = change.tablet->tablet_id();
+  ReplicaMove move;
+  {
+    std::lock_guard<simple_spinlock> l(moves_lock_);
+    const ReplicaMove* m = FindOrNull(pending_moves_, tablet_id);
+    if (!m || m->dest_uuid != ts_desc->permanent_uuid()) {
+      return;
+    }
+    move = *m;
+  }
+
+  ConsensusStatePB cstate;
+  {
+    TabletMetadataLock l(change.tablet.get(), TabletMetadataLock::READ);
+    cstate = l.data().pb.committed_consensus_state();
+  }
+  if (!IsRaftConfigVoter(move.dest_uuid, cstate.config())) {
+    // The destination hasn't been added to the committed config yet.
+    return;
+  }
+  if (IsRaftConfigMember(move.src_uuid, cstate.config())) {
+    if (cstate.leader_uuid() == move.src_uuid) {
+      // Wait for leadership to move elsewhere; the move times out otherwise.
+      return;
+    }
+    SendRemoveServerRequest(change.tablet, cstate, move.src_uuid);
+  }
+  std::lock_guard<simple_spinlock> l(moves_lock_);
+  pending_moves_.erase(tablet_id);
+}
+
 void CatalogManager::ExtractTabletsToProcess(
     vector<scoped_refptr<TabletInfo>>* tablets_to_process) {
 
@@ -3179,10 +3973,29 @@ shared_ptr<TSDescriptor> CatalogManager::PickBetterReplicaLocation(
   // we batch the selection process before sending any creation commands to the
   // servers themselves.
   //
-  // TODO: in the future we may want to factor in other items such as available disk space,
-  // actual request load, etc.
-  double load_a = a->RecentReplicaCreations() + a->num_live_replicas();
-  double load_b = b->RecentReplicaCreations() + b->num_live_replicas();
+  // We also consider (3) how much data the server already stores, and (4) how
+  // fast rows are being written to it, as reported in its heartbeats. Each
+  // factor is expressed as the server's share of the pair's combined total,
+  // so that factors with very different units can be weighted against each
+  // other. A small floor is added to each value so that idle or empty servers
+  // don't cause the shares to swing wildly.
+  auto share = [](double x, double y, double floor) {
+    return (x + floor) / (x + y + 2 * floor);
+  };
+  const double kDataSizeFloor = 1024.0 * 1024 * 1024;
+  const double kWriteRateFloor = 1000.0;
+  double load_a = share(a->RecentReplicaCreations() + a->num_live_replicas(),
+                        b->RecentReplicaCreations() + b->num_live_replicas(), 1) +
+      FLAGS_master_placement_data_size_weight *
+      share(a->data_size_bytes(), b->data_size_bytes(), kDataSizeFloor) +
+      FLAGS_master_placement_write_rate_weight *
+      share(a->write_rate(), b->write_rate(), kWriteRateFloor);
+  double load_b = share(b->RecentReplicaCreations() + b->num_live_replicas(),
+                        a->RecentReplicaCreations() + a->num_live_replicas(), 1) +
+      FLAGS_master_placement_data_size_weight *
+      share(b->data_size_bytes(), a->data_size_bytes(), kDataSizeFloor) +
+      FLAGS_master_placement_write_rate_weight *
+      share(b->write_rate(), a->write_rate(), kWriteRateFloor);
   if (load_a < load_b) {
     return a;
   } else if (load_b < load_a) {
@@ -3270,8 +4083,12 @@ void CatalogManager::SelectReplicas(const TSDescriptorVector& ts_descs,
 }
 
 Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
-                                               TabletLocationsPB* locs_pb) {
+                                               TabletLocationsPB* locs_pb,
+                                               uint64_t* metadata_version) {
   TabletMetadataLock l_tablet(tablet.get(), TabletMetadataLock::READ);
+  if (metadata_version) {
+    *metadata_version = tablet->metadata().version();
+  }
   if (PREDICT_FALSE(l_tablet.data().is_deleted())) {
     return Status::NotFound("Tablet deleted", l_tablet.data().pb.state_msg());
   }
@@ -3316,6 +4133,47 @@ Status CatalogManager::BuildLocationsForTablet(const scoped_refptr<TabletInfo>&
   return Status::OK();
 }
 
+Status CatalogManager::GetCachedLocationsForTablet(
+    const scoped_refptr<TabletInfo>& tablet,
+    int64_t registration_generation,
+    shared_ptr<const TabletInfo::CachedLocations>* locations) {
+  // The locations only depend on the tablet's metadata and on tablet server
+  // registrations, so they can be reused until either of those changes.
+  *locations = tablet->GetCachedLocations(tablet->metadata().version(),
+                                          registration_generation);
+  if (*locations) {
+    return Status::OK();
+  }
+
+  auto new_locations = std::make_shared<TabletInfo::CachedLocations>();
+  new_locations->registration_generation = registration_generation;
+  RETURN_NOT_OK(BuildLocationsForTablet(tablet, &new_locations->pb,
+                                        &new_locations->metadata_version));
+  GetTableLocationsResponsePB framed;
+  *framed.add_tablet_locations() = new_locations->pb;
+  framed.SerializeToString(&new_locations->serialized);
+
+  tablet->SetCachedLocations(new_locations);
+  *locations = std::move(new_locations);
+  return Status::OK();
+}
+
+void CatalogManager::ProcessTabletStatistics(
+    const RepeatedPtrField<TabletStatisticsPB>& statistics) {
+  leader_lock_.AssertAcquiredForReading();
+
+  for (const TabletStatisticsPB& tablet_stats : statistics) {
+    scoped_refptr<TabletInfo> tablet;
+    {
+      shared_lock<LockType> l(lock_);
+      if (!FindCopy(tablet_map_, tablet_stats.tablet_id(), &tablet)) {
+        continue;
+      }
+    }
+    tablet->set_statistics(std::make_shared<const TabletStatisticsPB>(tablet_stats));
+  }
+}
+
 Status CatalogManager::GetTabletLocations(const std::string& tablet_id,
                                           TabletLocationsPB* locs_pb) {
   leader_lock_.AssertAcquiredForReading();
@@ -3334,7 +4192,8 @@ Status CatalogManager::GetTabletLocations(const std::string& tablet_id,
 }
 
 Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
-                                         GetTableLocationsResponsePB* resp) {
+                                         GetTableLocationsResponsePB* resp,
+                                         faststring* serialized_locations) {
   leader_lock_.AssertAcquiredForReading();
   RETURN_NOT_OK(CheckOnline());
 
@@ -3363,12 +4222,22 @@ Status CatalogManager::GetTableLocations(const GetTableLocationsRequestPB* req,
   vector<scoped_refptr<TabletInfo> > tablets_in_range;
   table->GetTabletsInRange(req, &tablets_in_range);
 
-  TSRegistrationPB reg;
+  const int64_t registration_generation = master_->ts_manager()->registration_generation();
   for (const scoped_refptr<TabletInfo>& tablet : tablets_in_range) {
-    Status s = BuildLocationsForTablet(tablet, resp->add_tablet_locations());
+    shared_ptr<const TabletInfo::CachedLocations> locations;
+    Status s = GetCachedLocationsForTablet(tablet, registration_generation, &locations);
     if (s.ok()) {
+      if (serialized_locations) {
+        serialized_locations->append(locations->serialized);
+      } else {
+        *resp->add_tablet_locations() = locations->pb;
+      }
       continue;
-    } else if (s.IsNotFound()) {
+    }
+    if (serialized_locations) {
+      serialized_locations->clear();
+    }
+    if (s.IsNotFound()) {
       // The tablet has been deleted; force the client to retry. This is a
       // transient state that only happens with a concurrent drop range
       // partition alter table operation.
@@ -3553,6 +4422,7 @@ INITTED_AND_LEADER_OR_RESPOND(ListTablesResponsePB);
 INITTED_AND_LEADER_OR_RESPOND(ListTabletServersResponsePB);
 INITTED_AND_LEADER_OR_RESPOND(GetTableLocationsResponsePB);
 INITTED_AND_LEADER_OR_RESPOND(GetTableSchemaResponsePB);
+INITTED_AND_LEADER_OR_RESPOND(GetTableStatisticsResponsePB);
 INITTED_AND_LEADER_OR_RESPOND(GetTabletLocationsResponsePB);
 
 #undef INITTED_OR_RESPOND
@@ -3596,6 +4466,32 @@ uint32_t TabletInfo::reported_schema_version() const {
   return reported_schema_version_;
 }
 
+shared_ptr<const TabletInfo::CachedLocations> TabletInfo::GetCachedLocations(
+    uint64_t metadata_version, int64_t registration_generation) const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (cached_locations_ &&
+      cached_locations_->metadata_version == metadata_version &&
+      cached_locations_->registration_generation == registration_generation) {
+    return cached_locations_;
+  }
+  return nullptr;
+}
+
+shared_ptr<const TabletStatisticsPB> TabletInfo::statistics() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return statistics_;
+}
+
+void TabletInfo::set_statistics(shared_ptr<const TabletStatisticsPB> statistics) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  statistics_ = std::move(statistics);
+}
+
+void TabletInfo::SetCachedLocations(shared_ptr<const CachedLocations> locations) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  cached_locations_ = std::move(locations);
+}
+
 std::string TabletInfo::ToString() const {
   return Substitute("$0 (table $1)", tablet_id_,
                     (table_ != nullptr ? table_->ToString() : "MISSING"));
@@ -3622,6 +4518,7 @@ std::string TableInfo::ToString() const {
 
 bool TableInfo::RemoveTablet(const std::string& partition_key_start) {
   std::lock_guard<simple_spinlock> l(lock_);
+  tablet_index_.reset();
   return EraseKeyReturnValuePtr(&tablet_map_, partition_key_start) != nullptr;
 }
 
@@ -3640,6 +4537,7 @@ void TableInfo::AddTablets(const vector<TabletInfo*>& tablets) {
 void TableInfo::AddRemoveTablets(const vector<scoped_refptr<TabletInfo>>& tablets_to_add,
                                  const vector<scoped_refptr<TabletInfo>>& tablets_to_drop) {
   std::lock_guard<simple_spinlock> l(lock_);
+  tablet_index_.reset();
   for (const auto& tablet : tablets_to_drop) {
     const auto& lower_bound = tablet->metadata().state().pb.partition().partition_key_start();
     CHECK(EraseKeyReturnValuePtr(&tablet_map_, lower_bound) != nullptr);
@@ -3650,6 +4548,7 @@ void TableInfo::AddRemoveTablets(const vector<scoped_refptr<TabletInfo>>& tablet
 }
 
 void TableInfo::AddTabletUnlocked(TabletInfo* tablet) {
+  tablet_index_.reset();
   TabletInfo* old = nullptr;
   if (UpdateReturnCopy(&tablet_map_,
                        tablet->metadata().state().pb.partition().partition_key_start(),
@@ -3661,25 +4560,45 @@ void TableInfo::AddTabletUnlocked(TabletInfo* tablet) {
   }
 }
 
+shared_ptr<const TableInfo::TabletIndex> TableInfo::tablet_index() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (PREDICT_FALSE(!tablet_index_)) {
+    // The set of tablets changes rarely compared to how often it's read, so
+    // rebuilding the whole index on the first read after a change is cheap
+    // overall.
+    auto index = std::make_shared<TabletIndex>();
+    index->reserve(tablet_map_.size());
+    for (const auto& e : tablet_map_) {
+      index->emplace_back(e.first, e.second);
+    }
+    tablet_index_ = std::move(index);
+  }
+  return tablet_index_;
+}
+
 void TableInfo::GetTabletsInRange(const GetTableLocationsRequestPB* req,
                                   vector<scoped_refptr<TabletInfo> > *ret) const {
-  std::lock_guard<simple_spinlock> l(lock_);
+  // Search a snapshot of the index so that no lock is held while doing so.
+  shared_ptr<const TabletIndex> index = tablet_index();
   int max_returned_locations = req->max_returned_locations();
 
-  TableInfo::TabletInfoMap::const_iterator it, it_end;
+  auto key_less = [](const string& key, const TabletIndex::value_type& e) {
+    return key < e.first;
+  };
+  TabletIndex::const_iterator it, it_end;
   if (req->has_partition_key_start()) {
-    it = tablet_map_.upper_bound(req->partition_key_start());
-    if (it != tablet_map_.begin()) {
+    it = std::upper_bound(index->begin(), index->end(), req->partition_key_start(), key_less);
+    if (it != index->begin()) {
       --it;
     }
   } else {
-    it = tablet_map_.begin();
+    it = index->begin();
   }
 
   if (req->has_partition_key_end()) {
-    it_end = tablet_map_.upper_bound(req->partition_key_end());
+    it_end = std::upper_bound(it, index->end(), req->partition_key_end(), key_less);
   } else {
-    it_end = tablet_map_.end();
+    it_end = index->end();
   }
 
   int count = 0;
@@ -19,6 +19,7 @@
 
 #include <boost/optional/optional_fwd.hpp>
 #include <map>
+#include <memory>
 #include <set>
 #include <string>
 #include <unordered_map>
@@ -43,6 +44,7 @@
 
 namespace kudu {
 
+class faststring;
 class Schema;
 class ThreadPool;
 class CreateTableStressTest_TestConcurrentCreateTableAndReloadMetadata_Test;
@@ -123,6 +125,32 @@ class TabletInfo : public RefCountedThreadSafe<TabletInfo> {
   // No synchronization needed.
   std::string ToString() const;
 
+  // The tablet's locations as last built for a GetTableLocations response.
+  struct CachedLocations {
+    // The tablet's metadata version and the tablet server registration
+    // generation from which the locations were built.
+    uint64_t metadata_version;
+    int64_t registration_generation;
+
+    TabletLocationsPB pb;
+
+    // 'pb' serialized as the 'tablet_locations' entry of a
+    // GetTableLocationsResponsePB, so that the serialized locations of
+    // several tablets can be concatenated into a response.
+    std::string serialized;
+  };
+
+  // Returns the cached locations if they were built from the given metadata
+  // version and registration generation, or null otherwise.
+  std::shared_ptr<const CachedLocations> GetCachedLocations(
+      uint64_t metadata_version, int64_t registration_generation) const;
+  void SetCachedLocations(std::shared_ptr<const CachedLocations> locations);
+
+  // Accessors for the column statistics last reported by the tablet's
+  // leader, or null if none were reported.
+  std::shared_ptr<const TabletStatisticsPB> statistics() const;
+  void set_statistics(std::shared_ptr<const TabletStatisticsPB> statistics);
+
  private:
   friend class RefCountedThreadSafe<TabletInfo>;
   ~TabletInfo();
@@ -142,6 +170,12 @@ class TabletInfo : public RefCountedThreadSafe<TabletInfo> {
   // Reported schema version (in-memory only).
   uint32_t reported_schema_version_;
 
+  // Cached locations of the tablet's replicas (in-memory only).
+  std::shared_ptr<const CachedLocations> cached_locations_;
+
+  // Reported column statistics (in-memory only).
+  std::shared_ptr<const TabletStatisticsPB> statistics_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletInfo);
 };
 
@@ -181,6 +215,12 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
   typedef PersistentTableInfo cow_state;
   typedef std::map<std::string, TabletInfo*> TabletInfoMap;
 
+  // The table's tablets and their start partition keys, sorted by key.
+  // Once published an index is never modified, so it may be searched
+  // without holding any lock. As with TabletInfoMap, the TabletInfo objects
+  // are owned by the CatalogManager.
+  typedef std::vector<std::pair<std::string, TabletInfo*>> TabletIndex;
+
   explicit TableInfo(std::string table_id);
 
   std::string ToString() const;
@@ -239,6 +279,10 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
     return tablet_map_.size();
   }
 
+  // Returns the current immutable index of the table's tablets, building
+  // it first if the set of tablets changed since it was last published.
+  std::shared_ptr<const TabletIndex> tablet_index() const;
+
  private:
   friend class RefCountedThreadSafe<TableInfo>;
   ~TableInfo();
@@ -251,7 +295,12 @@ class TableInfo : public RefCountedThreadSafe<TableInfo> {
   // The TabletInfo objects are owned by the CatalogManager.
   TabletInfoMap tablet_map_;
 
-  // Protects tablet_map_ and pending_tasks_
+  // Snapshot of 'tablet_map_' handed out to readers, or null if it must be
+  // rebuilt. Mutations of 'tablet_map_' reset it rather than modifying it,
+  // so readers only hold 'lock_' long enough to copy the pointer.
+  mutable std::shared_ptr<const TabletIndex> tablet_index_;
+
+  // Protects tablet_map_, tablet_index_ and pending_tasks_
   mutable simple_spinlock lock_;
 
   CowObject<PersistentTableInfo> metadata_;
@@ -434,14 +483,24 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   Status GetTableSchema(const GetTableSchemaRequestPB* req,
                         GetTableSchemaResponsePB* resp);
 
+  // Get the column statistics of the specified table, merged across the
+  // statistics last reported for its tablets.
+  Status GetTableStatistics(const GetTableStatisticsRequestPB* req,
+                            GetTableStatisticsResponsePB* resp);
+
   // List all the running tables
   Status ListTables(const ListTablesRequestPB* req,
                     ListTablesResponsePB* resp);
 
   // Lookup the tablets contained in the partition range of the request.
   // Returns an error if any of the tablets are not running.
+  //
+  // If 'serialized_locations' is non-null, the tablet locations are appended
+  // to it as a serialized GetTableLocationsResponsePB instead of being added
+  // to 'resp'.
   Status GetTableLocations(const GetTableLocationsRequestPB* req,
-                           GetTableLocationsResponsePB* resp);
+                           GetTableLocationsResponsePB* resp,
+                           faststring* serialized_locations = nullptr);
 
   // Look up the locations of the given tablet. The locations
   // vector is overwritten (not appended to).
@@ -461,6 +520,11 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
                              TabletReportUpdatesPB *report_update,
                              rpc::RpcContext* rpc);
 
+  // Keep the column statistics reported by a tablet server for the tablets
+  // it leads. The statistics of unknown tablets are ignored.
+  void ProcessTabletStatistics(
+      const google::protobuf::RepeatedPtrField<TabletStatisticsPB>& statistics);
+
   SysCatalogTable* sys_catalog() { return sys_catalog_.get(); }
 
   // Dump all of the current state about tables and tablets to the
@@ -504,6 +568,11 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
       const consensus::StartTabletCopyRequestPB& req,
       boost::optional<kudu::tserver::TabletServerErrorPB::Code>* error_code) OVERRIDE;
 
+  // The master's tablet does not batch its heartbeats.
+  virtual consensus::HeartbeatBatcher* heartbeat_batcher() const OVERRIDE {
+    return nullptr;
+  }
+
   // Returns this CatalogManager's role in a consensus configuration. CatalogManager
   // must be initialized before calling this method.
   consensus::RaftPeerPB::Role Role() const;
@@ -572,17 +641,54 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // Builds the TabletLocationsPB for a tablet based on the provided TabletInfo.
   // Populates locs_pb and returns true on success.
   // Returns Status::ServiceUnavailable if tablet is not running.
+  //
+  // If 'metadata_version' is non-null, it is set to the version of the
+  // tablet metadata that the locations were built from.
   Status BuildLocationsForTablet(const scoped_refptr<TabletInfo>& tablet,
-                                 TabletLocationsPB* locs_pb);
+                                 TabletLocationsPB* locs_pb,
+                                 uint64_t* metadata_version = nullptr);
+
+  // Like BuildLocationsForTablet(), but reuses the locations cached in the
+  // tablet if they are still current, caching newly built locations otherwise.
+  // 'registration_generation' must have been read from the TSManager before
+  // calling.
+  Status GetCachedLocationsForTablet(
+      const scoped_refptr<TabletInfo>& tablet,
+      int64_t registration_generation,
+      std::shared_ptr<const TabletInfo::CachedLocations>* locations);
 
   Status FindTable(const TableIdentifierPB& table_identifier,
                    scoped_refptr<TableInfo>* table_info);
 
+  // A tablet handled as part of a tablet report, along with the work that
+  // remains once any change to its metadata has been persisted.
+  struct ReportedTabletChange {
+    scoped_refptr<TabletInfo> tablet;
+
+    // Write lock on the tablet's modified metadata, or null if the report
+    // left the metadata unchanged.
+    std::unique_ptr<TabletMetadataLock> lock;
+
+    const ReportedTabletPB* report;
+    bool needs_alter;
+  };
+
   // Handle one of the tablets in a tablet reported.
   // Requires that the lock is already held.
+  //
+  // Unless the report is rejected, appends an entry to 'changes' which must
+  // later be passed to PersistReportedTablets().
   Status HandleReportedTablet(TSDescriptor* ts_desc,
                               const ReportedTabletPB& report,
-                              ReportedTabletUpdatesPB *report_updates);
+                              ReportedTabletUpdatesPB *report_updates,
+                              std::vector<ReportedTabletChange>* changes);
+
+  // Writes the modified tablets in 'changes' to the sys catalog in a single
+  // batch, commits them, and sends any follow-up requests. Clears 'changes'.
+  //
+  // 'ts_desc' is the tablet server which sent the report.
+  Status PersistReportedTablets(TSDescriptor* ts_desc,
+                                std::vector<ReportedTabletChange>* changes);
 
   Status HandleRaftConfigChanged(const ReportedTabletPB& report,
                                  const scoped_refptr<TabletInfo>& tablet,
@@ -694,8 +800,35 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
 
   // Start a task to change the config to add an additional voter because the
   // specified tablet is under-replicated.
+  //
+  // If 'dest_uuid' is empty, the new voter is picked at random among the live
+  // tablet servers which do not already host a replica.
   void SendAddServerRequest(const scoped_refptr<TabletInfo>& tablet,
-                            const consensus::ConsensusStatePB& cstate);
+                            const consensus::ConsensusStatePB& cstate,
+                            const std::string& dest_uuid = "");
+
+  // Start a task to change the config to remove the voter 'peer_uuid' from the
+  // specified tablet.
+  void SendRemoveServerRequest(const scoped_refptr<TabletInfo>& tablet,
+                               const consensus::ConsensusStatePB& cstate,
+                               const std::string& peer_uuid);
+
+  // If auto-rebalancing is enabled, starts moving a replica from the tablet
+  // server hosting the most replicas to the one hosting the fewest, unless
+  // the cluster is already balanced or too many moves are in progress.
+  //
+  // A move first adds the destination as a voter; once the destination reports
+  // the replica as running, CompleteReplicaMove() removes the source.
+  void RebalanceReplicas();
+
+  // If leader rebalancing is enabled, transfers tablet leaderships away from
+  // the tablet servers which lead the most tablets, to other voters of the
+  // same tablets which lead fewer.
+  void RebalanceLeaders();
+
+  // Finishes the replica move of 'change', if any, once its destination
+  // 'ts_desc' has reported the new replica as running.
+  void CompleteReplicaMove(TSDescriptor* ts_desc, const ReportedTabletChange& change);
 
   std::string GenerateId() { return oid_generator_.Next(); }
 
@@ -740,6 +873,28 @@ class CatalogManager : public tserver::TabletPeerLookupIf {
   // Random number generator used for selecting replica locations.
   ThreadSafeRandom rng_;
 
+  // A replica being moved from one tablet server to another by the rebalancer.
+  struct ReplicaMove {
+    std::string src_uuid;
+    std::string dest_uuid;
+    MonoTime start_time;
+  };
+
+  // Lock protecting pending_moves_, last_rebalance_ and
+  // last_leader_rebalance_.
+  simple_spinlock moves_lock_;
+
+  // Replica moves in progress, keyed by tablet ID. Moves are only tracked in
+  // memory: a move interrupted by a master failover leaves the tablet with an
+  // extra replica.
+  std::unordered_map<std::string, ReplicaMove> pending_moves_;
+
+  // When RebalanceReplicas() last looked for a replica to move.
+  MonoTime last_rebalance_;
+
+  // When RebalanceLeaders() last looked for leaderships to transfer.
+  MonoTime last_leader_rebalance_;
+
   gscoped_ptr<SysCatalogTable> sys_catalog_;
 
   // Background thread, used to execute the catalog manager tasks
@@ -242,6 +242,28 @@ TEST_F(MasterTest, TestRegisterAndHeartbeat) {
     ASSERT_TRUE(resp.has_tablet_report());
   }
 
+  // Tablets in a report are handled in tablet ID order, and a tablet listed
+  // more than once is only handled once.
+  {
+    TSHeartbeatRequestPB req;
+    TSHeartbeatResponsePB resp;
+    RpcController rpc;
+    req.mutable_common()->CopyFrom(common);
+    TabletReportPB* tr = req.mutable_tablet_report();
+    tr->set_is_incremental(false);
+    tr->set_sequence_number(1);
+    for (const char* tablet_id : { "tablet-b", "tablet-a", "tablet-b" }) {
+      tr->add_updated_tablets()->set_tablet_id(tablet_id);
+    }
+    ASSERT_OK(proxy_->TSHeartbeat(req, &resp, &rpc));
+
+    ASSERT_TRUE(resp.leader_master());
+    ASSERT_FALSE(resp.has_full_tablet_report_retry_ms());
+    ASSERT_EQ(2, resp.tablet_report().tablets_size());
+    ASSERT_EQ("tablet-a", resp.tablet_report().tablets(0).tablet_id());
+    ASSERT_EQ("tablet-b", resp.tablet_report().tablets(1).tablet_id());
+  }
+
   // Having sent a full report, an incremental report will also be processed.
   {
     TSHeartbeatRequestPB req;
@@ -17,8 +17,10 @@
 
 #include "kudu/master/master_service.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -28,8 +30,11 @@
 #include "kudu/master/ts_descriptor.h"
 #include "kudu/master/ts_manager.h"
 #include "kudu/rpc/rpc_context.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/webserver.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/random_util.h"
 
 
 DEFINE_int32(master_inject_latency_on_tablet_lookups_ms, 0,
@@ -38,6 +43,20 @@ DEFINE_int32(master_inject_latency_on_tablet_lookups_ms, 0,
 TAG_FLAG(master_inject_latency_on_tablet_lookups_ms, unsafe);
 TAG_FLAG(master_inject_latency_on_tablet_lookups_ms, hidden);
 
+DEFINE_int32(master_max_concurrent_full_tablet_reports, 8,
+             "Maximum number of full tablet reports that the leader master "
+             "processes at once. Tablet servers whose full reports arrive "
+             "beyond this limit are asked to resend them later, so that a "
+             "newly elected leader isn't overwhelmed by every tablet server "
+             "reporting at the same time. 0 means no limit.");
+TAG_FLAG(master_max_concurrent_full_tablet_reports, advanced);
+
+DEFINE_int32(master_full_tablet_report_retry_ms, 1000,
+             "Minimum time that a tablet server whose full tablet report was "
+             "deferred waits before resending it. The actual delay is randomized "
+             "between this value and twice this value.");
+TAG_FLAG(master_full_tablet_report_retry_ms, advanced);
+
 namespace kudu {
 namespace master {
 
@@ -64,7 +83,11 @@ void CheckRespErrorOrSetUnknown(const Status& s, RespClass* resp) {
 
 MasterServiceImpl::MasterServiceImpl(Master* server)
   : MasterServiceIf(server->metric_entity(), server->result_tracker()),
-    server_(server) {
+    server_(server),
+    rng_(GetRandomSeed32()) {
+  if (FLAGS_master_max_concurrent_full_tablet_reports > 0) {
+    full_report_slots_.reset(new Semaphore(FLAGS_master_max_concurrent_full_tablet_reports));
+  }
 }
 
 void MasterServiceImpl::Ping(const PingRequestPB* req,
@@ -128,9 +151,29 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
   // 4. Update tserver soft state based on the heartbeat contents.
   ts_desc->UpdateHeartbeatTime();
   ts_desc->set_num_live_replicas(req->num_live_tablets());
+  if (req->has_load()) {
+    ts_desc->UpdateLoad(req->load());
+  }
 
   // 5. Only leaders handle tablet reports.
   if (is_leader_master && req->has_tablet_report()) {
+    // Full reports are expensive to process, and after a master election
+    // every tablet server sends one. Rather than queueing them all up, defer
+    // those beyond the concurrency limit and have their senders retry later.
+    std::unique_lock<Semaphore> report_slot;
+    if (full_report_slots_ && !req->tablet_report().is_incremental()) {
+      report_slot = std::unique_lock<Semaphore>(*full_report_slots_, std::try_to_lock);
+      if (!report_slot.owns_lock()) {
+        int32_t retry_ms = FLAGS_master_full_tablet_report_retry_ms;
+        retry_ms += rng_.Uniform(std::max(retry_ms, 1));
+        VLOG(1) << Substitute("Deferring full tablet report from $0 for $1 ms",
+                              rpc->requestor_string(), retry_ms);
+        resp->set_needs_full_tablet_report(true);
+        resp->set_full_tablet_report_retry_ms(retry_ms);
+        rpc->RespondSuccess();
+        return;
+      }
+    }
     Status s = server_->catalog_manager()->ProcessTabletReport(
         ts_desc.get(), req->tablet_report(), resp->mutable_tablet_report(), rpc);
     if (!s.ok()) {
@@ -139,6 +182,11 @@ void MasterServiceImpl::TSHeartbeat(const TSHeartbeatRequestPB* req,
     }
   }
 
+  // 6. Only leaders keep the column statistics of the tablets.
+  if (is_leader_master && req->tablet_statistics_size() > 0) {
+    server_->catalog_manager()->ProcessTabletStatistics(req->tablet_statistics());
+  }
+
   rpc->RespondSuccess();
 }
 
@@ -261,8 +309,21 @@ void MasterServiceImpl::GetTableLocations(const GetTableLocationsRequestPB* req,
   if (PREDICT_FALSE(FLAGS_master_inject_latency_on_tablet_lookups_ms > 0)) {
     SleepFor(MonoDelta::FromMilliseconds(FLAGS_master_inject_latency_on_tablet_lookups_ms));
   }
-  Status s = server_->catalog_manager()->GetTableLocations(req, resp);
+  // Clients that accept a sidecar get the cached, already serialized
+  // locations as is, saving the master from serializing them again.
+  gscoped_ptr<faststring> serialized_locations;
+  if (req->allow_locations_sidecar()) {
+    serialized_locations.reset(new faststring());
+  }
+  Status s = server_->catalog_manager()->GetTableLocations(req, resp,
+                                                           serialized_locations.get());
   CheckRespErrorOrSetUnknown(s, resp);
+  if (s.ok() && serialized_locations && serialized_locations->size() > 0) {
+    int idx;
+    CHECK_OK(rpc->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(std::move(serialized_locations))), &idx));
+    resp->set_tablet_locations_sidecar(idx);
+  }
   rpc->RespondSuccess();
 }
 
@@ -279,6 +340,19 @@ void MasterServiceImpl::GetTableSchema(const GetTableSchemaRequestPB* req,
   rpc->RespondSuccess();
 }
 
+void MasterServiceImpl::GetTableStatistics(const GetTableStatisticsRequestPB* req,
+                                           GetTableStatisticsResponsePB* resp,
+                                           rpc::RpcContext* rpc) {
+  CatalogManager::ScopedLeaderSharedLock l(server_->catalog_manager());
+  if (!l.CheckIsInitializedAndIsLeaderOrRespond(resp, rpc)) {
+    return;
+  }
+
+  Status s = server_->catalog_manager()->GetTableStatistics(req, resp);
+  CheckRespErrorOrSetUnknown(s, resp);
+  rpc->RespondSuccess();
+}
+
 void MasterServiceImpl::ListTabletServers(const ListTabletServersRequestPB* req,
                                           ListTabletServersResponsePB* resp,
                                           rpc::RpcContext* rpc) {
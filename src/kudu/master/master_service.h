@@ -17,9 +17,12 @@
 #ifndef KUDU_MASTER_MASTER_SERVICE_H
 #define KUDU_MASTER_MASTER_SERVICE_H
 
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/master/master.service.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/random.h"
+#include "kudu/util/semaphore.h"
 
 namespace kudu {
 
@@ -72,6 +75,9 @@ class MasterServiceImpl : public MasterServiceIf {
   virtual void GetTableSchema(const GetTableSchemaRequestPB* req,
                               GetTableSchemaResponsePB* resp,
                               rpc::RpcContext* rpc) OVERRIDE;
+  virtual void GetTableStatistics(const GetTableStatisticsRequestPB* req,
+                                  GetTableStatisticsResponsePB* resp,
+                                  rpc::RpcContext* rpc) OVERRIDE;
   virtual void ListTabletServers(const ListTabletServersRequestPB* req,
                                  ListTabletServersResponsePB* resp,
                                  rpc::RpcContext* rpc) OVERRIDE;
@@ -89,6 +95,13 @@ class MasterServiceImpl : public MasterServiceIf {
  private:
   Master* server_;
 
+  // Limits the number of full tablet reports processed at once, or null if
+  // there is no limit. See --master_max_concurrent_full_tablet_reports.
+  gscoped_ptr<Semaphore> full_report_slots_;
+
+  // Used to spread out the retries of deferred full tablet reports.
+  ThreadSafeRandom rng_;
+
   DISALLOW_COPY_AND_ASSIGN(MasterServiceImpl);
 };
 
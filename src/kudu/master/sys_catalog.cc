@@ -17,6 +17,9 @@
 
 #include "kudu/master/sys_catalog.h"
 
+#include <algorithm>
+#include <functional>
+
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
@@ -51,6 +54,11 @@ DEFINE_double(sys_catalog_fail_during_write, 0.0,
               "Fraction of the time when system table writes will fail");
 TAG_FLAG(sys_catalog_fail_during_write, unsafe);
 
+DEFINE_int32(sys_catalog_load_threads, 4,
+             "Number of threads which parse the tablet entries of the system catalog "
+             "while a newly elected leader master loads them into memory.");
+TAG_FLAG(sys_catalog_load_threads, advanced);
+
 using kudu::consensus::CONSENSUS_CONFIG_COMMITTED;
 using kudu::consensus::ConsensusMetadata;
 using kudu::consensus::RaftConfigPB;
@@ -64,6 +72,7 @@ using kudu::tserver::WriteRequestPB;
 using kudu::tserver::WriteResponsePB;
 using std::shared_ptr;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 namespace kudu {
@@ -82,7 +91,11 @@ SysCatalogTable::SysCatalogTable(Master* master, MetricRegistry* metrics,
     : metric_registry_(metrics),
       master_(master),
       leader_cb_(std::move(leader_cb)) {
+  CHECK_OK(ThreadPoolBuilder("prepare").set_max_threads(1).Build(&prepare_pool_));
   CHECK_OK(ThreadPoolBuilder("apply").Build(&apply_pool_));
+  CHECK_OK(ThreadPoolBuilder("catalog-load")
+           .set_max_threads(std::max(FLAGS_sys_catalog_load_threads, 1))
+           .Build(&load_pool_));
 }
 
 SysCatalogTable::~SysCatalogTable() {
@@ -92,7 +105,9 @@ void SysCatalogTable::Shutdown() {
   if (tablet_peer_) {
     tablet_peer_->Shutdown();
   }
+  prepare_pool_->Shutdown();
   apply_pool_->Shutdown();
+  load_pool_->Shutdown();
 }
 
 Status SysCatalogTable::Load(FsManager *fs_manager) {
@@ -258,6 +273,7 @@ Status SysCatalogTable::SetupTablet(const scoped_refptr<tablet::TabletMetadata>&
   tablet_peer_.reset(new TabletPeer(
       metadata,
       local_peer_pb_,
+      prepare_pool_.get(),
       apply_pool_.get(),
       Bind(&SysCatalogTable::SysCatalogStateChanged, Unretained(this), metadata->tablet_id())));
 
@@ -280,6 +296,7 @@ Status SysCatalogTable::SetupTablet(const scoped_refptr<tablet::TabletMetadata>&
   RETURN_NOT_OK_PREPEND(tablet_peer_->Init(tablet,
                                            scoped_refptr<server::Clock>(master_->clock()),
                                            master_->messenger(),
+                                           nullptr,
                                            scoped_refptr<rpc::ResultTracker>(),
                                            log,
                                            tablet->GetMetricEntity()),
@@ -554,27 +571,27 @@ Status SysCatalogTable::ReqDeleteTablets(WriteRequestPB* req,
   return Status::OK();
 }
 
-Status SysCatalogTable::VisitTabletFromRow(const RowBlockRow& row, TabletVisitor *visitor) {
-  const Slice *tablet_id =
+Status SysCatalogTable::ParseTabletFromRow(const RowBlockRow& row,
+                                           std::string* tablet_id,
+                                           SysTabletsEntryPB* metadata) const {
+  const Slice *id =
     schema_.ExtractColumnFromRow<STRING>(row, schema_.find_column(kSysCatalogTableColId));
   const Slice *data =
     schema_.ExtractColumnFromRow<STRING>(row, schema_.find_column(kSysCatalogTableColMetadata));
 
-  SysTabletsEntryPB metadata;
-  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(&metadata, data->data(), data->size()),
-                        "Unable to parse metadata field for tablet " + tablet_id->ToString());
+  *tablet_id = id->ToString();
+  RETURN_NOT_OK_PREPEND(pb_util::ParseFromArray(metadata, data->data(), data->size()),
+                        "Unable to parse metadata field for tablet " + *tablet_id);
 
   // Upgrade from the deprecated start/end-key fields to the 'partition' field.
-  if (!metadata.has_partition()) {
-    metadata.mutable_partition()->set_partition_key_start(
-        metadata.deprecated_start_key());
-    metadata.mutable_partition()->set_partition_key_end(
-        metadata.deprecated_end_key());
-    metadata.clear_deprecated_start_key();
-    metadata.clear_deprecated_end_key();
+  if (!metadata->has_partition()) {
+    metadata->mutable_partition()->set_partition_key_start(
+        metadata->deprecated_start_key());
+    metadata->mutable_partition()->set_partition_key_end(
+        metadata->deprecated_end_key());
+    metadata->clear_deprecated_start_key();
+    metadata->clear_deprecated_end_key();
   }
-
-  RETURN_NOT_OK(visitor->VisitTablet(metadata.table_id(), tablet_id->ToString(), metadata));
   return Status::OK();
 }
 
@@ -592,14 +609,53 @@ Status SysCatalogTable::VisitTablets(TabletVisitor* visitor) {
   RETURN_NOT_OK(tablet_peer_->tablet()->NewRowIterator(schema_, &iter));
   RETURN_NOT_OK(iter->Init(&spec));
 
+  // Parsing the entries takes most of the time, so each block's are parsed
+  // in parallel, in as many chunks as there are load threads. The visitor is
+  // then called on them in order, from this thread.
+  const int num_chunks = std::max(FLAGS_sys_catalog_load_threads, 1);
+  vector<int> selected_rows;
+  vector<std::string> tablet_ids;
+  vector<SysTabletsEntryPB> entries;
+  vector<Status> chunk_statuses(num_chunks);
+
   Arena arena(32 * 1024, 256 * 1024);
   RowBlock block(iter->schema(), 512, &arena);
   while (iter->HasNext()) {
     RETURN_NOT_OK(iter->NextBlock(&block));
+    selected_rows.clear();
     for (size_t i = 0; i < block.nrows(); i++) {
-      if (!block.selection_vector()->IsRowSelected(i)) continue;
+      if (block.selection_vector()->IsRowSelected(i)) {
+        selected_rows.push_back(i);
+      }
+    }
+    const int num_rows = selected_rows.size();
+    tablet_ids.resize(num_rows);
+    entries.resize(num_rows);
+
+    auto parse_chunk = [&](int chunk) {
+      Status s;
+      for (int i = chunk; i < num_rows && s.ok(); i += num_chunks) {
+        entries[i].Clear();
+        s = ParseTabletFromRow(block.row(selected_rows[i]), &tablet_ids[i], &entries[i]);
+      }
+      chunk_statuses[chunk] = s;
+    };
+    if (num_chunks == 1 || num_rows < num_chunks) {
+      for (int chunk = 0; chunk < num_chunks; chunk++) {
+        parse_chunk(chunk);
+      }
+    } else {
+      for (int chunk = 0; chunk < num_chunks; chunk++) {
+        RETURN_NOT_OK(load_pool_->SubmitFunc(std::bind(parse_chunk, chunk)));
+      }
+      load_pool_->Wait();
+    }
+    for (const Status& s : chunk_statuses) {
+      RETURN_NOT_OK(s);
+    }
 
-      RETURN_NOT_OK(VisitTabletFromRow(block.row(i), visitor));
+    for (int i = 0; i < num_rows; i++) {
+      RETURN_NOT_OK(visitor->VisitTablet(entries[i].table_id(), tablet_ids[i], entries[i]));
     }
   }
   return Status::OK();
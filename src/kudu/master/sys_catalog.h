@@ -173,7 +173,12 @@ class SysCatalogTable {
   Status AddTabletsToPB(const std::vector<TabletInfo*>& tablets,
                         RowOperationsPB::Type op_type,
                         RowOperationsPB* ops) const;
-  Status VisitTabletFromRow(const RowBlockRow& row, TabletVisitor* visitor);
+  // Decodes the ID and the metadata of the tablet entry at 'row'.
+  //
+  // Thread-safe: VisitTablets() calls it from its load threads.
+  Status ParseTabletFromRow(const RowBlockRow& row,
+                            std::string* tablet_id,
+                            SysTabletsEntryPB* metadata) const;
 
   // Initializes the RaftPeerPB for the local peer.
   // Crashes due to an invariant check if the rpc server is not running.
@@ -201,7 +206,10 @@ class SysCatalogTable {
 
   MetricRegistry* metric_registry_;
 
+  gscoped_ptr<ThreadPool> prepare_pool_;
   gscoped_ptr<ThreadPool> apply_pool_;
+  // Parses the tablet entries in VisitTablets().
+  gscoped_ptr<ThreadPool> load_pool_;
 
   scoped_refptr<tablet::TabletPeer> tablet_peer_;
 
@@ -49,7 +49,10 @@ TSDescriptor::TSDescriptor(std::string perm_id)
       last_heartbeat_(MonoTime::Now(MonoTime::FINE)),
       recent_replica_creations_(0),
       last_replica_creations_decay_(MonoTime::Now(MonoTime::FINE)),
-      num_live_replicas_(0) {
+      num_live_replicas_(0),
+      data_size_bytes_(0),
+      rows_written_(0),
+      write_rate_(0) {
 }
 
 TSDescriptor::~TSDescriptor() {
@@ -139,6 +142,40 @@ double TSDescriptor::RecentReplicaCreations() {
   return recent_replica_creations_;
 }
 
+void TSDescriptor::SetTabletLeadership(const string& tablet_id, bool is_leader) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (is_leader) {
+    led_tablets_.insert(tablet_id);
+  } else {
+    led_tablets_.erase(tablet_id);
+  }
+}
+
+void TSDescriptor::ClearTabletLeadership() {
+  std::lock_guard<simple_spinlock> l(lock_);
+  led_tablets_.clear();
+}
+
+void TSDescriptor::UpdateLoad(const TSLoadPB& load) {
+  // Weight of the latest sample in the write rate average.
+  const double kWriteRateAlpha = 0.25;
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+
+  std::lock_guard<simple_spinlock> l(lock_);
+  data_size_bytes_ = load.data_size_bytes();
+  // The counter restarts from zero when the server restarts; skip the sample
+  // rather than recording a negative rate.
+  if (last_load_update_.Initialized() && load.rows_written() >= rows_written_) {
+    double secs = now.GetDeltaSince(last_load_update_).ToSeconds();
+    if (secs > 0) {
+      double rate = (load.rows_written() - rows_written_) / secs;
+      write_rate_ += kWriteRateAlpha * (rate - write_rate_);
+    }
+  }
+  rows_written_ = load.rows_written();
+  last_load_update_ = now;
+}
+
 void TSDescriptor::GetRegistration(TSRegistrationPB* reg) const {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK(registration_) << "No registration";
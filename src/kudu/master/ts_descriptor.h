@@ -20,6 +20,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_set>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/locks.h"
@@ -46,6 +47,7 @@ class TabletServerAdminServiceProxy;
 
 namespace master {
 
+class TSLoadPB;
 class TSRegistrationPB;
 
 // Master-side view of a single tablet server.
@@ -112,6 +114,36 @@ class TSDescriptor {
     return num_live_replicas_;
   }
 
+  // Record whether the tablet server reported itself as the leader of
+  // 'tablet_id' in its latest report for that tablet.
+  void SetTabletLeadership(const std::string& tablet_id, bool is_leader);
+
+  // Forget all recorded leaderships, ahead of a full tablet report.
+  void ClearTabletLeadership();
+
+  // Return the number of tablets the server last reported leading.
+  int num_leaders() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return led_tablets_.size();
+  }
+
+  // Update the load statistics from the tablet server's latest heartbeat.
+  void UpdateLoad(const TSLoadPB& load);
+
+  // Return the estimated on-disk size of the server's replicas, from the
+  // last heartbeat.
+  int64_t data_size_bytes() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return data_size_bytes_;
+  }
+
+  // Return the smoothed rate at which rows are written to the server's
+  // replicas, in rows per second.
+  double write_rate() const {
+    std::lock_guard<simple_spinlock> l(lock_);
+    return write_rate_;
+  }
+
  private:
   FRIEND_TEST(TestTSDescriptor, TestReplicaCreationsDecay);
 
@@ -138,6 +170,17 @@ class TSDescriptor {
   // The number of live replicas on this host, from the last heartbeat.
   int num_live_replicas_;
 
+  // IDs of the tablets which the server last reported leading.
+  std::unordered_set<std::string> led_tablets_;
+
+  // The server's load, from the last heartbeat. 'write_rate_' is an
+  // exponentially weighted moving average computed from the change in
+  // 'rows_written_' between heartbeats.
+  int64_t data_size_bytes_;
+  int64_t rows_written_;
+  double write_rate_;
+  MonoTime last_load_update_;
+
   gscoped_ptr<TSRegistrationPB> registration_;
 
   std::shared_ptr<tserver::TabletServerAdminServiceProxy> ts_admin_proxy_;
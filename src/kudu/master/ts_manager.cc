@@ -40,7 +40,8 @@ using strings::Substitute;
 namespace kudu {
 namespace master {
 
-TSManager::TSManager() {
+TSManager::TSManager()
+  : registration_generation_(0) {
 }
 
 TSManager::~TSManager() {
@@ -90,6 +91,7 @@ Status TSManager::RegisterTS(const NodeInstancePB& instance,
                             instance.ShortDebugString());
     desc->swap(found);
   }
+  registration_generation_.fetch_add(1, std::memory_order_release);
 
   return Status::OK();
 }
@@ -17,6 +17,8 @@
 #ifndef KUDU_MASTER_TS_MANAGER_H
 #define KUDU_MASTER_TS_MANAGER_H
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -84,9 +86,18 @@ class TSManager {
   // Get the TS count.
   int GetCount() const;
 
+  // Returns a counter that is incremented every time a tablet server
+  // registers or re-registers. Anything derived from tablet server
+  // registrations may be cached as long as this value is unchanged.
+  int64_t registration_generation() const {
+    return registration_generation_.load(std::memory_order_acquire);
+  }
+
  private:
   mutable rw_spinlock lock_;
 
+  std::atomic<int64_t> registration_generation_;
+
   typedef std::unordered_map<
     std::string, std::shared_ptr<TSDescriptor> > TSDescriptorMap;
   TSDescriptorMap servers_by_id_;
@@ -0,0 +1,85 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "kudu/rpc/buffer_pool.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(rpc_buffer_pool_capacity_bytes);
+
+namespace kudu {
+namespace rpc {
+
+class BufferPoolTest : public KuduTest {
+};
+
+TEST_F(BufferPoolTest, TestReuse) {
+  BufferPool pool;
+  std::shared_ptr<MemTracker> tracker = MemTracker::FindOrCreateTracker(-1, "rpc_buffer_pools");
+  int64_t initial_consumption = tracker->consumption();
+
+  // Buffers are sized to the whole size class.
+  gscoped_ptr<faststring> buf = pool.Acquire(3000);
+  ASSERT_EQ(0, buf->size());
+  ASSERT_EQ(4096, buf->capacity());
+  uint8_t* data = buf->data();
+  buf->resize(3000);
+
+  pool.Release(buf.Pass());
+  ASSERT_EQ(4096, pool.cached_bytes());
+  ASSERT_EQ(initial_consumption + 4096, tracker->consumption());
+
+  // A smaller request from a different size class doesn't get it...
+  buf = pool.Acquire(10);
+  ASSERT_NE(data, buf->data());
+  ASSERT_EQ(BufferPool::kMinBufferSize, buf->capacity());
+  pool.Release(buf.Pass());
+
+  // ...but a request from the same one does, emptied.
+  buf = pool.Acquire(2100);
+  ASSERT_EQ(data, buf->data());
+  ASSERT_EQ(0, buf->size());
+  ASSERT_EQ(BufferPool::kMinBufferSize, pool.cached_bytes());
+  ASSERT_EQ(initial_consumption + BufferPool::kMinBufferSize, tracker->consumption());
+
+  // Buffers larger than the largest size class aren't pooled.
+  gscoped_ptr<faststring> big = pool.Acquire(BufferPool::kMaxBufferSize * 4);
+  ASSERT_GE(big->capacity(), BufferPool::kMaxBufferSize * 4);
+  pool.Release(big.Pass());
+  ASSERT_EQ(BufferPool::kMinBufferSize, pool.cached_bytes());
+}
+
+TEST_F(BufferPoolTest, TestCapacityLimit) {
+  FLAGS_rpc_buffer_pool_capacity_bytes = 8 * 1024;
+  BufferPool pool;
+  std::vector<faststring*> bufs;
+  for (int i = 0; i < 4; i++) {
+    bufs.push_back(pool.Acquire(4096).release());
+  }
+  // Only the first two fit.
+  for (faststring* buf : bufs) {
+    pool.Release(gscoped_ptr<faststring>(buf));
+  }
+  ASSERT_EQ(8 * 1024, pool.cached_bytes());
+}
+
+} // namespace rpc
+} // namespace kudu
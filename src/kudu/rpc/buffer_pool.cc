@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/rpc/buffer_pool.h"
+
+#include <gflags/gflags.h>
+#include <mutex>
+
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/stl_util.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
+
+DEFINE_int64(rpc_buffer_pool_capacity_bytes, 4 * 1024 * 1024,
+             "Maximum number of bytes each reactor keeps in idle buffers for "
+             "reuse by later RPC frames. 0 disables pooling.");
+TAG_FLAG(rpc_buffer_pool_capacity_bytes, advanced);
+
+namespace kudu {
+namespace rpc {
+
+namespace {
+
+// Returns the smallest size class with buffers of at least 'size' bytes, or -1
+// if there is none.
+int SizeClassFor(size_t size) {
+  if (size <= BufferPool::kMinBufferSize) {
+    return 0;
+  }
+  if (size > BufferPool::kMaxBufferSize) {
+    return -1;
+  }
+  return Bits::Log2Ceiling64(size) - Bits::Log2Floor64(BufferPool::kMinBufferSize);
+}
+
+} // anonymous namespace
+
+BufferPool::BufferPool()
+  : cached_bytes_(0),
+    mem_tracker_(MemTracker::FindOrCreateTracker(-1, "rpc_buffer_pools")) {
+}
+
+BufferPool::~BufferPool() {
+  for (std::vector<faststring*>& free_list : free_lists_) {
+    STLDeleteElements(&free_list);
+  }
+  mem_tracker_->Release(cached_bytes_);
+}
+
+gscoped_ptr<faststring> BufferPool::Acquire(size_t min_capacity) {
+  int size_class = SizeClassFor(min_capacity);
+  if (size_class >= 0) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    std::vector<faststring*>* free_list = &free_lists_[size_class];
+    if (!free_list->empty()) {
+      gscoped_ptr<faststring> buf(free_list->back());
+      free_list->pop_back();
+      cached_bytes_ -= buf->capacity();
+      mem_tracker_->Release(buf->capacity());
+      return buf.Pass();
+    }
+  }
+
+  // Allocate a whole size class worth, so the buffer can be pooled later.
+  gscoped_ptr<faststring> buf(new faststring());
+  buf->reserve(size_class >= 0 ? kMinBufferSize << size_class : min_capacity);
+  return buf.Pass();
+}
+
+void BufferPool::Release(gscoped_ptr<faststring> buf) {
+  size_t capacity = buf->capacity();
+  if (capacity < kMinBufferSize || capacity >= kMaxBufferSize * 2) {
+    return;
+  }
+  // The largest class whose buffers 'buf' can stand in for.
+  int size_class = Bits::Log2Floor64(capacity) - Bits::Log2Floor64(kMinBufferSize);
+
+  buf->clear();
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (cached_bytes_ + capacity > FLAGS_rpc_buffer_pool_capacity_bytes) {
+    return;
+  }
+  free_lists_[size_class].push_back(buf.release());
+  cached_bytes_ += capacity;
+  mem_tracker_->Consume(capacity);
+}
+
+int64_t BufferPool::cached_bytes() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return cached_bytes_;
+}
+
+} // namespace rpc
+} // namespace kudu
@@ -0,0 +1,81 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_RPC_BUFFER_POOL_H
+#define KUDU_RPC_BUFFER_POOL_H
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/locks.h"
+
+namespace kudu {
+
+class MemTracker;
+
+namespace rpc {
+
+// A pool of buffers for RPC frames, so that the allocations backing them can
+// be reused from one call to the next rather than going back to the heap.
+//
+// Buffers are kept in power-of-two size classes from kMinBufferSize to
+// kMaxBufferSize bytes. Larger buffers are never pooled. The bytes held in
+// idle pooled buffers are limited by --rpc_buffer_pool_capacity_bytes and
+// reported to the "rpc_buffer_pools" MemTracker.
+//
+// This class is thread-safe: buffers are usually acquired on a reactor thread
+// and released on whichever thread finishes with the call.
+class BufferPool {
+ public:
+  static const size_t kMinBufferSize = 1024;
+  static const size_t kMaxBufferSize = 1024 * 1024;
+
+  BufferPool();
+  ~BufferPool();
+
+  // Returns an empty buffer with room for at least 'min_capacity' bytes.
+  // It should be handed back with Release() when no longer needed.
+  gscoped_ptr<faststring> Acquire(size_t min_capacity);
+
+  // Returns 'buf' to the pool for reuse, or frees it if it doesn't fit a size
+  // class or the pool is full.
+  void Release(gscoped_ptr<faststring> buf);
+
+  // The number of bytes held in idle buffers.
+  int64_t cached_bytes() const;
+
+ private:
+  static const int kNumSizeClasses = 11;
+
+  mutable simple_spinlock lock_;
+
+  // Idle buffers by size class. Buffers in class 'i' have a capacity of at
+  // least kMinBufferSize << i bytes. Protected by 'lock_'.
+  std::vector<faststring*> free_lists_[kNumSizeClasses];
+  int64_t cached_bytes_;
+
+  std::shared_ptr<MemTracker> mem_tracker_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferPool);
+};
+
+} // namespace rpc
+} // namespace kudu
+#endif // KUDU_RPC_BUFFER_POOL_H
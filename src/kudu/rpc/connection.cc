@@ -31,6 +31,7 @@
 #include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/auth_store.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/messenger.h"
@@ -42,6 +43,7 @@
 #include "kudu/rpc/transfer.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/net/sockaddr.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/status.h"
 #include "kudu/util/trace.h"
 
@@ -55,6 +57,19 @@ using strings::Substitute;
 namespace kudu {
 namespace rpc {
 
+namespace {
+
+// Size of the buffer into which small inbound frames are read ahead, so that
+// several frames which arrived together can be handled with a single recv().
+// Frame bodies at least this large are read directly into their own buffer.
+const int32_t kReadAheadBytes = 16 * 1024;
+
+// Maximum number of iovecs gathered across queued outbound transfers for a
+// single writev().
+const int kMaxWriteIovecs = 64;
+
+} // anonymous namespace
+
 ///
 /// Connection
 ///
@@ -63,6 +78,7 @@ Connection::Connection(ReactorThread *reactor_thread, Sockaddr remote,
     : reactor_thread_(reactor_thread),
       socket_(socket),
       remote_(std::move(remote)),
+      idx_(0),
       direction_(direction),
       last_activity_time_(MonoTime::Now(MonoTime::FINE)),
       is_epoll_registered_(false),
@@ -282,13 +298,21 @@ void Connection::QueueOutboundCall(const shared_ptr<OutboundCall> &call) {
   int32_t call_id = GetNextCallId();
   call->set_call_id(call_id);
 
-  // Serialize the actual bytes to be put on the wire.
+  // Serialize the actual bytes to be put on the wire. The request may only
+  // be sent compressed if we already know that the server supports it.
+  bool allow_compression = negotiation_complete_ && RemoteSupportsFeature(COMPRESSION);
   slices_tmp_.clear();
-  Status s = call->SerializeTo(&slices_tmp_);
+  Status s = call->SerializeTo(&slices_tmp_, allow_compression);
   if (PREDICT_FALSE(!s.ok())) {
     call->SetFailed(s);
     return;
   }
+  size_t uncompressed_size;
+  size_t compressed_size;
+  if (call->GetCompressedSizes(&uncompressed_size, &compressed_size)) {
+    reactor_thread_->reactor()->messenger()->RecordCompressedMessage(uncompressed_size,
+                                                                     compressed_size);
+  }
 
   call->SetQueued();
 
@@ -446,11 +470,59 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
   }
   last_activity_time_ = reactor_thread_->cur_time();
 
+  // Handling a call may end up destroying the connection, so hold a reference
+  // until we're done looking at our own state.
+  scoped_refptr<Connection> self(this);
+  const shared_ptr<BufferPool>& pool = reactor_thread_->reactor()->buffer_pool();
+  gscoped_ptr<faststring> read_ahead;
+  auto release_read_ahead = MakeScopedCleanup([&]() {
+      if (read_ahead && pool) {
+        pool->Release(read_ahead.Pass());
+      }
+    });
+
+  // Bytes which have been read off the socket but not yet consumed by
+  // 'inbound_'.
+  Slice pending;
+  bool more_on_socket = true;
   while (true) {
     if (!inbound_) {
-      inbound_.reset(new InboundTransfer());
+      inbound_.reset(new InboundTransfer(pool));
+    }
+
+    Status status;
+    if (pending.empty()) {
+      if (!more_on_socket) {
+        return;
+      }
+      if (inbound_->remaining_length() >= kReadAheadBytes) {
+        // A large frame body: read straight into the transfer's own buffer
+        // rather than copying it through the read-ahead buffer.
+        status = inbound_->ReceiveBuffer(socket_);
+        more_on_socket = false;
+      } else {
+        if (!read_ahead) {
+          read_ahead = pool ? pool->Acquire(kReadAheadBytes)
+                            : gscoped_ptr<faststring>(new faststring());
+          read_ahead->resize(kReadAheadBytes);
+        }
+        int32_t nread = 0;
+        status = socket_.Recv(read_ahead->data(), kReadAheadBytes, &nread);
+        if (status.ok()) {
+          pending = Slice(read_ahead->data(), nread);
+          // A short read means that the socket has been drained.
+          more_on_socket = (nread == kReadAheadBytes);
+        } else if (Socket::IsTemporarySocketError(status.posix_code())) {
+          return;
+        }
+      }
+    }
+
+    if (status.ok() && !pending.empty()) {
+      size_t consumed;
+      status = inbound_->ConsumeBytes(pending, &consumed);
+      pending.remove_prefix(consumed);
     }
-    Status status = inbound_->ReceiveBuffer(socket_);
     if (PREDICT_FALSE(!status.ok())) {
       if (status.posix_code() == ESHUTDOWN) {
         VLOG(1) << ToString() << " shut down by remote end.";
@@ -462,7 +534,7 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
     }
     if (!inbound_->TransferFinished()) {
       DVLOG(3) << ToString() << ": read is not yet finished yet.";
-      return;
+      continue;
     }
     DVLOG(3) << ToString() << ": finished reading " << inbound_->data().size() << " bytes";
 
@@ -473,15 +545,10 @@ void Connection::ReadHandler(ev::io &watcher, int revents) {
     } else {
       LOG(FATAL) << "Invalid direction: " << direction_;
     }
-
-    // TODO: it would seem that it would be good to loop around and see if
-    // there is more data on the socket by trying another recv(), but it turns
-    // out that it really hurts throughput to do so. A better approach
-    // might be for each InboundTransfer to actually try to read an extra byte,
-    // and if it succeeds, then we'd copy that byte into a new InboundTransfer
-    // and loop around, since it's likely the next call also arrived at the
-    // same time.
-    break;
+    if (!shutdown_status_.ok()) {
+      // The connection was torn down while handling the frame.
+      return;
+    }
   }
 }
 
@@ -534,6 +601,39 @@ void Connection::HandleCallResponse(gscoped_ptr<InboundTransfer> transfer) {
   car->call->SetResponse(std::move(resp));
 }
 
+bool Connection::StartTransferOrAbort(OutboundTransfer* transfer) {
+  if (!transfer->is_for_outbound_call()) {
+    return true;
+  }
+  CallAwaitingResponse* car = FindOrDie(awaiting_response_, transfer->call_id());
+  if (!car->call) {
+    // If the call has already timed out, then the 'call' field will have been nulled.
+    // In that case, we don't need to bother sending it.
+    outbound_transfers_.erase(outbound_transfers_.iterator_to(*transfer));
+    transfer->Abort(Status::Aborted("already timed out"));
+    delete transfer;
+    return false;
+  }
+
+  // If this is the start of the transfer, then check if the server has the
+  // required RPC flags. We have to wait until just before the transfer in
+  // order to ensure that the negotiation has taken place, so that the flags
+  // are available.
+  const set<RpcFeatureFlag>& required_features = car->call->required_rpc_features();
+  const set<RpcFeatureFlag>& server_features = sasl_client_.server_features();
+  if (!includes(server_features.begin(), server_features.end(),
+                required_features.begin(), required_features.end())) {
+    outbound_transfers_.erase(outbound_transfers_.iterator_to(*transfer));
+    Status s = Status::NotSupported("server does not support the required RPC features");
+    transfer->Abort(s);
+    car->call->SetFailed(s);
+    car->call.reset();
+    delete transfer;
+    return false;
+  }
+  return true;
+}
+
 void Connection::WriteHandler(ev::io &watcher, int revents) {
   DCHECK(reactor_thread_->IsCurrentThread());
 
@@ -544,7 +644,6 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
   }
   DVLOG(3) << ToString() << ": writeHandler: revents = " << revents;
 
-  OutboundTransfer *transfer;
   if (outbound_transfers_.empty()) {
     LOG(WARNING) << ToString() << " got a ready-to-write callback, but there is "
       "nothing to write.";
@@ -553,55 +652,58 @@ void Connection::WriteHandler(ev::io &watcher, int revents) {
   }
 
   while (!outbound_transfers_.empty()) {
-    transfer = &(outbound_transfers_.front());
-
-    if (!transfer->TransferStarted()) {
-
-      if (transfer->is_for_outbound_call()) {
-        CallAwaitingResponse* car = FindOrDie(awaiting_response_, transfer->call_id());
-        if (!car->call) {
-          // If the call has already timed out, then the 'call' field will have been nulled.
-          // In that case, we don't need to bother sending it.
-          outbound_transfers_.pop_front();
-          transfer->Abort(Status::Aborted("already timed out"));
-          delete transfer;
-          continue;
-        }
-
-        // If this is the start of the transfer, then check if the server has the
-        // required RPC flags. We have to wait until just before the transfer in
-        // order to ensure that the negotiation has taken place, so that the flags
-        // are available.
-        const set<RpcFeatureFlag>& required_features = car->call->required_rpc_features();
-        const set<RpcFeatureFlag>& server_features = sasl_client_.server_features();
-        if (!includes(server_features.begin(), server_features.end(),
-                      required_features.begin(), required_features.end())) {
-          outbound_transfers_.pop_front();
-          Status s = Status::NotSupported("server does not support the required RPC features");
-          transfer->Abort(s);
-          car->call->SetFailed(s);
-          car->call.reset();
-          delete transfer;
-          continue;
-        }
+    // Gather as many of the queued transfers as fit into a single writev().
+    struct iovec iov[kMaxWriteIovecs];
+    int n_iovecs = 0;
+    int64_t gathered = 0;
+    auto it = outbound_transfers_.begin();
+    while (it != outbound_transfers_.end() && n_iovecs < kMaxWriteIovecs) {
+      OutboundTransfer* transfer = &(*it);
+      ++it;
+      if (!transfer->TransferStarted() && !StartTransferOrAbort(transfer)) {
+        continue;
       }
+      int n = transfer->FillIovecs(&iov[n_iovecs], kMaxWriteIovecs - n_iovecs);
+      for (int i = n_iovecs; i < n_iovecs + n; i++) {
+        gathered += iov[i].iov_len;
+      }
+      n_iovecs += n;
+    }
+    if (n_iovecs == 0) {
+      // Every remaining transfer was aborted.
+      break;
     }
 
     last_activity_time_ = reactor_thread_->cur_time();
-    Status status = transfer->SendBuffer(socket_);
+    int32_t written;
+    Status status = socket_.Writev(iov, n_iovecs, &written);
     if (PREDICT_FALSE(!status.ok())) {
+      if (Socket::IsTemporarySocketError(status.posix_code())) {
+        DVLOG(3) << ToString() << ": writeHandler: socket not ready.";
+        return;
+      }
       LOG(WARNING) << ToString() << " send error: " << status.ToString();
       reactor_thread_->DestroyConnection(this, status);
       return;
     }
 
-    if (!transfer->TransferFinished()) {
+    // Credit the written bytes to the transfers in the order they were gathered.
+    int32_t rem = written;
+    while (!outbound_transfers_.empty()) {
+      OutboundTransfer* transfer = &outbound_transfers_.front();
+      rem -= transfer->AdvanceWritten(rem);
+      if (!transfer->TransferFinished()) {
+        break;
+      }
+      outbound_transfers_.pop_front();
+      delete transfer;
+    }
+    DCHECK_EQ(0, rem);
+
+    if (written < gathered) {
       DVLOG(3) << ToString() << ": writeHandler: xfer not finished.";
       return;
     }
-
-    outbound_transfers_.pop_front();
-    delete transfer;
   }
 
   // If we were able to write all of our outbound transfers,
@@ -619,6 +721,12 @@ std::string Connection::ToString() const {
     remote_.ToString());
 }
 
+bool Connection::RemoteSupportsFeature(RpcFeatureFlag feature) const {
+  const set<RpcFeatureFlag>& features = direction_ == CLIENT ? sasl_client_.server_features()
+                                                             : sasl_server_.client_features();
+  return ContainsKey(features, feature);
+}
+
 Status Connection::InitSaslClient() {
   RETURN_NOT_OK(sasl_client().Init(kSaslProtoName));
   RETURN_NOT_OK(sasl_client().EnableAnonymous());
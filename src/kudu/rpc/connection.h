@@ -128,6 +128,11 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // Get the user credentials which will be used to log in.
   const UserCredentials &user_credentials() const { return user_credentials_; }
 
+  // Set/get the index of this connection among the client connections to
+  // the same remote and user. See ConnectionId::idx().
+  void set_idx(int idx) { idx_ = idx; }
+  int idx() const { return idx_; }
+
   RpczStore* rpcz_store();
 
   // libev callback when data is available to read.
@@ -149,6 +154,11 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // Return SASL server instance for this connection.
   SaslServer &sasl_server() { return sasl_server_; }
 
+  // Returns true if the remote end of this connection advertised support for
+  // the RPC system feature 'feature' during negotiation. Must only be called
+  // once negotiation is complete.
+  bool RemoteSupportsFeature(RpcFeatureFlag feature) const;
+
   // Initialize SASL client before negotiation begins.
   Status InitSaslClient();
 
@@ -222,6 +232,12 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // This must be called from the reactor thread.
   void QueueOutbound(gscoped_ptr<OutboundTransfer> transfer);
 
+  // Called before the first byte of 'transfer' is sent. If the call it belongs
+  // to has timed out, or the server lacks features the call requires, the
+  // transfer is removed from the outbound queue, aborted and deleted, and
+  // false is returned.
+  bool StartTransferOrAbort(OutboundTransfer* transfer);
+
   // The reactor thread that created this connection.
   ReactorThread * const reactor_thread_;
 
@@ -234,6 +250,9 @@ class Connection : public RefCountedThreadSafe<Connection> {
   // The credentials of the user operating on this connection (if a client user).
   UserCredentials user_credentials_;
 
+  // The index of this connection among those to the same remote and user.
+  int idx_;
+
   // whether we are client or server
   Direction direction_;
 
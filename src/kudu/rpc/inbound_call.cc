@@ -21,7 +21,10 @@
 #include <memory>
 
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/connection.h"
+#include "kudu/rpc/messenger.h"
+#include "kudu/rpc/reactor.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/rpc/rpcz_store.h"
@@ -50,12 +53,23 @@ InboundCall::InboundCall(Connection* conn)
   RecordCallReceived();
 }
 
-InboundCall::~InboundCall() {}
+InboundCall::~InboundCall() {
+  if (buffer_pool_ && response_msg_buf_) {
+    buffer_pool_->Release(response_msg_buf_.Pass());
+  }
+}
 
 Status InboundCall::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   TRACE_EVENT_FLOW_BEGIN0("rpc", "InboundCall", this);
   TRACE_EVENT0("rpc", "InboundCall::ParseFrom");
   RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_, &serialized_request_));
+  if (header_.has_uncompressed_body_size()) {
+    uncompressed_request_buf_.reset(new faststring());
+    RETURN_NOT_OK(serialization::UncompressMessage(serialized_request_,
+                                                   header_.uncompressed_body_size(),
+                                                   uncompressed_request_buf_.get(),
+                                                   &serialized_request_));
+  }
 
   // Adopt the service/method info from the header as soon as it's available.
   if (PREDICT_FALSE(!header_.has_remote_method())) {
@@ -157,9 +171,40 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
   }
 
   int additional_size = absolute_sidecar_offset - protobuf_msg_size;
-  serialization::SerializeMessage(response, &response_msg_buf_,
+  if (!response_msg_buf_) {
+    if (conn_) {
+      buffer_pool_ = conn_->reactor_thread()->reactor()->buffer_pool();
+      response_msg_buf_ = buffer_pool_->Acquire(
+          protobuf_msg_size + CodedOutputStream::VarintSize32(absolute_sidecar_offset));
+    } else {
+      response_msg_buf_.reset(new faststring());
+    }
+  }
+  serialization::SerializeMessage(response, response_msg_buf_.get(),
                                   additional_size, true);
-  int main_msg_size = additional_size + response_msg_buf_.size();
+  int main_msg_size = additional_size + response_msg_buf_->size();
+
+  // Compress large responses if the client can handle it. This runs on the
+  // service thread, keeping the work off the reactor.
+  compressed_response_buf_.reset();
+  if (conn_ && serialization::ShouldCompress(main_msg_size) &&
+      conn_->RemoteSupportsFeature(COMPRESSION)) {
+    vector<Slice> body_slices;
+    body_slices.reserve(1 + sidecars_.size());
+    body_slices.push_back(Slice(*response_msg_buf_));
+    for (RpcSidecar* car : sidecars_) {
+      body_slices.push_back(car->AsSlice());
+    }
+    gscoped_ptr<faststring> compressed(new faststring());
+    if (serialization::CompressMessage(body_slices, compressed.get())) {
+      conn_->reactor_thread()->reactor()->messenger()->RecordCompressedMessage(
+          main_msg_size, compressed->size());
+      resp_hdr.set_uncompressed_body_size(main_msg_size);
+      main_msg_size = compressed->size();
+      compressed_response_buf_ = compressed.Pass();
+    }
+  }
+
   serialization::SerializeHeader(resp_hdr, main_msg_size,
                                  &response_hdr_buf_);
 }
@@ -167,10 +212,14 @@ void InboundCall::SerializeResponseBuffer(const MessageLite& response,
 void InboundCall::SerializeResponseTo(vector<Slice>* slices) const {
   TRACE_EVENT0("rpc", "InboundCall::SerializeResponseTo");
   CHECK_GT(response_hdr_buf_.size(), 0);
-  CHECK_GT(response_msg_buf_.size(), 0);
-  slices->reserve(slices->size() + 2 + sidecars_.size());
+  CHECK_GT(response_msg_buf_->size(), 0);
   slices->push_back(Slice(response_hdr_buf_));
-  slices->push_back(Slice(response_msg_buf_));
+  if (compressed_response_buf_) {
+    slices->push_back(Slice(*compressed_response_buf_));
+    return;
+  }
+  slices->reserve(slices->size() + 1 + sidecars_.size());
+  slices->push_back(Slice(*response_msg_buf_));
   for (RpcSidecar* car : sidecars_) {
     slices->push_back(car->AsSlice());
   }
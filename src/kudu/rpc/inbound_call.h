@@ -18,6 +18,7 @@
 #define KUDU_RPC_INBOUND_CALL_H
 
 #include <glog/logging.h>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -47,6 +48,7 @@ class Trace;
 
 namespace rpc {
 
+class BufferPool;
 class Connection;
 class DumpRunningRpcsRequestPB;
 class RpcCallInProgressPB;
@@ -158,6 +160,9 @@ class InboundCall {
   RpcMethodInfo* method_info() {
     return method_info_.get();
   }
+  const RpcMethodInfo* method_info() const {
+    return method_info_.get();
+  }
 
   // When this InboundCall was received (instantiated).
   // Should only be called once on a given instance.
@@ -221,9 +226,19 @@ class InboundCall {
   // by 'serialized_request_' above.
   gscoped_ptr<InboundTransfer> transfer_;
 
+  // If the request was sent compressed, holds the uncompressed body which
+  // 'serialized_request_' then refers to.
+  gscoped_ptr<faststring> uncompressed_request_buf_;
+
   // The buffers for serialized response. Set by SerializeResponseBuffer().
+  // The message buffer comes from the connection's reactor's buffer pool,
+  // if any, and is handed back to it when the call is destroyed.
   faststring response_hdr_buf_;
-  faststring response_msg_buf_;
+  gscoped_ptr<faststring> response_msg_buf_;
+
+  // The compressed form of the response body, if it is to be sent compressed.
+  gscoped_ptr<faststring> compressed_response_buf_;
+  std::shared_ptr<BufferPool> buffer_pool_;
 
   // Vector of additional sidecars that are tacked on to the call's response
   // after serialization of the protobuf. See rpc/rpc_sidecar.h for more info.
@@ -60,6 +60,26 @@ DEFINE_int32(rpc_default_keepalive_time_ms, 65000,
              "will disconnect the client.");
 TAG_FLAG(rpc_default_keepalive_time_ms, advanced);
 
+DEFINE_int32(rpc_negotiation_max_threads, 64,
+             "Maximum number of threads negotiating new RPC connections at once. "
+             "Each negotiation blocks its thread for several network round trips, "
+             "so when many peers reconnect at the same time, e.g. after a master "
+             "restart, too few threads leave negotiations queued until they time "
+             "out. Idle threads exit, so a high limit costs nothing at rest.");
+TAG_FLAG(rpc_negotiation_max_threads, advanced);
+
+METRIC_DEFINE_counter(server, rpc_compression_input_bytes,
+                      "RPC Compression Input Bytes",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of RPC message bodies sent compressed, "
+                      "before compression.");
+METRIC_DEFINE_counter(server, rpc_compression_output_bytes,
+                      "RPC Compression Output Bytes",
+                      kudu::MetricUnit::kBytes,
+                      "Number of bytes of RPC message bodies sent compressed, "
+                      "after compression. The compression ratio is this divided "
+                      "by rpc_compression_input_bytes.");
+
 namespace kudu {
 namespace rpc {
 
@@ -71,7 +91,7 @@ MessengerBuilder::MessengerBuilder(std::string name)
       connection_keepalive_time_(
           MonoDelta::FromMilliseconds(FLAGS_rpc_default_keepalive_time_ms)),
       num_reactors_(4),
-      num_negotiation_threads_(4),
+      num_negotiation_threads_(FLAGS_rpc_negotiation_max_threads),
       coarse_timer_granularity_(MonoDelta::FromMilliseconds(100)) {}
 
 MessengerBuilder& MessengerBuilder::set_connection_keepalive_time(const MonoDelta &keepalive) {
@@ -204,7 +224,7 @@ Status Messenger::UnregisterService(const string& service_name) {
 }
 
 void Messenger::QueueOutboundCall(const shared_ptr<OutboundCall> &call) {
-  Reactor *reactor = RemoteToReactor(call->conn_id().remote());
+  Reactor *reactor = RemoteToReactor(call->conn_id().remote(), call->conn_id().idx());
   reactor->QueueOutboundCall(call);
 }
 
@@ -237,6 +257,10 @@ Messenger::Messenger(const MessengerBuilder &bld)
     rpcz_store_(new RpczStore()),
     metric_entity_(bld.metric_entity_),
     retain_self_(this) {
+  if (metric_entity_) {
+    compression_input_bytes_ = METRIC_rpc_compression_input_bytes.Instantiate(metric_entity_);
+    compression_output_bytes_ = METRIC_rpc_compression_output_bytes.Instantiate(metric_entity_);
+  }
   for (int i = 0; i < bld.num_reactors_; i++) {
     reactors_.push_back(new Reactor(retain_self_, i, bld));
   }
@@ -251,9 +275,16 @@ Messenger::~Messenger() {
   STLDeleteElements(&reactors_);
 }
 
-Reactor* Messenger::RemoteToReactor(const Sockaddr &remote) {
+void Messenger::RecordCompressedMessage(size_t uncompressed_size, size_t compressed_size) {
+  if (compression_input_bytes_) {
+    compression_input_bytes_->IncrementBy(uncompressed_size);
+    compression_output_bytes_->IncrementBy(compressed_size);
+  }
+}
+
+Reactor* Messenger::RemoteToReactor(const Sockaddr &remote, int conn_idx) {
   uint32_t hashCode = remote.HashCode();
-  int reactor_idx = hashCode % reactors_.size();
+  int reactor_idx = (hashCode + conn_idx) % reactors_.size();
   // This is just a static partitioning; we could get a lot
   // fancier with assigning Sockaddrs to Reactors.
   return reactors_[reactor_idx];
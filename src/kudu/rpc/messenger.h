@@ -38,6 +38,7 @@
 
 namespace kudu {
 
+class Counter;
 class Socket;
 class ThreadPool;
 
@@ -82,8 +83,9 @@ class MessengerBuilder {
   // receiving.
   MessengerBuilder &set_num_reactors(int num_reactors);
 
-  // Set the number of connection-negotiation threads that will be used to handle the
-  // blocking connection-negotiation step.
+  // Set the maximum number of connection-negotiation threads that will be used to
+  // handle the blocking connection-negotiation step. Defaults to
+  // --rpc_negotiation_max_threads.
   MessengerBuilder &set_negotiation_threads(int num_negotiation_threads);
 
   // Set the granularity with which connections are checked for keepalive.
@@ -190,6 +192,10 @@ class Messenger {
 
   scoped_refptr<MetricEntity> metric_entity() const { return metric_entity_.get(); }
 
+  // Account for a message body of 'uncompressed_size' bytes which was sent
+  // as 'compressed_size' bytes.
+  void RecordCompressedMessage(size_t uncompressed_size, size_t compressed_size);
+
   const scoped_refptr<RpcService> rpc_service(const std::string& service_name) const;
 
  private:
@@ -197,7 +203,9 @@ class Messenger {
 
   explicit Messenger(const MessengerBuilder &bld);
 
-  Reactor* RemoteToReactor(const Sockaddr &remote);
+  // Pick the reactor responsible for 'remote'. 'conn_idx' offsets the choice
+  // so that several connections to the same remote land on different reactors.
+  Reactor* RemoteToReactor(const Sockaddr &remote, int conn_idx = 0);
   Status Init();
   void RunTimeoutThread();
   void UpdateCurTime();
@@ -230,6 +238,10 @@ class Messenger {
 
   scoped_refptr<MetricEntity> metric_entity_;
 
+  // Compression metrics. NULL if the messenger has no metric entity.
+  scoped_refptr<Counter> compression_input_bytes_;
+  scoped_refptr<Counter> compression_output_bytes_;
+
   // The ownership of the Messenger object is somewhat subtle. The pointer graph
   // looks like this:
   //
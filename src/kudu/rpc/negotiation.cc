@@ -219,7 +219,13 @@ static Status DoServerNegotiation(Connection* conn,
 void Negotiation::RunNegotiation(const scoped_refptr<Connection>& conn,
                                  const MonoTime& deadline) {
   Status s;
-  if (conn->direction() == Connection::SERVER) {
+  if (PREDICT_FALSE(deadline.ComesBefore(MonoTime::Now(MonoTime::FINE)))) {
+    // The negotiation spent its whole timeout waiting for a thread. Give up
+    // on it straight away rather than occupying the thread with a handshake
+    // the peer has likely given up on too, which would only delay the
+    // negotiations queued behind it.
+    s = Status::TimedOut("Timed out waiting for a negotiation thread");
+  } else if (conn->direction() == Connection::SERVER) {
     s = DoServerNegotiation(conn.get(), deadline);
   } else {
     s = DoClientNegotiation(conn.get(), deadline);
@@ -68,7 +68,8 @@ OutboundCall::OutboundCall(const ConnectionId& conn_id,
       conn_id_(conn_id),
       callback_(std::move(callback)),
       controller_(DCHECK_NOTNULL(controller)),
-      response_(DCHECK_NOTNULL(response_storage)) {
+      response_(DCHECK_NOTNULL(response_storage)),
+      sent_compressed_(false) {
   DVLOG(4) << "OutboundCall " << this << " constructed with state_: " << StateName(state_)
            << " and RPC timeout: "
            << (controller->timeout().Initialized() ? controller->timeout().ToString() : "none");
@@ -90,7 +91,7 @@ OutboundCall::~OutboundCall() {
   DVLOG(4) << "OutboundCall " << this << " destroyed with state_: " << StateName(state_);
 }
 
-Status OutboundCall::SerializeTo(vector<Slice>* slices) {
+Status OutboundCall::SerializeTo(vector<Slice>* slices, bool allow_compression) {
   size_t param_len = request_buf_.size();
   if (PREDICT_FALSE(param_len == 0)) {
     return Status::InvalidArgument("Must call SetRequestParam() before SerializeTo()");
@@ -105,16 +106,56 @@ Status OutboundCall::SerializeTo(vector<Slice>* slices) {
     header_.add_required_feature_flags(feature);
   }
 
+  sent_compressed_ = allow_compression && compressed_request_buf_;
+  if (sent_compressed_) {
+    header_.set_uncompressed_body_size(param_len);
+    param_len = compressed_request_buf_->size();
+  }
+
   serialization::SerializeHeader(header_, param_len, &header_buf_);
 
   // Return the concatenated packet.
   slices->push_back(Slice(header_buf_));
-  slices->push_back(Slice(request_buf_));
+  slices->push_back(sent_compressed_ ? Slice(*compressed_request_buf_) : Slice(request_buf_));
   return Status::OK();
 }
 
+bool OutboundCall::GetCompressedSizes(size_t* uncompressed_size,
+                                      size_t* compressed_size) const {
+  if (!sent_compressed_) {
+    return false;
+  }
+  *uncompressed_size = request_buf_.size();
+  *compressed_size = compressed_request_buf_->size();
+  return true;
+}
+
+void OutboundCall::MaybeCompressRequest() {
+  // This runs on the caller's thread, so that the reactor thread only has to
+  // pick between the two forms once it knows what the server supports.
+  compressed_request_buf_.reset();
+  if (!serialization::ShouldCompress(request_buf_.size())) {
+    return;
+  }
+  gscoped_ptr<faststring> compressed(new faststring());
+  if (serialization::CompressMessage({ Slice(request_buf_) }, compressed.get())) {
+    compressed_request_buf_ = compressed.Pass();
+  }
+}
+
 void OutboundCall::SetRequestParam(const Message& message) {
   serialization::SerializeMessage(message, &request_buf_);
+  MaybeCompressRequest();
+}
+
+void OutboundCall::SetSerializedRequestParam(const Slice& serialized_req) {
+  int size_with_delim = serialized_req.size() +
+      CodedOutputStream::VarintSize32(serialized_req.size());
+  request_buf_.resize(size_with_delim);
+  uint8_t* dst = CodedOutputStream::WriteVarint32ToArray(serialized_req.size(),
+                                                         request_buf_.data());
+  memcpy(dst, serialized_req.data(), serialized_req.size());
+  MaybeCompressRequest();
 }
 
 Status OutboundCall::status() const {
@@ -382,13 +423,14 @@ bool UserCredentials::Equals(const UserCredentials& other) const {
 /// ConnectionId
 ///
 
-ConnectionId::ConnectionId() {}
+ConnectionId::ConnectionId() : idx_(0) {}
 
 ConnectionId::ConnectionId(const ConnectionId& other) {
   DoCopyFrom(other);
 }
 
-ConnectionId::ConnectionId(const Sockaddr& remote, const UserCredentials& user_credentials) {
+ConnectionId::ConnectionId(const Sockaddr& remote, const UserCredentials& user_credentials)
+    : idx_(0) {
   remote_ = remote;
   user_credentials_.CopyFrom(user_credentials);
 }
@@ -401,32 +443,41 @@ void ConnectionId::set_user_credentials(const UserCredentials& user_credentials)
   user_credentials_.CopyFrom(user_credentials);
 }
 
+void ConnectionId::set_idx(int idx) {
+  DCHECK_GE(idx, 0);
+  idx_ = idx;
+}
+
 void ConnectionId::CopyFrom(const ConnectionId& other) {
   DoCopyFrom(other);
 }
 
 string ConnectionId::ToString() const {
   // Does not print the password.
-  return StringPrintf("{remote=%s, user_credentials=%s}",
+  return StringPrintf("{remote=%s, user_credentials=%s, idx=%d}",
       remote_.ToString().c_str(),
-      user_credentials_.ToString().c_str());
+      user_credentials_.ToString().c_str(),
+      idx_);
 }
 
 void ConnectionId::DoCopyFrom(const ConnectionId& other) {
   remote_ = other.remote_;
   user_credentials_.CopyFrom(other.user_credentials_);
+  idx_ = other.idx_;
 }
 
 size_t ConnectionId::HashCode() const {
   size_t seed = 0;
   boost::hash_combine(seed, remote_.HashCode());
   boost::hash_combine(seed, user_credentials_.HashCode());
+  boost::hash_combine(seed, idx_);
   return seed;
 }
 
 bool ConnectionId::Equals(const ConnectionId& other) const {
   return (remote() == other.remote()
-       && user_credentials().Equals(other.user_credentials()));
+       && user_credentials().Equals(other.user_credentials())
+       && idx() == other.idx());
 }
 
 size_t ConnectionIdHash::operator() (const ConnectionId& conn_id) const {
@@ -460,6 +511,13 @@ Status CallResponse::ParseFrom(gscoped_ptr<InboundTransfer> transfer) {
   Slice entire_message;
   RETURN_NOT_OK(serialization::ParseMessage(transfer->data(), &header_,
                                             &entire_message));
+  if (header_.has_uncompressed_body_size()) {
+    uncompressed_body_.reset(new faststring());
+    RETURN_NOT_OK(serialization::UncompressMessage(entire_message,
+                                                   header_.uncompressed_body_size(),
+                                                   uncompressed_body_.get(),
+                                                   &entire_message));
+  }
 
   // Use information from header to extract the payload slices.
   int last = header_.sidecar_offsets_size() - 1;
@@ -117,6 +117,12 @@ class ConnectionId {
   const UserCredentials& user_credentials() const { return user_credentials_; }
   UserCredentials* mutable_user_credentials() { return &user_credentials_; }
 
+  // Which of the (possibly several) connections to the same remote and user
+  // this identifies. Calls with different indexes are sent on different
+  // connections, and may be handled by different reactor threads.
+  void set_idx(int idx);
+  int idx() const { return idx_; }
+
   // Copy state from another object to this one.
   void CopyFrom(const ConnectionId& other);
 
@@ -130,6 +136,7 @@ class ConnectionId {
   // Remember to update HashCode() and Equals() when new fields are added.
   Sockaddr remote_;
   UserCredentials user_credentials_;
+  int idx_;
 
   // Implementation of CopyFrom that can be shared with copy constructor.
   void DoCopyFrom(const ConnectionId& other);
@@ -171,6 +178,10 @@ class OutboundCall {
   // subsequently mutated with no ill effects.
   void SetRequestParam(const google::protobuf::Message& req);
 
+  // Like SetRequestParam(), but 'serialized_req' already holds the request
+  // PB in its wire format. The data is copied.
+  void SetSerializedRequestParam(const Slice& serialized_req);
+
   // Assign the call ID for this call. This is called from the reactor
   // thread once a connection has been assigned. Must only be called once.
   void set_call_id(int32_t call_id) {
@@ -180,7 +191,14 @@ class OutboundCall {
 
   // Serialize the call for the wire. Requires that SetRequestParam()
   // is called first. This is called from the Reactor thread.
-  Status SerializeTo(std::vector<Slice>* slices);
+  //
+  // If 'allow_compression' is true and the request was large enough to be
+  // compressed, the compressed form is sent.
+  Status SerializeTo(std::vector<Slice>* slices, bool allow_compression = false);
+
+  // Return true if SerializeTo() sent the request compressed, along with the
+  // size of its body before and after compression.
+  bool GetCompressedSizes(size_t* uncompressed_size, size_t* compressed_size) const;
 
   // Callback after the call has been put on the outbound connection queue.
   void SetQueued();
@@ -301,6 +319,16 @@ class OutboundCall {
   faststring header_buf_;
   faststring request_buf_;
 
+  // The compressed form of 'request_buf_', if compression was worthwhile.
+  gscoped_ptr<faststring> compressed_request_buf_;
+
+  // Set by SerializeTo() if the compressed form was sent.
+  bool sent_compressed_;
+
+  // Compress 'request_buf_' into 'compressed_request_buf_' if it is large
+  // enough for that to be worthwhile.
+  void MaybeCompressRequest();
+
   // Once a response has been received for this call, contains that response.
   // Otherwise NULL.
   gscoped_ptr<CallResponse> call_response_;
@@ -360,6 +388,10 @@ class CallResponse {
   // Slices of data for rpc sidecars. They point into memory owned by transfer_.
   Slice sidecar_slices_[OutboundTransfer::kMaxPayloadSlices];
 
+  // If the response was sent compressed, holds the uncompressed body which
+  // 'serialized_response_' and 'sidecar_slices_' then point into.
+  gscoped_ptr<faststring> uncompressed_body_;
+
   // The incoming transfer data - retained because serialized_response_
   // and sidecar_slices_ refer into its data.
   gscoped_ptr<InboundTransfer> transfer_;
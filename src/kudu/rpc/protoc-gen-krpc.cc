@@ -185,6 +185,9 @@ class MethodSubstitutions : public Substituter {
     (*map)["metric_enum_key"] = strings::Substitute("kMetricIndex$0", method_->name());
     bool track_result = static_cast<bool>(method_->options().GetExtension(track_rpc_result));
     (*map)["track_result"] = track_result ? " true" : "false";
+    (*map)["priority"] = SimpleItoa(method_->options().GetExtension(rpc_priority));
+    (*map)["queue_quota_pct"] =
+        SimpleItoa(method_->options().GetExtension(rpc_queue_quota_pct));
   }
 
   // Strips the package from method arguments if they are in the same package as
@@ -427,7 +430,7 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
           "  \"$rpc_full_name$ RPC Time\",\n"
           "  kudu::MetricUnit::kMicroseconds,\n"
           "  \"Microseconds spent handling $rpc_full_name$() RPC requests\",\n"
-          "  60000000LU, 2);\n"
+          "  60000000LU, 2, kudu::SHARDED_HISTOGRAM);\n"
           "\n");
         subs->Pop();
       }
@@ -465,7 +468,10 @@ class CodeGenerator : public ::google::protobuf::compiler::CodeGenerator {
               "    scoped_refptr<RpcMethodInfo> mi(new RpcMethodInfo());\n"
               "    mi->req_prototype.reset(new $request$());\n"
               "    mi->resp_prototype.reset(new $response$());\n"
+              "    mi->full_name = \"$rpc_full_name$\";\n"
               "    mi->track_result = $track_result$;\n"
+              "    mi->priority = $priority$;\n"
+              "    mi->queue_quota_pct = $queue_quota_pct$;\n"
               "    mi->handler_latency_histogram =\n"
               "        METRIC_handler_latency_$rpc_full_name_plainchars$.Instantiate(entity);\n"
               "    mi->func = [this](const Message* req, Message* resp, RpcContext* ctx) {\n"
@@ -18,6 +18,7 @@
 #include "kudu/rpc/proxy.h"
 
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <inttypes.h>
 #include <memory>
@@ -37,6 +38,7 @@
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/net/socket.h"
 #include "kudu/util/countdown_latch.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/status.h"
 #include "kudu/util/user.h"
 
@@ -44,6 +46,13 @@ using google::protobuf::Message;
 using std::string;
 using std::shared_ptr;
 
+DEFINE_int32(rpc_connections_per_peer, 1,
+             "Default number of TCP connections a proxy spreads its calls across "
+             "when talking to a remote server. Each connection may be served by a "
+             "different reactor thread on both ends.");
+TAG_FLAG(rpc_connections_per_peer, advanced);
+TAG_FLAG(rpc_connections_per_peer, experimental);
+
 namespace kudu {
 namespace rpc {
 
@@ -51,8 +60,11 @@ Proxy::Proxy(const std::shared_ptr<Messenger>& messenger,
              const Sockaddr& remote, string service_name)
     : service_name_(std::move(service_name)),
       messenger_(messenger),
-      is_started_(false) {
+      num_connections_(FLAGS_rpc_connections_per_peer),
+      is_started_(false),
+      next_conn_idx_(0) {
   CHECK(messenger != nullptr);
+  CHECK_GE(num_connections_, 1) << "--rpc_connections_per_peer must be at least 1";
   DCHECK(!service_name_.empty()) << "Proxy service name must not be blank";
 
   // By default, we set the real user to the currently logged-in user.
@@ -77,9 +89,7 @@ void Proxy::AsyncRequest(const string& method,
                          RpcController* controller,
                          const ResponseCallback& callback) const {
   CHECK(controller->call_.get() == nullptr) << "Controller should be reset";
-  base::subtle::NoBarrier_Store(&is_started_, true);
-  RemoteMethod remote_method(service_name_, method);
-  OutboundCall* call = new OutboundCall(conn_id_, remote_method, response, controller, callback);
+  OutboundCall* call = NewCall(method, response, controller, callback);
   controller->call_.reset(call);
   call->SetRequestParam(req);
 
@@ -89,6 +99,35 @@ void Proxy::AsyncRequest(const string& method,
 }
 
 
+void Proxy::AsyncRequestSerialized(const string& method,
+                                   const Slice& serialized_req,
+                                   google::protobuf::Message* response,
+                                   RpcController* controller,
+                                   const ResponseCallback& callback) const {
+  CHECK(controller->call_.get() == nullptr) << "Controller should be reset";
+  OutboundCall* call = NewCall(method, response, controller, callback);
+  controller->call_.reset(call);
+  call->SetSerializedRequestParam(serialized_req);
+
+  messenger_->QueueOutboundCall(controller->call_);
+}
+
+OutboundCall* Proxy::NewCall(const string& method,
+                             google::protobuf::Message* response,
+                             RpcController* controller,
+                             const ResponseCallback& callback) const {
+  base::subtle::NoBarrier_Store(&is_started_, true);
+  RemoteMethod remote_method(service_name_, method);
+  if (num_connections_ == 1) {
+    return new OutboundCall(conn_id_, remote_method, response, controller, callback);
+  }
+  // Round-robin the calls across the connections to the remote.
+  ConnectionId conn_id(conn_id_);
+  uint32_t n = base::subtle::NoBarrier_AtomicIncrement(&next_conn_idx_, 1);
+  conn_id.set_idx(n % num_connections_);
+  return new OutboundCall(conn_id, remote_method, response, controller, callback);
+}
+
 Status Proxy::SyncRequest(const string& method,
                           const google::protobuf::Message& req,
                           google::protobuf::Message* resp,
@@ -107,6 +146,13 @@ void Proxy::set_user_credentials(const UserCredentials& user_credentials) {
   conn_id_.set_user_credentials(user_credentials);
 }
 
+void Proxy::set_num_connections(int num_connections) {
+  CHECK(base::subtle::NoBarrier_Load(&is_started_) == false)
+    << "It is illegal to call set_num_connections() after request processing has started";
+  CHECK_GE(num_connections, 1);
+  num_connections_ = num_connections;
+}
+
 std::string Proxy::ToString() const {
   return strings::Substitute("$0@$1", service_name_, conn_id_.ToString());
 }
@@ -91,6 +91,15 @@ class Proxy {
                     RpcController* controller,
                     const ResponseCallback& callback) const;
 
+  // The same as AsyncRequest(), except that the request is given already
+  // serialized, e.g. because the caller assembled it from pieces which it
+  // serialized ahead of time. 'serialized_req' is copied before returning.
+  void AsyncRequestSerialized(const std::string& method,
+                              const Slice& serialized_req,
+                              google::protobuf::Message* resp,
+                              RpcController* controller,
+                              const ResponseCallback& callback) const;
+
   // The same as AsyncRequest(), except that the call blocks until the call
   // finishes. If the call fails, returns a non-OK result.
   Status SyncRequest(const std::string& method,
@@ -104,13 +113,28 @@ class Proxy {
   // Get the user credentials which should be used to log in.
   const UserCredentials& user_credentials() const { return conn_id_.user_credentials(); }
 
+  // Set the number of connections to the remote that calls made through this
+  // proxy are spread across, in round-robin order. Defaults to
+  // --rpc_connections_per_peer. Proxies to the same remote with the same
+  // credentials share connections.
+  void set_num_connections(int num_connections);
+  int num_connections() const { return num_connections_; }
+
   std::string ToString() const;
 
  private:
+  // Create a call to 'method', picking the connection it should be sent on.
+  OutboundCall* NewCall(const std::string& method,
+                        google::protobuf::Message* response,
+                        RpcController* controller,
+                        const ResponseCallback& callback) const;
+
   const std::string service_name_;
   std::shared_ptr<Messenger> messenger_;
   ConnectionId conn_id_;
+  int num_connections_;
   mutable Atomic32 is_started_;
+  mutable Atomic32 next_conn_idx_;
 
   DISALLOW_COPY_AND_ASSIGN(Proxy);
 };
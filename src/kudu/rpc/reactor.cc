@@ -31,6 +31,7 @@
 
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/connection.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/rpc/negotiation.h"
@@ -43,6 +44,7 @@
 #include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/thread_restrictions.h"
@@ -300,6 +302,13 @@ bool ReactorThread::IsCurrentThread() const {
 }
 
 void ReactorThread::RunThread() {
+  if (NumaPlacementEnabled()) {
+    // The connections of this reactor and the service queue shard it feeds
+    // are then local to one node.
+    int node = reactor_->index() % NumaNodeCount();
+    WARN_NOT_OK(BindCurrentThreadToNumaNode(node),
+                StringPrintf("%s: unable to bind to NUMA node %d", name().c_str(), node));
+  }
   ThreadRestrictions::SetWaitAllowed(false);
   ThreadRestrictions::SetIOAllowed(false);
   DVLOG(6) << "Calling ReactorThread::RunThread()...";
@@ -333,6 +342,7 @@ Status ReactorThread::FindOrStartConnection(const ConnectionId &conn_id,
   // Register the new connection in our map.
   *conn = new Connection(this, conn_id.remote(), sock.Release(), Connection::CLIENT);
   (*conn)->set_user_credentials(conn_id.user_credentials());
+  (*conn)->set_idx(conn_id.idx());
 
   // Kick off blocking client connection negotiation.
   Status s = StartConnectionNegotiation(*conn);
@@ -424,6 +434,7 @@ void ReactorThread::DestroyConnection(Connection *conn,
   // Unlink connection from lists.
   if (conn->direction() == Connection::CLIENT) {
     ConnectionId conn_id(conn->remote(), conn->user_credentials());
+    conn_id.set_idx(conn->idx());
     auto it = client_conns_.find(conn_id);
     CHECK(it != client_conns_.end()) << "Couldn't find connection " << conn->ToString();
     client_conns_.erase(it);
@@ -479,6 +490,8 @@ Reactor::Reactor(const shared_ptr<Messenger>& messenger,
                  int index, const MessengerBuilder &bld)
   : messenger_(messenger),
     name_(StringPrintf("%s_R%03d", messenger->name().c_str(), index)),
+    index_(index),
+    buffer_pool_(std::make_shared<BufferPool>()),
     closing_(false),
     thread_(this, bld) {
 }
@@ -41,6 +41,7 @@ namespace rpc {
 
 typedef std::list<scoped_refptr<Connection> > conn_list_t;
 
+class BufferPool;
 class DumpRunningRpcsRequestPB;
 class DumpRunningRpcsResponsePB;
 class Messenger;
@@ -276,6 +277,9 @@ class Reactor {
 
   const std::string &name() const;
 
+  // The index of this reactor among those of its messenger.
+  int index() const { return index_; }
+
   // Collect metrics about the reactor.
   Status GetMetrics(ReactorMetrics *metrics);
 
@@ -310,6 +314,13 @@ class Reactor {
     return messenger_.get();
   }
 
+  // The pool of buffers for the RPC frames of this reactor's connections.
+  //
+  // This method is thread-safe.
+  const std::shared_ptr<BufferPool>& buffer_pool() const {
+    return buffer_pool_;
+  }
+
   // Indicates whether the reactor is shutting down.
   //
   // This method is thread-safe.
@@ -330,6 +341,12 @@ class Reactor {
 
   const std::string name_;
 
+  const int index_;
+
+  // Shared with the transfers and calls of our connections, which may
+  // outlive the reactor.
+  const std::shared_ptr<BufferPool> buffer_pool_;
+
   // Whether the reactor is shutting down.
   // Guarded by lock_.
   bool closing_;
@@ -17,13 +17,40 @@
 
 #include "kudu/rpc/result_tracker.h"
 
+#include <functional>
+
+#include <gflags/gflags.h>
+
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/inbound_call.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/util/debug/trace_event.h"
-#include "kudu/util/trace.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/pb_util.h"
+#include "kudu/util/thread.h"
+#include "kudu/util/trace.h"
+
+DEFINE_int64(remember_clients_ttl_ms, 3600 * 1000 /* 1 hour */,
+             "Maximum amount of time, in milliseconds, the server \"remembers\" a client for "
+             "the purpose of caching its responses. After this period without hearing from it "
+             "the client is no longer remembered and the memory occupied by its responses is "
+             "reclaimed. Retries of requests older than this period are treated as new ones.");
+TAG_FLAG(remember_clients_ttl_ms, advanced);
+
+DEFINE_int32(result_tracker_gc_interval_ms, 1000,
+             "Interval, in milliseconds, at which the cached responses of the clients which "
+             "haven't been heard from in --remember_clients_ttl_ms are garbage collected.");
+TAG_FLAG(result_tracker_gc_interval_ms, advanced);
+
+DEFINE_int64(result_tracker_memory_limit_mb, 256,
+             "Maximum amount of memory, in MB, taken by the cached responses of the clients "
+             "of a server. When exceeded, the responses of the clients which were heard from "
+             "least recently are dropped first, regardless of --remember_clients_ttl_ms. "
+             "A negative value means no limit.");
+TAG_FLAG(result_tracker_memory_limit_mb, advanced);
 
 namespace kudu {
 namespace rpc {
@@ -32,29 +59,113 @@ using google::protobuf::Message;
 using rpc::InboundCall;
 using std::move;
 using std::lock_guard;
+using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
 using strings::Substitute;
 using strings::SubstituteAndAppend;
 
+namespace {
+
+// Rough overhead of an entry of an std::map, besides its key and value.
+const int64_t kMapEntryOverhead = 4 * sizeof(void*);
+
+} // anonymous namespace
+
+int64_t ResultTracker::CompletionRecord::memory_footprint() const {
+  return sizeof(SequenceNumber) + sizeof(unique_ptr<CompletionRecord>) + kMapEntryOverhead +
+      sizeof(*this) + response.capacity();
+}
+
+int64_t ResultTracker::ClientState::memory_footprint(const string& client_id) {
+  return sizeof(string) + client_id.size() + sizeof(unique_ptr<ClientState>) +
+      kMapEntryOverhead + sizeof(ClientState);
+}
+
+ResultTracker::ResultTracker(shared_ptr<MemTracker> parent_mem_tracker)
+    : mem_tracker_(MemTracker::CreateTracker(
+          FLAGS_result_tracker_memory_limit_mb < 0 ?
+              -1 : FLAGS_result_tracker_memory_limit_mb * 1024 * 1024,
+          "result-tracker",
+          parent_mem_tracker)),
+      gc_thread_stop_latch_(1) {
+}
+
+ResultTracker::~ResultTracker() {
+  if (gc_thread_) {
+    gc_thread_stop_latch_.CountDown();
+    gc_thread_->Join();
+  }
+  // Release the memory of whatever is left, so that the MemTracker goes away
+  // balanced.
+  int64_t footprint = 0;
+  for (Shard& shard : shards_) {
+    lock_guard<simple_spinlock> l(shard.lock);
+    for (const auto& cs : shard.clients) {
+      footprint += ClientState::memory_footprint(cs.first);
+      for (const auto& cr : cs.second->completion_records) {
+        footprint += cr.second->memory_footprint();
+      }
+    }
+  }
+  mem_tracker_->Release(footprint);
+}
+
+Status ResultTracker::StartGCThread() {
+  CHECK(!gc_thread_);
+  return Thread::Create("server", "result-tracker", &ResultTracker::RunGCThread,
+                        this, &gc_thread_);
+}
+
+ResultTracker::Shard* ResultTracker::ShardFor(const string& client_id) {
+  return &shards_[std::hash<string>()(client_id) % kNumShards];
+}
+
 ResultTracker::RpcState ResultTracker::TrackRpc(const RequestIdPB& request_id,
                                                 Message* response,
                                                 RpcContext* context) {
-  lock_guard<simple_spinlock> l(lock_);
-  return TrackRpcUnlocked(request_id, response, context);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  return TrackRpcUnlocked(shard, request_id, response, context);
 }
 
-ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& request_id,
+ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(Shard* shard,
+                                                        const RequestIdPB& request_id,
                                                         Message* response,
                                                         RpcContext* context) {
 
   ClientState* client_state = ComputeIfAbsent(
-      &clients_,
+      &shard->clients,
       request_id.client_id(),
-      []{ return unique_ptr<ClientState>(new ClientState()); })->get();
+      [&]{
+        mem_tracker_->Consume(ClientState::memory_footprint(request_id.client_id()));
+        return unique_ptr<ClientState>(new ClientState());
+      })->get();
 
   client_state->last_heard_from = MonoTime::Now(MonoTime::FINE);
 
+  // The client has seen the responses of the RPCs which precede its first
+  // incomplete one, so there's no need to remember them any longer.
+  if (request_id.has_first_incomplete_seq_no()) {
+    GCCompletionRecordsUnlocked(client_state, request_id.first_incomplete_seq_no());
+  }
+
+  // A client originated attempt at an RPC whose record was garbage collected
+  // must not be executed again. Attempts which originate from other replicas
+  // are still tracked, since the operation they carry must be applied.
+  if (PREDICT_FALSE(context != nullptr &&
+                    request_id.seq_no() < client_state->stale_before_seq_no &&
+                    !ContainsKey(client_state->completion_records, request_id.seq_no()))) {
+    Status s = Status::Incomplete(Substitute(
+        "The result of the request with sequence number $0 was already garbage collected, "
+        "the first incomplete sequence number of client $1 is past it",
+        request_id.seq_no(), request_id.client_id()));
+    LogAndTraceFailure(context, ErrorStatusPB::ERROR_REQUEST_STALE, s);
+    context->call_->RespondFailure(ErrorStatusPB::ERROR_REQUEST_STALE, s);
+    delete context;
+    return RpcState::STALE;
+  }
+
   auto result = ComputeIfAbsentReturnAbsense(
       &client_state->completion_records,
       request_id.seq_no(),
@@ -63,6 +174,7 @@ ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& reque
   CompletionRecord* completion_record = result.first->get();
 
   if (PREDICT_TRUE(result.second)) {
+    mem_tracker_->Consume(completion_record->memory_footprint());
     completion_record->state = RpcState::IN_PROGRESS;
     completion_record->driver_attempt_no = request_id.attempt_no();
     // When a follower is applying an operation it doesn't have a response yet, and it won't
@@ -81,7 +193,7 @@ ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& reque
       // non-null) copy the response and reply immediately. If there is no context/response
       // do nothing.
       if (context != nullptr) {
-        DCHECK_NOTNULL(response)->CopyFrom(*completion_record->response);
+        CHECK(DCHECK_NOTNULL(response)->ParseFromString(completion_record->response));
         context->call_->RespondSuccess(*response);
         delete context;
       }
@@ -105,12 +217,13 @@ ResultTracker::RpcState ResultTracker::TrackRpcUnlocked(const RequestIdPB& reque
 }
 
 ResultTracker::RpcState ResultTracker::TrackRpcOrChangeDriver(const RequestIdPB& request_id) {
-  lock_guard<simple_spinlock> l(lock_);
-  RpcState state = TrackRpcUnlocked(request_id, nullptr, nullptr);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  RpcState state = TrackRpcUnlocked(shard, request_id, nullptr, nullptr);
 
   if (state != RpcState::IN_PROGRESS) return state;
 
-  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(request_id);
+  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(shard, request_id);
 
   // ... if we did find a CompletionRecord change the driver and return true.
   completion_record->driver_attempt_no = request_id.attempt_no();
@@ -123,8 +236,9 @@ ResultTracker::RpcState ResultTracker::TrackRpcOrChangeDriver(const RequestIdPB&
 }
 
 bool ResultTracker::IsCurrentDriver(const RequestIdPB& request_id) {
-  lock_guard<simple_spinlock> l(lock_);
-  CompletionRecord* completion_record = FindCompletionRecordOrNullUnlocked(request_id);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  CompletionRecord* completion_record = FindCompletionRecordOrNullUnlocked(shard, request_id);
 
   // If we couldn't find the CompletionRecord, someone might have called FailAndRespond() so
   // just return false.
@@ -169,14 +283,16 @@ void ResultTracker::LogAndTraceFailure(RpcContext* context,
 }
 
 ResultTracker::CompletionRecord* ResultTracker::FindCompletionRecordOrDieUnlocked(
-    const RequestIdPB& request_id) {
-  ClientState* client_state = DCHECK_NOTNULL(FindPointeeOrNull(clients_, request_id.client_id()));
+    Shard* shard, const RequestIdPB& request_id) {
+  ClientState* client_state = DCHECK_NOTNULL(FindPointeeOrNull(shard->clients,
+                                                               request_id.client_id()));
   return DCHECK_NOTNULL(FindPointeeOrNull(client_state->completion_records, request_id.seq_no()));
 }
 
 pair<ResultTracker::ClientState*, ResultTracker::CompletionRecord*>
-ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(const RequestIdPB& request_id) {
-  ClientState* client_state = FindPointeeOrNull(clients_, request_id.client_id());
+ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(Shard* shard,
+                                                               const RequestIdPB& request_id) {
+  ClientState* client_state = FindPointeeOrNull(shard->clients, request_id.client_id());
   CompletionRecord* completion_record = nullptr;
   if (client_state != nullptr) {
     completion_record = FindPointeeOrNull(client_state->completion_records, request_id.seq_no());
@@ -185,23 +301,94 @@ ResultTracker::FindClientStateAndCompletionRecordOrNullUnlocked(const RequestIdP
 }
 
 ResultTracker::CompletionRecord*
-ResultTracker::FindCompletionRecordOrNullUnlocked(const RequestIdPB& request_id) {
-  return FindClientStateAndCompletionRecordOrNullUnlocked(request_id).second;
+ResultTracker::FindCompletionRecordOrNullUnlocked(Shard* shard, const RequestIdPB& request_id) {
+  return FindClientStateAndCompletionRecordOrNullUnlocked(shard, request_id).second;
+}
+
+void ResultTracker::GCCompletionRecordsUnlocked(ClientState* client_state,
+                                                SequenceNumber first_incomplete_seq_no) {
+  if (first_incomplete_seq_no <= client_state->stale_before_seq_no) return;
+  client_state->stale_before_seq_no = first_incomplete_seq_no;
+
+  auto& records = client_state->completion_records;
+  auto end = records.lower_bound(first_incomplete_seq_no);
+  for (auto iter = records.begin(); iter != end;) {
+    const CompletionRecord* record = iter->second.get();
+    // Records with RPCs still attached to them are left to their handlers.
+    if (record->state != RpcState::COMPLETED || !record->ongoing_rpcs.empty()) {
+      ++iter;
+      continue;
+    }
+    mem_tracker_->Release(record->memory_footprint());
+    iter = records.erase(iter);
+  }
+}
+
+void ResultTracker::GCClientStates(Shard* shard, const MonoTime& now, int64_t ttl_ms) {
+  int64_t released = 0;
+  {
+    lock_guard<simple_spinlock> l(shard->lock);
+    for (auto iter = shard->clients.begin(); iter != shard->clients.end();) {
+      const ClientState* client_state = iter->second.get();
+      bool idle = now.GetDeltaSince(client_state->last_heard_from).ToMilliseconds() >= ttl_ms;
+      int64_t footprint = ClientState::memory_footprint(iter->first);
+      for (const auto& cr : client_state->completion_records) {
+        if (!idle) break;
+        idle = cr.second->state == RpcState::COMPLETED && cr.second->ongoing_rpcs.empty();
+        footprint += cr.second->memory_footprint();
+      }
+      if (!idle) {
+        ++iter;
+        continue;
+      }
+      VLOG(2) << "Garbage collecting the state of client " << iter->first;
+      released += footprint;
+      iter = shard->clients.erase(iter);
+    }
+  }
+  mem_tracker_->Release(released);
+}
+
+void ResultTracker::GCResults() {
+  int64_t ttl_ms = FLAGS_remember_clients_ttl_ms;
+  while (true) {
+    MonoTime now = MonoTime::Now(MonoTime::FINE);
+    for (Shard& shard : shards_) {
+      GCClientStates(&shard, now, ttl_ms);
+    }
+    // Drop the clients which were heard from least recently until the memory
+    // is back under the limit.
+    if (ttl_ms == 0 || !mem_tracker_->LimitExceeded()) break;
+    ttl_ms /= 2;
+    KLOG_EVERY_N_SECS(WARNING, 10) << "The cached responses exceed their memory limit of "
+        << mem_tracker_->limit() << " bytes, dropping those of the clients which weren't heard "
+        << "from in the last " << ttl_ms << " ms";
+  }
+}
+
+void ResultTracker::RunGCThread() {
+  while (!gc_thread_stop_latch_.WaitFor(MonoDelta::FromMilliseconds(
+                                            FLAGS_result_tracker_gc_interval_ms))) {
+    GCResults();
+  }
 }
 
 void ResultTracker::RecordCompletionAndRespond(const RequestIdPB& request_id,
                                                const Message* response) {
-  lock_guard<simple_spinlock> l(lock_);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
 
-  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(request_id);
+  CompletionRecord* completion_record = FindCompletionRecordOrDieUnlocked(shard, request_id);
 
   CHECK_EQ(completion_record->driver_attempt_no, request_id.attempt_no())
     << "Called RecordCompletionAndRespond() from an executor identified with an attempt number that"
     << " was not marked as the driver for the RPC. RequestId: " << request_id.ShortDebugString()
-    << "\nTracker state:\n " << ToStringUnlocked();
+    << "\nTracker state:\n " << ClientsToStringUnlocked(shard->clients);
   DCHECK_EQ(completion_record->state, RpcState::IN_PROGRESS);
-  completion_record->response.reset(DCHECK_NOTNULL(response)->New());
-  completion_record->response->CopyFrom(*response);
+  int64_t old_footprint = completion_record->memory_footprint();
+  CHECK(DCHECK_NOTNULL(response)->SerializeToString(&completion_record->response));
+  completion_record->response.shrink_to_fit();
+  mem_tracker_->Consume(completion_record->memory_footprint() - old_footprint);
   completion_record->state = RpcState::COMPLETED;
 
   CHECK_EQ(completion_record->driver_attempt_no, request_id.attempt_no());
@@ -216,7 +403,7 @@ void ResultTracker::RecordCompletionAndRespond(const RequestIdPB& request_id,
     if (MustHandleRpc(handler_attempt_no, completion_record, ongoing_rpc)) {
       if (ongoing_rpc.context != nullptr) {
         if (PREDICT_FALSE(ongoing_rpc.response != response)) {
-          ongoing_rpc.response->CopyFrom(*completion_record->response);
+          ongoing_rpc.response->CopyFrom(*response);
         }
         LogAndTraceAndRespondSuccess(ongoing_rpc.context, *ongoing_rpc.response);
       }
@@ -231,12 +418,13 @@ void ResultTracker::RecordCompletionAndRespond(const RequestIdPB& request_id,
 
 void ResultTracker::FailAndRespondInternal(const RequestIdPB& request_id,
                                            HandleOngoingRpcFunc func) {
-  lock_guard<simple_spinlock> l(lock_);
-  auto state_and_record = FindClientStateAndCompletionRecordOrNullUnlocked(request_id);
+  Shard* shard = ShardFor(request_id.client_id());
+  lock_guard<simple_spinlock> l(shard->lock);
+  auto state_and_record = FindClientStateAndCompletionRecordOrNullUnlocked(shard, request_id);
 
   if (PREDICT_FALSE(state_and_record.first == nullptr)) {
     LOG(FATAL) << "Couldn't find ClientState for request: " << request_id.ShortDebugString()
-        << ". \nTracker state:\n" << ToStringUnlocked();
+        << ". \nTracker state:\n" << ClientsToStringUnlocked(shard->clients);
   }
 
   CompletionRecord* completion_record = state_and_record.second;
@@ -272,6 +460,7 @@ void ResultTracker::FailAndRespondInternal(const RequestIdPB& request_id,
   // delete the completion record.
   if (completion_record->ongoing_rpcs.size() == 0
       && completion_record->state != RpcState::COMPLETED) {
+    mem_tracker_->Release(completion_record->memory_footprint());
     unique_ptr<CompletionRecord> completion_record =
         EraseKeyReturnValuePtr(&state_and_record.first->completion_records, seq_no);
   }
@@ -310,17 +499,20 @@ void ResultTracker::FailAndRespond(const RequestIdPB& request_id,
 }
 
 string ResultTracker::ToString() {
-  lock_guard<simple_spinlock> l(lock_);
-  return ToStringUnlocked();
+  string result = Substitute("ResultTracker[this: $0, Client States:\n", this);
+  for (Shard& shard : shards_) {
+    lock_guard<simple_spinlock> l(shard.lock);
+    result.append(ClientsToStringUnlocked(shard.clients));
+  }
+  result.append("]");
+  return result;
 }
 
-string ResultTracker::ToStringUnlocked() const {
-  string result = Substitute("ResultTracker[this: $0, Num. Client States: $1, Client States:\n",
-                             this, clients_.size());
-  for (auto& cs : clients_) {
+string ResultTracker::ClientsToStringUnlocked(const ClientStateMap& clients) {
+  string result;
+  for (auto& cs : clients) {
     SubstituteAndAppend(&result, Substitute("\n\tClient: $0, $1", cs.first, cs.second->ToString()));
   }
-  result.append("]");
   return result;
 }
 
@@ -340,7 +532,8 @@ string ResultTracker::ClientState::ToString() const {
 string ResultTracker::CompletionRecord::ToString() const {
   string result = Substitute("Completion Record[State: $0, Driver: $1, Num. Ongoing RPCs: $2, "
                                  "Cached response: $3, OngoingRpcs:", state, driver_attempt_no,
-                             ongoing_rpcs.size(), response ? response->ShortDebugString() : "None");
+                             ongoing_rpcs.size(),
+                             response.empty() ? "None" : Substitute("$0 bytes", response.size()));
   for (auto& orpc : ongoing_rpcs) {
     SubstituteAndAppend(&result, Substitute("\n\t$0", orpc.ToString()));
   }
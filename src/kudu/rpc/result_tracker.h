@@ -17,6 +17,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -25,8 +26,10 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/rpc/request_tracker.h"
 #include "kudu/rpc/rpc_header.pb.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/status.h"
 
 namespace google {
 namespace protobuf {
@@ -35,6 +38,10 @@ class Message;
 } // google
 
 namespace kudu {
+
+class MemTracker;
+class Thread;
+
 namespace rpc {
 class RpcContext;
 
@@ -137,10 +144,32 @@ class RpcContext;
 //   }
 // }
 //
-// This class is thread safe.
+// ============================================================================
+// Memory bookkeeping and garbage collection
+// ============================================================================
+//
+// Responses are cached in their serialized form, which is several times
+// smaller than the protobufs they were parsed from, and the memory taken by
+// the client states and their completion records is charged to a MemTracker
+// whose limit is --result_tracker_memory_limit_mb.
 //
-// TODO Memory bookkeeping.
-// TODO Garbage collection.
+// Clients tell the server the first sequence number they haven't yet seen the
+// response of, in 'first_incomplete_seq_no', so when tracking an RPC the
+// completion records of the client with lower sequence numbers are dropped
+// right away. A later attempt at one of those, e.g. a duplicate which lingered
+// in the network, gets STALE and an ERROR_REQUEST_STALE error instead of being
+// executed again.
+//
+// Once the GC thread is started, it also drops the clients which haven't been
+// heard from in --remember_clients_ttl_ms and have no RPC in progress. While
+// the memory limit is exceeded, it keeps halving that TTL until enough clients
+// were dropped. A client which comes back after having been dropped has its
+// RPCs treated as NEW.
+//
+// The clients are spread over a fixed number of shards by client ID, each with
+// a lock of its own, so that the RPCs of different clients don't contend.
+//
+// This class is thread safe.
 class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
  public:
   typedef rpc::RequestTracker::SequenceNumber SequenceNumber;
@@ -160,8 +189,15 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     STALE
   };
 
-  ResultTracker() {}
-  ~ResultTracker() {}
+  // 'parent_mem_tracker' is the parent of the tracker to which the tracked
+  // state is charged; if null, the root tracker is.
+  explicit ResultTracker(
+      std::shared_ptr<MemTracker> parent_mem_tracker = std::shared_ptr<MemTracker>());
+  ~ResultTracker();
+
+  // Starts the thread which periodically drops the state of the clients which
+  // haven't been heard from in a while. The thread is stopped on destruction.
+  Status StartGCThread();
 
   // Tracks the RPC and returns its current state.
   //
@@ -171,6 +207,8 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   // If the RpcState is anything else all remaining actions will be taken care of internally,
   // i.e. the caller no longer needs to execute the RPC and this takes ownership of the passed
   // 'response' and 'context'.
+  //
+  // STALE is only returned for client originated attempts, i.e. when 'context' is non-null.
   RpcState TrackRpc(const RequestIdPB& request_id,
                     google::protobuf::Message* response,
                     RpcContext* context);
@@ -220,6 +258,9 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
                       int error_ext_id, const std::string& message,
                       const google::protobuf::Message& app_error_pb);
 
+  // Runs a garbage collection pass, as the GC thread does. Exposed for tests.
+  void GCResults();
+
   string ToString();
 
  private:
@@ -238,21 +279,44 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
     RpcState state;
     // The attempt number that is/was "driving" this RPC.
     int64_t driver_attempt_no;
-    // The cached response, if this RPC is in COMPLETED state.
-    std::unique_ptr<google::protobuf::Message> response;
+    // The serialized cached response, if this RPC is in COMPLETED state.
+    std::string response;
     // The set of ongoing RPCs that correspond to this record.
     std::vector<OnGoingRpcInfo> ongoing_rpcs;
 
+    // The memory charged to the MemTracker for this record.
+    int64_t memory_footprint() const;
+
     std::string ToString() const;
   };
   // The state corresponding to a single client.
   struct ClientState {
     MonoTime last_heard_from;
+    // The completion records of the sequence numbers lower than this one were
+    // garbage collected.
+    SequenceNumber stale_before_seq_no = 0;
     std::map<SequenceNumber, std::unique_ptr<CompletionRecord>> completion_records;
+
+    // The memory charged to the MemTracker for this client, not including
+    // its completion records.
+    static int64_t memory_footprint(const std::string& client_id);
+
     std::string ToString() const;
   };
+  typedef std::map<std::string, std::unique_ptr<ClientState>> ClientStateMap;
+
+  // A subset of the clients, and the lock protecting them and the state
+  // contained in each of their ClientStates.
+  struct Shard {
+    simple_spinlock lock;
+    ClientStateMap clients;
+  };
+  static const int kNumShards = 16;
 
-  RpcState TrackRpcUnlocked(const RequestIdPB& request_id,
+  Shard* ShardFor(const std::string& client_id);
+
+  RpcState TrackRpcUnlocked(Shard* shard,
+                            const RequestIdPB& request_id,
                             google::protobuf::Message* response,
                             RpcContext* context);
 
@@ -263,10 +327,24 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void FailAndRespondInternal(const rpc::RequestIdPB& request_id,
                               HandleOngoingRpcFunc func);
 
-  CompletionRecord* FindCompletionRecordOrNullUnlocked(const RequestIdPB& request_id);
-  CompletionRecord* FindCompletionRecordOrDieUnlocked(const RequestIdPB& request_id);
+  CompletionRecord* FindCompletionRecordOrNullUnlocked(Shard* shard,
+                                                       const RequestIdPB& request_id);
+  CompletionRecord* FindCompletionRecordOrDieUnlocked(Shard* shard,
+                                                      const RequestIdPB& request_id);
   std::pair<ClientState*, CompletionRecord*> FindClientStateAndCompletionRecordOrNullUnlocked(
-      const RequestIdPB& request_id);
+      Shard* shard, const RequestIdPB& request_id);
+
+  // Drops the completed records of 'client_state' whose sequence numbers are
+  // lower than 'first_incomplete_seq_no'.
+  void GCCompletionRecordsUnlocked(ClientState* client_state,
+                                   SequenceNumber first_incomplete_seq_no);
+
+  // Drops the clients of 'shard' which haven't been heard from in the 'ttl_ms'
+  // before 'now' and have no RPC in progress.
+  void GCClientStates(Shard* shard, const MonoTime& now, int64_t ttl_ms);
+
+  // Body of the GC thread.
+  void RunGCThread();
 
   // A handler must handle an RPC attempt if:
   // 1 - It's its own attempt. I.e. it has the same attempt number of the handler.
@@ -288,14 +366,14 @@ class ResultTracker : public RefCountedThreadSafe<ResultTracker> {
   void LogAndTraceFailure(RpcContext* context, ErrorStatusPB_RpcErrorCodePB err,
                           const Status& status);
 
-  std::string ToStringUnlocked() const;
+  static std::string ClientsToStringUnlocked(const ClientStateMap& clients);
+
+  Shard shards_[kNumShards];
 
+  std::shared_ptr<MemTracker> mem_tracker_;
 
-  // Lock that protects access to 'clients_' and to the state contained in each
-  // ClientState.
-  // TODO consider a per-ClientState lock if we find this too coarse grained.
-  simple_spinlock lock_;
-  std::map<std::string, std::unique_ptr<ClientState>> clients_;
+  CountDownLatch gc_thread_stop_latch_;
+  scoped_refptr<Thread> gc_thread_;
 
   DISALLOW_COPY_AND_ASSIGN(ResultTracker);
 };
@@ -15,17 +15,28 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <cmath>
 #include <functional>
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <thread>
 
 #include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/rpc-test-base.h"
 #include "kudu/rpc/rtest.proxy.h"
 #include "kudu/util/countdown_latch.h"
+#include "kudu/util/env.h"
+#include "kudu/util/hdr_histogram.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/test_util.h"
 
 using std::bind;
@@ -34,11 +45,12 @@ using std::string;
 using std::thread;
 using std::unique_ptr;
 using std::vector;
+using strings::Substitute;
 
 DEFINE_int32(client_threads, 16,
              "Number of client threads. For the synchronous benchmark, each thread has "
              "a single outstanding synchronous request at a time. For the async "
-             "benchmark, this determines the number of client reactors.");
+             "benchmarks, this determines the number of client reactors.");
 
 DEFINE_int32(async_call_concurrency, 60,
              "Number of concurrent requests that will be outstanding at a time for the "
@@ -53,14 +65,207 @@ DEFINE_int32(server_reactors, 4,
 
 DEFINE_int32(run_seconds, 1, "Seconds to run the test");
 
+DEFINE_string(method_mix, "add",
+              "Comma-separated list of the methods to call, each optionally followed "
+              "by ':<relative weight>'. Valid methods are 'add' (a trivial handler), "
+              "'payload' (see --request_bytes, --response_bytes, "
+              "--response_sidecar_bytes and --handler_cpu_micros) and 'sleep' "
+              "(see --handler_sleep_micros). Example: 'add:8,payload:2'.");
+DEFINE_int32(request_bytes, 0, "Size of the request payload of 'payload' calls");
+DEFINE_int32(response_bytes, 0, "Size of the response payload of 'payload' calls");
+DEFINE_int32(response_sidecar_bytes, 0,
+             "Size of the sidecar attached to the responses of 'payload' calls");
+DEFINE_int32(handler_cpu_micros, 0,
+             "CPU time spent by the server handling each 'payload' call");
+DEFINE_int32(handler_sleep_micros, 100,
+             "Time the server sleeps for while handling each 'sleep' call");
+
+DEFINE_double(open_loop_qps, 5000,
+              "Mean rate of the Poisson arrivals of the open-loop benchmark");
+DEFINE_int32(open_loop_max_outstanding, 1000,
+             "Arrivals of the open-loop benchmark which would exceed this many "
+             "outstanding calls are dropped, and counted as such in the results");
+
+DEFINE_string(sweep_connections, "1,4",
+              "Comma-separated values of --rpc_connections_per_peer run by the "
+              "sweep benchmark");
+DEFINE_string(sweep_server_reactors, "1,4",
+              "Comma-separated numbers of server reactors run by the sweep benchmark");
+
+DEFINE_string(json_output_path, "",
+              "If set, the results of all the benchmarks run by this process are "
+              "written to this file as a JSON array");
+
+DECLARE_int32(rpc_connections_per_peer);
+
 namespace kudu {
 namespace rpc {
 
+namespace {
+
+// Latencies are recorded in microseconds, up to a minute.
+const uint64_t kMaxLatencyMicros = 60 * 1000 * 1000;
+
+vector<int> ParseIntList(const string& flag_name, const string& value) {
+  vector<int> ret;
+  for (const string& s : strings::Split(value, ",", strings::SkipEmpty())) {
+    int32 i;
+    CHECK(safe_strto32(s, &i) && i > 0) << "bad value in --" << flag_name << ": " << s;
+    ret.push_back(i);
+  }
+  return ret;
+}
+
+// The JSON results of the benchmarks run so far, for --json_output_path.
+simple_spinlock json_results_lock;
+vector<string> json_results;
+
+} // anonymous namespace
+
+enum class BenchMethod {
+  kAdd,
+  kPayload,
+  kSleep
+};
+
+// Weighted choice among the methods of --method_mix.
+class MethodMix {
+ public:
+  MethodMix() : total_weight_(0) {
+    for (const string& entry : strings::Split(FLAGS_method_mix, ",", strings::SkipEmpty())) {
+      vector<string> parts = strings::Split(entry, ":");
+      CHECK_LE(parts.size(), 2) << "bad --method_mix entry: " << entry;
+      int32 weight = 1;
+      if (parts.size() == 2) {
+        CHECK(safe_strto32(parts[1], &weight) && weight >= 0)
+            << "bad --method_mix weight: " << entry;
+      }
+      BenchMethod method;
+      if (parts[0] == "add") {
+        method = BenchMethod::kAdd;
+      } else if (parts[0] == "payload") {
+        method = BenchMethod::kPayload;
+      } else if (parts[0] == "sleep") {
+        method = BenchMethod::kSleep;
+      } else {
+        LOG(FATAL) << "unknown --method_mix method: " << parts[0];
+      }
+      if (weight > 0) {
+        total_weight_ += weight;
+        cumulative_weights_.emplace_back(total_weight_, method);
+      }
+    }
+    CHECK_GT(total_weight_, 0) << "--method_mix must name at least one method";
+  }
+
+  BenchMethod Pick(Random* rng) const {
+    if (cumulative_weights_.size() == 1) {
+      return cumulative_weights_[0].second;
+    }
+    uint32_t r = rng->Uniform(total_weight_);
+    for (const auto& e : cumulative_weights_) {
+      if (r < e.first) {
+        return e.second;
+      }
+    }
+    LOG(FATAL) << "unreachable";
+    return BenchMethod::kAdd;
+  }
+
+ private:
+  uint32_t total_weight_;
+  vector<std::pair<uint32_t, BenchMethod>> cumulative_weights_;
+};
+
+// The request and response of a single call, reused across calls when
+// the caller has only one outstanding at a time.
+class BenchCall {
+ public:
+  BenchCall() {
+    add_req_.set_x(1);
+    add_req_.set_y(2);
+    payload_req_.mutable_data()->assign(FLAGS_request_bytes, 'r');
+    payload_req_.set_response_size(FLAGS_response_bytes);
+    payload_req_.set_response_sidecar_size(FLAGS_response_sidecar_bytes);
+    payload_req_.set_handler_cpu_micros(FLAGS_handler_cpu_micros);
+    sleep_req_.set_sleep_micros(FLAGS_handler_sleep_micros);
+  }
+
+  void Call(CalculatorServiceProxy* proxy, BenchMethod method) {
+    PrepareCall(method);
+    switch (method) {
+      case BenchMethod::kAdd:
+        CHECK_OK(proxy->Add(add_req_, &add_resp_, &controller_));
+        break;
+      case BenchMethod::kPayload:
+        CHECK_OK(proxy->Payload(payload_req_, &payload_resp_, &controller_));
+        break;
+      case BenchMethod::kSleep:
+        CHECK_OK(proxy->Sleep(sleep_req_, &sleep_resp_, &controller_));
+        break;
+    }
+    CheckResponse();
+  }
+
+  void CallAsync(CalculatorServiceProxy* proxy, BenchMethod method,
+                 const ResponseCallback& callback) {
+    PrepareCall(method);
+    switch (method) {
+      case BenchMethod::kAdd:
+        proxy->AddAsync(add_req_, &add_resp_, &controller_, callback);
+        break;
+      case BenchMethod::kPayload:
+        proxy->PayloadAsync(payload_req_, &payload_resp_, &controller_, callback);
+        break;
+      case BenchMethod::kSleep:
+        proxy->SleepAsync(sleep_req_, &sleep_resp_, &controller_, callback);
+        break;
+    }
+  }
+
+  // Checks the outcome of the last call, once it has completed.
+  void CheckResponse() const {
+    CHECK_OK(controller_.status());
+    switch (method_) {
+      case BenchMethod::kAdd:
+        CHECK_EQ(add_req_.x() + add_req_.y(), add_resp_.result());
+        break;
+      case BenchMethod::kPayload:
+        CHECK_EQ(FLAGS_response_bytes, static_cast<int>(payload_resp_.data().size()));
+        if (FLAGS_response_sidecar_bytes > 0) {
+          Slice sidecar;
+          CHECK_OK(controller_.GetSidecar(payload_resp_.sidecar_idx(), &sidecar));
+          CHECK_EQ(FLAGS_response_sidecar_bytes, static_cast<int>(sidecar.size()));
+        }
+        break;
+      case BenchMethod::kSleep:
+        break;
+    }
+  }
+
+ private:
+  void PrepareCall(BenchMethod method) {
+    method_ = method;
+    controller_.Reset();
+    controller_.set_timeout(MonoDelta::FromSeconds(10));
+  }
+
+  BenchMethod method_;
+  RpcController controller_;
+  AddRequestPB add_req_;
+  AddResponsePB add_resp_;
+  PayloadRequestPB payload_req_;
+  PayloadResponsePB payload_resp_;
+  SleepRequestPB sleep_req_;
+  SleepResponsePB sleep_resp_;
+};
+
 class RpcBench : public RpcTestBase {
  public:
   RpcBench()
       : should_run_(true),
-        stop_(0)
+        stop_(0),
+        dropped_calls_(0)
   {}
 
   void SetUp() override {
@@ -73,37 +278,152 @@ class RpcBench : public RpcTestBase {
     StartTestServerWithGeneratedCode(&server_addr_);
   }
 
-  void SummarizePerf(CpuTimes elapsed, int total_reqs, bool sync) {
+  // Restarts the server with 'num_reactors' reactor threads.
+  void RestartServer(int num_reactors) {
+    server_messenger_->UnregisterService(service_name_);
+    service_pool_->Shutdown();
+    server_messenger_->Shutdown();
+    service_pool_ = nullptr;
+    n_server_reactor_threads_ = num_reactors;
+    ASSERT_NO_FATAL_FAILURE(StartTestServerWithGeneratedCode(&server_addr_));
+  }
+
+  // Prepares for a new run of a benchmark.
+  void ResetRun() {
+    Release_Store(&should_run_, true);
+    latency_hist_.reset(new HdrHistogram(kMaxLatencyMicros, 3));
+    Release_Store(&dropped_calls_, 0);
+  }
+
+  void RecordLatency(const MonoTime& start) {
+    MonoDelta latency = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start);
+    latency_hist_->Increment(latency.ToMicroseconds());
+  }
+
+  // Runs --async_call_concurrency closed-loop calls, spread across
+  // 'num_messengers' client messengers of 'reactors_per_messenger' reactors.
+  int64_t RunAsyncClosedLoop(int num_messengers, int reactors_per_messenger);
+
+  void SummarizePerf(CpuTimes elapsed, int64_t total_reqs, bool sync) {
+    SummarizePerf(sync ? "BenchmarkCalls" : "BenchmarkCallsAsync", elapsed, total_reqs,
+                  sync ? "Sync" : "Async");
+  }
+
+  void SummarizePerf(const string& name, CpuTimes elapsed, int64_t total_reqs,
+                     const string& mode) {
     float reqs_per_second = static_cast<float>(total_reqs / elapsed.wall_seconds());
     float user_cpu_micros_per_req = static_cast<float>(elapsed.user / 1000.0 / total_reqs);
     float sys_cpu_micros_per_req = static_cast<float>(elapsed.system / 1000.0 / total_reqs);
     float csw_per_req = static_cast<float>(elapsed.context_switches) / total_reqs;
 
-    LOG(INFO) << "Mode:            " << (sync ? "Sync" : "Async");
-    if (sync) {
+    LOG(INFO) << "Mode:            " << mode;
+    if (mode == "Sync") {
       LOG(INFO) << "Client threads:   " << FLAGS_client_threads;
+    } else if (mode == "OpenLoop") {
+      LOG(INFO) << "Client reactors:  " << FLAGS_client_threads;
+      LOG(INFO) << "Target QPS:       " << FLAGS_open_loop_qps;
+      LOG(INFO) << "Dropped calls:    " << Acquire_Load(&dropped_calls_);
     } else {
       LOG(INFO) << "Client reactors:  " << FLAGS_client_threads;
       LOG(INFO) << "Call concurrency: " << FLAGS_async_call_concurrency;
     }
 
     LOG(INFO) << "Worker threads:   " << FLAGS_worker_threads;
-    LOG(INFO) << "Server reactors:  " << FLAGS_server_reactors;
+    LOG(INFO) << "Server reactors:  " << n_server_reactor_threads_;
+    LOG(INFO) << "Connections/peer: " << FLAGS_rpc_connections_per_peer;
+    LOG(INFO) << "Method mix:       " << FLAGS_method_mix;
     LOG(INFO) << "----------------------------------";
     LOG(INFO) << "Reqs/sec:         " << reqs_per_second;
     LOG(INFO) << "User CPU per req: " << user_cpu_micros_per_req << "us";
     LOG(INFO) << "Sys CPU per req:  " << sys_cpu_micros_per_req << "us";
     LOG(INFO) << "Ctx Sw. per req:  " << csw_per_req;
-
+    LOG(INFO) << "Latency p50:      " << latency_hist_->ValueAtPercentile(50) << "us";
+    LOG(INFO) << "Latency p99:      " << latency_hist_->ValueAtPercentile(99) << "us";
+    LOG(INFO) << "Latency p99.9:    " << latency_hist_->ValueAtPercentile(99.9) << "us";
+    LOG(INFO) << "Latency max:      " << latency_hist_->MaxValue() << "us";
+
+    std::stringstream json;
+    JsonWriter jw(&json, JsonWriter::COMPACT);
+    jw.StartObject();
+    jw.String("name");
+    jw.String(name);
+    jw.String("mode");
+    jw.String(mode);
+    jw.String("client_threads");
+    jw.Int(FLAGS_client_threads);
+    jw.String("async_call_concurrency");
+    jw.Int(FLAGS_async_call_concurrency);
+    jw.String("open_loop_qps");
+    jw.Double(FLAGS_open_loop_qps);
+    jw.String("worker_threads");
+    jw.Int(FLAGS_worker_threads);
+    jw.String("server_reactors");
+    jw.Int(n_server_reactor_threads_);
+    jw.String("connections_per_peer");
+    jw.Int(FLAGS_rpc_connections_per_peer);
+    jw.String("method_mix");
+    jw.String(FLAGS_method_mix);
+    jw.String("request_bytes");
+    jw.Int(FLAGS_request_bytes);
+    jw.String("response_bytes");
+    jw.Int(FLAGS_response_bytes);
+    jw.String("response_sidecar_bytes");
+    jw.Int(FLAGS_response_sidecar_bytes);
+    jw.String("total_reqs");
+    jw.Int64(total_reqs);
+    jw.String("dropped_reqs");
+    jw.Int64(Acquire_Load(&dropped_calls_));
+    jw.String("wall_seconds");
+    jw.Double(elapsed.wall_seconds());
+    jw.String("reqs_per_sec");
+    jw.Double(reqs_per_second);
+    jw.String("user_cpu_us_per_req");
+    jw.Double(user_cpu_micros_per_req);
+    jw.String("sys_cpu_us_per_req");
+    jw.Double(sys_cpu_micros_per_req);
+    jw.String("ctx_switches_per_req");
+    jw.Double(csw_per_req);
+    jw.String("latency_us");
+    jw.StartObject();
+    jw.String("p50");
+    jw.Uint64(latency_hist_->ValueAtPercentile(50));
+    jw.String("p99");
+    jw.Uint64(latency_hist_->ValueAtPercentile(99));
+    jw.String("p999");
+    jw.Uint64(latency_hist_->ValueAtPercentile(99.9));
+    jw.String("max");
+    jw.Uint64(latency_hist_->MaxValue());
+    jw.String("mean");
+    jw.Double(latency_hist_->MeanValue());
+    jw.EndObject();
+    jw.EndObject();
+    LOG(INFO) << "JSON: " << json.str();
+
+    if (!FLAGS_json_output_path.empty()) {
+      std::lock_guard<simple_spinlock> l(json_results_lock);
+      json_results.push_back(json.str());
+      CHECK_OK(WriteStringToFile(Env::Default(),
+                                 "[" + JoinStrings(json_results, ",\n") + "]\n",
+                                 FLAGS_json_output_path));
+    }
   }
 
  protected:
   friend class ClientThread;
   friend class ClientAsyncWorkload;
+  friend class ClientOpenLoopWorkload;
 
   Sockaddr server_addr_;
   Atomic32 should_run_;
   CountDownLatch stop_;
+  MethodMix method_mix_;
+
+  // Latencies of the calls of the current run, in microseconds.
+  gscoped_ptr<HdrHistogram> latency_hist_;
+
+  // Calls of the current open-loop run which were not sent because too many
+  // were outstanding.
+  Atomic32 dropped_calls_;
 };
 
 class ClientThread {
@@ -126,27 +446,25 @@ class ClientThread {
 
     CalculatorServiceProxy p(client_messenger, bench_->server_addr_);
 
-    AddRequestPB req;
-    AddResponsePB resp;
+    Random rng(SeedRandom());
+    BenchCall call;
     while (Acquire_Load(&bench_->should_run_)) {
-      req.set_x(request_count_);
-      req.set_y(request_count_);
-      RpcController controller;
-      controller.set_timeout(MonoDelta::FromSeconds(10));
-      CHECK_OK(p.Add(req, &resp, &controller));
-      CHECK_EQ(req.x() + req.y(), resp.result());
+      MonoTime start = MonoTime::Now(MonoTime::FINE);
+      call.Call(&p, bench_->method_mix_.Pick(&rng));
+      bench_->RecordLatency(start);
       request_count_++;
     }
   }
 
   unique_ptr<thread> thread_;
   RpcBench *bench_;
-  int request_count_;
+  int64_t request_count_;
 };
 
 
 // Test making successful RPC calls.
 TEST_F(RpcBench, BenchmarkCalls) {
+  ResetRun();
   Stopwatch sw(Stopwatch::ALL_THREADS);
   sw.start();
 
@@ -159,7 +477,7 @@ TEST_F(RpcBench, BenchmarkCalls) {
   SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
   Release_Store(&should_run_, false);
 
-  int total_reqs = 0;
+  int64_t total_reqs = 0;
 
   for (auto& thr : threads) {
     thr->Join();
@@ -170,33 +488,31 @@ TEST_F(RpcBench, BenchmarkCalls) {
   SummarizePerf(sw.elapsed(), total_reqs, true);
 }
 
+// Keeps a single call outstanding at a time, issuing the next one as soon as
+// the previous completes.
 class ClientAsyncWorkload {
  public:
   ClientAsyncWorkload(RpcBench *bench, shared_ptr<Messenger> messenger)
     : bench_(bench),
       messenger_(messenger),
-      request_count_(0) {
-    controller_.set_timeout(MonoDelta::FromSeconds(10));
+      request_count_(0),
+      rng_(SeedRandom()) {
     proxy_.reset(new CalculatorServiceProxy(messenger_, bench_->server_addr_));
   }
 
   void CallOneRpc() {
     if (request_count_ > 0) {
-      CHECK_OK(controller_.status());
-      CHECK_EQ(req_.x() + req_.y(), resp_.result());
+      call_.CheckResponse();
+      bench_->RecordLatency(start_);
     }
     if (!Acquire_Load(&bench_->should_run_)) {
       bench_->stop_.CountDown();
       return;
     }
-    controller_.Reset();
-    req_.set_x(request_count_);
-    req_.set_y(request_count_);
     request_count_++;
-    proxy_->AddAsync(req_,
-                     &resp_,
-                     &controller_,
-                     bind(&ClientAsyncWorkload::CallOneRpc, this));
+    start_ = MonoTime::Now(MonoTime::FINE);
+    call_.CallAsync(proxy_.get(), bench_->method_mix_.Pick(&rng_),
+                    bind(&ClientAsyncWorkload::CallOneRpc, this));
   }
 
   void Start() {
@@ -206,32 +522,28 @@ class ClientAsyncWorkload {
   RpcBench *bench_;
   shared_ptr<Messenger> messenger_;
   unique_ptr<CalculatorServiceProxy> proxy_;
-  uint32_t request_count_;
-  RpcController controller_;
-  AddRequestPB req_;
-  AddResponsePB resp_;
+  int64_t request_count_;
+  Random rng_;
+  MonoTime start_;
+  BenchCall call_;
 };
 
-TEST_F(RpcBench, BenchmarkCallsAsync) {
-  int threads = FLAGS_client_threads;
+int64_t RpcBench::RunAsyncClosedLoop(int num_messengers, int reactors_per_messenger) {
   int concurrency = FLAGS_async_call_concurrency;
 
   vector<shared_ptr<Messenger>> messengers;
-  for (int i = 0; i < threads; i++) {
-    messengers.push_back(CreateMessenger("Client"));
+  for (int i = 0; i < num_messengers; i++) {
+    messengers.push_back(CreateMessenger("Client", reactors_per_messenger));
   }
 
   vector<unique_ptr<ClientAsyncWorkload>> workloads;
   for (int i = 0; i < concurrency; i++) {
     workloads.emplace_back(
-        new ClientAsyncWorkload(this, messengers[i % threads]));
+        new ClientAsyncWorkload(this, messengers[i % num_messengers]));
   }
 
   stop_.Reset(concurrency);
 
-  Stopwatch sw(Stopwatch::ALL_THREADS);
-  sw.start();
-
   for (int i = 0; i < concurrency; i++) {
     workloads[i]->Start();
   }
@@ -239,17 +551,139 @@ TEST_F(RpcBench, BenchmarkCallsAsync) {
   SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
   Release_Store(&should_run_, false);
 
-  sw.stop();
-
   stop_.Wait();
-  int total_reqs = 0;
+  int64_t total_reqs = 0;
   for (int i = 0; i < concurrency; i++) {
     total_reqs += workloads[i]->request_count_;
   }
+  return total_reqs;
+}
+
+TEST_F(RpcBench, BenchmarkCallsAsync) {
+  ResetRun();
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+  int64_t total_reqs = RunAsyncClosedLoop(FLAGS_client_threads, 1);
+  sw.stop();
 
   SummarizePerf(sw.elapsed(), total_reqs, false);
 }
 
+// Issues calls at the times of a Poisson process of rate --open_loop_qps,
+// regardless of how quickly earlier calls complete. Latency is measured from
+// the time each call was due to be sent, so that a server falling behind
+// shows up in the results rather than slowing down the arrivals.
+class ClientOpenLoopWorkload {
+ public:
+  ClientOpenLoopWorkload(RpcBench* bench, const vector<shared_ptr<Messenger>>& messengers)
+      : bench_(bench),
+        outstanding_(0),
+        request_count_(0),
+        done_(1) {
+    for (const auto& messenger : messengers) {
+      proxies_.emplace_back(new CalculatorServiceProxy(messenger, bench_->server_addr_));
+    }
+  }
+
+  // Generates arrivals until the benchmark is stopped, then waits for the
+  // outstanding calls to complete.
+  void Run() {
+    Random rng(SeedRandom());
+    MonoTime next_arrival = MonoTime::Now(MonoTime::FINE);
+    while (Acquire_Load(&bench_->should_run_)) {
+      // Exponentially distributed inter-arrival times.
+      double interval_secs = -std::log(1.0 - rng.NextDoubleFraction()) / FLAGS_open_loop_qps;
+      next_arrival.AddDelta(MonoDelta::FromSeconds(interval_secs));
+      MonoDelta wait = next_arrival.GetDeltaSince(MonoTime::Now(MonoTime::FINE));
+      if (wait.ToNanoseconds() > 0) {
+        SleepFor(wait);
+      }
+
+      if (base::subtle::NoBarrier_Load(&outstanding_) >= FLAGS_open_loop_max_outstanding) {
+        base::subtle::Barrier_AtomicIncrement(&bench_->dropped_calls_, 1);
+        continue;
+      }
+      base::subtle::Barrier_AtomicIncrement(&outstanding_, 1);
+      request_count_++;
+      auto* call = new OpenLoopCall(next_arrival);
+      call->call.CallAsync(proxies_[request_count_ % proxies_.size()].get(),
+                           bench_->method_mix_.Pick(&rng),
+                           bind(&ClientOpenLoopWorkload::CallDone, this, call));
+    }
+    if (Acquire_Load(&outstanding_) > 0) {
+      done_.Wait();
+    }
+  }
+
+  int64_t request_count() const { return request_count_; }
+
+ private:
+  struct OpenLoopCall {
+    explicit OpenLoopCall(const MonoTime& due) : due(due) {}
+    MonoTime due;
+    BenchCall call;
+  };
+
+  void CallDone(OpenLoopCall* call) {
+    unique_ptr<OpenLoopCall> deleter(call);
+    call->call.CheckResponse();
+    bench_->RecordLatency(call->due);
+    if (base::subtle::Barrier_AtomicIncrement(&outstanding_, -1) == 0 &&
+        !Acquire_Load(&bench_->should_run_)) {
+      done_.CountDown();
+    }
+  }
+
+  RpcBench* bench_;
+  vector<unique_ptr<CalculatorServiceProxy>> proxies_;
+  Atomic32 outstanding_;
+  int64_t request_count_;
+  CountDownLatch done_;
+};
+
+TEST_F(RpcBench, BenchmarkCallsOpenLoop) {
+  vector<shared_ptr<Messenger>> messengers;
+  for (int i = 0; i < FLAGS_client_threads; i++) {
+    messengers.push_back(CreateMessenger("Client"));
+  }
+  ClientOpenLoopWorkload workload(this, messengers);
+
+  ResetRun();
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+  thread generator(&ClientOpenLoopWorkload::Run, &workload);
+  SleepFor(MonoDelta::FromSeconds(FLAGS_run_seconds));
+  Release_Store(&should_run_, false);
+  generator.join();
+  sw.stop();
+
+  SummarizePerf("BenchmarkCallsOpenLoop", sw.elapsed(), workload.request_count(), "OpenLoop");
+}
+
+// Runs the async closed-loop benchmark for each combination of
+// --sweep_server_reactors and --sweep_connections, with a single client
+// messenger of --client_threads reactors so that extra connections may be
+// served by different client reactors too.
+TEST_F(RpcBench, BenchmarkSweep) {
+  vector<int> server_reactors = ParseIntList("sweep_server_reactors",
+                                             FLAGS_sweep_server_reactors);
+  vector<int> connections = ParseIntList("sweep_connections", FLAGS_sweep_connections);
+  google::FlagSaver saver;
+  for (int reactors : server_reactors) {
+    ASSERT_NO_FATAL_FAILURE(RestartServer(reactors));
+    for (int conns : connections) {
+      FLAGS_rpc_connections_per_peer = conns;
+      ResetRun();
+      Stopwatch sw(Stopwatch::ALL_THREADS);
+      sw.start();
+      int64_t total_reqs = RunAsyncClosedLoop(1, FLAGS_client_threads);
+      sw.stop();
+      SummarizePerf(Substitute("BenchmarkSweep/server_reactors=$0/connections=$1",
+                               reactors, conns),
+                    sw.elapsed(), total_reqs, "Async");
+    }
+  }
+}
+
 } // namespace rpc
 } // namespace kudu
-
@@ -15,10 +15,14 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
+
 #include "kudu/rpc/retriable_rpc.h"
 #include "kudu/rpc/rpc.h"
 #include "kudu/rpc/rpc-test-base.h"
 
+DECLARE_int64(remember_clients_ttl_ms);
+
 using std::atomic_int;
 using std::shared_ptr;
 using std::unique_ptr;
@@ -32,15 +36,22 @@ const char* kClientId = "test-client";
 
 void AddRequestId(RpcController* controller,
                   ResultTracker::SequenceNumber sequence_number,
-                  int64_t attempt_no) {
+                  int64_t attempt_no,
+                  ResultTracker::SequenceNumber first_incomplete_seq_no) {
   unique_ptr<RequestIdPB> request_id(new RequestIdPB());
   request_id->set_client_id(kClientId);
   request_id->set_seq_no(sequence_number);
   request_id->set_attempt_no(attempt_no);
-  request_id->set_first_incomplete_seq_no(sequence_number);
+  request_id->set_first_incomplete_seq_no(first_incomplete_seq_no);
   controller->SetRequestIdPB(std::move(request_id));
 }
 
+void AddRequestId(RpcController* controller,
+                  ResultTracker::SequenceNumber sequence_number,
+                  int64_t attempt_no) {
+  AddRequestId(controller, sequence_number, attempt_no, sequence_number);
+}
+
 class TestServerPicker : public ServerPicker<CalculatorServiceProxy> {
  public:
   explicit TestServerPicker(CalculatorServiceProxy* proxy) : proxy_(proxy) {}
@@ -337,5 +348,48 @@ TEST_F(RpcStressTest, TestExactlyOnceSemanticsWithConcurrentUpdaters) {
   }
 }
 
+// Tests that the responses the client has seen are garbage collected, along
+// with the clients which haven't been heard from in a while.
+TEST_F(RpcStressTest, TestResultGarbageCollection) {
+  auto add = [&](ResultTracker::SequenceNumber seq_no, int64_t attempt_no,
+                 ResultTracker::SequenceNumber first_incomplete_seq_no,
+                 ExactlyOnceResponsePB* resp) {
+    RpcController controller;
+    controller.set_timeout(MonoDelta::FromSeconds(20));
+    ExactlyOnceRequestPB req;
+    req.set_value_to_add(1);
+    AddRequestId(&controller, seq_no, attempt_no, first_incomplete_seq_no);
+    Status s = proxy_->AddExactlyOnce(req, resp, &controller);
+    if (!s.ok()) {
+      CHECK(controller.error_response());
+      CHECK_EQ(ErrorStatusPB::ERROR_REQUEST_STALE, controller.error_response()->code());
+    }
+    return s;
+  };
+
+  ExactlyOnceResponsePB resp;
+  ASSERT_OK(add(0, 0, 0, &resp));
+  ASSERT_EQ(1, resp.current_val());
+
+  // While the client hasn't seen the response, a retry gets it.
+  ASSERT_OK(add(0, 1, 0, &resp));
+  ASSERT_EQ(1, resp.current_val());
+
+  // Once it has, a late retry is rejected rather than executed again.
+  ASSERT_OK(add(1, 0, 1, &resp));
+  ASSERT_EQ(2, resp.current_val());
+  Status s = add(0, 2, 0, &resp);
+  ASSERT_TRUE(s.IsRemoteError()) << s.ToString();
+
+  // Idle clients are forgotten, so a retry of their last RPC is executed anew.
+  result_tracker_->GCResults();
+  ASSERT_OK(add(1, 1, 1, &resp));
+  ASSERT_EQ(2, resp.current_val());
+  FLAGS_remember_clients_ttl_ms = 0;
+  result_tracker_->GCResults();
+  ASSERT_OK(add(1, 2, 1, &resp));
+  ASSERT_EQ(3, resp.current_val());
+}
+
 } // namespace rpc
 } // namespace kudu
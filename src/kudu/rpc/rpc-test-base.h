@@ -23,6 +23,7 @@
 #include <memory>
 #include <string>
 
+#include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/rpc/acceptor_pool.h"
 #include "kudu/rpc/messenger.h"
@@ -62,6 +63,8 @@ using kudu::rpc_test::ExactlyOnceResponsePB;
 using kudu::rpc_test::FeatureFlags;
 using kudu::rpc_test::PanicRequestPB;
 using kudu::rpc_test::PanicResponsePB;
+using kudu::rpc_test::PayloadRequestPB;
+using kudu::rpc_test::PayloadResponsePB;
 using kudu::rpc_test::SendTwoStringsRequestPB;
 using kudu::rpc_test::SendTwoStringsResponsePB;
 using kudu::rpc_test::SleepRequestPB;
@@ -221,6 +224,27 @@ class CalculatorService : public CalculatorServiceIf {
     context->RespondSuccess();
   }
 
+  void Payload(const PayloadRequestPB* req, PayloadResponsePB* resp,
+               RpcContext* context) override {
+    if (req->handler_cpu_micros() > 0) {
+      MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+      deadline.AddDelta(MonoDelta::FromMicroseconds(req->handler_cpu_micros()));
+      while (MonoTime::Now(MonoTime::FINE).ComesBefore(deadline)) {
+        base::subtle::PauseCPU();
+      }
+    }
+    resp->mutable_data()->assign(req->response_size(), 'x');
+    if (req->response_sidecar_size() > 0) {
+      gscoped_ptr<faststring> car(new faststring);
+      car->resize(req->response_sidecar_size());
+      memset(car->data(), 'y', car->size());
+      int idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(new RpcSidecar(std::move(car))), &idx));
+      resp->set_sidecar_idx(idx);
+    }
+    context->RespondSuccess();
+  }
+
   void WhoAmI(const WhoAmIRequestPB* req, WhoAmIResponsePB* resp, RpcContext* context) override {
     const UserCredentials& creds = context->user_credentials();
     if (creds.has_effective_user()) {
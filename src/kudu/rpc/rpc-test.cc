@@ -118,6 +118,30 @@ TEST_F(TestRpc, TestCall) {
   }
 }
 
+// Test that a proxy configured with several connections spreads its calls
+// across that many connections, each on a different reactor.
+TEST_F(TestRpc, TestMultipleConnectionsPerPeer) {
+  Sockaddr server_addr;
+  StartTestServer(&server_addr);
+
+  const int kNumConnections = 3;
+  shared_ptr<Messenger> client_messenger(CreateMessenger("Client", kNumConnections));
+  Proxy p(client_messenger, server_addr, GenericCalculatorService::static_service_name());
+  p.set_num_connections(kNumConnections);
+  ASSERT_EQ(kNumConnections, p.num_connections());
+
+  for (int i = 0; i < kNumConnections * 3; i++) {
+    ASSERT_OK(DoTestSyncCall(p, GenericCalculatorService::kAddMethodName));
+  }
+
+  for (int i = 0; i < kNumConnections; i++) {
+    ReactorMetrics metrics;
+    ASSERT_OK(client_messenger->reactors_[i]->GetMetrics(&metrics));
+    ASSERT_EQ(1, metrics.num_client_connections_)
+        << "Reactor " << i << " should have 1 client connection";
+  }
+}
+
 // Test that connecting to an invalid server properly throws an error.
 TEST_F(TestRpc, TestCallToBadServer) {
   shared_ptr<Messenger> client_messenger(CreateMessenger("Client"));
@@ -26,6 +26,7 @@
 #include <boost/bind.hpp>
 
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/rpc_introspection.pb.h"
 #include "kudu/rpc/rpcz_store.h"
 #include "kudu/rpc/rtest.proxy.h"
@@ -38,7 +39,12 @@
 #include "kudu/util/user.h"
 
 DEFINE_bool(is_panic_test_child, false, "Used by TestRpcPanic");
+DECLARE_bool(rpc_compress_messages);
 DECLARE_bool(socket_inject_short_recvs);
+DECLARE_int32(rpc_compression_min_bytes);
+
+METRIC_DECLARE_counter(rpc_compression_input_bytes);
+METRIC_DECLARE_counter(rpc_compression_output_bytes);
 
 using std::shared_ptr;
 using std::unique_ptr;
@@ -125,6 +131,69 @@ TEST_F(RpcStubTest, TestBigCallData) {
   }
 }
 
+// Test many small calls of varying sizes in flight at once, so that several
+// outbound transfers are coalesced into a single write and several inbound
+// frames, some straddling read-ahead boundaries, arrive in a single read.
+TEST_F(RpcStubTest, TestManySmallCallsAtOnce) {
+  const int kNumSentAtOnce = 1000;
+  CalculatorServiceProxy p(client_messenger_, server_addr_);
+
+  vector<unique_ptr<EchoRequestPB>> reqs;
+  vector<unique_ptr<EchoResponsePB>> resps;
+  vector<unique_ptr<RpcController>> controllers;
+
+  CountDownLatch latch(kNumSentAtOnce);
+  for (int i = 0; i < kNumSentAtOnce; i++) {
+    reqs.emplace_back(new EchoRequestPB);
+    reqs.back()->set_data(string((i * 37) % 20000, 'a' + i % 26));
+    resps.emplace_back(new EchoResponsePB);
+    controllers.emplace_back(new RpcController);
+
+    p.EchoAsync(*reqs.back(), resps.back().get(), controllers.back().get(),
+                boost::bind(&CountDownLatch::CountDown, boost::ref(latch)));
+  }
+
+  latch.Wait();
+
+  for (int i = 0; i < kNumSentAtOnce; i++) {
+    ASSERT_OK(controllers[i]->status());
+    ASSERT_EQ(reqs[i]->data(), resps[i]->data());
+  }
+}
+
+// Test that large requests and responses are sent compressed when enabled,
+// and arrive intact.
+TEST_F(RpcStubTest, TestCompressedCalls) {
+  FLAGS_rpc_compress_messages = true;
+  FLAGS_rpc_compression_min_bytes = 1024;
+  CalculatorServiceProxy p(client_messenger_, server_addr_);
+
+  // Small calls are sent as-is.
+  NO_FATALS(SendSimpleCall());
+  scoped_refptr<Counter> input_bytes =
+      METRIC_rpc_compression_input_bytes.Instantiate(metric_entity_);
+  scoped_refptr<Counter> output_bytes =
+      METRIC_rpc_compression_output_bytes.Instantiate(metric_entity_);
+  ASSERT_EQ(0, input_bytes->value());
+
+  string data;
+  for (int i = 0; data.size() < 1024 * 1024; i++) {
+    data.append(strings::Substitute("row $0 of some compressible data\n", i));
+  }
+  EchoRequestPB req;
+  req.set_data(data);
+  EchoResponsePB resp;
+  RpcController controller;
+  ASSERT_OK(p.Echo(req, &resp, &controller));
+  ASSERT_EQ(data, resp.data());
+
+  // The connection was negotiated by the first call, so both the request and
+  // the response were compressed.
+  int64_t data_size = data.size();
+  ASSERT_GT(input_bytes->value(), 2 * data_size);
+  ASSERT_LT(output_bytes->value(), input_bytes->value() / 2);
+}
+
 TEST_F(RpcStubTest, TestRespondDeferred) {
   CalculatorServiceProxy p(client_messenger_, server_addr_);
 
@@ -17,20 +17,37 @@
 
 #include "kudu/rpc/serialization.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <google/protobuf/message_lite.h>
 #include <google/protobuf/io/coded_stream.h>
+#include <lz4.h>
 
 #include "kudu/gutil/endian.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
 DECLARE_int32(rpc_max_message_size);
 
+DEFINE_bool(rpc_compress_messages, false,
+            "Whether to LZ4-compress large RPC requests and responses sent to "
+            "peers which support it. Trades CPU time for network bandwidth.");
+TAG_FLAG(rpc_compress_messages, advanced);
+TAG_FLAG(rpc_compress_messages, runtime);
+
+DEFINE_int32(rpc_compression_min_bytes, 32 * 1024,
+             "RPC messages with bodies smaller than this many bytes are never "
+             "compressed. Only used if --rpc_compress_messages is set.");
+TAG_FLAG(rpc_compression_min_bytes, advanced);
+TAG_FLAG(rpc_compression_min_bytes, runtime);
+
+using std::vector;
+
 using google::protobuf::MessageLite;
 using google::protobuf::io::CodedInputStream;
 using google::protobuf::io::CodedOutputStream;
@@ -152,6 +169,80 @@ Status ParseMessage(const Slice& buf,
   return Status::OK();
 }
 
+bool ShouldCompress(size_t body_size) {
+  return FLAGS_rpc_compress_messages && body_size >= FLAGS_rpc_compression_min_bytes;
+}
+
+bool CompressMessage(const vector<Slice>& body_slices, faststring* compressed) {
+  // LZ4 compresses a contiguous buffer, so gather the body if need be.
+  faststring gathered;
+  Slice body;
+  if (body_slices.size() == 1) {
+    body = body_slices[0];
+  } else {
+    size_t total_size = 0;
+    for (const Slice& s : body_slices) {
+      total_size += s.size();
+    }
+    gathered.reserve(total_size);
+    for (const Slice& s : body_slices) {
+      gathered.append(s.data(), s.size());
+    }
+    body = Slice(gathered);
+  }
+
+  int max_len = LZ4_compressBound(body.size());
+  int max_delim_len = CodedOutputStream::VarintSize32(max_len);
+  compressed->resize(max_delim_len + max_len);
+  int n = LZ4_compress(reinterpret_cast<const char*>(body.data()),
+                       reinterpret_cast<char*>(compressed->data() + max_delim_len),
+                       body.size());
+  if (n <= 0) {
+    return false;
+  }
+  int delim_len = CodedOutputStream::VarintSize32(n);
+  if (static_cast<size_t>(delim_len + n) >= body.size()) {
+    return false;
+  }
+  // Slide the compressed bytes down if the delimiter turned out shorter
+  // than we left room for.
+  if (delim_len != max_delim_len) {
+    memmove(compressed->data() + delim_len, compressed->data() + max_delim_len, n);
+  }
+  CodedOutputStream::WriteVarint32ToArray(n, compressed->data());
+  compressed->resize(delim_len + n);
+  return true;
+}
+
+Status UncompressMessage(const Slice& compressed,
+                         uint32_t uncompressed_size,
+                         faststring* buf,
+                         Slice* parsed_main_message) {
+  if (PREDICT_FALSE(uncompressed_size > static_cast<uint32_t>(FLAGS_rpc_max_message_size))) {
+    return Status::Corruption(
+        Substitute("Invalid packet: uncompressed size $0 is larger than the maximum "
+                   "message size $1", uncompressed_size, FLAGS_rpc_max_message_size));
+  }
+  buf->resize(uncompressed_size);
+  int n = LZ4_decompress_safe(reinterpret_cast<const char*>(compressed.data()),
+                              reinterpret_cast<char*>(buf->data()),
+                              compressed.size(), uncompressed_size);
+  if (PREDICT_FALSE(n < 0 || static_cast<uint32_t>(n) != uncompressed_size)) {
+    return Status::Corruption(
+        Substitute("Invalid packet: unable to uncompress $0 bytes into $1 bytes",
+                   compressed.size(), uncompressed_size));
+  }
+
+  CodedInputStream in(buf->data(), buf->size());
+  uint32_t main_msg_len;
+  if (PREDICT_FALSE(!in.ReadVarint32(&main_msg_len) ||
+                    in.CurrentPosition() + main_msg_len != buf->size())) {
+    return Status::Corruption("Invalid packet: bad main msg length in uncompressed body");
+  }
+  *parsed_main_message = Slice(buf->data() + in.CurrentPosition(), main_msg_len);
+  return Status::OK();
+}
+
 void SerializeConnHeader(uint8_t* buf) {
   memcpy(reinterpret_cast<char *>(buf), kMagicNumber, kMagicNumberLength);
   buf += kMagicNumberLength;
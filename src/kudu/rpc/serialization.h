@@ -20,6 +20,7 @@
 
 #include <inttypes.h>
 #include <string.h>
+#include <vector>
 
 namespace google {
 namespace protobuf {
@@ -76,6 +77,31 @@ Status ParseMessage(const Slice& buf,
 
 // Serialize the RPC connection header (magic number + flags).
 // buf must have 7 bytes available (kMagicNumberLength + kHeaderFlagsLength).
+// Returns true if a message body of 'body_size' bytes should be sent
+// compressed to a peer which supports the COMPRESSION feature, according to
+// the --rpc_compress_messages and --rpc_compression_min_bytes flags.
+bool ShouldCompress(size_t body_size);
+
+// Compress the message body made up of the concatenation of 'body_slices'
+// (i.e. everything following the header, including the varint delimiter of
+// the main message) into 'compressed'. The result is itself framed as a main
+// message, so that ParseMessage() returns the compressed bytes as the main
+// message, which UncompressMessage() then turns back into the original.
+//
+// Returns false, leaving 'compressed' in an unspecified state, if compression
+// would not make the body any smaller.
+bool CompressMessage(const std::vector<Slice>& body_slices,
+                     faststring* compressed);
+
+// Uncompress the main message 'compressed', returned by ParseMessage() for a
+// message whose header indicated an uncompressed body of 'uncompressed_size'
+// bytes, into 'buf'. On success, 'parsed_main_message' points into 'buf' and is
+// what ParseMessage() would have returned for the uncompressed message.
+Status UncompressMessage(const Slice& compressed,
+                         uint32_t uncompressed_size,
+                         faststring* buf,
+                         Slice* parsed_main_message);
+
 void SerializeConnHeader(uint8_t* buf);
 
 // Validate the entire rpc header (magic number + flags).
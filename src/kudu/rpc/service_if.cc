@@ -28,6 +28,7 @@
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/rpc/rpc_header.pb.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/sampling_profiler.h"
 
 // TODO remove this once we have ResultTracker GC
 DEFINE_bool(enable_exactly_once, false, "Whether to enable exactly once semantics on the client "
@@ -92,6 +93,7 @@ void GeneratedServiceIf::Handle(InboundCall *call) {
     RespondBadMethod(call);
     return;
   }
+  ScopedSamplingProfilerTag profiler_tag(method_info->full_name);
   unique_ptr<Message> req(method_info->req_prototype->New());
   if (PREDICT_FALSE(!ParseParam(call, req.get()))) {
     return;
@@ -117,6 +119,7 @@ void GeneratedServiceIf::Handle(InboundCall *call) {
         break;
       case ResultTracker::COMPLETED:
       case ResultTracker::IN_PROGRESS:
+      case ResultTracker::STALE:
         return;
       default:
         LOG(FATAL) << "Unknown state: " << state;
@@ -53,11 +53,21 @@ struct RpcMethodInfo : public RefCountedThreadSafe<RpcMethodInfo> {
   std::unique_ptr<google::protobuf::Message> req_prototype;
   std::unique_ptr<google::protobuf::Message> resp_prototype;
 
+  // The fully qualified name of the method, e.g.
+  // "kudu.tserver.TabletServerService.Write". Points to a string literal.
+  const char* full_name = nullptr;
+
   scoped_refptr<Histogram> handler_latency_histogram;
 
   // Whether we should track this method's result, using ResultTracker.
   bool track_result;
 
+  // The priority of this method's calls in the service queue, and the
+  // percentage of the queue they may occupy. See the 'rpc_priority' and
+  // 'rpc_queue_quota_pct' method options in rpc_header.proto.
+  int priority = 0;
+  int queue_quota_pct = 100;
+
   // The actual function to be called.
   std::function<void(const google::protobuf::Message* req,
                      google::protobuf::Message* resp,
@@ -17,6 +17,7 @@
 
 #include "kudu/rpc/service_pool.h"
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
 #include <string>
@@ -29,8 +30,11 @@
 #include "kudu/rpc/service_if.h"
 #include "kudu/rpc/service_queue.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/numa.h"
 #include "kudu/util/status.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/trace.h"
@@ -38,6 +42,14 @@
 using std::shared_ptr;
 using strings::Substitute;
 
+DEFINE_int32(rpc_service_queue_shards, 1,
+             "Number of shards to split each RPC service queue into. Producers "
+             "queue calls onto the shard of their CPU, and workers steal from "
+             "other shards when their own is empty. Priority and deadline "
+             "ordering only holds within a shard. If 0, uses one shard per CPU.");
+TAG_FLAG(rpc_service_queue_shards, advanced);
+TAG_FLAG(rpc_service_queue_shards, experimental);
+
 METRIC_DEFINE_histogram(server, rpc_incoming_queue_time,
                         "RPC Queue Time",
                         kudu::MetricUnit::kMicroseconds,
@@ -63,7 +75,11 @@ ServicePool::ServicePool(gscoped_ptr<ServiceIf> service,
                          const scoped_refptr<MetricEntity>& entity,
                          size_t service_queue_length)
   : service_(std::move(service)),
-    service_queue_(service_queue_length),
+    service_queue_(service_queue_length,
+                   NumaPlacementEnabled() ? NumaNodeCount() :
+                   FLAGS_rpc_service_queue_shards > 0 ? FLAGS_rpc_service_queue_shards
+                                                      : base::NumCPUs(),
+                   NumaPlacementEnabled()),
     incoming_queue_time_(METRIC_rpc_incoming_queue_time.Instantiate(entity)),
     rpcs_timed_out_in_queue_(METRIC_rpcs_timed_out_in_queue.Instantiate(entity)),
     rpcs_queue_overflow_(METRIC_rpcs_queue_overflow.Instantiate(entity)),
@@ -75,10 +91,12 @@ ServicePool::~ServicePool() {
 }
 
 Status ServicePool::Init(int num_threads) {
+  // Spread the workers over the NUMA nodes, matching the reactors.
+  bool numa = NumaPlacementEnabled();
   for (int i = 0; i < num_threads; i++) {
     scoped_refptr<kudu::Thread> new_thread;
     CHECK_OK(kudu::Thread::Create("service pool", "rpc worker",
-        &ServicePool::RunThread, this, &new_thread));
+        &ServicePool::RunThread, this, numa ? i % NumaNodeCount() : -1, &new_thread));
     threads_.push_back(new_thread);
   }
   return Status::OK();
@@ -105,14 +123,23 @@ void ServicePool::Shutdown() {
   service_->Shutdown();
 }
 
-void ServicePool::RejectTooBusy(InboundCall* c) {
-  string err_msg =
-      Substitute("$0 request on $1 from $2 dropped due to backpressure. "
-                 "The service queue is full; it has $3 items.",
-                 c->remote_method().method_name(),
-                 service_->service_name(),
-                 c->remote_address().ToString(),
-                 service_queue_.max_size());
+void ServicePool::RejectTooBusy(InboundCall* c, QueueStatus reason) {
+  string err_msg;
+  if (reason == QUEUE_OVER_QUOTA) {
+    err_msg = Substitute("$0 request on $1 from $2 dropped due to backpressure. "
+                         "$0 calls already take up $3% of the service queue.",
+                         c->remote_method().method_name(),
+                         service_->service_name(),
+                         c->remote_address().ToString(),
+                         c->method_info()->queue_quota_pct);
+  } else {
+    err_msg = Substitute("$0 request on $1 from $2 dropped due to backpressure. "
+                         "The service queue is full; it has $3 items.",
+                         c->remote_method().method_name(),
+                         service_->service_name(),
+                         c->remote_address().ToString(),
+                         service_queue_.max_size());
+  }
   rpcs_queue_overflow_->Increment();
   KLOG_EVERY_N_SECS(WARNING, 1) << err_msg;
   c->RespondFailure(ErrorStatusPB::ERROR_SERVER_TOO_BUSY,
@@ -145,13 +172,13 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
   // Queue message on service queue
   boost::optional<InboundCall*> evicted;
   auto queue_status = service_queue_.Put(c, &evicted);
-  if (queue_status == QUEUE_FULL) {
-    RejectTooBusy(c);
+  if (queue_status == QUEUE_FULL || queue_status == QUEUE_OVER_QUOTA) {
+    RejectTooBusy(c, queue_status);
     return Status::OK();
   }
 
   if (PREDICT_FALSE(evicted != boost::none)) {
-    RejectTooBusy(*evicted);
+    RejectTooBusy(*evicted, QUEUE_FULL);
   }
 
   if (PREDICT_TRUE(queue_status == QUEUE_SUCCESS)) {
@@ -172,7 +199,11 @@ Status ServicePool::QueueInboundCall(gscoped_ptr<InboundCall> call) {
   return status;
 }
 
-void ServicePool::RunThread() {
+void ServicePool::RunThread(int numa_node) {
+  if (numa_node != -1) {
+    WARN_NOT_OK(BindCurrentThreadToNumaNode(numa_node),
+                Substitute("Unable to bind RPC worker to NUMA node $0", numa_node));
+  }
   while (true) {
     std::unique_ptr<InboundCall> incoming;
     if (!service_queue_.BlockingGet(&incoming)) {
@@ -76,8 +76,10 @@ class ServicePool : public RpcService {
   const std::string service_name() const;
 
  private:
-  void RunThread();
-  void RejectTooBusy(InboundCall* c);
+  // The body of each worker thread. If 'numa_node' is not -1, the thread is
+  // bound to that NUMA node first.
+  void RunThread(int numa_node);
+  void RejectTooBusy(InboundCall* c, QueueStatus reason);
 
   gscoped_ptr<ServiceIf> service_;
   std::vector<scoped_refptr<kudu::Thread> > threads_;
@@ -43,6 +43,9 @@ DEFINE_int32(num_consumers, 20,
 DEFINE_int32(max_queue_size, 50,
              "Max queue length");
 
+DEFINE_int32(num_shards, 1,
+             "Number of queue shards");
+
 namespace kudu {
 namespace rpc {
 
@@ -90,8 +93,100 @@ void ConsumerThread(Queue* queue) {
   }
 }
 
+// Test that calls are dequeued by priority, that higher-priority calls evict
+// lower-priority ones from a full queue, and that per-method quotas apply.
+TEST(TestServiceQueue, TestPriorityAndQuota) {
+  LifoServiceQueue queue(4);
+  scoped_refptr<RpcMethodInfo> low(new RpcMethodInfo());
+  low->queue_quota_pct = 50;
+  scoped_refptr<RpcMethodInfo> high(new RpcMethodInfo());
+  high->priority = 1;
+
+  auto new_call = [](const scoped_refptr<RpcMethodInfo>& info) {
+    InboundCall* call = new InboundCall(nullptr);
+    call->set_method_info(info);
+    return call;
+  };
+
+  boost::optional<InboundCall*> evicted;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(QUEUE_SUCCESS, queue.Put(new_call(low), &evicted));
+  }
+  // The low-priority method may only take up half of the queue.
+  unique_ptr<InboundCall> rejected(new_call(low));
+  ASSERT_EQ(QUEUE_OVER_QUOTA, queue.Put(rejected.get(), &evicted));
+
+  for (int i = 0; i < 2; i++) {
+    ASSERT_EQ(QUEUE_SUCCESS, queue.Put(new_call(high), &evicted));
+  }
+  ASSERT_TRUE(evicted == boost::none);
+
+  // The queue is full, so another high-priority call bumps a low-priority one.
+  ASSERT_EQ(QUEUE_SUCCESS, queue.Put(new_call(high), &evicted));
+  ASSERT_TRUE(evicted != boost::none);
+  ASSERT_EQ(low.get(), evicted.get()->method_info());
+  delete evicted.get();
+
+  // Consumers are bound to the first queue they read from, so drain this one
+  // from a dedicated thread.
+  vector<const RpcMethodInfo*> dequeued;
+  std::thread consumer([&]() {
+    unique_ptr<InboundCall> call;
+    while (queue.BlockingGet(&call)) {
+      dequeued.push_back(call->method_info());
+      call.reset();
+    }
+  });
+  queue.Shutdown();
+  consumer.join();
+
+  vector<const RpcMethodInfo*> expected = { high.get(), high.get(), high.get(), low.get() };
+  ASSERT_EQ(expected, dequeued);
+}
+
+// Test that consumers of a sharded queue steal calls queued on shards other
+// than their own, and that none are stranded when consumers go to sleep.
+TEST(TestServiceQueue, TestShardedQueueStealing) {
+  const int kNumShards = 4;
+  const int kNumCalls = 1000;
+  LifoServiceQueue queue(kNumCalls, kNumShards);
+  ASSERT_EQ(kNumShards, queue.num_shards());
+
+  std::atomic<int> received(0);
+  vector<std::thread> consumers;
+  for (int i = 0; i < kNumShards; i++) {
+    consumers.emplace_back([&]() {
+      unique_ptr<InboundCall> call;
+      while (queue.BlockingGet(&call)) {
+        received++;
+        call.reset();
+      }
+    });
+  }
+
+  for (int i = 0; i < kNumCalls; i++) {
+    boost::optional<InboundCall*> evicted;
+    ASSERT_EQ(QUEUE_SUCCESS, queue.Put(new InboundCall(nullptr), &evicted));
+    ASSERT_TRUE(evicted == boost::none);
+    if (i % 100 == 0) {
+      // Give the consumers a chance to go idle.
+      SleepFor(MonoDelta::FromMilliseconds(1));
+    }
+  }
+  for (int i = 0; i < 10000 && received.load() < kNumCalls; i++) {
+    SleepFor(MonoDelta::FromMilliseconds(1));
+  }
+  ASSERT_EQ(kNumCalls, received.load());
+
+  queue.Shutdown();
+  for (auto& t : consumers) {
+    t.join();
+  }
+  ASSERT_TRUE(queue.empty());
+}
+
 TEST(TestServiceQueue, LifoServiceQueuePerf) {
-  LifoServiceQueue queue(FLAGS_max_queue_size);
+  LifoServiceQueue queue(FLAGS_max_queue_size, FLAGS_num_shards);
   vector<std::thread> producers;
   vector<std::thread> consumers;
 
@@ -14,47 +14,118 @@
 // KIND, either express or implied.  See the License for the
 // specific language governing permissions and limitations
 // under the License.
-
 #include "kudu/rpc/service_queue.h"
 
+#include <algorithm>
 #include <mutex>
+#include <sched.h>
 
 #include "kudu/util/logging.h"
+#include "kudu/util/numa.h"
 
 namespace kudu {
 namespace rpc {
 
 __thread LifoServiceQueue::ConsumerState* LifoServiceQueue::tl_consumer_ = nullptr;
 
-LifoServiceQueue::LifoServiceQueue(int max_size)
+LifoServiceQueue::LifoServiceQueue(int max_size, int num_shards, bool shard_by_numa_node)
    : shutdown_(false),
-     max_queue_size_(max_size) {
+     max_queue_size_(max_size),
+     shard_by_numa_node_(shard_by_numa_node),
+     num_queued_(0),
+     num_waiting_(0) {
   CHECK_GT(max_queue_size_, 0);
+  CHECK_GT(num_shards, 0);
+  for (int i = 0; i < num_shards; i++) {
+    shards_.emplace_back(new Shard());
+  }
 }
 
 LifoServiceQueue::~LifoServiceQueue() {
-  DCHECK(queue_.empty())
+  DCHECK_EQ(0, num_queued_.load())
       << "ServiceQueue holds bare pointers at destruction time";
 }
 
+int LifoServiceQueue::ProducerShard() const {
+  if (shards_.size() == 1) {
+    return 0;
+  }
+  if (shard_by_numa_node_) {
+    return CurrentNumaNode() % shards_.size();
+  }
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+#else
+  int cpu = 0;
+#endif
+  return cpu % shards_.size();
+}
+
+int LifoServiceQueue::ConsumerHomeShard() const {
+  if (shard_by_numa_node_) {
+    return CurrentNumaNode() % shards_.size();
+  }
+  return consumers_.size() % shards_.size();
+}
+
+LifoServiceQueue::ConsumerState* LifoServiceQueue::PopWaitingConsumerUnlocked(int shard) {
+  DCHECK(!waiting_consumers_.empty());
+  auto it = waiting_consumers_.end() - 1;
+  if (shard_by_numa_node_) {
+    for (auto rit = waiting_consumers_.rbegin(); rit != waiting_consumers_.rend(); ++rit) {
+      if ((*rit)->home_shard() == shard) {
+        it = rit.base() - 1;
+        break;
+      }
+    }
+  }
+  ConsumerState* consumer = *it;
+  waiting_consumers_.erase(it);
+  num_waiting_--;
+  return consumer;
+}
+
+bool LifoServiceQueue::TryGet(int home_shard, std::unique_ptr<InboundCall>* out) {
+  int n = shards_.size();
+  for (int i = 0; i < n; i++) {
+    if (num_queued_.load() == 0) {
+      return false;
+    }
+    Shard* shard = shards_[(home_shard + i) % n].get();
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    if (!shard->queue.empty()) {
+      auto it = shard->queue.begin();
+      out->reset(*it);
+      EraseUnlocked(shard, it);
+      return true;
+    }
+  }
+  return false;
+}
+
 bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
   auto consumer = tl_consumer_;
   if (PREDICT_FALSE(!consumer)) {
-    consumer = tl_consumer_ = new ConsumerState(this);
     std::lock_guard<simple_spinlock> l(lock_);
+    consumer = tl_consumer_ = new ConsumerState(this, ConsumerHomeShard());
     consumers_.emplace_back(consumer);
   }
 
   while (true) {
+    if (TryGet(consumer->home_shard(), out)) {
+      return true;
+    }
     {
       std::lock_guard<simple_spinlock> l(lock_);
-      if (!queue_.empty()) {
-        auto it = queue_.begin();
-        out->reset(*it);
-        queue_.erase(it);
-        return true;
+      // Announce that we're about to wait before the final check for work,
+      // so that a producer queueing a call concurrently knows to wake us.
+      num_waiting_++;
+      if (num_queued_.load() > 0) {
+        num_waiting_--;
+        continue;
       }
       if (PREDICT_FALSE(shutdown_)) {
+        num_waiting_--;
         return false;
       }
       consumer->DCheckBoundInstance(this);
@@ -65,62 +136,137 @@ bool LifoServiceQueue::BlockingGet(std::unique_ptr<InboundCall>* out) {
       out->reset(call);
       return true;
     }
-    // if call == nullptr, this means we are shutting down the queue.
-    // Loop back around and re-check 'shutdown_'.
+    // if call == nullptr, this means we are shutting down the queue, or that
+    // a call was queued onto some shard. Loop back around and re-check both.
   }
 }
 
 QueueStatus LifoServiceQueue::Put(InboundCall* call,
                                   boost::optional<InboundCall*>* evicted) {
-  std::unique_lock<simple_spinlock> l(lock_);
-  if (PREDICT_FALSE(shutdown_)) {
-    return QUEUE_SHUTDOWN;
+  int shard_idx = ProducerShard();
+
+  // fast path
+  if (num_queued_.load() == 0 && num_waiting_.load() > 0) {
+    std::unique_lock<simple_spinlock> l(lock_);
+    if (PREDICT_FALSE(shutdown_)) {
+      return QUEUE_SHUTDOWN;
+    }
+    if (!waiting_consumers_.empty() && num_queued_.load() == 0) {
+      auto consumer = PopWaitingConsumerUnlocked(shard_idx);
+      // Notify condition var(and wake up consumer thread) takes time,
+      // so put it out of spinlock scope.
+      l.unlock();
+      consumer->Post(call);
+      return QUEUE_SUCCESS;
+    }
   }
 
-  DCHECK(!(waiting_consumers_.size() > 0 && queue_.size() > 0));
+  Shard* shard = shards_[shard_idx].get();
+  {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    if (PREDICT_FALSE(shutdown_)) {
+      return QUEUE_SHUTDOWN;
+    }
+
+    if (PREDICT_FALSE(!ReserveQuota(call))) {
+      return QUEUE_OVER_QUOTA;
+    }
 
-  // fast path
-  if (queue_.empty() && waiting_consumers_.size() > 0) {
-    auto consumer = waiting_consumers_[waiting_consumers_.size() - 1];
-    waiting_consumers_.pop_back();
-    // Notify condition var(and wake up consumer thread) takes time,
-    // so put it out of spinlock scope.
-    l.unlock();
-    consumer->Post(call);
-    return QUEUE_SUCCESS;
-  }
-
-  if (PREDICT_FALSE(queue_.size() >= max_queue_size_)) {
-    // eviction
-    DCHECK_EQ(queue_.size(), max_queue_size_);
-    auto it = queue_.end();
-    --it;
-    if (DeadlineLess(*it, call)) {
-      return QUEUE_FULL;
+    if (PREDICT_FALSE(num_queued_.load() >= max_queue_size_)) {
+      // eviction: only calls in this producer's own shard are candidates.
+      if (shard->queue.empty()) {
+        ReleaseQuota(call);
+        return QUEUE_FULL;
+      }
+      auto it = shard->queue.end();
+      --it;
+      if (CallLess(*it, call)) {
+        ReleaseQuota(call);
+        return QUEUE_FULL;
+      }
+
+      *evicted = *it;
+      EraseUnlocked(shard, it);
     }
 
-    *evicted = *it;
-    queue_.erase(it);
+    shard->queue.insert(call);
+    num_queued_++;
   }
 
-  queue_.insert(call);
+  // Make sure a consumer which went to sleep before the call was queued
+  // picks it up.
+  if (num_waiting_.load() > 0) {
+    WakeWaitingConsumer(shard_idx);
+  }
   return QUEUE_SUCCESS;
 }
 
+void LifoServiceQueue::WakeWaitingConsumer(int shard) {
+  ConsumerState* consumer;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    if (waiting_consumers_.empty()) {
+      return;
+    }
+    consumer = PopWaitingConsumerUnlocked(shard);
+  }
+  consumer->Post(nullptr);
+}
+
+void LifoServiceQueue::EraseUnlocked(Shard* shard, CallSet::iterator it) {
+  ReleaseQuota(*it);
+  shard->queue.erase(it);
+  num_queued_--;
+}
+
+bool LifoServiceQueue::ReserveQuota(const InboundCall* call) {
+  const RpcMethodInfo* info = call->method_info();
+  if (!info || info->queue_quota_pct >= 100) {
+    return true;
+  }
+  int quota = std::max(1, max_queue_size_ * info->queue_quota_pct / 100);
+  std::lock_guard<simple_spinlock> l(quota_lock_);
+  int& count = queued_per_method_[info];
+  if (count >= quota) {
+    return false;
+  }
+  count++;
+  return true;
+}
+
+void LifoServiceQueue::ReleaseQuota(const InboundCall* call) {
+  const RpcMethodInfo* info = call->method_info();
+  if (!info || info->queue_quota_pct >= 100) {
+    return;
+  }
+  std::lock_guard<simple_spinlock> l(quota_lock_);
+  auto count = queued_per_method_.find(info);
+  DCHECK(count != queued_per_method_.end());
+  if (--count->second == 0) {
+    queued_per_method_.erase(count);
+  }
+}
+
 void LifoServiceQueue::Shutdown() {
   std::lock_guard<simple_spinlock> l(lock_);
+  for (auto& shard : shards_) {
+    shard->lock.lock();
+  }
   shutdown_ = true;
+  for (auto& shard : shards_) {
+    shard->lock.unlock();
+  }
 
   // Post a nullptr to wake up any consumers which are waiting.
   for (auto* cs : waiting_consumers_) {
     cs->Post(nullptr);
   }
+  num_waiting_ -= waiting_consumers_.size();
   waiting_consumers_.clear();
 }
 
 bool LifoServiceQueue::empty() const {
-  std::lock_guard<simple_spinlock> l(lock_);
-  return queue_.empty();
+  return num_queued_.load() == 0;
 }
 
 int LifoServiceQueue::max_size() const {
@@ -130,10 +276,12 @@ int LifoServiceQueue::max_size() const {
 std::string LifoServiceQueue::ToString() const {
   std::string ret;
 
-  std::lock_guard<simple_spinlock> l(lock_);
-  for (const auto* t : queue_) {
-    ret.append(t->ToString());
-    ret.append("\n");
+  for (const auto& shard : shards_) {
+    std::lock_guard<simple_spinlock> l(shard->lock);
+    for (const auto* t : shard->queue) {
+      ret.append(t->ToString());
+      ret.append("\n");
+    }
   }
   return ret;
 }
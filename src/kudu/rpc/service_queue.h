@@ -17,14 +17,18 @@
 #ifndef KUDU_UTIL_SERVICE_QUEUE_H
 #define KUDU_UTIL_SERVICE_QUEUE_H
 
+#include <atomic>
 #include <boost/optional.hpp>
 #include <memory>
 #include <string>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/rpc/inbound_call.h"
+#include "kudu/rpc/service_if.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/locks.h"
 #include "kudu/util/mutex.h"
 
 namespace kudu {
@@ -34,13 +38,16 @@ namespace rpc {
 enum QueueStatus {
   QUEUE_SUCCESS = 0,
   QUEUE_SHUTDOWN = 1,
-  QUEUE_FULL = 2
+  QUEUE_FULL = 2,
+  QUEUE_OVER_QUOTA = 3
 };
 
 // Blocking queue used for passing inbound RPC calls to the service handler pool.
-// Calls are dequeued in 'earliest-deadline first' order. The queue also maintains a
-// bounded number of calls. If the queue overflows, then calls with deadlines farthest
-// in the future are evicted.
+// Calls are dequeued in order of their method's priority (see RpcMethodInfo), and
+// in 'earliest-deadline first' order among calls of the same priority. The queue
+// also maintains a bounded number of calls. If the queue overflows, then the
+// lowest-priority calls with deadlines farthest in the future are evicted. Each
+// method may additionally be limited to a percentage of the queue's capacity.
 //
 // When calls do not provide deadlines, the RPC layer considers their deadline to
 // be infinitely in the future. This means that any call that does have a deadline
@@ -62,12 +69,28 @@ enum QueueStatus {
 //   work rate, the queue implementation itself is never used. Thus, we can
 //   have a priority queue without paying extra for it in the common case.
 //
+// The queue may be split into several shards, each with its own lock, to avoid
+// contention between many producers and consumers. A producer queues a call onto
+// the shard of the CPU it is running on, and each consumer takes calls from its
+// "home" shard first, stealing from the other shards when its own is empty.
+// With more than one shard, the priority and deadline ordering described above
+// holds only within each shard, and the bound on the number of queued calls may
+// briefly be exceeded by concurrent producers.
+//
+// If 'shard_by_numa_node' is set, there is one shard per NUMA node rather than
+// per CPU, and a consumer's home shard is the node it runs on once it first
+// takes from the queue. When a producer hands a call straight to a waiting
+// consumer, it then picks the most recently busy one on its own node if any.
+// This keeps calls on the node of the reactor thread which read them, provided
+// both the reactors and the consumers are bound to nodes.
+//
 // NOTE: because of the use of thread-local consumer records, once a consumer
 // thread accesses one LifoServiceQueue, it becomes "bound" to that queue and
 // must never access any other instance.
 class LifoServiceQueue {
  public:
-  explicit LifoServiceQueue(int max_size);
+  explicit LifoServiceQueue(int max_size, int num_shards = 1,
+                            bool shard_by_numa_node = false);
 
   ~LifoServiceQueue();
 
@@ -78,8 +101,10 @@ class LifoServiceQueue {
   // Add a new call to the queue.
   // Returns:
   // - QUEUE_SHUTDOWN if Shutdown() has already been called.
-  // - QUEUE_FULL if the queue is full and 'call' has a later deadline than any
-  //   RPC already in the queue.
+  // - QUEUE_FULL if the queue is full and 'call' has a lower priority or later
+  //   deadline than any RPC already in the queue.
+  // - QUEUE_OVER_QUOTA if calls to the method of 'call' already occupy their
+  //   share of the queue.
   // - QUEUE_SUCCESS if 'call' was enqueued.
   //
   // In the case of a 'QUEUE_SUCCESS' response, the new element may have bumped
@@ -100,25 +125,16 @@ class LifoServiceQueue {
 
   std::string ToString() const;
 
+  int num_shards() const { return shards_.size(); }
+
   // Return an estimate of the current queue length.
   int estimated_queue_length() const {
-    ANNOTATE_IGNORE_READS_BEGIN();
-    // The C++ standard says that std::multiset::size must be constant time,
-    // so this method won't try to traverse any actual nodes of the underlying
-    // RB tree. Investigation of the libstdcxx implementation confirms that
-    // size() is a simple field access of the _Rb_tree structure.
-    int ret = queue_.size();
-    ANNOTATE_IGNORE_READS_END();
-    return ret;
+    return num_queued_.load(std::memory_order_relaxed);
   }
 
   // Return an estimate of the number of idle threads currently awaiting work.
   int estimated_idle_worker_count() const {
-    ANNOTATE_IGNORE_READS_BEGIN();
-    // Size of a vector is a simple field access so this is safe.
-    int ret = waiting_consumers_.size();
-    ANNOTATE_IGNORE_READS_END();
-    return ret;
+    return num_waiting_.load(std::memory_order_relaxed);
   }
 
  private:
@@ -136,23 +152,85 @@ class LifoServiceQueue {
     return time_a.ComesBefore(time_b);
   }
 
-  // Struct functor wrapper for DeadlineLess.
-  struct DeadlineLessStruct {
+  static int Priority(const InboundCall* call) {
+    const RpcMethodInfo* info = call->method_info();
+    return info ? info->priority : 0;
+  }
+
+  // Comparison function which orders calls by their priority, and then by
+  // their deadlines.
+  static bool CallLess(const InboundCall* a,
+                       const InboundCall* b) {
+    int prio_a = Priority(a);
+    int prio_b = Priority(b);
+    if (prio_a != prio_b) {
+      return prio_a > prio_b;
+    }
+    return DeadlineLess(a, b);
+  }
+
+  // Struct functor wrapper for CallLess.
+  struct CallLessStruct {
     bool operator()(const InboundCall* a, const InboundCall* b) const {
-      return DeadlineLess(a, b);
+      return CallLess(a, b);
     }
   };
 
+  typedef std::multiset<InboundCall*, CallLessStruct> CallSet;
+
+  // One shard of the queue.
+  struct Shard {
+    simple_spinlock lock;
+
+    // Work is only added to the queue when there were no consumers available
+    // for a "direct hand-off".
+    CallSet queue;
+  };
+
+  class ConsumerState;
+
+  // Returns the index of the shard that calls queued by the current thread
+  // should go to.
+  int ProducerShard() const;
+
+  // Returns the shard that the current thread should take calls from first.
+  int ConsumerHomeShard() const;
+
+  // Pops the most recently pushed waiting consumer, preferring one whose home
+  // shard is 'shard'. Requires that 'lock_' is held and that there is a
+  // waiting consumer.
+  ConsumerState* PopWaitingConsumerUnlocked(int shard);
+
+  // Take the first call from the consumer's home shard, or failing that, from
+  // any other shard. Returns false if all shards are empty.
+  bool TryGet(int home_shard, std::unique_ptr<InboundCall>* out);
+
+  // Remove the call at 'it' from 'shard', updating the queued call counts.
+  // Requires that 'shard->lock' is held.
+  void EraseUnlocked(Shard* shard, CallSet::iterator it);
+
+  // Reserve a queue slot for 'call' against its method's queue quota, if it
+  // has one. Returns false if the method is already at its quota.
+  bool ReserveQuota(const InboundCall* call);
+
+  // Return a slot reserved with ReserveQuota().
+  void ReleaseQuota(const InboundCall* call);
+
+  // Wake up a waiting consumer, if there is one, so that it rescans the shards
+  // starting from its own. Prefers one whose home shard is 'shard'.
+  void WakeWaitingConsumer(int shard);
+
   // The thread-local record corresponding to a single consumer thread.
   // Threads push this record onto the waiting_consumers_ stack when
   // they are awaiting work. Producers pop the top waiting consumer and
   // post work using Post().
   class ConsumerState {
    public:
-    explicit ConsumerState(LifoServiceQueue* queue) :
+    ConsumerState(LifoServiceQueue* queue, int home_shard) :
         cond_(&lock_),
         call_(nullptr),
         should_wake_(false),
+        home_shard_(home_shard),
         bound_queue_(queue) {
     }
 
@@ -179,12 +257,17 @@ class LifoServiceQueue {
       DCHECK_EQ(q, bound_queue_);
     }
 
+    int home_shard() const { return home_shard_; }
+
    private:
     Mutex lock_;
     ConditionVariable cond_;
     InboundCall* call_;
     bool should_wake_;
 
+    // The shard this consumer takes calls from before stealing from others.
+    const int home_shard_;
+
     // For the purpose of assertions, tracks the LifoServiceQueue instance that
     // this consumer is reading from.
     LifoServiceQueue* bound_queue_;
@@ -192,16 +275,30 @@ class LifoServiceQueue {
 
   static __thread ConsumerState* tl_consumer_;
 
+  // Protects 'waiting_consumers_' and 'consumers_'. Also held, along with
+  // every shard lock, when setting 'shutdown_'.
   mutable simple_spinlock lock_;
   bool shutdown_;
   int max_queue_size_;
+  const bool shard_by_numa_node_;
 
   // Stack of consumer threads which are currently waiting for work.
   std::vector<ConsumerState*> waiting_consumers_;
 
-  // The actual queue. Work is only added to the queue when there were no
-  // consumers available for a "direct hand-off".
-  std::multiset<InboundCall*, DeadlineLessStruct> queue_;
+  // The queue itself.
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // The number of calls queued across all shards, and the number of consumers
+  // which are waiting or about to wait for work. A producer increments the
+  // former and then checks the latter; a consumer does the opposite. Hence
+  // either the consumer sees the queued call, or the producer wakes it up.
+  std::atomic<int> num_queued_;
+  std::atomic<int> num_waiting_;
+
+  // The number of queued calls per method, for the methods which have a
+  // queue quota.
+  simple_spinlock quota_lock_;
+  std::unordered_map<const RpcMethodInfo*, int> queued_per_method_;
 
   // The total set of consumers who have ever accessed this queue.
   std::vector<std::unique_ptr<ConsumerState>> consumers_;
@@ -18,7 +18,9 @@
 #include "kudu/rpc/transfer.h"
 
 #include <stdint.h>
+#include <string.h>
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -26,6 +28,7 @@
 
 #include "kudu/gutil/endian.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/rpc/buffer_pool.h"
 #include "kudu/rpc/constants.h"
 #include "kudu/rpc/messenger.h"
 #include "kudu/util/flag_tags.h"
@@ -67,10 +70,22 @@ using strings::Substitute;
 TransferCallbacks::~TransferCallbacks()
 {}
 
-InboundTransfer::InboundTransfer()
-  : total_length_(kMsgLengthPrefixLength),
+InboundTransfer::InboundTransfer(std::shared_ptr<BufferPool> buffer_pool)
+  : buffer_pool_(std::move(buffer_pool)),
+    total_length_(kMsgLengthPrefixLength),
     cur_offset_(0) {
-  buf_.resize(kMsgLengthPrefixLength);
+  if (buffer_pool_) {
+    buf_ = buffer_pool_->Acquire(kMsgLengthPrefixLength);
+  } else {
+    buf_.reset(new faststring());
+  }
+  buf_->resize(kMsgLengthPrefixLength);
+}
+
+InboundTransfer::~InboundTransfer() {
+  if (buffer_pool_) {
+    buffer_pool_->Release(buf_.Pass());
+  }
 }
 
 Status InboundTransfer::ReceiveBuffer(Socket &socket) {
@@ -78,7 +93,7 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
     // receive int32 length prefix
     int32_t rem = kMsgLengthPrefixLength - cur_offset_;
     int32_t nread;
-    Status status = socket.Recv(&buf_[cur_offset_], rem, &nread);
+    Status status = socket.Recv(&(*buf_)[cur_offset_], rem, &nread);
     RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
     if (nread == 0) {
       return Status::OK();
@@ -93,20 +108,7 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
     // Since we only read 'rem' bytes above, we should now have exactly
     // the length prefix in our buffer and no more.
     DCHECK_EQ(cur_offset_, kMsgLengthPrefixLength);
-
-    // The length prefix doesn't include its own 4 bytes, so we have to
-    // add that back in.
-    total_length_ = NetworkByteOrder::Load32(&buf_[0]) + kMsgLengthPrefixLength;
-    if (total_length_ > FLAGS_rpc_max_message_size) {
-      return Status::NetworkError(Substitute(
-          "RPC frame had a length of $0, but we only support messages up to $1 bytes "
-          "long.", total_length_, FLAGS_rpc_max_message_size));
-    }
-    if (total_length_ <= kMsgLengthPrefixLength) {
-      return Status::NetworkError(Substitute("RPC frame had invalid length of $0",
-                                             total_length_));
-    }
-    buf_.resize(total_length_);
+    RETURN_NOT_OK(ProcessLengthPrefix());
 
     // Fall through to receive the message body, which is likely to be already
     // available on the socket.
@@ -115,13 +117,58 @@ Status InboundTransfer::ReceiveBuffer(Socket &socket) {
   // receive message body
   int32_t nread;
   int32_t rem = total_length_ - cur_offset_;
-  Status status = socket.Recv(&buf_[cur_offset_], rem, &nread);
+  Status status = socket.Recv(&(*buf_)[cur_offset_], rem, &nread);
   RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
   cur_offset_ += nread;
 
   return Status::OK();
 }
 
+Status InboundTransfer::ConsumeBytes(const Slice& data, size_t* consumed) {
+  size_t pos = 0;
+  if (cur_offset_ < kMsgLengthPrefixLength) {
+    size_t n = std::min<size_t>(kMsgLengthPrefixLength - cur_offset_, data.size());
+    memcpy(&(*buf_)[cur_offset_], data.data(), n);
+    cur_offset_ += n;
+    pos += n;
+    if (cur_offset_ < kMsgLengthPrefixLength) {
+      *consumed = pos;
+      return Status::OK();
+    }
+    RETURN_NOT_OK(ProcessLengthPrefix());
+  }
+
+  size_t n = std::min<size_t>(total_length_ - cur_offset_, data.size() - pos);
+  memcpy(&(*buf_)[cur_offset_], data.data() + pos, n);
+  cur_offset_ += n;
+  *consumed = pos + n;
+  return Status::OK();
+}
+
+Status InboundTransfer::ProcessLengthPrefix() {
+  // The length prefix doesn't include its own 4 bytes, so we have to
+  // add that back in.
+  total_length_ = NetworkByteOrder::Load32(&(*buf_)[0]) + kMsgLengthPrefixLength;
+  if (total_length_ > FLAGS_rpc_max_message_size) {
+    return Status::NetworkError(Substitute(
+        "RPC frame had a length of $0, but we only support messages up to $1 bytes "
+        "long.", total_length_, FLAGS_rpc_max_message_size));
+  }
+  if (total_length_ <= kMsgLengthPrefixLength) {
+    return Status::NetworkError(Substitute("RPC frame had invalid length of $0",
+                                           total_length_));
+  }
+  if (buffer_pool_ && total_length_ > buf_->capacity()) {
+    // Trade the buffer for one of the right size class.
+    gscoped_ptr<faststring> buf = buffer_pool_->Acquire(total_length_);
+    buf->append(buf_->data(), kMsgLengthPrefixLength);
+    buffer_pool_->Release(buf_.Pass());
+    buf_.swap(buf);
+  }
+  buf_->resize(total_length_);
+  return Status::OK();
+}
+
 bool InboundTransfer::TransferStarted() const {
   return cur_offset_ != 0;
 }
@@ -181,25 +228,35 @@ void OutboundTransfer::Abort(const Status &status) {
 Status OutboundTransfer::SendBuffer(Socket &socket) {
   CHECK_LT(cur_slice_idx_, n_payload_slices_);
 
-  int n_iovecs = n_payload_slices_ - cur_slice_idx_;
-  struct iovec iovec[n_iovecs];
-  {
-    int offset_in_slice = cur_offset_in_slice_;
-    for (int i = 0; i < n_iovecs; i++) {
-      Slice &slice = payload_slices_[cur_slice_idx_ + i];
-      iovec[i].iov_base = slice.mutable_data() + offset_in_slice;
-      iovec[i].iov_len = slice.size() - offset_in_slice;
-
-      offset_in_slice = 0;
-    }
-  }
+  struct iovec iovec[kMaxPayloadSlices];
+  int n_iovecs = FillIovecs(iovec, kMaxPayloadSlices);
 
   int32_t written;
   Status status = socket.Writev(iovec, n_iovecs, &written);
   RETURN_ON_ERROR_OR_SOCKET_NOT_READY(status);
 
+  AdvanceWritten(written);
+  return Status::OK();
+}
+
+int OutboundTransfer::FillIovecs(struct iovec* iov, int max_iovecs) const {
+  int n_iovecs = std::min<int>(n_payload_slices_ - cur_slice_idx_, max_iovecs);
+  int offset_in_slice = cur_offset_in_slice_;
+  for (int i = 0; i < n_iovecs; i++) {
+    const Slice &slice = payload_slices_[cur_slice_idx_ + i];
+    iov[i].iov_base = const_cast<uint8_t*>(slice.data()) + offset_in_slice;
+    iov[i].iov_len = slice.size() - offset_in_slice;
+
+    offset_in_slice = 0;
+  }
+  return n_iovecs;
+}
+
+int32_t OutboundTransfer::AdvanceWritten(int32_t written) {
+  int32_t consumed = 0;
+
   // Adjust our accounting of current writer position.
-  for (int i = cur_slice_idx_; i < n_payload_slices_; i++) {
+  for (int i = cur_slice_idx_; i < n_payload_slices_ && written > 0; i++) {
     Slice &slice = payload_slices_[i];
     int rem_in_slice = slice.size() - cur_offset_in_slice_;
     DCHECK_GE(rem_in_slice, 0);
@@ -209,9 +266,11 @@ Status OutboundTransfer::SendBuffer(Socket &socket) {
       cur_slice_idx_++;
       cur_offset_in_slice_ = 0;
       written -= rem_in_slice;
+      consumed += rem_in_slice;
     } else {
       // Partially used up this slice, just advance the offset within it.
       cur_offset_in_slice_ += written;
+      consumed += written;
       break;
     }
   }
@@ -224,7 +283,7 @@ Status OutboundTransfer::SendBuffer(Socket &socket) {
     DCHECK_LT(cur_offset_in_slice_, payload_slices_[cur_slice_idx_].size());
   }
 
-  return Status::OK();
+  return consumed;
 }
 
 bool OutboundTransfer::TransferStarted() const {
@@ -20,12 +20,16 @@
 
 #include <boost/intrusive/list.hpp>
 #include <gflags/gflags.h>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
+#include <sys/uio.h>
 #include <vector>
 
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/rpc/constants.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
 
@@ -43,6 +47,7 @@ class Socket;
 
 namespace rpc {
 
+class BufferPool;
 class Messenger;
 struct TransferCallbacks;
 
@@ -55,11 +60,27 @@ struct TransferCallbacks;
 class InboundTransfer {
  public:
 
-  InboundTransfer();
+  // If 'buffer_pool' is set, the frame is received into a buffer from it,
+  // which is handed back when the transfer is destroyed.
+  explicit InboundTransfer(std::shared_ptr<BufferPool> buffer_pool =
+                           std::shared_ptr<BufferPool>());
+  ~InboundTransfer();
 
   // read from the socket into our buffer
   Status ReceiveBuffer(Socket &socket);
 
+  // Take the bytes of this transfer's frame from the front of 'data', which
+  // holds bytes already read off the socket, and set '*consumed' to how many
+  // were taken. If fewer than data.size() bytes are consumed, the transfer is
+  // finished and the rest belong to the following frames.
+  Status ConsumeBytes(const Slice& data, size_t* consumed);
+
+  // Return the number of bytes remaining to be received, as far as is known:
+  // before the length prefix has been received, this only counts the prefix.
+  int32_t remaining_length() const {
+    return total_length_ - cur_offset_;
+  }
+
   // Return true if any bytes have yet been sent.
   bool TransferStarted() const;
 
@@ -67,7 +88,7 @@ class InboundTransfer {
   bool TransferFinished() const;
 
   Slice data() const {
-    return Slice(buf_);
+    return Slice(*buf_);
   }
 
   // Return a string indicating the status of this transfer (number of bytes received, etc)
@@ -78,7 +99,13 @@ class InboundTransfer {
 
   Status ProcessInboundHeader();
 
-  faststring buf_;
+  // Validate the length prefix, which has just been received, and size the
+  // buffer for the rest of the frame.
+  Status ProcessLengthPrefix();
+
+  const std::shared_ptr<BufferPool> buffer_pool_;
+
+  gscoped_ptr<faststring> buf_;
 
   int32_t total_length_;
   int32_t cur_offset_;
@@ -130,6 +157,16 @@ class OutboundTransfer : public boost::intrusive::list_base_hook<> {
   // send from our buffers into the sock
   Status SendBuffer(Socket &socket);
 
+  // Describe the bytes of this transfer which have not yet been sent using
+  // at most 'max_iovecs' entries of 'iov'. Returns the number of entries used.
+  // This allows a connection to send several transfers with a single writev().
+  int FillIovecs(struct iovec* iov, int max_iovecs) const;
+
+  // Account for up to 'written' bytes of this transfer having been sent. If
+  // that finishes the transfer, notifies its callbacks. Returns the number of
+  // bytes that belonged to this transfer.
+  int32_t AdvanceWritten(int32_t written);
+
   // Return true if any bytes have yet been sent.
   bool TransferStarted() const;
 
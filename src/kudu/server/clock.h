@@ -93,6 +93,12 @@ class Clock : public RefCountedThreadSafe<Clock> {
   // Strigifies the provided timestamp according to this clock's internal format.
   virtual std::string Stringify(Timestamp timestamp) = 0;
 
+  // Returns true if the timestamps of this clock embed a physical time, i.e.
+  // if the age of a timestamp can be measured in wall-clock time.
+  virtual bool HasPhysicalComponent() const {
+    return false;
+  }
+
   virtual ~Clock() {}
 };
 
@@ -29,6 +29,7 @@
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/human_readable.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/split.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/server/pprof-path-handlers.h"
@@ -38,6 +39,7 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/metrics.pb.h"
 #include "kudu/util/jsonwriter.h"
 
 using boost::replace_all;
@@ -168,20 +170,46 @@ void AddDefaultPathHandlers(Webserver* webserver) {
 }
 
 
-static void WriteMetricsAsJson(const MetricRegistry* const metrics,
-                               const Webserver::WebRequest& req, std::stringstream* output) {
-  const string* requested_metrics_param = FindOrNull(req.parsed_args, "metrics");
-  vector<string> requested_metrics;
-  MetricJsonOptions opts;
-
+// Parses the arguments common to all the metrics pages into the requested
+// metrics and 'opts'.
+static void ParseMetricsArgs(const Webserver::WebRequest& req,
+                             vector<string>* requested_metrics,
+                             MetricJsonOptions* opts) {
   {
     string arg = FindWithDefault(req.parsed_args, "include_raw_histograms", "false");
-    opts.include_raw_histograms = ParseLeadingBoolValue(arg.c_str(), false);
+    opts->include_raw_histograms = ParseLeadingBoolValue(arg.c_str(), false);
   }
   {
     string arg = FindWithDefault(req.parsed_args, "include_schema", "false");
-    opts.include_schema_info = ParseLeadingBoolValue(arg.c_str(), false);
+    opts->include_schema_info = ParseLeadingBoolValue(arg.c_str(), false);
+  }
+  const string* types_param = FindOrNull(req.parsed_args, "types");
+  if (types_param != nullptr) {
+    SplitStringUsing(*types_param, ",", &opts->entity_types);
+  }
+  const string* changed_since_param = FindOrNull(req.parsed_args, "changed_since");
+  if (changed_since_param != nullptr) {
+    int64 epoch;
+    if (safe_strto64(*changed_since_param, &epoch)) {
+      opts->only_modified_in_or_after_epoch = epoch;
+    }
+  }
+
+  const string* requested_metrics_param = FindOrNull(req.parsed_args, "metrics");
+  if (requested_metrics_param != nullptr) {
+    SplitStringUsing(*requested_metrics_param, ",", requested_metrics);
+  } else {
+    // Default to including all metrics.
+    requested_metrics->push_back("*");
   }
+}
+
+static void WriteMetricsAsJson(const MetricRegistry* const metrics,
+                               const Webserver::WebRequest& req, std::stringstream* output) {
+  vector<string> requested_metrics;
+  MetricJsonOptions opts;
+  ParseMetricsArgs(req, &requested_metrics, &opts);
+
   JsonWriter::Mode json_mode;
   {
     string arg = FindWithDefault(req.parsed_args, "compact", "false");
@@ -190,18 +218,41 @@ static void WriteMetricsAsJson(const MetricRegistry* const metrics,
   }
 
   JsonWriter writer(output, json_mode);
-
-  if (requested_metrics_param != nullptr) {
-    SplitStringUsing(*requested_metrics_param, ",", &requested_metrics);
-  } else {
-    // Default to including all metrics.
-    requested_metrics.push_back("*");
-  }
-
   WARN_NOT_OK(metrics->WriteAsJson(&writer, requested_metrics, opts),
               "Couldn't write JSON metrics over HTTP");
 }
 
+static void WriteMetricsAsPrometheus(const MetricRegistry* const metrics,
+                                     const Webserver::WebRequest& req,
+                                     std::stringstream* output) {
+  vector<string> requested_metrics;
+  MetricJsonOptions opts;
+  ParseMetricsArgs(req, &requested_metrics, &opts);
+  // Prometheus considers series missing from a scrape to be gone, so the
+  // export can't skip the metrics which didn't change.
+  opts.only_modified_in_or_after_epoch = 0;
+
+  WARN_NOT_OK(metrics->WriteAsPrometheus(output, requested_metrics, opts),
+              "Couldn't write Prometheus metrics over HTTP");
+}
+
+static void WriteMetricsAsProtobuf(const MetricRegistry* const metrics,
+                                   const Webserver::WebRequest& req,
+                                   std::stringstream* output) {
+  vector<string> requested_metrics;
+  MetricJsonOptions opts;
+  ParseMetricsArgs(req, &requested_metrics, &opts);
+
+  // Metrics changing from now on are picked up by the next request passing
+  // this epoch, even if they change while this one is written out.
+  MetricsSnapshotPB pb;
+  pb.set_next_epoch(Metric::IncrementEpoch());
+  WARN_NOT_OK(metrics->WriteAsProtobuf(&pb, requested_metrics, opts),
+              "Couldn't write protobuf metrics over HTTP");
+  // Histogram snapshots only carry their schema fields if they were asked for.
+  pb.SerializePartialToOstream(output);
+}
+
 void RegisterMetricsJsonHandler(Webserver* webserver, const MetricRegistry* const metrics) {
   Webserver::PathHandlerCallback callback = boost::bind(WriteMetricsAsJson, metrics, _1, _2);
   bool not_styled = false;
@@ -212,6 +263,13 @@ void RegisterMetricsJsonHandler(Webserver* webserver, const MetricRegistry* cons
   // The old name -- this is preserved for compatibility with older releases of
   // monitoring software which expects the old name.
   webserver->RegisterPathHandler("/jsonmetricz", "Metrics", callback, not_styled, not_on_nav_bar);
+
+  webserver->RegisterPathHandler("/metrics_prometheus", "Prometheus Metrics",
+                                 boost::bind(WriteMetricsAsPrometheus, metrics, _1, _2),
+                                 not_styled, not_on_nav_bar);
+  webserver->RegisterPathHandler("/metrics_pb", "Protobuf Metrics",
+                                 boost::bind(WriteMetricsAsProtobuf, metrics, _1, _2),
+                                 not_styled, not_on_nav_bar);
 }
 
 } // namespace kudu
@@ -26,6 +26,7 @@
 #include "kudu/util/test_util.h"
 
 DECLARE_bool(use_mock_wall_clock);
+DECLARE_int32(hybrid_clock_max_error_refresh_ms);
 
 namespace kudu {
 namespace server {
@@ -129,6 +130,26 @@ TEST_F(HybridClockTest, TestNow_ValuesIncreaseMonotonically) {
   ASSERT_LT(now1.value(), now2.value());
 }
 
+// Test that, between readings of the maximum error from the kernel, the
+// extrapolated error only grows, and so keeps covering the kernel's own.
+TEST_F(HybridClockTest, TestCachedMaxErrorGrows) {
+  google::FlagSaver saver;
+  FLAGS_hybrid_clock_max_error_refresh_ms = 60 * 1000;
+  Timestamp ts;
+  uint64_t prev_error;
+  clock_->NowWithError(&ts, &prev_error);
+  for (int i = 0; i < 10; i++) {
+    SleepFor(MonoDelta::FromMilliseconds(10));
+    Timestamp now;
+    uint64_t error;
+    clock_->NowWithError(&now, &error);
+    ASSERT_GT(now.value(), ts.value());
+    ASSERT_GE(error, prev_error);
+    ts = now;
+    prev_error = error;
+  }
+}
+
 // Tests the clock updates with the incoming value if it is higher.
 TEST_F(HybridClockTest, TestUpdate_LogicalValueIncreasesByAmount) {
   Timestamp now = clock_->Now();
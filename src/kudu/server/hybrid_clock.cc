@@ -18,8 +18,10 @@
 #include "kudu/server/hybrid_clock.h"
 
 #include <algorithm>
+#include <cmath>
 #include <glog/logging.h>
 #include <mutex>
+#include <time.h>
 
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -42,6 +44,16 @@ DEFINE_int32(max_clock_sync_error_usec, 10 * 1000 * 1000, // 10 secs
 TAG_FLAG(max_clock_sync_error_usec, advanced);
 TAG_FLAG(max_clock_sync_error_usec, runtime);
 
+DEFINE_int32(hybrid_clock_max_error_refresh_ms, 100,
+             "How often the maximum clock error is read from the kernel. In between, "
+             "the wall time is read without a system call and the error is "
+             "extrapolated from the last reading at the clock's maximum frequency "
+             "tolerance, as the kernel itself does. This also bounds how long it "
+             "takes to notice that the clock became unsynchronized. If 0, the error "
+             "is read with every timestamp.");
+TAG_FLAG(hybrid_clock_max_error_refresh_ms, advanced);
+TAG_FLAG(hybrid_clock_max_error_refresh_ms, runtime);
+
 DEFINE_bool(use_hybrid_clock, true,
             "Whether HybridClock should be used as the default clock"
             " implementation. This should be disabled for testing purposes only.");
@@ -140,6 +152,8 @@ HybridClock::HybridClock()
       divisor_(1),
 #endif
       tolerance_adjustment_(1),
+      cached_max_error_usec_(0),
+      max_error_read_at_usec_(0),
       next_timestamp_(0),
       state_(kNotInitialized) {
 }
@@ -154,11 +168,6 @@ Status HybridClock::Init() {
   LOG(WARNING) << "HybridClock initialized in local mode (OS X only). "
                << "Not suitable for distributed clusters.";
 #else
-  // Read the current time. This will return an error if the clock is not synchronized.
-  uint64_t now_usec;
-  uint64_t error_usec;
-  RETURN_NOT_OK(WalltimeWithError(&now_usec, &error_usec));
-
   timex timex;
   RETURN_NOT_OK(GetClockModes(&timex));
   // read whether the STA_NANO bit is set to know whether we'll get back nanos
@@ -175,6 +184,11 @@ Status HybridClock::Init() {
   // Tolerance comes in parts per million but needs to be applied a scaling factor.
   tolerance_adjustment_ = (1 + ((timex.tolerance / kAdjtimexScalingFactor) / 1000000.0));
 
+  // Read the current time. This will return an error if the clock is not synchronized.
+  uint64_t now_usec;
+  uint64_t error_usec;
+  RETURN_NOT_OK(RefreshMaxError(&now_usec, &error_usec));
+
   LOG(INFO) << "HybridClock initialized. Resolution in nanos?: " << (divisor_ == 1000)
             << " Wait times tolerance adjustment: " << tolerance_adjustment_
             << " Current error: " << error_usec;
@@ -188,8 +202,6 @@ Status HybridClock::Init() {
 Timestamp HybridClock::Now() {
   Timestamp now;
   uint64_t error;
-
-  std::lock_guard<simple_spinlock> lock(lock_);
   NowWithError(&now, &error);
   return now;
 }
@@ -197,11 +209,7 @@ Timestamp HybridClock::Now() {
 Timestamp HybridClock::NowLatest() {
   Timestamp now;
   uint64_t error;
-
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    NowWithError(&now, &error);
-  }
+  NowWithError(&now, &error);
 
   uint64_t now_latest = GetPhysicalValueMicros(now) + error;
   uint64_t now_logical = GetLogicalValue(now);
@@ -230,11 +238,18 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
   }
 
   // If the physical time from the system clock is higher than our last-returned
-  // time, we should use the physical timestamp.
+  // time, we should use the physical timestamp. Otherwise, hand out the next
+  // logical value. Either way, advance 'next_timestamp_' past the one returned,
+  // retrying if another thread got to it first.
   uint64_t candidate_phys_timestamp = now_usec << kBitsToShift;
-  if (PREDICT_TRUE(candidate_phys_timestamp > next_timestamp_)) {
-    next_timestamp_ = candidate_phys_timestamp;
-    *timestamp = Timestamp(next_timestamp_++);
+  uint64_t next = next_timestamp_.load(std::memory_order_relaxed);
+  uint64_t ts;
+  do {
+    ts = std::max(candidate_phys_timestamp, next);
+  } while (!next_timestamp_.compare_exchange_weak(next, ts + 1));
+  *timestamp = Timestamp(ts);
+
+  if (PREDICT_TRUE(ts == candidate_phys_timestamp)) {
     *max_error_usec = error_usec;
     if (PREDICT_FALSE(VLOG_IS_ON(2))) {
       VLOG(2) << "Current clock is higher than the last one. Resetting logical values."
@@ -262,8 +277,7 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
   // This broadens the error interval for both cases but always returns
   // a correct error interval.
 
-  *max_error_usec = (next_timestamp_ >> kBitsToShift) - (now_usec - error_usec);
-  *timestamp = Timestamp(next_timestamp_++);
+  *max_error_usec = (ts >> kBitsToShift) - (now_usec - error_usec);
   if (PREDICT_FALSE(VLOG_IS_ON(2))) {
     VLOG(2) << "Current clock is lower than the last one. Returning last read and incrementing"
         " logical values. Clock: " + Stringify(*timestamp) << " Error: " << *max_error_usec;
@@ -271,7 +285,6 @@ void HybridClock::NowWithError(Timestamp* timestamp, uint64_t* max_error_usec) {
 }
 
 Status HybridClock::Update(const Timestamp& to_update) {
-  std::lock_guard<simple_spinlock> lock(lock_);
   Timestamp now;
   uint64_t error_ignored;
   NowWithError(&now, &error_ignored);
@@ -291,8 +304,11 @@ Status HybridClock::Update(const Timestamp& to_update) {
   }
 
   // Our next timestamp must be higher than the one that we are updating
-  // from.
-  next_timestamp_ = to_update.value() + 1;
+  // from. Another thread may have moved it further ahead meanwhile.
+  uint64_t next = next_timestamp_.load(std::memory_order_relaxed);
+  while (next <= to_update.value() &&
+         !next_timestamp_.compare_exchange_weak(next, to_update.value() + 1)) {
+  }
   return Status::OK();
 }
 
@@ -305,10 +321,7 @@ Status HybridClock::WaitUntilAfter(const Timestamp& then_latest,
   TRACE_EVENT0("clock", "HybridClock::WaitUntilAfter");
   Timestamp now;
   uint64_t error;
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    NowWithError(&now, &error);
-  }
+  NowWithError(&now, &error);
 
   // "unshift" the timestamps so that we can measure actual time
   uint64_t now_usec = GetPhysicalValueMicros(now);
@@ -349,10 +362,7 @@ Status HybridClock::WaitUntilAfter(const Timestamp& then_latest,
   while (true) {
     Timestamp now;
     uint64_t error;
-    {
-      std::lock_guard<simple_spinlock> lock(lock_);
-      NowWithError(&now, &error);
-    }
+    NowWithError(&now, &error);
     if (now.CompareTo(then) > 0) {
       return Status::OK();
     }
@@ -370,11 +380,7 @@ bool HybridClock::IsAfter(Timestamp t) {
   uint64_t error_usec;
   CHECK_OK(WalltimeWithError(&now_usec, &error_usec));
 
-  Timestamp now;
-  {
-    std::lock_guard<simple_spinlock> lock(lock_);
-    now = Timestamp(std::max(next_timestamp_, now_usec << kBitsToShift));
-  }
+  Timestamp now(std::max(next_timestamp_.load(), now_usec << kBitsToShift));
   return t.value() < now.value();
 }
 
@@ -391,11 +397,31 @@ kudu::Status HybridClock::WalltimeWithError(uint64_t* now_usec, uint64_t* error_
     *error_usec = 0;
   }
 #else
-    // Read the time. This will return an error if the clock is not synchronized.
-    ntptimeval timeval;
-    RETURN_NOT_OK(GetClockTime(&timeval));
-    *now_usec = timeval.time.tv_sec * kNanosPerSec + timeval.time.tv_usec / divisor_;
-    *error_usec = timeval.maxerror;
+    timespec ts;
+    PCHECK(clock_gettime(CLOCK_REALTIME, &ts) == 0);
+    *now_usec = ts.tv_sec * kNanosPerSec + ts.tv_nsec / 1000;
+
+    uint64_t read_at_usec = max_error_read_at_usec_.load(std::memory_order_acquire);
+    uint64_t since_read_usec = *now_usec - read_at_usec;
+    if (PREDICT_FALSE(read_at_usec == 0 || *now_usec < read_at_usec ||
+                      since_read_usec >= FLAGS_hybrid_clock_max_error_refresh_ms * 1000ULL)) {
+      // The cached error is stale, or the clock was stepped backwards. If
+      // another thread is already refreshing it, the extrapolated error still
+      // holds in the meantime.
+      std::unique_lock<simple_spinlock> l(max_error_refresh_lock_, std::try_to_lock);
+      if (l.owns_lock() || read_at_usec == 0 || *now_usec < read_at_usec) {
+        if (!l.owns_lock()) {
+          l.lock();
+        }
+        RETURN_NOT_OK(RefreshMaxError(now_usec, error_usec));
+        read_at_usec = *now_usec;
+        since_read_usec = 0;
+      }
+    }
+    // Between readings, the kernel grows the maximum error at the clock's
+    // frequency tolerance, which is what the wait times are adjusted by, too.
+    *error_usec = cached_max_error_usec_.load(std::memory_order_relaxed) +
+        static_cast<uint64_t>(std::ceil(since_read_usec * (tolerance_adjustment_ - 1)));
   }
 
   // If the clock is synchronized but has max_error beyond max_clock_sync_error_usec
@@ -408,16 +434,27 @@ kudu::Status HybridClock::WalltimeWithError(uint64_t* now_usec, uint64_t* error_
   return kudu::Status::OK();
 }
 
+#if !defined(__APPLE__)
+kudu::Status HybridClock::RefreshMaxError(uint64_t* now_usec, uint64_t* error_usec) {
+  // Read the time. This will return an error if the clock is not synchronized.
+  ntptimeval timeval;
+  RETURN_NOT_OK(GetClockTime(&timeval));
+  *now_usec = timeval.time.tv_sec * kNanosPerSec + timeval.time.tv_usec / divisor_;
+  *error_usec = timeval.maxerror;
+  cached_max_error_usec_.store(*error_usec, std::memory_order_relaxed);
+  max_error_read_at_usec_.store(*now_usec, std::memory_order_release);
+  return Status::OK();
+}
+#endif // !defined(__APPLE__)
+
 void HybridClock::SetMockClockWallTimeForTests(uint64_t now_usec) {
   CHECK(FLAGS_use_mock_wall_clock);
-  std::lock_guard<simple_spinlock> lock(lock_);
-  CHECK_GE(now_usec, mock_clock_time_usec_);
+  CHECK_GE(now_usec, mock_clock_time_usec_.load());
   mock_clock_time_usec_ = now_usec;
 }
 
 void HybridClock::SetMockMaxClockErrorForTests(uint64_t max_error_usec) {
   CHECK(FLAGS_use_mock_wall_clock);
-  std::lock_guard<simple_spinlock> lock(lock_);
   mock_clock_max_error_usec_ = max_error_usec;
 }
 
@@ -430,8 +467,6 @@ uint64_t HybridClock::NowForMetrics() {
 uint64_t HybridClock::ErrorForMetrics() {
   Timestamp now;
   uint64_t error;
-
-  std::lock_guard<simple_spinlock> lock(lock_);
   NowWithError(&now, &error);
   return error;
 }
@@ -18,6 +18,7 @@
 #ifndef KUDU_SERVER_HYBRID_CLOCK_H_
 #define KUDU_SERVER_HYBRID_CLOCK_H_
 
+#include <atomic>
 #include <string>
 
 #include "kudu/gutil/ref_counted.h"
@@ -115,10 +116,17 @@ class HybridClock : public Clock {
   // error in micros. This may fail if the clock is unsynchronized or synchronized
   // but the error is too high and, since we can't do anything about it,
   // LOG(FATAL)'s in that case.
+  //
+  // Lock-free: concurrent callers are ordered by a compare-and-swap on the
+  // next timestamp.
   void NowWithError(Timestamp* timestamp, uint64_t* max_error_usec);
 
   virtual std::string Stringify(Timestamp timestamp) OVERRIDE;
 
+  virtual bool HasPhysicalComponent() const OVERRIDE {
+    return true;
+  }
+
   // Static encoding/decoding methods for timestamps. Public mostly
   // for testing/debugging purposes.
 
@@ -164,8 +172,18 @@ class HybridClock : public Clock {
   // and checks if the clock is synchronized.
   //
   // On OS X, the error will always be 0.
+  //
+  // The time is read with clock_gettime(), which doesn't enter the kernel,
+  // while the error is only read with ntp_gettime() every
+  // --hybrid_clock_max_error_refresh_ms and extrapolated in between.
   kudu::Status WalltimeWithError(uint64_t* now_usec, uint64_t* error_usec);
 
+#if !defined(__APPLE__)
+  // Reads the time and maximum error with ntp_gettime() and caches the error
+  // for WalltimeWithError().
+  kudu::Status RefreshMaxError(uint64_t* now_usec, uint64_t* error_usec);
+#endif
+
   // Used to get the timestamp for metrics.
   uint64_t NowForMetrics();
 
@@ -174,11 +192,11 @@ class HybridClock : public Clock {
 
   // Set by calls to SetMockClockWallTimeForTests().
   // For testing purposes only.
-  uint64_t mock_clock_time_usec_;
+  std::atomic<uint64_t> mock_clock_time_usec_;
 
   // Set by calls to SetMockClockErrorForTests().
   // For testing purposes only.
-  uint64_t mock_clock_max_error_usec_;
+  std::atomic<uint64_t> mock_clock_max_error_usec_;
 
 #if !defined(__APPLE__)
   uint64_t divisor_;
@@ -186,11 +204,19 @@ class HybridClock : public Clock {
 
   double tolerance_adjustment_;
 
-  mutable simple_spinlock lock_;
+  // The maximum error last read from the kernel, and the wall time at which
+  // it was read, or 0 if it never was. The error is stored before the time,
+  // so a reader that sees a given time also sees the error read with it.
+  std::atomic<uint64_t> cached_max_error_usec_;
+  std::atomic<uint64_t> max_error_read_at_usec_;
+
+  // Held while refreshing the cached maximum error, so that only one thread
+  // at a time calls into the kernel for it.
+  simple_spinlock max_error_refresh_lock_;
 
   // The next timestamp to be generated from this clock, assuming that
   // the physical clock hasn't advanced beyond the value stored here.
-  uint64_t next_timestamp_;
+  std::atomic<uint64_t> next_timestamp_;
 
   // How many bits to left shift a microseconds clock read. The remainder
   // of the timestamp will be reserved for logical values.
@@ -35,6 +35,7 @@
 #include "kudu/util/env.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/sampling_profiler.h"
 #include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/status.h"
 
@@ -171,6 +172,34 @@ static void PprofContentionHandler(const Webserver::WebRequest& req, stringstrea
 #endif // defined(__linux__)
 }
 
+// Returns the sites at which threads waited on locks and condition variables
+// during the next 'seconds' seconds, each with a histogram of its waits, from
+// the one that waited longest in total down. Unlike /pprof/contention, this is
+// meant to be read directly rather than through pprof.
+static void ContentionSitesHandler(const Webserver::WebRequest& req, stringstream* output) {
+  string secs_str = FindWithDefault(req.parsed_args, "seconds", "");
+  int32_t seconds = ParseLeadingInt32Value(secs_str.c_str(), PPROF_DEFAULT_SAMPLE_SECS);
+  int64_t dropped_waits = 0;
+
+  // Waits are counted by site rather than sampled, so the table only needs
+  // flushing once at the end.
+  StartLockContentionSiteProfiling();
+  SleepFor(MonoDelta::FromSeconds(seconds));
+  StopLockContentionSiteProfiling();
+  FlushLockContentionSites(output, &dropped_waits);
+
+  *output << "dropped waits = " << dropped_waits << endl;
+}
+
+// Returns the stacks sampled by the continuous sampling profiler, in the
+// collapsed format which flame graph tools take. The optional 'seconds'
+// argument limits them to the most recent ones; by default, all those still
+// kept are returned.
+static void SampledProfileHandler(const Webserver::WebRequest& req, stringstream* output) {
+  string secs_str = FindWithDefault(req.parsed_args, "seconds", "");
+  int32_t seconds = ParseLeadingInt32Value(secs_str.c_str(), kint32max);
+  DumpSamplingProfile(seconds, output);
+}
 
 // pprof asks for the url /pprof/symbol to map from hex addresses to variable names.
 // When the server receives a GET request for /pprof/symbol, it should return a line
@@ -234,6 +263,9 @@ void AddPprofPathHandlers(Webserver* webserver) {
   webserver->RegisterPathHandler("/pprof/profile", "", PprofCpuProfileHandler, false, false);
   webserver->RegisterPathHandler("/pprof/symbol", "", PprofSymbolHandler, false, false);
   webserver->RegisterPathHandler("/pprof/contention", "", PprofContentionHandler, false, false);
+  webserver->RegisterPathHandler("/pprof/contention-sites", "", ContentionSitesHandler,
+                                 false, false);
+  webserver->RegisterPathHandler("/pprof/collapsed", "", SampledProfileHandler, false, false);
 }
 
 } // namespace kudu
@@ -50,6 +50,7 @@
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/pb_util.h"
 #include "kudu/util/rolling_log.h"
+#include "kudu/util/sampling_profiler.h"
 #include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/version_info.h"
@@ -93,14 +94,16 @@ ServerBase::ServerBase(string name, const ServerBaseOptions& options,
                                                       metric_namespace)),
       rpc_server_(new RpcServer(options.rpc_opts)),
       web_server_(new Webserver(options.webserver_opts)),
-      result_tracker_(new rpc::ResultTracker()),
+      result_tracker_(new rpc::ResultTracker(mem_tracker_)),
       is_first_run_(false),
       options_(options),
       stop_metrics_logging_latch_(1) {
   FsManagerOpts fs_opts;
   fs_opts.metric_entity = metric_entity_;
+  fs_opts.metric_registry = metric_registry_.get();
   fs_opts.parent_mem_tracker = mem_tracker_;
   fs_opts.wal_path = options.fs_opts.wal_path;
+  fs_opts.extra_wal_paths = options.fs_opts.extra_wal_paths;
   fs_opts.data_paths = options.fs_opts.data_paths;
   fs_manager_.reset(new FsManager(options.env, fs_opts));
 
@@ -154,6 +157,7 @@ Status ServerBase::Init() {
   RegisterSpinLockContentionMetrics(metric_entity_);
 
   InitSpinLockContentionProfiling();
+  WARN_NOT_OK(StartSamplingProfiler(), "Unable to start the sampling profiler");
 
   // Initialize the clock immediately. This checks that the clock is synchronized
   // so we're less likely to get into a partially initialized state on disk during startup
@@ -305,6 +309,7 @@ Status ServerBase::Start() {
                                   new GenericServiceImpl(this))));
 
   RETURN_NOT_OK(rpc_server_->Start());
+  RETURN_NOT_OK(result_tracker_->StartGCThread());
 
   AddDefaultPathHandlers(web_server_.get());
   AddRpczPathHandlers(messenger_, web_server_.get());
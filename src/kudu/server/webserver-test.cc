@@ -17,20 +17,25 @@
 
 #include <gflags/gflags.h>
 #include <gtest/gtest.h>
+#include <atomic>
 #include <string>
+#include <thread>
 
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/server/default-path-handlers.h"
 #include "kudu/server/webserver.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/curl_util.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/test_util.h"
 
 using std::string;
 
+DECLARE_int32(webserver_max_concurrent_requests_per_page);
 DECLARE_int32(webserver_max_post_length_bytes);
+DECLARE_int32(webserver_page_cache_ttl_ms);
 
 namespace kudu {
 
@@ -160,4 +165,52 @@ TEST_F(WebserverTest, TestStaticFiles) {
   ASSERT_EQ("Remote error: HTTP 403", s.ToString());
 }
 
+// Test that the requests for a page in excess of the concurrency limit get
+// its last rendering if it's recent enough, and an error otherwise.
+TEST_F(WebserverTest, TestConcurrentRequestsLimit) {
+  FLAGS_webserver_max_concurrent_requests_per_page = 1;
+  FLAGS_webserver_page_cache_ttl_ms = 60 * 1000;
+
+  std::atomic<int> renders(0);
+  std::atomic<bool> block(false);
+  CountDownLatch unblock(1);
+  server_->RegisterPathHandler("/slow", "Slow",
+      [&](const WebCallbackRegistry::WebRequest& req, std::stringstream* output) {
+        *output << "render " << ++renders;
+        if (block) {
+          unblock.Wait();
+        }
+      },
+      false /* is_styled */, false /* is_on_nav_bar */);
+  string url = strings::Substitute("http://$0/slow", addr_.ToString());
+
+  ASSERT_OK(curl_.FetchURL(url, &buf_));
+  ASSERT_EQ("render 1", buf_.ToString());
+
+  // Block a second rendering of the page.
+  block = true;
+  faststring blocked_buf;
+  std::thread blocked([&]() {
+      EasyCurl curl;
+      CHECK_OK(curl.FetchURL(url, &blocked_buf));
+    });
+  while (renders < 2) {
+    SleepFor(MonoDelta::FromMilliseconds(10));
+  }
+
+  // Meanwhile, the first rendering is served.
+  ASSERT_OK(curl_.FetchURL(url, &buf_));
+  ASSERT_EQ("render 1", buf_.ToString());
+
+  // Unless it's too old.
+  FLAGS_webserver_page_cache_ttl_ms = 0;
+  Status s = curl_.FetchURL(url, &buf_);
+  ASSERT_EQ("Remote error: HTTP 503", s.ToString());
+  ASSERT_EQ(2, renders);
+
+  unblock.CountDown();
+  blocked.join();
+  ASSERT_EQ("render 2", blocked_buf.ToString());
+}
+
 } // namespace kudu
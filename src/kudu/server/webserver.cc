@@ -39,7 +39,9 @@
 #include "kudu/util/env.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/logging.h"
 #include "kudu/util/net/net_util.h"
+#include "kudu/util/scoped_cleanup.h"
 #include "kudu/util/url-coding.h"
 #include "kudu/util/version_info.h"
 
@@ -47,6 +49,7 @@
 typedef sig_t sighandler_t;
 #endif
 
+using std::shared_ptr;
 using std::string;
 using std::stringstream;
 using std::vector;
@@ -58,6 +61,23 @@ DEFINE_int32(webserver_max_post_length_bytes, 1024 * 1024,
 TAG_FLAG(webserver_max_post_length_bytes, advanced);
 TAG_FLAG(webserver_max_post_length_bytes, runtime);
 
+DEFINE_int32(webserver_max_concurrent_requests_per_page, 4,
+             "The maximum number of requests which may render the same page of the "
+             "embedded web server at once. Requests in excess of it are served the last "
+             "rendering of the page if it's recent enough, per "
+             "--webserver_page_cache_ttl_ms, and get a 503 error otherwise. This prevents "
+             "monitoring systems and operators hammering an expensive page from tying up "
+             "all the web server's threads, and the locks taken by the page. "
+             "0 means no limit.");
+TAG_FLAG(webserver_max_concurrent_requests_per_page, advanced);
+TAG_FLAG(webserver_max_concurrent_requests_per_page, runtime);
+
+DEFINE_int32(webserver_page_cache_ttl_ms, 2000,
+             "The maximum age, in milliseconds, of the rendering of a page served to the "
+             "requests in excess of --webserver_max_concurrent_requests_per_page.");
+TAG_FLAG(webserver_page_cache_ttl_ms, advanced);
+TAG_FLAG(webserver_page_cache_ttl_ms, runtime);
+
 namespace kudu {
 
 Webserver::Webserver(const WebserverOptions& opts)
@@ -285,11 +305,31 @@ int Webserver::BeginRequestCallback(struct sq_connection* connection,
     handler = it->second;
   }
 
-  return RunPathHandler(*handler, connection, request_info);
+  return RunPathHandler(handler, connection, request_info);
+}
+
+void Webserver::PathHandler::CachePage(const string& query_string,
+                                       shared_ptr<const string> page) {
+  MonoTime now = MonoTime::Now(MonoTime::COARSE);
+  std::lock_guard<simple_spinlock> l(cache_lock_);
+  cached_query_string_ = query_string;
+  cached_page_ = std::move(page);
+  cached_time_ = now;
+}
+
+shared_ptr<const string> Webserver::PathHandler::GetCachedPage(const string& query_string,
+                                                               const MonoDelta& max_age) {
+  MonoTime now = MonoTime::Now(MonoTime::COARSE);
+  std::lock_guard<simple_spinlock> l(cache_lock_);
+  if (!cached_page_ || cached_query_string_ != query_string ||
+      !now.GetDeltaSince(cached_time_).LessThan(max_age)) {
+    return shared_ptr<const string>();
+  }
+  return cached_page_;
 }
 
 
-int Webserver::RunPathHandler(const PathHandler& handler,
+int Webserver::RunPathHandler(PathHandler* handler,
                               struct sq_connection* connection,
                               struct sq_request_info* request_info) {
   // Should we render with css styles?
@@ -334,33 +374,61 @@ int Webserver::RunPathHandler(const PathHandler& handler,
     }
   }
 
-  if (!handler.is_styled() || ContainsKey(req.parsed_args, "raw")) {
+  if (!handler->is_styled() || ContainsKey(req.parsed_args, "raw")) {
     use_style = false;
   }
 
-  stringstream output;
-  if (use_style) BootstrapPageHeader(&output);
-  for (const PathHandlerCallback& callback_ : handler.callbacks()) {
-    callback_(req, &output);
+  // Only the renderings of GET requests are cached, since the others may
+  // have side effects.
+  bool cacheable = req.request_method == "GET";
+  int max_in_flight = FLAGS_webserver_max_concurrent_requests_per_page;
+  int num_in_flight = handler->BeginRequest();
+  auto end_request = MakeScopedCleanup([&]() { handler->EndRequest(); });
+
+  shared_ptr<const string> page;
+  if (max_in_flight > 0 && num_in_flight > max_in_flight) {
+    if (cacheable) {
+      page = handler->GetCachedPage(req.query_string, MonoDelta::FromMilliseconds(
+          FLAGS_webserver_page_cache_ttl_ms));
+    }
+    if (!page) {
+      KLOG_EVERY_N_SECS(WARNING, 10) << "Rejected a request for " << request_info->uri
+          << ": it is already being rendered by " << max_in_flight << " requests";
+      sq_printf(connection, "HTTP/1.1 503 Service Unavailable\r\n"
+                "Content-Type: text/plain\r\n"
+                "Retry-After: 1\r\n"
+                "\r\n"
+                "Too many concurrent requests for %s\r\n", request_info->uri);
+      return 1;
+    }
+  } else {
+    stringstream output;
+    if (use_style) BootstrapPageHeader(&output);
+    for (const PathHandlerCallback& callback_ : handler->callbacks()) {
+      callback_(req, &output);
+    }
+    if (use_style) BootstrapPageFooter(&output);
+    page = std::make_shared<const string>(output.str());
+    if (cacheable) {
+      handler->CachePage(req.query_string, page);
+    }
   }
-  if (use_style) BootstrapPageFooter(&output);
 
-  string str = output.str();
   // Without styling, render the page as plain text
   if (!use_style) {
     sq_printf(connection, "HTTP/1.1 200 OK\r\n"
               "Content-Type: text/plain\r\n"
               "Content-Length: %zd\r\n"
-              "\r\n", str.length());
+              "\r\n", page->length());
   } else {
     sq_printf(connection, "HTTP/1.1 200 OK\r\n"
               "Content-Type: text/html\r\n"
               "Content-Length: %zd\r\n"
-              "\r\n", str.length());
+              "\r\n", page->length());
   }
 
   // Make sure to use sq_write for printing the body; sq_printf truncates at 8kb
-  sq_write(connection, str.c_str(), str.length());
+  sq_write(connection, page->c_str(), page->length());
   return 1;
 }
 
@@ -17,11 +17,15 @@
 #ifndef KUDU_UTIL_WEBSERVER_H
 #define KUDU_UTIL_WEBSERVER_H
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "kudu/server/webserver_options.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/rw_mutex.h"
 #include "kudu/util/status.h"
@@ -70,7 +74,8 @@ class Webserver : public WebCallbackRegistry {
     PathHandler(bool is_styled, bool is_on_nav_bar, std::string alias)
         : is_styled_(is_styled),
           is_on_nav_bar_(is_on_nav_bar),
-          alias_(std::move(alias)) {}
+          alias_(std::move(alias)),
+          num_in_flight_(0) {}
 
     void AddCallback(const PathHandlerCallback& callback) {
       callbacks_.push_back(callback);
@@ -81,6 +86,19 @@ class Webserver : public WebCallbackRegistry {
     const std::string& alias() const { return alias_; }
     const std::vector<PathHandlerCallback>& callbacks() const { return callbacks_; }
 
+    // Counts a request as rendering the page, returning the number of
+    // requests doing so, including it. EndRequest() must follow.
+    int BeginRequest() { return ++num_in_flight_; }
+    void EndRequest() { --num_in_flight_; }
+
+    // Remembers 'page' as the last rendering of the page for 'query_string'.
+    void CachePage(const std::string& query_string, std::shared_ptr<const std::string> page);
+
+    // Returns the last rendering of the page for 'query_string' if it's
+    // younger than 'max_age', or null otherwise.
+    std::shared_ptr<const std::string> GetCachedPage(const std::string& query_string,
+                                                     const MonoDelta& max_age);
+
    private:
     // If true, the page appears is rendered styled.
     bool is_styled_;
@@ -93,6 +111,16 @@ class Webserver : public WebCallbackRegistry {
 
     // List of callbacks to render output for this page, called in order.
     std::vector<PathHandlerCallback> callbacks_;
+
+    // The number of requests currently rendering this page.
+    std::atomic<int> num_in_flight_;
+
+    // The last rendering of the page, the query string it was rendered for,
+    // and when. Protected by 'cache_lock_'.
+    simple_spinlock cache_lock_;
+    std::string cached_query_string_;
+    std::shared_ptr<const std::string> cached_page_;
+    MonoTime cached_time_;
   };
 
   bool static_pages_available() const;
@@ -113,7 +141,7 @@ class Webserver : public WebCallbackRegistry {
   int BeginRequestCallback(struct sq_connection* connection,
                            struct sq_request_info* request_info);
 
-  int RunPathHandler(const PathHandler& handler,
+  int RunPathHandler(PathHandler* handler,
                      struct sq_connection* connection,
                      struct sq_request_info* request_info);
 
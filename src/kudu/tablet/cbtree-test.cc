@@ -17,6 +17,7 @@
 
 #include <glog/logging.h>
 #include <gtest/gtest.h>
+#include <set>
 #include <thread>
 #include <unordered_set>
 
@@ -26,6 +27,7 @@
 #include "kudu/util/hexdump.h"
 #include "kudu/util/memory/memory.h"
 #include "kudu/util/memory/overwrite.h"
+#include "kudu/util/random.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
@@ -89,6 +91,12 @@ TEST_F(TestCBTree, TestNodeSizes) {
   InternalNode<BTreeTraits> inode(Slice("split"), &lnode, &lnode, &arena);
   ASSERT_LE(sizeof(inode), BTreeTraits::internal_node_size);
 
+  LeafNode<KeyPrefixTraits> prefix_lnode(false);
+  ASSERT_LE(sizeof(prefix_lnode), KeyPrefixTraits::leaf_node_size);
+
+  InternalNode<KeyPrefixTraits> prefix_inode(Slice("split"), &prefix_lnode, &prefix_lnode,
+                                             &arena);
+  ASSERT_LE(sizeof(prefix_inode), KeyPrefixTraits::internal_node_size);
 }
 
 TEST_F(TestCBTree, TestLeafNode) {
@@ -167,6 +175,18 @@ struct RacyTraits : public SmallFanoutTraits {
   static const size_t debug_raciness = 100;
 };
 
+// Small fanout nodes which also store key prefixes. The nodes are slightly
+// larger than SmallFanoutTraits to keep the same fanout.
+struct KeyPrefixTraits : public BTreeTraits {
+  static const size_t internal_node_size = 120;
+  static const size_t leaf_node_size = 130;
+  static const size_t use_key_prefixes = 1;
+};
+
+struct RacyKeyPrefixTraits : public KeyPrefixTraits {
+  static const size_t debug_raciness = 100;
+};
+
 void MakeKey(char *kbuf, size_t len, int i) {
   snprintf(kbuf, len, "key_%d%d", i % 10, i / 10);
 }
@@ -419,6 +439,11 @@ TEST_F(TestCBTree, TestRacyConcurrentInsert) {
   DoTestConcurrentInsert<RacyTraits>();
 }
 
+// Same, but with key prefixes stored in the nodes.
+TEST_F(TestCBTree, TestRacyConcurrentInsertWithKeyPrefixes) {
+  DoTestConcurrentInsert<RacyKeyPrefixTraits>();
+}
+
 template<class TraitsClass>
 void TestCBTree::DoTestConcurrentInsert() {
   gscoped_ptr<CBTree<TraitsClass> > tree;
@@ -507,6 +532,41 @@ TEST_F(TestCBTree, TestIterator) {
   }
 }
 
+// Test searching nodes with key prefixes, using keys which share long
+// prefixes, differ only in their length, or contain zero bytes.
+TEST_F(TestCBTree, TestKeyPrefixSearch) {
+  CBTree<KeyPrefixTraits> t;
+  std::set<string> inserted;
+
+  const char kAlphabet[] = { '\0', '\1', 'a', '\xff' };
+  Random rng(SeedRandom());
+  for (int i = 0; i < 5000; i++) {
+    string key = StringPrintf("prefix_%d", rng.Uniform(2));
+    int suffix_len = rng.Uniform(6);
+    for (int j = 0; j < suffix_len; j++) {
+      key.push_back(kAlphabet[rng.Uniform(arraysize(kAlphabet))]);
+    }
+    bool is_new = inserted.insert(key).second;
+    ASSERT_EQ(is_new, t.Insert(Slice(key), Slice("val"))) << HexDump(Slice(key));
+  }
+
+  for (const string& key : inserted) {
+    VerifyGet(t, Slice(key), Slice("val"));
+  }
+
+  gscoped_ptr<CBTreeIterator<KeyPrefixTraits> > iter(t.NewIterator());
+  bool exact;
+  ASSERT_TRUE(iter->SeekAtOrAfter(Slice(""), &exact));
+  for (const string& key : inserted) {
+    ASSERT_TRUE(iter->IsValid());
+    Slice k, v;
+    iter->GetCurrentEntry(&k, &v);
+    ASSERT_EQ(0, Slice(key).compare(k)) << HexDump(k);
+    iter->Next();
+  }
+  ASSERT_FALSE(iter->IsValid());
+}
+
 // Test the limited "Rewind" functionality within a given leaf node.
 TEST_F(TestCBTree, TestIteratorRewind) {
   CBTree<SmallFanoutTraits> t;
@@ -22,6 +22,7 @@
 #include "kudu/cfile/bloomfile.h"
 #include "kudu/cfile/cfile_util.h"
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/cfile/index_btree.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/map-util.h"
@@ -34,11 +35,20 @@
 DEFINE_bool(consult_bloom_filters, true, "Whether to consult bloom filters on row presence checks");
 TAG_FLAG(consult_bloom_filters, hidden);
 
+DEFINE_int32(cfile_set_prefetch_columns_max_rows, 1000,
+             "Scans of at most this many rows of a rowset, such as point lookups, "
+             "hint all of the projected columns' first data blocks to be read at "
+             "once, rather than reading them from disk one column at a time. "
+             "Set to 0 to disable.");
+TAG_FLAG(cfile_set_prefetch_columns_max_rows, advanced);
+TAG_FLAG(cfile_set_prefetch_columns_max_rows, runtime);
+
 namespace kudu {
 namespace tablet {
 
-using cfile::ReaderOptions;
 using cfile::DefaultColumnValueIterator;
+using cfile::IndexTreeIterator;
+using cfile::ReaderOptions;
 using fs::ReadableBlock;
 using std::shared_ptr;
 using strings::Substitute;
@@ -49,14 +59,13 @@ using strings::Substitute;
 
 static Status OpenReader(const shared_ptr<RowSetMetadata>& rowset_metadata,
                          ColumnId col_id,
+                         const ReaderOptions& opts,
                          gscoped_ptr<CFileReader> *new_reader) {
   FsManager* fs = rowset_metadata->fs_manager();
   gscoped_ptr<ReadableBlock> block;
   BlockId block_id = rowset_metadata->column_data_block_for_col_id(col_id);
   RETURN_NOT_OK(fs->OpenBlock(block_id, &block));
 
-  // TODO: somehow pass reader options in schema
-  ReaderOptions opts;
   return CFileReader::OpenNoInit(std::move(block), opts, new_reader);
 }
 
@@ -64,8 +73,12 @@ static Status OpenReader(const shared_ptr<RowSetMetadata>& rowset_metadata,
 // CFile Base
 ////////////////////////////////////////////////////////////
 
-CFileSet::CFileSet(shared_ptr<RowSetMetadata> rowset_metadata)
-    : rowset_metadata_(std::move(rowset_metadata)) {}
+CFileSet::CFileSet(shared_ptr<RowSetMetadata> rowset_metadata,
+                   ReaderOptions reader_options)
+    : rowset_metadata_(std::move(rowset_metadata)),
+      reader_options_(std::move(reader_options)),
+      live_row_begin_(0),
+      live_row_end_(0) {}
 
 CFileSet::~CFileSet() {
 }
@@ -82,7 +95,7 @@ Status CFileSet::Open() {
     DCHECK(!ContainsKey(readers_by_col_id_, col_id)) << "already open";
 
     gscoped_ptr<CFileReader> reader;
-    RETURN_NOT_OK(OpenReader(rowset_metadata_, col_id, &reader));
+    RETURN_NOT_OK(OpenReader(rowset_metadata_, col_id, reader_options_, &reader));
     readers_by_col_id_[col_id] = shared_ptr<CFileReader>(reader.release());
     VLOG(1) << "Successfully opened cfile for column id " << col_id
             << " in " << rowset_metadata_->ToString();
@@ -99,6 +112,16 @@ Status CFileSet::Open() {
   // Determine the upper and lower key bounds for this CFileSet.
   RETURN_NOT_OK(LoadMinMaxKeys());
 
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  live_row_begin_ = 0;
+  live_row_end_ = num_rows;
+
+  // Restrict them to the live rows, if some were compacted away.
+  if (rowset_metadata_->has_live_range()) {
+    RETURN_NOT_OK(SetLiveRange(rowset_metadata_->live_range()));
+  }
+
   return Status::OK();
 }
 
@@ -111,8 +134,7 @@ Status CFileSet::OpenAdHocIndexReader() {
   gscoped_ptr<ReadableBlock> block;
   RETURN_NOT_OK(fs->OpenBlock(rowset_metadata_->adhoc_index_block(), &block));
 
-  ReaderOptions opts;
-  return CFileReader::Open(std::move(block), opts, &ad_hoc_idx_reader_);
+  return CFileReader::Open(std::move(block), reader_options_, &ad_hoc_idx_reader_);
 }
 
 
@@ -125,8 +147,7 @@ Status CFileSet::OpenBloomReader() {
   gscoped_ptr<ReadableBlock> block;
   RETURN_NOT_OK(fs->OpenBlock(rowset_metadata_->bloom_block(), &block));
 
-  ReaderOptions opts;
-  Status s = BloomFileReader::OpenNoInit(std::move(block), opts, &bloom_reader_);
+  Status s = BloomFileReader::OpenNoInit(std::move(block), reader_options_, &bloom_reader_);
   if (!s.ok()) {
     LOG(WARNING) << "Unable to open bloom file in " << rowset_metadata_->ToString() << ": "
                  << s.ToString();
@@ -154,6 +175,21 @@ Status CFileSet::LoadMinMaxKeys() {
   return Status::OK();
 }
 
+Status CFileSet::SetLiveRange(const RowSetLiveRange& live_range) {
+  rowid_t num_rows;
+  RETURN_NOT_OK(CountRows(&num_rows));
+  if (live_range.begin_row >= live_range.end_row || live_range.end_row > num_rows) {
+    return Status::Corruption(Substitute("Invalid live range [$0, $1) for $2 rows",
+                                         live_range.begin_row, live_range.end_row, num_rows),
+                              ToString());
+  }
+  live_row_begin_ = live_range.begin_row;
+  live_row_end_ = live_range.end_row;
+  min_encoded_key_ = live_range.min_encoded_key;
+  max_encoded_key_ = live_range.max_encoded_key;
+  return Status::OK();
+}
+
 CFileReader* CFileSet::key_index_reader() const {
   if (ad_hoc_idx_reader_) {
     return ad_hoc_idx_reader_.get();
@@ -170,6 +206,22 @@ Status CFileSet::NewColumnIterator(ColumnId col_id, CFileReader::CacheControl ca
   return FindOrDie(readers_by_col_id_, col_id)->NewIterator(iter, cache_blocks);
 }
 
+Status CFileSet::GetColumnStorage(ColumnId col_id, EncodingType* encoding,
+                                  CompressionType* compression) const {
+  const shared_ptr<CFileReader>& reader = FindOrDie(readers_by_col_id_, col_id);
+  RETURN_NOT_OK(reader->Init());
+  *encoding = reader->footer().encoding();
+  *compression = reader->footer().compression();
+  return Status::OK();
+}
+
+Status CFileSet::ReadColumnZoneMaps(ColumnId col_id,
+                                    gscoped_ptr<cfile::CFileZoneMapsPB>* zone_maps) const {
+  const shared_ptr<CFileReader>& reader = FindOrDie(readers_by_col_id_, col_id);
+  RETURN_NOT_OK(reader->Init());
+  return reader->ReadZoneMaps(zone_maps);
+}
+
 CFileSet::Iterator *CFileSet::NewIterator(const Schema *projection) const {
   return new CFileSet::Iterator(shared_from_this(), projection);
 }
@@ -194,6 +246,64 @@ uint64_t CFileSet::EstimateOnDiskSize() const {
   return ret;
 }
 
+void CFileSet::GetReaderMemoryUsage(int64_t* consumption, size_t* pinned_index_bytes) const {
+  *consumption = 0;
+  *pinned_index_bytes = 0;
+  for (const ReaderMap::value_type& e : readers_by_col_id_) {
+    *consumption += e.second->memory_consumption();
+    *pinned_index_bytes += e.second->pinned_validx_bytes();
+  }
+  if (ad_hoc_idx_reader_) {
+    *consumption += ad_hoc_idx_reader_->memory_consumption();
+    *pinned_index_bytes += ad_hoc_idx_reader_->pinned_validx_bytes();
+  }
+  if (bloom_reader_) {
+    *consumption += bloom_reader_->memory_consumption();
+    *pinned_index_bytes += bloom_reader_->pinned_index_bytes();
+  }
+}
+
+uint64_t CFileSet::EstimateColumnOnDiskSize(ColumnId col_id) const {
+  const shared_ptr<CFileReader>* reader = FindOrNull(readers_by_col_id_, col_id);
+  return reader == nullptr ? 0 : (*reader)->file_size();
+}
+
+Status CFileSet::ColumnZoneMapExcludes(ColumnId col_id, const ColumnPredicate& pred,
+                                       bool* excluded) const {
+  *excluded = false;
+  const shared_ptr<CFileReader>* reader = FindOrNull(readers_by_col_id_, col_id);
+  if (reader == nullptr) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK((*reader)->Init());
+  *excluded = (*reader)->FileZoneMapExcludes(pred);
+  return Status::OK();
+}
+
+Status CFileSet::GetIndexKeys(vector<string>* keys) const {
+  CFileReader* key_reader = key_index_reader();
+  if (!key_reader->has_validx()) {
+    return Status::NotSupported("no key index", ToString());
+  }
+  gscoped_ptr<IndexTreeIterator> iter(IndexTreeIterator::Create(key_reader,
+                                                                key_reader->validx_root()));
+  RETURN_NOT_OK(iter->SeekToFirst());
+  while (true) {
+    Slice key = iter->GetCurrentKey();
+    if (key.compare(max_encoded_key_) > 0) {
+      break;
+    }
+    if (key.compare(min_encoded_key_) >= 0) {
+      keys->push_back(key.ToString());
+    }
+    if (!iter->HasNext()) {
+      break;
+    }
+    RETURN_NOT_OK(iter->Next());
+  }
+  return Status::OK();
+}
+
 Status CFileSet::FindRow(const RowSetKeyProbe &probe, rowid_t *idx,
                          ProbeStats* stats) const {
   if (bloom_reader_ != nullptr && FLAGS_consult_bloom_filters) {
@@ -228,6 +338,26 @@ Status CFileSet::FindRow(const RowSetKeyProbe &probe, rowid_t *idx,
   }
 
   *idx = key_iter->GetCurrentOrdinal();
+  if (*idx < live_row_begin_ || *idx >= live_row_end_) {
+    return Status::NotFound("not present in storefile (outside of live range)");
+  }
+  return Status::OK();
+}
+
+Status CFileSet::FindLiveRowAtOrAfter(const EncodedKey& key, rowid_t* idx) const {
+  CFileIterator *key_iter = nullptr;
+  RETURN_NOT_OK(NewKeyIterator(&key_iter));
+  gscoped_ptr<CFileIterator> key_iter_scoped(key_iter); // free on return
+
+  bool exact;
+  Status s = key_iter->SeekAtOrAfter(key, &exact);
+  if (s.IsNotFound()) {
+    // The key comes past the end of the file.
+    *idx = live_row_end_;
+    return Status::OK();
+  }
+  RETURN_NOT_OK(s);
+  *idx = std::min(std::max(key_iter->GetCurrentOrdinal(), live_row_begin_), live_row_end_);
   return Status::OK();
 }
 
@@ -324,8 +454,8 @@ Status CFileSet::Iterator::Init(ScanSpec *spec) {
 Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
   CHECK_GT(row_count_, 0);
 
-  lower_bound_idx_ = 0;
-  upper_bound_idx_ = row_count_;
+  lower_bound_idx_ = base_data_->live_row_begin_;
+  upper_bound_idx_ = base_data_->live_row_end_;
 
   if (spec == nullptr) {
     // No predicate.
@@ -344,8 +474,8 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
     if (s.IsNotFound()) {
       // The lower bound is after the end of the key range.
       // Thus, no rows will pass the predicate, so we set the lower bound
-      // to the end of the file.
-      lower_bound_idx_ = row_count_;
+      // to the end of the live range.
+      lower_bound_idx_ = upper_bound_idx_;
       return Status::OK();
     }
     RETURN_NOT_OK(s);
@@ -378,6 +508,10 @@ Status CFileSet::Iterator::PushdownRangeScanPredicate(ScanSpec *spec) {
               << " as row_idx < " << upper_bound_idx_;
     }
   }
+
+  // The lower bound may lie past the live rows, if those of the files which
+  // follow them were compacted away.
+  lower_bound_idx_ = std::min(lower_bound_idx_, upper_bound_idx_);
   return Status::OK();
 }
 
@@ -396,12 +530,44 @@ Status CFileSet::Iterator::PrepareBatch(size_t *n) {
 
   prepared_count_ = *n;
 
+  if (!prefetched_) {
+    prefetched_ = true;
+    if (upper_bound_idx_ - lower_bound_idx_ <=
+        static_cast<rowid_t>(FLAGS_cfile_set_prefetch_columns_max_rows)) {
+      PrefetchColumns();
+    }
+  }
+
   // Lazily prepare the first column when it is materialized.
   return Status::OK();
 }
 
+void CFileSet::Iterator::PrefetchColumns() {
+  // Each column lives in its own cfile, so reading a short range of a wide
+  // projection would otherwise wait on one disk read per column in turn.
+  // Hinting them all up front lets the reads proceed concurrently; the
+  // columns are then prepared lazily as usual, mostly from the page cache.
+  int num_unseeked = 0;
+  for (const ColumnIterator* col_iter : col_iters_) {
+    if (!col_iter->seeked()) {
+      num_unseeked++;
+    }
+  }
+  if (num_unseeked < 2) {
+    return;
+  }
+  for (size_t i = 0; i < col_iters_.size(); i++) {
+    if (col_iters_[i]->seeked()) {
+      continue;
+    }
+    WARN_NOT_OK(col_iters_[i]->PrefetchOrdinal(cur_idx_),
+                Substitute("Unable to prefetch column $0 of $1",
+                           projection_->column(i).ToString(), base_data_->ToString()));
+  }
+}
+
 
-Status CFileSet::Iterator::PrepareColumn(size_t idx) {
+Status CFileSet::Iterator::PrepareColumn(size_t idx, ColumnMaterializationContext *ctx) {
   if (cols_prepared_[idx]) {
     // Already prepared in this batch.
     return Status::OK();
@@ -419,7 +585,7 @@ Status CFileSet::Iterator::PrepareColumn(size_t idx) {
     RETURN_NOT_OK(col_iter->SeekToOrdinal(cur_idx_));
   }
 
-  Status s = col_iter->PrepareBatch(&n);
+  Status s = ctx != nullptr ? col_iter->PrepareBatch(ctx, &n) : col_iter->PrepareBatch(&n);
   if (!s.ok()) {
     LOG(WARNING) << "Unable to prepare column " << idx << ": " << s.ToString();
     return s;
@@ -446,11 +612,20 @@ Status CFileSet::Iterator::MaterializeColumn(size_t col_idx, ColumnBlock *dst) {
   CHECK_EQ(prepared_count_, dst->nrows());
   DCHECK_LT(col_idx, col_iters_.size());
 
-  RETURN_NOT_OK(PrepareColumn(col_idx));
+  RETURN_NOT_OK(PrepareColumn(col_idx, nullptr));
   ColumnIterator* iter = col_iters_[col_idx];
   return iter->Scan(dst);
 }
 
+Status CFileSet::Iterator::MaterializeColumn(ColumnMaterializationContext *ctx) {
+  CHECK_EQ(prepared_count_, ctx->block()->nrows());
+  DCHECK_LT(ctx->col_idx(), col_iters_.size());
+
+  RETURN_NOT_OK(PrepareColumn(ctx->col_idx(), ctx));
+  ColumnIterator* iter = col_iters_[ctx->col_idx()];
+  return iter->Scan(ctx);
+}
+
 Status CFileSet::Iterator::FinishBatch() {
   CHECK_GT(prepared_count_, 0);
 
@@ -57,7 +57,9 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
  public:
   class Iterator;
 
-  explicit CFileSet(std::shared_ptr<RowSetMetadata> rowset_metadata);
+  // The files are opened with 'reader_options'.
+  explicit CFileSet(std::shared_ptr<RowSetMetadata> rowset_metadata,
+                    cfile::ReaderOptions reader_options = cfile::ReaderOptions());
 
   Status Open();
 
@@ -65,14 +67,46 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   // for the lifetime of the returned iterator.
   virtual Iterator *NewIterator(const Schema *projection) const;
 
+  // Counts all of the rows in the files, including any outside of the live range.
   Status CountRows(rowid_t *count) const;
 
+  // The ordinals of the rows which are visible: [live_row_begin(), live_row_end()).
+  // Unless a range-sliced compaction moved some of the rows into other rowsets,
+  // these are all of the rows in the files.
+  rowid_t live_row_begin() const { return live_row_begin_; }
+  rowid_t live_row_end() const { return live_row_end_; }
+
+  // Restrict the visible rows to 'live_range'. This must only be called
+  // after Open() and before the CFileSet is used.
+  Status SetLiveRange(const RowSetLiveRange& live_range);
+
+  // Set '*idx' to the ordinal of the first live row whose key is at or after
+  // 'key', or to live_row_end() if there is none.
+  Status FindLiveRowAtOrAfter(const EncodedKey& key, rowid_t* idx) const;
+
   // See RowSet::GetBounds
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const;
 
   uint64_t EstimateOnDiskSize() const;
 
+  // Estimate the number of bytes on-disk for the CFile of column 'col_id',
+  // or 0 if there is none.
+  uint64_t EstimateColumnOnDiskSize(ColumnId col_id) const;
+
+  // Sets '*excluded' to true if the zone map of the CFile of column 'col_id'
+  // shows that none of the base data can satisfy 'pred'. Columns without a
+  // CFile, such as those added since the rowset was written, never exclude
+  // a predicate. Opens the CFile if it was lazily opened.
+  Status ColumnZoneMapExcludes(ColumnId col_id, const ColumnPredicate& pred,
+                               bool* excluded) const;
+
+  // Append to 'keys', in order, the encoded keys of the key index entries
+  // which fall within the live range. Each entry marks the start of one data
+  // block of the key column, so consecutive keys are roughly a block apart.
+  // Some keys may be shortened separators rather than the keys of rows.
+  Status GetIndexKeys(std::vector<std::string>* keys) const;
+
   // Determine the index of the given row key.
   Status FindRow(const RowSetKeyProbe &probe, rowid_t *idx, ProbeStats* stats) const;
 
@@ -90,6 +124,23 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
     return ContainsKey(readers_by_col_id_, col_id);
   }
 
+  // Sets '*encoding' and '*compression' to those the CFile of the column
+  // 'col_id' was written with. The column must have data in this CFileSet.
+  // The CFile's footer is read if it hasn't been yet.
+  Status GetColumnStorage(ColumnId col_id, EncodingType* encoding,
+                          CompressionType* compression) const;
+
+  // Reads the zone maps of the CFile of the column 'col_id' into
+  // '*zone_maps', or resets it if the CFile has none. The column must have
+  // data in this CFileSet.
+  Status ReadColumnZoneMaps(ColumnId col_id,
+                            gscoped_ptr<cfile::CFileZoneMapsPB>* zone_maps) const;
+
+  // Sets '*consumption' to the memory used by the readers of the files opened
+  // so far, and '*pinned_index_bytes' to the part of it taken by index blocks
+  // kept in memory.
+  void GetReaderMemoryUsage(int64_t* consumption, size_t* pinned_index_bytes) const;
+
   virtual ~CFileSet();
 
  private:
@@ -113,10 +164,15 @@ class CFileSet : public std::enable_shared_from_this<CFileSet> {
   const Schema &tablet_schema() const { return rowset_metadata_->tablet_schema(); }
 
   std::shared_ptr<RowSetMetadata> rowset_metadata_;
+  const cfile::ReaderOptions reader_options_;
 
+  // The bounds of the live rows' keys.
   std::string min_encoded_key_;
   std::string max_encoded_key_;
 
+  rowid_t live_row_begin_;
+  rowid_t live_row_end_;
+
   // Map of column ID to reader. These are lazily initialized as needed.
   typedef std::unordered_map<int, std::shared_ptr<CFileReader> > ReaderMap;
   ReaderMap readers_by_col_id_;
@@ -146,6 +202,8 @@ class CFileSet::Iterator : public ColumnwiseIterator {
 
   virtual Status MaterializeColumn(size_t col_idx, ColumnBlock *dst) OVERRIDE;
 
+  virtual Status MaterializeColumn(ColumnMaterializationContext *ctx) OVERRIDE;
+
   virtual Status FinishBatch() OVERRIDE;
 
   virtual bool HasNext() const OVERRIDE {
@@ -182,7 +240,8 @@ class CFileSet::Iterator : public ColumnwiseIterator {
         projection_(projection),
         initted_(false),
         cur_idx_(0),
-        prepared_count_(0) {
+        prepared_count_(0),
+        prefetched_(false) {
     CHECK_OK(base_data_->CountRows(&row_count_));
   }
 
@@ -196,8 +255,13 @@ class CFileSet::Iterator : public ColumnwiseIterator {
 
   void Unprepare();
 
-  // Prepare the given column if not already prepared.
-  Status PrepareColumn(size_t col_idx);
+  // Hint the data blocks of the unread columns at the current position to
+  // be read, if there are several of them.
+  void PrefetchColumns();
+
+  // Prepare the given column if not already prepared. If 'ctx' is non-NULL,
+  // its predicate may be used to avoid reading data which can't match.
+  Status PrepareColumn(size_t col_idx, ColumnMaterializationContext *ctx);
 
   const std::shared_ptr<CFileSet const> base_data_;
   const Schema* projection_;
@@ -217,7 +281,8 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // Lower bound (inclusive) and upper bound (exclusive) for this iterator, in terms of
   // ordinal row indexes.
   // Both of these bounds are always set (even if there is no predicate).
-  // If there is no predicate, then the bounds will be [0, row_count_]
+  // If there is no predicate, then the bounds will be the live range of the
+  // CFileSet, normally [0, row_count_]
   rowid_t lower_bound_idx_;
   rowid_t upper_bound_idx_;
 
@@ -226,6 +291,10 @@ class CFileSet::Iterator : public ColumnwiseIterator {
   // materialized, it doesn't need to be read off disk.
   vector<bool> cols_prepared_;
 
+  // Whether the first batch was prepared, at which point short scans
+  // prefetch their columns.
+  bool prefetched_;
+
 };
 
 } // namespace tablet
@@ -26,6 +26,7 @@
 #include "kudu/consensus/opid_util.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/fs/log_block_manager.h"
+#include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/server/logical_clock.h"
@@ -34,6 +35,7 @@
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 DEFINE_string(merge_benchmark_input_dir, "",
               "Directory to benchmark merge. The benchmark will merge "
@@ -48,6 +50,9 @@ DEFINE_int32(merge_benchmark_num_rows_per_rowset, 500000,
 
 DECLARE_string(block_manager);
 DECLARE_bool(enable_data_block_fsync);
+DECLARE_int32(compaction_encode_column_groups);
+DECLARE_int64(compaction_encode_batch_bytes);
+DECLARE_int32(compaction_slice_min_rowset_mb);
 
 using std::shared_ptr;
 
@@ -70,7 +75,8 @@ class TestCompaction : public KuduRowSetTest {
       row_builder_(schema_),
       mvcc_(scoped_refptr<server::Clock>(
               server::LogicalClock::CreateStartingAt(Timestamp::kInitialTimestamp))),
-      log_anchor_registry_(new log::LogAnchorRegistry()) {
+      log_anchor_registry_(new log::LogAnchorRegistry()),
+      encode_pool_(nullptr) {
   }
 
   static Schema CreateSchema() {
@@ -206,9 +212,9 @@ class TestCompaction : public KuduRowSetTest {
     // This simplifies the test so we always need to reopen only a single rowset.
     RollingDiskRowSetWriter rsw(tablet()->metadata(), projection,
                                 BloomFilterSizing::BySizeAndFPRate(32*1024, 0.01f),
-                                roll_threshold);
+                                roll_threshold, encode_pool_);
     ASSERT_OK(rsw.Open());
-    ASSERT_OK(FlushCompactionInput(input, snap, &rsw));
+    ASSERT_OK(FlushCompactionInput(input, snap, nullptr, &rsw));
     ASSERT_OK(rsw.Finish());
 
     vector<shared_ptr<RowSetMetadata> > metas;
@@ -378,7 +384,7 @@ class TestCompaction : public KuduRowSetTest {
                                     BloomFilterSizing::BySizeAndFPRate(32 * 1024, 0.01f),
                                     1024 * 1024); // 1 MB
       ASSERT_OK(rdrsw.Open());
-      ASSERT_OK(FlushCompactionInput(compact_input.get(), merge_snap, &rdrsw));
+      ASSERT_OK(FlushCompactionInput(compact_input.get(), merge_snap, nullptr, &rdrsw));
       ASSERT_OK(rdrsw.Finish());
     }
   }
@@ -391,6 +397,9 @@ class TestCompaction : public KuduRowSetTest {
   MvccManager mvcc_;
 
   scoped_refptr<LogAnchorRegistry> log_anchor_registry_;
+
+  // If set, the columns written by DoFlushAndReopen() are encoded on this pool.
+  ThreadPool* encode_pool_;
 };
 
 TEST_F(TestCompaction, TestMemRowSetInput) {
@@ -444,6 +453,41 @@ TEST_F(TestCompaction, TestFlushMRSWithRolling) {
             rows[1]);
 }
 
+// Test that encoding the columns on a thread pool writes the same rowsets as
+// encoding them on the flushing thread.
+TEST_F(TestCompaction, TestFlushWithParallelEncoding) {
+  // Use small batches, so that each flush goes through many of them, and
+  // split the columns in two groups: the key, and the rest.
+  FLAGS_compaction_encode_batch_bytes = 4096;
+  FLAGS_compaction_encode_column_groups = 2;
+
+  shared_ptr<MemRowSet> mrs(new MemRowSet(0, schema_, log_anchor_registry_.get()));
+  InsertRows(mrs.get(), 10000, 0);
+  UpdateRows(mrs.get(), 10000, 0, 1);
+
+  shared_ptr<DiskRowSet> serial_rs;
+  ASSERT_NO_FATAL_FAILURE(FlushMRSAndReopenNoRoll(*mrs, schema_, &serial_rs));
+
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("encode").set_max_threads(2).Build(&pool));
+  encode_pool_ = pool.get();
+  shared_ptr<DiskRowSet> parallel_rs;
+  ASSERT_NO_FATAL_FAILURE(FlushMRSAndReopenNoRoll(*mrs, schema_, &parallel_rs));
+
+  vector<string> serial_rows;
+  vector<string> parallel_rows;
+  ASSERT_OK(serial_rs->DebugDump(&serial_rows));
+  ASSERT_OK(parallel_rs->DebugDump(&parallel_rows));
+  ASSERT_EQ(10000, parallel_rows.size());
+  ASSERT_EQ(serial_rows, parallel_rows);
+
+  // Rolling still splits the output when the columns are encoded in parallel.
+  vector<shared_ptr<DiskRowSet> > rowsets;
+  FlushMRSAndReopen(*mrs, schema_, kSmallRollThreshold, &rowsets);
+  ASSERT_GT(rowsets.size(), 1);
+  encode_pool_ = nullptr;
+}
+
 TEST_F(TestCompaction, TestRowSetInput) {
   // Create a memrowset with a bunch of rows, flush and reopen.
   shared_ptr<DiskRowSet> rs;
@@ -575,7 +619,7 @@ TEST_F(TestCompaction, TestOneToOne) {
 
   string dummy_name = "";
 
-  ASSERT_OK(ReupdateMissedDeltas(dummy_name, input.get(), snap, snap2, { rs }));
+  ASSERT_OK(ReupdateMissedDeltas(dummy_name, input.get(), snap, snap2, nullptr, { rs }));
 
   // If we look at the contents of the DiskRowSet now, we should see the "re-updated" data.
   vector<string> out;
@@ -628,7 +672,8 @@ TEST_F(TestCompaction, TestKUDU102) {
   string dummy_name = "";
 
   // This would fail without KUDU-102
-  ASSERT_OK(ReupdateMissedDeltas(dummy_name, input.get(), snap, snap2, { rs, rs_b }));
+  ASSERT_OK(ReupdateMissedDeltas(dummy_name, input.get(), snap, snap2, nullptr,
+                                 { rs, rs_b }));
 }
 
 
@@ -767,6 +812,67 @@ TEST_F(TestCompaction, TestCompactionFreesDiskSpace) {
   }
 }
 
+// Test that a compaction slices a large rowset which the other inputs overlap
+// only at its upper end: the overlapping rows are merged into the outputs
+// while the others stay in place, and the result survives a restart.
+TEST_F(TestCompaction, TestRangeSlicedCompaction) {
+  FLAGS_compaction_slice_min_rowset_mb = 0;
+
+  {
+    LocalTabletWriter writer(tablet().get(), &client_schema());
+    KuduPartialRow row(&client_schema());
+
+    // A large rowset with the even keys in [0, 200).
+    for (int i = 0; i < 200; i += 2) {
+      ASSERT_OK(row.SetStringCopy("key", StringPrintf(kRowKeyFormat, i)));
+      ASSERT_OK(row.SetInt32("val", i));
+      ASSERT_OK(writer.Insert(row));
+    }
+    ASSERT_OK(tablet()->Flush());
+
+    // A small rowset with the odd keys in [181, 210).
+    for (int i = 181; i < 210; i += 2) {
+      ASSERT_OK(row.SetStringCopy("key", StringPrintf(kRowKeyFormat, i)));
+      ASSERT_OK(row.SetInt32("val", i));
+      ASSERT_OK(writer.Insert(row));
+    }
+    ASSERT_OK(tablet()->Flush());
+  }
+
+  vector<string> rows_before;
+  ASSERT_OK(DumpTablet(*tablet(), client_schema(), &rows_before));
+  ASSERT_EQ(115, rows_before.size());
+
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+
+  // Only the 9 rows of the large rowset with keys >= 181 were rewritten.
+  for (int restart = 0; restart < 2; restart++) {
+    vector<shared_ptr<RowSet> > rowsets;
+    tablet()->GetRowSetsForTests(&rowsets);
+    ASSERT_EQ(2, rowsets.size());
+    int num_sliced = 0;
+    for (const shared_ptr<RowSet>& rs : rowsets) {
+      rowid_t count;
+      ASSERT_OK(rs->CountRows(&count));
+      if (rs->metadata()->has_live_range()) {
+        num_sliced++;
+        ASSERT_EQ(91, count);
+      } else {
+        ASSERT_EQ(24, count);
+      }
+    }
+    ASSERT_EQ(1, num_sliced);
+
+    vector<string> rows_after;
+    ASSERT_OK(DumpTablet(*tablet(), client_schema(), &rows_after));
+    ASSERT_EQ(rows_before, rows_after);
+
+    if (restart == 0) {
+      ASSERT_NO_FATAL_FAILURE(TabletReOpen());
+    }
+  }
+}
+
 // Regression test for KUDU-1237, a bug in which empty flushes or compactions
 // would result in orphaning near-empty cfile blocks on the disk.
 TEST_F(TestCompaction, TestEmptyFlushDoesntLeakBlocks) {
@@ -17,13 +17,17 @@
 
 #include "kudu/tablet/compaction.h"
 
+#include <algorithm>
 #include <deque>
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <memory>
 #include <string>
 #include <unordered_set>
 #include <vector>
 
+#include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/row_key_coder.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/macros.h"
@@ -37,6 +41,12 @@
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/transactions/write_transaction.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_bool(compaction_use_codegen, true,
+            "Whether merging compactions should compare row keys with code "
+            "generated for the tablet's key columns");
+TAG_FLAG(compaction_use_codegen, hidden);
 
 using std::shared_ptr;
 using std::unique_ptr;
@@ -135,9 +145,15 @@ class MemRowSetCompactionInput : public CompactionInput {
 class DiskRowSetCompactionInput : public CompactionInput {
  public:
   DiskRowSetCompactionInput(gscoped_ptr<RowwiseIterator> base_iter,
+                            const CFileSet::Iterator* base_cfile_iter,
                             unique_ptr<DeltaIterator> redo_delta_iter,
-                            unique_ptr<DeltaIterator> undo_delta_iter)
+                            unique_ptr<DeltaIterator> undo_delta_iter,
+                            const EncodedKey* lower_bound,
+                            const EncodedKey* exclusive_upper_bound)
       : base_iter_(std::move(base_iter)),
+        base_cfile_iter_(base_cfile_iter),
+        lower_bound_(lower_bound),
+        exclusive_upper_bound_(exclusive_upper_bound),
         redo_delta_iter_(std::move(redo_delta_iter)),
         undo_delta_iter_(std::move(undo_delta_iter)),
         arena_(32 * 1024, 128 * 1024),
@@ -149,11 +165,21 @@ class DiskRowSetCompactionInput : public CompactionInput {
   virtual Status Init() OVERRIDE {
     ScanSpec spec;
     spec.set_cache_blocks(false);
+    if (lower_bound_) {
+      spec.SetLowerBoundKey(lower_bound_);
+    }
+    if (exclusive_upper_bound_) {
+      spec.SetExclusiveUpperBoundKey(exclusive_upper_bound_);
+    }
     RETURN_NOT_OK(base_iter_->Init(&spec));
+
+    // The key bounds and the live range of the rowset may have the base data
+    // start past the first row, so seek the deltas to wherever it starts.
+    rowid_t first_rowid = base_cfile_iter_->cur_ordinal_idx();
     RETURN_NOT_OK(redo_delta_iter_->Init(&spec));
-    RETURN_NOT_OK(redo_delta_iter_->SeekToOrdinal(0));
+    RETURN_NOT_OK(redo_delta_iter_->SeekToOrdinal(first_rowid));
     RETURN_NOT_OK(undo_delta_iter_->Init(&spec));
-    RETURN_NOT_OK(undo_delta_iter_->SeekToOrdinal(0));
+    RETURN_NOT_OK(undo_delta_iter_->SeekToOrdinal(first_rowid));
     return Status::OK();
   }
 
@@ -201,6 +227,12 @@ class DiskRowSetCompactionInput : public CompactionInput {
  private:
   DISALLOW_COPY_AND_ASSIGN(DiskRowSetCompactionInput);
   gscoped_ptr<RowwiseIterator> base_iter_;
+
+  // The columnwise iterator wrapped by 'base_iter_'.
+  const CFileSet::Iterator* base_cfile_iter_;
+
+  const EncodedKey* lower_bound_;
+  const EncodedKey* exclusive_upper_bound_;
   unique_ptr<DeltaIterator> redo_delta_iter_;
   unique_ptr<DeltaIterator> undo_delta_iter_;
 
@@ -270,6 +302,9 @@ class MergeCompactionInput : public CompactionInput {
   MergeCompactionInput(const vector<shared_ptr<CompactionInput> > &inputs,
                        const Schema* schema)
     : schema_(schema) {
+    if (FLAGS_compaction_use_codegen) {
+      codegen::CompilationManager::GetSingleton()->RequestRowKeyCoder(schema_, &key_coder_);
+    }
     for (const shared_ptr<CompactionInput> &input : inputs) {
       gscoped_ptr<MergeState> state(new MergeState);
       state->input = input;
@@ -334,7 +369,8 @@ class MergeCompactionInput : public CompactionInput {
           smallest = state->next();
           continue;
         }
-        int row_comp = schema_->Compare(state->next().row, smallest.row);
+        int row_comp = key_coder_ ? key_coder_->Compare(state->next().row, smallest.row) :
+                                    schema_->Compare(state->next().row, smallest.row);
         if (row_comp < 0) {
           smallest_idx = i;
           smallest = state->next();
@@ -513,6 +549,9 @@ class MergeCompactionInput : public CompactionInput {
   }
 
   const Schema* schema_;
+  // Compares the keys of the merged rows if the key functions for the
+  // schema had already been compiled when the merge started.
+  gscoped_ptr<codegen::RowKeyCoder> key_coder_;
   vector<MergeState *> states_;
   Arena* prepared_block_arena_;
 };
@@ -525,9 +564,19 @@ Status CompactionInput::Create(const DiskRowSet &rowset,
                                const Schema* projection,
                                const MvccSnapshot &snap,
                                gscoped_ptr<CompactionInput>* out) {
+  return Create(rowset, projection, snap, nullptr, nullptr, out);
+}
+
+Status CompactionInput::Create(const DiskRowSet &rowset,
+                               const Schema* projection,
+                               const MvccSnapshot &snap,
+                               const EncodedKey* lower_bound,
+                               const EncodedKey* exclusive_upper_bound,
+                               gscoped_ptr<CompactionInput>* out) {
   CHECK(projection->has_column_ids());
 
-  shared_ptr<ColumnwiseIterator> base_cwise(rowset.base_data_->NewIterator(projection));
+  shared_ptr<CFileSet::Iterator> base_cwise(rowset.base_data_->NewIterator(projection));
+  const CFileSet::Iterator* base_cfile_iter = base_cwise.get();
   gscoped_ptr<RowwiseIterator> base_iter(new MaterializingIterator(base_cwise));
 
   // Creates a DeltaIteratorMerger that will only include the relevant REDO deltas.
@@ -542,8 +591,11 @@ Status CompactionInput::Create(const DiskRowSet &rowset,
       DeltaTracker::UNDOS_ONLY, &undo_deltas), "Could not open UNDOs");
 
   out->reset(new DiskRowSetCompactionInput(std::move(base_iter),
+                                           base_cfile_iter,
                                            std::move(redo_deltas),
-                                           std::move(undo_deltas)));
+                                           std::move(undo_deltas),
+                                           lower_bound,
+                                           exclusive_upper_bound));
   return Status::OK();
 }
 
@@ -569,9 +621,19 @@ Status RowSetsInCompaction::CreateCompactionInput(const MvccSnapshot &snap,
   vector<shared_ptr<CompactionInput> > inputs;
   for (const shared_ptr<RowSet> &rs : rowsets_) {
     gscoped_ptr<CompactionInput> input;
-    RETURN_NOT_OK_PREPEND(rs->NewCompactionInput(schema, snap, &input),
-                          Substitute("Could not create compaction input for rowset $0",
-                                     rs->ToString()));
+    const RowSetSlice* slice = FindSlice(rs.get());
+    Status s;
+    if (slice) {
+      const EncodedKey* split_key = slice->split_key.get();
+      s = CompactionInput::Create(*down_cast<DiskRowSet*>(rs.get()), schema, snap,
+                                  slice->compacted.compact_upper ? split_key : nullptr,
+                                  slice->compacted.compact_upper ? nullptr : split_key,
+                                  &input);
+    } else {
+      s = rs->NewCompactionInput(schema, snap, &input);
+    }
+    RETURN_NOT_OK_PREPEND(s, Substitute("Could not create compaction input for rowset $0",
+                                        rs->ToString()));
     inputs.push_back(shared_ptr<CompactionInput>(input.release()));
   }
 
@@ -588,11 +650,62 @@ void RowSetsInCompaction::DumpToLog() const {
   LOG(INFO) << "Selected " << rowsets_.size() << " rowsets to compact:";
   // Dump the selected rowsets to the log, and collect corresponding iterators.
   for (const shared_ptr<RowSet> &rs : rowsets_) {
+    const RowSetSlice* slice = FindSlice(rs.get());
     LOG(INFO) << rs->ToString() << "(current size on disk: ~"
-              << rs->EstimateOnDiskSize() << " bytes)";
+              << rs->EstimateOnDiskSize() << " bytes)"
+              << (slice ? Substitute(", sliced: keeping rows [$0, $1)",
+                                     slice->retained.begin_row, slice->retained.end_row) : "");
   }
 }
 
+void RowSetsInCompaction::SliceRowSet(const RowSet* rowset, unique_ptr<RowSetSlice> slice) {
+  DCHECK(std::any_of(rowsets_.begin(), rowsets_.end(),
+                     [&](const shared_ptr<RowSet>& rs) { return rs.get() == rowset; }));
+  CHECK(slices_.emplace(rowset, std::move(slice)).second)
+      << "Rowset already sliced: " << rowset->ToString();
+}
+
+const RowSetSlice* RowSetsInCompaction::FindSlice(const RowSet* rowset) const {
+  auto it = slices_.find(rowset);
+  return it == slices_.end() ? nullptr : it->second.get();
+}
+
+RowSetKeySlices RowSetsInCompaction::key_slices() const {
+  RowSetKeySlices ret;
+  for (const auto& e : slices_) {
+    InsertOrDie(&ret, e.first, e.second->compacted);
+  }
+  return ret;
+}
+
+RowSetLiveRanges RowSetsInCompaction::retained_live_ranges() const {
+  RowSetLiveRanges ret;
+  for (const shared_ptr<RowSet>& rs : rowsets_) {
+    const RowSetSlice* slice = FindSlice(rs.get());
+    if (slice) {
+      InsertOrDie(&ret, rs->metadata()->id(), slice->retained);
+    }
+  }
+  return ret;
+}
+
+
+bool IsRowExpired(const RowExpiry& expiry,
+                  const MvccSnapshot& snap,
+                  const CompactionInputRow& row) {
+  if (row.redo_head != nullptr && snap.IsCommitted(row.redo_head->timestamp())) {
+    return false;
+  }
+  const Schema* schema = row.row.schema();
+  int col_idx = schema->find_column_by_id(expiry.col_id);
+  if (col_idx == Schema::kColumnNotFound ||
+      (schema->column(col_idx).is_nullable() && row.row.is_null(col_idx))) {
+    return false;
+  }
+  int64_t row_micros;
+  memcpy(&row_micros, row.row.cell_ptr(col_idx), sizeof(row_micros));
+  return row_micros < expiry.cutoff_micros;
+}
 
 Status ApplyMutationsAndGenerateUndos(const MvccSnapshot& snap,
                                       const CompactionInputRow& src_row,
@@ -740,6 +853,7 @@ Status ApplyMutationsAndGenerateUndos(const MvccSnapshot& snap,
 
 Status FlushCompactionInput(CompactionInput* input,
                             const MvccSnapshot& snap,
+                            const RowExpiry* expiry,
                             RollingDiskRowSetWriter* out) {
   RETURN_NOT_OK(input->Init());
   vector<CompactionInputRow> rows;
@@ -749,12 +863,19 @@ Status FlushCompactionInput(CompactionInput* input,
   RowBlock block(out->schema(), 100, nullptr);
 
   uint64_t num_rows_history_truncated = 0;
+  uint64_t num_rows_expired = 0;
 
   while (input->HasMoreBlocks()) {
     RETURN_NOT_OK(input->PrepareBlock(&rows));
 
     int n = 0;
     for (const CompactionInputRow &input_row : rows) {
+      if (expiry != nullptr && IsRowExpired(*expiry, snap, input_row)) {
+        DVLOG(2) << "Dropping expired row: " << input_row.row.schema()->DebugRow(input_row.row);
+        num_rows_expired++;
+        continue;
+      }
+
       RETURN_NOT_OK(out->RollIfNecessary());
 
       const Schema* schema = input_row.row.schema();
@@ -831,6 +952,9 @@ Status FlushCompactionInput(CompactionInput* input,
     LOG(WARNING) << "Total " << num_rows_history_truncated
         << " rows lost some history due to REINSERT after DELETE";
   }
+  if (num_rows_expired > 0) {
+    VLOG(1) << "Dropped " << num_rows_expired << " expired rows";
+  }
   return Status::OK();
 }
 
@@ -838,6 +962,7 @@ Status ReupdateMissedDeltas(const string &tablet_name,
                             CompactionInput *input,
                             const MvccSnapshot &snap_to_exclude,
                             const MvccSnapshot &snap_to_include,
+                            const RowExpiry* expiry,
                             const RowSetVector &output_rowsets) {
   TRACE_EVENT0("tablet", "ReupdateMissedDeltas");
   RETURN_NOT_OK(input->Init());
@@ -878,6 +1003,12 @@ Status ReupdateMissedDeltas(const string &tablet_name,
     RETURN_NOT_OK(input->PrepareBlock(&rows));
 
     for (const CompactionInputRow &row : rows) {
+      if (expiry != nullptr && IsRowExpired(*expiry, snap_to_exclude, row)) {
+        // The first pass dropped this row, so it has no output row for the
+        // missed mutations to go to.
+        continue;
+      }
+
       DVLOG(2) << "Revisiting row: " << schema->DebugRow(row.row) <<
           " Redo Mutations: " << Mutation::StringifyMutationList(*schema, row.redo_head) <<
           " Undo Mutations: " << Mutation::StringifyMutationList(*schema, row.undo_head);
@@ -964,7 +1095,7 @@ Status ReupdateMissedDeltas(const string &tablet_name,
       }
 
       // TODO when garbage collection kicks in we need to take care that
-      // CGed rows do not increment this.
+      // CGed rows do not increment this, like expired rows don't.
       row_idx++;
     }
 
@@ -20,12 +20,16 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/memrowset.h"
+#include "kudu/tablet/tablet_metadata.h"
+#include "kudu/util/memory/arena.h"
 
 namespace kudu {
 namespace tablet {
@@ -49,6 +53,16 @@ class CompactionInput {
                        const MvccSnapshot &snap,
                        gscoped_ptr<CompactionInput>* out);
 
+  // Like the above, but only yields the rows with keys in
+  // ['lower_bound', 'exclusive_upper_bound'). Either bound may be NULL, and
+  // both must remain valid for the lifetime of the returned input.
+  static Status Create(const DiskRowSet &rowset,
+                       const Schema* projection,
+                       const MvccSnapshot &snap,
+                       const EncodedKey* lower_bound,
+                       const EncodedKey* exclusive_upper_bound,
+                       gscoped_ptr<CompactionInput>* out);
+
   // Create an input which reads from the given memrowset, yielding base rows and updates
   // prior to the given snapshot.
   static CompactionInput *Create(const MemRowSet &memrowset,
@@ -75,6 +89,20 @@ class CompactionInput {
   virtual ~CompactionInput() {}
 };
 
+// A disk rowset of which only a slice of the keys takes part in a compaction.
+// The rowset keeps its other rows in place, narrowed to 'retained'.
+struct RowSetSlice {
+  RowSetSlice() : arena(256, 4096) {}
+
+  RowSetKeySlice compacted;
+
+  // 'compacted.split_key', decoded into 'arena'.
+  Arena arena;
+  gscoped_ptr<EncodedKey> split_key;
+
+  RowSetLiveRange retained;
+};
+
 // The set of rowsets which are taking part in a given compaction.
 class RowSetsInCompaction {
  public:
@@ -98,15 +126,32 @@ class RowSetsInCompaction {
   // Dump a log message indicating the chosen rowsets.
   void DumpToLog() const;
 
+  // Restrict the compaction of 'rowset', which must already have been added,
+  // to 'slice'.
+  void SliceRowSet(const RowSet* rowset, std::unique_ptr<RowSetSlice> slice);
+
+  // Returns the slice of 'rowset' which takes part in the compaction, or NULL
+  // if all of its rows do.
+  const RowSetSlice* FindSlice(const RowSet* rowset) const;
+
+  // Returns the compacted key slices and retained live ranges of the sliced rowsets.
+  RowSetKeySlices key_slices() const;
+  RowSetLiveRanges retained_live_ranges() const;
+
   const RowSetVector &rowsets() const { return rowsets_; }
 
   size_t num_rowsets() const {
     return rowsets_.size();
   }
 
+  bool has_slices() const {
+    return !slices_.empty();
+  }
+
  private:
   RowSetVector rowsets_;
   vector<std::unique_lock<std::mutex>> locks_;
+  std::unordered_map<const RowSet*, std::unique_ptr<RowSetSlice>> slices_;
 };
 
 // One row yielded by CompactionInput::PrepareBlock.
@@ -119,6 +164,22 @@ struct CompactionInputRow {
   Mutation* undo_head;
 };
 
+// The rows a flush or compaction drops because their time-to-live ran out.
+struct RowExpiry {
+  // The UNIXTIME_MICROS column holding the time of each row.
+  ColumnId col_id;
+  // Rows whose time is before this had expired when the compaction started.
+  int64_t cutoff_micros;
+};
+
+// Returns true if the compaction may drop 'row' because it expired according
+// to 'expiry': its base TTL value is before the cutoff and it has no
+// mutations committed in 'snap'. A mutated row is kept, so that both passes
+// of a compaction agree on which rows they drop without applying mutations.
+bool IsRowExpired(const RowExpiry& expiry,
+                  const MvccSnapshot& snap,
+                  const CompactionInputRow& row);
+
 // Function shared by flushes, compactions and major delta compactions. Applies all the REDO
 // mutations from 'src_row' to the 'dst_row', and generates the related UNDO mutations. Some
 // handling depends on the nature of the operation being performed:
@@ -143,10 +204,13 @@ Status ApplyMutationsAndGenerateUndos(const MvccSnapshot& snap,
 // Iterate through this compaction input, flushing all rows to the given RollingDiskRowSetWriter.
 // The 'snap' argument should match the MvccSnapshot used to create the compaction input.
 //
+// If 'expiry' is non-NULL, the expired rows are dropped rather than flushed.
+//
 // After return of this function, this CompactionInput object is "used up" and will
 // no longer be useful.
 Status FlushCompactionInput(CompactionInput *input,
                             const MvccSnapshot &snap,
+                            const RowExpiry* expiry,
                             RollingDiskRowSetWriter *out);
 
 // Iterate through this compaction input, finding any mutations which came between
@@ -156,6 +220,8 @@ Status FlushCompactionInput(CompactionInput *input,
 //
 // The output rowsets passed in must be non-overlapping and in ascending key order:
 // typically they are the resulting rowsets from a RollingDiskRowSetWriter.
+// 'expiry' must be the one passed to FlushCompactionInput(), so that the rows
+// it dropped are skipped, along with the mutations missed for them.
 //
 // After return of this function, this CompactionInput object is "used up" and will
 // yield no further rows.
@@ -163,6 +229,7 @@ Status ReupdateMissedDeltas(const string &tablet_name,
                             CompactionInput *input,
                             const MvccSnapshot &snap_to_exclude,
                             const MvccSnapshot &snap_to_include,
+                            const RowExpiry* expiry,
                             const RowSetVector &output_rowsets);
 
 // Dump the given compaction input to 'lines' or LOG(INFO) if it is NULL.
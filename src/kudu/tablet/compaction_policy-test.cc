@@ -18,15 +18,18 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
 #include "kudu/util/test_util.h"
 #include "kudu/tablet/mock-rowsets.h"
 #include "kudu/tablet/rowset.h"
+#include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/rowset_tree.h"
 #include "kudu/tablet/compaction_policy.h"
 
 using std::shared_ptr;
 using std::unordered_set;
+using std::vector;
 
 namespace kudu {
 namespace tablet {
@@ -52,5 +55,66 @@ TEST(TestCompactionPolicy, TestBudgetedSelection) {
   ASSERT_GE(quality, 1.0);
 }
 
+// With four rowsets of the same size covering the same keys, the tiered
+// policy should merge them all once the merge width is reached.
+TEST(TestCompactionPolicy, TestTieredSelection) {
+  RowSetVector vec;
+  for (int i = 0; i < 4; i++) {
+    vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("A", "z")));
+  }
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  unordered_set<RowSet*> picked;
+  double quality = 0;
+  {
+    TieredCompactionPolicy policy(1000, 4, 5, 16);
+    ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+    ASSERT_EQ(0, picked.size());
+    ASSERT_EQ(0, quality);
+  }
+  {
+    TieredCompactionPolicy policy(1000, 4, 4, 16);
+    ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+    ASSERT_EQ(4, picked.size());
+    ASSERT_GT(quality, 0);
+  }
+}
+
+// Rowsets which are too narrow to merge by tier should still be compacted
+// once they stack deeper than the overlap limit.
+TEST(TestCompactionPolicy, TestTieredOverlapDepth) {
+  RowSetVector vec;
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("A", "z")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("B", "C")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("B", "D")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("C", "E")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("x", "y")));
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  vector<RowSetInfo> asc_min_key, asc_max_key;
+  RowSetInfo::CollectOrdered(tree, &asc_min_key, &asc_max_key);
+  vector<const RowSetInfo*> deepest;
+  ASSERT_EQ(4, TieredCompactionPolicy::MaxOverlapDepth(asc_min_key, &deepest));
+  ASSERT_EQ(4, deepest.size());
+
+  unordered_set<RowSet*> picked;
+  double quality = 0;
+  {
+    TieredCompactionPolicy policy(1000, 4, 16, 4);
+    ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+    ASSERT_EQ(0, picked.size());
+  }
+  {
+    TieredCompactionPolicy policy(1000, 4, 16, 3);
+    ASSERT_OK(policy.PickRowSets(tree, &picked, &quality, nullptr));
+    ASSERT_EQ(4, picked.size());
+    ASSERT_GT(quality, 0);
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
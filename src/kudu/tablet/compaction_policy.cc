@@ -20,12 +20,15 @@
 #include <glog/logging.h>
 
 #include <algorithm>
+#include <cmath>
+#include <map>
 #include <utility>
 #include <string>
 #include <vector>
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/rowset_tree.h"
@@ -35,7 +38,11 @@
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
 
+using std::map;
+using std::pair;
+using std::string;
 using std::vector;
+using strings::Substitute;
 
 DEFINE_int32(budgeted_compaction_target_rowset_size, 32*1024*1024,
              "The target size for DiskRowSets during flush/compact when the "
@@ -43,6 +50,12 @@ DEFINE_int32(budgeted_compaction_target_rowset_size, 32*1024*1024,
 TAG_FLAG(budgeted_compaction_target_rowset_size, experimental);
 TAG_FLAG(budgeted_compaction_target_rowset_size, advanced);
 
+DEFINE_int32(tiered_compaction_target_rowset_size, 32*1024*1024,
+             "The target size for DiskRowSets during flush/compact when the "
+             "tiered compaction policy is used");
+TAG_FLAG(tiered_compaction_target_rowset_size, experimental);
+TAG_FLAG(tiered_compaction_target_rowset_size, advanced);
+
 namespace kudu {
 namespace tablet {
 
@@ -343,5 +356,235 @@ Status BudgetedCompactionPolicy::PickRowSets(const RowSetTree &tree,
   return Status::OK();
 }
 
+////////////////////////////////////////////////////////////
+// TieredCompactionPolicy
+////////////////////////////////////////////////////////////
+
+namespace {
+
+// Rowsets spanning a negligible part of the tablet would otherwise have an
+// unbounded layer size.
+const double kMinLayerWidth = 1e-6;
+
+double LayerSizeMb(const RowSetInfo& rs) {
+  return rs.size_mb() / std::max(rs.width(), kMinLayerWidth);
+}
+
+bool LessCDFMin(const RowSetInfo* a, const RowSetInfo* b) {
+  return a->cdf_min_key() < b->cdf_min_key();
+}
+
+bool LessSize(const RowSetInfo* a, const RowSetInfo* b) {
+  return a->size_mb() < b->size_mb();
+}
+
+// Returns how much compacting 'rowsets' together lowers the average height of
+// the tablet: their total width minus the width of their union. This is the
+// measure the budgeted policy maximizes too, which keeps the qualities of
+// tablets using either policy comparable for the maintenance manager.
+double HeightReduction(vector<const RowSetInfo*> rowsets) {
+  std::sort(rowsets.begin(), rowsets.end(), LessCDFMin);
+  double total_width = 0;
+  double union_width = 0;
+  double run_min = 0;
+  double run_max = 0;
+  bool in_run = false;
+  for (const RowSetInfo* rs : rowsets) {
+    total_width += rs->width();
+    if (in_run && rs->cdf_min_key() <= run_max) {
+      run_max = std::max(run_max, rs->cdf_max_key());
+      continue;
+    }
+    if (in_run) {
+      union_width += run_max - run_min;
+    }
+    run_min = rs->cdf_min_key();
+    run_max = rs->cdf_max_key();
+    in_run = true;
+  }
+  if (in_run) {
+    union_width += run_max - run_min;
+  }
+  return total_width - union_width;
+}
+
+// Keeps the longest prefix of 'rowsets' whose total size fits in 'budget_mb'.
+void TrimToBudget(int budget_mb, vector<const RowSetInfo*>* rowsets) {
+  int total_mb = 0;
+  size_t n = 0;
+  for (; n < rowsets->size(); n++) {
+    total_mb += (*rowsets)[n]->size_mb();
+    if (total_mb > budget_mb) {
+      break;
+    }
+  }
+  rowsets->resize(n);
+}
+
+} // anonymous namespace
+
+TieredCompactionPolicy::TieredCompactionPolicy(int size_budget_mb,
+                                               int size_ratio,
+                                               int min_merge_width,
+                                               int max_overlap_depth)
+  : size_budget_mb_(size_budget_mb),
+    size_ratio_(size_ratio),
+    min_merge_width_(min_merge_width),
+    max_overlap_depth_(max_overlap_depth) {
+  CHECK_GT(size_budget_mb, 0);
+  CHECK_GE(size_ratio, 2);
+  CHECK_GE(min_merge_width, 2);
+  CHECK_GE(max_overlap_depth, 2);
+}
+
+uint64_t TieredCompactionPolicy::target_rowset_size() const {
+  CHECK_GT(FLAGS_tiered_compaction_target_rowset_size, 0);
+  return FLAGS_tiered_compaction_target_rowset_size;
+}
+
+int TieredCompactionPolicy::TierOf(const RowSetInfo& rs) const {
+  double layer_mb = std::max(LayerSizeMb(rs), 1.0);
+  return static_cast<int>(std::log(layer_mb) / std::log(size_ratio_));
+}
+
+int TieredCompactionPolicy::MaxOverlapDepth(const vector<RowSetInfo>& rowsets,
+                                            vector<const RowSetInfo*>* deepest) {
+  // Sweep the endpoints in key order. Key ranges are inclusive, so at equal
+  // positions starts (0) sort before stops (1).
+  vector<pair<double, int>> endpoints;
+  endpoints.reserve(rowsets.size() * 2);
+  for (const RowSetInfo& rs : rowsets) {
+    endpoints.emplace_back(rs.cdf_min_key(), 0);
+    endpoints.emplace_back(rs.cdf_max_key(), 1);
+  }
+  std::sort(endpoints.begin(), endpoints.end());
+
+  int depth = 0;
+  int max_depth = 0;
+  double deepest_pos = 0;
+  for (const pair<double, int>& e : endpoints) {
+    if (e.second == 0) {
+      depth++;
+      if (depth > max_depth) {
+        max_depth = depth;
+        deepest_pos = e.first;
+      }
+    } else {
+      depth--;
+    }
+  }
+
+  if (deepest) {
+    deepest->clear();
+    for (const RowSetInfo& rs : rowsets) {
+      if (rs.cdf_min_key() > deepest_pos) {
+        break;
+      }
+      if (rs.cdf_max_key() >= deepest_pos) {
+        deepest->push_back(&rs);
+      }
+    }
+  }
+  return max_depth;
+}
+
+Status TieredCompactionPolicy::PickRowSets(const RowSetTree &tree,
+                                           unordered_set<RowSet*>* picked,
+                                           double* quality,
+                                           std::vector<std::string>* log) {
+  vector<RowSetInfo> asc_min_key, asc_max_key;
+  RowSetInfo::CollectOrdered(tree, &asc_min_key, &asc_max_key);
+  if (asc_min_key.size() < 2) {
+    if (log) {
+      LOG_STRING(INFO, log) << "No rowsets to compact";
+    }
+    return Status::OK();
+  }
+
+  vector<const RowSetInfo*> best;
+  double best_quality = 0;
+  string reason;
+
+  // First, flatten the deepest stack of rowsets if it's too deep. The
+  // smallest rowsets go first: they're the cheapest to rewrite.
+  vector<const RowSetInfo*> deepest;
+  int max_depth = MaxOverlapDepth(asc_min_key, &deepest);
+  if (max_depth > max_overlap_depth_) {
+    std::sort(deepest.begin(), deepest.end(), LessSize);
+    TrimToBudget(size_budget_mb_, &deepest);
+    if (deepest.size() >= 2) {
+      best_quality = HeightReduction(deepest);
+      best.swap(deepest);
+      reason = Substitute("overlap depth $0 exceeds $1", max_depth, max_overlap_depth_);
+    }
+  }
+
+  // Otherwise, merge the best group of overlapping rowsets within one tier.
+  if (best.empty()) {
+    map<int, vector<const RowSetInfo*>> by_tier;
+    for (const RowSetInfo& rs : asc_min_key) {
+      by_tier[TierOf(rs)].push_back(&rs);
+    }
+    for (const auto& tier : by_tier) {
+      // Split the tier into groups of transitively overlapping rowsets.
+      // The rowsets are already in ascending min key order.
+      const vector<const RowSetInfo*>& members = tier.second;
+      size_t group_start = 0;
+      double group_max = 0;
+      for (size_t i = 0; i <= members.size(); i++) {
+        if (i < members.size() &&
+            (i == group_start || members[i]->cdf_min_key() <= group_max)) {
+          group_max = i == group_start ? members[i]->cdf_max_key() :
+              std::max(group_max, members[i]->cdf_max_key());
+          continue;
+        }
+        vector<const RowSetInfo*> group(members.begin() + group_start, members.begin() + i);
+        TrimToBudget(size_budget_mb_, &group);
+        if (static_cast<int>(group.size()) >= min_merge_width_) {
+          double group_quality = HeightReduction(group);
+          if (group_quality > best_quality) {
+            best_quality = group_quality;
+            best.swap(group);
+            reason = Substitute("merging $0 rowsets of tier $1", best.size(), tier.first);
+          }
+        }
+        group_start = i;
+        if (i < members.size()) {
+          group_max = members[i]->cdf_max_key();
+        }
+      }
+    }
+  }
+
+  unordered_set<RowSet*> chosen;
+  for (const RowSetInfo* rs : best) {
+    chosen.insert(rs->rowset());
+  }
+
+  // Log the input and output of the selection.
+  if (VLOG_IS_ON(1) || log != nullptr) {
+    LOG_STRING(INFO, log) << "Tiered compaction selection:";
+    for (const RowSetInfo& cand : asc_min_key) {
+      const char *checkbox = ContainsKey(chosen, cand.rowset()) ? "[x]" : "[ ]";
+      LOG_STRING(INFO, log) << "  " << checkbox << " tier " << TierOf(cand)
+                            << " " << cand.ToString();
+    }
+    LOG_STRING(INFO, log) << "Max overlap depth: " << max_depth
+                          << " (limit " << max_overlap_depth_ << ")";
+    LOG_STRING(INFO, log) << "Reason: " << (reason.empty() ? "nothing to do" : reason);
+    LOG_STRING(INFO, log) << "Solution value: " << best_quality;
+  }
+
+  *quality = best_quality;
+  if (chosen.empty()) {
+    return Status::OK();
+  }
+
+  picked->swap(chosen);
+  DumpCompactionSVG(asc_min_key, *picked);
+
+  return Status::OK();
+}
+
 } // namespace tablet
 } // namespace kudu
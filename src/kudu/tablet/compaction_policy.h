@@ -65,6 +65,9 @@ class CompactionPolicy {
     return 1024 * 1024 * 1024; // no rolling
   }
 
+  // A short name for the policy, shown on the tablet's rowset layout page.
+  virtual std::string name() const = 0;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(CompactionPolicy);
 };
@@ -85,6 +88,8 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
 
   virtual uint64_t target_rowset_size() const OVERRIDE;
 
+  virtual std::string name() const OVERRIDE { return "budgeted"; }
+
  private:
   void SetupKnapsackInput(const RowSetTree &tree,
                           std::vector<RowSetInfo>* min_key,
@@ -93,6 +98,55 @@ class BudgetedCompactionPolicy : public CompactionPolicy {
   size_t size_budget_mb_;
 };
 
+// Size-tiered compaction policy which trades read amplification for bounded
+// write amplification.
+//
+// Each rowset is assigned a tier by its "layer size": its on-disk size divided
+// by the fraction of the tablet's data its key range spans. The rowsets
+// written by one flush or compaction form a layer and share a tier, no matter
+// how they were rolled. The policy only merges overlapping rowsets within a
+// tier, and only once at least 'min_merge_width' of them have accumulated, so
+// every rewrite multiplies the layer size of the rows involved by at least
+// that much. A row is therefore rewritten at most
+// log_{min_merge_width}(tablet size / flush size) times.
+//
+// Independently of the tiers, if more than 'max_overlap_depth' rowsets
+// overlap at any key, the rowsets stacked at the deepest point are compacted
+// first, which bounds the number of rowsets a point lookup has to consult.
+//
+// Every compaction also stays within 'size_budget_mb'.
+class TieredCompactionPolicy : public CompactionPolicy {
+ public:
+  TieredCompactionPolicy(int size_budget_mb,
+                         int size_ratio,
+                         int min_merge_width,
+                         int max_overlap_depth);
+
+  virtual Status PickRowSets(const RowSetTree &tree,
+                             std::unordered_set<RowSet*>* picked,
+                             double* quality,
+                             std::vector<std::string>* log) OVERRIDE;
+
+  virtual uint64_t target_rowset_size() const OVERRIDE;
+
+  virtual std::string name() const OVERRIDE { return "tiered"; }
+
+  // Returns the deepest overlap among 'rowsets', which must be sorted by
+  // ascending minimum key. If 'deepest' is not NULL, it is set to the
+  // rowsets which overlap at a point of that depth.
+  static int MaxOverlapDepth(const std::vector<RowSetInfo>& rowsets,
+                             std::vector<const RowSetInfo*>* deepest);
+
+ private:
+  // Returns the tier of 'rs', from its layer size.
+  int TierOf(const RowSetInfo& rs) const;
+
+  const int size_budget_mb_;
+  const int size_ratio_;
+  const int min_merge_width_;
+  const int max_overlap_depth_;
+};
+
 } // namespace tablet
 } // namespace kudu
 #endif
@@ -42,11 +42,13 @@
 #include <boost/smart_ptr/detail/yield_k.hpp>
 #include <boost/utility/binary.hpp>
 #include <memory>
+#include <nmmintrin.h>
 #include <string>
 
 #include "kudu/util/inline_slice.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/status.h"
+#include "kudu/gutil/endian.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/gutil/stringprintf.h"
@@ -78,14 +80,20 @@ struct BTreeTraits {
     // Tests can set this trait to a non-zero value, which inserts
     // some pause-loops in key parts of the code to try to simulate
     // races.
-    debug_raciness = 0
+    debug_raciness = 0,
+
+    // If non-zero, each node also stores a normalized 8-byte prefix of
+    // each of its keys, and searches compare those prefixes (with SIMD)
+    // before falling back to full key comparisons. This costs 8 bytes per
+    // entry, so node sizes should be raised to keep the same fanout.
+    use_key_prefixes = 0
   };
   typedef ThreadSafeArena ArenaType;
 };
 
 template<class T>
 inline void PrefetchMemory(const T *addr) {
-  int size = std::min<int>(sizeof(T), 4 * CACHELINE_SIZE);
+  int size = std::min<int>(sizeof(T), 8 * CACHELINE_SIZE);
 
   for (int i = 0; i < size; i += CACHELINE_SIZE) {
     prefetch(reinterpret_cast<const char *>(addr) + i, PREFETCH_HINT_T0);
@@ -335,6 +343,134 @@ size_t FindInSliceArray(const InlineSlice<N, true> *array, ssize_t num_entries,
   return left;
 }
 
+// Return the first 8 bytes of 'key' as an integer, zero-padded if the key is
+// shorter. If the prefix of one key is strictly less than the prefix of
+// another, then the first key also sorts strictly before the second one.
+// Keys with equal prefixes must be compared in full.
+inline uint64_t EncodeKeyPrefix(const Slice &key) {
+  uint64_t prefix = 0;
+  memcpy(&prefix, key.data(), std::min<size_t>(key.size(), sizeof(prefix)));
+  return BigEndian::ToHost64(prefix);
+}
+
+// Count the entries of the sorted array 'prefixes' which are strictly less
+// than 'key_prefix' and strictly greater than it, two entries at a time.
+inline void CountKeyPrefixes(const uint64_t *prefixes, size_t num_entries,
+                             uint64_t key_prefix,
+                             size_t *num_less, size_t *num_greater) {
+  // SSE4.2 only provides a signed 64-bit comparison, so flip the sign bits
+  // of both sides to compare them as unsigned.
+  const uint64_t kSignBit = 1ULL << 63;
+  const __m128i sign = _mm_set1_epi64x(static_cast<int64_t>(kSignBit));
+  const __m128i search = _mm_set1_epi64x(static_cast<int64_t>(key_prefix ^ kSignBit));
+  // Lanes of the comparison results are all ones (i.e -1) where the
+  // comparison holds, so subtracting them counts matches.
+  __m128i less = _mm_setzero_si128();
+  __m128i greater = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 2 <= num_entries; i += 2) {
+    __m128i vals = _mm_xor_si128(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(&prefixes[i])), sign);
+    less = _mm_sub_epi64(less, _mm_cmpgt_epi64(search, vals));
+    greater = _mm_sub_epi64(greater, _mm_cmpgt_epi64(vals, search));
+  }
+  *num_less = _mm_cvtsi128_si64(less) + _mm_extract_epi64(less, 1);
+  *num_greater = _mm_cvtsi128_si64(greater) + _mm_extract_epi64(greater, 1);
+  for (; i < num_entries; i++) {
+    *num_less += prefixes[i] < key_prefix;
+    *num_greater += prefixes[i] > key_prefix;
+  }
+}
+
+// Same as FindInSliceArray(), but uses the key prefixes stored in
+// 'prefixes' to narrow the search down to the entries sharing the prefix of
+// 'key', and only compares those in full.
+template<size_t N>
+size_t FindInSliceArrayWithPrefixes(const InlineSlice<N, true> *array,
+                                    const uint64_t *prefixes,
+                                    ssize_t num_entries,
+                                    const Slice &key, bool *exact) {
+  DCHECK_GE(num_entries, 0);
+
+  size_t num_less, num_greater;
+  CountKeyPrefixes(prefixes, num_entries, EncodeKeyPrefix(key),
+                   &num_less, &num_greater);
+
+  // Binary search the entries in [left, right), which have the same prefix
+  // as the search key. If the node is being concurrently modified, the
+  // result may be bogus, but stays within bounds.
+  size_t left = num_less;
+  size_t right = num_entries - num_greater;
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    int compare = array[mid].as_slice().compare(key);
+    if (compare < 0) { // mid < key
+      left = mid + 1;
+    } else if (compare > 0) { // mid > key
+      right = mid;
+    } else { // mid == key
+      *exact = true;
+      return mid;
+    }
+  }
+  *exact = false;
+  return left;
+}
+
+// The key prefixes of a node, used when Traits::use_key_prefixes is set.
+// Nodes inherit from this class so that the disabled specialization below
+// takes no space.
+template<size_t N, bool ENABLED>
+class NodeKeyPrefixes {
+ public:
+  enum { kBytesPerEntry = sizeof(uint64_t) };
+
+ protected:
+  template<class ISlice>
+  size_t FindWithPrefixes(const ISlice *keys, ssize_t num_entries,
+                          const Slice &key, bool *exact) const {
+    return FindInSliceArrayWithPrefixes(keys, prefixes_, num_entries, key, exact);
+  }
+
+  void SetPrefix(size_t idx, const Slice &key) {
+    prefixes_[idx] = EncodeKeyPrefix(key);
+  }
+
+  // Mirrors InsertInSliceArray().
+  void InsertPrefix(size_t num_entries, const Slice &key, size_t idx) {
+    DCHECK_LT(idx, num_entries);
+    for (size_t i = num_entries - 1; i > idx; i--) {
+      prefixes_[i] = prefixes_[i - 1];
+    }
+    prefixes_[idx] = EncodeKeyPrefix(key);
+  }
+
+  // Copy the prefixes of entries [start, end) of 'other' to the beginning
+  // of this node.
+  void CopyPrefixes(const NodeKeyPrefixes &other, size_t start, size_t end) {
+    std::copy(other.prefixes_ + start, other.prefixes_ + end, prefixes_);
+  }
+
+ private:
+  uint64_t prefixes_[N];
+} PACKED;
+
+template<size_t N>
+class NodeKeyPrefixes<N, false> {
+ public:
+  enum { kBytesPerEntry = 0 };
+
+ protected:
+  template<class ISlice>
+  size_t FindWithPrefixes(const ISlice *keys, ssize_t num_entries,
+                          const Slice &key, bool *exact) const {
+    return FindInSliceArray(keys, num_entries, key, exact);
+  }
+
+  void SetPrefix(size_t idx, const Slice &key) {}
+  void InsertPrefix(size_t num_entries, const Slice &key, size_t idx) {}
+  void CopyPrefixes(const NodeKeyPrefixes &other, size_t start, size_t end) {}
+};
 
 template<class ISlice, class ArenaType>
 static void InsertInSliceArray(ISlice *array, size_t num_entries,
@@ -497,8 +633,43 @@ enum InsertStatus {
 // Internal node
 ////////////////////////////////////////////////////////////
 
+// The key prefixes type used by nodes of trees with the given traits.
+template<class Traits, size_t N>
+struct NodeKeyPrefixesFor {
+  typedef NodeKeyPrefixes<N, Traits::use_key_prefixes != 0> type;
+};
+
+// Space accounting for the node types. These are computed outside of the
+// node classes since the fanout also parameterizes their key prefixes.
+template<class Traits>
+struct InternalNodeSpace {
+  enum {
+    constant_overhead = sizeof(NodeBase<Traits>) // base class
+                      + sizeof(uint32_t), // num_children_
+    keyptr_space = Traits::internal_node_size - constant_overhead,
+    kFanout = keyptr_space / (sizeof(InlineSlice<sizeof(void*), true>) // key
+                              + sizeof(NodePtr<Traits>) // child pointer
+                              + NodeKeyPrefixesFor<Traits, 1>::type::kBytesPerEntry)
+  };
+};
+
+template<class Traits>
+struct LeafNodeSpace {
+  enum {
+    constant_overhead = sizeof(NodeBase<Traits>) // base class
+                      + sizeof(LeafNode<Traits>*) // next_
+                      + sizeof(uint8_t), // num_entries_
+    kv_space = Traits::leaf_node_size - constant_overhead,
+    kMaxEntries = kv_space / (sizeof(InlineSlice<sizeof(void*), true>) // key
+                              + sizeof(ValueSlice) // value
+                              + NodeKeyPrefixesFor<Traits, 1>::type::kBytesPerEntry)
+  };
+};
+
 template<class Traits>
-class PACKED InternalNode : public NodeBase<Traits> {
+class PACKED InternalNode
+  : public NodeBase<Traits>,
+    public NodeKeyPrefixesFor<Traits, InternalNodeSpace<Traits>::kFanout>::type {
   public:
 
   // Construct a new internal node, containing the given children.
@@ -521,6 +692,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
     VersionField::SetLockedInsertingNoBarrier(&this->version_);
 
     keys_[0].set(split_key, arena);
+    this->SetPrefix(0, split_key);
     DCHECK_GT(split_key.size(), 0);
     child_pointers_[0] = lchild;
     child_pointers_[1] = rchild;
@@ -556,6 +728,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
     // Insert the key and child pointer in the right spot in the list
     int new_num_children = num_children_ + 1;
     InsertInSliceArray(keys_, new_num_children, key, idx, arena);
+    this->InsertPrefix(new_num_children, key, idx);
     for (int i = new_num_children - 1; i > idx + 1; i--) {
       child_pointers_[i] = child_pointers_[i - 1];
     }
@@ -573,7 +746,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
   // For example, if the key is less than the first discriminating
   // node, returns 0. If it is between 0 and 1, returns 1, etc.
   size_t Find(const Slice &key, bool *exact) {
-    return FindInSliceArray(keys_, key_count(), key, exact);
+    return this->FindWithPrefixes(keys_, key_count(), key, exact);
   }
 
   // Find the child whose subtree may contain the given key.
@@ -647,10 +820,7 @@ class PACKED InternalNode : public NodeBase<Traits> {
   typedef InlineSlice<sizeof(void*), true> KeyInlineSlice;
 
   enum SpaceConstants {
-    constant_overhead = sizeof(NodeBase<Traits>) // base class
-                      + sizeof(uint32_t), // num_children_
-    keyptr_space = Traits::internal_node_size - constant_overhead,
-    kFanout = keyptr_space / (sizeof(KeyInlineSlice) + sizeof(NodePtr<Traits>))
+    kFanout = InternalNodeSpace<Traits>::kFanout
   };
 
   // This ordering of members ensures KeyInlineSlices are properly aligned
@@ -665,7 +835,9 @@ class PACKED InternalNode : public NodeBase<Traits> {
 ////////////////////////////////////////////////////////////
 
 template<class Traits>
-class LeafNode : public NodeBase<Traits> {
+class LeafNode
+  : public NodeBase<Traits>,
+    public NodeKeyPrefixesFor<Traits, LeafNodeSpace<Traits>::kMaxEntries>::type {
  public:
   // Construct a new leaf node.
   // If initially_locked is true, then the new node is created
@@ -717,6 +889,7 @@ class LeafNode : public NodeBase<Traits> {
     // verified that there is space available above.
     num_entries_++;
     InsertInSliceArray(keys_, num_entries_, key, idx, arena);
+    this->InsertPrefix(num_entries_, key, idx);
     DebugRacyPoint<Traits>();
     InsertInSliceArray(vals_, num_entries_, val, idx, arena);
 
@@ -732,7 +905,7 @@ class LeafNode : public NodeBase<Traits> {
   // Note that, if the lock is not held, this may return
   // bogus results, in which case OCC must be used to verify.
   size_t Find(const Slice &key, bool *exact) const {
-    return FindInSliceArray(keys_, num_entries_, key, exact);
+    return this->FindWithPrefixes(keys_, num_entries_, key, exact);
   }
 
   // Get the slice corresponding to the nth key.
@@ -799,11 +972,7 @@ class LeafNode : public NodeBase<Traits> {
   // constants (the macros may attempt to specialize templates
   // with the constants, which require a named type).
   enum SpaceConstants {
-    constant_overhead = sizeof(NodeBase<Traits>) // base class
-                        + sizeof(LeafNode<Traits>*) // next_
-                        + sizeof(uint8_t), // num_entries_
-    kv_space = Traits::leaf_node_size - constant_overhead,
-    kMaxEntries = kv_space / (sizeof(KeyInlineSlice) + sizeof(ValueSlice))
+    kMaxEntries = LeafNodeSpace<Traits>::kMaxEntries
   };
 
   // This ordering of members keeps KeyInlineSlices so pointers are aligned
@@ -1435,6 +1604,7 @@ class CBTree {
 
     std::copy(node->keys_ + copy_start, node->keys_ + node->num_entries(),
               new_leaf->keys_);
+    new_leaf->CopyPrefixes(*node, copy_start, node->num_entries());
     std::copy(node->vals_ + copy_start, node->vals_ + node->num_entries(),
               new_leaf->vals_);
     new_leaf->num_entries_ = node->num_entries() - copy_start;
@@ -23,6 +23,7 @@
 #include "kudu/common/iterator.h"
 #include "kudu/tablet/delta_store.h"
 #include "kudu/util/status.h"
+#include "kudu/util/trace.h"
 
 using std::shared_ptr;
 using std::string;
@@ -31,6 +32,9 @@ using std::unique_ptr;
 namespace kudu {
 namespace tablet {
 
+const char* SCAN_DECODE_TIME_METRIC_NAME = "scan_decode_us";
+const char* SCAN_DELTA_APPLY_TIME_METRIC_NAME = "scan_delta_apply_us";
+
   // Construct. The base_iter and delta_iter should not be Initted.
 DeltaApplier::DeltaApplier(shared_ptr<CFileSet::Iterator> base_iter,
                            unique_ptr<DeltaIterator> delta_iter)
@@ -43,7 +47,9 @@ DeltaApplier::~DeltaApplier() {
 
 Status DeltaApplier::Init(ScanSpec *spec) {
   RETURN_NOT_OK(base_iter_->Init(spec));
-  RETURN_NOT_OK(delta_iter_->Init(spec));
+  if (delta_iter_) {
+    RETURN_NOT_OK(delta_iter_->Init(spec));
+  }
   return Status::OK();
 }
 
@@ -53,7 +59,7 @@ string DeltaApplier::ToString() const {
   s.append("DeltaApplier(");
   s.append(base_iter_->ToString());
   s.append(" + ");
-  s.append(delta_iter_->ToString());
+  s.append(delta_iter_ ? delta_iter_->ToString() : "no deltas");
   s.append(")");
   return s;
 }
@@ -75,11 +81,15 @@ Status DeltaApplier::PrepareBatch(size_t *nrows) {
   // because it requires a loaded delta file, and we don't want to require
   // that at Init() time.
   if (first_prepare_) {
-    RETURN_NOT_OK(delta_iter_->SeekToOrdinal(base_iter_->cur_ordinal_idx()));
+    if (delta_iter_) {
+      RETURN_NOT_OK(delta_iter_->SeekToOrdinal(base_iter_->cur_ordinal_idx()));
+    }
     first_prepare_ = false;
   }
   RETURN_NOT_OK(base_iter_->PrepareBatch(nrows));
-  RETURN_NOT_OK(delta_iter_->PrepareBatch(*nrows, DeltaIterator::PREPARE_FOR_APPLY));
+  if (delta_iter_) {
+    RETURN_NOT_OK(delta_iter_->PrepareBatch(*nrows, DeltaIterator::PREPARE_FOR_APPLY));
+  }
   return Status::OK();
 }
 
@@ -90,6 +100,10 @@ Status DeltaApplier::FinishBatch() {
 Status DeltaApplier::InitializeSelectionVector(SelectionVector *sel_vec) {
   DCHECK(!first_prepare_) << "PrepareBatch() must be called at least once";
   RETURN_NOT_OK(base_iter_->InitializeSelectionVector(sel_vec));
+  if (!delta_iter_) {
+    return Status::OK();
+  }
+  TRACE_COUNTER_SCOPE_LATENCY_US(SCAN_DELTA_APPLY_TIME_METRIC_NAME);
   return delta_iter_->ApplyDeletes(sel_vec);
 }
 
@@ -97,10 +111,45 @@ Status DeltaApplier::MaterializeColumn(size_t col_idx, ColumnBlock *dst) {
   DCHECK(!first_prepare_) << "PrepareBatch() must be called at least once";
 
   // Copy the base data.
-  RETURN_NOT_OK(base_iter_->MaterializeColumn(col_idx, dst));
+  {
+    TRACE_COUNTER_SCOPE_LATENCY_US(SCAN_DECODE_TIME_METRIC_NAME);
+    RETURN_NOT_OK(base_iter_->MaterializeColumn(col_idx, dst));
+  }
+  if (!delta_iter_) {
+    return Status::OK();
+  }
 
   // Apply all the updates for this column.
-  RETURN_NOT_OK(delta_iter_->ApplyUpdates(col_idx, dst));
+  TRACE_COUNTER_SCOPE_LATENCY_US(SCAN_DELTA_APPLY_TIME_METRIC_NAME);
+  RETURN_NOT_OK(delta_iter_->ApplyUpdates(col_idx, dst, nullptr));
+  return Status::OK();
+}
+
+Status DeltaApplier::MaterializeColumn(ColumnMaterializationContext *ctx) {
+  DCHECK(!first_prepare_) << "PrepareBatch() must be called at least once";
+
+  // An update may make a row match (or stop matching) the predicate, so the
+  // base data alone can only be filtered when the batch has none for this
+  // column.
+  bool has_updates = delta_iter_ && delta_iter_->MayHaveUpdatesForColumn(ctx->col_idx());
+  if (has_updates) {
+    ctx->SetDecoderEvalNotSupported();
+  }
+
+  // Copy the base data.
+  {
+    TRACE_COUNTER_SCOPE_LATENCY_US(SCAN_DECODE_TIME_METRIC_NAME);
+    RETURN_NOT_OK(base_iter_->MaterializeColumn(ctx));
+  }
+  if (!has_updates) {
+    return Status::OK();
+  }
+
+  // Apply the updates for this column. Rows which earlier predicates have
+  // already filtered out are left as they are if the caller allows it.
+  TRACE_COUNTER_SCOPE_LATENCY_US(SCAN_DELTA_APPLY_TIME_METRIC_NAME);
+  RETURN_NOT_OK(delta_iter_->ApplyUpdates(ctx->col_idx(), ctx->block(),
+                                          ctx->skip_unselected_rows() ? ctx->sel() : nullptr));
   return Status::OK();
 }
 
@@ -62,6 +62,10 @@ class DeltaApplier : public ColumnwiseIterator {
   virtual Status InitializeSelectionVector(SelectionVector *sel_vec) OVERRIDE;
 
   Status MaterializeColumn(size_t col_idx, ColumnBlock *dst) OVERRIDE;
+
+  // Predicates may only be evaluated by the base data iterator when there are
+  // no updates in the current batch which could change their outcome.
+  Status MaterializeColumn(ColumnMaterializationContext *ctx) OVERRIDE;
  private:
   friend class DeltaTracker;
 
@@ -70,6 +74,8 @@ class DeltaApplier : public ColumnwiseIterator {
   DISALLOW_COPY_AND_ASSIGN(DeltaApplier);
 
   // Construct. The base_iter and delta_iter should not be Initted.
+  // 'delta_iter' may be NULL if there are no deltas to apply, in which case
+  // the base data is returned as is.
   DeltaApplier(std::shared_ptr<CFileSet::Iterator> base_iter,
                std::unique_ptr<DeltaIterator> delta_iter);
   virtual ~DeltaApplier();
@@ -53,7 +53,8 @@ class MajorDeltaCompaction {
   // TODO: is base_schema supposed to be the same as base_data->schema()? how about
   // in an ALTER scenario?
   MajorDeltaCompaction(
-      FsManager* fs_manager, const Schema& base_schema, CFileSet* base_data,
+      FsManager* fs_manager, std::string tablet_id,
+      const Schema& base_schema, CFileSet* base_data,
       std::unique_ptr<DeltaIterator> delta_iter,
       std::vector<std::shared_ptr<DeltaStore> > included_stores,
       const std::vector<ColumnId>& col_ids);
@@ -93,6 +94,9 @@ class MajorDeltaCompaction {
 
   FsManager* const fs_manager_;
 
+  // The tablet whose data directories the new blocks are placed in.
+  const std::string tablet_id_;
+
   // TODO: doc me
   const Schema base_schema_;
 
@@ -58,9 +58,10 @@ Status DeltaIteratorMerger::PrepareBatch(size_t nrows, PrepareFlag flag) {
   return Status::OK();
 }
 
-Status DeltaIteratorMerger::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
+Status DeltaIteratorMerger::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst,
+                                         const SelectionVector* filter) {
   for (const unique_ptr<DeltaIterator> &iter : iters_) {
-    RETURN_NOT_OK(iter->ApplyUpdates(col_to_apply, dst));
+    RETURN_NOT_OK(iter->ApplyUpdates(col_to_apply, dst, filter));
   }
   return Status::OK();
 }
@@ -111,6 +112,26 @@ bool DeltaIteratorMerger::HasNext() {
   return false;
 }
 
+bool DeltaIteratorMerger::MayHaveDeltas() {
+  for (const unique_ptr<DeltaIterator>& iter : iters_) {
+    if (iter->MayHaveDeltas()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool DeltaIteratorMerger::MayHaveUpdatesForColumn(size_t col_idx) {
+  for (const unique_ptr<DeltaIterator>& iter : iters_) {
+    if (iter->MayHaveUpdatesForColumn(col_idx)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
 string DeltaIteratorMerger::ToString() const {
   string ret;
   ret.append("DeltaIteratorMerger(");
@@ -129,13 +150,11 @@ string DeltaIteratorMerger::ToString() const {
 }
 
 
-Status DeltaIteratorMerger::Create(
+Status DeltaIteratorMerger::CreateStoreIterators(
     const vector<shared_ptr<DeltaStore> > &stores,
     const Schema* projection,
     const MvccSnapshot &snapshot,
-    unique_ptr<DeltaIterator>* out) {
-  vector<unique_ptr<DeltaIterator> > delta_iters;
-
+    vector<unique_ptr<DeltaIterator> >* iters) {
   for (const shared_ptr<DeltaStore> &store : stores) {
     DeltaIterator* raw_iter;
     Status s = store->NewDeltaIterator(projection, snapshot, &raw_iter);
@@ -145,16 +164,45 @@ Status DeltaIteratorMerger::Create(
     RETURN_NOT_OK_PREPEND(s, Substitute("Could not create iterator for store $0",
                                         store->ToString()));
 
-    delta_iters.push_back(unique_ptr<DeltaIterator>(raw_iter));
+    iters->push_back(unique_ptr<DeltaIterator>(raw_iter));
   }
+  return Status::OK();
+}
 
-  if (delta_iters.size() == 1) {
+void DeltaIteratorMerger::WrapIterators(vector<unique_ptr<DeltaIterator> > iters,
+                                        unique_ptr<DeltaIterator>* out) {
+  if (iters.size() == 1) {
     // If we only have one input to the "merge", we can just directly
     // return that iterator.
-    *out = std::move(delta_iters[0]);
+    *out = std::move(iters[0]);
   } else {
-    out->reset(new DeltaIteratorMerger(std::move(delta_iters)));
+    out->reset(new DeltaIteratorMerger(std::move(iters)));
+  }
+}
+
+Status DeltaIteratorMerger::Create(
+    const vector<shared_ptr<DeltaStore> > &stores,
+    const Schema* projection,
+    const MvccSnapshot &snapshot,
+    unique_ptr<DeltaIterator>* out) {
+  vector<unique_ptr<DeltaIterator> > delta_iters;
+  RETURN_NOT_OK(CreateStoreIterators(stores, projection, snapshot, &delta_iters));
+  WrapIterators(std::move(delta_iters), out);
+  return Status::OK();
+}
+
+Status DeltaIteratorMerger::CreateIfAnyRelevant(
+    const vector<shared_ptr<DeltaStore> > &stores,
+    const Schema* projection,
+    const MvccSnapshot &snapshot,
+    unique_ptr<DeltaIterator>* out) {
+  vector<unique_ptr<DeltaIterator> > delta_iters;
+  RETURN_NOT_OK(CreateStoreIterators(stores, projection, snapshot, &delta_iters));
+  if (delta_iters.empty()) {
+    out->reset();
+    return Status::OK();
   }
+  WrapIterators(std::move(delta_iters), out);
   return Status::OK();
 }
 
@@ -44,24 +44,48 @@ class DeltaIteratorMerger : public DeltaIterator {
       const MvccSnapshot &snapshot,
       std::unique_ptr<DeltaIterator>* out);
 
+  // Like Create(), but sets '*out' to NULL if none of the stores may hold
+  // deltas relevant to 'snapshot', so that the caller can skip applying
+  // deltas altogether.
+  static Status CreateIfAnyRelevant(
+      const std::vector<std::shared_ptr<DeltaStore> > &stores,
+      const Schema* projection,
+      const MvccSnapshot &snapshot,
+      std::unique_ptr<DeltaIterator>* out);
+
   ////////////////////////////////////////////////////////////
   // Implementations of DeltaIterator
   ////////////////////////////////////////////////////////////
   virtual Status Init(ScanSpec *spec) OVERRIDE;
   virtual Status SeekToOrdinal(rowid_t idx) OVERRIDE;
   virtual Status PrepareBatch(size_t nrows, PrepareFlag flag) OVERRIDE;
-  virtual Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) OVERRIDE;
+  virtual Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst,
+                              const SelectionVector* filter) OVERRIDE;
   virtual Status ApplyDeletes(SelectionVector *sel_vec) OVERRIDE;
   virtual Status CollectMutations(vector<Mutation *> *dst, Arena *arena) OVERRIDE;
   virtual Status FilterColumnIdsAndCollectDeltas(const std::vector<ColumnId>& col_ids,
                                                  vector<DeltaKeyAndUpdate>* out,
                                                  Arena* arena) OVERRIDE;
   virtual bool HasNext() OVERRIDE;
+  virtual bool MayHaveDeltas() OVERRIDE;
+
+  virtual bool MayHaveUpdatesForColumn(size_t col_idx) OVERRIDE;
   virtual std::string ToString() const OVERRIDE;
 
  private:
   explicit DeltaIteratorMerger(vector<std::unique_ptr<DeltaIterator> > iters);
 
+  // Creates an iterator for each of 'stores' that may hold deltas relevant
+  // to 'snapshot', and appends them to 'iters'.
+  static Status CreateStoreIterators(
+      const std::vector<std::shared_ptr<DeltaStore> > &stores,
+      const Schema* projection,
+      const MvccSnapshot &snapshot,
+      std::vector<std::unique_ptr<DeltaIterator> >* iters);
+
+  static void WrapIterators(std::vector<std::unique_ptr<DeltaIterator> > iters,
+                            std::unique_ptr<DeltaIterator>* out);
+
   std::vector<std::unique_ptr<DeltaIterator> > iters_;
 };
 
@@ -119,6 +119,26 @@ void DeltaStats::AddColumnIdsWithUpdates(std::set<ColumnId>* col_ids) const {
   }
 }
 
+bool DeltaStats::MayAffectProjection(const Schema& projection) const {
+  if (delete_count_ > 0) {
+    return true;
+  }
+  for (int i = 0; i < projection.num_columns(); i++) {
+    if (update_count_for_col_id(projection.column_id(i)) > 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void DeltaStats::AddColumnUpdateCounts(std::map<ColumnId, int64_t>* counts) const {
+  typedef std::pair<ColumnId, int64_t> entry;
+  for (const entry& e : update_counts_by_col_id_) {
+    if (e.second > 0) {
+      (*counts)[e.first] += e.second;
+    }
+  }
+}
 
 } // namespace tablet
 } // namespace kudu
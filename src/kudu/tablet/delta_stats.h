@@ -20,6 +20,7 @@
 #include <glog/logging.h>
 #include <boost/function.hpp>
 
+#include <map>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -28,6 +29,7 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/common/row_changelist.h"
+#include "kudu/common/schema.h"
 #include "kudu/tablet/mvcc.h"
 
 namespace kudu {
@@ -92,6 +94,15 @@ class DeltaStats {
   // set 'col_ids'.
   void AddColumnIdsWithUpdates(std::set<ColumnId>* col_ids) const;
 
+  // Returns true if this store holds any DELETE, or an update to any of the
+  // columns of 'projection', i.e. if it may change the result of a scan
+  // with that projection.
+  bool MayAffectProjection(const Schema& projection) const;
+
+  // For each column which has at least one update, add that column's update
+  // count to its entry in 'counts'.
+  void AddColumnUpdateCounts(std::map<ColumnId, int64_t>* counts) const;
+
  private:
   std::unordered_map<ColumnId, int64_t> update_counts_by_col_id_;
   uint64_t delete_count_;
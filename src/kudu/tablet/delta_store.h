@@ -69,6 +69,10 @@ class DeltaStore {
   // Set *deleted to true if the latest update for the given row is a deletion.
   virtual Status CheckRowDeleted(rowid_t row_idx, bool *deleted) const = 0;
 
+  // Set *deleted_count to the number of DELETE mutations held in this store.
+  // This may require I/O if the store's stats have not yet been loaded.
+  virtual Status CountDeletedRows(int64_t* deleted_count) const = 0;
+
   // Get the store's estimated size in bytes.
   virtual uint64_t EstimateSize() const = 0;
 
@@ -97,10 +101,10 @@ typedef std::vector<std::shared_ptr<DeltaStore> > SharedDeltaStoreVector;
 //     clear row block
 //     CHECK_OK(iter->PrepareBatch(rowblock.size()));
 //     ... read column 0 from base data into row block ...
-//     CHECK_OK(iter->ApplyUpdates(0, rowblock.column(0))
+//     CHECK_OK(iter->ApplyUpdates(0, rowblock.column(0), nullptr))
 //     ... check predicates for column ...
 //     ... read another column from base data...
-//     CHECK_OK(iter->ApplyUpdates(1, rowblock.column(1)))
+//     CHECK_OK(iter->ApplyUpdates(1, rowblock.column(1), nullptr))
 //     ...
 //  }
 
@@ -140,8 +144,11 @@ class DeltaIterator {
 
   // Apply the snapshotted updates to one of the columns.
   // 'dst' must be the same length as was previously passed to PrepareBatch()
+  // If 'filter' is non-NULL, updates to rows which aren't selected in it may be
+  // skipped, leaving their cells in 'dst' untouched.
   // Must have called PrepareBatch() with flag = PREPARE_FOR_APPLY.
-  virtual Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) = 0;
+  virtual Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst,
+                              const SelectionVector* filter) = 0;
 
   // Apply any deletes to the given selection vector.
   // Rows which have been deleted in the associated MVCC snapshot are set to
@@ -173,6 +180,17 @@ class DeltaIterator {
   // Returns true if there are any more rows left in this iterator.
   virtual bool HasNext() = 0;
 
+  // Returns true if the currently prepared batch may contain updates.
+  // When this returns false, ApplyUpdates() is guaranteed to leave the
+  // column blocks it is passed unchanged. Implementations may conservatively
+  // return true. Must have called PrepareBatch() with flag = PREPARE_FOR_APPLY.
+  virtual bool MayHaveDeltas() = 0;
+
+  // Like MayHaveDeltas(), but only considers updates to the projection column
+  // 'col_idx'. When this returns false, ApplyUpdates() is guaranteed to leave
+  // that column unchanged.
+  virtual bool MayHaveUpdatesForColumn(size_t col_idx) = 0;
+
   // Return a string representation suitable for debug printouts.
   virtual std::string ToString() const = 0;
 
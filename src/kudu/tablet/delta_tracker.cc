@@ -31,10 +31,12 @@
 #include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/util/status.h"
+#include "kudu/util/trace.h"
 
 namespace kudu {
 namespace tablet {
 
+using fs::CreateBlockOptions;
 using fs::ReadableBlock;
 using fs::WritableBlock;
 using std::shared_ptr;
@@ -214,7 +216,10 @@ Status DeltaTracker::CompactStores(int start_idx, int end_idx) {
   // Open a writer for the new destination delta block
   FsManager* fs = rowset_metadata_->fs_manager();
   gscoped_ptr<WritableBlock> block;
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&block),
+  CreateBlockOptions opts;
+  opts.background_write = true;
+  opts.tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(opts, &block),
                         "Could not allocate delta block");
   BlockId new_block_id(block->id());
 
@@ -322,11 +327,42 @@ Status DeltaTracker::NewDeltaFileIterator(
   return DeltaIteratorMerger::Create(*included_stores, schema, snap, out);
 }
 
+void DeltaTracker::CollectStoresForScan(const Schema& projection,
+                                        SharedDeltaStoreVector* stores) const {
+  std::lock_guard<rw_spinlock> lock(component_lock_);
+  int culled = 0;
+  for (const SharedDeltaStoreVector* v : { &undo_delta_stores_, &redo_delta_stores_ }) {
+    for (const shared_ptr<DeltaStore>& ds : *v) {
+      // A file whose stats haven't been loaded yet may hold anything; we
+      // won't do I/O here just to find out.
+      if (ds->Initted() && !ds->delta_stats().MayAffectProjection(projection)) {
+        culled++;
+        continue;
+      }
+      stores->push_back(ds);
+    }
+  }
+  // The DMS doesn't keep stats, but a scan can safely skip it when it's
+  // empty: the scan's snapshot was taken before this call, so any update it
+  // includes has already been applied to the DMS.
+  if (!dms_->Empty()) {
+    stores->push_back(dms_);
+  }
+  if (culled > 0) {
+    TRACE_COUNTER_INCREMENT("delta_iterators_culled_for_projection", culled);
+  }
+}
+
 Status DeltaTracker::WrapIterator(const shared_ptr<CFileSet::Iterator> &base,
                                   const MvccSnapshot &mvcc_snap,
                                   gscoped_ptr<ColumnwiseIterator>* out) const {
+  SharedDeltaStoreVector stores;
+  CollectStoresForScan(base->schema(), &stores);
+
+  // If no store has deltas relevant to the scan, the base data is read as is.
   unique_ptr<DeltaIterator> iter;
-  RETURN_NOT_OK(NewDeltaIterator(&base->schema(), mvcc_snap, &iter));
+  RETURN_NOT_OK(DeltaIteratorMerger::CreateIfAnyRelevant(stores, &base->schema(),
+                                                         mvcc_snap, &iter));
 
   out->reset(new DeltaApplier(base, std::move(iter)));
   return Status::OK();
@@ -378,13 +414,32 @@ Status DeltaTracker::CheckRowDeleted(rowid_t row_idx, bool *deleted,
   return Status::OK();
 }
 
+Status DeltaTracker::CountDeletedRows(int64_t* deleted_count) const {
+  // Copy the store list so that any I/O needed to load delta file stats
+  // happens outside of component_lock_.
+  SharedDeltaStoreVector stores;
+  CollectStores(&stores, REDOS_ONLY);
+
+  int64_t total = 0;
+  for (const shared_ptr<DeltaStore>& ds : stores) {
+    int64_t store_count;
+    RETURN_NOT_OK(ds->CountDeletedRows(&store_count));
+    total += store_count;
+  }
+  *deleted_count = total;
+  return Status::OK();
+}
+
 Status DeltaTracker::FlushDMS(DeltaMemStore* dms,
                               shared_ptr<DeltaFileReader>* dfr,
                               MetadataFlushType flush_type) {
   // Open file for write.
   FsManager* fs = rowset_metadata_->fs_manager();
   gscoped_ptr<WritableBlock> writable_block;
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&writable_block),
+  CreateBlockOptions opts;
+  opts.background_write = true;
+  opts.tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(opts, &writable_block),
                         "Unable to allocate new delta data writable_block");
   BlockId block_id(writable_block->id());
 
@@ -499,6 +554,73 @@ uint64_t DeltaTracker::EstimateOnDiskSize() const {
   return size;
 }
 
+int64_t DeltaTracker::EstimateBytesInPotentiallyAncientUndoDeltas(
+    Timestamp ancient_history_mark) const {
+  SharedDeltaStoreVector undos;
+  {
+    shared_lock<rw_spinlock> lock(component_lock_);
+    undos = undo_delta_stores_;
+  }
+  int64_t bytes = 0;
+  for (const shared_ptr<DeltaStore>& ds : undos) {
+    if (!ds->Initted() ||
+        ds->delta_stats().max_timestamp().CompareTo(ancient_history_mark) < 0) {
+      bytes += ds->EstimateSize();
+    }
+  }
+  return bytes;
+}
+
+Status DeltaTracker::DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                             int64_t* blocks_deleted,
+                                             int64_t* bytes_deleted) {
+  // Don't race with a merge or delta compaction that may be reading the UNDOs.
+  std::lock_guard<Mutex> l(compact_flush_lock_);
+  CHECK(open_);
+
+  SharedDeltaStoreVector undos;
+  {
+    shared_lock<rw_spinlock> lock(component_lock_);
+    undos = undo_delta_stores_;
+  }
+
+  SharedDeltaStoreVector to_remove;
+  vector<BlockId> blocks_to_remove;
+  int64_t bytes = 0;
+  for (const shared_ptr<DeltaStore>& ds : undos) {
+    RETURN_NOT_OK(ds->Init());
+    if (ds->delta_stats().max_timestamp().CompareTo(ancient_history_mark) >= 0) {
+      continue;
+    }
+    // In DEBUG mode, the following asserts that the object is of the right type
+    // (using RTTI)
+    ignore_result(down_cast<DeltaFileReader*>(ds.get()));
+    shared_ptr<DeltaFileReader> dfr = std::static_pointer_cast<DeltaFileReader>(ds);
+    to_remove.push_back(ds);
+    blocks_to_remove.push_back(dfr->block_id());
+    bytes += ds->EstimateSize();
+  }
+
+  if (!to_remove.empty()) {
+    {
+      std::lock_guard<rw_spinlock> lock(component_lock_);
+      for (const shared_ptr<DeltaStore>& ds : to_remove) {
+        auto it = std::find(undo_delta_stores_.begin(), undo_delta_stores_.end(), ds);
+        DCHECK(it != undo_delta_stores_.end());
+        undo_delta_stores_.erase(it);
+      }
+    }
+    RowSetMetadataUpdate update;
+    update.RemoveUndoDeltaBlocks(blocks_to_remove);
+    RETURN_NOT_OK(rowset_metadata_->CommitUpdate(update));
+    VLOG(1) << "Removed ancient UNDO delta blocks: " << BlockId::JoinStrings(blocks_to_remove);
+  }
+
+  *blocks_deleted = to_remove.size();
+  *bytes_deleted = bytes;
+  return Status::OK();
+}
+
 void DeltaTracker::GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const {
   shared_lock<rw_spinlock> lock(component_lock_);
 
@@ -514,5 +636,48 @@ void DeltaTracker::GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const
   col_ids->assign(column_ids_with_updates.begin(), column_ids_with_updates.end());
 }
 
+bool DeltaTracker::MayHaveUpdatesToColumn(ColumnId col_id) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+
+  // The DMS doesn't keep statistics.
+  if (!dms_->Empty()) {
+    return true;
+  }
+  for (const SharedDeltaStoreVector* stores : { &redo_delta_stores_, &undo_delta_stores_ }) {
+    for (const shared_ptr<DeltaStore>& ds : *stores) {
+      if (!ds->Initted() || ds->delta_stats().update_count_for_col_id(col_id) > 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+void DeltaTracker::GetColumnUpdateCounts(std::map<ColumnId, int64_t>* counts) const {
+  shared_lock<rw_spinlock> lock(component_lock_);
+
+  counts->clear();
+  for (const shared_ptr<DeltaStore>& ds : redo_delta_stores_) {
+    if (!ds->Initted()) {
+      continue;
+    }
+    ds->delta_stats().AddColumnUpdateCounts(counts);
+  }
+}
+
+Status DeltaTracker::CountRedoUpdatesForColumn(ColumnId col_id, int64_t* count) const {
+  SharedDeltaStoreVector redos;
+  {
+    shared_lock<rw_spinlock> lock(component_lock_);
+    redos = redo_delta_stores_;
+  }
+  *count = 0;
+  for (const shared_ptr<DeltaStore>& ds : redos) {
+    RETURN_NOT_OK(ds->Init());
+    *count += ds->delta_stats().update_count_for_col_id(col_id);
+  }
+  return Status::OK();
+}
+
 } // namespace tablet
 } // namespace kudu
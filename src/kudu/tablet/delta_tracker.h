@@ -18,6 +18,7 @@
 #define KUDU_TABLET_DELTATRACKER_H
 
 #include <gtest/gtest_prod.h>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -72,6 +73,9 @@ class DeltaTracker {
                rowid_t num_rows, log::LogAnchorRegistry* log_anchor_registry,
                std::shared_ptr<MemTracker> parent_tracker);
 
+  // Wraps 'base' in an iterator which applies the deltas relevant to
+  // 'mvcc_snap' and to the base iterator's projection. If there are none,
+  // the returned iterator passes the base data through untouched.
   Status WrapIterator(const std::shared_ptr<CFileSet::Iterator> &base,
                       const MvccSnapshot &mvcc_snap,
                       gscoped_ptr<ColumnwiseIterator>* out) const;
@@ -140,6 +144,11 @@ class DeltaTracker {
   // Sets *deleted to true if so; otherwise sets it to false.
   Status CheckRowDeleted(rowid_t row_idx, bool *deleted, ProbeStats* stats) const;
 
+  // Sets *deleted_count to the number of rows deleted by the REDO delta
+  // stores, including the DeltaMemStore. Since a row may only be deleted once
+  // from a given rowset, this is exact.
+  Status CountDeletedRows(int64_t* deleted_count) const;
+
   // Compacts all deltafiles
   //
   // TODO keep metadata in the delta stores to indicate whether or not
@@ -181,9 +190,42 @@ class DeltaTracker {
 
   uint64_t EstimateOnDiskSize() const;
 
+  // Returns the size of the UNDO delta stores that may hold only history older
+  // than 'ancient_history_mark'. Stores whose stats have not been loaded yet
+  // are counted, since they may be ancient. Does no I/O.
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas(Timestamp ancient_history_mark) const;
+
+  // Stops tracking the UNDO delta stores whose mutations are all older than
+  // 'ancient_history_mark', loading the stats of stores as needed, and removes
+  // their blocks from the rowset metadata. The metadata is not flushed; the
+  // blocks are deleted once the tablet metadata is next flushed.
+  //
+  // Sets '*blocks_deleted' and '*bytes_deleted' to the number and the total
+  // size of the removed stores.
+  Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                 int64_t* blocks_deleted,
+                                 int64_t* bytes_deleted);
+
   // Retrieves the list of column indexes that currently have updates.
   void GetColumnIdsWithUpdates(std::vector<ColumnId>* col_ids) const;
 
+  // Return true unless the delta stores are known not to hold any update to
+  // column 'col_id', at any snapshot. Unlike GetColumnIdsWithUpdates(), both
+  // the REDO and UNDO stores are considered, and a non-empty DMS or a file
+  // which hasn't been opened yet may hold updates.
+  bool MayHaveUpdatesToColumn(ColumnId col_id) const;
+
+  // Retrieves the number of updates to each column that currently has
+  // updates, summed over the REDO delta files. As with
+  // GetColumnIdsWithUpdates(), files which haven't been opened yet are
+  // skipped.
+  void GetColumnUpdateCounts(std::map<ColumnId, int64_t>* counts) const;
+
+  // Sets '*count' to the number of updates to the column 'col_id' in the
+  // REDO delta files, opening the files which haven't been opened yet. The
+  // DeltaMemStore isn't counted.
+  Status CountRedoUpdatesForColumn(ColumnId col_id, int64_t* count) const;
+
   Mutex* compact_flush_lock() {
     return &compact_flush_lock_;
   }
@@ -211,6 +253,12 @@ class DeltaTracker {
   void CollectStores(vector<std::shared_ptr<DeltaStore>>* stores,
                      WhichStores which) const;
 
+  // Collects the undo and redo stores a scan with 'projection' has to
+  // consult into '*stores', leaving out the loaded delta files that neither
+  // delete rows nor update any projected column, and the DMS if it's empty.
+  void CollectStoresForScan(const Schema& projection,
+                            SharedDeltaStoreVector* stores) const;
+
   // Performs the actual compaction. Results of compaction are written to "block",
   // while delta stores that underwent compaction are appended to "compacted_stores", while
   // their corresponding block ids are appended to "compacted_blocks".
@@ -157,7 +157,7 @@ class TestDeltaFile : public KuduTest {
 
       ASSERT_OK_FAST(it->PrepareBatch(block.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
       ColumnBlock dst_col = block.column_block(0);
-      ASSERT_OK_FAST(it->ApplyUpdates(0, &dst_col));
+      ASSERT_OK_FAST(it->ApplyUpdates(0, &dst_col, nullptr));
 
       for (int i = 0; i < block.nrows(); i++) {
         uint32_t row = start_row + i;
@@ -361,6 +361,75 @@ TEST_F(TestDeltaFile, TestLazyInit) {
   ASSERT_EQ(bytes_read_after_init, bytes_read);
 }
 
+// Test that the column index of a delta file tells which ranges of rows have
+// updates to each column.
+TEST_F(TestDeltaFile, TestColumnIndex) {
+  SchemaBuilder builder;
+  ASSERT_OK(builder.AddColumn("val", UINT32));
+  ASSERT_OK(builder.AddColumn("other", UINT32));
+  Schema schema = builder.Build();
+
+  gscoped_ptr<WritableBlock> block;
+  ASSERT_OK(fs_manager_->CreateNewBlock(&block));
+  test_block_ = block->id();
+  {
+    DeltaFileWriter dfw(std::move(block));
+    ASSERT_OK(dfw.Start());
+    DeltaStats stats;
+    faststring buf;
+    // Rows 0-9 have updates to 'other', rows 1000-1009 to 'val'.
+    for (int i = 0; i < 2; i++) {
+      for (int row = 1000 * i; row < 1000 * i + 10; row++) {
+        buf.clear();
+        RowChangeListEncoder update(&buf);
+        uint32_t new_val = row;
+        int col_idx = i == 0 ? 1 : 0;
+        update.AddColumnUpdate(schema.column(col_idx), schema.column_id(col_idx), &new_val);
+        DeltaKey key(row, Timestamp(0));
+        RowChangeList rcl(buf);
+        ASSERT_OK(dfw.AppendDelta<REDO>(key, rcl));
+        ASSERT_OK(stats.UpdateStats(key.timestamp(), rcl));
+      }
+    }
+    ASSERT_OK(dfw.WriteDeltaStats(stats));
+    ASSERT_OK(dfw.Finish());
+  }
+
+  shared_ptr<DeltaFileReader> reader;
+  ASSERT_OK(OpenDeltaFileReader(test_block_, &reader));
+  ColumnId val_id = schema.column_id(0);
+  ColumnId other_id = schema.column_id(1);
+  ASSERT_TRUE(reader->MayHaveUpdatesForColumnInRange(other_id, 0, 99));
+  ASSERT_FALSE(reader->MayHaveUpdatesForColumnInRange(other_id, 1000, 1099));
+  ASSERT_FALSE(reader->MayHaveUpdatesForColumnInRange(val_id, 0, 99));
+  ASSERT_FALSE(reader->MayHaveUpdatesForColumnInRange(val_id, 500, 999));
+  ASSERT_TRUE(reader->MayHaveUpdatesForColumnInRange(val_id, 900, 1000));
+  ASSERT_TRUE(reader->MayHaveUpdatesForColumnInRange(val_id, 1009, 2000));
+  ASSERT_FALSE(reader->MayHaveUpdatesForColumnInRange(val_id, 1010, 2000));
+
+  // The iterator consults the index for each prepared batch.
+  DeltaIterator* raw_iter;
+  ASSERT_OK(reader->NewDeltaIterator(&schema,
+                                     MvccSnapshot::CreateSnapshotIncludingAllTransactions(),
+                                     &raw_iter));
+  gscoped_ptr<DeltaIterator> iter(raw_iter);
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+  ASSERT_OK(iter->PrepareBatch(100, DeltaIterator::PREPARE_FOR_APPLY));
+  ASSERT_FALSE(iter->MayHaveUpdatesForColumn(0));
+  ASSERT_TRUE(iter->MayHaveUpdatesForColumn(1));
+
+  ASSERT_OK(iter->SeekToOrdinal(1000));
+  ASSERT_OK(iter->PrepareBatch(100, DeltaIterator::PREPARE_FOR_APPLY));
+  ASSERT_TRUE(iter->MayHaveUpdatesForColumn(0));
+  ASSERT_FALSE(iter->MayHaveUpdatesForColumn(1));
+  RowBlock row_block(schema, 100, &arena_);
+  row_block.ZeroMemory();
+  ColumnBlock dst_col = row_block.column_block(0);
+  ASSERT_OK(iter->ApplyUpdates(0, &dst_col, nullptr));
+  ASSERT_EQ(1005, *schema.ExtractColumnFromRow<UINT32>(row_block.row(5), 0));
+}
+
 // Check that, if a delta file is opened but no deltas are written,
 // Finish() will return Status::Aborted().
 TEST_F(TestDeltaFile, TestEmptyFileIsAborted) {
@@ -18,6 +18,7 @@
 #include "kudu/tablet/deltafile.h"
 
 #include <arpa/inet.h>
+#include <algorithm>
 #include <memory>
 #include <string>
 
@@ -28,6 +29,7 @@
 #include "kudu/cfile/cfile_reader.h"
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/mathlimits.h"
 #include "kudu/tablet/mutation.h"
 #include "kudu/tablet/mvcc.h"
@@ -43,6 +45,15 @@ DEFINE_int32(deltafile_default_block_size, 32*1024,
              "on a per-table basis.");
 TAG_FLAG(deltafile_default_block_size, experimental);
 
+DEFINE_int32(deltafile_column_index_gap_rows, 128,
+             "Number of rows without updates to a column after which the column "
+             "index of a delta file starts a new range of updated rows. Smaller "
+             "values let scans skip the deltas of more rows, but make the index "
+             "bigger.");
+TAG_FLAG(deltafile_column_index_gap_rows, experimental);
+
+using std::pair;
+using std::vector;
 using std::shared_ptr;
 using std::unique_ptr;
 
@@ -60,9 +71,14 @@ using fs::WritableBlock;
 namespace tablet {
 
 const char * const DeltaFileReader::kDeltaStatsEntryName = "deltafilestats";
+const char * const DeltaFileReader::kDeltaColumnIndexEntryName = "deltafilecolindex";
 
 namespace {
 
+// The maximum number of ranges of a column in the column index of a delta
+// file. Past it, neighbouring ranges are merged.
+const int kMaxColumnIndexRanges = 1024;
+
 } // namespace
 
 DeltaFileWriter::DeltaFileWriter(gscoped_ptr<WritableBlock> block)
@@ -94,9 +110,60 @@ Status DeltaFileWriter::FinishAndReleaseBlock(ScopedWritableBlockCloser* closer)
   if (writer_->written_value_count() == 0) {
     return Status::Aborted("no deltas written");
   }
+  RETURN_NOT_OK(WriteColumnIndex());
   return writer_->FinishAndReleaseBlock(closer);
 }
 
+Status DeltaFileWriter::IndexDelta(const DeltaKey &key, const RowChangeList &delta) {
+  RowChangeListDecoder decoder(delta);
+  RETURN_NOT_OK(decoder.Init());
+  if (!decoder.is_update()) {
+    // Deletes are accounted for by the delta stats.
+    return Status::OK();
+  }
+  vector<ColumnId> col_ids;
+  RETURN_NOT_OK(decoder.GetIncludedColumnIds(&col_ids));
+
+  rowid_t row_idx = key.row_idx();
+  for (ColumnId col_id : col_ids) {
+    vector<pair<rowid_t, rowid_t>>& ranges = col_index_[col_id];
+    // Deltas are appended in ascending order of row index.
+    if (!ranges.empty() &&
+        row_idx <= ranges.back().second + FLAGS_deltafile_column_index_gap_rows) {
+      ranges.back().second = row_idx;
+      continue;
+    }
+    if (ranges.size() == kMaxColumnIndexRanges) {
+      // Keep the index small by merging the ranges pairwise.
+      for (int i = 0; i < ranges.size() / 2; i++) {
+        ranges[i] = { ranges[2 * i].first, ranges[2 * i + 1].second };
+      }
+      ranges.resize(ranges.size() / 2);
+    }
+    ranges.emplace_back(row_idx, row_idx);
+  }
+  return Status::OK();
+}
+
+Status DeltaFileWriter::WriteColumnIndex() {
+  DeltaColumnIndexPB index_pb;
+  for (const auto& e : col_index_) {
+    DeltaColumnIndexPB::ColumnRanges* col_pb = index_pb.add_columns();
+    col_pb->set_col_id(e.first);
+    for (const auto& range : e.second) {
+      col_pb->add_range_starts(range.first);
+      col_pb->add_range_ends(range.second);
+    }
+  }
+
+  faststring buf;
+  if (!pb_util::SerializeToString(index_pb, &buf)) {
+    return Status::IOError("Unable to serialize DeltaColumnIndexPB");
+  }
+  writer_->AddMetadataPair(DeltaFileReader::kDeltaColumnIndexEntryName, buf.ToString());
+  return Status::OK();
+}
+
 Status DeltaFileWriter::DoAppendDelta(const DeltaKey &key,
                                       const RowChangeList &delta) {
   Slice delta_slice(delta.slice());
@@ -114,6 +181,7 @@ Status DeltaFileWriter::DoAppendDelta(const DeltaKey &key,
   tmp_buf_.append(delta_slice.data(), delta_slice.size());
   Slice tmp_buf_slice(tmp_buf_);
 
+  RETURN_NOT_OK(IndexDelta(key, delta));
   return writer_->AppendEntries(&tmp_buf_slice, 1);
 }
 
@@ -208,6 +276,7 @@ Status DeltaFileReader::OpenNoInit(gscoped_ptr<ReadableBlock> block,
 DeltaFileReader::DeltaFileReader(BlockId block_id, CFileReader *cf_reader,
                                  DeltaType delta_type)
     : reader_(cf_reader),
+      has_col_index_(false),
       block_id_(std::move(block_id)),
       delta_type_(delta_type) {}
 
@@ -227,6 +296,7 @@ Status DeltaFileReader::InitOnce() {
 
   // Initialize delta file stats
   RETURN_NOT_OK(ReadDeltaStats());
+  RETURN_NOT_OK(ReadColumnIndex());
   return Status::OK();
 }
 
@@ -246,6 +316,51 @@ Status DeltaFileReader::ReadDeltaStats() {
   return Status::OK();
 }
 
+Status DeltaFileReader::ReadColumnIndex() {
+  string index_pb_buf;
+  if (!reader_->GetMetadataEntry(kDeltaColumnIndexEntryName, &index_pb_buf)) {
+    // Written before delta files had column indexes.
+    return Status::OK();
+  }
+
+  DeltaColumnIndexPB index_pb;
+  if (!index_pb.ParseFromString(index_pb_buf)) {
+    return Status::Corruption("unable to parse the delta column index protobuf");
+  }
+  for (const DeltaColumnIndexPB::ColumnRanges& col_pb : index_pb.columns()) {
+    if (col_pb.range_starts_size() != col_pb.range_ends_size()) {
+      return Status::Corruption("mismatched range bounds in the delta column index",
+                                col_pb.ShortDebugString());
+    }
+    vector<pair<rowid_t, rowid_t>>& ranges = col_index_[ColumnId(col_pb.col_id())];
+    ranges.reserve(col_pb.range_starts_size());
+    for (int i = 0; i < col_pb.range_starts_size(); i++) {
+      ranges.emplace_back(col_pb.range_starts(i), col_pb.range_ends(i));
+    }
+  }
+  has_col_index_ = true;
+  return Status::OK();
+}
+
+bool DeltaFileReader::MayHaveUpdatesForColumnInRange(ColumnId col_id,
+                                                     rowid_t first_row,
+                                                     rowid_t last_row) const {
+  DCHECK(init_once_.initted());
+  if (!has_col_index_) {
+    return delta_stats_->update_count_for_col_id(col_id) > 0;
+  }
+  const vector<pair<rowid_t, rowid_t>>* ranges = FindOrNull(col_index_, col_id);
+  if (!ranges) {
+    return false;
+  }
+  // Find the first range which ends at or after 'first_row'.
+  auto it = std::lower_bound(ranges->begin(), ranges->end(), first_row,
+                             [](const pair<rowid_t, rowid_t>& range, rowid_t row) {
+                               return range.second < row;
+                             });
+  return it != ranges->end() && it->first <= last_row;
+}
+
 bool DeltaFileReader::IsRelevantForSnapshot(const MvccSnapshot& snap) const {
   if (!init_once_.initted()) {
     // If we're not initted, it means we have no delta stats and must
@@ -298,6 +413,12 @@ Status DeltaFileReader::NewDeltaIterator(const Schema *projection,
   }
 }
 
+Status DeltaFileReader::CountDeletedRows(int64_t* deleted_count) const {
+  RETURN_NOT_OK(const_cast<DeltaFileReader*>(this)->Init());
+  *deleted_count = delta_stats_->delete_count();
+  return Status::OK();
+}
+
 Status DeltaFileReader::CheckRowDeleted(rowid_t row_idx, bool *deleted) const {
   RETURN_NOT_OK(const_cast<DeltaFileReader*>(this)->Init());
 
@@ -634,6 +755,11 @@ struct ApplyingVisitor {
   inline Status ApplyMutation(const DeltaKey &key, const Slice &deltas) {
     int64_t rel_idx = key.row_idx() - dfi->prepared_idx_;
     DCHECK_GE(rel_idx, 0);
+    // Rows the caller has already filtered out don't need their mutations
+    // decoded at all.
+    if (filter && !filter->IsRowSelected(rel_idx)) {
+      return Status::OK();
+    }
 
     // TODO: this code looks eerily similar to DMSIterator::ApplyUpdates!
     // I bet it can be combined.
@@ -655,6 +781,7 @@ struct ApplyingVisitor {
   DeltaFileIterator *dfi;
   size_t col_to_apply;
   ColumnBlock *dst;
+  const SelectionVector* filter;
 };
 
 template<>
@@ -681,16 +808,22 @@ inline Status ApplyingVisitor<UNDO>::Visit(const DeltaKey& key,
   return Status::OK();
 }
 
-Status DeltaFileIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
+Status DeltaFileIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst,
+                                       const SelectionVector* filter) {
   DCHECK_LE(prepared_count_, dst->nrows());
 
+  // Skip decoding the mutations of the batch if none updates the column.
+  if (!MayHaveUpdatesForColumn(col_to_apply)) {
+    return Status::OK();
+  }
+
   if (delta_type_ == REDO) {
     DVLOG(3) << "Applying REDO mutations to " << col_to_apply;
-    ApplyingVisitor<REDO> visitor = {this, col_to_apply, dst};
+    ApplyingVisitor<REDO> visitor = {this, col_to_apply, dst, filter};
     return VisitMutations(&visitor);
   } else {
     DVLOG(3) << "Applying UNDO mutations to " << col_to_apply;
-    ApplyingVisitor<UNDO> visitor = {this, col_to_apply, dst};
+    ApplyingVisitor<UNDO> visitor = {this, col_to_apply, dst, filter};
     return VisitMutations(&visitor);
   }
 }
@@ -748,6 +881,9 @@ inline Status DeletingVisitor<UNDO>::Visit(const DeltaKey& key,
 
 Status DeltaFileIterator::ApplyDeletes(SelectionVector *sel_vec) {
   DCHECK_LE(prepared_count_, sel_vec->nrows());
+  if (!MayHaveDeltas() || dfr_->delta_stats().delete_count() == 0) {
+    return Status::OK();
+  }
   if (delta_type_ == REDO) {
     DVLOG(3) << "Applying REDO deletes";
     DeletingVisitor<REDO> visitor = { this, sel_vec};
@@ -817,6 +953,24 @@ bool DeltaFileIterator::HasNext() {
   return !exhausted_ || !delta_blocks_.empty();
 }
 
+bool DeltaFileIterator::MayHaveDeltas() {
+  // Any prepared delta block may hold updates relevant to the batch.
+  DCHECK(prepared_) << "must Prepare";
+  return !delta_blocks_.empty();
+}
+
+bool DeltaFileIterator::MayHaveUpdatesForColumn(size_t col_idx) {
+  if (!MayHaveDeltas()) {
+    return false;
+  }
+  // The file's column index tells which ranges of rows have updates to the
+  // column. Without one, the file's stats cover every row in it, so a column
+  // they have no updates for can't have any in the prepared batch either.
+  return dfr_->MayHaveUpdatesForColumnInRange(projection_->column_id(col_idx),
+                                              prepared_idx_,
+                                              prepared_idx_ + prepared_count_ - 1);
+}
+
 string DeltaFileIterator::ToString() const {
   return "DeltaFileIterator(" + dfr_->ToString() + ")";
 }
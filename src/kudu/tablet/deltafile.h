@@ -20,6 +20,8 @@
 #include <deque>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "kudu/cfile/block_handle.h"
@@ -85,8 +87,19 @@ class DeltaFileWriter {
  private:
   Status DoAppendDelta(const DeltaKey &key, const RowChangeList &delta);
 
+  // Adds the columns updated by 'delta' to the ranges of 'col_index_'.
+  Status IndexDelta(const DeltaKey &key, const RowChangeList &delta);
+
+  // Adds 'col_index_' to the file's metadata.
+  Status WriteColumnIndex();
+
   gscoped_ptr<cfile::CFileWriter> writer_;
 
+  // For each updated column, the ranges of rows with updates to it, see
+  // DeltaColumnIndexPB. A row within --deltafile_column_index_gap_rows of
+  // the last range is merged into it.
+  std::unordered_map<ColumnId, std::vector<std::pair<rowid_t, rowid_t>>> col_index_;
+
   // Buffer used as a temporary for storing the serialized form
   // of the deltas
   faststring tmp_buf_;
@@ -106,6 +119,7 @@ class DeltaFileReader : public DeltaStore,
                         public std::enable_shared_from_this<DeltaFileReader> {
  public:
   static const char * const kDeltaStatsEntryName;
+  static const char * const kDeltaColumnIndexEntryName;
 
   // Fully open a delta file using a previously opened block.
   //
@@ -139,6 +153,9 @@ class DeltaFileReader : public DeltaStore,
   // See DeltaStore::CheckRowDeleted
   virtual Status CheckRowDeleted(rowid_t row_idx, bool *deleted) const OVERRIDE;
 
+  // See DeltaStore::CountDeletedRows
+  virtual Status CountDeletedRows(int64_t* deleted_count) const OVERRIDE;
+
   virtual uint64_t EstimateSize() const OVERRIDE;
 
   const BlockId& block_id() const { return block_id_; }
@@ -157,6 +174,13 @@ class DeltaFileReader : public DeltaStore,
   // been fully initialized.
   bool IsRelevantForSnapshot(const MvccSnapshot& snap) const;
 
+  // Returns false if none of the rows 'first_row' through 'last_row' has an
+  // update to column 'col_id' in this file.
+  //
+  // REQUIRES: the file has been fully initialized.
+  bool MayHaveUpdatesForColumnInRange(ColumnId col_id,
+                                      rowid_t first_row, rowid_t last_row) const;
+
  private:
   friend class DeltaFileIterator;
 
@@ -174,9 +198,17 @@ class DeltaFileReader : public DeltaStore,
 
   Status ReadDeltaStats();
 
+  // Reads the file's column index, if it has one.
+  Status ReadColumnIndex();
+
   std::shared_ptr<cfile::CFileReader> reader_;
   gscoped_ptr<DeltaStats> delta_stats_;
 
+  // The ranges of rows with updates to each column, sorted by row index.
+  // Only valid if 'has_col_index_' is set.
+  std::unordered_map<ColumnId, std::vector<std::pair<rowid_t, rowid_t>>> col_index_;
+  bool has_col_index_;
+
   const BlockId block_id_;
 
   // The type of this delta, i.e. UNDO or REDO.
@@ -194,7 +226,8 @@ class DeltaFileIterator : public DeltaIterator {
 
   Status SeekToOrdinal(rowid_t idx) OVERRIDE;
   Status PrepareBatch(size_t nrows, PrepareFlag flag) OVERRIDE;
-  Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) OVERRIDE;
+  Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst,
+                      const SelectionVector* filter) OVERRIDE;
   Status ApplyDeletes(SelectionVector *sel_vec) OVERRIDE;
   Status CollectMutations(vector<Mutation *> *dst, Arena *arena) OVERRIDE;
   Status FilterColumnIdsAndCollectDeltas(const std::vector<ColumnId>& col_ids,
@@ -202,6 +235,9 @@ class DeltaFileIterator : public DeltaIterator {
                                          Arena* arena) OVERRIDE;
   string ToString() const OVERRIDE;
   virtual bool HasNext() OVERRIDE;
+  virtual bool MayHaveDeltas() OVERRIDE;
+
+  virtual bool MayHaveUpdatesForColumn(size_t col_idx) OVERRIDE;
 
  private:
   friend class DeltaFileReader;
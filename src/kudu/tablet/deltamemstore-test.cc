@@ -106,7 +106,7 @@ class TestDeltaMemStore : public KuduTest {
     ASSERT_OK(iter->Init(nullptr));
     ASSERT_OK(iter->SeekToOrdinal(row_idx));
     ASSERT_OK(iter->PrepareBatch(cb->nrows(), DeltaIterator::PREPARE_FOR_APPLY));
-    ASSERT_OK(iter->ApplyUpdates(0, cb));
+    ASSERT_OK(iter->ApplyUpdates(0, cb, nullptr));
   }
 
 
@@ -423,7 +423,7 @@ TEST_F(TestDeltaMemStore, TestIteratorDoesUpdates) {
   int block_start_row = 50;
   ASSERT_OK(iter->SeekToOrdinal(block_start_row));
   ASSERT_OK(iter->PrepareBatch(block.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
-  ASSERT_OK(iter->ApplyUpdates(kIntColumn, &block));
+  ASSERT_OK(iter->ApplyUpdates(kIntColumn, &block, nullptr));
 
   for (int i = 0; i < 100; i++) {
     int actual_row = block_start_row + i;
@@ -433,13 +433,50 @@ TEST_F(TestDeltaMemStore, TestIteratorDoesUpdates) {
   // Apply the next block
   block_start_row += block.nrows();
   ASSERT_OK(iter->PrepareBatch(block.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
-  ASSERT_OK(iter->ApplyUpdates(kIntColumn, &block));
+  ASSERT_OK(iter->ApplyUpdates(kIntColumn, &block, nullptr));
   for (int i = 0; i < 100; i++) {
     int actual_row = block_start_row + i;
     ASSERT_EQ(actual_row * 10, block[i]) << "at row " << actual_row;
   }
 }
 
+// Test that updates are only applied to the rows selected by the filter, and
+// that the iterator knows which columns it has updates for.
+TEST_F(TestDeltaMemStore, TestApplyUpdatesWithFilter) {
+  unordered_set<uint32_t> to_update;
+  for (uint32_t i = 0; i < 100; i++) {
+    to_update.insert(i);
+  }
+  UpdateIntsAtIndexes(to_update);
+
+  MvccSnapshot snap(mvcc_);
+  DeltaIterator* raw_iter;
+  ASSERT_OK(dms_->NewDeltaIterator(&schema_, snap, &raw_iter));
+  gscoped_ptr<DeltaIterator> iter(raw_iter);
+  ASSERT_OK(iter->Init(nullptr));
+  ASSERT_OK(iter->SeekToOrdinal(0));
+
+  ScopedColumnBlock<UINT32> block(100);
+  ASSERT_OK(iter->PrepareBatch(block.nrows(), DeltaIterator::PREPARE_FOR_APPLY));
+  ASSERT_TRUE(iter->MayHaveUpdatesForColumn(kIntColumn));
+  ASSERT_FALSE(iter->MayHaveUpdatesForColumn(kStringColumn));
+
+  // Only select the even rows.
+  SelectionVector filter(block.nrows());
+  filter.SetAllFalse();
+  for (int i = 0; i < block.nrows(); i += 2) {
+    filter.SetRowSelected(i);
+  }
+  for (int i = 0; i < block.nrows(); i++) {
+    block[i] = 0;
+  }
+  ASSERT_OK(iter->ApplyUpdates(kIntColumn, &block, &filter));
+  for (int i = 0; i < block.nrows(); i++) {
+    uint32_t expected = i % 2 == 0 ? i * 10 : 0;
+    ASSERT_EQ(expected, block[i]) << "at row " << i;
+  }
+}
+
 TEST_F(TestDeltaMemStore, TestCollectMutations) {
   Arena arena(1024, 1024);
 
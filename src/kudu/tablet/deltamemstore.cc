@@ -17,6 +17,8 @@
 
 #include <utility>
 
+#include <gflags/gflags.h>
+
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/gutil/port.h"
 #include "kudu/tablet/deltafile.h"
@@ -28,6 +30,8 @@
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/status.h"
 
+DECLARE_bool(memstore_arena_huge_pages);
+
 namespace kudu {
 namespace tablet {
 
@@ -42,6 +46,9 @@ using strings::Substitute;
 static const int kInitialArenaSize = 16;
 static const int kMaxArenaBufferSize = 5*1024*1024;
 
+// With huge pages, a 5MB chunk would take up three of them.
+static const int kMaxHugePageArenaBufferSize = 4*1024*1024;
+
 DeltaMemStore::DeltaMemStore(int64_t id,
                              int64_t rs_id,
                              LogAnchorRegistry* log_anchor_registry,
@@ -49,6 +56,7 @@ DeltaMemStore::DeltaMemStore(int64_t id,
   : id_(id),
     rs_id_(rs_id),
     anchorer_(log_anchor_registry, Substitute("Rowset-$0/DeltaMemStore-$1", rs_id_, id_)),
+    deleted_row_count_(0),
     disambiguator_sequence_number_(0) {
   if (parent_tracker) {
     CHECK(MemTracker::FindTracker(Tablet::kDMSMemTrackerId,
@@ -57,10 +65,17 @@ DeltaMemStore::DeltaMemStore(int64_t id,
   } else {
     mem_tracker_ = MemTracker::GetRootTracker();
   }
-  allocator_.reset(new MemoryTrackingBufferAllocator(
-      HeapBufferAllocator::Get(), mem_tracker_));
-  arena_.reset(new ThreadSafeMemoryTrackingArena(
-      kInitialArenaSize, kMaxArenaBufferSize, allocator_));
+  if (FLAGS_memstore_arena_huge_pages) {
+    allocator_.reset(new MemoryTrackingBufferAllocator(
+        HugePageBufferAllocator::Get(), mem_tracker_));
+    arena_.reset(new ThreadSafeMemoryTrackingArena(
+        kInitialArenaSize, kMaxHugePageArenaBufferSize, allocator_));
+  } else {
+    allocator_.reset(new MemoryTrackingBufferAllocator(
+        HeapBufferAllocator::Get(), mem_tracker_));
+    arena_.reset(new ThreadSafeMemoryTrackingArena(
+        kInitialArenaSize, kMaxArenaBufferSize, allocator_));
+  }
   tree_.reset(new DMSTree(arena_));
 }
 
@@ -99,6 +114,9 @@ Status DeltaMemStore::Update(Timestamp timestamp,
 
   anchorer_.AnchorIfMinimum(op_id.index());
 
+  if (update.is_delete()) {
+    deleted_row_count_.Increment();
+  }
   return Status::OK();
 }
 
@@ -304,7 +322,8 @@ Status DMSIterator::PrepareBatch(size_t nrows, PrepareFlag flag) {
   return Status::OK();
 }
 
-Status DMSIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
+Status DMSIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst,
+                                 const SelectionVector* filter) {
   DCHECK_EQ(prepared_for_, PREPARED_FOR_APPLY);
   DCHECK_EQ(prepared_count_, dst->nrows());
 
@@ -312,6 +331,9 @@ Status DMSIterator::ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) {
   for (const ColumnUpdate& cu : updates_by_col_[col_to_apply]) {
     int32_t idx_in_block = cu.row_id - prepared_idx_;
     DCHECK_GE(idx_in_block, 0);
+    if (filter && !filter->IsRowSelected(idx_in_block)) {
+      continue;
+    }
     SimpleConstCell src(col_schema, cu.new_val_ptr);
     ColumnBlock::Cell dst_cell = dst->cell(idx_in_block);
     RETURN_NOT_OK(CopyCell(src, &dst_cell, dst->arena()));
@@ -363,6 +385,21 @@ bool DMSIterator::HasNext() {
   return false;
 }
 
+bool DMSIterator::MayHaveDeltas() {
+  DCHECK_EQ(prepared_for_, PREPARED_FOR_APPLY);
+  for (const UpdatesForColumn& ufc : updates_by_col_) {
+    if (!ufc.empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DMSIterator::MayHaveUpdatesForColumn(size_t col_idx) {
+  DCHECK_EQ(prepared_for_, PREPARED_FOR_APPLY);
+  return !updates_by_col_[col_idx].empty();
+}
+
 string DMSIterator::ToString() const {
   return "DMSIterator";
 }
@@ -112,6 +112,12 @@ class DeltaMemStore : public DeltaStore,
 
   virtual Status CheckRowDeleted(rowid_t row_idx, bool *deleted) const OVERRIDE;
 
+  // Unlike the flushed stats, the delete count is maintained on every Update().
+  virtual Status CountDeletedRows(int64_t* deleted_count) const OVERRIDE {
+    *deleted_count = deleted_row_count_.Load();
+    return Status::OK();
+  }
+
   virtual uint64_t EstimateSize() const OVERRIDE {
     return memory_footprint();
   }
@@ -161,6 +167,9 @@ class DeltaMemStore : public DeltaStore,
 
   const DeltaStats delta_stats_;
 
+  // The number of DELETE mutations applied to this DMS.
+  AtomicInt<int64_t> deleted_row_count_;
+
   // It's possible for multiple mutations to apply to the same row
   // in the same timestamp (e.g. if a batch contains multiple updates for that
   // row). In that case, we need to append a sequence number to the delta key
@@ -189,7 +198,8 @@ class DMSIterator : public DeltaIterator {
 
   Status PrepareBatch(size_t nrows, PrepareFlag flag) OVERRIDE;
 
-  Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst) OVERRIDE;
+  Status ApplyUpdates(size_t col_to_apply, ColumnBlock *dst,
+                      const SelectionVector* filter) OVERRIDE;
 
   Status ApplyDeletes(SelectionVector *sel_vec) OVERRIDE;
 
@@ -203,6 +213,10 @@ class DMSIterator : public DeltaIterator {
 
   virtual bool HasNext() OVERRIDE;
 
+  virtual bool MayHaveDeltas() OVERRIDE;
+
+  virtual bool MayHaveUpdatesForColumn(size_t col_idx) OVERRIDE;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(DMSIterator);
   FRIEND_TEST(TestDeltaMemStore, TestIteratorDoesUpdates);
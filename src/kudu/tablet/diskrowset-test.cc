@@ -468,6 +468,13 @@ void BetweenZeroAndOne(double to_check) {
   ASSERT_GT(1, to_check);
 }
 
+// Major compactions are scored against the base data of the updated columns
+// only, so with enough updates they may reach the maximum score.
+void AboveZeroAtMostOne(double to_check) {
+  ASSERT_LT(0, to_check);
+  ASSERT_GE(1, to_check);
+}
+
 TEST_F(TestRowSet, TestCompactStores) {
   // With this setting, we want major compactions to basically always have a score.
   FLAGS_tablet_delta_store_major_compact_min_ratio = 0.0001;
@@ -490,21 +497,21 @@ TEST_F(TestRowSet, TestCompactStores) {
   ASSERT_OK(rs->FlushDeltas());
   // One file isn't enough for minor compactions, but a major compaction can run.
   ASSERT_EQ(0, rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MINOR_DELTA_COMPACTION));
-  BetweenZeroAndOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
+  AboveZeroAtMostOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
 
   // Write a second delta file.
   UpdateExistingRows(rs.get(), FLAGS_update_fraction, nullptr);
   ASSERT_OK(rs->FlushDeltas());
   // Two files is enough for all delta compactions.
   BetweenZeroAndOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MINOR_DELTA_COMPACTION));
-  BetweenZeroAndOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
+  AboveZeroAtMostOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
 
   // Write a third delta file.
   UpdateExistingRows(rs.get(), FLAGS_update_fraction, nullptr);
   ASSERT_OK(rs->FlushDeltas());
   // We're hitting the max for minor compactions but not for major compactions.
   ASSERT_EQ(1, rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MINOR_DELTA_COMPACTION));
-  BetweenZeroAndOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
+  AboveZeroAtMostOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
 
   // Compact the deltafiles
   DeltaTracker *dt = rs->delta_tracker();
@@ -517,7 +524,7 @@ TEST_F(TestRowSet, TestCompactStores) {
   ASSERT_EQ(1,  num_stores);
   // Back to one store, can't minor compact.
   ASSERT_EQ(0, rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MINOR_DELTA_COMPACTION));
-  BetweenZeroAndOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
+  AboveZeroAtMostOne(rs->DeltaStoresCompactionPerfImprovementScore(RowSet::MAJOR_DELTA_COMPACTION));
 
   // Verify that the resulting deltafile is valid
   vector<shared_ptr<DeltaStore> > compacted_stores;
@@ -536,5 +543,44 @@ TEST_F(TestRowSet, TestCompactStores) {
   ASSERT_TRUE(is_sorted(results.begin(), results.end()));
 }
 
+// Scans skip the delta stores which can't change their results.
+TEST_F(TestRowSet, TestScanSkipsIrrelevantDeltas) {
+  // Culling relies on the delta files' stats being loaded.
+  FLAGS_cfile_lazy_open = false;
+  WriteTestRowSet();
+  shared_ptr<DiskRowSet> rs;
+  ASSERT_OK(OpenTestRowSet(&rs));
+
+  Schema proj_key = CreateProjection(schema_, { "key" });
+  Schema proj_val = CreateProjection(schema_, { "val" });
+  MvccSnapshot snap = MvccSnapshot::CreateSnapshotIncludingAllTransactions();
+  gscoped_ptr<RowwiseIterator> iter;
+
+  // Nothing has been mutated: the DMS is empty.
+  ASSERT_OK(rs->NewRowIterator(&proj_val, snap, &iter));
+  ASSERT_STR_CONTAINS(iter->ToString(), "no deltas");
+
+  // Update 'val' in some rows and flush the updates.
+  unordered_set<uint32_t> updated;
+  UpdateExistingRows(rs.get(), FLAGS_update_fraction, &updated);
+  ASSERT_OK(rs->FlushDeltas());
+
+  // A scan of 'val' must apply them, but a scan of 'key' alone needn't.
+  ASSERT_OK(rs->NewRowIterator(&proj_val, snap, &iter));
+  ASSERT_EQ(string::npos, iter->ToString().find("no deltas"));
+  NO_FATALS(VerifyUpdates(*rs, updated));
+  ASSERT_OK(rs->NewRowIterator(&proj_key, snap, &iter));
+  ASSERT_STR_CONTAINS(iter->ToString(), "no deltas");
+  NO_FATALS(IterateProjection(*rs, proj_key, n_rows_));
+
+  // Deletes matter whatever the projection.
+  OperationResultPB result;
+  ASSERT_OK(DeleteRow(rs.get(), 0, &result));
+  ASSERT_OK(rs->FlushDeltas());
+  ASSERT_OK(rs->NewRowIterator(&proj_key, snap, &iter));
+  ASSERT_EQ(string::npos, iter->ToString().find("no deltas"));
+  NO_FATALS(IterateProjection(*rs, proj_key, n_rows_ - 1));
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -17,11 +17,14 @@
 
 #include <algorithm>
 #include <glog/logging.h>
+#include <map>
 #include <mutex>
 #include <vector>
 
+#include "kudu/common/column_stats.h"
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
+#include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/cfile/bloomfile.h"
@@ -38,6 +41,7 @@
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/status.h"
 
 DEFINE_int32(tablet_delta_store_minor_compact_max, 1000,
@@ -50,14 +54,30 @@ DEFINE_double(tablet_delta_store_major_compact_min_ratio, 0.1f,
              "can run (Advanced option)");
 TAG_FLAG(tablet_delta_store_major_compact_min_ratio, experimental);
 
+DEFINE_double(tablet_delta_store_major_compact_min_column_update_ratio, 0.1,
+              "Minimum ratio of a column's update count to the update count of the rowset's "
+              "most-updated column for that column to be rewritten by a major delta compaction. "
+              "Deltas for columns below the ratio are carried over to a new delta file instead "
+              "(Advanced option)");
+TAG_FLAG(tablet_delta_store_major_compact_min_column_update_ratio, experimental);
+
 DEFINE_int32(default_composite_key_index_block_size_bytes, 4096,
              "Block size used for composite key indexes.");
 TAG_FLAG(default_composite_key_index_block_size_bytes, experimental);
 
+DEFINE_bool(rowset_collect_column_stats, true,
+            "Whether to collect the statistics of the values of each column "
+            "(row and null counts, min and max, a distinct value sketch and a "
+            "histogram) when writing a DiskRowSet, for the query planners of "
+            "the clients to use.");
+TAG_FLAG(rowset_collect_column_stats, experimental);
+TAG_FLAG(rowset_collect_column_stats, runtime);
+
 namespace kudu {
 namespace tablet {
 
 using cfile::BloomFileWriter;
+using fs::CreateBlockOptions;
 using fs::ScopedWritableBlockCloser;
 using fs::WritableBlock;
 using log::LogAnchorRegistry;
@@ -66,14 +86,17 @@ using std::string;
 using std::unique_ptr;
 
 const char *DiskRowSet::kMinKeyMetaEntryName = "min_key";
+const char *DiskRowSet::kCFileReaderMemTrackerId = "CFileReaders";
 const char *DiskRowSet::kMaxKeyMetaEntryName = "max_key";
 
 DiskRowSetWriter::DiskRowSetWriter(RowSetMetadata* rowset_metadata,
                                    const Schema* schema,
-                                   BloomFilterSizing bloom_sizing)
+                                   BloomFilterSizing bloom_sizing,
+                                   ThreadPool* encode_pool)
     : rowset_metadata_(rowset_metadata),
       schema_(schema),
       bloom_sizing_(std::move(bloom_sizing)),
+      encode_pool_(encode_pool),
       finished_(false),
       written_count_(0) {
   CHECK(schema->has_column_ids());
@@ -83,7 +106,9 @@ Status DiskRowSetWriter::Open() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::Open");
 
   FsManager* fs = rowset_metadata_->fs_manager();
-  col_writer_.reset(new MultiColumnWriter(fs, schema_));
+  col_writer_.reset(new MultiColumnWriter(fs, schema_,
+                                          rowset_metadata_->tablet_metadata()->tablet_id(),
+                                          encode_pool_));
   RETURN_NOT_OK(col_writer_->Open());
 
   // Open bloom filter.
@@ -94,6 +119,13 @@ Status DiskRowSetWriter::Open() {
     RETURN_NOT_OK(InitAdHocIndexWriter());
   }
 
+  if (FLAGS_rowset_collect_column_stats) {
+    for (int i = 0; i < schema_->num_columns(); i++) {
+      stats_collectors_.emplace_back(new ColumnStatsCollector(
+          schema_->column_id(i), schema_->column(i).type_info()));
+    }
+  }
+
   return Status::OK();
 }
 
@@ -101,7 +133,10 @@ Status DiskRowSetWriter::InitBloomFileWriter() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::InitBloomFileWriter");
   gscoped_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&block),
+  CreateBlockOptions opts;
+  opts.background_write = true;
+  opts.tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(opts, &block),
                         "Couldn't allocate a block for bloom filter");
   rowset_metadata_->set_bloom_block(block->id());
 
@@ -114,7 +149,10 @@ Status DiskRowSetWriter::InitAdHocIndexWriter() {
   TRACE_EVENT0("tablet", "DiskRowSetWriter::InitAdHocIndexWriter");
   gscoped_ptr<WritableBlock> block;
   FsManager* fs = rowset_metadata_->fs_manager();
-  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(&block),
+  CreateBlockOptions block_opts;
+  block_opts.background_write = true;
+  block_opts.tablet_id = rowset_metadata_->tablet_metadata()->tablet_id();
+  RETURN_NOT_OK_PREPEND(fs->CreateNewBlock(block_opts, &block),
                         "Couldn't allocate a block for compoound index");
 
   rowset_metadata_->set_adhoc_index_block(block->id());
@@ -161,6 +199,10 @@ Status DiskRowSetWriter::AppendBlock(const RowBlock &block) {
   // Write the batch to each of the columns
   RETURN_NOT_OK(col_writer_->AppendBlock(block));
 
+  for (int i = 0; i < stats_collectors_.size(); i++) {
+    stats_collectors_[i]->AddCells(block.column_block(i));
+  }
+
 #ifndef NDEBUG
     faststring prev_key;
 #endif
@@ -211,6 +253,10 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(ScopedWritableBlockCloser* close
     return Status::Aborted("no data written");
   }
 
+  // The key index may be the writer of the key column, which mustn't be
+  // touched while columns are being encoded.
+  RETURN_NOT_OK(col_writer_->WaitForPendingAppends());
+
   // Save the last encoded (max) key
   CHECK_GT(last_encoded_key_.size(), 0);
   Slice last_enc_slice(last_encoded_key_);
@@ -231,6 +277,14 @@ Status DiskRowSetWriter::FinishAndReleaseBlocks(ScopedWritableBlockCloser* close
   col_writer_->GetFlushedBlocksByColumnId(&flushed_blocks);
   rowset_metadata_->SetColumnDataBlocks(flushed_blocks);
 
+  if (!stats_collectors_.empty()) {
+    std::vector<ColumnStatisticsPB> column_stats(stats_collectors_.size());
+    for (int i = 0; i < stats_collectors_.size(); i++) {
+      stats_collectors_[i]->Finish(&column_stats[i]);
+    }
+    rowset_metadata_->SetColumnStats(std::move(column_stats));
+  }
+
   if (ad_hoc_index_writer_ != nullptr) {
     Status s = ad_hoc_index_writer_->FinishAndReleaseBlock(closer);
     if (!s.ok()) {
@@ -272,17 +326,24 @@ size_t DiskRowSetWriter::written_size() const {
   return size;
 }
 
+void DiskRowSetWriter::GetDictEncodingStats(cfile::DictEncodingStatsPB* stats) const {
+  CHECK(finished_);
+  col_writer_->GetDictEncodingStats(stats);
+}
+
 DiskRowSetWriter::~DiskRowSetWriter() {
 }
 
 RollingDiskRowSetWriter::RollingDiskRowSetWriter(
     TabletMetadata* tablet_metadata, const Schema& schema,
-    BloomFilterSizing bloom_sizing, size_t target_rowset_size)
+    BloomFilterSizing bloom_sizing, size_t target_rowset_size,
+    ThreadPool* encode_pool)
     : state_(kInitialized),
       tablet_metadata_(DCHECK_NOTNULL(tablet_metadata)),
       schema_(schema),
       bloom_sizing_(std::move(bloom_sizing)),
       target_rowset_size_(target_rowset_size),
+      encode_pool_(encode_pool),
       row_idx_in_cur_drs_(0),
       can_roll_(false),
       written_count_(0),
@@ -306,14 +367,18 @@ Status RollingDiskRowSetWriter::RollWriter() {
 
   RETURN_NOT_OK(tablet_metadata_->CreateRowSet(&cur_drs_metadata_, schema_));
 
-  cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_));
+  cur_writer_.reset(new DiskRowSetWriter(cur_drs_metadata_.get(), &schema_, bloom_sizing_,
+                                        encode_pool_));
   RETURN_NOT_OK(cur_writer_->Open());
 
   FsManager* fs = tablet_metadata_->fs_manager();
   gscoped_ptr<WritableBlock> undo_data_block;
   gscoped_ptr<WritableBlock> redo_data_block;
-  RETURN_NOT_OK(fs->CreateNewBlock(&undo_data_block));
-  RETURN_NOT_OK(fs->CreateNewBlock(&redo_data_block));
+  CreateBlockOptions opts;
+  opts.background_write = true;
+  opts.tablet_id = tablet_metadata_->tablet_id();
+  RETURN_NOT_OK(fs->CreateNewBlock(opts, &undo_data_block));
+  RETURN_NOT_OK(fs->CreateNewBlock(opts, &redo_data_block));
   cur_undo_ds_block_id_ = undo_data_block->id();
   cur_redo_ds_block_id_ = redo_data_block->id();
   cur_undo_writer_.reset(new DeltaFileWriter(std::move(undo_data_block)));
@@ -423,6 +488,7 @@ Status RollingDiskRowSetWriter::FinishCurrentWriter() {
     }
 
     written_size_ += cur_writer_->written_size();
+    cur_writer_->GetDictEncodingStats(&dict_stats_);
 
     written_drs_metas_.push_back(cur_drs_metadata_);
   }
@@ -481,7 +547,14 @@ DiskRowSet::DiskRowSet(shared_ptr<RowSetMetadata> rowset_metadata,
 
 Status DiskRowSet::Open() {
   TRACE_EVENT0("tablet", "DiskRowSet::Open");
-  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_));
+  if (parent_tracker_) {
+    base_data_reader_options_.parent_mem_tracker =
+        MemTracker::FindOrCreateTracker(-1, kCFileReaderMemTrackerId, parent_tracker_);
+  }
+  base_data_reader_options_.pin_validx =
+      rowset_metadata_->tablet_metadata()->pin_key_index();
+
+  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_, base_data_reader_options_));
   RETURN_NOT_OK(new_base->Open());
   base_data_.reset(new_base.release());
 
@@ -507,9 +580,24 @@ Status DiskRowSet::MinorCompactDeltaStores() {
   return delta_tracker_->Compact();
 }
 
+int64_t DiskRowSet::EstimateBytesInPotentiallyAncientUndoDeltas(
+    Timestamp ancient_history_mark) const {
+  DCHECK(open_);
+  return delta_tracker_->EstimateBytesInPotentiallyAncientUndoDeltas(ancient_history_mark);
+}
+
+Status DiskRowSet::DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                           int64_t* blocks_deleted,
+                                           int64_t* bytes_deleted) {
+  TRACE_EVENT0("tablet", "DiskRowSet::DeleteAncientUndoDeltas");
+  DCHECK(open_);
+  return delta_tracker_->DeleteAncientUndoDeltas(ancient_history_mark,
+                                                 blocks_deleted, bytes_deleted);
+}
+
 Status DiskRowSet::MajorCompactDeltaStores() {
   vector<ColumnId> col_ids;
-  delta_tracker_->GetColumnIdsWithUpdates(&col_ids);
+  SelectMajorDeltaCompactionColumns(&col_ids, nullptr);
 
   if (col_ids.empty()) {
     return Status::OK();
@@ -536,7 +624,7 @@ Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>&
   RETURN_NOT_OK(rowset_metadata_->Flush());
 
   // Make the new base data and delta files visible.
-  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_));
+  gscoped_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_, base_data_reader_options_));
   RETURN_NOT_OK(new_base->Open());
   {
     std::lock_guard<percpu_rwlock> lock(component_lock_);
@@ -546,6 +634,163 @@ Status DiskRowSet::MajorCompactDeltaStoresWithColumnIds(const vector<ColumnId>&
   return Status::OK();
 }
 
+void DiskRowSet::SelectMajorDeltaCompactionColumns(vector<ColumnId>* col_ids,
+                                                   double* ratio) const {
+  DCHECK(open_);
+  col_ids->clear();
+  if (ratio) *ratio = 0;
+
+  std::map<ColumnId, int64_t> update_counts;
+  delta_tracker_->GetColumnUpdateCounts(&update_counts);
+  if (update_counts.empty()) {
+    return;
+  }
+
+  int64_t max_count = 0;
+  int64_t total_count = 0;
+  for (const auto& e : update_counts) {
+    max_count = std::max(max_count, e.second);
+    total_count += e.second;
+  }
+
+  int64_t selected_count = 0;
+  uint64_t selected_base_size = 0;
+  {
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
+    for (const auto& e : update_counts) {
+      if (e.second < max_count * FLAGS_tablet_delta_store_major_compact_min_column_update_ratio) {
+        continue;
+      }
+      col_ids->push_back(e.first);
+      selected_count += e.second;
+      selected_base_size += base_data_->EstimateColumnOnDiskSize(e.first);
+    }
+    if (ratio == nullptr) {
+      return;
+    }
+    // The delta files don't record how many bytes belong to each column, so
+    // attribute their size in proportion to the update counts.
+    double selected_delta_size = static_cast<double>(delta_tracker_->EstimateOnDiskSize()) *
+        selected_count / total_count;
+    if (selected_base_size == 0) {
+      *ratio = selected_delta_size > 0 ? 1 : 0;
+    } else {
+      *ratio = selected_delta_size / selected_base_size;
+    }
+  }
+}
+
+Status DiskRowSet::FindColumnsToReencode(vector<ColumnId>* col_ids) const {
+  DCHECK(open_);
+  col_ids->clear();
+
+  shared_ptr<CFileSet> base_data;
+  {
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
+    base_data = base_data_;
+  }
+
+  // Key columns can't be rewritten by a major delta compaction, so they're
+  // left to rowset compactions.
+  const Schema& schema = rowset_metadata_->tablet_schema();
+  for (size_t i = schema.num_key_columns(); i < schema.num_columns(); i++) {
+    ColumnId col_id = schema.column_id(i);
+    if (!base_data->has_data_for_column_id(col_id)) {
+      continue;
+    }
+
+    // Resolve the attributes the way CFileWriter does.
+    const ColumnSchema& col = schema.column(i);
+    const cfile::TypeEncodingInfo* type_encoding;
+    if (!cfile::TypeEncodingInfo::Get(col.type_info(), col.attributes().encoding,
+                                      &type_encoding).ok()) {
+      CHECK_OK(cfile::TypeEncodingInfo::Get(
+          col.type_info(), cfile::TypeEncodingInfo::GetDefaultEncoding(col.type_info()),
+          &type_encoding));
+    }
+    CompressionType compression = col.attributes().compression;
+    if (compression == DEFAULT_COMPRESSION) {
+      compression = cfile::GetDefaultCompressionCodec();
+    }
+
+    EncodingType cur_encoding;
+    CompressionType cur_compression;
+    RETURN_NOT_OK(base_data->GetColumnStorage(col_id, &cur_encoding, &cur_compression));
+    if (cur_encoding != type_encoding->encoding_type() || cur_compression != compression) {
+      col_ids->push_back(col_id);
+    }
+  }
+  return Status::OK();
+}
+
+Status DiskRowSet::AllRowsExpired(const RowExpiry& expiry, bool* expired) const {
+  DCHECK(open_);
+  *expired = false;
+  if (!delta_tracker_->DeltaMemStoreEmpty()) {
+    return Status::OK();
+  }
+
+  shared_ptr<CFileSet> base_data;
+  {
+    shared_lock<rw_spinlock> l(component_lock_.get_lock());
+    base_data = base_data_;
+  }
+  if (!base_data->has_data_for_column_id(expiry.col_id)) {
+    return Status::OK();
+  }
+  gscoped_ptr<cfile::CFileZoneMapsPB> zone_maps;
+  RETURN_NOT_OK(base_data->ReadColumnZoneMaps(expiry.col_id, &zone_maps));
+  if (!zone_maps || zone_maps->blocks_size() == 0) {
+    return Status::OK();
+  }
+  for (const cfile::BlockZoneMapPB& zone_map : zone_maps->blocks()) {
+    if (zone_map.null_count() > 0 || !zone_map.has_max_value() ||
+        zone_map.max_value().size() != sizeof(int64_t)) {
+      return Status::OK();
+    }
+    int64_t max_micros;
+    memcpy(&max_micros, zone_map.max_value().data(), sizeof(max_micros));
+    if (max_micros >= expiry.cutoff_micros) {
+      return Status::OK();
+    }
+  }
+
+  int64_t updates;
+  RETURN_NOT_OK(delta_tracker_->CountRedoUpdatesForColumn(expiry.col_id, &updates));
+  *expired = updates == 0;
+  return Status::OK();
+}
+
+void DiskRowSet::GetLiveRowRange(rowid_t* begin, rowid_t* end) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  *begin = base_data_->live_row_begin();
+  *end = base_data_->live_row_end();
+}
+
+Status DiskRowSet::FindLiveRowAtOrAfter(const EncodedKey& key, rowid_t* idx) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return base_data_->FindLiveRowAtOrAfter(key, idx);
+}
+
+Status DiskRowSet::OpenNarrowedBaseData(const RowSetLiveRange& live_range,
+                                        shared_ptr<CFileSet>* base_data) const {
+  shared_ptr<CFileSet> new_base(new CFileSet(rowset_metadata_, base_data_reader_options_));
+  RETURN_NOT_OK(new_base->Open());
+  RETURN_NOT_OK(new_base->SetLiveRange(live_range));
+  base_data->swap(new_base);
+  return Status::OK();
+}
+
+void DiskRowSet::SwapInBaseData(shared_ptr<CFileSet> base_data) {
+  DCHECK(open_);
+  // Iterators which were already created keep reading the old base data, so
+  // they continue to see a consistent set of rows.
+  std::lock_guard<percpu_rwlock> lock(component_lock_);
+  base_data_ = std::move(base_data);
+}
+
 Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
                                            gscoped_ptr<MajorDeltaCompaction>* out) const {
   DCHECK(open_);
@@ -563,6 +808,7 @@ Status DiskRowSet::NewMajorDeltaCompaction(const vector<ColumnId>& col_ids,
     &delta_iter));
 
   out->reset(new MajorDeltaCompaction(rowset_metadata_->fs_manager(),
+                                      rowset_metadata_->tablet_metadata()->tablet_id(),
                                       *schema,
                                       base_data_.get(),
                                       std::move(delta_iter),
@@ -637,11 +883,42 @@ Status DiskRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
   return Status::OK();
 }
 
+Status DiskRowSet::CheckRowEverPresent(const RowSetKeyProbe &probe,
+                                       bool* present,
+                                       ProbeStats* stats) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+
+  // Rows only enter a DiskRowSet through its base data, and deletes are
+  // recorded as deltas, so every version of a row is keyed in the base data.
+  rowid_t row_idx;
+  return base_data_->CheckRowPresent(probe, present, &row_idx, stats);
+}
+
 Status DiskRowSet::CountRows(rowid_t *count) const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
 
-  return base_data_->CountRows(count);
+  *count = base_data_->live_row_end() - base_data_->live_row_begin();
+  return Status::OK();
+}
+
+Status DiskRowSet::CountLiveRows(uint64_t* count) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+
+  rowid_t base_count = base_data_->live_row_end() - base_data_->live_row_begin();
+  int64_t deleted_count;
+  RETURN_NOT_OK(delta_tracker_->CountDeletedRows(&deleted_count));
+  if (!rowset_metadata_->has_live_range()) {
+    DCHECK_LE(deleted_count, static_cast<int64_t>(base_count)) << ToString();
+  } else {
+    // The deleted rows which were compacted into other rowsets are still
+    // counted by the delta stores, so this is only an estimate.
+    deleted_count = std::min(deleted_count, static_cast<int64_t>(base_count));
+  }
+  *count = base_count - deleted_count;
+  return Status::OK();
 }
 
 Status DiskRowSet::GetBounds(std::string* min_encoded_key,
@@ -651,12 +928,47 @@ Status DiskRowSet::GetBounds(std::string* min_encoded_key,
   return base_data_->GetBounds(min_encoded_key, max_encoded_key);
 }
 
+Status DiskRowSet::GetIndexKeys(vector<string>* keys) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  return base_data_->GetIndexKeys(keys);
+}
+
+Status DiskRowSet::ExcludedByPredicates(const ScanSpec& spec, bool* excluded) const {
+  DCHECK(open_);
+  *excluded = false;
+  const Schema& schema = rowset_metadata_->tablet_schema();
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  for (const auto& entry : spec.predicates()) {
+    int col_idx = schema.find_column(entry.first);
+    if (col_idx == Schema::kColumnNotFound) {
+      continue;
+    }
+    ColumnId col_id = schema.column_id(col_idx);
+    if (delta_tracker_->MayHaveUpdatesToColumn(col_id)) {
+      continue;
+    }
+    RETURN_NOT_OK(base_data_->ColumnZoneMapExcludes(col_id, entry.second, excluded));
+    if (*excluded) {
+      return Status::OK();
+    }
+  }
+  return Status::OK();
+}
+
 uint64_t DiskRowSet::EstimateBaseDataDiskSize() const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
   return base_data_->EstimateOnDiskSize();
 }
 
+void DiskRowSet::GetBaseDataMemoryUsage(int64_t* consumption,
+                                        size_t* pinned_index_bytes) const {
+  DCHECK(open_);
+  shared_lock<rw_spinlock> l(component_lock_.get_lock());
+  base_data_->GetReaderMemoryUsage(consumption, pinned_index_bytes);
+}
+
 uint64_t DiskRowSet::EstimateDeltaDiskSize() const {
   DCHECK(open_);
   shared_lock<rw_spinlock> l(component_lock_.get_lock());
@@ -693,10 +1005,12 @@ size_t DiskRowSet::CountDeltaStores() const {
 
 // In this implementation, the returned improvement score is 0 if there aren't any redo files to
 // compact or if the base data is empty. After this, with a max score of 1:
-//  - Major compactions: the score will be the result of sizeof(deltas)/sizeof(base data), unless
+//  - Major compactions: the score will be the result of sizeof(deltas)/sizeof(base data) for
+//                       the columns SelectMajorDeltaCompactionColumns() would rewrite, unless
 //                       it is smaller than tablet_delta_store_major_compact_min_ratio or if the
 //                       delta files are only composed of deletes, in which case the score is
-//                       brought down to zero.
+//                       brought down to zero. Scoring only the updated columns keeps a few hot
+//                       columns of a wide table from being diluted by the untouched ones.
 //  - Minor compactions: the score will be zero if there's only 1 redo file, else it will be the
 //                       result of redo_files_count/tablet_delta_store_minor_compact_max. The
 //                       latter is meant to be high since minor compactions don't give us much, so
@@ -705,18 +1019,17 @@ double DiskRowSet::DeltaStoresCompactionPerfImprovementScore(DeltaCompactionType
   DCHECK(open_);
   double perf_improv = 0;
   size_t store_count = CountDeltaStores();
-  uint64_t base_data_size = EstimateBaseDataDiskSize();
 
   if (store_count == 0) {
     return perf_improv;
   }
 
   if (type == RowSet::MAJOR_DELTA_COMPACTION) {
-    vector<ColumnId> col_ids_with_updates;
-    delta_tracker_->GetColumnIdsWithUpdates(&col_ids_with_updates);
+    vector<ColumnId> col_ids;
+    double ratio;
+    SelectMajorDeltaCompactionColumns(&col_ids, &ratio);
     // If we have files but no updates, we don't want to major compact.
-    if (!col_ids_with_updates.empty()) {
-      double ratio = static_cast<double>(EstimateDeltaDiskSize()) / base_data_size;
+    if (!col_ids.empty()) {
       if (ratio >= FLAGS_tablet_delta_store_major_compact_min_ratio) {
         perf_improv = ratio;
       }
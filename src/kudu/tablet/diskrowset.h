@@ -28,6 +28,8 @@
 #include <string>
 #include <vector>
 
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/cfile_util.h"
 #include "kudu/common/row.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_manager.h"
@@ -41,10 +43,12 @@
 
 namespace kudu {
 
+class ColumnStatsCollector;
 class FsManager;
 class MemTracker;
 class RowBlock;
 class RowChangeList;
+class ThreadPool;
 
 namespace cfile {
 class BloomFileWriter;
@@ -64,12 +68,17 @@ class DeltaTracker;
 class MultiColumnWriter;
 class Mutation;
 class OperationResultPB;
+struct RowExpiry;
 
 class DiskRowSetWriter {
  public:
   // TODO: document ownership of rowset_metadata
+  //
+  // If 'encode_pool' is set, the columns are encoded on it in parallel. See
+  // MultiColumnWriter.
   DiskRowSetWriter(RowSetMetadata* rowset_metadata, const Schema* schema,
-                   BloomFilterSizing bloom_sizing);
+                   BloomFilterSizing bloom_sizing,
+                   ThreadPool* encode_pool = nullptr);
 
   ~DiskRowSetWriter();
 
@@ -102,6 +111,11 @@ class DiskRowSetWriter {
   // a reasonable estimate for the total data size.
   size_t written_size() const;
 
+  // Add the dictionary statistics of the dictionary encoded columns to 'stats'.
+  //
+  // REQUIRES: Finish() already called.
+  void GetDictEncodingStats(cfile::DictEncodingStatsPB* stats) const;
+
   const Schema& schema() const { return *schema_; }
 
  private:
@@ -122,12 +136,18 @@ class DiskRowSetWriter {
 
   BloomFilterSizing bloom_sizing_;
 
+  // Not owned. May be NULL.
+  ThreadPool* const encode_pool_;
+
   bool finished_;
   rowid_t written_count_;
   gscoped_ptr<MultiColumnWriter> col_writer_;
   gscoped_ptr<cfile::BloomFileWriter> bloom_writer_;
   gscoped_ptr<cfile::CFileWriter> ad_hoc_index_writer_;
 
+  // The collectors of the statistics of each column, if they're collected.
+  std::vector<std::unique_ptr<ColumnStatsCollector>> stats_collectors_;
+
   // The last encoded key written.
   faststring last_encoded_key_;
 };
@@ -143,9 +163,14 @@ class RollingDiskRowSetWriter {
   // Create a new rolling writer. The given 'tablet_metadata' must stay valid
   // for the lifetime of this writer, and is used to construct the new rowsets
   // that this RollingDiskRowSetWriter creates.
+  //
+  // If 'encode_pool' is set, the columns of each rowset are encoded on it in
+  // parallel, while key encoding, the bloom filter and the deltas are still
+  // written by the appending thread.
   RollingDiskRowSetWriter(TabletMetadata* tablet_metadata, const Schema& schema,
                           BloomFilterSizing bloom_sizing,
-                          size_t target_rowset_size);
+                          size_t target_rowset_size,
+                          ThreadPool* encode_pool = nullptr);
   ~RollingDiskRowSetWriter();
 
   Status Open();
@@ -195,6 +220,10 @@ class RollingDiskRowSetWriter {
 
   uint64_t written_size() const { return written_size_; }
 
+  // Return the dictionary statistics of the dictionary encoded columns of
+  // the rowsets written so far.
+  const cfile::DictEncodingStatsPB& dict_stats() const { return dict_stats_; }
+
  private:
   Status RollWriter();
 
@@ -222,6 +251,9 @@ class RollingDiskRowSetWriter {
   const BloomFilterSizing bloom_sizing_;
   const size_t target_rowset_size_;
 
+  // Not owned. May be NULL.
+  ThreadPool* const encode_pool_;
+
   gscoped_ptr<DiskRowSetWriter> cur_writer_;
 
   // A delta writer to store the undos for each DRS
@@ -245,6 +277,7 @@ class RollingDiskRowSetWriter {
 
   int64_t written_count_;
   uint64_t written_size_;
+  cfile::DictEncodingStatsPB dict_stats_;
 
   // Syncs and closes all outstanding blocks when the rolling writer is
   // destroyed.
@@ -265,6 +298,10 @@ class DiskRowSet : public RowSet {
   static const char *kMinKeyMetaEntryName;
   static const char *kMaxKeyMetaEntryName;
 
+  // The id of the MemTracker, under the tablet's, which accounts for the
+  // memory used by the readers of the base data of the tablet's rowsets.
+  static const char *kCFileReaderMemTrackerId;
+
   // Open a rowset from disk.
   // If successful, sets *rowset to the newly open rowset
   static Status Open(const std::shared_ptr<RowSetMetadata>& rowset_metadata,
@@ -285,6 +322,13 @@ class DiskRowSet : public RowSet {
   // If there is already only a single delta file, this does nothing.
   Status MinorCompactDeltaStores() OVERRIDE;
 
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas(
+      Timestamp ancient_history_mark) const OVERRIDE;
+
+  Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                 int64_t* blocks_deleted,
+                                 int64_t* bytes_deleted) OVERRIDE;
+
   ////////////////////////////////////////////////////////////
   // RowSet implementation
   ////////////////////////////////////////////////////////////
@@ -307,6 +351,10 @@ class DiskRowSet : public RowSet {
                          bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  Status CheckRowEverPresent(const RowSetKeyProbe &probe,
+                             bool *present,
+                             ProbeStats* stats) const OVERRIDE;
+
   ////////////////////
   // Read functions.
   ////////////////////
@@ -318,16 +366,31 @@ class DiskRowSet : public RowSet {
                                     const MvccSnapshot &snap,
                                     gscoped_ptr<CompactionInput>* out) const OVERRIDE;
 
-  // Count the number of rows in this rowset.
+  // Count the number of rows in this rowset. Rows which a range-sliced
+  // compaction moved into other rowsets aren't counted.
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  // See RowSet::CountLiveRows(...)
+  Status CountLiveRows(uint64_t* count) const OVERRIDE;
+
   // See RowSet::GetBounds(...)
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
+  // See RowSet::GetIndexKeys(...)
+  Status GetIndexKeys(std::vector<std::string>* keys) const OVERRIDE;
+
+  // See RowSet::ExcludedByPredicates(...). Uses the zone maps of the CFiles
+  // of the predicates' columns, unless the delta stores may hold updates to
+  // them.
+  Status ExcludedByPredicates(const ScanSpec& spec, bool* excluded) const OVERRIDE;
+
   // Estimate the number of bytes on-disk for the base data.
   uint64_t EstimateBaseDataDiskSize() const;
 
+  // See CFileSet::GetReaderMemoryUsage().
+  void GetBaseDataMemoryUsage(int64_t* consumption, size_t* pinned_index_bytes) const;
+
   // Estimate the number of bytes on-disk for the delta stores.
   uint64_t EstimateDeltaDiskSize() const;
 
@@ -345,9 +408,33 @@ class DiskRowSet : public RowSet {
 
   double DeltaStoresCompactionPerfImprovementScore(DeltaCompactionType type) const OVERRIDE;
 
-  // Major compacts all the delta files for all the columns.
+  // Major compacts all the delta files for the columns which are updated
+  // often enough to be worth rewriting. See SelectMajorDeltaCompactionColumns().
   Status MajorCompactDeltaStores();
 
+  // Selects the columns a major delta compaction should rewrite: those whose
+  // update count is at least --tablet_delta_store_major_compact_min_column_update_ratio
+  // of the most-updated column's. Columns with only a few updates are left to
+  // their delta files rather than paying to rewrite their base data.
+  //
+  // If 'ratio' is non-NULL, it is set to the estimated size of the selected
+  // columns' deltas divided by the size of their base data.
+  void SelectMajorDeltaCompactionColumns(std::vector<ColumnId>* col_ids,
+                                         double* ratio) const;
+
+  // Sets 'col_ids' to the non-key columns whose base data was written with an
+  // encoding or compression other than the one the tablet schema now asks
+  // for, e.g. because the column was altered since. Reads the footers of the
+  // columns' CFiles which haven't been read yet.
+  Status FindColumnsToReencode(std::vector<ColumnId>* col_ids) const;
+
+  // Sets '*expired' to true if every row of the rowset has expired according
+  // to 'expiry', going by the zone maps of the base data of its TTL column,
+  // and no REDO delta updates that column. A rowset with unflushed deltas is
+  // never considered expired. Reads the zone maps, and the stats of the
+  // REDO delta files which haven't been opened yet.
+  Status AllRowsExpired(const RowExpiry& expiry, bool* expired) const;
+
   std::mutex *compact_flush_lock() OVERRIDE {
     return &compact_flush_lock_;
   }
@@ -387,6 +474,19 @@ class DiskRowSet : public RowSet {
   // Major compacts all the delta files for the specified columns.
   Status MajorCompactDeltaStoresWithColumnIds(const std::vector<ColumnId>& col_ids);
 
+  // Sets '*begin' and '*end' to the ordinals of the live rows, [begin, end).
+  void GetLiveRowRange(rowid_t* begin, rowid_t* end) const;
+
+  // See CFileSet::FindLiveRowAtOrAfter().
+  Status FindLiveRowAtOrAfter(const EncodedKey& key, rowid_t* idx) const;
+
+  // Opens the base data anew, narrowed to 'live_range', for a range-sliced
+  // compaction which keeps those rows in this rowset. The new base data only
+  // becomes visible to readers and writers in SwapInBaseData().
+  Status OpenNarrowedBaseData(const RowSetLiveRange& live_range,
+                              std::shared_ptr<CFileSet>* base_data) const;
+  void SwapInBaseData(std::shared_ptr<CFileSet> base_data);
+
   std::shared_ptr<RowSetMetadata> rowset_metadata_;
 
   bool open_;
@@ -395,6 +495,9 @@ class DiskRowSet : public RowSet {
 
   std::shared_ptr<MemTracker> parent_tracker_;
 
+  // The options the files of the base data are opened with.
+  cfile::ReaderOptions base_data_reader_options_;
+
   // Base data for this rowset.
   mutable percpu_rwlock component_lock_;
   std::shared_ptr<CFileSet> base_data_;
@@ -20,8 +20,10 @@
 #include <gtest/gtest.h>
 #include <memory>
 #include <mutex>
+#include <thread>
 #include <vector>
 
+#include "kudu/gutil/bind.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/tablet/lock_manager.h"
 #include "kudu/util/env.h"
@@ -92,6 +94,85 @@ TEST_F(LockManagerTest, TestRelockSameRow) {
   VerifyAlreadyLocked(key_a);
 }
 
+TEST_F(LockManagerTest, TestAcquireAll) {
+  // Enough keys to spread across all of the lock table's partitions and
+  // make them resize, plus a repeated key.
+  vector<string> key_strs;
+  for (int i = 0; i < 1000; i++) {
+    key_strs.push_back(StringPrintf("key%04d", (i * 7919) % 1000));
+  }
+  key_strs.push_back(key_strs[0]);
+  vector<Slice> keys(key_strs.begin(), key_strs.end());
+
+  {
+    vector<ScopedRowLock> locks;
+    ScopedRowLock::AcquireAll(&lock_manager_, kFakeTransaction, keys,
+                              LockManager::LOCK_EXCLUSIVE, &locks);
+    ASSERT_EQ(keys.size(), locks.size());
+    for (int i = 0; i < keys.size(); i++) {
+      ASSERT_TRUE(locks[i].acquired());
+      NO_FATALS(VerifyAlreadyLocked(keys[i]));
+    }
+  }
+
+  // Once released, all of the keys can be locked again.
+  for (const Slice& key : keys) {
+    ScopedRowLock l(&lock_manager_, kFakeTransaction, key, LockManager::LOCK_EXCLUSIVE);
+    ASSERT_TRUE(l.acquired());
+  }
+}
+
+static void ReleaseRowLock(ScopedRowLock* lock, int* num_calls) {
+  (*num_calls)++;
+  lock->Release();
+}
+
+// The callback passed to AcquireAll() is run once, and only if one of the
+// locks is held by another transaction.
+TEST_F(LockManagerTest, TestAcquireAllBeforeWaitCallback) {
+  const TransactionState* other_txn = reinterpret_cast<const TransactionState*>(0x1);
+  vector<Slice> keys = { Slice("a"), Slice("b"), Slice("c") };
+  int num_calls = 0;
+  ScopedRowLock held(&lock_manager_, other_txn, keys[2], LockManager::LOCK_EXCLUSIVE);
+
+  {
+    vector<ScopedRowLock> locks;
+    ScopedRowLock::AcquireAll(&lock_manager_, kFakeTransaction, { keys[0], keys[1] },
+                              LockManager::LOCK_EXCLUSIVE, &locks,
+                              Bind(&ReleaseRowLock, &held, &num_calls));
+    ASSERT_EQ(0, num_calls);
+  }
+
+  // The callback releases the lock it's waiting for, so this doesn't block.
+  vector<ScopedRowLock> locks;
+  ScopedRowLock::AcquireAll(&lock_manager_, kFakeTransaction, keys,
+                            LockManager::LOCK_EXCLUSIVE, &locks,
+                            Bind(&ReleaseRowLock, &held, &num_calls));
+  ASSERT_EQ(1, num_calls);
+  for (const ScopedRowLock& lock : locks) {
+    ASSERT_TRUE(lock.acquired());
+  }
+}
+
+// Two transactions locking the same keys given in opposite orders must not
+// deadlock when they use AcquireAll().
+TEST_F(LockManagerTest, TestAcquireAllOppositeOrders) {
+  vector<Slice> forward = { Slice("a"), Slice("b"), Slice("c") };
+  vector<Slice> backward(forward.rbegin(), forward.rend());
+  auto worker = [&](const vector<Slice>& keys, const TransactionState* tx) {
+    for (int i = 0; i < FLAGS_num_iterations; i++) {
+      vector<ScopedRowLock> locks;
+      ScopedRowLock::AcquireAll(&lock_manager_, tx, keys, LockManager::LOCK_EXCLUSIVE, &locks);
+    }
+  };
+  std::thread t1(worker, std::cref(forward),
+                 reinterpret_cast<const TransactionState*>(0x1));
+  std::thread t2(worker, std::cref(backward),
+                 reinterpret_cast<const TransactionState*>(0x2));
+  t1.join();
+  t2.join();
+}
+
 TEST_F(LockManagerTest, TestMoveLock) {
   // Acquire a lock.
   Slice key_a("a");
@@ -17,14 +17,17 @@
 
 #include "kudu/tablet/lock_manager.h"
 
+#include <algorithm>
 #include <glog/logging.h>
 #include <mutex>
 #include <semaphore.h>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/dynamic_annotations.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/semaphore.h"
@@ -33,6 +36,8 @@
 namespace kudu {
 namespace tablet {
 
+using std::vector;
+
 class TransactionState;
 
 // ============================================================================
@@ -91,6 +96,14 @@ class LockEntry {
   const TransactionState* holder_;
 };
 
+// A hash table of the currently-held lock entries.
+//
+// The table is split into independent partitions, selected by the top bits
+// of each key's hash, so that concurrent writers to a tablet mostly touch
+// different cache lines: each partition has its own buckets, its own entry
+// count and is resized on its own. Within a partition, each bucket has its
+// own spinlock. The per-CPU 'lock_' is only taken exclusively to resize a
+// partition, which happens rarely since partitions only grow by doubling.
 class LockTable {
  private:
   struct Bucket {
@@ -100,17 +113,38 @@ class LockTable {
     Bucket() : chain_head(nullptr) {}
   };
 
+  struct Partition {
+    Partition() : mask(0), size(0), item_count(0) {}
+
+    // size - 1 used to lookup the bucket (hash & mask)
+    uint64_t mask;
+    // number of buckets in the partition
+    uint64_t size;
+    // partition buckets
+    gscoped_array<Bucket> buckets;
+    // number of items in the partition
+    base::subtle::Atomic64 item_count;
+  } CACHELINE_ALIGNED;
+
  public:
-  LockTable() : mask_(0), size_(0), item_count_(0) {
-    Resize();
+  // The number of partitions, as a power of two.
+  static const int kPartitionBits = 4;
+  static const int kNumPartitions = 1 << kPartitionBits;
+
+  LockTable() {
+    for (Partition& p : partitions_) {
+      Resize(&p);
+    }
   }
 
   ~LockTable() {
     // Sanity checks: The table shouldn't be destructed when there are any entries in it.
-    DCHECK_EQ(0, NoBarrier_Load(&(item_count_))) << "There are some unreleased locks";
-    for (size_t i = 0; i < size_; ++i) {
-      for (LockEntry *p = buckets_[i].chain_head; p != nullptr; p = p->ht_next_) {
-        DCHECK(p == nullptr) << "The entry " << p->ToString() << " was not released";
+    for (const Partition& p : partitions_) {
+      DCHECK_EQ(0, NoBarrier_Load(&(p.item_count))) << "There are some unreleased locks";
+      for (size_t i = 0; i < p.size; ++i) {
+        for (LockEntry *e = p.buckets[i].chain_head; e != nullptr; e = e->ht_next_) {
+          DCHECK(e == nullptr) << "The entry " << e->ToString() << " was not released";
+        }
       }
     }
   }
@@ -119,8 +153,14 @@ class LockTable {
   void ReleaseLockEntry(LockEntry *entry);
 
  private:
-  Bucket *FindBucket(uint64_t hash) const {
-    return &(buckets_[hash & mask_]);
+  Partition *FindPartition(uint64_t hash) {
+    // The bucket within a partition is chosen by the low bits, so use the
+    // high bits here to keep the two independent.
+    return &partitions_[hash >> (64 - kPartitionBits)];
+  }
+
+  static Bucket *FindBucket(const Partition *partition, uint64_t hash) {
+    return &(partition->buckets[hash & partition->mask]);
   }
 
   // Return a pointer to slot that points to a lock entry that
@@ -146,28 +186,25 @@ class LockTable {
     return nullptr;
   }
 
-  void Resize();
+  // Grow 'partition' to fit its entries. Requires 'lock_' to be held
+  // exclusively, or the table to not yet be shared.
+  static void Resize(Partition *partition);
 
  private:
   // table rwlock used as write on resize
   percpu_rwlock lock_;
-  // size - 1 used to lookup the bucket (hash & mask_)
-  uint64_t mask_;
-  // number of buckets in the table
-  uint64_t size_;
-  // table buckets
-  gscoped_array<Bucket> buckets_;
-  // number of items in the table
-  base::subtle::Atomic64 item_count_;
+  // table partitions
+  Partition partitions_[kNumPartitions];
 };
 
 LockEntry *LockTable::GetLockEntry(const Slice& key) {
   auto new_entry = new LockEntry(key);
   LockEntry *old_entry;
+  Partition *partition = FindPartition(new_entry->key_hash_);
 
   {
     shared_lock<rw_spinlock> l(lock_.get_lock());
-    Bucket *bucket = FindBucket(new_entry->key_hash_);
+    Bucket *bucket = FindBucket(partition, new_entry->key_hash_);
     {
       std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
       LockEntry **node = FindSlot(bucket, new_entry->key_, new_entry->key_hash_);
@@ -187,12 +224,13 @@ LockEntry *LockTable::GetLockEntry(const Slice& key) {
     return old_entry;
   }
 
-  if (base::subtle::NoBarrier_AtomicIncrement(&item_count_, 1) > size_) {
+  if (base::subtle::NoBarrier_AtomicIncrement(&partition->item_count, 1) >
+      ANNOTATE_UNPROTECTED_READ(partition->size)) {
     std::unique_lock<percpu_rwlock> table_wrlock(lock_, std::try_to_lock);
     // if we can't take the lock, means that someone else is resizing.
     // (The percpu_rwlock try_lock waits for readers to complete)
     if (table_wrlock.owns_lock()) {
-      Resize();
+      Resize(partition);
     }
   }
 
@@ -201,9 +239,10 @@ LockEntry *LockTable::GetLockEntry(const Slice& key) {
 
 void LockTable::ReleaseLockEntry(LockEntry *entry) {
   bool removed = false;
+  Partition *partition = FindPartition(entry->key_hash_);
   {
-    std::lock_guard<rw_spinlock> table_rdlock(lock_.get_lock());
-    Bucket *bucket = FindBucket(entry->key_hash_);
+    shared_lock<rw_spinlock> table_rdlock(lock_.get_lock());
+    Bucket *bucket = FindBucket(partition, entry->key_hash_);
     {
       std::lock_guard<simple_spinlock> bucket_lock(bucket->lock);
       LockEntry **node = FindEntry(bucket, entry);
@@ -220,18 +259,18 @@ void LockTable::ReleaseLockEntry(LockEntry *entry) {
   }
 
   DCHECK(removed) << "Unable to find LockEntry on release";
-  base::subtle::NoBarrier_AtomicIncrement(&item_count_, -1);
+  base::subtle::NoBarrier_AtomicIncrement(&partition->item_count, -1);
   delete entry;
 }
 
-void LockTable::Resize() {
-  // Calculate a new table size
+void LockTable::Resize(Partition *partition) {
+  // Calculate a new partition size
   size_t new_size = 16;
-  while (new_size < base::subtle::NoBarrier_Load(&item_count_)) {
+  while (new_size < base::subtle::NoBarrier_Load(&partition->item_count)) {
     new_size <<= 1;
   }
 
-  if (PREDICT_FALSE(size_ >= new_size))
+  if (PREDICT_FALSE(partition->size >= new_size))
     return;
 
   // Allocate a new bucket list
@@ -239,8 +278,8 @@ void LockTable::Resize() {
   size_t new_mask = new_size - 1;
 
   // Copy entries
-  for (size_t i = 0; i < size_; ++i) {
-    LockEntry *p = buckets_[i].chain_head;
+  for (size_t i = 0; i < partition->size; ++i) {
+    LockEntry *p = partition->buckets[i].chain_head;
     while (p != nullptr) {
       LockEntry *next = p->ht_next_;
 
@@ -254,9 +293,9 @@ void LockTable::Resize() {
   }
 
   // Swap the bucket
-  mask_ = new_mask;
-  size_ = new_size;
-  buckets_.swap(new_buckets);
+  partition->mask = new_mask;
+  partition->size = new_size;
+  partition->buckets.swap(new_buckets);
 }
 
 // ============================================================================
@@ -267,9 +306,17 @@ ScopedRowLock::ScopedRowLock(LockManager *manager,
                              const TransactionState* tx,
                              const Slice &key,
                              LockManager::LockMode mode)
+  : ScopedRowLock(manager, tx, key, mode, nullptr) {
+}
+
+ScopedRowLock::ScopedRowLock(LockManager *manager,
+                             const TransactionState* tx,
+                             const Slice &key,
+                             LockManager::LockMode mode,
+                             Closure* before_wait)
   : manager_(DCHECK_NOTNULL(manager)),
     acquired_(false) {
-  ls_ = manager_->Lock(key, tx, mode, &entry_);
+  ls_ = manager_->Lock(key, tx, mode, &entry_, before_wait);
 
   if (ls_ == LockManager::LOCK_ACQUIRED) {
     acquired_ = true;
@@ -280,6 +327,28 @@ ScopedRowLock::ScopedRowLock(LockManager *manager,
   }
 }
 
+void ScopedRowLock::AcquireAll(LockManager *manager,
+                               const TransactionState* ctx,
+                               const vector<Slice>& keys,
+                               LockManager::LockMode mode,
+                               vector<ScopedRowLock>* locks,
+                               const Closure& before_wait) {
+  vector<int> order(keys.size());
+  for (int i = 0; i < keys.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](int a, int b) {
+    return keys[a].compare(keys[b]) < 0;
+  });
+
+  locks->clear();
+  locks->resize(keys.size());
+  Closure wait_callback = before_wait;
+  for (int i : order) {
+    (*locks)[i] = ScopedRowLock(manager, ctx, keys[i], mode, &wait_callback);
+  }
+}
+
 ScopedRowLock::ScopedRowLock(ScopedRowLock&& other) {
   TakeState(&other);
 }
@@ -326,7 +395,8 @@ LockManager::~LockManager() {
 LockManager::LockStatus LockManager::Lock(const Slice& key,
                                           const TransactionState* tx,
                                           LockManager::LockMode mode,
-                                          LockEntry** entry) {
+                                          LockEntry** entry,
+                                          Closure* before_wait) {
   *entry = locks_->GetLockEntry(key);
 
   // We expect low contention, so just try to try_lock first. This is faster
@@ -351,6 +421,11 @@ LockManager::LockStatus LockManager::Lock(const Slice& key,
     // warn if it takes a long time.
     // TODO: would be nice to hook in some histogram metric about lock acquisition
     // time. For now we just associate with per-request metrics.
+    if (before_wait && !before_wait->is_null()) {
+      before_wait->Run();
+      before_wait->Reset();
+    }
+
     TRACE_COUNTER_INCREMENT("row_lock_wait_count", 1);
     MicrosecondsInt64 start_wait_us = GetMonoTimeMicros();
     int waited_seconds = 0;
@@ -17,6 +17,9 @@
 #ifndef KUDU_TABLET_LOCK_MANAGER_H
 #define KUDU_TABLET_LOCK_MANAGER_H
 
+#include <vector>
+
+#include "kudu/gutil/callback.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/move.h"
 #include "kudu/util/slice.h"
@@ -30,7 +33,8 @@ class TransactionState;
 
 // Super-simple lock manager implementation. This only supports exclusive
 // locks, and makes no attempt to prevent deadlocks if a single thread
-// takes multiple locks.
+// takes multiple locks one at a time; use ScopedRowLock::AcquireAll() to
+// take several locks safely.
 //
 // In the future when we want to support multi-row transactions of some kind
 // we'll have to implement a proper lock manager with all its trappings,
@@ -53,8 +57,10 @@ class LockManager {
   friend class ScopedRowLock;
   friend class LockManagerTest;
 
+  // If the lock is held by another transaction and 'before_wait' is set, it's
+  // run and reset before waiting for the lock.
   LockStatus Lock(const Slice& key, const TransactionState* tx,
-                  LockMode mode, LockEntry **entry);
+                  LockMode mode, LockEntry **entry, Closure* before_wait = nullptr);
   LockStatus TryLock(const Slice& key, const TransactionState* tx,
                      LockMode mode, LockEntry **entry);
   void Release(LockEntry *lock, LockStatus ls);
@@ -107,6 +113,22 @@ class ScopedRowLock {
   ScopedRowLock(ScopedRowLock&& other);
   ScopedRowLock& operator=(ScopedRowLock&& other);
 
+  // Lock each of 'keys' in the given LockManager on behalf of 'ctx',
+  // blocking until all are held. On return, (*locks)[i] holds the lock on
+  // keys[i]. Keys may repeat. As with the constructor, each key slice must
+  // remain valid for the lifetime of its lock.
+  //
+  // The locks are taken in ascending key order, whatever the order of
+  // 'keys', so transactions which take their locks this way can never
+  // deadlock against one another.
+  //
+  // If one of the locks is held by another transaction, 'before_wait' is run,
+  // if set, before waiting for it. It's run at most once.
+  static void AcquireAll(LockManager *manager, const TransactionState* ctx,
+                         const std::vector<Slice>& keys, LockManager::LockMode mode,
+                         std::vector<ScopedRowLock>* locks,
+                         const Closure& before_wait = Closure());
+
   void Release();
 
   bool acquired() const { return acquired_; }
@@ -116,6 +138,9 @@ class ScopedRowLock {
   ~ScopedRowLock();
 
  private:
+  ScopedRowLock(LockManager *manager, const TransactionState* ctx,
+                const Slice &key, LockManager::LockMode mode, Closure* before_wait);
+
   void TakeState(ScopedRowLock* other);
 
   LockManager *manager_;
@@ -23,16 +23,20 @@
 
 #include "kudu/common/generic_iterators.h"
 #include "kudu/common/partial_row.h"
+#include "kudu/gutil/casts.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/server/logical_clock.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/tablet/delta_compaction.h"
+#include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/tablet-test-util.h"
 #include "kudu/tablet/diskrowset-test-base.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_bool(cfile_lazy_open);
+
 using std::shared_ptr;
 using std::unordered_set;
 
@@ -213,6 +217,53 @@ TEST_F(TestMajorDeltaCompaction, TestCompact) {
   }
 }
 
+// Verifies that a major delta compaction picked by the rowset only rewrites
+// the columns which are updated often, and carries the others' deltas over.
+TEST_F(TestMajorDeltaCompaction, TestSelectColumnsByUpdateCount) {
+  // Stats are only read from delta files which are open.
+  FLAGS_cfile_lazy_open = false;
+  const int kNumRows = 100;
+  ASSERT_NO_FATAL_FAILURE(WriteTestTablet(kNumRows));
+  ASSERT_OK(tablet()->Flush());
+
+  vector<shared_ptr<RowSet> > all_rowsets;
+  tablet()->GetRowSetsForTests(&all_rowsets);
+  DiskRowSet* drs = down_cast<DiskRowSet*>(all_rowsets.front().get());
+
+  // Update val1 in every row, but val3 in just one.
+  {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    for (int idx = 0; idx < kNumRows; idx++) {
+      KuduPartialRow prow(&client_schema_);
+      ExpectedRow* row = &expected_state_[idx];
+      CHECK_OK(prow.SetString(0, row->key));
+      row->val1++;
+      CHECK_OK(prow.SetInt32(1, row->val1));
+      if (idx == 0) {
+        row->val3++;
+        CHECK_OK(prow.SetInt32(3, row->val3));
+      }
+      ASSERT_OK(writer.Update(prow));
+    }
+  }
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  ASSERT_NO_FATAL_FAILURE(VerifyData());
+
+  vector<ColumnId> col_ids;
+  double ratio;
+  drs->SelectMajorDeltaCompactionColumns(&col_ids, &ratio);
+  ASSERT_EQ(vector<ColumnId>({ schema_.column_id(1) }), col_ids);
+  ASSERT_GT(ratio, 0);
+
+  ASSERT_OK(drs->MajorCompactDeltaStores());
+  ASSERT_NO_FATAL_FAILURE(VerifyData());
+
+  // Only the val3 update remains in the deltas.
+  vector<ColumnId> col_ids_with_updates;
+  drs->delta_tracker()->GetColumnIdsWithUpdates(&col_ids_with_updates);
+  ASSERT_EQ(vector<ColumnId>({ schema_.column_id(3) }), col_ids_with_updates);
+}
+
 // Verify that we do issue UNDO files and that we can read them.
 TEST_F(TestMajorDeltaCompaction, TestUndos) {
   const int kNumRows = 100;
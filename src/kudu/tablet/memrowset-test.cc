@@ -30,6 +30,7 @@
 #include "kudu/util/test_macros.h"
 
 DECLARE_bool(enable_data_block_fsync);
+DECLARE_bool(mrs_use_columnar_scan);
 DEFINE_int32(roundtrip_num_rows, 10000,
              "Number of rows to use for the round-trip test");
 DEFINE_int32(num_scan_passes, 1,
@@ -519,5 +520,54 @@ TEST_F(TestMemRowSet, TestUpdateMVCC) {
   }
 }
 
+// Test that the columnar scan path returns the same results as the row-wise
+// one, including rows with mutations, uncommitted rows and projected defaults.
+TEST_F(TestMemRowSet, TestColumnarScanMatchesRowwise) {
+  shared_ptr<MemRowSet> mrs(new MemRowSet(0, schema_, log_anchor_registry_.get()));
+
+  const int kNumRows = 250;
+  vector<MvccSnapshot> snapshots;
+  for (int i = 0; i < kNumRows; i++) {
+    ASSERT_OK(InsertRow(mrs.get(), StringPrintf("row %03d", i), i));
+    if (i == kNumRows / 2) {
+      snapshots.push_back(MvccSnapshot(mvcc_));
+    }
+  }
+  for (int i = 0; i < kNumRows; i += 7) {
+    OperationResultPB result;
+    ASSERT_OK(UpdateRow(mrs.get(), StringPrintf("row %03d", i), i * 1000, &result));
+  }
+  for (int i = 0; i < kNumRows; i += 11) {
+    OperationResultPB result;
+    ASSERT_OK(DeleteRow(mrs.get(), StringPrintf("row %03d", i), &result));
+    if (i % 2 == 0) {
+      ASSERT_OK(InsertRow(mrs.get(), StringPrintf("row %03d", i), i + 1));
+    }
+  }
+  snapshots.push_back(MvccSnapshot(mvcc_));
+
+  // A projection with a column missing from the memrowset's schema.
+  SchemaBuilder builder(schema_);
+  uint32_t default_val = 42;
+  ASSERT_OK(builder.AddColumn("extra", UINT32, false, &default_val, &default_val));
+  ASSERT_OK(builder.AddNullableColumn("extra_nullable", STRING));
+  Schema default_projection = builder.Build();
+
+  vector<const Schema*> projections = { &schema_, &key_schema_, &default_projection };
+  for (const Schema* projection : projections) {
+    for (const MvccSnapshot& snap : snapshots) {
+      SCOPED_TRACE(projection->ToString() + " @ " + snap.ToString());
+      vector<string> rowwise_rows;
+      vector<string> columnar_rows;
+      FLAGS_mrs_use_columnar_scan = false;
+      ASSERT_OK(DumpRowSet(*mrs, *projection, snap, &rowwise_rows));
+      FLAGS_mrs_use_columnar_scan = true;
+      ASSERT_OK(DumpRowSet(*mrs, *projection, snap, &columnar_rows));
+      ASSERT_FALSE(rowwise_rows.empty());
+      ASSERT_EQ(rowwise_rows, columnar_rows);
+    }
+  }
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -17,12 +17,15 @@
 
 #include "kudu/tablet/memrowset.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <string>
 #include <vector>
 
 #include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/predicate_evaluator.h"
+#include "kudu/codegen/row_key_coder.h"
 #include "kudu/codegen/row_projector.h"
 #include "kudu/common/common.pb.h"
 #include "kudu/common/generic_iterators.h"
@@ -39,6 +42,28 @@ DEFINE_bool(mrs_use_codegen, true, "whether the memrowset should use code "
             "generation for iteration");
 TAG_FLAG(mrs_use_codegen, hidden);
 
+DEFINE_bool(mrs_use_columnar_scan, false,
+            "Whether memrowset scans should project each block of rows one "
+            "column at a time rather than one row at a time. This is mostly "
+            "beneficial for append-heavy workloads whose rows are rarely updated.");
+TAG_FLAG(mrs_use_columnar_scan, experimental);
+TAG_FLAG(mrs_use_columnar_scan, runtime);
+
+DEFINE_bool(mrs_use_codegen_predicates, true,
+            "Whether memrowset scans should evaluate their predicates with "
+            "code-generated evaluators. Scans fall back to the interpreted "
+            "predicates while the evaluator is being compiled.");
+TAG_FLAG(mrs_use_codegen_predicates, experimental);
+TAG_FLAG(mrs_use_codegen_predicates, runtime);
+
+DEFINE_bool(memstore_arena_huge_pages, false,
+            "Whether the arenas of MemRowSets and DeltaMemStores take their "
+            "chunks of 2MB or more from huge pages, which are recycled rather "
+            "than returned to the OS once the store is flushed. Reduces TLB "
+            "misses when scanning large in-memory stores.");
+TAG_FLAG(memstore_arena_huge_pages, advanced);
+TAG_FLAG(memstore_arena_huge_pages, experimental);
+
 using std::pair;
 using std::shared_ptr;
 
@@ -91,15 +116,23 @@ MemRowSet::MemRowSet(int64_t id,
     schema_(schema),
     parent_tracker_(parent_tracker),
     mem_tracker_(CreateMemTrackerForMemRowSet(id, parent_tracker)),
-    allocator_(new MemoryTrackingBufferAllocator(HeapBufferAllocator::Get(), mem_tracker_)),
+    allocator_(new MemoryTrackingBufferAllocator(
+        FLAGS_memstore_arena_huge_pages ?
+            static_cast<BufferAllocator*>(HugePageBufferAllocator::Get()) :
+            HeapBufferAllocator::Get(),
+        mem_tracker_)),
     arena_(new ThreadSafeMemoryTrackingArena(kInitialArenaSize, kMaxArenaBufferSize,
                                              allocator_)),
     tree_(arena_),
     debug_insert_count_(0),
     debug_update_count_(0),
+    live_row_count_(0),
     has_logged_throttling_(false),
     anchorer_(log_anchor_registry, Substitute("MemRowSet-$0", id_)) {
   CHECK(schema.has_column_ids());
+  if (FLAGS_mrs_use_codegen) {
+    codegen::CompilationManager::GetSingleton()->RequestRowKeyCoder(&schema_, &key_coder_);
+  }
   ANNOTATE_BENIGN_RACE(&debug_insert_count_, "insert count isnt accurate");
   ANNOTATE_BENIGN_RACE(&debug_update_count_, "update count isnt accurate");
 }
@@ -133,8 +166,7 @@ Status MemRowSet::Insert(Timestamp timestamp,
 
   {
     faststring enc_key_buf;
-    schema_.EncodeComparableKey(row, &enc_key_buf);
-    Slice enc_key(enc_key_buf);
+    Slice enc_key = EncodeKey(row, &enc_key_buf);
 
     btree::PreparedMutation<MSBTreeTraits> mutation(enc_key);
     mutation.Prepare(&tree_);
@@ -171,9 +203,17 @@ Status MemRowSet::Insert(Timestamp timestamp,
   anchorer_.AnchorIfMinimum(op_id.index());
 
   debug_insert_count_++;
+  live_row_count_.Increment();
   return Status::OK();
 }
 
+Slice MemRowSet::EncodeKey(const ConstContiguousRow& row, faststring* dst) const {
+  if (key_coder_) {
+    return key_coder_->EncodeComparableKey(row, dst);
+  }
+  return schema_.EncodeComparableKey(row, dst);
+}
+
 Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, MRSRow *ms_row) {
   DCHECK_SCHEMA_EQ(schema_, *row.schema());
 
@@ -199,6 +239,7 @@ Status MemRowSet::Reinsert(Timestamp timestamp, const ConstContiguousRow& row, M
   // for the mutation are fully published before any concurrent reader sees
   // the appended mutation.
   mut->AppendToListAtomic(&ms_row->header_->redo_head);
+  live_row_count_.Increment();
   return Status::OK();
 }
 
@@ -237,6 +278,10 @@ Status MemRowSet::MutateRow(Timestamp timestamp,
     target->set_mrs_id(id_);
   }
 
+  if (delta.is_delete()) {
+    live_row_count_.IncrementBy(-1);
+  }
+
   stats->mrs_consulted++;
 
   anchorer_.AnchorIfMinimum(op_id.index());
@@ -298,6 +343,17 @@ Status MemRowSet::NewCompactionInput(const Schema* projection,
   return Status::OK();
 }
 
+bool MemRowSet::HasEntriesInRange(const Slice& lower_bound, const Slice& upper_bound) const {
+  gscoped_ptr<MSBTIter> iter(tree_.NewIterator());
+  bool exact;
+  if (!iter->SeekAtOrAfter(lower_bound, &exact)) {
+    return false;
+  }
+  Slice key, val;
+  iter->GetCurrentEntry(&key, &val);
+  return key.compare(upper_bound) <= 0;
+}
+
 Status MemRowSet::GetBounds(string *min_encoded_key,
                             string *max_encoded_key) const {
   return Status::NotSupported("");
@@ -315,6 +371,7 @@ class MemRowSet::Iterator::MRSRowProjector {
                                    RowBlockRow* dst_row,
                                    Arena* arena) = 0;
   virtual const vector<ProjectionIdxMapping>& base_cols_mapping() const = 0;
+  virtual const vector<size_t>& projection_defaults() const = 0;
   virtual Status Init() = 0;
 };
 
@@ -344,6 +401,10 @@ class MRSRowProjectorImpl : public MRSRowProjector {
     return actual_->base_cols_mapping();
   }
 
+  const vector<size_t>& projection_defaults() const override {
+    return actual_->projection_defaults();
+  }
+
  private:
   gscoped_ptr<ActualProjector> actual_;
 };
@@ -412,6 +473,25 @@ Status MemRowSet::Iterator::Init(ScanSpec *spec) {
     exclusive_upper_bound_.reset(upper_bound);
   }
 
+  if (FLAGS_mrs_use_codegen && FLAGS_mrs_use_codegen_predicates &&
+      spec && !spec->predicates().empty()) {
+    vector<ColumnPredicate> predicates;
+    for (const auto& entry : spec->predicates()) {
+      predicates.push_back(entry.second);
+    }
+    // Evaluate the most selective predicates first. The order is part of
+    // the compiled code's shape, so ties are broken deterministically.
+    std::sort(predicates.begin(), predicates.end(),
+              [](const ColumnPredicate& a, const ColumnPredicate& b) {
+                int cmp = SelectivityComparator(a, b);
+                return cmp != 0 ? cmp < 0 : a.column().name() < b.column().name();
+              });
+    if (codegen::CompilationManager::GetSingleton()->RequestPredicateEvaluator(
+          projection_, predicates, &predicate_evaluator_)) {
+      spec->RemovePredicates();
+    }
+  }
+
   state_ = kScanning;
   return Status::OK();
 }
@@ -421,7 +501,7 @@ Status MemRowSet::Iterator::SeekAtOrAfter(const Slice &key, bool *exact) {
 
   if (key.size() > 0) {
     ConstContiguousRow row_slice(&memrowset_->schema(), key);
-    memrowset_->schema().EncodeComparableKey(row_slice, &tmp_buf);
+    memrowset_->EncodeKey(row_slice, &tmp_buf);
   } else {
     // Seeking to empty key shouldn't try to run any encoding.
     tmp_buf.resize(0);
@@ -462,13 +542,21 @@ Status MemRowSet::Iterator::NextBlock(RowBlock *dst) {
   // Fill
   dst->selection_vector()->SetAllTrue();
   size_t fetched;
-  RETURN_NOT_OK(FetchRows(dst, &fetched));
+  if (FLAGS_mrs_use_columnar_scan) {
+    RETURN_NOT_OK(FetchRowsColumnar(dst, &fetched));
+  } else {
+    RETURN_NOT_OK(FetchRows(dst, &fetched));
+  }
   DCHECK_LE(0, fetched);
   DCHECK_LE(fetched, dst->nrows());
 
   // Clear unreached bits by resizing
   dst->Resize(fetched);
 
+  if (predicate_evaluator_) {
+    predicate_evaluator_->Evaluate(dst);
+  }
+
   return Status::OK();
 }
 
@@ -518,6 +606,123 @@ Status MemRowSet::Iterator::FetchRows(RowBlock* dst, size_t* fetched) {
   return Status::OK();
 }
 
+namespace {
+
+// Copy the cell data at 'src' (belonging to a column of type 'type') into
+// row 'dst_idx' of 'dst_col', relocating indirect data into 'dst_arena' if
+// set. Mirrors CopyCellData() without the per-cell wrapper objects.
+inline Status CopyCellToColumn(const TypeInfo* type, const uint8_t* src,
+                               ColumnBlock* dst_col, size_t dst_idx,
+                               Arena* dst_arena) {
+  DCHECK_LT(dst_idx, dst_col->nrows());
+  uint8_t* dst = dst_col->data() + dst_col->stride() * dst_idx;
+  if (type->physical_type() == BINARY) {
+    const Slice* src_slice = reinterpret_cast<const Slice*>(src);
+    Slice* dst_slice = reinterpret_cast<Slice*>(dst);
+    if (dst_arena != nullptr) {
+      if (PREDICT_FALSE(!dst_arena->RelocateSlice(*src_slice, dst_slice))) {
+        return Status::IOError("out of memory copying slice", src_slice->ToString());
+      }
+    } else {
+      *dst_slice = *src_slice;
+    }
+  } else {
+    memcpy(dst, src, type->size());
+  }
+  return Status::OK();
+}
+
+} // anonymous namespace
+
+Status MemRowSet::Iterator::FetchRowsColumnar(RowBlock* dst, size_t* fetched) {
+  *fetched = 0;
+  visible_rows_.clear();
+  visible_row_idxs_.clear();
+
+  // First pass: walk the tree and collect the rows visible in our snapshot.
+  do {
+    Slice k, v;
+    iter_->GetCurrentEntry(&k, &v);
+    MRSRow row(memrowset_.get(), v);
+
+    if (mvcc_snap_.IsCommitted(row.insertion_timestamp())) {
+      if (has_upper_bound() && out_of_bounds(k)) {
+        state_ = kFinished;
+        break;
+      }
+      visible_rows_.push_back(row);
+      visible_row_idxs_.push_back(*fetched);
+    } else {
+      // This row was not yet committed in the current MVCC snapshot
+      dst->selection_vector()->SetRowUnselected(*fetched);
+
+      // In debug mode, fill the row data for easy debugging
+      #ifndef NDEBUG
+      RowBlockRow dst_row = dst->row(*fetched);
+      dst_row.OverwriteWithPattern("MVCCMVCCMVCCMVCCMVCCMVCC"
+                                   "MVCCMVCCMVCCMVCCMVCCMVCC"
+                                   "MVCCMVCCMVCCMVCCMVCCMVCC");
+      #endif
+    }
+
+    ++*fetched;
+  } while (iter_->Next() && *fetched < dst->nrows());
+
+  const size_t n_visible = visible_rows_.size();
+  if (n_visible == 0) {
+    return Status::OK();
+  }
+
+  // Second pass: project the base columns, one column at a time.
+  const Schema& base_schema = memrowset_->schema_nonvirtual();
+  for (const auto& mapping : projector_->base_cols_mapping()) {
+    const ColumnSchema& col = base_schema.column(mapping.second);
+    const TypeInfo* type = col.type_info();
+    ColumnBlock dst_col = dst->column_block(mapping.first);
+    for (size_t i = 0; i < n_visible; i++) {
+      const MRSRow& row = visible_rows_[i];
+      const size_t dst_idx = visible_row_idxs_[i];
+      if (col.is_nullable()) {
+        bool is_null = row.is_null(mapping.second);
+        dst_col.SetCellIsNull(dst_idx, is_null);
+        if (is_null) continue;
+      }
+      RETURN_NOT_OK(CopyCellToColumn(type, row.cell_ptr(mapping.second),
+                                     &dst_col, dst_idx, dst->arena()));
+    }
+  }
+
+  // Fill the columns which are missing from the base schema with their
+  // read defaults.
+  for (size_t proj_idx : projector_->projection_defaults()) {
+    const ColumnSchema& col = projection_->column(proj_idx);
+    const TypeInfo* type = col.type_info();
+    const uint8_t* vdefault = reinterpret_cast<const uint8_t*>(col.read_default_value());
+    ColumnBlock dst_col = dst->column_block(proj_idx);
+    for (size_t i = 0; i < n_visible; i++) {
+      const size_t dst_idx = visible_row_idxs_[i];
+      if (col.is_nullable()) {
+        dst_col.SetCellIsNull(dst_idx, vdefault == nullptr);
+        if (vdefault == nullptr) continue;
+      }
+      RETURN_NOT_OK(CopyCellToColumn(type, vdefault, &dst_col, dst_idx, dst->arena()));
+    }
+  }
+
+  // Third pass: roll forward committed mutations. Rows which were never
+  // updated, by far the common case for append-heavy workloads, are skipped.
+  for (size_t i = 0; i < n_visible; i++) {
+    Mutation* redo_head = visible_rows_[i].acquire_redo_head();
+    if (PREDICT_TRUE(redo_head == nullptr)) {
+      continue;
+    }
+    RowBlockRow dst_row = dst->row(visible_row_idxs_[i]);
+    RETURN_NOT_OK(ApplyMutationsToProjectedRow(redo_head, &dst_row, dst->arena()));
+  }
+
+  return Status::OK();
+}
+
 Status MemRowSet::Iterator::ApplyMutationsToProjectedRow(
   const Mutation *mutation_head, RowBlockRow *dst_row, Arena *dst_arena) {
   // Fast short-circuit the likely case of a row which was inserted and never
@@ -565,6 +770,18 @@ Status MemRowSet::Iterator::ApplyMutationsToProjectedRow(
                                                memrowset_->schema_nonvirtual(),
                                                mapping.second, dst_arena));
       }
+
+      // Columns added after the MemRowSet was created may have been updated
+      // since, while it was waiting to be flushed after the alter.
+      if (projection_->has_column_ids()) {
+        for (size_t proj_idx : projector_->projection_defaults()) {
+          RowChangeListDecoder decoder(mut->changelist());
+          RETURN_NOT_OK(decoder.Init());
+          ColumnBlock dst_col = dst_row->column_block(proj_idx);
+          RETURN_NOT_OK(decoder.ApplyToOneColumn(dst_row->row_index(), &dst_col,
+                                                 *projection_, proj_idx, dst_arena));
+        }
+      }
     }
   }
 
@@ -31,6 +31,7 @@
 #include "kudu/tablet/mutation.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/memory/memory.h"
 #include "kudu/util/status.h"
@@ -39,6 +40,11 @@ namespace kudu {
 
 class MemTracker;
 
+namespace codegen {
+class PredicateEvaluator;
+class RowKeyCoder;
+} // namespace codegen
+
 namespace tablet {
 
 //
@@ -156,6 +162,12 @@ class MRSRow {
 
 struct MSBTreeTraits : public btree::BTreeTraits {
   typedef ThreadSafeMemoryTrackingArena ArenaType;
+
+  // Search nodes by key prefix first. The nodes are two cache lines larger
+  // than the defaults to make room for the prefixes without losing fanout.
+  static const size_t use_key_prefixes = 1;
+  static const size_t internal_node_size = 6 * CACHELINE_SIZE;
+  static const size_t leaf_node_size = 6 * CACHELINE_SIZE;
 };
 
 // Define an MRSRow instance using on-stack storage.
@@ -227,6 +239,12 @@ class MemRowSet : public RowSet,
     return Status::OK();
   }
 
+  // Unlike entry_count(), this excludes "ghost" rows and is O(1).
+  Status CountLiveRows(uint64_t* count) const OVERRIDE {
+    *count = live_row_count_.Load();
+    return Status::OK();
+  }
+
   virtual Status GetBounds(std::string *min_encoded_key,
                            std::string *max_encoded_key) const OVERRIDE;
 
@@ -234,6 +252,15 @@ class MemRowSet : public RowSet,
     return 0;
   }
 
+  Status GetIndexKeys(std::vector<std::string>* keys) const OVERRIDE {
+    return Status::OK();
+  }
+
+  Status ExcludedByPredicates(const ScanSpec& spec, bool* excluded) const OVERRIDE {
+    *excluded = false;
+    return Status::OK();
+  }
+
   std::mutex *compact_flush_lock() OVERRIDE {
     return &compact_flush_lock_;
   }
@@ -248,10 +275,22 @@ class MemRowSet : public RowSet,
     return tree_.empty();
   }
 
+  // Return true if the memrowset has an entry (possibly a ghost) whose encoded
+  // key falls within [lower_bound, upper_bound].
+  bool HasEntriesInRange(const Slice& lower_bound, const Slice& upper_bound) const;
+
   // TODO: unit test me
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  // There are no filters in front of the MemRowSet: its iterators seek the
+  // tree directly, so probing it first would only double the work.
+  Status CheckRowEverPresent(const RowSetKeyProbe &probe, bool *present,
+                             ProbeStats* stats) const OVERRIDE {
+    *present = true;
+    return Status::OK();
+  }
+
   // Return the memory footprint of this memrowset.
   // Note that this may be larger than the sum of the data
   // inserted into the memrowset, due to arena and data structure
@@ -338,6 +377,19 @@ class MemRowSet : public RowSet,
 
   Status MinorCompactDeltaStores() OVERRIDE { return Status::OK(); }
 
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas(
+      Timestamp ancient_history_mark) const OVERRIDE {
+    return 0;
+  }
+
+  Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                 int64_t* blocks_deleted,
+                                 int64_t* bytes_deleted) OVERRIDE {
+    *blocks_deleted = 0;
+    *bytes_deleted = 0;
+    return Status::OK();
+  }
+
  private:
   friend class Iterator;
 
@@ -347,11 +399,19 @@ class MemRowSet : public RowSet,
                   const ConstContiguousRow& row_data,
                   MRSRow *row);
 
+  // Encodes the key of 'row' into 'dst' for lookups in the tree, like
+  // Schema::EncodeComparableKey().
+  Slice EncodeKey(const ConstContiguousRow& row, faststring* dst) const;
+
   typedef btree::CBTree<MSBTreeTraits> MSBTree;
 
   int64_t id_;
 
   const Schema schema_;
+  // Set at construction if the key functions for the schema had already
+  // been compiled: since a tablet's memrowsets are replaced at every flush,
+  // only the first one has to fall back to the schema.
+  gscoped_ptr<codegen::RowKeyCoder> key_coder_;
   std::shared_ptr<MemTracker> parent_tracker_;
   std::shared_ptr<MemTracker> mem_tracker_;
   std::shared_ptr<MemoryTrackingBufferAllocator> allocator_;
@@ -367,6 +427,11 @@ class MemRowSet : public RowSet,
   volatile uint64_t debug_insert_count_;
   volatile uint64_t debug_update_count_;
 
+  // The number of rows which are not ghosts. Unlike the debug counts above,
+  // this is exact: it is incremented on INSERT and REINSERT and decremented
+  // on DELETE.
+  AtomicInt<int64_t> live_row_count_;
+
   std::mutex compact_flush_lock_;
 
   Atomic32 has_logged_throttling_;
@@ -475,6 +540,12 @@ class MemRowSet::Iterator : public RowwiseIterator {
 
   // Various helper functions called while getting the next RowBlock
   Status FetchRows(RowBlock* dst, size_t* fetched);
+
+  // Same as FetchRows(), but first collects the visible rows of the batch
+  // and then projects them into 'dst' one column at a time, so that each
+  // destination ColumnBlock is written sequentially. Mutations are applied
+  // afterwards, only to the rows which have any.
+  Status FetchRowsColumnar(RowBlock* dst, size_t* fetched);
   Status ApplyMutationsToProjectedRow(const Mutation *mutation_head,
                                       RowBlockRow *dst_row,
                                       Arena *dst_arena);
@@ -494,9 +565,19 @@ class MemRowSet::Iterator : public RowwiseIterator {
   gscoped_ptr<MRSRowProjector> projector_;
   DeltaProjector delta_projector_;
 
+  // Codegenned evaluator for the scan's predicates, if one was ready when
+  // the iterator was initialized. Otherwise the predicates are left in the
+  // spec, to be evaluated by a wrapping PredicateEvaluatingIterator.
+  gscoped_ptr<codegen::PredicateEvaluator> predicate_evaluator_;
+
   // Temporary buffer used for RowChangeList projection.
   faststring delta_buf_;
 
+  // Rows collected by FetchRowsColumnar(), along with their index in the
+  // destination block. Kept as members to reuse their storage across blocks.
+  std::vector<MRSRow> visible_rows_;
+  std::vector<size_t> visible_row_idxs_;
+
   size_t prepared_count_;
 
   // Temporary local buffer used for seeking to hold the encoded
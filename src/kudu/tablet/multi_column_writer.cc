@@ -17,27 +17,114 @@
 
 #include "kudu/tablet/multi_column_writer.h"
 
+#include <algorithm>
+#include <boost/bind.hpp>
+#include <gflags/gflags.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
 #include "kudu/cfile/cfile_writer.h"
 #include "kudu/common/rowblock.h"
 #include "kudu/common/schema.h"
 #include "kudu/fs/block_id.h"
+#include "kudu/fs/block_manager.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/util/bitmap.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/memory/arena.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int64(compaction_encode_batch_bytes, 4 * 1024 * 1024,
+             "When the columns of flushes and compactions are encoded in parallel, "
+             "the approximate number of bytes of row data buffered per batch "
+             "handed to the encoding threads. Each writer buffers up to two batches.");
+TAG_FLAG(compaction_encode_batch_bytes, advanced);
+TAG_FLAG(compaction_encode_batch_bytes, experimental);
+
+DEFINE_int32(compaction_encode_column_groups, 8,
+             "When the columns of flushes and compactions are encoded in parallel, "
+             "the maximum number of groups of columns encoded concurrently for "
+             "each output rowset.");
+TAG_FLAG(compaction_encode_column_groups, advanced);
+TAG_FLAG(compaction_encode_column_groups, experimental);
+
+DEFINE_int32(rowset_out_of_line_value_threshold_bytes, 0,
+             "The size from which the values of non-key BINARY and STRING columns "
+             "are stored out of line in the cfiles of flushed and compacted rowsets, "
+             "so that scans only read those of the rows they materialize. "
+             "0 stores all values inline. Servers of versions without support for "
+             "out-of-line values read them as empty.");
+TAG_FLAG(rowset_out_of_line_value_threshold_bytes, advanced);
+TAG_FLAG(rowset_out_of_line_value_threshold_bytes, experimental);
 
 namespace kudu {
 namespace tablet {
 
 using cfile::CFileWriter;
+using fs::CreateBlockOptions;
 using fs::ScopedWritableBlockCloser;
 using fs::WritableBlock;
+using std::string;
+
+// Rows buffered for encoding, stored column by column.
+struct MultiColumnWriter::EncodeBatch {
+  explicit EncodeBatch(int num_columns)
+      : cells(num_columns),
+        null_bitmaps(num_columns),
+        arena(32 * 1024, 4 * 1024 * 1024),
+        num_rows(0) {
+  }
+
+  void Reset() {
+    for (faststring& c : cells) {
+      c.clear();
+    }
+    for (faststring& b : null_bitmaps) {
+      b.clear();
+    }
+    arena.Reset();
+    num_rows = 0;
+  }
+
+  size_t memory_footprint() const {
+    size_t size = arena.memory_footprint();
+    for (const faststring& c : cells) {
+      size += c.size();
+    }
+    return size;
+  }
+
+  // The cell data of each column.
+  std::vector<faststring> cells;
+
+  // The null bitmap of each nullable column.
+  std::vector<faststring> null_bitmaps;
+
+  // Holds the indirect data of the cells (e.g. the contents of strings).
+  Arena arena;
+
+  size_t num_rows;
+};
 
 MultiColumnWriter::MultiColumnWriter(FsManager* fs,
-                                     const Schema* schema)
+                                     const Schema* schema,
+                                     string tablet_id,
+                                     ThreadPool* encode_pool)
   : fs_(fs),
     schema_(schema),
-    finished_(false) {
+    tablet_id_(std::move(tablet_id)),
+    encode_pool_(encode_pool),
+    finished_(false),
+    in_flight_latch_(0),
+    encoded_size_(0) {
 }
 
 MultiColumnWriter::~MultiColumnWriter() {
+  // The encoding tasks reference the writers.
+  in_flight_latch_.Wait();
   STLDeleteElements(&cfile_writers_);
 }
 
@@ -67,9 +154,16 @@ Status MultiColumnWriter::Open() {
       opts.write_validx = true;
     }
 
+    if (i >= schema_->num_key_columns() && FLAGS_rowset_out_of_line_value_threshold_bytes > 0) {
+      opts.out_of_line_value_threshold = FLAGS_rowset_out_of_line_value_threshold_bytes;
+    }
+
     // Open file for write.
     gscoped_ptr<WritableBlock> block;
-    RETURN_NOT_OK_PREPEND(fs_->CreateNewBlock(&block),
+    CreateBlockOptions block_opts;
+    block_opts.background_write = true;
+    block_opts.tablet_id = tablet_id_;
+    RETURN_NOT_OK_PREPEND(fs_->CreateNewBlock(block_opts, &block),
                           "Unable to open output file for column " + col.ToString());
     BlockId block_id(block->id());
 
@@ -87,10 +181,45 @@ Status MultiColumnWriter::Open() {
     block_ids_.push_back(block_id);
   }
 
+  if (encode_pool_ != nullptr) {
+    ComputeColumnGroups();
+    staging_.reset(new EncodeBatch(schema_->num_columns()));
+    in_flight_.reset(new EncodeBatch(schema_->num_columns()));
+  }
   return Status::OK();
 }
 
+void MultiColumnWriter::ComputeColumnGroups() {
+  int num_groups = std::max(1, std::min(schema_->num_columns(),
+                                        FLAGS_compaction_encode_column_groups));
+  // Split the columns into contiguous groups of about the same cell width.
+  size_t total_width = 0;
+  for (int i = 0; i < schema_->num_columns(); i++) {
+    total_width += schema_->column(i).type_info()->size();
+  }
+  column_groups_.assign(1, std::vector<int>());
+  size_t width = 0;
+  for (int i = 0; i < schema_->num_columns(); i++) {
+    if (!column_groups_.back().empty() &&
+        static_cast<int>(column_groups_.size()) < num_groups &&
+        width * num_groups >= total_width * column_groups_.size()) {
+      column_groups_.emplace_back();
+    }
+    column_groups_.back().push_back(i);
+    width += schema_->column(i).type_info()->size();
+  }
+}
+
 Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
+  if (encode_pool_ != nullptr) {
+    RETURN_NOT_OK(StageBlock(block));
+    if (staging_->memory_footprint() >=
+        static_cast<size_t>(FLAGS_compaction_encode_batch_bytes)) {
+      RETURN_NOT_OK(SubmitStagedBatch());
+    }
+    return Status::OK();
+  }
+
   for (int i = 0; i < schema_->num_columns(); i++) {
     ColumnBlock column = block.column_block(i);
     if (column.is_nullable()) {
@@ -103,6 +232,143 @@ Status MultiColumnWriter::AppendBlock(const RowBlock& block) {
   return Status::OK();
 }
 
+Status MultiColumnWriter::StageBlock(const RowBlock& block) {
+  EncodeBatch* batch = staging_.get();
+  size_t first_row = batch->num_rows;
+  size_t nrows = block.nrows();
+  for (int i = 0; i < schema_->num_columns(); i++) {
+    ColumnBlock column = block.column_block(i);
+    faststring* cells = &batch->cells[i];
+    size_t offset = cells->size();
+    cells->append(column.data(), nrows * column.stride());
+
+    if (column.is_nullable()) {
+      faststring* bitmap = &batch->null_bitmaps[i];
+      bitmap->resize(BitmapSize(first_row + nrows));
+      for (size_t r = 0; r < nrows; r++) {
+        BitmapChange(bitmap->data(), first_row + r, !column.is_null(r));
+      }
+    }
+
+    if (column.type_info()->physical_type() == BINARY) {
+      Slice* slices = reinterpret_cast<Slice*>(cells->data() + offset);
+      for (size_t r = 0; r < nrows; r++) {
+        if (column.is_nullable() && column.is_null(r)) {
+          continue;
+        }
+        if (PREDICT_FALSE(!batch->arena.RelocateSlice(slices[r], &slices[r]))) {
+          return Status::RuntimeError("unable to copy cell data for encoding");
+        }
+      }
+    }
+  }
+  batch->num_rows += nrows;
+  return Status::OK();
+}
+
+// Encodes one group of columns of the batch in flight. If the pool drops the
+// task without running it (i.e. it is shut down), the batch fails instead of
+// waiting forever for it.
+class MultiColumnWriter::EncodeTask {
+ public:
+  EncodeTask(MultiColumnWriter* writer, const EncodeBatch* batch, int group_idx)
+      : writer_(writer),
+        batch_(batch),
+        group_idx_(group_idx),
+        ran_(false) {
+  }
+
+  ~EncodeTask() {
+    if (!ran_) {
+      writer_->RecordEncodeError(Status::Aborted("column encoding task was dropped"));
+      writer_->in_flight_latch_.CountDown();
+    }
+  }
+
+  void Run() {
+    ran_ = true;
+    writer_->EncodeColumnGroup(batch_, group_idx_);
+  }
+
+ private:
+  MultiColumnWriter* const writer_;
+  const EncodeBatch* const batch_;
+  const int group_idx_;
+  bool ran_;
+
+  DISALLOW_COPY_AND_ASSIGN(EncodeTask);
+};
+
+Status MultiColumnWriter::SubmitStagedBatch() {
+  RETURN_NOT_OK(WaitForBatchInFlight());
+  if (staging_->num_rows == 0) {
+    return Status::OK();
+  }
+  in_flight_.swap(staging_);
+  staging_->Reset();
+
+  in_flight_latch_.Reset(column_groups_.size());
+  for (int g = 0; g < column_groups_.size(); g++) {
+    std::shared_ptr<EncodeTask> task(new EncodeTask(this, in_flight_.get(), g));
+    Status s = encode_pool_->SubmitFunc(boost::bind(&EncodeTask::Run, task));
+    if (PREDICT_FALSE(!s.ok())) {
+      // The pool is shutting down: encode the group on this thread.
+      task->Run();
+    }
+  }
+  return Status::OK();
+}
+
+Status MultiColumnWriter::WaitForBatchInFlight() {
+  in_flight_latch_.Wait();
+  {
+    std::lock_guard<simple_spinlock> l(status_lock_);
+    RETURN_NOT_OK(encode_status_);
+  }
+  size_t size = 0;
+  for (const CFileWriter *writer : cfile_writers_) {
+    size += writer->written_size();
+  }
+  encoded_size_ = size;
+  return Status::OK();
+}
+
+void MultiColumnWriter::EncodeColumnGroup(const EncodeBatch* batch, int group_idx) {
+  Status s;
+  for (int i : column_groups_[group_idx]) {
+    const void* cells = batch->cells[i].data();
+    if (schema_->column(i).is_nullable()) {
+      s = cfile_writers_[i]->AppendNullableEntries(batch->null_bitmaps[i].data(),
+                                                   cells, batch->num_rows);
+    } else {
+      s = cfile_writers_[i]->AppendEntries(cells, batch->num_rows);
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      s = s.CloneAndPrepend("Unable to encode column " + schema_->column(i).ToString());
+      break;
+    }
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    RecordEncodeError(s);
+  }
+  in_flight_latch_.CountDown();
+}
+
+void MultiColumnWriter::RecordEncodeError(const Status& s) {
+  std::lock_guard<simple_spinlock> l(status_lock_);
+  if (encode_status_.ok()) {
+    encode_status_ = s;
+  }
+}
+
+Status MultiColumnWriter::WaitForPendingAppends() {
+  if (encode_pool_ == nullptr) {
+    return Status::OK();
+  }
+  RETURN_NOT_OK(SubmitStagedBatch());
+  return WaitForBatchInFlight();
+}
+
 Status MultiColumnWriter::Finish() {
   ScopedWritableBlockCloser closer;
   RETURN_NOT_OK(FinishAndReleaseBlocks(&closer));
@@ -111,6 +377,7 @@ Status MultiColumnWriter::Finish() {
 
 Status MultiColumnWriter::FinishAndReleaseBlocks(ScopedWritableBlockCloser* closer) {
   CHECK(!finished_);
+  RETURN_NOT_OK(WaitForPendingAppends());
   for (int i = 0; i < schema_->num_columns(); i++) {
     CFileWriter *writer = cfile_writers_[i];
     Status s = writer->FinishAndReleaseBlock(closer);
@@ -132,7 +399,17 @@ void MultiColumnWriter::GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>*
   }
 }
 
+void MultiColumnWriter::GetDictEncodingStats(cfile::DictEncodingStatsPB* stats) const {
+  CHECK(finished_);
+  for (const CFileWriter *writer : cfile_writers_) {
+    cfile::AddDictEncodingStats(writer->dict_stats(), stats);
+  }
+}
+
 size_t MultiColumnWriter::written_size() const {
+  if (encode_pool_ != nullptr) {
+    return encoded_size_;
+  }
   size_t size = 0;
   for (const CFileWriter *writer : cfile_writers_) {
     size += writer->written_size();
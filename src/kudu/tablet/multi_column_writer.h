@@ -19,19 +19,25 @@
 
 #include <glog/logging.h>
 #include <map>
+#include <string>
 #include <vector>
 
 #include "kudu/common/schema.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/util/countdown_latch.h"
+#include "kudu/util/locks.h"
 
 namespace kudu {
 
 class RowBlock;
 class Schema;
+class ThreadPool;
 
 namespace cfile {
 class CFileWriter;
+class DictEncodingStatsPB;
 } // namespace cfile
 
 namespace fs {
@@ -42,10 +48,18 @@ namespace tablet {
 
 // Wrapper which writes several columns in parallel corresponding to some
 // Schema.
+//
+// If given an 'encode_pool', appended rows are buffered, and each buffered
+// batch of rows is encoded on the pool, one task per group of columns,
+// while the next batch is being appended. At most two batches of about
+// --compaction_encode_batch_bytes each are held at a time.
 class MultiColumnWriter {
  public:
+  // The blocks are placed among the data directories of tablet 'tablet_id'.
   MultiColumnWriter(FsManager* fs,
-                    const Schema* schema);
+                    const Schema* schema,
+                    std::string tablet_id,
+                    ThreadPool* encode_pool = nullptr);
 
   virtual ~MultiColumnWriter();
 
@@ -54,9 +68,15 @@ class MultiColumnWriter {
 
   // Append the given block to the output columns.
   //
-  // Note that the selection vector here is ignored.
+  // Note that the selection vector here is ignored. With an encode pool, the
+  // block's data (including indirect data) is copied, so the caller may
+  // reuse it once this returns.
   Status AppendBlock(const RowBlock& block);
 
+  // Encodes any buffered rows and waits for all of them to be written to the
+  // column writers. A no-op without an encode pool.
+  Status WaitForPendingAppends();
+
   // Close the in-progress files.
   //
   // The file's blocks may be retrieved using FlushedBlocks().
@@ -66,9 +86,13 @@ class MultiColumnWriter {
   // to 'closer'.
   Status FinishAndReleaseBlocks(fs::ScopedWritableBlockCloser* closer);
 
-  // Return the number of bytes written so far.
+  // Return the number of bytes written so far. With an encode pool, this
+  // doesn't account for the batches which are still buffered or being encoded.
   size_t written_size() const;
 
+  // With an encode pool, the writer must not be used concurrently with the
+  // encoding of a batch: call WaitForPendingAppends() first, or only use it
+  // before the first block is appended.
   cfile::CFileWriter* writer_for_col_idx(int i) {
     DCHECK_LT(i, cfile_writers_.size());
     return cfile_writers_[i];
@@ -79,15 +103,64 @@ class MultiColumnWriter {
   // REQUIRES: Finish() already called.
   void GetFlushedBlocksByColumnId(std::map<ColumnId, BlockId>* ret) const;
 
+  // Add the dictionary statistics of the dictionary encoded columns to 'stats'.
+  //
+  // REQUIRES: Finish() already called.
+  void GetDictEncodingStats(cfile::DictEncodingStatsPB* stats) const;
+
  private:
+  struct EncodeBatch;
+  class EncodeTask;
+
+  // Divides the columns into the groups encoded by each task.
+  void ComputeColumnGroups();
+
+  // Copies 'block' into 'staging_'.
+  Status StageBlock(const RowBlock& block);
+
+  // Waits for the batch in flight, if any, then sends 'staging_' to be
+  // encoded in its place.
+  Status SubmitStagedBatch();
+
+  // Waits for the batch in flight, if any, to be encoded.
+  Status WaitForBatchInFlight();
+
+  // Appends the 'group_idx'th group of columns of 'batch' to their writers.
+  void EncodeColumnGroup(const EncodeBatch* batch, int group_idx);
+
+  // Records 's' as the outcome of the batch in flight, unless an earlier
+  // error was already recorded.
+  void RecordEncodeError(const Status& s);
+
   FsManager* const fs_;
   const Schema* const schema_;
+  const std::string tablet_id_;
+  ThreadPool* const encode_pool_;
 
   bool finished_;
 
   std::vector<cfile::CFileWriter *> cfile_writers_;
   std::vector<BlockId> block_ids_;
 
+  // The following are only used with an encode pool.
+
+  // Column indexes of each group of columns encoded by one task.
+  std::vector<std::vector<int>> column_groups_;
+
+  // The batch being filled by AppendBlock() and the one being encoded.
+  gscoped_ptr<EncodeBatch> staging_;
+  gscoped_ptr<EncodeBatch> in_flight_;
+
+  // Counts down once per column group of the batch in flight.
+  CountDownLatch in_flight_latch_;
+
+  // The first error hit encoding the batch in flight.
+  simple_spinlock status_lock_;
+  Status encode_status_;
+
+  // Sum of the column writers' sizes after the last batch was encoded.
+  size_t encoded_size_;
+
   DISALLOW_COPY_AND_ASSIGN(MultiColumnWriter);
 };
 
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <boost/bind.hpp>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <mutex>
@@ -23,8 +24,10 @@
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/server/logical_clock.h"
 #include "kudu/tablet/mvcc.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/threadpool.h"
 
 using std::thread;
 
@@ -164,6 +167,47 @@ TEST_F(MvccTest, TestMvccMultipleInFlight) {
   ASSERT_TRUE(snap.IsCommitted(t3));
 }
 
+// Snapshots share the manager's set of committed timestamps, which must be
+// copied rather than changed once a snapshot refers to it.
+TEST_F(MvccTest, TestSnapshotsUnaffectedByLaterCommits) {
+  MvccManager mgr(clock_.get());
+  Timestamp t1 = mgr.StartTransaction();
+  Timestamp t2 = mgr.StartTransaction();
+  Timestamp t3 = mgr.StartTransaction();
+  mgr.StartApplyingTransaction(t2);
+  mgr.CommitTransaction(t2);
+
+  MvccSnapshot snap1;
+  mgr.TakeSnapshot(&snap1);
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 1 or (T in {2})}]", snap1.ToString());
+
+  // Adds to the shared set.
+  mgr.StartApplyingTransaction(t3);
+  mgr.CommitTransaction(t3);
+  MvccSnapshot snap2;
+  mgr.TakeSnapshot(&snap2);
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 1 or (T in {2,3})}]", snap2.ToString());
+
+  // Trims the shared set.
+  mgr.StartApplyingTransaction(t1);
+  mgr.CommitTransaction(t1);
+  MvccSnapshot snap3;
+  mgr.TakeSnapshot(&snap3);
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 3 or (T in {3})}]", snap3.ToString());
+
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 1 or (T in {2})}]", snap1.ToString());
+  ASSERT_FALSE(snap1.IsCommitted(t3));
+  ASSERT_EQ("MvccSnapshot[committed={T|T < 1 or (T in {2,3})}]", snap2.ToString());
+  ASSERT_FALSE(snap2.IsCommitted(t1));
+  ASSERT_TRUE(snap2.IsCommitted(t3));
+
+  // Changing a copy of a snapshot leaves the original alone.
+  MvccSnapshot snap4(snap1);
+  snap4.AddCommittedTimestamps({ t1 });
+  ASSERT_TRUE(snap4.IsCommitted(t1));
+  ASSERT_FALSE(snap1.IsCommitted(t1));
+}
+
 TEST_F(MvccTest, TestOutOfOrderTxns) {
   scoped_refptr<Clock> hybrid_clock(new HybridClock());
   ASSERT_OK(hybrid_clock->Init());
@@ -243,6 +287,34 @@ TEST_F(MvccTest, TestOfflineTransactions) {
   ASSERT_TRUE(snap2.IsCommitted(Timestamp(40)));
 }
 
+// Tests that the safe time given to followers never covers an in-flight
+// transaction, and that transactions always start after it.
+TEST_F(MvccTest, TestGetSafeTimeForPropagation) {
+  MvccManager mgr(clock_.get());
+
+  // With nothing in flight, the safe time is the current time, and the leader's
+  // clean time advances to it as well.
+  Timestamp safe1 = mgr.GetSafeTimeForPropagation();
+  ASSERT_EQ(0, mgr.GetCleanTimestamp().CompareTo(safe1));
+
+  // An in-flight transaction holds the safe time back.
+  Timestamp t1 = mgr.StartTransaction();
+  ASSERT_GT(t1.CompareTo(safe1), 0);
+  Timestamp safe2 = mgr.GetSafeTimeForPropagation();
+  ASSERT_EQ(t1.value() - 1, safe2.value());
+
+  Timestamp t2 = mgr.StartTransaction();
+  ASSERT_GT(t2.CompareTo(safe2), 0);
+  mgr.StartApplyingTransaction(t1);
+  mgr.CommitTransaction(t1);
+  mgr.StartApplyingTransaction(t2);
+  mgr.CommitTransaction(t2);
+
+  Timestamp safe3 = mgr.GetSafeTimeForPropagation();
+  ASSERT_GT(safe3.CompareTo(t2), 0);
+  ASSERT_EQ(0, mgr.GetCleanTimestamp().CompareTo(safe3));
+}
+
 TEST_F(MvccTest, TestScopedTransaction) {
   MvccManager mgr(clock_.get());
   MvccSnapshot snap;
@@ -280,8 +352,8 @@ TEST_F(MvccTest, TestPointInTimeSnapshot) {
 TEST_F(MvccTest, TestMayHaveCommittedTransactionsAtOrAfter) {
   MvccSnapshot snap;
   snap.all_committed_before_ = Timestamp(10);
-  snap.committed_timestamps_.push_back(11);
-  snap.committed_timestamps_.push_back(13);
+  snap.AddCommittedTimestamp(Timestamp(11));
+  snap.AddCommittedTimestamp(Timestamp(13));
   snap.none_committed_at_or_after_ = Timestamp(14);
 
   ASSERT_TRUE(snap.MayHaveCommittedTransactionsAtOrAfter(Timestamp(9)));
@@ -316,8 +388,8 @@ TEST_F(MvccTest, TestMayHaveCommittedTransactionsAtOrAfter) {
 TEST_F(MvccTest, TestMayHaveUncommittedTransactionsBefore) {
   MvccSnapshot snap;
   snap.all_committed_before_ = Timestamp(10);
-  snap.committed_timestamps_.push_back(11);
-  snap.committed_timestamps_.push_back(13);
+  snap.AddCommittedTimestamp(Timestamp(11));
+  snap.AddCommittedTimestamp(Timestamp(13));
   snap.none_committed_at_or_after_ = Timestamp(14);
 
   ASSERT_FALSE(snap.MayHaveUncommittedTransactionsAtOrBefore(Timestamp(9)));
@@ -356,7 +428,7 @@ TEST_F(MvccTest, TestMayHaveUncommittedTransactionsBefore) {
   // still report that there can't be any uncommitted transactions before.
   MvccSnapshot snap2;
   snap2.all_committed_before_ = Timestamp(10);
-  snap2.committed_timestamps_.push_back(10);
+  snap2.AddCommittedTimestamp(Timestamp(10));
 
   ASSERT_FALSE(snap2.MayHaveUncommittedTransactionsAtOrBefore(Timestamp(10)));
 }
@@ -485,6 +557,52 @@ TEST_F(MvccTest, TestWaitForCleanSnapshot_SnapAtTimestampWithInFlights) {
   ASSERT_TRUE(HasResultSnapshot());
 }
 
+// Test waiting asynchronously for transactions below a timestamp to commit,
+// and cancelling such a wait.
+TEST_F(MvccTest, TestWaitForAllCommittedAsync) {
+  MvccManager mgr(clock_.get());
+  gscoped_ptr<ThreadPool> pool;
+  ASSERT_OK(ThreadPoolBuilder("mvcc-wait").Build(&pool));
+
+  // Nothing is in flight, so the callback is submitted immediately.
+  CountDownLatch done_now(1);
+  ASSERT_EQ(0, mgr.WaitForAllCommittedAsync(
+      clock_->Now(), pool.get(), boost::bind(&CountDownLatch::CountDown, &done_now)));
+  done_now.Wait();
+
+  Timestamp tx1 = mgr.StartTransaction();
+  Timestamp tx2 = mgr.StartTransaction();
+
+  // Wait for tx1 and tx2 to commit; a second wait is cancelled.
+  CountDownLatch done(1);
+  int64_t handle = mgr.WaitForAllCommittedAsync(
+      clock_->Now(), pool.get(), boost::bind(&CountDownLatch::CountDown, &done));
+  ASSERT_GT(handle, 0);
+  CountDownLatch cancelled(1);
+  int64_t cancelled_handle = mgr.WaitForAllCommittedAsync(
+      clock_->Now(), pool.get(), boost::bind(&CountDownLatch::CountDown, &cancelled));
+  ASSERT_GT(cancelled_handle, 0);
+  ASSERT_NE(handle, cancelled_handle);
+  ASSERT_EQ(2, mgr.GetNumWaitersForTests());
+  ASSERT_TRUE(mgr.CancelAsyncWait(cancelled_handle));
+  ASSERT_FALSE(mgr.CancelAsyncWait(cancelled_handle));
+  ASSERT_EQ(1, mgr.GetNumWaitersForTests());
+
+  mgr.StartApplyingTransaction(tx2);
+  mgr.CommitTransaction(tx2);
+  ASSERT_FALSE(done.WaitFor(MonoDelta::FromMilliseconds(10)));
+
+  mgr.StartApplyingTransaction(tx1);
+  mgr.CommitTransaction(tx1);
+  done.Wait();
+  ASSERT_EQ(0, mgr.GetNumWaitersForTests());
+  // The wait already fired, so it can no longer be cancelled.
+  ASSERT_FALSE(mgr.CancelAsyncWait(handle));
+
+  pool->Wait();
+  ASSERT_EQ(1, cancelled.count());
+}
+
 // Test that if we abort a transaction we don't advance the safe time and don't
 // add the transaction to the committed set.
 TEST_F(MvccTest, TestTxnAbort) {
@@ -31,6 +31,7 @@
 #include "kudu/util/countdown_latch.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/threadpool.h"
 
 namespace kudu { namespace tablet {
 
@@ -237,16 +238,19 @@ void MvccManager::OfflineAdjustSafeTime(Timestamp safe_time) {
   AdjustCleanTime();
 }
 
-// Remove any elements from 'v' which are < the given watermark.
-static void FilterTimestamps(std::vector<Timestamp::val_type>* v,
-                             Timestamp::val_type watermark) {
-  int j = 0;
-  for (const auto& ts : *v) {
-    if (ts >= watermark) {
-      (*v)[j++] = ts;
-    }
+Timestamp MvccManager::GetSafeTimeForPropagation() {
+  Timestamp now = clock_->Now();
+  std::lock_guard<LockType> l(lock_);
+
+  if (no_new_transactions_at_or_before_.CompareTo(now) < 0) {
+    no_new_transactions_at_or_before_ = now;
+    AdjustCleanTime();
   }
-  v->resize(j);
+
+  if (earliest_in_flight_.CompareTo(now) <= 0) {
+    return Timestamp(earliest_in_flight_.value() - 1);
+  }
+  return now;
 }
 
 void MvccManager::AdjustCleanTime() {
@@ -271,7 +275,7 @@ void MvccManager::AdjustCleanTime() {
   }
 
   // Filter out any committed timestamps that now fall below the watermark
-  FilterTimestamps(&cur_snap_.committed_timestamps_, cur_snap_.all_committed_before_.value());
+  cur_snap_.TrimCommittedTimestamps();
 
   // it may also have unblocked some waiters.
   // Check if someone is waiting for transactions to be committed.
@@ -280,6 +284,20 @@ void MvccManager::AdjustCleanTime() {
     while (iter != waiters_.end()) {
       WaitingState* waiter = *iter;
       if (IsDoneWaitingUnlocked(*waiter)) {
+        if (waiter->latch == nullptr) {
+          // An asynchronous waiter. The callback is only handed to its pool
+          // here, never run, since we're holding 'lock_'.
+          Status s = waiter->pool->SubmitFunc(waiter->callback);
+          if (PREDICT_FALSE(!s.ok())) {
+            // Leave it registered so that its owner can still cancel it.
+            LOG(WARNING) << "Unable to submit MVCC wait callback: " << s.ToString();
+            iter++;
+            continue;
+          }
+          iter = waiters_.erase(iter);
+          delete waiter;
+          continue;
+        }
         iter = waiters_.erase(iter);
         waiter->latch->CountDown();
         continue;
@@ -373,6 +391,45 @@ void MvccManager::WaitForCleanSnapshot(MvccSnapshot* snap) const {
   CHECK_OK(WaitForCleanSnapshotAtTimestamp(clock_->Now(), snap, MonoTime::Max()));
 }
 
+int64_t MvccManager::WaitForAllCommittedAsync(Timestamp timestamp, ThreadPool* pool,
+                                              const boost::function<void()>& callback) const {
+  gscoped_ptr<WaitingState> waiter(new WaitingState);
+  waiter->timestamp = timestamp;
+  waiter->latch = nullptr;
+  waiter->wait_for = ALL_COMMITTED;
+  waiter->pool = pool;
+  waiter->callback = callback;
+  {
+    std::lock_guard<LockType> l(lock_);
+    if (!IsDoneWaitingUnlocked(*waiter)) {
+      int64_t handle = next_async_handle_++;
+      waiter->async_handle = handle;
+      waiters_.push_back(waiter.release());
+      return handle;
+    }
+  }
+  // Already committed: no need to register at all. If the pool refuses the
+  // callback, run it here rather than dropping it.
+  Status s = pool->SubmitFunc(callback);
+  if (PREDICT_FALSE(!s.ok())) {
+    LOG(WARNING) << "Unable to submit MVCC wait callback: " << s.ToString();
+    callback();
+  }
+  return 0;
+}
+
+bool MvccManager::CancelAsyncWait(int64_t handle) const {
+  std::lock_guard<LockType> l(lock_);
+  for (auto iter = waiters_.begin(); iter != waiters_.end(); ++iter) {
+    if ((*iter)->latch == nullptr && (*iter)->async_handle == handle) {
+      delete *iter;
+      waiters_.erase(iter);
+      return true;
+    }
+  }
+  return false;
+}
+
 void MvccManager::WaitForApplyingTransactionsToCommit() const {
   TRACE_EVENT0("tablet", "MvccManager::WaitForApplyingTransactionsToCommit");
 
@@ -454,11 +511,9 @@ MvccSnapshot MvccSnapshot::CreateSnapshotIncludingNoTransactions() {
 }
 
 bool MvccSnapshot::IsCommittedFallback(const Timestamp& timestamp) const {
-  for (const Timestamp::val_type& v : committed_timestamps_) {
-    if (v == timestamp.value()) return true;
-  }
-
-  return false;
+  return committed_timestamps_ &&
+      std::binary_search(committed_timestamps_->begin(), committed_timestamps_->end(),
+                         timestamp.value());
 }
 
 bool MvccSnapshot::MayHaveCommittedTransactionsAtOrAfter(const Timestamp& timestamp) const {
@@ -477,7 +532,7 @@ bool MvccSnapshot::MayHaveUncommittedTransactionsAtOrBefore(const Timestamp& tim
 std::string MvccSnapshot::ToString() const {
   string ret("MvccSnapshot[committed={T|");
 
-  if (committed_timestamps_.size() == 0) {
+  if (!committed_timestamps_) {
     StrAppend(&ret, "T < ", all_committed_before_.ToString(),"}]");
     return ret;
   }
@@ -485,7 +540,7 @@ std::string MvccSnapshot::ToString() const {
             " or (T in {");
 
   bool first = true;
-  for (Timestamp::val_type t : committed_timestamps_) {
+  for (Timestamp::val_type t : *committed_timestamps_) {
     if (!first) {
       ret.push_back(',');
     }
@@ -505,7 +560,10 @@ void MvccSnapshot::AddCommittedTimestamps(const std::vector<Timestamp>& timestam
 void MvccSnapshot::AddCommittedTimestamp(Timestamp timestamp) {
   if (IsCommitted(timestamp)) return;
 
-  committed_timestamps_.push_back(timestamp.value());
+  // Transactions mostly commit in timestamp order, so this is usually an
+  // append.
+  std::vector<Timestamp::val_type>* v = MutableCommittedTimestamps();
+  v->insert(std::upper_bound(v->begin(), v->end(), timestamp.value()), timestamp.value());
 
   // If this is a new upper bound commit mark, update it.
   if (none_committed_at_or_after_.CompareTo(timestamp) <= 0) {
@@ -513,6 +571,37 @@ void MvccSnapshot::AddCommittedTimestamp(Timestamp timestamp) {
   }
 }
 
+void MvccSnapshot::TrimCommittedTimestamps() {
+  if (!committed_timestamps_) {
+    return;
+  }
+  const std::vector<Timestamp::val_type>& v = *committed_timestamps_;
+  auto first_kept = std::lower_bound(v.begin(), v.end(), all_committed_before_.value());
+  if (first_kept == v.end()) {
+    committed_timestamps_.reset();
+  } else if (first_kept != v.begin()) {
+    if (committed_timestamps_.use_count() > 1) {
+      committed_timestamps_ = std::make_shared<std::vector<Timestamp::val_type>>(
+          first_kept, v.end());
+    } else {
+      committed_timestamps_->erase(committed_timestamps_->begin(), first_kept);
+    }
+  }
+}
+
+std::vector<Timestamp::val_type>* MvccSnapshot::MutableCommittedTimestamps() {
+  if (!committed_timestamps_) {
+    committed_timestamps_ = std::make_shared<std::vector<Timestamp::val_type>>();
+  } else if (committed_timestamps_.use_count() > 1) {
+    // Other snapshots may be reading it. No new reference can be taken
+    // meanwhile: the manager's snapshot is only copied under its lock, which
+    // the manager holds while modifying it.
+    committed_timestamps_ = std::make_shared<std::vector<Timestamp::val_type>>(
+        *committed_timestamps_);
+  }
+  return committed_timestamps_.get();
+}
+
 ////////////////////////////////////////////////////////////
 // ScopedTransaction
 ////////////////////////////////////////////////////////////
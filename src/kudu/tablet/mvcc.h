@@ -17,7 +17,9 @@
 #ifndef KUDU_TABLET_MVCC_H
 #define KUDU_TABLET_MVCC_H
 
+#include <boost/function.hpp>
 #include <gtest/gtest_prod.h>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -29,6 +31,7 @@
 
 namespace kudu {
 class CountDownLatch;
+class ThreadPool;
 namespace tablet {
 class MvccManager;
 
@@ -97,7 +100,7 @@ class MvccSnapshot {
   // transactions with timestamps less than some timestamp to be committed,
   // and all other transactions to be uncommitted.
   bool is_clean() const {
-    return committed_timestamps_.empty();
+    return !committed_timestamps_;
   }
 
   // Consider the given list of timestamps to be committed in this snapshot,
@@ -117,6 +120,13 @@ class MvccSnapshot {
 
   void AddCommittedTimestamp(Timestamp timestamp);
 
+  // Drops the committed timestamps which are below 'all_committed_before_'.
+  void TrimCommittedTimestamps();
+
+  // Returns 'committed_timestamps_' for modification, first copying it if
+  // it is shared with another snapshot.
+  std::vector<Timestamp::val_type>* MutableCommittedTimestamps();
+
   // Summary rule:
   //   A transaction T is committed if and only if:
   //      T < all_committed_before_ or
@@ -137,18 +147,24 @@ class MvccSnapshot {
 
   // A transaction ID at or beyond which no transactions have been committed.
   // For any timestamp X, if X >= none_committed_after_, then X is uncommitted.
-  // This is equivalent to max(committed_timestamps_) + 1, but since
-  // that vector is unsorted, we cache it.
+  // This is equivalent to max(committed_timestamps_) + 1, cached so that
+  // IsCommitted() can check it inline.
   Timestamp none_committed_at_or_after_;
 
   // The set of transactions higher than all_committed_before_timestamp_ which
-  // are committed in this snapshot.
+  // are committed in this snapshot, in ascending order, or null if there are
+  // none.
   // It might seem like using an unordered_set<> or a set<> would be faster here,
   // but in practice, this list tends to be stay pretty small, and is only
   // rarely consulted (most data will be culled by 'all_committed_before_'
   // or none_committed_at_or_after_. So, using the compact vector structure fits
   // the whole thing on one or two cache lines, and it ends up going faster.
-  std::vector<Timestamp::val_type> committed_timestamps_;
+  //
+  // The vector is shared copy-on-write between the MvccManager's snapshot and
+  // the snapshots taken of it, so that taking a snapshot only bumps a
+  // reference count under the manager's lock rather than copying the vector.
+  // A shared vector is never modified.
+  std::shared_ptr<std::vector<Timestamp::val_type>> committed_timestamps_;
 
 };
 
@@ -244,6 +260,12 @@ class MvccManager {
   // manager can trim state.
   void OfflineAdjustSafeTime(Timestamp safe_time);
 
+  // Used on the leader to get a safe time to send to followers: returns the
+  // latest timestamp such that no transaction at or before it is in flight or
+  // will ever start. Transactions which read the clock before this call but
+  // have not yet started will retry with a later timestamp.
+  Timestamp GetSafeTimeForPropagation();
+
   // Take a snapshot of the current MVCC state, which indicates which
   // transactions have been committed at the time of this call.
   void TakeSnapshot(MvccSnapshot *snapshot) const;
@@ -277,6 +299,22 @@ class MvccManager {
   // Note that transactions are not blocked during this call.
   void WaitForCleanSnapshot(MvccSnapshot* snapshot) const;
 
+  // Non-blocking counterpart of the wait in WaitForCleanSnapshotAtTimestamp():
+  // arranges for 'callback' to be submitted to 'pool' once all transactions
+  // with a timestamp lower than 'timestamp' have committed. If that is already
+  // the case, 'callback' is submitted right away.
+  //
+  // Returns a handle which can be passed to CancelAsyncWait(), or 0 if the
+  // callback was already submitted. Waits have no deadline of their own, so a
+  // caller which needs one must cancel the wait when it expires. Every wait must
+  // either fire or be cancelled before the MvccManager is destroyed.
+  int64_t WaitForAllCommittedAsync(Timestamp timestamp, ThreadPool* pool,
+                                   const boost::function<void()>& callback) const;
+
+  // Cancels a wait registered with WaitForAllCommittedAsync(). Returns true if
+  // the wait was cancelled, or false if its callback was already submitted.
+  bool CancelAsyncWait(int64_t handle) const;
+
   // Wait for all operations that are currently APPLYING to commit.
   //
   // NOTE: this does _not_ guarantee that no transactions are APPLYING upon
@@ -327,6 +365,12 @@ class MvccManager {
     Timestamp timestamp;
     CountDownLatch* latch;
     WaitFor wait_for;
+
+    // Set instead of 'latch' for waits registered with
+    // WaitForAllCommittedAsync(), which are owned by 'waiters_'.
+    int64_t async_handle = 0;
+    ThreadPool* pool = nullptr;
+    boost::function<void()> callback;
   };
 
   // Returns true if all transactions before the given timestamp are committed.
@@ -394,6 +438,9 @@ class MvccManager {
   scoped_refptr<server::Clock> clock_;
   mutable std::vector<WaitingState*> waiters_;
 
+  // The handle to give the next asynchronous waiter.
+  mutable int64_t next_async_handle_ = 1;
+
   DISALLOW_COPY_AND_ASSIGN(MvccManager);
 };
 
@@ -81,6 +81,13 @@ struct RowOp {
   // If this operation is being replayed from the log, set to the original
   // result. Otherwise nullptr.
   const OperationResultPB* orig_result_from_log_;
+
+  // Set during Apply if the presence of this row's key in the tablet has
+  // already been determined by Tablet::BulkCheckPresence(). In that case,
+  // 'present_in_rowset' is the rowset containing the key, or nullptr if the
+  // key is not present in any rowset.
+  bool checked_present = false;
+  RowSet* present_in_rowset = nullptr;
 };
 
 
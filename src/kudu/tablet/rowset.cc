@@ -23,6 +23,7 @@
 #include <vector>
 
 #include "kudu/common/generic_iterators.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/substitute.h"
@@ -34,9 +35,13 @@ using strings::Substitute;
 namespace kudu { namespace tablet {
 
 DuplicatingRowSet::DuplicatingRowSet(RowSetVector old_rowsets,
-                                     RowSetVector new_rowsets)
+                                     RowSetVector new_rowsets,
+                                     RowSetKeySlices old_slices,
+                                     bool dropped_expired_rows)
     : old_rowsets_(std::move(old_rowsets)),
-      new_rowsets_(std::move(new_rowsets)) {
+      new_rowsets_(std::move(new_rowsets)),
+      old_slices_(std::move(old_slices)),
+      dropped_expired_rows_(dropped_expired_rows) {
   CHECK_GT(old_rowsets_.size(), 0);
   CHECK_GT(new_rowsets_.size(), 0);
 }
@@ -116,10 +121,12 @@ Status DuplicatingRowSet::MutateRow(Timestamp timestamp,
 
   // First mutate the relevant input rowset.
   bool updated = false;
+  const RowSetKeySlice* slice = nullptr;
   for (const shared_ptr<RowSet> &rowset : old_rowsets_) {
     Status s = rowset->MutateRow(timestamp, probe, update, op_id, stats, result);
     if (s.ok()) {
       updated = true;
+      slice = FindOrNull(old_slices_, rowset.get());
       break;
     } else if (!s.IsNotFound()) {
       LOG(ERROR) << "Unable to update key "
@@ -134,6 +141,11 @@ Status DuplicatingRowSet::MutateRow(Timestamp timestamp,
     return Status::NotFound("not found in any compaction input");
   }
 
+  // The rows which a sliced input keeps were not compacted into the new rowsets.
+  if (slice != nullptr && !slice->Contains(probe.encoded_key_slice())) {
+    return Status::OK();
+  }
+
   // If it succeeded there, we also need to mirror into the new rowset.
   int mirrored_count = 0;
   for (const shared_ptr<RowSet> &new_rowset : new_rowsets_) {
@@ -153,6 +165,10 @@ Status DuplicatingRowSet::MutateRow(Timestamp timestamp,
     }
     // IsNotFound is OK - it might be in a different one.
   }
+  if (mirrored_count == 0 && dropped_expired_rows_) {
+    // The row expired, so the update is lost along with it.
+    return Status::OK();
+  }
   CHECK_EQ(mirrored_count, 1)
     << "Updated row in compaction input, but didn't mirror in exactly 1 new rowset: "
     << probe.schema()->CreateKeyProjection().DebugRow(probe.row_key());
@@ -171,6 +187,19 @@ Status DuplicatingRowSet::CheckRowPresent(const RowSetKeyProbe &probe,
   return Status::OK();
 }
 
+Status DuplicatingRowSet::CheckRowEverPresent(const RowSetKeyProbe &probe,
+                                              bool *present, ProbeStats* stats) const {
+  // Reads are served by the old rowsets. See NewRowIterator().
+  *present = false;
+  for (const shared_ptr<RowSet> &rowset : old_rowsets_) {
+    RETURN_NOT_OK(rowset->CheckRowEverPresent(probe, present, stats));
+    if (*present) {
+      return Status::OK();
+    }
+  }
+  return Status::OK();
+}
+
 Status DuplicatingRowSet::CountRows(rowid_t *count) const {
   int64_t accumulated_count = 0;
   for (const shared_ptr<RowSet> &rs : new_rowsets_) {
@@ -186,6 +215,20 @@ Status DuplicatingRowSet::CountRows(rowid_t *count) const {
   return Status::OK();
 }
 
+Status DuplicatingRowSet::CountLiveRows(uint64_t* count) const {
+  // Mutations during a flush or compaction are always applied to the old
+  // rowsets, whereas the new ones only receive them once their data has been
+  // written, so the old rowsets are the authoritative source.
+  uint64_t accumulated_count = 0;
+  for (const shared_ptr<RowSet> &rs : old_rowsets_) {
+    uint64_t this_count;
+    RETURN_NOT_OK(rs->CountLiveRows(&this_count));
+    accumulated_count += this_count;
+  }
+  *count = accumulated_count;
+  return Status::OK();
+}
+
 Status DuplicatingRowSet::GetBounds(string* min_encoded_key,
                                     string* max_encoded_key) const {
   // The range out of the output rowset always spans the full range
@@ -198,6 +241,15 @@ Status DuplicatingRowSet::GetBounds(string* min_encoded_key,
   return Status::OK();
 }
 
+Status DuplicatingRowSet::GetIndexKeys(vector<string>* keys) const {
+  // Like EstimateOnDiskSize(), describe the output rowsets, which are in
+  // ascending key order.
+  for (const shared_ptr<RowSet> &rs : new_rowsets_) {
+    RETURN_NOT_OK(rs->GetIndexKeys(keys));
+  }
+  return Status::OK();
+}
+
 uint64_t DuplicatingRowSet::EstimateOnDiskSize() const {
   // The actual value of this doesn't matter, since it won't be selected
   // for compaction.
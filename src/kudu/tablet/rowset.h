@@ -20,6 +20,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/cfile/cfile_util.h"
@@ -36,6 +37,7 @@
 namespace kudu {
 
 class RowChangeList;
+class ScanSpec;
 
 namespace consensus {
 class OpId;
@@ -67,6 +69,14 @@ class RowSet {
   virtual Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                                  ProbeStats* stats) const = 0;
 
+  // Check if a given row key may be visible in this rowset at some snapshot.
+  //
+  // Unlike CheckRowPresent(), a row which was deleted since is still present:
+  // *present is set to false only if no snapshot can see the row in this
+  // rowset, so that readers of any snapshot may skip the rowset.
+  virtual Status CheckRowEverPresent(const RowSetKeyProbe &probe, bool *present,
+                                     ProbeStats* stats) const = 0;
+
   // Update/delete a row in this rowset.
   // The 'update_schema' is the client schema used to encode the 'update' RowChangeList.
   //
@@ -98,6 +108,12 @@ class RowSet {
   // Count the number of rows in this rowset.
   virtual Status CountRows(rowid_t *count) const = 0;
 
+  // Count the number of rows in this rowset which have not been deleted,
+  // taking into account all mutations applied so far, committed or not.
+  // Unlike a scan, this is computed from row counts and delete statistics
+  // alone and does not read any row data.
+  virtual Status CountLiveRows(uint64_t* count) const = 0;
+
   // Return the bounds for this RowSet. 'min_encoded_key' and 'max_encoded_key'
   // are set to the first and last encoded keys for this RowSet.
   //
@@ -106,6 +122,17 @@ class RowSet {
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const = 0;
 
+  // Append to 'keys', in ascending order, a sample of the encoded keys of
+  // this rowset's rows, spaced roughly evenly through its on-disk data.
+  // Rowsets whose data isn't indexed on disk (eg MemRowSet) append nothing.
+  virtual Status GetIndexKeys(std::vector<std::string>* keys) const = 0;
+
+  // Sets '*excluded' to true if the statistics of the rowset's data show that
+  // none of its rows can satisfy the column predicates of 'spec', at any
+  // snapshot, so that a scan may skip the rowset altogether. Rowsets without
+  // such statistics (eg MemRowSet) never exclude a scan.
+  virtual Status ExcludedByPredicates(const ScanSpec& spec, bool* excluded) const = 0;
+
   // Return a displayable string for this rowset.
   virtual string ToString() const = 0;
 
@@ -142,6 +169,19 @@ class RowSet {
   // Compact delta stores if more than one.
   virtual Status MinorCompactDeltaStores() = 0;
 
+  // Estimate the size of the UNDO delta files that may hold only history
+  // older than 'ancient_history_mark', without doing any I/O.
+  virtual int64_t EstimateBytesInPotentiallyAncientUndoDeltas(
+      Timestamp ancient_history_mark) const = 0;
+
+  // Delete the UNDO delta files which hold only history older than
+  // 'ancient_history_mark'. The caller must hold the compact_flush_lock and
+  // flush the tablet metadata afterwards, at which point the blocks are
+  // removed from disk.
+  virtual Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                         int64_t* blocks_deleted,
+                                         int64_t* bytes_deleted) = 0;
+
   virtual ~RowSet() {}
 
   // Return true if this RowSet is available for compaction, based on
@@ -240,16 +280,39 @@ struct ProbeStats {
   int mrs_consulted;
 };
 
+// The rows of a disk rowset which take part in a range-sliced compaction:
+// those with encoded keys at or after 'split_key' if 'compact_upper' is set,
+// otherwise those before it. The rowset keeps its other rows in place.
+struct RowSetKeySlice {
+  bool Contains(const Slice& encoded_key) const {
+    bool at_or_after = encoded_key.compare(split_key) >= 0;
+    return compact_upper ? at_or_after : !at_or_after;
+  }
+
+  std::string split_key;
+  bool compact_upper;
+};
+
+typedef std::unordered_map<const RowSet*, RowSetKeySlice> RowSetKeySlices;
+
 // RowSet which is used during the middle of a flush or compaction.
 // It consists of a set of one or more input rowsets, and a single
 // output rowset. All mutations are duplicated to the appropriate input
 // rowset as well as the output rowset. All reads are directed to the
 // union of the input rowsets.
 //
+// Inputs in 'old_slices' only take part in the compaction with a slice of
+// their keys, and mutations of their other rows aren't mirrored.
+//
+// If 'dropped_expired_rows' is true, the compaction may have dropped expired
+// rows of the inputs, whose mutations can't be mirrored either.
+//
 // See compaction.txt for a little more detail on how this is used.
 class DuplicatingRowSet : public RowSet {
  public:
-  DuplicatingRowSet(RowSetVector old_rowsets, RowSetVector new_rowsets);
+  DuplicatingRowSet(RowSetVector old_rowsets, RowSetVector new_rowsets,
+                    RowSetKeySlices old_slices = RowSetKeySlices(),
+                    bool dropped_expired_rows = false);
 
   virtual Status MutateRow(Timestamp timestamp,
                            const RowSetKeyProbe &probe,
@@ -261,6 +324,9 @@ class DuplicatingRowSet : public RowSet {
   Status CheckRowPresent(const RowSetKeyProbe &probe, bool *present,
                          ProbeStats* stats) const OVERRIDE;
 
+  Status CheckRowEverPresent(const RowSetKeyProbe &probe, bool *present,
+                             ProbeStats* stats) const OVERRIDE;
+
   virtual Status NewRowIterator(const Schema *projection,
                                 const MvccSnapshot &snap,
                                 gscoped_ptr<RowwiseIterator>* out) const OVERRIDE;
@@ -271,9 +337,19 @@ class DuplicatingRowSet : public RowSet {
 
   Status CountRows(rowid_t *count) const OVERRIDE;
 
+  Status CountLiveRows(uint64_t* count) const OVERRIDE;
+
   virtual Status GetBounds(std::string* min_encoded_key,
                            std::string* max_encoded_key) const OVERRIDE;
 
+  Status GetIndexKeys(std::vector<std::string>* keys) const OVERRIDE;
+
+  Status ExcludedByPredicates(const ScanSpec& spec, bool* excluded) const OVERRIDE {
+    // The rowsets being compacted are scanned as they are.
+    *excluded = false;
+    return Status::OK();
+  }
+
   uint64_t EstimateOnDiskSize() const OVERRIDE;
 
   string ToString() const OVERRIDE;
@@ -313,6 +389,19 @@ class DuplicatingRowSet : public RowSet {
 
   Status MinorCompactDeltaStores() OVERRIDE { return Status::OK(); }
 
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas(
+      Timestamp ancient_history_mark) const OVERRIDE {
+    return 0;
+  }
+
+  Status DeleteAncientUndoDeltas(Timestamp ancient_history_mark,
+                                 int64_t* blocks_deleted,
+                                 int64_t* bytes_deleted) OVERRIDE {
+    *blocks_deleted = 0;
+    *bytes_deleted = 0;
+    return Status::OK();
+  }
+
  private:
   friend class Tablet;
 
@@ -320,6 +409,8 @@ class DuplicatingRowSet : public RowSet {
 
   RowSetVector old_rowsets_;
   RowSetVector new_rowsets_;
+  RowSetKeySlices old_slices_;
+  const bool dropped_expired_rows_;
 };
 
 
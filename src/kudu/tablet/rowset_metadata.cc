@@ -87,6 +87,16 @@ Status RowSetMetadata::InitFromPB(const RowSetDataPB& pb) {
     undo_delta_blocks_.push_back(BlockId::FromPB(undo_delta_pb.block()));
   }
 
+  if (pb.has_live_row_begin()) {
+    has_live_range_ = true;
+    live_range_.begin_row = pb.live_row_begin();
+    live_range_.end_row = pb.live_row_end();
+    live_range_.min_encoded_key = pb.live_min_encoded_key();
+    live_range_.max_encoded_key = pb.live_max_encoded_key();
+  }
+
+  column_stats_.assign(pb.column_stats().begin(), pb.column_stats().end());
+
   initted_ = true;
   return Status::OK();
 }
@@ -128,6 +138,18 @@ void RowSetMetadata::ToProtobuf(RowSetDataPB *pb) {
   if (!adhoc_index_block_.IsNull()) {
     adhoc_index_block_.CopyToPB(pb->mutable_adhoc_index_block());
   }
+
+  // Write the live range
+  if (has_live_range_) {
+    pb->set_live_row_begin(live_range_.begin_row);
+    pb->set_live_row_end(live_range_.end_row);
+    pb->set_live_min_encoded_key(live_range_.min_encoded_key);
+    pb->set_live_max_encoded_key(live_range_.max_encoded_key);
+  }
+
+  for (const ColumnStatisticsPB& stats : column_stats_) {
+    *pb->add_column_stats() = stats;
+  }
 }
 
 const string RowSetMetadata::ToString() const {
@@ -191,6 +213,17 @@ Status RowSetMetadata::CommitUpdate(const RowSetMetadataUpdate& update) {
       undo_delta_blocks_.insert(undo_delta_blocks_.begin(), update.new_undo_block_);
     }
 
+    for (const BlockId& b : update.undo_blocks_to_remove_) {
+      auto it = std::find(undo_delta_blocks_.begin(), undo_delta_blocks_.end(), b);
+      if (it == undo_delta_blocks_.end()) {
+        return Status::InvalidArgument(
+            Substitute("Cannot find UNDO delta block $0 in <$1>",
+                       b.ToString(), BlockId::JoinStrings(undo_delta_blocks_)));
+      }
+      removed.push_back(b);
+      undo_delta_blocks_.erase(it);
+    }
+
     for (const ColumnIdToBlockIdMap::value_type& e : update.cols_to_replace_) {
       // If we are major-compacting deltas into a column which previously had no
       // base-data (e.g. because it was newly added), then there will be no original
@@ -264,5 +297,11 @@ RowSetMetadataUpdate& RowSetMetadataUpdate::SetNewUndoBlock(const BlockId& undo_
   return *this;
 }
 
+RowSetMetadataUpdate& RowSetMetadataUpdate::RemoveUndoDeltaBlocks(
+    const std::vector<BlockId>& to_remove) {
+  undo_blocks_to_remove_.insert(undo_blocks_to_remove_.end(), to_remove.begin(), to_remove.end());
+  return *this;
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -142,6 +142,40 @@ class RowSetMetadata {
     return undo_delta_blocks_;
   }
 
+  // Returns true if a range-sliced compaction moved some of this rowset's
+  // rows into other rowsets. See RowSetLiveRange.
+  bool has_live_range() const {
+    std::lock_guard<LockType> l(lock_);
+    return has_live_range_;
+  }
+
+  RowSetLiveRange live_range() const {
+    std::lock_guard<LockType> l(lock_);
+    DCHECK(has_live_range_);
+    return live_range_;
+  }
+
+  // Only the tablet metadata may narrow a rowset, atomically with adding the
+  // rowsets which took over its other rows. See TabletMetadata::UpdateAndFlush().
+  void SetLiveRange(const RowSetLiveRange& live_range) {
+    std::lock_guard<LockType> l(lock_);
+    DCHECK_LT(live_range.begin_row, live_range.end_row);
+    has_live_range_ = true;
+    live_range_ = live_range;
+  }
+
+  // Returns the statistics of the values of each column, as they were
+  // written. Empty if they weren't collected.
+  std::vector<ColumnStatisticsPB> column_stats() const {
+    std::lock_guard<LockType> l(lock_);
+    return column_stats_;
+  }
+
+  void SetColumnStats(std::vector<ColumnStatisticsPB> column_stats) {
+    std::lock_guard<LockType> l(lock_);
+    column_stats_ = std::move(column_stats);
+  }
+
   TabletMetadata *tablet_metadata() const { return tablet_metadata_; }
 
   int64_t last_durable_redo_dms_id() const {
@@ -184,7 +218,8 @@ class RowSetMetadata {
   explicit RowSetMetadata(TabletMetadata *tablet_metadata)
     : tablet_metadata_(tablet_metadata),
       initted_(false),
-      last_durable_redo_dms_id_(kNoDurableMemStore) {
+      last_durable_redo_dms_id_(kNoDurableMemStore),
+      has_live_range_(false) {
   }
 
   RowSetMetadata(TabletMetadata *tablet_metadata,
@@ -192,7 +227,8 @@ class RowSetMetadata {
     : tablet_metadata_(DCHECK_NOTNULL(tablet_metadata)),
       initted_(true),
       id_(id),
-      last_durable_redo_dms_id_(kNoDurableMemStore) {
+      last_durable_redo_dms_id_(kNoDurableMemStore),
+      has_live_range_(false) {
   }
 
   Status InitFromPB(const RowSetDataPB& pb);
@@ -216,6 +252,11 @@ class RowSetMetadata {
 
   int64_t last_durable_redo_dms_id_;
 
+  bool has_live_range_;
+  RowSetLiveRange live_range_;
+
+  std::vector<ColumnStatisticsPB> column_stats_;
+
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadata);
 };
 
@@ -245,6 +286,9 @@ class RowSetMetadataUpdate {
   // We'll need to replace them instead when we start GCing.
   RowSetMetadataUpdate& SetNewUndoBlock(const BlockId& undo_block);
 
+  // Remove the given UNDO delta blocks, e.g. once they hold only ancient history.
+  RowSetMetadataUpdate& RemoveUndoDeltaBlocks(const std::vector<BlockId>& to_remove);
+
  private:
   friend class RowSetMetadata;
   RowSetMetadata::ColumnIdToBlockIdMap cols_to_replace_;
@@ -257,6 +301,7 @@ class RowSetMetadataUpdate {
   };
   std::vector<ReplaceDeltaBlocks> replace_redo_blocks_;
   BlockId new_undo_block_;
+  std::vector<BlockId> undo_blocks_to_remove_;
 
   DISALLOW_COPY_AND_ASSIGN(RowSetMetadataUpdate);
 };
@@ -102,6 +102,114 @@ TEST_F(TestRowSetTree, TestTree) {
   ASSERT_EQ(vec[0].get(), out[1]);
   ASSERT_EQ(vec[1].get(), out[2]);
   ASSERT_EQ(vec[2].get(), out[3]);
+
+  // [6, +inf) overlaps 5-9 and the MemRowSet.
+  Slice key("6");
+  out.clear();
+  tree.FindRowSetsIntersectingOpenInterval(&key, nullptr, &out);
+  ASSERT_EQ(2, out.size());
+  ASSERT_EQ(vec[3].get(), out[0]);
+  ASSERT_EQ(vec[2].get(), out[1]);
+
+  // [5, +inf) overlaps 0-5, 3-5, 5-9 and the MemRowSet.
+  key = Slice("5");
+  out.clear();
+  tree.FindRowSetsIntersectingOpenInterval(&key, nullptr, &out);
+  ASSERT_EQ(4, out.size());
+  ASSERT_EQ(vec[3].get(), out[0]);
+
+  // (-inf, 2] overlaps 0-5 and the MemRowSet.
+  key = Slice("2");
+  out.clear();
+  tree.FindRowSetsIntersectingOpenInterval(nullptr, &key, &out);
+  ASSERT_EQ(2, out.size());
+  ASSERT_EQ(vec[3].get(), out[0]);
+  ASSERT_EQ(vec[0].get(), out[1]);
+
+  // (-inf, +inf) overlaps everything.
+  out.clear();
+  tree.FindRowSetsIntersectingOpenInterval(nullptr, nullptr, &out);
+  ASSERT_EQ(4, out.size());
+}
+
+TEST_F(TestRowSetTree, TestForEachRowSetContainingKeys) {
+  RowSetVector vec;
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("0", "5")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("3", "5")));
+  vec.push_back(shared_ptr<RowSet>(new MockDiskRowSet("5", "9")));
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(vec));
+
+  // The batched lookup must agree with one FindRowSetsWithKeyInRange() per key.
+  vector<string> key_strs = { "", "0", "2", "4", "4", "5", "7", "9", "a" };
+  vector<Slice> keys(key_strs.begin(), key_strs.end());
+  vector<unordered_set<RowSet*>> batched(keys.size());
+  tree.ForEachRowSetContainingKeys(keys, [&](RowSet* rs, int i) {
+      ASSERT_TRUE(InsertIfNotPresent(&batched[i], rs));
+    });
+  for (int i = 0; i < keys.size(); i++) {
+    SCOPED_TRACE(key_strs[i]);
+    vector<RowSet*> out;
+    tree.FindRowSetsWithKeyInRange(keys[i], &out);
+    unordered_set<RowSet*> expected(out.begin(), out.end());
+    ASSERT_EQ(expected, batched[i]);
+  }
+}
+
+// An incremental Reset() must build the same tree as a full one over the
+// resulting rowsets.
+TEST_F(TestRowSetTree, TestIncrementalReset) {
+  SeedRandom();
+  RowSetVector vec = GenerateRandomRowSets(100);
+  vec.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+  RowSetTree old_tree;
+  ASSERT_OK(old_tree.Reset(vec));
+
+  // Swap out every third rowset, including the MemRowSet, for a few new ones.
+  RowSetVector to_remove;
+  RowSetVector remaining;
+  for (int i = 0; i < vec.size(); i++) {
+    if (i % 3 == 0 || i == vec.size() - 1) {
+      to_remove.push_back(vec[i]);
+    } else {
+      remaining.push_back(vec[i]);
+    }
+  }
+  RowSetVector to_add = GenerateRandomRowSets(10);
+  to_add.push_back(shared_ptr<RowSet>(new MockMemRowSet()));
+
+  RowSetTree tree;
+  ASSERT_OK(tree.Reset(old_tree, to_remove, to_add));
+
+  RowSetVector expected_rowsets = remaining;
+  expected_rowsets.insert(expected_rowsets.end(), to_add.begin(), to_add.end());
+  RowSetTree expected;
+  ASSERT_OK(expected.Reset(expected_rowsets));
+
+  ASSERT_EQ(expected.all_rowsets(), tree.all_rowsets());
+  ASSERT_EQ(expected.key_endpoints().size(), tree.key_endpoints().size());
+  for (int i = 0; i < tree.key_endpoints().size(); i++) {
+    const RowSetTree::RSEndpoint& a = expected.key_endpoints()[i];
+    const RowSetTree::RSEndpoint& b = tree.key_endpoints()[i];
+    ASSERT_EQ(a.rowset_, b.rowset_);
+    ASSERT_EQ(a.endpoint_, b.endpoint_);
+    ASSERT_EQ(a.slice_, b.slice_);
+  }
+  for (int key = 0; key < 10000; key += 37) {
+    string key_str = StringPrintf("%04d", key);
+    vector<RowSet*> a, b;
+    expected.FindRowSetsWithKeyInRange(key_str, &a);
+    tree.FindRowSetsWithKeyInRange(key_str, &b);
+    ASSERT_EQ(unordered_set<RowSet*>(a.begin(), a.end()),
+              unordered_set<RowSet*>(b.begin(), b.end())) << key_str;
+  }
+
+  // The old tree is untouched.
+  vector<RowSet*> out;
+  old_tree.FindRowSetsIntersectingInterval("0000", "9999", &out);
+  ASSERT_EQ(vec.size(), out.size());
 }
 
 TEST_F(TestRowSetTree, TestPerformance) {
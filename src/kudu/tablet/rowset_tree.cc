@@ -21,9 +21,10 @@
 #include <cstddef>
 #include <memory>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
-#include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/tablet/rowset.h"
 #include "kudu/tablet/rowset_metadata.h"
 #include "kudu/util/interval_tree.h"
@@ -32,6 +33,7 @@
 
 using std::vector;
 using std::shared_ptr;
+using std::unordered_set;
 
 namespace kudu {
 namespace tablet {
@@ -76,15 +78,39 @@ struct RowSetIntervalTraits {
   }
 };
 
+namespace {
+
+// Fetches the bounds of 'rs' into a new tree entry. Returns NotSupported if
+// the rowset's bounds aren't fixed, as for a MemRowSet.
+Status FetchBounds(const shared_ptr<RowSet>& rs, shared_ptr<RowSetWithBounds>* entry) {
+  shared_ptr<RowSetWithBounds> rsit(new RowSetWithBounds());
+  rsit->rowset = rs.get();
+  Status s = rs->GetBounds(&rsit->min_key, &rsit->max_key);
+  if (s.IsNotSupported()) {
+    return s;
+  }
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to construct RowSetTree: "
+                 << rs->ToString() << " unable to determine its bounds: "
+                 << s.ToString();
+    return s;
+  }
+  DCHECK_LE(rsit->min_key.compare(rsit->max_key), 0)
+    << "Rowset min must be <= max: " << rs->ToString();
+  *entry = std::move(rsit);
+  return Status::OK();
+}
+
+} // anonymous namespace
+
 RowSetTree::RowSetTree()
   : initted_(false) {
 }
 
 Status RowSetTree::Reset(const RowSetVector &rowsets) {
   CHECK(!initted_);
-  std::vector<RowSetWithBounds *> entries;
+  std::vector<shared_ptr<RowSetWithBounds>> entries;
   RowSetVector unbounded;
-  ElementDeleter deleter(&entries);
   entries.reserve(rowsets.size());
   std::vector<RSEndpoint> endpoints;
   endpoints.reserve(rowsets.size()*2);
@@ -92,10 +118,8 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   // Iterate over each of the provided RowSets, fetching their
   // bounds and adding them to the local vectors.
   for (const shared_ptr<RowSet> &rs : rowsets) {
-    gscoped_ptr<RowSetWithBounds> rsit(new RowSetWithBounds());
-    rsit->rowset = rs.get();
-    string min_key, max_key;
-    Status s = rs->GetBounds(&min_key, &max_key);
+    shared_ptr<RowSetWithBounds> rsit;
+    Status s = FetchBounds(rs, &rsit);
     if (s.IsNotSupported()) {
       // This rowset is a MemRowSet, for which the bounds change as more
       // data gets inserted. Therefore we can't put it in the static
@@ -103,24 +127,14 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
       // on every access.
       unbounded.push_back(rs);
       continue;
-    } else if (!s.ok()) {
-      LOG(WARNING) << "Unable to construct RowSetTree: "
-                   << rs->ToString() << " unable to determine its bounds: "
-                   << s.ToString();
-      return s;
     }
-    DCHECK_LE(min_key.compare(max_key), 0)
-      << "Rowset min must be <= max: " << rs->ToString();
-
-    // Load bounds and save entry
-    rsit->min_key = std::move(min_key);
-    rsit->max_key = std::move(max_key);
+    RETURN_NOT_OK(s);
 
     // Load into key endpoints.
     endpoints.push_back(RSEndpoint(rsit->rowset, START, rsit->min_key));
     endpoints.push_back(RSEndpoint(rsit->rowset, STOP, rsit->max_key));
 
-    entries.push_back(rsit.release());
+    entries.push_back(std::move(rsit));
   }
 
   // Sort endpoints
@@ -129,7 +143,7 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   // Install the vectors into the object.
   entries_.swap(entries);
   unbounded_rowsets_.swap(unbounded);
-  tree_.reset(new IntervalTree<RowSetIntervalTraits>(entries_));
+  BuildIntervalTree();
   key_endpoints_.swap(endpoints);
   all_rowsets_.assign(rowsets.begin(), rowsets.end());
 
@@ -146,53 +160,213 @@ Status RowSetTree::Reset(const RowSetVector &rowsets) {
   return Status::OK();
 }
 
+Status RowSetTree::Reset(const RowSetTree& old_tree,
+                         const RowSetVector& to_remove,
+                         const RowSetVector& to_add) {
+  CHECK(!initted_);
+  DCHECK(old_tree.initted_);
+  unordered_set<const RowSet*> removed;
+  for (const shared_ptr<RowSet>& rs : to_remove) {
+    removed.insert(rs.get());
+  }
+
+  // Carry over what is known of the remaining rowsets, keeping their order.
+  RowSetVector all_rowsets;
+  all_rowsets.reserve(old_tree.all_rowsets_.size() + to_add.size());
+  for (const shared_ptr<RowSet>& rs : old_tree.all_rowsets_) {
+    if (!ContainsKey(removed, rs.get())) {
+      all_rowsets.push_back(rs);
+    }
+  }
+  CHECK_EQ(old_tree.all_rowsets_.size() - all_rowsets.size(), to_remove.size())
+      << "Rowsets to remove must all be in the tree";
+
+  std::vector<shared_ptr<RowSetWithBounds>> entries;
+  entries.reserve(old_tree.entries_.size() + to_add.size());
+  for (const shared_ptr<RowSetWithBounds>& e : old_tree.entries_) {
+    if (!ContainsKey(removed, e->rowset)) {
+      entries.push_back(e);
+    }
+  }
+  RowSetVector unbounded;
+  for (const shared_ptr<RowSet>& rs : old_tree.unbounded_rowsets_) {
+    if (!ContainsKey(removed, rs.get())) {
+      unbounded.push_back(rs);
+    }
+  }
+  std::vector<RSEndpoint> endpoints;
+  endpoints.reserve(entries.capacity() * 2);
+  for (const RSEndpoint& e : old_tree.key_endpoints_) {
+    if (!ContainsKey(removed, e.rowset_)) {
+      endpoints.push_back(e);
+    }
+  }
+
+  // Only the bounds of the new rowsets need to be fetched and sorted; they
+  // are then merged into the endpoints which are already in order.
+  size_t num_old_endpoints = endpoints.size();
+  for (const shared_ptr<RowSet>& rs : to_add) {
+    shared_ptr<RowSetWithBounds> rsit;
+    Status s = FetchBounds(rs, &rsit);
+    if (s.IsNotSupported()) {
+      unbounded.push_back(rs);
+      continue;
+    }
+    RETURN_NOT_OK(s);
+    endpoints.push_back(RSEndpoint(rsit->rowset, START, rsit->min_key));
+    endpoints.push_back(RSEndpoint(rsit->rowset, STOP, rsit->max_key));
+    entries.push_back(std::move(rsit));
+  }
+  std::sort(endpoints.begin() + num_old_endpoints, endpoints.end(), RSEndpointBySliceCompare);
+  std::inplace_merge(endpoints.begin(), endpoints.begin() + num_old_endpoints, endpoints.end(),
+                     RSEndpointBySliceCompare);
+  all_rowsets.insert(all_rowsets.end(), to_add.begin(), to_add.end());
+
+  entries_.swap(entries);
+  unbounded_rowsets_.swap(unbounded);
+  BuildIntervalTree();
+  key_endpoints_.swap(endpoints);
+  all_rowsets_.swap(all_rowsets);
+
+  drs_by_id_ = old_tree.drs_by_id_;
+  for (const shared_ptr<RowSet>& rs : to_remove) {
+    if (rs->metadata()) {
+      drs_by_id_.erase(rs->metadata()->id());
+    }
+  }
+  for (const shared_ptr<RowSet>& rs : to_add) {
+    if (rs->metadata()) {
+      InsertOrDie(&drs_by_id_, rs->metadata()->id(), rs.get());
+    }
+  }
+
+  initted_ = true;
+
+  return Status::OK();
+}
+
+void RowSetTree::BuildIntervalTree() {
+  std::vector<RowSetWithBounds*> intervals;
+  intervals.reserve(entries_.size());
+  for (const shared_ptr<RowSetWithBounds>& e : entries_) {
+    intervals.push_back(e.get());
+  }
+  tree_.reset(new IntervalTree<RowSetIntervalTraits>(intervals));
+}
+
 void RowSetTree::FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                                  const Slice &upper_bound,
                                                  vector<RowSet *> *rowsets) const {
+  ForEachRowSetIntersectingInterval(lower_bound, upper_bound, [&](RowSet* rs) {
+      rowsets->push_back(rs);
+    });
+}
+
+void RowSetTree::ForEachRowSetIntersectingInterval(
+    const Slice& lower_bound,
+    const Slice& upper_bound,
+    const std::function<void(RowSet*)>& cb) const {
   DCHECK(initted_);
 
   // All rowsets with unknown bounds need to be checked.
   for (const shared_ptr<RowSet> &rs : unbounded_rowsets_) {
-    rowsets->push_back(rs.get());
+    cb(rs.get());
   }
 
-  // perf TODO: make it possible to query using raw Slices
-  // instead of copying to strings here
-  RowSetWithBounds query;
-  query.min_key = lower_bound.ToString();
-  query.max_key = upper_bound.ToString();
+  tree_->ForEachIntervalIntersecting(lower_bound, upper_bound, [&](RowSetWithBounds* rs) {
+      cb(rs->rowset);
+    });
+}
 
-  vector<RowSetWithBounds *> from_tree;
-  from_tree.reserve(all_rowsets_.size());
-  tree_->FindIntersectingInterval(&query, &from_tree);
-  rowsets->reserve(rowsets->size() + from_tree.size());
-  for (RowSetWithBounds *rs : from_tree) {
-    rowsets->push_back(rs->rowset);
+void RowSetTree::FindRowSetsIntersectingOpenInterval(const Slice* lower_bound,
+                                                     const Slice* upper_bound,
+                                                     vector<RowSet *> *rowsets) const {
+  DCHECK(initted_);
+  if (lower_bound && upper_bound) {
+    FindRowSetsIntersectingInterval(*lower_bound, *upper_bound, rowsets);
+    return;
+  }
+
+  // All rowsets with unknown bounds need to be checked.
+  for (const shared_ptr<RowSet> &rs : unbounded_rowsets_) {
+    rowsets->push_back(rs.get());
+  }
+
+  // With a single bound, sweep the sorted endpoints from that bound out: a
+  // rowset intersects [lower_bound, +inf) iff its max key is at or after
+  // 'lower_bound', and (-inf, upper_bound] iff its min key is at or before
+  // 'upper_bound'.
+  if (lower_bound) {
+    auto it = std::lower_bound(key_endpoints_.begin(), key_endpoints_.end(), *lower_bound,
+                               [](const RSEndpoint& e, const Slice& key) {
+                                 return e.slice_.compare(key) < 0;
+                               });
+    for (; it != key_endpoints_.end(); ++it) {
+      if (it->endpoint_ == STOP) {
+        rowsets->push_back(it->rowset_);
+      }
+    }
+  } else if (upper_bound) {
+    for (const RSEndpoint& e : key_endpoints_) {
+      if (e.slice_.compare(*upper_bound) > 0) {
+        break;
+      }
+      if (e.endpoint_ == START) {
+        rowsets->push_back(e.rowset_);
+      }
+    }
+  } else {
+    for (const shared_ptr<RowSetWithBounds>& rs : entries_) {
+      rowsets->push_back(rs->rowset);
+    }
   }
 }
 
 void RowSetTree::FindRowSetsWithKeyInRange(const Slice &encoded_key,
                                            vector<RowSet *> *rowsets) const {
+  ForEachRowSetContainingKey(encoded_key, [&](RowSet* rs) {
+      rowsets->push_back(rs);
+    });
+}
+
+void RowSetTree::ForEachRowSetContainingKey(const Slice& encoded_key,
+                                            const std::function<void(RowSet*)>& cb) const {
   DCHECK(initted_);
 
   // All rowsets with unknown bounds need to be checked.
   for (const shared_ptr<RowSet> &rs : unbounded_rowsets_) {
-    rowsets->push_back(rs.get());
+    cb(rs.get());
   }
 
   // Query the interval tree to efficiently find rowsets with known bounds
   // whose ranges overlap the probe key.
-  vector<RowSetWithBounds *> from_tree;
-  from_tree.reserve(all_rowsets_.size());
-  tree_->FindContainingPoint(encoded_key, &from_tree);
-  rowsets->reserve(rowsets->size() + from_tree.size());
-  for (RowSetWithBounds *rs : from_tree) {
-    rowsets->push_back(rs->rowset);
+  tree_->ForEachIntervalContainingPoint(encoded_key, [&](RowSetWithBounds* rs) {
+      cb(rs->rowset);
+    });
+}
+
+void RowSetTree::ForEachRowSetContainingKeys(
+    const vector<Slice>& sorted_encoded_keys,
+    const std::function<void(RowSet*, int)>& cb) const {
+  DCHECK(initted_);
+  DCHECK(std::is_sorted(sorted_encoded_keys.begin(), sorted_encoded_keys.end(),
+                        [](const Slice& a, const Slice& b) { return a.compare(b) < 0; }));
+
+  // All rowsets with unknown bounds need to be checked.
+  for (const shared_ptr<RowSet> &rs : unbounded_rowsets_) {
+    for (int i = 0; i < sorted_encoded_keys.size(); i++) {
+      cb(rs.get(), i);
+    }
   }
+
+  tree_->ForEachIntervalContainingPoints(
+      sorted_encoded_keys,
+      [&](int idx, RowSetWithBounds* rs) {
+        cb(rs->rowset, idx);
+      });
 }
 
 RowSetTree::~RowSetTree() {
-  STLDeleteElements(&entries_);
 }
 
 } // namespace tablet
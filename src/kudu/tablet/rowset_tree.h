@@ -17,6 +17,8 @@
 #ifndef KUDU_TABLET_ROWSET_MANAGER_H
 #define KUDU_TABLET_ROWSET_MANAGER_H
 
+#include <functional>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <utility>
@@ -64,6 +66,17 @@ class RowSetTree {
 
   RowSetTree();
   Status Reset(const RowSetVector &rowsets);
+
+  // Like Reset(), but with the rowsets of 'old_tree' less 'to_remove' and
+  // plus 'to_add', as when rowsets are swapped after a flush or compaction.
+  // The bounds of the rowsets carried over are shared with 'old_tree' rather
+  // than fetched again, and their endpoints are merged with those of the
+  // added rowsets rather than sorted from scratch.
+  //
+  // Every rowset in 'to_remove' must be in 'old_tree'.
+  Status Reset(const RowSetTree& old_tree,
+               const RowSetVector& to_remove,
+               const RowSetVector& to_add);
   ~RowSetTree();
 
   // Return all RowSets whose range may contain the given encoded key.
@@ -73,10 +86,40 @@ class RowSetTree {
   void FindRowSetsWithKeyInRange(const Slice &encoded_key,
                                  std::vector<RowSet *> *rowsets) const;
 
+  // Call 'cb(rowset)' for every RowSet whose range may contain the given
+  // encoded key, in the order FindRowSetsWithKeyInRange() returns them.
+  // Unlike FindRowSetsWithKeyInRange(), this doesn't allocate.
+  void ForEachRowSetContainingKey(const Slice& encoded_key,
+                                  const std::function<void(RowSet*)>& cb) const;
+
+  // For each of the given encoded keys, which must be sorted in ascending
+  // order, call 'cb(rowset, key_index)' for every RowSet whose range may
+  // contain the key. 'key_index' is the position of the key in
+  // 'sorted_encoded_keys'.
+  //
+  // This is equivalent to calling FindRowSetsWithKeyInRange() once per key,
+  // but sweeps the interval tree only once for the whole batch. The callbacks
+  // are made in no particular order.
+  void ForEachRowSetContainingKeys(const std::vector<Slice>& sorted_encoded_keys,
+                                   const std::function<void(RowSet*, int)>& cb) const;
+
   void FindRowSetsIntersectingInterval(const Slice &lower_bound,
                                        const Slice &upper_bound,
                                        std::vector<RowSet *> *rowsets) const;
 
+  // Call 'cb(rowset)' for every RowSet whose range may intersect the closed
+  // interval ['lower_bound', 'upper_bound'], without allocating.
+  void ForEachRowSetIntersectingInterval(const Slice& lower_bound,
+                                         const Slice& upper_bound,
+                                         const std::function<void(RowSet*)>& cb) const;
+
+  // Like FindRowSetsIntersectingInterval(), but either bound may be null, for
+  // an interval which is open on that side, such as the rest of a scan which
+  // resumes from the last key it returned.
+  void FindRowSetsIntersectingOpenInterval(const Slice* lower_bound,
+                                           const Slice* upper_bound,
+                                           std::vector<RowSet *> *rowsets) const;
+
   const RowSetVector &all_rowsets() const { return all_rowsets_; }
 
   RowSet* drs_by_id(int64_t drs_id) const {
@@ -98,10 +141,12 @@ class RowSetTree {
   // TODO map to usage statistics as well. See KUDU-???
   std::vector<RSEndpoint> key_endpoints_;
 
-  // Container for all of the entries in tree_. IntervalTree does
-  // not itself manage memory, so this provides a simple way to enumerate
-  // all the entry structs and free them in the destructor.
-  std::vector<RowSetWithBounds *> entries_;
+  // Container for all of the entries in tree_, which IntervalTree does
+  // not itself manage the memory of.
+  //
+  // The entries of the rowsets carried over by an incremental Reset() are
+  // shared with the tree they came from.
+  std::vector<std::shared_ptr<RowSetWithBounds>> entries_;
 
   // All of the rowsets which were put in this RowSetTree.
   RowSetVector all_rowsets_;
@@ -117,6 +162,9 @@ class RowSetTree {
   RowSetVector unbounded_rowsets_;
 
   bool initted_;
+
+  // Builds 'tree_' out of 'entries_'.
+  void BuildIntervalTree();
 };
 
 } // namespace tablet
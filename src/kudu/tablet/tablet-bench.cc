@@ -0,0 +1,339 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+//
+// Benchmarks of the write and scan paths of a single tablet, driven directly
+// through LocalTabletWriter and Tablet::NewRowIterator() with neither RPC nor
+// consensus in the way.
+//
+// Each benchmark first builds the tablet into a controlled layout:
+// --tablet_bench_num_rowsets flushed rowsets of --tablet_bench_rows_per_rowset
+// rows each, either all spanning the whole key range or each covering a range
+// of its own, with --tablet_bench_delta_files flushed delta files per rowset
+// and --tablet_bench_mrs_rows rows left in the MemRowSet. The layout's rows
+// have even keys, so that inserts of odd keys within the range have to be
+// checked against the rowsets without finding a duplicate.
+//
+// Along with the throughput, the results include the bloom filter, key file,
+// delta file and MemRowSet lookups per operation, from the tablet's metrics,
+// and for scans the cells read from disk per row, as measures of read
+// amplification.
+
+#include <algorithm>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/common/iterator_stats.h"
+#include "kudu/gutil/strings/join.h"
+#include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/local_tablet_writer.h"
+#include "kudu/tablet/tablet-test-base.h"
+#include "kudu/tablet/tablet_metrics.h"
+#include "kudu/util/env.h"
+#include "kudu/util/jsonwriter.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/random.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/test_util.h"
+
+DEFINE_int32(tablet_bench_num_rowsets, 10, "Number of flushed rowsets in the layout");
+DEFINE_int32(tablet_bench_rows_per_rowset, 10000, "Number of rows in each flushed rowset");
+DEFINE_bool(tablet_bench_overlapping_rowsets, true,
+            "Whether each rowset of the layout spans the whole key range, rather than "
+            "a range of its own");
+DEFINE_int32(tablet_bench_delta_files, 0,
+             "Number of flushed delta files in each rowset of the layout. Each holds an "
+             "update of every --tablet_bench_delta_stride'th row of the rowset.");
+DEFINE_int32(tablet_bench_delta_stride, 10,
+             "Which rows the updates of each delta file of the layout touch");
+DEFINE_int32(tablet_bench_mrs_rows, 0, "Number of rows left in the MemRowSet of the layout");
+DEFINE_int32(tablet_bench_num_ops, 10000, "Number of rows written by each write benchmark");
+DEFINE_int32(tablet_bench_batch_size, 1, "Number of rows per write transaction");
+DEFINE_int32(tablet_bench_scan_iterations, 5, "Number of full scans timed by the scan benchmark");
+
+DEFINE_string(json_output_path, "",
+              "If set, the results of all the benchmarks run by this process are "
+              "written to this file as a JSON array");
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+namespace {
+
+// The JSON results of the benchmarks run so far, for --json_output_path.
+simple_spinlock json_results_lock;
+vector<string> json_results;
+
+// The lookup counters of the tablet, for the per-operation read amplification.
+struct LookupCounts {
+  explicit LookupCounts(const TabletMetrics* m)
+      : bloom(m->bloom_lookups->value()),
+        key_file(m->key_file_lookups->value()),
+        delta_file(m->delta_file_lookups->value()),
+        mrs(m->mrs_lookups->value()) {
+  }
+
+  int64_t bloom;
+  int64_t key_file;
+  int64_t delta_file;
+  int64_t mrs;
+};
+
+} // anonymous namespace
+
+class TabletBench : public TabletTestBase<IntKeyTestSetup<INT64>> {
+ public:
+  void SetUp() override {
+    TabletTestBase<IntKeyTestSetup<INT64>>::SetUp();
+    ASSERT_NO_FATAL_FAILURE(BuildLayout());
+  }
+
+ protected:
+  int64_t layout_rows() const {
+    return static_cast<int64_t>(FLAGS_tablet_bench_num_rowsets) *
+        FLAGS_tablet_bench_rows_per_rowset;
+  }
+
+  // The key index of the 'i'th row of rowset 'rs'. The key itself is twice
+  // that, see above.
+  int64_t LayoutKeyIdx(int rs, int64_t i) const {
+    if (FLAGS_tablet_bench_overlapping_rowsets) {
+      return i * FLAGS_tablet_bench_num_rowsets + rs;
+    }
+    return rs * static_cast<int64_t>(FLAGS_tablet_bench_rows_per_rowset) + i;
+  }
+
+  // Returns the keys of all the rows of the layout in a random order, so that
+  // a batch doesn't write the same row twice.
+  vector<int64_t> ShuffledLayoutKeys() {
+    int64_t num_keys = layout_rows() + FLAGS_tablet_bench_mrs_rows;
+    vector<int64_t> keys(num_keys);
+    for (int64_t i = 0; i < num_keys; i++) {
+      keys[i] = 2 * i;
+    }
+    Random rng(SeedRandom());
+    for (int64_t i = num_keys - 1; i > 0; i--) {
+      std::swap(keys[i], keys[rng.Uniform64(i + 1)]);
+    }
+    return keys;
+  }
+
+  void BuildLayout() {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow row(&client_schema_);
+    for (int rs = 0; rs < FLAGS_tablet_bench_num_rowsets; rs++) {
+      for (int64_t i = 0; i < FLAGS_tablet_bench_rows_per_rowset; i++) {
+        setup_.BuildRow(&row, 2 * LayoutKeyIdx(rs, i));
+        ASSERT_OK(writer.Insert(row));
+      }
+      ASSERT_OK(tablet()->Flush());
+    }
+
+    for (int d = 0; d < FLAGS_tablet_bench_delta_files; d++) {
+      for (int rs = 0; rs < FLAGS_tablet_bench_num_rowsets; rs++) {
+        for (int64_t i = 0; i < FLAGS_tablet_bench_rows_per_rowset;
+             i += FLAGS_tablet_bench_delta_stride) {
+          ASSERT_OK(UpdateTestRow(&writer, 2 * LayoutKeyIdx(rs, i), d + 1));
+        }
+      }
+      vector<std::shared_ptr<RowSet>> rowsets;
+      tablet()->GetRowSetsForTests(&rowsets);
+      for (const auto& rs : rowsets) {
+        ASSERT_OK(rs->FlushDeltas());
+      }
+    }
+
+    // The MemRowSet's rows come after the flushed ones.
+    for (int64_t i = 0; i < FLAGS_tablet_bench_mrs_rows; i++) {
+      setup_.BuildRow(&row, 2 * (layout_rows() + i));
+      ASSERT_OK(writer.Insert(row));
+    }
+  }
+
+  // Runs FLAGS_tablet_bench_num_ops write operations of type 'type', in
+  // batches of --tablet_bench_batch_size, on the rows with the key indexes
+  // returned by 'next_key'.
+  template<class KeyFunc>
+  void RunWrites(const string& name, RowOperationsPB::Type type, const KeyFunc& next_key) {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    int batch_size = std::max(1, FLAGS_tablet_bench_batch_size);
+    vector<KuduPartialRow> rows(batch_size, KuduPartialRow(&client_schema_));
+    vector<LocalTabletWriter::Op> ops;
+
+    LookupCounts before(tablet()->metrics());
+    Stopwatch sw(Stopwatch::ALL_THREADS);
+    sw.start();
+    for (int64_t done = 0; done < FLAGS_tablet_bench_num_ops; done += ops.size()) {
+      ops.clear();
+      int n = std::min<int64_t>(batch_size, FLAGS_tablet_bench_num_ops - done);
+      for (int i = 0; i < n; i++) {
+        if (type == RowOperationsPB::UPDATE) {
+          setup_.BuildRowKey(&rows[i], next_key());
+          CHECK_OK(rows[i].SetInt32(2, -1));
+        } else {
+          setup_.BuildRow(&rows[i], next_key(), -1);
+        }
+        ops.emplace_back(type, &rows[i]);
+      }
+      ASSERT_OK(writer.WriteBatch(ops));
+    }
+    sw.stop();
+    LookupCounts after(tablet()->metrics());
+    Report(name, FLAGS_tablet_bench_num_ops, sw.elapsed(), before, after, 0);
+  }
+
+  void Report(const string& name, int64_t num_ops, const CpuTimes& elapsed,
+              const LookupCounts& before, const LookupCounts& after,
+              int64_t cells_read_from_disk) {
+    double ops = static_cast<double>(num_ops);
+    LOG(INFO) << name << ": " << num_ops << " ops in " << elapsed.ToString();
+    LOG(INFO) << "Ops/sec:             " << ops / elapsed.wall_seconds();
+    LOG(INFO) << "Bloom lookups/op:    " << (after.bloom - before.bloom) / ops;
+    LOG(INFO) << "Key file lookups/op: " << (after.key_file - before.key_file) / ops;
+    LOG(INFO) << "Delta file lookups/op: " << (after.delta_file - before.delta_file) / ops;
+
+    std::stringstream json;
+    JsonWriter jw(&json, JsonWriter::COMPACT);
+    jw.StartObject();
+    jw.String("name");
+    jw.String(name);
+    jw.String("num_rowsets");
+    jw.Int(FLAGS_tablet_bench_num_rowsets);
+    jw.String("actual_num_rowsets");
+    jw.Int64(tablet()->num_rowsets());
+    jw.String("rows_per_rowset");
+    jw.Int(FLAGS_tablet_bench_rows_per_rowset);
+    jw.String("overlapping_rowsets");
+    jw.Bool(FLAGS_tablet_bench_overlapping_rowsets);
+    jw.String("delta_files");
+    jw.Int(FLAGS_tablet_bench_delta_files);
+    jw.String("delta_stride");
+    jw.Int(FLAGS_tablet_bench_delta_stride);
+    jw.String("mrs_rows");
+    jw.Int(FLAGS_tablet_bench_mrs_rows);
+    jw.String("batch_size");
+    jw.Int(FLAGS_tablet_bench_batch_size);
+    jw.String("num_ops");
+    jw.Int64(num_ops);
+    jw.String("wall_seconds");
+    jw.Double(elapsed.wall_seconds());
+    jw.String("ops_per_sec");
+    jw.Double(ops / elapsed.wall_seconds());
+    jw.String("wall_us_per_op");
+    jw.Double(elapsed.wall_seconds() * 1e6 / ops);
+    jw.String("user_cpu_us_per_op");
+    jw.Double(elapsed.user / 1000.0 / ops);
+    jw.String("sys_cpu_us_per_op");
+    jw.Double(elapsed.system / 1000.0 / ops);
+    jw.String("bloom_lookups_per_op");
+    jw.Double((after.bloom - before.bloom) / ops);
+    jw.String("key_file_lookups_per_op");
+    jw.Double((after.key_file - before.key_file) / ops);
+    jw.String("delta_file_lookups_per_op");
+    jw.Double((after.delta_file - before.delta_file) / ops);
+    jw.String("mrs_lookups_per_op");
+    jw.Double((after.mrs - before.mrs) / ops);
+    jw.String("cells_read_from_disk_per_op");
+    jw.Double(cells_read_from_disk / ops);
+    jw.EndObject();
+    LOG(INFO) << "JSON: " << json.str();
+
+    if (!FLAGS_json_output_path.empty()) {
+      std::lock_guard<simple_spinlock> l(json_results_lock);
+      json_results.push_back(json.str());
+      CHECK_OK(WriteStringToFile(Env::Default(),
+                                 "[" + JoinStrings(json_results, ",\n") + "]\n",
+                                 FLAGS_json_output_path));
+    }
+  }
+};
+
+// Inserts new rows with keys between those of the layout.
+TEST_F(TabletBench, BenchmarkInsert) {
+  Random rng(SeedRandom());
+  int64_t range = layout_rows() + FLAGS_tablet_bench_mrs_rows;
+  int64_t next = 0;
+  // Odd keys are new, and go up by a random step averaging 'stride', so that
+  // they land all over the key range without repeating.
+  int64_t stride = std::max<int64_t>(1, range / std::max(1, FLAGS_tablet_bench_num_ops));
+  RunWrites("BenchmarkInsert", RowOperationsPB::INSERT, [&]() {
+      next += 1 + rng.Uniform64(2 * stride - 1);
+      return 2 * next + 1;
+    });
+}
+
+// Upserts random rows of the layout, so that they turn into updates.
+TEST_F(TabletBench, BenchmarkUpsert) {
+  vector<int64_t> keys = ShuffledLayoutKeys();
+  int64_t next = 0;
+  RunWrites("BenchmarkUpsert", RowOperationsPB::UPSERT, [&]() {
+      return keys[next++ % keys.size()];
+    });
+}
+
+// Updates random rows of the layout.
+TEST_F(TabletBench, BenchmarkUpdate) {
+  vector<int64_t> keys = ShuffledLayoutKeys();
+  int64_t next = 0;
+  RunWrites("BenchmarkUpdate", RowOperationsPB::UPDATE, [&]() {
+      return keys[next++ % keys.size()];
+    });
+}
+
+// Scans the whole tablet; each row counts as an operation.
+TEST_F(TabletBench, BenchmarkScan) {
+  int64_t expected_rows = layout_rows() + FLAGS_tablet_bench_mrs_rows;
+  Arena arena(32 * 1024, 256 * 1024);
+  RowBlock block(schema_, 1024, &arena);
+  int64_t total_rows = 0;
+  int64_t cells_read_from_disk = 0;
+
+  LookupCounts before(tablet()->metrics());
+  Stopwatch sw(Stopwatch::ALL_THREADS);
+  sw.start();
+  for (int i = 0; i < FLAGS_tablet_bench_scan_iterations; i++) {
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(tablet()->NewRowIterator(client_schema_, &iter));
+    ASSERT_OK(iter->Init(nullptr));
+    int64_t rows = 0;
+    while (iter->HasNext()) {
+      arena.Reset();
+      ASSERT_OK(iter->NextBlock(&block));
+      rows += block.selection_vector()->CountSelected();
+    }
+    ASSERT_EQ(expected_rows, rows);
+    total_rows += rows;
+    vector<IteratorStats> stats;
+    iter->GetIteratorStats(&stats);
+    for (const IteratorStats& col_stats : stats) {
+      cells_read_from_disk += col_stats.cells_read_from_disk;
+    }
+  }
+  sw.stop();
+  LookupCounts after(tablet()->metrics());
+  Report("BenchmarkScan", total_rows, sw.elapsed(), before, after, cells_read_from_disk);
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -24,8 +24,10 @@
 #include "kudu/common/schema.h"
 #include "kudu/tablet/tablet-test-base.h"
 #include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/util/auto_release_pool.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
@@ -201,6 +203,52 @@ TEST_P(TabletPushdownTest, TestPushdownIntValueRange) {
   // were not read.
 }
 
+// Disk rowsets whose zone maps show that they can't hold any matching row
+// aren't scanned at all, unless they were updated since they were written.
+TEST_P(TabletPushdownTest, TestPruneRowSetsByZoneMaps) {
+  if (GetParam() != SPLIT_MEMORY_DISK) {
+    LOG(INFO) << "Only the split setup has a rowset to prune";
+    return;
+  }
+  scoped_refptr<Counter> pruned = tablet()->metrics()->scanner_rowsets_pruned;
+
+  // The flushed rows have values up to 2050.
+  int32_t lower = 5000;
+  int32_t upper = 5101;
+  ScanSpec spec;
+  spec.AddPredicate(ColumnPredicate::Range(schema_.column(1), &lower, &upper));
+  vector<string> results;
+  {
+    ScanSpec scan_spec = spec;
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(tablet()->NewRowIterator(client_schema_, &iter));
+    ASSERT_OK(iter->Init(&scan_spec));
+    ASSERT_OK(IterateToStringList(iter.get(), &results));
+  }
+  ASSERT_EQ(11, results.size());
+  ASSERT_EQ(1, pruned->value());
+
+  // Once one of the flushed rows is updated into the range, the rowset is
+  // scanned again.
+  {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow row(&client_schema_);
+    ASSERT_OK(row.SetInt32(0, 1));
+    ASSERT_OK(row.SetInt32(1, 5050));
+    ASSERT_OK(writer.Update(row));
+  }
+  {
+    ScanSpec scan_spec = spec;
+    gscoped_ptr<RowwiseIterator> iter;
+    ASSERT_OK(tablet()->NewRowIterator(client_schema_, &iter));
+    ASSERT_OK(iter->Init(&scan_spec));
+    results.clear();
+    ASSERT_OK(IterateToStringList(iter.get(), &results));
+  }
+  ASSERT_EQ(12, results.size());
+  ASSERT_EQ(1, pruned->value());
+}
+
 INSTANTIATE_TEST_CASE_P(AllMemory, TabletPushdownTest, ::testing::Values(ALL_IN_MEMORY));
 INSTANTIATE_TEST_CASE_P(SplitMemoryDisk, TabletPushdownTest, ::testing::Values(SPLIT_MEMORY_DISK));
 INSTANTIATE_TEST_CASE_P(AllDisk, TabletPushdownTest, ::testing::Values(ALL_ON_DISK));
@@ -23,12 +23,14 @@
 
 #include "kudu/common/schema.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/tablet.h"
 #include "kudu/tablet/tablet-test-base.h"
 #include "kudu/util/test_macros.h"
 #include "kudu/util/test_util.h"
 
+using std::shared_ptr;
 using strings::Substitute;
 
 namespace kudu {
@@ -294,5 +296,111 @@ TEST_F(TestTabletSchema, TestModifyEmptyMemRowSet) {
   EXPECT_EQ("(int32 key=2, int32 c1=4, int32 c2=3)", rows[0]);
 }
 
+// Verify that the MemRowSet replaced by an alter can still be read and
+// mutated, including in the columns added by the alter, until it's flushed.
+TEST_F(TestTabletSchema, TestAlterBeforeFlushingMemRowSet) {
+  InsertRow(client_schema_, 1);
+  InsertRow(client_schema_, 2);
+  MutateRow(client_schema_, /* key= */ 2, /* col_idx= */ 1, /* new_val= */ 20);
+
+  const int32_t c2_write_default = 5;
+  const int32_t c2_read_default = 7;
+  SchemaBuilder builder(tablet()->metadata()->schema());
+  ASSERT_OK(builder.AddColumn("c2", INT32, false, &c2_read_default, &c2_write_default));
+  Schema new_schema = builder.Build();
+  Schema s2 = builder.BuildWithoutIds();
+
+  // Alter the schema the way the transaction does, leaving the old
+  // MemRowSet unflushed once the schema lock is released.
+  tserver::AlterSchemaRequestPB req;
+  req.set_schema_version(tablet()->metadata()->schema_version() + 1);
+  AlterSchemaTransactionState tx_state(nullptr, &req, nullptr);
+  ASSERT_OK(tablet()->CreatePreparedAlterSchema(&tx_state, &new_schema));
+  ASSERT_OK(tablet()->AlterSchema(&tx_state));
+  tx_state.ReleaseSchemaLock();
+  tx_state.Finish();
+
+  // Update the new column of a row in the old MemRowSet, and insert a row
+  // into the new one.
+  MutateRow(s2, /* key= */ 1, /* col_idx= */ 2, /* new_val= */ 10);
+  InsertRow(s2, 3);
+
+  const vector<string> expected = {
+    "(int32 key=1, int32 c1=1, int32 c2=10)",
+    "(int32 key=2, int32 c1=20, int32 c2=7)",
+    "(int32 key=3, int32 c1=3, int32 c2=5)"
+  };
+  {
+    vector<string> rows;
+    ASSERT_OK(DumpTablet(*tablet(), s2, &rows));
+    std::sort(rows.begin(), rows.end());
+    ASSERT_EQ(expected, rows);
+  }
+
+  // Flushing the old MemRowSet, then the new one, keeps the same rows.
+  ASSERT_OK(tablet()->FlushPreAlterMemRowSet());
+  {
+    vector<string> rows;
+    ASSERT_OK(DumpTablet(*tablet(), s2, &rows));
+    std::sort(rows.begin(), rows.end());
+    ASSERT_EQ(expected, rows);
+  }
+  ASSERT_OK(tablet()->Flush());
+  {
+    vector<string> rows;
+    ASSERT_OK(DumpTablet(*tablet(), s2, &rows));
+    std::sort(rows.begin(), rows.end());
+    ASSERT_EQ(expected, rows);
+  }
+}
+
+// Verify that altering the encoding and compression of a column leaves its
+// data on disk as it was written until the column is re-encoded, and that
+// re-encoding it keeps the rows, including their updates.
+TEST_F(TestTabletSchema, TestReencodeAlteredColumn) {
+  const size_t kNumRows = 10;
+  vector<string> expected;
+  for (size_t i = 0; i < kNumRows; i++) {
+    InsertRow(client_schema_, i);
+    expected.push_back(Substitute("(int32 key=$0, int32 c1=$1)", i, i == 1 ? 100 : i));
+  }
+  ASSERT_OK(tablet()->Flush());
+  MutateRow(client_schema_, /* key= */ 1, /* col_idx= */ 1, /* new_val= */ 100);
+  std::sort(expected.begin(), expected.end());
+
+  // Nothing needs re-encoding before the alter.
+  bool up_to_date;
+  ASSERT_OK(tablet()->ReencodeColumnsOfOneRowSet(&up_to_date));
+  ASSERT_TRUE(up_to_date);
+
+  ColumnStorageAttributes attributes;
+  attributes.encoding = RLE;
+  attributes.compression = LZ4;
+  SchemaBuilder builder(tablet()->metadata()->schema());
+  ASSERT_OK(builder.SetColumnStorageAttributes("c1", attributes));
+  AlterSchema(builder.Build());
+
+  vector<shared_ptr<RowSet> > rowsets;
+  tablet()->GetRowSetsForTests(&rowsets);
+  ASSERT_EQ(1, rowsets.size());
+  DiskRowSet* drs = down_cast<DiskRowSet*>(rowsets[0].get());
+  vector<ColumnId> col_ids;
+  ASSERT_OK(drs->FindColumnsToReencode(&col_ids));
+  ASSERT_EQ(1, col_ids.size());
+  ASSERT_EQ(tablet()->schema()->column_id(1), col_ids[0]);
+
+  ASSERT_OK(tablet()->ReencodeColumnsOfOneRowSet(&up_to_date));
+  ASSERT_FALSE(up_to_date);
+  ASSERT_OK(drs->FindColumnsToReencode(&col_ids));
+  ASSERT_TRUE(col_ids.empty());
+  ASSERT_OK(tablet()->ReencodeColumnsOfOneRowSet(&up_to_date));
+  ASSERT_TRUE(up_to_date);
+
+  vector<string> rows;
+  ASSERT_OK(DumpTablet(*tablet(), client_schema_, &rows));
+  std::sort(rows.begin(), rows.end());
+  ASSERT_EQ(expected, rows);
+}
+
 } // namespace tablet
 } // namespace kudu
@@ -18,6 +18,7 @@
 #include <glog/logging.h>
 #include <time.h>
 
+#include "kudu/common/encoded_key.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/row.h"
 #include "kudu/common/scan_spec.h"
@@ -26,13 +27,18 @@
 #include "kudu/tablet/deltafile.h"
 #include "kudu/tablet/local_tablet_writer.h"
 #include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet-test-base.h"
+#include "kudu/util/metrics.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/test_macros.h"
 
 using std::shared_ptr;
 using std::unordered_set;
 
+DECLARE_int32(cfile_default_block_size);
+DECLARE_bool(tablet_synchronize_full_scans);
+
 namespace kudu {
 namespace tablet {
 
@@ -193,6 +199,101 @@ TYPED_TEST(TestTablet, TestGhostRowsOnDiskRowSets) {
   ASSERT_OK(this->UpdateTestRow(&writer, 0, 1));
 }
 
+// Test that the metadata-only row count matches the rows visible to a scan
+// as rows move between the MemRowSet, DeltaMemStores, delta files and
+// compacted DiskRowSets.
+TYPED_TEST(TestTablet, TestCountLiveRows) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+
+  auto verify_count = [&](uint64_t expected) {
+    uint64_t count;
+    Timestamp snap_timestamp;
+    ASSERT_OK(this->tablet()->CountLiveRows(&count, &snap_timestamp));
+    ASSERT_EQ(expected, count);
+    ASSERT_NE(Timestamp::kInvalidTimestamp, snap_timestamp);
+    ASSERT_OK(this->tablet()->CountRows(&count));
+    ASSERT_GE(count, expected);
+    vector<string> rows;
+    ASSERT_OK(this->IterateToStringList(&rows));
+    ASSERT_EQ(expected, rows.size());
+  };
+
+  // Rows and ghost rows in the MemRowSet, including a reinsert.
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(this->InsertTestRow(&writer, i, 0));
+  }
+  ASSERT_OK(this->DeleteTestRow(&writer, 0));
+  ASSERT_OK(this->DeleteTestRow(&writer, 1));
+  ASSERT_OK(this->InsertTestRow(&writer, 1, 1));
+  NO_FATALS(verify_count(9));
+
+  // Deletes in a DeltaMemStore, then in a delta file.
+  ASSERT_OK(this->tablet()->Flush());
+  NO_FATALS(verify_count(9));
+  ASSERT_OK(this->DeleteTestRow(&writer, 2));
+  ASSERT_OK(this->DeleteTestRow(&writer, 3));
+  NO_FATALS(verify_count(7));
+  ASSERT_OK(this->tablet()->FlushBiggestDMS());
+  NO_FATALS(verify_count(7));
+
+  // A row deleted from the DiskRowSet and reinserted into the MemRowSet.
+  ASSERT_OK(this->InsertTestRow(&writer, 2, 2));
+  ASSERT_OK(this->InsertTestRow(&writer, 10, 0));
+  NO_FATALS(verify_count(9));
+  ASSERT_OK(this->tablet()->Flush());
+  NO_FATALS(verify_count(9));
+
+  ASSERT_OK(this->tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  NO_FATALS(verify_count(9));
+}
+
+// Test splitting the key range of a tablet by the key indexes of its rowsets.
+TYPED_TEST(TestTablet, TestSplitKeyRange) {
+  // Small blocks give each rowset many index keys.
+  FLAGS_cfile_default_block_size = 1024;
+  uint64_t max_rows = this->ClampRowCount(10000);
+  if (max_rows < 10000) {
+    LOG(INFO) << "Skipping test: too few distinct keys to fill many blocks";
+    return;
+  }
+
+  // Unflushed rows can't be split.
+  this->InsertTestRows(0, max_rows / 2, 0);
+  vector<string> split_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", 1, &split_keys));
+  ASSERT_TRUE(split_keys.empty());
+
+  ASSERT_OK(this->tablet()->Flush());
+  this->InsertTestRows(max_rows / 2, max_rows - max_rows / 2, 0);
+  ASSERT_OK(this->tablet()->Flush());
+
+  // With a one-byte target, the chunks are as small as the indexes allow.
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", 1, &split_keys));
+  ASSERT_GT(split_keys.size(), 4);
+  Arena arena(1024, 1024);
+  for (int i = 0; i < split_keys.size(); i++) {
+    if (i > 0) {
+      ASSERT_LT(split_keys[i - 1], split_keys[i]);
+    }
+    gscoped_ptr<EncodedKey> decoded;
+    ASSERT_OK(EncodedKey::DecodeEncodedString(this->schema_, &arena, split_keys[i], &decoded));
+  }
+
+  // A bounded range is only split strictly within its bounds.
+  const string& start = split_keys[1];
+  const string& stop = split_keys[split_keys.size() - 2];
+  vector<string> bounded_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange(start, stop, 1, &bounded_keys));
+  ASSERT_EQ(vector<string>(split_keys.begin() + 2, split_keys.end() - 2), bounded_keys);
+
+  // Quarters of the data are split at no more than three keys.
+  vector<string> quarter_keys;
+  ASSERT_OK(this->tablet()->SplitKeyRange("", "", this->tablet()->EstimateOnDiskSize() / 4,
+                                          &quarter_keys));
+  ASSERT_GE(quarter_keys.size(), 1);
+  ASSERT_LE(quarter_keys.size(), 3);
+}
+
 // Test that inserting a row which already exists causes an AlreadyPresent
 // error
 TYPED_TEST(TestTablet, TestInsertDuplicateKey) {
@@ -217,6 +318,43 @@ TYPED_TEST(TestTablet, TestInsertDuplicateKey) {
   ASSERT_EQ(1, this->TabletCount());
 }
 
+// Test that a batch of inserts and upserts against both the MRS and a flushed
+// DRS gets the same per-row results as if each row were written on its own,
+// including for keys that repeat within the batch.
+TYPED_TEST(TestTablet, TestBatchedInsertPresenceChecks) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  this->InsertTestRows(0, 10, 0);
+  ASSERT_OK(this->tablet()->Flush());
+  CHECK_OK(this->InsertTestRow(&writer, 30, 0));
+
+  vector<int> keys = { 20, 5, 15, 20, 3, 30, 31 };
+  vector<RowOperationsPB::Type> types = {
+    RowOperationsPB::INSERT, RowOperationsPB::INSERT, RowOperationsPB::INSERT,
+    RowOperationsPB::INSERT, RowOperationsPB::UPSERT, RowOperationsPB::INSERT,
+    RowOperationsPB::UPSERT };
+  vector<bool> expect_failed = { false, true, false, true, false, true, false };
+
+  vector<std::unique_ptr<KuduPartialRow>> rows;
+  vector<LocalTabletWriter::Op> ops;
+  for (int i = 0; i < keys.size(); i++) {
+    rows.emplace_back(new KuduPartialRow(&this->client_schema_));
+    this->setup_.BuildRow(rows.back().get(), keys[i], 1);
+    ops.emplace_back(types[i], rows.back().get());
+  }
+  ignore_result(writer.WriteBatch(ops));
+
+  const TxResultPB& result = writer.last_write_result();
+  ASSERT_EQ(keys.size(), result.ops_size());
+  for (int i = 0; i < keys.size(); i++) {
+    SCOPED_TRACE(keys[i]);
+    ASSERT_EQ(expect_failed[i], result.ops(i).has_failed_status());
+    if (expect_failed[i]) {
+      ASSERT_STR_CONTAINS(StatusFromPB(result.ops(i).failed_status()).ToString(),
+                          "key already present");
+    }
+  }
+  ASSERT_EQ(14, this->TabletCount());
+}
 
 // Test flushes and compactions dealing with deleted rows.
 TYPED_TEST(TestTablet, TestDeleteWithFlushAndCompact) {
@@ -397,6 +535,47 @@ TYPED_TEST(TestTablet, TestRowIteratorSimple) {
   ASSERT_FALSE(iter->HasNext());
 }
 
+// Test that an unordered full scan starts at the rowset which another one
+// is reading, then wraps around to the ones before it.
+TYPED_TEST(TestTablet, TestSynchronizedFullScans) {
+  FLAGS_tablet_synchronize_full_scans = true;
+  const int kInRowSet1 = 1;
+  const int kInRowSet2 = 2;
+  const int kInMemRowSet = 3;
+
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  CHECK_OK(this->InsertTestRow(&writer, kInRowSet1, 0));
+  ASSERT_OK(this->tablet()->Flush());
+  CHECK_OK(this->InsertTestRow(&writer, kInRowSet2, 0));
+  ASSERT_OK(this->tablet()->Flush());
+  CHECK_OK(this->InsertTestRow(&writer, kInMemRowSet, 0));
+
+  // Read the first scan up to the second rowset.
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  RowBlock block(this->schema_, 100, &this->arena_);
+  for (int expected : { kInMemRowSet, kInRowSet1, kInRowSet2 }) {
+    ASSERT_TRUE(iter->HasNext());
+    ASSERT_OK(iter->NextBlock(&block));
+    ASSERT_EQ(1, block.nrows());
+    this->VerifyRow(block.row(0), expected, 0);
+  }
+
+  // The second scan joins it there, and wraps around to the first rowset.
+  gscoped_ptr<RowwiseIterator> iter2;
+  ASSERT_OK(this->tablet()->NewRowIterator(this->client_schema_, &iter2));
+  ASSERT_OK(iter2->Init(nullptr));
+  for (int expected : { kInMemRowSet, kInRowSet2, kInRowSet1 }) {
+    ASSERT_TRUE(iter2->HasNext());
+    ASSERT_OK(iter2->NextBlock(&block));
+    ASSERT_EQ(1, block.nrows());
+    this->VerifyRow(block.row(0), expected, 0);
+  }
+  ASSERT_FALSE(iter2->HasNext());
+  FLAGS_tablet_synchronize_full_scans = false;
+}
+
 TYPED_TEST(TestTablet, TestRowIteratorOrdered) {
   // Create interleaved keys in each rowset, so they are clearly not in order
   const int kNumRows = 128;
@@ -588,6 +767,33 @@ TYPED_TEST(TestTablet, TestUpsert) {
   EXPECT_EQ(vector<string>{ this->setup_.FormatDebugRow(0, 1002, false) }, rows);
 }
 
+// Test that upserting a key which is live in the MemRowSet doesn't consult
+// the bloom filters of the DiskRowSets whose key ranges contain it, whether
+// the upsert is checked as part of a batch or on its own.
+TYPED_TEST(TestTablet, TestUpsertOfMemRowSetKeySkipsDiskRowSets) {
+  LocalTabletWriter writer(this->tablet().get(), &this->client_schema_);
+  CHECK_OK(this->InsertTestRow(&writer, 1, 0));
+  CHECK_OK(this->InsertTestRow(&writer, 9, 0));
+  ASSERT_OK(this->tablet()->Flush());
+  CHECK_OK(this->InsertTestRow(&writer, 5, 0));
+
+  scoped_refptr<Counter> bloom_lookups = this->tablet()->metrics()->bloom_lookups;
+  int64_t lookups_before = bloom_lookups->value();
+  this->UpsertTestRows(5, 1, 1);
+
+  KuduPartialRow row(&this->client_schema_);
+  this->setup_.BuildRow(&row, 5, 2);
+  vector<LocalTabletWriter::Op> ops = {
+    LocalTabletWriter::Op(RowOperationsPB::UPSERT, &row),
+    LocalTabletWriter::Op(RowOperationsPB::UPSERT, &row) };
+  ASSERT_OK(writer.WriteBatch(ops));
+  ASSERT_EQ(lookups_before, bloom_lookups->value());
+
+  vector<string> rows;
+  ASSERT_OK(this->IterateToStringList(&rows));
+  ASSERT_EQ(3, rows.size());
+  EXPECT_EQ(this->setup_.FormatDebugRow(5, 2, false), rows[1]);
+}
 
 // Test that when a row has been updated many times, it always yields
 // the most recent value.
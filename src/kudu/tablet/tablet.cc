@@ -18,17 +18,22 @@
 #include "kudu/tablet/tablet.h"
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <limits>
 #include <memory>
 #include <mutex>
 #include <ostream>
+#include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "kudu/cfile/cfile_writer.h"
+#include "kudu/common/column_stats.h"
+#include "kudu/common/generic_iterators.h"
 #include "kudu/common/iterator.h"
+#include "kudu/common/row.h"
 #include "kudu/common/row_changelist.h"
 #include "kudu/common/row_operations.h"
 #include "kudu/common/scan_spec.h"
@@ -36,15 +41,20 @@
 #include "kudu/consensus/consensus.pb.h"
 #include "kudu/consensus/log_anchor_registry.h"
 #include "kudu/consensus/opid_util.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/server/hybrid_clock.h"
 #include "kudu/tablet/compaction.h"
 #include "kudu/tablet/compaction_policy.h"
 #include "kudu/tablet/delta_compaction.h"
 #include "kudu/tablet/diskrowset.h"
+#include "kudu/tablet/mutation.h"
 #include "kudu/tablet/row_op.h"
 #include "kudu/tablet/rowset_info.h"
 #include "kudu/tablet/rowset_tree.h"
@@ -62,6 +72,7 @@
 #include "kudu/util/logging.h"
 #include "kudu/util/maintenance_manager.h"
 #include "kudu/util/mem_tracker.h"
+#include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/trace.h"
@@ -71,6 +82,53 @@ DEFINE_int32(tablet_compaction_budget_mb, 128,
              "Budget for a single compaction");
 TAG_FLAG(tablet_compaction_budget_mb, experimental);
 
+DEFINE_string(tablet_compaction_policy, "budgeted",
+              "The compaction policy of tablets whose table doesn't choose one: "
+              "'budgeted' minimizes rowset overlap within the compaction budget, "
+              "'tiered' bounds how often rows are rewritten.");
+TAG_FLAG(tablet_compaction_policy, experimental);
+
+static bool ValidateCompactionPolicy(const char* flagname, const std::string& value) {
+  if (value == "budgeted" || value == "tiered") {
+    return true;
+  }
+  LOG(ERROR) << strings::Substitute("$0 must be 'budgeted' or 'tiered', value '$1' is invalid",
+                                    flagname, value);
+  return false;
+}
+static bool compaction_policy_validator_registered = google::RegisterFlagValidator(
+    &FLAGS_tablet_compaction_policy, &ValidateCompactionPolicy);
+
+DEFINE_int32(tiered_compaction_size_ratio, 4,
+             "Ratio between the layer sizes of consecutive tiers of the tiered "
+             "compaction policy.");
+TAG_FLAG(tiered_compaction_size_ratio, experimental);
+
+DEFINE_int32(tiered_compaction_min_merge_width, 4,
+             "Minimum number of overlapping rowsets of one tier that the tiered "
+             "compaction policy merges at once. Each row is rewritten at most "
+             "log base this of (tablet size / flush size) times.");
+TAG_FLAG(tiered_compaction_min_merge_width, experimental);
+
+DEFINE_int32(tiered_compaction_max_overlap_depth, 16,
+             "Maximum number of rowsets the tiered compaction policy lets overlap "
+             "at any key before compacting them regardless of their tiers.");
+TAG_FLAG(tiered_compaction_max_overlap_depth, experimental);
+
+DEFINE_int32(compaction_slice_min_rowset_mb, 256,
+             "Disk rowsets at least this large take part in compactions with only "
+             "the slice of their keys which overlaps the other rowsets being "
+             "compacted. Their other rows are kept in place rather than rewritten. "
+             "A negative value disables range-sliced compactions.");
+TAG_FLAG(compaction_slice_min_rowset_mb, experimental);
+TAG_FLAG(compaction_slice_min_rowset_mb, runtime);
+
+DEFINE_double(compaction_slice_min_retained_fraction, 0.2,
+              "Minimum fraction of the rows of a large rowset which a compaction "
+              "must be able to keep in place for it to slice that rowset.");
+TAG_FLAG(compaction_slice_min_retained_fraction, experimental);
+TAG_FLAG(compaction_slice_min_retained_fraction, runtime);
+
 DEFINE_int32(tablet_bloom_block_size, 4096,
              "Block size of the bloom filters used for tablet keys.");
 TAG_FLAG(tablet_bloom_block_size, advanced);
@@ -82,6 +140,13 @@ DEFINE_double(tablet_bloom_target_fp_rate, 0.0001f,
               "required for bloom filters.");
 TAG_FLAG(tablet_bloom_target_fp_rate, advanced);
 
+DEFINE_bool(tablet_bloom_blocked_layout, false,
+            "Whether to write the bloom filters of tablet keys using a blocked "
+            "(cache-line-local) layout, which makes each probe touch a single cache "
+            "line at the cost of a slightly higher false positive rate. Only affects "
+            "newly written rowsets; existing bloom filters remain readable.");
+TAG_FLAG(tablet_bloom_blocked_layout, experimental);
+
 
 DEFINE_double(fault_crash_before_flush_tablet_meta_after_compaction, 0.0,
               "Fraction of the time, during compaction, to crash before flushing metadata");
@@ -108,6 +173,78 @@ DEFINE_double(tablet_throttler_burst_factor, 1.0f,
              "base rate.");
 TAG_FLAG(tablet_throttler_burst_factor, experimental);
 
+DEFINE_int32(tablet_scan_prefetch_rowsets, 4,
+             "The number of rowsets decoded ahead of an unordered scan when "
+             "the tablet has a scan prefetch pool. Ordered scans decode all "
+             "of their rowsets at once, since they are merged.");
+TAG_FLAG(tablet_scan_prefetch_rowsets, experimental);
+
+DEFINE_int32(tablet_scan_prefetch_blocks, 2,
+             "The maximum number of blocks buffered ahead of the scanner for "
+             "each rowset being prefetched.");
+TAG_FLAG(tablet_scan_prefetch_blocks, experimental);
+
+DEFINE_bool(tablet_synchronize_full_scans, false,
+            "Whether an unordered scan of a whole tablet starts at the rowset "
+            "which another such scan is reading, wrapping around to the rowsets "
+            "it skipped, rather than at the first rowset. Concurrent full scans "
+            "then read the same blocks at about the same time, so that most of "
+            "the blocks are read from disk once and from the block cache after.");
+TAG_FLAG(tablet_synchronize_full_scans, advanced);
+
+DEFINE_bool(tablet_prune_rowsets_by_zone_maps, true,
+            "Whether scans skip the disk rowsets which the zone maps of the columns "
+            "of their predicates show can't hold any matching row, rather than "
+            "opening an iterator on each of them.");
+TAG_FLAG(tablet_prune_rowsets_by_zone_maps, advanced);
+TAG_FLAG(tablet_synchronize_full_scans, experimental);
+TAG_FLAG(tablet_synchronize_full_scans, runtime);
+
+DEFINE_int32(tablet_synchronize_full_scans_window_ms, 5000,
+             "How recently another full scan must have read from a rowset for a "
+             "new one to start there, when --tablet_synchronize_full_scans is set.");
+TAG_FLAG(tablet_synchronize_full_scans_window_ms, advanced);
+TAG_FLAG(tablet_synchronize_full_scans_window_ms, experimental);
+
+DEFINE_int32(tablet_history_max_age_sec, 15 * 60,
+             "Number of seconds for which tablets keep the history of their rows, "
+             "for tables that don't choose their own retention. Snapshot scans "
+             "older than this are rejected, and UNDO delta blocks holding only "
+             "older history are deleted. Scans that take longer than this may fail.");
+TAG_FLAG(tablet_history_max_age_sec, advanced);
+
+DEFINE_bool(enable_undo_delta_block_gc, true,
+            "Whether to delete UNDO delta blocks which hold only history older "
+            "than the tablet's history retention.");
+TAG_FLAG(enable_undo_delta_block_gc, advanced);
+TAG_FLAG(enable_undo_delta_block_gc, runtime);
+
+DEFINE_bool(enable_column_reencoding, false,
+            "Whether to rewrite the data of columns whose encoding or compression "
+            "was altered, in the background. Otherwise, such data is only rewritten "
+            "with the new attributes when its rowset is compacted.");
+TAG_FLAG(enable_column_reencoding, experimental);
+TAG_FLAG(enable_column_reencoding, runtime);
+
+DEFINE_int32(column_reencode_min_interval_ms, 60 * 1000,
+             "The minimum time between two rewrites of altered columns in a tablet, "
+             "when --enable_column_reencoding is set. Each rewrites the columns of "
+             "one rowset.");
+TAG_FLAG(column_reencode_min_interval_ms, experimental);
+TAG_FLAG(column_reencode_min_interval_ms, runtime);
+
+DEFINE_bool(enable_expired_rowset_gc, true,
+            "Whether to delete the rowsets of tables with a row TTL all of whose "
+            "rows have expired, without rewriting them.");
+TAG_FLAG(enable_expired_rowset_gc, advanced);
+TAG_FLAG(enable_expired_rowset_gc, runtime);
+
+DEFINE_int32(expired_rowset_check_interval_ms, 60 * 1000,
+             "The minimum time between two looks for rowsets whose rows have all "
+             "expired in a tablet of a table with a row TTL.");
+TAG_FLAG(expired_rowset_check_interval_ms, advanced);
+TAG_FLAG(expired_rowset_check_interval_ms, runtime);
+
 METRIC_DEFINE_entity(tablet);
 METRIC_DEFINE_gauge_size(tablet, memrowset_size, "MemRowSet Memory Usage",
                          kudu::MetricUnit::kBytes,
@@ -116,8 +253,10 @@ METRIC_DEFINE_gauge_size(tablet, on_disk_size, "Tablet Size On Disk",
                          kudu::MetricUnit::kBytes,
                          "Size of this tablet on disk.");
 
+using std::pair;
 using std::shared_ptr;
 using std::string;
+using std::unique_ptr;
 using std::unordered_set;
 using std::vector;
 
@@ -131,7 +270,17 @@ using log::LogAnchorRegistry;
 using strings::Substitute;
 using base::subtle::Barrier_AtomicIncrement;
 
-static CompactionPolicy *CreateCompactionPolicy() {
+static CompactionPolicy *CreateCompactionPolicy(CompactionPolicyPB policy) {
+  if (policy == UNKNOWN_COMPACTION_POLICY) {
+    policy = FLAGS_tablet_compaction_policy == "tiered" ?
+        TIERED_COMPACTION_POLICY : BUDGETED_COMPACTION_POLICY;
+  }
+  if (policy == TIERED_COMPACTION_POLICY) {
+    return new TieredCompactionPolicy(FLAGS_tablet_compaction_budget_mb,
+                                      FLAGS_tiered_compaction_size_ratio,
+                                      FLAGS_tiered_compaction_min_merge_width,
+                                      FLAGS_tiered_compaction_max_overlap_depth);
+  }
   return new BudgetedCompactionPolicy(FLAGS_tablet_compaction_budget_mb);
 }
 
@@ -143,6 +292,153 @@ TabletComponents::TabletComponents(shared_ptr<MemRowSet> mrs,
                                    shared_ptr<RowSetTree> rs_tree)
     : memrowset(std::move(mrs)), rowsets(std::move(rs_tree)) {}
 
+////////////////////////////////////////////////////////////
+// UndoDeltaBlockGCOp
+////////////////////////////////////////////////////////////
+
+UndoDeltaBlockGCOp::UndoDeltaBlockGCOp(Tablet* tablet)
+  : MaintenanceOp(Substitute("UndoDeltaBlockGCOp($0)", tablet->tablet_id()),
+                  MaintenanceOp::LOW_IO_USAGE),
+    tablet_(tablet) {
+}
+
+void UndoDeltaBlockGCOp::UpdateStats(MaintenanceOpStats* stats) {
+  if (!FLAGS_enable_undo_delta_block_gc) {
+    stats->set_runnable(false);
+    return;
+  }
+  int64_t bytes = tablet_->EstimateBytesInPotentiallyAncientUndoDeltas();
+  stats->set_data_retained_bytes(bytes);
+  stats->set_runnable(bytes > 0);
+}
+
+bool UndoDeltaBlockGCOp::Prepare() {
+  return true;
+}
+
+void UndoDeltaBlockGCOp::Perform() {
+  int64_t blocks_deleted;
+  int64_t bytes_deleted;
+  WARN_NOT_OK(tablet_->DeleteAncientUndoDeltas(&blocks_deleted, &bytes_deleted),
+              Substitute("Failed to delete ancient UNDO deltas of $0", tablet_->tablet_id()));
+}
+
+scoped_refptr<Histogram> UndoDeltaBlockGCOp::DurationHistogram() const {
+  return tablet_->metrics()->undo_delta_block_gc_duration;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > UndoDeltaBlockGCOp::RunningGauge() const {
+  return tablet_->metrics()->undo_delta_block_gc_running;
+}
+
+////////////////////////////////////////////////////////////
+// ReencodeColumnsOp
+////////////////////////////////////////////////////////////
+
+ReencodeColumnsOp::ReencodeColumnsOp(Tablet* tablet)
+  : MaintenanceOp(Substitute("ReencodeColumnsOp($0)", tablet->tablet_id()),
+                  MaintenanceOp::HIGH_IO_USAGE),
+    reencoded_schema_version_(-1),
+    tablet_(tablet) {
+}
+
+void ReencodeColumnsOp::UpdateStats(MaintenanceOpStats* stats) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!FLAGS_enable_column_reencoding ||
+      reencoded_schema_version_ == tablet_->metadata()->schema_version()) {
+    stats->set_runnable(false);
+    return;
+  }
+  if (last_performed_.Initialized() &&
+      MonoTime::Now(MonoTime::FINE).GetDeltaSince(last_performed_).ToMilliseconds() <
+          FLAGS_column_reencode_min_interval_ms) {
+    stats->set_runnable(false);
+    return;
+  }
+  // Finding the columns to rewrite takes reading the footers of their files,
+  // so it's left to Perform(). The score is low, so that the rewrites make way
+  // for the compactions which matter more to reads.
+  stats->set_perf_improvement(0.01);
+  stats->set_runnable(true);
+}
+
+bool ReencodeColumnsOp::Prepare() {
+  std::lock_guard<simple_spinlock> l(lock_);
+  last_performed_ = MonoTime::Now(MonoTime::FINE);
+  return true;
+}
+
+void ReencodeColumnsOp::Perform() {
+  int64_t schema_version = tablet_->metadata()->schema_version();
+  bool up_to_date = false;
+  Status s = tablet_->ReencodeColumnsOfOneRowSet(&up_to_date);
+  if (!s.ok()) {
+    LOG(WARNING) << Substitute("Column re-encoding failed on $0: $1",
+                               tablet_->tablet_id(), s.ToString());
+    return;
+  }
+  if (up_to_date) {
+    std::lock_guard<simple_spinlock> l(lock_);
+    reencoded_schema_version_ = schema_version;
+  }
+}
+
+scoped_refptr<Histogram> ReencodeColumnsOp::DurationHistogram() const {
+  return tablet_->metrics()->reencode_columns_duration;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > ReencodeColumnsOp::RunningGauge() const {
+  return tablet_->metrics()->reencode_columns_running;
+}
+
+////////////////////////////////////////////////////////////
+// ExpiredRowSetGCOp
+////////////////////////////////////////////////////////////
+
+ExpiredRowSetGCOp::ExpiredRowSetGCOp(Tablet* tablet)
+  : MaintenanceOp(Substitute("ExpiredRowSetGCOp($0)", tablet->tablet_id()),
+                  MaintenanceOp::LOW_IO_USAGE),
+    tablet_(tablet) {
+}
+
+void ExpiredRowSetGCOp::UpdateStats(MaintenanceOpStats* stats) {
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (!FLAGS_enable_expired_rowset_gc || !tablet_->HasRowTtl()) {
+    stats->set_runnable(false);
+    return;
+  }
+  if (last_performed_.Initialized() &&
+      MonoTime::Now(MonoTime::FINE).GetDeltaSince(last_performed_).ToMilliseconds() <
+          FLAGS_expired_rowset_check_interval_ms) {
+    stats->set_runnable(false);
+    return;
+  }
+  // Which rowsets have expired isn't known until Perform() reads their zone
+  // maps. Deleting them is cheap, so a low score is enough.
+  stats->set_perf_improvement(0.01);
+  stats->set_runnable(true);
+}
+
+bool ExpiredRowSetGCOp::Prepare() {
+  std::lock_guard<simple_spinlock> l(lock_);
+  last_performed_ = MonoTime::Now(MonoTime::FINE);
+  return true;
+}
+
+void ExpiredRowSetGCOp::Perform() {
+  int64_t rowsets_deleted;
+  WARN_NOT_OK(tablet_->DeleteExpiredRowSets(&rowsets_deleted),
+              Substitute("Failed to delete expired rowsets of $0", tablet_->tablet_id()));
+}
+
+scoped_refptr<Histogram> ExpiredRowSetGCOp::DurationHistogram() const {
+  return tablet_->metrics()->expired_rowset_gc_duration;
+}
+
+scoped_refptr<AtomicGauge<uint32_t> > ExpiredRowSetGCOp::RunningGauge() const {
+  return tablet_->metrics()->expired_rowset_gc_running;
+}
+
 ////////////////////////////////////////////////////////////
 // Tablet
 ////////////////////////////////////////////////////////////
@@ -162,13 +458,15 @@ Tablet::Tablet(const scoped_refptr<TabletMetadata>& metadata,
                        parent_mem_tracker)),
     dms_mem_tracker_(MemTracker::CreateTracker(
         -1, kDMSMemTrackerId, mem_tracker_)),
+    scan_prefetch_pool_(nullptr),
+    compaction_encode_pool_(nullptr),
     next_mrs_id_(0),
     clock_(clock),
     mvcc_(clock),
     rowsets_flush_sem_(1),
     state_(kInitialized) {
       CHECK(schema()->has_column_ids());
-  compaction_policy_.reset(CreateCompactionPolicy());
+  compaction_policy_.reset(CreateCompactionPolicy(metadata_->compaction_policy()));
 
   if (metric_registry) {
     MetricEntity::AttributeMap attrs;
@@ -262,8 +560,12 @@ Status Tablet::GetMappedReadProjection(const Schema& projection,
 }
 
 BloomFilterSizing Tablet::bloom_sizing() const {
-  return BloomFilterSizing::BySizeAndFPRate(FLAGS_tablet_bloom_block_size,
-                                            FLAGS_tablet_bloom_target_fp_rate);
+  BloomFilterSizing sizing = BloomFilterSizing::BySizeAndFPRate(
+      FLAGS_tablet_bloom_block_size, FLAGS_tablet_bloom_target_fp_rate);
+  if (FLAGS_tablet_bloom_blocked_layout) {
+    sizing.set_layout(BLOCKED_BLOOM_LAYOUT);
+  }
+  return sizing;
 }
 
 Status Tablet::NewRowIterator(const Schema &projection,
@@ -292,10 +594,26 @@ Status Tablet::DecodeWriteOperations(const Schema* client_schema,
   TRACE_EVENT0("tablet", "Tablet::DecodeWriteOperations");
 
   DCHECK_EQ(tx_state->row_ops().size(), 0);
+  return DecodeRowOperations(client_schema, tx_state, tx_state);
+}
 
+Status Tablet::DecodeCoalescedWriteOperations(const Schema* client_schema,
+                                              WriteTransactionState* write,
+                                              WriteTransactionState* tx_state) {
+  TRACE_EVENT0("tablet", "Tablet::DecodeCoalescedWriteOperations");
+  DCHECK_NE(write, tx_state);
+  return DecodeRowOperations(client_schema, write, tx_state);
+}
+
+Status Tablet::DecodeRowOperations(const Schema* client_schema,
+                                   WriteTransactionState* write,
+                                   WriteTransactionState* tx_state) {
   // Acquire the schema lock in shared mode, so that the schema doesn't
-  // change while this transaction is in-flight.
-  tx_state->AcquireSchemaLock(&schema_lock_);
+  // change while this transaction is in-flight. The writes coalesced into
+  // a transaction share its lock.
+  if (!tx_state->has_schema_lock()) {
+    tx_state->AcquireSchemaLock(&schema_lock_);
+  }
 
   // The Schema needs to be held constant while any transactions are between
   // PREPARE and APPLY stages
@@ -303,13 +621,19 @@ Status Tablet::DecodeWriteOperations(const Schema* client_schema,
   vector<DecodedRowOperation> ops;
 
   // Decode the ops
-  RowOperationsPBDecoder dec(&tx_state->request()->row_operations(),
+  RowOperationsPBDecoder dec(&write->request()->row_operations(),
                              client_schema,
                              schema(),
                              tx_state->arena());
   RETURN_NOT_OK(dec.DecodeOperations(&ops));
   TRACE_COUNTER_INCREMENT("num_ops", ops.size());
 
+  if (!tx_state->coalesced_writes().empty()) {
+    for (const DecodedRowOperation& op : ops) {
+      RETURN_NOT_OK(CheckRowInTablet(ConstContiguousRow(&key_schema_, op.row_data)));
+    }
+  }
+
   // Create RowOp objects for each
   vector<RowOp*> row_ops;
   row_ops.reserve(ops.size());
@@ -320,7 +644,7 @@ Status Tablet::DecodeWriteOperations(const Schema* client_schema,
   // Important to set the schema before the ops -- we need the
   // schema in order to stringify the ops.
   tx_state->set_schema_at_decode_time(schema());
-  tx_state->swap_row_ops(&row_ops);
+  tx_state->AppendRowOps(write, &row_ops);
 
   return Status::OK();
 }
@@ -329,8 +653,25 @@ Status Tablet::AcquireRowLocks(WriteTransactionState* tx_state) {
   TRACE_EVENT1("tablet", "Tablet::AcquireRowLocks",
                "num_locks", tx_state->row_ops().size());
   TRACE("PREPARE: Acquiring locks for $0 operations", tx_state->row_ops().size());
-  for (RowOp* op : tx_state->row_ops()) {
-    RETURN_NOT_OK(AcquireLockForOp(tx_state, op));
+
+  // Encode and validate every key up front, so that the locks can then be
+  // taken in a single pass in key order. Besides keeping the lock manager
+  // accesses for neighbouring keys together, a consistent order means that
+  // two concurrent multi-row transactions can never deadlock on each other.
+  const vector<RowOp*>& row_ops = tx_state->row_ops();
+  vector<Slice> keys;
+  keys.reserve(row_ops.size());
+  for (RowOp* op : row_ops) {
+    ConstContiguousRow row_key(&key_schema_, op->decoded_op.row_data);
+    op->key_probe.reset(new tablet::RowSetKeyProbe(row_key));
+    RETURN_NOT_OK(CheckRowInTablet(row_key));
+    keys.push_back(op->key_probe->encoded_key_slice());
+  }
+  vector<ScopedRowLock> locks;
+  ScopedRowLock::AcquireAll(&lock_manager_, tx_state, keys, LockManager::LOCK_EXCLUSIVE, &locks,
+                            tx_state->row_lock_wait_callback());
+  for (int i = 0; i < row_ops.size(); i++) {
+    row_ops[i]->row_lock = std::move(locks[i]);
   }
   TRACE("PREPARE: locks acquired");
   return Status::OK();
@@ -389,23 +730,36 @@ Status Tablet::InsertOrUpsertUnlocked(WriteTransactionState *tx_state,
   const bool is_upsert = op->decoded_op.type == RowOperationsPB::UPSERT;
   const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
 
-  // First, ensure that it is a unique key by checking all the open RowSets.
-  vector<RowSet *> to_check = FindRowSetsToCheck(op, comps);
-  for (RowSet *rowset : to_check) {
-    bool present = false;
-    RETURN_NOT_OK(rowset->CheckRowPresent(*op->key_probe, &present, stats));
-    if (present) {
-      if (is_upsert) {
-        return ApplyUpsertAsUpdate(tx_state, op, rowset, stats);
-      }
-      Status s = Status::AlreadyPresent("key already present");
-      if (metrics_) {
-        metrics_->insertions_failed_dup_key->Increment();
+  // First, ensure that it is a unique key by checking all the open RowSets,
+  // unless that was already done for the whole batch.
+  RowSet* present_in_rowset = nullptr;
+  if (op->checked_present) {
+    present_in_rowset = op->present_in_rowset;
+  } else if (is_upsert && IsPresentInMemRowSet(comps, op, stats)) {
+    present_in_rowset = comps->memrowset.get();
+  } else {
+    vector<RowSet*>* to_check = tx_state->rowsets_to_check_scratch();
+    FindRowSetsToCheck(op, comps, to_check);
+    for (RowSet *rowset : *to_check) {
+      bool present = false;
+      RETURN_NOT_OK(rowset->CheckRowPresent(*op->key_probe, &present, stats));
+      if (present) {
+        present_in_rowset = rowset;
+        break;
       }
-      op->SetFailed(s);
-      return s;
     }
   }
+  if (present_in_rowset) {
+    if (is_upsert) {
+      return ApplyUpsertAsUpdate(tx_state, op, present_in_rowset, stats);
+    }
+    Status s = Status::AlreadyPresent("key already present");
+    if (metrics_) {
+      metrics_->insertions_failed_dup_key->Increment();
+    }
+    op->SetFailed(s);
+    return s;
+  }
 
   Timestamp ts = tx_state->timestamp();
   ConstContiguousRow row(schema(), op->decoded_op.row_data);
@@ -432,6 +786,15 @@ Status Tablet::InsertOrUpsertUnlocked(WriteTransactionState *tx_state,
   return s;
 }
 
+bool Tablet::IsPresentInMemRowSet(const TabletComponents* comps,
+                                  RowOp* op,
+                                  ProbeStats* stats) {
+  bool present = false;
+  // The MemRowSet's presence check can't fail.
+  CHECK_OK(comps->memrowset->CheckRowPresent(*op->key_probe, &present, stats));
+  return present;
+}
+
 Status Tablet::ApplyUpsertAsUpdate(WriteTransactionState* tx_state,
                                    RowOp* upsert,
                                    RowSet* rowset,
@@ -470,35 +833,36 @@ Status Tablet::ApplyUpsertAsUpdate(WriteTransactionState* tx_state,
   return s;
 }
 
-vector<RowSet*> Tablet::FindRowSetsToCheck(RowOp* op,
-                                           const TabletComponents* comps) {
-  vector<RowSet*> to_check;
+void Tablet::FindRowSetsToCheck(RowOp* op,
+                                const TabletComponents* comps,
+                                vector<RowSet*>* to_check) {
+  to_check->clear();
   if (PREDICT_TRUE(!op->orig_result_from_log_)) {
     // TODO: could iterate the rowsets in a smart order
     // based on recent statistics - eg if a rowset is getting
     // updated frequently, pick that one first.
     comps->rowsets->FindRowSetsWithKeyInRange(op->key_probe->encoded_key_slice(),
-                                              &to_check);
+                                              to_check);
 #ifndef NDEBUG
     // The order in which the rowset tree returns its results doesn't have semantic
     // relevance. We've had bugs in the past (eg KUDU-1341) which were obscured by
     // relying on the order of rowsets here. So, in debug builds, we shuffle the
     // order to encourage finding such bugs more easily.
-    std::random_shuffle(to_check.begin(), to_check.end());
+    std::random_shuffle(to_check->begin(), to_check->end());
 #endif
-    return to_check;
+    return;
   }
 
   // If we are replaying an operation during bootstrap, then we already have a
   // COMMIT message which tells us specifically which memory store to apply it to.
   for (const auto& store : op->orig_result_from_log_->mutated_stores()) {
     if (store.has_mrs_id()) {
-      to_check.push_back(comps->memrowset.get());
+      to_check->push_back(comps->memrowset.get());
     } else {
       DCHECK(store.has_rs_id());
       RowSet* drs = comps->rowsets->drs_by_id(store.rs_id());
       if (PREDICT_TRUE(drs)) {
-        to_check.push_back(drs);
+        to_check->push_back(drs);
       }
 
       // If for some reason we didn't find any stores that the COMMIT message indicated,
@@ -507,7 +871,6 @@ vector<RowSet*> Tablet::FindRowSetsToCheck(RowOp* op,
       // corruption.
     }
   }
-  return to_check;
 }
 
 Status Tablet::MutateRowUnlocked(WriteTransactionState *tx_state,
@@ -550,8 +913,9 @@ Status Tablet::MutateRowUnlocked(WriteTransactionState *tx_state,
 
   // Next, check the disk rowsets.
 
-  vector<RowSet *> to_check = FindRowSetsToCheck(mutate, comps);
-  for (RowSet *rs : to_check) {
+  vector<RowSet*>* to_check = tx_state->rowsets_to_check_scratch();
+  FindRowSetsToCheck(mutate, comps, to_check);
+  for (RowSet *rs : *to_check) {
     s = rs->MutateRow(ts,
                       *mutate->key_probe,
                       mutate->decoded_op.changelist,
@@ -587,14 +951,22 @@ void Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
       tx_state->arena()->AllocateBytesAligned(sizeof(ProbeStats) * num_ops,
                                               alignof(ProbeStats)));
 
+  // Manually run the constructors to clear the stats to 0 before collecting
+  // them.
+  for (int i = 0; i < num_ops; i++) {
+    new (&stats_array[i]) ProbeStats();
+  }
+
   StartApplying(tx_state);
+
+  // If the batch check fails, the failing lookups are simply retried (and
+  // their errors reported) row by row below.
+  WARN_NOT_OK(BulkCheckPresence(tx_state, stats_array),
+              LogPrefix() + "Could not check row presence for the whole batch");
+
   int i = 0;
   for (RowOp* row_op : tx_state->row_ops()) {
-    ProbeStats* stats = &stats_array[i++];
-    // Manually run the constructor to clear the stats to 0 before collecting
-    // them.
-    new (stats) ProbeStats();
-    ApplyRowOperation(tx_state, row_op, stats);
+    ApplyRowOperation(tx_state, row_op, &stats_array[i++]);
   }
 
   if (metrics_) {
@@ -602,6 +974,104 @@ void Tablet::ApplyRowOperations(WriteTransactionState* tx_state) {
   }
 }
 
+Status Tablet::BulkCheckPresence(WriteTransactionState* tx_state, ProbeStats* stats_array) {
+  const TabletComponents* comps = DCHECK_NOTNULL(tx_state->tablet_components());
+  const vector<RowOp*>& row_ops = tx_state->row_ops();
+
+  // Collect the indexes of the inserts and upserts, sorted by key. Ops being
+  // replayed from the log already know which store to apply to.
+  vector<int> op_idxs;
+  op_idxs.reserve(row_ops.size());
+  for (int i = 0; i < row_ops.size(); i++) {
+    const RowOp* op = row_ops[i];
+    if ((op->decoded_op.type == RowOperationsPB::INSERT ||
+         op->decoded_op.type == RowOperationsPB::UPSERT) &&
+        !op->has_result() &&
+        !op->orig_result_from_log_) {
+      op_idxs.push_back(i);
+    }
+  }
+  if (op_idxs.empty()) {
+    return Status::OK();
+  }
+  auto key_of = [&](int idx) { return row_ops[idx]->key_probe->encoded_key_slice(); };
+  std::sort(op_idxs.begin(), op_idxs.end(), [&](int a, int b) {
+    return key_of(a).compare(key_of(b)) < 0;
+  });
+
+  // A key which appears more than once in the batch may change presence as
+  // the batch is applied, so those ops are left to be checked row by row.
+  vector<int> unique_idxs;
+  vector<Slice> keys;
+  unique_idxs.reserve(op_idxs.size());
+  keys.reserve(op_idxs.size());
+  for (int i = 0; i < op_idxs.size();) {
+    int j = i + 1;
+    while (j < op_idxs.size() && key_of(op_idxs[j]) == key_of(op_idxs[i])) {
+      j++;
+    }
+    if (j == i + 1) {
+      unique_idxs.push_back(op_idxs[i]);
+      keys.push_back(key_of(op_idxs[i]));
+    }
+    i = j;
+  }
+  if (keys.empty()) {
+    return Status::OK();
+  }
+
+  // An upserted key is usually hot, so look for it in the MemRowSet first: a
+  // key live there can't be live in any other rowset, so its bloom filter and
+  // key index probes can be skipped altogether.
+  vector<RowSet*> present_in(keys.size(), nullptr);
+  for (int key_idx = 0; key_idx < keys.size(); key_idx++) {
+    int op_idx = unique_idxs[key_idx];
+    RowOp* op = row_ops[op_idx];
+    if (op->decoded_op.type == RowOperationsPB::UPSERT &&
+        IsPresentInMemRowSet(comps, op, &stats_array[op_idx])) {
+      present_in[key_idx] = comps->memrowset.get();
+    }
+  }
+
+  // Find the candidate rowsets of every key in one sweep of the rowset tree,
+  // then group the probes by rowset. Within a rowset the keys stay sorted,
+  // so consecutive probes hit the same bloom and index blocks.
+  vector<pair<RowSet*, int>> probes;
+  comps->rowsets->ForEachRowSetContainingKeys(keys, [&](RowSet* rs, int key_idx) {
+    probes.emplace_back(rs, key_idx);
+  });
+  std::sort(probes.begin(), probes.end(),
+            [](const pair<RowSet*, int>& a, const pair<RowSet*, int>& b) {
+    if (a.first != b.first) {
+      return std::less<RowSet*>()(a.first, b.first);
+    }
+    return a.second < b.second;
+  });
+
+  for (const auto& probe : probes) {
+    int key_idx = probe.second;
+    if (present_in[key_idx]) {
+      // A key can be live in at most one rowset.
+      continue;
+    }
+    int op_idx = unique_idxs[key_idx];
+    bool present = false;
+    RETURN_NOT_OK(probe.first->CheckRowPresent(*row_ops[op_idx]->key_probe, &present,
+                                               &stats_array[op_idx]));
+    if (present) {
+      present_in[key_idx] = probe.first;
+    }
+  }
+
+  // Only publish the results once every probe has succeeded.
+  for (int key_idx = 0; key_idx < keys.size(); key_idx++) {
+    RowOp* op = row_ops[unique_idxs[key_idx]];
+    op->checked_present = true;
+    op->present_in_rowset = present_in[key_idx];
+  }
+  return Status::OK();
+}
+
 void Tablet::ApplyRowOperation(WriteTransactionState* tx_state,
                                RowOp* row_op,
                                ProbeStats* stats) {
@@ -631,35 +1101,7 @@ void Tablet::ModifyRowSetTree(const RowSetTree& old_tree,
                               const RowSetVector& rowsets_to_remove,
                               const RowSetVector& rowsets_to_add,
                               RowSetTree* new_tree) {
-  RowSetVector post_swap;
-
-  // O(n^2) diff algorithm to collect the set of rowsets excluding
-  // the rowsets that were included in the compaction
-  int num_removed = 0;
-
-  for (const shared_ptr<RowSet> &rs : old_tree.all_rowsets()) {
-    // Determine if it should be removed
-    bool should_remove = false;
-    for (const shared_ptr<RowSet> &to_remove : rowsets_to_remove) {
-      if (to_remove == rs) {
-        should_remove = true;
-        num_removed++;
-        break;
-      }
-    }
-    if (!should_remove) {
-      post_swap.push_back(rs);
-    }
-  }
-
-  CHECK_EQ(num_removed, rowsets_to_remove.size());
-
-  // Then push the new rowsets on the end of the new list
-  std::copy(rowsets_to_add.begin(),
-            rowsets_to_add.end(),
-            std::back_inserter(post_swap));
-
-  CHECK_OK(new_tree->Reset(post_swap));
+  CHECK_OK(new_tree->Reset(old_tree, rowsets_to_remove, rowsets_to_add));
 }
 
 void Tablet::AtomicSwapRowSets(const RowSetVector &old_rowsets,
@@ -695,6 +1137,8 @@ Status Tablet::Flush() {
 
 Status Tablet::FlushUnlocked() {
   TRACE_EVENT0("tablet", "Tablet::FlushUnlocked");
+  RETURN_NOT_OK(FlushPreAlterMemRowSetUnlocked());
+
   RowSetsInCompaction input;
   shared_ptr<MemRowSet> old_mrs;
   {
@@ -711,6 +1155,162 @@ Status Tablet::FlushUnlocked() {
   return FlushInternal(input, old_mrs);
 }
 
+Status Tablet::FlushPreAlterMemRowSet() {
+  TRACE_EVENT1("tablet", "Tablet::FlushPreAlterMemRowSet", "id", tablet_id());
+  std::lock_guard<Semaphore> lock(rowsets_flush_sem_);
+  return FlushPreAlterMemRowSetUnlocked();
+}
+
+Status Tablet::FlushPreAlterMemRowSetUnlocked() {
+  if (!pre_alter_mrs_) {
+    return Status::OK();
+  }
+  shared_ptr<MemRowSet> old_mrs;
+  old_mrs.swap(pre_alter_mrs_);
+  gscoped_ptr<RowSetsInCompaction> input(pre_alter_mrs_input_.release());
+
+  // As in FlushUnlocked(), wait for any transactions which were applying
+  // against the old MRS when it was replaced.
+  mvcc_.WaitForApplyingTransactionsToCommit();
+
+  LOG_WITH_PREFIX(INFO) << "Flushing MemRowSet " << old_mrs->mrs_id()
+                        << " replaced by an alter schema";
+  return FlushInternal(*input, old_mrs);
+}
+
+Status Tablet::BulkLoadSortedRows(const vector<ConstContiguousRow>& rows) {
+  TRACE_EVENT1("tablet", "Tablet::BulkLoadSortedRows", "id", tablet_id());
+  CHECK_EQ(state_, kOpen);
+  if (rows.empty()) {
+    return Status::OK();
+  }
+
+  // Validate the input before writing anything.
+  const Schema* schema_ptr = schema();
+  faststring key_buf;
+  string lower_bound;
+  string prev_key;
+  for (const ConstContiguousRow& row : rows) {
+    if (PREDICT_FALSE(!row.schema()->Equals(*schema_ptr))) {
+      return Status::InvalidArgument("Bulk load row schema does not match the tablet schema",
+                                     row.schema()->ToString());
+    }
+    RETURN_NOT_OK(CheckRowInTablet(row));
+    Slice key = schema_ptr->EncodeComparableKey(row, &key_buf);
+    if (PREDICT_FALSE(!prev_key.empty() && Slice(prev_key).compare(key) >= 0)) {
+      return Status::InvalidArgument("Bulk load rows are not in strictly ascending key order",
+                                     schema_ptr->DebugRowKey(row));
+    }
+    prev_key.assign(reinterpret_cast<const char*>(key.data()), key.size());
+    if (lower_bound.empty()) {
+      lower_bound = prev_key;
+    }
+  }
+  const string& upper_bound = prev_key;
+
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    RETURN_NOT_OK(CheckKeyRangeIsEmptyUnlocked(lower_bound, upper_bound));
+  }
+
+  // Each row gets an UNDO delete at the load timestamp, just like rows flushed
+  // from a MemRowSet, so that earlier snapshots do not see it.
+  ScopedTransaction tx(&mvcc_);
+  faststring undo_buf;
+  RowChangeListEncoder undo_encoder(&undo_buf);
+  undo_encoder.SetToDelete();
+  const RowChangeList undo_delete = undo_encoder.as_changelist();
+
+  RollingDiskRowSetWriter drsw(metadata_.get(), *schema_ptr, bloom_sizing(),
+                               compaction_policy_->target_rowset_size(),
+                               compaction_encode_pool_);
+  RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for bulk load");
+  RowBlock block(*schema_ptr, 100, nullptr);
+  Arena undo_arena(32 * 1024, 1024 * 1024);
+  int n = 0;
+  for (const ConstContiguousRow& row : rows) {
+    RETURN_NOT_OK(drsw.RollIfNecessary());
+    RowBlockRow dst_row = block.row(n);
+    RETURN_NOT_OK(CopyRow(row, &dst_row, reinterpret_cast<Arena*>(NULL)));
+
+    Mutation* undo_head = Mutation::CreateInArena(&undo_arena, tx.timestamp(), undo_delete);
+    rowid_t row_idx_in_drs;
+    RETURN_NOT_OK(drsw.AppendUndoDeltas(n, undo_head, &row_idx_in_drs));
+
+    n++;
+    if (n == block.nrows()) {
+      RETURN_NOT_OK(drsw.AppendBlock(block));
+      undo_arena.Reset();
+      n = 0;
+    }
+  }
+  if (n > 0) {
+    block.Resize(n);
+    RETURN_NOT_OK(drsw.AppendBlock(block));
+  }
+  RETURN_NOT_OK_PREPEND(drsw.Finish(), "Failed to finish DRS writer");
+
+  RowSetMetadataVector new_drs_metas;
+  drsw.GetWrittenRowSetMetadata(&new_drs_metas);
+  RowSetVector new_disk_rowsets;
+  for (const shared_ptr<RowSetMetadata>& meta : new_drs_metas) {
+    shared_ptr<DiskRowSet> new_rowset;
+    RETURN_NOT_OK_PREPEND(DiskRowSet::Open(meta, log_anchor_registry_.get(), &new_rowset,
+                                           mem_tracker_),
+                          "Unable to open bulk loaded rowset");
+    new_disk_rowsets.push_back(new_rowset);
+  }
+
+  RETURN_NOT_OK_PREPEND(FlushMetadata(RowSetVector(), new_drs_metas,
+                                      TabletMetadata::kNoMrsFlushed),
+                        "Failed to flush new tablet metadata");
+
+  // Concurrent writes may have landed in the range while we were writing, so
+  // check again before making the new rowsets visible.
+  Status s;
+  {
+    std::lock_guard<rw_spinlock> lock(component_lock_);
+    s = CheckKeyRangeIsEmptyUnlocked(lower_bound, upper_bound);
+    if (s.ok()) {
+      tx.StartApplying();
+      AtomicSwapRowSetsUnlocked(RowSetVector(), new_disk_rowsets);
+    }
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    tx.Abort();
+    RETURN_NOT_OK_PREPEND(FlushMetadata(new_disk_rowsets, RowSetMetadataVector(),
+                                        TabletMetadata::kNoMrsFlushed),
+                          "Failed to remove bulk loaded rowsets from tablet metadata");
+    return s;
+  }
+  tx.Commit();
+
+  if (metrics_.get()) {
+    metrics_->bytes_flushed->IncrementBy(drsw.written_size());
+    metrics_->AddDictEncodingStats(drsw.dict_stats());
+  }
+  LOG_WITH_PREFIX(INFO) << "Bulk load successful on " << drsw.written_count() << " rows "
+                        << "(" << drsw.written_size() << " bytes) in "
+                        << new_disk_rowsets.size() << " rowsets";
+  return Status::OK();
+}
+
+Status Tablet::CheckKeyRangeIsEmptyUnlocked(const Slice& lower_bound,
+                                            const Slice& upper_bound) const {
+  DCHECK(component_lock_.is_locked());
+  vector<RowSet*> rowsets;
+  components_->rowsets->FindRowSetsIntersectingInterval(lower_bound, upper_bound, &rowsets);
+  for (RowSet* rs : rowsets) {
+    if (rs == components_->memrowset.get() &&
+        !components_->memrowset->HasEntriesInRange(lower_bound, upper_bound)) {
+      continue;
+    }
+    return Status::IllegalState("Bulk load key range overlaps existing rows",
+                                rs->ToString());
+  }
+  return Status::OK();
+}
+
 Status Tablet::ReplaceMemRowSetUnlocked(RowSetsInCompaction *compaction,
                                         shared_ptr<MemRowSet> *old_ms) {
   *old_ms = components_->memrowset;
@@ -761,7 +1361,7 @@ Status Tablet::FlushInternal(const RowSetsInCompaction& input,
     // the need to create cfiles and write their headers only to later delete
     // them.
     LOG(INFO) << "MemRowSet was empty: no flush needed.";
-    return HandleEmptyCompactionOrFlush(input.rowsets(), mrs_being_flushed);
+    return HandleEmptyCompactionOrFlush(input, mrs_being_flushed);
   }
 
   if (flush_hooks_) {
@@ -839,7 +1439,21 @@ Status Tablet::AlterSchema(AlterSchemaTransactionState *tx_state) {
     return metadata_->Flush();
   }
 
-  return FlushUnlocked();
+  // A MemRowSet left over by an earlier alter must be flushed before the one
+  // replaced now.
+  RETURN_NOT_OK(FlushPreAlterMemRowSetUnlocked());
+
+  // Swap in a new MemRowSet with the new schema, leaving the flush of the old
+  // one until the schema lock is released. Inserts go to the new one from
+  // now on, while updates and deletes of the rows in the old one still go to
+  // it: their changelists are keyed by column id, so it stores those of added
+  // columns too, and readers ignore those of dropped ones.
+  pre_alter_mrs_input_.reset(new RowSetsInCompaction);
+  {
+    std::lock_guard<rw_spinlock> lock(component_lock_);
+    RETURN_NOT_OK(ReplaceMemRowSetUnlocked(pre_alter_mrs_input_.get(), &pre_alter_mrs_));
+  }
+  return metadata_->Flush();
 }
 
 Status Tablet::RewindSchemaForBootstrap(const Schema& new_schema,
@@ -903,6 +1517,23 @@ bool Tablet::ShouldThrottleAllow(int64_t bytes) {
 // CompactRowSetsOp
 ////////////////////////////////////////////////////////////
 
+namespace {
+
+// Refreshes the tablet's read amplification in the valid 'stats' of a
+// compaction op. Unchanged stats are left untouched, so that they don't look
+// modified.
+void UpdateReadAmplification(const Tablet* tablet, MaintenanceOpStats* stats) {
+  if (!stats->valid()) {
+    return;
+  }
+  double read_amplification = tablet->MeasuredReadAmplification();
+  if (read_amplification != stats->read_amplification()) {
+    stats->set_read_amplification(read_amplification);
+  }
+}
+
+} // anonymous namespace
+
 CompactRowSetsOp::CompactRowSetsOp(Tablet* tablet)
   : MaintenanceOp(Substitute("CompactRowSetsOp($0)", tablet->tablet_id()),
                   MaintenanceOp::HIGH_IO_USAGE),
@@ -923,6 +1554,7 @@ void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
     if (prev_stats_.valid() &&
         new_num_mrs_flushed == last_num_mrs_flushed_ &&
         new_num_rs_compacted == last_num_rs_compacted_) {
+      UpdateReadAmplification(tablet_, &prev_stats_);
       *stats = prev_stats_;
       return;
     } else {
@@ -931,7 +1563,9 @@ void CompactRowSetsOp::UpdateStats(MaintenanceOpStats* stats) {
     }
   }
 
+  prev_stats_.Clear();
   tablet_->UpdateCompactionStats(&prev_stats_);
+  UpdateReadAmplification(tablet_, &prev_stats_);
   *stats = prev_stats_;
 }
 
@@ -992,6 +1626,7 @@ void MinorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
         new_num_dms_flushed == last_num_dms_flushed_ &&
         new_num_rs_compacted == last_num_rs_compacted_ &&
         new_num_rs_minor_delta_compacted == last_num_rs_minor_delta_compacted_) {
+      UpdateReadAmplification(tablet_, &prev_stats_);
       *stats = prev_stats_;
       return;
     } else {
@@ -1002,10 +1637,17 @@ void MinorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
     }
   }
 
+  prev_stats_.Clear();
+  shared_ptr<RowSet> rs;
   double perf_improv = tablet_->GetPerfImprovementForBestDeltaCompact(
-      RowSet::MINOR_DELTA_COMPACTION, nullptr);
+      RowSet::MINOR_DELTA_COMPACTION, &rs);
+  if (rs) {
+    prev_stats_.set_io_bytes(down_cast<DiskRowSet*>(rs.get())->EstimateDeltaDiskSize() * 2);
+    tablet_->AddRowSetDataDirs(rs.get(), &prev_stats_);
+  }
   prev_stats_.set_perf_improvement(perf_improv);
   prev_stats_.set_runnable(perf_improv > 0);
+  UpdateReadAmplification(tablet_, &prev_stats_);
   *stats = prev_stats_;
 }
 
@@ -1067,6 +1709,7 @@ void MajorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
         new_num_rs_compacted == last_num_rs_compacted_ &&
         new_num_rs_minor_delta_compacted == last_num_rs_minor_delta_compacted_ &&
         new_num_rs_major_delta_compacted == last_num_rs_major_delta_compacted_) {
+      UpdateReadAmplification(tablet_, &prev_stats_);
       *stats = prev_stats_;
       return;
     } else {
@@ -1078,10 +1721,17 @@ void MajorDeltaCompactionOp::UpdateStats(MaintenanceOpStats* stats) {
     }
   }
 
+  prev_stats_.Clear();
+  shared_ptr<RowSet> rs;
   double perf_improv = tablet_->GetPerfImprovementForBestDeltaCompact(
-      RowSet::MAJOR_DELTA_COMPACTION, nullptr);
+      RowSet::MAJOR_DELTA_COMPACTION, &rs);
+  if (rs) {
+    prev_stats_.set_io_bytes(down_cast<DiskRowSet*>(rs.get())->EstimateOnDiskSize() * 2);
+    tablet_->AddRowSetDataDirs(rs.get(), &prev_stats_);
+  }
   prev_stats_.set_perf_improvement(perf_improv);
   prev_stats_.set_runnable(perf_improv > 0);
+  UpdateReadAmplification(tablet_, &prev_stats_);
   *stats = prev_stats_;
 }
 
@@ -1203,6 +1853,18 @@ void Tablet::RegisterMaintenanceOps(MaintenanceManager* maint_mgr) {
   gscoped_ptr<MaintenanceOp> major_delta_compact_op(new MajorDeltaCompactionOp(this));
   maint_mgr->RegisterOp(major_delta_compact_op.get());
   maintenance_ops_.push_back(major_delta_compact_op.release());
+
+  gscoped_ptr<MaintenanceOp> undo_delta_block_gc_op(new UndoDeltaBlockGCOp(this));
+  maint_mgr->RegisterOp(undo_delta_block_gc_op.get());
+  maintenance_ops_.push_back(undo_delta_block_gc_op.release());
+
+  gscoped_ptr<MaintenanceOp> reencode_columns_op(new ReencodeColumnsOp(this));
+  maint_mgr->RegisterOp(reencode_columns_op.get());
+  maintenance_ops_.push_back(reencode_columns_op.release());
+
+  gscoped_ptr<MaintenanceOp> expired_rowset_gc_op(new ExpiredRowSetGCOp(this));
+  maint_mgr->RegisterOp(expired_rowset_gc_op.get());
+  maintenance_ops_.push_back(expired_rowset_gc_op.release());
 }
 
 void Tablet::UnregisterMaintenanceOps() {
@@ -1212,44 +1874,373 @@ void Tablet::UnregisterMaintenanceOps() {
   STLDeleteElements(&maintenance_ops_);
 }
 
-Status Tablet::FlushMetadata(const RowSetVector& to_remove,
-                             const RowSetMetadataVector& to_add,
-                             int64_t mrs_being_flushed) {
-  RowSetMetadataIds to_remove_meta;
-  for (const shared_ptr<RowSet>& rowset : to_remove) {
-    // Skip MemRowSet & DuplicatingRowSets which don't have metadata.
-    if (rowset->metadata().get() == nullptr) {
-      continue;
-    }
-    to_remove_meta.insert(rowset->metadata()->id());
+MonoDelta Tablet::HistoryMaxAge() const {
+  int32_t max_age_sec = metadata_->history_max_age_sec();
+  if (max_age_sec < 0) {
+    max_age_sec = FLAGS_tablet_history_max_age_sec;
   }
+  return MonoDelta::FromSeconds(max_age_sec);
+}
 
-  return metadata_->UpdateAndFlush(to_remove_meta, to_add, mrs_being_flushed);
+bool Tablet::GetTabletAncientHistoryMark(Timestamp* ancient_history_mark) const {
+  if (!clock_->HasPhysicalComponent()) {
+    return false;
+  }
+  uint64_t now_micros = server::HybridClock::GetPhysicalValueMicros(clock_->Now());
+  uint64_t max_age_micros = HistoryMaxAge().ToMicroseconds();
+  *ancient_history_mark = server::HybridClock::TimestampFromMicroseconds(
+      now_micros > max_age_micros ? now_micros - max_age_micros : 0);
+  return true;
 }
 
-Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs_being_flushed) {
-  const char *op_name =
-        (mrs_being_flushed == TabletMetadata::kNoMrsFlushed) ? "Compaction" : "Flush";
-  TRACE_EVENT2("tablet", "Tablet::DoCompactionOrFlush",
-               "tablet_id", tablet_id(),
-               "op", op_name);
+bool Tablet::HasRowTtl() const {
+  ColumnId col_id;
+  int32_t ttl_sec;
+  return clock_->HasPhysicalComponent() && metadata_->GetRowTtl(&col_id, &ttl_sec);
+}
 
-  MvccSnapshot flush_snap(mvcc_);
-  LOG_WITH_PREFIX(INFO) << op_name << ": entering phase 1 (flushing snapshot). Phase 1 snapshot: "
-                        << flush_snap.ToString();
+bool Tablet::GetRowExpiry(RowExpiry* expiry) const {
+  ColumnId col_id;
+  int32_t ttl_sec;
+  if (!clock_->HasPhysicalComponent() || !metadata_->GetRowTtl(&col_id, &ttl_sec)) {
+    return false;
+  }
+  int64_t now_micros = server::HybridClock::GetPhysicalValueMicros(clock_->Now());
+  expiry->col_id = col_id;
+  expiry->cutoff_micros = now_micros - MonoDelta::FromSeconds(ttl_sec).ToMicroseconds();
+  return true;
+}
 
-  if (common_hooks_) {
-    RETURN_NOT_OK_PREPEND(common_hooks_->PostTakeMvccSnapshot(),
-                          "PostTakeMvccSnapshot hook failed");
+Status Tablet::GetColumnStatistics(vector<ColumnStatisticsPB>* stats) const {
+  const Schema* schema = this->schema();
+  std::unordered_map<int32_t, ColumnStatisticsPB> stats_by_id;
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    shared_ptr<RowSetMetadata> rowset_meta = rowset->metadata();
+    if (!rowset_meta) {
+      continue;
+    }
+    for (const ColumnStatisticsPB& col_stats : rowset_meta->column_stats()) {
+      int col_idx = schema->find_column_by_id(ColumnId(col_stats.column_id()));
+      if (col_idx == Schema::kColumnNotFound) {
+        // The column was dropped since the rowset was written.
+        continue;
+      }
+      RETURN_NOT_OK_PREPEND(
+          MergeColumnStatistics(schema->column(col_idx).type_info(), col_stats,
+                                &stats_by_id[col_stats.column_id()]),
+          Substitute("could not merge the statistics of column $0 in rowset $1",
+                     schema->column(col_idx).name(), rowset->ToString()));
+    }
   }
 
-  shared_ptr<CompactionInput> merge;
+  stats->clear();
+  for (int i = 0; i < schema->num_columns(); i++) {
+    ColumnStatisticsPB* col_stats = FindOrNull(stats_by_id, schema->column_id(i));
+    if (col_stats) {
+      stats->emplace_back(std::move(*col_stats));
+    }
+  }
+  return Status::OK();
+}
+
+int64_t Tablet::EstimateBytesInPotentiallyAncientUndoDeltas() {
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return 0;
+  }
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  int64_t bytes = 0;
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    bytes += rowset->EstimateBytesInPotentiallyAncientUndoDeltas(ancient_history_mark);
+  }
+  return bytes;
+}
+
+Status Tablet::DeleteAncientUndoDeltas(int64_t* blocks_deleted, int64_t* bytes_deleted) {
+  CHECK_EQ(state_, kOpen);
+  *blocks_deleted = 0;
+  *bytes_deleted = 0;
+  Timestamp ancient_history_mark;
+  if (!GetTabletAncientHistoryMark(&ancient_history_mark)) {
+    return Status::OK();
+  }
+
+  // Lock the rowsets no compaction is using, under the selection lock like
+  // compactions do, so that none of them starts reading the UNDOs we delete.
+  vector<shared_ptr<RowSet>> rowsets;
+  vector<std::unique_lock<std::mutex>> rowset_locks;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    scoped_refptr<TabletComponents> comps;
+    GetComponents(&comps);
+    for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+      if (!rowset->IsAvailableForCompaction()) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(*rowset->compact_flush_lock(), std::try_to_lock);
+      CHECK(lock.owns_lock());
+      rowsets.push_back(rowset);
+      rowset_locks.push_back(std::move(lock));
+    }
+  }
+
+  for (const shared_ptr<RowSet>& rowset : rowsets) {
+    int64_t rs_blocks_deleted;
+    int64_t rs_bytes_deleted;
+    RETURN_NOT_OK_PREPEND(rowset->DeleteAncientUndoDeltas(ancient_history_mark,
+                                                          &rs_blocks_deleted,
+                                                          &rs_bytes_deleted),
+                          "Failed to delete ancient UNDO deltas of " + rowset->ToString());
+    *blocks_deleted += rs_blocks_deleted;
+    *bytes_deleted += rs_bytes_deleted;
+  }
+  if (*blocks_deleted == 0) {
+    return Status::OK();
+  }
+
+  // Flushing the metadata deletes the blocks from disk.
+  RETURN_NOT_OK_PREPEND(metadata_->Flush(),
+                        "Failed to flush metadata after deleting ancient UNDO deltas");
+  if (metrics_) {
+    metrics_->undo_delta_blocks_deleted->IncrementBy(*blocks_deleted);
+    metrics_->undo_delta_block_bytes_deleted->IncrementBy(*bytes_deleted);
+  }
+  LOG(INFO) << "T " << tablet_id() << ": deleted " << *blocks_deleted
+            << " ancient UNDO delta blocks ("
+            << HumanReadableNumBytes::ToString(*bytes_deleted) << ") older than "
+            << clock_->Stringify(ancient_history_mark);
+  return Status::OK();
+}
+
+Status Tablet::DeleteExpiredRowSets(int64_t* rowsets_deleted) {
+  CHECK_EQ(state_, kOpen);
+  *rowsets_deleted = 0;
+  RowExpiry expiry;
+  if (!GetRowExpiry(&expiry)) {
+    return Status::OK();
+  }
+
+  // Look for the rowsets without holding compact_select_lock_, since it
+  // takes reading the zone maps of their TTL columns.
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  RowSetVector expired;
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    if (!rowset->IsAvailableForCompaction()) {
+      continue;
+    }
+    bool all_expired;
+    RETURN_NOT_OK(down_cast<DiskRowSet*>(rowset.get())->AllRowsExpired(expiry, &all_expired));
+    if (all_expired) {
+      expired.push_back(rowset);
+    }
+  }
+  if (expired.empty()) {
+    return Status::OK();
+  }
+
+  RowSetsInCompaction input;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    GetComponents(&comps);
+    const auto& all_rowsets = comps->rowsets->all_rowsets();
+    for (const shared_ptr<RowSet>& rowset : expired) {
+      std::unique_lock<std::mutex> lock(*rowset->compact_flush_lock(), std::try_to_lock);
+      // Skip the rowsets another compaction got to first, or which were
+      // updated since they were checked.
+      if (!lock.owns_lock() ||
+          std::find(all_rowsets.begin(), all_rowsets.end(), rowset) == all_rowsets.end() ||
+          !rowset->DeltaMemStoreEmpty()) {
+        continue;
+      }
+      input.AddRowSet(rowset, std::move(lock));
+    }
+  }
+  if (input.num_rowsets() == 0) {
+    return Status::OK();
+  }
+
+  LOG_WITH_PREFIX(INFO) << "Deleting " << input.num_rowsets() << " rowset(s) whose rows "
+                        << "have all expired";
+  input.DumpToLog();
+  RETURN_NOT_OK_PREPEND(HandleEmptyCompactionOrFlush(input, TabletMetadata::kNoMrsFlushed),
+                        "Failed to delete expired rowsets");
+  *rowsets_deleted = input.num_rowsets();
+  if (metrics_) {
+    metrics_->expired_rowsets_deleted->IncrementBy(*rowsets_deleted);
+  }
+  return Status::OK();
+}
+
+Status Tablet::SliceCompactionInputs(RowSetsInCompaction* input) const {
+  if (FLAGS_compaction_slice_min_rowset_mb < 0 || input->num_rowsets() < 2) {
+    return Status::OK();
+  }
+  const uint64_t min_size_bytes =
+      static_cast<uint64_t>(FLAGS_compaction_slice_min_rowset_mb) * 1024 * 1024;
+
+  for (const shared_ptr<RowSet>& rs : input->rowsets()) {
+    if (rs->EstimateOnDiskSize() < min_size_bytes) {
+      continue;
+    }
+
+    // Find the key range covered by the other inputs.
+    string others_min;
+    string others_max;
+    bool first = true;
+    for (const shared_ptr<RowSet>& other : input->rowsets()) {
+      if (other == rs) {
+        continue;
+      }
+      string min_key;
+      string max_key;
+      RETURN_NOT_OK(other->GetBounds(&min_key, &max_key));
+      if (first || Slice(min_key).compare(others_min) < 0) {
+        others_min.swap(min_key);
+      }
+      if (first || Slice(max_key).compare(others_max) > 0) {
+        others_max.swap(max_key);
+      }
+      first = false;
+    }
+
+    string rs_min;
+    string rs_max;
+    RETURN_NOT_OK(rs->GetBounds(&rs_min, &rs_max));
+    const DiskRowSet* drs = down_cast<DiskRowSet*>(rs.get());
+    rowid_t live_begin;
+    rowid_t live_end;
+    drs->GetLiveRowRange(&live_begin, &live_end);
+
+    // The overlap can be cut off from either end of the rowset: compact its
+    // rows from the others' min key onwards, or up to their max key. Prefer
+    // whichever rewrites fewer rows.
+    unique_ptr<RowSetSlice> best;
+    rowid_t best_compacted_rows = 0;
+    if (Slice(others_min).compare(rs_min) > 0) {
+      unique_ptr<RowSetSlice> slice(new RowSetSlice);
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(*schema(), &slice->arena, others_min,
+                                                    &slice->split_key));
+      rowid_t split_row;
+      RETURN_NOT_OK(drs->FindLiveRowAtOrAfter(*slice->split_key, &split_row));
+      slice->compacted.split_key = others_min;
+      slice->compacted.compact_upper = true;
+      // The kept rows' keys are all less than 'others_min', so it bounds them.
+      slice->retained = { live_begin, split_row, rs_min, others_min };
+      best_compacted_rows = live_end - split_row;
+      best = std::move(slice);
+    }
+    if (Slice(others_max).compare(rs_max) < 0) {
+      unique_ptr<RowSetSlice> slice(new RowSetSlice);
+      RETURN_NOT_OK(EncodedKey::DecodeEncodedString(*schema(), &slice->arena, others_max,
+                                                    &slice->split_key));
+      // The split key is the first key after 'others_max', which is
+      // impossible to find if that is the greatest possible key.
+      if (EncodedKey::IncrementEncodedKey(*schema(), &slice->split_key, &slice->arena).ok()) {
+        rowid_t split_row;
+        RETURN_NOT_OK(drs->FindLiveRowAtOrAfter(*slice->split_key, &split_row));
+        rowid_t compacted_rows = split_row - live_begin;
+        if (!best || compacted_rows < best_compacted_rows) {
+          slice->compacted.split_key = slice->split_key->encoded_key().ToString();
+          slice->compacted.compact_upper = false;
+          slice->retained = { split_row, live_end, slice->compacted.split_key, rs_max };
+          best_compacted_rows = compacted_rows;
+          best = std::move(slice);
+        }
+      }
+    }
+    if (!best) {
+      continue;
+    }
+
+    rowid_t live_rows = live_end - live_begin;
+    rowid_t retained_rows = best->retained.end_row - best->retained.begin_row;
+    if (retained_rows == 0 ||
+        retained_rows < FLAGS_compaction_slice_min_retained_fraction * live_rows) {
+      continue;
+    }
+    LOG_WITH_PREFIX(INFO) << Substitute("Compaction: slicing $0, rewriting $1 of its $2 rows "
+                                        "and keeping the others in place",
+                                        rs->ToString(), best_compacted_rows, live_rows);
+    input->SliceRowSet(rs.get(), std::move(best));
+  }
+  return Status::OK();
+}
+
+Status Tablet::PrepareSlicedRowSets(const RowSetsInCompaction& input,
+                                    RowSetVector* whole_rowsets,
+                                    RowSetVector* sliced_rowsets,
+                                    vector<shared_ptr<CFileSet>>* narrowed_base_data) const {
+  for (const shared_ptr<RowSet>& rs : input.rowsets()) {
+    const RowSetSlice* slice = input.FindSlice(rs.get());
+    if (slice == nullptr) {
+      whole_rowsets->push_back(rs);
+      continue;
+    }
+    shared_ptr<CFileSet> base_data;
+    RETURN_NOT_OK_PREPEND(down_cast<DiskRowSet*>(rs.get())->OpenNarrowedBaseData(
+                              slice->retained, &base_data),
+                          Substitute("Failed to narrow $0", rs->ToString()));
+    sliced_rowsets->push_back(rs);
+    narrowed_base_data->push_back(std::move(base_data));
+  }
+  return Status::OK();
+}
+
+Status Tablet::FlushMetadata(const RowSetVector& to_remove,
+                             const RowSetMetadataVector& to_add,
+                             int64_t mrs_being_flushed) {
+  return FlushMetadata(to_remove, to_add, RowSetLiveRanges(), mrs_being_flushed);
+}
+
+Status Tablet::FlushMetadata(const RowSetVector& to_remove,
+                             const RowSetMetadataVector& to_add,
+                             const RowSetLiveRanges& to_narrow,
+                             int64_t mrs_being_flushed) {
+  RowSetMetadataIds to_remove_meta;
+  for (const shared_ptr<RowSet>& rowset : to_remove) {
+    // Skip MemRowSet & DuplicatingRowSets which don't have metadata.
+    if (rowset->metadata().get() == nullptr) {
+      continue;
+    }
+    to_remove_meta.insert(rowset->metadata()->id());
+  }
+
+  return metadata_->UpdateAndFlush(to_remove_meta, to_add, to_narrow, mrs_being_flushed);
+}
+
+Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs_being_flushed) {
+  const char *op_name =
+        (mrs_being_flushed == TabletMetadata::kNoMrsFlushed) ? "Compaction" : "Flush";
+  TRACE_EVENT2("tablet", "Tablet::DoCompactionOrFlush",
+               "tablet_id", tablet_id(),
+               "op", op_name);
+
+  MvccSnapshot flush_snap(mvcc_);
+  LOG_WITH_PREFIX(INFO) << op_name << ": entering phase 1 (flushing snapshot). Phase 1 snapshot: "
+                        << flush_snap.ToString();
+
+  if (common_hooks_) {
+    RETURN_NOT_OK_PREPEND(common_hooks_->PostTakeMvccSnapshot(),
+                          "PostTakeMvccSnapshot hook failed");
+  }
+
+  shared_ptr<CompactionInput> merge;
   RETURN_NOT_OK(input.CreateCompactionInput(flush_snap, schema(), &merge));
 
+  // The expired rows are dropped as of the time the compaction starts, so
+  // that both of its passes drop the same rows.
+  RowExpiry row_expiry;
+  const RowExpiry* expiry = GetRowExpiry(&row_expiry) ? &row_expiry : nullptr;
+
   RollingDiskRowSetWriter drsw(metadata_.get(), merge->schema(), bloom_sizing(),
-                               compaction_policy_->target_rowset_size());
+                               compaction_policy_->target_rowset_size(),
+                               compaction_encode_pool_);
   RETURN_NOT_OK_PREPEND(drsw.Open(), "Failed to open DiskRowSet for flush");
-  RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, &drsw),
+  RETURN_NOT_OK_PREPEND(FlushCompactionInput(merge.get(), flush_snap, expiry, &drsw),
                         "Flush to disk failed");
   RETURN_NOT_OK_PREPEND(drsw.Finish(), "Failed to finish DRS writer");
 
@@ -1258,13 +2249,14 @@ Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs
                           "PostWriteSnapshot hook failed");
   }
 
-  // Though unlikely, it's possible that all of the input rows were actually
-  // GCed in this compaction. In that case, we don't actually want to reopen.
+  // It's possible that all of the input rows were actually GCed in this
+  // compaction, e.g. because they expired. In that case, we don't actually
+  // want to reopen.
   bool gced_all_input = drsw.written_count() == 0;
   if (gced_all_input) {
     LOG_WITH_PREFIX(INFO) << op_name << " resulted in no output rows (all input rows "
                           << "were GCed!)  Removing all input rowsets.";
-    return HandleEmptyCompactionOrFlush(input.rowsets(), mrs_being_flushed);
+    return HandleEmptyCompactionOrFlush(input, mrs_being_flushed);
   }
 
   // The RollingDiskRowSet writer wrote out one or more RowSets as the
@@ -1273,7 +2265,10 @@ Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs
   RowSetMetadataVector new_drs_metas;
   drsw.GetWrittenRowSetMetadata(&new_drs_metas);
 
-  if (metrics_.get()) metrics_->bytes_flushed->IncrementBy(drsw.written_size());
+  if (metrics_.get()) {
+    metrics_->bytes_flushed->IncrementBy(drsw.written_size());
+    metrics_->AddDictEncodingStats(drsw.dict_stats());
+  }
   CHECK(!new_drs_metas.empty());
   {
     TRACE_EVENT0("tablet", "Opening compaction results");
@@ -1318,7 +2313,8 @@ Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs
   LOG_WITH_PREFIX(INFO) << op_name << ": entering phase 2 (starting to duplicate updates "
                         << "in new rowsets)";
   shared_ptr<DuplicatingRowSet> inprogress_rowset(
-    new DuplicatingRowSet(input.rowsets(), new_disk_rowsets));
+    new DuplicatingRowSet(input.rowsets(), new_disk_rowsets, input.key_slices(),
+                          expiry != nullptr));
 
   // The next step is to swap in the DuplicatingRowSet, and at the same time, determine an
   // MVCC snapshot which includes all of the transactions that saw a pre-DuplicatingRowSet
@@ -1385,6 +2381,7 @@ Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs
                                              merge.get(),
                                              flush_snap,
                                              non_duplicated_txns_snap,
+                                             expiry,
                                              new_disk_rowsets),
         Substitute("Failed to re-update deltas missed during $0 phase 1",
                      op_name).c_str());
@@ -1405,13 +2402,31 @@ Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs
     MAYBE_FAULT(FLAGS_fault_crash_before_flush_tablet_meta_after_flush_mrs);
   }
 
+  // Sliced input rowsets stay in the tablet, narrowed to the rows they keep.
+  RowSetVector whole_rowsets;
+  RowSetVector sliced_rowsets;
+  vector<shared_ptr<CFileSet>> narrowed_base_data;
+  RETURN_NOT_OK(PrepareSlicedRowSets(input, &whole_rowsets, &sliced_rowsets,
+                                     &narrowed_base_data));
+
   // Write out the new Tablet Metadata and remove old rowsets.
-  RETURN_NOT_OK_PREPEND(FlushMetadata(input.rowsets(), new_drs_metas, mrs_being_flushed),
+  RETURN_NOT_OK_PREPEND(FlushMetadata(whole_rowsets, new_drs_metas,
+                                      input.retained_live_ranges(), mrs_being_flushed),
                         "Failed to flush new tablet metadata");
 
   // Replace the compacted rowsets with the new on-disk rowsets, making them visible now that
-  // their metadata was written to disk.
-  AtomicSwapRowSets({ inprogress_rowset }, new_disk_rowsets);
+  // their metadata was written to disk. The sliced rowsets are narrowed at the same time, so
+  // that no reader sees their compacted rows twice, or not at all.
+  RowSetVector swapped_in(new_disk_rowsets);
+  swapped_in.insert(swapped_in.end(), sliced_rowsets.begin(), sliced_rowsets.end());
+  {
+    std::lock_guard<rw_spinlock> lock(component_lock_);
+    for (size_t i = 0; i < sliced_rowsets.size(); i++) {
+      down_cast<DiskRowSet*>(sliced_rowsets[i].get())->SwapInBaseData(
+          std::move(narrowed_base_data[i]));
+    }
+    AtomicSwapRowSetsUnlocked({ inprogress_rowset }, swapped_in);
+  }
 
   LOG_WITH_PREFIX(INFO) << op_name << " successful on " << drsw.written_count()
                         << " rows " << "(" << drsw.written_size() << " bytes)";
@@ -1424,15 +2439,27 @@ Status Tablet::DoCompactionOrFlush(const RowSetsInCompaction &input, int64_t mrs
   return Status::OK();
 }
 
-Status Tablet::HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
+Status Tablet::HandleEmptyCompactionOrFlush(const RowSetsInCompaction& input,
                                             int mrs_being_flushed) {
+  RowSetVector whole_rowsets;
+  RowSetVector sliced_rowsets;
+  vector<shared_ptr<CFileSet>> narrowed_base_data;
+  RETURN_NOT_OK(PrepareSlicedRowSets(input, &whole_rowsets, &sliced_rowsets,
+                                     &narrowed_base_data));
+
   // Write out the new Tablet Metadata and remove old rowsets.
-  RETURN_NOT_OK_PREPEND(FlushMetadata(rowsets,
+  RETURN_NOT_OK_PREPEND(FlushMetadata(whole_rowsets,
                                       RowSetMetadataVector(),
+                                      input.retained_live_ranges(),
                                       mrs_being_flushed),
                         "Failed to flush new tablet metadata");
 
-  AtomicSwapRowSets(rowsets, RowSetVector());
+  std::lock_guard<rw_spinlock> lock(component_lock_);
+  for (size_t i = 0; i < sliced_rowsets.size(); i++) {
+    down_cast<DiskRowSet*>(sliced_rowsets[i].get())->SwapInBaseData(
+        std::move(narrowed_base_data[i]));
+  }
+  AtomicSwapRowSetsUnlocked(whole_rowsets, RowSetVector());
   return Status::OK();
 }
 
@@ -1449,6 +2476,8 @@ Status Tablet::Compact(CompactFlags flags) {
   }
   LOG_WITH_PREFIX(INFO) << "Compaction: stage 1 complete, picked "
                         << input.num_rowsets() << " rowsets to compact";
+  RETURN_NOT_OK_PREPEND(SliceCompactionInputs(&input),
+                        "Failed to slice rowsets to compact");
   if (compaction_hooks_) {
     RETURN_NOT_OK_PREPEND(compaction_hooks_->PostSelectIterators(),
                           "PostSelectIterators hook failed");
@@ -1466,7 +2495,7 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
   // been in the last 5 minutes, and somehow scale the compaction quality
   // based on that, so we favor hot tablets.
   double quality = 0;
-  unordered_set<RowSet*> picked_set_ignored;
+  unordered_set<RowSet*> picked;
 
   shared_ptr<RowSetTree> rowsets_copy;
   {
@@ -1476,16 +2505,39 @@ void Tablet::UpdateCompactionStats(MaintenanceOpStats* stats) {
 
   {
     std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
-    WARN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy, &picked_set_ignored, &quality, NULL),
+    WARN_NOT_OK(compaction_policy_->PickRowSets(*rowsets_copy, &picked, &quality, NULL),
                 Substitute("Couldn't determine compaction quality for $0", tablet_id()));
   }
 
   VLOG_WITH_PREFIX(1) << "Best compaction for " << tablet_id() << ": " << quality;
 
+  // A compaction reads its inputs and writes roughly as much back out.
+  int64_t input_bytes = 0;
+  for (RowSet* rs : picked) {
+    input_bytes += rs->EstimateOnDiskSize();
+    AddRowSetDataDirs(rs, stats);
+  }
+  stats->set_io_bytes(input_bytes * 2);
   stats->set_runnable(quality >= 0);
   stats->set_perf_improvement(quality);
 }
 
+void Tablet::AddRowSetDataDirs(RowSet* rowset, MaintenanceOpStats* stats) const {
+  shared_ptr<RowSetMetadata> rs_meta = rowset->metadata();
+  if (!rs_meta) {
+    return;
+  }
+  fs::BlockManager* block_manager = metadata_->fs_manager()->block_manager();
+  for (const BlockId& block_id : rs_meta->GetAllBlocks()) {
+    string root_path;
+    // The block may have been deleted by a concurrent compaction; the stats
+    // are only a scheduling hint, so skip it.
+    if (block_manager->FindBlockRootPath(block_id, &root_path).ok()) {
+      stats->add_data_dir(root_path);
+    }
+  }
+}
+
 
 Status Tablet::DebugDump(vector<string> *lines) {
   shared_lock<rw_spinlock> l(component_lock_);
@@ -1504,11 +2556,124 @@ Status Tablet::DebugDump(vector<string> *lines) {
   return Status::OK();
 }
 
+// Wraps the iterator of a disk rowset read by an unordered full scan,
+// recording in the tablet's FullScanPosition that the scan has reached the
+// rowset whenever it reads a block.
+class Tablet::FullScanPositionIterator : public RowwiseIterator {
+ public:
+  FullScanPositionIterator(gscoped_ptr<RowwiseIterator> iter,
+                           const RowSet* rowset,
+                           FullScanPosition* position)
+      : iter_(std::move(iter)),
+        rowset_(rowset),
+        position_(position) {
+  }
+
+  Status Init(ScanSpec* spec) OVERRIDE {
+    return iter_->Init(spec);
+  }
+
+  bool HasNext() const OVERRIDE {
+    return iter_->HasNext();
+  }
+
+  string ToString() const OVERRIDE {
+    return iter_->ToString();
+  }
+
+  const Schema& schema() const OVERRIDE {
+    return iter_->schema();
+  }
+
+  void GetIteratorStats(vector<IteratorStats>* stats) const OVERRIDE {
+    iter_->GetIteratorStats(stats);
+  }
+
+  Status NextBlock(RowBlock* dst) OVERRIDE {
+    MonoTime now = MonoTime::Now(MonoTime::COARSE);
+    {
+      std::lock_guard<simple_spinlock> l(position_->lock);
+      position_->rowset = rowset_;
+      position_->updated = now;
+    }
+    return iter_->NextBlock(dst);
+  }
+
+ private:
+  gscoped_ptr<RowwiseIterator> iter_;
+  const RowSet* const rowset_;
+  FullScanPosition* const position_;
+};
+
+Status Tablet::FindPrunedRowSets(const ScanSpec& spec,
+                                 RowSetVector* candidates,
+                                 unordered_set<const RowSet*>* pruned) const {
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    rowsets_copy = components_->rowsets;
+  }
+
+  // Only consider the rowsets within the key bounds of the scan, if any, as
+  // the others are culled anyway.
+  if (spec.lower_bound_key() || spec.exclusive_upper_bound_key()) {
+    Slice lower_bound;
+    Slice upper_bound;
+    if (spec.lower_bound_key()) {
+      lower_bound = spec.lower_bound_key()->encoded_key();
+    }
+    if (spec.exclusive_upper_bound_key()) {
+      upper_bound = spec.exclusive_upper_bound_key()->encoded_key();
+    }
+    vector<RowSet*> interval_sets;
+    rowsets_copy->FindRowSetsIntersectingOpenInterval(
+        spec.lower_bound_key() ? &lower_bound : nullptr,
+        spec.exclusive_upper_bound_key() ? &upper_bound : nullptr,
+        &interval_sets);
+    unordered_set<RowSet*> in_interval(interval_sets.begin(), interval_sets.end());
+    for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+      if (ContainsKey(in_interval, rs.get())) {
+        candidates->push_back(rs);
+      }
+    }
+  } else {
+    *candidates = rowsets_copy->all_rowsets();
+  }
+
+  // The candidates hold on to the rowsets so that their addresses can't be
+  // reused by new rowsets while the caller looks them up in 'pruned'.
+  for (const shared_ptr<RowSet>& rs : *candidates) {
+    bool excluded;
+    RETURN_NOT_OK_PREPEND(rs->ExcludedByPredicates(spec, &excluded),
+                          Substitute("Could not check predicates against rowset $0",
+                                     rs->ToString()));
+    if (excluded) {
+      pruned->insert(rs.get());
+    }
+  }
+  if (metrics_ && !pruned->empty()) {
+    metrics_->scanner_rowsets_pruned->IncrementBy(pruned->size());
+  }
+  return Status::OK();
+}
+
 Status Tablet::CaptureConsistentIterators(
   const Schema *projection,
   const MvccSnapshot &snap,
   const ScanSpec *spec,
+  OrderMode order,
   vector<shared_ptr<RowwiseIterator> > *iters) const {
+  // Find the rowsets which can't match the predicates of the scan before
+  // taking the component lock, since doing so may open their files. Rowsets
+  // swapped in meanwhile aren't pruned, and those swapped out are left out
+  // anyway, so the outcome still applies to the components captured below.
+  unordered_set<const RowSet*> pruned;
+  RowSetVector pruning_candidates;
+  if (spec != nullptr && !spec->predicates().empty() &&
+      FLAGS_tablet_prune_rowsets_by_zone_maps) {
+    RETURN_NOT_OK(FindPrunedRowSets(*spec, &pruning_candidates, &pruned));
+  }
+
   shared_lock<rw_spinlock> l(component_lock_);
 
   // Construct all the iterators locally first, so that if we fail
@@ -1520,18 +2685,30 @@ Status Tablet::CaptureConsistentIterators(
   RETURN_NOT_OK(components_->memrowset->NewRowIterator(projection, snap, &ms_iter));
   ret.push_back(shared_ptr<RowwiseIterator>(ms_iter.release()));
 
-  // Cull row-sets in the case of key-range queries.
-  if (spec != nullptr && spec->lower_bound_key() && spec->exclusive_upper_bound_key()) {
-    // TODO : support open-ended intervals
+  // Cull row-sets in the case of key-range queries, including open-ended
+  // ones such as the rest of a fault-tolerant scan resumed from its last key,
+  // which then skips the rowsets it has already gone past.
+  if (spec != nullptr && (spec->lower_bound_key() || spec->exclusive_upper_bound_key())) {
     // TODO: the upper bound key is exclusive, but the RowSetTree function takes
     // an inclusive interval. So, we might end up fetching one more rowset than
     // necessary.
+    Slice lower_bound;
+    Slice upper_bound;
+    if (spec->lower_bound_key()) {
+      lower_bound = spec->lower_bound_key()->encoded_key();
+    }
+    if (spec->exclusive_upper_bound_key()) {
+      upper_bound = spec->exclusive_upper_bound_key()->encoded_key();
+    }
     vector<RowSet *> interval_sets;
-    components_->rowsets->FindRowSetsIntersectingInterval(
-        spec->lower_bound_key()->encoded_key(),
-        spec->exclusive_upper_bound_key()->encoded_key(),
+    components_->rowsets->FindRowSetsIntersectingOpenInterval(
+        spec->lower_bound_key() ? &lower_bound : nullptr,
+        spec->exclusive_upper_bound_key() ? &upper_bound : nullptr,
         &interval_sets);
     for (const RowSet *rs : interval_sets) {
+      if (ContainsKey(pruned, rs)) {
+        continue;
+      }
       gscoped_ptr<RowwiseIterator> row_it;
       RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, &row_it),
                             Substitute("Could not create iterator for rowset $0",
@@ -1542,15 +2719,41 @@ Status Tablet::CaptureConsistentIterators(
     return Status::OK();
   }
 
-  // If there are no encoded predicates or they represent an open-ended range, then
-  // fall back to grabbing all rowset iterators
+  // If there are no encoded key bounds, fall back to grabbing all rowset
+  // iterators
+  bool synchronize = order == UNORDERED && FLAGS_tablet_synchronize_full_scans;
+  const RowSet* start_rowset = nullptr;
+  if (synchronize) {
+    MonoTime now = MonoTime::Now(MonoTime::COARSE);
+    std::lock_guard<simple_spinlock> pl(full_scan_position_.lock);
+    if (full_scan_position_.rowset != nullptr &&
+        now.GetDeltaSince(full_scan_position_.updated).ToMilliseconds() <
+            FLAGS_tablet_synchronize_full_scans_window_ms) {
+      start_rowset = full_scan_position_.rowset;
+    }
+  }
+  size_t start_idx = ret.size();
   for (const shared_ptr<RowSet> &rs : components_->rowsets->all_rowsets()) {
+    if (ContainsKey(pruned, rs.get())) {
+      continue;
+    }
     gscoped_ptr<RowwiseIterator> row_it;
     RETURN_NOT_OK_PREPEND(rs->NewRowIterator(projection, snap, &row_it),
                           Substitute("Could not create iterator for rowset $0",
                                      rs->ToString()));
+    if (synchronize) {
+      if (rs.get() == start_rowset) {
+        start_idx = ret.size();
+      }
+      row_it.reset(new FullScanPositionIterator(
+          std::move(row_it), rs.get(), &full_scan_position_));
+    }
     ret.push_back(shared_ptr<RowwiseIterator>(row_it.release()));
   }
+  // Start the disk rowsets at the one another scan is reading, following it
+  // and then wrapping around to the ones it read before this scan began. The
+  // memrowset stays first.
+  std::rotate(ret.begin() + 1, ret.begin() + start_idx, ret.end());
 
   // Swap results into the parameters.
   ret.swap(*iters);
@@ -1573,6 +2776,195 @@ Status Tablet::CountRows(uint64_t *count) const {
   return Status::OK();
 }
 
+Status Tablet::CountLiveRows(uint64_t* count, Timestamp* snap_timestamp) const {
+  // A transaction which starts applying after the check below either is
+  // still in flight at the end, or has committed, which on a leader advances
+  // the clean timestamp and on a follower leaves the snapshot unclean.
+  MvccSnapshot before;
+  mvcc_.TakeSnapshot(&before);
+  Timestamp clean_timestamp = mvcc_.GetCleanTimestamp();
+  if (mvcc_.CountTransactionsInFlight() > 0 || !before.is_clean()) {
+    return Status::Incomplete("transactions are in flight");
+  }
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  uint64_t total;
+  RETURN_NOT_OK(comps->memrowset->CountLiveRows(&total));
+  for (const shared_ptr<RowSet> &rowset : comps->rowsets->all_rowsets()) {
+    uint64_t rs_count;
+    RETURN_NOT_OK(rowset->CountLiveRows(&rs_count));
+    total += rs_count;
+  }
+
+  MvccSnapshot after;
+  mvcc_.TakeSnapshot(&after);
+  if (mvcc_.CountTransactionsInFlight() > 0 || !after.is_clean() ||
+      mvcc_.GetCleanTimestamp() != clean_timestamp) {
+    return Status::Incomplete("transactions committed while counting rows");
+  }
+
+  *count = total;
+  *snap_timestamp = clean_timestamp;
+  return Status::OK();
+}
+
+Status Tablet::SplitKeyRange(const string& start_key,
+                             const string& stop_key,
+                             uint64_t target_chunk_size_bytes,
+                             vector<string>* split_keys) const {
+  DCHECK_GT(target_chunk_size_bytes, 0);
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  // Sample the index keys of every rowset overlapping the range. Each index
+  // key stands for an equal share of its rowset's on-disk size.
+  vector<pair<string, uint64_t>> samples;
+  for (const shared_ptr<RowSet>& rs : comps->rowsets->all_rowsets()) {
+    string min_key;
+    string max_key;
+    RETURN_NOT_OK(rs->GetBounds(&min_key, &max_key));
+    if (Slice(max_key).compare(start_key) < 0 ||
+        (!stop_key.empty() && Slice(min_key).compare(stop_key) >= 0)) {
+      continue;
+    }
+    vector<string> keys;
+    RETURN_NOT_OK(rs->GetIndexKeys(&keys));
+    if (keys.empty()) {
+      continue;
+    }
+    uint64_t bytes_per_key = std::max<uint64_t>(rs->EstimateOnDiskSize() / keys.size(), 1);
+    for (string& key : keys) {
+      samples.emplace_back(std::move(key), bytes_per_key);
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+
+  // Start a new chunk at the first sample past each target size. Index keys
+  // may be shortened separators rather than row keys, so only split at the
+  // ones which decode as primary keys.
+  Arena arena(1024, 64 * 1024);
+  uint64_t chunk_bytes = 0;
+  for (const pair<string, uint64_t>& sample : samples) {
+    const string& key = sample.first;
+    if (Slice(key).compare(start_key) < 0) {
+      continue;
+    }
+    if (!stop_key.empty() && Slice(key).compare(stop_key) >= 0) {
+      break;
+    }
+    if (chunk_bytes >= target_chunk_size_bytes &&
+        key != start_key &&
+        (split_keys->empty() || split_keys->back() != key)) {
+      gscoped_ptr<EncodedKey> decoded;
+      if (EncodedKey::DecodeEncodedString(*schema(), &arena, key, &decoded).ok()) {
+        split_keys->push_back(key);
+        chunk_bytes = 0;
+      }
+      arena.Reset();
+    }
+    chunk_bytes += sample.second;
+  }
+  return Status::OK();
+}
+
+Status Tablet::LookupRows(const Schema& projection,
+                          const MvccSnapshot& snap,
+                          const vector<string>& encoded_keys,
+                          RowBlock* block) const {
+  CHECK_EQ(state_, kOpen);
+  DCHECK_GE(block->row_capacity(), encoded_keys.size());
+
+  Schema mapped_projection;
+  RETURN_NOT_OK(GetMappedReadProjection(projection, &mapped_projection));
+  const Schema key_schema = schema()->CreateKeyProjection();
+
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+
+  Arena* arena = block->arena();
+  block->Resize(encoded_keys.size());
+  block->selection_vector()->SetAllFalse();
+
+  // Holds the rows read for one key. The key bounds of the scans leave at
+  // most one row to read.
+  RowBlock key_block(mapped_projection, 1, arena);
+  ProbeStats stats;
+  for (int i = 0; i < encoded_keys.size(); i++) {
+    gscoped_ptr<EncodedKey> lower_bound;
+    RETURN_NOT_OK_PREPEND(EncodedKey::DecodeEncodedString(*schema(), arena, encoded_keys[i],
+                                                          &lower_bound),
+                          "Invalid primary key");
+    if (PREDICT_FALSE(lower_bound->raw_keys().size() != key_schema.num_columns())) {
+      return Status::InvalidArgument("Primary key is missing columns",
+                                     lower_bound->Stringify(*schema()));
+    }
+    // The largest possible key has no successor, and needs no upper bound.
+    gscoped_ptr<EncodedKey> upper_bound;
+    RETURN_NOT_OK(EncodedKey::DecodeEncodedString(*schema(), arena, encoded_keys[i],
+                                                  &upper_bound));
+    if (!EncodedKey::IncrementEncodedKey(*schema(), &upper_bound, arena).ok()) {
+      upper_bound.reset();
+    }
+
+    // The bloom filters and key indexes are probed with the key as a row.
+    uint8_t* key_data = static_cast<uint8_t*>(arena->AllocateBytes(key_schema.byte_size()));
+    if (PREDICT_FALSE(key_data == nullptr)) {
+      return Status::RuntimeError("Out of memory allocating row key");
+    }
+    ContiguousRow key_row(&key_schema, key_data);
+    for (int c = 0; c < key_schema.num_columns(); c++) {
+      memcpy(key_row.mutable_cell_ptr(c), lower_bound->raw_keys()[c],
+             key_schema.column(c).type_info()->size());
+    }
+    RowSetKeyProbe probe(key_row);
+
+    vector<RowSet*> candidates;
+    comps->rowsets->FindRowSetsWithKeyInRange(probe.encoded_key_slice(), &candidates);
+    candidates.push_back(comps->memrowset.get());
+
+    bool found = false;
+    for (const RowSet* rs : candidates) {
+      bool present;
+      RETURN_NOT_OK(rs->CheckRowEverPresent(probe, &present, &stats));
+      if (!present) {
+        continue;
+      }
+
+      gscoped_ptr<RowwiseIterator> iter;
+      RETURN_NOT_OK(rs->NewRowIterator(&mapped_projection, snap, &iter));
+      ScanSpec spec;
+      spec.SetLowerBoundKey(lower_bound.get());
+      if (upper_bound) {
+        spec.SetExclusiveUpperBoundKey(upper_bound.get());
+      }
+      RETURN_NOT_OK(iter->Init(&spec));
+      while (!found && iter->HasNext()) {
+        RETURN_NOT_OK(iter->NextBlock(&key_block));
+        for (size_t j = 0; j < key_block.nrows(); j++) {
+          if (key_block.selection_vector()->IsRowSelected(j)) {
+            RowBlockRow dst = block->row(i);
+            RETURN_NOT_OK(CopyRow(key_block.row(j), &dst, arena));
+            block->selection_vector()->SetRowSelected(i);
+            found = true;
+            break;
+          }
+        }
+      }
+      // A row is only ever visible in one rowset.
+      if (found) {
+        break;
+      }
+    }
+  }
+
+  if (metrics_) {
+    metrics_->AddProbeStats(&stats, 1, arena);
+  }
+  return Status::OK();
+}
+
 size_t Tablet::MemRowSetSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1598,6 +2990,18 @@ size_t Tablet::MemRowSetLogRetentionSize(const MaxIdxToSegmentMap& max_idx_to_se
                                      max_idx_to_segment_size);
 }
 
+double Tablet::MeasuredReadAmplification() const {
+  if (!metrics_) {
+    return 0;
+  }
+  int64_t cells_returned = metrics_->scanner_cells_returned->value();
+  if (cells_returned == 0) {
+    return 0;
+  }
+  return static_cast<double>(metrics_->scanner_cells_scanned_from_disk->value()) /
+      cells_returned;
+}
+
 size_t Tablet::EstimateOnDiskSize() const {
   scoped_refptr<TabletComponents> comps;
   GetComponents(&comps);
@@ -1749,6 +3153,57 @@ Status Tablet::CompactWorstDeltas(RowSet::DeltaCompactionType type) {
   return Status::OK();
 }
 
+Status Tablet::ReencodeColumnsOfOneRowSet(bool* up_to_date) {
+  CHECK_EQ(state_, kOpen);
+  *up_to_date = false;
+
+  // Look for the columns without holding compact_select_lock_, since it
+  // takes reading the footers of their files.
+  scoped_refptr<TabletComponents> comps;
+  GetComponents(&comps);
+  shared_ptr<RowSet> rs;
+  vector<ColumnId> col_ids;
+  bool skipped_any = false;
+  for (const shared_ptr<RowSet>& rowset : comps->rowsets->all_rowsets()) {
+    if (!rowset->IsAvailableForCompaction()) {
+      skipped_any = true;
+      continue;
+    }
+    RETURN_NOT_OK(down_cast<DiskRowSet*>(rowset.get())->FindColumnsToReencode(&col_ids));
+    if (!col_ids.empty()) {
+      rs = rowset;
+      break;
+    }
+  }
+  if (!rs) {
+    *up_to_date = !skipped_any;
+    return Status::OK();
+  }
+
+  std::unique_lock<std::mutex> lock;
+  {
+    std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
+    lock = std::unique_lock<std::mutex>(*rs->compact_flush_lock(), std::try_to_lock);
+    if (!lock.owns_lock()) {
+      // Another compaction got to the rowset first.
+      return Status::OK();
+    }
+    // Or it may have been compacted away since.
+    GetComponents(&comps);
+    const auto& all_rowsets = comps->rowsets->all_rowsets();
+    if (std::find(all_rowsets.begin(), all_rowsets.end(), rs) == all_rowsets.end()) {
+      return Status::OK();
+    }
+  }
+
+  LOG_WITH_PREFIX(INFO) << "Rewriting " << col_ids.size() << " altered column(s) of "
+                        << rs->ToString();
+  RETURN_NOT_OK_PREPEND(
+      down_cast<DiskRowSet*>(rs.get())->MajorCompactDeltaStoresWithColumnIds(col_ids),
+      "Failed to rewrite the altered columns of " + rs->ToString());
+  return Status::OK();
+}
+
 double Tablet::GetPerfImprovementForBestDeltaCompact(RowSet::DeltaCompactionType type,
                                                              shared_ptr<RowSet>* rs) const {
   std::lock_guard<std::mutex> compact_lock(compact_select_lock_);
@@ -1802,6 +3257,7 @@ void Tablet::PrintRSLayout(ostream* o) {
     return;
   }
 
+  *o << "<p>Compaction policy: " << compaction_policy_->name() << "</p>";
   if (!picked.empty()) {
     *o << "<p>";
     *o << "Highlighted rowsets indicate those that would be compacted next if a "
@@ -1822,6 +3278,39 @@ void Tablet::PrintRSLayout(ostream* o) {
   *o << "</pre>" << std::endl;
 }
 
+void Tablet::PrintCFileReaderMemory(ostream* o) {
+  shared_ptr<RowSetTree> rowsets_copy;
+  {
+    shared_lock<rw_spinlock> l(component_lock_);
+    rowsets_copy = components_->rowsets;
+  }
+
+  shared_ptr<MemTracker> tracker;
+  int64_t total = 0;
+  if (MemTracker::FindTracker(DiskRowSet::kCFileReaderMemTrackerId, &tracker, mem_tracker_)) {
+    total = tracker->consumption();
+  }
+  *o << "<p>Total: " << HumanReadableNumBytes::ToString(total) << "</p>" << std::endl;
+  *o << "<p>Key indexes pinned: " << (metadata_->pin_key_index() ? "yes" : "no")
+     << "</p>" << std::endl;
+
+  *o << "<table class=\"table table-striped\">" << std::endl;
+  *o << "<tr><th>RowSet</th><th>On-disk size</th><th>Reader memory</th>"
+     << "<th>Pinned index blocks</th></tr>" << std::endl;
+  for (const shared_ptr<RowSet>& rs : rowsets_copy->all_rowsets()) {
+    int64_t consumption;
+    size_t pinned_bytes;
+    down_cast<DiskRowSet*>(rs.get())->GetBaseDataMemoryUsage(&consumption, &pinned_bytes);
+    *o << Substitute("<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td></tr>",
+                     rs->metadata()->id(),
+                     HumanReadableNumBytes::ToString(rs->EstimateOnDiskSize()),
+                     HumanReadableNumBytes::ToString(consumption),
+                     HumanReadableNumBytes::ToString(pinned_bytes))
+       << std::endl;
+  }
+  *o << "</table>" << std::endl;
+}
+
 string Tablet::LogPrefix() const {
   return Substitute("T $0 ", tablet_id());
 }
@@ -1830,6 +3319,35 @@ string Tablet::LogPrefix() const {
 // Tablet::Iterator
 ////////////////////////////////////////////////////////////
 
+namespace {
+
+// Wraps each of 'iters' so that their blocks are decoded on 'pool'. An
+// unordered scan consumes the iterators one after another, so only a sliding
+// window of them is prefetched at any time; an ordered scan merges them all.
+void WrapForPrefetching(ThreadPool* pool, Tablet::OrderMode order,
+                        vector<shared_ptr<RowwiseIterator>>* iters) {
+  vector<shared_ptr<PrefetchingIterator>> prefetchers;
+  for (shared_ptr<RowwiseIterator>& iter : *iters) {
+    prefetchers.push_back(std::make_shared<PrefetchingIterator>(
+        std::move(iter), pool, FLAGS_tablet_scan_prefetch_blocks));
+    iter = prefetchers.back();
+  }
+
+  size_t window = prefetchers.size();
+  if (order == Tablet::UNORDERED) {
+    window = std::min<size_t>(window, std::max(1, FLAGS_tablet_scan_prefetch_rowsets));
+  }
+  for (size_t i = 0; i < prefetchers.size(); i++) {
+    if (i < window) {
+      prefetchers[i]->StartPrefetching();
+    } else {
+      prefetchers[i - window]->set_successor(prefetchers[i]);
+    }
+  }
+}
+
+} // anonymous namespace
+
 Tablet::Iterator::Iterator(const Tablet* tablet, const Schema& projection,
                            MvccSnapshot snap, const OrderMode order)
     : tablet_(tablet),
@@ -1846,7 +3364,11 @@ Status Tablet::Iterator::Init(ScanSpec *spec) {
 
   vector<shared_ptr<RowwiseIterator>> iters;
 
-  RETURN_NOT_OK(tablet_->CaptureConsistentIterators(&projection_, snap_, spec, &iters));
+  RETURN_NOT_OK(tablet_->CaptureConsistentIterators(&projection_, snap_, spec, order_, &iters));
+
+  if (tablet_->scan_prefetch_pool_ != nullptr && iters.size() > 1) {
+    WrapForPrefetching(tablet_->scan_prefetch_pool_, order_, &iters);
+  }
 
   switch (order_) {
     case ORDERED:
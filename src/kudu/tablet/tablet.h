@@ -22,6 +22,7 @@
 #include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_set>
 #include <vector>
 
 #include "kudu/common/iterator.h"
@@ -36,6 +37,7 @@
 #include "kudu/tablet/rowset.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/semaphore.h"
 #include "kudu/util/slice.h"
 #include "kudu/util/status.h"
@@ -46,6 +48,7 @@ namespace kudu {
 class MemTracker;
 class MetricEntity;
 class RowChangeList;
+class ThreadPool;
 class UnionIterator;
 
 namespace log {
@@ -63,10 +66,12 @@ class MaintenanceOpStats;
 namespace tablet {
 
 class AlterSchemaTransactionState;
+class CFileSet;
 class CompactionPolicy;
 class MemRowSet;
 class MvccSnapshot;
 struct RowOp;
+struct RowExpiry;
 class RowSetsInCompaction;
 class RowSetTree;
 struct TabletComponents;
@@ -111,6 +116,16 @@ class Tablet {
   Status DecodeWriteOperations(const Schema* client_schema,
                                WriteTransactionState* tx_state);
 
+  // Decode the Write operations of 'write', one of the writes coalesced into
+  // 'tx_state', appending them to the operations of 'tx_state'.
+  //
+  // So that a coalesced write which doesn't belong in this tablet fails on
+  // its own, rather than failing AcquireRowLocks() for all the writes, the
+  // keys of the rows of every write of 'tx_state' are checked here.
+  Status DecodeCoalescedWriteOperations(const Schema* client_schema,
+                                        WriteTransactionState* write,
+                                        WriteTransactionState* tx_state);
+
   // Acquire locks for each of the operations in the given txn.
   //
   // Note that, if this fails, it's still possible that the transaction
@@ -209,6 +224,21 @@ class Tablet {
   // To do that, call FlushBiggestDMS() for example.
   Status Flush();
 
+  // Load a run of rows directly into new DiskRowSets, bypassing the MemRowSet
+  // and the flush and compaction work that inserting them would otherwise cost.
+  //
+  // The rows must use the tablet's schema and be sorted by strictly ascending
+  // primary key. The key range they span must be empty: no existing rowset may
+  // overlap it, and the MemRowSet may not hold any key within it. Returns
+  // InvalidArgument or IllegalState if these requirements are not met, in which
+  // case nothing is loaded.
+  //
+  // The rows become visible atomically, to snapshots taken after the load.
+  //
+  // NOTE: this is a local operation. It does not go through consensus, so on a
+  // replicated tablet it must be applied to every replica by other means.
+  Status BulkLoadSortedRows(const std::vector<ConstContiguousRow>& rows);
+
   // Prepares the transaction context for the alter schema operation.
   // An error will be returned if the specified schema is invalid (e.g.
   // key mismatch, or missing IDs)
@@ -216,9 +246,21 @@ class Tablet {
                                    const Schema* schema);
 
   // Apply the Schema of the specified transaction.
-  // This operation will trigger a flush on the current MemRowSet.
+  //
+  // Rather than flushing the current MemRowSet, which would block writes on
+  // the schema lock for as long as the flush takes, this swaps in a new one
+  // with the new schema. The old one stays in the rowset tree, where it's
+  // read through the new schema like any other rowset which predates it,
+  // until FlushPreAlterMemRowSet() flushes it.
   Status AlterSchema(AlterSchemaTransactionState* tx_state);
 
+  // Flushes the MemRowSet replaced by the last AlterSchema() call, if it
+  // hasn't been flushed yet. Should be called once the schema lock taken by
+  // the alter is released, so that writes can go on in the meantime. Any
+  // other flush also flushes it first, since MemRowSets must be flushed in
+  // the order of their ids.
+  Status FlushPreAlterMemRowSet();
+
   // Rewind the schema to an earlier version than is written in the on-disk
   // metadata. This is done during bootstrap to roll the schema back to the
   // point in time where the logs-to-be-replayed begin, so we can then decode
@@ -233,6 +275,10 @@ class Tablet {
   // on the current layout.
   void PrintRSLayout(std::ostream* o);
 
+  // Dumps, as HTML, the memory used by the readers of the base data of each
+  // of the tablet's rowsets, including the index blocks they pinned.
+  void PrintCFileReaderMemory(std::ostream* o);
+
   // Flags to change the behavior of compaction.
   enum CompactFlag {
     COMPACT_NO_FLAGS = 0,
@@ -249,6 +295,49 @@ class Tablet {
   // Update the statistics for performing a compaction.
   void UpdateCompactionStats(MaintenanceOpStats* stats);
 
+  // Adds the data directories holding the blocks of 'rowset' to 'stats', so
+  // that the maintenance manager can account for the disks an op reads.
+  void AddRowSetDataDirs(RowSet* rowset, MaintenanceOpStats* stats) const;
+
+  // Returns how long the tablet keeps the history of its rows: the table's
+  // retention if it chose one, else --tablet_history_max_age_sec.
+  MonoDelta HistoryMaxAge() const;
+
+  // Sets '*ancient_history_mark' to the earliest timestamp the tablet keeps
+  // history for and returns true. Snapshots before it may no longer be read.
+  // Returns false if the clock can't measure the age of timestamps, in which
+  // case all history is kept.
+  bool GetTabletAncientHistoryMark(Timestamp* ancient_history_mark) const;
+
+  // Returns the size of the UNDO delta blocks that may hold only history
+  // older than the ancient history mark. Does no I/O.
+  int64_t EstimateBytesInPotentiallyAncientUndoDeltas();
+
+  // Deletes the UNDO delta blocks of the rowsets not being compacted which
+  // hold only history older than the ancient history mark, then flushes the
+  // tablet metadata. REDO deltas are never ancient: they hold the latest
+  // versions of rows, and only delta compactions fold them into the base data.
+  Status DeleteAncientUndoDeltas(int64_t* blocks_deleted, int64_t* bytes_deleted);
+
+  // Returns true if the table has a row TTL, but always false if the clock
+  // can't tell how old rows are, in which case no row expires.
+  bool HasRowTtl() const;
+
+  // Sets '*expiry' to the TTL column and the time before which rows have
+  // expired as of now, and returns true. Returns false if !HasRowTtl().
+  bool GetRowExpiry(RowExpiry* expiry) const;
+
+  // Deletes the rowsets not being compacted all of whose rows have expired,
+  // without rewriting them, and flushes the tablet metadata. Reads the zone
+  // maps of the TTL column of each rowset.
+  Status DeleteExpiredRowSets(int64_t* rowsets_deleted);
+
+  // Sets '*stats' to the statistics of the values of each column of the
+  // current schema, merged across the DiskRowSets which collected them.
+  // They describe the base data as it was written: neither the MemRowSet nor
+  // the deltas are accounted for. Columns without statistics are left out.
+  Status GetColumnStatistics(std::vector<ColumnStatisticsPB>* stats) const;
+
   // Returns the exact current size of the MRS, in bytes. A value greater than 0 doesn't imply
   // that the MRS has data, only that it has allocated that amount of memory.
   // This method takes a read lock on component_lock_ and is thread-safe.
@@ -262,6 +351,12 @@ class Tablet {
   // Returns the size in bytes for the MRS's log retention.
   size_t MemRowSetLogRetentionSize(const MaxIdxToSegmentMap& max_idx_to_segment_size) const;
 
+  // Returns the number of cells scanners have read from disk for every cell
+  // they returned, since the tablet was opened, or 0 if nothing has been
+  // returned yet or metrics are disabled. This is the read amplification that
+  // compactions can reduce.
+  double MeasuredReadAmplification() const;
+
   // Estimate the total on-disk size of this tablet, in bytes.
   size_t EstimateOnDiskSize() const;
 
@@ -286,6 +381,13 @@ class Tablet {
   // issues a minor delta compaction.
   Status CompactWorstDeltas(RowSet::DeltaCompactionType type);
 
+  // Rewrites the base data of the columns of one rowset which were written
+  // with an encoding or compression other than the schema's, e.g. because
+  // the columns were altered since. Sets '*up_to_date' to true if no rowset
+  // has any such columns, in which case there is nothing more to do until
+  // the schema changes.
+  Status ReencodeColumnsOfOneRowSet(bool* up_to_date);
+
   // Get the highest performance improvement that would come from compacting the delta stores
   // of one of the rowsets. If the returned performance improvement is 0, or if 'rs' is NULL,
   // then 'rs' isn't set. Callers who already own compact_select_lock_
@@ -306,6 +408,46 @@ class Tablet {
   // memrowset in the current implementation.
   Status CountRows(uint64_t *count) const;
 
+  // Count the number of live (i.e. not deleted) rows in the tablet without
+  // reading any row data, using the row counts of the rowsets and the delete
+  // counts of their delta stores.
+  //
+  // These counts include every applied mutation, committed or not, so they
+  // only correspond to an MVCC snapshot if no transaction is in flight while
+  // they are summed. If that holds, sets *count and sets *snap_timestamp to a
+  // timestamp at which a snapshot scan would see exactly *count rows.
+  // Otherwise returns Status::Incomplete, and callers should fall back to
+  // scanning.
+  Status CountLiveRows(uint64_t* count, Timestamp* snap_timestamp) const;
+
+  // Split the primary key range [start_key, stop_key) into chunks of roughly
+  // 'target_chunk_size_bytes' of on-disk data each, setting 'split_keys' to
+  // the encoded keys at which the chunks begin, in ascending order and
+  // excluding 'start_key'. An empty 'start_key' or 'stop_key' leaves that
+  // end of the range unbounded.
+  //
+  // The sizes are estimated from the key indexes and sizes of the rowsets,
+  // without reading any row data. Rows which haven't been flushed yet aren't
+  // accounted for.
+  Status SplitKeyRange(const std::string& start_key,
+                       const std::string& stop_key,
+                       uint64_t target_chunk_size_bytes,
+                       std::vector<std::string>* split_keys) const;
+
+  // Look up the rows with the given encoded primary keys as of 'snap',
+  // without setting up an iterator over the whole tablet. Row i of 'block',
+  // whose schema must be 'projection', is set to the row of
+  // 'encoded_keys[i]' and selected if that row is visible in 'snap', and is
+  // unselected otherwise. 'block' must have room for all the keys; the
+  // indirect data of the rows is allocated from its arena.
+  //
+  // A key is only looked for in the rowsets whose key range covers it and
+  // whose bloom filter and key index may contain it.
+  Status LookupRows(const Schema& projection,
+                    const MvccSnapshot& snap,
+                    const std::vector<std::string>& encoded_keys,
+                    RowBlock* block) const;
+
 
   // Verbosely dump this entire tablet to the logs. This is only
   // really useful when debugging unit tests failures where the tablet
@@ -364,6 +506,16 @@ class Tablet {
   // May be NULL in unit tests, etc.
   TabletMetrics* metrics() { return metrics_.get(); }
 
+  // Set the thread pool used to decode the rowsets of a scan in parallel.
+  // If unset (the default), each scan is decoded by the thread driving it.
+  // Must be called before the tablet is scanned.
+  void set_scan_prefetch_pool(ThreadPool* pool) { scan_prefetch_pool_ = pool; }
+
+  // Set the thread pool used to encode the columns of flushes, compactions
+  // and bulk loads in parallel. If unset (the default), they are encoded by
+  // the thread writing them. Must be called before the tablet writes rowsets.
+  void set_compaction_encode_pool(ThreadPool* pool) { compaction_encode_pool_ = pool; }
+
   // Return handle to the metric entity of this tablet.
   const scoped_refptr<MetricEntity>& GetMetricEntity() const { return metric_entity_; }
 
@@ -382,6 +534,9 @@ class Tablet {
 
   Status FlushUnlocked();
 
+  // Like FlushPreAlterMemRowSet(), for callers holding 'rowsets_flush_sem_'.
+  Status FlushPreAlterMemRowSetUnlocked();
+
 
   // Perform an INSERT or UPSERT operation, assuming that the transaction is already in
   // prepared state. This state ensures that:
@@ -404,10 +559,29 @@ class Tablet {
                              RowSet* rowset,
                              ProbeStats* stats);
 
-  // Return the list of RowSets that need to be consulted when processing the
-  // given insertion or mutation.
-  static std::vector<RowSet*> FindRowSetsToCheck(RowOp* op,
-                                                 const TabletComponents* comps);
+  // Returns whether the key of 'op' is live in the MemRowSet of 'comps'.
+  // UPSERTs check this before probing the DiskRowSets, which can't hold a key
+  // live in the MemRowSet, so that repeated upserts of a hot key cost no disk
+  // lookups at all.
+  static bool IsPresentInMemRowSet(const TabletComponents* comps,
+                                   RowOp* op,
+                                   ProbeStats* stats);
+
+  // Fill 'to_check' with the list of RowSets that need to be consulted when
+  // processing the given insertion or mutation.
+  static void FindRowSetsToCheck(RowOp* op,
+                                 const TabletComponents* comps,
+                                 std::vector<RowSet*>* to_check);
+
+  // Determine, for a whole batch, which rowset (if any) already contains the
+  // key of each INSERT and UPSERT in the transaction. The keys are sorted and
+  // looked up in a single sweep of the rowset tree, and each rowset is then
+  // probed for its candidate keys in key order. On success, each op that was
+  // checked has 'checked_present' set; the others are left to be checked
+  // row by row while applying.
+  //
+  // 'stats_array' must contain one ProbeStats per row op.
+  Status BulkCheckPresence(WriteTransactionState* tx_state, ProbeStats* stats_array);
 
 
   // Capture a set of iterators which, together, reflect all of the data in the tablet.
@@ -418,26 +592,67 @@ class Tablet {
   //
   // The returned iterators are not Init()ed.
   // 'projection' must remain valid and unchanged for the lifetime of the returned iterators.
+  //
+  // If 'order' is UNORDERED and the scan covers the whole tablet, the disk
+  // rowsets' iterators may start at the rowset which another such scan has
+  // reached rather than at the first one, and wrap around; see
+  // --tablet_synchronize_full_scans.
   Status CaptureConsistentIterators(const Schema *projection,
                                     const MvccSnapshot &snap,
                                     const ScanSpec *spec,
+                                    OrderMode order,
                                     vector<std::shared_ptr<RowwiseIterator> > *iters) const;
 
+  // Adds to '*pruned' the disk rowsets within the key bounds of 'spec' which
+  // can't hold any row satisfying its predicates, as found by
+  // RowSet::ExcludedByPredicates(). The rowsets checked are added to
+  // '*candidates', which keeps them alive for as long as '*pruned' is used.
+  //
+  // Takes the component lock only to capture the rowsets, so that their
+  // files may be opened without holding it.
+  Status FindPrunedRowSets(const ScanSpec& spec,
+                           RowSetVector* candidates,
+                           std::unordered_set<const RowSet*>* pruned) const;
+
   Status PickRowSetsToCompact(RowSetsInCompaction *picked,
                               CompactFlags flags) const;
 
+  // Restrict the large disk rowsets of 'input' to the slice of their keys
+  // which overlaps the other rowsets being compacted, so that their other
+  // rows are kept in place rather than rewritten.
+  Status SliceCompactionInputs(RowSetsInCompaction* input) const;
+
+  // Split the rowsets of 'input' into those which are compacted whole and
+  // those which were sliced, opening the base data of the latter narrowed
+  // to the rows they keep.
+  Status PrepareSlicedRowSets(const RowSetsInCompaction& input,
+                              RowSetVector* whole_rowsets,
+                              RowSetVector* sliced_rowsets,
+                              std::vector<std::shared_ptr<CFileSet>>* narrowed_base_data) const;
+
   Status DoCompactionOrFlush(const RowSetsInCompaction &input,
                              int64_t mrs_being_flushed);
 
   // Handle the case in which a compaction or flush yielded no output rows.
-  // In this case, we just need to remove the rowsets in 'rowsets' from the
-  // metadata and flush it.
-  Status HandleEmptyCompactionOrFlush(const RowSetVector& rowsets,
+  // In this case, we just need to remove the rowsets of 'input' from the
+  // metadata (or narrow them, if they were sliced) and flush it.
+  Status HandleEmptyCompactionOrFlush(const RowSetsInCompaction& input,
                                       int mrs_being_flushed);
 
+  // Returns IllegalState if any row in the encoded key range
+  // [lower_bound, upper_bound] may already exist in the tablet.
+  //
+  // REQUIRES: component_lock_ is held.
+  Status CheckKeyRangeIsEmptyUnlocked(const Slice& lower_bound,
+                                      const Slice& upper_bound) const;
+
   Status FlushMetadata(const RowSetVector& to_remove,
                        const RowSetMetadataVector& to_add,
                        int64_t mrs_being_flushed);
+  Status FlushMetadata(const RowSetVector& to_remove,
+                       const RowSetMetadataVector& to_add,
+                       const RowSetLiveRanges& to_narrow,
+                       int64_t mrs_being_flushed);
 
   static void ModifyRowSetTree(const RowSetTree& old_tree,
                                const RowSetVector& rowsets_to_remove,
@@ -480,6 +695,12 @@ class Tablet {
 
   Status CheckRowInTablet(const ConstContiguousRow& probe) const;
 
+  // Decodes the row operations of 'write' and appends them to those of
+  // 'tx_state'. See DecodeCoalescedWriteOperations().
+  Status DecodeRowOperations(const Schema* client_schema,
+                             WriteTransactionState* write,
+                             WriteTransactionState* tx_state);
+
   // Helper method to find the rowset that has the DMS with the highest retention.
   std::shared_ptr<RowSet> FindBestDMSToFlush(
       const MaxIdxToSegmentMap& max_idx_to_segment_size) const;
@@ -540,6 +761,26 @@ class Tablet {
 
   std::unique_ptr<Throttler> throttler_;
 
+  // Not owned. May be NULL.
+  ThreadPool* scan_prefetch_pool_;
+
+  class FullScanPositionIterator;
+
+  // The disk rowset which an unordered full scan of the tablet last read a
+  // block from, and when. It is only compared with other rowsets, never
+  // dereferenced.
+  struct FullScanPosition {
+    FullScanPosition() : rowset(nullptr) {}
+
+    simple_spinlock lock;
+    const RowSet* rowset;
+    MonoTime updated;
+  };
+  mutable FullScanPosition full_scan_position_;
+
+  // Not owned. May be NULL.
+  ThreadPool* compaction_encode_pool_;
+
   int64_t next_mrs_id_;
 
   // A pointer to the server's clock.
@@ -561,6 +802,12 @@ class Tablet {
   // started earlier completes after the one started later.
   mutable Semaphore rowsets_flush_sem_;
 
+  // The MemRowSet replaced by AlterSchema() and not yet flushed, if any, and
+  // the flush input holding its compaction lock. Protected by
+  // 'rowsets_flush_sem_'.
+  std::shared_ptr<MemRowSet> pre_alter_mrs_;
+  gscoped_ptr<RowSetsInCompaction> pre_alter_mrs_input_;
+
   enum State {
     kInitialized,
     kBootstrapping,
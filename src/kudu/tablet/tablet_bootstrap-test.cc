@@ -17,6 +17,7 @@
 
 #include "kudu/consensus/log-test-base.h"
 
+#include <gflags/gflags.h>
 #include <vector>
 
 #include "kudu/common/iterator.h"
@@ -35,6 +36,8 @@ using std::shared_ptr;
 using std::string;
 using std::vector;
 
+DECLARE_int32(log_replay_readahead_mb);
+
 namespace kudu {
 
 namespace log {
@@ -178,6 +181,30 @@ TEST_F(BootstrapTest, TestBootstrap) {
   ASSERT_EQ(1, results.size());
 }
 
+// Tests a bootstrap over several segments with the smallest possible
+// read-ahead, so that replay has to wait on the read-ahead thread for every
+// entry.
+TEST_F(BootstrapTest, TestBootstrapWithMinimalReadAhead) {
+  FLAGS_log_replay_readahead_mb = 0;
+  ASSERT_OK(BuildLog());
+
+  const int kNumSegments = 3;
+  const int kOpsPerSegment = 10;
+  for (int i = 0; i < kNumSegments; i++) {
+    AppendReplicateBatchAndCommitEntryPairsToLog(kOpsPerSegment);
+    ASSERT_OK(RollLog());
+  }
+
+  shared_ptr<Tablet> tablet;
+  ConsensusBootstrapInfo boot_info;
+  ASSERT_OK(BootstrapTestTablet(-1, -1, &tablet, &boot_info));
+  ASSERT_TRUE(boot_info.orphaned_replicates.empty());
+
+  vector<string> results;
+  IterateTabletRows(tablet.get(), &results);
+  ASSERT_EQ(kNumSegments * kOpsPerSegment, results.size());
+}
+
 // Tests attempting a local bootstrap of a tablet that was in the middle of a
 // tablet copy before "crashing".
 TEST_F(BootstrapTest, TestIncompleteTabletCopy) {
@@ -17,6 +17,7 @@
 
 #include "kudu/tablet/tablet_bootstrap.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <map>
 #include <memory>
@@ -37,6 +38,7 @@
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/strcat.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
@@ -50,13 +52,17 @@
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tablet/transactions/alter_schema_transaction.h"
 #include "kudu/tablet/transactions/write_transaction.h"
+#include "kudu/util/blocking_queue.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/fault_injection.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/path_util.h"
 #include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
 
 DEFINE_bool(skip_remove_old_recovery_dir, false,
             "Skip removing WAL recovery dir after startup. (useful for debugging)");
@@ -68,6 +74,24 @@ DEFINE_double(fault_crash_during_log_replay, 0.0,
               "(For testing only!)");
 TAG_FLAG(fault_crash_during_log_replay, unsafe);
 
+DEFINE_int32(log_replay_readahead_mb, 64,
+             "Maximum amount of log data, in MB, that tablet bootstrap reads and "
+             "decodes ahead of the entries being replayed.");
+TAG_FLAG(log_replay_readahead_mb, advanced);
+
+METRIC_DEFINE_counter(tablet, log_replay_entries_read, "Log Replay Entries Read",
+                      kudu::MetricUnit::kEntries,
+                      "Number of log entries read while replaying the log "
+                      "at tablet bootstrap.");
+METRIC_DEFINE_counter(tablet, log_replay_bytes_read, "Log Replay Bytes Read",
+                      kudu::MetricUnit::kBytes,
+                      "Amount of log data read while replaying the log "
+                      "at tablet bootstrap.");
+METRIC_DEFINE_counter(tablet, log_replay_duration, "Log Replay Duration",
+                      kudu::MetricUnit::kMilliseconds,
+                      "Time spent replaying the log at tablet bootstrap. Together "
+                      "with the bytes read, this gives the replay throughput.");
+
 DECLARE_int32(max_clock_sync_error_usec);
 
 namespace kudu {
@@ -113,6 +137,109 @@ using tserver::WriteResponsePB;
 
 struct ReplayState;
 
+// Reads the entries of a sequence of log segments on a separate thread, so
+// that reading and decoding the next entries overlaps with replaying the
+// previous ones. The amount of data read ahead is bounded.
+class LogEntryReadAhead {
+ public:
+  struct Item {
+    explicit Item(int segment_idx)
+      : segment_idx(segment_idx),
+        size_bytes(0) {
+    }
+
+    // The index of the segment this item was read from.
+    int segment_idx;
+
+    // The entry, or NULL if this item marks the end of the segment or a
+    // read error.
+    unique_ptr<LogEntryPB> entry;
+
+    // The number of bytes the entry took in the segment.
+    int64_t size_bytes;
+
+    // Set if reading the segment failed. No more items follow.
+    Status status;
+  };
+
+  LogEntryReadAhead(log::SegmentSequence segments, size_t max_bytes)
+    : segments_(std::move(segments)),
+      queue_(max_bytes) {
+  }
+
+  ~LogEntryReadAhead() {
+    queue_.Shutdown();
+    if (thread_) {
+      thread_->Join();
+    }
+    Item* item;
+    while (queue_.BlockingGet(&item)) {
+      delete item;
+    }
+  }
+
+  Status Start() {
+    return Thread::Create("tablet", "log-replay-readahead",
+                          &LogEntryReadAhead::ReadThread, this, &thread_);
+  }
+
+  // Returns the next item read, blocking until one is available.
+  // Returns false if the reader stopped early, which is a bug.
+  bool Next(unique_ptr<Item>* item) {
+    Item* next;
+    if (!queue_.BlockingGet(&next)) {
+      return false;
+    }
+    item->reset(next);
+    return true;
+  }
+
+ private:
+  struct ItemLogicalSize {
+    static size_t logical_size(const Item* item) {
+      return item->size_bytes;
+    }
+  };
+
+  void ReadThread() {
+    for (int i = 0; i < segments_.size(); i++) {
+      log::LogEntryReader reader(segments_[i].get());
+      while (true) {
+        int64_t start_offset = reader.offset();
+        unique_ptr<Item> item(new Item(i));
+        item->entry.reset(new LogEntryPB);
+        Status s = reader.ReadNextEntry(item->entry.get());
+        bool segment_done = !s.ok();
+        if (segment_done) {
+          item->entry.reset();
+          if (!s.IsEndOfFile()) {
+            item->status = s;
+          }
+        } else {
+          item->size_bytes = reader.offset() - start_offset;
+        }
+        if (!queue_.BlockingPut(item.get())) {
+          // Shut down by the consumer.
+          return;
+        }
+        item.release();
+        if (!s.ok() && !s.IsEndOfFile()) {
+          return;
+        }
+        if (segment_done) {
+          break;
+        }
+      }
+    }
+  }
+
+  const log::SegmentSequence segments_;
+  BlockingQueue<Item*, ItemLogicalSize> queue_;
+  scoped_refptr<Thread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(LogEntryReadAhead);
+};
+
 // Information from the tablet metadata which indicates which data was
 // flushed prior to this restart and which memory stores are still active.
 //
@@ -245,10 +372,16 @@ class TabletBootstrap {
                            const vector<bool>& already_flushed);
 
   // Determine which of the operations from 'result' correspond to already-flushed stores.
-  // At the same time this builds the WriteResponsePB that we'll store on the ResultTracker.
-  Status DetermineFlushedOpsAndBuildResponse(const TxResultPB& result,
-                                             vector<bool>* flushed_by_op,
-                                             WriteResponsePB* response);
+  Status DetermineFlushedOps(const TxResultPB& result, vector<bool>* flushed_by_op);
+
+  // Stores the result of the write whose request id is 'request_id' on the ResultTracker,
+  // unless it's already stored there. The results of the row operations of the write are
+  // the 'num_ops' of 'result' which start at 'first_op'.
+  void RecordWriteResult(const rpc::RequestIdPB& request_id,
+                         uint64_t timestamp,
+                         const TxResultPB& result,
+                         int first_op,
+                         int num_ops);
 
   // Pass through all of the decoded operations in tx_state. For
   // each op:
@@ -1065,51 +1198,88 @@ Status TabletBootstrap::PlaySegments(ConsensusBootstrapInfo* consensus_info) {
   // writing.
   RETURN_NOT_OK_PREPEND(OpenNewLog(), "Failed to open new log");
 
-  int segment_count = 0;
-  for (const scoped_refptr<ReadableLogSegment>& segment : segments) {
-    log::LogEntryReader reader(segment.get());
-
-    int entry_count = 0;
-    while (true) {
-      unique_ptr<LogEntryPB> entry(new LogEntryPB);
+  scoped_refptr<Counter> entries_read_metric;
+  scoped_refptr<Counter> bytes_read_metric;
+  scoped_refptr<Counter> duration_metric;
+  if (tablet_->GetMetricEntity()) {
+    entries_read_metric = METRIC_log_replay_entries_read.Instantiate(tablet_->GetMetricEntity());
+    bytes_read_metric = METRIC_log_replay_bytes_read.Instantiate(tablet_->GetMetricEntity());
+    duration_metric = METRIC_log_replay_duration.Instantiate(tablet_->GetMetricEntity());
+  }
 
-      Status s = reader.ReadNextEntry(entry.get());
-      if (PREDICT_FALSE(!s.ok())) {
-        if (s.IsEndOfFile()) {
-          break;
-        }
-        return Status::Corruption(Substitute("Error reading Log Segment of tablet $0: $1 "
-                                             "(Read up to entry $2 of segment $3, in path $4)",
-                                             tablet_->tablet_id(),
-                                             s.ToString(),
-                                             entry_count,
-                                             segment->header().sequence_number(),
-                                             segment->path()));
-      }
-      entry_count++;
+  // Segments are read and decoded ahead of replay on a separate thread, but
+  // the entries are still replayed one at a time, in log order.
+  LogEntryReadAhead read_ahead(
+      segments, std::max<size_t>(1, static_cast<size_t>(FLAGS_log_replay_readahead_mb) << 20));
+  RETURN_NOT_OK_PREPEND(read_ahead.Start(), "Couldn't start log read-ahead thread");
 
-      s = HandleEntry(&state, entry.get());
-      if (!s.ok()) {
-        DumpReplayStateToLog(state);
-        RETURN_NOT_OK_PREPEND(s, DebugInfo(tablet_->tablet_id(),
+  MonoTime replay_start = MonoTime::Now(MonoTime::FINE);
+  int64_t bytes_read = 0;
+  int segment_count = 0;
+  int entry_count = 0;
+  while (segment_count < segments.size()) {
+    unique_ptr<LogEntryReadAhead::Item> item;
+    if (PREDICT_FALSE(!read_ahead.Next(&item))) {
+      return Status::IllegalState("Log read-ahead stopped before the end of the log");
+    }
+    const scoped_refptr<ReadableLogSegment>& segment = segments[item->segment_idx];
+    DCHECK_EQ(segment_count, item->segment_idx);
+
+    if (PREDICT_FALSE(!item->status.ok())) {
+      return Status::Corruption(Substitute("Error reading Log Segment of tablet $0: $1 "
+                                           "(Read up to entry $2 of segment $3, in path $4)",
+                                           tablet_->tablet_id(),
+                                           item->status.ToString(),
+                                           entry_count,
                                            segment->header().sequence_number(),
-                                           entry_count, segment->path(),
-                                           *entry));
-      }
+                                           segment->path()));
+    }
 
-      // If HandleEntry returns OK, then it has taken ownership of the entry.
-      entry.release();
+    if (!item->entry) {
+      // TODO: could be more granular here and log during the segments as well,
+      // but this is better than nothing.
+      listener_->StatusMessage(Substitute("Bootstrap replayed $0/$1 log segments ($2). "
+                                          "Stats: $3. Pending: $4 replicates",
+                                          segment_count + 1, log_reader_->num_segments(),
+                                          HumanReadableNumBytes::ToString(bytes_read),
+                                          stats_.ToString(),
+                                          state.pending_replicates.size()));
+      segment_count++;
+      entry_count = 0;
+      continue;
+    }
+
+    entry_count++;
+    bytes_read += item->size_bytes;
+    if (entries_read_metric) {
+      entries_read_metric->Increment();
+      bytes_read_metric->IncrementBy(item->size_bytes);
+    }
+
+    Status s = HandleEntry(&state, item->entry.get());
+    if (!s.ok()) {
+      DumpReplayStateToLog(state);
+      RETURN_NOT_OK_PREPEND(s, DebugInfo(tablet_->tablet_id(),
+                                         segment->header().sequence_number(),
+                                         entry_count, segment->path(),
+                                         *item->entry));
     }
 
-    // TODO: could be more granular here and log during the segments as well,
-    // plus give info about number of MB processed, but this is better than
-    // nothing.
-    listener_->StatusMessage(Substitute("Bootstrap replayed $0/$1 log segments. "
-                                        "Stats: $2. Pending: $3 replicates",
-                                        segment_count + 1, log_reader_->num_segments(),
-                                        stats_.ToString(),
-                                        state.pending_replicates.size()));
-    segment_count++;
+    // If HandleEntry returns OK, then it has taken ownership of the entry.
+    item->entry.release();
+  }
+
+  MonoDelta replay_time = MonoTime::Now(MonoTime::FINE).GetDeltaSince(replay_start);
+  if (duration_metric) {
+    duration_metric->IncrementBy(replay_time.ToMilliseconds());
+  }
+  if (!segments.empty()) {
+    LOG_WITH_PREFIX(INFO) << "Replayed " << HumanReadableNumBytes::ToString(bytes_read)
+                          << " of log in " << replay_time.ToString() << " ("
+                          << HumanReadableNumBytes::ToString(
+                              static_cast<int64_t>(
+                                  bytes_read / std::max(replay_time.ToSeconds(), 0.001)))
+                          << "/s)";
   }
 
   // If we have non-applied commits they all must belong to pending operations and
@@ -1192,26 +1362,50 @@ Status TabletBootstrap::AppendCommitMsg(const CommitMsg& commit_msg) {
   return log_->Append(&commit_entry);
 }
 
-Status TabletBootstrap::DetermineFlushedOpsAndBuildResponse(const TxResultPB& result,
-                                                            vector<bool>* flushed_by_op,
-                                                            WriteResponsePB* response) {
+Status TabletBootstrap::DetermineFlushedOps(const TxResultPB& result,
+                                            vector<bool>* flushed_by_op) {
   int num_ops = result.ops_size();
   flushed_by_op->resize(num_ops);
 
   for (int i = 0; i < num_ops; i++) {
-    const auto& orig_op_result = result.ops(i);
-    if (orig_op_result.has_failed_status() && response) {
-      WriteResponsePB::PerRowErrorPB* error = response->add_per_row_errors();
-      error->set_row_index(i);
-      error->mutable_error()->CopyFrom(orig_op_result.failed_status());
-    }
     bool f;
-    RETURN_NOT_OK(FilterOperation(orig_op_result, &f));
+    RETURN_NOT_OK(FilterOperation(result.ops(i), &f));
     (*flushed_by_op)[i] = f;
   }
   return Status::OK();
 }
 
+void TabletBootstrap::RecordWriteResult(const rpc::RequestIdPB& request_id,
+                                        uint64_t timestamp,
+                                        const TxResultPB& result,
+                                        int first_op,
+                                        int num_ops) {
+  VLOG(1) << result_tracker_.get() << " Boostrapping request for tablet: "
+      << tablet_->tablet_id() << " id: " << request_id.DebugString();
+  // We only replay committed requests so the result of tracking this request can be:
+  // NEW - This is a previously untracked request, or we changed the driver -> store the result
+  // COMPLETED - We've bootstrapped this tablet twice, and previously stored the result -> do
+  //             nothing.
+  ResultTracker::RpcState state = result_tracker_->TrackRpcOrChangeDriver(request_id);
+  CHECK(state == ResultTracker::RpcState::NEW || state == ResultTracker::RpcState::COMPLETED)
+      << "Wrong state: " << state;
+  if (state != ResultTracker::NEW) {
+    return;
+  }
+
+  WriteResponsePB response;
+  response.set_timestamp(timestamp);
+  for (int i = 0; i < num_ops; i++) {
+    const auto& orig_op_result = result.ops(first_op + i);
+    if (orig_op_result.has_failed_status()) {
+      WriteResponsePB::PerRowErrorPB* error = response.add_per_row_errors();
+      error->set_row_index(i);
+      error->mutable_error()->CopyFrom(orig_op_result.failed_status());
+    }
+  }
+  result_tracker_->RecordCompletionAndRespond(request_id, &response);
+}
+
 Status TabletBootstrap::PlayWriteRequest(ReplicateMsg* replicate_msg,
                                          const CommitMsg& commit_msg) {
   // Prepare the commit entry for the rewritten log.
@@ -1229,30 +1423,38 @@ Status TabletBootstrap::PlayWriteRequest(ReplicateMsg* replicate_msg,
   WriteTransactionState tx_state(nullptr, write, nullptr);
   tx_state.mutable_op_id()->CopyFrom(replicate_msg->id());
   tx_state.set_timestamp(Timestamp(replicate_msg->timestamp()));
+  for (const consensus::CoalescedWritePB& coalesced : replicate_msg->coalesced_writes()) {
+    tx_state.AddCoalescedWrite(unique_ptr<WriteTransactionState>(
+        new WriteTransactionState(nullptr, &coalesced.write_request(), nullptr)));
+  }
 
   tablet_->StartTransaction(&tx_state);
   tablet_->StartApplying(&tx_state);
 
-  unique_ptr<WriteResponsePB> response;
-
-  bool tracking_results = result_tracker_.get() != nullptr && replicate_msg->has_request_id();
-
-  // If the results are being tracked and this write has a request id, register
-  // it with the result tracker.
-  ResultTracker::RpcState state;
-  if (tracking_results) {
-    VLOG(1) << result_tracker_.get() << " Boostrapping request for tablet: "
-        << write->tablet_id() << ". State: " << 0 << " id: "
-        << replicate_msg->request_id().DebugString();
-    // We only replay committed requests so the result of tracking this request can be:
-    // NEW - This is a previously untracked request, or we changed the driver -> store the result
-    // COMPLETED - We've bootstrapped this tablet twice, and previously stored the result -> do
-    //             nothing.
-    state = result_tracker_->TrackRpcOrChangeDriver(replicate_msg->request_id());
-    CHECK(state == ResultTracker::RpcState::NEW || state == ResultTracker::RpcState::COMPLETED)
-        << "Wrong state: " << state;
-    response.reset(new WriteResponsePB());
-    response->set_timestamp(replicate_msg->timestamp());
+  // If the results are being tracked, register the writes which have a request id with the
+  // result tracker. The row operations of the writes coalesced into this one follow its own.
+  const TxResultPB& result = commit_msg.result();
+  if (result_tracker_.get() != nullptr) {
+    int num_ops = result.ops_size();
+    for (const consensus::CoalescedWritePB& coalesced : replicate_msg->coalesced_writes()) {
+      num_ops -= coalesced.num_row_ops();
+    }
+    if (PREDICT_FALSE(num_ops < 0)) {
+      return Status::Corruption(Substitute("Commit for op $0 has fewer results than the "
+                                           "row operations of its coalesced writes",
+                                           replicate_msg->id().ShortDebugString()));
+    }
+    if (replicate_msg->has_request_id()) {
+      RecordWriteResult(replicate_msg->request_id(), replicate_msg->timestamp(), result,
+                        0, num_ops);
+    }
+    for (const consensus::CoalescedWritePB& coalesced : replicate_msg->coalesced_writes()) {
+      if (coalesced.has_request_id()) {
+        RecordWriteResult(coalesced.request_id(), replicate_msg->timestamp(), result,
+                          num_ops, coalesced.num_row_ops());
+      }
+      num_ops += coalesced.num_row_ops();
+    }
   }
 
   // Determine which of the operations are already flushed to persistent
@@ -1260,13 +1462,7 @@ Status TabletBootstrap::PlayWriteRequest(ReplicateMsg* replicate_msg,
   // we decode any row operations, so we can short-circuit that decoding
   // in the case that the entire op has been already flushed.
   vector<bool> already_flushed;
-  RETURN_NOT_OK(DetermineFlushedOpsAndBuildResponse(commit_msg.result(),
-                                                    &already_flushed,
-                                                    response.get()));
-
-  if (tracking_results && state == ResultTracker::NEW) {
-    result_tracker_->RecordCompletionAndRespond(replicate_msg->request_id(), response.get());
-  }
+  RETURN_NOT_OK(DetermineFlushedOps(result, &already_flushed));
 
   bool all_already_flushed = std::all_of(already_flushed.begin(),
                                          already_flushed.end(),
@@ -1278,7 +1474,7 @@ Status TabletBootstrap::PlayWriteRequest(ReplicateMsg* replicate_msg,
       op.set_flushed(true);
     }
   } else {
-    if (write->has_row_operations()) {
+    if (write->has_row_operations() || replicate_msg->coalesced_writes_size() > 0) {
       // TODO: get rid of redundant params below - they can be gotten from the Request
       RETURN_NOT_OK(PlayRowOperations(&tx_state,
                                       write->schema(),
@@ -1314,6 +1510,9 @@ Status TabletBootstrap::PlayAlterSchemaRequest(ReplicateMsg* replicate_msg,
 
   // Apply the alter schema to the tablet
   RETURN_NOT_OK_PREPEND(tablet_->AlterSchema(&tx_state), "Failed to AlterSchema:");
+  tx_state.ReleaseSchemaLock();
+  RETURN_NOT_OK_PREPEND(tablet_->FlushPreAlterMemRowSet(),
+                        "Failed to flush the MemRowSet replaced by AlterSchema:");
 
   // Also update the log information. Normally, the AlterSchema() call above
   // takes care of this, but our new log isn't hooked up to the tablet yet.
@@ -1365,6 +1564,15 @@ Status TabletBootstrap::PlayRowOperations(WriteTransactionState* tx_state,
   RETURN_NOT_OK_PREPEND(tablet_->DecodeWriteOperations(&inserts_schema, tx_state),
                         Substitute("Could not decode row operations: $0",
                                    ops_pb.ShortDebugString()));
+  for (const auto& write : tx_state->coalesced_writes()) {
+    Schema write_schema;
+    RETURN_NOT_OK_PREPEND(SchemaFromPB(write->request()->schema(), &write_schema),
+                          "Couldn't decode client schema");
+    RETURN_NOT_OK_PREPEND(
+        tablet_->DecodeCoalescedWriteOperations(&write_schema, write.get(), tx_state),
+        Substitute("Could not decode row operations: $0",
+                   write->request()->row_operations().ShortDebugString()));
+  }
   DCHECK_EQ(tx_state->row_ops().size(), already_flushed.size());
 
   // Propagate the 'already_flushed' information into the decoded operations.
@@ -0,0 +1,137 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+#include <vector>
+
+#include "kudu/common/partial_row.h"
+#include "kudu/common/row.h"
+#include "kudu/tablet/local_tablet_writer.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet-test-util.h"
+#include "kudu/util/test_macros.h"
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+class TestTabletBulkLoad : public KuduTabletTest {
+ public:
+  TestTabletBulkLoad()
+    : KuduTabletTest(Schema({ ColumnSchema("key", INT32),
+                              ColumnSchema("val", INT32) }, 1)) {
+  }
+
+ protected:
+  // Encode rows with the given keys into 'row_data', and point 'rows' at them.
+  void BuildRows(const vector<int32_t>& keys,
+                 vector<string>* row_data,
+                 vector<ConstContiguousRow>* rows) {
+    RowBuilder rb(schema_);
+    row_data->clear();
+    for (int32_t key : keys) {
+      rb.Reset();
+      rb.AddInt32(key);
+      rb.AddInt32(key * 10);
+      row_data->push_back(rb.data().ToString());
+    }
+    rows->clear();
+    for (const string& data : *row_data) {
+      rows->push_back(ConstContiguousRow(&schema_, Slice(data)));
+    }
+  }
+
+  Status InsertRow(int32_t key) {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow row(&client_schema_);
+    CHECK_OK(row.SetInt32(0, key));
+    CHECK_OK(row.SetInt32(1, key * 10));
+    return writer.Insert(row);
+  }
+};
+
+TEST_F(TestTabletBulkLoad, TestLoadIntoEmptyRanges) {
+  vector<string> row_data;
+  vector<ConstContiguousRow> rows;
+  MvccSnapshot before_load(*tablet()->mvcc_manager());
+
+  vector<int32_t> keys;
+  for (int32_t i = 0; i < 1000; i++) {
+    keys.push_back(i * 2);
+  }
+  BuildRows(keys, &row_data, &rows);
+  ASSERT_OK(tablet()->BulkLoadSortedRows(rows));
+  ASSERT_TRUE(tablet()->MemRowSetEmpty());
+
+  uint64_t count;
+  ASSERT_OK(tablet()->CountRows(&count));
+  ASSERT_EQ(1000, count);
+
+  // The loaded rows behave like any other rows.
+  ASSERT_TRUE(InsertRow(10).IsAlreadyPresent());
+  vector<string> dumped;
+  ASSERT_OK(DumpTablet(*tablet(), client_schema_, &dumped));
+  ASSERT_EQ(1000, dumped.size());
+
+  // Snapshots taken before the load do not see the rows.
+  gscoped_ptr<RowwiseIterator> iter;
+  ASSERT_OK(tablet()->NewRowIterator(client_schema_, before_load, Tablet::UNORDERED, &iter));
+  ASSERT_OK(iter->Init(nullptr));
+  vector<string> old_rows;
+  ASSERT_OK(IterateToStringList(iter.get(), &old_rows));
+  ASSERT_TRUE(old_rows.empty());
+
+  // A second run above the first one is accepted.
+  BuildRows({ 5000, 5001, 5002 }, &row_data, &rows);
+  ASSERT_OK(tablet()->BulkLoadSortedRows(rows));
+  ASSERT_OK(tablet()->CountRows(&count));
+  ASSERT_EQ(1003, count);
+}
+
+TEST_F(TestTabletBulkLoad, TestRejectsInvalidInput) {
+  vector<string> row_data;
+  vector<ConstContiguousRow> rows;
+
+  // Unsorted and duplicate keys.
+  BuildRows({ 1, 3, 2 }, &row_data, &rows);
+  ASSERT_TRUE(tablet()->BulkLoadSortedRows(rows).IsInvalidArgument());
+  BuildRows({ 1, 1 }, &row_data, &rows);
+  ASSERT_TRUE(tablet()->BulkLoadSortedRows(rows).IsInvalidArgument());
+
+  // A range overlapping a key in the MemRowSet.
+  ASSERT_OK(InsertRow(50));
+  BuildRows({ 40, 60 }, &row_data, &rows);
+  ASSERT_TRUE(tablet()->BulkLoadSortedRows(rows).IsIllegalState());
+
+  // A range next to it is fine.
+  BuildRows({ 51, 60 }, &row_data, &rows);
+  ASSERT_OK(tablet()->BulkLoadSortedRows(rows));
+
+  // A range overlapping a flushed rowset, even in a gap between its keys.
+  ASSERT_OK(tablet()->Flush());
+  BuildRows({ 55 }, &row_data, &rows);
+  ASSERT_TRUE(tablet()->BulkLoadSortedRows(rows).IsIllegalState());
+
+  uint64_t count;
+  ASSERT_OK(tablet()->CountRows(&count));
+  ASSERT_EQ(3, count);
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -0,0 +1,136 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <vector>
+
+#include "kudu/fs/block_manager.h"
+#include "kudu/gutil/casts.h"
+#include "kudu/server/hybrid_clock.h"
+#include "kudu/tablet/rowset_metadata.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_metadata.h"
+#include "kudu/tablet/tablet_mm_ops.h"
+#include "kudu/tablet/tablet-test-base.h"
+#include "kudu/util/maintenance_manager.h"
+
+DECLARE_bool(use_mock_wall_clock);
+DECLARE_int32(tablet_history_max_age_sec);
+
+using std::shared_ptr;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+class TabletHistoryGcTest : public TabletTestBase<IntKeyTestSetup<INT64>> {
+ public:
+  typedef TabletTestBase<IntKeyTestSetup<INT64>> Superclass;
+
+  TabletHistoryGcTest()
+      : Superclass(TabletHarness::Options::HYBRID_CLOCK),
+        mock_now_usec_(0) {
+    FLAGS_use_mock_wall_clock = true;
+  }
+
+  virtual void SetUp() OVERRIDE {
+    FLAGS_tablet_history_max_age_sec = 100;
+    Superclass::SetUp();
+  }
+
+ protected:
+  void AdvanceClockSeconds(int64_t secs) {
+    mock_now_usec_ += secs * 1000000L;
+    down_cast<server::HybridClock*>(clock())->SetMockClockWallTimeForTests(mock_now_usec_);
+  }
+
+  // Returns the UNDO delta blocks of the tablet's only rowset.
+  vector<BlockId> UndoBlocksOfOnlyRowSet() {
+    vector<shared_ptr<RowSet>> rowsets;
+    tablet()->GetRowSetsForTests(&rowsets);
+    CHECK_EQ(1, rowsets.size());
+    return rowsets[0]->metadata()->undo_delta_blocks();
+  }
+
+  uint64_t mock_now_usec_;
+};
+
+// UNDO delta blocks become eligible for GC, and are deleted, only once they
+// fall entirely out of the history retention window.
+TEST_F(TabletHistoryGcTest, TestUndoDeltaBlockGc) {
+  AdvanceClockSeconds(1);
+  NO_FATALS(InsertTestRows(0, 100, 0));
+  ASSERT_OK(tablet()->Flush());
+
+  vector<BlockId> undo_blocks = UndoBlocksOfOnlyRowSet();
+  ASSERT_EQ(1, undo_blocks.size());
+
+  // Still within the retention window: nothing to do.
+  int64_t blocks_deleted = 0;
+  int64_t bytes_deleted = 0;
+  ASSERT_OK(tablet()->DeleteAncientUndoDeltas(&blocks_deleted, &bytes_deleted));
+  ASSERT_EQ(0, blocks_deleted);
+  ASSERT_EQ(0, bytes_deleted);
+  ASSERT_EQ(0, tablet()->EstimateBytesInPotentiallyAncientUndoDeltas());
+  ASSERT_EQ(1, UndoBlocksOfOnlyRowSet().size());
+
+  // Move past the retention window; the op should now want to run.
+  AdvanceClockSeconds(200);
+  ASSERT_GT(tablet()->EstimateBytesInPotentiallyAncientUndoDeltas(), 0);
+  UndoDeltaBlockGCOp op(tablet());
+  MaintenanceOpStats stats;
+  op.UpdateStats(&stats);
+  ASSERT_TRUE(stats.runnable());
+  ASSERT_GT(stats.data_retained_bytes(), 0);
+
+  ASSERT_OK(tablet()->DeleteAncientUndoDeltas(&blocks_deleted, &bytes_deleted));
+  ASSERT_EQ(1, blocks_deleted);
+  ASSERT_GT(bytes_deleted, 0);
+  ASSERT_TRUE(UndoBlocksOfOnlyRowSet().empty());
+  ASSERT_EQ(0, tablet()->EstimateBytesInPotentiallyAncientUndoDeltas());
+
+  // The orphaned block is deleted when the tablet metadata is flushed.
+  gscoped_ptr<fs::ReadableBlock> block;
+  ASSERT_TRUE(fs_manager()->OpenBlock(undo_blocks[0], &block).IsNotFound());
+
+  // Current data is untouched.
+  NO_FATALS(VerifyTestRows(0, 100));
+}
+
+// A per-table retention overrides the server-wide default.
+TEST_F(TabletHistoryGcTest, TestPerTableHistoryMaxAge) {
+  tablet()->metadata()->set_history_max_age_sec(1000);
+  ASSERT_EQ(1000, tablet()->HistoryMaxAge().ToSeconds());
+
+  AdvanceClockSeconds(1);
+  NO_FATALS(InsertTestRows(0, 100, 0));
+  ASSERT_OK(tablet()->Flush());
+
+  AdvanceClockSeconds(200);
+  ASSERT_EQ(0, tablet()->EstimateBytesInPotentiallyAncientUndoDeltas());
+  int64_t blocks_deleted = 0;
+  int64_t bytes_deleted = 0;
+  ASSERT_OK(tablet()->DeleteAncientUndoDeltas(&blocks_deleted, &bytes_deleted));
+  ASSERT_EQ(0, blocks_deleted);
+  ASSERT_EQ(1, UndoBlocksOfOnlyRowSet().size());
+}
+
+} // namespace tablet
+} // namespace kudu
@@ -226,8 +226,15 @@ TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id,
       table_name_(std::move(table_name)),
       partition_schema_(std::move(partition_schema)),
       tablet_data_state_(tablet_data_state),
+      compaction_policy_(UNKNOWN_COMPACTION_POLICY),
+      history_max_age_sec_(-1),
+      row_ttl_column_id_(-1),
+      row_ttl_sec_(-1),
+      pin_key_index_(false),
       tombstone_last_logged_opid_(MinimumOpId()),
       num_flush_pins_(0),
+      flush_request_seqno_(0),
+      flushed_seqno_(0),
       needs_flush_(false),
       pre_flush_callback_(Bind(DoNothingStatusClosure)) {
   CHECK(schema_->has_column_ids());
@@ -245,8 +252,15 @@ TabletMetadata::TabletMetadata(FsManager* fs_manager, string tablet_id)
       fs_manager_(fs_manager),
       next_rowset_idx_(0),
       schema_(nullptr),
+      compaction_policy_(UNKNOWN_COMPACTION_POLICY),
+      history_max_age_sec_(-1),
+      row_ttl_column_id_(-1),
+      row_ttl_sec_(-1),
+      pin_key_index_(false),
       tombstone_last_logged_opid_(MinimumOpId()),
       num_flush_pins_(0),
+      flush_request_seqno_(0),
+      flushed_seqno_(0),
       needs_flush_(false),
       pre_flush_callback_(Bind(DoNothingStatusClosure)) {}
 
@@ -284,6 +298,17 @@ Status TabletMetadata::LoadFromSuperBlock(const TabletSuperBlockPB& superblock)
     last_durable_mrs_id_ = superblock.last_durable_mrs_id();
 
     table_name_ = superblock.table_name();
+    compaction_policy_ = superblock.compaction_policy();
+    history_max_age_sec_ = superblock.has_history_max_age_sec() ?
+        superblock.history_max_age_sec() : -1;
+    if (superblock.has_row_ttl()) {
+      row_ttl_column_id_ = ColumnId(superblock.row_ttl().column_id());
+      row_ttl_sec_ = superblock.row_ttl().ttl_sec();
+    } else {
+      row_ttl_column_id_ = ColumnId(-1);
+      row_ttl_sec_ = -1;
+    }
+    pin_key_index_ = superblock.pin_key_index();
 
     uint32_t schema_version = superblock.schema_version();
     gscoped_ptr<Schema> schema(new Schema());
@@ -347,9 +372,16 @@ Status TabletMetadata::LoadFromSuperBlock(const TabletSuperBlockPB& superblock)
 Status TabletMetadata::UpdateAndFlush(const RowSetMetadataIds& to_remove,
                                       const RowSetMetadataVector& to_add,
                                       int64_t last_durable_mrs_id) {
+  return UpdateAndFlush(to_remove, to_add, RowSetLiveRanges(), last_durable_mrs_id);
+}
+
+Status TabletMetadata::UpdateAndFlush(const RowSetMetadataIds& to_remove,
+                                      const RowSetMetadataVector& to_add,
+                                      const RowSetLiveRanges& to_narrow,
+                                      int64_t last_durable_mrs_id) {
   {
     std::lock_guard<LockType> l(data_lock_);
-    RETURN_NOT_OK(UpdateUnlocked(to_remove, to_add, last_durable_mrs_id));
+    RETURN_NOT_OK(UpdateUnlocked(to_remove, to_add, to_narrow, last_durable_mrs_id));
   }
   return Flush();
 }
@@ -417,11 +449,26 @@ Status TabletMetadata::Flush() {
   TRACE_EVENT1("tablet", "TabletMetadata::Flush",
                "tablet_id", tablet_id_);
 
+  int64_t request_seqno;
+  {
+    std::lock_guard<LockType> l(data_lock_);
+    request_seqno = ++flush_request_seqno_;
+  }
+
   MutexLock l_flush(flush_lock_);
   vector<BlockId> orphaned;
   TabletSuperBlockPB pb;
+  int64_t snapshot_seqno;
   {
     std::lock_guard<LockType> l(data_lock_);
+    // If a flush which started after this one was requested already wrote
+    // the superblock, it included all the changes this one was meant to
+    // persist: concurrent flushes, e.g. of the MRS and of a DMS, are
+    // coalesced into a single write.
+    if (flushed_seqno_ >= request_seqno) {
+      TRACE("Metadata already flushed by a concurrent flush");
+      return Status::OK();
+    }
     CHECK_GE(num_flush_pins_, 0);
     if (num_flush_pins_ > 0) {
       needs_flush_ = true;
@@ -439,10 +486,15 @@ Status TabletMetadata::Flush() {
     // want to accidentally delete those blocks before that next metadata update
     // is persisted. See KUDU-701 for details.
     orphaned.assign(orphaned_blocks_.begin(), orphaned_blocks_.end());
+    snapshot_seqno = flush_request_seqno_;
   }
   pre_flush_callback_.Run();
   RETURN_NOT_OK(ReplaceSuperBlockUnlocked(pb));
   TRACE("Metadata flushed");
+  {
+    std::lock_guard<LockType> l(data_lock_);
+    flushed_seqno_ = snapshot_seqno;
+  }
   l_flush.Unlock();
 
   // Now that the superblock is written, try to delete the orphaned blocks.
@@ -457,6 +509,7 @@ Status TabletMetadata::Flush() {
 Status TabletMetadata::UpdateUnlocked(
     const RowSetMetadataIds& to_remove,
     const RowSetMetadataVector& to_add,
+    const RowSetLiveRanges& to_narrow,
     int64_t last_durable_mrs_id) {
   DCHECK(data_lock_.is_locked());
   CHECK_NE(state_, kNotLoadedYet);
@@ -472,6 +525,12 @@ Status TabletMetadata::UpdateUnlocked(
       AddOrphanedBlocksUnlocked((*it)->GetAllBlocks());
       it = new_rowsets.erase(it);
     } else {
+      const RowSetLiveRange* live_range = FindOrNull(to_narrow, (*it)->id());
+      if (live_range) {
+        // Narrowing happens under 'data_lock_' so that no superblock can be
+        // written with the new rowsets but without the narrowed ones.
+        (*it)->SetLiveRange(*live_range);
+      }
       it++;
     }
   }
@@ -535,6 +594,19 @@ Status TabletMetadata::ToSuperBlockUnlocked(TabletSuperBlockPB* super_block,
   pb.set_schema_version(schema_version_);
   partition_schema_.ToPB(pb.mutable_partition_schema());
   pb.set_table_name(table_name_);
+  if (compaction_policy_ != UNKNOWN_COMPACTION_POLICY) {
+    pb.set_compaction_policy(compaction_policy_);
+  }
+  if (history_max_age_sec_ >= 0) {
+    pb.set_history_max_age_sec(history_max_age_sec_);
+  }
+  if (row_ttl_sec_ >= 0) {
+    pb.mutable_row_ttl()->set_column_id(row_ttl_column_id_);
+    pb.mutable_row_ttl()->set_ttl_sec(row_ttl_sec_);
+  }
+  if (pin_key_index_) {
+    pb.set_pin_key_index(true);
+  }
 
   for (const shared_ptr<RowSetMetadata>& meta : rowsets) {
     meta->ToProtobuf(pb.add_rowsets());
@@ -616,6 +688,56 @@ string TabletMetadata::table_name() const {
   return table_name_;
 }
 
+CompactionPolicyPB TabletMetadata::compaction_policy() const {
+  std::lock_guard<LockType> l(data_lock_);
+  DCHECK_NE(state_, kNotLoadedYet);
+  return compaction_policy_;
+}
+
+void TabletMetadata::set_compaction_policy(CompactionPolicyPB policy) {
+  std::lock_guard<LockType> l(data_lock_);
+  compaction_policy_ = policy;
+}
+
+int32_t TabletMetadata::history_max_age_sec() const {
+  std::lock_guard<LockType> l(data_lock_);
+  DCHECK_NE(state_, kNotLoadedYet);
+  return history_max_age_sec_;
+}
+
+void TabletMetadata::set_history_max_age_sec(int32_t history_max_age_sec) {
+  std::lock_guard<LockType> l(data_lock_);
+  history_max_age_sec_ = history_max_age_sec;
+}
+
+bool TabletMetadata::GetRowTtl(ColumnId* col_id, int32_t* ttl_sec) const {
+  std::lock_guard<LockType> l(data_lock_);
+  DCHECK_NE(state_, kNotLoadedYet);
+  if (row_ttl_sec_ < 0) {
+    return false;
+  }
+  *col_id = row_ttl_column_id_;
+  *ttl_sec = row_ttl_sec_;
+  return true;
+}
+
+void TabletMetadata::set_row_ttl(ColumnId col_id, int32_t ttl_sec) {
+  std::lock_guard<LockType> l(data_lock_);
+  row_ttl_column_id_ = col_id;
+  row_ttl_sec_ = ttl_sec;
+}
+
+bool TabletMetadata::pin_key_index() const {
+  std::lock_guard<LockType> l(data_lock_);
+  DCHECK_NE(state_, kNotLoadedYet);
+  return pin_key_index_;
+}
+
+void TabletMetadata::set_pin_key_index(bool pin_key_index) {
+  std::lock_guard<LockType> l(data_lock_);
+  pin_key_index_ = pin_key_index;
+}
+
 uint32_t TabletMetadata::schema_version() const {
   std::lock_guard<LockType> l(data_lock_);
   DCHECK_NE(state_, kNotLoadedYet);
@@ -20,6 +20,7 @@
 #include <boost/optional/optional_fwd.hpp>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -46,6 +47,19 @@ class RowSetMetadataUpdate;
 typedef std::vector<std::shared_ptr<RowSetMetadata> > RowSetMetadataVector;
 typedef std::unordered_set<int64_t> RowSetMetadataIds;
 
+// The rows of a disk rowset which remain visible after a range-sliced
+// compaction moved the others into new rowsets: those with ordinals in
+// [begin_row, end_row), whose keys lie within [min_encoded_key, max_encoded_key].
+struct RowSetLiveRange {
+  uint32_t begin_row;
+  uint32_t end_row;
+  std::string min_encoded_key;
+  std::string max_encoded_key;
+};
+
+// Live ranges to set, keyed by rowset ID.
+typedef std::unordered_map<int64_t, RowSetLiveRange> RowSetLiveRanges;
+
 extern const int64 kNoDurableMemStore;
 
 // Manages the "blocks tracking" for the specified tablet.
@@ -118,6 +132,32 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
 
   void SetTableName(const std::string& table_name);
 
+  // The compaction policy chosen for the table, or UNKNOWN_COMPACTION_POLICY
+  // if the tablet server's default applies. Persisted on the next Flush().
+  CompactionPolicyPB compaction_policy() const;
+
+  void set_compaction_policy(CompactionPolicyPB policy);
+
+  // The history retention, in seconds, chosen for the table, or -1 if the
+  // tablet server's default applies. Persisted on the next Flush().
+  int32_t history_max_age_sec() const;
+
+  void set_history_max_age_sec(int32_t history_max_age_sec);
+
+  // Sets '*col_id' and '*ttl_sec' to the TTL column and the time-to-live
+  // chosen for the rows of the table and returns true, or returns false if
+  // its rows don't expire.
+  bool GetRowTtl(ColumnId* col_id, int32_t* ttl_sec) const;
+
+  // Persisted on the next Flush().
+  void set_row_ttl(ColumnId col_id, int32_t ttl_sec);
+
+  // Whether the table asked for the key indexes and bloom filter indexes of
+  // its rowsets to be pinned in memory. Persisted on the next Flush().
+  bool pin_key_index() const;
+
+  void set_pin_key_index(bool pin_key_index);
+
   // Return a reference to the current schema.
   // This pointer will be valid until the TabletMetadata is destructed,
   // even if the schema is changed.
@@ -155,10 +195,15 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // 3. Adds orphaned blocks from 'to_remove'.
   // 4. Updates the last durable MRS ID from 'last_durable_mrs_id',
   //    assuming it's not kNoMrsFlushed.
+  // 5. Narrows the rowsets in 'to_narrow' to their new live ranges.
   static const int64_t kNoMrsFlushed = -1;
   Status UpdateAndFlush(const RowSetMetadataIds& to_remove,
                         const RowSetMetadataVector& to_add,
                         int64_t last_durable_mrs_id);
+  Status UpdateAndFlush(const RowSetMetadataIds& to_remove,
+                        const RowSetMetadataVector& to_add,
+                        const RowSetLiveRanges& to_narrow,
+                        int64_t last_durable_mrs_id);
 
   // Adds the blocks referenced by 'block_ids' to 'orphaned_blocks_'.
   //
@@ -259,6 +304,7 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // Requires 'data_lock_'.
   Status UpdateUnlocked(const RowSetMetadataIds& to_remove,
                         const RowSetMetadataVector& to_add,
+                        const RowSetLiveRanges& to_narrow,
                         int64_t last_durable_mrs_id);
 
   // Requires 'data_lock_'.
@@ -326,6 +372,20 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // The current state of tablet copy for the tablet.
   TabletDataState tablet_data_state_;
 
+  // Protected by 'data_lock_'.
+  CompactionPolicyPB compaction_policy_;
+
+  // Protected by 'data_lock_'.
+  int32_t history_max_age_sec_;
+
+  // The TTL column and the time-to-live of the rows, or -1 if they don't
+  // expire. Protected by 'data_lock_'.
+  ColumnId row_ttl_column_id_;
+  int32_t row_ttl_sec_;
+
+  // Protected by 'data_lock_'.
+  bool pin_key_index_;
+
   // Record of the last opid logged by the tablet before it was last
   // tombstoned. Has no meaning for non-tombstoned tablets.
   consensus::OpId tombstone_last_logged_opid_;
@@ -334,6 +394,12 @@ class TabletMetadata : public RefCountedThreadSafe<TabletMetadata> {
   // disk.
   int32_t num_flush_pins_;
 
+  // The number of calls to Flush() so far, and the number of those whose
+  // changes were included in the last superblock written. Protected by
+  // 'data_lock_'.
+  int64_t flush_request_seqno_;
+  int64_t flushed_seqno_;
+
   // Set if Flush() is called when num_flush_pins_ is > 0; if true,
   // then next UnPinFlush will call Flush() again to ensure the
   // metadata is persisted.
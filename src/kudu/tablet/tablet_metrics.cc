@@ -20,6 +20,7 @@
 #include <map>
 #include <utility>
 
+#include "kudu/cfile/cfile.pb.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/util/memory/arena.h"
 #include "kudu/util/metrics.h"
@@ -94,6 +95,11 @@ METRIC_DEFINE_counter(tablet, insertions_failed_dup_key, "Duplicate Key Inserts"
 METRIC_DEFINE_counter(tablet, scans_started, "Scans Started",
                       kudu::MetricUnit::kScanners,
                       "Number of scanners which have been started on this tablet");
+METRIC_DEFINE_counter(tablet, scanner_rowsets_pruned, "Scanner RowSets Pruned",
+                      kudu::MetricUnit::kUnits,
+                      "Number of rowsets skipped by scans because the zone maps of "
+                      "their columns showed that none of their rows could satisfy "
+                      "the scans' predicates");
 
 METRIC_DEFINE_counter(tablet, bloom_lookups, "Bloom Filter Lookups",
                       kudu::MetricUnit::kProbes,
@@ -110,6 +116,25 @@ METRIC_DEFINE_counter(tablet, mrs_lookups, "MemRowSet Lookups",
 METRIC_DEFINE_counter(tablet, bytes_flushed, "Bytes Flushed",
                       kudu::MetricUnit::kBytes,
                       "Amount of data that has been flushed to disk by this tablet.");
+METRIC_DEFINE_counter(tablet, dict_encoding_code_word_blocks_flushed,
+                      "Dictionary Encoded Blocks Flushed",
+                      kudu::MetricUnit::kBlocks,
+                      "Number of data blocks of dictionary encoded columns that have been "
+                      "written as dictionary code words by flushes and compactions.");
+METRIC_DEFINE_counter(tablet, dict_encoding_fallback_blocks_flushed,
+                      "Dictionary Encoding Fallback Blocks Flushed",
+                      kudu::MetricUnit::kBlocks,
+                      "Number of data blocks of dictionary encoded columns that have been "
+                      "written with plain encoding by flushes and compactions, because "
+                      "the dictionary of their file was full. A high ratio to "
+                      "dict_encoding_code_word_blocks_flushed indicates that the column "
+                      "has too many distinct values for dictionary encoding.");
+METRIC_DEFINE_counter(tablet, dict_encoding_fallback_cells_flushed,
+                      "Dictionary Encoding Fallback Cells Flushed",
+                      kudu::MetricUnit::kCells,
+                      "Number of cells of dictionary encoded columns that have been written "
+                      "with plain encoding by flushes and compactions, because the "
+                      "dictionary of their file was full.");
 
 METRIC_DEFINE_histogram(tablet, bloom_lookups_per_op, "Bloom Lookups per Operation",
                         kudu::MetricUnit::kProbes,
@@ -145,6 +170,75 @@ METRIC_DEFINE_histogram(tablet, write_op_duration_commit_wait_consistency,
   "Duration of writes to this tablet with external consistency set to COMMIT_WAIT.",
   60000000LU, 2);
 
+METRIC_DEFINE_histogram(tablet, write_op_prepare_queue_duration,
+  "Write Op Prepare Queue Time",
+  kudu::MetricUnit::kMicroseconds,
+  "Time leader writes to this tablet spent waiting to be prepared.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_op_prepare_duration,
+  "Write Op Prepare Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent preparing leader writes to this tablet, which includes decoding their "
+  "operations and acquiring their row locks.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_op_row_lock_duration,
+  "Write Op Row Lock Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent acquiring the row locks of leader writes to this tablet.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_op_replication_duration,
+  "Write Op Replication Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent replicating leader writes to this tablet, from their submission to "
+  "consensus until a majority of replicas had appended them to their WALs.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_op_apply_duration,
+  "Write Op Apply Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent applying leader writes to the rowsets of this tablet.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, write_op_mvcc_commit_duration,
+  "Write Op MVCC Commit Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent committing leader writes to this tablet in MVCC and releasing their locks.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, scanner_iterator_init_duration,
+  "Scanner Iterator Init Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time spent creating and initializing the iterators of new scans of this tablet.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, scanner_decode_duration,
+  "Scanner Decode Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time each scan request to this tablet spent decoding columns read from disk.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, scanner_delta_apply_duration,
+  "Scanner Delta Apply Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time each scan request to this tablet spent applying deltas to the rows it read.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, scanner_predicate_eval_duration,
+  "Scanner Predicate Evaluation Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time each scan request to this tablet spent evaluating predicates outside of the "
+  "block decoders.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, scanner_serialize_duration,
+  "Scanner Serialize Duration",
+  kudu::MetricUnit::kMicroseconds,
+  "Time each scan request to this tablet spent serializing the rows it returns.",
+  60000000LU, 2);
+
 METRIC_DEFINE_histogram(tablet, commit_wait_duration,
   "Commit-Wait Duration",
   kudu::MetricUnit::kMicroseconds,
@@ -182,6 +276,21 @@ METRIC_DEFINE_gauge_uint32(tablet, delta_major_compact_rs_running,
   kudu::MetricUnit::kMaintenanceOperations,
   "Number of delta major compactions currently running.");
 
+METRIC_DEFINE_gauge_uint32(tablet, undo_delta_block_gc_running,
+  "Undo Delta Block GC Running",
+  kudu::MetricUnit::kMaintenanceOperations,
+  "Number of UNDO delta block GC operations currently running.");
+
+METRIC_DEFINE_gauge_uint32(tablet, reencode_columns_running,
+  "Column Re-encodings Running",
+  kudu::MetricUnit::kMaintenanceOperations,
+  "Number of column re-encodings currently running.");
+
+METRIC_DEFINE_gauge_uint32(tablet, expired_rowset_gc_running,
+  "Expired RowSet GC Running",
+  kudu::MetricUnit::kMaintenanceOperations,
+  "Number of expired rowset GC operations currently running.");
+
 METRIC_DEFINE_histogram(tablet, flush_dms_duration,
   "DeltaMemStore Flush Duration",
   kudu::MetricUnit::kMilliseconds,
@@ -207,10 +316,49 @@ METRIC_DEFINE_histogram(tablet, delta_major_compact_rs_duration,
   kudu::MetricUnit::kSeconds,
   "Seconds spent major delta compacting.", 60000000LU, 2);
 
+METRIC_DEFINE_histogram(tablet, undo_delta_block_gc_duration,
+  "Undo Delta Block GC Duration",
+  kudu::MetricUnit::kMilliseconds,
+  "Time spent deleting ancient UNDO delta blocks.", 60000LU, 1);
+
+METRIC_DEFINE_histogram(tablet, reencode_columns_duration,
+  "Column Re-encoding Duration",
+  kudu::MetricUnit::kSeconds,
+  "Seconds spent rewriting columns with their altered storage attributes.",
+  60000000LU, 2);
+
+METRIC_DEFINE_histogram(tablet, expired_rowset_gc_duration,
+  "Expired RowSet GC Duration",
+  kudu::MetricUnit::kMilliseconds,
+  "Time spent looking for and deleting rowsets whose rows have all expired.",
+  60000LU, 1);
+
+METRIC_DEFINE_counter(tablet, undo_delta_blocks_deleted,
+  "Undo Delta Blocks Deleted",
+  kudu::MetricUnit::kBlocks,
+  "Number of UNDO delta blocks deleted because they held only history older "
+  "than the tablet's history retention.");
+
+METRIC_DEFINE_counter(tablet, undo_delta_block_bytes_deleted,
+  "Undo Delta Block Bytes Deleted",
+  kudu::MetricUnit::kBytes,
+  "Bytes of UNDO delta blocks deleted because they held only history older "
+  "than the tablet's history retention.");
+
+METRIC_DEFINE_counter(tablet, expired_rowsets_deleted,
+  "Expired RowSets Deleted",
+  kudu::MetricUnit::kUnits,
+  "Number of rowsets deleted because all of their rows had outlived the "
+  "table's row TTL.");
+
 METRIC_DEFINE_counter(tablet, leader_memory_pressure_rejections,
   "Leader Memory Pressure Rejections",
   kudu::MetricUnit::kRequests,
   "Number of RPC requests rejected due to memory pressure while LEADER.");
+METRIC_DEFINE_counter(tablet, leader_memory_pressure_delays,
+  "Leader Memory Pressure Delays",
+  kudu::MetricUnit::kRequests,
+  "Number of RPC requests delayed due to memory pressure while LEADER.");
 
 using strings::Substitute;
 using std::unordered_map;
@@ -234,11 +382,15 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(scanner_cells_scanned_from_disk),
     MINIT(scanner_bytes_scanned_from_disk),
     MINIT(scans_started),
+    MINIT(scanner_rowsets_pruned),
     MINIT(bloom_lookups),
     MINIT(key_file_lookups),
     MINIT(delta_file_lookups),
     MINIT(mrs_lookups),
     MINIT(bytes_flushed),
+    MINIT(dict_encoding_code_word_blocks_flushed),
+    MINIT(dict_encoding_fallback_blocks_flushed),
+    MINIT(dict_encoding_fallback_cells_flushed),
     MINIT(bloom_lookups_per_op),
     MINIT(key_file_lookups_per_op),
     MINIT(delta_file_lookups_per_op),
@@ -246,21 +398,48 @@ TabletMetrics::TabletMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(snapshot_read_inflight_wait_duration),
     MINIT(write_op_duration_client_propagated_consistency),
     MINIT(write_op_duration_commit_wait_consistency),
+    MINIT(write_op_prepare_queue_duration),
+    MINIT(write_op_prepare_duration),
+    MINIT(write_op_row_lock_duration),
+    MINIT(write_op_replication_duration),
+    MINIT(write_op_apply_duration),
+    MINIT(write_op_mvcc_commit_duration),
+    MINIT(scanner_iterator_init_duration),
+    MINIT(scanner_decode_duration),
+    MINIT(scanner_delta_apply_duration),
+    MINIT(scanner_predicate_eval_duration),
+    MINIT(scanner_serialize_duration),
     GINIT(flush_dms_running),
     GINIT(flush_mrs_running),
     GINIT(compact_rs_running),
     GINIT(delta_minor_compact_rs_running),
     GINIT(delta_major_compact_rs_running),
+    GINIT(undo_delta_block_gc_running),
+    GINIT(reencode_columns_running),
+    GINIT(expired_rowset_gc_running),
     MINIT(flush_dms_duration),
     MINIT(flush_mrs_duration),
     MINIT(compact_rs_duration),
     MINIT(delta_minor_compact_rs_duration),
     MINIT(delta_major_compact_rs_duration),
-    MINIT(leader_memory_pressure_rejections) {
+    MINIT(undo_delta_block_gc_duration),
+    MINIT(reencode_columns_duration),
+    MINIT(expired_rowset_gc_duration),
+    MINIT(undo_delta_blocks_deleted),
+    MINIT(undo_delta_block_bytes_deleted),
+    MINIT(expired_rowsets_deleted),
+    MINIT(leader_memory_pressure_rejections),
+    MINIT(leader_memory_pressure_delays) {
 }
 #undef MINIT
 #undef GINIT
 
+void TabletMetrics::AddDictEncodingStats(const cfile::DictEncodingStatsPB& stats) {
+  dict_encoding_code_word_blocks_flushed->IncrementBy(stats.num_code_word_blocks());
+  dict_encoding_fallback_blocks_flushed->IncrementBy(stats.num_plain_blocks());
+  dict_encoding_fallback_cells_flushed->IncrementBy(stats.num_plain_values());
+}
+
 void TabletMetrics::AddProbeStats(const ProbeStats* stats_array, int len,
                                   Arena* work_arena) {
   // In most cases, different operations within a batch will have the same
@@ -29,6 +29,10 @@ class AtomicGauge;
 class Histogram;
 class MetricEntity;
 
+namespace cfile {
+class DictEncodingStatsPB;
+} // namespace cfile
+
 namespace tablet {
 
 struct ProbeStats;
@@ -45,6 +49,10 @@ struct TabletMetrics {
   // This allocates temporary scratch space from work_arena.
   void AddProbeStats(const ProbeStats* stats_array, int len, Arena* work_arena);
 
+  // Add the dictionary statistics of the rowsets written by a flush or a
+  // compaction to the metrics.
+  void AddDictEncodingStats(const cfile::DictEncodingStatsPB& stats);
+
   // Operation rates
   scoped_refptr<Counter> rows_inserted;
   scoped_refptr<Counter> rows_upserted;
@@ -58,6 +66,7 @@ struct TabletMetrics {
   scoped_refptr<Counter> scanner_cells_scanned_from_disk;
   scoped_refptr<Counter> scanner_bytes_scanned_from_disk;
   scoped_refptr<Counter> scans_started;
+  scoped_refptr<Counter> scanner_rowsets_pruned;
 
   // Probe stats
   scoped_refptr<Counter> bloom_lookups;
@@ -65,6 +74,9 @@ struct TabletMetrics {
   scoped_refptr<Counter> delta_file_lookups;
   scoped_refptr<Counter> mrs_lookups;
   scoped_refptr<Counter> bytes_flushed;
+  scoped_refptr<Counter> dict_encoding_code_word_blocks_flushed;
+  scoped_refptr<Counter> dict_encoding_fallback_blocks_flushed;
+  scoped_refptr<Counter> dict_encoding_fallback_cells_flushed;
 
   scoped_refptr<Histogram> bloom_lookups_per_op;
   scoped_refptr<Histogram> key_file_lookups_per_op;
@@ -75,19 +87,43 @@ struct TabletMetrics {
   scoped_refptr<Histogram> write_op_duration_client_propagated_consistency;
   scoped_refptr<Histogram> write_op_duration_commit_wait_consistency;
 
+  // Breakdown of the time spent by writes and scans in each of their stages.
+  scoped_refptr<Histogram> write_op_prepare_queue_duration;
+  scoped_refptr<Histogram> write_op_prepare_duration;
+  scoped_refptr<Histogram> write_op_row_lock_duration;
+  scoped_refptr<Histogram> write_op_replication_duration;
+  scoped_refptr<Histogram> write_op_apply_duration;
+  scoped_refptr<Histogram> write_op_mvcc_commit_duration;
+  scoped_refptr<Histogram> scanner_iterator_init_duration;
+  scoped_refptr<Histogram> scanner_decode_duration;
+  scoped_refptr<Histogram> scanner_delta_apply_duration;
+  scoped_refptr<Histogram> scanner_predicate_eval_duration;
+  scoped_refptr<Histogram> scanner_serialize_duration;
+
   scoped_refptr<AtomicGauge<uint32_t> > flush_dms_running;
   scoped_refptr<AtomicGauge<uint32_t> > flush_mrs_running;
   scoped_refptr<AtomicGauge<uint32_t> > compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > delta_minor_compact_rs_running;
   scoped_refptr<AtomicGauge<uint32_t> > delta_major_compact_rs_running;
+  scoped_refptr<AtomicGauge<uint32_t> > undo_delta_block_gc_running;
+  scoped_refptr<AtomicGauge<uint32_t> > reencode_columns_running;
+  scoped_refptr<AtomicGauge<uint32_t> > expired_rowset_gc_running;
 
   scoped_refptr<Histogram> flush_dms_duration;
   scoped_refptr<Histogram> flush_mrs_duration;
   scoped_refptr<Histogram> compact_rs_duration;
   scoped_refptr<Histogram> delta_minor_compact_rs_duration;
   scoped_refptr<Histogram> delta_major_compact_rs_duration;
+  scoped_refptr<Histogram> undo_delta_block_gc_duration;
+  scoped_refptr<Histogram> reencode_columns_duration;
+  scoped_refptr<Histogram> expired_rowset_gc_duration;
+
+  scoped_refptr<Counter> undo_delta_blocks_deleted;
+  scoped_refptr<Counter> undo_delta_block_bytes_deleted;
+  scoped_refptr<Counter> expired_rowsets_deleted;
 
   scoped_refptr<Counter> leader_memory_pressure_rejections;
+  scoped_refptr<Counter> leader_memory_pressure_delays;
 };
 
 } // namespace tablet
@@ -114,6 +114,81 @@ class MajorDeltaCompactionOp : public MaintenanceOp {
   Tablet* const tablet_;
 };
 
+// Rewrites the columns of the tablet's rowsets whose data was written with
+// an encoding or compression other than the one the schema now asks for, one
+// rowset at a time and at most once per --column_reencode_min_interval_ms.
+// Rowset compactions rewrite them too, but may never get to rowsets which
+// don't overlap others. Only runs if --enable_column_reencoding is set.
+class ReencodeColumnsOp : public MaintenanceOp {
+ public:
+  explicit ReencodeColumnsOp(Tablet* tablet);
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
+
+  virtual bool Prepare() OVERRIDE;
+
+  virtual void Perform() OVERRIDE;
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE;
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
+
+ private:
+  mutable simple_spinlock lock_;
+  // The schema version as of which no rowset had columns left to rewrite, or
+  // -1 if the rowsets haven't been found to be up to date yet.
+  int64_t reencoded_schema_version_;
+  MonoTime last_performed_;
+  Tablet* const tablet_;
+};
+
+// MaintenanceOp to delete the UNDO delta blocks which hold only history older
+// than the tablet's history retention.
+//
+// Deleting blocks is cheap, so the op is scored by the disk space it would
+// reclaim rather than by a performance improvement.
+class UndoDeltaBlockGCOp : public MaintenanceOp {
+ public:
+  explicit UndoDeltaBlockGCOp(Tablet* tablet);
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
+
+  virtual bool Prepare() OVERRIDE;
+
+  virtual void Perform() OVERRIDE;
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE;
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
+
+ private:
+  Tablet* const tablet_;
+};
+
+// MaintenanceOp to delete the rowsets of a table with a row TTL all of whose
+// rows have expired, without rewriting them. Finding them takes reading the
+// zone maps of their TTL columns, so they're looked for at most once per
+// --expired_rowset_check_interval_ms.
+class ExpiredRowSetGCOp : public MaintenanceOp {
+ public:
+  explicit ExpiredRowSetGCOp(Tablet* tablet);
+
+  virtual void UpdateStats(MaintenanceOpStats* stats) OVERRIDE;
+
+  virtual bool Prepare() OVERRIDE;
+
+  virtual void Perform() OVERRIDE;
+
+  virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE;
+
+  virtual scoped_refptr<AtomicGauge<uint32_t> > RunningGauge() const OVERRIDE;
+
+ private:
+  mutable simple_spinlock lock_;
+  MonoTime last_performed_;
+  Tablet* const tablet_;
+};
+
 } // namespace tablet
 } // namespace kudu
 
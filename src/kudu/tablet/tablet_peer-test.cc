@@ -49,6 +49,7 @@ METRIC_DECLARE_entity(tablet);
 
 DECLARE_int32(log_min_seconds_to_retain);
 DECLARE_int32(flush_threshold_mb);
+DECLARE_int32(max_coalesced_writes);
 
 namespace kudu {
 namespace tablet {
@@ -72,6 +73,7 @@ using server::LogicalClock;
 using std::shared_ptr;
 using std::string;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
@@ -91,6 +93,7 @@ class TabletPeerTest : public KuduTabletTest {
   virtual void SetUp() OVERRIDE {
     KuduTabletTest::SetUp();
 
+    ASSERT_OK(ThreadPoolBuilder("prepare").Build(&prepare_pool_));
     ASSERT_OK(ThreadPoolBuilder("apply").Build(&apply_pool_));
 
     rpc::MessengerBuilder builder(CURRENT_TEST_NAME());
@@ -108,6 +111,7 @@ class TabletPeerTest : public KuduTabletTest {
     tablet_peer_.reset(
       new TabletPeer(make_scoped_refptr(tablet()->metadata()),
                      config_peer,
+                     prepare_pool_.get(),
                      apply_pool_.get(),
                      Bind(&TabletPeerTest::TabletPeerStateChangedCallback,
                           Unretained(this),
@@ -138,6 +142,7 @@ class TabletPeerTest : public KuduTabletTest {
     ASSERT_OK(tablet_peer_->Init(tablet(),
                                  clock(),
                                  messenger_,
+                                 nullptr,
                                  scoped_refptr<rpc::ResultTracker>(),
                                  log,
                                  metric_entity_));
@@ -155,6 +160,7 @@ class TabletPeerTest : public KuduTabletTest {
 
   virtual void TearDown() OVERRIDE {
     tablet_peer_->Shutdown();
+    prepare_pool_->Shutdown();
     apply_pool_->Shutdown();
     KuduTabletTest::TearDown();
   }
@@ -216,6 +222,26 @@ class TabletPeerTest : public KuduTabletTest {
     return Status::OK();
   }
 
+  // Generate a request inserting the rows with the given keys.
+  void GenerateInsertRequest(const vector<int32_t>& keys, WriteRequestPB* write_req) {
+    Schema schema(GetTestSchema());
+    write_req->set_tablet_id(tablet()->tablet_id());
+    CHECK_OK(SchemaToPB(schema, write_req->mutable_schema()));
+
+    RowOperationsPBEncoder enc(write_req->mutable_row_operations());
+    for (int32_t key : keys) {
+      KuduPartialRow row(&schema);
+      CHECK_OK(row.SetInt32("key", key));
+      enc.Add(RowOperationsPB::INSERT, row);
+    }
+  }
+
+  // Holds up the prepare tasks of the tablet's transactions until 'latch'
+  // counts down.
+  Status BlockPrepares(CountDownLatch* latch) {
+    return tablet_peer_->prepare_pool_token_->SubmitFunc([latch]() { latch->Wait(); });
+  }
+
   // Execute insert requests and roll log after each one.
   Status ExecuteInsertsAndRollLogs(int num_inserts) {
     for (int i = 0; i < num_inserts; i++) {
@@ -274,6 +300,7 @@ class TabletPeerTest : public KuduTabletTest {
   scoped_refptr<MetricEntity> metric_entity_;
   shared_ptr<Messenger> messenger_;
   scoped_refptr<TabletPeer> tablet_peer_;
+  gscoped_ptr<ThreadPool> prepare_pool_;
   gscoped_ptr<ThreadPool> apply_pool_;
 };
 
@@ -539,6 +566,64 @@ TEST_F(TabletPeerTest, TestActiveTransactionPreventsLogGC) {
   ASSERT_EQ(2, segments.size());
 }
 
+// Test that the small writes submitted while the tablet is busy preparing are
+// coalesced into a single operation, with a response of their own each.
+TEST_F(TabletPeerTest, TestCoalescesQueuedWrites) {
+  FLAGS_max_coalesced_writes = 10;
+  ConsensusBootstrapInfo info;
+  ASSERT_OK(StartPeer(info));
+  ASSERT_OK(tablet_peer_->log()->WaitUntilAllFlushed());
+  OpId last_op_id;
+  tablet_peer_->log()->GetLatestEntryOpId(&last_op_id);
+
+  CountDownLatch prepare_continue(1);
+  ASSERT_OK(BlockPrepares(&prepare_continue));
+
+  // The first write can't be decoded, which must only fail it. The third one
+  // inserts a row of the second one again, which must only fail that row.
+  const int kNumWrites = 4;
+  vector<WriteRequestPB> reqs(kNumWrites);
+  vector<WriteResponsePB> resps(kNumWrites);
+  reqs[0].set_tablet_id(tablet()->tablet_id());
+  ASSERT_OK(SchemaToPB(GetTestSchema(), reqs[0].mutable_schema()));
+  reqs[0].mutable_row_operations()->set_rows("not a row");
+  GenerateInsertRequest({ 1, 2 }, &reqs[1]);
+  GenerateInsertRequest({ 3, 1, 4 }, &reqs[2]);
+  GenerateInsertRequest({ 5 }, &reqs[3]);
+
+  CountDownLatch rpc_latch(kNumWrites);
+  for (int i = 0; i < kNumWrites; i++) {
+    unique_ptr<WriteTransactionState> tx_state(new WriteTransactionState(tablet_peer_.get(),
+                                                                         &reqs[i],
+                                                                         nullptr,
+                                                                         &resps[i]));
+    tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
+        new LatchTransactionCompletionCallback<WriteResponsePB>(&rpc_latch, &resps[i])));
+    ASSERT_OK(tablet_peer_->SubmitWrite(std::move(tx_state)));
+  }
+  prepare_continue.CountDown();
+  rpc_latch.Wait();
+
+  ASSERT_TRUE(resps[0].has_error());
+  for (int i = 1; i < kNumWrites; i++) {
+    ASSERT_FALSE(resps[i].has_error()) << resps[i].DebugString();
+    ASSERT_EQ(resps[1].timestamp(), resps[i].timestamp());
+  }
+  ASSERT_EQ(0, resps[1].per_row_errors_size());
+  ASSERT_EQ(1, resps[2].per_row_errors_size());
+  ASSERT_EQ(1, resps[2].per_row_errors(0).row_index());
+  ASSERT_EQ(0, resps[3].per_row_errors_size());
+
+  // The three writes which succeeded were replicated as one operation.
+  ASSERT_OK(tablet_peer_->log()->WaitUntilAllFlushed());
+  OpId op_id;
+  tablet_peer_->log()->GetLatestEntryOpId(&op_id);
+  ASSERT_EQ(last_op_id.index() + 1, op_id.index());
+  uint64_t num_rows;
+  ASSERT_OK(tablet_peer_->tablet()->CountRows(&num_rows));
+  ASSERT_EQ(5, num_rows);
+}
+
 TEST_F(TabletPeerTest, TestGCEmptyLog) {
   ConsensusBootstrapInfo info;
   tablet_peer_->Start(info);
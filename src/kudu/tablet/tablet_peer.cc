@@ -47,12 +47,28 @@
 #include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer_mm_ops.h"
 #include "kudu/tablet/tablet.pb.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
+DEFINE_int32(max_coalesced_writes, 1,
+             "The maximum number of small writes to a tablet which its leader may "
+             "coalesce into a single operation, replicated and applied at once, "
+             "when they're submitted while the tablet is busy preparing other "
+             "operations. Values above 1 require every replica of the tablet to "
+             "understand coalesced writes.");
+TAG_FLAG(max_coalesced_writes, experimental);
+TAG_FLAG(max_coalesced_writes, runtime);
+
+DEFINE_int32(max_coalesced_write_size_bytes, 4096,
+             "The size of the row operations of the largest write which may be "
+             "coalesced with others. See --max_coalesced_writes.");
+TAG_FLAG(max_coalesced_write_size_bytes, experimental);
+TAG_FLAG(max_coalesced_write_size_bytes, runtime);
+
 using std::shared_ptr;
 using std::unique_ptr;
 
@@ -104,6 +120,7 @@ using tserver::TabletServerErrorPB;
 // ============================================================================
 TabletPeer::TabletPeer(const scoped_refptr<TabletMetadata>& meta,
                        const consensus::RaftPeerPB& local_peer_pb,
+                       ThreadPool* prepare_pool,
                        ThreadPool* apply_pool,
                        Callback<void(const std::string& reason)> mark_dirty_clbk)
     : meta_(meta),
@@ -111,6 +128,8 @@ TabletPeer::TabletPeer(const scoped_refptr<TabletMetadata>& meta,
       local_peer_pb_(local_peer_pb),
       state_(NOT_STARTED),
       status_listener_(new TabletStatusListener(meta)),
+      prepare_pool_(prepare_pool),
+      coalescing_write_(nullptr),
       apply_pool_(apply_pool),
       log_anchor_registry_(new LogAnchorRegistry()),
       mark_dirty_clbk_(std::move(mark_dirty_clbk)) {}
@@ -127,6 +146,7 @@ TabletPeer::~TabletPeer() {
 Status TabletPeer::Init(const shared_ptr<Tablet>& tablet,
                         const scoped_refptr<server::Clock>& clock,
                         const shared_ptr<Messenger>& messenger,
+                        const shared_ptr<consensus::HeartbeatBatcher>& heartbeat_batcher,
                         const scoped_refptr<ResultTracker>& result_tracker,
                         const scoped_refptr<Log>& log,
                         const scoped_refptr<MetricEntity>& metric_entity) {
@@ -134,12 +154,12 @@ Status TabletPeer::Init(const shared_ptr<Tablet>& tablet,
   DCHECK(tablet) << "A TabletPeer must be provided with a Tablet";
   DCHECK(log) << "A TabletPeer must be provided with a Log";
 
-  RETURN_NOT_OK(ThreadPoolBuilder("prepare").set_max_threads(1).Build(&prepare_pool_));
-  prepare_pool_->SetQueueLengthHistogram(
+  prepare_pool_token_ = prepare_pool_->NewSerialToken();
+  prepare_pool_token_->SetQueueLengthHistogram(
       METRIC_op_prepare_queue_length.Instantiate(metric_entity));
-  prepare_pool_->SetQueueTimeMicrosHistogram(
+  prepare_pool_token_->SetQueueTimeMicrosHistogram(
       METRIC_op_prepare_queue_time.Instantiate(metric_entity));
-  prepare_pool_->SetRunTimeMicrosHistogram(
+  prepare_pool_token_->SetRunTimeMicrosHistogram(
       METRIC_op_prepare_run_time.Instantiate(metric_entity));
 
   {
@@ -167,9 +187,11 @@ Status TabletPeer::Init(const shared_ptr<Tablet>& tablet,
                                         clock_,
                                         this,
                                         messenger_,
+                                        heartbeat_batcher,
                                         log_.get(),
                                         tablet_->mem_tracker(),
                                         mark_dirty_clbk_);
+    replicate_batcher_.reset(new ReplicateBatcher(consensus_.get(), prepare_pool_token_.get()));
   }
 
   if (tablet_->metrics() != nullptr) {
@@ -239,8 +261,14 @@ void TabletPeer::Shutdown() {
     txn_tracker_.WaitForAllToFinish();
   }
 
-  if (prepare_pool_) {
-    prepare_pool_->Shutdown();
+  {
+    std::lock_guard<simple_spinlock> l(coalesce_lock_);
+    coalescing_driver_.reset();
+    coalescing_write_ = nullptr;
+  }
+
+  if (prepare_pool_token_) {
+    prepare_pool_token_->Shutdown();
   }
 
   if (log_) {
@@ -323,15 +351,49 @@ Status TabletPeer::WaitUntilConsensusRunning(const MonoDelta& timeout) {
   return Status::OK();
 }
 
+// Returns whether 'state' is small and simple enough to be coalesced with
+// other writes.
+static bool CanCoalesceWrite(const WriteTransactionState& state) {
+  if (FLAGS_max_coalesced_writes <= 1) {
+    return false;
+  }
+  const tserver::WriteRequestPB* request = state.request();
+  const RowOperationsPB& ops = request->row_operations();
+  return state.external_consistency_mode() == CLIENT_PROPAGATED &&
+      request->has_row_operations() &&
+      static_cast<int64_t>(ops.rows().size() + ops.indirect_data().size()) <=
+          FLAGS_max_coalesced_write_size_bytes;
+}
+
 Status TabletPeer::SubmitWrite(unique_ptr<WriteTransactionState> state) {
   RETURN_NOT_OK(CheckRunning());
 
   state->SetResultTracker(result_tracker_);
+
+  // While the tablet is busy preparing other operations, the small writes
+  // that queue up behind them are coalesced into one, to share its Raft
+  // entry, WAL records and MVCC transaction.
+  bool can_coalesce = CanCoalesceWrite(*state);
+  if (can_coalesce) {
+    std::lock_guard<simple_spinlock> l(coalesce_lock_);
+    if (coalescing_write_ &&
+        coalescing_write_->TryCoalesce(&state, FLAGS_max_coalesced_writes)) {
+      TRACE("Coalesced into an earlier write");
+      return Status::OK();
+    }
+  }
+
+  WriteTransactionState* write = state.get();
   gscoped_ptr<WriteTransaction> transaction(new WriteTransaction(std::move(state),
                                                                  consensus::LEADER));
   scoped_refptr<TransactionDriver> driver;
   RETURN_NOT_OK(NewLeaderTransactionDriver(transaction.PassAs<Transaction>(),
                                            &driver));
+  if (can_coalesce) {
+    std::lock_guard<simple_spinlock> l(coalesce_lock_);
+    coalescing_driver_ = driver;
+    coalescing_write_ = write;
+  }
   return driver->ExecuteAsync();
 }
 
@@ -504,6 +566,15 @@ Status TabletPeer::StartReplicaTransaction(const scoped_refptr<ConsensusRound>&
               &replicate_msg->write_request(),
               replicate_msg->has_request_id() ? &replicate_msg->request_id() : nullptr));
       tx_state->SetResultTracker(result_tracker_);
+      for (const consensus::CoalescedWritePB& write : replicate_msg->coalesced_writes()) {
+        unique_ptr<WriteTransactionState> write_state(
+            new WriteTransactionState(
+                this,
+                &write.write_request(),
+                write.has_request_id() ? &write.request_id() : nullptr));
+        write_state->SetResultTracker(result_tracker_);
+        tx_state->AddCoalescedWrite(std::move(write_state));
+      }
 
       transaction.reset(new WriteTransaction(std::move(tx_state), consensus::REPLICA));
       break;
@@ -541,15 +612,31 @@ Status TabletPeer::StartReplicaTransaction(const scoped_refptr<ConsensusRound>&
   return Status::OK();
 }
 
+Status TabletPeer::GetSafeTimeForPropagation(Timestamp* safe_time) {
+  *safe_time = tablet_->mvcc_manager()->GetSafeTimeForPropagation();
+  return Status::OK();
+}
+
+void TabletPeer::AdvanceSafeTime(const Timestamp& safe_time) {
+  // Replica transactions only start in MVCC once they are prepared, so one
+  // that is still pending may yet need to start at or before 'safe_time'.
+  // Consensus holds its update lock, so no new ones can be added meanwhile.
+  if (txn_tracker_.GetNumPending() > 0) {
+    return;
+  }
+  tablet_->mvcc_manager()->OfflineAdjustSafeTime(safe_time);
+}
+
 Status TabletPeer::NewLeaderTransactionDriver(gscoped_ptr<Transaction> transaction,
                                               scoped_refptr<TransactionDriver>* driver) {
   scoped_refptr<TransactionDriver> tx_driver = new TransactionDriver(
     &txn_tracker_,
     consensus_.get(),
     log_.get(),
-    prepare_pool_.get(),
+    prepare_pool_token_.get(),
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    replicate_batcher_.get());
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::LEADER));
   driver->swap(tx_driver);
 
@@ -562,9 +649,10 @@ Status TabletPeer::NewReplicaTransactionDriver(gscoped_ptr<Transaction> transact
     &txn_tracker_,
     consensus_.get(),
     log_.get(),
-    prepare_pool_.get(),
+    prepare_pool_token_.get(),
     apply_pool_,
-    &txn_order_verifier_);
+    &txn_order_verifier_,
+    replicate_batcher_.get());
   RETURN_NOT_OK(tx_driver->Init(std::move(transaction), consensus::REPLICA));
   driver->swap(tx_driver);
 
@@ -627,7 +715,8 @@ Status FlushInflightsToLogCallback::WaitForInflightsAndFlushLog() {
   //
   // Because the operations always enqueue their COMMIT message to the log
   // before calling Commit(), this ensures that any in-flight operations have
-  // their commit messages "en route".
+  // their commit messages "en route". Writes may only have buffered theirs
+  // (see Log::AsyncAppendBufferedCommit()), but step 2 appends those too.
   //
   // NOTE: we only wait for those operations that have started their Apply() phase.
   // Any operations which haven't yet started applying haven't made any changes
@@ -645,7 +734,7 @@ Status FlushInflightsToLogCallback::WaitForInflightsAndFlushLog() {
   // 2) Flush the log
   //
   // This ensures that the above-mentioned commit messages are not just enqueued
-  // to the log, but also on disk.
+  // to the log, or buffered, but also on disk.
   VLOG(1) << "T " << tablet_->metadata()->tablet_id()
       <<  ": Waiting for in-flight transactions to commit.";
   LOG_SLOW_EXECUTION(WARNING, 200, "Committing in-flights took a long time.") {
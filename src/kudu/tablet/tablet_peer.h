@@ -36,6 +36,10 @@
 
 namespace kudu {
 
+namespace consensus {
+class HeartbeatBatcher;
+}
+
 namespace log {
 class LogAnchorRegistry;
 }
@@ -51,10 +55,13 @@ class CatchUpServiceTest;
 
 class MaintenanceManager;
 class MaintenanceOp;
+class ThreadPool;
+class ThreadPoolToken;
 
 namespace tablet {
 class LeaderTransactionDriver;
 class ReplicaTransactionDriver;
+class ReplicateBatcher;
 class TabletPeer;
 class TabletStatusPB;
 class TabletStatusListener;
@@ -71,14 +78,16 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   typedef std::map<int64_t, int64_t> MaxIdxToSegmentSizeMap;
 
   TabletPeer(const scoped_refptr<TabletMetadata>& meta,
-             const consensus::RaftPeerPB& local_peer_pb, ThreadPool* apply_pool,
-             Callback<void(const std::string& reason)> mark_dirty_clbk);
+             const consensus::RaftPeerPB& local_peer_pb, ThreadPool* prepare_pool,
+             ThreadPool* apply_pool, Callback<void(const std::string& reason)> mark_dirty_clbk);
 
   // Initializes the TabletPeer, namely creating the Log and initializing
-  // Consensus.
+  // Consensus. Consensus heartbeats are batched with those of the other
+  // tablets on this server through 'heartbeat_batcher', unless it is null.
   Status Init(const std::shared_ptr<tablet::Tablet>& tablet,
               const scoped_refptr<server::Clock>& clock,
               const std::shared_ptr<rpc::Messenger>& messenger,
+              const std::shared_ptr<consensus::HeartbeatBatcher>& heartbeat_batcher,
               const scoped_refptr<rpc::ResultTracker>& result_tracker,
               const scoped_refptr<log::Log>& log,
               const scoped_refptr<MetricEntity>& metric_entity);
@@ -124,6 +133,12 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   virtual Status StartReplicaTransaction(
       const scoped_refptr<consensus::ConsensusRound>& round) OVERRIDE;
 
+  // Used by consensus on the leader to get the safe time to propagate.
+  virtual Status GetSafeTimeForPropagation(Timestamp* safe_time) OVERRIDE;
+
+  // Used by consensus on followers to advance the MVCC safe time.
+  virtual void AdvanceSafeTime(const Timestamp& safe_time) OVERRIDE;
+
   consensus::Consensus* consensus() {
     std::lock_guard<simple_spinlock> lock(lock_);
     return consensus_.get();
@@ -302,12 +317,23 @@ class TabletPeer : public RefCountedThreadSafe<TabletPeer>,
   // during them in order to reject RPCs, etc.
   mutable simple_spinlock state_change_lock_;
 
-  // IMPORTANT: correct execution of PrepareTask assumes that 'prepare_pool_'
-  // is single-threaded, moving to a multi-tablet setup where multiple TabletPeers
-  // use the same 'prepare_pool_' needs to enforce that, for a single
-  // TabletPeer, PrepareTasks are executed *serially*.
-  // TODO move the prepare pool to TabletServer.
-  gscoped_ptr<ThreadPool> prepare_pool_;
+  // Pool that executes prepare tasks for transactions, constructor-injected
+  // like 'apply_pool_'. Correct execution of PrepareTask requires that, for a
+  // single TabletPeer, PrepareTasks are executed *serially*, so they're
+  // submitted through 'prepare_pool_token_'.
+  ThreadPool* prepare_pool_;
+  std::unique_ptr<ThreadPoolToken> prepare_pool_token_;
+
+  // Coalesces the replication of the writes prepared through
+  // 'prepare_pool_token_'. Only used by the prepare tasks.
+  gscoped_ptr<ReplicateBatcher> replicate_batcher_;
+
+  // The last small leader write submitted, run by 'coalescing_driver_', into
+  // which the small writes submitted after it are coalesced until it starts
+  // to be prepared. See --max_coalesced_writes. Protected by 'coalesce_lock_'.
+  scoped_refptr<TransactionDriver> coalescing_driver_;
+  WriteTransactionState* coalescing_write_;
+  simple_spinlock coalesce_lock_;
 
   // Pool that executes apply tasks for transactions. This is a multi-threaded
   // pool, constructor-injected by either the Master (for system tables) or
@@ -103,7 +103,11 @@ void FlushMRSOp::UpdateStats(MaintenanceOpStats* stats) {
     stats->set_runnable(lock.try_lock());
   }
 
-  stats->set_ram_anchored(tablet_peer_->tablet()->MemRowSetSize());
+  // A flush only writes, and new blocks are spread over all the data dirs,
+  // so it doesn't declare any.
+  size_t mrs_size = tablet_peer_->tablet()->MemRowSetSize();
+  stats->set_ram_anchored(mrs_size);
+  stats->set_io_bytes(mrs_size);
   stats->set_logs_retained_bytes(
       tablet_peer_->tablet()->MemRowSetLogRetentionSize(max_idx_to_segment_size));
 
@@ -159,6 +163,7 @@ void FlushDeltaMemStoresOp::UpdateStats(MaintenanceOpStats* stats) {
                                                    &dms_size, &retention_size);
 
   stats->set_ram_anchored(dms_size);
+  stats->set_io_bytes(dms_size);
   stats->set_runnable(true);
   stats->set_logs_retained_bytes(retention_size);
 
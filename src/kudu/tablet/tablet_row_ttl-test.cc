@@ -0,0 +1,182 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "kudu/common/partial_row.h"
+#include "kudu/common/schema.h"
+#include "kudu/gutil/casts.h"
+#include "kudu/server/hybrid_clock.h"
+#include "kudu/tablet/compaction.h"
+#include "kudu/tablet/local_tablet_writer.h"
+#include "kudu/tablet/tablet.h"
+#include "kudu/tablet/tablet_mm_ops.h"
+#include "kudu/tablet/tablet-test-util.h"
+#include "kudu/util/maintenance_manager.h"
+#include "kudu/util/test_macros.h"
+
+DECLARE_bool(use_mock_wall_clock);
+
+using std::string;
+using std::vector;
+
+namespace kudu {
+namespace tablet {
+
+class TabletRowTtlTest : public KuduTabletTest {
+ public:
+  TabletRowTtlTest()
+      : KuduTabletTest(Schema({ ColumnSchema("key", INT32),
+                                ColumnSchema("ts", UNIXTIME_MICROS),
+                                ColumnSchema("val", INT32) }, 1),
+                       TabletHarness::Options::HYBRID_CLOCK) {
+    FLAGS_use_mock_wall_clock = true;
+  }
+
+  virtual void SetUp() OVERRIDE {
+    KuduTabletTest::SetUp();
+    SetClockSeconds(1000);
+    // Rows expire 100 seconds after their 'ts'.
+    tablet()->metadata()->set_row_ttl(schema_.column_id(1), 100);
+  }
+
+ protected:
+  void SetClockSeconds(int64_t secs) {
+    down_cast<server::HybridClock*>(clock())->SetMockClockWallTimeForTests(secs * 1000000L);
+  }
+
+  void InsertRow(int32_t key, int64_t ts_secs) {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow row(&client_schema_);
+    ASSERT_OK(row.SetInt32(0, key));
+    ASSERT_OK(row.SetTimestamp(1, ts_secs * 1000000L));
+    ASSERT_OK(row.SetInt32(2, key));
+    ASSERT_OK(writer.Insert(row));
+  }
+
+  void UpdateVal(int32_t key, int32_t val) {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow row(&client_schema_);
+    ASSERT_OK(row.SetInt32(0, key));
+    ASSERT_OK(row.SetInt32(2, val));
+    ASSERT_OK(writer.Update(row));
+  }
+
+  uint64_t CountRows() {
+    uint64_t count;
+    CHECK_OK(tablet()->CountRows(&count));
+    return count;
+  }
+};
+
+// Flushes drop the rows which expired, but keep those mutated since their
+// insertion.
+TEST_F(TabletRowTtlTest, TestFlushDropsExpiredRows) {
+  RowExpiry expiry;
+  ASSERT_TRUE(tablet()->GetRowExpiry(&expiry));
+  ASSERT_EQ(schema_.column_id(1), expiry.col_id);
+  ASSERT_EQ(900 * 1000000L, expiry.cutoff_micros);
+
+  for (int i = 0; i < 10; i++) {
+    // The even rows have expired, the odd ones haven't.
+    NO_FATALS(InsertRow(i, i % 2 == 0 ? 850 : 950));
+  }
+  NO_FATALS(UpdateVal(2, 20));
+  ASSERT_OK(tablet()->Flush());
+  ASSERT_EQ(6, CountRows());
+
+  vector<string> rows;
+  ASSERT_OK(DumpTablet(*tablet(), client_schema_, &rows));
+  ASSERT_EQ(6, rows.size());
+  ASSERT_STR_CONTAINS(rows[0], "int32 key=1");
+  ASSERT_STR_CONTAINS(rows[1], "int32 key=2");
+  ASSERT_STR_CONTAINS(rows[1], "int32 val=20");
+
+  // The flush folded the update into the base data, so once the rows expire,
+  // a compaction drops them all but the one inserted since.
+  NO_FATALS(InsertRow(100, 1050));
+  ASSERT_OK(tablet()->Flush());
+  SetClockSeconds(1100);
+  ASSERT_OK(tablet()->Compact(Tablet::FORCE_COMPACT_ALL));
+  ASSERT_EQ(1, tablet()->num_rowsets());
+  ASSERT_EQ(1, CountRows());
+}
+
+// Whole rowsets whose rows have all expired are deleted without a rewrite.
+TEST_F(TabletRowTtlTest, TestDeleteExpiredRowSets) {
+  for (int i = 0; i < 10; i++) {
+    NO_FATALS(InsertRow(i, 950));
+  }
+  ASSERT_OK(tablet()->Flush());
+  SetClockSeconds(1060);
+  for (int i = 10; i < 20; i++) {
+    NO_FATALS(InsertRow(i, 1050));
+  }
+  ASSERT_OK(tablet()->Flush());
+  ASSERT_EQ(2, tablet()->num_rowsets());
+
+  int64_t rowsets_deleted;
+  ASSERT_OK(tablet()->DeleteExpiredRowSets(&rowsets_deleted));
+  ASSERT_EQ(0, rowsets_deleted);
+
+  ExpiredRowSetGCOp op(tablet().get());
+  MaintenanceOpStats stats;
+  op.UpdateStats(&stats);
+  ASSERT_TRUE(stats.runnable());
+
+  // Only the first rowset has expired by now.
+  SetClockSeconds(1100);
+  ASSERT_OK(tablet()->DeleteExpiredRowSets(&rowsets_deleted));
+  ASSERT_EQ(1, rowsets_deleted);
+  ASSERT_EQ(1, tablet()->num_rowsets());
+  ASSERT_EQ(10, CountRows());
+
+  // An update of the TTL column of one of the rows keeps the rowset alive.
+  {
+    LocalTabletWriter writer(tablet().get(), &client_schema_);
+    KuduPartialRow row(&client_schema_);
+    ASSERT_OK(row.SetInt32(0, 10));
+    ASSERT_OK(row.SetTimestamp(1, 1100 * 1000000L));
+    ASSERT_OK(writer.Update(row));
+  }
+  ASSERT_OK(tablet()->FlushBiggestDMS());
+  SetClockSeconds(1160);
+  ASSERT_OK(tablet()->DeleteExpiredRowSets(&rowsets_deleted));
+  ASSERT_EQ(0, rowsets_deleted);
+  ASSERT_EQ(1, tablet()->num_rowsets());
+}
+
+// Tablets of tables without a row TTL have nothing to expire.
+TEST_F(TabletRowTtlTest, TestNoRowTtl) {
+  tablet()->metadata()->set_row_ttl(ColumnId(-1), -1);
+  ASSERT_FALSE(tablet()->HasRowTtl());
+  NO_FATALS(InsertRow(0, 0));
+  ASSERT_OK(tablet()->Flush());
+  ASSERT_EQ(1, CountRows());
+
+  ExpiredRowSetGCOp op(tablet().get());
+  MaintenanceOpStats stats;
+  op.UpdateStats(&stats);
+  ASSERT_FALSE(stats.runnable());
+}
+
+} // namespace tablet
+} // namespace kudu
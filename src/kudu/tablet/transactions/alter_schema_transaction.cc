@@ -140,6 +140,12 @@ void AlterSchemaTransaction::Finish(TransactionResult result) {
   // make the changes visible to readers.
   TRACE("AlterSchemaCommitCallback: making alter schema visible");
   state()->Finish();
+
+  // Now that writes can go on, flush the MemRowSet replaced by the alter.
+  // Like any other failed flush, a failure here is fatal.
+  TRACE("AlterSchemaCommitCallback: flushing the pre-alter MemRowSet");
+  CHECK_OK_PREPEND(state_->tablet_peer()->tablet()->FlushPreAlterMemRowSet(),
+                   "Unable to flush the MemRowSet replaced by an alter schema");
 }
 
 string AlterSchemaTransaction::ToString() const {
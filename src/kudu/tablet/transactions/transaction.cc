@@ -74,7 +74,12 @@ TransactionMetrics::TransactionMetrics()
     successful_upserts(0),
     successful_updates(0),
     successful_deletes(0),
-    commit_wait_duration_usec(0) {
+    commit_wait_duration_usec(0),
+    prepare_queue_duration_usec(0),
+    prepare_duration_usec(0),
+    row_lock_duration_usec(0),
+    replication_duration_usec(0),
+    apply_duration_usec(0) {
 }
 
 void TransactionMetrics::Reset() {
@@ -82,6 +87,11 @@ void TransactionMetrics::Reset() {
   successful_updates = 0;
   successful_deletes = 0;
   commit_wait_duration_usec = 0;
+  prepare_queue_duration_usec = 0;
+  prepare_duration_usec = 0;
+  row_lock_duration_usec = 0;
+  replication_duration_usec = 0;
+  apply_duration_usec = 0;
 }
 
 
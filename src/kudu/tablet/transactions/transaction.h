@@ -20,11 +20,13 @@
 
 #include <string>
 #include <mutex>
+#include <vector>
 #include <kudu/rpc/result_tracker.h>
 
 #include "kudu/common/timestamp.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus.h"
+#include "kudu/gutil/callback.h"
 #include "kudu/util/auto_release_pool.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/status.h"
@@ -50,6 +52,13 @@ struct TransactionMetrics {
   int successful_updates;
   int successful_deletes;
   uint64_t commit_wait_duration_usec;
+
+  // The time the transaction spent in each of its stages.
+  uint64_t prepare_queue_duration_usec;
+  uint64_t prepare_duration_usec;
+  uint64_t row_lock_duration_usec;
+  uint64_t replication_duration_usec;
+  uint64_t apply_duration_usec;
 };
 
 // Base class for transactions.
@@ -188,6 +197,16 @@ class TransactionState {
     return DCHECK_NOTNULL(completion_clbk_.get());
   }
 
+  // Sets a callback to run if the transaction is about to wait for a row lock
+  // held by another transaction while it's being prepared.
+  void set_row_lock_wait_callback(const Closure& callback) {
+    row_lock_wait_callback_ = callback;
+  }
+
+  const Closure& row_lock_wait_callback() const {
+    return row_lock_wait_callback_;
+  }
+
   // Sets a heap object to be managed by this transaction's AutoReleasePool.
   template<class T>
   T* AddToAutoReleasePool(T* t) {
@@ -253,6 +272,13 @@ class TransactionState {
     return request_id_;
   }
 
+  // Returns the states of the transactions which are coalesced into this one,
+  // if any. They are replicated and applied as part of this transaction, but
+  // keep their own responses, request ids and completion callbacks.
+  virtual std::vector<TransactionState*> coalesced_states() const {
+    return std::vector<TransactionState*>();
+  }
+
  protected:
   explicit TransactionState(TabletPeer* tablet_peer);
   virtual ~TransactionState();
@@ -268,6 +294,9 @@ class TransactionState {
   // Optional callback to be called once the transaction completes.
   gscoped_ptr<TransactionCompletionCallback> completion_clbk_;
 
+  // Optional callback to be called before waiting for a row lock.
+  Closure row_lock_wait_callback_;
+
   AutoReleasePool pool_;
 
   // This transaction's timestamp. Protected by txn_state_lock_.
@@ -17,6 +17,7 @@
 
 #include "kudu/tablet/transactions/transaction_driver.h"
 
+#include <gflags/gflags.h>
 #include <mutex>
 
 #include "kudu/consensus/consensus.h"
@@ -26,10 +27,18 @@
 #include "kudu/tablet/transactions/transaction_tracker.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/debug/trace_event.h"
+#include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
+DEFINE_int32(max_replicate_batch_size, 64,
+             "Maximum number of leader transactions of a tablet which are prepared back "
+             "to back and then replicated together, as a single append to the log and "
+             "the queue. 1 replicates each transaction as soon as it's prepared.");
+TAG_FLAG(max_replicate_batch_size, advanced);
+TAG_FLAG(max_replicate_batch_size, runtime);
+
 namespace kudu {
 namespace tablet {
 
@@ -43,6 +52,7 @@ using log::Log;
 using rpc::RequestIdPB;
 using rpc::ResultTracker;
 using std::shared_ptr;
+using std::vector;
 
 static const char* kTimestampFieldName = "timestamp";
 
@@ -84,15 +94,17 @@ class FollowerTransactionCompletionCallback : public TransactionCompletionCallba
 TransactionDriver::TransactionDriver(TransactionTracker *txn_tracker,
                                      Consensus* consensus,
                                      Log* log,
-                                     ThreadPool* prepare_pool,
+                                     ThreadPoolToken* prepare_pool_token,
                                      ThreadPool* apply_pool,
-                                     TransactionOrderVerifier* order_verifier)
+                                     TransactionOrderVerifier* order_verifier,
+                                     ReplicateBatcher* replicate_batcher)
     : txn_tracker_(txn_tracker),
       consensus_(consensus),
       log_(log),
-      prepare_pool_(prepare_pool),
+      prepare_pool_token_(prepare_pool_token),
       apply_pool_(apply_pool),
       order_verifier_(order_verifier),
+      replicate_batcher_(replicate_batcher),
       trace_(new Trace()),
       start_time_(MonoTime::Now(MonoTime::FINE)),
       replication_state_(NOT_REPLICATING),
@@ -112,16 +124,11 @@ Status TransactionDriver::Init(gscoped_ptr<Transaction> transaction,
     DCHECK(op_id_copy_.IsInitialized());
     replication_state_ = REPLICATING;
     replication_start_time_ = MonoTime::Now(MonoTime::FINE);
-    if (state()->are_results_tracked()) {
-      // If this is a follower transaction, make sure to set the transaction completion callback
-      // before the transaction has a chance to fail.
-      const rpc::RequestIdPB& request_id = state()->request_id();
-      const google::protobuf::Message* response = state()->response();
-      gscoped_ptr<TransactionCompletionCallback> callback(
-          new FollowerTransactionCompletionCallback(request_id,
-                                                    response,
-                                                    state()->result_tracker()));
-      mutable_state()->set_completion_callback(callback.Pass());
+    // If this is a follower transaction, make sure to set the transaction completion callbacks
+    // before the transaction has a chance to fail.
+    SetFollowerCompletionCallback(mutable_state());
+    for (TransactionState* coalesced_state : state()->coalesced_states()) {
+      SetFollowerCompletionCallback(coalesced_state);
     }
   } else {
     DCHECK_EQ(type, consensus::LEADER);
@@ -186,7 +193,7 @@ Status TransactionDriver::ExecuteAsync() {
   }
 
   if (s.ok()) {
-    s = prepare_pool_->SubmitClosure(
+    s = prepare_pool_token_->SubmitClosure(
       Bind(&TransactionDriver::PrepareAndStartTask, Unretained(this)));
   }
 
@@ -200,19 +207,51 @@ Status TransactionDriver::ExecuteAsync() {
 
 void TransactionDriver::PrepareAndStartTask() {
   TRACE_EVENT_FLOW_END0("txn", "PrepareAndStartTask", this);
+  // HandleFailure() may release the last reference to this driver.
+  ReplicateBatcher* batcher = replicate_batcher_;
+  if (batcher) {
+    if (CanJoinReplicateBatch()) {
+      // The batched transactions only release their row locks once they're
+      // replicated and applied, so don't wait for one without replicating them.
+      mutable_state()->set_row_lock_wait_callback(
+          Bind(&ReplicateBatcher::Flush, Unretained(batcher)));
+    } else {
+      batcher->Flush();
+    }
+  }
   Status prepare_status = PrepareAndStart();
   if (PREDICT_FALSE(!prepare_status.ok())) {
     HandleFailure(prepare_status);
   }
+  if (batcher) {
+    batcher->MaybeFlush();
+  }
+}
+
+void TransactionDriver::SetFollowerCompletionCallback(TransactionState* state) {
+  if (!state->are_results_tracked()) return;
+
+  gscoped_ptr<TransactionCompletionCallback> callback(
+      new FollowerTransactionCompletionCallback(state->request_id(),
+                                                state->response(),
+                                                state->result_tracker()));
+  state->set_completion_callback(callback.Pass());
 }
 
 void TransactionDriver::RegisterFollowerTransactionOnResultTracker() {
+  RegisterFollowerTransactionOnResultTracker(mutable_state());
+  for (TransactionState* coalesced_state : state()->coalesced_states()) {
+    RegisterFollowerTransactionOnResultTracker(coalesced_state);
+  }
+}
+
+void TransactionDriver::RegisterFollowerTransactionOnResultTracker(TransactionState* state) {
   // If this is a transaction being executed by a follower and its result is being
   // tracked, make sure that we're the driver of the transaction.
-  if (!state()->are_results_tracked()) return;
+  if (!state->are_results_tracked()) return;
 
-  ResultTracker::RpcState rpc_state = state()->result_tracker()->TrackRpcOrChangeDriver(
-      state()->request_id());
+  ResultTracker::RpcState rpc_state = state->result_tracker()->TrackRpcOrChangeDriver(
+      state->request_id());
   switch (rpc_state) {
     case ResultTracker::RpcState::NEW:
       // We're the only ones trying to execute the transaction (normal case). Proceed.
@@ -221,11 +260,11 @@ void TransactionDriver::RegisterFollowerTransactionOnResultTracker() {
       // stop tracking the result. Only follower transactions can observe this state so we
       // simply reset the callback and the result will not be tracked anymore.
     case ResultTracker::RpcState::COMPLETED: {
-      mutable_state()->set_completion_callback(
+      state->set_completion_callback(
           gscoped_ptr<TransactionCompletionCallback>(new TransactionCompletionCallback()));
-      VLOG(1) << state()->result_tracker() << " Follower Rpc was not NEW or IN_PROGRESS: "
-          << rpc_state << " OpId: " << state()->op_id().ShortDebugString()
-          << " RequestId: " << state()->request_id().ShortDebugString();
+      VLOG(1) << state->result_tracker() << " Follower Rpc was not NEW or IN_PROGRESS: "
+          << rpc_state << " OpId: " << state->op_id().ShortDebugString()
+          << " RequestId: " << state->request_id().ShortDebugString();
       return;
     }
     default:
@@ -239,7 +278,14 @@ Status TransactionDriver::PrepareAndStart() {
   // Actually prepare and start the transaction.
   prepare_physical_timestamp_ = GetMonoTimeMicros();
 
+  MonoTime prepare_start_time = MonoTime::Now(MonoTime::FINE);
+  TransactionMetrics* metrics = mutable_state()->mutable_metrics();
+  metrics->prepare_queue_duration_usec =
+      prepare_start_time.GetDeltaSince(start_time_).ToMicroseconds();
   RETURN_NOT_OK(transaction_->Prepare());
+  metrics->prepare_duration_usec =
+      MonoTime::Now(MonoTime::FINE).GetDeltaSince(prepare_start_time).ToMicroseconds();
+  TRACE_COUNTER_INCREMENT("prepare_time_us", metrics->prepare_duration_usec);
   RETURN_NOT_OK(transaction_->Start());
 
   // Only take the lock long enough to take a local copy of the
@@ -262,13 +308,19 @@ Status TransactionDriver::PrepareAndStart() {
     // ... else we're a client-started transaction. Make sure we're still the driver of the
     // RPC and give up if we aren't.
     } else {
-      if (state()->are_results_tracked()
-          && !state()->result_tracker()->IsCurrentDriver(state()->request_id())) {
-        transaction_status_ = Status::AlreadyPresent(strings::Substitute(
-            "There's already an attempt of the same operation on the server for request id: $0",
-            state()->request_id().ShortDebugString()));
-        replication_state_ = REPLICATION_FAILED;
-        return transaction_status_;
+      // The writes coalesced into this one are replicated with it, so give up
+      // on all of them if we aren't the driver of any of them.
+      vector<TransactionState*> states = state()->coalesced_states();
+      states.push_back(mutable_state());
+      for (const TransactionState* tx_state : states) {
+        if (tx_state->are_results_tracked()
+            && !tx_state->result_tracker()->IsCurrentDriver(tx_state->request_id())) {
+          transaction_status_ = Status::AlreadyPresent(strings::Substitute(
+              "There's already an attempt of the same operation on the server for request id: $0",
+              tx_state->request_id().ShortDebugString()));
+          replication_state_ = REPLICATION_FAILED;
+          return transaction_status_;
+        }
       }
     }
   }
@@ -289,6 +341,15 @@ Status TransactionDriver::PrepareAndStart() {
         replication_start_time_ = MonoTime::Now(MonoTime::FINE);
       }
 
+      if (replicate_batcher_) {
+        if (CanJoinReplicateBatch()) {
+          replicate_batcher_->Add(this);
+          break;
+        }
+        // The batch must still be replicated before this transaction.
+        replicate_batcher_->Flush();
+      }
+
       Status s = consensus_->Replicate(mutable_state()->consensus_round());
       if (PREDICT_FALSE(!s.ok())) {
         std::lock_guard<simple_spinlock> lock(lock_);
@@ -319,6 +380,22 @@ Status TransactionDriver::PrepareAndStart() {
   return Status::OK();
 }
 
+bool TransactionDriver::CanJoinReplicateBatch() const {
+  return transaction_->type() == consensus::LEADER &&
+      transaction_->tx_type() == Transaction::WRITE_TXN &&
+      FLAGS_max_replicate_batch_size > 1;
+}
+
+void TransactionDriver::ReplicationFailed(const Status& s) {
+  {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    CHECK_EQ(replication_state_, REPLICATING);
+    transaction_status_ = s;
+    replication_state_ = REPLICATION_FAILED;
+  }
+  HandleFailure(s);
+}
+
 void TransactionDriver::HandleFailure(const Status& s) {
   VLOG_WITH_PREFIX(2) << "Failed transaction: " << s.ToString();
   CHECK(!s.ok());
@@ -339,6 +416,10 @@ void TransactionDriver::HandleFailure(const Status& s) {
       VLOG_WITH_PREFIX(1) << "Transaction " << ToString() << " failed prior to "
           "replication success: " << s.ToString();
       transaction_->Finish(Transaction::ABORTED);
+      for (TransactionState* coalesced_state : state()->coalesced_states()) {
+        coalesced_state->completion_callback()->set_error(transaction_status_);
+        coalesced_state->completion_callback()->TransactionCompleted();
+      }
       mutable_state()->completion_callback()->set_error(transaction_status_);
       mutable_state()->completion_callback()->TransactionCompleted();
       txn_tracker_->Release(this);
@@ -385,6 +466,8 @@ void TransactionDriver::ReplicationFinished(const Status& status) {
   }
 
 
+  mutable_state()->mutable_metrics()->replication_duration_usec =
+      replication_duration.ToMicroseconds();
   TRACE_COUNTER_INCREMENT("replication_time_us", replication_duration.ToMicroseconds());
 
   // If we have prepared and replicated, we're ready
@@ -462,15 +545,30 @@ void TransactionDriver::ApplyTask() {
 
   {
     gscoped_ptr<CommitMsg> commit_msg;
+    MonoTime apply_start_time = MonoTime::Now(MonoTime::FINE);
     CHECK_OK(transaction_->Apply(&commit_msg));
+    uint64_t apply_duration_usec =
+        MonoTime::Now(MonoTime::FINE).GetDeltaSince(apply_start_time).ToMicroseconds();
+    mutable_state()->mutable_metrics()->apply_duration_usec = apply_duration_usec;
+    TRACE_COUNTER_INCREMENT("apply_time_us", apply_duration_usec);
     commit_msg->mutable_commited_op_id()->CopyFrom(op_id_copy_);
     SetResponseTimestamp(transaction_->state(), transaction_->state()->timestamp());
+    for (TransactionState* coalesced_state : state()->coalesced_states()) {
+      SetResponseTimestamp(coalesced_state, transaction_->state()->timestamp());
+    }
 
     {
       TRACE_EVENT1("txn", "AsyncAppendCommit", "txn", this);
-      CHECK_OK(log_->AsyncAppendCommit(std::move(commit_msg),
-                                       Bind(CrashIfNotOkStatusCB,
-                                       "Enqueued commit operation failed to write to WAL")));
+      StatusCallback commit_cb = Bind(CrashIfNotOkStatusCB,
+                                      "Enqueued commit operation failed to write to WAL");
+      // The effects of a write only become durable once the tablet flushes
+      // its stores, which first waits for the log to be flushed, so the
+      // commit may be buffered: if it's lost, bootstrap just replays the write.
+      if (transaction_->tx_type() == Transaction::WRITE_TXN) {
+        CHECK_OK(log_->AsyncAppendBufferedCommit(std::move(commit_msg), commit_cb));
+      } else {
+        CHECK_OK(log_->AsyncAppendCommit(std::move(commit_msg), commit_cb));
+      }
     }
 
     // If the client requested COMMIT_WAIT as the external consistency mode
@@ -521,11 +619,56 @@ void TransactionDriver::Finalize() {
   scoped_refptr<TransactionDriver> ref(this);
   std::lock_guard<simple_spinlock> lock(lock_);
   transaction_->Finish(Transaction::COMMITTED);
+  for (TransactionState* coalesced_state : state()->coalesced_states()) {
+    coalesced_state->completion_callback()->TransactionCompleted();
+  }
   mutable_state()->completion_callback()->TransactionCompleted();
   txn_tracker_->Release(this);
 }
 
 
+////////////////////////////////////////////////////////////
+// ReplicateBatcher
+////////////////////////////////////////////////////////////
+
+ReplicateBatcher::ReplicateBatcher(Consensus* consensus, ThreadPoolToken* prepare_pool_token)
+    : consensus_(consensus),
+      prepare_pool_token_(prepare_pool_token) {
+}
+
+void ReplicateBatcher::Add(TransactionDriver* driver) {
+  batch_.push_back(driver);
+}
+
+void ReplicateBatcher::MaybeFlush() {
+  if (static_cast<int>(batch_.size()) < FLAGS_max_replicate_batch_size &&
+      prepare_pool_token_->queue_length() > 0) {
+    return;
+  }
+  Flush();
+}
+
+void ReplicateBatcher::Flush() {
+  if (batch_.empty()) {
+    return;
+  }
+
+  vector<scoped_refptr<TransactionDriver> > batch;
+  batch.swap(batch_);
+  vector<scoped_refptr<ConsensusRound> > rounds;
+  rounds.reserve(batch.size());
+  for (const scoped_refptr<TransactionDriver>& driver : batch) {
+    rounds.push_back(driver->mutable_state()->consensus_round());
+  }
+
+  int num_replicated = 0;
+  Status s = consensus_->ReplicateBatch(rounds, &num_replicated);
+  for (int i = num_replicated; i < batch.size(); i++) {
+    DCHECK(!s.ok());
+    batch[i]->ReplicationFailed(s);
+  }
+}
+
 std::string TransactionDriver::StateString(ReplicationState repl_state,
                                            PrepareState prep_state) {
   string state_str;
@@ -19,6 +19,7 @@
 #define KUDU_TABLET_TRANSACTION_DRIVER_H_
 
 #include <string>
+#include <vector>
 #include <kudu/rpc/result_tracker.h>
 
 #include "kudu/consensus/consensus.h"
@@ -30,6 +31,7 @@
 
 namespace kudu {
 class ThreadPool;
+class ThreadPoolToken;
 
 namespace log {
 class Log;
@@ -40,6 +42,7 @@ class ResultTracker;
 }
 
 namespace tablet {
+class ReplicateBatcher;
 class TransactionOrderVerifier;
 class TransactionTracker;
 
@@ -54,14 +57,16 @@ class TransactionTracker;
 //      the operation is already "REPLICATING" (and thus we don't need to
 //      trigger replication ourself later on).
 //
-//  2 - ExecuteAsync() is called. This submits PrepareAndStartTask() to prepare_pool_
-//      and returns immediately.
+//  2 - ExecuteAsync() is called. This submits PrepareAndStartTask() to
+//      prepare_pool_token_ and returns immediately.
 //
 //  3 - PrepareAndStartTask() calls Prepare() and Start() on the transaction.
 //
 //      Once successfully prepared, if we have not yet replicated (i.e we are leader),
 //      also triggers consensus->Replicate() and changes the replication state to
-//      REPLICATING.
+//      REPLICATING. If the driver has a ReplicateBatcher and the transaction is
+//      a write, it's instead replicated along with the writes prepared right
+//      after it.
 //
 //      On the other hand, if we have already successfully replicated (eg we are the
 //      follower and ConsensusCommitted() has already been called, then we can move
@@ -183,12 +188,15 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
  public:
   // Construct TransactionDriver. TransactionDriver does not take ownership
   // of any of the objects pointed to in the constructor's arguments.
+  // 'replicate_batcher' may be null, in which case leader transactions are
+  // always replicated one by one.
   TransactionDriver(TransactionTracker* txn_tracker,
                     consensus::Consensus* consensus,
                     log::Log* log,
-                    ThreadPool* prepare_pool,
+                    ThreadPoolToken* prepare_pool_token,
                     ThreadPool* apply_pool,
-                    TransactionOrderVerifier* order_verifier);
+                    TransactionOrderVerifier* order_verifier,
+                    ReplicateBatcher* replicate_batcher = nullptr);
 
   // Perform any non-constructor initialization. Sets the transaction
   // that will be executed.
@@ -237,6 +245,7 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
 
  private:
   friend class RefCountedThreadSafe<TransactionDriver>;
+  friend class ReplicateBatcher;
   enum ReplicationState {
     // The operation has not yet been sent to consensus for replication
     NOT_REPLICATING,
@@ -278,6 +287,14 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   // requested consistency mode.
   Status CommitWait();
 
+  // Returns true if the transaction is a leader write whose replication may be
+  // batched with that of the transactions prepared after it.
+  bool CanJoinReplicateBatch() const;
+
+  // Called by the ReplicateBatcher when the transaction couldn't be
+  // replicated along with its batch.
+  void ReplicationFailed(const Status& s);
+
   // Handle a failure in any of the stages of the operation.
   // In some cases, this will end the operation and call its callback.
   // In others, where we can't recover, this will FATAL.
@@ -301,16 +318,23 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
                             const Timestamp& timestamp);
 
   // If this driver is executing a follower transaction then it is possible
-  // it never went through the rpc system so we have to register it with the
-  // ResultTracker.
+  // it never went through the rpc system so we have to register it, and the
+  // transactions coalesced into it, with the ResultTracker.
   void RegisterFollowerTransactionOnResultTracker();
+  void RegisterFollowerTransactionOnResultTracker(TransactionState* state);
+
+  // Sets the completion callback of 'state', the state of a follower
+  // transaction or of one coalesced into it, to record its result on the
+  // ResultTracker, if the result is tracked.
+  static void SetFollowerCompletionCallback(TransactionState* state);
 
   TransactionTracker* const txn_tracker_;
   consensus::Consensus* const consensus_;
   log::Log* const log_;
-  ThreadPool* const prepare_pool_;
+  ThreadPoolToken* const prepare_pool_token_;
   ThreadPool* const apply_pool_;
   TransactionOrderVerifier* const order_verifier_;
+  ReplicateBatcher* const replicate_batcher_;
 
   Status transaction_status_;
 
@@ -348,6 +372,49 @@ class TransactionDriver : public RefCountedThreadSafe<TransactionDriver> {
   DISALLOW_COPY_AND_ASSIGN(TransactionDriver);
 };
 
+// Coalesces the replication of the leader write transactions of a tablet
+// which are prepared back to back: rather than each one being replicated as
+// soon as it's prepared, they're replicated together once the prepare pool
+// token has nothing else queued, or once --max_replicate_batch_size of them
+// are waiting. They're then appended to the log and sent to the followers as
+// a single batch, under a single acquisition of the consensus locks.
+//
+// Since transactions are prepared in timestamp order on the token, and a
+// batch keeps that order, this doesn't change the order they're replicated
+// or applied in. The applies of the transactions in a batch still run in
+// parallel on the apply pool.
+//
+// A batched transaction holds its row locks until it's applied, so the batch
+// is replicated before a later prepare waits on one of them, and before any
+// other kind of transaction is prepared.
+//
+// Only ever used from tasks running on the prepare pool token, which run one
+// at a time, so it isn't otherwise synchronized.
+class ReplicateBatcher {
+ public:
+  ReplicateBatcher(consensus::Consensus* consensus, ThreadPoolToken* prepare_pool_token);
+
+  // Adds a prepared leader write transaction to the batch.
+  void Add(TransactionDriver* driver);
+
+  // Replicates the batch if it's full, or if no other prepare is queued on the
+  // token. Called at the end of every prepare task, so that the last one to
+  // run replicates whatever is left in the batch.
+  void MaybeFlush();
+
+  // Replicates the batch, if it isn't empty. The transactions which can't be
+  // replicated are failed.
+  void Flush();
+
+ private:
+  consensus::Consensus* const consensus_;
+  ThreadPoolToken* const prepare_pool_token_;
+
+  std::vector<scoped_refptr<TransactionDriver> > batch_;
+
+  DISALLOW_COPY_AND_ASSIGN(ReplicateBatcher);
+};
+
 }  // namespace tablet
 }  // namespace kudu
 
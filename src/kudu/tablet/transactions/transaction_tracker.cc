@@ -191,6 +191,10 @@ void TransactionTracker::GetPendingTransactions(
 }
 
 int TransactionTracker::GetNumPendingForTests() const {
+  return GetNumPending();
+}
+
+int TransactionTracker::GetNumPending() const {
   std::lock_guard<simple_spinlock> l(lock_);
   return pending_txns_.size();
 }
@@ -63,6 +63,10 @@ class TransactionTracker {
   // Returns number of pending transactions.
   int GetNumPendingForTests() const;
 
+  // Returns the number of transactions which have been added but not yet
+  // released.
+  int GetNumPending() const;
+
   void WaitForAllToFinish() const;
   Status WaitForAllToFinish(const MonoDelta& timeout) const;
 
@@ -45,6 +45,7 @@ TAG_FLAG(tablet_inject_latency_on_apply_write_txn_ms, runtime);
 namespace kudu {
 namespace tablet {
 
+using consensus::ConsensusRound;
 using consensus::ReplicateMsg;
 using consensus::CommitMsg;
 using consensus::DriverType;
@@ -53,6 +54,7 @@ using tserver::TabletServerErrorPB;
 using tserver::WriteRequestPB;
 using tserver::WriteResponsePB;
 using std::unique_ptr;
+using std::vector;
 using strings::Substitute;
 
 WriteTransaction::WriteTransaction(unique_ptr<WriteTransactionState> state, DriverType type)
@@ -70,37 +72,122 @@ void WriteTransaction::NewReplicateMsg(gscoped_ptr<ReplicateMsg>* replicate_msg)
   }
 }
 
-Status WriteTransaction::Prepare() {
-  TRACE_EVENT0("txn", "WriteTransaction::Prepare");
-  TRACE("PREPARE: Starting");
-  // Decode everything first so that we give up if something major is wrong.
+// Decodes the row operations of 'write', which is either 'tx_state' or one of
+// the writes coalesced into it, appending them to those of 'tx_state'. On
+// failure, also sets the error on the completion callback of 'write'.
+static Status DecodeWrite(Tablet* tablet,
+                          WriteTransactionState* write,
+                          WriteTransactionState* tx_state) {
   Schema client_schema;
-  RETURN_NOT_OK_PREPEND(SchemaFromPB(state_->request()->schema(), &client_schema),
-                        "Cannot decode client schema");
+  Status s = SchemaFromPB(write->request()->schema(), &client_schema);
+  if (!s.ok()) {
+    s = s.CloneAndPrepend("Cannot decode client schema");
+    write->completion_callback()->set_error(s);
+    return s;
+  }
   if (client_schema.has_column_ids()) {
     // TODO: we have this kind of code a lot - add a new SchemaFromPB variant which
     // does this check inline.
-    Status s = Status::InvalidArgument("User requests should not have Column IDs");
-    state_->completion_callback()->set_error(s, TabletServerErrorPB::INVALID_SCHEMA);
+    s = Status::InvalidArgument("User requests should not have Column IDs");
+    write->completion_callback()->set_error(s, TabletServerErrorPB::INVALID_SCHEMA);
     return s;
   }
 
-  Tablet* tablet = state()->tablet_peer()->tablet();
-
-  Status s = tablet->DecodeWriteOperations(&client_schema, state());
+  if (write == tx_state) {
+    s = tablet->DecodeWriteOperations(&client_schema, tx_state);
+  } else {
+    s = tablet->DecodeCoalescedWriteOperations(&client_schema, write, tx_state);
+  }
   if (!s.ok()) {
     // TODO: is MISMATCHED_SCHEMA always right here? probably not.
-    state()->completion_callback()->set_error(s, TabletServerErrorPB::MISMATCHED_SCHEMA);
+    write->completion_callback()->set_error(s, TabletServerErrorPB::MISMATCHED_SCHEMA);
     return s;
   }
+  return Status::OK();
+}
+
+Status WriteTransaction::Prepare() {
+  TRACE_EVENT0("txn", "WriteTransaction::Prepare");
+  TRACE("PREPARE: Starting");
+  state_->StopCoalescing();
+
+  Tablet* tablet = state()->tablet_peer()->tablet();
+
+  // Decode everything first so that we give up if something major is wrong.
+  Status s = DecodeWrite(tablet, state(), state());
+  if (!state_->coalesced_writes().empty()) {
+    s = DecodeCoalescedWrites(s);
+  }
+  RETURN_NOT_OK(s);
 
   // Now acquire row locks and prepare everything for apply
+  MonoTime row_lock_start_time = MonoTime::Now(MonoTime::FINE);
   RETURN_NOT_OK(tablet->AcquireRowLocks(state()));
+  state()->mutable_metrics()->row_lock_duration_usec =
+      MonoTime::Now(MonoTime::FINE).GetDeltaSince(row_lock_start_time).ToMicroseconds();
 
   TRACE("PREPARE: finished.");
   return Status::OK();
 }
 
+Status WriteTransaction::DecodeCoalescedWrites(const Status& decode_status) {
+  Tablet* tablet = state()->tablet_peer()->tablet();
+  if (type() == consensus::REPLICA) {
+    // The leader only replicated the writes it could decode.
+    RETURN_NOT_OK(decode_status);
+    for (const auto& write : state_->coalesced_writes()) {
+      RETURN_NOT_OK(DecodeWrite(tablet, write.get(), state()));
+    }
+    return Status::OK();
+  }
+
+  // On the leader, each of the coalesced writes which can't be decoded fails
+  // on its own, without failing the others.
+  vector<WriteTransactionState*> writes;
+  for (const auto& write : state_->coalesced_writes()) {
+    writes.push_back(write.get());
+  }
+  for (WriteTransactionState* write : writes) {
+    if (!DecodeWrite(tablet, write, state()).ok()) {
+      state_->FailCoalescedWrite(write);
+    }
+  }
+  const auto& decoded_writes = state_->coalesced_writes();
+  if (decoded_writes.empty()) {
+    return decode_status;
+  }
+  TRACE("PREPARE: coalesced $0 writes", decoded_writes.size());
+
+  // Neither does this write fail the others if it can't be decoded: it
+  // then goes along with them, with its error, and the first of them is
+  // replicated in its stead.
+  ConsensusRound* round = state()->consensus_round();
+  if (!round) { // sometimes NULL in tests
+    return Status::OK();
+  }
+  ReplicateMsg* msg = round->replicate_msg();
+  auto it = decoded_writes.begin();
+  if (!decode_status.ok()) {
+    msg->mutable_write_request()->CopyFrom(*(*it)->request());
+    if ((*it)->are_results_tracked()) {
+      msg->mutable_request_id()->CopyFrom((*it)->request_id());
+    } else {
+      msg->clear_request_id();
+    }
+    ++it;
+  }
+  msg->clear_coalesced_writes();
+  for (; it != decoded_writes.end(); ++it) {
+    consensus::CoalescedWritePB* write_pb = msg->add_coalesced_writes();
+    write_pb->mutable_write_request()->CopyFrom(*(*it)->request());
+    if ((*it)->are_results_tracked()) {
+      write_pb->mutable_request_id()->CopyFrom((*it)->request_id());
+    }
+    write_pb->set_num_row_ops((*it)->num_row_ops());
+  }
+  return Status::OK();
+}
+
 Status WriteTransaction::Start() {
   TRACE_EVENT0("txn", "WriteTransaction::Start");
   TRACE("Start()");
@@ -132,8 +219,10 @@ Status WriteTransaction::Apply(gscoped_ptr<CommitMsg>* commit_msg) {
     if (op->result->has_failed_status()) {
       // Replicas disregard the per row errors, for now
       // TODO check the per-row errors against the leader's, at least in debug mode
-      WriteResponsePB::PerRowErrorPB* error = state()->response()->add_per_row_errors();
-      error->set_row_index(i);
+      int row_idx;
+      WriteTransactionState* write = state()->WriteForRowOp(i, &row_idx);
+      WriteResponsePB::PerRowErrorPB* error = write->response()->add_per_row_errors();
+      error->set_row_index(row_idx);
       error->mutable_error()->CopyFrom(op->result->failed_status());
     }
 
@@ -151,8 +240,13 @@ Status WriteTransaction::Apply(gscoped_ptr<CommitMsg>* commit_msg) {
 
 void WriteTransaction::Finish(TransactionResult result) {
   TRACE_EVENT0("txn", "WriteTransaction::Finish");
+  state_->StopCoalescing();
 
+  MonoTime commit_start_time = MonoTime::Now(MonoTime::FINE);
   state()->CommitOrAbort(result);
+  uint64_t mvcc_commit_duration_usec =
+      MonoTime::Now(MonoTime::FINE).GetDeltaSince(commit_start_time).ToMicroseconds();
+  TRACE_COUNTER_INCREMENT("mvcc_commit_time_us", mvcc_commit_duration_usec);
 
   if (PREDICT_FALSE(result == Transaction::ABORTED)) {
     TRACE("FINISH: transaction aborted");
@@ -188,6 +282,15 @@ void WriteTransaction::Finish(TransactionResult result) {
         case UNKNOWN_EXTERNAL_CONSISTENCY_MODE:
           break;
       }
+
+      const TransactionMetrics& txn_metrics = state_->metrics();
+      metrics->write_op_prepare_queue_duration->Increment(
+          txn_metrics.prepare_queue_duration_usec);
+      metrics->write_op_prepare_duration->Increment(txn_metrics.prepare_duration_usec);
+      metrics->write_op_row_lock_duration->Increment(txn_metrics.row_lock_duration_usec);
+      metrics->write_op_replication_duration->Increment(txn_metrics.replication_duration_usec);
+      metrics->write_op_apply_duration->Increment(txn_metrics.apply_duration_usec);
+      metrics->write_op_mvcc_commit_duration->Increment(mvcc_commit_duration_usec);
     }
   }
 }
@@ -209,6 +312,9 @@ WriteTransactionState::WriteTransactionState(TabletPeer* tablet_peer,
   : TransactionState(tablet_peer),
     request_(DCHECK_NOTNULL(request)),
     response_(response),
+    first_row_op_(0),
+    num_row_ops_(0),
+    coalescing_stopped_(false),
     mvcc_tx_(nullptr),
     schema_at_decode_time_(nullptr) {
   external_consistency_mode_ = request_->external_consistency_mode();
@@ -220,6 +326,73 @@ WriteTransactionState::WriteTransactionState(TabletPeer* tablet_peer,
   }
 }
 
+void WriteTransactionState::AppendRowOps(WriteTransactionState* write,
+                                         vector<RowOp*>* new_ops) {
+  std::lock_guard<simple_spinlock> l(txn_state_lock_);
+  write->first_row_op_ = row_ops_.size();
+  write->num_row_ops_ = new_ops->size();
+  row_ops_.insert(row_ops_.end(), new_ops->begin(), new_ops->end());
+  new_ops->clear();
+}
+
+bool WriteTransactionState::TryCoalesce(unique_ptr<WriteTransactionState>* write,
+                                        int max_writes) {
+  std::lock_guard<simple_spinlock> l(txn_state_lock_);
+  if (coalescing_stopped_ || static_cast<int>(coalesced_writes_.size()) + 1 >= max_writes) {
+    return false;
+  }
+  coalesced_writes_.emplace_back(std::move(*write));
+  return true;
+}
+
+void WriteTransactionState::StopCoalescing() {
+  std::lock_guard<simple_spinlock> l(txn_state_lock_);
+  coalescing_stopped_ = true;
+}
+
+void WriteTransactionState::AddCoalescedWrite(unique_ptr<WriteTransactionState> write) {
+  std::lock_guard<simple_spinlock> l(txn_state_lock_);
+  coalesced_writes_.emplace_back(std::move(write));
+}
+
+void WriteTransactionState::FailCoalescedWrite(WriteTransactionState* write) {
+  unique_ptr<WriteTransactionState> failed;
+  {
+    std::lock_guard<simple_spinlock> l(txn_state_lock_);
+    auto it = std::find_if(coalesced_writes_.begin(), coalesced_writes_.end(),
+                           [&](const unique_ptr<WriteTransactionState>& w) {
+                             return w.get() == write;
+                           });
+    CHECK(it != coalesced_writes_.end());
+    failed = std::move(*it);
+    coalesced_writes_.erase(it);
+  }
+  DCHECK(failed->completion_callback()->has_error());
+  failed->completion_callback()->TransactionCompleted();
+}
+
+vector<TransactionState*> WriteTransactionState::coalesced_states() const {
+  std::lock_guard<simple_spinlock> l(txn_state_lock_);
+  vector<TransactionState*> states;
+  states.reserve(coalesced_writes_.size());
+  for (const auto& write : coalesced_writes_) {
+    states.push_back(write.get());
+  }
+  return states;
+}
+
+WriteTransactionState* WriteTransactionState::WriteForRowOp(int op_idx, int* row_idx) {
+  for (const auto& write : coalesced_writes_) {
+    if (op_idx >= write->first_row_op_ &&
+        op_idx < write->first_row_op_ + write->num_row_ops_) {
+      *row_idx = op_idx - write->first_row_op_;
+      return write.get();
+    }
+  }
+  *row_idx = op_idx - first_row_op_;
+  return this;
+}
+
 void WriteTransactionState::SetMvccTxAndTimestamp(gscoped_ptr<ScopedTransaction> mvcc_tx) {
   DCHECK(!mvcc_tx_) << "Mvcc transaction already started/set.";
   if (has_timestamp()) {
@@ -276,6 +449,9 @@ void WriteTransactionState::CommitOrAbort(Transaction::TransactionResult result)
   // That will delete the RPC request and response objects. So, NULL them here
   // so we don't read them again after they're deleted.
   ResetRpcFields();
+  for (const auto& write : coalesced_writes_) {
+    write->ResetRpcFields();
+  }
 }
 
 void WriteTransactionState::ReleaseTxResultPB(TxResultPB* result) const {
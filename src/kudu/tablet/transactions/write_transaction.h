@@ -18,6 +18,7 @@
 #ifndef KUDU_TABLET_WRITE_TRANSACTION_H_
 #define KUDU_TABLET_WRITE_TRANSACTION_H_
 
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -46,6 +47,7 @@ class WriteResponsePB;
 
 namespace tablet {
 struct RowOp;
+class RowSet;
 class RowSetKeyProbe;
 struct TabletComponents;
 
@@ -169,8 +171,67 @@ class WriteTransactionState : public TransactionState {
     row_ops_.swap(*new_ops);
   }
 
+  // Appends 'new_ops', decoded from the request of 'write', to the row
+  // operations of this transaction. 'write' is either this write or one
+  // coalesced into it.
+  void AppendRowOps(WriteTransactionState* write, std::vector<RowOp*>* new_ops);
+
+  // Coalesces 'write', a leader write which hasn't been submitted, into this
+  // one, so that the two are prepared, replicated and applied as a single
+  // transaction, under a single timestamp. Each of the writes keeps its own
+  // request, response, request id and completion callback.
+  //
+  // Returns false, leaving 'write' untouched, if this write has already
+  // started to be prepared or was aborted, or if 'max_writes' writes,
+  // including this one, are already coalesced into it.
+  bool TryCoalesce(std::unique_ptr<WriteTransactionState>* write, int max_writes);
+
+  // Stops any more writes from being coalesced into this one. Called once
+  // it starts to be prepared, or it's aborted.
+  void StopCoalescing();
+
+  // Adds 'write' to the writes which are coalesced into this one, for a
+  // replica or a replayed transaction whose ReplicateMsg has coalesced writes.
+  void AddCoalescedWrite(std::unique_ptr<WriteTransactionState> write);
+
+  // Completes 'write', one of the writes coalesced into this one, with the
+  // error it's already been given, and removes it from them. To be used when
+  // the write can't be prepared, so that it fails on its own.
+  void FailCoalescedWrite(WriteTransactionState* write);
+
+  // The writes coalesced into this one, in the order their row operations
+  // follow those of this write.
+  const std::vector<std::unique_ptr<WriteTransactionState>>& coalesced_writes() const {
+    return coalesced_writes_;
+  }
+
+  std::vector<TransactionState*> coalesced_states() const OVERRIDE;
+
+  // The number of row operations of this write, not counting those of the
+  // writes coalesced into it.
+  int num_row_ops() const {
+    return num_row_ops_;
+  }
+
+  // Returns the write which the row operation at 'op_idx' in row_ops() comes
+  // from, either this one or one coalesced into it, and sets '*row_idx' to the
+  // index of the operation among the row operations of its write.
+  WriteTransactionState* WriteForRowOp(int op_idx, int* row_idx);
+
+  // Whether the schema lock is held, see AcquireSchemaLock().
+  bool has_schema_lock() const {
+    return schema_lock_.owns_lock();
+  }
+
   void UpdateMetricsForOp(const RowOp& op);
 
+  // Scratch space for the rowsets that the row operation being applied must
+  // be checked against, reused from one operation to the next so that
+  // looking them up doesn't allocate once the vector has grown.
+  std::vector<RowSet*>* rowsets_to_check_scratch() {
+    return &rowsets_to_check_scratch_;
+  }
+
   // Resets this TransactionState, releasing all locks, destroying all prepared
   // writes, clearing the transaction result _and_ committing the current Mvcc
   // transaction.
@@ -196,10 +257,24 @@ class WriteTransactionState : public TransactionState {
   const tserver::WriteRequestPB* request_;
   tserver::WriteResponsePB* response_;
 
-  // The row operations which are decoded from the request during PREPARE
+  // The row operations which are decoded from the request during PREPARE,
+  // followed by those of the writes coalesced into this one, if any.
   // Protected by superclass's txn_state_lock_.
   std::vector<RowOp*> row_ops_;
 
+  // The index in the row operations of the transaction of the first of those
+  // of this write, and their number. See AppendRowOps().
+  int first_row_op_;
+  int num_row_ops_;
+
+  // See TryCoalesce(). Protected by superclass's txn_state_lock_ until
+  // StopCoalescing() is called.
+  std::vector<std::unique_ptr<WriteTransactionState>> coalesced_writes_;
+  bool coalescing_stopped_;
+
+  // See rowsets_to_check_scratch(). Only used while applying.
+  std::vector<RowSet*> rowsets_to_check_scratch_;
+
   // The MVCC transaction, set up during PREPARE phase
   gscoped_ptr<ScopedTransaction> mvcc_tx_;
 
@@ -266,6 +341,12 @@ class WriteTransaction : public Transaction {
   virtual std::string ToString() const OVERRIDE;
 
  private:
+  // Decodes the writes coalesced into this one, once this one has been
+  // decoded with 'decode_status'. On the leader, the coalesced writes which
+  // fail to decode are completed with their errors and dropped, and the
+  // others are added to the ReplicateMsg.
+  Status DecodeCoalescedWrites(const Status& decode_status);
+
   // this transaction's start time
   MonoTime start_time_;
 
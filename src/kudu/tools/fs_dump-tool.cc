@@ -45,6 +45,13 @@ DEFINE_bool(metadata_only, false, "Whether just to dump the block metadata, "
 
 DEFINE_bool(headers_only, false, "Don't dump contents, dump headers only");
 
+DEFINE_uint64(export_snapshot_timestamp, 0,
+              "Hybrid time as of which export_tablet_data exports the data. "
+              "If 0, all of the data on disk is exported.");
+DEFINE_int32(export_threads, 4,
+             "Number of threads with which export_tablet_data exports the "
+             "columns of the rowsets in parallel.");
+
 namespace kudu {
 namespace tools {
 
@@ -57,6 +64,7 @@ namespace {
 enum CommandType {
   DUMP_TABLET_BLOCKS,
   DUMP_TABLET_DATA,
+  EXPORT_TABLET_DATA,
   DUMP_ROWSET,
   DUMP_CFILE_BLOCK,
   PRINT_TABLET_META,
@@ -75,6 +83,9 @@ struct CommandHandler {
 const vector<CommandHandler> kCommandHandlers = {
     CommandHandler(DUMP_TABLET_DATA, "dump_tablet_data",
                    "Dump a tablet's data (requires a tablet id)"),
+    CommandHandler(EXPORT_TABLET_DATA, "export_tablet_data",
+                   "Export a tablet's data as raw column files (requires a tablet id "
+                   "and an output directory)"),
     CommandHandler(DUMP_TABLET_BLOCKS, "dump_tablet_blocks",
                    "Dump a tablet's constituent blocks (requires a tablet id)"),
     CommandHandler(DUMP_ROWSET, "dump_rowset",
@@ -159,6 +170,19 @@ static int FsDumpToolMain(int argc, char** argv) {
       break;
     }
 
+    case EXPORT_TABLET_DATA: {
+      if (argc < 4) {
+        Usage(argv[0],
+              Substitute("export_tablet_data requires tablet id and output directory: $0 "
+                         "export_tablet_data <tablet_id> <output_dir>",
+                         argv[0]));
+        return 2;
+      }
+      CHECK_OK(fs_tool.ExportTabletData(argv[2], argv[3], FLAGS_export_snapshot_timestamp,
+                                        FLAGS_export_threads));
+      break;
+    }
+
     case DUMP_ROWSET: {
       if (argc < 4) {
         Usage(argv[0],
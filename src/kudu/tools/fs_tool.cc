@@ -37,12 +37,17 @@
 #include "kudu/gutil/strings/util.h"
 #include "kudu/tablet/cfile_set.h"
 #include "kudu/tablet/deltafile.h"
+#include "kudu/tablet/diskrowset.h"
 #include "kudu/tablet/tablet.h"
+#include "kudu/util/coding.h"
 #include "kudu/util/env.h"
+#include "kudu/util/env_util.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/memory/arena.h"
+#include "kudu/util/path_util.h"
 #include "kudu/util/status.h"
+#include "kudu/util/threadpool.h"
 
 namespace kudu {
 namespace tools {
@@ -64,6 +69,7 @@ using tablet::DeltaFileReader;
 using tablet::DeltaIterator;
 using tablet::DeltaKeyAndUpdate;
 using tablet::DeltaType;
+using tablet::DiskRowSet;
 using tablet::MvccSnapshot;
 using tablet::RowSetMetadata;
 using tablet::Tablet;
@@ -114,30 +120,31 @@ Status FsTool::FsTree() {
 Status FsTool::ListAllLogSegments() {
   DCHECK(initialized_);
 
-  string wals_dir = fs_manager_->GetWalsRootDir();
-  if (!fs_manager_->Exists(wals_dir)) {
-    return Status::Corruption(Substitute(
-        "root log directory '$0' does not exist", wals_dir));
-  }
+  for (const string& wals_dir : fs_manager_->GetWalsRootDirs()) {
+    if (!fs_manager_->Exists(wals_dir)) {
+      return Status::Corruption(Substitute(
+          "root log directory '$0' does not exist", wals_dir));
+    }
 
-  std::cout << "Root log directory: " << wals_dir << std::endl;
+    std::cout << "Root log directory: " << wals_dir << std::endl;
 
-  vector<string> children;
-  RETURN_NOT_OK_PREPEND(fs_manager_->ListDir(wals_dir, &children),
-                        "Could not list log directories");
-  for (const string& child : children) {
-    if (HasPrefixString(child, ".")) {
-      // Hidden files or ./..
-      VLOG(1) << "Ignoring hidden file in root log directory " << child;
-      continue;
-    }
-    string path = JoinPathSegments(wals_dir, child);
-    if (HasSuffixString(child, FsManager::kWalsRecoveryDirSuffix)) {
-      std::cout << "Log recovery dir found: " << path << std::endl;
-    } else {
-      std::cout << "Log directory: " << path << std::endl;
+    vector<string> children;
+    RETURN_NOT_OK_PREPEND(fs_manager_->ListDir(wals_dir, &children),
+                          "Could not list log directories");
+    for (const string& child : children) {
+      if (HasPrefixString(child, ".")) {
+        // Hidden files or ./..
+        VLOG(1) << "Ignoring hidden file in root log directory " << child;
+        continue;
+      }
+      string path = JoinPathSegments(wals_dir, child);
+      if (HasSuffixString(child, FsManager::kWalsRecoveryDirSuffix)) {
+        std::cout << "Log recovery dir found: " << path << std::endl;
+      } else {
+        std::cout << "Log directory: " << path << std::endl;
+      }
+      RETURN_NOT_OK(ListSegmentsInDir(path));
     }
-    RETURN_NOT_OK(ListSegmentsInDir(path));
   }
   return Status::OK();
 }
@@ -347,6 +354,147 @@ Status FsTool::DumpTabletData(const std::string& tablet_id) {
   return Status::OK();
 }
 
+namespace {
+
+// Writes the values of the only column of 'projection' in 'rowset', as of
+// 'snap', to 'path' in the format described for ExportTabletData(). Returns
+// the number of rows written in 'num_rows'.
+Status ExportColumn(const shared_ptr<DiskRowSet>& rowset,
+                    const Schema& projection,
+                    const MvccSnapshot& snap,
+                    const string& path,
+                    int64_t* num_rows) {
+  const ColumnSchema& col = projection.column(0);
+  bool is_binary = col.type_info()->physical_type() == BINARY;
+  size_t cell_size = col.type_info()->size();
+
+  gscoped_ptr<RowwiseIterator> iter;
+  RETURN_NOT_OK(rowset->NewRowIterator(&projection, snap, &iter));
+  RETURN_NOT_OK(iter->Init(nullptr));
+
+  gscoped_ptr<WritableFile> out;
+  RETURN_NOT_OK(Env::Default()->NewWritableFile(path, &out));
+
+  const size_t kFlushBytes = 1024 * 1024;
+  Arena arena(32 * 1024, 4 * 1024 * 1024);
+  RowBlock block(projection, 1024, &arena);
+  faststring buf;
+  *num_rows = 0;
+  while (iter->HasNext()) {
+    arena.Reset();
+    RETURN_NOT_OK(iter->NextBlock(&block));
+    ColumnBlock cblock = block.column_block(0);
+    for (size_t i = 0; i < block.nrows(); i++) {
+      if (!block.selection_vector()->IsRowSelected(i)) continue;
+      (*num_rows)++;
+      if (col.is_nullable()) {
+        bool is_null = cblock.is_null(i);
+        buf.push_back(is_null ? 1 : 0);
+        if (is_null) continue;
+      }
+      const uint8_t* cell = cblock.cell_ptr(i);
+      if (is_binary) {
+        const Slice* slice = reinterpret_cast<const Slice*>(cell);
+        PutFixed32LengthPrefixedSlice(&buf, *slice);
+      } else {
+        buf.append(cell, cell_size);
+      }
+    }
+    if (buf.size() >= kFlushBytes) {
+      RETURN_NOT_OK(out->Append(buf));
+      buf.clear();
+    }
+  }
+  RETURN_NOT_OK(out->Append(buf));
+  return out->Close();
+}
+
+} // anonymous namespace
+
+Status FsTool::ExportTabletData(const string& tablet_id,
+                                const string& output_dir,
+                                uint64_t snapshot_timestamp,
+                                int num_threads) {
+  DCHECK(initialized_);
+
+  scoped_refptr<TabletMetadata> meta;
+  RETURN_NOT_OK(TabletMetadata::Load(fs_manager_.get(), tablet_id, &meta));
+  const Schema& schema = meta->schema();
+  MvccSnapshot snap = snapshot_timestamp == 0 ?
+      MvccSnapshot::CreateSnapshotIncludingAllTransactions() :
+      MvccSnapshot(Timestamp(snapshot_timestamp));
+
+  Env* env = Env::Default();
+  RETURN_NOT_OK_PREPEND(env_util::CreateDirIfMissing(env, output_dir),
+                        "Couldn't create the output directory");
+  RETURN_NOT_OK(WriteStringToFile(env, schema.ToString() + "\n",
+                                  JoinPathSegments(output_dir, "schema")));
+
+  scoped_refptr<log::LogAnchorRegistry> reg(new log::LogAnchorRegistry());
+  vector<shared_ptr<DiskRowSet>> rowsets;
+  for (const shared_ptr<RowSetMetadata>& rs_meta : meta->rowsets()) {
+    shared_ptr<DiskRowSet> rowset;
+    RETURN_NOT_OK_PREPEND(DiskRowSet::Open(rs_meta, reg.get(), &rowset),
+                          Substitute("Couldn't open rowset $0", rs_meta->id()));
+    rowsets.push_back(std::move(rowset));
+  }
+
+  // Export each column of each rowset on its own.
+  struct Task {
+    shared_ptr<DiskRowSet> rowset;
+    gscoped_ptr<Schema> projection;
+    string path;
+    Status status;
+    int64_t num_rows;
+  };
+  vector<Task> tasks(rowsets.size() * schema.num_columns());
+  gscoped_ptr<ThreadPool> pool;
+  RETURN_NOT_OK(ThreadPoolBuilder("export")
+                .set_max_threads(num_threads)
+                .Build(&pool));
+  for (int r = 0; r < rowsets.size(); r++) {
+    for (int c = 0; c < schema.num_columns(); c++) {
+      Task* task = &tasks[r * schema.num_columns() + c];
+      task->rowset = rowsets[r];
+      task->projection.reset(new Schema({ schema.column(c) }, { schema.column_id(c) }, 0));
+      task->path = JoinPathSegments(
+          output_dir, Substitute("rowset-$0.col-$1", rowsets[r]->metadata()->id(),
+                                 schema.column_id(c)));
+      task->num_rows = 0;
+      CHECK_OK(pool->SubmitFunc([task, &snap]() {
+            task->status = ExportColumn(task->rowset, *task->projection, snap,
+                                        task->path, &task->num_rows);
+          }));
+    }
+  }
+  pool->Wait();
+
+  // All the columns of a rowset are read in row order at the same snapshot,
+  // so they have the same number of rows, which the manifest records.
+  string manifest;
+  int64_t total_rows = 0;
+  for (int r = 0; r < rowsets.size(); r++) {
+    int64_t rowset_rows = -1;
+    for (int c = 0; c < schema.num_columns(); c++) {
+      const Task& task = tasks[r * schema.num_columns() + c];
+      RETURN_NOT_OK_PREPEND(task.status, Substitute("Couldn't export $0", task.path));
+      if (rowset_rows == -1) {
+        rowset_rows = task.num_rows;
+      } else if (rowset_rows != task.num_rows) {
+        return Status::Corruption(Substitute("$0 has $1 rows instead of $2",
+                                             task.path, task.num_rows, rowset_rows));
+      }
+    }
+    manifest += Substitute("rowset $0 rows $1\n", rowsets[r]->metadata()->id(),
+                           std::max<int64_t>(rowset_rows, 0));
+    total_rows += std::max<int64_t>(rowset_rows, 0);
+  }
+  RETURN_NOT_OK(WriteStringToFile(env, manifest, JoinPathSegments(output_dir, "manifest")));
+  LOG(INFO) << Substitute("Exported $0 rows from $1 rowsets of tablet $2 to $3",
+                          total_rows, rowsets.size(), tablet_id, output_dir);
+  return Status::OK();
+}
+
 Status FsTool::DumpRowSet(const string& tablet_id,
                           int64_t rowset_id,
                           const DumpOptions& opts,
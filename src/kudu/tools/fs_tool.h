@@ -107,6 +107,25 @@ class FsTool {
   // with those rows.
   Status DumpTabletData(const std::string& tablet_id);
 
+  // Exports the data of a tablet's disk rowsets into 'output_dir', using up
+  // to 'num_threads' threads to export the rowsets and their columns in
+  // parallel. The deltas are applied as of the hybrid time
+  // 'snapshot_timestamp', or all of them if it's 0. Data which is only in the
+  // WAL, i.e. which wasn't flushed yet, isn't exported.
+  //
+  // Each column of each rowset is written to its own file, named
+  // 'rowset-<rowset id>.col-<column id>', holding the column's values one
+  // after the other in row order: the values of nullable columns are preceded
+  // by a byte which is 1 if the value is null, in which case it's omitted;
+  // binary values are prefixed by their length as a little-endian 32-bit
+  // integer, and other values are stored in their little-endian in-memory
+  // format. The 'schema' file describes the columns and the 'manifest' file
+  // lists the number of rows of each rowset.
+  Status ExportTabletData(const std::string& tablet_id,
+                          const std::string& output_dir,
+                          uint64_t snapshot_timestamp,
+                          int num_threads);
+
   // Dumps column blocks, all types of delta blocks for a given
   // rowset.
   Status DumpRowSet(const std::string& tablet_id,
@@ -59,6 +59,9 @@ DEFINE_uint64(checksum_snapshot_timestamp, ChecksumOptions::kCurrentTimestamp,
 
 DEFINE_int32(fetch_replica_info_concurrency, 20,
              "Number of concurrent tablet servers to fetch replica info from.");
+DEFINE_int32(fetch_tablets_list_concurrency, 20,
+             "Number of tables whose lists of tablets are fetched from the master "
+             "concurrently.");
 
 // The stream to write output to. If this is NULL, defaults to cerr.
 // This is used by tests to capture output.
@@ -127,10 +130,28 @@ Status KsckCluster::FetchTableAndTabletInfo() {
   RETURN_NOT_OK(master_->Connect());
   RETURN_NOT_OK(RetrieveTablesList());
   RETURN_NOT_OK(RetrieveTabletServers());
+
+  // Each table takes at least one round trip to the master, so fetch the
+  // tablets of many tables at once.
+  gscoped_ptr<ThreadPool> pool;
+  RETURN_NOT_OK(ThreadPoolBuilder("ksck-tablets")
+                .set_max_threads(FLAGS_fetch_tablets_list_concurrency)
+                .Build(&pool));
+  simple_spinlock lock;
+  Status first_error;
   for (const shared_ptr<KsckTable>& table : tables()) {
-    RETURN_NOT_OK(RetrieveTabletsList(table));
+    CHECK_OK(pool->SubmitFunc([&]() {
+          Status s = RetrieveTabletsList(table);
+          if (!s.ok()) {
+            std::lock_guard<simple_spinlock> l(lock);
+            if (first_error.ok()) {
+              first_error = s;
+            }
+          }
+        }));
   }
-  return Status::OK();
+  pool->Wait();
+  return first_error;
 }
 
 // Gets the list of tablet servers from the Master.
@@ -486,10 +507,15 @@ Status Ksck::ChecksumData(const ChecksumOptions& opts) {
   int num_errors = 0;
   int num_mismatches = 0;
   int num_results = 0;
+  int num_consistent_tablets = 0;
+  int num_mismatched_tablets = 0;
+  int num_unchecked_tablets = 0;
   for (const shared_ptr<KsckTable>& table : cluster_->tables()) {
     bool printed_table_name = false;
     for (const shared_ptr<KsckTablet>& tablet : table->tablets()) {
       if (ContainsKey(checksums, tablet->id())) {
+        int tablet_errors = num_errors;
+        int tablet_mismatches = num_mismatches;
         if (!printed_table_name) {
           printed_table_name = true;
           cout << "-----------------------" << endl;
@@ -523,10 +549,22 @@ Status Ksck::ChecksumData(const ChecksumOptions& opts) {
           }
           num_results++;
         }
+        if (num_mismatches > tablet_mismatches) {
+          num_mismatched_tablets++;
+        } else if (num_errors > tablet_errors) {
+          num_unchecked_tablets++;
+        } else {
+          num_consistent_tablets++;
+        }
       }
     }
     if (printed_table_name) cout << endl;
   }
+  Info() << Substitute("Checksummed $0 tablet(s): $1 consistent, $2 with mismatched replicas, "
+                       "$3 with replicas that couldn't be checksummed",
+                       num_consistent_tablets + num_mismatched_tablets + num_unchecked_tablets,
+                       num_consistent_tablets, num_mismatched_tablets,
+                       num_unchecked_tablets) << endl;
   if (timed_out) {
     return Status::TimedOut(Substitute("Checksum scan did not complete within the timeout of $0: "
                                        "Received results for $1 out of $2 expected replicas",
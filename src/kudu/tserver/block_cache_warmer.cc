@@ -0,0 +1,210 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/tserver/block_cache_warmer.h"
+
+#include <algorithm>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+#include <utility>
+#include <vector>
+
+#include "kudu/cfile/block_cache.h"
+#include "kudu/cfile/cfile.pb.h"
+#include "kudu/cfile/cfile_reader.h"
+#include "kudu/fs/block_manager.h"
+#include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/tserver/ts_tablet_manager.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/pb_util.h"
+#include "kudu/util/stopwatch.h"
+#include "kudu/util/thread.h"
+#include "kudu/util/throttler.h"
+
+DEFINE_int32(block_cache_keys_dump_interval_secs, 0,
+             "How often the tablet server records the keys of the blocks in "
+             "the block cache, so that it can read them back into the cache "
+             "after a restart. If 0, the block cache is neither recorded nor "
+             "warmed.");
+TAG_FLAG(block_cache_keys_dump_interval_secs, experimental);
+
+DEFINE_int64(block_cache_keys_max_entries, 1024 * 1024,
+             "Maximum number of block cache keys recorded in each dump.");
+TAG_FLAG(block_cache_keys_max_entries, experimental);
+
+DEFINE_int32(block_cache_warmup_mb_per_sec, 64,
+             "Maximum rate at which blocks are read back into the block cache "
+             "after a restart. If 0, the rate is unlimited.");
+TAG_FLAG(block_cache_warmup_mb_per_sec, experimental);
+
+using kudu::cfile::BlockCache;
+using kudu::cfile::BlockCacheKeysPB;
+using kudu::cfile::CFileReader;
+using kudu::cfile::ReaderOptions;
+using kudu::fs::ReadableBlock;
+using std::pair;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+namespace tserver {
+
+BlockCacheWarmer::BlockCacheWarmer(FsManager* fs_manager, TSTabletManager* tablet_manager)
+    : fs_manager_(fs_manager),
+      tablet_manager_(tablet_manager),
+      cond_(&lock_),
+      shutdown_(false) {
+}
+
+BlockCacheWarmer::~BlockCacheWarmer() {
+  Shutdown();
+}
+
+Status BlockCacheWarmer::Start() {
+  if (FLAGS_block_cache_keys_dump_interval_secs <= 0) {
+    return Status::OK();
+  }
+  return Thread::Create("tserver", "block-cache-warmer",
+                        &BlockCacheWarmer::RunThread, this, &thread_);
+}
+
+void BlockCacheWarmer::Shutdown() {
+  {
+    MutexLock l(lock_);
+    if (shutdown_) {
+      return;
+    }
+    shutdown_ = true;
+    cond_.Broadcast();
+  }
+  if (thread_) {
+    CHECK_OK(ThreadJoiner(thread_.get()).Join());
+    WARN_NOT_OK(DumpKeys(), "Unable to record the block cache keys");
+  }
+}
+
+bool BlockCacheWarmer::WaitForShutdown(const MonoDelta& delta) {
+  MutexLock l(lock_);
+  if (!shutdown_) {
+    cond_.TimedWait(delta);
+  }
+  return shutdown_;
+}
+
+void BlockCacheWarmer::RunThread() {
+  // Warm the cache once the tablets are open, since their blocks are only
+  // read once they are.
+  WARN_NOT_OK(tablet_manager_->WaitForAllBootstrapsToFinish(),
+              "Not all tablets were opened");
+  LOG_TIMING(INFO, "warming the block cache") {
+    WARN_NOT_OK(WarmCache(), "Unable to warm the block cache");
+  }
+
+  MonoDelta interval = MonoDelta::FromSeconds(FLAGS_block_cache_keys_dump_interval_secs);
+  while (!WaitForShutdown(interval)) {
+    WARN_NOT_OK(DumpKeys(), "Unable to record the block cache keys");
+  }
+}
+
+Status BlockCacheWarmer::DumpKeys() {
+  vector<pair<BlockCache::CacheKey, size_t> > entries;
+  BlockCache::GetSingleton()->ListEntries(FLAGS_block_cache_keys_max_entries, &entries);
+
+  BlockCacheKeysPB pb;
+  for (const auto& entry : entries) {
+    BlockCacheKeysPB::EntryPB* entry_pb = pb.add_entries();
+    entry_pb->set_block_id(entry.first.file_id_);
+    entry_pb->set_offset(entry.first.offset_);
+    entry_pb->set_cached_size(entry.second);
+  }
+  VLOG(1) << Substitute("Recording $0 block cache keys", pb.entries_size());
+  return pb_util::WritePBContainerToPath(fs_manager_->env(),
+                                         fs_manager_->GetBlockCacheKeysPath(),
+                                         pb, pb_util::OVERWRITE, pb_util::NO_SYNC);
+}
+
+Status BlockCacheWarmer::WarmCache() {
+  string path = fs_manager_->GetBlockCacheKeysPath();
+  if (!fs_manager_->Exists(path)) {
+    return Status::OK();
+  }
+  BlockCacheKeysPB pb;
+  RETURN_NOT_OK(pb_util::ReadPBContainerFromPath(fs_manager_->env(), path, &pb));
+
+  // Read the blocks of each cfile in order, opening it once.
+  std::sort(pb.mutable_entries()->begin(), pb.mutable_entries()->end(),
+            [](const BlockCacheKeysPB::EntryPB& a, const BlockCacheKeysPB::EntryPB& b) {
+              return std::make_pair(a.block_id(), a.offset()) <
+                  std::make_pair(b.block_id(), b.offset());
+            });
+
+  const uint64_t byte_rate = FLAGS_block_cache_warmup_mb_per_sec * 1024L * 1024L;
+  // A burst factor of 10 allows up to a second's worth of bytes at a time.
+  Throttler throttler(MonoTime::Now(MonoTime::FINE), 0, byte_rate, 10);
+
+  gscoped_ptr<CFileReader> reader;
+  BlockId reader_block_id;
+  int num_warmed = 0;
+  for (const BlockCacheKeysPB::EntryPB& entry : pb.entries()) {
+    BlockId block_id(entry.block_id());
+    if (reader_block_id != block_id) {
+      reader_block_id = block_id;
+      reader.reset();
+      gscoped_ptr<ReadableBlock> block;
+      Status s = fs_manager_->OpenBlock(block_id, &block);
+      if (s.ok()) {
+        s = CFileReader::Open(std::move(block), ReaderOptions(), &reader);
+      }
+      if (!s.ok()) {
+        // The block may have been deleted since the keys were recorded.
+        VLOG(1) << "Not warming blocks of " << block_id.ToString() << ": " << s.ToString();
+        reader.reset();
+      }
+    }
+    if (!reader) {
+      continue;
+    }
+
+    uint64_t bytes = byte_rate > 0 ? std::min(entry.cached_size(), byte_rate) : 0;
+    while (!throttler.Take(MonoTime::Now(MonoTime::FINE), 0, bytes)) {
+      if (WaitForShutdown(MonoDelta::FromMilliseconds(10))) {
+        return Status::Aborted("shutting down");
+      }
+    }
+    {
+      MutexLock l(lock_);
+      if (shutdown_) {
+        return Status::Aborted("shutting down");
+      }
+    }
+    Status s = reader->WarmBlock(entry.offset(), entry.cached_size());
+    if (s.ok()) {
+      num_warmed++;
+    } else {
+      VLOG(1) << "Unable to warm block at offset " << entry.offset() << " of "
+              << block_id.ToString() << ": " << s.ToString();
+    }
+  }
+  LOG(INFO) << Substitute("Read $0 of $1 blocks into the block cache",
+                          num_warmed, pb.entries_size());
+  return Status::OK();
+}
+
+} // namespace tserver
+} // namespace kudu
@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_TSERVER_BLOCK_CACHE_WARMER_H
+#define KUDU_TSERVER_BLOCK_CACHE_WARMER_H
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/mutex.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class FsManager;
+class Thread;
+
+namespace tserver {
+
+class TSTabletManager;
+
+// Component of the Tablet Server which keeps the block cache warm across
+// restarts. It periodically records the keys of the cached blocks, but not
+// their data, under the FsManager's metadata root. Once the tablets have been
+// opened after a restart, it reads the recorded blocks back into the cache in
+// the background, at a limited rate.
+//
+// Enabled by --block_cache_keys_dump_interval_secs.
+class BlockCacheWarmer {
+ public:
+  BlockCacheWarmer(FsManager* fs_manager, TSTabletManager* tablet_manager);
+  ~BlockCacheWarmer();
+
+  // Start the background thread, if enabled.
+  Status Start();
+
+  // Stop the background thread, recording the keys of the cached blocks one
+  // last time.
+  void Shutdown();
+
+  // Record the keys of the cached blocks.
+  Status DumpKeys();
+
+  // Read the blocks recorded by the last DumpKeys() into the cache.
+  // Returns early if shut down.
+  Status WarmCache();
+
+ private:
+  void RunThread();
+
+  // Waits for 'delta', returning true if shut down in the meantime.
+  bool WaitForShutdown(const MonoDelta& delta);
+
+  FsManager* const fs_manager_;
+  TSTabletManager* const tablet_manager_;
+
+  // Protects 'shutdown_'.
+  Mutex lock_;
+  ConditionVariable cond_;
+  bool shutdown_;
+
+  scoped_refptr<Thread> thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(BlockCacheWarmer);
+};
+
+} // namespace tserver
+} // namespace kudu
+#endif
@@ -54,6 +54,13 @@ DEFINE_int32(heartbeat_max_failures_before_backoff, 3,
              "rather than retrying.");
 TAG_FLAG(heartbeat_max_failures_before_backoff, advanced);
 
+DEFINE_int32(heartbeat_tablet_statistics_interval_ms, 60000,
+             "Interval at which the TS sends the column statistics of the "
+             "tablets it leads to the master, with its heartbeats. The "
+             "statistics only change with flushes and compactions, so there's "
+             "no point in sending them often. If 0 or less, they aren't sent.");
+TAG_FLAG(heartbeat_tablet_statistics_interval_ms, advanced);
+
 using google::protobuf::RepeatedPtrField;
 using kudu::HostPortPB;
 using kudu::consensus::RaftPeerPB;
@@ -176,6 +183,10 @@ class Heartbeater::Thread {
   // the thread detects that the master has been elected leader.
   bool send_full_tablet_report_;
 
+  // The last time the column statistics of the tablets were sent. Only
+  // accessed by the heartbeat thread.
+  MonoTime last_tablet_statistics_time_;
+
   DISALLOW_COPY_AND_ASSIGN(Thread);
 };
 
@@ -331,6 +342,13 @@ int Heartbeater::Thread::GetMinimumHeartbeatMillis() const {
 }
 
 int Heartbeater::Thread::GetMillisUntilNextHeartbeat() const {
+  // If the master was too busy to process our full tablet report, it tells
+  // us how long to wait before sending it again.
+  if (last_hb_response_.has_full_tablet_report_retry_ms() &&
+      !last_hb_response_.needs_reregister()) {
+    return last_hb_response_.full_tablet_report_retry_ms();
+  }
+
   // If the master needs something from us, we should immediately
   // send another heartbeat with that info, rather than waiting for the interval.
   if (last_hb_response_.needs_reregister() ||
@@ -382,6 +400,22 @@ Status Heartbeater::Thread::DoHeartbeat() {
     GenerateIncrementalTabletReport(req.mutable_tablet_report());
   }
   req.set_num_live_tablets(server_->tablet_manager()->GetNumLiveTablets());
+  server_->tablet_manager()->GetLoad(req.mutable_load());
+
+  // Send the column statistics periodically. Masters which aren't the leader
+  // ignore them.
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  bool send_tablet_statistics = FLAGS_heartbeat_tablet_statistics_interval_ms > 0 &&
+      (!last_tablet_statistics_time_.Initialized() ||
+       now.GetDeltaSince(last_tablet_statistics_time_).ToMilliseconds() >=
+           FLAGS_heartbeat_tablet_statistics_interval_ms);
+  if (send_tablet_statistics) {
+    vector<master::TabletStatisticsPB> tablet_stats;
+    server_->tablet_manager()->GetTabletStatistics(&tablet_stats);
+    for (master::TabletStatisticsPB& stats : tablet_stats) {
+      req.add_tablet_statistics()->Swap(&stats);
+    }
+  }
 
   RpcController rpc;
   rpc.set_timeout(MonoDelta::FromMilliseconds(FLAGS_heartbeat_rpc_timeout_ms));
@@ -407,6 +441,9 @@ Status Heartbeater::Thread::DoHeartbeat() {
 
   last_hb_response_.Swap(&resp);
 
+  if (send_tablet_statistics) {
+    last_tablet_statistics_time_ = now;
+  }
   MarkTabletReportAcknowledged(req.tablet_report());
   return Status::OK();
 }
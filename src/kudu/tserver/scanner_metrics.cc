@@ -24,6 +24,12 @@ METRIC_DEFINE_counter(server, scanners_expired,
                       kudu::MetricUnit::kScanners,
                       "Number of scanners that have expired since service start");
 
+METRIC_DEFINE_counter(server, scanners_rejected,
+                      "Scanners Rejected",
+                      kudu::MetricUnit::kScanners,
+                      "Number of new scans rejected since service start because the "
+                      "limits on active scanners or on their memory were reached");
+
 METRIC_DEFINE_histogram(server, scanner_duration,
                         "Scanner Duration",
                         kudu::MetricUnit::kMicroseconds,
@@ -37,6 +43,8 @@ namespace tserver {
 ScannerMetrics::ScannerMetrics(const scoped_refptr<MetricEntity>& metric_entity)
     : scanners_expired(
           METRIC_scanners_expired.Instantiate(metric_entity)),
+      scanners_rejected(
+          METRIC_scanners_rejected.Instantiate(metric_entity)),
       scanner_duration(METRIC_scanner_duration.Instantiate(metric_entity)) {
 }
 
@@ -41,6 +41,10 @@ struct ScannerMetrics {
   // expired since the start of service.
   scoped_refptr<Counter> scanners_expired;
 
+  // Keeps track of the total number of new scans that have been
+  // rejected by admission control since the start of service.
+  scoped_refptr<Counter> scanners_rejected;
+
   // Keeps track of the duration of scanners.
   scoped_refptr<Histogram> scanner_duration;
 };
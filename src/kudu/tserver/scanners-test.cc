@@ -21,9 +21,12 @@
 #include <gtest/gtest.h>
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/scanner_metrics.h"
+#include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(scanner_max_active);
+DECLARE_int64(scanner_memory_limit_mb);
 DECLARE_int32(scanner_ttl_ms);
 
 namespace kudu {
@@ -40,8 +43,8 @@ TEST(ScannersTest, TestManager) {
 
   // Create two scanners, make sure their ids are different.
   SharedScanner s1, s2;
-  mgr.NewScanner(null_peer, "", &s1);
-  mgr.NewScanner(null_peer, "", &s2);
+  ASSERT_OK(mgr.NewScanner(null_peer, "", &s1));
+  ASSERT_OK(mgr.NewScanner(null_peer, "", &s2));
   ASSERT_NE(s1->id(), s2->id());
 
   // Check that they're both registered.
@@ -69,8 +72,8 @@ TEST(ScannerTest, TestExpire) {
   MetricRegistry registry;
   ScannerManager mgr(METRIC_ENTITY_server.Instantiate(&registry, "test"));
   SharedScanner s1, s2;
-  mgr.NewScanner(null_peer, "", &s1);
-  mgr.NewScanner(null_peer, "", &s2);
+  ASSERT_OK(mgr.NewScanner(null_peer, "", &s1));
+  ASSERT_OK(mgr.NewScanner(null_peer, "", &s2));
   SleepFor(MonoDelta::FromMilliseconds(200));
   s2->UpdateAccessTime();
   mgr.RemoveExpiredScanners();
@@ -81,5 +84,42 @@ TEST(ScannerTest, TestExpire) {
   ASSERT_EQ(s2->id(), active_scanners[0]->id());
 }
 
+TEST(ScannerTest, TestAdmissionControl) {
+  scoped_refptr<TabletPeer> null_peer(nullptr);
+  MetricRegistry registry;
+  ScannerManager mgr(METRIC_ENTITY_server.Instantiate(&registry, "test"));
+
+  // The scanners of one table may only take half of the active slots.
+  FLAGS_scanner_max_active = 4;
+  SharedScanner s1, s2, s3;
+  ASSERT_OK(mgr.NewScanner(null_peer, "", &s1));
+  ASSERT_OK(mgr.NewScanner(null_peer, "", &s2));
+  Status s = mgr.NewScanner(null_peer, "", &s3);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_EQ(1, mgr.metrics_->scanners_rejected->value());
+  ASSERT_EQ(2, mgr.CountActiveScanners());
+
+  // Unregistering a scanner frees its slot.
+  ASSERT_TRUE(mgr.UnregisterScanner(s1->id()));
+  ASSERT_OK(mgr.NewScanner(null_peer, "", &s3));
+  FLAGS_scanner_max_active = 0;
+
+  // The scanners' arenas are charged to the scanners' tracker, and new scans
+  // are rejected once it is over the limit.
+  ASSERT_EQ(0, mgr.mem_tracker()->consumption());
+  s2->arena()->AllocateBytes(1024);
+  ASSERT_GT(mgr.mem_tracker()->consumption(), 0);
+  FLAGS_scanner_memory_limit_mb = 0;
+  s = mgr.NewScanner(null_peer, "", &s1);
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  FLAGS_scanner_memory_limit_mb = -1;
+
+  ASSERT_TRUE(mgr.UnregisterScanner(s2->id()));
+  ASSERT_TRUE(mgr.UnregisterScanner(s3->id()));
+  s2.reset();
+  s3.reset();
+  ASSERT_EQ(0, mgr.mem_tracker()->consumption());
+}
+
 } // namespace tserver
 } // namespace kudu
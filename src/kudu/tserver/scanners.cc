@@ -16,15 +16,21 @@
 // under the License.
 #include "kudu/tserver/scanners.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <mutex>
 
 #include "kudu/common/iterator.h"
+#include "kudu/common/rowblock.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/gutil/hash/string_hash.h"
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/strings/substitute.h"
 #include "kudu/tserver/scanner_metrics.h"
+#include "kudu/tserver/tserver.pb.h"
 #include "kudu/util/flag_tags.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/memory/memory.h"
 #include "kudu/util/thread.h"
 #include "kudu/util/metrics.h"
 
@@ -36,6 +42,34 @@ DEFINE_int32(scanner_gc_check_interval_us, 5 * 1000L *1000L, // 5 seconds
              "Number of microseconds in the interval at which we remove expired scanners");
 TAG_FLAG(scanner_gc_check_interval_us, hidden);
 
+DEFINE_int32(scanner_max_active, 0,
+             "Maximum number of scanners that may be active at once on a tablet "
+             "server. New scans beyond it are rejected with a 'server too busy' "
+             "error, which the client retries after backing off. 0 means no limit.");
+TAG_FLAG(scanner_max_active, advanced);
+TAG_FLAG(scanner_max_active, runtime);
+
+DEFINE_int64(scanner_memory_limit_mb, -1,
+             "Maximum amount of memory that the active scanners of a tablet "
+             "server may hold before new scans are rejected with a 'server too "
+             "busy' error. -1 means no limit.");
+TAG_FLAG(scanner_memory_limit_mb, advanced);
+TAG_FLAG(scanner_memory_limit_mb, runtime);
+
+DEFINE_int32(scanner_max_table_share_pct, 50,
+             "Percentage of --scanner_max_active and --scanner_memory_limit_mb "
+             "which the scanners of any one table may take up, so that the scans "
+             "of a busy table cannot keep those of other tables from starting. "
+             "100 turns this off.");
+TAG_FLAG(scanner_max_table_share_pct, advanced);
+TAG_FLAG(scanner_max_table_share_pct, runtime);
+
+DEFINE_int32(scanner_column_memory_estimate_kb, 64,
+             "Estimated amount of memory, in KB, which a scanner's iterators hold for "
+             "each projected column, e.g. for decoders and their buffers. Counted "
+             "against --scanner_memory_limit_mb.");
+TAG_FLAG(scanner_column_memory_estimate_kb, advanced);
+
 // TODO: would be better to scope this at a tablet level instead of
 // server level.
 METRIC_DEFINE_gauge_size(server, active_scanners,
@@ -45,12 +79,19 @@ METRIC_DEFINE_gauge_size(server, active_scanners,
 
 namespace kudu {
 
+using std::shared_ptr;
+using strings::Substitute;
 using tablet::TabletPeer;
 
 namespace tserver {
 
-ScannerManager::ScannerManager(const scoped_refptr<MetricEntity>& metric_entity)
-    : shutdown_(false),
+ScannerManager::ScannerManager(const scoped_refptr<MetricEntity>& metric_entity,
+                               const shared_ptr<MemTracker>& parent_mem_tracker)
+    : mem_tracker_(MemTracker::CreateTracker(
+          -1, "scanners",
+          parent_mem_tracker ? parent_mem_tracker : MemTracker::GetRootTracker())),
+      num_admitted_(0),
+      shutdown_(false),
       shutdown_cv_(&shutdown_lock_) {
   if (metric_entity) {
     metrics_.reset(new ScannerMetrics(metric_entity));
@@ -102,9 +143,72 @@ ScannerManager::ScannerMapStripe& ScannerManager::GetStripeByScannerId(const str
   return *scanner_maps_[slot];
 }
 
-void ScannerManager::NewScanner(const scoped_refptr<TabletPeer>& tablet_peer,
-                                const std::string& requestor_string,
-                                SharedScanner* scanner) {
+Status ScannerManager::AdmitScanner(const string& table_id,
+                                    shared_ptr<MemTracker>* table_tracker) {
+  *table_tracker = MemTracker::FindOrCreateTracker(
+      -1, Substitute("table-$0", table_id), mem_tracker_);
+  int share_pct = std::min(std::max(FLAGS_scanner_max_table_share_pct, 1), 100);
+
+  if (FLAGS_scanner_memory_limit_mb >= 0) {
+    int64_t limit = FLAGS_scanner_memory_limit_mb * 1024 * 1024;
+    if (mem_tracker_->consumption() >= limit) {
+      return Status::ServiceUnavailable(Substitute(
+          "Scanners are using $0 bytes of memory, over the limit of $1",
+          mem_tracker_->consumption(), limit));
+    }
+    int64_t table_limit = limit * share_pct / 100;
+    if ((*table_tracker)->consumption() >= table_limit) {
+      return Status::ServiceUnavailable(Substitute(
+          "Scanners of table $0 are using $1 bytes of memory, over their share of $2",
+          table_id, (*table_tracker)->consumption(), table_limit));
+    }
+  }
+
+  std::lock_guard<simple_spinlock> l(admission_lock_);
+  int& num_table_admitted = num_admitted_by_table_[table_id];
+  int max_active = FLAGS_scanner_max_active;
+  if (max_active > 0) {
+    if (num_admitted_ >= max_active) {
+      return Status::ServiceUnavailable(Substitute(
+          "$0 scanners are active, the most allowed", num_admitted_));
+    }
+    int table_max_active = std::max(max_active * share_pct / 100, 1);
+    if (num_table_admitted >= table_max_active) {
+      return Status::ServiceUnavailable(Substitute(
+          "$0 scanners of table $1 are active, the most allowed for a table",
+          num_table_admitted, table_id));
+    }
+  }
+  num_admitted_++;
+  num_table_admitted++;
+  return Status::OK();
+}
+
+void ScannerManager::ReleaseScanner(const Scanner& scanner) {
+  std::lock_guard<simple_spinlock> l(admission_lock_);
+  auto it = num_admitted_by_table_.find(scanner.table_id());
+  DCHECK(it != num_admitted_by_table_.end());
+  DCHECK_GT(it->second, 0);
+  if (--it->second == 0) {
+    num_admitted_by_table_.erase(it);
+  }
+  num_admitted_--;
+}
+
+Status ScannerManager::NewScanner(const scoped_refptr<TabletPeer>& tablet_peer,
+                                  const std::string& requestor_string,
+                                  SharedScanner* scanner) {
+  // scanners-test passes a null tablet_peer.
+  string table_id = tablet_peer ? tablet_peer->tablet_metadata()->table_id() : "";
+  shared_ptr<MemTracker> table_tracker;
+  Status s = AdmitScanner(table_id, &table_tracker);
+  if (PREDICT_FALSE(!s.ok())) {
+    if (metrics_) {
+      metrics_->scanners_rejected->Increment();
+    }
+    return s;
+  }
+
   // Keep trying to generate a unique ID until we get one.
   bool success = false;
   while (!success) {
@@ -112,12 +216,14 @@ void ScannerManager::NewScanner(const scoped_refptr<TabletPeer>& tablet_peer,
     // probably generate random numbers instead, since we can safely
     // just retry until we avoid a collission.
     string id = oid_generator_.Next();
-    scanner->reset(new Scanner(id, tablet_peer, requestor_string, metrics_.get()));
+    scanner->reset(new Scanner(id, tablet_peer, requestor_string, metrics_.get(),
+                               table_tracker));
 
     ScannerMapStripe& stripe = GetStripeByScannerId(id);
     std::lock_guard<RWMutex> l(stripe.lock_);
     success = InsertIfNotPresent(&stripe.scanners_by_id_, id, *scanner);
   }
+  return Status::OK();
 }
 
 bool ScannerManager::LookupScanner(const string& scanner_id, SharedScanner* scanner) {
@@ -129,7 +235,13 @@ bool ScannerManager::LookupScanner(const string& scanner_id, SharedScanner* scan
 bool ScannerManager::UnregisterScanner(const string& scanner_id) {
   ScannerMapStripe& stripe = GetStripeByScannerId(scanner_id);
   std::lock_guard<RWMutex> l(stripe.lock_);
-  return stripe.scanners_by_id_.erase(scanner_id) > 0;
+  auto it = stripe.scanners_by_id_.find(scanner_id);
+  if (it == stripe.scanners_by_id_.end()) {
+    return false;
+  }
+  ReleaseScanner(*it->second);
+  stripe.scanners_by_id_.erase(it);
+  return true;
 }
 
 size_t ScannerManager::CountActiveScanners() const {
@@ -166,6 +278,7 @@ void ScannerManager::RemoveExpiredScanners() {
                   << ", after " << time_live.ToMicroseconds()
                   << " us of inactivity, which is > TTL ("
                   << scanner_ttl.ToMicroseconds() << " us).";
+        ReleaseScanner(*scanner);
         it = stripe->scanners_by_id_.erase(it);
         if (metrics_) {
           metrics_->scanners_expired->Increment();
@@ -178,14 +291,26 @@ void ScannerManager::RemoveExpiredScanners() {
 }
 
 Scanner::Scanner(string id, const scoped_refptr<TabletPeer>& tablet_peer,
-                 string requestor_string, ScannerMetrics* metrics)
+                 string requestor_string, ScannerMetrics* metrics,
+                 const shared_ptr<MemTracker>& parent_mem_tracker)
     : id_(std::move(id)),
       tablet_peer_(tablet_peer),
       requestor_string_(std::move(requestor_string)),
       call_seq_id_(0),
       start_time_(MonoTime::Now(MonoTime::COARSE)),
       metrics_(metrics),
-      arena_(1024, 1024 * 1024) {
+      table_id_(tablet_peer_ ? tablet_peer_->tablet_metadata()->table_id() : ""),
+      mem_tracker_(MemTracker::CreateTracker(-1, Substitute("scanner-$0", id_),
+                                             parent_mem_tracker)),
+      allocator_(new MemoryTrackingBufferAllocator(HeapBufferAllocator::Get(),
+                                                   mem_tracker_)),
+      row_format_flags_(NO_FLAGS),
+      has_limit_(false),
+      limit_(0),
+      num_rows_limited_(0),
+      bytes_per_row_(-1),
+      arena_(allocator_.get(), 1024, 1024 * 1024),
+      batch_arena_(allocator_.get(), 32 * 1024, 1024 * 1024) {
   UpdateAccessTime();
 }
 
@@ -204,6 +329,9 @@ void Scanner::Init(gscoped_ptr<RowwiseIterator> iter,
                    gscoped_ptr<ScanSpec> spec) {
   std::lock_guard<simple_spinlock> l(lock_);
   CHECK(!iter_) << "Already initialized";
+  iter_consumption_.reset(new ScopedTrackedConsumption(
+      mem_tracker_,
+      iter->schema().num_columns() * FLAGS_scanner_column_memory_estimate_kb * 1024L));
   iter_.reset(iter.release());
   spec_.reset(spec.release());
 }
@@ -212,6 +340,29 @@ const ScanSpec& Scanner::spec() const {
   return *spec_;
 }
 
+RowBlock* Scanner::GetBatchBlock(size_t nrows) {
+  if (batch_block_ &&
+      nrows <= batch_block_->row_capacity() * 2 &&
+      nrows * 2 >= batch_block_->row_capacity()) {
+    return batch_block_.get();
+  }
+
+  const Schema& schema = iter()->schema();
+  // Drop the old block before allocating the new one.
+  batch_block_.reset();
+  batch_block_.reset(new RowBlock(schema, nrows, &batch_arena_));
+
+  // The column data, the null bitmaps and the selection vector.
+  int64_t bytes = nrows * schema.byte_size() +
+      BitmapSize(nrows) * (schema.num_columns() + 1);
+  if (batch_block_consumption_) {
+    batch_block_consumption_->Reset(bytes);
+  } else {
+    batch_block_consumption_.reset(new ScopedTrackedConsumption(mem_tracker_, bytes));
+  }
+  return batch_block_.get();
+}
+
 void Scanner::GetIteratorStats(vector<IteratorStats>* stats) const {
   iter_->GetIteratorStats(stats);
 }
@@ -39,10 +39,14 @@
 
 namespace kudu {
 
+class MemTracker;
+class MemoryTrackingBufferAllocator;
 class MetricEntity;
+class RowBlock;
 class RowwiseIterator;
 class ScanSpec;
 class Schema;
+class ScopedTrackedConsumption;
 class Status;
 class Thread;
 
@@ -62,18 +66,33 @@ typedef std::shared_ptr<Scanner> SharedScanner;
 //
 // Since scanners keep resources on the server, the manager periodically
 // removes any scanners which have not been accessed since a configurable TTL.
+//
+// The memory held by each scanner is tracked under a "scanners" MemTracker,
+// with a child per table and a grandchild per scanner. New scans are turned
+// away while the server is at its limits on the number of active scanners
+// or on their memory; no table may take more than its share of either while
+// the limits are reached, so that one table's scans cannot starve another's.
 class ScannerManager {
  public:
-  explicit ScannerManager(const scoped_refptr<MetricEntity>& metric_entity);
+  // The "scanners" tracker is created under 'parent_mem_tracker', or under
+  // the root tracker if it is null.
+  explicit ScannerManager(const scoped_refptr<MetricEntity>& metric_entity,
+                          const std::shared_ptr<MemTracker>& parent_mem_tracker =
+                              std::shared_ptr<MemTracker>());
   ~ScannerManager();
 
   // Starts the expired scanner removal thread.
   Status StartRemovalThread();
 
   // Create a new scanner with a unique ID, inserting it into the map.
-  void NewScanner(const scoped_refptr<tablet::TabletPeer>& tablet_peer,
-                  const std::string& requestor_string,
-                  SharedScanner* scanner);
+  //
+  // Returns ServiceUnavailable, without creating a scanner, if the scan
+  // would go over the server's limits on active scanners or scanner memory,
+  // or over its table's share of them. The client retries such scans after
+  // backing off.
+  Status NewScanner(const scoped_refptr<tablet::TabletPeer>& tablet_peer,
+                    const std::string& requestor_string,
+                    SharedScanner* scanner);
 
   // Lookup the given scanner by its ID.
   // Returns true if the scanner is found successfully.
@@ -96,7 +115,10 @@ class ScannerManager {
   // Iterate through scanners and remove any which are past their TTL.
   void RemoveExpiredScanners();
 
+  const std::shared_ptr<MemTracker>& mem_tracker() const { return mem_tracker_; }
+
  private:
+  FRIEND_TEST(ScannerTest, TestAdmissionControl);
   FRIEND_TEST(ScannerTest, TestExpire);
 
   enum {
@@ -119,6 +141,26 @@ class ScannerManager {
 
   ScannerMapStripe& GetStripeByScannerId(const string& scanner_id);
 
+  // Counts a new scan of the table with ID 'table_id' as active, unless
+  // that goes over the limits on active scanners or scanner memory, in which
+  // case returns ServiceUnavailable. Sets 'table_tracker' to the tracker for
+  // the table's scanners.
+  Status AdmitScanner(const std::string& table_id,
+                      std::shared_ptr<MemTracker>* table_tracker);
+
+  // Undoes AdmitScanner() for a scanner that was removed from the map.
+  void ReleaseScanner(const Scanner& scanner);
+
+  // The parent of the trackers of each table's scanners.
+  std::shared_ptr<MemTracker> mem_tracker_;
+
+  // Protects 'num_admitted_' and 'num_admitted_by_table_'.
+  simple_spinlock admission_lock_;
+
+  // The number of scanners in the maps, in total and by table ID.
+  int num_admitted_;
+  std::unordered_map<std::string, int> num_admitted_by_table_;
+
   // (Optional) scanner metrics for this instance.
   gscoped_ptr<ScannerMetrics> metrics_;
 
@@ -167,13 +209,20 @@ class ScopedUnregisterScanner {
 // An open scanner on the server side.
 class Scanner {
  public:
-  explicit Scanner(std::string id,
-                   const scoped_refptr<tablet::TabletPeer>& tablet_peer,
-                   std::string requestor_string, ScannerMetrics* metrics);
+  // The memory held by the scanner is tracked by a child of
+  // 'parent_mem_tracker'.
+  Scanner(std::string id,
+          const scoped_refptr<tablet::TabletPeer>& tablet_peer,
+          std::string requestor_string, ScannerMetrics* metrics,
+          const std::shared_ptr<MemTracker>& parent_mem_tracker);
   ~Scanner();
 
   // Attach an actual iterator and a ScanSpec to this Scanner.
   // Takes ownership of 'iter' and 'spec'.
+  //
+  // The iterator's buffers are allocated as it goes and are not tracked
+  // directly, so an estimate of their size, proportional to the number of
+  // columns it projects, is charged to the scanner's MemTracker instead.
   void Init(gscoped_ptr<RowwiseIterator> iter,
             gscoped_ptr<ScanSpec> spec);
 
@@ -209,8 +258,26 @@ class Scanner {
     return &arena_;
   }
 
+  // Returns the RowBlock which a request materializes the rows it reads
+  // into, with room for about 'nrows' rows of the iterator's schema. The
+  // block, and the arena backing its indirect data, are kept across the
+  // requests of the scan rather than reallocated by each, and are charged to
+  // the scanner's MemTracker. The block is only reallocated when its
+  // capacity is well off 'nrows'.
+  //
+  // The indirect data of the rows materialized by the previous requests is
+  // freed by ResetBatchArena(), which each request must call before getting
+  // the block.
+  RowBlock* GetBatchBlock(size_t nrows);
+  void ResetBatchArena() { batch_arena_.Reset(); }
+
   const std::string& id() const { return id_; }
 
+  // The ID of the table being scanned, or empty if there is no tablet peer.
+  const std::string& table_id() const { return table_id_; }
+
+  const std::shared_ptr<MemTracker>& mem_tracker() const { return mem_tracker_; }
+
   // Return the ScanSpec associated with this Scanner.
   const ScanSpec& spec() const;
 
@@ -262,6 +329,39 @@ class Scanner {
   // See the note about 'set_client_projection_schema' above.
   const Schema* client_projection_schema() const { return client_projection_schema_.get(); }
 
+  // The bitfield of RowFormatFlags requested when the scan was started.
+  uint64_t row_format_flags() const { return row_format_flags_; }
+  void set_row_format_flags(uint64_t row_format_flags) {
+    row_format_flags_ = row_format_flags;
+  }
+
+  // The maximum number of rows to return over the lifetime of the scanner,
+  // if the scan has a limit.
+  bool has_limit() const { return has_limit_; }
+  uint64_t limit() const { return limit_; }
+  void set_limit(uint64_t limit) {
+    has_limit_ = true;
+    limit_ = limit;
+  }
+
+  // The number of rows which were counted against the limit so far.
+  uint64_t num_rows_limited() const { return num_rows_limited_; }
+  void add_num_rows_limited(uint64_t num_rows) { num_rows_limited_ += num_rows; }
+
+  // Returns true if the scan has returned as many rows as its limit allows.
+  bool limit_reached() const { return has_limit_ && num_rows_limited_ >= limit_; }
+
+  // An estimate of the number of bytes each row read from the iterator adds
+  // to a response, after predicates and the client's projection, or a
+  // negative value until a row has been read.
+  double bytes_per_row() const { return bytes_per_row_; }
+
+  // Folds the bytes per row observed for the latest block into the estimate,
+  // weighting recent blocks more.
+  void UpdateBytesPerRow(double observed) {
+    bytes_per_row_ = bytes_per_row_ < 0 ? observed : 0.75 * bytes_per_row_ + 0.25 * observed;
+  }
+
   // Get per-column stats for each iterator.
   void GetIteratorStats(std::vector<IteratorStats>* stats) const;
 
@@ -300,6 +400,13 @@ class Scanner {
   // (Optional) scanner metrics struct, for recording scanner's duration.
   ScannerMetrics* metrics_;
 
+  const std::string table_id_;
+
+  // Tracks the memory held by the scanner. Declared before the members
+  // which consume from it, so that it is destroyed after them.
+  std::shared_ptr<MemTracker> mem_tracker_;
+  std::shared_ptr<MemoryTrackingBufferAllocator> allocator_;
+
   // A summary of the statistics already reported to the metrics system
   // for this scanner. This allows us to report the metrics incrementally
   // as the scanner proceeds.
@@ -312,8 +419,22 @@ class Scanner {
   // schema used by the iterator.
   gscoped_ptr<Schema> client_projection_schema_;
 
+  // The layout in which rows are returned to the client.
+  uint64_t row_format_flags_;
+
+  // See has_limit() and num_rows_limited().
+  bool has_limit_;
+  uint64_t limit_;
+  uint64_t num_rows_limited_;
+
+  // See bytes_per_row().
+  double bytes_per_row_;
+
   gscoped_ptr<RowwiseIterator> iter_;
 
+  // The estimated memory held by 'iter_'.
+  gscoped_ptr<ScopedTrackedConsumption> iter_consumption_;
+
   AutoReleasePool autorelease_pool_;
 
   // Arena used for allocations which must last as long as the scanner
@@ -321,6 +442,14 @@ class Scanner {
   // response.
   Arena arena_;
 
+  // See GetBatchBlock(). The arena is declared before the block, so that it
+  // outlives it.
+  Arena batch_arena_;
+  gscoped_ptr<RowBlock> batch_block_;
+
+  // The memory held by the columns of 'batch_block_'.
+  gscoped_ptr<ScopedTrackedConsumption> batch_block_consumption_;
+
   DISALLOW_COPY_AND_ASSIGN(Scanner);
 };
 
@@ -237,5 +237,23 @@ TEST_F(TabletCopyClientTest, TestDownloadAllBlocks) {
   }
 }
 
+// Restarting the session keeps the blocks that were already downloaded.
+TEST_F(TabletCopyClientTest, TestRestartSessionKeepsBlocks) {
+  ASSERT_OK(client_->DownloadBlocks());
+  vector<BlockId> first_blocks = GetAllSortedBlocks(*client_->new_superblock_.get());
+
+  ASSERT_OK(client_->RestartRemoteSession());
+  ASSERT_OK(client_->DownloadBlocks());
+  vector<BlockId> second_blocks = GetAllSortedBlocks(*client_->new_superblock_.get());
+  ASSERT_EQ(first_blocks.size(), second_blocks.size());
+  for (int i = 0; i < first_blocks.size(); i++) {
+    ASSERT_EQ(first_blocks[i], second_blocks[i]);
+  }
+
+  TabletStatusListener listener(meta_);
+  ASSERT_OK(client_->FetchAll(&listener));
+  ASSERT_OK(client_->Finish());
+}
+
 } // namespace tserver
 } // namespace kudu
@@ -17,6 +17,10 @@
 
 #include "kudu/tserver/tablet_copy_client.h"
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
+
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 
@@ -26,6 +30,7 @@
 #include "kudu/fs/block_id.h"
 #include "kudu/fs/block_manager.h"
 #include "kudu/fs/fs_manager.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
 #include "kudu/gutil/walltime.h"
@@ -37,12 +42,15 @@
 #include "kudu/tserver/tablet_copy.pb.h"
 #include "kudu/tserver/tablet_copy.proxy.h"
 #include "kudu/tserver/tablet_server.h"
+#include "kudu/util/background_io_throttle.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
 #include "kudu/util/net/net_util.h"
+#include "kudu/util/threadpool.h"
+#include "kudu/util/throttler.h"
 
 DEFINE_int32(tablet_copy_begin_session_timeout_ms, 3000,
              "Tablet server RPC client timeout for BeginTabletCopySession calls. "
@@ -61,6 +69,24 @@ DEFINE_int32(tablet_copy_dowload_file_inject_latency_ms, 0,
              "to take much longer. For use in tests only.");
 TAG_FLAG(tablet_copy_dowload_file_inject_latency_ms, hidden);
 
+DEFINE_int32(tablet_copy_download_threads, 4,
+             "Number of data blocks a tablet copy downloads from its source at "
+             "the same time.");
+TAG_FLAG(tablet_copy_download_threads, advanced);
+
+DEFINE_int32(tablet_copy_max_session_restarts, 3,
+             "Number of times a tablet copy whose session with the source fails "
+             "begins a new one and resumes, keeping the blocks it has already "
+             "downloaded, before giving up.");
+TAG_FLAG(tablet_copy_max_session_restarts, advanced);
+
+DEFINE_int64(tablet_copy_source_mb_per_sec, 0,
+             "Maximum rate, in megabytes per second, at which the tablet copies "
+             "on this server may download data from any one source server, "
+             "summed over those copies. 0 means unlimited.");
+TAG_FLAG(tablet_copy_source_mb_per_sec, advanced);
+TAG_FLAG(tablet_copy_source_mb_per_sec, runtime);
+
 DECLARE_int32(tablet_copy_transfer_chunk_size_bytes);
 
 // RETURN_NOT_OK_PREPEND() with a remote-error unwinding step.
@@ -76,10 +102,12 @@ using consensus::OpId;
 using consensus::RaftConfigPB;
 using consensus::RaftPeerPB;
 using env_util::CopyFile;
+using fs::CreateBlockOptions;
 using fs::WritableBlock;
 using rpc::Messenger;
 using std::shared_ptr;
 using std::string;
+using std::unordered_set;
 using std::vector;
 using strings::Substitute;
 using tablet::ColumnDataPB;
@@ -91,6 +119,57 @@ using tablet::TabletMetadata;
 using tablet::TabletStatusListener;
 using tablet::TabletSuperBlockPB;
 
+namespace {
+
+// How long a throttled download sleeps before trying again.
+const int kThrottleSleepMs = 10;
+
+// The download rate limits, one per source server, shared by all copies.
+struct SourceThrottles {
+  simple_spinlock lock;
+
+  // The rate the throttlers were built for. Rebuilt when the flag changes.
+  int64_t mb_per_sec = 0;
+  std::unordered_map<string, std::unique_ptr<Throttler>> by_source;
+};
+
+SourceThrottles* source_throttles() {
+  static SourceThrottles* throttles = new SourceThrottles();
+  return throttles;
+}
+
+// Blocks until 'bytes' more may be downloaded from the server at 'source'.
+void ThrottleDownload(const string& source, uint64_t bytes) {
+  SourceThrottles* t = source_throttles();
+  while (true) {
+    int64_t mb_per_sec = FLAGS_tablet_copy_source_mb_per_sec;
+    if (mb_per_sec <= 0 || bytes == 0) {
+      return;
+    }
+    // The bucket holds at most a second's worth of tokens, so larger
+    // chunks are charged as one second.
+    uint64_t byte_rate = mb_per_sec * 1024 * 1024;
+    {
+      std::lock_guard<simple_spinlock> l(t->lock);
+      MonoTime now = MonoTime::Now(MonoTime::FINE);
+      if (t->mb_per_sec != mb_per_sec) {
+        t->by_source.clear();
+        t->mb_per_sec = mb_per_sec;
+      }
+      std::unique_ptr<Throttler>& throttler = t->by_source[source];
+      if (!throttler) {
+        throttler.reset(new Throttler(now, 0, byte_rate, 1));
+      }
+      if (throttler->Take(now, 0, std::min(bytes, byte_rate))) {
+        return;
+      }
+    }
+    SleepFor(MonoDelta::FromMilliseconds(kThrottleSleepMs));
+  }
+}
+
+} // anonymous namespace
+
 TabletCopyClient::TabletCopyClient(std::string tablet_id,
                                              FsManager* fs_manager,
                                              shared_ptr<Messenger> messenger)
@@ -103,7 +182,8 @@ TabletCopyClient::TabletCopyClient(std::string tablet_id,
       replace_tombstoned_tablet_(false),
       status_listener_(nullptr),
       session_idle_timeout_millis_(0),
-      start_time_micros_(0) {}
+      start_time_micros_(0),
+      session_failed_(false) {}
 
 TabletCopyClient::~TabletCopyClient() {
   // Note: Ending the tablet copy session releases anchors on the remote.
@@ -146,6 +226,11 @@ Status TabletCopyClient::SetTabletToReplace(const scoped_refptr<TabletMetadata>&
   return Status::OK();
 }
 
+void TabletCopyClient::SetFollowerSources(vector<HostPort> follower_addrs) {
+  CHECK(!started_);
+  follower_addrs_ = std::move(follower_addrs);
+}
+
 Status TabletCopyClient::Start(const HostPort& copy_source_addr,
                                     scoped_refptr<TabletMetadata>* meta) {
   CHECK(!started_);
@@ -162,37 +247,35 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
                         << " from remote peer at address " << copy_source_addr.ToString();
 
   // Set up an RPC proxy for the TabletCopyService.
-  proxy_.reset(new TabletCopyServiceProxy(messenger_, addr));
-
-  BeginTabletCopySessionRequestPB req;
-  req.set_requestor_uuid(fs_manager_->uuid());
-  req.set_tablet_id(tablet_id_);
-
-  rpc::RpcController controller;
-  controller.set_timeout(MonoDelta::FromMilliseconds(
-      FLAGS_tablet_copy_begin_session_timeout_ms));
-
-  // Begin the tablet copy session with the remote peer.
-  BeginTabletCopySessionResponsePB resp;
-  RETURN_NOT_OK_UNWIND_PREPEND(proxy_->BeginTabletCopySession(req, &resp, &controller),
-                               controller,
-                               "Unable to begin tablet copy session");
-  string copy_peer_uuid = resp.has_responder_uuid()
-      ? resp.responder_uuid() : "(unknown uuid)";
-  if (resp.superblock().tablet_data_state() != tablet::TABLET_DATA_READY) {
-    Status s = Status::IllegalState("Remote peer (" + copy_peer_uuid + ")" +
-                                    " is currently copying itself!",
-                                    resp.superblock().ShortDebugString());
-    LOG_WITH_PREFIX(WARNING) << s.ToString();
-    return s;
+  leader_proxy_.reset(new TabletCopyServiceProxy(messenger_, addr));
+  leader_addr_ = copy_source_addr.ToString();
+
+  // Try to copy from a follower, sparing the leader the load, and from the
+  // leader itself if none of them is able to.
+  string copy_peer_uuid;
+  bool began = false;
+  std::random_shuffle(follower_addrs_.begin(), follower_addrs_.end());
+  for (const HostPort& follower : follower_addrs_) {
+    Sockaddr follower_addr;
+    Status s = SockaddrFromHostPort(follower, &follower_addr);
+    if (s.ok() && !follower_addr.IsWildcard()) {
+      proxy_.reset(new TabletCopyServiceProxy(messenger_, follower_addr));
+      source_addr_ = follower.ToString();
+      s = BeginRemoteSession(&copy_peer_uuid);
+    }
+    if (s.ok()) {
+      LOG_WITH_PREFIX(INFO) << "Copying from follower at " << source_addr_;
+      began = true;
+      break;
+    }
+    LOG_WITH_PREFIX(WARNING) << "Unable to copy from follower at " << follower.ToString()
+                             << ": " << s.ToString();
+  }
+  if (!began) {
+    proxy_ = leader_proxy_;
+    source_addr_ = leader_addr_;
+    RETURN_NOT_OK(BeginRemoteSession(&copy_peer_uuid));
   }
-
-  session_id_ = resp.session_id();
-  session_idle_timeout_millis_ = resp.session_idle_timeout_millis();
-  superblock_.reset(resp.release_superblock());
-  superblock_->set_tablet_data_state(tablet::TABLET_DATA_COPYING);
-  wal_seqnos_.assign(resp.wal_segment_seqnos().begin(), resp.wal_segment_seqnos().end());
-  remote_committed_cstate_.reset(resp.release_initial_committed_cstate());
 
   Schema schema;
   RETURN_NOT_OK_PREPEND(SchemaFromPB(superblock_->schema(), &schema),
@@ -246,15 +329,90 @@ Status TabletCopyClient::Start(const HostPort& copy_source_addr,
   return Status::OK();
 }
 
+Status TabletCopyClient::BeginRemoteSession(string* copy_peer_uuid) {
+  BeginTabletCopySessionRequestPB req;
+  req.set_requestor_uuid(fs_manager_->uuid());
+  req.set_tablet_id(tablet_id_);
+
+  rpc::RpcController controller;
+  controller.set_timeout(MonoDelta::FromMilliseconds(
+      FLAGS_tablet_copy_begin_session_timeout_ms));
+
+  // Begin the tablet copy session with the remote peer.
+  BeginTabletCopySessionResponsePB resp;
+  RETURN_NOT_OK_UNWIND_PREPEND(proxy_->BeginTabletCopySession(req, &resp, &controller),
+                               controller,
+                               "Unable to begin tablet copy session");
+  *copy_peer_uuid = resp.has_responder_uuid()
+      ? resp.responder_uuid() : "(unknown uuid)";
+  if (resp.superblock().tablet_data_state() != tablet::TABLET_DATA_READY) {
+    Status s = Status::IllegalState("Remote peer (" + *copy_peer_uuid + ")" +
+                                    " is currently copying itself!",
+                                    resp.superblock().ShortDebugString());
+    LOG_WITH_PREFIX(WARNING) << s.ToString();
+    return s;
+  }
+
+  session_id_ = resp.session_id();
+  session_idle_timeout_millis_ = resp.session_idle_timeout_millis();
+  superblock_.reset(resp.release_superblock());
+  superblock_->set_tablet_data_state(tablet::TABLET_DATA_COPYING);
+  wal_seqnos_.assign(resp.wal_segment_seqnos().begin(), resp.wal_segment_seqnos().end());
+  remote_committed_cstate_.reset(resp.release_initial_committed_cstate());
+  return Status::OK();
+}
+
+Status TabletCopyClient::RestartRemoteSession() {
+  // The old session has most likely expired on the source already.
+  WARN_NOT_OK(EndRemoteSession(), "Unable to close failed tablet copy session");
+  session_failed_ = false;
+
+  string copy_peer_uuid;
+  // The source may have flushed or compacted the tablet in the meantime:
+  // the blocks are downloaded against its new superblock, which only
+  // replaces the local one once the copy finishes.
+  Status s = BeginRemoteSession(&copy_peer_uuid);
+  if (!s.ok() && proxy_ != leader_proxy_) {
+    // The follower may have gone away. Its blocks are of no use for a copy
+    // from the leader, whose layout differs, and are deleted once the
+    // leader's have been downloaded.
+    LOG_WITH_PREFIX(WARNING) << "Unable to restart tablet copy session with follower at "
+                             << source_addr_ << ": " << s.ToString()
+                             << ". Copying from the leader instead";
+    proxy_ = leader_proxy_;
+    source_addr_ = leader_addr_;
+    s = BeginRemoteSession(&copy_peer_uuid);
+  }
+  RETURN_NOT_OK_PREPEND(s, "Unable to restart tablet copy session");
+  return Status::OK();
+}
+
 Status TabletCopyClient::FetchAll(TabletStatusListener* status_listener) {
   CHECK(started_);
   status_listener_ = status_listener;
 
-  // Download all the files (serially, for now, but in parallel in the future).
-  RETURN_NOT_OK(DownloadBlocks());
-  RETURN_NOT_OK(DownloadWALs());
-
-  return Status::OK();
+  int restarts = 0;
+  while (true) {
+    Status s = DownloadBlocks();
+    if (s.ok()) {
+      s = DownloadWALs();
+    }
+    if (s.ok() || !session_failed_ || restarts >= FLAGS_tablet_copy_max_session_restarts) {
+      return s;
+    }
+    restarts++;
+    int num_copied;
+    {
+      std::lock_guard<simple_spinlock> l(copied_blocks_lock_);
+      num_copied = copied_blocks_.size();
+    }
+    LOG_WITH_PREFIX(WARNING) << "Tablet copy session failed: " << s.ToString()
+                             << ". Beginning a new session, keeping the " << num_copied
+                             << " blocks already downloaded (restart " << restarts << "/"
+                             << FLAGS_tablet_copy_max_session_restarts << ")";
+    UpdateStatusMessage(Substitute("Restarting session after failure: $0", s.ToString()));
+    RETURN_NOT_OK(RestartRemoteSession());
+  }
 }
 
 Status TabletCopyClient::Finish() {
@@ -363,46 +521,79 @@ Status TabletCopyClient::DownloadWALs() {
 Status TabletCopyClient::DownloadBlocks() {
   CHECK(started_);
 
-  // Count up the total number of blocks to download.
-  int num_blocks = 0;
-  for (const RowSetDataPB& rowset : superblock_->rowsets()) {
-    num_blocks += rowset.columns_size();
-    num_blocks += rowset.redo_deltas_size();
-    num_blocks += rowset.undo_deltas_size();
-    if (rowset.has_bloom_block()) {
-      num_blocks++;
-    }
-    if (rowset.has_adhoc_index_block()) {
-      num_blocks++;
-    }
-  }
-
-  // Download each block, writing the new block IDs into the new superblock
-  // as each block downloads.
+  // Gather the blocks to download, which are rewritten with their new IDs in
+  // the new superblock as each block downloads.
   gscoped_ptr<TabletSuperBlockPB> new_sb(new TabletSuperBlockPB());
   new_sb->CopyFrom(*superblock_);
-  int block_count = 0;
-  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_blocks << " data blocks...";
+  vector<BlockIdPB*> block_ids;
   for (RowSetDataPB& rowset : *new_sb->mutable_rowsets()) {
     for (ColumnDataPB& col : *rowset.mutable_columns()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(col.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(col.mutable_block());
     }
     for (DeltaDataPB& redo : *rowset.mutable_redo_deltas()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(redo.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(redo.mutable_block());
     }
     for (DeltaDataPB& undo : *rowset.mutable_undo_deltas()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(undo.mutable_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(undo.mutable_block());
     }
     if (rowset.has_bloom_block()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(rowset.mutable_bloom_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(rowset.mutable_bloom_block());
     }
     if (rowset.has_adhoc_index_block()) {
-      RETURN_NOT_OK(DownloadAndRewriteBlock(rowset.mutable_adhoc_index_block(),
-                                            &block_count, num_blocks));
+      block_ids.push_back(rowset.mutable_adhoc_index_block());
+    }
+  }
+  int num_blocks = block_ids.size();
+  LOG_WITH_PREFIX(INFO) << "Starting download of " << num_blocks << " data blocks...";
+
+  std::atomic<int> block_count(0);
+  simple_spinlock error_lock;
+  Status first_error;
+  {
+    gscoped_ptr<ThreadPool> pool;
+    RETURN_NOT_OK(ThreadPoolBuilder("tablet-copy")
+                  .set_max_threads(std::max(1, FLAGS_tablet_copy_download_threads))
+                  .Build(&pool));
+    for (BlockIdPB* block_id : block_ids) {
+      RETURN_NOT_OK(pool->SubmitFunc([&, block_id]() {
+        {
+          // Don't start on more blocks once one has failed.
+          std::lock_guard<simple_spinlock> l(error_lock);
+          if (!first_error.ok()) {
+            return;
+          }
+        }
+        // Writing the copied blocks counts against the background I/O budget.
+        BackgroundIOThrottle::ScopedBackgroundIO background_io;
+        Status s = DownloadAndRewriteBlock(block_id, &block_count, num_blocks);
+        if (PREDICT_FALSE(!s.ok())) {
+          std::lock_guard<simple_spinlock> l(error_lock);
+          if (first_error.ok()) {
+            first_error = s;
+          }
+        }
+      }));
+    }
+    pool->Wait();
+  }
+  RETURN_NOT_OK(first_error);
+
+  // Blocks downloaded in an earlier session may since have been compacted
+  // away on the source, in which case nothing refers to them any more.
+  unordered_set<BlockId, BlockIdHash> used;
+  for (const BlockIdPB* block_id : block_ids) {
+    used.insert(BlockId::FromPB(*block_id));
+  }
+  {
+    std::lock_guard<simple_spinlock> l(copied_blocks_lock_);
+    for (auto it = copied_blocks_.begin(); it != copied_blocks_.end();) {
+      if (ContainsKey(used, it->second)) {
+        ++it;
+        continue;
+      }
+      WARN_NOT_OK(fs_manager_->DeleteBlock(it->second),
+                  "Unable to delete block no longer needed by tablet copy");
+      it = copied_blocks_.erase(it);
     }
   }
 
@@ -460,14 +651,24 @@ Status TabletCopyClient::WriteConsensusMetadata() {
 }
 
 Status TabletCopyClient::DownloadAndRewriteBlock(BlockIdPB* block_id,
-                                                      int* block_count, int num_blocks) {
+                                                 std::atomic<int>* block_count,
+                                                 int num_blocks) {
   BlockId old_block_id(BlockId::FromPB(*block_id));
-  UpdateStatusMessage(Substitute("Downloading block $0 ($1/$2)",
-                                 old_block_id.ToString(), *block_count,
-                                 num_blocks));
   BlockId new_block_id;
-  RETURN_NOT_OK_PREPEND(DownloadBlock(old_block_id, &new_block_id),
-      "Unable to download block with id " + old_block_id.ToString());
+  bool copied;
+  {
+    std::lock_guard<simple_spinlock> l(copied_blocks_lock_);
+    copied = FindCopy(copied_blocks_, old_block_id, &new_block_id);
+  }
+  if (!copied) {
+    UpdateStatusMessage(Substitute("Downloading block $0 ($1/$2)",
+                                   old_block_id.ToString(), block_count->load(),
+                                   num_blocks));
+    RETURN_NOT_OK_PREPEND(DownloadBlock(old_block_id, &new_block_id),
+        "Unable to download block with id " + old_block_id.ToString());
+    std::lock_guard<simple_spinlock> l(copied_blocks_lock_);
+    InsertOrDie(&copied_blocks_, old_block_id, new_block_id);
+  }
 
   new_block_id.CopyToPB(block_id);
   (*block_count)++;
@@ -479,7 +680,9 @@ Status TabletCopyClient::DownloadBlock(const BlockId& old_block_id,
   VLOG_WITH_PREFIX(1) << "Downloading block with block_id " << old_block_id.ToString();
 
   gscoped_ptr<WritableBlock> block;
-  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(&block),
+  CreateBlockOptions opts;
+  opts.tablet_id = tablet_id_;
+  RETURN_NOT_OK_PREPEND(fs_manager_->CreateNewBlock(opts, &block),
                         "Unable to create new block");
 
   DataIdPB data_id;
@@ -509,18 +712,32 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
     req.mutable_data_id()->CopyFrom(data_id);
     req.set_offset(offset);
     req.set_max_length(FLAGS_tablet_copy_transfer_chunk_size_bytes);
+    req.set_data_in_sidecar(true);
 
     FetchDataResponsePB resp;
-    RETURN_NOT_OK_UNWIND_PREPEND(proxy_->FetchData(req, &resp, &controller),
-                                controller,
-                                "Unable to fetch data from remote");
+    Status s = proxy_->FetchData(req, &resp, &controller);
+    if (PREDICT_FALSE(!s.ok())) {
+      session_failed_ = true;
+      RETURN_NOT_OK_UNWIND_PREPEND(s, controller, "Unable to fetch data from remote");
+    }
+
+    // The bytes in a sidecar point into the RPC's receive buffer, which keeps
+    // them from having to be copied before being written out.
+    Slice data;
+    if (resp.chunk().has_sidecar_idx()) {
+      RETURN_NOT_OK_PREPEND(controller.GetSidecar(resp.chunk().sidecar_idx(), &data),
+                            "Unable to get data sidecar");
+    } else {
+      data = resp.chunk().data();
+    }
 
     // Sanity-check for corruption.
-    RETURN_NOT_OK_PREPEND(VerifyData(offset, resp.chunk()),
+    RETURN_NOT_OK_PREPEND(VerifyData(offset, resp.chunk(), data),
                           Substitute("Error validating data item $0", data_id.ShortDebugString()));
 
     // Write the data.
-    RETURN_NOT_OK(appendable->Append(resp.chunk().data()));
+    RETURN_NOT_OK(appendable->Append(data));
+    ThrottleDownload(source_addr_, data.size());
 
     if (PREDICT_FALSE(FLAGS_tablet_copy_dowload_file_inject_latency_ms > 0)) {
       LOG_WITH_PREFIX(INFO) << "Injecting latency into file download: " <<
@@ -528,16 +745,21 @@ Status TabletCopyClient::DownloadFile(const DataIdPB& data_id,
       SleepFor(MonoDelta::FromMilliseconds(FLAGS_tablet_copy_dowload_file_inject_latency_ms));
     }
 
-    if (offset + resp.chunk().data().size() == resp.chunk().total_data_length()) {
+    if (offset + data.size() == resp.chunk().total_data_length()) {
       done = true;
     }
-    offset += resp.chunk().data().size();
+    offset += data.size();
   }
 
   return Status::OK();
 }
 
 Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk) {
+  return VerifyData(offset, chunk, chunk.data());
+}
+
+Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk,
+                                    const Slice& data) {
   // Verify the offset is what we expected.
   if (offset != chunk.offset()) {
     return Status::InvalidArgument("Offset did not match what was asked for",
@@ -545,11 +767,11 @@ Status TabletCopyClient::VerifyData(uint64_t offset, const DataChunkPB& chunk) {
   }
 
   // Verify the checksum.
-  uint32_t crc32 = crc::Crc32c(chunk.data().data(), chunk.data().length());
+  uint32_t crc32 = crc::Crc32c(data.data(), data.size());
   if (PREDICT_FALSE(crc32 != chunk.crc32())) {
     return Status::Corruption(
         Substitute("CRC32 does not match at offset $0 size $1: $2 vs $3",
-          offset, chunk.data().size(), crc32, chunk.crc32()));
+          offset, data.size(), crc32, chunk.crc32()));
   }
   return Status::OK();
 }
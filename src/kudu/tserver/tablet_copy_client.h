@@ -17,23 +17,26 @@
 #ifndef KUDU_TSERVER_TABLET_COPY_CLIENT_H
 #define KUDU_TSERVER_TABLET_COPY_CLIENT_H
 
+#include <atomic>
 #include <string>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <gtest/gtest_prod.h>
 
+#include "kudu/fs/block_id.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/net/net_util.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 
-class BlockId;
 class BlockIdPB;
 class FsManager;
-class HostPort;
 
 namespace consensus {
 class ConsensusMetadata;
@@ -63,9 +66,15 @@ class TabletCopyServiceProxy;
 // Client class for using tablet copy to copy a tablet from another host.
 // This class is not thread-safe.
 //
-// TODO:
-// * Parallelize download of blocks and WAL segments.
+// Data blocks are downloaded --tablet_copy_download_threads at a time. If
+// the session with the source fails during the download, e.g. because the
+// source restarted or the session expired, a new one is begun and the copy
+// resumes, keeping the blocks already downloaded which the source still has.
 //
+// The tablet may be copied from one of the followers that the leader offers
+// rather than from the leader itself, falling back to the leader if none of
+// them can begin a session. The new replica then catches up on the rest of
+// the log from the leader through Raft as usual.
 class TabletCopyClient {
  public:
 
@@ -89,6 +98,11 @@ class TabletCopyClient {
   Status SetTabletToReplace(const scoped_refptr<tablet::TabletMetadata>& meta,
                             int64_t caller_term);
 
+  // Offer the followers at 'follower_addrs' as sources to copy from instead
+  // of the one passed to Start(), which is tried only if none of them is
+  // able to begin a session. Must be called before Start().
+  void SetFollowerSources(std::vector<HostPort> follower_addrs);
+
   // Start up a tablet copy session to bootstrap from the specified
   // bootstrap peer. Place a new superblock indicating that tablet copy is
   // in progress. If the 'metadata' pointer is passed as NULL, it is ignored,
@@ -111,6 +125,7 @@ class TabletCopyClient {
   FRIEND_TEST(TabletCopyClientTest, TestVerifyData);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadWalSegment);
   FRIEND_TEST(TabletCopyClientTest, TestDownloadAllBlocks);
+  FRIEND_TEST(TabletCopyClientTest, TestRestartSessionKeepsBlocks);
 
   // Extract the embedded Status message from the given ErrorStatusPB.
   // The given ErrorStatusPB must extend TabletCopyErrorPB.
@@ -122,9 +137,18 @@ class TabletCopyClient {
   // The string "TabletCopy: " will be prepended to each message.
   void UpdateStatusMessage(const std::string& message);
 
+  // Begin a tablet copy session with the source, filling in the session
+  // data items below from its response. 'copy_peer_uuid' is set to the
+  // source's UUID.
+  Status BeginRemoteSession(std::string* copy_peer_uuid);
+
   // End the tablet copy session.
   Status EndRemoteSession();
 
+  // Replace a failed tablet copy session with a new one, to resume the
+  // download from.
+  Status RestartRemoteSession();
+
   // Download all WAL files sequentially.
   Status DownloadWALs();
 
@@ -137,19 +161,22 @@ class TabletCopyClient {
   // downloaded as part of initiating the tablet copy session.
   Status WriteConsensusMetadata();
 
-  // Download all blocks belonging to a tablet sequentially.
+  // Download all blocks belonging to a tablet, several at a time.
   //
   // Blocks are given new IDs upon creation. On success, 'new_superblock_'
   // is populated to reflect the new block IDs and should be used in lieu
-  // of 'superblock_' henceforth.
+  // of 'superblock_' henceforth. Blocks downloaded in an earlier session
+  // are not downloaded again.
   Status DownloadBlocks();
 
-  // Download the block specified by 'block_id'.
+  // Download the block specified by 'block_id', unless it was already
+  // downloaded in an earlier session. Thread-safe.
   //
   // On success:
   // - 'block_id' is set to the new ID of the downloaded block.
   // - 'block_count' is incremented.
-  Status DownloadAndRewriteBlock(BlockIdPB* block_id, int* block_count, int num_blocks);
+  Status DownloadAndRewriteBlock(BlockIdPB* block_id, std::atomic<int>* block_count,
+                                 int num_blocks);
 
   // Download a single block.
   // Data block is opened with options so that it will fsync() on close.
@@ -169,6 +196,10 @@ class TabletCopyClient {
 
   Status VerifyData(uint64_t offset, const DataChunkPB& resp);
 
+  // Like the above, but verifies 'data', which holds the chunk's bytes
+  // whether they came in the protobuf or in a sidecar.
+  Status VerifyData(uint64_t offset, const DataChunkPB& chunk, const Slice& data);
+
   // Return standard log prefix.
   std::string LogPrefix();
 
@@ -194,6 +225,13 @@ class TabletCopyClient {
 
   tablet::TabletStatusListener* status_listener_;
   std::shared_ptr<TabletCopyServiceProxy> proxy_;
+  std::string source_addr_;
+
+  // The addresses of the source passed to Start(), which is the fallback for
+  // the followers in 'follower_addrs_'.
+  std::string leader_addr_;
+  std::shared_ptr<TabletCopyServiceProxy> leader_proxy_;
+  std::vector<HostPort> follower_addrs_;
   std::string session_id_;
   uint64_t session_idle_timeout_millis_;
   gscoped_ptr<tablet::TabletSuperBlockPB> superblock_;
@@ -202,6 +240,15 @@ class TabletCopyClient {
   std::vector<uint64_t> wal_seqnos_;
   int64_t start_time_micros_;
 
+  // Set when a FetchData RPC fails, i.e. when the session may need to be
+  // restarted for the copy to go on.
+  std::atomic<bool> session_failed_;
+
+  // The local IDs of the blocks downloaded so far, keyed by their IDs on the
+  // source. Kept across sessions.
+  simple_spinlock copied_blocks_lock_;
+  std::unordered_map<BlockId, BlockId, BlockIdHash> copied_blocks_;
+
   DISALLOW_COPY_AND_ASSIGN(TabletCopyClient);
 };
 
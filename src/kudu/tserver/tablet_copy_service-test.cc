@@ -115,11 +115,13 @@ class TabletCopyServiceTest : public TabletCopyTest {
   Status DoFetchData(const string& session_id, const DataIdPB& data_id,
                      uint64_t* offset, int64_t* max_length,
                      FetchDataResponsePB* resp,
-                     RpcController* controller) {
+                     RpcController* controller,
+                     bool data_in_sidecar = false) {
     controller->set_timeout(MonoDelta::FromSeconds(1.0));
     FetchDataRequestPB req;
     req.set_session_id(session_id);
     req.mutable_data_id()->CopyFrom(data_id);
+    req.set_data_in_sidecar(data_in_sidecar);
     if (offset) {
       req.set_offset(*offset);
     }
@@ -462,6 +464,40 @@ TEST_F(TabletCopyServiceTest, TestFetchLog) {
   AssertDataEqual(slice.data(), slice.size(), resp.chunk());
 }
 
+// Test that the data of a chunk can be fetched in a sidecar.
+TEST_F(TabletCopyServiceTest, TestFetchLogInSidecar) {
+  string session_id;
+  tablet::TabletSuperBlockPB superblock;
+  uint64_t idle_timeout_millis;
+  vector<uint64_t> segment_seqnos;
+  ASSERT_OK(DoBeginValidTabletCopySession(&session_id,
+                                               &superblock,
+                                               &idle_timeout_millis,
+                                               &segment_seqnos));
+  FetchDataResponsePB resp;
+  RpcController controller;
+  DataIdPB data_id;
+  data_id.set_type(DataIdPB::LOG_SEGMENT);
+  data_id.set_wal_segment_seqno(segment_seqnos[0]);
+  ASSERT_OK(DoFetchData(session_id, data_id, nullptr, nullptr, &resp, &controller,
+                        true /* data_in_sidecar */));
+  ASSERT_TRUE(resp.chunk().has_sidecar_idx());
+  ASSERT_TRUE(resp.chunk().data().empty());
+  Slice remote;
+  ASSERT_OK(controller.GetSidecar(resp.chunk().sidecar_idx(), &remote));
+
+  log::SegmentSequence local_segments;
+  ASSERT_OK(tablet_peer_->log()->reader()->GetSegmentsSnapshot(&local_segments));
+  const scoped_refptr<ReadableLogSegment>& segment = local_segments[0];
+  faststring scratch;
+  int64_t size = segment->file_size();
+  scratch.resize(size);
+  Slice local;
+  ASSERT_OK(ReadFully(segment->readable_file().get(), 0, size, &local, scratch.data()));
+  ASSERT_EQ(local, remote);
+  ASSERT_EQ(crc::Crc32c(local.data(), local.size()), resp.chunk().crc32());
+}
+
 // Test that the tablet copy session timeout works properly.
 TEST_F(TabletCopyServiceTest, TestSessionTimeout) {
   // This flag should be seen by the service due to TSO.
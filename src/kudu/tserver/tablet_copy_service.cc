@@ -28,6 +28,7 @@
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/rpc/rpc_context.h"
+#include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/tserver/tablet_copy_session.h"
 #include "kudu/tserver/tablet_peer_lookup.h"
 #include "kudu/tablet/tablet_peer.h"
@@ -208,19 +209,20 @@ void TabletCopyServiceImpl::FetchData(const FetchDataRequestPB* req,
                     error_code, "Invalid DataId");
 
   DataChunkPB* data_chunk = resp->mutable_chunk();
-  string* data = data_chunk->mutable_data();
+  gscoped_ptr<faststring> data(new faststring());
   int64_t total_data_length = 0;
   if (data_id.type() == DataIdPB::BLOCK) {
     // Fetching a data block chunk.
     const BlockId& block_id = BlockId::FromPB(data_id.block_id());
     RPC_RETURN_NOT_OK(session->GetBlockPiece(block_id, offset, client_maxlen,
-                                             data, &total_data_length, &error_code),
+                                             data.get(), &total_data_length, &error_code),
                       error_code, "Unable to get piece of data block");
   } else {
     // Fetching a log segment chunk.
     uint64_t segment_seqno = data_id.wal_segment_seqno();
     RPC_RETURN_NOT_OK(session->GetLogSegmentPiece(segment_seqno, offset, client_maxlen,
-                                                  data, &total_data_length, &error_code),
+                                                  data.get(), &total_data_length,
+                                                  &error_code),
                       error_code, "Unable to get piece of log segment");
   }
 
@@ -231,6 +233,18 @@ void TabletCopyServiceImpl::FetchData(const FetchDataRequestPB* req,
   uint32_t crc32 = Crc32c(data->data(), data->length());
   data_chunk->set_crc32(crc32);
 
+  if (req->data_in_sidecar()) {
+    int sidecar_idx;
+    RPC_RETURN_NOT_OK(context->AddRpcSidecar(
+                          gscoped_ptr<rpc::RpcSidecar>(new rpc::RpcSidecar(std::move(data))),
+                          &sidecar_idx),
+                      TabletCopyErrorPB::UNKNOWN_ERROR, "Unable to attach data sidecar");
+    data_chunk->set_sidecar_idx(sidecar_idx);
+    data_chunk->mutable_data();
+  } else {
+    data_chunk->set_data(data->data(), data->size());
+  }
+
   context->RespondSuccess();
 }
 
@@ -73,6 +73,7 @@ class TabletCopyTest : public KuduTabletTest {
   TabletCopyTest()
     : KuduTabletTest(Schema({ ColumnSchema("key", STRING),
                               ColumnSchema("val", INT32) }, 1)) {
+    CHECK_OK(ThreadPoolBuilder("test-prepare").Build(&prepare_pool_));
     CHECK_OK(ThreadPoolBuilder("test-exec").Build(&apply_pool_));
   }
 
@@ -109,6 +110,7 @@ class TabletCopyTest : public KuduTabletTest {
     tablet_peer_.reset(
         new TabletPeer(tablet()->metadata(),
                        config_peer,
+                       prepare_pool_.get(),
                        apply_pool_.get(),
                        Bind(&TabletCopyTest::TabletPeerStateChangedCallback,
                             Unretained(this),
@@ -133,6 +135,7 @@ class TabletCopyTest : public KuduTabletTest {
     ASSERT_OK(tablet_peer_->Init(tablet(),
                                  clock(),
                                  messenger,
+                                 nullptr,
                                  scoped_refptr<rpc::ResultTracker>(),
                                  log,
                                  metric_entity));
@@ -190,7 +193,7 @@ class TabletCopyTest : public KuduTabletTest {
   void FetchBlockToFile(const BlockId& block_id,
                         string* path,
                         gscoped_ptr<SequentialFile>* file) {
-    string data;
+    faststring data;
     int64_t block_file_size = 0;
     TabletCopyErrorPB::Code error_code;
     CHECK_OK(session_->GetBlockPiece(block_id, 0, 0, &data, &block_file_size, &error_code));
@@ -211,6 +214,7 @@ class TabletCopyTest : public KuduTabletTest {
 
   MetricRegistry metric_registry_;
   scoped_refptr<LogAnchorRegistry> log_anchor_registry_;
+  gscoped_ptr<ThreadPool> prepare_pool_;
   gscoped_ptr<ThreadPool> apply_pool_;
   scoped_refptr<TabletPeer> tablet_peer_;
   scoped_refptr<TabletCopySession> session_;
@@ -322,7 +326,7 @@ TEST_F(TabletCopyTest, TestBlocksAreFetchableAfterBeingDeleted) {
   // Read them back.
   for (const BlockId& block_id : data_blocks) {
     ASSERT_TRUE(session_->IsBlockOpenForTests(block_id));
-    string data;
+    faststring data;
     TabletCopyErrorPB::Code error_code;
     int64_t piece_size;
     ASSERT_OK(session_->GetBlockPiece(block_id, 0, 0,
@@ -28,6 +28,7 @@
 #include "kudu/gutil/type_traits.h"
 #include "kudu/rpc/transfer.h"
 #include "kudu/tablet/tablet_peer.h"
+#include "kudu/util/background_io_throttle.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/mutex.h"
 #include "kudu/util/stopwatch.h"
@@ -203,7 +204,7 @@ template <class Info>
 static Status ReadFileChunkToBuf(const Info* info,
                                  uint64_t offset, int64_t client_maxlen,
                                  const string& data_name,
-                                 string* data, int64_t* file_size,
+                                 faststring* data, int64_t* file_size,
                                  TabletCopyErrorPB::Code* error_code) {
   int64_t response_data_size = 0;
   RETURN_NOT_OK_PREPEND(GetResponseDataSize(info->size, offset, client_maxlen, error_code,
@@ -213,11 +214,8 @@ static Status ReadFileChunkToBuf(const Info* info,
   Stopwatch chunk_timer(Stopwatch::THIS_THREAD);
   chunk_timer.start();
 
-  // Writing into a std::string buffer is basically guaranteed to work on C++11,
-  // however any modern compiler should be compatible with it.
-  // Violates the API contract, but avoids excessive copies.
   data->resize(response_data_size);
-  uint8_t* buf = reinterpret_cast<uint8_t*>(const_cast<char*>(data->data()));
+  uint8_t* buf = data->data();
   Slice slice;
   Status s = info->ReadFully(offset, response_data_size, &slice, buf);
   if (PREDICT_FALSE(!s.ok())) {
@@ -242,11 +240,13 @@ static Status ReadFileChunkToBuf(const Info* info,
 
 Status TabletCopySession::GetBlockPiece(const BlockId& block_id,
                                              uint64_t offset, int64_t client_maxlen,
-                                             string* data, int64_t* block_file_size,
+                                             faststring* data, int64_t* block_file_size,
                                              TabletCopyErrorPB::Code* error_code) {
   ImmutableReadableBlockInfo* block_info;
   RETURN_NOT_OK(FindBlock(block_id, &block_info, error_code));
 
+  // Reading blocks for a copy counts against the background I/O budget.
+  BackgroundIOThrottle::ScopedBackgroundIO background_io;
   RETURN_NOT_OK(ReadFileChunkToBuf(block_info, offset, client_maxlen,
                                    Substitute("block $0", block_id.ToString()),
                                    data, block_file_size, error_code));
@@ -261,7 +261,7 @@ Status TabletCopySession::GetBlockPiece(const BlockId& block_id,
 
 Status TabletCopySession::GetLogSegmentPiece(uint64_t segment_seqno,
                                                   uint64_t offset, int64_t client_maxlen,
-                                                  std::string* data, int64_t* block_file_size,
+                                                  faststring* data, int64_t* block_file_size,
                                                   TabletCopyErrorPB::Code* error_code) {
   ImmutableRandomAccessFileInfo* file_info;
   RETURN_NOT_OK(FindLogSegment(segment_seqno, &file_info, error_code));
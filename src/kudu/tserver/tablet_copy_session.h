@@ -33,6 +33,7 @@
 #include "kudu/gutil/stl_util.h"
 #include "kudu/tserver/tablet_copy.pb.h"
 #include "kudu/util/env_util.h"
+#include "kudu/util/faststring.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/status.h"
 
@@ -104,15 +105,14 @@ class TabletCopySession : public RefCountedThreadSafe<TabletCopySession> {
 
   // Open block for reading, if it's not already open, and read some of it.
   // If maxlen is 0, we use a system-selected length for the data piece.
-  // *data is set to a std::string containing the data. Ownership of this object
-  // is passed to the caller. A string is used because the RPC interface is
-  // sending data serialized as protobuf and we want to minimize copying.
+  // *data is set to the bytes read. A faststring is used so that the buffer can
+  // be handed to the RPC layer as a sidecar without copying.
   // On error, Status is set to a non-OK value and error_code is filled in.
   //
   // This method is thread-safe.
   Status GetBlockPiece(const BlockId& block_id,
                        uint64_t offset, int64_t client_maxlen,
-                       std::string* data, int64_t* block_file_size,
+                       faststring* data, int64_t* block_file_size,
                        TabletCopyErrorPB::Code* error_code);
 
   // Get a piece of a log segment.
@@ -120,7 +120,7 @@ class TabletCopySession : public RefCountedThreadSafe<TabletCopySession> {
   // is only for sending WAL segment files.
   Status GetLogSegmentPiece(uint64_t segment_seqno,
                             uint64_t offset, int64_t client_maxlen,
-                            std::string* data, int64_t* log_file_size,
+                            faststring* data, int64_t* log_file_size,
                             TabletCopyErrorPB::Code* error_code);
 
   const tablet::TabletSuperBlockPB& tablet_superblock() const {
@@ -31,6 +31,7 @@ class HostPort;
 class NodeInstancePB;
 
 namespace consensus {
+class HeartbeatBatcher;
 class StartTabletCopyRequestPB;
 } // namespace consensus
 
@@ -53,6 +54,10 @@ class TabletPeerLookupIf {
 
   virtual Status StartTabletCopy(const consensus::StartTabletCopyRequestPB& req,
                                       boost::optional<TabletServerErrorPB::Code>* error_code) = 0;
+
+  // Returns the batcher through which the tablets send consensus heartbeats
+  // to other servers, or null if they don't batch them.
+  virtual consensus::HeartbeatBatcher* heartbeat_batcher() const = 0;
 };
 
 } // namespace tserver
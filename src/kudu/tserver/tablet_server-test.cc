@@ -16,14 +16,19 @@
 // under the License.
 #include "kudu/tserver/tablet_server-test-base.h"
 
+#include <boost/bind.hpp>
+
 #include "kudu/consensus/log-test-base.h"
+#include "kudu/consensus/opid_util.h"
 #include "kudu/gutil/strings/escaping.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/master/master.pb.h"
 #include "kudu/server/hybrid_clock.h"
 #include "kudu/server/server_base.pb.h"
 #include "kudu/server/server_base.proxy.h"
+#include "kudu/tablet/mvcc.h"
 #include "kudu/tablet/tablet_bootstrap.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/curl_util.h"
 #include "kudu/util/url-coding.h"
@@ -50,6 +55,7 @@ DEFINE_int32(single_threaded_insert_latency_bench_insert_rows, 1000,
              " tablet server insert latency micro-benchmark");
 
 DECLARE_int32(scanner_batch_size_rows);
+DECLARE_int32(scanner_max_aggregate_groups);
 DECLARE_int32(metrics_retirement_age_ms);
 DECLARE_string(block_manager);
 
@@ -58,6 +64,14 @@ METRIC_DECLARE_counter(rows_inserted);
 METRIC_DECLARE_counter(rows_updated);
 METRIC_DECLARE_counter(rows_deleted);
 METRIC_DECLARE_gauge_uint64(log_block_manager_blocks_under_management);
+METRIC_DECLARE_histogram(write_op_prepare_duration);
+METRIC_DECLARE_histogram(write_op_row_lock_duration);
+METRIC_DECLARE_histogram(write_op_replication_duration);
+METRIC_DECLARE_histogram(write_op_apply_duration);
+METRIC_DECLARE_histogram(write_op_mvcc_commit_duration);
+METRIC_DECLARE_histogram(scanner_iterator_init_duration);
+METRIC_DECLARE_histogram(scanner_decode_duration);
+METRIC_DECLARE_histogram(scanner_serialize_duration);
 
 namespace kudu {
 namespace tserver {
@@ -1017,6 +1031,81 @@ TEST_F(TabletServerTest, TestScan) {
   }
 }
 
+// Test that writes and scans record the time spent in each of their stages.
+TEST_F(TabletServerTest, TestStageDurationMetrics) {
+  const scoped_refptr<MetricEntity>& entity = tablet_peer_->tablet()->GetMetricEntity();
+  InsertTestRowsRemote(0, 0, 10, 2);
+  for (auto* proto : { &METRIC_write_op_prepare_duration,
+                       &METRIC_write_op_row_lock_duration,
+                       &METRIC_write_op_replication_duration,
+                       &METRIC_write_op_apply_duration,
+                       &METRIC_write_op_mvcc_commit_duration }) {
+    SCOPED_TRACE(proto->name());
+    ASSERT_EQ(2, proto->Instantiate(entity)->TotalCount());
+  }
+
+  // Only the flushed rows are decoded from disk.
+  ASSERT_OK(tablet_peer_->tablet()->Flush());
+  ScanResponsePB resp;
+  ASSERT_NO_FATAL_FAILURE(OpenScannerWithAllColumns(&resp));
+  vector<string> results;
+  ASSERT_NO_FATAL_FAILURE(DrainScannerToStrings(resp.scanner_id(), schema_, &results));
+  ASSERT_EQ(10, results.size());
+  ASSERT_EQ(1, METRIC_scanner_iterator_init_duration.Instantiate(entity)->TotalCount());
+  ASSERT_GT(METRIC_scanner_decode_duration.Instantiate(entity)->TotalCount(), 0);
+  ASSERT_GT(METRIC_scanner_serialize_duration.Instantiate(entity)->TotalCount(), 0);
+}
+
+// Test looking up rows by primary key, in both flushed and in-memory data.
+TEST_F(TabletServerTest, TestLookupRows) {
+  InsertTestRowsDirect(0, 100);
+  ASSERT_OK(tablet_peer_->tablet()->Flush());
+  InsertTestRowsDirect(100, 100);
+  ASSERT_NO_FATAL_FAILURE(DeleteTestRowsRemote(10, 1));
+
+  const vector<int> keys = { 150, 5, 1000, 10, 42 };
+  LookupRowsRequestPB req;
+  req.set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, req.mutable_projected_columns()));
+  KuduPartialRow key_row(&schema_);
+  for (int key : keys) {
+    ASSERT_OK(key_row.SetInt32(0, key));
+    ASSERT_OK(key_row.EncodeRowKey(req.add_encoded_primary_keys()));
+  }
+
+  LookupRowsResponsePB resp;
+  rpc::RpcController rpc;
+  ASSERT_OK(proxy_->LookupRows(req, &resp, &rpc));
+  SCOPED_TRACE(resp.DebugString());
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_EQ(keys.size(), resp.found_size());
+
+  ScanResponsePB scan_resp;
+  scan_resp.mutable_data()->Swap(resp.mutable_data());
+  vector<string> results;
+  ASSERT_NO_FATAL_FAILURE(StringifyRowsFromResponse(schema_, rpc, scan_resp, &results));
+
+  vector<string> expected;
+  KuduPartialRow row(&schema_);
+  for (int i = 0; i < keys.size(); i++) {
+    bool exists = keys[i] < 200 && keys[i] != 10;
+    ASSERT_EQ(exists, resp.found(i)) << keys[i];
+    if (exists) {
+      BuildTestRow(keys[i], &row);
+      expected.push_back("(" + row.ToString() + ")");
+    }
+  }
+  ASSERT_EQ(expected, results);
+
+  // A key must set every key column.
+  req.clear_encoded_primary_keys();
+  req.add_encoded_primary_keys("x");
+  rpc.Reset();
+  ASSERT_OK(proxy_->LookupRows(req, &resp, &rpc));
+  ASSERT_TRUE(resp.has_error());
+  ASSERT_EQ(TabletServerErrorPB::INVALID_SCAN_SPEC, resp.error().code());
+}
+
 TEST_F(TabletServerTest, TestScannerOpenWhenServerShutsDown) {
   InsertTestRowsDirect(0, 1);
 
@@ -1129,6 +1218,88 @@ TEST_F(TabletServerTest, TestSnapshotScan_WithoutSnapshotTimestamp) {
   ASSERT_GE(resp.snap_timestamp(), now.ToUint64());
 }
 
+// Tests that a snapshot scan which has to wait for an in-flight operation is
+// parked until the operation commits, and that one whose deadline passes first
+// fails with the usual error.
+TEST_F(TabletServerTest, TestSnapshotScan_WaitsForInFlightOps) {
+  InsertTestRowsRemote(0, 0, 1);
+  tablet::MvccManager* mvcc = tablet_peer_->tablet()->mvcc_manager();
+  Timestamp in_flight = mvcc->StartTransaction();
+
+  ScanRequestPB req;
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+
+  // This one times out while the operation is still in flight.
+  {
+    ScanResponsePB resp;
+    RpcController rpc;
+    rpc.set_timeout(MonoDelta::FromMilliseconds(500));
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    ASSERT_TRUE(resp.has_error());
+    ASSERT_EQ(TabletServerErrorPB::INVALID_SNAPSHOT, resp.error().code());
+    ASSERT_STR_CONTAINS(resp.error().status().message(),
+                        "could not wait for desired snapshot timestamp to be consistent");
+  }
+
+  // This one completes once the operation commits.
+  ScanResponsePB resp;
+  RpcController rpc;
+  CountDownLatch latch(1);
+  proxy_->ScanAsync(req, &resp, &rpc, boost::bind(&CountDownLatch::CountDown, &latch));
+  ASSERT_FALSE(latch.WaitFor(MonoDelta::FromMilliseconds(100)));
+
+  mvcc->StartApplyingTransaction(in_flight);
+  mvcc->CommitTransaction(in_flight);
+  latch.Wait();
+  ASSERT_OK(rpc.status());
+  SCOPED_TRACE(resp.DebugString());
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_EQ(1, resp.data().num_rows());
+}
+
+// Tests that a bounded-staleness scan on the leader reads at the current time,
+// and that the max staleness is only accepted for server-chosen snapshots.
+TEST_F(TabletServerTest, TestSnapshotScan_MaxStaleness) {
+  InsertTestRowsRemote(0, 0, 1);
+
+  ScanRequestPB req;
+  ScanResponsePB resp;
+  RpcController rpc;
+
+  NewScanRequestPB* scan = req.mutable_new_scan_request();
+  scan->set_tablet_id(kTabletId);
+  ASSERT_OK(SchemaToColumnPBs(schema_, scan->mutable_projected_columns()));
+  req.set_call_seq_id(0);
+  req.set_batch_size_bytes(0); // so it won't return data right away
+  scan->set_read_mode(READ_AT_SNAPSHOT);
+  scan->set_max_staleness_us(0);
+
+  Timestamp now = mini_server_->server()->clock()->Now();
+  {
+    SCOPED_TRACE(req.DebugString());
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(resp.DebugString());
+    ASSERT_FALSE(resp.has_error());
+  }
+  ASSERT_GE(resp.snap_timestamp(), now.ToUint64());
+
+  // READ_LATEST scans can't bound their staleness.
+  scan->set_read_mode(READ_LATEST);
+  resp.Clear();
+  rpc.Reset();
+  {
+    SCOPED_TRACE(req.DebugString());
+    ASSERT_OK(proxy_->Scan(req, &resp, &rpc));
+    SCOPED_TRACE(resp.DebugString());
+    ASSERT_TRUE(resp.has_error());
+    ASSERT_EQ(TabletServerErrorPB::INVALID_SCAN_SPEC, resp.error().code());
+  }
+}
+
 // Tests that a snapshot in the future (beyond the current time plus maximum
 // synchronization error) fails as an invalid snapshot.
 TEST_F(TabletServerTest, TestSnapshotScan_SnapshotInTheFutureFails) {
@@ -1875,6 +2046,40 @@ TEST_F(TabletServerTest, TestCreateTablet_TabletExists) {
   }
 }
 
+// Test that the heartbeats in a MultiRaftHeartbeat RPC are each handed to
+// their tablet, with errors reported per tablet.
+TEST_F(TabletServerTest, TestMultiRaftHeartbeat) {
+  const string uuid = mini_server_->server()->fs_manager()->uuid();
+  consensus::MultiRaftHeartbeatRequestPB req;
+  consensus::MultiRaftHeartbeatResponsePB resp;
+  RpcController rpc;
+  req.set_dest_uuid(uuid);
+  for (const string& tablet_id : { string(kTabletId), string("not-a-tablet") }) {
+    consensus::ConsensusRequestPB* hb = req.add_heartbeats();
+    hb->set_dest_uuid(uuid);
+    hb->set_tablet_id(tablet_id);
+    hb->set_caller_uuid("fake-leader");
+    hb->set_caller_term(0);
+    hb->mutable_committed_index()->CopyFrom(consensus::MinimumOpId());
+  }
+
+  SCOPED_TRACE(req.DebugString());
+  ASSERT_OK(consensus_proxy_->MultiRaftHeartbeat(req, &resp, &rpc));
+  SCOPED_TRACE(resp.DebugString());
+  ASSERT_FALSE(resp.has_error());
+  ASSERT_EQ(2, resp.responses_size());
+
+  // The tablet exists, but rejects the heartbeat from an earlier term.
+  const consensus::ConsensusResponsePB& tablet_resp = resp.responses(0);
+  ASSERT_FALSE(tablet_resp.has_error());
+  ASSERT_EQ(uuid, tablet_resp.responder_uuid());
+  ASSERT_EQ(consensus::ConsensusErrorPB::INVALID_TERM,
+            tablet_resp.status().error().code());
+
+  ASSERT_TRUE(resp.responses(1).has_error());
+  ASSERT_EQ(TabletServerErrorPB::TABLET_NOT_FOUND, resp.responses(1).error().code());
+}
+
 TEST_F(TabletServerTest, TestDeleteTablet) {
   scoped_refptr<TabletPeer> tablet;
 
@@ -2087,7 +2292,8 @@ TEST_F(TabletServerTest, TestWriteOutOfBounds) {
       "TestWriteOutOfBoundsTable", tabletId,
       partitions[1],
       tabletId, schema, partition_schema,
-      mini_server_->CreateLocalConfig(), nullptr));
+      mini_server_->CreateLocalConfig(), tablet::UNKNOWN_COMPACTION_POLICY, -1, nullptr,
+      false, nullptr));
 
   ASSERT_OK(WaitForTabletRunning(tabletId));
 
@@ -2214,6 +2420,103 @@ TEST_F(TabletServerTest, TestChecksumScan) {
   ASSERT_FALSE(resp.has_more_results());
 }
 
+TEST_F(TabletServerTest, TestAggregateScan) {
+  // Rows 0-9 have a string value, and rows 10-11 have a NULL string.
+  InsertTestRowsRemote(0, 0, 10);
+  InsertTestRowsRemote(0, 10, 2, 1, nullptr, kTabletId, nullptr, nullptr, false);
+
+  AggregateRequestPB req;
+  req.mutable_new_request()->set_tablet_id(kTabletId);
+  req.mutable_new_request()->set_read_mode(READ_LATEST);
+  req.set_call_seq_id(0);
+  ASSERT_OK(SchemaToColumnPBs(schema_, req.mutable_new_request()->mutable_projected_columns(),
+                              SCHEMA_PB_WITHOUT_IDS));
+  req.add_aggregates()->set_function(AggregateSpecPB::COUNT);
+  const struct {
+    AggregateSpecPB::Function function;
+    const char* column;
+  } kAggregates[] = {
+    { AggregateSpecPB::COUNT, "string_val" },
+    { AggregateSpecPB::SUM, "int_val" },
+    { AggregateSpecPB::MIN, "int_val" },
+    { AggregateSpecPB::MAX, "string_val" },
+  };
+  for (const auto& agg : kAggregates) {
+    AggregateSpecPB* spec = req.add_aggregates();
+    spec->set_function(agg.function);
+    spec->set_column(agg.column);
+  }
+
+  // Without a group-by column, there is a single group.
+  {
+    AggregateResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->Aggregate(req, &resp, &controller));
+    ASSERT_FALSE(resp.has_error()) << resp.error().DebugString();
+    ASSERT_FALSE(resp.has_more_results());
+    ASSERT_EQ(12, resp.rows_aggregated());
+    ASSERT_EQ(1, resp.groups_size());
+    const AggregateGroupPB& group = resp.groups(0);
+    ASSERT_FALSE(group.has_group_value());
+    ASSERT_EQ(5, group.values_size());
+    EXPECT_EQ(12, group.values(0).int_value());
+    EXPECT_EQ(10, group.values(1).int_value());
+    EXPECT_EQ(66, group.values(2).int_value());
+    int32_t min_val;
+    ASSERT_EQ(sizeof(min_val), group.values(3).cell_value().size());
+    memcpy(&min_val, group.values(3).cell_value().data(), sizeof(min_val));
+    EXPECT_EQ(0, min_val);
+    EXPECT_EQ("original9", group.values(4).cell_value());
+  }
+
+  // Group by the nullable string column: each row has its own group, and the
+  // NULL rows share one.
+  req.set_group_by_column("string_val");
+  {
+    AggregateResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->Aggregate(req, &resp, &controller));
+    ASSERT_FALSE(resp.has_error()) << resp.error().DebugString();
+    ASSERT_EQ(11, resp.groups_size());
+    int null_groups = 0;
+    for (const AggregateGroupPB& group : resp.groups()) {
+      if (!group.has_group_value()) {
+        null_groups++;
+        EXPECT_EQ(2, group.values(0).int_value());
+        EXPECT_EQ(0, group.values(1).int_value());
+        EXPECT_EQ(21, group.values(2).int_value());
+        EXPECT_FALSE(group.values(4).has_cell_value());
+      } else {
+        EXPECT_EQ(1, group.values(0).int_value());
+        EXPECT_EQ(group.group_value(), group.values(4).cell_value());
+      }
+    }
+    EXPECT_EQ(1, null_groups);
+  }
+
+  // Too many groups fails the scan.
+  FLAGS_scanner_max_aggregate_groups = 5;
+  {
+    AggregateResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->Aggregate(req, &resp, &controller));
+    ASSERT_TRUE(resp.has_error());
+    ASSERT_STR_CONTAINS(StatusFromPB(resp.error().status()).ToString(),
+                        "more than 5 groups");
+  }
+
+  // An invalid aggregate (SUM without a column) fails the scan.
+  req.clear_group_by_column();
+  req.add_aggregates()->set_function(AggregateSpecPB::SUM);
+  {
+    AggregateResponsePB resp;
+    RpcController controller;
+    ASSERT_OK(proxy_->Aggregate(req, &resp, &controller));
+    ASSERT_TRUE(resp.has_error());
+    ASSERT_EQ(TabletServerErrorPB::INVALID_SCAN_SPEC, resp.error().code());
+  }
+}
+
 class DelayFsyncLogHook : public log::Log::LogFaultHooks {
  public:
   DelayFsyncLogHook() : log_latch1_(1), test_latch1_(1) {}
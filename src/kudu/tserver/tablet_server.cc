@@ -22,11 +22,13 @@
 #include <vector>
 
 #include "kudu/cfile/block_cache.h"
+#include "kudu/codegen/compilation_manager.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/rpc/service_if.h"
 #include "kudu/server/rpc_server.h"
 #include "kudu/server/webserver.h"
+#include "kudu/tserver/block_cache_warmer.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/scanners.h"
 #include "kudu/tserver/tablet_service.h"
@@ -52,7 +54,7 @@ TabletServer::TabletServer(const TabletServerOptions& opts)
     fail_heartbeats_for_tests_(false),
     opts_(opts),
     tablet_manager_(new TSTabletManager(fs_manager_.get(), this, metric_registry())),
-    scanner_manager_(new ScannerManager(metric_entity())),
+    scanner_manager_(new ScannerManager(metric_entity(), mem_tracker())),
     path_handlers_(new TabletServerPathHandlers(this)),
     maintenance_manager_(new MaintenanceManager(MaintenanceManager::DEFAULT_OPTIONS)) {
 }
@@ -92,12 +94,22 @@ Status TabletServer::Init() {
 
   heartbeater_.reset(new Heartbeater(opts_, this));
 
+  // Open the code cache before the tablets, whose scans and flushes request
+  // compilations.
+  WARN_NOT_OK(codegen::CompilationManager::GetSingleton()->OpenPersistentCache(
+                  fs_manager_->env(), fs_manager_->GetCodegenCacheDir()),
+              "Could not open the persistent code cache");
+
   RETURN_NOT_OK_PREPEND(tablet_manager_->Init(),
                         "Could not init Tablet Manager");
 
   RETURN_NOT_OK_PREPEND(scanner_manager_->StartRemovalThread(),
                         "Could not start expired Scanner removal thread");
 
+  block_cache_warmer_.reset(new BlockCacheWarmer(fs_manager_.get(), tablet_manager_.get()));
+  RETURN_NOT_OK_PREPEND(block_cache_warmer_->Start(),
+                        "Could not start block cache warmer thread");
+
   initted_ = true;
   return Status::OK();
 }
@@ -138,6 +150,7 @@ void TabletServer::Shutdown() {
     maintenance_manager_->Shutdown();
     WARN_NOT_OK(heartbeater_->Stop(), "Failed to stop TS Heartbeat thread");
     ServerBase::Shutdown();
+    block_cache_warmer_->Shutdown();
     tablet_manager_->Shutdown();
   }
 
@@ -39,6 +39,7 @@ class MaintenanceManager;
 
 namespace tserver {
 
+class BlockCacheWarmer;
 class Heartbeater;
 class ScannerManager;
 class TabletServerPathHandlers;
@@ -111,6 +112,9 @@ class TabletServer : public server::ServerBase {
   // Thread responsible for heartbeating to the master.
   gscoped_ptr<Heartbeater> heartbeater_;
 
+  // Records and restores the contents of the block cache across restarts.
+  gscoped_ptr<BlockCacheWarmer> block_cache_warmer_;
+
   // Webserver path handlers
   gscoped_ptr<TabletServerPathHandlers> path_handlers_;
 
@@ -19,23 +19,32 @@
 
 #include <algorithm>
 #include <boost/optional.hpp>
+#include <limits>
 #include <memory>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include "kudu/codegen/compilation_manager.h"
+#include "kudu/codegen/row_serializer.h"
 #include "kudu/common/iterator.h"
 #include "kudu/common/scan_spec.h"
 #include "kudu/common/schema.h"
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus.h"
+#include "kudu/consensus/heartbeat_batcher.h"
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/casts.h"
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/gutil/strings/escaping.h"
+#include "kudu/rpc/messenger.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/rpc/rpc_sidecar.h"
 #include "kudu/server/hybrid_clock.h"
+#include "kudu/tablet/compaction.h"
 #include "kudu/tablet/metadata.pb.h"
 #include "kudu/tablet/tablet_bootstrap.h"
 #include "kudu/tablet/tablet_metrics.h"
@@ -47,15 +56,18 @@
 #include "kudu/tserver/tablet_server.h"
 #include "kudu/tserver/ts_tablet_manager.h"
 #include "kudu/tserver/tserver.pb.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/crc.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/faststring.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/logging.h"
+#include "kudu/util/maintenance_manager.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/monotime.h"
 #include "kudu/util/status.h"
 #include "kudu/util/status_callback.h"
+#include "kudu/util/threadpool.h"
 #include "kudu/util/trace.h"
 
 DEFINE_int32(scanner_default_batch_size_bytes, 1024 * 1024,
@@ -70,10 +82,37 @@ TAG_FLAG(scanner_max_batch_size_bytes, advanced);
 TAG_FLAG(scanner_max_batch_size_bytes, runtime);
 
 DEFINE_int32(scanner_batch_size_rows, 100,
-             "The number of rows to batch for servicing scan requests.");
+             "The minimum number of rows to batch for servicing scan requests. "
+             "Requests for large batches of scan results are serviced with "
+             "larger batches of rows, up to --scanner_max_batch_size_rows.");
 TAG_FLAG(scanner_batch_size_rows, advanced);
 TAG_FLAG(scanner_batch_size_rows, runtime);
 
+DEFINE_int32(scanner_max_batch_size_rows, 4096,
+             "The maximum number of rows to batch for servicing scan requests.");
+TAG_FLAG(scanner_max_batch_size_rows, advanced);
+TAG_FLAG(scanner_max_batch_size_rows, runtime);
+
+DEFINE_int32(scanner_max_aggregate_groups, 1024,
+             "The maximum number of distinct group-by values that an Aggregate "
+             "scan may produce in a single request.");
+TAG_FLAG(scanner_max_aggregate_groups, advanced);
+TAG_FLAG(scanner_max_aggregate_groups, runtime);
+
+DEFINE_bool(scanner_async_snapshot_wait, true,
+            "Whether a snapshot scan which has to wait for in-flight operations "
+            "to commit releases its RPC service thread while waiting, instead "
+            "of blocking it.");
+TAG_FLAG(scanner_async_snapshot_wait, advanced);
+TAG_FLAG(scanner_async_snapshot_wait, runtime);
+
+DEFINE_bool(scanner_use_codegen_serialization, true,
+            "Whether to serialize row-wise scan results with code generated for "
+            "the scan's projection. Until the code is compiled, results are "
+            "serialized by the interpreted path.");
+TAG_FLAG(scanner_use_codegen_serialization, experimental);
+TAG_FLAG(scanner_use_codegen_serialization, runtime);
+
 // Fault injection flags.
 DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "If set, the scanner will pause the specified number of milliesconds "
@@ -81,13 +120,29 @@ DEFINE_int32(scanner_inject_latency_on_each_batch_ms, 0,
              "Used for tests.");
 TAG_FLAG(scanner_inject_latency_on_each_batch_ms, unsafe);
 
+DEFINE_int32(write_memory_pressure_max_delay_ms, 100,
+             "Maximum time for which a write is delayed while the memory usage of "
+             "the tablet server is between its soft and hard limits. The delay "
+             "grows linearly from zero at the soft limit to this value at the hard "
+             "limit, slowing down writers while memstores are flushed; writes are "
+             "only rejected once the hard limit is reached. If 0, writes are "
+             "rejected as soon as the soft limit is exceeded, with a probability "
+             "that grows with the memory usage.");
+TAG_FLAG(write_memory_pressure_max_delay_ms, advanced);
+TAG_FLAG(write_memory_pressure_max_delay_ms, runtime);
+
 DECLARE_int32(memory_limit_warn_threshold_percentage);
 
 namespace kudu {
+extern const char* SCAN_PREDICATE_EVAL_TIME_METRIC_NAME;
 namespace cfile {
 extern const char* CFILE_CACHE_MISS_BYTES_METRIC_NAME;
 extern const char* CFILE_CACHE_HIT_BYTES_METRIC_NAME;
 }
+namespace tablet {
+extern const char* SCAN_DECODE_TIME_METRIC_NAME;
+extern const char* SCAN_DELTA_APPLY_TIME_METRIC_NAME;
+}
 }
 
 namespace kudu {
@@ -106,6 +161,8 @@ using consensus::GetNodeInstanceRequestPB;
 using consensus::GetNodeInstanceResponsePB;
 using consensus::LeaderStepDownRequestPB;
 using consensus::LeaderStepDownResponsePB;
+using consensus::MultiRaftHeartbeatRequestPB;
+using consensus::MultiRaftHeartbeatResponsePB;
 using consensus::RunLeaderElectionRequestPB;
 using consensus::RunLeaderElectionResponsePB;
 using consensus::StartTabletCopyRequestPB;
@@ -130,21 +187,14 @@ using tablet::WriteTransactionState;
 namespace {
 
 // Lookup the given tablet, ensuring that it both exists and is RUNNING.
-// If it is not, responds to the RPC associated with 'context' after setting
-// resp->mutable_error() to indicate the failure reason.
-//
-// Returns true if successful.
-template<class RespClass>
-bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
+// If it is not, returns the failure reason and sets 'error_code'.
+Status LookupRunningTabletPeer(TabletPeerLookupIf* tablet_manager,
                                const string& tablet_id,
-                               RespClass* resp,
-                               rpc::RpcContext* context,
-                               scoped_refptr<TabletPeer>* peer) {
+                               scoped_refptr<TabletPeer>* peer,
+                               TabletServerErrorPB::Code* error_code) {
   if (PREDICT_FALSE(!tablet_manager->GetTabletPeer(tablet_id, peer).ok())) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::NotFound("Tablet not found"),
-                         TabletServerErrorPB::TABLET_NOT_FOUND, context);
-    return false;
+    *error_code = TabletServerErrorPB::TABLET_NOT_FOUND;
+    return Status::NotFound("Tablet not found");
   }
 
   // Check RUNNING state.
@@ -155,8 +205,27 @@ bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
     if (state == tablet::FAILED) {
       s = s.CloneAndAppend((*peer)->error().ToString());
     }
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::TABLET_NOT_RUNNING, context);
+    *error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+    return s;
+  }
+  return Status::OK();
+}
+
+// Lookup the given tablet, ensuring that it both exists and is RUNNING.
+// If it is not, responds to the RPC associated with 'context' after setting
+// resp->mutable_error() to indicate the failure reason.
+//
+// Returns true if successful.
+template<class RespClass>
+bool LookupTabletPeerOrRespond(TabletPeerLookupIf* tablet_manager,
+                               const string& tablet_id,
+                               RespClass* resp,
+                               rpc::RpcContext* context,
+                               scoped_refptr<TabletPeer>* peer) {
+  TabletServerErrorPB::Code error_code;
+  Status s = LookupRunningTabletPeer(tablet_manager, tablet_id, peer, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
     return false;
   }
   return true;
@@ -303,12 +372,82 @@ class RpcTransactionCompletionCallback : public TransactionCompletionCallback {
   tablet::TransactionState* state_;
 };
 
+// Collects the responses to the writes of a MultiWrite RPC, responding to the
+// RPC once the last of them has completed.
+class MultiWriteTracker {
+ public:
+  MultiWriteTracker(rpc::RpcContext* context, int num_writes)
+      : context_(context),
+        num_remaining_(num_writes) {
+  }
+
+  // Records that the write whose response is 'resp' failed with 's'.
+  void WriteFailed(WriteResponsePB* resp, const Status& s, TabletServerErrorPB::Code code) {
+    StatusToPB(s, resp->mutable_error()->mutable_status());
+    resp->mutable_error()->set_code(code);
+    WriteDone();
+  }
+
+  void WriteDone() {
+    // The barrier makes every other write's response visible to whichever
+    // thread ends up responding.
+    if (num_remaining_.IncrementBy(-1, kMemOrderBarrier) == 0) {
+      context_->RespondSuccess();
+    }
+  }
+
+ private:
+  rpc::RpcContext* context_;
+  AtomicInt<int32_t> num_remaining_;
+};
+
+// A transaction completion callback for one of the writes of a MultiWrite RPC.
+class MultiWriteCompletionCallback : public TransactionCompletionCallback {
+ public:
+  MultiWriteCompletionCallback(shared_ptr<MultiWriteTracker> tracker,
+                               WriteResponsePB* response)
+      : tracker_(std::move(tracker)),
+        response_(response) {
+  }
+
+  virtual void TransactionCompleted() OVERRIDE {
+    if (!status_.ok()) {
+      tracker_->WriteFailed(response_, status_, code_);
+    } else {
+      tracker_->WriteDone();
+    }
+  }
+
+ private:
+  shared_ptr<MultiWriteTracker> tracker_;
+  WriteResponsePB* response_;
+};
+
 // Generic interface to handle scan results.
 class ScanResultCollector {
  public:
+  // Prepares the collector to serialize rows using the given bitfield of
+  // RowFormatFlags. Called before the first HandleRowBlock() of each request,
+  // with the schema of the row blocks which will be passed to it.
+  //
+  // Collectors which do not return rows to the client only support NO_FLAGS.
+  virtual Status InitSerializer(uint64_t row_format_flags, const Schema& scanner_schema) {
+    if (row_format_flags != NO_FLAGS) {
+      return Status::NotSupported("row format flags not supported by this scan");
+    }
+    return Status::OK();
+  }
+
   virtual void HandleRowBlock(const Schema* client_projection_schema,
                               const RowBlock& row_block) = 0;
 
+  // Handles 'num_rows' rows of an empty projection without a RowBlock, as
+  // computed by the count-only fast path. Returns false if the collector
+  // needs the rows themselves, in which case the tablet is scanned.
+  virtual bool HandleRowCount(int64_t num_rows) {
+    return false;
+  }
+
   // Returns number of times HandleRowBlock() was called.
   virtual int BlocksProcessed() const = 0;
 
@@ -341,6 +480,27 @@ void SetLastRow(const RowBlock& row_block, faststring* last_primary_key) {
   }
 }
 
+// Unselects the rows of 'block' past the remaining row limit of 'scanner',
+// and counts the rows which are left selected against the limit.
+void ApplyScanLimit(Scanner* scanner, RowBlock* block) {
+  DCHECK(scanner->has_limit());
+  uint64_t remaining = scanner->limit() - std::min(scanner->limit(),
+                                                   scanner->num_rows_limited());
+  SelectionVector* sel = block->selection_vector();
+  uint64_t selected = 0;
+  for (size_t i = 0; i < block->nrows(); i++) {
+    if (!sel->IsRowSelected(i)) {
+      continue;
+    }
+    if (selected == remaining) {
+      sel->SetRowUnselected(i);
+    } else {
+      selected++;
+    }
+  }
+  scanner->add_num_rows_limited(selected);
+}
+
 }  // namespace
 
 // Copies the scan result to the given row block PB and data buffers.
@@ -358,25 +518,80 @@ class ScanResultCopier : public ScanResultCollector {
         rows_data_(DCHECK_NOTNULL(rows_data)),
         indirect_data_(DCHECK_NOTNULL(indirect_data)),
         blocks_processed_(0),
-        num_rows_returned_(0) {
+        num_rows_returned_(0),
+        columnar_(false),
+        serializer_requested_(false) {
+  }
+
+  virtual Status InitSerializer(uint64_t row_format_flags,
+                                const Schema& /* scanner_schema */) OVERRIDE {
+    columnar_ = row_format_flags & COLUMNAR_LAYOUT;
+    return Status::OK();
   }
 
   virtual void HandleRowBlock(const Schema* client_projection_schema,
                               const RowBlock& row_block) OVERRIDE {
     blocks_processed_++;
     num_rows_returned_ += row_block.selection_vector()->CountSelected();
-    SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
-                      rows_data_, indirect_data_);
+    if (columnar_) {
+      SerializeRowBlockColumnar(row_block, client_projection_schema, &columnar_batch_);
+    } else {
+      if (!serializer_requested_ && FLAGS_scanner_use_codegen_serialization) {
+        // All the blocks of a scan share the schema, so the cache is only
+        // consulted once per batch.
+        serializer_requested_ = true;
+        codegen::CompilationManager::GetSingleton()->RequestRowSerializer(
+            &row_block.schema(),
+            client_projection_schema ? client_projection_schema : &row_block.schema(),
+            &serializer_);
+      }
+      if (serializer_) {
+        serializer_->SerializeRowBlock(row_block, rowblock_pb_, rows_data_, indirect_data_);
+      } else {
+        SerializeRowBlock(row_block, rowblock_pb_, client_projection_schema,
+                          rows_data_, indirect_data_);
+      }
+    }
     SetLastRow(row_block, &last_primary_key_);
   }
 
+  virtual bool HandleRowCount(int64_t num_rows) OVERRIDE {
+    if (columnar_) {
+      columnar_batch_.num_rows += num_rows;
+    } else {
+      int64_t total = rowblock_pb_->num_rows() + num_rows;
+      if (total > std::numeric_limits<int32_t>::max()) {
+        return false;
+      }
+      rowblock_pb_->set_num_rows(total);
+    }
+    blocks_processed_++;
+    num_rows_returned_ += num_rows;
+    return true;
+  }
+
   virtual int BlocksProcessed() const OVERRIDE { return blocks_processed_; }
 
   // Returns number of bytes buffered to return.
   virtual int64_t ResponseSize() const OVERRIDE {
-    return rows_data_->size() + indirect_data_->size();
+    if (!columnar_) {
+      return rows_data_->size() + indirect_data_->size();
+    }
+    int64_t size = 0;
+    for (const auto& col : columnar_batch_.columns) {
+      size += col.data->size();
+      if (col.varlen_data) size += col.varlen_data->size();
+      if (col.non_null_bitmap) size += col.non_null_bitmap->size();
+    }
+    return size;
   }
 
+  // Whether the rows were serialized in the columnar layout rather than
+  // into the row block PB and buffers passed to the constructor.
+  bool columnar() const { return columnar_; }
+
+  ColumnarSerializedBatch* columnar_batch() { return &columnar_batch_; }
+
   virtual const faststring& last_primary_key() const OVERRIDE {
     return last_primary_key_;
   }
@@ -392,6 +607,13 @@ class ScanResultCopier : public ScanResultCollector {
   int blocks_processed_;
   int64_t num_rows_returned_;
   faststring last_primary_key_;
+  bool columnar_;
+  ColumnarSerializedBatch columnar_batch_;
+
+  // Set on the first row-wise block; 'serializer_' stays NULL if the
+  // serializer for the scan's schemas hadn't been compiled yet.
+  bool serializer_requested_;
+  gscoped_ptr<codegen::RowSerializer> serializer_;
 
   DISALLOW_COPY_AND_ASSIGN(ScanResultCopier);
 };
@@ -413,11 +635,20 @@ class ScanResultChecksummer : public ScanResultCollector {
       client_projection_schema = &row_block.schema();
     }
 
+    // Look up the columns of the projection once per block rather than for
+    // every cell.
+    size_t num_cols = client_projection_schema->num_columns();
+    columns_.clear();
+    for (size_t j = 0; j < num_cols; j++) {
+      ColumnBlock col = row_block.column_block(j);
+      columns_.push_back({ col, col.type_info()->physical_type() == BINARY });
+    }
+
     size_t nrows = row_block.nrows();
+    const SelectionVector* sel = row_block.selection_vector();
     for (size_t i = 0; i < nrows; i++) {
-      if (!row_block.selection_vector()->IsRowSelected(i)) continue;
-      uint32_t row_crc = CalcRowCrc32(*client_projection_schema, row_block.row(i));
-      agg_checksum_ += row_crc;
+      if (!sel->IsRowSelected(i)) continue;
+      agg_checksum_ += CalcRowCrc32(i);
       rows_checksummed_++;
     }
     // Find the last selected row and save its encoded key.
@@ -444,24 +675,35 @@ class ScanResultChecksummer : public ScanResultCollector {
   uint64_t agg_checksum() const { return agg_checksum_; }
 
  private:
-  // Calculates a CRC32C for the given row.
-  uint32_t CalcRowCrc32(const Schema& projection, const RowBlockRow& row) {
+  struct Column {
+    ColumnBlock block;
+    bool is_binary;
+  };
+
+  // Calculates a CRC32C for row 'row_idx' of the columns in 'columns_'.
+  //
+  // The checksums of all the replicas of a tablet are compared with each
+  // other, so the bytes that go into the CRC must not change: for each
+  // column, its index, whether it is defined if it is nullable, and then its
+  // value.
+  uint32_t CalcRowCrc32(size_t row_idx) {
     tmp_buf_.clear();
 
-    for (size_t j = 0; j < projection.num_columns(); j++) {
+    for (size_t j = 0; j < columns_.size(); j++) {
+      const Column& col = columns_[j];
       uint32_t col_index = static_cast<uint32_t>(j);  // For the CRC.
       tmp_buf_.append(&col_index, sizeof(col_index));
-      ColumnBlockCell cell = row.cell(j);
-      if (cell.is_nullable()) {
-        uint8_t is_defined = cell.is_null() ? 0 : 1;
+      if (col.block.is_nullable()) {
+        uint8_t is_defined = col.block.is_null(row_idx) ? 0 : 1;
         tmp_buf_.append(&is_defined, sizeof(is_defined));
         if (!is_defined) continue;
       }
-      if (cell.typeinfo()->physical_type() == BINARY) {
-        const Slice* data = reinterpret_cast<const Slice *>(cell.ptr());
+      const uint8_t* ptr = col.block.cell_ptr(row_idx);
+      if (col.is_binary) {
+        const Slice* data = reinterpret_cast<const Slice *>(ptr);
         tmp_buf_.append(data->data(), data->size());
       } else {
-        tmp_buf_.append(cell.ptr(), cell.size());
+        tmp_buf_.append(ptr, col.block.stride());
       }
     }
 
@@ -470,7 +712,8 @@ class ScanResultChecksummer : public ScanResultCollector {
     return static_cast<uint32_t>(row_crc); // CRC32 only uses the lower 32 bits.
   }
 
-
+  // The columns of the block being checksummed.
+  vector<Column> columns_;
   faststring tmp_buf_;
   crc::Crc* const crc_;
   uint64_t agg_checksum_;
@@ -481,6 +724,363 @@ class ScanResultChecksummer : public ScanResultCollector {
   DISALLOW_COPY_AND_ASSIGN(ScanResultChecksummer);
 };
 
+// Computes partial aggregates (COUNT, SUM, MIN and MAX), optionally grouped
+// by a low-cardinality column, over the scan result. Only the aggregates are
+// returned to the client.
+//
+// Errors found while aggregating, such as too many groups, are reported
+// through status() once the request is done.
+class ScanResultAggregator : public ScanResultCollector {
+ public:
+  ScanResultAggregator(const RepeatedPtrField<AggregateSpecPB>& aggregates,
+                       string group_by_column)
+      : aggregates_(aggregates.begin(), aggregates.end()),
+        group_by_column_(std::move(group_by_column)),
+        schema_(nullptr),
+        group_by_idx_(-1),
+        blocks_processed_(0),
+        rows_aggregated_(0) {
+  }
+
+  virtual Status InitSerializer(uint64_t row_format_flags,
+                                const Schema& scanner_schema) OVERRIDE {
+    RETURN_NOT_OK(ScanResultCollector::InitSerializer(row_format_flags, scanner_schema));
+    schema_ = &scanner_schema;
+    col_idxs_.clear();
+    for (const AggregateSpecPB& agg : aggregates_) {
+      int idx = -1;
+      if (agg.has_column()) {
+        idx = scanner_schema.find_column(agg.column());
+        if (idx == -1) {
+          return Status::InvalidArgument("aggregated column is not projected", agg.column());
+        }
+      }
+      const TypeInfo* type = idx == -1 ? nullptr : scanner_schema.column(idx).type_info();
+      switch (agg.function()) {
+        case AggregateSpecPB::COUNT:
+          break;
+        case AggregateSpecPB::SUM:
+          if (!type || !IsSummable(type->type())) {
+            return Status::InvalidArgument("SUM requires an integer or floating point column",
+                                           agg.ShortDebugString());
+          }
+          break;
+        case AggregateSpecPB::MIN:
+        case AggregateSpecPB::MAX:
+          if (!type) {
+            return Status::InvalidArgument("MIN and MAX require a column",
+                                           agg.ShortDebugString());
+          }
+          break;
+        default:
+          return Status::InvalidArgument("unknown aggregate function", agg.ShortDebugString());
+      }
+      col_idxs_.push_back(idx);
+    }
+    if (!group_by_column_.empty()) {
+      group_by_idx_ = scanner_schema.find_column(group_by_column_);
+      if (group_by_idx_ == -1) {
+        return Status::InvalidArgument("group-by column is not projected", group_by_column_);
+      }
+    }
+    return Status::OK();
+  }
+
+  virtual void HandleRowBlock(const Schema* /* client_projection_schema */,
+                              const RowBlock& row_block) OVERRIDE {
+    DCHECK(schema_ != nullptr) << "InitSerializer() not called";
+    blocks_processed_++;
+    if (PREDICT_FALSE(!status_.ok())) return;
+
+    const SelectionVector& sel = *row_block.selection_vector();
+    if (!AssignGroups(row_block)) return;
+    for (int i = 0; i < aggregates_.size(); i++) {
+      switch (aggregates_[i].function()) {
+        case AggregateSpecPB::COUNT:
+          Count(row_block, i);
+          break;
+        case AggregateSpecPB::SUM:
+          Sum(row_block, i);
+          break;
+        case AggregateSpecPB::MIN:
+          MinMax(row_block, i, -1);
+          break;
+        case AggregateSpecPB::MAX:
+          MinMax(row_block, i, 1);
+          break;
+        default:
+          LOG(FATAL) << "unexpected aggregate: " << aggregates_[i].ShortDebugString();
+      }
+    }
+    rows_aggregated_ += sel.CountSelected();
+    SetLastRow(row_block, &last_primary_key_);
+  }
+
+  virtual int BlocksProcessed() const OVERRIDE { return blocks_processed_; }
+
+  // Aggregates are small, so the response is only cut short by the time
+  // budget, or as soon as an error is found.
+  virtual int64_t ResponseSize() const OVERRIDE {
+    return status_.ok() ? 0 : std::numeric_limits<int64_t>::max();
+  }
+
+  virtual const faststring& last_primary_key() const OVERRIDE { return last_primary_key_; }
+
+  virtual int64_t NumRowsReturned() const OVERRIDE {
+    return 0;
+  }
+
+  const Status& status() const { return status_; }
+
+  int64_t rows_aggregated() const { return rows_aggregated_; }
+
+  // Fills in 'groups' with the partial aggregates of this request.
+  void ToPB(RepeatedPtrField<AggregateGroupPB>* groups) const {
+    for (const Group& group : groups_) {
+      AggregateGroupPB* group_pb = groups->Add();
+      if (group_by_idx_ != -1 && !group.is_null) {
+        group_pb->set_group_value(group.value);
+      }
+      for (int i = 0; i < aggregates_.size(); i++) {
+        const AggregateState& state = group.states[i];
+        AggregateValuePB* value_pb = group_pb->add_values();
+        switch (aggregates_[i].function()) {
+          case AggregateSpecPB::COUNT:
+            value_pb->set_int_value(state.int_value);
+            break;
+          case AggregateSpecPB::SUM:
+            if (!state.has_value) break;
+            if (IsFloatingPoint(col_idxs_[i])) {
+              value_pb->set_double_value(state.double_value);
+            } else {
+              value_pb->set_int_value(state.int_value);
+            }
+            break;
+          default:
+            if (state.has_value) {
+              value_pb->set_cell_value(state.cell_value);
+            }
+            break;
+        }
+      }
+    }
+  }
+
+ private:
+  // The running value of one aggregate for one group.
+  struct AggregateState {
+    AggregateState() : int_value(0), double_value(0), has_value(false) {}
+
+    // COUNT, or SUM over integers.
+    int64_t int_value;
+    // SUM over floating point values.
+    double double_value;
+    // Whether a non-NULL cell has been aggregated.
+    bool has_value;
+    // MIN or MAX, encoded as for ColumnPredicatePB bounds.
+    string cell_value;
+  };
+
+  struct Group {
+    bool is_null;
+    string value;
+    vector<AggregateState> states;
+  };
+
+  static bool IsSummable(DataType type) {
+    switch (type) {
+      case INT8: case INT16: case INT32: case INT64:
+      case UINT8: case UINT16: case UINT32: case UINT64:
+      case FLOAT: case DOUBLE:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+  bool IsFloatingPoint(int col_idx) const {
+    DataType type = schema_->column(col_idx).type_info()->physical_type();
+    return type == FLOAT || type == DOUBLE;
+  }
+
+  // Appends the cell at 'cell_ptr' to 'dst', encoded as for
+  // ColumnPredicatePB bounds.
+  static void AppendCell(const TypeInfo* type, const void* cell_ptr, string* dst) {
+    if (type->physical_type() == BINARY) {
+      const Slice* slice = reinterpret_cast<const Slice*>(cell_ptr);
+      dst->append(reinterpret_cast<const char*>(slice->data()), slice->size());
+    } else {
+      dst->append(reinterpret_cast<const char*>(cell_ptr), type->size());
+    }
+  }
+
+  Group* NewGroup() {
+    groups_.emplace_back();
+    Group* group = &groups_.back();
+    group->is_null = false;
+    group->states.resize(aggregates_.size());
+    return group;
+  }
+
+  // Sets 'row_groups_' to the group of each selected row of 'block',
+  // creating groups as needed. Returns false, setting 'status_', if there
+  // are too many groups.
+  bool AssignGroups(const RowBlock& block) {
+    const SelectionVector& sel = *block.selection_vector();
+    row_groups_.assign(block.nrows(), 0);
+    if (group_by_idx_ == -1) {
+      if (groups_.empty()) NewGroup();
+      return true;
+    }
+
+    ColumnBlock cblock = block.column_block(group_by_idx_);
+    const TypeInfo* type = cblock.type_info();
+    for (size_t row = 0; row < block.nrows(); row++) {
+      if (!sel.IsRowSelected(row)) continue;
+      bool is_null = cblock.is_nullable() && cblock.is_null(row);
+      if (is_null) {
+        tmp_key_ = "N";
+      } else {
+        tmp_key_ = "V";
+        AppendCell(type, cblock.cell_ptr(row), &tmp_key_);
+      }
+      int* group_idx = FindOrNull(group_idx_by_key_, tmp_key_);
+      if (group_idx == nullptr) {
+        if (PREDICT_FALSE(static_cast<int>(groups_.size()) >=
+                          FLAGS_scanner_max_aggregate_groups)) {
+          status_ = Status::InvalidArgument(Substitute(
+              "aggregate scan produced more than $0 groups",
+              FLAGS_scanner_max_aggregate_groups));
+          return false;
+        }
+        Group* group = NewGroup();
+        group->is_null = is_null;
+        group->value = tmp_key_.substr(1);
+        group_idx = &InsertKeyOrDie(&group_idx_by_key_, tmp_key_);
+        *group_idx = groups_.size() - 1;
+      }
+      row_groups_[row] = *group_idx;
+    }
+    return true;
+  }
+
+  void Count(const RowBlock& block, int agg_idx) {
+    const SelectionVector& sel = *block.selection_vector();
+    int col_idx = col_idxs_[agg_idx];
+    if (col_idx == -1 || !schema_->column(col_idx).is_nullable()) {
+      for (size_t row = 0; row < block.nrows(); row++) {
+        if (!sel.IsRowSelected(row)) continue;
+        groups_[row_groups_[row]].states[agg_idx].int_value++;
+      }
+      return;
+    }
+    ColumnBlock cblock = block.column_block(col_idx);
+    for (size_t row = 0; row < block.nrows(); row++) {
+      if (!sel.IsRowSelected(row) || cblock.is_null(row)) continue;
+      groups_[row_groups_[row]].states[agg_idx].int_value++;
+    }
+  }
+
+  void Sum(const RowBlock& block, int agg_idx) {
+    switch (schema_->column(col_idxs_[agg_idx]).type_info()->physical_type()) {
+      case INT8: SumCells<int8_t>(block, agg_idx); break;
+      case INT16: SumCells<int16_t>(block, agg_idx); break;
+      case INT32: SumCells<int32_t>(block, agg_idx); break;
+      case INT64: SumCells<int64_t>(block, agg_idx); break;
+      case UINT8: SumCells<uint8_t>(block, agg_idx); break;
+      case UINT16: SumCells<uint16_t>(block, agg_idx); break;
+      case UINT32: SumCells<uint32_t>(block, agg_idx); break;
+      case UINT64: SumCells<uint64_t>(block, agg_idx); break;
+      case FLOAT: SumCells<float>(block, agg_idx); break;
+      case DOUBLE: SumCells<double>(block, agg_idx); break;
+      default: LOG(FATAL) << "unexpected type for SUM";
+    }
+  }
+
+  template<typename CppType>
+  void SumCells(const RowBlock& block, int agg_idx) {
+    const SelectionVector& sel = *block.selection_vector();
+    ColumnBlock cblock = block.column_block(col_idxs_[agg_idx]);
+    const CppType* cells = reinterpret_cast<const CppType*>(cblock.data());
+    bool is_float = std::is_floating_point<CppType>::value;
+    for (size_t row = 0; row < block.nrows(); row++) {
+      if (!sel.IsRowSelected(row)) continue;
+      if (cblock.is_nullable() && cblock.is_null(row)) continue;
+      AggregateState* state = &groups_[row_groups_[row]].states[agg_idx];
+      if (is_float) {
+        state->double_value += cells[row];
+      } else {
+        // Sum as unsigned so that overflow wraps around rather than being
+        // undefined.
+        state->int_value = static_cast<int64_t>(
+            static_cast<uint64_t>(state->int_value) + static_cast<uint64_t>(cells[row]));
+      }
+      state->has_value = true;
+    }
+  }
+
+  // Computes MIN (if 'sign' is -1) or MAX (if 'sign' is 1). The best cell of
+  // each group in the block is found first, so that only one value per group
+  // is copied.
+  void MinMax(const RowBlock& block, int agg_idx, int sign) {
+    const SelectionVector& sel = *block.selection_vector();
+    ColumnBlock cblock = block.column_block(col_idxs_[agg_idx]);
+    const TypeInfo* type = cblock.type_info();
+    block_best_.assign(groups_.size(), nullptr);
+    for (size_t row = 0; row < block.nrows(); row++) {
+      if (!sel.IsRowSelected(row)) continue;
+      if (cblock.is_nullable() && cblock.is_null(row)) continue;
+      const void* cell = cblock.cell_ptr(row);
+      const void*& best = block_best_[row_groups_[row]];
+      if (best == nullptr || type->Compare(cell, best) * sign > 0) {
+        best = cell;
+      }
+    }
+
+    for (int g = 0; g < groups_.size(); g++) {
+      const void* best = block_best_[g];
+      if (best == nullptr) continue;
+      AggregateState* state = &groups_[g].states[agg_idx];
+      if (state->has_value) {
+        const string& cur = state->cell_value;
+        Slice cur_slice(cur);
+        const void* cur_ptr = type->physical_type() == BINARY ?
+            static_cast<const void*>(&cur_slice) : static_cast<const void*>(cur.data());
+        if (type->Compare(best, cur_ptr) * sign <= 0) continue;
+      }
+      state->cell_value.clear();
+      AppendCell(type, best, &state->cell_value);
+      state->has_value = true;
+    }
+  }
+
+  const vector<AggregateSpecPB> aggregates_;
+  const string group_by_column_;
+
+  // The schema of the row blocks, and the index in it of the column of each
+  // aggregate (-1 for COUNT(*)) and of the group-by column (or -1).
+  const Schema* schema_;
+  vector<int> col_idxs_;
+  int group_by_idx_;
+
+  vector<Group> groups_;
+  // Maps a group-by value, prefixed by 'V' (or "N" for NULL), to its index in
+  // 'groups_'.
+  std::unordered_map<string, int> group_idx_by_key_;
+
+  // Scratch space, reused across blocks.
+  vector<int> row_groups_;
+  vector<const void*> block_best_;
+  string tmp_key_;
+
+  Status status_;
+  int blocks_processed_;
+  int64_t rows_aggregated_;
+  faststring last_primary_key_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScanResultAggregator);
+};
+
 // Return the batch size to use for a given request, after clamping
 // the user-requested request within the server-side allowable range.
 // This is only a hint, really more of a threshold since returned bytes
@@ -494,9 +1094,46 @@ static size_t GetMaxBatchSizeBytesHint(const ScanRequestPB* req) {
                   implicit_cast<uint32_t>(FLAGS_scanner_max_batch_size_bytes));
 }
 
+// Return the number of rows to read from the tablet at a time for a request
+// whose batches of results are 'batch_size_bytes' large. Larger batches of
+// rows amortize the per-batch cost of the column iterators and decoders, but
+// a batch must be small enough not to overshoot the result batch size by
+// much: it's sized to fill about a quarter of it.
+//
+// 'bytes_per_row' is the number of response bytes each row read was seen to
+// add, which accounts for indirect data, the client's projection and the
+// rows filtered out by predicates. Until it is known (i.e. while negative),
+// the fixed width of 'projection' stands in for it.
+static size_t GetBatchSizeRows(const Schema& projection, size_t batch_size_bytes,
+                               double bytes_per_row) {
+  if (bytes_per_row < 0) {
+    bytes_per_row = projection.byte_size();
+  }
+  size_t rows = batch_size_bytes / 4 / std::max(bytes_per_row, 1.0);
+  rows = std::min(rows, static_cast<size_t>(std::max(FLAGS_scanner_max_batch_size_rows, 1)));
+  return std::max(rows, static_cast<size_t>(std::max(FLAGS_scanner_batch_size_rows, 1)));
+}
+
+struct TabletServiceImpl::SnapshotWait {
+  // Whether a scan whose snapshot is not yet clean may be parked instead of
+  // blocking the calling thread.
+  bool may_defer = false;
+
+  // Set once the scan has been parked. The snapshot timestamp and deadline
+  // picked for the scan are kept so that the resumed scan uses the same ones.
+  bool parked = false;
+  Timestamp snap_timestamp;
+  MonoTime deadline;
+  MonoTime wait_start;
+};
+
 TabletServiceImpl::TabletServiceImpl(TabletServer* server)
   : TabletServerServiceIf(server->metric_entity(), server->result_tracker()),
     server_(server) {
+  CHECK_OK(ThreadPoolBuilder("scan-resume").Build(&scan_resume_pool_));
+}
+
+TabletServiceImpl::~TabletServiceImpl() {
 }
 
 void TabletServiceImpl::Ping(const PingRequestPB* req,
@@ -627,6 +1264,11 @@ void TabletServiceAdminImpl::CreateTablet(const CreateTabletRequestPB* req,
                                                  schema,
                                                  partition_schema,
                                                  req->config(),
+                                                 req->compaction_policy(),
+                                                 req->has_history_max_age_sec() ?
+                                                     req->history_max_age_sec() : -1,
+                                                 req->has_row_ttl() ? &req->row_ttl() : nullptr,
+                                                 req->pin_key_index(),
                                                  nullptr);
   if (PREDICT_FALSE(!s.ok())) {
     TabletServerErrorPB::Code code;
@@ -684,91 +1326,132 @@ void TabletServiceImpl::Write(const WriteRequestPB* req,
                "tablet_id", req->tablet_id());
   DVLOG(3) << "Received Write RPC: " << req->DebugString();
 
-  scoped_refptr<TabletPeer> tablet_peer;
-  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
-                                 &tablet_peer)) {
-    return;
-  }
-
-  shared_ptr<Tablet> tablet;
+  // The RPC will be responded to asynchronously.
   TabletServerErrorPB::Code error_code;
-  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  Status s = SubmitWrite(req, resp,
+                         context->AreResultsTracked() ? context->request_id() : nullptr,
+                         gscoped_ptr<TransactionCompletionCallback>(
+                             new RpcTransactionCompletionCallback<WriteResponsePB>(context,
+                                                                                   resp)),
+                         &error_code);
   if (PREDICT_FALSE(!s.ok())) {
     SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+  }
+}
+
+void TabletServiceImpl::MultiWrite(const MultiWriteRequestPB* req,
+                                   MultiWriteResponsePB* resp,
+                                   rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::MultiWrite",
+               "num_writes", req->writes_size());
+  DVLOG(3) << "Received MultiWrite RPC: " << req->DebugString();
+
+  if (req->writes_size() == 0) {
+    context->RespondSuccess();
     return;
   }
 
+  // Allocate all of the responses up front so that they don't move while the
+  // writes are completing.
+  for (int i = 0; i < req->writes_size(); i++) {
+    resp->add_responses();
+  }
+
+  // Each write is submitted to its own tablet, whose prepare and apply
+  // pools then run them in parallel.
+  shared_ptr<MultiWriteTracker> tracker(new MultiWriteTracker(context, req->writes_size()));
+  for (int i = 0; i < req->writes_size(); i++) {
+    WriteResponsePB* write_resp = resp->mutable_responses(i);
+    TabletServerErrorPB::Code error_code;
+    Status s = SubmitWrite(&req->writes(i), write_resp, nullptr,
+                           gscoped_ptr<TransactionCompletionCallback>(
+                               new MultiWriteCompletionCallback(tracker, write_resp)),
+                           &error_code);
+    if (PREDICT_FALSE(!s.ok())) {
+      tracker->WriteFailed(write_resp, s, error_code);
+    }
+  }
+}
+
+Status TabletServiceImpl::SubmitWrite(const WriteRequestPB* req,
+                                      WriteResponsePB* resp,
+                                      const rpc::RequestIdPB* request_id,
+                                      gscoped_ptr<TransactionCompletionCallback> callback,
+                                      TabletServerErrorPB::Code* error_code) {
+  scoped_refptr<TabletPeer> tablet_peer;
+  RETURN_NOT_OK(LookupRunningTabletPeer(server_->tablet_manager(), req->tablet_id(),
+                                        &tablet_peer, error_code));
+
+  shared_ptr<Tablet> tablet;
+  RETURN_NOT_OK(GetTabletRef(tablet_peer, &tablet, error_code));
+
   uint64_t bytes = req->row_operations().rows().size() +
       req->row_operations().indirect_data().size();
   if (!tablet->ShouldThrottleAllow(bytes)) {
-    SetupErrorAndRespond(resp->mutable_error(),
-                         Status::ServiceUnavailable("Rejecting Write request: throttled"),
-                         TabletServerErrorPB::THROTTLED,
-                         context);
-    return;
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return Status::ServiceUnavailable("Rejecting Write request: throttled");
   }
 
   // Check for memory pressure; don't bother doing any additional work if we've
-  // exceeded the limit.
+  // exceeded the limit. Between the soft and hard limits, the write is
+  // delayed in proportion to the pressure instead of being rejected outright,
+  // and the maintenance manager is prodded to start flushing straight away.
   double capacity_pct;
-  if (tablet->mem_tracker()->AnySoftLimitExceeded(&capacity_pct)) {
+  bool reject;
+  int32_t max_delay_ms = FLAGS_write_memory_pressure_max_delay_ms;
+  if (max_delay_ms > 0) {
+    double pressure = tablet->mem_tracker()->AnySoftLimitPressure();
+    if (pressure > 0) {
+      server_->maintenance_manager()->RequestSchedulingPass();
+    }
+    reject = pressure >= 1;
+    if (!reject && pressure > 0) {
+      tablet->metrics()->leader_memory_pressure_delays->Increment();
+      SleepFor(MonoDelta::FromMicroseconds(
+          static_cast<int64_t>(pressure * max_delay_ms * 1000)));
+    }
+    capacity_pct = 100;
+  } else {
+    reject = tablet->mem_tracker()->AnySoftLimitExceeded(&capacity_pct);
+  }
+  if (reject) {
     tablet->metrics()->leader_memory_pressure_rejections->Increment();
-    string msg = StringPrintf(
-        "Soft memory limit exceeded (at %.2f%% of capacity)",
-        capacity_pct);
+    string msg = max_delay_ms > 0 ?
+        string("Hard memory limit exceeded") :
+        StringPrintf("Soft memory limit exceeded (at %.2f%% of capacity)",
+                     capacity_pct);
     if (capacity_pct >= FLAGS_memory_limit_warn_threshold_percentage) {
       KLOG_EVERY_N_SECS(WARNING, 1) << "Rejecting Write request: " << msg << THROTTLE_MSG;
     } else {
       KLOG_EVERY_N_SECS(INFO, 1) << "Rejecting Write request: " << msg << THROTTLE_MSG;
     }
-    SetupErrorAndRespond(resp->mutable_error(), Status::ServiceUnavailable(msg),
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
+    *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    return Status::ServiceUnavailable(msg);
   }
 
+  *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
   if (!server_->clock()->SupportsExternalConsistencyMode(req->external_consistency_mode())) {
-    Status s = Status::NotSupported("The configured clock does not support the"
+    return Status::NotSupported("The configured clock does not support the"
         " required consistency mode.");
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
   }
 
   unique_ptr<WriteTransactionState> tx_state(new WriteTransactionState(
       tablet_peer.get(),
       req,
-      context->AreResultsTracked() ? context->request_id() : nullptr,
+      request_id,
       resp));
 
   // If the client sent us a timestamp, decode it and update the clock so that all future
   // timestamps are greater than the passed timestamp.
   if (req->has_propagated_timestamp()) {
     Timestamp ts(req->propagated_timestamp());
-    s = server_->clock()->Update(ts);
+    RETURN_NOT_OK(server_->clock()->Update(ts));
   }
-  if (PREDICT_FALSE(!s.ok())) {
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-    return;
-  }
-
-  tx_state->set_completion_callback(gscoped_ptr<TransactionCompletionCallback>(
-      new RpcTransactionCompletionCallback<WriteResponsePB>(context,
-                                                            resp)));
 
-  // Submit the write. The RPC will be responded to asynchronously.
-  s = tablet_peer->SubmitWrite(std::move(tx_state));
+  tx_state->set_completion_callback(std::move(callback));
 
-  // Check that we could submit the write
-  if (PREDICT_FALSE(!s.ok())) {
-    SetupErrorAndRespond(resp->mutable_error(), s,
-                         TabletServerErrorPB::UNKNOWN_ERROR,
-                         context);
-  }
-  return;
+  // Submit the write. The callback will be notified asynchronously.
+  return tablet_peer->SubmitWrite(std::move(tx_state));
 }
 
 ConsensusServiceImpl::ConsensusServiceImpl(const scoped_refptr<MetricEntity>& metric_entity,
@@ -813,6 +1496,56 @@ void ConsensusServiceImpl::UpdateConsensus(const ConsensusRequestPB* req,
   context->RespondSuccess();
 }
 
+void ConsensusServiceImpl::MultiRaftHeartbeat(const MultiRaftHeartbeatRequestPB* req,
+                                              MultiRaftHeartbeatResponsePB* resp,
+                                              rpc::RpcContext* context) {
+  DVLOG(3) << "Received Multi-Raft Heartbeat RPC with " << req->heartbeats_size()
+           << " heartbeats";
+  if (!CheckUuidMatchOrRespond(tablet_manager_, "MultiRaftHeartbeat", req, resp, context)) {
+    return;
+  }
+  consensus::HeartbeatBatcher* batcher = tablet_manager_->heartbeat_batcher();
+  if (batcher && req->has_caller_uuid()) {
+    // Followers of the caller's quiesced leaders rely on this.
+    batcher->RecordHeardFrom(req->caller_uuid());
+  }
+
+  // Hand each heartbeat to its tablet's Consensus instance, as UpdateConsensus
+  // would. Errors are reported per tablet, so that one missing tablet doesn't
+  // fail the heartbeats of the others.
+  for (const ConsensusRequestPB& hb : req->heartbeats()) {
+    ConsensusResponsePB* hb_resp = resp->add_responses();
+    TabletServerErrorPB::Code error_code = TabletServerErrorPB::UNKNOWN_ERROR;
+    scoped_refptr<TabletPeer> tablet_peer;
+    scoped_refptr<Consensus> consensus;
+    Status s;
+    if (PREDICT_FALSE(hb.dest_uuid() != req->dest_uuid())) {
+      s = Status::InvalidArgument(Substitute("Heartbeat for tablet $0 is addressed to $1, "
+                                             "not $2", hb.tablet_id(), hb.dest_uuid(),
+                                             req->dest_uuid()));
+      error_code = TabletServerErrorPB::WRONG_SERVER_UUID;
+    } else {
+      s = LookupRunningTabletPeer(tablet_manager_, hb.tablet_id(), &tablet_peer, &error_code);
+    }
+    if (s.ok()) {
+      consensus = tablet_peer->shared_consensus();
+      if (!consensus) {
+        s = Status::ServiceUnavailable("Consensus unavailable. Tablet not running");
+        error_code = TabletServerErrorPB::TABLET_NOT_RUNNING;
+      }
+    }
+    if (s.ok()) {
+      s = consensus->Update(&hb, hb_resp);
+    }
+    if (PREDICT_FALSE(!s.ok())) {
+      hb_resp->Clear();
+      StatusToPB(s, hb_resp->mutable_error()->mutable_status());
+      hb_resp->mutable_error()->set_code(error_code);
+    }
+  }
+  context->RespondSuccess();
+}
+
 void ConsensusServiceImpl::RequestConsensusVote(const VoteRequestPB* req,
                                                 VoteResponsePB* resp,
                                                 rpc::RpcContext* context) {
@@ -909,7 +1642,9 @@ void ConsensusServiceImpl::LeaderStepDown(const LeaderStepDownRequestPB* req,
 
   scoped_refptr<Consensus> consensus;
   if (!GetConsensusOrRespond(tablet_peer, resp, context, &consensus)) return;
-  Status s = consensus->StepDown(resp);
+  Status s = req->has_new_leader_uuid() ?
+      consensus->TransferLeadership(req->new_leader_uuid(), resp) :
+      consensus->StepDown(resp);
   if (PREDICT_FALSE(!s.ok())) {
     SetupErrorAndRespond(resp->mutable_error(), s,
                          TabletServerErrorPB::UNKNOWN_ERROR,
@@ -1013,17 +1748,60 @@ void TabletServiceImpl::ScannerKeepAlive(const ScannerKeepAliveRequestPB *req,
 }
 
 namespace {
+// The trace counters into which the scans of an RPC add their IteratorStats.
+const char* const kScanDataBlocksReadMetricName = "scan_data_blocks_read_from_disk";
+const char* const kScanBytesReadMetricName = "scan_bytes_read_from_disk";
+const char* const kScanCellsReadMetricName = "scan_cells_read_from_disk";
+
 void SetResourceMetrics(ResourceMetricsPB* metrics, rpc::RpcContext* context) {
+  TraceMetrics* trace_metrics = context->trace()->metrics();
   metrics->set_cfile_cache_miss_bytes(
-    context->trace()->metrics()->GetMetric(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME));
+    trace_metrics->GetMetric(cfile::CFILE_CACHE_MISS_BYTES_METRIC_NAME));
   metrics->set_cfile_cache_hit_bytes(
-    context->trace()->metrics()->GetMetric(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME));
+    trace_metrics->GetMetric(cfile::CFILE_CACHE_HIT_BYTES_METRIC_NAME));
+  metrics->set_data_blocks_read_from_disk(trace_metrics->GetMetric(kScanDataBlocksReadMetricName));
+  metrics->set_bytes_read_from_disk(trace_metrics->GetMetric(kScanBytesReadMetricName));
+  metrics->set_cells_read_from_disk(trace_metrics->GetMetric(kScanCellsReadMetricName));
+}
+
+// Attaches the buffers of 'batch' to the RPC as sidecars, recording their
+// indices in 'columnar_pb'.
+void AddColumnarSidecars(ColumnarSerializedBatch* batch,
+                         ColumnarRowBlockPB* columnar_pb,
+                         rpc::RpcContext* context) {
+  columnar_pb->set_num_rows(batch->num_rows);
+  for (auto& col : batch->columns) {
+    ColumnarRowBlockPB::Column* col_pb = columnar_pb->add_columns();
+    int idx;
+    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(gscoped_ptr<faststring>(col.data.release()))), &idx));
+    col_pb->set_data_sidecar(idx);
+    if (col.varlen_data && col.varlen_data->size() > 0) {
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(gscoped_ptr<faststring>(col.varlen_data.release()))), &idx));
+      col_pb->set_varlen_data_sidecar(idx);
+    }
+    if (col.non_null_bitmap) {
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(gscoped_ptr<faststring>(col.non_null_bitmap.release()))), &idx));
+      col_pb->set_non_null_bitmap_sidecar(idx);
+    }
+  }
 }
 } // anonymous namespace
 
 void TabletServiceImpl::Scan(const ScanRequestPB* req,
                              ScanResponsePB* resp,
                              rpc::RpcContext* context) {
+  SnapshotWait wait;
+  wait.may_defer = FLAGS_scanner_async_snapshot_wait;
+  DoScan(req, resp, context, &wait);
+}
+
+void TabletServiceImpl::DoScan(const ScanRequestPB* req,
+                               ScanResponsePB* resp,
+                               rpc::RpcContext* context,
+                               SnapshotWait* wait) {
   TRACE_EVENT0("tserver", "TabletServiceImpl::Scan");
   // Validate the request: user must pass a new_scan_request or
   // a scanner ID, but not both.
@@ -1053,7 +1831,11 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
     Timestamp scan_timestamp;
     Status s = HandleNewScanRequest(tablet_peer.get(), req, context,
                                     &collector, &scanner_id, &scan_timestamp, &has_more_results,
-                                    &error_code);
+                                    &error_code, wait);
+    if (s.IsIncomplete() && wait->may_defer && wait->parked) {
+      ParkScan(tablet_peer.get(), req, resp, context, *wait);
+      return;
+    }
     if (PREDICT_FALSE(!s.ok())) {
       SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
       return;
@@ -1081,20 +1863,24 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
 
   DVLOG(2) << "Blocks processed: " << collector.BlocksProcessed();
   if (collector.BlocksProcessed() > 0) {
-    resp->mutable_data()->CopyFrom(data);
-
-    // Add sidecar data to context and record the returned indices.
-    int rows_idx;
-    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-        new rpc::RpcSidecar(std::move(rows_data))), &rows_idx));
-    resp->mutable_data()->set_rows_sidecar(rows_idx);
+    if (collector.columnar()) {
+      AddColumnarSidecars(collector.columnar_batch(), resp->mutable_columnar_data(), context);
+    } else {
+      resp->mutable_data()->CopyFrom(data);
 
-    // Add indirect data as a sidecar, if applicable.
-    if (indirect_data->size() > 0) {
-      int indirect_idx;
+      // Add sidecar data to context and record the returned indices.
+      int rows_idx;
       CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
-          new rpc::RpcSidecar(std::move(indirect_data))), &indirect_idx));
-      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+          new rpc::RpcSidecar(std::move(rows_data))), &rows_idx));
+      resp->mutable_data()->set_rows_sidecar(rows_idx);
+
+      // Add indirect data as a sidecar, if applicable.
+      if (indirect_data->size() > 0) {
+        int indirect_idx;
+        CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+            new rpc::RpcSidecar(std::move(indirect_data))), &indirect_idx));
+        resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+      }
     }
 
     // Set the last row found by the collector.
@@ -1109,6 +1895,55 @@ void TabletServiceImpl::Scan(const ScanRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceImpl::ParkScan(TabletPeer* tablet_peer,
+                                 const ScanRequestPB* req,
+                                 ScanResponsePB* resp,
+                                 rpc::RpcContext* context,
+                                 const SnapshotWait& wait) {
+  SnapshotWait resumed_wait = wait;
+  resumed_wait.may_defer = false;
+  boost::function<void()> resume = [this, req, resp, context, resumed_wait]() {
+    ADOPT_TRACE(context->trace());
+    SnapshotWait w = resumed_wait;
+    DoScan(req, resp, context, &w);
+  };
+
+  shared_ptr<Tablet> tablet = tablet_peer->shared_tablet();
+  if (PREDICT_FALSE(!tablet)) {
+    // Let the scan run again here; it will report the tablet's state.
+    resume();
+    return;
+  }
+
+  TRACE("Waiting for operations in snapshot to commit without holding a service thread");
+  int64_t handle = tablet->mvcc_manager()->WaitForAllCommittedAsync(
+      wait.snap_timestamp, scan_resume_pool_.get(), resume);
+  if (handle == 0) {
+    // Already submitted.
+    return;
+  }
+
+  // The wait has no deadline of its own: cancel it when ours passes and let the
+  // resumed scan produce the timeout error. The timer holds on to the tablet so
+  // that its MvccManager outlives the wait.
+  MonoDelta timeout = wait.deadline.GetDeltaSince(MonoTime::Now(MonoTime::FINE));
+  if (timeout.ToNanoseconds() < 0) {
+    timeout = MonoDelta::FromNanoseconds(0);
+  }
+  server_->messenger()->ScheduleOnReactor(
+      [this, tablet, handle, resume, context](const Status& /* s */) {
+        if (!tablet->mvcc_manager()->CancelAsyncWait(handle)) {
+          // The snapshot became clean first and the scan has already resumed.
+          return;
+        }
+        Status s = scan_resume_pool_->SubmitFunc(resume);
+        if (PREDICT_FALSE(!s.ok())) {
+          context->RespondFailure(s);
+        }
+      },
+      timeout);
+}
+
 void TabletServiceImpl::ListTablets(const ListTabletsRequestPB* req,
                                     ListTabletsResponsePB* resp,
                                     rpc::RpcContext* context) {
@@ -1128,6 +1963,127 @@ void TabletServiceImpl::ListTablets(const ListTabletsRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceImpl::SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                                      SplitKeyRangeResponsePB* resp,
+                                      rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::SplitKeyRange",
+               "tablet_id", req->tablet_id());
+  DVLOG(3) << "Received SplitKeyRange RPC: " << req->DebugString();
+
+  if (PREDICT_FALSE(req->target_chunk_size_bytes() == 0)) {
+    SetupErrorAndRespond(resp->mutable_error(),
+                         Status::InvalidArgument("Target chunk size must be positive"),
+                         TabletServerErrorPB::INVALID_SCAN_SPEC, context);
+    return;
+  }
+
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  Status s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  vector<string> split_keys;
+  s = tablet->SplitKeyRange(req->start_primary_key(), req->stop_primary_key(),
+                            req->target_chunk_size_bytes(), &split_keys);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         TabletServerErrorPB::UNKNOWN_ERROR, context);
+    return;
+  }
+  for (string& key : split_keys) {
+    resp->add_split_primary_keys()->swap(key);
+  }
+  context->RespondSuccess();
+}
+
+void TabletServiceImpl::LookupRows(const LookupRowsRequestPB* req,
+                                   LookupRowsResponsePB* resp,
+                                   rpc::RpcContext* context) {
+  TRACE_EVENT1("tserver", "TabletServiceImpl::LookupRows",
+               "tablet_id", req->tablet_id());
+  DVLOG(3) << "Received LookupRows RPC: " << req->DebugString();
+
+  scoped_refptr<TabletPeer> tablet_peer;
+  if (!LookupTabletPeerOrRespond(server_->tablet_manager(), req->tablet_id(), resp, context,
+                                 &tablet_peer)) {
+    return;
+  }
+
+  Schema projection;
+  Status s = ColumnPBsToSchema(req->projected_columns(), &projection);
+  if (PREDICT_TRUE(s.ok()) && projection.has_column_ids()) {
+    s = Status::InvalidArgument("User requests should not have Column IDs");
+  }
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, TabletServerErrorPB::INVALID_SCHEMA, context);
+    return;
+  }
+  // Mark the key columns of the projection, as scans do.
+  const Schema& tablet_schema = tablet_peer->tablet_metadata()->schema();
+  SchemaBuilder projection_builder;
+  for (const ColumnSchema& col : projection.columns()) {
+    CHECK_OK(projection_builder.AddColumn(col, tablet_schema.is_key_column(col.name())));
+  }
+  projection = projection_builder.BuildWithoutIds();
+
+  shared_ptr<Tablet> tablet;
+  TabletServerErrorPB::Code error_code;
+  s = GetTabletRef(tablet_peer, &tablet, &error_code);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+    return;
+  }
+
+  if (req->encoded_primary_keys_size() == 0) {
+    context->RespondSuccess();
+    return;
+  }
+  vector<string> keys(req->encoded_primary_keys().begin(), req->encoded_primary_keys().end());
+  Arena arena(32 * 1024, 4 * 1024 * 1024);
+  RowBlock block(projection, keys.size(), &arena);
+  tablet::MvccSnapshot snap(*tablet->mvcc_manager());
+  s = tablet->LookupRows(projection, snap, keys, &block);
+  if (PREDICT_FALSE(!s.ok())) {
+    SetupErrorAndRespond(resp->mutable_error(), s,
+                         s.IsInvalidArgument() ? TabletServerErrorPB::INVALID_SCAN_SPEC
+                                               : TabletServerErrorPB::UNKNOWN_ERROR,
+                         context);
+    return;
+  }
+  TRACE("Looked up $0 rows", keys.size());
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    resp->add_found(block.selection_vector()->IsRowSelected(i));
+  }
+  if (block.selection_vector()->AnySelected()) {
+    gscoped_ptr<faststring> rows_data(new faststring());
+    gscoped_ptr<faststring> indirect_data(new faststring());
+    SerializeRowBlock(block, resp->mutable_data(), nullptr,
+                      rows_data.get(), indirect_data.get());
+
+    int rows_idx;
+    CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+        new rpc::RpcSidecar(std::move(rows_data))), &rows_idx));
+    resp->mutable_data()->set_rows_sidecar(rows_idx);
+    if (indirect_data->size() > 0) {
+      int indirect_idx;
+      CHECK_OK(context->AddRpcSidecar(make_gscoped_ptr(
+          new rpc::RpcSidecar(std::move(indirect_data))), &indirect_idx));
+      resp->mutable_data()->set_indirect_data_sidecar(indirect_idx);
+    }
+  }
+  context->RespondSuccess();
+}
+
 void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
                                  ChecksumResponsePB* resp,
                                  rpc::RpcContext* context) {
@@ -1195,11 +2151,96 @@ void TabletServiceImpl::Checksum(const ChecksumRequestPB* req,
   context->RespondSuccess();
 }
 
+void TabletServiceImpl::Aggregate(const AggregateRequestPB* req,
+                                  AggregateResponsePB* resp,
+                                  rpc::RpcContext* context) {
+  TRACE_EVENT0("tserver", "TabletServiceImpl::Aggregate");
+  VLOG(1) << "Full request: " << req->DebugString();
+
+  // Validate the request: user must pass a new_request or a scanner ID, but
+  // not both.
+  if (PREDICT_FALSE(req->has_new_request() && req->has_scanner_id())) {
+    context->RespondFailure(Status::InvalidArgument(
+                            "Must not pass both a scanner_id and new_request"));
+    return;
+  }
+
+  // Convert AggregateRequestPB to a ScanRequestPB.
+  ScanRequestPB scan_req;
+  if (req->has_call_seq_id()) scan_req.set_call_seq_id(req->call_seq_id());
+  if (req->has_batch_size_bytes()) scan_req.set_batch_size_bytes(req->batch_size_bytes());
+  if (req->has_close_scanner()) scan_req.set_close_scanner(req->close_scanner());
+
+  ScanResultAggregator collector(req->aggregates(), req->group_by_column());
+  string scanner_id = req->scanner_id();
+  bool has_more = false;
+  TabletServerErrorPB::Code error_code;
+  if (req->has_new_request()) {
+    scan_req.mutable_new_scan_request()->CopyFrom(req->new_request());
+    const NewScanRequestPB& new_req = req->new_request();
+    scoped_refptr<TabletPeer> tablet_peer;
+    if (!LookupTabletPeerOrRespond(server_->tablet_manager(), new_req.tablet_id(), resp, context,
+                                   &tablet_peer)) {
+      return;
+    }
+
+    Timestamp snap_timestamp;
+    Status s = HandleNewScanRequest(tablet_peer.get(), &scan_req, context,
+                                    &collector, &scanner_id, &snap_timestamp, &has_more,
+                                    &error_code);
+    if (PREDICT_FALSE(!s.ok())) {
+      SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+      return;
+    }
+    if (has_more) {
+      resp->set_scanner_id(scanner_id);
+    }
+    if (snap_timestamp != Timestamp::kInvalidTimestamp) {
+      resp->set_snap_timestamp(snap_timestamp.ToUint64());
+    }
+  } else if (req->has_scanner_id()) {
+    scan_req.set_scanner_id(req->scanner_id());
+    Status s = HandleContinueScanRequest(&scan_req, &collector, &has_more, &error_code);
+    if (PREDICT_FALSE(!s.ok())) {
+      SetupErrorAndRespond(resp->mutable_error(), s, error_code, context);
+      return;
+    }
+  } else {
+    context->RespondFailure(Status::InvalidArgument(
+                            "Must pass either new_request or scanner_id"));
+    return;
+  }
+
+  if (PREDICT_FALSE(!collector.status().ok())) {
+    // The rows of the failed batch have been consumed, so the scan can't be
+    // resumed.
+    if (has_more) {
+      server_->scanner_manager()->UnregisterScanner(scanner_id);
+    }
+    SetupErrorAndRespond(resp->mutable_error(), collector.status(),
+                         TabletServerErrorPB::INVALID_SCAN_SPEC, context);
+    return;
+  }
+
+  collector.ToPB(resp->mutable_groups());
+  resp->set_has_more_results(has_more);
+  SetResourceMetrics(resp->mutable_resource_metrics(), context);
+  resp->set_rows_aggregated(collector.rows_aggregated());
+  context->RespondSuccess();
+}
+
 bool TabletServiceImpl::SupportsFeature(uint32_t feature) const {
-  return feature == TabletServerFeatures::COLUMN_PREDICATES;
+  switch (feature) {
+    case TabletServerFeatures::COLUMN_PREDICATES:
+    case TabletServerFeatures::COLUMNAR_LAYOUT_FEATURE:
+      return true;
+    default:
+      return false;
+  }
 }
 
 void TabletServiceImpl::Shutdown() {
+  scan_resume_pool_->Shutdown();
 }
 
 // Extract a void* pointer suitable for use in a ColumnRangePredicate from the
@@ -1374,7 +2415,8 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
                                                std::string* scanner_id,
                                                Timestamp* snap_timestamp,
                                                bool* has_more_results,
-                                               TabletServerErrorPB::Code* error_code) {
+                                               TabletServerErrorPB::Code* error_code,
+                                               SnapshotWait* wait) {
   DCHECK(result_collector != nullptr);
   DCHECK(error_code != nullptr);
   DCHECK(req->has_new_scan_request());
@@ -1385,9 +2427,14 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   const Schema& tablet_schema = tablet_peer->tablet_metadata()->schema();
 
   SharedScanner scanner;
-  server_->scanner_manager()->NewScanner(tablet_peer,
-                                         rpc_context->requestor_string(),
-                                         &scanner);
+  Status s = server_->scanner_manager()->NewScanner(tablet_peer,
+                                                    rpc_context->requestor_string(),
+                                                    &scanner);
+  if (PREDICT_FALSE(!s.ok())) {
+    // The client backs off and retries a scan turned away as too busy.
+    *error_code = TabletServerErrorPB::THROTTLED;
+    return s;
+  }
 
   // If we early-exit out of this function, automatically unregister
   // the scanner.
@@ -1396,7 +2443,7 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
   // Create the user's requested projection.
   // TODO: add test cases for bad projections including 0 columns
   Schema projection;
-  Status s = ColumnPBsToSchema(scan_pb.projected_columns(), &projection);
+  s = ColumnPBsToSchema(scan_pb.projected_columns(), &projection);
   if (PREDICT_FALSE(!s.ok())) {
     *error_code = TabletServerErrorPB::INVALID_SCHEMA;
     return s;
@@ -1407,6 +2454,11 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     return Status::InvalidArgument("User requests should not have Column IDs");
   }
 
+  if (PREDICT_FALSE(scan_pb.count_only() && projection.num_columns() > 0)) {
+    *error_code = TabletServerErrorPB::INVALID_SCHEMA;
+    return Status::InvalidArgument("Count-only scans must have an empty projection");
+  }
+
   if (scan_pb.order_mode() == ORDERED) {
     // Ordered scans must be at a snapshot so that we perform a serializable read (which can be
     // resumed). Otherwise, this would be read committed isolation, which is not resumable.
@@ -1416,6 +2468,16 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     }
   }
 
+  if (PREDICT_FALSE(scan_pb.row_format_flags() & ~static_cast<uint64_t>(COLUMNAR_LAYOUT))) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return Status::InvalidArgument(
+        Substitute("Unsupported row format flags: $0", scan_pb.row_format_flags()));
+  }
+  scanner->set_row_format_flags(scan_pb.row_format_flags());
+  if (scan_pb.has_limit()) {
+    scanner->set_limit(scan_pb.limit());
+  }
+
   gscoped_ptr<ScanSpec> spec(new ScanSpec);
 
   // Missing columns will contain the columns that are not mentioned in the client
@@ -1428,6 +2490,23 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
     return s;
   }
 
+  // Hide the rows which outlived the table's row TTL, whether or not a
+  // compaction dropped them yet.
+  tablet::RowExpiry expiry;
+  if (tablet_peer->tablet() != nullptr && tablet_peer->tablet()->GetRowExpiry(&expiry)) {
+    int idx = tablet_schema.find_column_by_id(expiry.col_id);
+    if (idx != Schema::kColumnNotFound) {
+      const ColumnSchema& col = tablet_schema.column(idx);
+      int64_t* cutoff = scanner->arena()->NewObject<int64_t>(expiry.cutoff_micros);
+      spec->AddPredicate(ColumnPredicate::Range(col, cutoff, nullptr));
+      if (projection.find_column(col.name()) == Schema::kColumnNotFound &&
+          std::none_of(missing_cols.begin(), missing_cols.end(),
+                       [&](const ColumnSchema& c) { return c.name() == col.name(); })) {
+        missing_cols.push_back(col);
+      }
+    }
+  }
+
   VLOG(3) << "Before optimizing scan spec: " << spec->ToString(tablet_schema);
   spec->OptimizeScan(tablet_schema, scanner->arena(), scanner->autorelease_pool(), true);
   VLOG(3) << "After optimizing scan spec: " << spec->ToString(tablet_schema);
@@ -1460,6 +2539,94 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
 
   shared_ptr<Tablet> tablet;
   RETURN_NOT_OK(GetTabletRef(tablet_peer, &tablet, error_code));
+
+  // Check the lease before picking the read point, so that every write
+  // acknowledged before this scan arrived is visible to it.
+  if (scan_pb.require_leader_lease()) {
+    if (PREDICT_FALSE(scan_pb.has_snap_timestamp())) {
+      *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+      return Status::InvalidArgument("Leader lease scans cannot specify a snapshot timestamp");
+    }
+    scoped_refptr<Consensus> consensus = tablet_peer->shared_consensus();
+    s = consensus ? consensus->CheckLeaderLease()
+                  : Status::ServiceUnavailable("Consensus unavailable. Tablet not running");
+    if (PREDICT_FALSE(!s.ok())) {
+      *error_code = TabletServerErrorPB::NOT_THE_LEADER;
+      return s;
+    }
+    TRACE("Leader lease held");
+  }
+
+  // Bounded-staleness scans are served by followers at their safe time, as
+  // long as it is recent enough and covers any timestamp the client propagated.
+  bool read_at_safe_time = false;
+  if (scan_pb.has_max_staleness_us()) {
+    if (PREDICT_FALSE(scan_pb.read_mode() != READ_AT_SNAPSHOT ||
+                      scan_pb.has_snap_timestamp())) {
+      *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+      return Status::InvalidArgument(
+          "Max staleness requires a READ_AT_SNAPSHOT scan without a snapshot timestamp");
+    }
+    scoped_refptr<Consensus> consensus = tablet_peer->shared_consensus();
+    if (consensus && consensus->role() != consensus::RaftPeerPB::LEADER) {
+      Timestamp max_allowed_ts;
+      s = server_->clock()->GetGlobalLatest(&max_allowed_ts);
+      if (PREDICT_FALSE(!s.ok())) {
+        *error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
+        return Status::NotSupported("Bounded-staleness scans not supported on this server",
+                                    s.ToString());
+      }
+      Timestamp safe_time = tablet->mvcc_manager()->GetCleanTimestamp();
+      uint64_t now_us = server::HybridClock::GetPhysicalValueMicros(server_->clock()->Now());
+      uint64_t safe_us = server::HybridClock::GetPhysicalValueMicros(safe_time);
+      uint64_t staleness_us = now_us > safe_us ? now_us - safe_us : 0;
+      if (staleness_us > scan_pb.max_staleness_us()) {
+        *error_code = TabletServerErrorPB::REPLICA_TOO_STALE;
+        return Status::ServiceUnavailable(
+            Substitute("Replica is $0us behind, more than the allowed $1us",
+                       staleness_us, scan_pb.max_staleness_us()));
+      }
+      if (scan_pb.has_propagated_timestamp() &&
+          safe_time.CompareTo(Timestamp(scan_pb.propagated_timestamp())) < 0) {
+        *error_code = TabletServerErrorPB::REPLICA_TOO_STALE;
+        return Status::ServiceUnavailable("Replica has not caught up to the propagated timestamp");
+      }
+      read_at_safe_time = true;
+      TRACE("Reading at safe time, $0us behind", staleness_us);
+    }
+  }
+
+  // COUNT(*) over the whole tablet can usually be answered from the rowset
+  // metadata. This is only valid for the latest data, or for a snapshot whose
+  // timestamp the server gets to pick.
+  if (scan_pb.count_only() &&
+      projection.num_columns() == 0 &&
+      spec->predicates().empty() &&
+      spec->lower_bound_key() == nullptr &&
+      spec->exclusive_upper_bound_key() == nullptr &&
+      !scan_pb.has_limit() &&
+      (scan_pb.read_mode() == READ_LATEST ||
+       (scan_pb.read_mode() == READ_AT_SNAPSHOT &&
+        !scan_pb.has_snap_timestamp() &&
+        !scan_pb.has_propagated_timestamp()))) {
+    uint64_t count;
+    Timestamp count_timestamp;
+    s = tablet->CountLiveRows(&count, &count_timestamp);
+    if (s.ok()) {
+      RETURN_NOT_OK(result_collector->InitSerializer(scan_pb.row_format_flags(), projection));
+      if (result_collector->HandleRowCount(count)) {
+        TRACE("Counted $0 rows from rowset metadata", count);
+        if (scan_pb.read_mode() == READ_AT_SNAPSHOT) {
+          *snap_timestamp = count_timestamp;
+        }
+        *has_more_results = false;
+        return Status::OK();
+      }
+    } else {
+      VLOG(2) << "Falling back to a scan to count rows: " << s.ToString();
+    }
+  }
+
   {
     TRACE("Creating iterator");
     TRACE_EVENT0("tserver", "Create iterator");
@@ -1475,7 +2642,12 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
         break;
       }
       case READ_AT_SNAPSHOT: {
-        s = HandleScanAtSnapshot(scan_pb, rpc_context, projection, tablet, &iter, snap_timestamp);
+        s = HandleScanAtSnapshot(scan_pb, rpc_context, projection, tablet, read_at_safe_time,
+                                 &iter, snap_timestamp, wait);
+        if (s.IsIncomplete() && wait != nullptr && wait->may_defer && wait->parked) {
+          // Parked until the snapshot is clean; the scan will be run again.
+          return s;
+        }
         if (!s.ok()) {
           tmp_error_code = TabletServerErrorPB::INVALID_SNAPSHOT;
         }
@@ -1486,7 +2658,12 @@ Status TabletServiceImpl::HandleNewScanRequest(TabletPeer* tablet_peer,
 
   if (PREDICT_TRUE(s.ok())) {
     TRACE_EVENT0("tserver", "iter->Init");
+    MonoTime init_start_time = MonoTime::Now(MonoTime::FINE);
     s = iter->Init(spec.get());
+    uint64_t init_duration_usec =
+        MonoTime::Now(MonoTime::FINE).GetDeltaSince(init_start_time).ToMicroseconds();
+    TRACE_COUNTER_INCREMENT("scan_iterator_init_us", init_duration_usec);
+    tablet->metrics()->scanner_iterator_init_duration->Increment(init_duration_usec);
   }
 
   TRACE("Iterator init: $0", s.ToString());
@@ -1578,14 +2755,21 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   scanner->IncrementCallSeqId();
   scanner->UpdateAccessTime();
 
+  Status s = result_collector->InitSerializer(scanner->row_format_flags(),
+                                              scanner->iter()->schema());
+  if (PREDICT_FALSE(!s.ok())) {
+    *error_code = TabletServerErrorPB::INVALID_SCAN_SPEC;
+    return s;
+  }
+
   RowwiseIterator* iter = scanner->iter();
 
-  // TODO: could size the RowBlock based on the user's requested batch size?
-  // If people had really large indirect objects, we would currently overshoot
-  // their requested batch size by a lot.
-  Arena arena(32 * 1024, 1 * 1024 * 1024);
-  RowBlock block(scanner->iter()->schema(),
-                 FLAGS_scanner_batch_size_rows, &arena);
+  // The block is resized as the bytes per row are observed; the scanner
+  // carries the estimate over from one request to the next, along with the
+  // block and its arena.
+  scanner->ResetBatchArena();
+  RowBlock* block = scanner->GetBatchBlock(
+      GetBatchSizeRows(iter->schema(), batch_size_bytes, scanner->bytes_per_row()));
 
   // TODO: in the future, use the client timeout to set a budget. For now,
   // just use a half second, which should be plenty to amortize call overhead.
@@ -1594,31 +2778,47 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
   deadline.AddDelta(MonoDelta::FromMilliseconds(budget_ms));
 
   int64_t rows_scanned = 0;
-  while (iter->HasNext()) {
+  uint64_t serialize_duration_usec = 0;
+  while (iter->HasNext() && !scanner->limit_reached()) {
     if (PREDICT_FALSE(FLAGS_scanner_inject_latency_on_each_batch_ms > 0)) {
       SleepFor(MonoDelta::FromMilliseconds(FLAGS_scanner_inject_latency_on_each_batch_ms));
     }
 
-    Status s = iter->NextBlock(&block);
+    s = iter->NextBlock(block);
     if (PREDICT_FALSE(!s.ok())) {
       LOG(WARNING) << "Copying rows from internal iterator for request " << req->ShortDebugString();
       *error_code = TabletServerErrorPB::UNKNOWN_ERROR;
       return s;
     }
 
-    if (PREDICT_TRUE(block.nrows() > 0)) {
+    int64_t prev_response_size = result_collector->ResponseSize();
+    if (PREDICT_TRUE(block->nrows() > 0)) {
       // Count the number of rows scanned, regardless of predicates or deletions.
       // The collector will separately count the number of rows actually returned to
       // the client.
-      rows_scanned += block.nrows();
-      result_collector->HandleRowBlock(scanner->client_projection_schema(), block);
+      rows_scanned += block->nrows();
+      if (scanner->has_limit()) {
+        ApplyScanLimit(scanner.get(), block);
+      }
+      MonoTime serialize_start_time = MonoTime::Now(MonoTime::FINE);
+      result_collector->HandleRowBlock(scanner->client_projection_schema(), *block);
+      serialize_duration_usec +=
+          MonoTime::Now(MonoTime::FINE).GetDeltaSince(serialize_start_time).ToMicroseconds();
     }
 
     int64_t response_size = result_collector->ResponseSize();
 
     if (VLOG_IS_ON(2)) {
       // This may be fairly expensive if row block size is small
-      TRACE("Copied block (nrows=$0), new size=$1", block.nrows(), response_size);
+      TRACE("Copied block (nrows=$0), new size=$1", block->nrows(), response_size);
+    }
+
+    if (PREDICT_TRUE(block->nrows() > 0 && response_size >= prev_response_size)) {
+      double observed = std::min<double>(response_size - prev_response_size, batch_size_bytes) /
+          block->nrows();
+      scanner->UpdateBytesPerRow(observed);
+      block = scanner->GetBatchBlock(
+          GetBatchSizeRows(iter->schema(), batch_size_bytes, scanner->bytes_per_row()));
     }
 
     // TODO: should check if RPC got cancelled, once we implement RPC cancellation.
@@ -1665,9 +2865,29 @@ Status TabletServiceImpl::HandleContinueScanRequest(const ScanRequestPB* req,
       delta_stats.cells_read_from_disk);
   tablet->metrics()->scanner_bytes_scanned_from_disk->IncrementBy(
       delta_stats.bytes_read_from_disk);
+  // ... and to the client, through the RPC's resource metrics.
+  TRACE_COUNTER_INCREMENT(kScanDataBlocksReadMetricName, delta_stats.data_blocks_read_from_disk);
+  TRACE_COUNTER_INCREMENT(kScanBytesReadMetricName, delta_stats.bytes_read_from_disk);
+  TRACE_COUNTER_INCREMENT(kScanCellsReadMetricName, delta_stats.cells_read_from_disk);
+
+  // Finally, the time spent in each stage of reading the rows. The iterators
+  // account for the time they spend decoding, applying deltas and evaluating
+  // predicates in the RPC's trace.
+  TRACE_COUNTER_INCREMENT("scan_serialize_us", serialize_duration_usec);
+  tablet->metrics()->scanner_serialize_duration->Increment(serialize_duration_usec);
+  Trace* trace = Trace::CurrentTrace();
+  if (trace) {
+    tablet->metrics()->scanner_decode_duration->Increment(
+        trace->metrics()->GetMetric(tablet::SCAN_DECODE_TIME_METRIC_NAME));
+    tablet->metrics()->scanner_delta_apply_duration->Increment(
+        trace->metrics()->GetMetric(tablet::SCAN_DELTA_APPLY_TIME_METRIC_NAME));
+    tablet->metrics()->scanner_predicate_eval_duration->Increment(
+        trace->metrics()->GetMetric(SCAN_PREDICATE_EVAL_TIME_METRIC_NAME));
+  }
 
   scanner->UpdateAccessTime();
-  *has_more_results = !req->close_scanner() && iter->HasNext();
+  // A scanner which reached its limit is closed, even if it has more rows.
+  *has_more_results = !req->close_scanner() && iter->HasNext() && !scanner->limit_reached();
   if (*has_more_results) {
     unreg_scanner.Cancel();
   } else {
@@ -1681,11 +2901,10 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
                                                const RpcContext* rpc_context,
                                                const Schema& projection,
                                                const shared_ptr<Tablet>& tablet,
+                                               bool read_at_safe_time,
                                                gscoped_ptr<RowwiseIterator>* iter,
-                                               Timestamp* snap_timestamp) {
-
-  // TODO check against the earliest boundary (i.e. how early can we go) right
-  // now we're keeping all undos/redos forever!
+                                               Timestamp* snap_timestamp,
+                                               SnapshotWait* wait) {
 
   // If the client sent a timestamp update our clock with it.
   if (scan_pb.has_propagated_timestamp()) {
@@ -1701,8 +2920,15 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   Timestamp tmp_snap_timestamp;
 
   // If the client provided no snapshot timestamp we take the current clock
-  // time as the snapshot timestamp.
-  if (!scan_pb.has_snap_timestamp()) {
+  // time as the snapshot timestamp, or the safe time for bounded-staleness
+  // scans on followers, which never needs to wait. A scan resuming after
+  // being parked reuses the timestamp it picked the first time around.
+  bool resumed = wait != nullptr && wait->parked;
+  if (resumed) {
+    tmp_snap_timestamp = wait->snap_timestamp;
+  } else if (read_at_safe_time) {
+    tmp_snap_timestamp = tablet->mvcc_manager()->GetCleanTimestamp();
+  } else if (!scan_pb.has_snap_timestamp()) {
     tmp_snap_timestamp = server_->clock()->Now();
   // ... else we use the client provided one, but make sure it is not too far
   // in the future as to be invalid.
@@ -1720,6 +2946,17 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
                      server_->clock()->Stringify(tmp_snap_timestamp),
                      server_->clock()->Stringify(max_allowed_ts)));
     }
+    // The history before the ancient history mark may already be gone.
+    Timestamp ancient_history_mark;
+    if (tablet->GetTabletAncientHistoryMark(&ancient_history_mark) &&
+        tmp_snap_timestamp.CompareTo(ancient_history_mark) < 0) {
+      return Status::InvalidArgument(
+          Substitute("Snapshot time $0 is older than the tablet's history retention "
+                     "of $1 seconds. Earliest allowed timestamp is $2",
+                     server_->clock()->Stringify(tmp_snap_timestamp),
+                     tablet->HistoryMaxAge().ToSeconds(),
+                     server_->clock()->Stringify(ancient_history_mark)));
+    }
   }
 
   tablet::MvccSnapshot snap;
@@ -1732,19 +2969,39 @@ Status TabletServiceImpl::HandleScanAtSnapshot(const NewScanRequestPB& scan_pb,
   // has been since the MVCC manager was able to advance its safe time. If it has been
   // a long time, it's likely that the majority of voters for this tablet are down
   // and some writes are "stuck" and therefore won't be committed.
-  MonoTime client_deadline = rpc_context->GetClientDeadline();
-  // Subtract a little bit from the client deadline so that it's more likely we actually
-  // have time to send our response sent back before it times out.
-  client_deadline.AddDelta(MonoDelta::FromMilliseconds(-10));
+  MonoTime deadline;
+  MonoTime before;
+  if (resumed) {
+    deadline = wait->deadline;
+    before = wait->wait_start;
+  } else {
+    MonoTime client_deadline = rpc_context->GetClientDeadline();
+    // Subtract a little bit from the client deadline so that it's more likely we actually
+    // have time to send our response sent back before it times out.
+    client_deadline.AddDelta(MonoDelta::FromMilliseconds(-10));
+
+    deadline = MonoTime::Now(MonoTime::FINE);
+    deadline.AddDelta(MonoDelta::FromSeconds(5));
+    if (client_deadline.ComesBefore(deadline)) {
+      deadline = client_deadline;
+    }
+    before = MonoTime::Now(MonoTime::FINE);
+  }
 
-  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
-  deadline.AddDelta(MonoDelta::FromSeconds(5));
-  if (client_deadline.ComesBefore(deadline)) {
-    deadline = client_deadline;
+  // Rather than block this thread while operations in the snapshot are still
+  // in flight, hand the wait off to MVCC and let the caller park the scan.
+  // Waiting for the clock itself is short and is still done inline.
+  if (wait != nullptr && wait->may_defer &&
+      server_->clock()->IsAfter(tmp_snap_timestamp) &&
+      !tablet->mvcc_manager()->AreAllTransactionsCommitted(tmp_snap_timestamp)) {
+    wait->parked = true;
+    wait->snap_timestamp = tmp_snap_timestamp;
+    wait->deadline = deadline;
+    wait->wait_start = before;
+    return Status::Incomplete("snapshot is not yet clean");
   }
 
   TRACE("Waiting for operations in snapshot to commit");
-  MonoTime before = MonoTime::Now(MonoTime::FINE);
   RETURN_NOT_OK_PREPEND(
       tablet->mvcc_manager()->WaitForCleanSnapshotAtTimestamp(
           tmp_snap_timestamp, &snap, deadline),
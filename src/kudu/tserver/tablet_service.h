@@ -22,6 +22,7 @@
 #include <vector>
 
 #include "kudu/consensus/consensus.service.h"
+#include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/ref_counted.h"
 #include "kudu/tserver/tserver_admin.service.h"
 #include "kudu/tserver/tserver_service.service.h"
@@ -30,11 +31,17 @@ namespace kudu {
 class RowwiseIterator;
 class Schema;
 class Status;
+class ThreadPool;
 class Timestamp;
 
+namespace rpc {
+class RequestIdPB;
+} // namespace rpc
+
 namespace tablet {
 class Tablet;
 class TabletPeer;
+class TransactionCompletionCallback;
 class TransactionState;
 } // namespace tablet
 
@@ -48,6 +55,8 @@ class TabletServiceImpl : public TabletServerServiceIf {
  public:
   explicit TabletServiceImpl(TabletServer* server);
 
+  ~TabletServiceImpl();
+
   virtual void Ping(const PingRequestPB* req,
                     PingResponsePB* resp,
                     rpc::RpcContext* context) OVERRIDE;
@@ -55,6 +64,9 @@ class TabletServiceImpl : public TabletServerServiceIf {
   virtual void Write(const WriteRequestPB* req, WriteResponsePB* resp,
                    rpc::RpcContext* context) OVERRIDE;
 
+  virtual void MultiWrite(const MultiWriteRequestPB* req, MultiWriteResponsePB* resp,
+                          rpc::RpcContext* context) OVERRIDE;
+
   virtual void Scan(const ScanRequestPB* req,
                     ScanResponsePB* resp,
                     rpc::RpcContext* context) OVERRIDE;
@@ -67,15 +79,62 @@ class TabletServiceImpl : public TabletServerServiceIf {
                            ListTabletsResponsePB* resp,
                            rpc::RpcContext* context) OVERRIDE;
 
+  virtual void SplitKeyRange(const SplitKeyRangeRequestPB* req,
+                             SplitKeyRangeResponsePB* resp,
+                             rpc::RpcContext* context) OVERRIDE;
+
+  virtual void LookupRows(const LookupRowsRequestPB* req,
+                          LookupRowsResponsePB* resp,
+                          rpc::RpcContext* context) OVERRIDE;
+
   virtual void Checksum(const ChecksumRequestPB* req,
                         ChecksumResponsePB* resp,
                         rpc::RpcContext* context) OVERRIDE;
 
+  virtual void Aggregate(const AggregateRequestPB* req,
+                         AggregateResponsePB* resp,
+                         rpc::RpcContext* context) OVERRIDE;
+
   bool SupportsFeature(uint32_t feature) const override;
 
   virtual void Shutdown() OVERRIDE;
 
  private:
+  // Validates 'req' and submits it to its tablet as a write transaction.
+  // 'callback' is notified once the write completes, with 'resp' filled in.
+  // 'request_id' may be NULL if the write's result isn't tracked.
+  //
+  // If the write could not be submitted, returns the error and sets
+  // 'error_code'. 'callback' is then never notified and the caller must
+  // report the error itself.
+  Status SubmitWrite(const WriteRequestPB* req,
+                     WriteResponsePB* resp,
+                     const rpc::RequestIdPB* request_id,
+                     gscoped_ptr<tablet::TransactionCompletionCallback> callback,
+                     TabletServerErrorPB::Code* error_code);
+
+  // Tracks a new snapshot scan which may wait for its snapshot to become clean
+  // off the service threads. Defined in tablet_service.cc.
+  struct SnapshotWait;
+
+  // Does the work of Scan(). If 'wait' allows it, a new snapshot scan whose
+  // snapshot is not yet clean is parked with ParkScan() instead of blocking.
+  void DoScan(const ScanRequestPB* req,
+              ScanResponsePB* resp,
+              rpc::RpcContext* context,
+              SnapshotWait* wait);
+
+  // Waits, without occupying a thread, until the snapshot described by 'wait'
+  // is clean or its deadline passes, then runs the scan again on
+  // 'scan_resume_pool_'.
+  void ParkScan(tablet::TabletPeer* tablet_peer,
+                const ScanRequestPB* req,
+                ScanResponsePB* resp,
+                rpc::RpcContext* context,
+                const SnapshotWait& wait);
+
+  // If 'wait' is non-NULL and allows it, returns Status::Incomplete() and sets
+  // wait->parked rather than waiting for the snapshot to become clean.
   Status HandleNewScanRequest(tablet::TabletPeer* tablet_peer,
                               const ScanRequestPB* req,
                               const rpc::RpcContext* rpc_context,
@@ -83,7 +142,8 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               std::string* scanner_id,
                               Timestamp* snap_timestamp,
                               bool* has_more_results,
-                              TabletServerErrorPB::Code* error_code);
+                              TabletServerErrorPB::Code* error_code,
+                              SnapshotWait* wait = nullptr);
 
   Status HandleContinueScanRequest(const ScanRequestPB* req,
                                    ScanResultCollector* result_collector,
@@ -94,10 +154,15 @@ class TabletServiceImpl : public TabletServerServiceIf {
                               const rpc::RpcContext* rpc_context,
                               const Schema& projection,
                               const std::shared_ptr<tablet::Tablet>& tablet,
+                              bool read_at_safe_time,
                               gscoped_ptr<RowwiseIterator>* iter,
-                              Timestamp* snap_timestamp);
+                              Timestamp* snap_timestamp,
+                              SnapshotWait* wait);
 
   TabletServer* server_;
+
+  // Runs snapshot scans which were parked waiting for their snapshot.
+  gscoped_ptr<ThreadPool> scan_resume_pool_;
 };
 
 class TabletServiceAdminImpl : public TabletServerAdminServiceIf {
@@ -131,6 +196,10 @@ class ConsensusServiceImpl : public consensus::ConsensusServiceIf {
                                consensus::ConsensusResponsePB *resp,
                                rpc::RpcContext *context) OVERRIDE;
 
+  virtual void MultiRaftHeartbeat(const consensus::MultiRaftHeartbeatRequestPB* req,
+                                  consensus::MultiRaftHeartbeatResponsePB* resp,
+                                  rpc::RpcContext* context) OVERRIDE;
+
   virtual void RequestConsensusVote(const consensus::VoteRequestPB* req,
                                     consensus::VoteResponsePB* resp,
                                     rpc::RpcContext* context) OVERRIDE;
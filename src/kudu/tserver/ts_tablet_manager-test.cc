@@ -22,6 +22,7 @@
 
 #include "kudu/common/partition.h"
 #include "kudu/common/schema.h"
+#include "kudu/consensus/consensus_meta.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/fs/fs_manager.h"
 #include "kudu/master/master.pb.h"
@@ -41,10 +42,12 @@
 namespace kudu {
 namespace tserver {
 
+using consensus::ConsensusMetadata;
 using consensus::kInvalidOpIdIndex;
 using consensus::RaftConfigPB;
 using master::ReportedTabletPB;
 using master::TabletReportPB;
+using tablet::TabletMetadata;
 using tablet::TabletPeer;
 
 static const char* const kTabletId = "my-tablet-id";
@@ -82,7 +85,8 @@ class TsTabletManagerTest : public KuduTest {
                                                    tablet_id,
                                                    full_schema, partition.first,
                                                    config_,
-                                                   &tablet_peer));
+                                                   tablet::UNKNOWN_COMPACTION_POLICY, -1,
+                                                   nullptr, false, &tablet_peer));
     if (out_tablet_peer) {
       (*out_tablet_peer) = tablet_peer;
     }
@@ -141,6 +145,29 @@ TEST_F(TsTabletManagerTest, TestCreateTablet) {
   ASSERT_EQ(kTabletId, peer->tablet()->tablet_id());
 }
 
+TEST_F(TsTabletManagerTest, TestTabletOpenPriority) {
+  const string kColdTabletId = "cold-tablet-id";
+  const string kLeaderTabletId = "leader-tablet-id";
+  scoped_refptr<TabletPeer> cold_peer;
+  scoped_refptr<TabletPeer> leader_peer;
+  ASSERT_OK(CreateNewTablet(kColdTabletId, schema_, &cold_peer));
+  ASSERT_OK(CreateNewTablet(kLeaderTabletId, schema_, &leader_peer));
+
+  // Both replicas elected themselves; make the first one look like it last
+  // voted for somebody else.
+  gscoped_ptr<ConsensusMetadata> cmeta;
+  ASSERT_OK(ConsensusMetadata::Load(fs_manager_, kColdTabletId, fs_manager_->uuid(), &cmeta));
+  cmeta->clear_voted_for();
+  ASSERT_OK(cmeta->Flush());
+
+  vector<scoped_refptr<TabletMetadata>> metas = { cold_peer->tablet()->metadata(),
+                                                  leader_peer->tablet()->metadata() };
+  tablet_manager_->SortTabletsByOpenPriority(&metas);
+  ASSERT_EQ(2, metas.size());
+  ASSERT_EQ(kLeaderTabletId, metas[0]->tablet_id());
+  ASSERT_EQ(kColdTabletId, metas[1]->tablet_id());
+}
+
 static void AssertMonotonicReportSeqno(int64_t* report_seqno,
                                        const TabletReportPB &report) {
   ASSERT_LT(*report_seqno, report.sequence_number());
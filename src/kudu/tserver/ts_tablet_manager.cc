@@ -28,6 +28,7 @@
 
 #include "kudu/common/wire_protocol.h"
 #include "kudu/consensus/consensus_meta.h"
+#include "kudu/consensus/heartbeat_batcher.h"
 #include "kudu/consensus/log.h"
 #include "kudu/consensus/metadata.pb.h"
 #include "kudu/consensus/opid_util.h"
@@ -43,6 +44,7 @@
 #include "kudu/tablet/tablet.pb.h"
 #include "kudu/tablet/tablet_bootstrap.h"
 #include "kudu/tablet/tablet_metadata.h"
+#include "kudu/tablet/tablet_metrics.h"
 #include "kudu/tablet/tablet_peer.h"
 #include "kudu/tserver/heartbeater.h"
 #include "kudu/tserver/tablet_copy_client.h"
@@ -66,11 +68,37 @@ DEFINE_int32(num_tablets_to_open_simultaneously, 0,
              "may make sense to manually tune this.");
 TAG_FLAG(num_tablets_to_open_simultaneously, advanced);
 
+DEFINE_bool(open_tablets_in_priority_order, true,
+            "Whether to open the tablets found at startup in priority order rather "
+            "than in directory order. Replicas which were likely leaders (they voted "
+            "for themselves in their latest term) open first, followed by replicas "
+            "with the most write-ahead log data, i.e. the most recent write traffic.");
+TAG_FLAG(open_tablets_in_priority_order, advanced);
+
 DEFINE_int32(tablet_start_warn_threshold_ms, 500,
              "If a tablet takes more than this number of millis to start, issue "
              "a warning with a trace.");
 TAG_FLAG(tablet_start_warn_threshold_ms, hidden);
 
+DEFINE_bool(apply_pool_work_stealing, true,
+            "Whether the threads which apply write operations to tablets each "
+            "keep their own queue of operations, taking them from the others' "
+            "when they run out, rather than all sharing a single queue.");
+TAG_FLAG(apply_pool_work_stealing, advanced);
+TAG_FLAG(apply_pool_work_stealing, experimental);
+
+DEFINE_int32(scanner_prefetch_threads, 0,
+             "Maximum number of threads used to decode the rowsets of tablet "
+             "scans in parallel, shared between all tablets. If 0, each scan "
+             "is decoded by the thread handling its RPC.");
+TAG_FLAG(scanner_prefetch_threads, experimental);
+
+DEFINE_int32(compaction_encode_threads, 0,
+             "Maximum number of threads used to encode the columns of flushes and "
+             "compactions in parallel, shared between all tablets. If 0, each "
+             "flush or compaction encodes its columns on its maintenance thread.");
+TAG_FLAG(compaction_encode_threads, experimental);
+
 DEFINE_double(fault_crash_after_blocks_deleted, 0.0,
               "Fraction of the time when the tablet will crash immediately "
               "after deleting the data blocks during tablet deletion. "
@@ -154,13 +182,31 @@ TSTabletManager::TSTabletManager(FsManager* fs_manager,
     metric_registry_(metric_registry),
     state_(MANAGER_INITIALIZING) {
 
-  CHECK_OK(ThreadPoolBuilder("apply").Build(&apply_pool_));
+  CHECK_OK(ThreadPoolBuilder("prepare").Build(&prepare_pool_));
+
+  CHECK_OK(ThreadPoolBuilder("apply")
+           .set_work_stealing(FLAGS_apply_pool_work_stealing)
+           .Build(&apply_pool_));
   apply_pool_->SetQueueLengthHistogram(
       METRIC_op_apply_queue_length.Instantiate(server_->metric_entity()));
   apply_pool_->SetQueueTimeMicrosHistogram(
       METRIC_op_apply_queue_time.Instantiate(server_->metric_entity()));
   apply_pool_->SetRunTimeMicrosHistogram(
       METRIC_op_apply_run_time.Instantiate(server_->metric_entity()));
+
+  if (FLAGS_scanner_prefetch_threads > 0) {
+    CHECK_OK(ThreadPoolBuilder("scan-prefetch")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_scanner_prefetch_threads)
+             .Build(&scan_prefetch_pool_));
+  }
+
+  if (FLAGS_compaction_encode_threads > 0) {
+    CHECK_OK(ThreadPoolBuilder("compaction-encode")
+             .set_min_threads(0)
+             .set_max_threads(FLAGS_compaction_encode_threads)
+             .Build(&compaction_encode_pool_));
+  }
 }
 
 TSTabletManager::~TSTabletManager() {
@@ -181,6 +227,9 @@ Status TSTabletManager::Init() {
                 .set_max_threads(max_bootstrap_threads)
                 .Build(&open_tablet_pool_));
 
+  heartbeat_batcher_ = std::make_shared<consensus::HeartbeatBatcher>(server_->messenger(),
+                                                                     fs_manager_->uuid());
+
   // Search for tablets in the metadata dir.
   vector<string> tablet_ids;
   RETURN_NOT_OK(fs_manager_->ListTabletIds(&tablet_ids));
@@ -203,7 +252,11 @@ Status TSTabletManager::Init() {
     metas.push_back(meta);
   }
 
-  // Now submit the "Open" task for each.
+  if (FLAGS_open_tablets_in_priority_order) {
+    SortTabletsByOpenPriority(&metas);
+  }
+
+  // Now submit the "Open" task for each. The pool runs them in submission order.
   for (const scoped_refptr<TabletMetadata>& meta : metas) {
     scoped_refptr<TransitionInProgressDeleter> deleter;
     {
@@ -250,6 +303,10 @@ Status TSTabletManager::CreateNewTablet(const string& table_id,
                                         const Schema& schema,
                                         const PartitionSchema& partition_schema,
                                         RaftConfigPB config,
+                                        tablet::CompactionPolicyPB compaction_policy,
+                                        int32_t history_max_age_sec,
+                                        const tablet::RowTtlPB* row_ttl,
+                                        bool pin_key_index,
                                         scoped_refptr<TabletPeer>* tablet_peer) {
   CHECK_EQ(state(), MANAGER_RUNNING);
   CHECK(IsRaftConfigMember(server_->instance_pb().permanent_uuid(), config));
@@ -288,6 +345,16 @@ Status TSTabletManager::CreateNewTablet(const string& table_id,
                               TABLET_DATA_READY,
                               &meta),
     "Couldn't create tablet metadata");
+  if (compaction_policy != tablet::UNKNOWN_COMPACTION_POLICY || history_max_age_sec >= 0 ||
+      row_ttl != nullptr || pin_key_index) {
+    meta->set_compaction_policy(compaction_policy);
+    meta->set_history_max_age_sec(history_max_age_sec);
+    if (row_ttl != nullptr) {
+      meta->set_row_ttl(ColumnId(row_ttl->column_id()), row_ttl->ttl_sec());
+    }
+    meta->set_pin_key_index(pin_key_index);
+    RETURN_NOT_OK_PREPEND(meta->Flush(), "Couldn't persist tablet table options");
+  }
 
   // We must persist the consensus metadata to disk before starting a new
   // tablet's TabletPeer and Consensus implementation.
@@ -416,6 +483,15 @@ Status TSTabletManager::StartTabletCopy(
   TRACE(init_msg);
 
   TabletCopyClient tc_client(tablet_id, fs_manager_, server_->messenger());
+  vector<HostPort> follower_addrs;
+  for (const RaftPeerPB& follower : req.follower_copy_peers()) {
+    HostPort hp;
+    if (follower.permanent_uuid() != fs_manager_->uuid() &&
+        HostPortFromPB(follower.last_known_addr(), &hp).ok()) {
+      follower_addrs.push_back(hp);
+    }
+  }
+  tc_client.SetFollowerSources(std::move(follower_addrs));
 
   // Download and persist the remote superblock in TABLET_DATA_COPYING state.
   if (replacing_tablet) {
@@ -457,6 +533,7 @@ scoped_refptr<TabletPeer> TSTabletManager::CreateAndRegisterTabletPeer(
   scoped_refptr<TabletPeer> tablet_peer(
       new TabletPeer(meta,
                      local_peer_pb_,
+                     prepare_pool_.get(),
                      apply_pool_.get(),
                      Bind(&TSTabletManager::MarkTabletDirty, Unretained(this), meta->tablet_id())));
   RegisterTablet(meta->tablet_id(), tablet_peer, mode);
@@ -613,6 +690,49 @@ Status TSTabletManager::OpenTabletMeta(const string& tablet_id,
   return Status::OK();
 }
 
+void TSTabletManager::SortTabletsByOpenPriority(vector<scoped_refptr<TabletMetadata>>* metas) {
+  struct OpenPriority {
+    bool was_leader;
+    uint64_t wal_bytes;
+    scoped_refptr<TabletMetadata> meta;
+  };
+
+  vector<OpenPriority> priorities;
+  priorities.reserve(metas->size());
+  for (const scoped_refptr<TabletMetadata>& meta : *metas) {
+    OpenPriority p = { false, 0, meta };
+    const string& tablet_id = meta->tablet_id();
+
+    // Errors here only affect the ordering: the bootstrap reports them properly.
+    gscoped_ptr<ConsensusMetadata> cmeta;
+    Status s = ConsensusMetadata::Load(fs_manager_, tablet_id, fs_manager_->uuid(), &cmeta);
+    if (s.ok()) {
+      p.was_leader = cmeta->has_voted_for() && cmeta->voted_for() == fs_manager_->uuid();
+    } else {
+      VLOG(1) << LogPrefix(tablet_id) << "Unable to load consensus metadata: " << s.ToString();
+    }
+    s = fs_manager_->env()->GetFileSizeOnDiskRecursively(fs_manager_->GetTabletWalDir(tablet_id),
+                                                         &p.wal_bytes);
+    if (!s.ok()) {
+      VLOG(1) << LogPrefix(tablet_id) << "Unable to get WAL size: " << s.ToString();
+    }
+    priorities.push_back(std::move(p));
+  }
+
+  std::stable_sort(priorities.begin(), priorities.end(),
+                   [](const OpenPriority& a, const OpenPriority& b) {
+                     if (a.was_leader != b.was_leader) {
+                       return a.was_leader;
+                     }
+                     return a.wal_bytes > b.wal_bytes;
+                   });
+
+  metas->clear();
+  for (OpenPriority& p : priorities) {
+    metas->push_back(std::move(p.meta));
+  }
+}
+
 void TSTabletManager::OpenTablet(const scoped_refptr<TabletMetadata>& meta,
                                  const scoped_refptr<TransitionInProgressDeleter>& deleter) {
   string tablet_id = meta->tablet_id();
@@ -655,6 +775,8 @@ void TSTabletManager::OpenTablet(const scoped_refptr<TabletMetadata>& meta,
       tablet_peer->SetFailed(s);
       return;
     }
+    tablet->set_scan_prefetch_pool(scan_prefetch_pool_.get());
+    tablet->set_compaction_encode_pool(compaction_encode_pool_.get());
   }
 
   MonoTime start(MonoTime::Now(MonoTime::FINE));
@@ -663,6 +785,7 @@ void TSTabletManager::OpenTablet(const scoped_refptr<TabletMetadata>& meta,
     s =  tablet_peer->Init(tablet,
                            scoped_refptr<server::Clock>(server_->clock()),
                            server_->messenger(),
+                           heartbeat_batcher_,
                            server_->result_tracker(),
                            log,
                            tablet->GetMetricEntity());
@@ -733,9 +856,20 @@ void TSTabletManager::Shutdown() {
     peer->Shutdown();
   }
 
-  // Shut down the apply pool.
+  // Shut down the prepare and apply pools.
+  prepare_pool_->Shutdown();
   apply_pool_->Shutdown();
 
+  // Any scans still running fail once their prefetch tasks are dropped.
+  if (scan_prefetch_pool_) {
+    scan_prefetch_pool_->Shutdown();
+  }
+
+  // The tablets were shut down above, so no flush or compaction is running.
+  if (compaction_encode_pool_) {
+    compaction_encode_pool_->Shutdown();
+  }
+
   {
     std::lock_guard<rw_spinlock> l(lock_);
     // We don't expect anyone else to be modifying the map after we start the
@@ -823,6 +957,60 @@ int TSTabletManager::GetNumLiveTablets() const {
   return count;
 }
 
+void TSTabletManager::GetLoad(master::TSLoadPB* load) const {
+  vector<scoped_refptr<TabletPeer>> peers;
+  GetTabletPeers(&peers);
+
+  int64_t data_size_bytes = 0;
+  int64_t rows_written = 0;
+  for (const scoped_refptr<TabletPeer>& peer : peers) {
+    shared_ptr<Tablet> tablet = peer->shared_tablet();
+    if (!tablet) {
+      continue;
+    }
+    data_size_bytes += tablet->EstimateOnDiskSize();
+    const tablet::TabletMetrics* metrics = tablet->metrics();
+    if (metrics) {
+      rows_written += metrics->rows_inserted->value() +
+                      metrics->rows_upserted->value() +
+                      metrics->rows_updated->value() +
+                      metrics->rows_deleted->value();
+    }
+  }
+  load->set_data_size_bytes(data_size_bytes);
+  load->set_rows_written(rows_written);
+}
+
+void TSTabletManager::GetTabletStatistics(vector<master::TabletStatisticsPB>* stats) const {
+  vector<scoped_refptr<TabletPeer>> peers;
+  GetTabletPeers(&peers);
+
+  stats->clear();
+  for (const scoped_refptr<TabletPeer>& peer : peers) {
+    shared_ptr<Tablet> tablet = peer->shared_tablet();
+    scoped_refptr<consensus::Consensus> consensus = peer->shared_consensus();
+    if (!tablet || !consensus || consensus->role() != RaftPeerPB::LEADER) {
+      continue;
+    }
+    master::TabletStatisticsPB tablet_stats;
+    tablet_stats.set_tablet_id(peer->tablet_id());
+    vector<ColumnStatisticsPB> columns;
+    Status s = tablet->GetColumnStatistics(&columns);
+    if (!s.ok()) {
+      LOG(WARNING) << Substitute("T $0 P $1: Unable to get the column statistics: $2",
+                                 peer->tablet_id(), fs_manager_->uuid(), s.ToString());
+      continue;
+    }
+    if (columns.empty()) {
+      continue;
+    }
+    for (ColumnStatisticsPB& col_stats : columns) {
+      tablet_stats.add_columns()->Swap(&col_stats);
+    }
+    stats->emplace_back(std::move(tablet_stats));
+  }
+}
+
 void TSTabletManager::InitLocalRaftPeerPB() {
   DCHECK_EQ(state(), MANAGER_INITIALIZING);
   local_peer_pb_.set_permanent_uuid(fs_manager_->uuid());
@@ -44,12 +44,15 @@ class Partition;
 class Schema;
 
 namespace consensus {
+class HeartbeatBatcher;
 class RaftConfigPB;
 } // namespace consensus
 
 namespace master {
 class ReportedTabletPB;
 class TabletReportPB;
+class TabletStatisticsPB;
+class TSLoadPB;
 } // namespace master
 
 namespace rpc {
@@ -114,6 +117,10 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
                          const Schema& schema,
                          const PartitionSchema& partition_schema,
                          consensus::RaftConfigPB config,
+                         tablet::CompactionPolicyPB compaction_policy,
+                         int32_t history_max_age_sec,
+                         const tablet::RowTtlPB* row_ttl,
+                         bool pin_key_index,
                          scoped_refptr<tablet::TabletPeer>* tablet_peer);
 
   // Delete the specified tablet.
@@ -152,6 +159,10 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
       const consensus::StartTabletCopyRequestPB& req,
       boost::optional<TabletServerErrorPB::Code>* error_code) OVERRIDE;
 
+  virtual consensus::HeartbeatBatcher* heartbeat_batcher() const OVERRIDE {
+    return heartbeat_batcher_.get();
+  }
+
   // Adds updated tablet information to 'report'.
   void PopulateFullTabletReport(master::TabletReportPB* report) const;
 
@@ -173,10 +184,18 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // Return the number of tablets in RUNNING or BOOTSTRAPPING state.
   int GetNumLiveTablets() const;
 
+  // Fill in the load statistics of the tablets hosted by this server.
+  void GetLoad(master::TSLoadPB* load) const;
+
+  // Fill in the column statistics of the tablets whose replicas hosted by
+  // this server are leaders, so that each tablet is reported once.
+  void GetTabletStatistics(std::vector<master::TabletStatisticsPB>* stats) const;
+
   Status RunAllLogGC();
 
  private:
   FRIEND_TEST(TsTabletManagerTest, TestPersistBlocks);
+  FRIEND_TEST(TsTabletManagerTest, TestTabletOpenPriority);
 
   // Flag specified when registering a TabletPeer.
   enum RegisterTabletPeerMode {
@@ -202,6 +221,10 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
                                             const std::string& reason,
                                             scoped_refptr<TransitionInProgressDeleter>* deleter);
 
+  // Reorder 'metas' so that the tablets which should become available first
+  // come first: likely leaders, then tablets with the most WAL data.
+  void SortTabletsByOpenPriority(std::vector<scoped_refptr<tablet::TabletMetadata>>* metas);
+
   // Open a tablet meta from the local file system by loading its superblock.
   Status OpenTabletMeta(const std::string& tablet_id,
                         scoped_refptr<tablet::TabletMetadata>* metadata);
@@ -313,9 +336,26 @@ class TSTabletManager : public tserver::TabletPeerLookupIf {
   // Thread pool used to open the tablets async, whether bootstrap is required or not.
   gscoped_ptr<ThreadPool> open_tablet_pool_;
 
+  // Thread pool for prepare transactions, shared between all tablets, each
+  // of which submits its prepares through its own serial token.
+  gscoped_ptr<ThreadPool> prepare_pool_;
+
   // Thread pool for apply transactions, shared between all tablets.
   gscoped_ptr<ThreadPool> apply_pool_;
 
+  // Thread pool for decoding the rowsets of scans in parallel, shared between
+  // all tablets. NULL if disabled by --scanner_prefetch_threads.
+  gscoped_ptr<ThreadPool> scan_prefetch_pool_;
+
+  // Thread pool for encoding the columns of flushes and compactions in
+  // parallel, shared between all tablets. NULL if disabled by
+  // --compaction_encode_threads.
+  gscoped_ptr<ThreadPool> compaction_encode_pool_;
+
+  // Coalesces the consensus heartbeats that the tablets on this server send
+  // to each of the other servers, shared between all tablets.
+  std::shared_ptr<consensus::HeartbeatBatcher> heartbeat_batcher_;
+
   DISALLOW_COPY_AND_ASSIGN(TSTabletManager);
 };
 
@@ -85,6 +85,10 @@ Status TabletServerPathHandlers::Register(Webserver* server) {
     "/tablet-rowsetlayout-svg", "",
     boost::bind(&TabletServerPathHandlers::HandleTabletSVGPage, this, _1, _2),
     true /* styled */, false /* is_on_nav_bar */);
+  server->RegisterPathHandler(
+    "/tablet-storage-memory", "",
+    boost::bind(&TabletServerPathHandlers::HandleTabletStorageMemoryPage, this, _1, _2),
+    true /* styled */, false /* is_on_nav_bar */);
   server->RegisterPathHandler(
     "/tablet-consensus-status", "",
     boost::bind(&TabletServerPathHandlers::HandleConsensusStatusPage, this, _1, _2),
@@ -339,6 +343,12 @@ void TabletServerPathHandlers::HandleTabletPage(const Webserver::WebRequest& req
                                   "Rowset Layout Diagram")
           << "</li>" << endl;
 
+  // Link to the memory used by the readers of the tablet's files.
+  *output << "<li>" << Substitute("<a href=\"/tablet-storage-memory?id=$0\">$1</a>",
+                                  UrlEncodeToString(tablet_id),
+                                  "Storage Reader Memory")
+          << "</li>" << endl;
+
   // Link to consensus status page.
   *output << "<li>" << Substitute("<a href=\"/tablet-consensus-status?id=$0\">$1</a>",
                                   UrlEncodeToString(tablet_id),
@@ -372,6 +382,22 @@ void TabletServerPathHandlers::HandleTabletSVGPage(const Webserver::WebRequest&
 
 }
 
+void TabletServerPathHandlers::HandleTabletStorageMemoryPage(const Webserver::WebRequest& req,
+                                                             std::stringstream* output) {
+  string id;
+  scoped_refptr<TabletPeer> peer;
+  if (!LoadTablet(tserver_, req, &id, &peer, output)) return;
+  shared_ptr<Tablet> tablet = peer->shared_tablet();
+  if (!tablet) {
+    *output << "Tablet " << EscapeForHtmlToString(id) << " not running";
+    return;
+  }
+
+  *output << "<h1>Storage Reader Memory for Tablet "
+          << TabletLink(id) << "</h1>\n";
+  tablet->PrintCFileReaderMemory(output);
+}
+
 void TabletServerPathHandlers::HandleLogAnchorsPage(const Webserver::WebRequest& req,
                                                     std::stringstream* output) {
   string tablet_id;
@@ -535,17 +561,31 @@ void TabletServerPathHandlers::HandleMaintenanceManagerPage(const Webserver::Web
   *output << "<h1>Maintenance Manager state</h1>\n";
   *output << "<h3>Running operations</h3>\n";
   *output << "<table class='table table-striped'>\n";
-  *output << "  <tr><th>Name</th><th>Instances running</th></tr>\n";
+  *output << "  <tr><th>Name</th><th>Instances running</th><th>I/O cost</th>"
+          << "<th>Data dirs</th></tr>\n";
   for (int i = 0; i < ops_count; i++) {
     MaintenanceManagerStatusPB_MaintenanceOpPB op_pb = pb.registered_operations(i);
     if (op_pb.running() > 0) {
-      *output <<  Substitute("<tr><td>$0</td><td>$1</td></tr>\n",
+      *output <<  Substitute("<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td></tr>\n",
                              EscapeForHtmlToString(op_pb.name()),
-                             op_pb.running());
+                             op_pb.running(),
+                             HumanReadableNumBytes::ToString(op_pb.io_bytes()),
+                             EscapeForHtmlToString(JoinStrings(op_pb.data_dirs(), ", ")));
     }
   }
   *output << "</table>\n";
 
+  *output << "<h3>Data directory I/O</h3>\n";
+  *output << "<table class='table table-striped'>\n";
+  *output << "  <tr><th>Data dir</th><th>Operations running</th><th>I/O in flight</th></tr>\n";
+  for (const MaintenanceManagerStatusPB_DiskLoadPB& disk_pb : pb.disk_loads()) {
+    *output << Substitute("<tr><td>$0</td><td>$1</td><td>$2</td></tr>\n",
+                          EscapeForHtmlToString(disk_pb.data_dir()),
+                          disk_pb.running_ops(),
+                          HumanReadableNumBytes::ToString(disk_pb.io_bytes()));
+  }
+  *output << "</table>\n";
+
   *output << "<h3>Recent completed operations</h3>\n";
   *output << "<table class='table table-striped'>\n";
   *output << "  <tr><th>Name</th><th>Duration</th><th>Time since op started</th></tr>\n";
@@ -563,16 +603,21 @@ void TabletServerPathHandlers::HandleMaintenanceManagerPage(const Webserver::Web
   *output << "<h3>Non-running operations</h3>\n";
   *output << "<table class='table table-striped'>\n";
   *output << "  <tr><th>Name</th><th>Runnable</th><th>RAM anchored</th>\n"
-          << "       <th>Logs retained</th><th>Perf</th></tr>\n";
+          << "       <th>Logs retained</th><th>Data retained</th><th>Perf</th>"
+          << "<th>I/O cost</th><th>Data dirs</th></tr>\n";
   for (int i = 0; i < ops_count; i++) {
     MaintenanceManagerStatusPB_MaintenanceOpPB op_pb = pb.registered_operations(i);
     if (op_pb.running() == 0) {
-      *output << Substitute("<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4</td></tr>\n",
+      *output << Substitute("<tr><td>$0</td><td>$1</td><td>$2</td><td>$3</td><td>$4</td>"
+                            "<td>$5</td><td>$6</td><td>$7</td></tr>\n",
                             EscapeForHtmlToString(op_pb.name()),
                             op_pb.runnable(),
                             HumanReadableNumBytes::ToString(op_pb.ram_anchored_bytes()),
                             HumanReadableNumBytes::ToString(op_pb.logs_retained_bytes()),
-                            op_pb.perf_improvement());
+                            HumanReadableNumBytes::ToString(op_pb.data_retained_bytes()),
+                            op_pb.perf_improvement(),
+                            HumanReadableNumBytes::ToString(op_pb.io_bytes()),
+                            EscapeForHtmlToString(JoinStrings(op_pb.data_dirs(), ", ")));
     }
   }
   *output << "</table>\n";
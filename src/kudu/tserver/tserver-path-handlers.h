@@ -56,6 +56,8 @@ class TabletServerPathHandlers {
                         std::stringstream* output);
   void HandleTransactionsPage(const Webserver::WebRequest& req,
                               std::stringstream* output);
+  void HandleTabletStorageMemoryPage(const Webserver::WebRequest& req,
+                                     std::stringstream* output);
   void HandleTabletSVGPage(const Webserver::WebRequest& req,
                            std::stringstream* output);
   void HandleLogAnchorsPage(const Webserver::WebRequest& req,
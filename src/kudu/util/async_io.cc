@@ -0,0 +1,80 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/async_io.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/once.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/threadpool.h"
+
+DEFINE_int32(async_io_threads, 0,
+             "Maximum number of threads used to service asynchronous file "
+             "reads. If 0, asynchronous reads are performed synchronously by "
+             "the thread that submits them. Read at the first asynchronous "
+             "read and not changeable afterwards.");
+TAG_FLAG(async_io_threads, experimental);
+
+DEFINE_int32(async_io_max_queue_size, 1024,
+             "Maximum number of asynchronous file reads which may be queued "
+             "waiting for an I/O thread. Reads submitted past this limit are "
+             "performed synchronously by the submitting thread.");
+TAG_FLAG(async_io_max_queue_size, experimental);
+
+namespace kudu {
+
+namespace {
+
+GoogleOnceType async_io_pool_once = GOOGLE_ONCE_INIT;
+
+// The pool is never destroyed: operations may be in flight at exit.
+ThreadPool* async_io_pool = nullptr;
+
+void InitAsyncIoPool() {
+  if (FLAGS_async_io_threads <= 0) {
+    return;
+  }
+  gscoped_ptr<ThreadPool> pool;
+  Status s = ThreadPoolBuilder("async-io")
+      .set_min_threads(0)
+      .set_max_threads(FLAGS_async_io_threads)
+      .set_max_queue_size(FLAGS_async_io_max_queue_size)
+      .set_idle_timeout(MonoDelta::FromSeconds(10))
+      .Build(&pool);
+  if (!s.ok()) {
+    LOG(WARNING) << "Unable to create asynchronous I/O pool, performing "
+                 << "asynchronous reads synchronously: " << s.ToString();
+    return;
+  }
+  async_io_pool = pool.release();
+}
+
+} // anonymous namespace
+
+void SubmitAsyncIo(const boost::function<void()>& io) {
+  GoogleOnceInit(&async_io_pool_once, &InitAsyncIoPool);
+  if (async_io_pool != nullptr && async_io_pool->SubmitFunc(io).ok()) {
+    return;
+  }
+  io();
+}
+
+} // namespace kudu
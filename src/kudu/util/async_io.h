@@ -0,0 +1,38 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_ASYNC_IO_H
+#define KUDU_UTIL_ASYNC_IO_H
+
+#include <boost/function.hpp>
+
+namespace kudu {
+
+// Submits 'io', a blocking I/O operation, to the process-wide asynchronous
+// I/O pool, which is sized by --async_io_threads. This lets a caller keep
+// many operations in flight without tying up its own thread.
+//
+// If the pool is disabled (the default) or cannot accept more work, 'io' is
+// run on the calling thread before this returns, so callers must not assume
+// that their completion callback runs on a different thread.
+//
+// 'io' runs on an I/O thread and should complete promptly: it must not block
+// on anything other than the I/O it performs.
+void SubmitAsyncIo(const boost::function<void()>& io);
+
+} // namespace kudu
+
+#endif
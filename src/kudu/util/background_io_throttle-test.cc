@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/background_io_throttle.h"
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int64(background_io_mb_per_sec);
+DECLARE_int32(background_io_throttle_relax_memory_pct);
+
+namespace kudu {
+
+class BackgroundIOThrottleTest : public KuduTest {
+ protected:
+  // Pushes 'total_bytes' through the throttle in 64KB requests and returns
+  // how long that took.
+  static MonoDelta TimeThrottle(uint64_t total_bytes) {
+    const uint64_t kChunk = 64 * 1024;
+    MonoTime start = MonoTime::Now(MonoTime::FINE);
+    for (uint64_t done = 0; done < total_bytes; done += kChunk) {
+      BackgroundIOThrottle::Throttle(kChunk);
+    }
+    return MonoTime::Now(MonoTime::FINE).GetDeltaSince(start);
+  }
+};
+
+TEST_F(BackgroundIOThrottleTest, TestOnlyBackgroundThreadsAreThrottled) {
+  FLAGS_background_io_mb_per_sec = 1;
+  FLAGS_background_io_throttle_relax_memory_pct = 100;
+  ASSERT_FALSE(BackgroundIOThrottle::IsBackgroundThread());
+  ASSERT_LT(TimeThrottle(10 * 1024 * 1024).ToMilliseconds(), 100);
+
+  {
+    BackgroundIOThrottle::ScopedBackgroundIO outer;
+    {
+      BackgroundIOThrottle::ScopedBackgroundIO inner;
+      ASSERT_TRUE(BackgroundIOThrottle::IsBackgroundThread());
+    }
+    ASSERT_TRUE(BackgroundIOThrottle::IsBackgroundThread());
+  }
+  ASSERT_FALSE(BackgroundIOThrottle::IsBackgroundThread());
+}
+
+TEST_F(BackgroundIOThrottleTest, TestRateLimit) {
+  FLAGS_background_io_mb_per_sec = 10;
+  FLAGS_background_io_throttle_relax_memory_pct = 100;
+  BackgroundIOThrottle::ScopedBackgroundIO background_io;
+
+  // 5MB at 10MB/s, starting from an empty bucket, takes about half a second.
+  ASSERT_GE(TimeThrottle(5 * 1024 * 1024).ToMilliseconds(), 300);
+
+  // Turning the throttle off takes effect immediately.
+  FLAGS_background_io_mb_per_sec = 0;
+  ASSERT_LT(TimeThrottle(100 * 1024 * 1024).ToMilliseconds(), 100);
+}
+
+TEST_F(BackgroundIOThrottleTest, TestRelaxUnderMemoryPressure) {
+  FLAGS_background_io_mb_per_sec = 1;
+  // Any memory consumption counts as pressure.
+  FLAGS_background_io_throttle_relax_memory_pct = 0;
+  BackgroundIOThrottle::ScopedBackgroundIO background_io;
+  ASSERT_LT(TimeThrottle(10 * 1024 * 1024).ToMilliseconds(), 1000);
+}
+
+} // namespace kudu
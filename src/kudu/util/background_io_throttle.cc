@@ -0,0 +1,122 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/background_io_throttle.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+#include <gflags/gflags.h>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/mem_tracker.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/throttler.h"
+
+DEFINE_int64(background_io_mb_per_sec, 0,
+             "Maximum rate, in megabytes per second, at which flushes, compactions and "
+             "tablet copies may read and write data blocks, summed over the whole "
+             "process. 0 means unlimited.");
+TAG_FLAG(background_io_mb_per_sec, experimental);
+TAG_FLAG(background_io_mb_per_sec, runtime);
+
+DEFINE_int32(background_io_throttle_relax_memory_pct, 80,
+             "Percentage of the process memory limit above which background I/O is no "
+             "longer throttled, so that flushes can free memory as fast as possible.");
+TAG_FLAG(background_io_throttle_relax_memory_pct, experimental);
+TAG_FLAG(background_io_throttle_relax_memory_pct, runtime);
+
+namespace kudu {
+
+namespace {
+
+// How long a throttled thread sleeps before trying again.
+const int kThrottleSleepMs = 10;
+
+// Nesting depth of ScopedBackgroundIO on this thread.
+__thread int background_io_depth = 0;
+
+struct GlobalThrottle {
+  simple_spinlock lock;
+
+  // The rate 'throttler' was built for. Rebuilt when the flag changes.
+  int64_t mb_per_sec = 0;
+  gscoped_ptr<Throttler> throttler;
+};
+
+GlobalThrottle* global_throttle() {
+  static GlobalThrottle* throttle = new GlobalThrottle();
+  return throttle;
+}
+
+bool MemoryNearLimit() {
+  std::shared_ptr<MemTracker> root = MemTracker::GetRootTracker();
+  return root->has_limit() &&
+      root->consumption() >=
+          root->limit() / 100 * FLAGS_background_io_throttle_relax_memory_pct;
+}
+
+} // anonymous namespace
+
+BackgroundIOThrottle::ScopedBackgroundIO::ScopedBackgroundIO() {
+  background_io_depth++;
+}
+
+BackgroundIOThrottle::ScopedBackgroundIO::~ScopedBackgroundIO() {
+  background_io_depth--;
+}
+
+bool BackgroundIOThrottle::IsBackgroundThread() {
+  return background_io_depth > 0;
+}
+
+void BackgroundIOThrottle::Throttle(uint64_t bytes) {
+  if (background_io_depth == 0 || bytes == 0) {
+    return;
+  }
+  GlobalThrottle* g = global_throttle();
+  while (true) {
+    int64_t mb_per_sec = FLAGS_background_io_mb_per_sec;
+    if (mb_per_sec <= 0) {
+      return;
+    }
+    // The bucket holds at most a second's worth of tokens, so larger
+    // requests are charged as one second.
+    uint64_t byte_rate = mb_per_sec * 1024 * 1024;
+    uint64_t to_take = std::min(bytes, byte_rate);
+    {
+      std::lock_guard<simple_spinlock> l(g->lock);
+      MonoTime now = MonoTime::Now(MonoTime::FINE);
+      if (!g->throttler || g->mb_per_sec != mb_per_sec) {
+        g->throttler.reset(new Throttler(now, 0, byte_rate, 10));
+        g->mb_per_sec = mb_per_sec;
+      }
+      if (g->throttler->Take(now, 0, to_take)) {
+        return;
+      }
+    }
+    if (MemoryNearLimit()) {
+      return;
+    }
+    SleepFor(MonoDelta::FromMilliseconds(kThrottleSleepMs));
+  }
+}
+
+} // namespace kudu
@@ -0,0 +1,62 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef KUDU_UTIL_BACKGROUND_IO_THROTTLE_H
+#define KUDU_UTIL_BACKGROUND_IO_THROTTLE_H
+
+#include <stdint.h>
+
+#include "kudu/gutil/macros.h"
+
+namespace kudu {
+
+// A process-wide token bucket shared by all background I/O: flushes,
+// compactions and tablet copies. Foreground reads and writes are never
+// throttled.
+//
+// A thread opts in by constructing a ScopedBackgroundIO; the block managers
+// then call Throttle() before each read and append. The rate comes from
+// --background_io_mb_per_sec, which can be changed at runtime. When the root
+// MemTracker approaches its limit the throttle is lifted so that flushes can
+// keep up with incoming writes.
+class BackgroundIOThrottle {
+ public:
+  // Marks the current thread as doing background I/O for the lifetime of the
+  // object. May be nested.
+  class ScopedBackgroundIO {
+   public:
+    ScopedBackgroundIO();
+    ~ScopedBackgroundIO();
+
+   private:
+    DISALLOW_COPY_AND_ASSIGN(ScopedBackgroundIO);
+  };
+
+  // Returns true if the current thread is inside a ScopedBackgroundIO.
+  static bool IsBackgroundThread();
+
+  // If the current thread is doing background I/O, blocks until 'bytes' may
+  // be read or written. Otherwise returns immediately.
+  static void Throttle(uint64_t bytes);
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(BackgroundIOThrottle);
+};
+
+} // namespace kudu
+
+#endif
@@ -16,10 +16,12 @@
 // under the License.
 
 #include <gtest/gtest.h>
+#include <random>
 #include <vector>
 
 #include "kudu/gutil/strings/join.h"
 #include "kudu/util/bitmap.h"
+#include "kudu/util/test_util.h"
 
 namespace kudu {
 
@@ -220,4 +222,42 @@ TEST(TestBitMap, TestBitmapIteration) {
   ASSERT_EQ(expected_sizes[i], size);
 }
 
+// The whole-bitmap kernels agree with bit-at-a-time operations, including on
+// the last partial word and byte, and leave the bits past the end alone.
+TEST(TestBitMap, TestBitmapKernels) {
+  std::mt19937 rng(SeedRandom());
+  for (size_t n_bits : { 1, 7, 8, 63, 64, 65, 200, 1000, 1024 }) {
+    SCOPED_TRACE(n_bits);
+    const size_t n_bytes = BitmapSize(n_bits) + 8;
+    std::vector<uint8_t> a(n_bytes), b(n_bytes);
+    for (size_t i = 0; i < n_bytes; i++) {
+      a[i] = rng();
+      b[i] = rng();
+    }
+
+    size_t expected_count = 0;
+    std::vector<size_t> expected_set;
+    for (size_t i = 0; i < n_bits; i++) {
+      if (BitmapTest(&a[0], i)) {
+        expected_count++;
+        expected_set.push_back(i);
+      }
+    }
+    ASSERT_EQ(expected_count, BitmapCountSet(&a[0], n_bits));
+    std::vector<size_t> set;
+    BitmapForEachSetBit(&a[0], n_bits, [&](size_t i) { set.push_back(i); });
+    ASSERT_EQ(expected_set, set);
+
+    std::vector<uint8_t> anded(a), and_notted(a);
+    BitmapAnd(&anded[0], &b[0], n_bits);
+    BitmapAndNot(&and_notted[0], &b[0], n_bits);
+    for (size_t i = 0; i < n_bytes * 8; i++) {
+      bool in_a = BitmapTest(&a[0], i);
+      bool in_b = BitmapTest(&b[0], i);
+      ASSERT_EQ(i < n_bits ? in_a && in_b : in_a, BitmapTest(&anded[0], i)) << i;
+      ASSERT_EQ(i < n_bits ? in_a && !in_b : in_a, BitmapTest(&and_notted[0], i)) << i;
+    }
+  }
+}
+
 } // namespace kudu
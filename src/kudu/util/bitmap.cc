@@ -17,11 +17,95 @@
 #include <glog/logging.h>
 #include <string>
 
+#include "kudu/gutil/cpu.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/stringprintf.h"
 #include "kudu/util/bitmap.h"
 
 namespace kudu {
 
+namespace {
+
+struct AndOp {
+  uint8_t operator()(uint8_t a, uint8_t b) const { return a & b; }
+};
+
+struct AndNotOp {
+  uint8_t operator()(uint8_t a, uint8_t b) const { return a & ~b; }
+};
+
+// Combines 'src' into 'dst' bytewise with 'op', leaving the bits of 'dst'
+// past 'n_bits' unchanged. The loop over the whole bytes is left to the
+// compiler to vectorize for the instruction set of the calling kernel.
+template<class Op>
+ATTRIBUTE_ALWAYS_INLINE
+inline void BitmapCombine(uint8_t *dst, const uint8_t *src, size_t n_bits, Op op) {
+  const size_t n_whole_bytes = n_bits / 8;
+  for (size_t i = 0; i < n_whole_bytes; i++) {
+    dst[i] = op(dst[i], src[i]);
+  }
+  if (n_bits % 8 != 0) {
+    const uint8_t mask = (1 << (n_bits % 8)) - 1;
+    const uint8_t combined = op(dst[n_whole_bytes], src[n_whole_bytes]);
+    dst[n_whole_bytes] = (dst[n_whole_bytes] & ~mask) | (combined & mask);
+  }
+}
+
+template<class Op>
+void BitmapCombineSSE4(uint8_t *dst, const uint8_t *src, size_t n_bits, Op op) {
+  BitmapCombine(dst, src, n_bits, op);
+}
+
+// The same kernel, compiled for AVX2. Only called when the CPU supports it.
+template<class Op>
+__attribute__((target("avx2")))
+void BitmapCombineAVX2(uint8_t *dst, const uint8_t *src, size_t n_bits, Op op) {
+  BitmapCombine(dst, src, n_bits, op);
+}
+
+bool CpuHasAVX2() {
+  static const bool has_avx2 = base::CPU().has_avx2();
+  return has_avx2;
+}
+
+template<class Op>
+void DispatchBitmapCombine(uint8_t *dst, const uint8_t *src, size_t n_bits, Op op) {
+  if (CpuHasAVX2()) {
+    BitmapCombineAVX2(dst, src, n_bits, op);
+  } else {
+    BitmapCombineSSE4(dst, src, n_bits, op);
+  }
+}
+
+} // anonymous namespace
+
+void BitmapAnd(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  DispatchBitmapCombine(dst, src, n_bits, AndOp());
+}
+
+void BitmapAndNot(uint8_t *dst, const uint8_t *src, size_t n_bits) {
+  DispatchBitmapCombine(dst, src, n_bits, AndNotOp());
+}
+
+size_t BitmapCountSet(const uint8_t *bitmap, size_t n_bits) {
+  // Kudu requires SSE4.2, so the popcnt instruction is always available.
+  size_t count = 0;
+  const size_t n_words = n_bits / 64;
+  for (size_t i = 0; i < n_words; i++) {
+    uint64_t word;
+    memcpy(&word, bitmap + i * 8, sizeof(word));
+    count += Bits::CountOnes64withPopcount(word);
+  }
+  const size_t rem = n_bits % 64;
+  if (rem != 0) {
+    uint64_t word = 0;
+    memcpy(&word, bitmap + n_words * 8, BitmapSize(rem));
+    word &= (1ULL << rem) - 1;
+    count += Bits::CountOnes64withPopcount(word);
+  }
+  return count;
+}
+
 void BitmapChangeBits(uint8_t *bitmap, size_t offset, size_t num_bits, bool value) {
   DCHECK_GT(num_bits, 0);
 
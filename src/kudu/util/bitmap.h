@@ -19,6 +19,7 @@
 #ifndef KUDU_UTIL_BITMAP_H
 #define KUDU_UTIL_BITMAP_H
 
+#include <string.h>
 #include <string>
 #include "kudu/gutil/bits.h"
 
@@ -58,6 +59,41 @@ inline void BitmapMergeOr(uint8_t *dst, const uint8_t *src, size_t n_bits) {
   }
 }
 
+// Bitwise operations over the first 'n_bits' bits of two bitmaps, storing the
+// result into 'dst'. The bits of 'dst' past 'n_bits' are left unchanged, so
+// 'src' may hold garbage there. These run on every batch of a scan, and use
+// AVX2 when the CPU supports it.
+//
+// dst &= src
+void BitmapAnd(uint8_t *dst, const uint8_t *src, size_t n_bits);
+// dst &= ~src
+void BitmapAndNot(uint8_t *dst, const uint8_t *src, size_t n_bits);
+
+// Return the number of set bits among the first 'n_bits' bits of 'bitmap'.
+size_t BitmapCountSet(const uint8_t *bitmap, size_t n_bits);
+
+// Call 'func' with the index of each set bit among the first 'n_bits' bits
+// of 'bitmap', in ascending order. The bitmap is read 64 bits at a time, so
+// that runs of unset bits cost little, and 'func' may clear the bits it's
+// called for.
+template<class F>
+inline void BitmapForEachSetBit(const uint8_t *bitmap, size_t n_bits, const F& func) {
+  for (size_t base = 0; base < n_bits; base += 64) {
+    uint64_t word = 0;
+    size_t rem = n_bits - base;
+    if (rem >= 64) {
+      memcpy(&word, bitmap + base / 8, sizeof(word));
+    } else {
+      memcpy(&word, bitmap + base / 8, BitmapSize(rem));
+      word &= (1ULL << rem) - 1;
+    }
+    while (word != 0) {
+      func(base + Bits::FindLSBSetNonZero64(word));
+      word &= word - 1;
+    }
+  }
+}
+
 // Set bits from offset to (offset + num_bits) to the specified value
 void BitmapChangeBits(uint8_t *bitmap, size_t offset, size_t num_bits, bool value);
 
@@ -65,6 +65,29 @@ TEST(BlockingQueueTest, TestBlockingDrainTo) {
   ASSERT_EQ(3, out[2]);
 }
 
+TEST(BlockingQueueTest, TestBlockingDrainToWithDeadline) {
+  BlockingQueue<int32_t> test_queue(3);
+  vector<int32_t> out;
+
+  // An empty queue times out without draining anything.
+  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(MonoDelta::FromMilliseconds(10));
+  ASSERT_TRUE(test_queue.BlockingDrainTo(&out, deadline));
+  ASSERT_TRUE(out.empty());
+  ASSERT_FALSE(MonoTime::Now(MonoTime::FINE).ComesBefore(deadline));
+
+  // Drained elements are appended to what is already there.
+  out.push_back(0);
+  ASSERT_EQ(test_queue.Put(1), QUEUE_SUCCESS);
+  deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(MonoDelta::FromSeconds(10));
+  ASSERT_TRUE(test_queue.BlockingDrainTo(&out, deadline));
+  ASSERT_EQ(vector<int32_t>({ 0, 1 }), out);
+
+  test_queue.Shutdown();
+  ASSERT_FALSE(test_queue.BlockingDrainTo(&out, deadline));
+}
+
 TEST(BlockingQueueTest, TestTooManyInsertions) {
   BlockingQueue<int32_t> test_queue(2);
   ASSERT_EQ(test_queue.Put(123), QUEUE_SUCCESS);
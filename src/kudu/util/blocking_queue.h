@@ -26,6 +26,7 @@
 #include "kudu/gutil/basictypes.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/condition_variable.h"
+#include "kudu/util/monotime.h"
 #include "kudu/util/mutex.h"
 
 namespace kudu {
@@ -121,6 +122,33 @@ class BlockingQueue {
     }
   }
 
+  // Like BlockingDrainTo() above, but waits for elements only until
+  // 'deadline', after which it returns true without appending anything.
+  // Returns false if the queue is empty and shut down.
+  bool BlockingDrainTo(std::vector<T>* out, const MonoTime& deadline) {
+    MutexLock l(lock_);
+    while (true) {
+      if (!list_.empty()) {
+        out->reserve(out->size() + list_.size());
+        for (const T& elt : list_) {
+          out->push_back(elt);
+          decrement_size_unlocked(elt);
+        }
+        list_.clear();
+        not_full_.Signal();
+        return true;
+      }
+      if (shutdown_) {
+        return false;
+      }
+      MonoTime now = MonoTime::Now(MonoTime::FINE);
+      if (!now.ComesBefore(deadline)) {
+        return true;
+      }
+      not_empty_.TimedWait(deadline.GetDeltaSince(now));
+    }
+  }
+
   // Attempts to put the given value in the queue.
   // Returns:
   //   QUEUE_SUCCESS: if successfully inserted
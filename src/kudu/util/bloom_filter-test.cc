@@ -84,4 +84,36 @@ TEST(TestBloomFilter, TestInsertAndProbe) {
   ASSERT_NEAR(fp_rate, expected_fp_rate, 0.20*expected_fp_rate);
 }
 
+TEST(TestBloomFilter, TestBlockedInsertAndProbe) {
+  int n_keys = 2000;
+  BloomFilterSizing sizing = BloomFilterSizing::ByCountAndFPRate(n_keys, 0.01);
+  sizing.set_layout(BLOCKED_BLOOM_LAYOUT);
+  BloomFilterBuilder bfb(sizing);
+  ASSERT_EQ(BLOCKED_BLOOM_LAYOUT, bfb.layout());
+  ASSERT_EQ(8, bfb.n_hashes());
+
+  AddRandomKeys(kRandomSeed, n_keys, &bfb);
+
+  // No false negatives.
+  BloomFilter bf(bfb.slice(), bfb.n_hashes(), BLOCKED_BLOOM_LAYOUT);
+  CheckRandomKeys(kRandomSeed, n_keys, bf);
+
+  uint32_t num_queries = 100000;
+  uint32_t num_positives = 0;
+  for (int i = 0; i < num_queries; i++) {
+    uint64_t key = random();
+    Slice key_slice(reinterpret_cast<const uint8_t *>(&key), sizeof(key));
+    BloomKeyProbe probe(key_slice);
+    if (bf.MayContainKey(probe)) {
+      num_positives++;
+    }
+  }
+  double fp_rate = static_cast<double>(num_positives) / static_cast<double>(num_queries);
+  LOG(INFO) << "FP rate: " << fp_rate << " (" << num_positives << "/" << num_queries << ")";
+
+  // For the same size, the blocked layout gives up some accuracy: with about
+  // 9.6 bits per key, expect roughly 1.6% rather than 1%.
+  ASSERT_LT(fp_rate, 0.025);
+}
+
 } // namespace kudu
@@ -24,6 +24,9 @@ namespace kudu {
 
 static double kNaturalLog2 = 0.69314;
 
+const int BloomFilter::kBucketWords;
+const int BloomFilter::kBucketBytes;
+
 static int ComputeOptimalHashCount(size_t n_bits, size_t elems) {
   int n_hashes = n_bits * kNaturalLog2 / elems;
   if (n_hashes < 1) n_hashes = 1;
@@ -58,7 +61,14 @@ BloomFilterBuilder::BloomFilterBuilder(const BloomFilterSizing &sizing)
     bitmap_(new uint8_t[sizing.n_bytes()]),
     n_hashes_(ComputeOptimalHashCount(n_bits_, sizing.expected_count())),
     expected_count_(sizing.expected_count()),
-    n_inserted_(0) {
+    n_inserted_(0),
+    layout_(sizing.layout()) {
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    // Any bytes past the last whole bucket are left unused.
+    CHECK_GE(sizing.n_bytes(), BloomFilter::kBucketBytes)
+      << "blocked bloom filters must hold at least one bucket";
+    n_hashes_ = BloomFilter::kBucketWords;
+  }
   Clear();
 }
 
@@ -72,13 +82,16 @@ double BloomFilterBuilder::false_positive_rate() const {
     << "expected_count_ not initialized: can't call this function on "
     << "a BloomFilter initialized from external data";
 
+  // This is the classic estimate. Blocked filters fare slightly worse for
+  // the same size, since keys don't spread evenly across buckets.
   return pow(1 - exp(-static_cast<double>(n_hashes_) * expected_count_ / n_bits_), n_hashes_);
 }
 
-BloomFilter::BloomFilter(const Slice &data, size_t n_hashes)
+BloomFilter::BloomFilter(const Slice &data, size_t n_hashes, BloomFilterLayout layout)
   : n_bits_(data.size() * 8),
     bitmap_(reinterpret_cast<const uint8_t *>(data.data())),
-    n_hashes_(n_hashes)
+    n_hashes_(n_hashes),
+    layout_(layout)
 {}
 
 
@@ -20,6 +20,7 @@
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/macros.h"
+#include "kudu/gutil/port.h"
 #include "kudu/util/bitmap.h"
 #include "kudu/util/slice.h"
 
@@ -81,6 +82,22 @@ class BloomKeyProbe {
   uint32_t h_2_;
 };
 
+// How the bits of a bloom filter are laid out.
+enum BloomFilterLayout {
+  // Each of the k hashes of a key selects a bit anywhere in the filter, so
+  // a probe touches up to k cache lines.
+  CLASSIC_BLOOM_LAYOUT,
+
+  // Split-block layout: the filter is divided into 256-bit buckets, each
+  // made of eight 32-bit words. One half of a key's hash selects a bucket,
+  // and the other sets or tests exactly one bit in each of the bucket's
+  // words. A probe therefore touches a single cache line, and the eight word
+  // tests are independent of each other, which vectorizes well.
+  //
+  // See "Cache-, Hash- and Space-Efficient Bloom Filters", Putze et al.
+  BLOCKED_BLOOM_LAYOUT
+};
+
 // Sizing parameters for the constructor to BloomFilterBuilder.
 // This is simply to provide a nicer API than a bunch of overloaded
 // constructors.
@@ -99,14 +116,21 @@ class BloomFilterSizing {
   size_t n_bytes() const { return n_bytes_; }
   size_t expected_count() const { return expected_count_; }
 
+  // The layout of filters built with these parameters. Defaults to
+  // CLASSIC_BLOOM_LAYOUT.
+  BloomFilterLayout layout() const { return layout_; }
+  void set_layout(BloomFilterLayout layout) { layout_ = layout; }
+
  private:
   BloomFilterSizing(size_t n_bytes, size_t expected_count) :
     n_bytes_(n_bytes),
-    expected_count_(expected_count)
+    expected_count_(expected_count),
+    layout_(CLASSIC_BLOOM_LAYOUT)
   {}
 
   size_t n_bytes_;
   size_t expected_count_;
+  BloomFilterLayout layout_;
 };
 
 
@@ -144,6 +168,8 @@ class BloomFilterBuilder {
   // in the bloom filter.
   size_t n_hashes() const { return n_hashes_; }
 
+  BloomFilterLayout layout() const { return layout_; }
+
   size_t expected_count() const { return expected_count_; }
 
   // Return the number of keys inserted.
@@ -163,25 +189,52 @@ class BloomFilterBuilder {
 
   // The number of elements inserted so far since the last Reset.
   size_t n_inserted_;
+
+  const BloomFilterLayout layout_;
 };
 
 
 // Wrapper around a byte array for reading it as a bloom filter.
 class BloomFilter {
  public:
-  BloomFilter(const Slice &data, size_t n_hashes);
+  BloomFilter(const Slice &data, size_t n_hashes,
+              BloomFilterLayout layout = CLASSIC_BLOOM_LAYOUT);
 
   // Return true if the filter may contain the given key.
   bool MayContainKey(const BloomKeyProbe &probe) const;
 
+  // Prefetch the parts of the bitmap that MayContainKey() will test for
+  // the given key. When checking many keys against the same filter, issuing
+  // the prefetches for a group of keys before testing any of them lets the
+  // cache misses overlap.
+  void PrefetchKey(const BloomKeyProbe &probe) const;
+
  private:
   friend class BloomFilterBuilder;
   static uint32_t PickBit(uint32_t hash, size_t n_bits);
 
+  // Helpers for BLOCKED_BLOOM_LAYOUT.
+  //
+  // The number of 32-bit words in each bucket, which is also the number of
+  // bits set per key.
+  static const int kBucketWords = 8;
+  static const int kBucketBytes = kBucketWords * sizeof(uint32_t);
+
+  // Return the byte offset of the bucket for 'probe' within a filter of
+  // 'n_bits' bits.
+  static size_t PickBucket(const BloomKeyProbe &probe, size_t n_bits);
+
+  // Compute the bit to set or test in each word of a key's bucket.
+  static void BucketMasks(const BloomKeyProbe &probe, uint32_t masks[kBucketWords]);
+
+  bool MayContainKeyBlocked(const BloomKeyProbe &probe) const;
+
   size_t n_bits_;
   const uint8_t *bitmap_;
 
   size_t n_hashes_;
+
+  BloomFilterLayout layout_;
 };
 
 
@@ -201,7 +254,40 @@ inline uint32_t BloomFilter::PickBit(uint32_t hash, size_t n_bits) {
   }
 }
 
+inline size_t BloomFilter::PickBucket(const BloomKeyProbe &probe, size_t n_bits) {
+  // Map the hash onto [0, n_buckets) by multiplication rather than modulo,
+  // which avoids a division.
+  uint64_t n_buckets = n_bits / (kBucketBytes * 8);
+  return ((static_cast<uint64_t>(probe.initial_hash()) * n_buckets) >> 32) * kBucketBytes;
+}
+
+inline void BloomFilter::BucketMasks(const BloomKeyProbe &probe,
+                                     uint32_t masks[kBucketWords]) {
+  // Odd constants used to derive one bit position per word from a single
+  // hash value, as in the Parquet and Impala split-block bloom filters.
+  static const uint32_t kSalts[kBucketWords] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U
+  };
+  uint32_t h = probe.MixHash(0);
+  for (int i = 0; i < kBucketWords; i++) {
+    masks[i] = 1U << ((h * kSalts[i]) >> 27);
+  }
+}
+
 inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    uint8_t *bucket = &bitmap_[BloomFilter::PickBucket(probe, n_bits_)];
+    uint32_t masks[BloomFilter::kBucketWords];
+    BloomFilter::BucketMasks(probe, masks);
+    for (int i = 0; i < BloomFilter::kBucketWords; i++) {
+      uint8_t *word = bucket + i * sizeof(uint32_t);
+      UNALIGNED_STORE32(word, UNALIGNED_LOAD32(word) | masks[i]);
+    }
+    n_inserted_++;
+    return;
+  }
+
   uint32_t h = probe.initial_hash();
   for (size_t i = 0; i < n_hashes_; i++) {
     uint32_t bitpos = BloomFilter::PickBit(h, n_bits_);
@@ -211,7 +297,38 @@ inline void BloomFilterBuilder::AddKey(const BloomKeyProbe &probe) {
   n_inserted_++;
 }
 
+inline void BloomFilter::PrefetchKey(const BloomKeyProbe &probe) const {
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    prefetch(reinterpret_cast<const char *>(&bitmap_[PickBucket(probe, n_bits_)]),
+             PREFETCH_HINT_T0);
+    return;
+  }
+  uint32_t h = probe.initial_hash();
+  for (size_t i = 0; i < n_hashes_; i++) {
+    uint32_t bitpos = PickBit(h, n_bits_);
+    prefetch(reinterpret_cast<const char *>(&bitmap_[bitpos >> 3]), PREFETCH_HINT_T0);
+    h = probe.MixHash(h);
+  }
+}
+
+inline bool BloomFilter::MayContainKeyBlocked(const BloomKeyProbe &probe) const {
+  const uint8_t *bucket = &bitmap_[PickBucket(probe, n_bits_)];
+  uint32_t masks[kBucketWords];
+  BucketMasks(probe, masks);
+
+  // Accumulate rather than branching per word, so that the compiler can
+  // test all of the words at once.
+  uint32_t missing = 0;
+  for (int i = 0; i < kBucketWords; i++) {
+    missing |= masks[i] & ~UNALIGNED_LOAD32(bucket + i * sizeof(uint32_t));
+  }
+  return missing == 0;
+}
+
 inline bool BloomFilter::MayContainKey(const BloomKeyProbe &probe) const {
+  if (layout_ == BLOCKED_BLOOM_LAYOUT) {
+    return MayContainKeyBlocked(probe);
+  }
   uint32_t h = probe.initial_hash();
 
   // Basic unrolling by 2s gives a small benefit here since the two bit positions
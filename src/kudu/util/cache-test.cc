@@ -9,10 +9,12 @@
 
 #include <vector>
 #include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
 #include "kudu/util/coding.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
 #include "kudu/util/test_util.h"
+#include "kudu/util/tiered_cache.h"
 
 #if defined(__linux__)
 DECLARE_string(nvm_cache_path);
@@ -228,4 +230,132 @@ TEST_P(CacheTest, NewId) {
   ASSERT_NE(a, b);
 }
 
+// Test that a segmented LRU cache keeps entries which were looked up while
+// entries which are only inserted, as by a large scan, flow through it.
+TEST(SLRUCacheTest, ScanResistance) {
+  const int kCapacity = 1600;
+  gscoped_ptr<Cache> cache(NewSLRUCache(DRAM_CACHE, kCapacity, "slru_cache_test"));
+  auto insert = [&](int key) {
+    string key_str = EncodeInt(key);
+    string val_str = EncodeInt(key);
+    Cache::PendingHandle* ph = CHECK_NOTNULL(cache->Allocate(key_str, val_str.size(), 1));
+    memcpy(cache->MutableValue(ph), val_str.data(), val_str.size());
+    cache->Release(cache->Insert(ph, nullptr));
+  };
+  auto lookup = [&](int key) {
+    Cache::Handle* h = cache->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE);
+    if (h == nullptr) return false;
+    cache->Release(h);
+    return true;
+  };
+
+  // Insert and look up a hot set of entries, promoting them.
+  const int kHotEntries = kCapacity / 10;
+  for (int i = 0; i < kHotEntries; i++) {
+    insert(i);
+    ASSERT_TRUE(lookup(i));
+  }
+
+  // "Scan" through many more entries than fit in the cache.
+  for (int i = 0; i < kCapacity * 10; i++) {
+    insert(kHotEntries + i);
+  }
+
+  for (int i = 0; i < kHotEntries; i++) {
+    ASSERT_TRUE(lookup(i)) << "hot entry " << i << " was evicted";
+  }
+}
+
+// Test the basic operations of a CLOCK cache, and that it gives entries
+// which were looked up a second chance before evicting them.
+TEST(ClockCacheTest, SecondChance) {
+  const int kCapacity = 1 << 16;
+  gscoped_ptr<Cache> cache(NewClockCache(DRAM_CACHE, kCapacity, "clock_cache_test"));
+  auto insert = [&](int key, int value) {
+    string key_str = EncodeInt(key);
+    string val_str = EncodeInt(value);
+    Cache::PendingHandle* ph = CHECK_NOTNULL(cache->Allocate(key_str, val_str.size(), 1));
+    memcpy(cache->MutableValue(ph), val_str.data(), val_str.size());
+    cache->Release(cache->Insert(ph, nullptr));
+  };
+  auto lookup = [&](int key) {
+    Cache::Handle* h = cache->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE);
+    const int r = (h == nullptr) ? -1 : DecodeInt(cache->Value(h));
+    if (h != nullptr) {
+      cache->Release(h);
+    }
+    return r;
+  };
+
+  ASSERT_EQ(-1, lookup(100));
+  insert(100, 101);
+  ASSERT_EQ(101, lookup(100));
+  insert(100, 102);
+  ASSERT_EQ(102, lookup(100));
+  cache->Erase(100);
+  ASSERT_EQ(-1, lookup(100));
+
+  // Keep looking up a hot entry while inserting many more entries than fit.
+  insert(1, 1);
+  for (int i = 0; i < kCapacity * 4; i++) {
+    ASSERT_EQ(1, lookup(1));
+    insert(1000 + i, i);
+  }
+  ASSERT_EQ(-1, lookup(1000));
+
+  // Pinned entries remain readable after being evicted.
+  Cache::Handle* h = cache->Lookup(EncodeInt(1), Cache::EXPECT_IN_CACHE);
+  ASSERT_TRUE(h != nullptr);
+  cache->Erase(1);
+  ASSERT_EQ(1, DecodeInt(cache->Value(h)));
+  cache->Release(h);
+}
+
+// Test that a tiered cache demotes entries evicted from its upper tier, and
+// promotes them back when they are looked up.
+TEST(TieredCacheTest, DemoteAndPromote) {
+  const int kUpperCapacity = 16 * 16;
+  const int kLowerCapacity = 16 * 16 * 16;
+  gscoped_ptr<Cache> cache(NewTieredCache(
+      NewLRUCache(DRAM_CACHE, kUpperCapacity, "tiered_cache_test_upper"),
+      NewLRUCache(DRAM_CACHE, kLowerCapacity, "tiered_cache_test_lower")));
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  cache->SetMetrics(entity);
+
+  auto insert = [&](int key) {
+    string key_str = EncodeInt(key);
+    string val_str = EncodeInt(key);
+    Cache::PendingHandle* ph = CHECK_NOTNULL(cache->Allocate(key_str, val_str.size(),
+                                                             val_str.size()));
+    memcpy(cache->MutableValue(ph), val_str.data(), val_str.size());
+    cache->Release(cache->Insert(ph, nullptr));
+  };
+  auto lookup = [&](int key) {
+    Cache::Handle* h = cache->Lookup(EncodeInt(key), Cache::EXPECT_IN_CACHE);
+    const int r = (h == nullptr) ? -1 : DecodeInt(cache->Value(h));
+    if (h != nullptr) {
+      cache->Release(h);
+    }
+    return r;
+  };
+
+  // Insert more entries than fit in the upper tier, but few enough to fit in
+  // both tiers. Every entry remains in the cache.
+  const int kNumEntries = (kUpperCapacity + kLowerCapacity) / 4 / 2;
+  for (int i = 0; i < kNumEntries; i++) {
+    insert(i);
+  }
+  TieredCacheMetrics metrics(entity);
+  ASSERT_GT(metrics.lower_tier_demotions->value(), 0);
+  for (int i = 0; i < kNumEntries; i++) {
+    ASSERT_EQ(i, lookup(i));
+  }
+  ASSERT_GT(metrics.lower_tier_promotions->value(), 0);
+
+  // Erased entries leave both tiers.
+  cache->Erase(EncodeInt(0));
+  ASSERT_EQ(-1, lookup(0));
+}
+
 }  // namespace kudu
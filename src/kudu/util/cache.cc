@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
 #include <glog/logging.h>
 #include <memory>
 #include <mutex>
@@ -10,9 +11,11 @@
 #include <vector>
 
 #include "kudu/gutil/atomic_refcount.h"
+#include "kudu/gutil/bits.h"
 #include "kudu/gutil/hash/city.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/alignment.h"
 #include "kudu/util/atomic.h"
 #include "kudu/util/cache.h"
@@ -53,6 +56,8 @@ struct LRUHandle {
   uint32_t val_length;
   Atomic32 refs;
   uint32_t hash;      // Hash of key(); used for fast sharding and comparisons
+  bool in_protected;  // Whether the entry is in the protected segment (SLRU only)
+  Atomic32 referenced;  // CLOCK reference bit (ClockCache only)
 
   // The storage for the key/value pair itself. The data is stored as:
   //   [key bytes ...] [padding up to 8-byte boundary] [value bytes ...]
@@ -171,6 +176,10 @@ class LRUCache {
   // Separate from constructor so caller can easily make an array of LRUCache
   void SetCapacity(size_t capacity) { capacity_ = capacity; }
 
+  // Makes this a segmented LRU cache whose protected segment may hold up to
+  // 'capacity' of the entries. See NewSLRUCache().
+  void SetProtectedCapacity(size_t capacity) { protected_capacity_ = capacity; }
+
   void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
 
   Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
@@ -178,10 +187,18 @@ class LRUCache {
   Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
   void Release(Cache::Handle* handle);
   void Erase(const Slice& key, uint32_t hash);
+  // Appends up to 'max_entries' entries, most recently used first.
+  void ListEntries(size_t max_entries, vector<Cache::EntryInfo>* entries);
 
  private:
   void LRU_Remove(LRUHandle* e);
-  void LRU_Append(LRUHandle* e);
+  // Make 'e' the newest entry of the list headed by 'list'.
+  void LRU_Append(LRUHandle* list, LRUHandle* e);
+  // Move a looked-up entry to the newest end of the protected segment, if the
+  // cache is segmented, or of the LRU list otherwise.
+  void LRU_Touch(LRUHandle* e);
+  // Returns the entry which should be evicted next, or NULL if empty.
+  LRUHandle* NextToEvict();
   // Just reduce the reference count by 1.
   // Return true if last reference
   bool Unref(LRUHandle* e);
@@ -191,14 +208,24 @@ class LRUCache {
   // Initialized before use.
   size_t capacity_;
 
+  // If non-zero, entries which are looked up after being inserted are moved
+  // to a protected segment of up to this size, which is only evicted from
+  // once the rest of the cache is empty. Initialized before use.
+  size_t protected_capacity_;
+
   // mutex_ protects the following state.
   MutexType mutex_;
   size_t usage_;
+  size_t protected_usage_;
 
-  // Dummy head of LRU list.
+  // Dummy head of LRU list. For a segmented cache, this is the probationary
+  // segment.
   // lru.prev is newest entry, lru.next is oldest entry.
   LRUHandle lru_;
 
+  // Dummy head of the protected segment's LRU list.
+  LRUHandle protected_lru_;
+
   HandleTable table_;
 
   MemTracker* mem_tracker_;
@@ -207,22 +234,28 @@ class LRUCache {
 };
 
 LRUCache::LRUCache(MemTracker* tracker)
- : usage_(0),
+ : protected_capacity_(0),
+   usage_(0),
+   protected_usage_(0),
    mem_tracker_(tracker),
    metrics_(nullptr) {
-  // Make empty circular linked list
+  // Make empty circular linked lists
   lru_.next = &lru_;
   lru_.prev = &lru_;
+  protected_lru_.next = &protected_lru_;
+  protected_lru_.prev = &protected_lru_;
 }
 
 LRUCache::~LRUCache() {
-  for (LRUHandle* e = lru_.next; e != &lru_; ) {
-    LRUHandle* next = e->next;
-    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
-    if (Unref(e)) {
-      FreeEntry(e);
+  for (LRUHandle* list : { &lru_, &protected_lru_ }) {
+    for (LRUHandle* e = list->next; e != list; ) {
+      LRUHandle* next = e->next;
+      DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+      if (Unref(e)) {
+        FreeEntry(e);
+      }
+      e = next;
     }
-    e = next;
   }
 }
 
@@ -248,15 +281,50 @@ void LRUCache::LRU_Remove(LRUHandle* e) {
   e->next->prev = e->prev;
   e->prev->next = e->next;
   usage_ -= e->charge;
+  if (e->in_protected) {
+    protected_usage_ -= e->charge;
+  }
 }
 
-void LRUCache::LRU_Append(LRUHandle* e) {
-  // Make "e" newest entry by inserting just before lru_
-  e->next = &lru_;
-  e->prev = lru_.prev;
+void LRUCache::LRU_Append(LRUHandle* list, LRUHandle* e) {
+  // Make "e" newest entry by inserting just before the list head
+  e->next = list;
+  e->prev = list->prev;
   e->prev->next = e;
   e->next->prev = e;
   usage_ += e->charge;
+  e->in_protected = (list == &protected_lru_);
+  if (e->in_protected) {
+    protected_usage_ += e->charge;
+  }
+}
+
+void LRUCache::LRU_Touch(LRUHandle* e) {
+  LRU_Remove(e);
+  if (protected_capacity_ == 0) {
+    LRU_Append(&lru_, e);
+    return;
+  }
+
+  // Promote the entry, demoting the oldest protected entries back to the
+  // probationary segment to make room for it. A scan which touches each
+  // block once can therefore only evict other probationary entries.
+  LRU_Append(&protected_lru_, e);
+  while (protected_usage_ > protected_capacity_ && protected_lru_.next != e) {
+    LRUHandle* demoted = protected_lru_.next;
+    LRU_Remove(demoted);
+    LRU_Append(&lru_, demoted);
+  }
+}
+
+LRUHandle* LRUCache::NextToEvict() {
+  if (lru_.next != &lru_) {
+    return lru_.next;
+  }
+  if (protected_lru_.next != &protected_lru_) {
+    return protected_lru_.next;
+  }
+  return nullptr;
 }
 
 Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
@@ -266,8 +334,7 @@ Cache::Handle* LRUCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
     e = table_.Lookup(key, hash);
     if (e != nullptr) {
       base::RefCountInc(&e->refs);
-      LRU_Remove(e);
-      LRU_Append(e);
+      LRU_Touch(e);
     }
   }
 
@@ -317,7 +384,7 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
   {
     std::lock_guard<MutexType> l(mutex_);
 
-    LRU_Append(e);
+    LRU_Append(&lru_, e);
 
     LRUHandle* old = table_.Insert(e);
     if (old != nullptr) {
@@ -328,8 +395,9 @@ Cache::Handle* LRUCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_
       }
     }
 
-    while (usage_ > capacity_ && lru_.next != &lru_) {
-      LRUHandle* old = lru_.next;
+    while (usage_ > capacity_) {
+      LRUHandle* old = NextToEvict();
+      if (old == nullptr) break;
       LRU_Remove(old);
       table_.Remove(old->key(), old->hash);
       if (Unref(old)) {
@@ -368,14 +436,274 @@ void LRUCache::Erase(const Slice& key, uint32_t hash) {
   }
 }
 
+// CLOCK cache implementation
+
+// A single shard of a sharded CLOCK cache.
+//
+// Unlike LRUCache, a lookup does not reorder any list: it only sets the
+// entry's reference bit, which the clock hand clears as it sweeps the entries
+// looking for one to evict. Lookups can therefore share a per-CPU reader lock,
+// and concurrent lookups of hot entries don't contend with each other.
+class ClockCache {
+ public:
+  explicit ClockCache(MemTracker* tracker);
+  ~ClockCache();
+
+  // Separate from constructor so caller can easily make an array of ClockCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  void SetMetrics(CacheMetrics* metrics) { metrics_ = metrics; }
+
+  Cache::Handle* Insert(LRUHandle* handle, Cache::EvictionCallback* eviction_callback);
+  // Like Cache::Lookup, but with an extra "hash" parameter.
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash, bool caching);
+  void Release(Cache::Handle* handle);
+  void Erase(const Slice& key, uint32_t hash);
+  // Appends up to 'max_entries' entries, referenced ones first.
+  void ListEntries(size_t max_entries, vector<Cache::EntryInfo>* entries);
+
+ private:
+  void Clock_Remove(LRUHandle* e);
+  // Insert 'e' just behind the clock hand, so that it is swept last.
+  void Clock_Insert(LRUHandle* e);
+  // Just reduce the reference count by 1.
+  // Return true if last reference
+  bool Unref(LRUHandle* e);
+  // Call the user's eviction callback, if it exists, and free the entry.
+  void FreeEntry(LRUHandle* e);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // Held in shared mode by lookups, and in exclusive mode when the entries
+  // or the clock ring are modified. It protects the following state.
+  percpu_rwlock lock_;
+  size_t usage_;
+
+  // Dummy head of the circular list of entries swept by the clock hand.
+  LRUHandle ring_;
+
+  // The next entry to be swept, or &ring_.
+  LRUHandle* hand_;
+
+  HandleTable table_;
+
+  MemTracker* mem_tracker_;
+
+  CacheMetrics* metrics_;
+};
+
+ClockCache::ClockCache(MemTracker* tracker)
+ : usage_(0),
+   hand_(&ring_),
+   mem_tracker_(tracker),
+   metrics_(nullptr) {
+  // Make empty circular linked list
+  ring_.next = &ring_;
+  ring_.prev = &ring_;
+}
+
+ClockCache::~ClockCache() {
+  for (LRUHandle* e = ring_.next; e != &ring_; ) {
+    LRUHandle* next = e->next;
+    DCHECK_EQ(e->refs, 1);  // Error if caller has an unreleased handle
+    if (Unref(e)) {
+      FreeEntry(e);
+    }
+    e = next;
+  }
+}
+
+bool ClockCache::Unref(LRUHandle* e) {
+  DCHECK_GT(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  return !base::RefCountDec(&e->refs);
+}
+
+void ClockCache::FreeEntry(LRUHandle* e) {
+  DCHECK_EQ(ANNOTATE_UNPROTECTED_READ(e->refs), 0);
+  if (e->eviction_callback) {
+    e->eviction_callback->EvictedEntry(e->key(), e->value());
+  }
+  mem_tracker_->Release(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->DecrementBy(e->charge);
+    metrics_->evictions->Increment();
+  }
+  delete [] e;
+}
+
+void ClockCache::Clock_Remove(LRUHandle* e) {
+  if (hand_ == e) {
+    hand_ = e->next;
+  }
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+  usage_ -= e->charge;
+}
+
+void ClockCache::Clock_Insert(LRUHandle* e) {
+  e->next = hand_;
+  e->prev = hand_->prev;
+  e->prev->next = e;
+  e->next->prev = e;
+  usage_ += e->charge;
+}
+
+Cache::Handle* ClockCache::Lookup(const Slice& key, uint32_t hash, bool caching) {
+  LRUHandle* e;
+  {
+    shared_lock<rw_spinlock> l(lock_.get_lock());
+    e = table_.Lookup(key, hash);
+    if (e != nullptr) {
+      base::RefCountInc(&e->refs);
+      // Avoid dirtying the cache line of an entry which is already marked.
+      if (!base::subtle::NoBarrier_Load(&e->referenced)) {
+        base::subtle::NoBarrier_Store(&e->referenced, 1);
+      }
+    }
+  }
+
+  // Do the metrics outside of the lock.
+  if (metrics_) {
+    metrics_->lookups->Increment();
+    bool was_hit = (e != nullptr);
+    if (was_hit) {
+      if (caching) {
+        metrics_->cache_hits_caching->Increment();
+      } else {
+        metrics_->cache_hits->Increment();
+      }
+    } else {
+      if (caching) {
+        metrics_->cache_misses_caching->Increment();
+      } else {
+        metrics_->cache_misses->Increment();
+      }
+    }
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Release(Cache::Handle* handle) {
+  LRUHandle* e = reinterpret_cast<LRUHandle*>(handle);
+  bool last_reference = Unref(e);
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
+Cache::Handle* ClockCache::Insert(LRUHandle* e, Cache::EvictionCallback *eviction_callback) {
+  // Set the remaining LRUHandle members which were not already allocated during
+  // Allocate().
+  e->eviction_callback = eviction_callback;
+  e->refs = 2;  // One from ClockCache, one for the returned handle
+  e->referenced = 0;
+  mem_tracker_->Consume(e->charge);
+  if (PREDICT_TRUE(metrics_)) {
+    metrics_->cache_usage->IncrementBy(e->charge);
+    metrics_->inserts->Increment();
+  }
+
+  LRUHandle* to_remove_head = nullptr;
+  {
+    std::lock_guard<percpu_rwlock> l(lock_);
+
+    LRUHandle* old = table_.Insert(e);
+    if (old != nullptr) {
+      Clock_Remove(old);
+      if (Unref(old)) {
+        old->next = to_remove_head;
+        to_remove_head = old;
+      }
+    }
+
+    // Sweep the clock hand, giving a second chance to each entry which was
+    // referenced since it was last swept. The new entry is swept last.
+    Clock_Insert(e);
+    while (usage_ > capacity_ && ring_.next != &ring_) {
+      if (hand_ == &ring_) {
+        hand_ = ring_.next;
+      }
+      LRUHandle* victim = hand_;
+      if (base::subtle::NoBarrier_Load(&victim->referenced)) {
+        base::subtle::NoBarrier_Store(&victim->referenced, 0);
+        hand_ = victim->next;
+        continue;
+      }
+      Clock_Remove(victim);
+      table_.Remove(victim->key(), victim->hash);
+      if (Unref(victim)) {
+        victim->next = to_remove_head;
+        to_remove_head = victim;
+      }
+    }
+  }
+
+  // we free the entries here outside of mutex for
+  // performance reasons
+  while (to_remove_head != nullptr) {
+    LRUHandle* next = to_remove_head->next;
+    FreeEntry(to_remove_head);
+    to_remove_head = next;
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void ClockCache::Erase(const Slice& key, uint32_t hash) {
+  LRUHandle* e;
+  bool last_reference = false;
+  {
+    std::lock_guard<percpu_rwlock> l(lock_);
+    e = table_.Remove(key, hash);
+    if (e != nullptr) {
+      Clock_Remove(e);
+      last_reference = Unref(e);
+    }
+  }
+  // lock not held here
+  // last_reference will only be true if e != NULL
+  if (last_reference) {
+    FreeEntry(e);
+  }
+}
+
+void LRUCache::ListEntries(size_t max_entries, vector<Cache::EntryInfo>* entries) {
+  std::lock_guard<MutexType> l(mutex_);
+  size_t n = 0;
+  for (LRUHandle* list : { &protected_lru_, &lru_ }) {
+    for (LRUHandle* e = list->prev; e != list && n < max_entries; e = e->prev, n++) {
+      entries->push_back({ e->key().ToString(), e->val_length });
+    }
+  }
+}
+
+void ClockCache::ListEntries(size_t max_entries, vector<Cache::EntryInfo>* entries) {
+  shared_lock<rw_spinlock> l(lock_.get_lock());
+  size_t n = 0;
+  for (bool referenced : { true, false }) {
+    for (LRUHandle* e = ring_.next; e != &ring_ && n < max_entries; e = e->next) {
+      if (static_cast<bool>(base::subtle::NoBarrier_Load(&e->referenced)) == referenced) {
+        entries->push_back({ e->key().ToString(), e->val_length });
+        n++;
+      }
+    }
+  }
+}
+
 static const int kNumShardBits = 4;
-static const int kNumShards = 1 << kNumShardBits;
 
-class ShardedLRUCache : public Cache {
+// A cache which partitions its entries between a power-of-two number of
+// independently locked shards, by the hash of their keys. 'ShardType' is either
+// LRUCache or ClockCache.
+template<class ShardType>
+class ShardedCache : public Cache {
  private:
   shared_ptr<MemTracker> mem_tracker_;
   gscoped_ptr<CacheMetrics> metrics_;
-  vector<LRUCache*> shards_;
+  vector<ShardType*> shards_;
+  const int num_shard_bits_;
   MutexType id_mutex_;
   uint64_t last_id_;
 
@@ -384,31 +712,48 @@ class ShardedLRUCache : public Cache {
       reinterpret_cast<const char *>(s.data()), s.size());
   }
 
-  static uint32_t Shard(uint32_t hash) {
-    return hash >> (32 - kNumShardBits);
+  uint32_t Shard(uint32_t hash) const {
+    return hash >> (32 - num_shard_bits_);
   }
 
  public:
-  explicit ShardedLRUCache(size_t capacity, const string& id)
-      : last_id_(0) {
+  // 'tracker_suffix' names the cache's MemTracker, along with 'id'.
+  ShardedCache(size_t capacity, const string& id, int num_shard_bits,
+               const string& tracker_suffix)
+      : num_shard_bits_(num_shard_bits),
+        last_id_(0) {
+    DCHECK_GT(num_shard_bits, 0);
+    DCHECK_LT(num_shard_bits, 32);
     // A cache is often a singleton, so:
     // 1. We reuse its MemTracker if one already exists, and
     // 2. It is directly parented to the root MemTracker.
     mem_tracker_ = MemTracker::FindOrCreateTracker(
-        -1, strings::Substitute("$0-sharded_lru_cache", id));
+        -1, strings::Substitute("$0-$1", id, tracker_suffix));
 
-    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
-    for (int s = 0; s < kNumShards; s++) {
-      gscoped_ptr<LRUCache> shard(new LRUCache(mem_tracker_.get()));
+    const int num_shards = 1 << num_shard_bits;
+    const size_t per_shard = (capacity + (num_shards - 1)) / num_shards;
+    for (int s = 0; s < num_shards; s++) {
+      gscoped_ptr<ShardType> shard(new ShardType(mem_tracker_.get()));
       shard->SetCapacity(per_shard);
       shards_.push_back(shard.release());
     }
   }
 
-  virtual ~ShardedLRUCache() {
+  virtual ~ShardedCache() {
     STLDeleteElements(&shards_);
   }
 
+  // Makes each shard a segmented LRU cache whose protected segment holds up
+  // to 'ratio' of its capacity. Only valid for LRUCache shards, before use.
+  void SetProtectedRatio(size_t capacity, double ratio) {
+    DCHECK_GE(ratio, 0);
+    DCHECK_LT(ratio, 1);
+    const size_t per_shard = (capacity + (shards_.size() - 1)) / shards_.size();
+    for (ShardType* shard : shards_) {
+      shard->SetProtectedCapacity(per_shard * ratio);
+    }
+  }
+
   virtual Handle* Insert(PendingHandle* handle,
                          Cache::EvictionCallback* eviction_callback) OVERRIDE {
     LRUHandle* h = reinterpret_cast<LRUHandle*>(DCHECK_NOTNULL(handle));
@@ -436,11 +781,22 @@ class ShardedLRUCache : public Cache {
 
   virtual void SetMetrics(const scoped_refptr<MetricEntity>& entity) OVERRIDE {
     metrics_.reset(new CacheMetrics(entity));
-    for (LRUCache* cache : shards_) {
+    for (ShardType* cache : shards_) {
       cache->SetMetrics(metrics_.get());
     }
   }
 
+  virtual void ListEntries(size_t max_entries, vector<EntryInfo>* entries) OVERRIDE {
+    // Entries are distributed evenly between the shards.
+    const size_t per_shard = (max_entries + (shards_.size() - 1)) / shards_.size();
+    for (ShardType* cache : shards_) {
+      cache->ListEntries(per_shard, entries);
+    }
+    if (entries->size() > max_entries) {
+      entries->resize(max_entries);
+    }
+  }
+
   virtual PendingHandle* Allocate(Slice key, int val_len, int charge) OVERRIDE {
     int key_len = key.size();
     DCHECK_GE(key_len, 0);
@@ -476,7 +832,7 @@ class ShardedLRUCache : public Cache {
 Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   switch (type) {
     case DRAM_CACHE:
-      return new ShardedLRUCache(capacity, id);
+      return new ShardedCache<LRUCache>(capacity, id, kNumShardBits, "sharded_lru_cache");
 #if !defined(__APPLE__)
     case NVM_CACHE:
       return NewLRUNvmCache(capacity, id);
@@ -486,4 +842,30 @@ Cache* NewLRUCache(CacheType type, size_t capacity, const string& id) {
   }
 }
 
+Cache* NewSLRUCache(CacheType type, size_t capacity, const string& id) {
+  // The segment sizes used by the original SLRU papers.
+  static const double kProtectedRatio = 0.8;
+  switch (type) {
+    case DRAM_CACHE: {
+      auto cache = new ShardedCache<LRUCache>(capacity, id, kNumShardBits, "sharded_lru_cache");
+      cache->SetProtectedRatio(capacity, kProtectedRatio);
+      return cache;
+    }
+    default:
+      LOG(FATAL) << "Unsupported SLRU cache type: " << type;
+  }
+}
+
+Cache* NewClockCache(CacheType type, size_t capacity, const string& id) {
+  // Use at least one shard per CPU, so that inserts on different CPUs rarely
+  // contend for the same shard.
+  int num_shard_bits = std::max(kNumShardBits, Bits::Log2Ceiling(base::NumCPUs()));
+  switch (type) {
+    case DRAM_CACHE:
+      return new ShardedCache<ClockCache>(capacity, id, num_shard_bits, "sharded_clock_cache");
+    default:
+      LOG(FATAL) << "Unsupported CLOCK cache type: " << type;
+  }
+}
+
 }  // namespace kudu
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -40,6 +41,25 @@ enum CacheType {
 // of Cache uses a least-recently-used eviction policy.
 Cache* NewLRUCache(CacheType type, size_t capacity, const std::string& id);
 
+// Create a new cache with a fixed size capacity which uses a scan-resistant
+// segmented LRU eviction policy. Entries are inserted into a probationary
+// segment, and promoted to a protected segment when they are looked up again.
+// Entries are only evicted from the protected segment once the probationary
+// one is empty, so a large scan which reads each entry once does not flush
+// the frequently used entries out of the cache.
+//
+// Only DRAM_CACHE is supported.
+Cache* NewSLRUCache(CacheType type, size_t capacity, const std::string& id);
+
+// Create a new cache with a fixed size capacity which uses the CLOCK
+// approximation of a least-recently-used eviction policy. A lookup only sets
+// a reference bit on the entry under a per-CPU reader lock, so concurrent
+// lookups do not contend with each other. The cache has at least one shard
+// per CPU, to reduce contention between inserts.
+//
+// Only DRAM_CACHE is supported.
+Cache* NewClockCache(CacheType type, size_t capacity, const std::string& id);
+
 class Cache {
  public:
   // Callback interface which is called when an entry is evicted from the
@@ -101,6 +121,18 @@ class Cache {
   // Pass a metric entity in order to start recoding metrics.
   virtual void SetMetrics(const scoped_refptr<MetricEntity>& metric_entity) = 0;
 
+  // The key and value size of an entry in the cache.
+  struct EntryInfo {
+    std::string key;
+    size_t value_size;
+  };
+
+  // Appends up to 'max_entries' of the entries in the cache to 'entries',
+  // preferring recently used entries. This takes the cache's locks, so it
+  // should be called infrequently. Caches which can't list their entries
+  // append nothing.
+  virtual void ListEntries(size_t max_entries, std::vector<EntryInfo>* entries) {}
+
   // ------------------------------------------------------------
   // Insertion path
   // ------------------------------------------------------------
@@ -49,6 +49,20 @@ METRIC_DEFINE_gauge_uint64(server, block_cache_usage, "Block Cache Memory Usage"
                            kudu::MetricUnit::kBytes,
                            "Memory consumed by the block cache");
 
+METRIC_DEFINE_counter(server, block_cache_lower_tier_demotions,
+                      "Block Cache Lower Tier Demotions", kudu::MetricUnit::kBlocks,
+                      "Number of blocks evicted from the upper tier of the cache, "
+                      "such as DRAM, and demoted into its lower tier, such as NVM");
+METRIC_DEFINE_counter(server, block_cache_lower_tier_promotions,
+                      "Block Cache Lower Tier Promotions", kudu::MetricUnit::kBlocks,
+                      "Number of lookups that missed the upper tier of the cache but "
+                      "found a block in its lower tier, promoting it");
+
+METRIC_DEFINE_gauge_uint64(server, block_cache_lower_tier_usage,
+                           "Block Cache Lower Tier Usage",
+                           kudu::MetricUnit::kBytes,
+                           "Size of the blocks held in the lower tier of the block cache");
+
 namespace kudu {
 
 #define MINIT(member, x) member(METRIC_##x.Instantiate(entity))
@@ -63,6 +77,12 @@ CacheMetrics::CacheMetrics(const scoped_refptr<MetricEntity>& entity)
     MINIT(cache_misses_caching, block_cache_misses_caching),
     GINIT(cache_usage, block_cache_usage) {
 }
+
+TieredCacheMetrics::TieredCacheMetrics(const scoped_refptr<MetricEntity>& entity)
+  : MINIT(lower_tier_demotions, block_cache_lower_tier_demotions),
+    MINIT(lower_tier_promotions, block_cache_lower_tier_promotions),
+    GINIT(lower_tier_usage, block_cache_lower_tier_usage) {
+}
 #undef MINIT
 #undef GINIT
 
@@ -43,5 +43,15 @@ struct CacheMetrics {
   scoped_refptr<AtomicGauge<uint64_t> > cache_usage;
 };
 
+// Metrics for the lower tier of a tiered cache. See NewTieredCache().
+struct TieredCacheMetrics {
+  explicit TieredCacheMetrics(const scoped_refptr<MetricEntity>& metric_entity);
+
+  scoped_refptr<Counter> lower_tier_demotions;
+  scoped_refptr<Counter> lower_tier_promotions;
+
+  scoped_refptr<AtomicGauge<uint64_t> > lower_tier_usage;
+};
+
 } // namespace kudu
 #endif /* KUDU_UTIL_CACHE_METRICS_H */
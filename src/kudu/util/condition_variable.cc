@@ -9,7 +9,9 @@
 #include <errno.h>
 #include <sys/time.h>
 
+#include "kudu/gutil/walltime.h"
 #include "kudu/util/monotime.h"
+#include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/thread_restrictions.h"
 
 namespace kudu {
@@ -63,8 +65,10 @@ void ConditionVariable::Wait() const {
 #if !defined(NDEBUG)
   user_lock_->CheckHeldAndUnmark();
 #endif
+  MicrosecondsInt64 start_time = GetMonoTimeMicros();
   int rv = pthread_cond_wait(&condition_, user_mutex_);
   DCHECK_EQ(0, rv);
+  SubmitLockContention(LockType::CONDITION_VARIABLE, GetMonoTimeMicros() - start_time);
 #if !defined(NDEBUG)
   user_lock_->CheckUnheldAndMark();
 #endif
@@ -86,6 +90,7 @@ bool ConditionVariable::TimedWait(const MonoDelta& max_time) const {
   user_lock_->CheckHeldAndUnmark();
 #endif
 
+  MicrosecondsInt64 start_time = GetMonoTimeMicros();
 #if defined(__APPLE__)
   int rv = pthread_cond_timedwait_relative_np(
       &condition_, user_mutex_, &relative_time);
@@ -121,6 +126,7 @@ bool ConditionVariable::TimedWait(const MonoDelta& max_time) const {
 
   DCHECK(rv == 0 || rv == ETIMEDOUT)
     << "unexpected pthread_cond_timedwait return value: " << rv;
+  SubmitLockContention(LockType::CONDITION_VARIABLE, GetMonoTimeMicros() - start_time);
 #if !defined(NDEBUG)
   user_lock_->CheckUnheldAndMark();
 #endif
@@ -19,6 +19,8 @@
 
 #include <glog/logging.h>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
@@ -35,7 +37,7 @@ namespace kudu {
 template<class State>
 class CowObject {
  public:
-  CowObject() {}
+  CowObject() : version_(0) {}
   ~CowObject() {}
 
   void ReadLock() const {
@@ -69,9 +71,17 @@ class CowObject {
     CHECK(dirty_state_);
     std::swap(state_, *dirty_state_);
     dirty_state_.reset();
+    version_.fetch_add(1, std::memory_order_release);
     lock_.CommitUnlock();
   }
 
+  // Return the number of mutations committed so far. May be called without
+  // holding any lock, e.g. to check whether something derived from an
+  // earlier state of the object is stale.
+  uint64_t version() const {
+    return version_.load(std::memory_order_acquire);
+  }
+
   // Return the current state, not reflecting any in-progress mutations.
   State& state() {
     DCHECK(lock_.HasReaders() || lock_.HasWriteLock());
@@ -100,6 +110,9 @@ class CowObject {
   State state_;
   gscoped_ptr<State> dirty_state_;
 
+  // Incremented each time a mutation is committed.
+  std::atomic<uint64_t> version_;
+
   DISALLOW_COPY_AND_ASSIGN(CowObject);
 };
 
@@ -153,6 +153,11 @@ class StackTrace {
 
   uint64_t HashCode() const;
 
+  // The number of frames collected, and the return address of each, from the
+  // innermost frame (0) outwards.
+  int num_frames() const { return num_frames_; }
+  void* frame(int i) const { return frames_[i]; }
+
  private:
   enum {
     // The maximum number of stack frames to collect.
@@ -20,12 +20,14 @@
 #include <string>
 #include <sys/types.h>
 
+#include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/strings/util.h"
+#include "kudu/util/countdown_latch.h"
 #include "kudu/util/env.h"
 #include "kudu/util/env_util.h"
 #include "kudu/util/malloc.h"
@@ -46,6 +48,8 @@
 #define FALLOC_FL_PUNCH_HOLE  0x02 /* de-allocates range */
 #endif
 
+DECLARE_int32(async_io_threads);
+
 namespace kudu {
 
 using std::shared_ptr;
@@ -452,6 +456,54 @@ TEST_F(TestEnv, TestReadFully) {
   ASSERT_STR_CONTAINS(status.ToString(), "EOF");
 }
 
+static void RecordStatusAndCountDown(CountDownLatch* latch, Status* out,
+                                     const Status& s) {
+  *out = s;
+  latch->CountDown();
+}
+
+TEST_F(TestEnv, TestReadAsync) {
+  FLAGS_async_io_threads = 4;
+  const string kTestPath = GetTestPath("test");
+  const int kFileSize = 64 * 1024;
+  const int kNumReads = 16;
+  const int kReadLength = kFileSize / kNumReads;
+  Env* env = Env::Default();
+
+  WriteTestFile(env, kTestPath, kFileSize);
+  ASSERT_NO_FATAL_FAILURE();
+
+  shared_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env_util::OpenFileForRandom(env, kTestPath, &raf));
+  ShortReadRandomAccessFile sr_raf(raf);
+
+  // Keep all of the reads in flight at once; each lands in its own slice of
+  // the scratch buffer despite the short reads.
+  gscoped_ptr<uint8_t[]> scratch(new uint8_t[kFileSize]);
+  vector<Slice> results(kNumReads);
+  vector<Status> statuses(kNumReads);
+  CountDownLatch latch(kNumReads);
+  for (int i = 0; i < kNumReads; i++) {
+    sr_raf.ReadAsync(i * kReadLength, kReadLength, &results[i],
+                     scratch.get() + i * kReadLength,
+                     Bind(&RecordStatusAndCountDown, &latch, &statuses[i]));
+  }
+  latch.Wait();
+  for (int i = 0; i < kNumReads; i++) {
+    ASSERT_OK(statuses[i]);
+    ASSERT_EQ(kReadLength, results[i].size());
+    ASSERT_NO_FATAL_FAILURE(VerifyTestData(results[i], i * kReadLength));
+  }
+
+  // A read past EOF fails through its callback.
+  CountDownLatch eof_latch(1);
+  Status eof_status;
+  sr_raf.ReadAsync(kFileSize - 100, 200, &results[0], scratch.get(),
+                   Bind(&RecordStatusAndCountDown, &eof_latch, &eof_status));
+  eof_latch.Wait();
+  ASSERT_TRUE(eof_status.IsIOError()) << eof_status.ToString();
+}
+
 TEST_F(TestEnv, TestAppendVector) {
   WritableFileOptions opts;
   LOG(INFO) << "Testing AppendVector() only, NO pre-allocation";
@@ -3,7 +3,14 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "kudu/util/env.h"
+
+#include <string.h>
+
+#include "kudu/gutil/callback.h"
+#include "kudu/util/async_io.h"
+#include "kudu/util/env_util.h"
 #include "kudu/util/faststring.h"
+#include "kudu/util/slice.h"
 
 namespace kudu {
 
@@ -16,12 +23,51 @@ SequentialFile::~SequentialFile() {
 RandomAccessFile::~RandomAccessFile() {
 }
 
+Status RandomAccessFile::ReadV(uint64_t offset, std::vector<Slice>* results) const {
+  for (Slice& result : *results) {
+    Slice data;
+    RETURN_NOT_OK(env_util::ReadFully(this, offset, result.size(), &data,
+                                      result.mutable_data()));
+    if (data.data() != result.data()) {
+      memcpy(result.mutable_data(), data.data(), data.size());
+    }
+    offset += result.size();
+  }
+  return Status::OK();
+}
+
+void RandomAccessFile::ReadAsync(uint64_t offset, size_t length, Slice* result,
+                                 uint8_t* scratch, const StatusCallback& callback) const {
+  SubmitAsyncIo([=]() {
+    callback.Run(env_util::ReadFully(this, offset, length, result, scratch));
+  });
+}
+
 WritableFile::~WritableFile() {
 }
 
 RWFile::~RWFile() {
 }
 
+Status RWFile::ReadV(uint64_t offset, std::vector<Slice>* results) const {
+  for (Slice& result : *results) {
+    Slice data;
+    RETURN_NOT_OK(Read(offset, result.size(), &data, result.mutable_data()));
+    if (data.data() != result.data()) {
+      memcpy(result.mutable_data(), data.data(), data.size());
+    }
+    offset += result.size();
+  }
+  return Status::OK();
+}
+
+void RWFile::ReadAsync(uint64_t offset, size_t length, Slice* result,
+                       uint8_t* scratch, const StatusCallback& callback) const {
+  SubmitAsyncIo([=]() {
+    callback.Run(Read(offset, length, result, scratch));
+  });
+}
+
 FileLock::~FileLock() {
 }
 
@@ -21,6 +21,7 @@
 #include "kudu/gutil/callback_forward.h"
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/util/status.h"
+#include "kudu/util/status_callback.h"
 
 namespace kudu {
 
@@ -322,9 +323,49 @@ class RandomAccessFile {
   virtual Status Read(uint64_t offset, size_t n, Slice* result,
                       uint8_t *scratch) const = 0;
 
+  // Reads consecutive bytes of the file starting at 'offset' into the
+  // buffers described by 'results': each slice must point at a buffer of
+  // its size, which is filled in place. Retries on short reads, so either
+  // every buffer is filled or an error is returned (possibly after some
+  // buffers have been modified).
+  //
+  // Safe for concurrent use by multiple threads.
+  virtual Status ReadV(uint64_t offset, std::vector<Slice>* results) const;
+
+  // Asynchronously reads exactly 'length' bytes starting at 'offset',
+  // retrying on short reads, and invokes 'callback' with the outcome. On
+  // success, '*result' references the data, which may be backed by
+  // 'scratch'. This file, 'result' and 'scratch' must remain live until
+  // 'callback' has been invoked.
+  //
+  // The read is run on the shared asynchronous I/O pool (see async_io.h),
+  // and 'callback' is invoked from the thread that performed the read,
+  // which may be the calling thread.
+  virtual void ReadAsync(uint64_t offset, size_t length, Slice* result,
+                         uint8_t* scratch, const StatusCallback& callback) const;
+
   // Returns the size of the file
   virtual Status Size(uint64_t *size) const = 0;
 
+  // Hints that the range [offset, offset + length) will be read soon, so
+  // that the OS may begin fetching it in the background. The call does not
+  // block on the read itself.
+  //
+  // The default implementation does nothing.
+  virtual Status Readahead(uint64_t offset, size_t length) const {
+    return Status::OK();
+  }
+
+  // Hints that the range [offset, offset + length) won't be read again
+  // soon, so that the OS may drop it from its page cache. Only clean pages
+  // are dropped. If 'length' is 0, the range extends to the end of the
+  // file.
+  //
+  // The default implementation does nothing.
+  virtual Status InvalidateCache(uint64_t offset, size_t length) const {
+    return Status::OK();
+  }
+
   // Returns the filename provided when the RandomAccessFile was constructed.
   virtual const std::string& filename() const = 0;
 
@@ -397,6 +438,12 @@ class WritableFile {
 
   virtual uint64_t Size() const = 0;
 
+  // See RandomAccessFile::InvalidateCache(). Call after Sync() for the hint
+  // to take effect on the data written.
+  virtual Status InvalidateCache(uint64_t offset, size_t length) {
+    return Status::OK();
+  }
+
   // Returns the filename provided when the WritableFile was constructed.
   virtual const std::string& filename() const = 0;
 
@@ -451,6 +498,24 @@ class RWFile {
   virtual Status Read(uint64_t offset, size_t length,
                       Slice* result, uint8_t* scratch) const = 0;
 
+  // Vectored version of Read(). See RandomAccessFile::ReadV().
+  virtual Status ReadV(uint64_t offset, std::vector<Slice>* results) const;
+
+  // Asynchronous version of Read(). See RandomAccessFile::ReadAsync() for
+  // the lifetime and threading requirements.
+  virtual void ReadAsync(uint64_t offset, size_t length, Slice* result,
+                         uint8_t* scratch, const StatusCallback& callback) const;
+
+  // See RandomAccessFile::Readahead().
+  virtual Status Readahead(uint64_t offset, size_t length) const {
+    return Status::OK();
+  }
+
+  // See RandomAccessFile::InvalidateCache().
+  virtual Status InvalidateCache(uint64_t offset, size_t length) const {
+    return Status::OK();
+  }
+
   // Writes 'data' to the file position given by 'offset'.
   virtual Status Write(uint64_t offset, const Slice& data) = 0;
 
@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
+#include <algorithm>
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -203,6 +204,91 @@ static Status DoSync(int fd, const string& filename) {
   return Status::OK();
 }
 
+static Status DoReadahead(int fd, const string& filename,
+                          uint64_t offset, size_t length) {
+  TRACE_COUNTER_INCREMENT("readahead_bytes", length);
+#if defined(__APPLE__)
+  struct radvisory advice;
+  advice.ra_offset = offset;
+  advice.ra_count = length;
+  if (fcntl(fd, F_RDADVISE, &advice) < 0) {
+    return IOError(filename, errno);
+  }
+#else
+  // posix_fadvise() returns the error number rather than setting errno.
+  int err = posix_fadvise(fd, offset, length, POSIX_FADV_WILLNEED);
+  if (err != 0) {
+    return IOError(filename, err);
+  }
+#endif
+  return Status::OK();
+}
+
+static Status DoInvalidateCache(int fd, const string& filename,
+                                uint64_t offset, size_t length) {
+#if defined(__APPLE__)
+  // OS X only supports bypassing the cache for the whole file (F_NOCACHE).
+  return Status::OK();
+#else
+  int err = posix_fadvise(fd, offset, length, POSIX_FADV_DONTNEED);
+  if (err != 0) {
+    return IOError(filename, err);
+  }
+  return Status::OK();
+#endif
+}
+
+// Fills the buffers described by 'results' with consecutive bytes of the
+// file beginning at 'offset', retrying on EINTR and short reads.
+static Status DoReadV(int fd, const string& filename, uint64_t offset,
+                      vector<Slice>* results) {
+  ThreadRestrictions::AssertIOAllowed();
+
+  size_t iov_size = results->size();
+  vector<struct iovec> iov(iov_size);
+  size_t bytes_req = 0;
+  for (size_t i = 0; i < iov_size; i++) {
+    Slice& result = (*results)[i];
+    bytes_req += result.size();
+    iov[i].iov_base = result.mutable_data();
+    iov[i].iov_len = result.size();
+  }
+
+  uint64_t cur_offset = offset;
+  size_t completed_iov = 0;
+  size_t rem = bytes_req;
+  while (rem > 0) {
+    int iov_count = std::min<size_t>(iov_size - completed_iov, IOV_MAX);
+    ssize_t r;
+    RETRY_ON_EINTR(r, preadv(fd, &iov[completed_iov], iov_count, cur_offset));
+    if (PREDICT_FALSE(r < 0)) {
+      return IOError(filename, errno);
+    }
+    if (PREDICT_FALSE(r == 0)) {
+      return Status::IOError(Substitute("EOF trying to read $0 bytes at offset $1",
+                                        bytes_req, offset));
+    }
+    rem -= r;
+    cur_offset += r;
+
+    // Skip past the buffers that were filled, and trim the one that was
+    // partially filled, if any.
+    while (r > 0) {
+      DCHECK_LT(completed_iov, iov_size);
+      struct iovec* cur = &iov[completed_iov];
+      if (r >= cur->iov_len) {
+        r -= cur->iov_len;
+        completed_iov++;
+      } else {
+        cur->iov_base = static_cast<uint8_t*>(cur->iov_base) + r;
+        cur->iov_len -= r;
+        r = 0;
+      }
+    }
+  }
+  return Status::OK();
+}
+
 static Status DoOpen(const string& filename, Env::CreateMode mode, int* fd) {
   ThreadRestrictions::AssertIOAllowed();
   int flags = O_RDWR;
@@ -301,6 +387,18 @@ class PosixRandomAccessFile: public RandomAccessFile {
     return Status::OK();
   }
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    return DoReadV(fd_, filename_, offset, results);
+  }
+
+  virtual Status Readahead(uint64_t offset, size_t length) const OVERRIDE {
+    return DoReadahead(fd_, filename_, offset, length);
+  }
+
+  virtual Status InvalidateCache(uint64_t offset, size_t length) const OVERRIDE {
+    return DoInvalidateCache(fd_, filename_, offset, length);
+  }
+
   virtual const string& filename() const OVERRIDE { return filename_; }
 
   virtual size_t memory_footprint() const OVERRIDE {
@@ -437,6 +535,10 @@ class PosixWritableFile : public WritableFile {
     return filesize_;
   }
 
+  virtual Status InvalidateCache(uint64_t offset, size_t length) OVERRIDE {
+    return DoInvalidateCache(fd_, filename_, offset, length);
+  }
+
   virtual const string& filename() const OVERRIDE { return filename_; }
 
  private:
@@ -548,6 +650,18 @@ class PosixRWFile : public RWFile {
     return Status::OK();
   }
 
+  virtual Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    return DoReadV(fd_, filename_, offset, results);
+  }
+
+  virtual Status Readahead(uint64_t offset, size_t length) const OVERRIDE {
+    return DoReadahead(fd_, filename_, offset, length);
+  }
+
+  virtual Status InvalidateCache(uint64_t offset, size_t length) const OVERRIDE {
+    return DoInvalidateCache(fd_, filename_, offset, length);
+  }
+
   virtual Status Write(uint64_t offset, const Slice& data) OVERRIDE {
     ThreadRestrictions::AssertIOAllowed();
     ssize_t written;
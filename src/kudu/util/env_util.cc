@@ -142,7 +142,7 @@ Status VerifySufficientDiskSpace(Env *env, const std::string& path,
   return Status::OK();
 }
 
-Status ReadFully(RandomAccessFile* file, uint64_t offset, size_t n,
+Status ReadFully(const RandomAccessFile* file, uint64_t offset, size_t n,
                  Slice* result, uint8_t* scratch) {
 
   bool first_read = true;
@@ -58,7 +58,7 @@ Status VerifySufficientDiskSpace(Env *env, const std::string& path,
 // NOTE: even if this returns an error, some data _may_ be read into
 // the provided scratch buffer, but no guarantee that that will be the
 // case.
-Status ReadFully(RandomAccessFile* file, uint64_t offset, size_t n,
+Status ReadFully(const RandomAccessFile* file, uint64_t offset, size_t n,
                  Slice* result, uint8_t* scratch);
 
 // Creates the directory given by 'path', unless it already exists.
@@ -109,4 +109,47 @@ TEST_F(FailureDetectorTest, TestDetectsFailure) {
   monitor_->Shutdown();
 }
 
+// Tests that the phi-accrual detector learns the heartbeat interval and
+// suspects the node well before its maximum failure period.
+TEST_F(FailureDetectorTest, TestPhiAccrual) {
+  scoped_refptr<PhiAccrualFailureDetector> detector(new PhiAccrualFailureDetector(
+      MonoDelta::FromSeconds(10),
+      MonoDelta::FromMilliseconds(kExpectedHeartbeatPeriodMillis / 10),
+      8.0));
+
+  // Replay heartbeats which arrived in the past at regular intervals.
+  MonoTime start = MonoTime::Now(MonoTime::FINE);
+  start.AddDelta(MonoDelta::FromSeconds(-5));
+  ASSERT_OK(detector->Track(kNodeName, start,
+                            Bind(&FailureDetectorTest::FailureFunction, Unretained(this))));
+  MonoTime t = start;
+  for (int i = 0; i < PhiAccrualFailureDetector::kMinSamples; i++) {
+    t.AddDelta(MonoDelta::FromMilliseconds(kExpectedHeartbeatPeriodMillis));
+    ASSERT_OK(detector->MessageFrom(kNodeName, t));
+  }
+
+  MonoTime on_time = t;
+  on_time.AddDelta(MonoDelta::FromMilliseconds(kExpectedHeartbeatPeriodMillis));
+  MonoTime late = t;
+  late.AddDelta(MonoDelta::FromMilliseconds(kExpectedHeartbeatPeriodMillis * 3));
+  ASSERT_LT(detector->Phi(kNodeName, on_time), 1.0);
+  ASSERT_GT(detector->Phi(kNodeName, late), 8.0);
+
+  detector->CheckForFailures(on_time);
+  ASSERT_EQ(1, latch_.count());
+  detector->CheckForFailures(late);
+  ASSERT_EQ(0, latch_.count());
+
+  // Snoozing into the future postpones suspicion, and forgetting the history
+  // falls back to the maximum failure period.
+  MonoTime future = MonoTime::Now(MonoTime::FINE);
+  future.AddDelta(MonoDelta::FromSeconds(1));
+  ASSERT_OK(detector->MessageFrom(kNodeName, future));
+  ASSERT_EQ(0, detector->Phi(kNodeName, future));
+  ASSERT_OK(detector->ResetHistory(kNodeName));
+  MonoTime later = future;
+  later.AddDelta(MonoDelta::FromSeconds(1));
+  ASSERT_EQ(0, detector->Phi(kNodeName, later));
+}
+
 }  // namespace kudu
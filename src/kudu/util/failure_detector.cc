@@ -17,6 +17,8 @@
 
 #include "kudu/util/failure_detector.h"
 
+#include <algorithm>
+#include <cmath>
 #include <glog/logging.h>
 #include <mutex>
 #include <unordered_map>
@@ -116,6 +118,150 @@ void TimedFailureDetector::CheckForFailures(const MonoTime& now) {
   }
 }
 
+const int PhiAccrualFailureDetector::kMinSamples = 10;
+const int PhiAccrualFailureDetector::kWindowSize = 100;
+
+PhiAccrualFailureDetector::PhiAccrualFailureDetector(MonoDelta failure_period,
+                                                     MonoDelta min_stddev,
+                                                     double phi_threshold)
+    : failure_period_(std::move(failure_period)),
+      min_stddev_(std::move(min_stddev)),
+      phi_threshold_(phi_threshold) {
+}
+
+PhiAccrualFailureDetector::~PhiAccrualFailureDetector() {
+  STLDeleteValues(&nodes_);
+}
+
+Status PhiAccrualFailureDetector::Track(const string& name,
+                                        const MonoTime& now,
+                                        const FailureDetectedCallback& callback) {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  gscoped_ptr<Node> node(new Node);
+  node->last_heard_of = now;
+  node->callback = callback;
+  node->status = ALIVE;
+  node->sum_us = 0;
+  node->sum_sq_us = 0;
+  if (!InsertIfNotPresent(&nodes_, name, node.get())) {
+    return Status::AlreadyPresent(
+        Substitute("Node with name '$0' is already being monitored", name));
+  }
+  ignore_result(node.release());
+  return Status::OK();
+}
+
+Status PhiAccrualFailureDetector::UnTrack(const string& name) {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  Node* node = EraseKeyReturnValuePtr(&nodes_, name);
+  if (PREDICT_FALSE(node == NULL)) {
+    return Status::NotFound(Substitute("Node with name '$0' not found", name));
+  }
+  delete node;
+  return Status::OK();
+}
+
+bool PhiAccrualFailureDetector::IsTracking(const std::string& name) {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  return ContainsKey(nodes_, name);
+}
+
+Status PhiAccrualFailureDetector::MessageFrom(const std::string& name, const MonoTime& now) {
+  VLOG(3) << "Received message from " << name << " at " << now.ToString();
+  // Snoozes and expirations aren't message arrivals.
+  bool is_arrival = now.Initialized() && !now.Equals(MonoTime::Min()) &&
+      !MonoTime::Now(MonoTime::FINE).ComesBefore(now);
+
+  std::lock_guard<simple_spinlock> lock(lock_);
+  Node* node = FindPtrOrNull(nodes_, name);
+  if (node == NULL) {
+    VLOG(1) << "Not tracking node: " << name;
+    return Status::NotFound(Substitute("Message from unknown node '$0'", name));
+  }
+  node->last_heard_of = now;
+  node->status = ALIVE;
+  if (!is_arrival) {
+    return Status::OK();
+  }
+  if (node->last_arrival.Initialized() && node->last_arrival.ComesBefore(now)) {
+    double interval_us = now.GetDeltaSince(node->last_arrival).ToMicroseconds();
+    node->intervals_us.push_back(interval_us);
+    node->sum_us += interval_us;
+    node->sum_sq_us += interval_us * interval_us;
+    if (static_cast<int>(node->intervals_us.size()) > kWindowSize) {
+      double oldest = node->intervals_us.front();
+      node->intervals_us.pop_front();
+      node->sum_us -= oldest;
+      node->sum_sq_us -= oldest * oldest;
+    }
+  }
+  node->last_arrival = now;
+  return Status::OK();
+}
+
+Status PhiAccrualFailureDetector::ResetHistory(const std::string& name) {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  Node* node = FindPtrOrNull(nodes_, name);
+  if (node == NULL) {
+    return Status::NotFound(Substitute("Node with name '$0' not found", name));
+  }
+  node->last_arrival = MonoTime();
+  node->intervals_us.clear();
+  node->sum_us = 0;
+  node->sum_sq_us = 0;
+  return Status::OK();
+}
+
+double PhiAccrualFailureDetector::Phi(const std::string& name, const MonoTime& now) const {
+  std::lock_guard<simple_spinlock> lock(lock_);
+  const Node* node = FindPtrOrNull(nodes_, name);
+  return node ? PhiUnlocked(*node, now) : 0;
+}
+
+double PhiAccrualFailureDetector::PhiUnlocked(const Node& node, const MonoTime& now) const {
+  int n = node.intervals_us.size();
+  if (n < kMinSamples || !node.last_heard_of.ComesBefore(now)) {
+    return 0;
+  }
+  double mean = node.sum_us / n;
+  double variance = std::max(0.0, node.sum_sq_us / n - mean * mean);
+  double stddev = std::max(sqrt(variance), static_cast<double>(min_stddev_.ToMicroseconds()));
+  double elapsed = now.GetDeltaSince(node.last_heard_of).ToMicroseconds();
+
+  // Use a logistic approximation of the normal distribution's complementary
+  // CDF, which is accurate to within 0.01% and cheap to compute.
+  double y = (elapsed - mean) / stddev;
+  double e = exp(-y * (1.5976 + 0.070566 * y * y));
+  if (elapsed > mean) {
+    return -log10(e / (1.0 + e));
+  }
+  return -log10(1.0 - 1.0 / (1.0 + e));
+}
+
+void PhiAccrualFailureDetector::CheckForFailures(const MonoTime& now) {
+  typedef unordered_map<string, FailureDetectedCallback> CallbackMap;
+  CallbackMap callbacks;
+  {
+    std::lock_guard<simple_spinlock> lock(lock_);
+    for (const NodeMap::value_type& entry : nodes_) {
+      Node* node = entry.second;
+      if (now.GetDeltaSince(node->last_heard_of).MoreThan(failure_period_) ||
+          PhiUnlocked(*node, now) > phi_threshold_) {
+        node->status = DEAD;
+      }
+      if (node->status == DEAD) {
+        InsertOrDie(&callbacks, entry.first, node->callback);
+      }
+    }
+  }
+  // Invoke failure callbacks outside of lock.
+  for (const CallbackMap::value_type& entry : callbacks) {
+    const string& node_name = entry.first;
+    const FailureDetectedCallback& callback = entry.second;
+    callback.Run(node_name, Status::RemoteError(Substitute("Node '$0' failed", node_name)));
+  }
+}
+
 RandomizedFailureMonitor::RandomizedFailureMonitor(uint32_t random_seed,
                                                    int64_t period_mean_millis,
                                                    int64_t period_stddev_millis)
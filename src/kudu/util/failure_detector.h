@@ -18,6 +18,7 @@
 #ifndef KUDU_UTIL_FAILURE_DETECTOR_H_
 #define KUDU_UTIL_FAILURE_DETECTOR_H_
 
+#include <deque>
 #include <string>
 #include <unordered_map>
 
@@ -129,6 +130,82 @@ class TimedFailureDetector : public FailureDetector {
 //
 // We use a random wake up interval to avoid thundering herd / lockstep problems
 // when multiple nodes react to the failure of another node.
+// A failure detector which learns the distribution of the intervals between
+// messages from each node, as described in "The Phi Accrual Failure Detector"
+// by Hayashibara et al. Rather than a fixed timeout, it computes a suspicion
+// level phi = -log10(P), where P is the probability, under a normal
+// distribution fitted to the recent intervals, that the next message arrives
+// later than the time already elapsed since the last one. A node is declared
+// failed once phi exceeds 'phi_threshold'; e.g. a threshold of 8 accepts a
+// 1e-8 chance of a false positive per check.
+//
+// A node is always declared failed once 'failure_period' elapses without a
+// message, and never declared failed by phi until 'kMinSamples' intervals have
+// been observed, so that the detector is never slower than a
+// TimedFailureDetector with the same period. 'min_stddev' bounds how
+// confident the detector gets on a very regular network.
+//
+// A call to MessageFrom() with a time in the future is taken to be a snooze:
+// failure detection is postponed until then, but the time isn't recorded as a
+// message arrival.
+class PhiAccrualFailureDetector : public FailureDetector {
+ public:
+  // The number of intervals needed before phi is used.
+  static const int kMinSamples;
+
+  // The number of most recent intervals which the distribution is fitted to.
+  static const int kWindowSize;
+
+  PhiAccrualFailureDetector(MonoDelta failure_period, MonoDelta min_stddev,
+                            double phi_threshold);
+  virtual ~PhiAccrualFailureDetector();
+
+  virtual Status Track(const std::string& name,
+                       const MonoTime& now,
+                       const FailureDetectedCallback& callback) OVERRIDE;
+
+  virtual Status UnTrack(const std::string& name) OVERRIDE;
+
+  virtual bool IsTracking(const std::string& name) OVERRIDE;
+
+  virtual Status MessageFrom(const std::string& name, const MonoTime& now) OVERRIDE;
+
+  virtual void CheckForFailures(const MonoTime& now) OVERRIDE;
+
+  // Forgets the intervals learned for 'name', e.g. because another server
+  // took over sending its messages.
+  Status ResetHistory(const std::string& name);
+
+  // Returns the suspicion level of 'name' at 'now', or 0 if 'name' isn't
+  // tracked or not enough intervals are known yet.
+  double Phi(const std::string& name, const MonoTime& now) const;
+
+ private:
+  struct Node {
+    MonoTime last_heard_of;
+    // The time of the last message, or uninitialized if unknown.
+    MonoTime last_arrival;
+    FailureDetectedCallback callback;
+    NodeStatus status;
+    // The most recent intervals between messages, in microseconds, along with
+    // their running sum and sum of squares.
+    std::deque<double> intervals_us;
+    double sum_us;
+    double sum_sq_us;
+  };
+  typedef std::unordered_map<std::string, Node*> NodeMap;
+
+  double PhiUnlocked(const Node& node, const MonoTime& now) const;
+
+  const MonoDelta failure_period_;
+  const MonoDelta min_stddev_;
+  const double phi_threshold_;
+  mutable simple_spinlock lock_;
+  NodeMap nodes_;
+
+  DISALLOW_COPY_AND_ASSIGN(PhiAccrualFailureDetector);
+};
+
 class RandomizedFailureMonitor {
  public:
   // The minimum time the FailureMonitor will wait.
@@ -0,0 +1,101 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/file_cache.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+METRIC_DECLARE_entity(server);
+METRIC_DECLARE_counter(file_cache_hits);
+METRIC_DECLARE_counter(file_cache_misses);
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+class FileCacheTest : public KuduTest {
+ protected:
+  void ReadAndCheck(const shared_ptr<RandomAccessFile>& file, const string& expected) {
+    uint64_t size;
+    ASSERT_OK(file->Size(&size));
+    ASSERT_EQ(expected.size(), size);
+    uint8_t scratch[64];
+    Slice result;
+    ASSERT_OK(file->Read(0, expected.size(), &result, scratch));
+    ASSERT_EQ(expected, result.ToString());
+  }
+};
+
+TEST_F(FileCacheTest, TestBoundsOpenFiles) {
+  MetricRegistry registry;
+  scoped_refptr<MetricEntity> entity = METRIC_ENTITY_server.Instantiate(&registry, "test");
+  FileCache cache("test", env_.get(), 2, entity);
+
+  const int kNumFiles = 5;
+  vector<string> paths;
+  vector<shared_ptr<RandomAccessFile>> files;
+  for (int i = 0; i < kNumFiles; i++) {
+    string path = GetTestPath(Substitute("file-$0", i));
+    ASSERT_OK(WriteStringToFile(env_.get(), Substitute("data-$0", i), path));
+    shared_ptr<RandomAccessFile> file;
+    ASSERT_OK(cache.OpenExistingFile(path, &file));
+    paths.push_back(path);
+    files.push_back(file);
+    ASSERT_LE(cache.num_open_files(), 2);
+  }
+
+  // Every file can be read, though only two descriptors are kept open.
+  for (int iter = 0; iter < 2; iter++) {
+    for (int i = 0; i < kNumFiles; i++) {
+      NO_FATALS(ReadAndCheck(files[i], Substitute("data-$0", i)));
+      ASSERT_EQ(2, cache.num_open_files());
+    }
+  }
+  scoped_refptr<Counter> hits = METRIC_file_cache_hits.Instantiate(entity);
+  scoped_refptr<Counter> misses = METRIC_file_cache_misses.Instantiate(entity);
+  int64_t misses_before = misses->value();
+  NO_FATALS(ReadAndCheck(files[kNumFiles - 1], Substitute("data-$0", kNumFiles - 1)));
+  ASSERT_EQ(misses_before, misses->value());
+  ASSERT_GT(hits->value(), 0);
+
+  // Opening a missing file fails straight away.
+  shared_ptr<RandomAccessFile> missing;
+  ASSERT_TRUE(cache.OpenExistingFile(GetTestPath("missing"), &missing).IsNotFound());
+
+  // Once a file is deleted and invalidated, its reads fail.
+  ASSERT_OK(env_->DeleteFile(paths[kNumFiles - 1]));
+  cache.Invalidate(paths[kNumFiles - 1]);
+  ASSERT_EQ(1, cache.num_open_files());
+  uint8_t scratch[64];
+  Slice result;
+  ASSERT_TRUE(files[kNumFiles - 1]->Read(0, 1, &result, scratch).IsNotFound());
+}
+
+} // namespace kudu
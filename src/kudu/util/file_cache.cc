@@ -0,0 +1,212 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/file_cache.h"
+
+#include <mutex>
+#include <vector>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/map-util.h"
+#include "kudu/util/atomic.h"
+#include "kudu/util/env.h"
+#include "kudu/util/malloc.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+
+METRIC_DEFINE_counter(server, file_cache_hits,
+                      "File Cache Hits", kudu::MetricUnit::kEntries,
+                      "Number of reads of files opened through the file cache "
+                      "whose descriptor was open");
+METRIC_DEFINE_counter(server, file_cache_misses,
+                      "File Cache Misses", kudu::MetricUnit::kEntries,
+                      "Number of times a file opened through the file cache had "
+                      "to be (re)opened");
+METRIC_DEFINE_histogram(server, file_cache_open_latency,
+                        "File Cache Open Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds spent opening files on file cache misses",
+                        60000000LU, 2);
+
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+namespace kudu {
+
+namespace internal {
+
+// A file whose descriptor is borrowed from a FileCache for each operation.
+class CachedRandomAccessFile : public RandomAccessFile {
+ public:
+  CachedRandomAccessFile(FileCache* cache, string path)
+      : cache_(cache),
+        path_(std::move(path)),
+        size_(-1) {
+  }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              uint8_t* scratch) const OVERRIDE {
+    shared_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(cache_->GetOpenFile(path_, &file));
+    return file->Read(offset, n, result, scratch);
+  }
+
+  Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    shared_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(cache_->GetOpenFile(path_, &file));
+    return file->ReadV(offset, results);
+  }
+
+  Status Size(uint64_t* size) const OVERRIDE {
+    // The file doesn't change, so its size doesn't need a descriptor after
+    // the first call.
+    int64_t cached_size = size_.Load();
+    if (cached_size >= 0) {
+      *size = cached_size;
+      return Status::OK();
+    }
+    shared_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(cache_->GetOpenFile(path_, &file));
+    RETURN_NOT_OK(file->Size(size));
+    size_.Store(*size);
+    return Status::OK();
+  }
+
+  Status Readahead(uint64_t offset, size_t length) const OVERRIDE {
+    shared_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(cache_->GetOpenFile(path_, &file));
+    return file->Readahead(offset, length);
+  }
+
+  Status InvalidateCache(uint64_t offset, size_t length) const OVERRIDE {
+    shared_ptr<RandomAccessFile> file;
+    RETURN_NOT_OK(cache_->GetOpenFile(path_, &file));
+    return file->InvalidateCache(offset, length);
+  }
+
+  const string& filename() const OVERRIDE {
+    return path_;
+  }
+
+  size_t memory_footprint() const OVERRIDE {
+    return kudu_malloc_usable_size(this) + path_.capacity();
+  }
+
+ private:
+  FileCache* const cache_;
+  const string path_;
+  mutable AtomicInt<int64_t> size_;
+
+  DISALLOW_COPY_AND_ASSIGN(CachedRandomAccessFile);
+};
+
+} // namespace internal
+
+FileCache::FileCache(string name, Env* env, int max_open_files,
+                     const scoped_refptr<MetricEntity>& entity)
+    : name_(std::move(name)),
+      env_(DCHECK_NOTNULL(env)),
+      max_open_files_(max_open_files) {
+  CHECK_GT(max_open_files_, 0);
+  if (entity) {
+    hits_ = METRIC_file_cache_hits.Instantiate(entity);
+    misses_ = METRIC_file_cache_misses.Instantiate(entity);
+    open_latency_ = METRIC_file_cache_open_latency.Instantiate(entity);
+  }
+}
+
+FileCache::~FileCache() {
+}
+
+Status FileCache::OpenExistingFile(const string& path, shared_ptr<RandomAccessFile>* file) {
+  // Open the file straight away so that errors such as a missing file are
+  // reported here rather than by the first read.
+  shared_ptr<RandomAccessFile> opened;
+  RETURN_NOT_OK(GetOpenFile(path, &opened));
+  file->reset(new internal::CachedRandomAccessFile(this, path));
+  return Status::OK();
+}
+
+void FileCache::Invalidate(const string& path) {
+  shared_ptr<RandomAccessFile> to_close;
+  std::lock_guard<simple_spinlock> l(lock_);
+  Entry* entry = FindOrNull(open_files_, path);
+  if (entry) {
+    to_close.swap(entry->file);
+    lru_.erase(entry->lru_pos);
+    open_files_.erase(path);
+  }
+}
+
+int FileCache::num_open_files() const {
+  std::lock_guard<simple_spinlock> l(lock_);
+  return open_files_.size();
+}
+
+Status FileCache::GetOpenFile(const string& path, shared_ptr<RandomAccessFile>* file) {
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    Entry* entry = FindOrNull(open_files_, path);
+    if (entry) {
+      lru_.splice(lru_.begin(), lru_, entry->lru_pos);
+      *file = entry->file;
+      if (hits_) hits_->Increment();
+      return Status::OK();
+    }
+  }
+
+  // Open the file without holding the lock: open() may be slow.
+  if (misses_) misses_->Increment();
+  MonoTime start = MonoTime::Now(MonoTime::FINE);
+  gscoped_ptr<RandomAccessFile> opened;
+  RETURN_NOT_OK(env_->NewRandomAccessFile(path, &opened));
+  if (open_latency_) {
+    open_latency_->Increment(
+        MonoTime::Now(MonoTime::FINE).GetDeltaSince(start).ToMicroseconds());
+  }
+
+  // The evicted descriptors are closed, if they're not in use, once the lock
+  // is released.
+  vector<shared_ptr<RandomAccessFile>> evicted;
+  std::lock_guard<simple_spinlock> l(lock_);
+  Entry* entry = FindOrNull(open_files_, path);
+  if (entry) {
+    // Another thread opened the file in the meantime.
+    lru_.splice(lru_.begin(), lru_, entry->lru_pos);
+    *file = entry->file;
+    return Status::OK();
+  }
+  file->reset(opened.release());
+  lru_.push_front(path);
+  Entry& new_entry = open_files_[path];
+  new_entry.file = *file;
+  new_entry.lru_pos = lru_.begin();
+  while (open_files_.size() > max_open_files_) {
+    auto it = open_files_.find(lru_.back());
+    DCHECK(it != open_files_.end());
+    evicted.emplace_back(std::move(it->second.file));
+    open_files_.erase(it);
+    lru_.pop_back();
+  }
+  VLOG_IF(2, !evicted.empty()) << name_ << ": evicted " << evicted.size()
+                               << " file(s) to open " << path;
+  return Status::OK();
+}
+
+} // namespace kudu
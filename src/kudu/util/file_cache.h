@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_FILE_CACHE_H
+#define KUDU_UTIL_FILE_CACHE_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/gutil/ref_counted.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+class Counter;
+class Env;
+class Histogram;
+class MetricEntity;
+class RandomAccessFile;
+
+namespace internal {
+class CachedRandomAccessFile;
+} // namespace internal
+
+// Bounds the number of file descriptors used by files which are opened for
+// reading, such as the blocks of the FileBlockManager, when there are more
+// such files than the process may keep open at once.
+//
+// The files opened through the cache look like regular RandomAccessFiles, but
+// their descriptors are kept in an LRU list of at most 'max_open_files'
+// entries. A descriptor evicted from the list is closed once the reads in
+// progress on it complete, and the file is reopened transparently by the
+// next read. The files must not change while they're open through the cache.
+//
+// Thread-safe.
+class FileCache {
+ public:
+  // Creates a cache, named 'name' in log messages, which keeps at most
+  // 'max_open_files' files of 'env' open. 'entity', if not null, receives the
+  // hit, miss and open latency metrics of the cache.
+  FileCache(std::string name, Env* env, int max_open_files,
+            const scoped_refptr<MetricEntity>& entity);
+  ~FileCache();
+
+  // Opens the existing file at 'path' for reading through the cache.
+  //
+  // The returned file must not outlive the cache.
+  Status OpenExistingFile(const std::string& path,
+                          std::shared_ptr<RandomAccessFile>* file);
+
+  // Closes the cached descriptor of the file at 'path', if any, e.g. because
+  // the file was deleted and its space should be reclaimed. Reads of the file
+  // after this reopen it.
+  void Invalidate(const std::string& path);
+
+  // Returns the number of descriptors currently held by the cache.
+  int num_open_files() const;
+
+ private:
+  friend class internal::CachedRandomAccessFile;
+
+  struct Entry {
+    std::shared_ptr<RandomAccessFile> file;
+    std::list<std::string>::iterator lru_pos;
+  };
+
+  // Returns an open descriptor for the file at 'path', opening it if it's
+  // not in the cache.
+  Status GetOpenFile(const std::string& path, std::shared_ptr<RandomAccessFile>* file);
+
+  const std::string name_;
+  Env* const env_;
+  const int max_open_files_;
+
+  // Protects 'lru_' and 'open_files_'.
+  mutable simple_spinlock lock_;
+  // The paths of the open files, most recently used first.
+  std::list<std::string> lru_;
+  // The open files, keyed by path.
+  std::unordered_map<std::string, Entry> open_files_;
+
+  scoped_refptr<Counter> hits_;
+  scoped_refptr<Counter> misses_;
+  scoped_refptr<Histogram> open_latency_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileCache);
+};
+
+} // namespace kudu
+
+#endif /* KUDU_UTIL_FILE_CACHE_H */
@@ -184,6 +184,32 @@ void HdrHistogram::IncrementBy(int64_t value, int64_t count) {
   }
 }
 
+void HdrHistogram::MergeFrom(const HdrHistogram& other) {
+  DCHECK_EQ(highest_trackable_value_, other.highest_trackable_value_);
+  DCHECK_EQ(num_significant_digits_, other.num_significant_digits_);
+
+  // Same order as the copy constructor: sum and min, counts, then max.
+  NoBarrier_AtomicIncrement(&total_sum_, NoBarrier_Load(&other.total_sum_));
+  Atomic64 other_min = NoBarrier_Load(&other.min_value_);
+  if (other_min < NoBarrier_Load(&min_value_)) {
+    NoBarrier_Store(&min_value_, other_min);
+  }
+
+  uint64_t total_merged_count = 0;
+  for (int i = 0; i < counts_array_length_; i++) {
+    uint64_t count = NoBarrier_Load(&other.counts_[i]);
+    if (count != 0) {
+      NoBarrier_AtomicIncrement(&counts_[i], count);
+      total_merged_count += count;
+    }
+  }
+  Atomic64 other_max = NoBarrier_Load(&other.max_value_);
+  if (other_max > NoBarrier_Load(&max_value_)) {
+    NoBarrier_Store(&max_value_, other_max);
+  }
+  NoBarrier_AtomicIncrement(&total_count_, total_merged_count);
+}
+
 void HdrHistogram::IncrementWithExpectedInterval(int64_t value,
                                                  int64_t expected_interval_between_samples) {
   Increment(value);
@@ -0,0 +1,68 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/hyperloglog.h"
+
+#include <cmath>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/gutil/hash/city.h"
+#include "kudu/util/test_macros.h"
+
+namespace kudu {
+
+static uint64_t HashInt(int64_t v) {
+  return util_hash::CityHash64(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+TEST(HyperLogLogTest, TestEstimate) {
+  for (int64_t n : { 0, 1, 10, 1000, 100000 }) {
+    SCOPED_TRACE(n);
+    HyperLogLog hll(10);
+    // Adding every value twice doesn't change the estimate.
+    for (int round = 0; round < 2; round++) {
+      for (int64_t i = 0; i < n; i++) {
+        hll.AddHash(HashInt(i));
+      }
+    }
+    ASSERT_LE(std::abs(hll.Estimate() - n), n * 0.1);
+  }
+}
+
+TEST(HyperLogLogTest, TestMergeAndRegisters) {
+  HyperLogLog a(10);
+  HyperLogLog b(10);
+  for (int64_t i = 0; i < 20000; i++) {
+    a.AddHash(HashInt(i));
+    b.AddHash(HashInt(i + 10000));
+  }
+  ASSERT_OK(a.Merge(b));
+  ASSERT_LE(std::abs(a.Estimate() - 30000), 3000);
+
+  HyperLogLog copy(4);
+  ASSERT_OK(HyperLogLog::FromRegisters(a.registers(), &copy));
+  ASSERT_EQ(10, copy.precision());
+  ASSERT_EQ(a.Estimate(), copy.Estimate());
+
+  ASSERT_TRUE(a.Merge(HyperLogLog(8)).IsInvalidArgument());
+  std::string bad(1000, '\0');
+  ASSERT_TRUE(HyperLogLog::FromRegisters(bad, &copy).IsCorruption());
+}
+
+} // namespace kudu
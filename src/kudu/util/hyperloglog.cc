@@ -0,0 +1,101 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/hyperloglog.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glog/logging.h>
+
+#include "kudu/gutil/bits.h"
+#include "kudu/gutil/strings/substitute.h"
+
+using strings::Substitute;
+
+namespace kudu {
+
+HyperLogLog::HyperLogLog(int precision)
+    : precision_(precision),
+      registers_(1 << precision, 0) {
+  DCHECK_GE(precision, kMinPrecision);
+  DCHECK_LE(precision, kMaxPrecision);
+}
+
+Status HyperLogLog::FromRegisters(const Slice& registers, HyperLogLog* hll) {
+  int precision = Bits::Log2Floor64(registers.size());
+  if (precision < kMinPrecision || precision > kMaxPrecision ||
+      registers.size() != (1UL << precision)) {
+    return Status::Corruption(Substitute("invalid number of HyperLogLog registers: $0",
+                                         registers.size()));
+  }
+  hll->precision_ = precision;
+  hll->registers_.assign(registers.data(), registers.data() + registers.size());
+  return Status::OK();
+}
+
+void HyperLogLog::AddHash(uint64_t hash) {
+  // The top bits of the hash select the register, which keeps the longest
+  // run of leading zeros seen in the remaining bits, plus one.
+  uint64_t idx = hash >> (64 - precision_);
+  uint64_t rest = hash << precision_;
+  int max_rank = 64 - precision_ + 1;
+  int rank = rest == 0 ? max_rank : std::min(63 - Bits::Log2FloorNonZero64(rest) + 1, max_rank);
+  registers_[idx] = std::max<uint8_t>(registers_[idx], rank);
+}
+
+Status HyperLogLog::Merge(const HyperLogLog& other) {
+  if (other.precision_ != precision_) {
+    return Status::InvalidArgument(Substitute("cannot merge HyperLogLog of precision $0 "
+                                              "into one of precision $1",
+                                              other.precision_, precision_));
+  }
+  for (size_t i = 0; i < registers_.size(); i++) {
+    registers_[i] = std::max(registers_[i], other.registers_[i]);
+  }
+  return Status::OK();
+}
+
+int64_t HyperLogLog::Estimate() const {
+  double m = registers_.size();
+  double alpha;
+  switch (registers_.size()) {
+    case 16: alpha = 0.673; break;
+    case 32: alpha = 0.697; break;
+    case 64: alpha = 0.709; break;
+    default: alpha = 0.7213 / (1 + 1.079 / m); break;
+  }
+  double sum = 0;
+  int zeros = 0;
+  for (uint8_t r : registers_) {
+    sum += std::ldexp(1.0, -r);
+    if (r == 0) {
+      zeros++;
+    }
+  }
+  double estimate = alpha * m * m / sum;
+
+  // Small cardinalities are better estimated by linear counting of the
+  // registers still empty. The hashes being 64-bit, large cardinalities need
+  // no correction.
+  if (estimate <= 2.5 * m && zeros > 0) {
+    estimate = m * std::log(m / zeros);
+  }
+  return static_cast<int64_t>(std::llround(estimate));
+}
+
+} // namespace kudu
@@ -0,0 +1,73 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_HYPERLOGLOG_H
+#define KUDU_UTIL_HYPERLOGLOG_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "kudu/util/slice.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// A HyperLogLog sketch, estimating the number of distinct values among those
+// whose 64-bit hashes were added to it, within a few percent, using one byte
+// per register.
+//
+// See "HyperLogLog: the analysis of a near-optimal cardinality estimation
+// algorithm", Flajolet et al., AofA 2007.
+//
+// Sketches of the same precision may be merged, estimating the number of
+// distinct values of the union of their inputs, so that the sketches of
+// separately written sets of values may be combined later.
+class HyperLogLog {
+ public:
+  static const int kMinPrecision = 4;
+  static const int kMaxPrecision = 16;
+
+  // Creates an empty sketch with 2^'precision' registers.
+  explicit HyperLogLog(int precision);
+
+  // Sets '*hll' to the sketch whose registers were returned by registers().
+  // Returns Corruption if their number isn't a valid power of 2.
+  static Status FromRegisters(const Slice& registers, HyperLogLog* hll);
+
+  void AddHash(uint64_t hash);
+
+  // Folds 'other' into this sketch. Returns InvalidArgument if the two don't
+  // have the same precision.
+  Status Merge(const HyperLogLog& other);
+
+  // Returns the estimated number of distinct values added.
+  int64_t Estimate() const;
+
+  int precision() const { return precision_; }
+
+  // Returns the registers of the sketch, which is its serialized form.
+  Slice registers() const { return Slice(registers_.data(), registers_.size()); }
+
+ private:
+  int precision_;
+  std::vector<uint8_t> registers_;
+};
+
+} // namespace kudu
+
+#endif /* KUDU_UTIL_HYPERLOGLOG_H */
@@ -38,16 +38,46 @@ IntervalTree<Traits>::~IntervalTree() {
 template<class Traits>
 void IntervalTree<Traits>::FindContainingPoint(const point_type &query,
                                                IntervalVector *results) const {
-  if (root_) {
-    root_->FindContainingPoint(query, results);
-  }
+  ForEachIntervalContainingPoint(query, [&](const interval_type &interval) {
+      results->push_back(interval);
+    });
 }
 
 template<class Traits>
 void IntervalTree<Traits>::FindIntersectingInterval(const interval_type &query,
                                                     IntervalVector *results) const {
+  ForEachIntervalIntersecting(Traits::get_left(query), Traits::get_right(query),
+                              [&](const interval_type &interval) {
+                                results->push_back(interval);
+                              });
+}
+
+template<class Traits>
+template<class Callback>
+void IntervalTree<Traits>::ForEachIntervalContainingPoint(const point_type &query,
+                                                          const Callback &cb) const {
+  if (root_) {
+    root_->ForEachIntervalContainingPoint(query, cb);
+  }
+}
+
+template<class Traits>
+template<class Callback>
+void IntervalTree<Traits>::ForEachIntervalIntersecting(const point_type &lower,
+                                                       const point_type &upper,
+                                                       const Callback &cb) const {
   if (root_) {
-    root_->FindIntersectingInterval(query, results);
+    root_->ForEachIntervalIntersecting(lower, upper, cb);
+  }
+}
+
+template<class Traits>
+template<class Callback>
+void IntervalTree<Traits>::ForEachIntervalContainingPoints(
+    const std::vector<point_type> &sorted_queries,
+    const Callback &cb) const {
+  if (root_) {
+    root_->ForEachIntervalContainingPoints(sorted_queries, 0, sorted_queries.size(), cb);
   }
 }
 
@@ -150,13 +180,23 @@ class ITNode {
          ITNode<Traits> *right);
   ~ITNode();
 
-  // See IntervalTree::FindContainingPoint(...)
-  void FindContainingPoint(const point_type &query,
-                           IntervalVector *results) const;
+  // See IntervalTree::ForEachIntervalContainingPoint(...)
+  template<class Callback>
+  void ForEachIntervalContainingPoint(const point_type &query,
+                                      const Callback &cb) const;
 
-  // See IntervalTree::FindIntersectingInterval(...)
-  void FindIntersectingInterval(const interval_type &query,
-                                IntervalVector *results) const;
+  // See IntervalTree::ForEachIntervalIntersecting(...)
+  template<class Callback>
+  void ForEachIntervalIntersecting(const point_type &lower,
+                                   const point_type &upper,
+                                   const Callback &cb) const;
+
+  // See IntervalTree::ForEachIntervalContainingPoints(...). Only the points
+  // in 'queries' in the index range ['begin', 'end') are considered.
+  template<class Callback>
+  void ForEachIntervalContainingPoints(const std::vector<point_type> &queries,
+                                       int begin, int end,
+                                       const Callback &cb) const;
 
  private:
   // Comparators for sorting lists of intervals.
@@ -212,20 +252,21 @@ ITNode<Traits>::~ITNode() {
 }
 
 template<class Traits>
-void ITNode<Traits>::FindContainingPoint(const point_type &query,
-                                         IntervalVector *results) const {
+template<class Callback>
+void ITNode<Traits>::ForEachIntervalContainingPoint(const point_type &query,
+                                                    const Callback &cb) const {
   int cmp = Traits::compare(query, split_point_);
   if (cmp < 0) {
     // None of the intervals in right_ may intersect this.
     if (left_ != NULL) {
-      left_->FindContainingPoint(query, results);
+      left_->ForEachIntervalContainingPoint(query, cb);
     }
 
     // Any intervals which start before the query point and overlap the split point
     // must therefore contain the query point.
     for (const interval_type &interval : overlapping_by_asc_left_) {
       if (Traits::compare(Traits::get_left(interval), query) <= 0) {
-        results->push_back(interval);
+        cb(interval);
       } else {
         break;
       }
@@ -233,14 +274,14 @@ void ITNode<Traits>::FindContainingPoint(const point_type &query,
   } else if (cmp > 0) {
     // None of the intervals in left_ may intersect this.
     if (right_ != NULL) {
-      right_->FindContainingPoint(query, results);
+      right_->ForEachIntervalContainingPoint(query, cb);
     }
 
     // Any intervals which end after the query point and overlap the split point
     // must therefore contain the query point.
     for (const interval_type &interval : overlapping_by_desc_right_) {
       if (Traits::compare(Traits::get_right(interval), query) >= 0) {
-        results->push_back(interval);
+        cb(interval);
       } else {
         break;
       }
@@ -249,42 +290,45 @@ void ITNode<Traits>::FindContainingPoint(const point_type &query,
     DCHECK_EQ(cmp, 0);
     // The query is exactly our split point -- in this case we've already got
     // the computed list of overlapping intervals.
-    results->insert(results->end(), overlapping_by_asc_left_.begin(),
-                    overlapping_by_asc_left_.end());
+    for (const interval_type &interval : overlapping_by_asc_left_) {
+      cb(interval);
+    }
   }
 }
 
 template<class Traits>
-void ITNode<Traits>::FindIntersectingInterval(const interval_type &query,
-                                              IntervalVector *results) const {
-  if (Traits::compare(Traits::get_right(query), split_point_) < 0) {
+template<class Callback>
+void ITNode<Traits>::ForEachIntervalIntersecting(const point_type &lower,
+                                                 const point_type &upper,
+                                                 const Callback &cb) const {
+  if (Traits::compare(upper, split_point_) < 0) {
     // The interval is fully left of the split point. So, it may not overlap
     // with any in 'right_'
     if (left_ != NULL) {
-      left_->FindIntersectingInterval(query, results);
+      left_->ForEachIntervalIntersecting(lower, upper, cb);
     }
 
     // Any intervals whose left edge is <= the query interval's right edge
     // intersect the query interval.
     for (const interval_type &interval : overlapping_by_asc_left_) {
-      if (Traits::compare(Traits::get_left(interval),Traits::get_right(query)) <= 0) {
-        results->push_back(interval);
+      if (Traits::compare(Traits::get_left(interval), upper) <= 0) {
+        cb(interval);
       } else {
         break;
       }
     }
-  } else if (Traits::compare(Traits::get_left(query), split_point_) > 0) {
+  } else if (Traits::compare(lower, split_point_) > 0) {
     // The interval is fully right of the split point. So, it may not overlap
     // with any in 'left_'
     if (right_ != NULL) {
-      right_->FindIntersectingInterval(query, results);
+      right_->ForEachIntervalIntersecting(lower, upper, cb);
     }
 
     // Any intervals whose right edge is >= the query interval's left edge
     // intersect the query interval.
     for (const interval_type &interval : overlapping_by_desc_right_) {
-      if (Traits::compare(Traits::get_right(interval), Traits::get_left(query)) >= 0) {
-        results->push_back(interval);
+      if (Traits::compare(Traits::get_right(interval), lower) >= 0) {
+        cb(interval);
       } else {
         break;
       }
@@ -292,19 +336,86 @@ void ITNode<Traits>::FindIntersectingInterval(const interval_type &query,
   } else {
     // The query interval contains the split point. Therefore all other intervals
     // which also contain the split point are intersecting.
-    results->insert(results->end(), overlapping_by_asc_left_.begin(),
-                    overlapping_by_asc_left_.end());
+    for (const interval_type &interval : overlapping_by_asc_left_) {
+      cb(interval);
+    }
 
     // The query interval may _also_ intersect some in either child.
     if (left_ != NULL) {
-      left_->FindIntersectingInterval(query, results);
+      left_->ForEachIntervalIntersecting(lower, upper, cb);
     }
     if (right_ != NULL) {
-      right_->FindIntersectingInterval(query, results);
+      right_->ForEachIntervalIntersecting(lower, upper, cb);
     }
   }
 }
 
+template<class Traits>
+template<class Callback>
+void ITNode<Traits>::ForEachIntervalContainingPoints(const std::vector<point_type> &queries,
+                                                     int begin, int end,
+                                                     const Callback &cb) const {
+  if (begin == end) {
+    return;
+  }
+  auto first = queries.begin() + begin;
+  auto last = queries.begin() + end;
+
+  // Split the queries into those left of, equal to, and right of the split point.
+  int mid_begin = std::lower_bound(first, last, split_point_, LessThan<Traits>) -
+      queries.begin();
+  int mid_end = std::upper_bound(queries.begin() + mid_begin, last, split_point_,
+                                 LessThan<Traits>) - queries.begin();
+
+  if (left_ != NULL) {
+    left_->ForEachIntervalContainingPoints(queries, begin, mid_begin, cb);
+  }
+
+  // Each overlapping interval contains every query point left of the split
+  // point which is at or after its left edge. Since the intervals are sorted
+  // by their left edges, once one contains none of the points, neither do the
+  // rest.
+  if (begin < mid_begin) {
+    for (const interval_type &interval : overlapping_by_asc_left_) {
+      int start = std::lower_bound(first, queries.begin() + mid_begin,
+                                   Traits::get_left(interval),
+                                   LessThan<Traits>) - queries.begin();
+      if (start == mid_begin) {
+        break;
+      }
+      for (int i = start; i < mid_begin; i++) {
+        cb(i, interval);
+      }
+    }
+  }
+
+  // Query points equal to the split point are contained by every
+  // overlapping interval.
+  for (int i = mid_begin; i < mid_end; i++) {
+    for (const interval_type &interval : overlapping_by_asc_left_) {
+      cb(i, interval);
+    }
+  }
+
+  // Symmetrically, for query points right of the split point.
+  if (mid_end < end) {
+    for (const interval_type &interval : overlapping_by_desc_right_) {
+      int stop = std::upper_bound(queries.begin() + mid_end, last,
+                                  Traits::get_right(interval),
+                                  LessThan<Traits>) - queries.begin();
+      if (stop == mid_end) {
+        break;
+      }
+      for (int i = mid_end; i < stop; i++) {
+        cb(i, interval);
+      }
+    }
+  }
+
+  if (right_ != NULL) {
+    right_->ForEachIntervalContainingPoints(queries, mid_end, end, cb);
+  }
+}
 
 } // namespace interval_tree_internal
 
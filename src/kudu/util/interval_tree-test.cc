@@ -148,6 +148,27 @@ static void VerifyFindIntersectingInterval(const vector<IntInterval> all_interva
   EXPECT_EQ(Stringify(brute_force), Stringify(results));
 }
 
+// Verify that IntervalTree::ForEachIntervalContainingPoints yields the same
+// results as calling the brute-force algorithm once per query point.
+static void VerifyForEachIntervalContainingPoints(const vector<IntInterval> &all_intervals,
+                                                  const IntervalTree<IntTraits> &tree,
+                                                  const vector<int> &sorted_queries) {
+  vector<vector<IntInterval>> results(sorted_queries.size());
+  tree.ForEachIntervalContainingPoints(sorted_queries,
+                                       [&](int idx, const IntInterval &interval) {
+                                         results[idx].push_back(interval);
+                                       });
+  for (int i = 0; i < sorted_queries.size(); i++) {
+    std::sort(results[i].begin(), results[i].end(), CompareIntervals);
+
+    vector<IntInterval> brute_force;
+    FindContainingBruteForce(all_intervals, sorted_queries[i], &brute_force);
+    std::sort(brute_force.begin(), brute_force.end(), CompareIntervals);
+
+    SCOPED_TRACE(Stringify(all_intervals) + StringPrintf(" (q=%d)", sorted_queries[i]));
+    EXPECT_EQ(Stringify(brute_force), Stringify(results[i]));
+  }
+}
 
 TEST_F(TestIntervalTree, TestBasic) {
   vector<IntInterval> intervals;
@@ -163,6 +184,7 @@ TEST_F(TestIntervalTree, TestBasic) {
       VerifyFindIntersectingInterval(intervals, t, IntInterval(i, j));
     }
   }
+  VerifyForEachIntervalContainingPoints(intervals, t, { 0, 1, 1, 2, 3, 4, 4, 5 });
 }
 
 TEST_F(TestIntervalTree, TestRandomized) {
@@ -188,6 +210,16 @@ TEST_F(TestIntervalTree, TestRandomized) {
     int r = l + rand() % 100; // NOLINT(runtime/threadsafe_fn)
     VerifyFindIntersectingInterval(intervals, t, IntInterval(l, r));
   }
+
+  // Test batches of sorted random query points, including duplicates.
+  for (int i = 0; i < 10; i++) {
+    vector<int> queries;
+    for (int j = 0; j < 50; j++) {
+      queries.push_back(rand() % 202 - 1); // NOLINT(runtime/threadsafe_fn)
+    }
+    std::sort(queries.begin(), queries.end());
+    VerifyForEachIntervalContainingPoints(intervals, t, queries);
+  }
 }
 
 TEST_F(TestIntervalTree, TestEmpty) {
@@ -196,6 +228,7 @@ TEST_F(TestIntervalTree, TestEmpty) {
 
   VerifyFindContainingPoint(empty, t, 1);
   VerifyFindIntersectingInterval(empty, t, IntInterval(1, 2));
+  VerifyForEachIntervalContainingPoints(empty, t, { 1, 2 });
 }
 
 } // namespace kudu
@@ -93,6 +93,33 @@ class IntervalTree {
   void FindIntersectingInterval(const interval_type &query,
                                 IntervalVector *results) const;
 
+  // For each of the query points in 'sorted_queries', which must be sorted
+  // in ascending order, find the intervals in the tree which contain it, and
+  // call 'cb(point_index, interval)' for each such pair, where 'point_index'
+  // is the index of the point in 'sorted_queries'.
+  //
+  // This is equivalent to calling FindContainingPoint() once per point, but
+  // visits each tree node at most once for the whole batch. The callbacks
+  // are made in no particular order.
+  template<class Callback>
+  void ForEachIntervalContainingPoints(const std::vector<point_type> &sorted_queries,
+                                       const Callback &cb) const;
+
+  // Like FindContainingPoint(), but calls 'cb(interval)' for each result
+  // rather than collecting them, so that probing the tree allocates nothing.
+  // The callbacks are made in the order FindContainingPoint() returns.
+  template<class Callback>
+  void ForEachIntervalContainingPoint(const point_type &query,
+                                      const Callback &cb) const;
+
+  // Like FindIntersectingInterval(), but for the closed interval
+  // ['lower', 'upper'] given by its bounds, calling 'cb(interval)' for each
+  // result rather than collecting them.
+  template<class Callback>
+  void ForEachIntervalIntersecting(const point_type &lower,
+                                   const point_type &upper,
+                                   const Callback &cb) const;
+
  private:
   static void Partition(const IntervalVector &in,
                         point_type *split_point,
@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/io_latency_env.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/metrics.h"
+#include "kudu/util/path_util.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+METRIC_DECLARE_entity(storage_dir);
+METRIC_DECLARE_histogram(io_read_latency);
+METRIC_DECLARE_histogram(io_write_latency);
+METRIC_DECLARE_histogram(io_sync_latency);
+
+using std::string;
+
+namespace kudu {
+
+class IoLatencyEnvTest : public KuduTest {
+ protected:
+  scoped_refptr<Histogram> GetHistogram(const string& root,
+                                        const HistogramPrototype& proto) {
+    // Instantiating an existing entity or metric returns it.
+    scoped_refptr<MetricEntity> entity = METRIC_ENTITY_storage_dir.Instantiate(&registry_, root);
+    return proto.Instantiate(entity);
+  }
+
+  MetricRegistry registry_;
+};
+
+TEST_F(IoLatencyEnvTest, TestTimesFilesInDirectories) {
+  string timed_dir = GetTestPath("timed");
+  string untimed_dir = GetTestPath("untimed");
+  ASSERT_OK(env_->CreateDir(timed_dir));
+  ASSERT_OK(env_->CreateDir(untimed_dir));
+
+  IoLatencyEnv env(env_.get());
+  env.AddDirectory(timed_dir, "data", &registry_);
+  scoped_refptr<Histogram> reads = GetHistogram(timed_dir, METRIC_io_read_latency);
+  scoped_refptr<Histogram> writes = GetHistogram(timed_dir, METRIC_io_write_latency);
+  scoped_refptr<Histogram> syncs = GetHistogram(timed_dir, METRIC_io_sync_latency);
+
+  // A file outside the directory isn't timed.
+  ASSERT_OK(WriteStringToFile(&env, "hello", JoinPathSegments(untimed_dir, "file")));
+  ASSERT_EQ(0, writes->TotalCount());
+  ASSERT_EQ(0, syncs->TotalCount());
+
+  // Nor is one in a directory whose name merely starts with that of a timed one.
+  ASSERT_OK(env_->CreateDir(timed_dir + "2"));
+  ASSERT_OK(WriteStringToFile(&env, "hello", JoinPathSegments(timed_dir + "2", "file")));
+  ASSERT_EQ(0, writes->TotalCount());
+
+  // A file inside it is. Closing the file counts as a sync.
+  string path = JoinPathSegments(timed_dir, "file");
+  ASSERT_OK(WriteStringToFile(&env, "hello", path));
+  ASSERT_GT(writes->TotalCount(), 0);
+  ASSERT_GT(syncs->TotalCount(), 0);
+
+  gscoped_ptr<RandomAccessFile> raf;
+  ASSERT_OK(env.NewRandomAccessFile(path, &raf));
+  uint8_t scratch[5];
+  Slice result;
+  ASSERT_OK(raf->Read(0, sizeof(scratch), &result, scratch));
+  ASSERT_EQ("hello", result.ToString());
+  ASSERT_EQ(1, reads->TotalCount());
+
+  gscoped_ptr<RWFile> rwf;
+  ASSERT_OK(env.NewRWFile(path, &rwf));
+  uint64_t writes_before = writes->TotalCount();
+  ASSERT_OK(rwf->Write(5, " world"));
+  ASSERT_EQ(writes_before + 1, writes->TotalCount());
+  ASSERT_OK(rwf->Read(0, sizeof(scratch), &result, scratch));
+  ASSERT_EQ(2, reads->TotalCount());
+
+  uint64_t syncs_before = syncs->TotalCount();
+  ASSERT_OK(env.SyncDir(timed_dir));
+  ASSERT_EQ(syncs_before + 1, syncs->TotalCount());
+}
+
+} // namespace kudu
@@ -0,0 +1,445 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/io_latency_env.h"
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/strings/util.h"
+#include "kudu/util/flag_tags.h"
+#include "kudu/util/kernel_stack_watchdog.h"
+#include "kudu/util/logging.h"
+#include "kudu/util/metrics.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/sampling_profiler.h"
+#include "kudu/util/thread.h"
+
+DEFINE_int32(io_stall_threshold_ms, 500,
+             "Reads, writes and syncs of the files in the WAL and data directories "
+             "which take longer than this are logged and counted as stalls in the "
+             "metrics of their directory. 0 disables the logging.");
+TAG_FLAG(io_stall_threshold_ms, advanced);
+TAG_FLAG(io_stall_threshold_ms, runtime);
+
+METRIC_DEFINE_entity(storage_dir);
+
+METRIC_DEFINE_histogram(storage_dir, io_read_latency, "Read Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds spent reading files in the directory",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(storage_dir, io_write_latency, "Write Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds spent writing, preallocating, truncating and "
+                        "punching holes in files in the directory",
+                        60000000LU, 2);
+METRIC_DEFINE_histogram(storage_dir, io_sync_latency, "Sync Latency",
+                        kudu::MetricUnit::kMicroseconds,
+                        "Microseconds spent flushing, syncing and closing files in the "
+                        "directory, and syncing the directories themselves",
+                        60000000LU, 2);
+METRIC_DEFINE_counter(storage_dir, io_stalls, "I/O Stalls",
+                      kudu::MetricUnit::kOperations,
+                      "Number of reads, writes and syncs in the directory which took "
+                      "longer than --io_stall_threshold_ms");
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+struct IoLatencyEnv::Directory {
+  // With a trailing slash, for matching the paths under it.
+  string root;
+  scoped_refptr<MetricEntity> entity;
+  scoped_refptr<Histogram> read_latency;
+  scoped_refptr<Histogram> write_latency;
+  scoped_refptr<Histogram> sync_latency;
+  scoped_refptr<Counter> stalls;
+};
+
+namespace {
+
+typedef IoLatencyEnv::Directory Directory;
+
+enum IoOp {
+  kRead,
+  kWrite,
+  kSync
+};
+
+// Also the labels of the KernelStackWatchdog frames, which must outlive them.
+const char* const kIoOpNames[] = { "read", "write", "sync" };
+
+// Times an I/O operation on a file of 'dir' for as long as it's in scope.
+class ScopedIoTimer {
+ public:
+  ScopedIoTimer(const Directory* dir, IoOp op, const string& filename)
+      : dir_(dir),
+        op_(op),
+        filename_(filename),
+        threshold_ms_(FLAGS_io_stall_threshold_ms),
+        start_(MonoTime::Now(MonoTime::FINE)),
+        watch_(kIoOpNames[op], threshold_ms_) {
+  }
+
+  ~ScopedIoTimer() {
+    int64_t elapsed_us = MonoTime::Now(MonoTime::FINE).GetDeltaSince(start_).ToMicroseconds();
+    switch (op_) {
+      case kRead:
+        dir_->read_latency->Increment(elapsed_us);
+        break;
+      case kWrite:
+        dir_->write_latency->Increment(elapsed_us);
+        break;
+      case kSync:
+        dir_->sync_latency->Increment(elapsed_us);
+        break;
+    }
+    if (PREDICT_FALSE(threshold_ms_ > 0 && elapsed_us >= threshold_ms_ * 1000L)) {
+      dir_->stalls->Increment();
+      Thread* thread = Thread::current_thread();
+      const char* tag = ScopedSamplingProfilerTag::current_tag();
+      KLOG_EVERY_N_SECS(WARNING, 1)
+          << Substitute("I/O stall: $0 of $1 took $2ms (thread: $3, tag: $4)",
+                        kIoOpNames[op_], filename_, elapsed_us / 1000,
+                        thread ? thread->name() : "(unknown)", tag ? tag : "(none)")
+          << THROTTLE_MSG;
+    }
+  }
+
+ private:
+  const Directory* const dir_;
+  const IoOp op_;
+  const string& filename_;
+  const int threshold_ms_;
+  const MonoTime start_;
+  ScopedWatchKernelStack watch_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedIoTimer);
+};
+
+class TimedSequentialFile : public SequentialFile {
+ public:
+  TimedSequentialFile(const Directory* dir, gscoped_ptr<SequentialFile> file)
+      : dir_(dir), file_(std::move(file)) {
+  }
+
+  Status Read(size_t n, Slice* result, uint8_t* scratch) OVERRIDE {
+    ScopedIoTimer t(dir_, kRead, filename());
+    return file_->Read(n, result, scratch);
+  }
+
+  Status Skip(uint64_t n) OVERRIDE {
+    return file_->Skip(n);
+  }
+
+  const string& filename() const OVERRIDE {
+    return file_->filename();
+  }
+
+ private:
+  const Directory* const dir_;
+  const gscoped_ptr<SequentialFile> file_;
+};
+
+class TimedRandomAccessFile : public RandomAccessFile {
+ public:
+  TimedRandomAccessFile(const Directory* dir, gscoped_ptr<RandomAccessFile> file)
+      : dir_(dir), file_(std::move(file)) {
+  }
+
+  // ReadAsync() is left to the base class, which runs Read() on the
+  // asynchronous I/O pool, so that it's timed there.
+  Status Read(uint64_t offset, size_t n, Slice* result, uint8_t* scratch) const OVERRIDE {
+    ScopedIoTimer t(dir_, kRead, filename());
+    return file_->Read(offset, n, result, scratch);
+  }
+
+  Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    ScopedIoTimer t(dir_, kRead, filename());
+    return file_->ReadV(offset, results);
+  }
+
+  Status Size(uint64_t* size) const OVERRIDE {
+    return file_->Size(size);
+  }
+
+  Status Readahead(uint64_t offset, size_t length) const OVERRIDE {
+    return file_->Readahead(offset, length);
+  }
+
+  Status InvalidateCache(uint64_t offset, size_t length) const OVERRIDE {
+    return file_->InvalidateCache(offset, length);
+  }
+
+  const string& filename() const OVERRIDE {
+    return file_->filename();
+  }
+
+  size_t memory_footprint() const OVERRIDE {
+    return sizeof(*this) + file_->memory_footprint();
+  }
+
+ private:
+  const Directory* const dir_;
+  const gscoped_ptr<RandomAccessFile> file_;
+};
+
+class TimedWritableFile : public WritableFile {
+ public:
+  TimedWritableFile(const Directory* dir, gscoped_ptr<WritableFile> file)
+      : dir_(dir), file_(std::move(file)) {
+  }
+
+  Status Append(const Slice& data) OVERRIDE {
+    ScopedIoTimer t(dir_, kWrite, filename());
+    return file_->Append(data);
+  }
+
+  Status AppendVector(const vector<Slice>& data_vector) OVERRIDE {
+    ScopedIoTimer t(dir_, kWrite, filename());
+    return file_->AppendVector(data_vector);
+  }
+
+  Status PreAllocate(uint64_t size) OVERRIDE {
+    ScopedIoTimer t(dir_, kWrite, filename());
+    return file_->PreAllocate(size);
+  }
+
+  // Closing may sync the file, see WritableFileOptions::sync_on_close.
+  Status Close() OVERRIDE {
+    ScopedIoTimer t(dir_, kSync, filename());
+    return file_->Close();
+  }
+
+  Status Flush(FlushMode mode) OVERRIDE {
+    ScopedIoTimer t(dir_, kSync, filename());
+    return file_->Flush(mode);
+  }
+
+  Status Sync() OVERRIDE {
+    ScopedIoTimer t(dir_, kSync, filename());
+    return file_->Sync();
+  }
+
+  uint64_t Size() const OVERRIDE {
+    return file_->Size();
+  }
+
+  Status InvalidateCache(uint64_t offset, size_t length) OVERRIDE {
+    return file_->InvalidateCache(offset, length);
+  }
+
+  const string& filename() const OVERRIDE {
+    return file_->filename();
+  }
+
+ private:
+  const Directory* const dir_;
+  const gscoped_ptr<WritableFile> file_;
+};
+
+class TimedRWFile : public RWFile {
+ public:
+  TimedRWFile(const Directory* dir, gscoped_ptr<RWFile> file)
+      : dir_(dir), file_(std::move(file)) {
+  }
+
+  Status Read(uint64_t offset, size_t length,
+              Slice* result, uint8_t* scratch) const OVERRIDE {
+    ScopedIoTimer t(dir_, kRead, filename());
+    return file_->Read(offset, length, result, scratch);
+  }
+
+  Status ReadV(uint64_t offset, vector<Slice>* results) const OVERRIDE {
+    ScopedIoTimer t(dir_, kRead, filename());
+    return file_->ReadV(offset, results);
+  }
+
+  Status Readahead(uint64_t offset, size_t length) const OVERRIDE {
+    return file_->Readahead(offset, length);
+  }
+
+  Status InvalidateCache(uint64_t offset, size_t length) const OVERRIDE {
+    return file_->InvalidateCache(offset, length);
+  }
+
+  Status Write(uint64_t offset, const Slice& data) OVERRIDE {
+    ScopedIoTimer t(dir_, kWrite, filename());
+    return file_->Write(offset, data);
+  }
+
+  Status PreAllocate(uint64_t offset, size_t length) OVERRIDE {
+    ScopedIoTimer t(dir_, kWrite, filename());
+    return file_->PreAllocate(offset, length);
+  }
+
+  Status Truncate(uint64_t length) OVERRIDE {
+    ScopedIoTimer t(dir_, kWrite, filename());
+    return file_->Truncate(length);
+  }
+
+  Status PunchHole(uint64_t offset, size_t length) OVERRIDE {
+    ScopedIoTimer t(dir_, kWrite, filename());
+    return file_->PunchHole(offset, length);
+  }
+
+  Status Flush(FlushMode mode, uint64_t offset, size_t length) OVERRIDE {
+    ScopedIoTimer t(dir_, kSync, filename());
+    return file_->Flush(mode, offset, length);
+  }
+
+  Status Sync() OVERRIDE {
+    ScopedIoTimer t(dir_, kSync, filename());
+    return file_->Sync();
+  }
+
+  // Closing may sync the file, see RWFileOptions::sync_on_close.
+  Status Close() OVERRIDE {
+    ScopedIoTimer t(dir_, kSync, filename());
+    return file_->Close();
+  }
+
+  Status Size(uint64_t* size) const OVERRIDE {
+    return file_->Size(size);
+  }
+
+  const string& filename() const OVERRIDE {
+    return file_->filename();
+  }
+
+ private:
+  const Directory* const dir_;
+  const gscoped_ptr<RWFile> file_;
+};
+
+// Wraps '*file' in a 'TimedFile' if it's in 'dir'.
+template<class FileType, class TimedFile>
+void MaybeWrap(const Directory* dir, gscoped_ptr<FileType>* file) {
+  if (dir) {
+    file->reset(new TimedFile(dir, std::move(*file)));
+  }
+}
+
+} // anonymous namespace
+
+IoLatencyEnv::IoLatencyEnv(Env* target)
+    : EnvWrapper(target) {
+}
+
+IoLatencyEnv::~IoLatencyEnv() {
+}
+
+void IoLatencyEnv::AddDirectory(const string& root, const string& roles,
+                                MetricRegistry* registry) {
+  std::unique_ptr<Directory> dir(new Directory);
+  dir->root = HasSuffixString(root, "/") ? root : root + "/";
+  dir->entity = METRIC_ENTITY_storage_dir.Instantiate(registry, root,
+                                                      { { "path", root }, { "roles", roles } });
+  dir->read_latency = METRIC_io_read_latency.Instantiate(dir->entity);
+  dir->write_latency = METRIC_io_write_latency.Instantiate(dir->entity);
+  dir->sync_latency = METRIC_io_sync_latency.Instantiate(dir->entity);
+  dir->stalls = METRIC_io_stalls.Instantiate(dir->entity);
+  dirs_.emplace_back(std::move(dir));
+}
+
+const IoLatencyEnv::Directory* IoLatencyEnv::FindDirectory(const string& path) const {
+  const Directory* found = nullptr;
+  for (const auto& dir : dirs_) {
+    if ((HasPrefixString(path, dir->root) || path + "/" == dir->root) &&
+        (!found || dir->root.size() > found->root.size())) {
+      found = dir.get();
+    }
+  }
+  return found;
+}
+
+Status IoLatencyEnv::NewSequentialFile(const string& fname,
+                                       gscoped_ptr<SequentialFile>* result) {
+  RETURN_NOT_OK(target()->NewSequentialFile(fname, result));
+  MaybeWrap<SequentialFile, TimedSequentialFile>(FindDirectory(fname), result);
+  return Status::OK();
+}
+
+Status IoLatencyEnv::NewRandomAccessFile(const string& fname,
+                                         gscoped_ptr<RandomAccessFile>* result) {
+  return NewRandomAccessFile(RandomAccessFileOptions(), fname, result);
+}
+
+Status IoLatencyEnv::NewRandomAccessFile(const RandomAccessFileOptions& opts,
+                                         const string& fname,
+                                         gscoped_ptr<RandomAccessFile>* result) {
+  RETURN_NOT_OK(target()->NewRandomAccessFile(opts, fname, result));
+  MaybeWrap<RandomAccessFile, TimedRandomAccessFile>(FindDirectory(fname), result);
+  return Status::OK();
+}
+
+Status IoLatencyEnv::NewWritableFile(const string& fname,
+                                     gscoped_ptr<WritableFile>* result) {
+  return NewWritableFile(WritableFileOptions(), fname, result);
+}
+
+Status IoLatencyEnv::NewWritableFile(const WritableFileOptions& opts,
+                                     const string& fname,
+                                     gscoped_ptr<WritableFile>* result) {
+  RETURN_NOT_OK(target()->NewWritableFile(opts, fname, result));
+  MaybeWrap<WritableFile, TimedWritableFile>(FindDirectory(fname), result);
+  return Status::OK();
+}
+
+Status IoLatencyEnv::NewTempWritableFile(const WritableFileOptions& opts,
+                                         const string& name_template,
+                                         string* created_filename,
+                                         gscoped_ptr<WritableFile>* result) {
+  RETURN_NOT_OK(target()->NewTempWritableFile(opts, name_template, created_filename, result));
+  MaybeWrap<WritableFile, TimedWritableFile>(FindDirectory(*created_filename), result);
+  return Status::OK();
+}
+
+Status IoLatencyEnv::NewRWFile(const string& fname, gscoped_ptr<RWFile>* result) {
+  return NewRWFile(RWFileOptions(), fname, result);
+}
+
+Status IoLatencyEnv::NewRWFile(const RWFileOptions& opts,
+                               const string& fname,
+                               gscoped_ptr<RWFile>* result) {
+  RETURN_NOT_OK(target()->NewRWFile(opts, fname, result));
+  MaybeWrap<RWFile, TimedRWFile>(FindDirectory(fname), result);
+  return Status::OK();
+}
+
+Status IoLatencyEnv::NewTempRWFile(const RWFileOptions& opts, const string& name_template,
+                                   string* created_filename, gscoped_ptr<RWFile>* result) {
+  RETURN_NOT_OK(target()->NewTempRWFile(opts, name_template, created_filename, result));
+  MaybeWrap<RWFile, TimedRWFile>(FindDirectory(*created_filename), result);
+  return Status::OK();
+}
+
+Status IoLatencyEnv::SyncDir(const string& dirname) {
+  const Directory* dir = FindDirectory(dirname);
+  if (!dir) {
+    return target()->SyncDir(dirname);
+  }
+  ScopedIoTimer t(dir, kSync, dirname);
+  return target()->SyncDir(dirname);
+}
+
+} // namespace kudu
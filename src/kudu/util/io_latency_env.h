@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_IO_LATENCY_ENV_H
+#define KUDU_UTIL_IO_LATENCY_ENV_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/env.h"
+
+namespace kudu {
+
+class MetricRegistry;
+
+// An Env which times the reads, writes and syncs of the files under a set of
+// storage directories, such as the WAL and data directories of a server, so
+// that a slow disk can be told apart from slow code.
+//
+// Each directory gets a 'storage_dir' metric entity of its own, with
+// histograms of its read, write and sync latencies and a count of the
+// operations which took longer than --io_stall_threshold_ms. Such stalls are
+// also logged, along with the file, the thread and its sampling profiler tag,
+// if any. While an operation is in progress, it's watched by the
+// KernelStackWatchdog with the same threshold, so that the kernel stack of a
+// thread stuck in the middle of one is logged too.
+//
+// Files outside the directories, and files opened before their directory is
+// added, are not timed.
+class IoLatencyEnv : public EnvWrapper {
+ public:
+  // The state of one of the directories.
+  struct Directory;
+
+  explicit IoLatencyEnv(Env* target);
+  ~IoLatencyEnv();
+
+  // Starts timing the files under 'root', into the metrics of a new entity of
+  // 'registry' whose 'roles' attribute is set to 'roles', e.g. "wal,data".
+  //
+  // Not thread-safe: all the directories must be added before the Env is used
+  // by more than one thread.
+  void AddDirectory(const std::string& root, const std::string& roles,
+                    MetricRegistry* registry);
+
+  Status NewSequentialFile(const std::string& fname,
+                           gscoped_ptr<SequentialFile>* result) OVERRIDE;
+  Status NewRandomAccessFile(const std::string& fname,
+                             gscoped_ptr<RandomAccessFile>* result) OVERRIDE;
+  Status NewRandomAccessFile(const RandomAccessFileOptions& opts,
+                             const std::string& fname,
+                             gscoped_ptr<RandomAccessFile>* result) OVERRIDE;
+  Status NewWritableFile(const std::string& fname,
+                         gscoped_ptr<WritableFile>* result) OVERRIDE;
+  Status NewWritableFile(const WritableFileOptions& opts,
+                         const std::string& fname,
+                         gscoped_ptr<WritableFile>* result) OVERRIDE;
+  Status NewTempWritableFile(const WritableFileOptions& opts,
+                             const std::string& name_template,
+                             std::string* created_filename,
+                             gscoped_ptr<WritableFile>* result) OVERRIDE;
+  Status NewRWFile(const std::string& fname,
+                   gscoped_ptr<RWFile>* result) OVERRIDE;
+  Status NewRWFile(const RWFileOptions& opts,
+                   const std::string& fname,
+                   gscoped_ptr<RWFile>* result) OVERRIDE;
+  Status NewTempRWFile(const RWFileOptions& opts, const std::string& name_template,
+                       std::string* created_filename, gscoped_ptr<RWFile>* result) OVERRIDE;
+  Status SyncDir(const std::string& dirname) OVERRIDE;
+
+ private:
+  // Returns the innermost directory holding 'path', or null if none does.
+  const Directory* FindDirectory(const std::string& path) const;
+
+  std::vector<std::unique_ptr<Directory>> dirs_;
+
+  DISALLOW_COPY_AND_ASSIGN(IoLatencyEnv);
+};
+
+} // namespace kudu
+
+#endif /* KUDU_UTIL_IO_LATENCY_ENV_H */
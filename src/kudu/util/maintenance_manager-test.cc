@@ -34,6 +34,10 @@ using std::shared_ptr;
 using std::vector;
 using strings::Substitute;
 
+DECLARE_int64(maintenance_manager_disk_io_budget_mb);
+DECLARE_bool(maintenance_manager_prefer_idle_disks);
+DECLARE_double(maintenance_manager_max_read_amplification_boost);
+
 METRIC_DEFINE_entity(test);
 METRIC_DEFINE_gauge_uint32(test, maintenance_ops_running,
                            "Number of Maintenance Operations Running",
@@ -91,7 +95,10 @@ class TestMaintenanceOp : public MaintenanceOp {
       state_(state),
       consumption_(tracker, 500),
       logs_retained_bytes_(0),
+      data_retained_bytes_(0),
       perf_improvement_(0),
+      read_amplification_(0),
+      io_bytes_(0),
       metric_entity_(METRIC_ENTITY_test.Instantiate(&metric_registry_, "test")),
       maintenance_op_duration_(METRIC_maintenance_op_duration.Instantiate(metric_entity_)),
       maintenance_ops_running_(METRIC_maintenance_ops_running.Instantiate(metric_entity_, 0)) {
@@ -123,7 +130,13 @@ class TestMaintenanceOp : public MaintenanceOp {
     stats->set_runnable(state_ == OP_RUNNABLE);
     stats->set_ram_anchored(consumption_.consumption());
     stats->set_logs_retained_bytes(logs_retained_bytes_);
+    stats->set_data_retained_bytes(data_retained_bytes_);
     stats->set_perf_improvement(perf_improvement_);
+    stats->set_read_amplification(read_amplification_);
+    stats->set_io_bytes(io_bytes_);
+    if (!data_dir_.empty()) {
+      stats->add_data_dir(data_dir_);
+    }
   }
 
   void Enable() {
@@ -166,11 +179,27 @@ class TestMaintenanceOp : public MaintenanceOp {
     logs_retained_bytes_ = logs_retained_bytes;
   }
 
+  void set_data_retained_bytes(int64_t data_retained_bytes) {
+    std::lock_guard<Mutex> guard(lock_);
+    data_retained_bytes_ = data_retained_bytes;
+  }
+
   void set_perf_improvement(uint64_t perf_improvement) {
     std::lock_guard<Mutex> guard(lock_);
     perf_improvement_ = perf_improvement;
   }
 
+  void set_read_amplification(double read_amplification) {
+    std::lock_guard<Mutex> guard(lock_);
+    read_amplification_ = read_amplification;
+  }
+
+  void set_io(const std::string& data_dir, int64_t io_bytes) {
+    std::lock_guard<Mutex> guard(lock_);
+    data_dir_ = data_dir;
+    io_bytes_ = io_bytes;
+  }
+
   virtual scoped_refptr<Histogram> DurationHistogram() const OVERRIDE {
     return maintenance_op_duration_;
   }
@@ -185,7 +214,11 @@ class TestMaintenanceOp : public MaintenanceOp {
   enum TestMaintenanceOpState state_;
   ScopedTrackedConsumption consumption_;
   uint64_t logs_retained_bytes_;
+  int64_t data_retained_bytes_;
   uint64_t perf_improvement_;
+  double read_amplification_;
+  std::string data_dir_;
+  int64_t io_bytes_;
   MetricRegistry metric_registry_;
   scoped_refptr<MetricEntity> metric_entity_;
   scoped_refptr<Histogram> maintenance_op_duration_;
@@ -261,6 +294,156 @@ TEST_F(MaintenanceManagerTest, TestLogRetentionPrioritization) {
   manager_->UnregisterOp(&op2);
 }
 
+// Test that, among ops which free logs, the RAM they anchor counts for more as
+// memory fills up.
+TEST_F(MaintenanceManagerTest, TestAnchoredCostPrioritization) {
+  manager_->Shutdown();
+
+  // Like a small DeltaMemStore anchored further back in the log...
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op1.set_ram_anchored(0);
+  op1.set_logs_retained_bytes(200);
+
+  // ...and a MemRowSet which anchors more memory but less log.
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op2.set_ram_anchored(100);
+  op2.set_logs_retained_bytes(100);
+
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+
+  // At 10% of the memory limit, op2 costs 100 + 100 * 0.1 = 110, less than op1.
+  ASSERT_EQ(&op1, manager_->FindBestOp());
+
+  // At 40%, op2 costs 100 + 400 * 0.4 = 260.
+  op2.set_ram_anchored(400);
+  ASSERT_EQ(&op2, manager_->FindBestOp());
+
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+}
+
+// Test that the measured read amplification boosts perf improvement scores,
+// up to a limit.
+TEST_F(MaintenanceManagerTest, TestReadAmplificationBoost) {
+  manager_->Shutdown();
+
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op1.set_ram_anchored(0);
+  op1.set_perf_improvement(10);
+
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op2.set_ram_anchored(0);
+  op2.set_perf_improvement(4);
+  op2.set_read_amplification(3);
+
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+
+  ASSERT_EQ(&op2, manager_->FindBestOp());
+
+  FLAGS_maintenance_manager_max_read_amplification_boost = 2;
+  ASSERT_EQ(&op1, manager_->FindBestOp());
+
+  manager_->UnregisterOp(&op1);
+  manager_->UnregisterOp(&op2);
+}
+
+// Test that ops which reclaim data disk space go after those which free logs,
+// but before those which only improve performance.
+TEST_F(MaintenanceManagerTest, TestDataRetentionPrioritization) {
+  manager_->Shutdown();
+
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op1.set_ram_anchored(0);
+  op1.set_perf_improvement(10);
+
+  TestMaintenanceOp op2("op2", MaintenanceOp::LOW_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op2.set_ram_anchored(0);
+  op2.set_data_retained_bytes(100);
+
+  TestMaintenanceOp op3("op3", MaintenanceOp::LOW_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op3.set_ram_anchored(0);
+  op3.set_data_retained_bytes(200);
+
+  TestMaintenanceOp op4("op4", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op4.set_ram_anchored(0);
+  op4.set_logs_retained_bytes(100);
+
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+  manager_->RegisterOp(&op3);
+  manager_->RegisterOp(&op4);
+
+  ASSERT_EQ(&op4, manager_->FindBestOp());
+  manager_->UnregisterOp(&op4);
+
+  ASSERT_EQ(&op3, manager_->FindBestOp());
+  manager_->UnregisterOp(&op3);
+
+  ASSERT_EQ(&op2, manager_->FindBestOp());
+  manager_->UnregisterOp(&op2);
+
+  ASSERT_EQ(&op1, manager_->FindBestOp());
+  manager_->UnregisterOp(&op1);
+}
+
+// Test that perf-improving ops on idle disks are preferred, and that the
+// per-disk I/O budget holds back ops on busy disks.
+TEST_F(MaintenanceManagerTest, TestPreferIdleDisks) {
+  manager_->Shutdown();
+  const int64_t kMb = 1024 * 1024;
+
+  TestMaintenanceOp op1("op1", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op1.set_ram_anchored(0);
+  op1.set_perf_improvement(10);
+  op1.set_io("/data/a", kMb);
+
+  TestMaintenanceOp op2("op2", MaintenanceOp::HIGH_IO_USAGE, OP_RUNNABLE, test_tracker_);
+  op2.set_ram_anchored(0);
+  op2.set_perf_improvement(1);
+  op2.set_io("/data/b", kMb);
+
+  manager_->RegisterOp(&op1);
+  manager_->RegisterOp(&op2);
+
+  // With both disks idle, the best op wins.
+  ASSERT_EQ(&op1, manager_->FindBestOp());
+
+  // Once another op is running on op1's disk, op2 is preferred.
+  MaintenanceManager::OpIOCost cost;
+  cost.data_dirs.insert("/data/a");
+  cost.io_bytes = kMb;
+  manager_->ChargeDiskIO(cost);
+  ASSERT_EQ(&op2, manager_->FindBestOp());
+
+  // Without the preference and without a budget, disks don't matter.
+  FLAGS_maintenance_manager_prefer_idle_disks = false;
+  ASSERT_EQ(&op1, manager_->FindBestOp());
+
+  // With a budget that op1 would exceed, it is held back...
+  FLAGS_maintenance_manager_disk_io_budget_mb = 1;
+  ASSERT_EQ(&op2, manager_->FindBestOp());
+
+  // ...and if nothing else fits, nothing runs.
+  manager_->UnregisterOp(&op2);
+  ASSERT_TRUE(manager_->FindBestOp() == nullptr);
+
+  // When the disk drains, op1 runs regardless of its size.
+  manager_->ReleaseDiskIO(cost);
+  op1.set_io("/data/a", 10 * kMb);
+  ASSERT_EQ(&op1, manager_->FindBestOp());
+
+  MaintenanceManagerStatusPB status_pb;
+  manager_->GetMaintenanceManagerStatusDump(&status_pb);
+  ASSERT_EQ(1, status_pb.registered_operations_size());
+  ASSERT_EQ(10 * kMb, status_pb.registered_operations(0).io_bytes());
+  ASSERT_EQ(1, status_pb.registered_operations(0).data_dirs_size());
+  ASSERT_EQ(0, status_pb.disk_loads_size());
+
+  manager_->UnregisterOp(&op1);
+}
+
 // Test adding operations and make sure that the history of recently completed operations
 // is correct in that it wraps around and doesn't grow.
 TEST_F(MaintenanceManagerTest, TestCompletedOpsHistory) {
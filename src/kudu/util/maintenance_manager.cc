@@ -17,21 +17,27 @@
 
 #include "kudu/util/maintenance_manager.h"
 
+#include <algorithm>
 #include <gflags/gflags.h>
 #include <memory>
 #include <stdint.h>
 #include <string>
 #include <utility>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/gutil/stringprintf.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/background_io_throttle.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/debug/trace_logging.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/mem_tracker.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/sampling_profiler.h"
 #include "kudu/util/stopwatch.h"
 #include "kudu/util/thread.h"
+#include "kudu/util/trace_metrics.h"
 
 using std::pair;
 using std::shared_ptr;
@@ -56,6 +62,27 @@ DEFINE_bool(enable_maintenance_manager, true,
        "Enable the maintenance manager, runs compaction and tablet cleaning tasks.");
 TAG_FLAG(enable_maintenance_manager, unsafe);
 
+DEFINE_int64(maintenance_manager_disk_io_budget_mb, 0,
+       "Maximum number of megabytes of estimated maintenance I/O that may be in flight "
+       "on a single data directory. An op whose data directories would exceed the "
+       "budget is held back unless the directories are otherwise idle. 0 means "
+       "unlimited.");
+TAG_FLAG(maintenance_manager_disk_io_budget_mb, experimental);
+TAG_FLAG(maintenance_manager_disk_io_budget_mb, runtime);
+
+DEFINE_bool(maintenance_manager_prefer_idle_disks, true,
+       "When choosing between ops that improve performance, prefer one whose data "
+       "directories have no maintenance ops running over a better-scoring op on a "
+       "busy directory.");
+TAG_FLAG(maintenance_manager_prefer_idle_disks, experimental);
+TAG_FLAG(maintenance_manager_prefer_idle_disks, runtime);
+
+DEFINE_double(maintenance_manager_max_read_amplification_boost, 4.0,
+       "Maximum factor by which the measured read amplification of a tablet may boost "
+       "the perf_improvement score of a compaction op on it. 1 disables the boost.");
+TAG_FLAG(maintenance_manager_max_read_amplification_boost, experimental);
+TAG_FLAG(maintenance_manager_max_read_amplification_boost, runtime);
+
 namespace kudu {
 
 MaintenanceOpStats::MaintenanceOpStats() {
@@ -67,7 +94,11 @@ void MaintenanceOpStats::Clear() {
   runnable_ = false;
   ram_anchored_ = 0;
   logs_retained_bytes_ = 0;
+  data_retained_bytes_ = 0;
   perf_improvement_ = 0;
+  read_amplification_ = 0;
+  io_bytes_ = 0;
+  data_dirs_.clear();
 }
 
 MaintenanceOp::MaintenanceOp(std::string name, IOUsage io_usage)
@@ -99,6 +130,7 @@ MaintenanceManager::MaintenanceManager(const Options& options)
     polling_interval_ms_(options.polling_interval_ms <= 0 ?
           FLAGS_maintenance_manager_polling_interval_ms :
           options.polling_interval_ms),
+    next_requested_pass_micros_(0),
     completed_ops_count_(0),
     parent_mem_tracker_(!options.parent_mem_tracker ?
         MemTracker::GetRootTracker() : options.parent_mem_tracker) {
@@ -179,6 +211,18 @@ void MaintenanceManager::UnregisterOp(MaintenanceOp* op) {
   op->manager_.reset();
 }
 
+void MaintenanceManager::RequestSchedulingPass() {
+  int64_t now = GetMonoTimeMicros();
+  int64_t next = next_requested_pass_micros_.load(std::memory_order_relaxed);
+  if (now < next ||
+      !next_requested_pass_micros_.compare_exchange_strong(
+          next, now + polling_interval_ms_ * 1000L)) {
+    return;
+  }
+  std::lock_guard<Mutex> guard(lock_);
+  cond_.Signal();
+}
+
 void MaintenanceManager::RunSchedulerThread() {
   MonoDelta polling_interval = MonoDelta::FromMilliseconds(polling_interval_ms_);
 
@@ -198,6 +242,14 @@ void MaintenanceManager::RunSchedulerThread() {
       continue;
     }
 
+    // Charge the op's I/O to its disks before dropping the lock, so that
+    // the next scheduling pass already sees them as busy.
+    const MaintenanceOpStats& stats = FindOrDie(ops_, op);
+    OpIOCost cost;
+    cost.data_dirs = stats.data_dirs();
+    cost.io_bytes = stats.io_bytes();
+    ChargeDiskIO(cost);
+
     // Prepare the maintenance operation.
     op->running_++;
     running_ops_++;
@@ -207,6 +259,8 @@ void MaintenanceManager::RunSchedulerThread() {
     if (!ready) {
       LOG(INFO) << "Prepare failed for " << op->name()
                 << ".  Re-running scheduler.";
+      ReleaseDiskIO(cost);
+      running_ops_--;
       op->running_--;
       op->cond_->Signal();
       continue;
@@ -214,7 +268,7 @@ void MaintenanceManager::RunSchedulerThread() {
 
     // Run the maintenance operation.
     Status s = thread_pool_->SubmitFunc(boost::bind(
-          &MaintenanceManager::LaunchOp, this, op));
+          &MaintenanceManager::LaunchOp, this, op, cost));
     CHECK(s.ok());
   }
 }
@@ -223,10 +277,20 @@ void MaintenanceManager::RunSchedulerThread() {
 // - If there's an Op that we can run quickly that frees log retention, we run it.
 // - If we've hit the overall process memory limit (note: this includes memory that the Ops cannot
 //   free), we run the Op with the highest RAM usage.
-// - If there are Ops that retain logs, we run the one that has the highest retention (and if many
-//   qualify, then we run the one that also frees up the most RAM).
+// - If there are Ops that retain logs, we run the one with the highest anchored cost: the logs it
+//   retains (which are also what bootstrap would have to replay), plus the RAM it anchors weighted
+//   by how close we are to the memory limit. That way a flush of a huge MemRowSet isn't put off
+//   behind flushes of tiny DeltaMemStores that happen to be anchored a little further back.
+// - If there are Ops that keep data disk space from being reclaimed, we run the one that can
+//   reclaim the most.
 // - Finally, if there's nothing else that we really need to do, we run the Op that will improve
-//   performance the most.
+//   performance the most. Compactions get their score boosted by the read amplification measured
+//   on their tablet. Here the data directories the Ops declared come into play: an Op whose
+//   directories are all idle is preferred over a better-scoring Op on a busy directory, and an Op
+//   that would push one of its directories over the per-disk I/O budget is not run at all.
+//
+// The urgent filters ignore the disks: running out of memory or log space is worse than
+// contending for a spindle.
 //
 // The reason it's done this way is that we want to prioritize limiting the amount of resources we
 // hold on to. Low IO Ops go first since we can quickly run them, then we can look at memory usage.
@@ -234,10 +298,6 @@ void MaintenanceManager::RunSchedulerThread() {
 //
 // In the third priority we're at a point where nothing's urgent and there's nothing we can run
 // quickly.
-// TODO We currently optimize for freeing log retention but we could consider having some sort of
-// sliding priority between log retention and RAM usage. For example, is an Op that frees
-// 128MB of log retention and 12MB of RAM always better than an op that frees 12MB of log retention
-// and 128MB of RAM? Maybe a more holistic approach would be better.
 MaintenanceOp* MaintenanceManager::FindBestOp() {
   TRACE_EVENT0("maintenance", "MaintenanceManager::FindBestOp");
 
@@ -257,12 +317,23 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
   uint64_t most_mem_anchored = 0;
   MaintenanceOp* most_mem_anchored_op = nullptr;
 
-  int64_t most_logs_retained_bytes = 0;
-  int64_t most_logs_retained_bytes_ram_anchored = 0;
-  MaintenanceOp* most_logs_retained_bytes_op = nullptr;
+  const double memory_pressure = MemoryPressure();
+  double most_anchored_cost = 0;
+  int64_t most_anchored_cost_ram_anchored = 0;
+  MaintenanceOp* most_anchored_cost_op = nullptr;
+
+  int64_t most_data_retained_bytes = 0;
+  MaintenanceOp* most_data_retained_bytes_op = nullptr;
 
   double best_perf_improvement = 0;
   MaintenanceOp* best_perf_improvement_op = nullptr;
+
+  // The best-scoring ops that fit the per-disk I/O budget, and that only
+  // touch idle disks.
+  double best_in_budget_perf_improvement = 0;
+  MaintenanceOp* best_in_budget_op = nullptr;
+  double best_idle_perf_improvement = 0;
+  MaintenanceOp* best_idle_op = nullptr;
   for (OpMapTy::value_type &val : ops_) {
     MaintenanceOp* op(val.first);
     MaintenanceOpStats& stats(val.second);
@@ -282,20 +353,38 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
       most_mem_anchored_op = op;
       most_mem_anchored = stats.ram_anchored();
     }
-    // We prioritize ops that can free more logs, but when it's the same we pick the one that
-    // also frees up the most memory.
-    if (stats.logs_retained_bytes() > 0 &&
-        (stats.logs_retained_bytes() > most_logs_retained_bytes ||
-            (stats.logs_retained_bytes() == most_logs_retained_bytes &&
-                stats.ram_anchored() > most_logs_retained_bytes_ram_anchored))) {
-      most_logs_retained_bytes_op = op;
-      most_logs_retained_bytes = stats.logs_retained_bytes();
-      most_logs_retained_bytes_ram_anchored = stats.ram_anchored();
+    // Among the ops that can free logs, we prioritize the ones that cost the most to keep
+    // around, and when it's the same we pick the one that frees up the most memory.
+    if (stats.logs_retained_bytes() > 0) {
+      double cost = AnchoredCost(stats, memory_pressure);
+      if (cost > most_anchored_cost ||
+          (cost == most_anchored_cost &&
+              stats.ram_anchored() > most_anchored_cost_ram_anchored)) {
+        most_anchored_cost_op = op;
+        most_anchored_cost = cost;
+        most_anchored_cost_ram_anchored = stats.ram_anchored();
+      }
     }
+    if (stats.data_retained_bytes() > most_data_retained_bytes) {
+      most_data_retained_bytes_op = op;
+      most_data_retained_bytes = stats.data_retained_bytes();
+    }
+    double perf_improvement = AdjustedPerfImprovement(stats);
     if ((!best_perf_improvement_op) ||
-        (stats.perf_improvement() > best_perf_improvement)) {
+        (perf_improvement > best_perf_improvement)) {
       best_perf_improvement_op = op;
-      best_perf_improvement = stats.perf_improvement();
+      best_perf_improvement = perf_improvement;
+    }
+    if (perf_improvement > 0 && FitsDiskIOBudget(stats)) {
+      if (!best_in_budget_op || perf_improvement > best_in_budget_perf_improvement) {
+        best_in_budget_op = op;
+        best_in_budget_perf_improvement = perf_improvement;
+      }
+      if (OnIdleDisks(stats) &&
+          (!best_idle_op || perf_improvement > best_idle_perf_improvement)) {
+        best_idle_op = op;
+        best_idle_perf_improvement = perf_improvement;
+      }
     }
   }
 
@@ -328,31 +417,117 @@ MaintenanceOp* MaintenanceManager::FindBestOp() {
     return most_mem_anchored_op;
   }
 
-  if (most_logs_retained_bytes_op) {
+  if (most_anchored_cost_op) {
     VLOG_AND_TRACE("maintenance", 1)
-            << "Performing " << most_logs_retained_bytes_op->name() << ", "
-            << "because it can free up more logs " << "at " << most_logs_retained_bytes
+            << "Performing " << most_anchored_cost_op->name() << ", "
+            << "because it can free up more logs and memory, "
+            << "at an anchored cost of " << most_anchored_cost << " bytes";
+    return most_anchored_cost_op;
+  }
+
+  if (most_data_retained_bytes_op) {
+    VLOG_AND_TRACE("maintenance", 1)
+            << "Performing " << most_data_retained_bytes_op->name() << ", "
+            << "because it can free up more data " << "at " << most_data_retained_bytes
             << " bytes";
-    return most_logs_retained_bytes_op;
+    return most_data_retained_bytes_op;
   }
 
-  if (best_perf_improvement_op) {
-    if (best_perf_improvement > 0) {
-      VLOG_AND_TRACE("maintenance", 1) << "Performing " << best_perf_improvement_op->name() << ", "
-                 << "because it had the best perf_improvement score, "
-                 << "at " << best_perf_improvement;
-      return best_perf_improvement_op;
-    }
+  if (FLAGS_maintenance_manager_prefer_idle_disks && best_idle_op) {
+    VLOG_AND_TRACE("maintenance", 1) << "Performing " << best_idle_op->name() << ", "
+               << "because it had the best perf_improvement score among ops on idle disks, "
+               << "at " << best_idle_perf_improvement;
+    return best_idle_op;
+  }
+
+  if (best_in_budget_op) {
+    VLOG_AND_TRACE("maintenance", 1) << "Performing " << best_in_budget_op->name() << ", "
+               << "because it had the best perf_improvement score, "
+               << "at " << best_in_budget_perf_improvement;
+    return best_in_budget_op;
+  }
+
+  if (best_perf_improvement_op && best_perf_improvement > 0) {
+    VLOG_AND_TRACE("maintenance", 1) << "Not performing " << best_perf_improvement_op->name()
+               << " because its data directories are over their I/O budget";
   }
   return nullptr;
 }
 
-void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
+double MaintenanceManager::AnchoredCost(const MaintenanceOpStats& stats,
+                                        double memory_pressure) {
+  return stats.logs_retained_bytes() + stats.ram_anchored() * memory_pressure;
+}
+
+double MaintenanceManager::AdjustedPerfImprovement(const MaintenanceOpStats& stats) {
+  double boost = std::min(std::max(stats.read_amplification(), 1.0),
+                          std::max(FLAGS_maintenance_manager_max_read_amplification_boost, 1.0));
+  return stats.perf_improvement() * boost;
+}
+
+double MaintenanceManager::MemoryPressure() const {
+  if (!parent_mem_tracker_->has_limit() || parent_mem_tracker_->limit() == 0) {
+    return 0;
+  }
+  return static_cast<double>(parent_mem_tracker_->consumption()) / parent_mem_tracker_->limit();
+}
+
+bool MaintenanceManager::OnIdleDisks(const MaintenanceOpStats& stats) const {
+  for (const string& dir : stats.data_dirs()) {
+    const DiskLoad* load = FindOrNull(disk_load_, dir);
+    if (load && load->running_ops > 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MaintenanceManager::FitsDiskIOBudget(const MaintenanceOpStats& stats) const {
+  int64_t budget_bytes = FLAGS_maintenance_manager_disk_io_budget_mb * 1024 * 1024;
+  if (budget_bytes <= 0) {
+    return true;
+  }
+  for (const string& dir : stats.data_dirs()) {
+    const DiskLoad* load = FindOrNull(disk_load_, dir);
+    if (load && load->running_ops > 0 &&
+        load->io_bytes + stats.io_bytes() > budget_bytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void MaintenanceManager::ChargeDiskIO(const OpIOCost& cost) {
+  for (const string& dir : cost.data_dirs) {
+    DiskLoad* load = &disk_load_[dir];
+    load->running_ops++;
+    load->io_bytes += cost.io_bytes;
+  }
+}
+
+void MaintenanceManager::ReleaseDiskIO(const OpIOCost& cost) {
+  for (const string& dir : cost.data_dirs) {
+    DiskLoadMap::iterator it = disk_load_.find(dir);
+    DCHECK(it != disk_load_.end()) << dir;
+    it->second.running_ops--;
+    it->second.io_bytes -= cost.io_bytes;
+    if (it->second.running_ops == 0) {
+      disk_load_.erase(it);
+    }
+  }
+}
+
+void MaintenanceManager::LaunchOp(MaintenanceOp* op, const OpIOCost& cost) {
   MonoTime start_time(MonoTime::Now(MonoTime::FINE));
   op->RunningGauge()->Increment();
   LOG_TIMING(INFO, Substitute("running $0", op->name())) {
     TRACE_EVENT1("maintenance", "MaintenanceManager::LaunchOp",
                  "name", op->name());
+    BackgroundIOThrottle::ScopedBackgroundIO background_io;
+    // Tag the profiler's samples with the kind of operation, leaving out the
+    // tablet it runs for.
+    ScopedSamplingProfilerTag profiler_tag(
+        TraceMetrics::InternName(op->name().substr(0, op->name().find('('))));
     op->Perform();
   }
   op->RunningGauge()->Decrement();
@@ -368,6 +543,7 @@ void MaintenanceManager::LaunchOp(MaintenanceOp* op) {
 
   op->DurationHistogram()->Increment(delta.ToMilliseconds());
 
+  ReleaseDiskIO(cost);
   running_ops_--;
   op->running_--;
   op->cond_->Signal();
@@ -387,12 +563,20 @@ void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatu
       op_pb->set_runnable(stat.runnable());
       op_pb->set_ram_anchored_bytes(stat.ram_anchored());
       op_pb->set_logs_retained_bytes(stat.logs_retained_bytes());
+      op_pb->set_data_retained_bytes(stat.data_retained_bytes());
       op_pb->set_perf_improvement(stat.perf_improvement());
+      op_pb->set_read_amplification(stat.read_amplification());
+      op_pb->set_io_bytes(stat.io_bytes());
+      for (const string& dir : stat.data_dirs()) {
+        op_pb->add_data_dirs(dir);
+      }
     } else {
       op_pb->set_runnable(false);
       op_pb->set_ram_anchored_bytes(0);
       op_pb->set_logs_retained_bytes(0);
+      op_pb->set_data_retained_bytes(0);
       op_pb->set_perf_improvement(0.0);
+      op_pb->set_io_bytes(0);
     }
 
     if (best_op == op) {
@@ -400,6 +584,13 @@ void MaintenanceManager::GetMaintenanceManagerStatusDump(MaintenanceManagerStatu
     }
   }
 
+  for (const DiskLoadMap::value_type& e : disk_load_) {
+    MaintenanceManagerStatusPB_DiskLoadPB* disk_pb = out_pb->add_disk_loads();
+    disk_pb->set_data_dir(e.first);
+    disk_pb->set_running_ops(e.second.running_ops);
+    disk_pb->set_io_bytes(e.second.io_bytes);
+  }
+
   for (const CompletedOp& completed_op : completed_ops_) {
     if (!completed_op.name.empty()) {
       MaintenanceManagerStatusPB_CompletedOpPB* completed_pb = out_pb->add_completed_operations();
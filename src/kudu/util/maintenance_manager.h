@@ -19,6 +19,7 @@
 
 #include <stdint.h>
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <set>
@@ -79,6 +80,16 @@ class MaintenanceOpStats {
     logs_retained_bytes_ = logs_retained_bytes;
   }
 
+  int64_t data_retained_bytes() const {
+    DCHECK(valid_);
+    return data_retained_bytes_;
+  }
+
+  void set_data_retained_bytes(int64_t data_retained_bytes) {
+    UpdateLastModified();
+    data_retained_bytes_ = data_retained_bytes;
+  }
+
   double perf_improvement() const {
     DCHECK(valid_);
     return perf_improvement_;
@@ -89,6 +100,36 @@ class MaintenanceOpStats {
     perf_improvement_ = perf_improvement;
   }
 
+  double read_amplification() const {
+    DCHECK(valid_);
+    return read_amplification_;
+  }
+
+  void set_read_amplification(double read_amplification) {
+    UpdateLastModified();
+    read_amplification_ = read_amplification;
+  }
+
+  int64_t io_bytes() const {
+    DCHECK(valid_);
+    return io_bytes_;
+  }
+
+  void set_io_bytes(int64_t io_bytes) {
+    UpdateLastModified();
+    io_bytes_ = io_bytes;
+  }
+
+  const std::set<std::string>& data_dirs() const {
+    DCHECK(valid_);
+    return data_dirs_;
+  }
+
+  void add_data_dir(const std::string& data_dir) {
+    UpdateLastModified();
+    data_dirs_.insert(data_dir);
+  }
+
   const MonoTime& last_modified() const {
     DCHECK(valid_);
     return last_modified_;
@@ -119,10 +160,28 @@ class MaintenanceOpStats {
   // the logs. May be 0.
   int64_t logs_retained_bytes_;
 
+  // The approximate amount of data disk space that not doing this operation
+  // keeps from being reclaimed, e.g. history older than the retention window.
+  // May be 0.
+  int64_t data_retained_bytes_;
+
   // The estimated performance improvement-- how good it is to do this on some
   // absolute scale (yet TBD).
   double perf_improvement_;
 
+  // The read amplification measured on the data this op would reorganize:
+  // the number of cells read from disk for every cell returned to scanners.
+  // 0 if this op doesn't reduce read amplification or it hasn't been measured.
+  double read_amplification_;
+
+  // The approximate number of bytes this op will read and write. May be 0 if
+  // the op doesn't know.
+  int64_t io_bytes_;
+
+  // The data directories this op will read from or write to. An op that
+  // declares no directories is never held back by the per-disk I/O budget.
+  std::set<std::string> data_dirs_;
+
   // The last time that the stats were modified.
   MonoTime last_modified_;
 };
@@ -242,19 +301,72 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
 
   void GetMaintenanceManagerStatusDump(MaintenanceManagerStatusPB* out_pb);
 
+  // Wake up the scheduler thread for a scheduling pass without waiting for
+  // the rest of the polling interval, e.g. so that the ops which free memory
+  // are started as soon as memory pressure builds up. Requests made within
+  // the polling interval of the previous one are ignored.
+  void RequestSchedulingPass();
+
   static const Options DEFAULT_OPTIONS;
 
  private:
   FRIEND_TEST(MaintenanceManagerTest, TestLogRetentionPrioritization);
+  FRIEND_TEST(MaintenanceManagerTest, TestDataRetentionPrioritization);
+  FRIEND_TEST(MaintenanceManagerTest, TestPreferIdleDisks);
+  FRIEND_TEST(MaintenanceManagerTest, TestAnchoredCostPrioritization);
+  FRIEND_TEST(MaintenanceManagerTest, TestReadAmplificationBoost);
   typedef std::map<MaintenanceOp*, MaintenanceOpStats,
           MaintenanceOpComparator> OpMapTy;
 
+  // The I/O that a launched op was expected to do, charged against the disks
+  // it declared when it was scheduled and released when it completes.
+  struct OpIOCost {
+    std::set<std::string> data_dirs;
+    int64_t io_bytes;
+  };
+
+  // The I/O currently in flight on one data directory.
+  struct DiskLoad {
+    DiskLoad() : running_ops(0), io_bytes(0) {}
+    int running_ops;
+    int64_t io_bytes;
+  };
+  typedef std::map<std::string, DiskLoad> DiskLoadMap;
+
   void RunSchedulerThread();
 
   // find the best op, or null if there is nothing we want to run
   MaintenanceOp* FindBestOp();
 
-  void LaunchOp(MaintenanceOp* op);
+  void LaunchOp(MaintenanceOp* op, const OpIOCost& cost);
+
+  // Returns the cost of leaving the op's log retention and memory in place,
+  // in bytes: the WAL it keeps from being GCed and replayed at bootstrap,
+  // plus the RAM it anchors weighted by 'memory_pressure', the fraction of the
+  // memory limit currently consumed.
+  static double AnchoredCost(const MaintenanceOpStats& stats, double memory_pressure);
+
+  // Returns the op's perf improvement, boosted by the read amplification it
+  // reported (capped at --maintenance_manager_max_read_amplification_boost).
+  static double AdjustedPerfImprovement(const MaintenanceOpStats& stats);
+
+  // Returns the fraction of the parent memory tracker's limit that's consumed,
+  // or 0 if it has no limit.
+  double MemoryPressure() const;
+
+  // Returns true if none of the op's data directories have other ops running
+  // on them.
+  bool OnIdleDisks(const MaintenanceOpStats& stats) const;
+
+  // Returns true if running the op would keep each of its data directories
+  // within --maintenance_manager_disk_io_budget_mb. A directory with no other
+  // ops running always has room, so an op larger than the budget still runs
+  // eventually.
+  bool FitsDiskIOBudget(const MaintenanceOpStats& stats) const;
+
+  // Adds or removes 'cost' from the per-disk load. Requires 'lock_'.
+  void ChargeDiskIO(const OpIOCost& cost);
+  void ReleaseDiskIO(const OpIOCost& cost);
 
   const int32_t num_threads_;
   OpMapTy ops_; // registered operations
@@ -265,6 +377,11 @@ class MaintenanceManager : public std::enable_shared_from_this<MaintenanceManage
   bool shutdown_;
   uint64_t running_ops_;
   int32_t polling_interval_ms_;
+  // The earliest time, in microseconds, at which RequestSchedulingPass()
+  // wakes up the scheduler thread again.
+  std::atomic<int64_t> next_requested_pass_micros_;
+  // The I/O of the running ops, keyed by data directory.
+  DiskLoadMap disk_load_;
   // Vector used as a circular buffer for recently completed ops. Elements need to be added at
   // the completed_ops_count_ % the vector's size and then the count needs to be incremented.
   std::vector<CompletedOp> completed_ops_;
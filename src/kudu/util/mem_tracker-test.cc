@@ -30,6 +30,7 @@
 #include "kudu/util/test_util.h"
 
 DECLARE_int32(memory_limit_soft_percentage);
+DECLARE_int64(memory_tracker_batch_bytes);
 
 namespace kudu {
 
@@ -113,6 +114,44 @@ TEST(MemTrackerTest, TrackerHierarchy) {
   c2->Release(60);
 }
 
+TEST(MemTrackerTest, BatchedAncestorDeltas) {
+  google::FlagSaver saver;
+  FLAGS_memory_tracker_batch_bytes = 100;
+  shared_ptr<MemTracker> p = MemTracker::CreateTracker(1000, "p");
+  shared_ptr<MemTracker> c = MemTracker::CreateTracker(-1, "c", p);
+
+  // Small changes are only reflected in the child at first.
+  c->Consume(10);
+  EXPECT_EQ(c->consumption(), 10);
+  EXPECT_EQ(p->consumption(), 0);
+
+  // Checking a limit from the child brings the parent up to date.
+  EXPECT_FALSE(c->AnyLimitExceeded());
+  EXPECT_EQ(p->consumption(), 10);
+  EXPECT_EQ(c->SpareCapacity(), 990);
+
+  // A large change is passed on right away, along with whatever was batched.
+  c->Consume(5);
+  c->Consume(2000);
+  EXPECT_EQ(c->consumption(), 2015);
+  EXPECT_TRUE(c->AnyLimitExceeded());
+  EXPECT_EQ(p->consumption(), 2015);
+  EXPECT_LT(c->SpareCapacity(), 0);
+
+  // TryConsume() checks the limits against the batched changes too.
+  c->Release(1000);
+  EXPECT_FALSE(c->TryConsume(1));
+  c->Release(1015);
+  EXPECT_TRUE(c->TryConsume(1));
+  EXPECT_EQ(c->consumption(), 1);
+
+  // Destroying the child passes on whatever is still batched.
+  c->Consume(20);
+  c->Release(21);
+  c.reset();
+  EXPECT_EQ(p->consumption(), 0);
+}
+
 class GcFunctionHelper {
  public:
   static const int NUM_RELEASE_BYTES = 1;
@@ -282,6 +321,25 @@ TEST(MemTrackerTest, SoftLimitExceeded) {
   }
 }
 
+TEST(MemTrackerTest, SoftLimitPressure) {
+  const int kMemLimit = 1000;
+  google::FlagSaver saver;
+  FLAGS_memory_limit_soft_percentage = 50;
+  shared_ptr<MemTracker> parent = MemTracker::CreateTracker(kMemLimit, "parent");
+  shared_ptr<MemTracker> child = MemTracker::CreateTracker(-1, "child", parent);
+  ASSERT_EQ(0, child->SoftLimitPressure());
+
+  // No pressure up to the soft limit, then growing linearly up to the hard one.
+  ScopedTrackedConsumption consumption(child, kMemLimit / 2);
+  ASSERT_EQ(0, parent->SoftLimitPressure());
+  ASSERT_EQ(0, child->AnySoftLimitPressure());
+  consumption.Reset(kMemLimit * 3 / 4);
+  ASSERT_NEAR(0.5, parent->SoftLimitPressure(), 0.01);
+  ASSERT_NEAR(0.5, child->AnySoftLimitPressure(), 0.01);
+  consumption.Reset(kMemLimit + 1);
+  ASSERT_EQ(1, child->AnySoftLimitPressure());
+}
+
 #ifdef TCMALLOC_ENABLED
 TEST(MemTrackerTest, TcMallocRootTracker) {
   shared_ptr<MemTracker> root = MemTracker::GetRootTracker();
@@ -24,12 +24,14 @@
 #include <list>
 #include <memory>
 #include <mutex>
+#include <sched.h>
 
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/once.h"
 #include "kudu/gutil/strings/join.h"
 #include "kudu/gutil/strings/human_readable.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/debug/trace_event.h"
 #include "kudu/util/env.h"
@@ -57,6 +59,14 @@ DEFINE_int32(memory_limit_warn_threshold_percentage, 98,
              "consume before WARNING level messages are periodically logged.");
 TAG_FLAG(memory_limit_warn_threshold_percentage, advanced);
 
+DEFINE_int64(memory_tracker_batch_bytes, 0,
+             "If positive, memory trackers created from then on batch the changes "
+             "they pass on to their parents in per-CPU buffers of up to this many "
+             "bytes, reducing contention on the shared parent trackers at the cost "
+             "of their consumption lagging slightly behind. A value of 0 passes "
+             "every change on immediately.");
+TAG_FLAG(memory_tracker_batch_bytes, experimental);
+
 #ifdef TCMALLOC_ENABLED
 DEFINE_int32(tcmalloc_max_free_bytes_percentage, 10,
              "Maximum percentage of the RSS that tcmalloc is allowed to use for "
@@ -169,12 +179,18 @@ MemTracker::MemTracker(ConsumptionFunction consumption_func, int64_t byte_limit,
       parent_(std::move(parent)),
       consumption_(0),
       consumption_func_(std::move(consumption_func)),
+      num_pending_deltas_(0),
+      batch_bytes_(0),
       rand_(GetRandomSeed32()),
       enable_logging_(false),
       log_stack_(false) {
   VLOG(1) << "Creating tracker " << ToString();
   if (consumption_func_) {
     UpdateConsumption();
+  } else if (parent_ && FLAGS_memory_tracker_batch_bytes > 0) {
+    num_pending_deltas_ = base::MaxCPUIndex() + 1;
+    pending_deltas_.reset(new PendingDelta[num_pending_deltas_]);
+    batch_bytes_ = FLAGS_memory_tracker_batch_bytes;
   }
   soft_limit_ = (limit_ == -1)
       ? -1 : (limit_ * FLAGS_memory_limit_soft_percentage) / 100;
@@ -183,6 +199,7 @@ MemTracker::MemTracker(ConsumptionFunction consumption_func, int64_t byte_limit,
 MemTracker::~MemTracker() {
   VLOG(1) << "Destroying tracker " << ToString();
   if (parent_) {
+    FlushPendingDeltas();
     DCHECK(consumption() == 0) << "Memory tracker " << ToString()
         << " has unreleased consumption " << consumption();
     parent_->Release(consumption());
@@ -290,6 +307,11 @@ void MemTracker::Consume(int64_t bytes) {
   if (PREDICT_FALSE(enable_logging_)) {
     LogUpdate(true, bytes);
   }
+  if (pending_deltas_) {
+    consumption_.IncrementBy(bytes);
+    BatchAncestorDelta(bytes);
+    return;
+  }
   for (auto& tracker : all_trackers_) {
     tracker->consumption_.IncrementBy(bytes);
     if (!tracker->consumption_func_.empty()) {
@@ -308,6 +330,9 @@ bool MemTracker::TryConsume(int64_t bytes) {
   if (PREDICT_FALSE(enable_logging_)) {
     LogUpdate(true, bytes);
   }
+  // Check the limits against up-to-date ancestors; the consumption itself is
+  // applied to the whole hierarchy at once below.
+  FlushPendingDeltas();
 
   int i = 0;
   // Walk the tracker tree top-down, to avoid expanding a limit on a child whose parent
@@ -375,6 +400,11 @@ void MemTracker::Release(int64_t bytes) {
     LogUpdate(false, bytes);
   }
 
+  if (pending_deltas_) {
+    consumption_.IncrementBy(-bytes);
+    BatchAncestorDelta(-bytes);
+    return;
+  }
   for (auto& tracker : all_trackers_) {
     tracker->consumption_.IncrementBy(-bytes);
     // If a UDF calls FunctionContext::TrackAllocation() but allocates less than the
@@ -389,7 +419,54 @@ void MemTracker::Release(int64_t bytes) {
   }
 }
 
+void MemTracker::UpdateAncestors(int64_t bytes) const {
+  for (size_t i = 1; i < all_trackers_.size(); i++) {
+    MemTracker* tracker = all_trackers_[i];
+    tracker->consumption_.IncrementBy(bytes);
+    if (!tracker->consumption_func_.empty()) {
+      DCHECK_GE(tracker->consumption_.current_value(), 0);
+    }
+  }
+}
+
+void MemTracker::BatchAncestorDelta(int64_t bytes) {
+#if defined(__APPLE__)
+  // OSX doesn't have a way to get the CPU, so all threads share one buffer.
+  int cpu = 0;
+#else
+  int cpu = sched_getcpu();
+  DCHECK_LT(cpu, num_pending_deltas_);
+#endif  // defined(__APPLE__)
+  AtomicInt<int64_t>& pending = pending_deltas_[cpu].bytes;
+  int64_t delta = pending.IncrementBy(bytes);
+  if (delta >= batch_bytes_ || delta <= -batch_bytes_) {
+    // Another thread on this CPU may have changed the delta in the meantime; pass on
+    // whatever has accumulated.
+    delta = pending.Exchange(0);
+    if (delta != 0) {
+      UpdateAncestors(delta);
+    }
+  }
+}
+
+void MemTracker::FlushPendingDeltas() const {
+  if (!pending_deltas_) {
+    return;
+  }
+  for (int i = 0; i < num_pending_deltas_; i++) {
+    AtomicInt<int64_t>& pending = pending_deltas_[i].bytes;
+    // Avoid taking ownership of the cache lines of the CPUs with nothing batched.
+    if (pending.Load() != 0) {
+      int64_t delta = pending.Exchange(0);
+      if (delta != 0) {
+        UpdateAncestors(delta);
+      }
+    }
+  }
+}
+
 bool MemTracker::AnyLimitExceeded() {
+  FlushPendingDeltas();
   for (const auto& tracker : limit_trackers_) {
     if (tracker->LimitExceeded()) {
       return true;
@@ -399,6 +476,7 @@ bool MemTracker::AnyLimitExceeded() {
 }
 
 bool MemTracker::LimitExceeded() {
+  FlushPendingDeltas();
   if (PREDICT_FALSE(CheckLimitExceeded())) {
     return GcMemory(limit_);
   }
@@ -438,7 +516,31 @@ bool MemTracker::SoftLimitExceeded(double* current_capacity_pct) {
   return false;
 }
 
+double MemTracker::SoftLimitPressure() const {
+  if (!has_limit()) {
+    return 0;
+  }
+  int64_t usage = consumption();
+  if (usage >= limit_) {
+    return 1;
+  }
+  if (usage <= soft_limit_ || limit_ == soft_limit_) {
+    return 0;
+  }
+  return static_cast<double>(usage - soft_limit_) / (limit_ - soft_limit_);
+}
+
+double MemTracker::AnySoftLimitPressure() {
+  FlushPendingDeltas();
+  double pressure = 0;
+  for (MemTracker* t : limit_trackers_) {
+    pressure = std::max(pressure, t->SoftLimitPressure());
+  }
+  return pressure;
+}
+
 bool MemTracker::AnySoftLimitExceeded(double* current_capacity_pct) {
+  FlushPendingDeltas();
   for (MemTracker* t : limit_trackers_) {
     if (t->SoftLimitExceeded(current_capacity_pct)) {
       return true;
@@ -448,6 +550,7 @@ bool MemTracker::AnySoftLimitExceeded(double* current_capacity_pct) {
 }
 
 int64_t MemTracker::SpareCapacity() const {
+  FlushPendingDeltas();
   int64_t result = std::numeric_limits<int64_t>::max();
   for (const auto& tracker : limit_trackers_) {
     int64_t mem_left = tracker->limit() - tracker->consumption();
@@ -24,7 +24,9 @@
 #include <string>
 #include <vector>
 
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/ref_counted.h"
+#include "kudu/util/atomic.h"
 #include "kudu/util/high_water_mark.h"
 #include "kudu/util/locks.h"
 #include "kudu/util/mutex.h"
@@ -69,6 +71,14 @@ class MemTracker;
 // this will be called before the process limit is reported as exceeded. GcFunctions are
 // called in the order they are added, so expensive functions should be added last.
 //
+// If --memory_tracker_batch_bytes is set when a tracker is created, the tracker batches
+// the deltas it passes on to its ancestors in per-CPU buffers, so that frequent small
+// Consume()/Release() calls on different cores don't all bounce the ancestors' cache
+// lines. A tracker's own consumption stays exact, but an ancestor's may lag behind by up
+// to the batch size per CPU per batching descendant. The buffers are flushed before this
+// tracker checks any limit, so a tracker always sees its own changes reflected in the
+// limits of its ancestors.
+//
 // This class is thread-safe.
 //
 // NOTE: this class has been partially ported over from Impala with
@@ -189,6 +199,15 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   // independent event).
   bool AnySoftLimitExceeded(double* current_capacity_pct);
 
+  // Returns how far the consumption of this tracker is between its soft and
+  // hard limits: 0 at or below the soft limit, or if there's none, and 1 at
+  // or above the hard limit. Unlike SoftLimitExceeded(), this is
+  // deterministic and never runs the GC functions.
+  double SoftLimitPressure() const;
+
+  // Returns the highest SoftLimitPressure() of this tracker and its ancestors.
+  double AnySoftLimitPressure();
+
   // Returns the maximum consumption that can be made without exceeding the limit on
   // this tracker or any of its parents. Returns int64_t::max() if there are no
   // limits and a negative value if any limit is already exceeded.
@@ -199,7 +218,8 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   bool has_limit() const { return limit_ >= 0; }
   const std::string& id() const { return id_; }
 
-  // Returns the memory consumed in bytes.
+  // Returns the memory consumed in bytes. If descendants batch their deltas, this
+  // may not yet include their most recent changes.
   int64_t consumption() const {
     return consumption_.current_value();
   }
@@ -246,6 +266,23 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
   MemTracker(ConsumptionFunction consumption_func, int64_t byte_limit,
              const std::string& id, std::shared_ptr<MemTracker> parent);
 
+  // A batched delta for the ancestors of this tracker, padded to its own cache line.
+  struct PendingDelta {
+    PendingDelta() : bytes(0) {}
+    AtomicInt<int64_t> bytes;
+    char padding[CACHELINE_SIZE - (sizeof(AtomicInt<int64_t>) % CACHELINE_SIZE)];
+  };
+
+  // Adds 'bytes' to the consumption of all the ancestors of this tracker.
+  void UpdateAncestors(int64_t bytes) const;
+
+  // Adds 'bytes' to the delta batched for the ancestors on the current CPU, and
+  // passes the delta on once it grows past the batch size.
+  void BatchAncestorDelta(int64_t bytes);
+
+  // Passes all the batched deltas on to the ancestors of this tracker.
+  void FlushPendingDeltas() const;
+
   bool CheckLimitExceeded() const {
     return limit_ >= 0 && limit_ < consumption();
   }
@@ -313,6 +350,12 @@ class MemTracker : public std::enable_shared_from_this<MemTracker> {
 
   ConsumptionFunction consumption_func_;
 
+  // Deltas not yet passed on to the ancestors, indexed by CPU, and the size above which
+  // they are. Null if this tracker doesn't batch its deltas.
+  std::unique_ptr<PendingDelta[]> pending_deltas_;
+  int num_pending_deltas_;
+  int64_t batch_bytes_;
+
   // this tracker plus all of its ancestors
   std::vector<MemTracker*> all_trackers_;
   // all_trackers_ with valid limits
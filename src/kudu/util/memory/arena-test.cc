@@ -174,6 +174,46 @@ TEST(TestArena, TestMemoryTrackingEnforced) {
   ASSERT_EQ(256, mem_tracker->consumption());
 }
 
+TEST(TestArena, TestHugePageAllocator) {
+  HugePageBufferAllocator* allocator = HugePageBufferAllocator::Get();
+  const size_t kHuge = HugePageBufferAllocator::kHugePageSize;
+
+  // Small buffers come from the heap.
+  gscoped_ptr<Buffer> small(allocator->Allocate(1024));
+  ASSERT_TRUE(small);
+  memset(small->data(), 1, small->size());
+
+  // Large ones are aligned to huge pages, and recycled once freed.
+  gscoped_ptr<Buffer> large(allocator->Allocate(kHuge + 1));
+  ASSERT_TRUE(large);
+  ASSERT_EQ(kHuge + 1, large->size());
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(large->data()) % kHuge);
+  memset(large->data(), 2, large->size());
+  void* data = large->data();
+  size_t pooled = allocator->pooled_bytes();
+  large.reset();
+  ASSERT_EQ(pooled + 2 * kHuge, allocator->pooled_bytes());
+  large.reset(allocator->Allocate(2 * kHuge));
+  ASSERT_EQ(data, large->data());
+  ASSERT_EQ(pooled, allocator->pooled_bytes());
+
+  // Reallocation preserves the contents across the heap and huge pages.
+  memset(small->data(), 3, small->size());
+  ASSERT_TRUE(allocator->Reallocate(3 * kHuge, small.get()));
+  ASSERT_EQ(0, reinterpret_cast<uintptr_t>(small->data()) % kHuge);
+  ASSERT_EQ(3, reinterpret_cast<uint8_t*>(small->data())[1023]);
+  ASSERT_TRUE(allocator->Reallocate(512, small.get()));
+  ASSERT_EQ(3, reinterpret_cast<uint8_t*>(small->data())[511]);
+
+  // An arena can grow into huge pages.
+  ArenaBase<false> arena(allocator, 256, 4 * kHuge);
+  for (int i = 0; i < 64; i++) {
+    uint8_t* p = static_cast<uint8_t*>(arena.AllocateBytes(256 * 1024));
+    ASSERT_TRUE(p);
+    memset(p, i, 256 * 1024);
+  }
+}
+
 TEST(TestArena, TestSTLAllocator) {
   Arena a(256, 256 * 1024);
   typedef vector<int, ArenaAllocator<int, false> > ArenaVector;
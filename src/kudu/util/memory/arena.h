@@ -278,6 +278,14 @@ class Arena : public ArenaBase<false> {
   explicit Arena(size_t initial_buffer_size, size_t max_buffer_size) :
     ArenaBase<false>(initial_buffer_size, max_buffer_size)
   {}
+
+  // Does not take ownership of 'buffer_allocator', which must outlive the
+  // arena.
+  Arena(BufferAllocator* const buffer_allocator,
+        size_t initial_buffer_size,
+        size_t max_buffer_size) :
+    ArenaBase<false>(buffer_allocator, initial_buffer_size, max_buffer_size)
+  {}
 };
 
 class ThreadSafeArena : public ArenaBase<true> {
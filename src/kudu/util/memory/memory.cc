@@ -21,12 +21,14 @@
 #include "kudu/util/memory/memory.h"
 
 #include "kudu/util/alignment.h"
+#include "kudu/util/errno.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/memory/overwrite.h"
 #include "kudu/util/mem_tracker.h"
 
 #include <gflags/gflags.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include <algorithm>
 using std::copy;
@@ -170,6 +172,168 @@ void* HeapBufferAllocator::Realloc(void* previousData, size_t previousSize,
   }
 }
 
+DEFINE_int32(huge_page_pool_max_mb, 1024,
+             "The amount of memory, in MB, in freed huge-page buffers which "
+             "is kept for reuse by later ones rather than returned to the OS.");
+TAG_FLAG(huge_page_pool_max_mb, advanced);
+TAG_FLAG(huge_page_pool_max_mb, experimental);
+
+HugePageBufferAllocator::HugePageBufferAllocator()
+  : pooled_bytes_(0),
+    hugetlb_failed_(false) {
+}
+
+size_t HugePageBufferAllocator::pooled_bytes() const {
+  MutexLock l(pool_lock_);
+  return pooled_bytes_;
+}
+
+Buffer* HugePageBufferAllocator::AllocateInternal(
+    const size_t requested,
+    const size_t minimal,
+    BufferAllocator* const originator) {
+  DCHECK_LE(minimal, requested);
+  void* data;
+  size_t attempted = requested;
+  while (true) {
+    if (attempted == 0) {
+      data = &dummy_buffer[0];
+    } else if (IsHugeSize(attempted)) {
+      data = MapHugePages(attempted);
+    } else {
+      data = malloc(attempted);
+    }
+    if (data != nullptr) {
+      return CreateBuffer(data, attempted, originator);
+    }
+    if (attempted == minimal) return nullptr;
+    attempted = minimal + (attempted - minimal - 1) / 2;
+  }
+}
+
+bool HugePageBufferAllocator::ReallocateInternal(
+    const size_t requested,
+    const size_t minimal,
+    Buffer* const buffer,
+    BufferAllocator* const originator) {
+  DCHECK_LE(minimal, requested);
+  size_t old_size = buffer->size();
+  size_t attempted = requested;
+  while (true) {
+    void* data;
+    if (attempted == 0) {
+      data = &dummy_buffer[0];
+    } else if (!IsHugeSize(old_size) && !IsHugeSize(attempted) && old_size > 0) {
+      data = realloc(buffer->data(), attempted);
+      if (data != nullptr) {
+        UpdateBuffer(data, attempted, buffer);
+        return true;
+      }
+    } else if (IsHugeSize(old_size) && IsHugeSize(attempted) &&
+               KUDU_ALIGN_UP(old_size, kHugePageSize) ==
+               KUDU_ALIGN_UP(attempted, kHugePageSize)) {
+      // It fits in the same huge pages.
+      data = buffer->data();
+      UpdateBuffer(data, attempted, buffer);
+      return true;
+    } else {
+      data = IsHugeSize(attempted) ? MapHugePages(attempted) : malloc(attempted);
+    }
+    if (data != nullptr) {
+      if (old_size > 0) {
+        memcpy(data, buffer->data(), min(old_size, attempted));
+        FreeInternal(buffer);
+      }
+      UpdateBuffer(data, attempted, buffer);
+      return true;
+    }
+    if (attempted == minimal) return false;
+    attempted = minimal + (attempted - minimal - 1) / 2;
+  }
+}
+
+void HugePageBufferAllocator::FreeInternal(Buffer* buffer) {
+  if (buffer->size() == 0) return;
+  if (IsHugeSize(buffer->size())) {
+    UnmapHugePages(buffer->data(), buffer->size());
+  } else {
+    free(buffer->data());
+  }
+}
+
+void* HugePageBufferAllocator::MapHugePages(size_t size) {
+  size_t len = KUDU_ALIGN_UP(size, kHugePageSize);
+  bool try_hugetlb;
+  {
+    MutexLock l(pool_lock_);
+    auto it = pool_.find(len);
+    if (it != pool_.end() && !it->second.empty()) {
+      void* data = it->second.back();
+      it->second.pop_back();
+      pooled_bytes_ -= len;
+      return data;
+    }
+    try_hugetlb = !hugetlb_failed_;
+  }
+
+#if defined(__linux__)
+  if (try_hugetlb) {
+    void* data = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (data != MAP_FAILED) {
+      return data;
+    }
+    // No huge pages are reserved, or they have run out. Don't keep asking.
+    int err = errno;
+    MutexLock l(pool_lock_);
+    if (!hugetlb_failed_) {
+      VLOG(1) << "Unable to map reserved huge pages, using transparent huge pages: "
+              << ErrnoToString(err);
+      hugetlb_failed_ = true;
+    }
+  }
+#endif
+
+  // Map an extra huge page so that the start of the mapping can be aligned to
+  // one, and trim the excess, which is never touched.
+  void* raw = mmap(nullptr, len + kHugePageSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) {
+    return nullptr;
+  }
+  uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+  uintptr_t aligned = KUDU_ALIGN_UP(start, kHugePageSize);
+  if (aligned > start) {
+    munmap(raw, aligned - start);
+  }
+  size_t tail = start + len + kHugePageSize - (aligned + len);
+  if (tail > 0) {
+    munmap(reinterpret_cast<void*>(aligned + len), tail);
+  }
+  void* data = reinterpret_cast<void*>(aligned);
+#if defined(__linux__)
+  if (madvise(data, len, MADV_HUGEPAGE) != 0) {
+    // E.g. transparent huge pages are disabled; the memory is still usable.
+    int err = errno;
+    VLOG(2) << "madvise(MADV_HUGEPAGE) failed: " << ErrnoToString(err);
+  }
+#endif
+  return data;
+}
+
+void HugePageBufferAllocator::UnmapHugePages(void* data, size_t size) {
+  size_t len = KUDU_ALIGN_UP(size, kHugePageSize);
+  {
+    MutexLock l(pool_lock_);
+    if (pooled_bytes_ + len <= static_cast<size_t>(FLAGS_huge_page_pool_max_mb) * 1024 * 1024) {
+      pool_[len].push_back(data);
+      pooled_bytes_ += len;
+      return;
+    }
+  }
+  PCHECK(munmap(data, len) == 0);
+}
+
 Buffer* ClearingBufferAllocator::AllocateInternal(size_t requested,
                                                   size_t minimal,
                                                   BufferAllocator* originator) {
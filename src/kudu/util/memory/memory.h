@@ -37,6 +37,7 @@
 #include <limits>
 #include <memory>
 #include <stddef.h>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/util/boost_mutex_utils.h"
@@ -319,6 +320,78 @@ class ClearingBufferAllocator : public BufferAllocator {
   DISALLOW_COPY_AND_ASSIGN(ClearingBufferAllocator);
 };
 
+// Allocates buffers of at least one huge page (2MB on x86-64) directly with
+// mmap(), backed by huge pages: explicitly reserved ones (MAP_HUGETLB) when
+// the kernel has some to spare, or else transparent huge pages requested with
+// madvise(). Smaller buffers come from the heap, as with HeapBufferAllocator.
+//
+// Freed huge-page buffers are kept in a pool, up to --huge_page_pool_max_mb,
+// and reused for later buffers of the same rounded-up size rather than
+// returned to the OS. The arenas which use this allocator grow by chunks of
+// the same few sizes, so the pool recycles most of them, and the memory they
+// free stays in contiguous huge pages rather than fragmenting the heap.
+//
+// This class is thread-safe.
+class HugePageBufferAllocator : public BufferAllocator {
+ public:
+  virtual ~HugePageBufferAllocator() {}
+
+  // Returns a singleton instance of the huge-page allocator.
+  static HugePageBufferAllocator* Get() {
+    return Singleton<HugePageBufferAllocator>::get();
+  }
+
+  virtual size_t Available() const OVERRIDE {
+    return numeric_limits<size_t>::max();
+  }
+
+  // The number of bytes of freed huge-page buffers held in the pool.
+  size_t pooled_bytes() const;
+
+  // The size of a huge page.
+  static const size_t kHugePageSize = 2 * 1024 * 1024;
+
+ private:
+  friend class Singleton<HugePageBufferAllocator>;
+
+  HugePageBufferAllocator();
+
+  virtual Buffer* AllocateInternal(size_t requested,
+                                   size_t minimal,
+                                   BufferAllocator* originator) OVERRIDE;
+
+  virtual bool ReallocateInternal(size_t requested,
+                                  size_t minimal,
+                                  Buffer* buffer,
+                                  BufferAllocator* originator) OVERRIDE;
+
+  virtual void FreeInternal(Buffer* buffer) OVERRIDE;
+
+  // Returns 'size' huge-page-aligned bytes, rounded up to whole huge pages,
+  // from the pool or else the OS. Returns NULL on OOM.
+  void* MapHugePages(size_t size);
+
+  // Returns the mapping of 'size' bytes at 'data' to the pool, or to the OS
+  // once the pool is full.
+  void UnmapHugePages(void* data, size_t size);
+
+  // Whether a buffer of 'size' bytes is allocated with MapHugePages().
+  static bool IsHugeSize(size_t size) { return size >= kHugePageSize; }
+
+  // Protects 'pool_' and 'pooled_bytes_'.
+  mutable Mutex pool_lock_;
+
+  // Freed mappings, keyed by their rounded-up length.
+  std::unordered_map<size_t, std::vector<void*>> pool_;
+  size_t pooled_bytes_;
+
+  // Set once a MAP_HUGETLB mapping fails, after which only transparent huge
+  // pages are used.
+  bool hugetlb_failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(HugePageBufferAllocator);
+};
+
 // Abstract policy for modifying allocation requests - e.g. enforcing quotas.
 class Mediator {
  public:
@@ -17,16 +17,20 @@
 
 #include <gtest/gtest.h>
 #include <rapidjson/document.h>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
 #include "kudu/gutil/bind.h"
 #include "kudu/gutil/map-util.h"
 #include "kudu/util/hdr_histogram.h"
+#include "kudu/util/histogram.pb.h"
 #include "kudu/util/jsonreader.h"
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/metrics.h"
+#include "kudu/util/metrics.pb.h"
 #include "kudu/util/test_util.h"
 
 using std::string;
@@ -165,6 +169,41 @@ TEST_F(MetricsTest, SimpleHistogramTest) {
   // TODO: Test coverage needs to be improved a lot.
 }
 
+METRIC_DEFINE_histogram(test_entity, test_sharded_hist, "Test Sharded Histogram",
+                        MetricUnit::kMilliseconds, "foo", 1000000, 3,
+                        kudu::SHARDED_HISTOGRAM);
+
+TEST_F(MetricsTest, ShardedHistogramTest) {
+  const int kNumThreads = 8;
+  const int kNumIncrementsPerThread = 1000;
+  scoped_refptr<Histogram> hist = METRIC_test_sharded_hist.Instantiate(entity_);
+  vector<std::thread> threads;
+  for (int i = 0; i < kNumThreads; i++) {
+    threads.emplace_back([&hist, i]() {
+      for (int j = 0; j < kNumIncrementsPerThread; j++) {
+        hist->Increment(i + 1);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  // Reads merge the values from all the shards.
+  ASSERT_EQ(kNumThreads * kNumIncrementsPerThread, hist->TotalCount());
+  ASSERT_EQ(1, hist->MinValueForTests());
+  ASSERT_EQ(kNumThreads, hist->MaxValueForTests());
+  ASSERT_EQ(kNumIncrementsPerThread, hist->CountInBucketForValueForTests(kNumThreads));
+
+  HistogramSnapshotPB snapshot;
+  ASSERT_OK(hist->GetHistogramSnapshotPB(&snapshot, MetricJsonOptions()));
+  ASSERT_EQ(kNumThreads * kNumIncrementsPerThread, snapshot.total_count());
+  ASSERT_EQ(kNumIncrementsPerThread * kNumThreads * (kNumThreads + 1) / 2,
+            snapshot.total_sum());
+  ASSERT_EQ(1, snapshot.min());
+  ASSERT_EQ(kNumThreads, snapshot.max());
+}
+
 TEST_F(MetricsTest, JsonPrintTest) {
   scoped_refptr<Counter> bytes_seen = METRIC_reqs_pending.Instantiate(entity_);
   bytes_seen->Increment();
@@ -201,6 +240,73 @@ TEST_F(MetricsTest, JsonPrintTest) {
   ASSERT_EQ("", out.str());
 }
 
+TEST_F(MetricsTest, PrometheusPrintTest) {
+  scoped_refptr<Counter> reqs = METRIC_reqs_pending.Instantiate(entity_);
+  reqs->IncrementBy(3);
+  scoped_refptr<Histogram> hist = METRIC_test_hist.Instantiate(entity_);
+  hist->IncrementBy(10, 4);
+  entity_->SetAttribute("test.attr", "attr \"val\"");
+
+  std::ostringstream out;
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "*" }, MetricJsonOptions()));
+  const string kLabels = "entity_type=\"test_entity\",entity_id=\"my-test\","
+                         "test_attr=\"attr \\\"val\\\"\"";
+  ASSERT_STR_CONTAINS(out.str(), "# TYPE kudu_reqs_pending counter\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_reqs_pending{" + kLabels + "} 3\n");
+  ASSERT_STR_CONTAINS(out.str(), "# TYPE kudu_test_hist summary\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_hist{" + kLabels + ",quantile=\"0.99\"} 10\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_hist_sum{" + kLabels + "} 40\n");
+  ASSERT_STR_CONTAINS(out.str(), "kudu_test_hist_count{" + kLabels + "} 4\n");
+
+  // Filtering by metric name.
+  out.str("");
+  ASSERT_OK(registry_.WriteAsPrometheus(&out, { "reqs" }, MetricJsonOptions()));
+  ASSERT_STR_CONTAINS(out.str(), "kudu_reqs_pending");
+  ASSERT_EQ(string::npos, out.str().find("kudu_test_hist"));
+}
+
+TEST_F(MetricsTest, ProtobufFilterTest) {
+  scoped_refptr<MetricEntity> other_entity =
+      METRIC_ENTITY_server.Instantiate(&registry_, "my-server");
+  scoped_refptr<Counter> reqs = METRIC_reqs_pending.Instantiate(entity_);
+  scoped_refptr<AtomicGauge<uint64_t>> gauge = METRIC_fake_memory_usage.Instantiate(entity_, 0);
+  reqs->Increment();
+
+  // Filtering by entity type.
+  {
+    MetricsSnapshotPB pb;
+    MetricJsonOptions opts;
+    opts.entity_types = { "server" };
+    ASSERT_OK(registry_.WriteAsProtobuf(&pb, { "*" }, opts));
+    ASSERT_EQ(1, pb.entities_size());
+    ASSERT_EQ("my-server", pb.entities(0).id());
+
+    pb.Clear();
+    opts.entity_types = { "test_entity" };
+    ASSERT_OK(registry_.WriteAsProtobuf(&pb, { "*" }, opts));
+    ASSERT_EQ(1, pb.entities_size());
+    ASSERT_EQ("my-test", pb.entities(0).id());
+    ASSERT_EQ(2, pb.entities(0).metrics_size());
+  }
+
+  // Only the metrics changed since the start of an epoch are included.
+  int64_t epoch = Metric::IncrementEpoch();
+  {
+    MetricsSnapshotPB pb;
+    MetricJsonOptions opts;
+    opts.only_modified_in_or_after_epoch = epoch;
+    ASSERT_OK(registry_.WriteAsProtobuf(&pb, { "*" }, opts));
+    ASSERT_EQ(0, pb.entities_size());
+
+    gauge->set_value(42);
+    ASSERT_OK(registry_.WriteAsProtobuf(&pb, { "*" }, opts));
+    ASSERT_EQ(1, pb.entities_size());
+    ASSERT_EQ(1, pb.entities(0).metrics_size());
+    ASSERT_EQ("fake_memory_usage", pb.entities(0).metrics(0).name());
+    ASSERT_EQ(42, pb.entities(0).metrics(0).int_value());
+  }
+}
+
 // Test that metrics are retired when they are no longer referenced.
 TEST_F(MetricsTest, RetirementTest) {
   FLAGS_metrics_retirement_age_ms = 100;
@@ -18,7 +18,9 @@
 
 #include <iostream>
 #include <map>
+#include <sched.h>
 #include <set>
+#include <utility>
 
 #include <gflags/gflags.h>
 
@@ -27,12 +29,16 @@
 #include "kudu/gutil/map-util.h"
 #include "kudu/gutil/singleton.h"
 #include "kudu/gutil/stl_util.h"
+#include "kudu/gutil/strings/ascii_ctype.h"
+#include "kudu/gutil/strings/numbers.h"
 #include "kudu/gutil/strings/substitute.h"
+#include "kudu/gutil/sysinfo.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/hdr_histogram.h"
 #include "kudu/util/histogram.pb.h"
 #include "kudu/util/jsonwriter.h"
 #include "kudu/util/locks.h"
+#include "kudu/util/metrics.pb.h"
 #include "kudu/util/status.h"
 
 DEFINE_int32(metrics_retirement_age_ms, 120 * 1000,
@@ -47,9 +53,11 @@ METRIC_DEFINE_entity(server);
 
 namespace kudu {
 
+using std::pair;
 using std::string;
 using std::vector;
 using strings::Substitute;
+using strings::SubstituteAndAppend;
 
 //
 // MetricUnit
@@ -189,35 +197,107 @@ bool MatchMetricInList(const string& metric_name,
   return false;
 }
 
+// Escapes a label value as required by the Prometheus text exposition format.
+string EscapePrometheusLabelValue(const string& value) {
+  string ret;
+  ret.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+      case '\\': ret.append("\\\\"); break;
+      case '"': ret.append("\\\""); break;
+      case '\n': ret.append("\\n"); break;
+      default: ret.push_back(c);
+    }
+  }
+  return ret;
+}
+
+// Escapes the text of a HELP line.
+string EscapePrometheusHelp(const string& help) {
+  string ret;
+  ret.reserve(help.size());
+  for (char c : help) {
+    switch (c) {
+      case '\\': ret.append("\\\\"); break;
+      case '\n': ret.append("\\n"); break;
+      default: ret.push_back(c);
+    }
+  }
+  return ret;
+}
+
+// Turns an entity attribute name into a valid Prometheus label name.
+string PrometheusLabelName(const string& name) {
+  string ret = name;
+  for (size_t i = 0; i < ret.size(); i++) {
+    char c = ret[i];
+    if (!ascii_isalnum(c) && c != '_') {
+      ret[i] = '_';
+    }
+  }
+  if (ret.empty() || ascii_isdigit(ret[0])) {
+    ret.insert(0, "_");
+  }
+  return ret;
+}
+
+const char* PrometheusType(MetricType::Type type) {
+  switch (type) {
+    case MetricType::kCounter:
+      return "counter";
+    case MetricType::kHistogram:
+      // Exposed through the precomputed percentiles.
+      return "summary";
+    default:
+      return "gauge";
+  }
+}
+
 } // anonymous namespace
 
 
-Status MetricEntity::WriteAsJson(JsonWriter* writer,
-                                 const vector<string>& requested_metrics,
-                                 const MetricJsonOptions& opts) const {
+bool MetricEntity::GetSelectedMetrics(const vector<string>& requested_metrics,
+                                      const MetricJsonOptions& opts,
+                                      OrderedMetricMap* metrics,
+                                      AttributeMap* attrs) const {
+  if (!opts.entity_types.empty() &&
+      std::find(opts.entity_types.begin(), opts.entity_types.end(), prototype_->name()) ==
+      opts.entity_types.end()) {
+    return false;
+  }
   bool select_all = MatchMetricInList(id(), requested_metrics);
 
-  // We want the keys to be in alphabetical order when printing, so we use an ordered map here.
-  typedef std::map<const char*, scoped_refptr<Metric> > OrderedMetricMap;
-  OrderedMetricMap metrics;
-  AttributeMap attrs;
   {
     // Snapshot the metrics in this registry (not guaranteed to be a consistent snapshot)
     std::lock_guard<simple_spinlock> l(lock_);
-    attrs = attributes_;
+    *attrs = attributes_;
     for (const MetricMap::value_type& val : metric_map_) {
       const MetricPrototype* prototype = val.first;
       const scoped_refptr<Metric>& metric = val.second;
 
-      if (select_all || MatchMetricInList(prototype->name(), requested_metrics)) {
-        InsertOrDie(&metrics, prototype->name(), metric);
+      if ((select_all || MatchMetricInList(prototype->name(), requested_metrics)) &&
+          metric->ModifiedInOrAfterEpoch(opts.only_modified_in_or_after_epoch)) {
+        InsertOrDie(metrics, prototype->name(), metric);
       }
     }
   }
 
   // If we had a filter, and we didn't either match this entity or any metrics inside
-  // it, don't print the entity at all.
-  if (!requested_metrics.empty() && !select_all && metrics.empty()) {
+  // it, don't print the entity at all. Likewise if none of its metrics changed.
+  if (metrics->empty() &&
+      ((!requested_metrics.empty() && !select_all) ||
+       opts.only_modified_in_or_after_epoch > 0)) {
+    return false;
+  }
+  return true;
+}
+
+Status MetricEntity::WriteAsJson(JsonWriter* writer,
+                                 const vector<string>& requested_metrics,
+                                 const MetricJsonOptions& opts) const {
+  OrderedMetricMap metrics;
+  AttributeMap attrs;
+  if (!GetSelectedMetrics(requested_metrics, opts, &metrics, &attrs)) {
     return Status::OK();
   }
 
@@ -251,6 +331,34 @@ Status MetricEntity::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+bool MetricEntity::WriteAsProtobuf(MetricEntityPB* pb,
+                                   const vector<string>& requested_metrics,
+                                   const MetricJsonOptions& opts) const {
+  OrderedMetricMap metrics;
+  AttributeMap attrs;
+  if (!GetSelectedMetrics(requested_metrics, opts, &metrics, &attrs)) {
+    return false;
+  }
+
+  pb->set_type(prototype_->name());
+  pb->set_id(id_);
+  for (const AttributeMap::value_type& val : attrs) {
+    MetricEntityPB::AttributePB* attr_pb = pb->add_attributes();
+    attr_pb->set_key(val.first);
+    attr_pb->set_value(val.second);
+  }
+  for (OrderedMetricMap::value_type& val : metrics) {
+    MetricPB metric_pb;
+    Status s = val.second->WriteAsProtobuf(&metric_pb, opts);
+    if (PREDICT_FALSE(!s.ok())) {
+      WARN_NOT_OK(s, strings::Substitute("Failed to write $0 as protobuf", val.first));
+      continue;
+    }
+    pb->add_metrics()->Swap(&metric_pb);
+  }
+  return true;
+}
+
 void MetricEntity::RetireOldMetrics() {
   MonoTime now(MonoTime::Now(MonoTime::FINE));
 
@@ -348,6 +456,80 @@ Status MetricRegistry::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+Status MetricRegistry::WriteAsPrometheus(std::ostream* out,
+                                         const vector<string>& requested_metrics,
+                                         const MetricJsonOptions& opts) const {
+  EntityMap entities;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    entities = entities_;
+  }
+
+  // All the samples of a metric must be exposed together, so group the
+  // metrics of every entity by name first.
+  struct PrometheusFamily {
+    const MetricPrototype* prototype;
+    vector<pair<string, scoped_refptr<Metric> > > metrics;
+  };
+  std::map<string, PrometheusFamily> families;
+  for (const EntityMap::value_type& e : entities) {
+    MetricEntity::OrderedMetricMap metrics;
+    MetricEntity::AttributeMap attrs;
+    if (!e.second->GetSelectedMetrics(requested_metrics, opts, &metrics, &attrs)) {
+      continue;
+    }
+    string labels = Substitute("entity_type=\"$0\",entity_id=\"$1\"",
+                               EscapePrometheusLabelValue(e.second->prototype_->name()),
+                               EscapePrometheusLabelValue(e.second->id()));
+    for (const MetricEntity::AttributeMap::value_type& attr : attrs) {
+      SubstituteAndAppend(&labels, ",$0=\"$1\"",
+                          PrometheusLabelName(attr.first),
+                          EscapePrometheusLabelValue(attr.second));
+    }
+    for (MetricEntity::OrderedMetricMap::value_type& val : metrics) {
+      PrometheusFamily* family = &families[val.first];
+      family->prototype = val.second->prototype();
+      family->metrics.emplace_back(labels, std::move(val.second));
+    }
+  }
+  entities.clear();
+
+  for (const auto& f : families) {
+    const string name = "kudu_" + f.first;
+    const MetricPrototype* prototype = f.second.prototype;
+    *out << "# HELP " << name << " " << EscapePrometheusHelp(prototype->description()) << "\n";
+    *out << "# TYPE " << name << " " << PrometheusType(prototype->type()) << "\n";
+    for (const auto& m : f.second.metrics) {
+      m.second->WriteAsPrometheus(name, m.first, out);
+    }
+  }
+
+  families.clear(); // deref the metrics before the retirement scan, as above.
+  const_cast<MetricRegistry*>(this)->RetireOldMetrics();
+  return Status::OK();
+}
+
+Status MetricRegistry::WriteAsProtobuf(MetricsSnapshotPB* pb,
+                                       const vector<string>& requested_metrics,
+                                       const MetricJsonOptions& opts) const {
+  EntityMap entities;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    entities = entities_;
+  }
+
+  for (const EntityMap::value_type& e : entities) {
+    MetricEntityPB entity_pb;
+    if (e.second->WriteAsProtobuf(&entity_pb, requested_metrics, opts)) {
+      pb->add_entities()->Swap(&entity_pb);
+    }
+  }
+
+  entities.clear(); // deref the metrics before the retirement scan, as above.
+  const_cast<MetricRegistry*>(this)->RetireOldMetrics();
+  return Status::OK();
+}
+
 void MetricRegistry::RetireOldMetrics() {
   std::lock_guard<simple_spinlock> l(lock_);
   for (auto it = entities_.begin(); it != entities_.end();) {
@@ -480,13 +662,48 @@ scoped_refptr<MetricEntity> MetricRegistry::FindOrCreateEntity(
 //
 // Metric
 //
+AtomicInt<int64_t> Metric::g_epoch_(0);
+
 Metric::Metric(const MetricPrototype* prototype)
-  : prototype_(prototype) {
+  : prototype_(prototype),
+    m_epoch_(current_epoch()) {
 }
 
 Metric::~Metric() {
 }
 
+namespace internal {
+
+void SetMetricPBValue(bool v, MetricPB* pb) {
+  pb->set_int_value(v);
+}
+
+void SetMetricPBValue(int32_t v, MetricPB* pb) {
+  pb->set_int_value(v);
+}
+
+void SetMetricPBValue(uint32_t v, MetricPB* pb) {
+  pb->set_int_value(v);
+}
+
+void SetMetricPBValue(int64_t v, MetricPB* pb) {
+  pb->set_int_value(v);
+}
+
+void SetMetricPBValue(uint64_t v, MetricPB* pb) {
+  pb->set_int_value(static_cast<int64_t>(v));
+}
+
+void SetMetricPBValue(double v, MetricPB* pb) {
+  pb->set_double_value(v);
+}
+
+void SetMetricPBValue(const string& v, MetricPB* pb) {
+  pb->set_string_value(v);
+}
+
+} // namespace internal
+
 //
 // Gauge
 //
@@ -504,6 +721,23 @@ Status Gauge::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Gauge::WriteAsPrometheus(const string& name,
+                              const string& labels,
+                              std::ostream* out) const {
+  double value;
+  if (!NumericValue(&value)) {
+    // Prometheus only deals in numbers.
+    return;
+  }
+  *out << name << "{" << labels << "} " << SimpleDtoa(value) << "\n";
+}
+
+Status Gauge::WriteAsProtobuf(MetricPB* pb, const MetricJsonOptions& /* opts */) const {
+  pb->set_name(prototype_->name());
+  SetValue(pb);
+  return Status::OK();
+}
+
 //
 // StringGauge
 //
@@ -518,14 +752,21 @@ std::string StringGauge::value() const {
 }
 
 void StringGauge::set_value(const std::string& value) {
-  std::lock_guard<simple_spinlock> l(lock_);
-  value_ = value;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    value_ = value;
+  }
+  UpdateModificationEpoch();
 }
 
 void StringGauge::WriteValue(JsonWriter* writer) const {
   writer->String(value());
 }
 
+void StringGauge::SetValue(MetricPB* pb) const {
+  pb->set_string_value(value());
+}
+
 //
 // Counter
 //
@@ -548,6 +789,7 @@ void Counter::Increment() {
 
 void Counter::IncrementBy(int64_t amount) {
   value_.IncrementBy(amount);
+  UpdateModificationEpoch();
 }
 
 Status Counter::WriteAsJson(JsonWriter* writer,
@@ -563,6 +805,18 @@ Status Counter::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Counter::WriteAsPrometheus(const string& name,
+                                const string& labels,
+                                std::ostream* out) const {
+  *out << name << "{" << labels << "} " << value() << "\n";
+}
+
+Status Counter::WriteAsProtobuf(MetricPB* pb, const MetricJsonOptions& /* opts */) const {
+  pb->set_name(prototype_->name());
+  pb->set_int_value(value());
+  return Status::OK();
+}
+
 /////////////////////////////////////////////////
 // HistogramPrototype
 /////////////////////////////////////////////////
@@ -592,15 +846,76 @@ scoped_refptr<Histogram> HistogramPrototype::Instantiate(
 
 Histogram::Histogram(const HistogramPrototype* proto)
   : Metric(proto),
-    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())) {
+    histogram_(new HdrHistogram(proto->max_trackable_value(), proto->num_sig_digits())),
+    num_shards_(0) {
+  if (proto->sharded()) {
+    num_shards_ = base::MaxCPUIndex() + 1;
+    shards_.reset(new AtomicWord[num_shards_]());  // value-initialized
+  }
+}
+
+Histogram::~Histogram() {
+  for (int i = 0; i < num_shards_; i++) {
+    delete reinterpret_cast<HdrHistogram*>(base::subtle::NoBarrier_Load(&shards_[i]));
+  }
+}
+
+HdrHistogram* Histogram::GetShard() {
+#if defined(__APPLE__)
+  // OSX doesn't have a way to get the CPU, so we record into the main histogram.
+  return histogram_.get();
+#else
+  int cpu = sched_getcpu();
+  DCHECK_LT(cpu, num_shards_);
+  AtomicWord* slot = &shards_[cpu];
+  HdrHistogram* shard = reinterpret_cast<HdrHistogram*>(base::subtle::Acquire_Load(slot));
+  if (PREDICT_TRUE(shard != nullptr)) {
+    return shard;
+  }
+  // Shards are created on first use so that a histogram only pays for the CPUs
+  // that actually record into it.
+  gscoped_ptr<HdrHistogram> new_shard(new HdrHistogram(histogram_->highest_trackable_value(),
+                                                       histogram_->num_significant_digits()));
+  AtomicWord prev = base::subtle::Release_CompareAndSwap(
+      slot, 0, reinterpret_cast<AtomicWord>(new_shard.get()));
+  if (prev != 0) {
+    // Another thread on this CPU beat us to it.
+    return reinterpret_cast<HdrHistogram*>(prev);
+  }
+  return new_shard.release();
+#endif  // defined(__APPLE__)
+}
+
+void Histogram::MergeShardsInto(HdrHistogram* snapshot) const {
+  for (int i = 0; i < num_shards_; i++) {
+    const HdrHistogram* shard =
+        reinterpret_cast<const HdrHistogram*>(base::subtle::Acquire_Load(&shards_[i]));
+    if (shard != nullptr) {
+      snapshot->MergeFrom(*shard);
+    }
+  }
+}
+
+const HdrHistogram* Histogram::Snapshot(gscoped_ptr<HdrHistogram>* storage) const {
+  if (!shards_) {
+    return histogram_.get();
+  }
+  storage->reset(new HdrHistogram(*histogram_));
+  MergeShardsInto(storage->get());
+  return storage->get();
 }
 
 void Histogram::Increment(int64_t value) {
-  histogram_->Increment(value);
+  IncrementBy(value, 1);
 }
 
 void Histogram::IncrementBy(int64_t value, int64_t amount) {
-  histogram_->IncrementBy(value, amount);
+  if (shards_) {
+    GetShard()->IncrementBy(value, amount);
+  } else {
+    histogram_->IncrementBy(value, amount);
+  }
+  UpdateModificationEpoch();
 }
 
 Status Histogram::WriteAsJson(JsonWriter* writer,
@@ -612,9 +927,35 @@ Status Histogram::WriteAsJson(JsonWriter* writer,
   return Status::OK();
 }
 
+void Histogram::WriteAsPrometheus(const string& name,
+                                  const string& labels,
+                                  std::ostream* out) const {
+  HistogramSnapshotPB snapshot;
+  WARN_NOT_OK(GetHistogramSnapshotPB(&snapshot, MetricJsonOptions()),
+              Substitute("Failed to snapshot $0", prototype_->name()));
+  const pair<const char*, uint64_t> quantiles[] = {
+    { "0.75", snapshot.percentile_75() },
+    { "0.95", snapshot.percentile_95() },
+    { "0.99", snapshot.percentile_99() },
+    { "0.999", snapshot.percentile_99_9() },
+    { "0.9999", snapshot.percentile_99_99() },
+  };
+  for (const auto& q : quantiles) {
+    *out << name << "{" << labels << ",quantile=\"" << q.first << "\"} " << q.second << "\n";
+  }
+  *out << name << "_sum{" << labels << "} " << snapshot.total_sum() << "\n";
+  *out << name << "_count{" << labels << "} " << snapshot.total_count() << "\n";
+}
+
+Status Histogram::WriteAsProtobuf(MetricPB* pb, const MetricJsonOptions& opts) const {
+  pb->set_name(prototype_->name());
+  return GetHistogramSnapshotPB(pb->mutable_histogram(), opts);
+}
+
 Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
                                          const MetricJsonOptions& opts) const {
   HdrHistogram snapshot(*histogram_);
+  MergeShardsInto(&snapshot);
   snapshot_pb->set_name(prototype_->name());
   if (opts.include_schema_info) {
     snapshot_pb->set_type(MetricType::Name(prototype_->type()));
@@ -648,22 +989,34 @@ Status Histogram::GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot_pb,
 }
 
 uint64_t Histogram::CountInBucketForValueForTests(uint64_t value) const {
-  return histogram_->CountInBucketForValue(value);
+  gscoped_ptr<HdrHistogram> storage;
+  return Snapshot(&storage)->CountInBucketForValue(value);
 }
 
 uint64_t Histogram::TotalCount() const {
-  return histogram_->TotalCount();
+  uint64_t total = histogram_->TotalCount();
+  for (int i = 0; i < num_shards_; i++) {
+    const HdrHistogram* shard =
+        reinterpret_cast<const HdrHistogram*>(base::subtle::Acquire_Load(&shards_[i]));
+    if (shard != nullptr) {
+      total += shard->TotalCount();
+    }
+  }
+  return total;
 }
 
 uint64_t Histogram::MinValueForTests() const {
-  return histogram_->MinValue();
+  gscoped_ptr<HdrHistogram> storage;
+  return Snapshot(&storage)->MinValue();
 }
 
 uint64_t Histogram::MaxValueForTests() const {
-  return histogram_->MaxValue();
+  gscoped_ptr<HdrHistogram> storage;
+  return Snapshot(&storage)->MaxValue();
 }
 double Histogram::MeanValueForTests() const {
-  return histogram_->MeanValue();
+  gscoped_ptr<HdrHistogram> storage;
+  return Snapshot(&storage)->MeanValue();
 }
 
 ScopedLatencyMetric::ScopedLatencyMetric(Histogram* latency_hist)
@@ -104,6 +104,18 @@
 //                            "Total number of threads started on this server",
 //                            kudu::EXPOSE_AS_COUNTER);
 //
+// Histograms which are updated concurrently from many threads at a high rate, such
+// as the per-RPC handler latency histograms, may be defined with the
+// 'SHARDED_HISTOGRAM' flag. Each CPU then records into its own shard, and the shards
+// are merged whenever the histogram is read:
+//
+// METRIC_DEFINE_histogram(server, handler_latency,
+//                         "Handler Latency",
+//                         kudu::MetricUnit::kMicroseconds,
+//                         "Microseconds spent handling requests",
+//                         60000000LU, 2,
+//                         kudu::SHARDED_HISTOGRAM);
+//
 //
 // Metrics ownership
 // ------------------------------------------------------------
@@ -224,6 +236,8 @@
 /////////////////////////////////////////////////////
 
 #include <algorithm>
+#include <iosfwd>
+#include <map>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -279,9 +293,9 @@
   ::kudu::GaugePrototype<double> METRIC_##name(                      \
       ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__))
 
-#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits) \
+#define METRIC_DEFINE_histogram(entity, name, label, unit, desc, max_val, num_sig_digits, ...) \
   ::kudu::HistogramPrototype METRIC_##name(                                       \
-      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc), \
+      ::kudu::MetricPrototype::CtorArgs(#entity, #name, label, unit, desc, ## __VA_ARGS__), \
     max_val, num_sig_digits)
 
 // The following macros act as forward declarations for entity types and metric prototypes.
@@ -331,9 +345,12 @@ template<typename T>
 class GaugePrototype;
 
 class Metric;
+class MetricEntityPB;
 class MetricEntityPrototype;
+class MetricPB;
 class MetricPrototype;
 class MetricRegistry;
+class MetricsSnapshotPB;
 
 class HdrHistogram;
 class Histogram;
@@ -393,10 +410,13 @@ class MetricType {
   static const char* const kHistogramType;
 };
 
+// Options for exporting metrics. Despite the name, they apply to the
+// Prometheus and protobuf exports as well.
 struct MetricJsonOptions {
   MetricJsonOptions() :
     include_raw_histograms(false),
-    include_schema_info(false) {
+    include_schema_info(false),
+    only_modified_in_or_after_epoch(0) {
   }
 
   // Include the raw histogram values and counts in the JSON output.
@@ -409,6 +429,16 @@ struct MetricJsonOptions {
   // unit, etc).
   // Default: false
   bool include_schema_info;
+
+  // Only include the entities of these types, e.g. "tablet" or "server".
+  // Default: empty, i.e. all entity types.
+  std::vector<std::string> entity_types;
+
+  // Only include the metrics which changed in or after the given epoch (see
+  // Metric::IncrementEpoch()). Metrics whose value is computed on demand are
+  // always included.
+  // Default: 0, i.e. all metrics.
+  int64_t only_modified_in_or_after_epoch;
 };
 
 class MetricEntityPrototype {
@@ -465,6 +495,12 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // See MetricRegistry::WriteAsProtobuf(). Leaves 'pb' untouched and returns
+  // false if nothing in this entity is selected.
+  bool WriteAsProtobuf(MetricEntityPB* pb,
+                       const std::vector<std::string>& requested_metrics,
+                       const MetricJsonOptions& opts) const;
+
   const MetricMap& UnsafeMetricsMapForTests() const { return metric_map_; }
 
   // Mark that the given metric should never be retired until the metric
@@ -499,6 +535,17 @@ class MetricEntity : public RefCountedThreadSafe<MetricEntity> {
                AttributeMap attributes);
   ~MetricEntity();
 
+  // We want the keys to be in alphabetical order when printing, so we use an ordered map.
+  typedef std::map<const char*, scoped_refptr<Metric> > OrderedMetricMap;
+
+  // Snapshots this entity's attributes and the metrics selected by
+  // 'requested_metrics' and 'opts'. Returns false if nothing in this entity
+  // is selected.
+  bool GetSelectedMetrics(const std::vector<std::string>& requested_metrics,
+                          const MetricJsonOptions& opts,
+                          OrderedMetricMap* metrics,
+                          AttributeMap* attrs) const;
+
   // Ensure that the given metric prototype is allowed to be instantiated
   // within this entity. This entity's type must match the expected entity
   // type defined within the metric prototype.
@@ -527,12 +574,46 @@ class Metric : public RefCountedThreadSafe<Metric> {
   virtual Status WriteAsJson(JsonWriter* writer,
                              const MetricJsonOptions& opts) const = 0;
 
+  // Writes the samples of this metric in the Prometheus text exposition format,
+  // as metric 'name' with the given 'labels' (e.g. 'entity_id="foo"').
+  virtual void WriteAsPrometheus(const std::string& name,
+                                 const std::string& labels,
+                                 std::ostream* out) const = 0;
+
+  // Fills in 'pb' with the value of this metric.
+  virtual Status WriteAsProtobuf(MetricPB* pb, const MetricJsonOptions& opts) const = 0;
+
   const MetricPrototype* prototype() const { return prototype_; }
 
+  // Returns whether this metric changed in or after 'epoch'.
+  virtual bool ModifiedInOrAfterEpoch(int64_t epoch) const {
+    return m_epoch_.Load() >= epoch;
+  }
+
+  // Starts a new epoch and returns it. Metrics which change from then on are
+  // selected by MetricJsonOptions::only_modified_in_or_after_epoch set to the
+  // returned value.
+  static int64_t IncrementEpoch() {
+    return g_epoch_.Increment();
+  }
+
+  static int64_t current_epoch() {
+    return g_epoch_.Load();
+  }
+
  protected:
   explicit Metric(const MetricPrototype* prototype);
   virtual ~Metric();
 
+  // Records that this metric changed in the current epoch. Must be called by
+  // every mutator.
+  void UpdateModificationEpoch() {
+    int64_t current = g_epoch_.Load();
+    if (PREDICT_FALSE(m_epoch_.Load() < current)) {
+      m_epoch_.StoreMax(current);
+    }
+  }
+
   const MetricPrototype* const prototype_;
 
  private:
@@ -544,6 +625,12 @@ class Metric : public RefCountedThreadSafe<Metric> {
   // uninitialized.
   MonoTime retire_time_;
 
+  // The epoch in which this metric last changed.
+  AtomicInt<int64_t> m_epoch_;
+
+  // The current epoch, shared by all metrics.
+  static AtomicInt<int64_t> g_epoch_;
+
   DISALLOW_COPY_AND_ASSIGN(Metric);
 };
 
@@ -573,6 +660,18 @@ class MetricRegistry {
                      const std::vector<std::string>& requested_metrics,
                      const MetricJsonOptions& opts) const;
 
+  // Like WriteAsJson(), but in the Prometheus text exposition format. Each
+  // metric is exposed as 'kudu_<name>', labeled with the type, ID and
+  // attributes of its entity; histograms are exposed as summaries.
+  Status WriteAsPrometheus(std::ostream* out,
+                           const std::vector<std::string>& requested_metrics,
+                           const MetricJsonOptions& opts) const;
+
+  // Like WriteAsJson(), but into a protobuf, which is much more compact.
+  Status WriteAsProtobuf(MetricsSnapshotPB* pb,
+                         const std::vector<std::string>& requested_metrics,
+                         const MetricJsonOptions& opts) const;
+
   // For each registered entity, retires orphaned metrics. If an entity has no more
   // metrics and there are no external references, entities are removed as well.
   //
@@ -637,7 +736,11 @@ class MetricPrototypeRegistry {
 enum PrototypeFlags {
   // Flag which causes a Gauge prototype to expose itself as if it
   // were a counter.
-  EXPOSE_AS_COUNTER = 1 << 0
+  EXPOSE_AS_COUNTER = 1 << 0,
+
+  // Flag which causes a Histogram to record into per-CPU shards, trading
+  // memory and read cost for uncontended updates.
+  SHARDED_HISTOGRAM = 1 << 1
 };
 
 class MetricPrototype {
@@ -723,6 +826,29 @@ class GaugePrototype : public MetricPrototype {
   DISALLOW_COPY_AND_ASSIGN(GaugePrototype);
 };
 
+namespace internal {
+
+// Helpers for exporting the values of gauges of any type.
+template<typename T>
+inline bool MetricValueAsDouble(const T& v, double* out) {
+  *out = static_cast<double>(v);
+  return true;
+}
+
+inline bool MetricValueAsDouble(const std::string& /* v */, double* /* out */) {
+  return false;
+}
+
+void SetMetricPBValue(bool v, MetricPB* pb);
+void SetMetricPBValue(int32_t v, MetricPB* pb);
+void SetMetricPBValue(uint32_t v, MetricPB* pb);
+void SetMetricPBValue(int64_t v, MetricPB* pb);
+void SetMetricPBValue(uint64_t v, MetricPB* pb);
+void SetMetricPBValue(double v, MetricPB* pb);
+void SetMetricPBValue(const std::string& v, MetricPB* pb);
+
+} // namespace internal
+
 // Abstract base class to provide point-in-time metric values.
 class Gauge : public Metric {
  public:
@@ -732,8 +858,18 @@ class Gauge : public Metric {
   virtual ~Gauge() {}
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(const std::string& name,
+                                 const std::string& labels,
+                                 std::ostream* out) const OVERRIDE;
+  virtual Status WriteAsProtobuf(MetricPB* pb, const MetricJsonOptions& opts) const OVERRIDE;
  protected:
   virtual void WriteValue(JsonWriter* writer) const = 0;
+
+  // Sets 'value' to the value of the gauge, or returns false if it isn't numeric.
+  virtual bool NumericValue(double* value) const = 0;
+
+  // Sets the matching value field of 'pb'.
+  virtual void SetValue(MetricPB* pb) const = 0;
  private:
   DISALLOW_COPY_AND_ASSIGN(Gauge);
 };
@@ -747,6 +883,8 @@ class StringGauge : public Gauge {
   void set_value(const std::string& value);
  protected:
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE;
+  virtual bool NumericValue(double* /* value */) const OVERRIDE { return false; }
+  virtual void SetValue(MetricPB* pb) const OVERRIDE;
  private:
   std::string value_;
   mutable simple_spinlock lock_;  // Guards value_
@@ -766,12 +904,15 @@ class AtomicGauge : public Gauge {
   }
   virtual void set_value(const T& value) {
     value_.Store(static_cast<int64_t>(value), kMemOrderNoBarrier);
+    UpdateModificationEpoch();
   }
   void Increment() {
     value_.IncrementBy(1, kMemOrderNoBarrier);
+    UpdateModificationEpoch();
   }
   virtual void IncrementBy(int64_t amount) {
     value_.IncrementBy(amount, kMemOrderNoBarrier);
+    UpdateModificationEpoch();
   }
   void Decrement() {
     IncrementBy(-1);
@@ -784,6 +925,13 @@ class AtomicGauge : public Gauge {
   virtual void WriteValue(JsonWriter* writer) const OVERRIDE {
     writer->Value(value());
   }
+  virtual bool NumericValue(double* value) const OVERRIDE {
+    *value = static_cast<double>(this->value());
+    return true;
+  }
+  virtual void SetValue(MetricPB* pb) const OVERRIDE {
+    internal::SetMetricPBValue(value(), pb);
+  }
   AtomicInt<int64_t> value_;
  private:
   DISALLOW_COPY_AND_ASSIGN(AtomicGauge);
@@ -859,6 +1007,11 @@ class FunctionGauge : public Gauge {
     writer->Value(value());
   }
 
+  // The value is computed on demand, so it may have changed at any time.
+  virtual bool ModifiedInOrAfterEpoch(int64_t /* epoch */) const OVERRIDE {
+    return true;
+  }
+
   // Reset this FunctionGauge to return a specific value.
   // This should be used during destruction. If you want a settable
   // Gauge, use a normal Gauge instead of a FunctionGauge.
@@ -905,6 +1058,13 @@ class FunctionGauge : public Gauge {
     return v;
   }
 
+  virtual bool NumericValue(double* value) const OVERRIDE {
+    return internal::MetricValueAsDouble(this->value(), value);
+  }
+  virtual void SetValue(MetricPB* pb) const OVERRIDE {
+    internal::SetMetricPBValue(value(), pb);
+  }
+
   mutable simple_spinlock lock_;
   Callback<T()> function_;
   DISALLOW_COPY_AND_ASSIGN(FunctionGauge);
@@ -937,6 +1097,10 @@ class Counter : public Metric {
   void IncrementBy(int64_t amount);
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(const std::string& name,
+                                 const std::string& labels,
+                                 std::ostream* out) const OVERRIDE;
+  virtual Status WriteAsProtobuf(MetricPB* pb, const MetricJsonOptions& opts) const OVERRIDE;
 
  private:
   FRIEND_TEST(MetricsTest, SimpleCounterTest);
@@ -957,6 +1121,7 @@ class HistogramPrototype : public MetricPrototype {
 
   uint64_t max_trackable_value() const { return max_trackable_value_; }
   int num_sig_digits() const { return num_sig_digits_; }
+  bool sharded() const { return args_.flags_ & SHARDED_HISTOGRAM; }
   virtual MetricType::Type type() const OVERRIDE { return MetricType::kHistogram; }
 
  private:
@@ -981,6 +1146,10 @@ class Histogram : public Metric {
 
   virtual Status WriteAsJson(JsonWriter* w,
                              const MetricJsonOptions& opts) const OVERRIDE;
+  virtual void WriteAsPrometheus(const std::string& name,
+                                 const std::string& labels,
+                                 std::ostream* out) const OVERRIDE;
+  virtual Status WriteAsProtobuf(MetricPB* pb, const MetricJsonOptions& opts) const OVERRIDE;
 
   // Returns a snapshot of this histogram including the bucketed values and counts.
   Status GetHistogramSnapshotPB(HistogramSnapshotPB* snapshot,
@@ -995,8 +1164,27 @@ class Histogram : public Metric {
   FRIEND_TEST(MetricsTest, SimpleHistogramTest);
   friend class MetricEntity;
   explicit Histogram(const HistogramPrototype* proto);
+  virtual ~Histogram();
+
+  // Returns the shard for the current CPU, creating it if needed.
+  HdrHistogram* GetShard();
+
+  // Adds the values recorded in all the shards to 'snapshot'.
+  void MergeShardsInto(HdrHistogram* snapshot) const;
+
+  // Returns a merged snapshot of the histogram and all of its shards. If the
+  // histogram isn't sharded, returns 'histogram_' itself and leaves 'storage'
+  // untouched.
+  const HdrHistogram* Snapshot(gscoped_ptr<HdrHistogram>* storage) const;
 
   const gscoped_ptr<HdrHistogram> histogram_;
+
+  // If the histogram is sharded, the shard of each CPU, or null for the CPUs
+  // which haven't recorded any value yet. Values recorded into 'histogram_'
+  // directly are merged in as well.
+  int num_shards_;
+  gscoped_array<AtomicWord> shards_;
+
   DISALLOW_COPY_AND_ASSIGN(Histogram);
 };
 
@@ -24,6 +24,7 @@
 #include "kudu/gutil/walltime.h"
 #include "kudu/util/debug-util.h"
 #include "kudu/util/env.h"
+#include "kudu/util/spinlock_profiling.h"
 #include "kudu/util/trace.h"
 
 namespace kudu {
@@ -95,6 +96,7 @@ void Mutex::Acquire() {
   int64_t wait_time = end_time - start_time;
   if (wait_time > 0) {
     TRACE_COUNTER_INCREMENT("mutex_wait_us", wait_time);
+    SubmitLockContention(LockType::MUTEX, wait_time);
   }
 
 #ifndef NDEBUG
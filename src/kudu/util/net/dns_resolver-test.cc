@@ -18,6 +18,7 @@
 #include "kudu/util/net/dns_resolver.h"
 
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <vector>
 
@@ -27,6 +28,8 @@
 #include "kudu/util/net/sockaddr.h"
 #include "kudu/util/test_util.h"
 
+DECLARE_int32(dns_resolver_cache_ttl_sec);
+
 using std::vector;
 
 namespace kudu {
@@ -52,4 +55,35 @@ TEST_F(DnsResolverTest, TestResolution) {
   }
 }
 
+// Cached resolutions are returned inline, with the same addresses.
+TEST_F(DnsResolverTest, TestCachedResolution) {
+  HostPort hp("localhost", 12345);
+  vector<Sockaddr> addrs;
+  Synchronizer s;
+  resolver_.ResolveAddresses(hp, &addrs, s.AsStatusCallback());
+  ASSERT_OK(s.Wait());
+  ASSERT_FALSE(addrs.empty());
+
+  vector<Sockaddr> cached_addrs;
+  Synchronizer cached;
+  resolver_.ResolveAddresses(hp, &cached_addrs, cached.AsStatusCallback());
+  ASSERT_OK(cached.WaitFor(MonoDelta::FromMilliseconds(0)));
+  ASSERT_EQ(addrs.size(), cached_addrs.size());
+  for (int i = 0; i < addrs.size(); i++) {
+    ASSERT_EQ(addrs[i].ToString(), cached_addrs[i].ToString());
+  }
+
+  // Without caching, resolutions still work.
+  google::FlagSaver saver;
+  FLAGS_dns_resolver_cache_ttl_sec = 0;
+  DnsResolver uncached_resolver;
+  for (int i = 0; i < 2; i++) {
+    Synchronizer uncached;
+    vector<Sockaddr> uncached_addrs;
+    uncached_resolver.ResolveAddresses(hp, &uncached_addrs, uncached.AsStatusCallback());
+    ASSERT_OK(uncached.Wait());
+    ASSERT_FALSE(uncached_addrs.empty());
+  }
+}
+
 } // namespace kudu
@@ -20,8 +20,11 @@
 #include <boost/bind.hpp>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
+#include <mutex>
+#include <string>
 #include <vector>
 
+#include "kudu/gutil/map-util.h"
 #include "kudu/util/flag_tags.h"
 #include "kudu/util/threadpool.h"
 #include "kudu/util/net/net_util.h"
@@ -30,6 +33,19 @@
 DEFINE_int32(dns_num_resolver_threads, 1, "The number of threads to use for DNS resolution");
 TAG_FLAG(dns_num_resolver_threads, advanced);
 
+DEFINE_int32(dns_resolver_cache_ttl_sec, 15,
+             "How long the result of a successful DNS resolution is cached for. "
+             "If 0, results aren't cached.");
+TAG_FLAG(dns_resolver_cache_ttl_sec, advanced);
+TAG_FLAG(dns_resolver_cache_ttl_sec, runtime);
+
+DEFINE_int32(dns_resolver_cache_negative_ttl_sec, 2,
+             "How long the failure of a DNS resolution is cached for. If 0, "
+             "failures aren't cached.");
+TAG_FLAG(dns_resolver_cache_negative_ttl_sec, advanced);
+TAG_FLAG(dns_resolver_cache_negative_ttl_sec, runtime);
+
+using std::string;
 using std::vector;
 
 namespace kudu {
@@ -44,20 +60,100 @@ DnsResolver::~DnsResolver() {
   pool_->Shutdown();
 }
 
-namespace {
-static void DoResolution(const HostPort &hostport, vector<Sockaddr>* addresses,
-                         StatusCallback cb) {
-  cb.Run(hostport.ResolveAddresses(addresses));
-}
-} // anonymous namespace
-
 void DnsResolver::ResolveAddresses(const HostPort& hostport,
                                    vector<Sockaddr>* addresses,
                                    const StatusCallback& cb) {
-  Status s = pool_->SubmitFunc(boost::bind(&DoResolution, hostport, addresses, cb));
+  string key = hostport.ToString();
+  Status cached_status;
+  bool cached = false;
+  bool refresh = false;
+  {
+    std::lock_guard<simple_spinlock> l(lock_);
+    CacheEntry* entry = FindOrNull(cache_, key);
+    MonoTime now = MonoTime::Now(MonoTime::FINE);
+    if (entry && now.ComesBefore(entry->expiration)) {
+      cached = true;
+      cached_status = entry->status;
+      if (addresses) {
+        *addresses = entry->addresses;
+      }
+      if (entry->status.ok() && !entry->refreshing && !now.ComesBefore(entry->refresh_time)) {
+        entry->refreshing = true;
+        refresh = true;
+      }
+    }
+  }
+
+  if (refresh) {
+    Status s = pool_->SubmitFunc(boost::bind(&DnsResolver::DoRefresh, this, hostport));
+    if (!s.ok()) {
+      std::lock_guard<simple_spinlock> l(lock_);
+      CacheEntry* entry = FindOrNull(cache_, key);
+      if (entry) {
+        entry->refreshing = false;
+      }
+    }
+  }
+  if (cached) {
+    cb.Run(cached_status);
+    return;
+  }
+
+  Status s = pool_->SubmitFunc(boost::bind(&DnsResolver::DoResolution, this,
+                                           hostport, addresses, cb));
   if (!s.ok()) {
     cb.Run(s);
   }
 }
 
+void DnsResolver::DoResolution(const HostPort& hostport, vector<Sockaddr>* addresses,
+                               const StatusCallback& cb) {
+  vector<Sockaddr> resolved;
+  Status s = hostport.ResolveAddresses(&resolved);
+  StoreResult(hostport.ToString(), s, resolved);
+  if (addresses) {
+    addresses->swap(resolved);
+  }
+  cb.Run(s);
+}
+
+void DnsResolver::DoRefresh(const HostPort& hostport) {
+  vector<Sockaddr> resolved;
+  Status s = hostport.ResolveAddresses(&resolved);
+  string key = hostport.ToString();
+  if (s.ok()) {
+    StoreResult(key, s, resolved);
+    return;
+  }
+  // Keep using the previous result until it expires.
+  VLOG(1) << "Unable to refresh the addresses of " << key << ": " << s.ToString();
+  std::lock_guard<simple_spinlock> l(lock_);
+  CacheEntry* entry = FindOrNull(cache_, key);
+  if (entry) {
+    entry->refreshing = false;
+  }
+}
+
+void DnsResolver::StoreResult(const string& key, const Status& s,
+                              const vector<Sockaddr>& addresses) {
+  int32_t ttl_sec = s.ok() ? FLAGS_dns_resolver_cache_ttl_sec :
+      FLAGS_dns_resolver_cache_negative_ttl_sec;
+  std::lock_guard<simple_spinlock> l(lock_);
+  if (ttl_sec <= 0) {
+    cache_.erase(key);
+    return;
+  }
+  MonoTime now = MonoTime::Now(MonoTime::FINE);
+  CacheEntry& entry = cache_[key];
+  entry.status = s;
+  entry.addresses = addresses;
+  entry.expiration = now;
+  entry.expiration.AddDelta(MonoDelta::FromSeconds(ttl_sec));
+  // Refresh the entry once three quarters of its TTL have passed, so that
+  // hosts which are looked up regularly never have to wait for the DNS.
+  entry.refresh_time = now;
+  entry.refresh_time.AddDelta(MonoDelta::FromMilliseconds(ttl_sec * 750L));
+  entry.refreshing = false;
+}
+
 } // namespace kudu
@@ -17,20 +17,32 @@
 #ifndef KUDU_UTIL_NET_DNS_RESOLVER_H
 #define KUDU_UTIL_NET_DNS_RESOLVER_H
 
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "kudu/gutil/gscoped_ptr.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/util/async_util.h"
+#include "kudu/util/locks.h"
+#include "kudu/util/monotime.h"
+#include "kudu/util/net/sockaddr.h"
 #include "kudu/util/status.h"
 
 namespace kudu {
 
 class HostPort;
-class Sockaddr;
 class ThreadPool;
 
 // DNS Resolver which supports async address resolution.
+// Resolves host names on a thread pool, caching the results.
+//
+// Successful resolutions are cached for --dns_resolver_cache_ttl_sec and
+// failed ones for --dns_resolver_cache_negative_ttl_sec, so that a slow or
+// failing DNS server isn't queried again and again for the same hosts. Once
+// a successful result gets close to its expiry, the next lookup returns it
+// and refreshes it in the background; if the refresh fails, the cached
+// result keeps being used until it expires.
 class DnsResolver {
  public:
   DnsResolver();
@@ -47,15 +59,45 @@ class DnsResolver {
   //
   // NOTE: the callback should be fast since it is called by the DNS
   // resolution thread.
-  // NOTE: in some rare cases, the callback may also be called inline
-  // from this function call, on the caller's thread.
+  // NOTE: the callback is called inline from this function call, on the
+  // caller's thread, when the result is cached or the resolution can't be
+  // started.
   void ResolveAddresses(const HostPort& hostport,
                         std::vector<Sockaddr>* addresses,
                         const StatusCallback& cb);
 
  private:
+  struct CacheEntry {
+    Status status;
+    std::vector<Sockaddr> addresses;
+    // The entry is no longer used after this time.
+    MonoTime expiration;
+    // A lookup after this time refreshes the entry in the background.
+    MonoTime refresh_time;
+    // Whether a background refresh of the entry is in progress.
+    bool refreshing;
+  };
+
+  // Resolves 'hostport' and caches the result, then returns it through
+  // 'addresses' and 'cb'. Runs on the resolver pool.
+  void DoResolution(const HostPort& hostport, std::vector<Sockaddr>* addresses,
+                    const StatusCallback& cb);
+
+  // Resolves 'hostport' again, replacing its cached result if successful.
+  // Runs on the resolver pool.
+  void DoRefresh(const HostPort& hostport);
+
+  // Caches the result of resolving the host:port pair 'key'.
+  void StoreResult(const std::string& key, const Status& s,
+                   const std::vector<Sockaddr>& addresses);
+
   gscoped_ptr<ThreadPool> pool_;
 
+  // Protects 'cache_'.
+  simple_spinlock lock_;
+  // Cached results, keyed by host:port.
+  std::unordered_map<std::string, CacheEntry> cache_;
+
   DISALLOW_COPY_AND_ASSIGN(DnsResolver);
 };
 
@@ -0,0 +1,52 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gtest/gtest.h>
+
+#include "kudu/util/numa.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+namespace kudu {
+
+class NumaTest : public KuduTest {};
+
+TEST_F(NumaTest, TestTopology) {
+  int num_nodes = NumaNodeCount();
+  ASSERT_GE(num_nodes, 1);
+  int node = CurrentNumaNode();
+  ASSERT_GE(node, 0);
+  ASSERT_LT(node, num_nodes);
+  ASSERT_EQ(0, NumaNodeOfCpu(-1));
+  ASSERT_TRUE(BindCurrentThreadToNumaNode(num_nodes).IsInvalidArgument());
+}
+
+TEST_F(NumaTest, TestBindCurrentThread) {
+  // Some of the nodes' CPUs may be off limits to this process.
+  for (int node = 0; node < NumaNodeCount(); node++) {
+    Status s = BindCurrentThreadToNumaNode(node);
+    if (s.IsIllegalState()) {
+      continue;
+    }
+    ASSERT_OK(s);
+    if (NumaNodeCount() > 1) {
+      ASSERT_EQ(node, CurrentNumaNode());
+    }
+  }
+}
+
+} // namespace kudu
@@ -0,0 +1,206 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/numa.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/once.h"
+#include "kudu/gutil/strings/numbers.h"
+#include "kudu/gutil/strings/split.h"
+#include "kudu/gutil/strings/strip.h"
+#include "kudu/gutil/strings/substitute.h"
+#include "kudu/util/env.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/faststring.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_bool(numa_aware_placement, false,
+            "Whether to bind the RPC reactor and service threads to the NUMA "
+            "nodes of the machine in turn, and to hand each incoming call to "
+            "a service thread on the node of the reactor which read it. Has "
+            "no effect on machines with a single NUMA node.");
+TAG_FLAG(numa_aware_placement, advanced);
+TAG_FLAG(numa_aware_placement, experimental);
+
+using std::string;
+using std::vector;
+using strings::Substitute;
+
+namespace kudu {
+
+namespace {
+
+struct NumaTopology {
+  // The CPUs of each node with any. Nodes are renumbered densely from 0 if
+  // the kernel's numbering has gaps.
+  vector<vector<int>> node_cpus;
+
+  // The node of each CPU, indexed by CPU number.
+  vector<int> cpu_node;
+};
+
+NumaTopology* g_topology;
+GoogleOnceType g_topology_once = GOOGLE_ONCE_INIT;
+
+// Parses a list of CPUs such as "0-3,8,10-11", as found in the 'cpulist'
+// files of sysfs.
+bool ParseCpuList(const string& list, vector<int>* cpus) {
+  vector<string> ranges = strings::Split(list, ",", strings::SkipEmpty());
+  for (const string& range : ranges) {
+    vector<string> bounds = strings::Split(range, "-");
+    int32 first;
+    int32 last;
+    if (!safe_strto32(bounds[0], &first)) {
+      return false;
+    }
+    last = first;
+    if (bounds.size() == 2 && !safe_strto32(bounds[1], &last)) {
+      return false;
+    }
+    if (bounds.size() > 2 || first < 0 || last < first) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      cpus->push_back(cpu);
+    }
+  }
+  return true;
+}
+
+void InitTopology() {
+  NumaTopology* t = new NumaTopology();
+#if defined(__linux__)
+  Env* env = Env::Default();
+  // Node numbers may have gaps, e.g. with memory-only nodes, but not many.
+  for (int node = 0; node < 1024; node++) {
+    string path = Substitute("/sys/devices/system/node/node$0/cpulist", node);
+    if (!env->FileExists(path)) {
+      continue;
+    }
+    faststring contents;
+    vector<int> cpus;
+    Status s = ReadFileToString(env, path, &contents);
+    string list = contents.ToString();
+    StripWhiteSpace(&list);
+    if (!s.ok() || !ParseCpuList(list, &cpus)) {
+      LOG(WARNING) << "Unable to read the CPUs of NUMA node " << node << " from " << path
+                   << ": " << (s.ok() ? "unexpected format: " + list : s.ToString());
+      t->node_cpus.clear();
+      break;
+    }
+    if (cpus.empty()) {
+      continue;
+    }
+    t->node_cpus.emplace_back(std::move(cpus));
+  }
+#endif // defined(__linux__)
+
+  if (t->node_cpus.empty()) {
+    // Treat the machine as a single node.
+    t->node_cpus.emplace_back();
+  }
+  for (int node = 0; node < t->node_cpus.size(); node++) {
+    for (int cpu : t->node_cpus[node]) {
+      if (cpu >= t->cpu_node.size()) {
+        t->cpu_node.resize(cpu + 1, 0);
+      }
+      t->cpu_node[cpu] = node;
+    }
+  }
+  g_topology = t;
+}
+
+const NumaTopology& Topology() {
+  GoogleOnceInit(&g_topology_once, &InitTopology);
+  return *g_topology;
+}
+
+} // anonymous namespace
+
+int NumaNodeCount() {
+  return Topology().node_cpus.size();
+}
+
+int NumaNodeOfCpu(int cpu) {
+  const NumaTopology& t = Topology();
+  if (cpu < 0 || cpu >= t.cpu_node.size()) {
+    return 0;
+  }
+  return t.cpu_node[cpu];
+}
+
+int CurrentNumaNode() {
+#if defined(__linux__)
+  return NumaNodeOfCpu(sched_getcpu());
+#else
+  return 0;
+#endif
+}
+
+bool NumaPlacementEnabled() {
+  return FLAGS_numa_aware_placement && NumaNodeCount() > 1;
+}
+
+Status BindCurrentThreadToNumaNode(int node) {
+  const NumaTopology& t = Topology();
+  if (node < 0 || node >= t.node_cpus.size()) {
+    return Status::InvalidArgument("no such NUMA node", std::to_string(node));
+  }
+#if defined(__linux__)
+  if (t.node_cpus[node].empty()) {
+    // The single node of a machine without NUMA.
+    return Status::OK();
+  }
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    int err = errno;
+    return Status::RuntimeError("unable to get the CPU affinity", ErrnoToString(err), err);
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu : t.node_cpus[node]) {
+    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+      CPU_SET(cpu, &cpus);
+    }
+  }
+  if (CPU_COUNT(&cpus) == 0) {
+    // E.g. the process was confined to other nodes' CPUs by a cpuset.
+    return Status::IllegalState(Substitute("none of the CPUs of NUMA node $0 are allowed",
+                                           node));
+  }
+  if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+    int err = errno;
+    return Status::RuntimeError("unable to set the CPU affinity", ErrnoToString(err), err);
+  }
+  return Status::OK();
+#else
+  return Status::OK();
+#endif // defined(__linux__)
+}
+
+} // namespace kudu
@@ -0,0 +1,48 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_NUMA_H
+#define KUDU_UTIL_NUMA_H
+
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// Utilities for placing threads on the NUMA nodes of the machine, read from
+// /sys/devices/system/node. On machines or kernels without NUMA, or other
+// platforms, everything is on a single node 0.
+
+// Return the number of NUMA nodes with CPUs.
+int NumaNodeCount();
+
+// Return the NUMA node of the given CPU, or 0 if it's unknown.
+int NumaNodeOfCpu(int cpu);
+
+// Return the NUMA node of the CPU the calling thread is running on.
+int CurrentNumaNode();
+
+// Whether the server's threads should be placed on NUMA nodes, i.e. whether
+// --numa_aware_placement is set and there is more than one node.
+bool NumaPlacementEnabled();
+
+// Restrict the calling thread to the CPUs of NUMA node 'node', among those
+// it may already run on. Memory it then allocates and first touches comes
+// from that node under the kernel's default policy.
+Status BindCurrentThreadToNumaNode(int node);
+
+} // namespace kudu
+
+#endif /* KUDU_UTIL_NUMA_H */
@@ -21,7 +21,10 @@
 #include <mutex>
 
 #include "kudu/gutil/map-util.h"
+#include "kudu/gutil/port.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/util/env.h"
+#include "kudu/util/spinlock_profiling.h"
 
 using std::lock_guard;
 
@@ -88,7 +91,13 @@ RWMutex::~RWMutex() {
 
 void RWMutex::ReadLock() {
   CheckLockState(LockState::NEITHER);
-  int rv = pthread_rwlock_rdlock(&native_handle_);
+  // As in Mutex::Acquire(), only time the acquisition if it's contended.
+  int rv = pthread_rwlock_tryrdlock(&native_handle_);
+  if (PREDICT_FALSE(rv == EBUSY)) {
+    MicrosecondsInt64 start_time = GetMonoTimeMicros();
+    rv = pthread_rwlock_rdlock(&native_handle_);
+    SubmitLockContention(LockType::RW_MUTEX, GetMonoTimeMicros() - start_time);
+  }
   DCHECK_EQ(0, rv) << strerror(rv);
   MarkForReading();
 }
@@ -112,7 +121,13 @@ bool RWMutex::TryReadLock() {
 
 void RWMutex::WriteLock() {
   CheckLockState(LockState::NEITHER);
-  int rv = pthread_rwlock_wrlock(&native_handle_);
+  // As in Mutex::Acquire(), only time the acquisition if it's contended.
+  int rv = pthread_rwlock_trywrlock(&native_handle_);
+  if (PREDICT_FALSE(rv == EBUSY)) {
+    MicrosecondsInt64 start_time = GetMonoTimeMicros();
+    rv = pthread_rwlock_wrlock(&native_handle_);
+    SubmitLockContention(LockType::RW_MUTEX, GetMonoTimeMicros() - start_time);
+  }
   DCHECK_EQ(0, rv) << strerror(rv);
   MarkForWriting();
 }
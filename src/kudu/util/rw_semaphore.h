@@ -23,7 +23,9 @@
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/port.h"
+#include "kudu/gutil/walltime.h"
 #include "kudu/util/debug-util.h"
+#include "kudu/util/spinlock_profiling.h"
 
 #include "kudu/util/thread.h"
 
@@ -65,6 +67,7 @@ class rw_semaphore {
 
   void lock_shared() {
     int loop_count = 0;
+    MicrosecondsInt64 wait_start = 0;
     Atomic32 cur_state = base::subtle::NoBarrier_Load(&state_);
     while (true) {
       Atomic32 expected = cur_state & kNumReadersMask;   // I expect no write lock
@@ -73,8 +76,9 @@ class rw_semaphore {
       if (cur_state == expected)
         break;
       // Either was already locked by someone else, or CAS failed.
-      boost::detail::yield(loop_count++);
+      Yield(&loop_count, &wait_start);
     }
+    RecordWait(loop_count, wait_start);
   }
 
   void unlock_shared() {
@@ -97,6 +101,7 @@ class rw_semaphore {
   // This function retries on CAS failure and waits for readers to complete.
   bool try_lock() {
     int loop_count = 0;
+    MicrosecondsInt64 wait_start = 0;
     Atomic32 cur_state = base::subtle::NoBarrier_Load(&state_);
     while (true) {
       // someone else has already the write lock
@@ -109,16 +114,18 @@ class rw_semaphore {
       if (cur_state == expected)
         break;
       // Either was already locked by someone else, or CAS failed.
-      boost::detail::yield(loop_count++);
+      Yield(&loop_count, &wait_start);
     }
 
-    WaitPendingReaders();
+    WaitPendingReaders(&loop_count, &wait_start);
+    RecordWait(loop_count, wait_start);
     RecordLockHolderStack();
     return true;
   }
 
   void lock() {
     int loop_count = 0;
+    MicrosecondsInt64 wait_start = 0;
     Atomic32 cur_state = base::subtle::NoBarrier_Load(&state_);
     while (true) {
       Atomic32 expected = cur_state & kNumReadersMask;   // I expect some 0+ readers
@@ -129,10 +136,11 @@ class rw_semaphore {
       if (cur_state == expected)
         break;
       // Either was already locked by someone else, or CAS failed.
-      boost::detail::yield(loop_count++);
+      Yield(&loop_count, &wait_start);
     }
 
-    WaitPendingReaders();
+    WaitPendingReaders(&loop_count, &wait_start);
+    RecordWait(loop_count, wait_start);
 
 #ifndef NDEBUG
     writer_tid_ = Thread::CurrentThreadId();
@@ -185,10 +193,26 @@ class rw_semaphore {
   }
 #endif
 
-  void WaitPendingReaders() {
-    int loop_count = 0;
+  void WaitPendingReaders(int* loop_count, MicrosecondsInt64* wait_start) {
     while ((base::subtle::Acquire_Load(&state_) & kNumReadersMask) > 0) {
-      boost::detail::yield(loop_count++);
+      Yield(loop_count, wait_start);
+    }
+  }
+
+  // Backs off before the next attempt to acquire the lock, noting when the
+  // thread first had to.
+  static void Yield(int* loop_count, MicrosecondsInt64* wait_start) {
+    if (*loop_count == 0) {
+      *wait_start = GetMonoTimeMicros();
+    }
+    boost::detail::yield((*loop_count)++);
+  }
+
+  // Submits the time spent acquiring the lock to the contention profiles,
+  // if the thread had to wait.
+  static void RecordWait(int loop_count, MicrosecondsInt64 wait_start) {
+    if (PREDICT_FALSE(loop_count > 0)) {
+      SubmitLockContention(LockType::RW_SPINLOCK, GetMonoTimeMicros() - wait_start);
     }
   }
 
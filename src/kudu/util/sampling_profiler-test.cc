@@ -0,0 +1,71 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gflags/gflags.h>
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+#include "kudu/util/monotime.h"
+#include "kudu/util/sampling_profiler.h"
+#include "kudu/util/test_macros.h"
+#include "kudu/util/test_util.h"
+
+DECLARE_int32(sampling_profiler_frequency_hz);
+
+namespace kudu {
+
+class SamplingProfilerTest : public KuduTest {};
+
+static int64_t BurnCpu(const MonoDelta& duration) {
+  MonoTime deadline = MonoTime::Now(MonoTime::FINE);
+  deadline.AddDelta(duration);
+  int64_t x = 0;
+  while (MonoTime::Now(MonoTime::FINE).ComesBefore(deadline)) {
+    for (int i = 0; i < 1000; i++) {
+      x += i * x + 1;
+    }
+  }
+  return x;
+}
+
+TEST_F(SamplingProfilerTest, TestTaggedSamples) {
+#if defined(__linux__)
+  FLAGS_sampling_profiler_frequency_hz = 1000;
+  ASSERT_OK(StartSamplingProfiler());
+  // Starting it again does nothing.
+  ASSERT_OK(StartSamplingProfiler());
+
+  {
+    ScopedSamplingProfilerTag tag("test-outer-tag");
+    {
+      ScopedSamplingProfilerTag inner(nullptr);
+      ASSERT_STREQ("test-outer-tag", ScopedSamplingProfilerTag::current_tag());
+    }
+    ScopedSamplingProfilerTag inner("test-inner-tag");
+    BurnCpu(MonoDelta::FromMilliseconds(500));
+  }
+  ASSERT_TRUE(ScopedSamplingProfilerTag::current_tag() == nullptr);
+
+  std::ostringstream out;
+  DumpSamplingProfile(60, &out);
+  string profile = out.str();
+  ASSERT_STR_CONTAINS(profile, "test-inner-tag;");
+#endif // defined(__linux__)
+}
+
+} // namespace kudu
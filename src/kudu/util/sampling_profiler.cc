@@ -0,0 +1,304 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/sampling_profiler.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+#include "kudu/gutil/atomicops.h"
+#include "kudu/gutil/walltime.h"
+#include "kudu/util/debug-util.h"
+#include "kudu/util/errno.h"
+#include "kudu/util/flag_tags.h"
+
+DEFINE_int32(sampling_profiler_frequency_hz, 10,
+             "How many stack samples per second of CPU time the process "
+             "consumes are taken by the continuous sampling profiler, "
+             "available at /pprof/collapsed. 0 disables the profiler.");
+TAG_FLAG(sampling_profiler_frequency_hz, advanced);
+TAG_FLAG(sampling_profiler_frequency_hz, experimental);
+
+DEFINE_int32(sampling_profiler_window_secs, 60,
+             "The length of the time windows into which the samples of the "
+             "continuous sampling profiler are aggregated.");
+TAG_FLAG(sampling_profiler_window_secs, advanced);
+TAG_FLAG(sampling_profiler_window_secs, experimental);
+
+DEFINE_int32(sampling_profiler_num_windows, 10,
+             "How many of the most recent time windows of samples the "
+             "continuous sampling profiler keeps.");
+TAG_FLAG(sampling_profiler_num_windows, advanced);
+TAG_FLAG(sampling_profiler_num_windows, experimental);
+
+// GLog already implements symbolization. Just import their hidden symbol.
+namespace google {
+// Symbolizes a program counter.  On success, returns true and write the
+// symbol name to "out".  The symbol name is demangled if possible
+// (supports symbols generated by GCC 3.x or newer).  Otherwise,
+// returns false.
+bool Symbolize(void *pc, char *out, int out_size);
+}
+
+using std::map;
+using std::string;
+using std::unordered_map;
+
+namespace kudu {
+
+__thread const char* ScopedSamplingProfilerTag::current_tag_ = nullptr;
+
+namespace {
+
+// The stacks sampled during one window of time, counted in a fixed-size
+// hashtable. Each window's table is reused for a later window once it falls
+// out of the ring buffer: its entries are free again as soon as they belong
+// to an earlier window.
+//
+// Samples are recorded from a signal handler, so the entries are guarded by
+// bare atomics rather than SpinLocks, which may futex() and so are not
+// async-signal-safe. A sample is dropped rather than waited for if its entry
+// is locked.
+struct Window {
+  enum {
+    kNumEntries = 1024,
+    kNumLinearProbeAttempts = 4
+  };
+
+  struct Entry {
+    Entry() : lock(0), window_id(-1), count(0), hash(0), tag(nullptr) {}
+
+    // 1 while a thread is reading or updating the other fields.
+    Atomic32 lock;
+
+    // The window this entry was last claimed for: the number of windows
+    // elapsed since the monotonic clock's epoch.
+    int64_t window_id;
+
+    // The number of times the stack was sampled with the tag.
+    int64_t count;
+
+    // A cached hashcode of the stack and tag.
+    uint64_t hash;
+
+    const char* tag;
+    StackTrace trace;
+  };
+
+  Entry entries[kNumEntries];
+};
+
+// The ring buffer of windows, set once by StartSamplingProfiler() before the
+// timer is armed.
+Window* g_windows = nullptr;
+int g_num_windows = 0;
+int64_t g_window_usecs = 0;
+
+std::mutex g_start_lock;
+bool g_started = false;
+
+void RecordSample(const StackTrace& stack, const char* tag, int64_t window_id) {
+  Window* w = &g_windows[window_id % g_num_windows];
+  uint64_t hash = stack.HashCode() ^ reinterpret_cast<uintptr_t>(tag);
+
+  for (int i = 0; i < Window::kNumLinearProbeAttempts; i++) {
+    Window::Entry* e = &w->entries[(hash + i) % Window::kNumEntries];
+    if (base::subtle::Acquire_CompareAndSwap(&e->lock, 0, 1) != 0) {
+      // Another thread is using the entry. It's OK for a stack to show up in
+      // several entries, since they're aggregated when dumped.
+      continue;
+    }
+
+    if (e->window_id != window_id) {
+      // It's left over from an earlier window. Claim it.
+      e->window_id = window_id;
+      e->count = 0;
+      e->hash = hash;
+      e->tag = tag;
+      e->trace.CopyFrom(stack);
+    } else if (e->hash != hash || e->tag != tag || !e->trace.Equals(stack)) {
+      // It's claimed by a different stack.
+      base::subtle::Release_Store(&e->lock, 0);
+      continue;
+    }
+
+    e->count++;
+    base::subtle::Release_Store(&e->lock, 0);
+    return;
+  }
+}
+
+void HandleProfilerSignal(int signum) {
+  int saved_errno = errno;
+  StackTrace stack;
+  // Skip Collect() itself and this function.
+  stack.Collect(2);
+  RecordSample(stack, ScopedSamplingProfilerTag::current_tag(),
+               GetMonoTimeMicros() / g_window_usecs);
+  errno = saved_errno;
+}
+
+// Appends the symbol for the return address 'pc', looking it up in 'cache'
+// first, since a profile symbolizes the same frames over and over.
+void AppendSymbol(void* pc, unordered_map<void*, string>* cache, string* out) {
+  auto it = cache->find(pc);
+  if (it == cache->end()) {
+    char tmp[1024];
+    string symbol;
+    // Subtract 1 so that 'pc' points into the 'call' instruction; see
+    // StackTrace::Symbolize().
+    if (google::Symbolize(reinterpret_cast<char*>(pc) - 1, tmp, sizeof(tmp))) {
+      symbol = tmp;
+      // Semicolons separate the frames of a collapsed stack.
+      std::replace(symbol.begin(), symbol.end(), ';', ':');
+    } else {
+      symbol = "(unknown)";
+    }
+    it = cache->emplace(pc, std::move(symbol)).first;
+  }
+  out->append(it->second);
+}
+
+} // anonymous namespace
+
+Status StartSamplingProfiler() {
+  std::lock_guard<std::mutex> l(g_start_lock);
+  if (g_started || FLAGS_sampling_profiler_frequency_hz <= 0) {
+    return Status::OK();
+  }
+#if defined(__linux__)
+  CHECK_GT(FLAGS_sampling_profiler_window_secs, 0);
+  CHECK_GT(FLAGS_sampling_profiler_num_windows, 0);
+
+  // The glibc implementation reserves the first real-time signals, which
+  // SIGRTMIN accounts for. Use one that isn't commonly claimed by libraries.
+  const int signum = SIGRTMIN + 4;
+  struct sigaction old_act;
+  PCHECK(sigaction(signum, nullptr, &old_act) == 0);
+  if (old_act.sa_handler != SIG_DFL && old_act.sa_handler != SIG_IGN) {
+    return Status::IllegalState("signal handler for the sampling profiler is already in use",
+                                std::to_string(signum));
+  }
+
+  g_num_windows = FLAGS_sampling_profiler_num_windows;
+  g_window_usecs = FLAGS_sampling_profiler_window_secs * 1000000L;
+  g_windows = new Window[g_num_windows];
+
+  struct sigaction act;
+  memset(&act, 0, sizeof(act));
+  act.sa_handler = &HandleProfilerSignal;
+  sigemptyset(&act.sa_mask);
+  // The signal goes to a thread which is running rather than blocked in a
+  // system call, but restart the call if it isn't.
+  act.sa_flags = SA_RESTART;
+  PCHECK(sigaction(signum, &act, nullptr) == 0);
+
+  struct sigevent sev;
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_SIGNAL;
+  sev.sigev_signo = signum;
+  timer_t timer;
+  if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &sev, &timer) != 0) {
+    int err = errno;
+    return Status::RuntimeError("unable to create the sampling profiler timer",
+                                ErrnoToString(err), err);
+  }
+  int64_t interval_nanos = 1000000000L / FLAGS_sampling_profiler_frequency_hz;
+  struct itimerspec spec;
+  spec.it_interval.tv_sec = interval_nanos / 1000000000L;
+  spec.it_interval.tv_nsec = interval_nanos % 1000000000L;
+  spec.it_value = spec.it_interval;
+  if (timer_settime(timer, 0, &spec, nullptr) != 0) {
+    int err = errno;
+    return Status::RuntimeError("unable to arm the sampling profiler timer",
+                                ErrnoToString(err), err);
+  }
+  g_started = true;
+  LOG(INFO) << "Started the sampling profiler at "
+            << FLAGS_sampling_profiler_frequency_hz << " samples per second of CPU time";
+  return Status::OK();
+#else
+  return Status::NotSupported("the sampling profiler is only supported on Linux");
+#endif // defined(__linux__)
+}
+
+void DumpSamplingProfile(int seconds, std::ostream* out) {
+  {
+    std::lock_guard<std::mutex> l(g_start_lock);
+    if (!g_started) {
+      return;
+    }
+  }
+  int64_t now_window_id = GetMonoTimeMicros() / g_window_usecs;
+  int64_t num_windows = (std::max<int64_t>(seconds, 1) * 1000000L + g_window_usecs - 1) /
+      g_window_usecs;
+  num_windows = std::min<int64_t>(num_windows, g_num_windows);
+  int64_t min_window_id = now_window_id - num_windows + 1;
+
+  // Collapse the stacks first, since the same one may have been sampled in
+  // several windows or entries.
+  unordered_map<void*, string> symbols;
+  map<string, int64_t> counts;
+  StackTrace trace;
+  for (int64_t id = min_window_id; id <= now_window_id; id++) {
+    Window* w = &g_windows[id % g_num_windows];
+    for (auto& e : w->entries) {
+      const char* tag;
+      int64_t count;
+      while (base::subtle::Acquire_CompareAndSwap(&e.lock, 0, 1) != 0) {
+        sched_yield();
+      }
+      count = e.window_id == id ? e.count : 0;
+      tag = e.tag;
+      trace.CopyFrom(e.trace);
+      base::subtle::Release_Store(&e.lock, 0);
+      if (count == 0) {
+        continue;
+      }
+
+      string collapsed;
+      if (tag) {
+        collapsed.append(tag);
+      }
+      for (int i = trace.num_frames() - 1; i >= 0; i--) {
+        if (!collapsed.empty()) {
+          collapsed.push_back(';');
+        }
+        AppendSymbol(trace.frame(i), &symbols, &collapsed);
+      }
+      counts[collapsed] += count;
+    }
+  }
+
+  for (const auto& entry : counts) {
+    *out << entry.first << " " << entry.second << "\n";
+  }
+}
+
+} // namespace kudu
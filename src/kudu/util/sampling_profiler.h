@@ -0,0 +1,87 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_SAMPLING_PROFILER_H
+#define KUDU_UTIL_SAMPLING_PROFILER_H
+
+#include <iosfwd>
+
+#include "kudu/gutil/macros.h"
+#include "kudu/util/status.h"
+
+namespace kudu {
+
+// A low-frequency CPU profiler meant to run for the whole life of the
+// process, so that the cause of a regression can be looked for after the
+// fact.
+//
+// A timer on the CPU time consumed by the process interrupts whichever thread
+// is running every 1/--sampling_profiler_frequency_hz seconds of CPU time,
+// and that thread records its stack. The samples are counted by stack in a
+// ring buffer of --sampling_profiler_num_windows tables, each covering
+// --sampling_profiler_window_secs seconds of wall time.
+//
+// Unlike the gperftools CPU profiler, this one uses a real-time signal, so
+// both can run at the same time.
+
+// Starts the profiler, unless --sampling_profiler_frequency_hz is 0. Does
+// nothing if it is already running.
+Status StartSamplingProfiler();
+
+// Writes the stacks sampled over about the last 'seconds' seconds, rounded up
+// to whole windows, to 'out' in the "collapsed" format which flame graph tools
+// take: one line per stack, with its frames from the outermost to the
+// innermost separated by semicolons, followed by a space and the number of
+// times it was sampled. The tag the stack was sampled with, if any, is the
+// outermost frame.
+void DumpSamplingProfile(int seconds, std::ostream* out);
+
+// Tags the samples taken on this thread while in scope, e.g. with the name
+// of the RPC method or maintenance operation being run. Tags nest; a null
+// tag leaves the enclosing one in place.
+//
+// 'tag' must stay valid until the process exits, e.g. be a string literal or
+// a name interned with TraceMetrics::InternName(), and must not contain
+// semicolons.
+class ScopedSamplingProfilerTag {
+ public:
+  explicit ScopedSamplingProfilerTag(const char* tag)
+      : prev_tag_(current_tag_) {
+    if (tag) {
+      current_tag_ = tag;
+    }
+  }
+
+  ~ScopedSamplingProfilerTag() {
+    current_tag_ = prev_tag_;
+  }
+
+  // Returns the tag of the current thread, or null if it has none.
+  static const char* current_tag() {
+    return current_tag_;
+  }
+
+ private:
+  static __thread const char* current_tag_;
+
+  const char* const prev_tag_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedSamplingProfilerTag);
+};
+
+} // namespace kudu
+
+#endif /* KUDU_UTIL_SAMPLING_PROFILER_H */
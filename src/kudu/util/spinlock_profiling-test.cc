@@ -76,6 +76,34 @@ TEST_F(SpinLockProfilingTest, TestStackCollection) {
   ASSERT_EQ(0, dropped);
 }
 
+TEST_F(SpinLockProfilingTest, TestContentionSites) {
+  StartLockContentionSiteProfiling();
+  // Both waits come from the same stack.
+  for (int i = 0; i < 2; i++) {
+    SubmitLockContention(LockType::MUTEX, 100);
+  }
+  SubmitLockContention(LockType::CONDITION_VARIABLE, 5000);
+  StopLockContentionSiteProfiling();
+  // Not recorded once profiling is stopped.
+  SubmitLockContention(LockType::MUTEX, 100);
+
+  std::stringstream str;
+  int64_t dropped = 0;
+  FlushLockContentionSites(&str, &dropped);
+  string s = str.str();
+  ASSERT_STR_CONTAINS(s, "mutex waits=2 total_wait_us=200");
+  ASSERT_STR_CONTAINS(s, "wait_us [64,128)=2");
+  ASSERT_STR_CONTAINS(s, "condition_variable waits=1 total_wait_us=5000");
+  // The site that waited longest comes first.
+  ASSERT_LT(s.find("condition_variable"), s.find("mutex"));
+  ASSERT_EQ(0, dropped);
+
+  // Flushing empties the table.
+  str.str("");
+  FlushLockContentionSites(&str, &dropped);
+  ASSERT_EQ("", str.str());
+}
+
 TEST_F(SpinLockProfilingTest, TestTcmallocContention) {
   StartSynchronizationProfiling();
   base::SubmitSpinLockProfileData(nullptr, 12345);
@@ -20,8 +20,13 @@
 #include <glog/logging.h>
 #include <gflags/gflags.h>
 
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/basictypes.h"
+#include "kudu/gutil/bits.h"
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/spinlock.h"
 #include "kudu/gutil/strings/human_readable.h"
@@ -55,6 +60,7 @@ METRIC_DEFINE_gauge_uint64(server, tcmalloc_contention_time,
 
 using base::SpinLock;
 using base::SpinLockHolder;
+using std::vector;
 
 namespace kudu {
 
@@ -149,9 +155,177 @@ class ContentionStacks {
   AtomicInt<int64_t> dropped_samples_;
 };
 
+// Implements a hashtable like ContentionStacks', which keeps a histogram of
+// the waits at each stack and type of lock rather than just their totals.
+class ContentionSites {
+ public:
+  ContentionSites()
+    : dropped_waits_(0) {
+  }
+
+  // Add a wait of 'micros' at the given stack to the table.
+  void AddWait(LockType type, const StackTrace& s, int64_t micros);
+
+  // Flush the sites from the table to 'out'. See the docs for
+  // FlushLockContentionSites() in spinlock_profiling.h for details on format.
+  void Flush(std::ostream* out, int64_t* dropped);
+
+ private:
+  enum {
+    kNumEntries = 1024,
+    kNumLinearProbeAttempts = 4,
+
+    // Bucket i counts the waits of [2^i, 2^(i+1)) microseconds, except for
+    // the first and last, which also count the shorter and longer ones.
+    kNumBuckets = 32
+  };
+
+  struct Entry {
+    Entry() : wait_count(0) {
+    }
+
+    // Protects all other fields.
+    SpinLock lock;
+
+    // The number of waits at this site. If this is 0, then the entry is
+    // "unclaimed" and the other fields are not considered valid.
+    int64_t wait_count;
+
+    int64_t total_wait_micros;
+    int64_t buckets[kNumBuckets];
+
+    LockType type;
+    uint64_t hash;
+    StackTrace trace;
+  };
+
+  // A copy of a flushed entry.
+  struct Site {
+    LockType type;
+    int64_t wait_count;
+    int64_t total_wait_micros;
+    int64_t buckets[kNumBuckets];
+    StackTrace trace;
+  };
+
+  Entry entries_[kNumEntries];
+
+  // The number of waits which were dropped due to contention on this
+  // structure or due to the hashtable being too full.
+  AtomicInt<int64_t> dropped_waits_;
+};
+
+const char* LockTypeToString(LockType type) {
+  switch (type) {
+    case LockType::SPINLOCK: return "spinlock";
+    case LockType::MUTEX: return "mutex";
+    case LockType::RW_MUTEX: return "rw_mutex";
+    case LockType::RW_SPINLOCK: return "rw_spinlock";
+    case LockType::CONDITION_VARIABLE: return "condition_variable";
+  }
+  LOG(FATAL) << "unknown lock type";
+  return "";
+}
+
+void ContentionSites::AddWait(LockType type, const StackTrace& s, int64_t micros) {
+  uint64_t hash = s.HashCode() + static_cast<uint64_t>(type);
+  int bucket = 0;
+  if (micros > 1) {
+    bucket = std::min<int>(Bits::Log2Floor64(micros), kNumBuckets - 1);
+  }
+
+  for (int i = 0; i < kNumLinearProbeAttempts; i++) {
+    Entry* e = &entries_[(hash + i) % kNumEntries];
+    if (!e->lock.TryLock()) {
+      // As in ContentionStacks::AddStack(), it's OK for a site to be spread
+      // over several slots; they're merged when flushed.
+      continue;
+    }
+
+    if (e->wait_count == 0) {
+      // It's an un-claimed slot. Claim it.
+      e->type = type;
+      e->hash = hash;
+      e->trace.CopyFrom(s);
+      e->total_wait_micros = 0;
+      memset(e->buckets, 0, sizeof(e->buckets));
+    } else if (e->hash != hash || e->type != type || !e->trace.Equals(s)) {
+      // It's claimed by a different site.
+      e->lock.Unlock();
+      continue;
+    }
+
+    e->wait_count++;
+    e->total_wait_micros += micros;
+    e->buckets[bucket]++;
+    e->lock.Unlock();
+    return;
+  }
+
+  dropped_waits_.Increment();
+}
+
+void ContentionSites::Flush(std::ostream* out, int64_t* dropped) {
+  vector<Site> sites;
+  for (Entry& e : entries_) {
+    SpinLockHolder l(&e.lock);
+    if (e.wait_count == 0) continue;
+
+    // Merge the slots a site was spread over.
+    Site* site = nullptr;
+    for (Site& other : sites) {
+      if (other.type == e.type && other.trace.Equals(e.trace)) {
+        site = &other;
+        break;
+      }
+    }
+    if (site == nullptr) {
+      sites.emplace_back();
+      site = &sites.back();
+      site->type = e.type;
+      site->wait_count = 0;
+      site->total_wait_micros = 0;
+      memset(site->buckets, 0, sizeof(site->buckets));
+      site->trace.CopyFrom(e.trace);
+    }
+    site->wait_count += e.wait_count;
+    site->total_wait_micros += e.total_wait_micros;
+    for (int i = 0; i < kNumBuckets; i++) {
+      site->buckets[i] += e.buckets[i];
+    }
+
+    e.wait_count = 0;
+  }
+
+  std::sort(sites.begin(), sites.end(), [](const Site& a, const Site& b) {
+      return a.total_wait_micros > b.total_wait_micros;
+    });
+  for (const Site& site : sites) {
+    *out << LockTypeToString(site.type) << " waits=" << site.wait_count
+         << " total_wait_us=" << site.total_wait_micros << std::endl;
+    *out << "  wait_us";
+    for (int i = 0; i < kNumBuckets; i++) {
+      if (site.buckets[i] == 0) continue;
+      *out << " [" << (i == 0 ? 0 : 1L << i) << ",";
+      if (i == kNumBuckets - 1) {
+        *out << "inf";
+      } else {
+        *out << (1L << (i + 1));
+      }
+      *out << ")=" << site.buckets[i];
+    }
+    *out << std::endl << site.trace.Symbolize();
+  }
+
+  *dropped += dropped_waits_.Exchange(0);
+}
+
 Atomic32 g_profiling_enabled = 0;
 ContentionStacks* g_contention_stacks = nullptr;
 
+Atomic32 g_site_profiling_enabled = 0;
+ContentionSites* g_contention_sites = nullptr;
+
 void ContentionStacks::AddStack(const StackTrace& s, int64_t cycles) {
   uint64_t hash = s.HashCode();
 
@@ -221,13 +395,17 @@ bool ContentionStacks::CollectSample(uint64_t* iterator, StackTrace* s, int64_t*
   return false;
 }
 
+int64_t CyclesToMicros(int64_t cycles) {
+  return static_cast<double>(cycles) / base::CyclesPerSecond() * kMicrosPerSecond;
+}
 
 void SubmitSpinLockProfileData(const void *contendedlock, int64 wait_cycles) {
   TRACE_COUNTER_INCREMENT("spinlock_wait_cycles", wait_cycles);
   bool profiling_enabled = base::subtle::Acquire_Load(&g_profiling_enabled);
+  bool site_profiling_enabled = base::subtle::Acquire_Load(&g_site_profiling_enabled);
   bool long_wait_time = wait_cycles > FLAGS_lock_contention_trace_threshold_cycles;
   // Short circuit this function quickly in the common case.
-  if (PREDICT_TRUE(!profiling_enabled && !long_wait_time)) {
+  if (PREDICT_TRUE(!profiling_enabled && !site_profiling_enabled && !long_wait_time)) {
     return;
   }
 
@@ -241,6 +419,10 @@ void SubmitSpinLockProfileData(const void *contendedlock, int64 wait_cycles) {
   if (profiling_enabled) {
     DCHECK_NOTNULL(g_contention_stacks)->AddStack(stack, wait_cycles);
   }
+  if (site_profiling_enabled) {
+    DCHECK_NOTNULL(g_contention_sites)->AddWait(LockType::SPINLOCK, stack,
+                                                CyclesToMicros(wait_cycles));
+  }
 
   if (PREDICT_FALSE(long_wait_time)) {
     Trace* t = Trace::CurrentTrace();
@@ -266,6 +448,8 @@ void SubmitSpinLockProfileData(const void *contendedlock, int64 wait_cycles) {
 void DoInit() {
   base::subtle::Release_Store(reinterpret_cast<AtomicWord*>(&g_contention_stacks),
                               reinterpret_cast<uintptr_t>(new ContentionStacks()));
+  base::subtle::Release_Store(reinterpret_cast<AtomicWord*>(&g_contention_sites),
+                              reinterpret_cast<uintptr_t>(new ContentionSites()));
   base::subtle::Release_Store(reinterpret_cast<AtomicWord*>(&g_contended_cycles),
                               reinterpret_cast<uintptr_t>(new LongAdder()));
 }
@@ -318,6 +502,46 @@ void StopSynchronizationProfiling() {
   CHECK_GE(base::subtle::Barrier_AtomicIncrement(&g_profiling_enabled, -1), 0);
 }
 
+void SubmitLockContention(LockType type, int64_t wait_micros) {
+  bool profiling_enabled = base::subtle::Acquire_Load(&g_profiling_enabled);
+  bool site_profiling_enabled = base::subtle::Acquire_Load(&g_site_profiling_enabled);
+  if (PREDICT_TRUE(!profiling_enabled && !site_profiling_enabled)) {
+    return;
+  }
+
+  // Collecting the stack may itself wait on a lock.
+  static __thread bool in_func = false;
+  if (in_func) return; // non-re-entrant
+  in_func = true;
+
+  StackTrace stack;
+  stack.Collect();
+
+  if (profiling_enabled) {
+    int64_t wait_cycles = wait_micros * base::CyclesPerSecond() / kMicrosPerSecond;
+    DCHECK_NOTNULL(g_contention_stacks)->AddStack(stack, wait_cycles);
+  }
+  if (site_profiling_enabled) {
+    DCHECK_NOTNULL(g_contention_sites)->AddWait(type, stack, wait_micros);
+  }
+
+  in_func = false;
+}
+
+void StartLockContentionSiteProfiling() {
+  InitSpinLockContentionProfiling();
+  base::subtle::Barrier_AtomicIncrement(&g_site_profiling_enabled, 1);
+}
+
+void FlushLockContentionSites(std::ostream* out, int64_t* dropped_sites) {
+  CHECK_NOTNULL(g_contention_sites)->Flush(out, dropped_sites);
+}
+
+void StopLockContentionSiteProfiling() {
+  InitSpinLockContentionProfiling();
+  CHECK_GE(base::subtle::Barrier_AtomicIncrement(&g_site_profiling_enabled, -1), 0);
+}
+
 } // namespace kudu
 
 // The hook expected by gutil is in the gutil namespace. Simply forward into the
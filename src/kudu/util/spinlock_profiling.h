@@ -18,6 +18,7 @@
 #define KUDU_UTIL_SPINLOCK_PROFILING_H
 
 #include <iosfwd>
+#include <stdint.h>
 
 #include "kudu/gutil/macros.h"
 #include "kudu/gutil/ref_counted.h"
@@ -72,5 +73,45 @@ void FlushSynchronizationProfile(std::stringstream* out, int64_t* drop_count);
 // Stop collecting contention profiles.
 void StopSynchronizationProfiling();
 
+// The kinds of waits which are profiled.
+enum class LockType {
+  SPINLOCK,
+  MUTEX,
+  RW_MUTEX,
+  // Also covers rw_semaphore and percpu_rwlock, which are built on it.
+  RW_SPINLOCK,
+  CONDITION_VARIABLE,
+};
+
+// Record that the calling thread waited 'wait_micros' to acquire a lock of
+// the given type, or on a condition variable.
+//
+// While synchronization profiling is enabled, the wait is added to its
+// contention profile, and while lock contention site profiling is, to the
+// histogram of waits of the calling stack. Otherwise this is very cheap.
+void SubmitLockContention(LockType type, int64_t wait_micros);
+
+// Enable process-wide profiling of the sites of lock contention, i.e. the
+// stacks at which threads wait on locks and condition variables.
+//
+// As with synchronization profiling, the caller should periodically call
+// FlushLockContentionSites() to empty the buffer of sites.
+void StartLockContentionSiteProfiling();
+
+// Flush the sites of lock contention recorded since the last call to 'out',
+// from the one with the most total wait time down. Each site is written as:
+//   <lock type> waits=<count> total_wait_us=<micros>
+//     wait_us [<low>,<high>)=<count> ...
+//     <symbolized stack trace>
+// where the histogram lists the number of waits in each power-of-two range
+// of microseconds that any fell into.
+//
+// *dropped_sites is incremented by the number of waits which could not be
+// attributed because the buffer was full or contended.
+void FlushLockContentionSites(std::ostream* out, int64_t* dropped_sites);
+
+// Stop profiling the sites of lock contention.
+void StopLockContentionSiteProfiling();
+
 } // namespace kudu
 #endif /* KUDU_UTIL_SPINLOCK_PROFILING_H */
@@ -19,6 +19,7 @@
 #include <glog/logging.h>
 #include <gtest/gtest.h>
 #include <memory>
+#include <vector>
 
 #include "kudu/gutil/atomicops.h"
 #include "kudu/gutil/bind.h"
@@ -249,6 +250,122 @@ TEST(TestThreadPool, TestPromises) {
   thread_pool->Shutdown();
 }
 
+static Status BuildWorkStealingTestPool(int num_threads, gscoped_ptr<ThreadPool>* pool) {
+  return ThreadPoolBuilder("test").set_max_threads(num_threads)
+                                  .set_work_stealing(true)
+                                  .Build(pool);
+}
+
+// Submits two more tasks from the pool's own thread until 'depth' reaches
+// zero, so that most tasks get queued by the workers and stolen.
+static void FanOutTask(ThreadPool* pool, int depth, Atomic32* counter) {
+  base::subtle::NoBarrier_AtomicIncrement(counter, 1);
+  if (depth == 0) {
+    return;
+  }
+  for (int i = 0; i < 2; i++) {
+    CHECK_OK(pool->SubmitFunc(boost::bind(&FanOutTask, pool, depth - 1, counter)));
+  }
+}
+
+TEST(TestThreadPool, TestWorkStealing) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildWorkStealingTestPool(4, &thread_pool));
+
+  Atomic32 counter(0);
+  ASSERT_OK(thread_pool->SubmitFunc(boost::bind(&SimpleTaskMethod, 10, &counter)));
+  ASSERT_OK(thread_pool->Submit(shared_ptr<Runnable>(new SimpleTask(15, &counter))));
+  thread_pool->Wait();
+  ASSERT_EQ(10 + 15, base::subtle::NoBarrier_Load(&counter));
+
+  // A tree of 2^13 - 1 tasks, nearly all of them submitted by pool threads.
+  counter = 0;
+  ASSERT_OK(thread_pool->SubmitFunc(
+      boost::bind(&FanOutTask, thread_pool.get(), 12, &counter)));
+  thread_pool->Wait();
+  ASSERT_EQ((1 << 13) - 1, base::subtle::NoBarrier_Load(&counter));
+  ASSERT_EQ(0, thread_pool->queue_length());
+
+  // Let the workers go to sleep, and check that they wake up for new tasks.
+  SleepFor(MonoDelta::FromMilliseconds(100));
+  counter = 0;
+  ASSERT_OK(thread_pool->SubmitFunc(
+      boost::bind(&FanOutTask, thread_pool.get(), 4, &counter)));
+  ASSERT_TRUE(thread_pool->WaitFor(MonoDelta::FromSeconds(10)));
+  ASSERT_EQ((1 << 5) - 1, base::subtle::NoBarrier_Load(&counter));
+  thread_pool->Shutdown();
+}
+
+TEST(TestThreadPool, TestWorkStealingShutdown) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildWorkStealingTestPool(2, &thread_pool));
+
+  // Shut down with tasks still queued: whichever haven't started are
+  // dropped, and submitting fails afterwards.
+  CountDownLatch latch(1);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(thread_pool->Submit(shared_ptr<Runnable>(new SlowTask(&latch))));
+  }
+  latch.CountDown();
+  thread_pool->Shutdown();
+  thread_pool->Wait();
+  ASSERT_EQ(0, thread_pool->queue_length());
+  Status s = thread_pool->SubmitFunc(boost::bind(&CountDownLatch::CountDown, &latch));
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+}
+
+// Appends 'i' to 'order', checking that no other task of the same token is
+// running meanwhile.
+static void RecordOrderTask(int i, Atomic32* running, std::vector<int>* order) {
+  CHECK_EQ(0, base::subtle::NoBarrier_AtomicIncrement(running, 1) - 1);
+  order->push_back(i);
+  boost::detail::yield(i % 20);
+  base::subtle::NoBarrier_AtomicIncrement(running, -1);
+}
+
+TEST(TestThreadPool, TestSerialTokens) {
+  gscoped_ptr<ThreadPool> thread_pool;
+  ASSERT_OK(BuildMinMaxTestPool(0, 4, &thread_pool));
+
+  const int kNumTokens = 8;
+  const int kNumTasks = 200;
+  std::vector<std::unique_ptr<ThreadPoolToken>> tokens;
+  std::vector<Atomic32> running(kNumTokens, 0);
+  std::vector<std::vector<int>> orders(kNumTokens);
+  for (int t = 0; t < kNumTokens; t++) {
+    tokens.emplace_back(thread_pool->NewSerialToken());
+  }
+  for (int i = 0; i < kNumTasks; i++) {
+    for (int t = 0; t < kNumTokens; t++) {
+      ASSERT_OK(tokens[t]->SubmitFunc(
+          boost::bind(&RecordOrderTask, i, &running[t], &orders[t])));
+    }
+  }
+  for (int t = 0; t < kNumTokens; t++) {
+    tokens[t]->Wait();
+    ASSERT_EQ(0, tokens[t]->queue_length());
+    ASSERT_EQ(kNumTasks, static_cast<int>(orders[t].size()));
+    for (int i = 0; i < kNumTasks; i++) {
+      ASSERT_EQ(i, orders[t][i]);
+    }
+  }
+
+  // Once shut down, a token drops its queued tasks and rejects new ones,
+  // while the pool and the other tokens carry on.
+  CountDownLatch latch(1);
+  ASSERT_OK(tokens[0]->Submit(shared_ptr<Runnable>(new SlowTask(&latch))));
+  ASSERT_OK(tokens[0]->SubmitFunc(boost::bind(&RecordOrderTask, -1, &running[0], &orders[0])));
+  latch.CountDown();
+  tokens[0]->Shutdown();
+  Status s = tokens[0]->SubmitFunc(boost::bind(&RecordOrderTask, -1, &running[0], &orders[0]));
+  ASSERT_TRUE(s.IsServiceUnavailable()) << s.ToString();
+  ASSERT_OK(tokens[1]->SubmitFunc(boost::bind(&RecordOrderTask, -1, &running[1], &orders[1])));
+  tokens[1]->Wait();
+  ASSERT_EQ(-1, orders[1].back());
+
+  tokens.clear();
+  thread_pool->Shutdown();
+}
 
 METRIC_DEFINE_entity(test_entity);
 METRIC_DEFINE_histogram(test_entity, queue_length, "queue length",
@@ -18,12 +18,14 @@
 #include "kudu/util/threadpool.h"
 
 #include <boost/function.hpp>
+#include <boost/smart_ptr/detail/yield_k.hpp>
 #include <gflags/gflags.h>
 #include <glog/logging.h>
 #include <limits>
 #include <string>
 
 #include "kudu/gutil/callback.h"
+#include "kudu/gutil/port.h"
 #include "kudu/gutil/stl_util.h"
 #include "kudu/gutil/strings/substitute.h"
 #include "kudu/gutil/sysinfo.h"
@@ -34,6 +36,7 @@
 
 namespace kudu {
 
+using std::shared_ptr;
 using strings::Substitute;
 
 ////////////////////////////////////////////////////////
@@ -52,6 +55,110 @@ class FunctionRunnable : public Runnable {
   boost::function<void()> func_;
 };
 
+////////////////////////////////////////////////////////
+// WorkStealingDeque
+////////////////////////////////////////////////////////
+
+namespace {
+
+// A bounded Chase-Lev deque: its owner pushes and pops at the bottom, and any
+// other thread may steal from the top, all without locking. Follows "Correct
+// and Efficient Work-Stealing for Weak Memory Models" (Le et al., PPoPP '13),
+// except that the buffer is never grown.
+template<class T>
+class WorkStealingDeque {
+ public:
+  WorkStealingDeque() : top_(0), bottom_(0) {
+    for (auto& e : buffer_) {
+      e.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  // Adds 'e' at the bottom. Returns false if the deque is full. May only be
+  // called by the owner.
+  bool Push(T* e) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= kCapacity) {
+      return false;
+    }
+    buffer_[b & kMask].store(e, std::memory_order_relaxed);
+    bottom_.store(b + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Removes the element at the bottom, i.e. the most recently pushed one.
+  // Returns null if the deque is empty. May only be called by the owner.
+  T* Pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    T* e = nullptr;
+    if (t <= b) {
+      e = buffer_[b & kMask].load(std::memory_order_relaxed);
+      if (t == b) {
+        // It's the last element: race the thieves for it.
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+          e = nullptr;
+        }
+        bottom_.store(b + 1, std::memory_order_relaxed);
+      }
+    } else {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return e;
+  }
+
+  // Removes the element at the top, i.e. the least recently pushed one.
+  // Returns null if the deque is empty or another thread took the element
+  // first. May be called by any thread.
+  T* Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) {
+      return nullptr;
+    }
+    T* e = buffer_[t & kMask].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return e;
+  }
+
+ private:
+  enum {
+    kCapacity = 1024,
+    kMask = kCapacity - 1
+  };
+
+  std::atomic<int64_t> top_;
+  // Keep the thieves' and the owner's ends on different cache lines.
+  char padding_[CACHELINE_SIZE];
+  std::atomic<int64_t> bottom_;
+  std::atomic<T*> buffer_[kCapacity];
+
+  DISALLOW_COPY_AND_ASSIGN(WorkStealingDeque);
+};
+
+// How many times an idle worker of a work-stealing pool looks for a task
+// before it goes to sleep. See boost::detail::yield() for how long it backs
+// off in between.
+const int kWorkStealingSpins = 64;
+
+// The worker of a work-stealing pool the current thread is, if any.
+__thread ThreadPool* tls_work_stealing_pool = nullptr;
+__thread int tls_worker_index = -1;
+
+} // anonymous namespace
+
+struct ThreadPool::Worker {
+  WorkStealingDeque<QueueEntry> deque;
+};
+
 ////////////////////////////////////////////////////////
 // ThreadPoolBuilder
 ////////////////////////////////////////////////////////
@@ -61,7 +168,8 @@ ThreadPoolBuilder::ThreadPoolBuilder(std::string name)
       min_threads_(0),
       max_threads_(base::NumCPUs()),
       max_queue_size_(std::numeric_limits<int>::max()),
-      idle_timeout_(MonoDelta::FromMilliseconds(500)) {}
+      idle_timeout_(MonoDelta::FromMilliseconds(500)),
+      work_stealing_(false) {}
 
 ThreadPoolBuilder& ThreadPoolBuilder::set_trace_metric_prefix(
     const std::string& prefix) {
@@ -92,6 +200,11 @@ ThreadPoolBuilder& ThreadPoolBuilder::set_idle_timeout(const MonoDelta& idle_tim
   return *this;
 }
 
+ThreadPoolBuilder& ThreadPoolBuilder::set_work_stealing(bool work_stealing) {
+  work_stealing_ = work_stealing;
+  return *this;
+}
+
 Status ThreadPoolBuilder::Build(gscoped_ptr<ThreadPool>* pool) const {
   pool->reset(new ThreadPool(*this));
   RETURN_NOT_OK((*pool)->Init());
@@ -108,13 +221,18 @@ ThreadPool::ThreadPool(const ThreadPoolBuilder& builder)
     max_threads_(builder.max_threads_),
     max_queue_size_(builder.max_queue_size_),
     idle_timeout_(builder.idle_timeout_),
+    work_stealing_(builder.work_stealing_),
     pool_status_(Status::Uninitialized("The pool was not initialized.")),
     idle_cond_(&lock_),
     no_threads_cond_(&lock_),
     not_empty_(&lock_),
     num_threads_(0),
     active_threads_(0),
-    queue_size_(0) {
+    queue_size_(0),
+    num_queued_(0),
+    num_pending_(0),
+    num_parked_(0),
+    shutting_down_(false) {
 
   string prefix = !builder.trace_metric_prefix_.empty() ?
       builder.trace_metric_prefix_ : builder.name_;
@@ -137,6 +255,26 @@ Status ThreadPool::Init() {
     return Status::NotSupported("The thread pool is already initialized");
   }
   pool_status_ = Status::OK();
+  if (work_stealing_) {
+    // Every worker's deque must exist before any worker may steal from it.
+    for (int i = 0; i < max_threads_; i++) {
+      workers_.emplace_back(new Worker);
+    }
+    for (int i = 0; i < max_threads_; i++) {
+      scoped_refptr<Thread> t;
+      Status status = kudu::Thread::Create(
+          "thread pool", strings::Substitute("$0 [worker]", name_),
+          &ThreadPool::WorkStealingDispatchThread, this, i, &t);
+      if (!status.ok()) {
+        unique_lock.Unlock();
+        Shutdown();
+        return status;
+      }
+      InsertOrDie(&threads_, t.get());
+      num_threads_++;
+    }
+    return Status::OK();
+  }
   for (int i = 0; i < min_threads_; i++) {
     Status status = CreateThreadUnlocked();
     if (!status.ok()) {
@@ -153,8 +291,27 @@ void ThreadPool::ClearQueue() {
       e.trace->Release();
     }
   }
+  int num_cleared = queue_size_;
   queue_.clear();
   queue_size_ = 0;
+
+  // The workers may still be running, so only steal from their deques.
+  for (const auto& w : workers_) {
+    QueueEntry* e;
+    while ((e = w->deque.Steal()) != nullptr) {
+      if (e->trace) {
+        e->trace->Release();
+      }
+      delete e;
+      num_cleared++;
+    }
+  }
+  if (work_stealing_ && num_cleared > 0) {
+    num_queued_ -= num_cleared;
+    if ((num_pending_ -= num_cleared) == 0) {
+      idle_cond_.Broadcast();
+    }
+  }
 }
 
 void ThreadPool::Shutdown() {
@@ -162,6 +319,7 @@ void ThreadPool::Shutdown() {
   CheckNotPoolThreadUnlocked();
 
   pool_status_ = Status::ServiceUnavailable("The pool has been shut down.");
+  shutting_down_ = true;
   ClearQueue();
   not_empty_.Broadcast();
 
@@ -170,6 +328,9 @@ void ThreadPool::Shutdown() {
   while (num_threads_ > 0) {
     no_threads_cond_.Wait();
   }
+
+  // The tasks which were running may have queued more.
+  ClearQueue();
 }
 
 Status ThreadPool::SubmitClosure(const Closure& task) {
@@ -184,6 +345,9 @@ Status ThreadPool::SubmitFunc(const boost::function<void()>& func) {
 
 Status ThreadPool::Submit(const std::shared_ptr<Runnable>& task) {
   MonoTime submit_time = MonoTime::Now(MonoTime::FINE);
+  if (work_stealing_) {
+    return SubmitWorkStealing(task, submit_time);
+  }
 
   MutexLock guard(lock_);
   if (PREDICT_FALSE(!pool_status_.ok())) {
@@ -245,9 +409,78 @@ Status ThreadPool::Submit(const std::shared_ptr<Runnable>& task) {
   return Status::OK();
 }
 
+Status ThreadPool::SubmitWorkStealing(const shared_ptr<Runnable>& task,
+                                      const MonoTime& submit_time) {
+  if (PREDICT_FALSE(shutting_down_.load(std::memory_order_acquire))) {
+    MutexLock guard(lock_);
+    return pool_status_;
+  }
+
+  int length_at_submit = num_queued_.fetch_add(1);
+  if (length_at_submit >= max_queue_size_) {
+    num_queued_--;
+    return Status::ServiceUnavailable(Substitute("Thread pool queue is full ($0 items)",
+                                                 length_at_submit));
+  }
+  // Counted before the task may be taken, so that it can't be counted as
+  // finished first.
+  num_pending_++;
+
+  gscoped_ptr<QueueEntry> e(new QueueEntry);
+  e->runnable = task;
+  e->trace = Trace::CurrentTrace();
+  // Need to AddRef, since the thread which submitted the task may go away,
+  // and we don't want the trace to be destructed while waiting in the queue.
+  if (e->trace) {
+    e->trace->AddRef();
+  }
+  e->submit_time = submit_time;
+
+  if (tls_work_stealing_pool == this &&
+      workers_[tls_worker_index]->deque.Push(e.get())) {
+    ignore_result(e.release());
+    // Pairs with the barrier between a worker announcing it's about to park
+    // and its last look for tasks: either it sees this one, or this sees it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (num_parked_.load(std::memory_order_relaxed) > 0) {
+      MutexLock guard(lock_);
+      not_empty_.Signal();
+    }
+  } else {
+    MutexLock guard(lock_);
+    if (PREDICT_FALSE(!pool_status_.ok())) {
+      if (e->trace) {
+        e->trace->Release();
+      }
+      num_queued_--;
+      guard.Unlock();
+      TaskFinished();
+      return pool_status_;
+    }
+    queue_.push_back(*e);
+    queue_size_++;
+    // The workers only wait on 'not_empty_' with 'lock_' held after looking
+    // for tasks, so none can miss this one.
+    if (num_parked_.load() > 0) {
+      not_empty_.Signal();
+    }
+  }
+
+  if (queue_length_histogram_) {
+    queue_length_histogram_->Increment(length_at_submit);
+  }
+  return Status::OK();
+}
+
 void ThreadPool::Wait() {
   MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
+  if (work_stealing_) {
+    while (num_pending_.load() > 0) {
+      idle_cond_.Wait();
+    }
+    return;
+  }
   while ((!queue_.empty()) || (active_threads_ > 0)) {
     idle_cond_.Wait();
   }
@@ -261,6 +494,14 @@ bool ThreadPool::WaitUntil(const MonoTime& until) {
 bool ThreadPool::WaitFor(const MonoDelta& delta) {
   MutexLock unique_lock(lock_);
   CheckNotPoolThreadUnlocked();
+  if (work_stealing_) {
+    while (num_pending_.load() > 0) {
+      if (!idle_cond_.TimedWait(delta)) {
+        return false;
+      }
+    }
+    return true;
+  }
   while ((!queue_.empty()) || (active_threads_ > 0)) {
     if (!idle_cond_.TimedWait(delta)) {
       return false;
@@ -282,6 +523,10 @@ void ThreadPool::SetRunTimeMicrosHistogram(const scoped_refptr<Histogram>& hist)
   run_time_us_histogram_ = hist;
 }
 
+std::unique_ptr<ThreadPoolToken> ThreadPool::NewSerialToken() {
+  return std::unique_ptr<ThreadPoolToken>(new ThreadPoolToken(this));
+}
+
 
 void ThreadPool::DispatchThread(bool permanent) {
   MutexLock unique_lock(lock_);
@@ -320,37 +565,7 @@ void ThreadPool::DispatchThread(bool permanent) {
     ++active_threads_;
 
     unique_lock.Unlock();
-
-    // Release the reference which was held by the queued item.
-    ADOPT_TRACE(entry.trace);
-    if (entry.trace) {
-      entry.trace->Release();
-    }
-
-    // Update metrics
-    MonoTime now(MonoTime::Now(MonoTime::FINE));
-    int64_t queue_time_us = now.GetDeltaSince(entry.submit_time).ToMicroseconds();
-    TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
-    if (queue_time_us_histogram_) {
-      queue_time_us_histogram_->Increment(queue_time_us);
-    }
-
-    // Execute the task
-    {
-      MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
-      MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
-
-      entry.runnable->Run();
-
-      int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
-      int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
-
-      if (run_time_us_histogram_) {
-        run_time_us_histogram_->Increment(wall_us);
-      }
-      TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
-      TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
-    }
+    RunTask(entry, queue_time_us_histogram_, run_time_us_histogram_);
     unique_lock.Lock();
 
     if (--active_threads_ == 0) {
@@ -374,6 +589,122 @@ void ThreadPool::DispatchThread(bool permanent) {
   }
 }
 
+void ThreadPool::RunTask(const QueueEntry& entry,
+                         const scoped_refptr<Histogram>& queue_time_us_histogram,
+                         const scoped_refptr<Histogram>& run_time_us_histogram) {
+  // Release the reference which was held by the queued item.
+  ADOPT_TRACE(entry.trace);
+  if (entry.trace) {
+    entry.trace->Release();
+  }
+
+  // Update metrics
+  MonoTime now(MonoTime::Now(MonoTime::FINE));
+  int64_t queue_time_us = now.GetDeltaSince(entry.submit_time).ToMicroseconds();
+  TRACE_COUNTER_INCREMENT(queue_time_trace_metric_name_, queue_time_us);
+  if (queue_time_us_histogram) {
+    queue_time_us_histogram->Increment(queue_time_us);
+  }
+
+  // Execute the task
+  MicrosecondsInt64 start_wall_us = GetMonoTimeMicros();
+  MicrosecondsInt64 start_cpu_us = GetThreadCpuTimeMicros();
+
+  entry.runnable->Run();
+
+  int64_t wall_us = GetMonoTimeMicros() - start_wall_us;
+  int64_t cpu_us = GetThreadCpuTimeMicros() - start_cpu_us;
+
+  if (run_time_us_histogram) {
+    run_time_us_histogram->Increment(wall_us);
+  }
+  TRACE_COUNTER_INCREMENT(run_wall_time_trace_metric_name_, wall_us);
+  TRACE_COUNTER_INCREMENT(run_cpu_time_trace_metric_name_, cpu_us);
+}
+
+void ThreadPool::WorkStealingDispatchThread(int worker_index) {
+  tls_work_stealing_pool = this;
+  tls_worker_index = worker_index;
+
+  QueueEntry* entry;
+  while ((entry = TakeTask(worker_index)) != nullptr) {
+    num_queued_--;
+    RunTask(*entry, queue_time_us_histogram_, run_time_us_histogram_);
+    delete entry;
+    TaskFinished();
+  }
+  VLOG(2) << "WorkStealingDispatchThread exiting";
+
+  tls_work_stealing_pool = nullptr;
+  tls_worker_index = -1;
+
+  MutexLock unique_lock(lock_);
+  CHECK_EQ(threads_.erase(Thread::current_thread()), 1);
+  if (--num_threads_ == 0) {
+    no_threads_cond_.Broadcast();
+  }
+}
+
+ThreadPool::QueueEntry* ThreadPool::StealTask(int worker_index) {
+  QueueEntry* e = workers_[worker_index]->deque.Pop();
+  if (e) {
+    return e;
+  }
+  int num_workers = workers_.size();
+  for (int i = 1; i < num_workers; i++) {
+    e = workers_[(worker_index + i) % num_workers]->deque.Steal();
+    if (e) {
+      return e;
+    }
+  }
+  return nullptr;
+}
+
+ThreadPool::QueueEntry* ThreadPool::TakeTask(int worker_index) {
+  for (int spins = 0; ; spins++) {
+    if (PREDICT_FALSE(shutting_down_.load(std::memory_order_acquire))) {
+      return nullptr;
+    }
+    QueueEntry* e = StealTask(worker_index);
+    if (e) {
+      return e;
+    }
+    if (ANNOTATE_UNPROTECTED_READ(queue_size_) > 0 || spins >= kWorkStealingSpins) {
+      break;
+    }
+    boost::detail::yield(spins);
+  }
+
+  // Check the shared queue, going to sleep if it's empty too.
+  MutexLock unique_lock(lock_);
+  num_parked_++;
+  QueueEntry* e = nullptr;
+  while (!shutting_down_) {
+    if (!queue_.empty()) {
+      e = new QueueEntry(std::move(queue_.front()));
+      queue_.pop_front();
+      queue_size_--;
+      break;
+    }
+    // Submitters only signal once they see this worker parked, so look at
+    // the deques again now that it is.
+    e = StealTask(worker_index);
+    if (e) {
+      break;
+    }
+    not_empty_.Wait();
+  }
+  num_parked_--;
+  return e;
+}
+
+void ThreadPool::TaskFinished() {
+  if (--num_pending_ == 0) {
+    MutexLock unique_lock(lock_);
+    idle_cond_.Broadcast();
+  }
+}
+
 Status ThreadPool::CreateThreadUnlocked() {
   // The first few threads are permanent, and do not time out.
   bool permanent = (num_threads_ < min_threads_);
@@ -396,4 +727,143 @@ void ThreadPool::CheckNotPoolThreadUnlocked() {
   }
 }
 
+////////////////////////////////////////////////////////
+// ThreadPoolToken
+////////////////////////////////////////////////////////
+
+ThreadPoolToken::ThreadPoolToken(ThreadPool* pool)
+    : pool_(pool),
+      idle_cond_(&lock_),
+      running_(false),
+      shut_down_(false) {
+}
+
+ThreadPoolToken::~ThreadPoolToken() {
+  Shutdown();
+}
+
+void ThreadPoolToken::Shutdown() {
+  MutexLock unique_lock(lock_);
+  shut_down_ = true;
+  for (ThreadPool::QueueEntry& e : queue_) {
+    if (e.trace) {
+      e.trace->Release();
+    }
+  }
+  queue_.clear();
+  while (running_) {
+    idle_cond_.Wait();
+  }
+}
+
+Status ThreadPoolToken::SubmitClosure(const Closure& task) {
+  return SubmitFunc(boost::bind(&Closure::Run, task));
+}
+
+Status ThreadPoolToken::SubmitFunc(const boost::function<void()>& func) {
+  return Submit(std::shared_ptr<Runnable>(new FunctionRunnable(func)));
+}
+
+Status ThreadPoolToken::Submit(const shared_ptr<Runnable>& task) {
+  ThreadPool::QueueEntry e;
+  e.runnable = task;
+  e.submit_time = MonoTime::Now(MonoTime::FINE);
+
+  MutexLock guard(lock_);
+  if (PREDICT_FALSE(shut_down_)) {
+    return Status::ServiceUnavailable("The thread pool token has been shut down.");
+  }
+  e.trace = Trace::CurrentTrace();
+  // As in ThreadPool::Submit(), the trace must outlive the submitting thread.
+  if (e.trace) {
+    e.trace->AddRef();
+  }
+  queue_.push_back(e);
+  int length_at_submit = queue_.size() - 1;
+
+  if (!running_) {
+    running_ = true;
+    Status s = Schedule();
+    if (PREDICT_FALSE(!s.ok())) {
+      ClearQueueUnlocked();
+      return s;
+    }
+  }
+  guard.Unlock();
+
+  if (queue_length_histogram_) {
+    queue_length_histogram_->Increment(length_at_submit);
+  }
+  return Status::OK();
+}
+
+void ThreadPoolToken::Wait() {
+  MutexLock unique_lock(lock_);
+  while (running_) {
+    idle_cond_.Wait();
+  }
+}
+
+int ThreadPoolToken::queue_length() const {
+  MutexLock unique_lock(lock_);
+  return queue_.size();
+}
+
+void ThreadPoolToken::SetQueueLengthHistogram(const scoped_refptr<Histogram>& hist) {
+  queue_length_histogram_ = hist;
+}
+
+void ThreadPoolToken::SetQueueTimeMicrosHistogram(const scoped_refptr<Histogram>& hist) {
+  queue_time_us_histogram_ = hist;
+}
+
+void ThreadPoolToken::SetRunTimeMicrosHistogram(const scoped_refptr<Histogram>& hist) {
+  run_time_us_histogram_ = hist;
+}
+
+Status ThreadPoolToken::Schedule() {
+  // The traces are those of the token's tasks, not of whoever happens to
+  // schedule them.
+  ADOPT_TRACE(nullptr);
+  return pool_->SubmitFunc(boost::bind(&ThreadPoolToken::RunNext, this));
+}
+
+void ThreadPoolToken::RunNext() {
+  MutexLock unique_lock(lock_);
+  if (queue_.empty()) {
+    // The token was shut down meanwhile.
+    ClearQueueUnlocked();
+    return;
+  }
+  ThreadPool::QueueEntry entry = queue_.front();
+  queue_.pop_front();
+  unique_lock.Unlock();
+
+  pool_->RunTask(entry, queue_time_us_histogram_, run_time_us_histogram_);
+
+  unique_lock.Lock();
+  if (queue_.empty()) {
+    ClearQueueUnlocked();
+    return;
+  }
+  // Go to the back of the pool's queue rather than running the next task
+  // right away, so that the other tokens get their turn.
+  Status s = Schedule();
+  if (PREDICT_FALSE(!s.ok())) {
+    // The pool is shutting down.
+    ClearQueueUnlocked();
+  }
+}
+
+void ThreadPoolToken::ClearQueueUnlocked() {
+  for (ThreadPool::QueueEntry& e : queue_) {
+    if (e.trace) {
+      e.trace->Release();
+    }
+  }
+  queue_.clear();
+  running_ = false;
+  idle_cond_.Broadcast();
+}
+
 } // namespace kudu
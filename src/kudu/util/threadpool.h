@@ -17,7 +17,9 @@
 #ifndef KUDU_UTIL_THREAD_POOL_H
 #define KUDU_UTIL_THREAD_POOL_H
 
+#include <atomic>
 #include <boost/function.hpp>
+#include <deque>
 #include <gtest/gtest_prod.h>
 #include <list>
 #include <memory>
@@ -40,6 +42,7 @@ namespace kudu {
 class Histogram;
 class Thread;
 class ThreadPool;
+class ThreadPoolToken;
 class Trace;
 
 class Runnable {
@@ -90,6 +93,19 @@ class Runnable {
 //    We always keep at least min_threads.
 //    Default: 500 milliseconds.
 //
+// work_stealing: Whether each worker thread keeps its own queue of tasks,
+//    taking tasks from the other workers' queues when its own is empty,
+//    rather than all of them sharing a single queue. Tasks submitted by a
+//    worker go to its own queue without taking any lock, and idle workers
+//    spin briefly before going to sleep. Tasks submitted from other
+//    threads still go through a shared queue.
+//
+//    Such a pool starts max_threads threads up front and keeps them, so
+//    min_threads and timeout don't apply. Tasks are not run in the order
+//    they were submitted, so single-threaded pools which rely on that order
+//    must not use this.
+//    Default: false.
+//
 class ThreadPoolBuilder {
  public:
   explicit ThreadPoolBuilder(std::string name);
@@ -101,12 +117,14 @@ class ThreadPoolBuilder {
   ThreadPoolBuilder& set_max_threads(int max_threads);
   ThreadPoolBuilder& set_max_queue_size(int max_queue_size);
   ThreadPoolBuilder& set_idle_timeout(const MonoDelta& idle_timeout);
+  ThreadPoolBuilder& set_work_stealing(bool work_stealing);
 
   const std::string& name() const { return name_; }
   int min_threads() const { return min_threads_; }
   int max_threads() const { return max_threads_; }
   int max_queue_size() const { return max_queue_size_; }
   const MonoDelta& idle_timeout() const { return idle_timeout_; }
+  bool work_stealing() const { return work_stealing_; }
 
   // Instantiate a new ThreadPool with the existing builder arguments.
   Status Build(gscoped_ptr<ThreadPool>* pool) const;
@@ -119,6 +137,7 @@ class ThreadPoolBuilder {
   int max_threads_;
   int max_queue_size_;
   MonoDelta idle_timeout_;
+  bool work_stealing_;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadPoolBuilder);
 };
@@ -178,6 +197,9 @@ class ThreadPool {
   // Return the current number of tasks waiting in the queue.
   // Typically used for metrics.
   int queue_length() const {
+    if (work_stealing_) {
+      return num_queued_.load(std::memory_order_relaxed);
+    }
     return ANNOTATE_UNPROTECTED_READ(queue_size_);
   }
 
@@ -192,8 +214,13 @@ class ThreadPool {
   // Attach a histogram which measures the amount of time that tasks spend running.
   void SetRunTimeMicrosHistogram(const scoped_refptr<Histogram>& hist);
 
+  // Return a new token for submitting tasks to this pool which are to run
+  // one at a time, in the order they were submitted. See ThreadPoolToken.
+  std::unique_ptr<ThreadPoolToken> NewSerialToken();
+
  private:
   friend class ThreadPoolBuilder;
+  friend class ThreadPoolToken;
 
   // Create a new thread pool using a builder.
   explicit ThreadPool(const ThreadPoolBuilder& builder);
@@ -210,6 +237,32 @@ class ThreadPool {
   // Create new thread. Required that lock_ is held.
   Status CreateThreadUnlocked();
 
+  struct QueueEntry;
+  struct Worker;
+
+  // Runs the task of 'entry' and records its metrics, including in the
+  // given histograms if they're set.
+  void RunTask(const QueueEntry& entry,
+               const scoped_refptr<Histogram>& queue_time_us_histogram,
+               const scoped_refptr<Histogram>& run_time_us_histogram);
+
+  // The work-stealing counterparts of Submit() and DispatchThread().
+  Status SubmitWorkStealing(const std::shared_ptr<Runnable>& task,
+                            const MonoTime& submit_time);
+  void WorkStealingDispatchThread(int worker_index);
+
+  // Takes the next task for the worker at 'worker_index' from its own
+  // queue, or failing that from the other workers' queues, without locking.
+  QueueEntry* StealTask(int worker_index);
+
+  // Takes the next task for the worker at 'worker_index', waiting for one
+  // if there are none. Returns null once the pool is shut down.
+  QueueEntry* TakeTask(int worker_index);
+
+  // Accounts for a task which was run or discarded, waking up the threads
+  // in Wait() if it was the last one.
+  void TaskFinished();
+
   // Aborts if the current thread is a member of this thread pool.
   void CheckNotPoolThreadUnlocked();
 
@@ -230,6 +283,7 @@ class ThreadPool {
   const int max_threads_;
   const int max_queue_size_;
   const MonoDelta idle_timeout_;
+  const bool work_stealing_;
 
   Status pool_status_;
   Mutex lock_;
@@ -247,6 +301,22 @@ class ThreadPool {
   // Protected by lock_.
   std::unordered_set<Thread*> threads_;
 
+  // The state of each worker of a work-stealing pool, in which case
+  // 'queue_' only holds the tasks submitted from outside the pool. Set up
+  // in Init() and kept until the pool is destroyed.
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // The number of tasks in any queue, and of those plus the running ones,
+  // in a work-stealing pool.
+  std::atomic<int> num_queued_;
+  std::atomic<int> num_pending_;
+
+  // The number of workers of a work-stealing pool waiting on 'not_empty_'.
+  std::atomic<int> num_parked_;
+
+  // Set once a work-stealing pool starts to shut down.
+  std::atomic<bool> shutting_down_;
+
   scoped_refptr<Histogram> queue_length_histogram_;
   scoped_refptr<Histogram> queue_time_us_histogram_;
   scoped_refptr<Histogram> run_time_us_histogram_;
@@ -258,5 +328,85 @@ class ThreadPool {
   DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
 
+// A handle for submitting tasks to a ThreadPool which run serially: each
+// starts only once the previous one submitted through the token finished,
+// in submission order. Tasks of different tokens run concurrently, so many
+// tokens, e.g. one per tablet, can share a few threads while each keeps its
+// own ordering.
+//
+// A token hands its tasks to the pool one at a time, so a long queue behind
+// one token doesn't keep the others from running.
+//
+// Every token must be shut down or destroyed before its pool is shut down.
+// This class is thread-safe.
+//
+// Usage Example:
+//    std::unique_ptr<ThreadPoolToken> token = thread_pool->NewSerialToken();
+//    CHECK_OK(token->SubmitFunc(boost::bind(&Func, 1)));
+//    CHECK_OK(token->SubmitFunc(boost::bind(&Func, 2)));  // Runs after the first.
+//    token->Wait();
+class ThreadPoolToken {
+ public:
+  ~ThreadPoolToken();
+
+  // Drop the tasks which haven't started yet and wait for the running one,
+  // if any, to complete. Tasks submitted afterwards are rejected.
+  void Shutdown();
+
+  // Submit a task, as with the ThreadPool methods of the same names.
+  Status SubmitClosure(const Closure& task) WARN_UNUSED_RESULT;
+  Status SubmitFunc(const boost::function<void()>& func) WARN_UNUSED_RESULT;
+  Status Submit(const std::shared_ptr<Runnable>& task) WARN_UNUSED_RESULT;
+
+  // Wait until all the tasks submitted through this token are completed.
+  void Wait();
+
+  // Return the current number of tasks of this token waiting to run.
+  int queue_length() const;
+
+  // Attach histograms which measure the tasks of this token, as with the
+  // ThreadPool methods of the same names. The pool's own histograms measure
+  // each of the tasks too, except for the time spent queued behind its
+  // predecessors in the token.
+  void SetQueueLengthHistogram(const scoped_refptr<Histogram>& hist);
+  void SetQueueTimeMicrosHistogram(const scoped_refptr<Histogram>& hist);
+  void SetRunTimeMicrosHistogram(const scoped_refptr<Histogram>& hist);
+
+ private:
+  friend class ThreadPool;
+
+  explicit ThreadPoolToken(ThreadPool* pool);
+
+  // Submits RunNext() to the pool.
+  Status Schedule();
+
+  // Runs the task at the front of the queue, then schedules the next one.
+  void RunNext();
+
+  // Drops the queued tasks and marks the token as not running, waking up
+  // the threads in Wait(). Requires that lock_ is held.
+  void ClearQueueUnlocked();
+
+  ThreadPool* const pool_;
+
+  mutable Mutex lock_;
+  ConditionVariable idle_cond_;
+
+  // The tasks which haven't started yet.
+  std::deque<ThreadPool::QueueEntry> queue_;
+
+  // Whether a call to RunNext() is queued on or running in the pool. Only
+  // one ever is.
+  bool running_;
+
+  bool shut_down_;
+
+  scoped_refptr<Histogram> queue_length_histogram_;
+  scoped_refptr<Histogram> queue_time_us_histogram_;
+  scoped_refptr<Histogram> run_time_us_histogram_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPoolToken);
+};
+
 } // namespace kudu
 #endif
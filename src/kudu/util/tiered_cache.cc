@@ -0,0 +1,183 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "kudu/util/tiered_cache.h"
+
+#include <atomic>
+#include <glog/logging.h>
+#include <string.h>
+#include <vector>
+
+#include "kudu/gutil/gscoped_ptr.h"
+#include "kudu/gutil/macros.h"
+#include "kudu/util/cache.h"
+#include "kudu/util/cache_metrics.h"
+#include "kudu/util/metrics.h"
+
+namespace kudu {
+
+namespace {
+
+class TieredCache : public Cache {
+ public:
+  TieredCache(Cache* upper, Cache* lower)
+      : upper_(DCHECK_NOTNULL(upper)),
+        lower_(DCHECK_NOTNULL(lower)),
+        demoter_(this),
+        lower_evicted_(this),
+        shutting_down_(false) {
+  }
+
+  virtual ~TieredCache() {
+    // Don't demote the entries of 'upper_' while it is destroyed.
+    shutting_down_ = true;
+    upper_.reset();
+    lower_.reset();
+  }
+
+  virtual Handle* Lookup(const Slice& key, CacheBehavior caching) OVERRIDE {
+    Handle* h = upper_->Lookup(key, caching);
+    if (h != nullptr) {
+      return h;
+    }
+    Handle* lower_h = lower_->Lookup(key, caching);
+    if (lower_h == nullptr) {
+      return nullptr;
+    }
+
+    // Promote the entry. Only handles to 'upper_' are returned to callers.
+    Slice value = lower_->Value(lower_h);
+    PendingHandle* ph = upper_->Allocate(key, value.size(), value.size());
+    if (ph == nullptr) {
+      lower_->Release(lower_h);
+      return nullptr;
+    }
+    memcpy(upper_->MutableValue(ph), value.data(), value.size());
+    lower_->Release(lower_h);
+    lower_->Erase(key);
+    if (metrics_) {
+      metrics_->lower_tier_promotions->Increment();
+    }
+    return upper_->Insert(ph, &demoter_);
+  }
+
+  virtual void Release(Handle* handle) OVERRIDE {
+    upper_->Release(handle);
+  }
+
+  virtual void Erase(const Slice& key) OVERRIDE {
+    upper_->Erase(key);
+    lower_->Erase(key);
+  }
+
+  virtual Slice Value(Handle* handle) OVERRIDE {
+    return upper_->Value(handle);
+  }
+
+  virtual uint64_t NewId() OVERRIDE {
+    return upper_->NewId();
+  }
+
+  virtual void SetMetrics(const scoped_refptr<MetricEntity>& metric_entity) OVERRIDE {
+    upper_->SetMetrics(metric_entity);
+    metrics_.reset(new TieredCacheMetrics(metric_entity));
+  }
+
+  virtual void ListEntries(size_t max_entries, std::vector<EntryInfo>* entries) OVERRIDE {
+    size_t initial_size = entries->size();
+    upper_->ListEntries(max_entries, entries);
+    size_t listed = entries->size() - initial_size;
+    if (listed < max_entries) {
+      lower_->ListEntries(max_entries - listed, entries);
+    }
+  }
+
+  virtual PendingHandle* Allocate(Slice key, int val_len, int charge) OVERRIDE {
+    return upper_->Allocate(key, val_len, charge);
+  }
+
+  virtual uint8_t* MutableValue(PendingHandle* handle) OVERRIDE {
+    return upper_->MutableValue(handle);
+  }
+
+  virtual Handle* Insert(PendingHandle* pending, EvictionCallback* eviction_callback) OVERRIDE {
+    return upper_->Insert(pending, eviction_callback != nullptr ? eviction_callback : &demoter_);
+  }
+
+  virtual void Free(PendingHandle* ptr) OVERRIDE {
+    upper_->Free(ptr);
+  }
+
+ private:
+  // Demotes the entries evicted from 'upper_' into 'lower_'.
+  class Demoter : public EvictionCallback {
+   public:
+    explicit Demoter(TieredCache* cache) : cache_(cache) {}
+    void EvictedEntry(Slice key, Slice value) OVERRIDE {
+      cache_->Demote(key, value);
+    }
+   private:
+    TieredCache* cache_;
+  };
+
+  // Tracks the usage of 'lower_'.
+  class LowerTierEvicted : public EvictionCallback {
+   public:
+    explicit LowerTierEvicted(TieredCache* cache) : cache_(cache) {}
+    void EvictedEntry(Slice key, Slice value) OVERRIDE {
+      if (cache_->metrics_) {
+        cache_->metrics_->lower_tier_usage->DecrementBy(value.size());
+      }
+    }
+   private:
+    TieredCache* cache_;
+  };
+
+  void Demote(Slice key, Slice value) {
+    if (shutting_down_) {
+      return;
+    }
+    // If 'lower_' has no room, the entry is simply dropped.
+    PendingHandle* ph = lower_->Allocate(key, value.size(), value.size());
+    if (ph == nullptr) {
+      return;
+    }
+    memcpy(lower_->MutableValue(ph), value.data(), value.size());
+    lower_->Release(lower_->Insert(ph, &lower_evicted_));
+    if (metrics_) {
+      metrics_->lower_tier_demotions->Increment();
+      metrics_->lower_tier_usage->IncrementBy(value.size());
+    }
+  }
+
+  gscoped_ptr<Cache> upper_;
+  gscoped_ptr<Cache> lower_;
+  Demoter demoter_;
+  LowerTierEvicted lower_evicted_;
+  gscoped_ptr<TieredCacheMetrics> metrics_;
+  std::atomic<bool> shutting_down_;
+
+  DISALLOW_COPY_AND_ASSIGN(TieredCache);
+};
+
+} // anonymous namespace
+
+Cache* NewTieredCache(Cache* upper, Cache* lower) {
+  return new TieredCache(upper, lower);
+}
+
+}  // namespace kudu
@@ -0,0 +1,42 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+#ifndef KUDU_UTIL_TIERED_CACHE_H
+#define KUDU_UTIL_TIERED_CACHE_H
+
+namespace kudu {
+
+class Cache;
+
+// Create a cache made of two tiers, taking ownership of both. Entries are
+// inserted into and served from 'upper', typically a small DRAM cache. When
+// 'upper' evicts an entry, it is demoted into 'lower', typically a larger NVM
+// cache. A lookup which misses 'upper' but hits 'lower' promotes the entry
+// back into 'upper'.
+//
+// The charge of a demoted or promoted entry is the size of its value.
+// Entries inserted with an eviction callback are never demoted, so that the
+// callback runs exactly once. An entry which is erased while a handle to it
+// is outstanding may be demoted when the handle is released.
+//
+// Metrics are reported for 'upper' as for any other cache, along with
+// separate metrics for the demotions into, promotions from and usage of
+// 'lower'.
+Cache* NewTieredCache(Cache* upper, Cache* lower);
+
+}  // namespace kudu
+
+#endif /* KUDU_UTIL_TIERED_CACHE_H */
@@ -217,6 +217,14 @@ build_lz4() {
   make -j$PARALLEL install
 }
 
+build_zstd() {
+  cd $ZSTD_DIR/lib
+  # Only the static library is needed.
+  make -j$PARALLEL CFLAGS="$EXTRA_CFLAGS -O3 -fPIC" libzstd.a
+  cp libzstd.a $PREFIX/lib/
+  cp zstd.h zdict.h $PREFIX/include/
+}
+
 build_bitshuffle() {
   cd $BITSHUFFLE_DIR
   # bitshuffle depends on lz4, therefore set the flag I$PREFIX/include
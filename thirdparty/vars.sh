@@ -53,6 +53,9 @@ SNAPPY_DIR=$TP_DIR/snappy-$SNAPPY_VERSION
 LZ4_VERSION=r130
 LZ4_DIR=$TP_DIR/lz4-lz4-$LZ4_VERSION
 
+ZSTD_VERSION=1.3.1
+ZSTD_DIR=$TP_DIR/zstd-$ZSTD_VERSION
+
 # from https://github.com/kiyo-masui/bitshuffle
 # Hash of git: 55f9b4caec73fa21d13947cacea1295926781440
 BITSHUFFLE_VERSION=55f9b4c